@@ -155,7 +155,7 @@ babel_interface_delete (int cmd, struct zclient *client, zebra_size_t length)
 
     /* To support pseudo interface do not free interface structure.  */
     /* if_delete(ifp); */
-    ifp->ifindex = IFINDEX_INTERNAL;
+    if_set_index (ifp, IFINDEX_INTERNAL);
 
     return 0;
 }
@@ -80,6 +80,7 @@ unsigned char myid[8];            /* unique id (mac address of an interface) */
 int debug = 0;
 
 int resend_delay = -1;
+int flush_delay = -1;
 static const char *pidfile = PATH_BABELD_PID;
 
 const unsigned char zeroes[16] = {0};
@@ -257,6 +258,7 @@ babel_init(int argc, char **argv)
     memory_init ();
 
     resend_delay = BABEL_DEFAULT_RESEND_DELAY;
+    flush_delay = BABEL_DEFAULT_FLUSH_DELAY;
 
     babel_replace_by_null(STDIN_FILENO);
 
@@ -457,6 +459,7 @@ babel_exit_properly(void)
     /* Uninstall and flush all routes. */
     debugf(BABEL_DEBUG_COMMON, "Uninstall routes.");
     flush_all_routes();
+    kernel_route_flush();
     babel_interface_close_all();
     babel_zebra_close_connexion();
     babel_save_state_file();
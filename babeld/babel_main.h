@@ -42,6 +42,7 @@ extern struct timeval babel_now;         /* current time             */
 extern struct thread_master *master;     /* quagga's threads handler */
 extern int debug;
 extern int resend_delay;
+extern int flush_delay;
 
 extern unsigned char myid[8];
 
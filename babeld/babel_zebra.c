@@ -374,5 +374,6 @@ zebra_config_write (struct vty *vty)
 void
 babel_zebra_close_connexion(void)
 {
+    zclient_flush(zclient);
     zclient_stop(zclient);
 }
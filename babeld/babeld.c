@@ -107,6 +107,11 @@ babel_config_write (struct vty *vty)
         vty_out (vty, " babel resend-delay %u%s", resend_delay, VTY_NEWLINE);
         lines++;
     }
+    if (flush_delay != BABEL_DEFAULT_FLUSH_DELAY)
+    {
+        vty_out (vty, " babel flush-delay %u%s", flush_delay, VTY_NEWLINE);
+        lines++;
+    }
     /* list enabled interfaces */
     lines = 1 + babel_enable_if_config_write (vty);
     /* list redistributed protocols */
@@ -670,6 +675,21 @@ DEFUN (babel_set_resend_delay,
     return CMD_SUCCESS;
 }
 
+DEFUN (babel_set_flush_delay,
+       babel_set_flush_delay_cmd,
+       "babel flush-delay <10-1000>",
+       "Babel commands\n"
+       "Time updates may wait to be packed with others\n"
+       "Milliseconds\n")
+{
+    int delay;
+
+    VTY_GET_INTEGER_RANGE("milliseconds", delay, argv[0], 10, 1000);
+
+    flush_delay = delay;
+    return CMD_SUCCESS;
+}
+
 void
 babeld_quagga_init(void)
 {
@@ -681,6 +701,7 @@ babeld_quagga_init(void)
 
     install_default(BABEL_NODE);
     install_element(BABEL_NODE, &babel_set_resend_delay_cmd);
+    install_element(BABEL_NODE, &babel_set_flush_delay_cmd);
 
     babel_if_init();
 
@@ -112,6 +112,7 @@ THE SOFTWARE.
 #define BABEL_DEFAULT_HELLO_INTERVAL 4000
 #define BABEL_DEFAULT_UPDATE_INTERVAL 16000
 #define BABEL_DEFAULT_RESEND_DELAY 2000
+#define BABEL_DEFAULT_FLUSH_DELAY 10
 
 
 /* Babel socket. */
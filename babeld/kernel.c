@@ -60,6 +60,7 @@ THE SOFTWARE.
 #include "vty.h"
 #include "memory.h"
 #include "thread.h"
+#include "jhash.h"
 
 #include "util.h"
 #include "babel_interface.h"
@@ -93,13 +94,193 @@ kernel_interface_wireless(struct interface *interface)
     return 0;
 }
 
+/* Route changes are not sent to zebra as they are made but queued, one
+   entry per prefix holding what zebra has and what it is to have, and
+   sent together KERNEL_QUEUE_DELAY later.  A prefix switching several
+   times in the window costs one message, or none if it ends up as it
+   was, and the routes that share a next hop go in the same bulk
+   message.  The entries are kept in an array, indexed by an
+   open-addressed hash table over (prefix, plen); both are emptied as a
+   whole when the queue is sent. */
+
+struct kernel_pending {
+    unsigned char prefix[16];
+    unsigned short plen;
+    unsigned char ipv4;
+    unsigned char installed;    /* what zebra has */
+    unsigned char gate[16];
+    int ifindex;
+    unsigned int metric;
+    unsigned char want;         /* what it is to have */
+    unsigned char newgate[16];
+    int newifindex;
+    unsigned int newmetric;
+};
+
+static struct kernel_pending *kernel_queue = NULL;
+static int kernel_queue_count = 0, kernel_queue_slots = 0;
+static int *kernel_queue_index = NULL; /* entry + 1, or 0 if free */
+static int kernel_queue_index_size = 0;
+static struct thread *kernel_queue_thread = NULL;
+
+static unsigned int
+kernel_queue_hash(const unsigned char *prefix, unsigned short plen)
+{
+    u_int32_t k[4];
+
+    memcpy(k, prefix, 16);
+    return jhash2(k, 4, plen);
+}
+
+/* Returns the bucket of kernel_queue_index holding (prefix, plen), or the
+   free bucket where it would go. */
+static unsigned int
+kernel_queue_bucket(const unsigned char *prefix, unsigned short plen)
+{
+    unsigned int mask = kernel_queue_index_size - 1;
+    unsigned int b = kernel_queue_hash(prefix, plen) & mask;
+
+    while(kernel_queue_index[b] != 0) {
+        struct kernel_pending *k = &kernel_queue[kernel_queue_index[b] - 1];
+        if(k->plen == plen && memcmp(k->prefix, prefix, 16) == 0)
+            break;
+        b = (b + 1) & mask;
+    }
+
+    return b;
+}
+
+/* Makes room for one more entry, the index staying at most half full. */
+static int
+kernel_queue_grow(void)
+{
+    int i;
+
+    if(kernel_queue_count >= kernel_queue_slots) {
+        int n = kernel_queue_slots ? 2 * kernel_queue_slots : 64;
+        struct kernel_pending *new_queue;
+
+        new_queue = realloc(kernel_queue, n * sizeof(struct kernel_pending));
+        if(new_queue == NULL)
+            return -1;
+        kernel_queue = new_queue;
+        kernel_queue_slots = n;
+    }
+
+    if(2 * (kernel_queue_count + 1) > kernel_queue_index_size) {
+        int n = kernel_queue_index_size ? 2 * kernel_queue_index_size : 128;
+        int *new_index;
+
+        new_index = calloc(n, sizeof(int));
+        if(new_index == NULL)
+            return -1;
+        free(kernel_queue_index);
+        kernel_queue_index = new_index;
+        kernel_queue_index_size = n;
+        for(i = 0; i < kernel_queue_count; i++)
+            kernel_queue_index[kernel_queue_bucket(kernel_queue[i].prefix,
+                                                   kernel_queue[i].plen)] =
+                i + 1;
+    }
+
+    return 0;
+}
+
+/* Adds and deletes apart, then by next hop and metric, so that routes
+   sharing them are consecutive. */
+static int
+kernel_pending_cmp(const void *a, const void *b)
+{
+    const struct kernel_pending *k1 = a, *k2 = b;
+    int rc;
+
+    if(k1->want != k2->want)
+        return k1->want ? 1 : -1;
+    if(k1->ipv4 != k2->ipv4)
+        return k1->ipv4 ? -1 : 1;
+    if(k1->want) {
+        rc = memcmp(k1->newgate, k2->newgate, 16);
+        if(rc == 0 && k1->newifindex != k2->newifindex)
+            rc = k1->newifindex < k2->newifindex ? -1 : 1;
+        if(rc == 0 && k1->newmetric != k2->newmetric)
+            rc = k1->newmetric < k2->newmetric ? -1 : 1;
+    } else {
+        rc = memcmp(k1->gate, k2->gate, 16);
+        if(rc == 0 && k1->ifindex != k2->ifindex)
+            rc = k1->ifindex < k2->ifindex ? -1 : 1;
+        if(rc == 0 && k1->metric != k2->metric)
+            rc = k1->metric < k2->metric ? -1 : 1;
+    }
+    return rc;
+}
+
+/* Sends what is queued to zebra.  An add replaces the route zebra has
+   for the prefix, so a changed route is only added. */
+void
+kernel_route_flush(void)
+{
+    struct kernel_pending *k;
+    int i, rc, sent = 0;
+
+    THREAD_OFF(kernel_queue_thread);
+    if(kernel_queue_count == 0)
+        return;
+
+    qsort(kernel_queue, kernel_queue_count, sizeof(struct kernel_pending),
+          kernel_pending_cmp);
+
+    zclient_cork(zclient);
+    for(i = 0; i < kernel_queue_count; i++) {
+        k = &kernel_queue[i];
+        if(k->want) {
+            if(k->installed && k->metric == k->newmetric &&
+               k->ifindex == k->newifindex &&
+               memcmp(k->gate, k->newgate, 16) == 0)
+                continue;
+            rc = k->ipv4 ?
+                kernel_route_v4(1, k->prefix, k->plen, k->newgate,
+                                k->newifindex, k->newmetric):
+                kernel_route_v6(1, k->prefix, k->plen, k->newgate,
+                                k->newifindex, k->newmetric);
+        } else {
+            if(!k->installed)
+                continue;
+            rc = k->ipv4 ?
+                kernel_route_v4(0, k->prefix, k->plen, k->gate,
+                                k->ifindex, k->metric):
+                kernel_route_v6(0, k->prefix, k->plen, k->gate,
+                                k->ifindex, k->metric);
+        }
+        if(rc < 0)
+            zlog_err("kernel_route(%s %s): %s", k->want ? "ADD" : "FLUSH",
+                     format_prefix(k->prefix, k->plen), safe_strerror(errno));
+        sent++;
+    }
+    zclient_uncork(zclient);
+
+    debugf(BABEL_DEBUG_ROUTE, "Sent %d of %d queued route changes to zebra.",
+           sent, kernel_queue_count);
+
+    kernel_queue_count = 0;
+    memset(kernel_queue_index, 0, kernel_queue_index_size * sizeof(int));
+}
+
+static int
+kernel_route_flush_thread(struct thread *thread)
+{
+    kernel_queue_thread = NULL;
+    kernel_route_flush();
+    return 0;
+}
+
 int
 kernel_route(int operation, const unsigned char *pref, unsigned short plen,
              const unsigned char *gate, int ifindex, unsigned int metric,
              const unsigned char *newgate, int newifindex,
              unsigned int newmetric)
 {
-    int rc;
+    struct kernel_pending *k;
+    unsigned int b;
     int ipv4;
 
     /* Check that the protocol family is consistent. */
@@ -117,34 +298,49 @@ kernel_route(int operation, const unsigned char *pref, unsigned short plen,
         ipv4 = 0;
     }
 
+    if(operation == ROUTE_MODIFY && newmetric == metric &&
+       memcmp(newgate, gate, 16) == 0 && newifindex == ifindex)
+        return 0;
+
+    if(kernel_queue_grow() < 0) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    b = kernel_queue_bucket(pref, plen);
+    if(kernel_queue_index[b] == 0) {
+        k = &kernel_queue[kernel_queue_count++];
+        kernel_queue_index[b] = kernel_queue_count;
+        memset(k, 0, sizeof(struct kernel_pending));
+        memcpy(k->prefix, pref, 16);
+        k->plen = plen;
+        k->ipv4 = ipv4;
+        /* Zebra has the route being replaced or removed. */
+        if(operation != ROUTE_ADD) {
+            k->installed = 1;
+            memcpy(k->gate, gate, 16);
+            k->ifindex = ifindex;
+            k->metric = metric;
+        }
+    } else {
+        k = &kernel_queue[kernel_queue_index[b] - 1];
+    }
+
     switch (operation) {
         case ROUTE_ADD:
-            return ipv4 ?
-                   kernel_route_v4(1, pref, plen, gate, ifindex, metric):
-                   kernel_route_v6(1, pref, plen, gate, ifindex, metric);
+            memcpy(k->newgate, gate, 16);
+            k->newifindex = ifindex;
+            k->newmetric = metric;
+            k->want = 1;
             break;
         case ROUTE_FLUSH:
-            return ipv4 ?
-                   kernel_route_v4(0, pref, plen, gate, ifindex, metric):
-                   kernel_route_v6(0, pref, plen, gate, ifindex, metric);
+            k->want = 0;
             break;
         case ROUTE_MODIFY:
-            if(newmetric == metric && memcmp(newgate, gate, 16) == 0 &&
-               newifindex == ifindex)
-                return 0;
-            debugf(BABEL_DEBUG_ROUTE, "Modify route: delete old; add new.");
-            rc = ipv4 ?
-                kernel_route_v4(0, pref, plen, gate, ifindex, metric):
-                kernel_route_v6(0, pref, plen, gate, ifindex, metric);
-
-            if (rc < 0)
-                return -1;
-
-            rc = ipv4 ?
-                kernel_route_v4(1, pref, plen, newgate, newifindex, newmetric):
-                kernel_route_v6(1, pref, plen, newgate, newifindex, newmetric);
-
-            return rc;
+            memcpy(k->newgate, newgate, 16);
+            k->newifindex = newifindex;
+            k->newmetric = newmetric;
+            k->want = 1;
             break;
         default:
             zlog_err("this should never appens (false value - kernel_route)");
@@ -152,6 +348,12 @@ kernel_route(int operation, const unsigned char *pref, unsigned short plen,
             exit(1);
             break;
     }
+
+    if(kernel_queue_thread == NULL)
+        kernel_queue_thread =
+            thread_add_timer_msec(master, kernel_route_flush_thread, NULL,
+                                  KERNEL_QUEUE_DELAY);
+    return 0;
 }
 
 static int
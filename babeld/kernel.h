@@ -55,6 +55,9 @@ struct kernel_route {
 #define ROUTE_ADD 1
 #define ROUTE_MODIFY 2
 
+/* How long route changes are held before going to zebra, in ms. */
+#define KERNEL_QUEUE_DELAY 20
+
 extern int export_table, import_table;
 
 int kernel_interface_operational(struct interface *interface);
@@ -64,6 +67,7 @@ int kernel_route(int operation, const unsigned char *dest, unsigned short plen,
                  const unsigned char *gate, int ifindex, unsigned int metric,
                  const unsigned char *newgate, int newifindex,
                  unsigned int newmetric);
+void kernel_route_flush(void);
 int if_eui64(char *ifname, int ifindex, unsigned char *eui);
 int gettime(struct timeval *tv);
 int read_random_bytes(void *buf, size_t len);
@@ -582,12 +582,13 @@ schedule_flush(struct interface *ifp)
     set_timeout(&babel_ifp->flush_timeout, msecs);
 }
 
+/* Flush soon, but leave flush_delay for more updates to join the
+   packet. */
 static void
 schedule_flush_now(struct interface *ifp)
 {
     babel_interface_nfo *babel_ifp = babel_get_if_nfo(ifp);
-    /* Almost now */
-    unsigned msecs = roughly(10);
+    unsigned msecs = roughly(flush_delay);
     if(babel_ifp->flush_timeout.tv_sec != 0 &&
        timeval_minus_msec(&babel_ifp->flush_timeout, &babel_now) < msecs)
         return;
@@ -1085,8 +1086,20 @@ buffer_update(struct interface *ifp,
 {
     babel_interface_nfo *babel_ifp = babel_get_if_nfo(ifp);
     if(babel_ifp->num_buffered_updates > 0 &&
-       babel_ifp->num_buffered_updates >= babel_ifp->update_bufsize)
-        flushupdates(ifp);
+       babel_ifp->num_buffered_updates >= babel_ifp->update_bufsize) {
+        /* Grow the buffer rather than flushing early, so that a burst
+           of changes still goes out in as few packets as possible. */
+        struct buffered_update *new_updates;
+        int n = 2 * babel_ifp->update_bufsize;
+        new_updates = realloc(babel_ifp->buffered_updates,
+                              n * sizeof(struct buffered_update));
+        if(new_updates == NULL) {
+            flushupdates(ifp);
+        } else {
+            babel_ifp->buffered_updates = new_updates;
+            babel_ifp->update_bufsize = n;
+        }
+    }
 
     if(babel_ifp->update_bufsize == 0) {
         int n;
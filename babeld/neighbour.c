@@ -54,14 +54,60 @@ THE SOFTWARE.
 #include "route.h"
 #include "message.h"
 #include "resend.h"
+#include "jhash.h"
 
 struct neighbour *neighs = NULL;
 
+/* Neighbours are also chained in a hash table keyed by (address, ifp),
+   which grows with their number. */
+static struct neighbour **neigh_hash = NULL;
+static unsigned int neigh_hash_size = 0, neigh_count = 0;
+
+static unsigned int
+neighbour_hash_key(const unsigned char *address, struct interface *ifp)
+{
+    u_int32_t k[4];
+
+    memcpy(k, address, 16);
+    return jhash2(k, 4, (u_int32_t)(uintptr_t)ifp);
+}
+
+static void
+neighbour_hash_resize(unsigned int size)
+{
+    struct neighbour **new_hash;
+    struct neighbour *neigh;
+
+    new_hash = calloc(size, sizeof(struct neighbour *));
+    if(new_hash == NULL) {
+        /* Keep the old table; lookups get slower but still work. */
+        zlog_err("calloc(neighbour hash): %s", safe_strerror(errno));
+        return;
+    }
+
+    FOR_ALL_NEIGHBOURS(neigh) {
+        unsigned int h =
+            neighbour_hash_key(neigh->address, neigh->ifp) & (size - 1);
+        neigh->hash_next = new_hash[h];
+        new_hash[h] = neigh;
+    }
+
+    free(neigh_hash);
+    neigh_hash = new_hash;
+    neigh_hash_size = size;
+}
+
 static struct neighbour *
 find_neighbour_nocreate(const unsigned char *address, struct interface *ifp)
 {
     struct neighbour *neigh;
-    FOR_ALL_NEIGHBOURS(neigh) {
+
+    if(neigh_hash_size == 0)
+        return NULL;
+
+    neigh = neigh_hash[neighbour_hash_key(address, ifp) &
+                       (neigh_hash_size - 1)];
+    for(; neigh; neigh = neigh->hash_next) {
         if(memcmp(address, neigh->address, 16) == 0 &&
            neigh->ifp == ifp)
             return neigh;
@@ -72,11 +118,19 @@ find_neighbour_nocreate(const unsigned char *address, struct interface *ifp)
 void
 flush_neighbour(struct neighbour *neigh)
 {
+    struct neighbour **p;
+
     flush_neighbour_routes(neigh);
     if(unicast_neighbour == neigh)
         flush_unicast(1);
     flush_resends(neigh);
 
+    p = &neigh_hash[neighbour_hash_key(neigh->address, neigh->ifp) &
+                    (neigh_hash_size - 1)];
+    while(*p != neigh)
+        p = &(*p)->hash_next;
+    *p = neigh->hash_next;
+
     if(neighs == neigh) {
         neighs = neigh->next;
     } else {
@@ -86,6 +140,7 @@ flush_neighbour(struct neighbour *neigh)
         previous->next = neigh->next;
     }
     free(neigh);
+    neigh_count--;
 }
 
 struct neighbour *
@@ -93,6 +148,7 @@ find_neighbour(const unsigned char *address, struct interface *ifp)
 {
     struct neighbour *neigh;
     const struct timeval zero = {0, 0};
+    unsigned int h;
 
     neigh = find_neighbour_nocreate(address, ifp);
     if(neigh)
@@ -101,6 +157,11 @@ find_neighbour(const unsigned char *address, struct interface *ifp)
     debugf(BABEL_DEBUG_COMMON,"Creating neighbour %s on %s.",
            format_address(address), ifp->name);
 
+    if(neigh_count >= neigh_hash_size)
+        neighbour_hash_resize(neigh_hash_size < 1 ? 16 : 2 * neigh_hash_size);
+    if(neigh_hash_size == 0)
+        return NULL;
+
     neigh = malloc(sizeof(struct neighbour));
     if(neigh == NULL) {
         zlog_err("malloc(neighbour): %s", safe_strerror(errno));
@@ -118,6 +179,10 @@ find_neighbour(const unsigned char *address, struct interface *ifp)
     neigh->ifp = ifp;
     neigh->next = neighs;
     neighs = neigh;
+    h = neighbour_hash_key(address, ifp) & (neigh_hash_size - 1);
+    neigh->hash_next = neigh_hash[h];
+    neigh_hash[h] = neigh;
+    neigh_count++;
     send_hello(ifp);
     return neigh;
 }
@@ -38,6 +38,7 @@ THE SOFTWARE.
 
 struct neighbour {
     struct neighbour *next;
+    struct neighbour *hash_next;
     /* This is -1 when unknown, so don't make it unsigned */
     int hello_seqno;
     unsigned char address[16];
@@ -51,10 +51,64 @@ THE SOFTWARE.
 #include "resend.h"
 #include "message.h"
 #include "babel_interface.h"
+#include "jhash.h"
 
 struct timeval resend_time = {0, 0};
 struct resend *to_resend = NULL;
 
+/* Pending resends are also chained in a hash table keyed by (kind,
+   prefix, plen), which grows with their number. */
+static struct resend **resend_hash = NULL;
+static unsigned int resend_hash_size = 0, resend_count = 0;
+
+static unsigned int
+resend_hash_key(int kind, const unsigned char *prefix, unsigned char plen)
+{
+    u_int32_t k[4];
+
+    memcpy(k, prefix, 16);
+    return jhash2(k, 4, (kind << 8) | plen);
+}
+
+static void
+resend_hash_resize(unsigned int size)
+{
+    struct resend **new_hash;
+    struct resend *resend;
+
+    new_hash = calloc(size, sizeof(struct resend *));
+    if(new_hash == NULL) {
+        /* Keep the old table; lookups get slower but still work. */
+        zlog_err("calloc(resend hash): %s", safe_strerror(errno));
+        return;
+    }
+
+    for(resend = to_resend; resend; resend = resend->next) {
+        unsigned int h =
+            resend_hash_key(resend->kind, resend->prefix, resend->plen) &
+            (size - 1);
+        resend->hash_next = new_hash[h];
+        new_hash[h] = resend;
+    }
+
+    free(resend_hash);
+    resend_hash = new_hash;
+    resend_hash_size = size;
+}
+
+static void
+resend_hash_delete(struct resend *resend)
+{
+    struct resend **p;
+
+    p = &resend_hash[resend_hash_key(resend->kind,
+                                     resend->prefix, resend->plen) &
+                     (resend_hash_size - 1)];
+    while(*p != resend)
+        p = &(*p)->hash_next;
+    *p = resend->hash_next;
+}
+
 static int
 resend_match(struct resend *resend,
              int kind, const unsigned char *prefix, unsigned char plen)
@@ -72,31 +126,27 @@ flush_resends(struct neighbour *neigh)
 }
 
 static struct resend *
-find_resend(int kind, const unsigned char *prefix, unsigned char plen,
-             struct resend **previous_return)
+find_resend(int kind, const unsigned char *prefix, unsigned char plen)
 {
-    struct resend *current, *previous;
+    struct resend *resend;
 
-    previous = NULL;
-    current = to_resend;
-    while(current) {
-        if(resend_match(current, kind, prefix, plen)) {
-            if(previous_return)
-                *previous_return = previous;
-            return current;
-        }
-        previous = current;
-        current = current->next;
+    if(resend_hash_size == 0)
+        return NULL;
+
+    resend = resend_hash[resend_hash_key(kind, prefix, plen) &
+                         (resend_hash_size - 1)];
+    for(; resend; resend = resend->hash_next) {
+        if(resend_match(resend, kind, prefix, plen))
+            return resend;
     }
 
     return NULL;
 }
 
 struct resend *
-find_request(const unsigned char *prefix, unsigned char plen,
-             struct resend **previous_return)
+find_request(const unsigned char *prefix, unsigned char plen)
 {
-    return find_resend(RESEND_REQUEST, prefix, plen, previous_return);
+    return find_resend(RESEND_REQUEST, prefix, plen);
 }
 
 int
@@ -116,7 +166,7 @@ record_resend(int kind, const unsigned char *prefix, unsigned char plen,
     if(delay >= 0xFFFF)
         delay = 0xFFFF;
 
-    resend = find_resend(kind, prefix, plen, NULL);
+    resend = find_resend(kind, prefix, plen);
     if(resend) {
         if(resend->delay && delay)
             resend->delay = MIN(resend->delay, delay);
@@ -136,6 +186,13 @@ record_resend(int kind, const unsigned char *prefix, unsigned char plen,
         if(resend->ifp != ifp)
             resend->ifp = NULL;
     } else {
+        unsigned int h;
+
+        if(resend_count >= resend_hash_size)
+            resend_hash_resize(resend_hash_size < 1 ?
+                               64 : 2 * resend_hash_size);
+        if(resend_hash_size == 0)
+            return -1;
         resend = malloc(sizeof(struct resend));
         if(resend == NULL)
             return -1;
@@ -153,6 +210,10 @@ record_resend(int kind, const unsigned char *prefix, unsigned char plen,
         resend->time = babel_now;
         resend->next = to_resend;
         to_resend = resend;
+        h = resend_hash_key(kind, prefix, plen) & (resend_hash_size - 1);
+        resend->hash_next = resend_hash[h];
+        resend_hash[h] = resend;
+        resend_count++;
     }
 
     if(resend->delay) {
@@ -180,7 +241,7 @@ unsatisfied_request(const unsigned char *prefix, unsigned char plen,
 {
     struct resend *request;
 
-    request = find_request(prefix, plen, NULL);
+    request = find_request(prefix, plen);
     if(request == NULL || resend_expired(request))
         return 0;
 
@@ -199,7 +260,7 @@ request_redundant(struct interface *ifp,
 {
     struct resend *request;
 
-    request = find_request(prefix, plen, NULL);
+    request = find_request(prefix, plen);
     if(request == NULL || resend_expired(request))
         return 0;
 
@@ -227,9 +288,9 @@ satisfy_request(const unsigned char *prefix, unsigned char plen,
                 unsigned short seqno, const unsigned char *id,
                 struct interface *ifp)
 {
-    struct resend *request, *previous;
+    struct resend *request;
 
-    request = find_request(prefix, plen, &previous);
+    request = find_request(prefix, plen);
     if(request == NULL)
         return 0;
 
@@ -259,6 +320,8 @@ expire_resend()
     current = to_resend;
     while(current) {
         if(resend_expired(current)) {
+            resend_hash_delete(current);
+            resend_count--;
             if(previous == NULL) {
                 to_resend = current->next;
                 free(current);
@@ -274,6 +337,11 @@ expire_resend()
             current = current->next;
         }
     }
+    if(resend_count == 0) {
+        free(resend_hash);
+        resend_hash = NULL;
+        resend_hash_size = 0;
+    }
     if(recompute)
         recompute_resend_time();
 }
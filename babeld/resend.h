@@ -53,12 +53,12 @@ struct resend {
     unsigned char id[8];
     struct interface *ifp;
     struct resend *next;
+    struct resend *hash_next;
 };
 
 extern struct timeval resend_time;
 
-struct resend *find_request(const unsigned char *prefix, unsigned char plen,
-                            struct resend **previous_return);
+struct resend *find_request(const unsigned char *prefix, unsigned char plen);
 void flush_resends(struct neighbour *neigh);
 int record_resend(int kind, const unsigned char *prefix, unsigned char plen,
                    unsigned short seqno, const unsigned char *id,
@@ -39,6 +39,7 @@ THE SOFTWARE.
 
 #include <zebra.h>
 #include "if.h"
+#include "jhash.h"
 
 #include "babeld.h"
 #include "util.h"
@@ -61,58 +62,78 @@ int diversity_kind = DIVERSITY_NONE;
 int diversity_factor = 256;     /* in units of 1/256 */
 int keep_unfeasible = 0;
 
-/* We maintain a list of "slots", ordered by prefix.  Every slot
+/* We maintain an array of "slots", in no particular order.  Every slot
    contains a linked list of the routes to this prefix, with the
-   installed route, if any, at the head of the list. */
+   installed route, if any, at the head of the list.  The slots are
+   indexed by an open-addressed hash table over (prefix, plen), so that
+   looking up, adding and removing a prefix does not depend on the size
+   of the table.  When a slot becomes empty, the last slot is moved into
+   its place to keep the array dense. */
 
-static int
-route_compare(const unsigned char *prefix, unsigned char plen,
-               struct babel_route *route)
+static int *route_index = NULL; /* slot number + 1, or 0 if free */
+static int route_index_size = 0;
+
+static unsigned int
+route_hash(const unsigned char *prefix, unsigned char plen)
 {
-    int i = memcmp(prefix, route->src->prefix, 16);
-    if(i != 0)
-        return i;
+    u_int32_t k[4];
 
-    if(plen < route->src->plen)
-        return -1;
-    else if(plen > route->src->plen)
-        return 1;
-    else
-        return 0;
+    memcpy(k, prefix, 16);
+    return jhash2(k, 4, plen);
 }
 
-/* Performs binary search, returns -1 in case of failure.  In the latter
-   case, new_return is the place where to insert the new element. */
-
-static int
-find_route_slot(const unsigned char *prefix, unsigned char plen,
-                int *new_return)
+/* Returns the bucket of route_index holding (prefix, plen), or the free
+   bucket where it would go. */
+static unsigned int
+route_index_bucket(const unsigned char *prefix, unsigned char plen)
 {
-    int p, m, g, c;
-
-    if(route_slots < 1) {
-        if(new_return)
-            *new_return = 0;
-        return -1;
+    unsigned int mask = route_index_size - 1;
+    unsigned int b = route_hash(prefix, plen) & mask;
+
+    while(route_index[b] != 0) {
+        struct babel_route *r = routes[route_index[b] - 1];
+        if(r->src->plen == plen && memcmp(r->src->prefix, prefix, 16) == 0)
+            break;
+        b = (b + 1) & mask;
     }
 
-    p = 0; g = route_slots - 1;
+    return b;
+}
 
-    do {
-        m = (p + g) / 2;
-        c = route_compare(prefix, plen, routes[m]);
-        if(c == 0)
-            return m;
-        else if(c < 0)
-            g = m - 1;
-        else
-            p = m + 1;
-    } while(p <= g);
+/* Frees bucket b, shifting back the entries of the probe sequence that
+   follows it. */
+static void
+route_index_delete(unsigned int b)
+{
+    unsigned int mask = route_index_size - 1;
+    unsigned int i = b, j = b, k;
 
-    if(new_return)
-        *new_return = p;
+    route_index[i] = 0;
+    while(1) {
+        struct babel_route *r;
 
-    return -1;
+        j = (j + 1) & mask;
+        if(route_index[j] == 0)
+            break;
+        r = routes[route_index[j] - 1];
+        k = route_hash(r->src->prefix, r->src->plen) & mask;
+        /* Leave it alone if its home bucket lies cyclically in (i, j]. */
+        if(i <= j ? (i < k && k <= j) : (i < k || k <= j))
+            continue;
+        route_index[i] = route_index[j];
+        route_index[j] = 0;
+        i = j;
+    }
+}
+
+/* Returns the slot of (prefix, plen), or -1 if there is none. */
+static int
+find_route_slot(const unsigned char *prefix, unsigned char plen)
+{
+    if(route_slots < 1)
+        return -1;
+
+    return route_index[route_index_bucket(prefix, plen)] - 1;
 }
 
 struct babel_route *
@@ -120,7 +141,7 @@ find_route(const unsigned char *prefix, unsigned char plen,
            struct neighbour *neigh, const unsigned char *nexthop)
 {
     struct babel_route *route;
-    int i = find_route_slot(prefix, plen, NULL);
+    int i = find_route_slot(prefix, plen);
 
     if(i < 0)
         return NULL;
@@ -139,7 +160,7 @@ find_route(const unsigned char *prefix, unsigned char plen,
 struct babel_route *
 find_installed_route(const unsigned char *prefix, unsigned char plen)
 {
-    int i = find_route_slot(prefix, plen, NULL);
+    int i = find_route_slot(prefix, plen);
 
     if(i >= 0 && routes[i]->installed)
         return routes[i];
@@ -154,36 +175,75 @@ installed_routes_estimate(void)
     return route_slots;
 }
 
+/* The hash index is kept at twice the size of the slot array, which
+   is always zero or a power of two. */
 static int
 resize_route_table(int new_slots)
 {
     struct babel_route **new_routes;
+    int *new_index;
+    int i;
     assert(new_slots >= route_slots);
 
     if(new_slots == 0) {
-        new_routes = NULL;
         free(routes);
-    } else {
-        new_routes = realloc(routes, new_slots * sizeof(struct babel_route*));
-        if(new_routes == NULL)
-            return -1;
+        free(route_index);
+        routes = NULL;
+        route_index = NULL;
+        max_route_slots = 0;
+        route_index_size = 0;
+        return 1;
+    }
+
+    new_index = calloc(2 * new_slots, sizeof(int));
+    if(new_index == NULL)
+        return -1;
+    new_routes = realloc(routes, new_slots * sizeof(struct babel_route*));
+    if(new_routes == NULL) {
+        free(new_index);
+        return -1;
     }
 
+    free(route_index);
     max_route_slots = new_slots;
     routes = new_routes;
+    route_index = new_index;
+    route_index_size = 2 * new_slots;
+
+    for(i = 0; i < route_slots; i++)
+        route_index[route_index_bucket(routes[i]->src->prefix,
+                                       routes[i]->src->plen)] = i + 1;
     return 1;
 }
 
+/* Removes slot i, whose only route is being flushed. */
+static void
+remove_route_slot(int i)
+{
+    int last = route_slots - 1;
+
+    route_index_delete(route_index_bucket(routes[i]->src->prefix,
+                                          routes[i]->src->plen));
+
+    if(i < last) {
+        routes[i] = routes[last];
+        route_index[route_index_bucket(routes[i]->src->prefix,
+                                        routes[i]->src->plen)] = i + 1;
+    }
+    routes[last] = NULL;
+    route_slots--;
+}
+
 /* Insert a route into the table.  If successful, retains the route.
    On failure, caller must free the route. */
 static struct babel_route *
 insert_route(struct babel_route *route)
 {
-    int i, n;
+    int i;
 
     assert(!route->installed);
 
-    i = find_route_slot(route->src->prefix, route->src->plen, &n);
+    i = find_route_slot(route->src->prefix, route->src->plen);
 
     if(i < 0) {
         if(route_slots >= max_route_slots)
@@ -191,11 +251,10 @@ insert_route(struct babel_route *route)
         if(route_slots >= max_route_slots)
             return NULL;
         route->next = NULL;
-        if(n < route_slots)
-            memmove(routes + n + 1, routes + n,
-                    (route_slots - n) * sizeof(struct babel_route*));
+        routes[route_slots] = route;
+        route_index[route_index_bucket(route->src->prefix,
+                                       route->src->plen)] = route_slots + 1;
         route_slots++;
-        routes[n] = route;
     } else {
         struct babel_route *r;
         r = routes[i];
@@ -224,22 +283,17 @@ flush_route(struct babel_route *route)
         lost = 1;
     }
 
-    i = find_route_slot(route->src->prefix, route->src->plen, NULL);
+    i = find_route_slot(route->src->prefix, route->src->plen);
     assert(i >= 0 && i < route_slots);
 
     if(route == routes[i]) {
-        routes[i] = route->next;
+        if(route->next == NULL)
+            remove_route_slot(i);
+        else
+            routes[i] = route->next;
         route->next = NULL;
         free(route);
 
-        if(routes[i] == NULL) {
-            if(i < route_slots - 1)
-                memmove(routes + i, routes + i + 1,
-                        (route_slots - i - 1) * sizeof(struct babel_route*));
-            routes[route_slots - 1] = NULL;
-            route_slots--;
-        }
-
         if(route_slots == 0)
             resize_route_table(0);
         else if(max_route_slots > 8 && route_slots < max_route_slots / 4)
@@ -264,13 +318,13 @@ flush_all_routes()
 {
     int i;
 
-    /* Start from the end, to avoid shifting the table. */
+    /* Start from the end, so that emptied slots need not be refilled. */
     i = route_slots - 1;
     while(i >= 0) {
         while(i < route_slots) {
         /* Uninstall first, to avoid calling route_lost. */
             if(routes[i]->installed)
-                uninstall_route(routes[0]);
+                uninstall_route(routes[i]);
             flush_route(routes[i]);
         }
         i--;
@@ -386,7 +440,7 @@ install_route(struct babel_route *route)
         zlog_err("WARNING: installing unfeasible route "
                  "(this shouldn't happen).");
 
-    i = find_route_slot(route->src->prefix, route->src->plen, NULL);
+    i = find_route_slot(route->src->prefix, route->src->plen);
     assert(i >= 0 && i < route_slots);
 
     if(routes[i] != route && routes[i]->installed) {
@@ -461,8 +515,8 @@ switch_routes(struct babel_route *old, struct babel_route *new)
 
     old->installed = 0;
     new->installed = 1;
-    move_installed_route(new, find_route_slot(new->src->prefix, new->src->plen,
-                                              NULL));
+    move_installed_route(new, find_route_slot(new->src->prefix,
+                                              new->src->plen));
 }
 
 static void
@@ -587,7 +641,7 @@ find_best_route(const unsigned char *prefix, unsigned char plen, int feasible,
                 struct neighbour *exclude)
 {
     struct babel_route *route = NULL, *r = NULL;
-    int i = find_route_slot(prefix, plen, NULL);
+    int i = find_route_slot(prefix, plen);
 
     if(i < 0)
         return NULL;
@@ -47,31 +47,103 @@ THE SOFTWARE.
 #include "source.h"
 #include "babel_interface.h"
 #include "route.h"
+#include "jhash.h"
 
-struct source *srcs = NULL;
+/* Sources live on a list ordered by the time they were last updated,
+   oldest first, so that expire_sources need only look at its head.
+   They are also chained in a hash table keyed by (id, prefix, plen),
+   which grows with the number of sources. */
+
+static struct source *srcs = NULL, *srcs_tail = NULL;
+static struct source **source_hash = NULL;
+static unsigned int source_hash_size = 0, source_count = 0;
+
+static unsigned int
+source_hash_key(const unsigned char *id, const unsigned char *p,
+                unsigned char plen)
+{
+    u_int32_t k[6];
+
+    memcpy(k, id, 8);
+    memcpy(k + 2, p, 16);
+    return jhash2(k, 6, plen);
+}
+
+static void
+source_hash_resize(unsigned int size)
+{
+    struct source **new_hash;
+    struct source *src;
+
+    new_hash = calloc(size, sizeof(struct source *));
+    if(new_hash == NULL) {
+        /* Keep the old table; lookups get slower but still work. */
+        zlog_err("calloc(source hash): %s", safe_strerror(errno));
+        return;
+    }
+
+    for(src = srcs; src; src = src->next) {
+        unsigned int h =
+            source_hash_key(src->id, src->prefix, src->plen) & (size - 1);
+        src->hash_next = new_hash[h];
+        new_hash[h] = src;
+    }
+
+    free(source_hash);
+    source_hash = new_hash;
+    source_hash_size = size;
+}
+
+/* Move src to the young end of the time-ordered list. */
+static void
+source_touch(struct source *src)
+{
+    src->time = babel_now.tv_sec;
+
+    if(srcs_tail == src)
+        return;
+
+    if(src->prev)
+        src->prev->next = src->next;
+    else if(srcs == src)
+        srcs = src->next;
+    if(src->next)
+        src->next->prev = src->prev;
+
+    src->next = NULL;
+    src->prev = srcs_tail;
+    if(srcs_tail)
+        srcs_tail->next = src;
+    else
+        srcs = src;
+    srcs_tail = src;
+}
 
 struct source*
 find_source(const unsigned char *id, const unsigned char *p, unsigned char plen,
             int create, unsigned short seqno)
 {
     struct source *src;
+    unsigned int h;
 
-    for(src = srcs; src; src = src->next) {
-        /* This should really be a hash table.  For now, check the
-           last byte first. */
-        if(src->id[7] != id[7])
-            continue;
-        if(memcmp(src->id, id, 8) != 0)
-            continue;
-        if(src->plen != plen)
-            continue;
-        if(memcmp(src->prefix, p, 16) == 0)
-            return src;
+    if(source_hash_size > 0) {
+        h = source_hash_key(id, p, plen) & (source_hash_size - 1);
+        for(src = source_hash[h]; src; src = src->hash_next) {
+            if(src->plen == plen &&
+               memcmp(src->id, id, 8) == 0 &&
+               memcmp(src->prefix, p, 16) == 0)
+                return src;
+        }
     }
 
     if(!create)
         return NULL;
 
+    if(source_count >= source_hash_size)
+        source_hash_resize(source_hash_size < 1 ? 64 : 2 * source_hash_size);
+    if(source_hash_size == 0)
+        return NULL;
+
     src = malloc(sizeof(struct source));
     if(src == NULL) {
         zlog_err("malloc(source): %s", safe_strerror(errno));
@@ -83,10 +155,15 @@ find_source(const unsigned char *id, const unsigned char *p, unsigned char plen,
     src->plen = plen;
     src->seqno = seqno;
     src->metric = INFINITY;
-    src->time = babel_now.tv_sec;
     src->route_count = 0;
-    src->next = srcs;
-    srcs = src;
+    src->next = src->prev = NULL;
+    source_touch(src);
+
+    h = source_hash_key(id, p, plen) & (source_hash_size - 1);
+    src->hash_next = source_hash[h];
+    source_hash[h] = src;
+    source_count++;
+
     return src;
 }
 
@@ -108,20 +185,35 @@ release_source(struct source *src)
 int
 flush_source(struct source *src)
 {
+    struct source **p;
+
     if(src->route_count > 0)
         /* The source is in use by a route. */
         return 0;
 
-    if(srcs == src) {
+    p = &source_hash[source_hash_key(src->id, src->prefix, src->plen) &
+                     (source_hash_size - 1)];
+    while(*p != src)
+        p = &(*p)->hash_next;
+    *p = src->hash_next;
+
+    if(src->prev)
+        src->prev->next = src->next;
+    else
         srcs = src->next;
-    } else {
-        struct source *previous = srcs;
-        while(previous->next != src)
-            previous = previous->next;
-        previous->next = src->next;
-    }
+    if(src->next)
+        src->next->prev = src->prev;
+    else
+        srcs_tail = src->prev;
 
     free(src);
+    source_count--;
+
+    if(source_count == 0) {
+        free(source_hash);
+        source_hash = NULL;
+        source_hash_size = 0;
+    }
     return 1;
 }
 
@@ -142,7 +234,7 @@ update_source(struct source *src,
         src->seqno = seqno;
         src->metric = metric;
     }
-    src->time = babel_now.tv_sec;
+    source_touch(src);
 }
 
 void
@@ -150,18 +242,23 @@ expire_sources()
 {
     struct source *src;
 
-    src = srcs;
-    while(src) {
-        if(src->time > babel_now.tv_sec)
-            /* clock stepped */
-            src->time = babel_now.tv_sec;
-        if(src->time < babel_now.tv_sec - SOURCE_GC_TIME) {
-            struct source *old = src;
-            src = src->next;
-            flush_source(old);
-            continue;
+    /* If the clock stepped backwards, the youngest source is in the
+       future; bring every such source back to now.  This keeps the list
+       ordered. */
+    if(srcs_tail && srcs_tail->time > babel_now.tv_sec) {
+        for(src = srcs; src; src = src->next) {
+            if(src->time > babel_now.tv_sec)
+                src->time = babel_now.tv_sec;
         }
+    }
+
+    /* Sources still in use by a route stay at the head, so step over
+       them; stop at the first one that is young enough. */
+    src = srcs;
+    while(src && src->time < babel_now.tv_sec - SOURCE_GC_TIME) {
+        struct source *old = src;
         src = src->next;
+        flush_source(old);
     }
 }
 
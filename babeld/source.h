@@ -42,7 +42,9 @@ THE SOFTWARE.
 #define SOURCE_GC_TIME 200
 
 struct source {
-    struct source *next;
+    struct source *next;        /* in order of last update */
+    struct source *prev;
+    struct source *hash_next;
     unsigned char id[8];
     unsigned char prefix[16];
     unsigned char plen;
@@ -25,6 +25,7 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #include "prefix.h"
 #include "hash.h"
 #include "thread.h"
+#include "jhash.h"
 
 #include "bgpd/bgpd.h"
 #include "bgpd/bgp_table.h"
@@ -35,6 +36,7 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #include "bgpd/bgp_packet.h"
 #include "bgpd/bgp_fsm.h"
 #include "bgpd/bgp_mplsvpn.h"
+#include "bgpd/bgp_perf.h"
 
 /* BGP advertise attribute is used for pack same attribute update into
    one packet.  To do that we maintain attribute hash in struct
@@ -86,8 +88,11 @@ baa_hash_cmp (const void *p1, const void *p2)
 static struct bgp_advertise *
 bgp_advertise_new (void)
 {
-  return (struct bgp_advertise *) 
-    XCALLOC (MTYPE_BGP_ADVERTISE, sizeof (struct bgp_advertise));
+  struct bgp_advertise *adv;
+
+  adv = XCALLOC (MTYPE_BGP_ADVERTISE, sizeof (struct bgp_advertise));
+  adv->queued = bgp_perf_now ();
+  return adv;
 }
 
 static void
@@ -152,30 +157,268 @@ bgp_advertise_unintern (struct hash *hash, struct bgp_advertise_attr *baa)
     }
 }
 
+/* Node adjacency index.  */
+static struct bgp_adj_index *
+bgp_adj_index_new (unsigned int size)
+{
+  struct bgp_adj_index *idx;
+
+  idx = XMALLOC (MTYPE_BGP_ADJ_INDEX, sizeof (struct bgp_adj_index));
+  idx->count = 0;
+  idx->size = size;
+  idx->bucket = XCALLOC (MTYPE_BGP_ADJ_INDEX, size * sizeof (void *));
+  return idx;
+}
+
+static void
+bgp_adj_index_free (struct bgp_adj_index **idx)
+{
+  XFREE (MTYPE_BGP_ADJ_INDEX, (*idx)->bucket);
+  XFREE (MTYPE_BGP_ADJ_INDEX, *idx);
+}
+
+static inline void **
+bgp_adj_index_bucket (struct bgp_adj_index *idx, const struct peer *peer)
+{
+  uintptr_t key = (uintptr_t) peer;
+
+  return &idx->bucket[jhash_2words ((u_int32_t) key,
+				    (u_int32_t) (key >> 16 >> 16), 0)
+		      & (idx->size - 1)];
+}
+
+/* Size for an index of count adjacencies: below one per bucket.  */
+static unsigned int
+bgp_adj_index_size (unsigned int count)
+{
+  unsigned int size = BGP_ADJ_INDEX_MIN;
+
+  while (size < count)
+    size <<= 1;
+  return size << 1;
+}
+
+static void
+bgp_adj_out_index_build (struct bgp_node *rn, unsigned int count)
+{
+  struct bgp_adj_out *adj;
+  void **bucket;
+
+  if (rn->adj_out_index)
+    bgp_adj_index_free (&rn->adj_out_index);
+  rn->adj_out_index = bgp_adj_index_new (bgp_adj_index_size (count));
+
+  for (adj = rn->adj_out; adj; adj = adj->next)
+    {
+      bucket = bgp_adj_index_bucket (rn->adj_out_index, adj->peer);
+      adj->hash_next = *bucket;
+      *bucket = adj;
+      rn->adj_out_index->count++;
+    }
+}
+
+/* Link an adjacency into the node, indexing it if the node has many.  */
+static void
+bgp_adj_out_link (struct bgp_node *rn, struct bgp_adj_out *adj)
+{
+  struct bgp_adj_index *idx = rn->adj_out_index;
+  struct bgp_adj_out *a;
+  unsigned int n;
+  void **bucket;
+
+  BGP_ADJ_OUT_ADD (rn, adj);
+
+  if (! idx)
+    {
+      for (n = 0, a = rn->adj_out; a && n <= BGP_ADJ_INDEX_MIN; a = a->next)
+	n++;
+      if (n > BGP_ADJ_INDEX_MIN)
+	bgp_adj_out_index_build (rn, n);
+      return;
+    }
+  if (idx->count >= idx->size)
+    {
+      bgp_adj_out_index_build (rn, idx->count + 1);
+      return;
+    }
+  bucket = bgp_adj_index_bucket (idx, adj->peer);
+  adj->hash_next = *bucket;
+  *bucket = adj;
+  idx->count++;
+}
+
+static void
+bgp_adj_out_unlink (struct bgp_node *rn, struct bgp_adj_out *adj)
+{
+  struct bgp_adj_index *idx = rn->adj_out_index;
+  void **prev;
+
+  BGP_ADJ_OUT_DEL (rn, adj);
+
+  if (! idx)
+    return;
+  for (prev = bgp_adj_index_bucket (idx, adj->peer); *prev != adj;
+       prev = &((struct bgp_adj_out *) *prev)->hash_next)
+    assert (*prev);
+  *prev = adj->hash_next;
+  adj->hash_next = NULL;
+
+  /* Back to the plain list once the node has few adjacencies left.  */
+  if (--idx->count < BGP_ADJ_INDEX_MIN / 2)
+    bgp_adj_index_free (&rn->adj_out_index);
+}
+
+static void
+bgp_adj_in_index_build (struct bgp_node *rn, unsigned int count)
+{
+  struct bgp_adj_in *adj;
+  void **bucket;
+
+  if (rn->adj_in_index)
+    bgp_adj_index_free (&rn->adj_in_index);
+  rn->adj_in_index = bgp_adj_index_new (bgp_adj_index_size (count));
+
+  for (adj = rn->adj_in; adj; adj = adj->next)
+    {
+      bucket = bgp_adj_index_bucket (rn->adj_in_index, adj->peer);
+      adj->hash_next = *bucket;
+      *bucket = adj;
+      rn->adj_in_index->count++;
+    }
+}
+
+static void
+bgp_adj_in_link (struct bgp_node *rn, struct bgp_adj_in *adj)
+{
+  struct bgp_adj_index *idx = rn->adj_in_index;
+  struct bgp_adj_in *a;
+  unsigned int n;
+  void **bucket;
+
+  BGP_ADJ_IN_ADD (rn, adj);
+
+  if (! idx)
+    {
+      for (n = 0, a = rn->adj_in; a && n <= BGP_ADJ_INDEX_MIN; a = a->next)
+	n++;
+      if (n > BGP_ADJ_INDEX_MIN)
+	bgp_adj_in_index_build (rn, n);
+      return;
+    }
+  if (idx->count >= idx->size)
+    {
+      bgp_adj_in_index_build (rn, idx->count + 1);
+      return;
+    }
+  bucket = bgp_adj_index_bucket (idx, adj->peer);
+  adj->hash_next = *bucket;
+  *bucket = adj;
+  idx->count++;
+}
+
+static void
+bgp_adj_in_unlink (struct bgp_node *rn, struct bgp_adj_in *adj)
+{
+  struct bgp_adj_index *idx = rn->adj_in_index;
+  void **prev;
+
+  BGP_ADJ_IN_DEL (rn, adj);
+
+  if (! idx)
+    return;
+  for (prev = bgp_adj_index_bucket (idx, adj->peer); *prev != adj;
+       prev = &((struct bgp_adj_in *) *prev)->hash_next)
+    assert (*prev);
+  *prev = adj->hash_next;
+  adj->hash_next = NULL;
+
+  if (--idx->count < BGP_ADJ_INDEX_MIN / 2)
+    bgp_adj_index_free (&rn->adj_in_index);
+}
+
+/* The peer's Adj-RIB-In entry for the node.  */
+static struct bgp_adj_in *
+bgp_adj_in_get (struct bgp_node *rn, const struct peer *peer)
+{
+  struct bgp_adj_in *adj;
+
+  if (rn->adj_in_index)
+    {
+      for (adj = *bgp_adj_index_bucket (rn->adj_in_index, peer); adj;
+	   adj = adj->hash_next)
+	if (adj->peer == peer)
+	  break;
+      return adj;
+    }
+
+  for (adj = rn->adj_in; adj; adj = adj->next)
+    if (adj->peer == peer)
+      break;
+  return adj;
+}
+
 /* BGP adjacency keeps minimal advertisement information.  */
 static void
 bgp_adj_out_free (struct bgp_adj_out *adj)
 {
+  BGP_PEER_INDEX_DEL (adj);
+  adj->peer->mem_adj_out -= sizeof (struct bgp_adj_out);
   peer_unlock (adj->peer); /* adj_out peer reference */
   XFREE (MTYPE_BGP_ADJ_OUT, adj);
 }
 
+/* Whether the peer has been advertised the route, or has it queued. */
+static inline int
+bgp_adj_out_advertised (struct bgp_adj_out *adj)
+{
+  return (adj->adv
+	  ? (adj->adv->baa ? 1 : 0)
+	  : (adj->attr ? 1 : 0));
+}
+
 int
 bgp_adj_out_lookup (struct peer *peer, struct prefix *p,
 		    afi_t afi, safi_t safi, struct bgp_node *rn)
 {
   struct bgp_adj_out *adj;
 
+  if (rn->adj_out_index)
+    {
+      for (adj = *bgp_adj_index_bucket (rn->adj_out_index, peer); adj;
+	   adj = adj->hash_next)
+	if (adj->peer == peer && bgp_adj_out_advertised (adj))
+	  return 1;
+      return 0;
+    }
+
   for (adj = rn->adj_out; adj; adj = adj->next)
-    if (adj->peer == peer)
-      break;
+    if (adj->peer == peer && bgp_adj_out_advertised (adj))
+      return 1;
 
-  if (! adj)
-    return 0;
+  return 0;
+}
 
-  return (adj->adv 
-	  ? (adj->adv->baa ? 1 : 0)
-	  : (adj->attr ? 1 : 0));
+/* Adjacency of the path with the given identifier to the peer. */
+struct bgp_adj_out *
+bgp_adj_out_get (struct bgp_node *rn, struct peer *peer,
+		 u_int32_t addpath_tx_id)
+{
+  struct bgp_adj_out *adj;
+
+  if (rn->adj_out_index)
+    {
+      for (adj = *bgp_adj_index_bucket (rn->adj_out_index, peer); adj;
+	   adj = adj->hash_next)
+	if (adj->peer == peer && adj->addpath_tx_id == addpath_tx_id)
+	  break;
+      return adj;
+    }
+
+  for (adj = rn->adj_out; adj; adj = adj->next)
+    if (adj->peer == peer && adj->addpath_tx_id == addpath_tx_id)
+      break;
+
+  return adj;
 }
 
 struct bgp_advertise *
@@ -208,10 +451,25 @@ bgp_advertise_clean (struct peer *peer, struct bgp_adj_out *adj,
   /* Free memory.  */
   bgp_advertise_free (adj->adv);
   adj->adv = NULL;
+  peer->mem_adv -= sizeof (struct bgp_advertise);
 
   return next;
 }
 
+/* Is attr what was last advertised to the peer for adj? */
+static int
+bgp_adj_out_attr_same (struct bgp_adj_out *adj, struct attr *attr)
+{
+  struct attr *interned;
+  int same;
+
+  interned = bgp_attr_intern (attr);
+  same = (interned == adj->attr);
+  bgp_attr_unintern (&interned);
+
+  return same;
+}
+
 void
 bgp_adj_out_set (struct bgp_node *rn, struct peer *peer, struct prefix *p,
 		 struct attr *attr, afi_t afi, safi_t safi,
@@ -219,34 +477,53 @@ bgp_adj_out_set (struct bgp_node *rn, struct peer *peer, struct prefix *p,
 {
   struct bgp_adj_out *adj = NULL;
   struct bgp_advertise *adv;
+  u_int32_t addpath_tx_id = 0;
 
   if (DISABLE_BGP_ANNOUNCE)
     return;
 
+  if (binfo && PEER_ADDPATH_TX (peer, afi, safi))
+    addpath_tx_id = binfo->addpath_tx_id;
+
   /* Look for adjacency information. */
   if (rn)
-    {
-      for (adj = rn->adj_out; adj; adj = adj->next)
-	if (adj->peer == peer)
-	  break;
-    }
+    adj = bgp_adj_out_get (rn, peer, addpath_tx_id);
 
   if (! adj)
     {
       adj = XCALLOC (MTYPE_BGP_ADJ_OUT, sizeof (struct bgp_adj_out));
       adj->peer = peer_lock (peer); /* adj_out peer reference */
+      peer->mem_adj_out += sizeof (struct bgp_adj_out);
+      adj->addpath_tx_id = addpath_tx_id;
       
       if (rn)
         {
-          BGP_ADJ_OUT_ADD (rn, adj);
+          bgp_adj_out_link (rn, adj);
           bgp_lock_node (rn);
+          adj->rn = rn;
+          BGP_PEER_INDEX_ADD (&peer->adj_out[afi][safi], adj);
         }
     }
 
+  /* A change still queued is replaced by this one.  If this one takes
+     the route back to what the peer was last sent, nothing need be sent
+     at all.  Towards IBGP peers the encoding also depends on the peer
+     the route came from, which the adjacency does not record.  */
   if (adj->adv)
-    bgp_advertise_clean (peer, adj, afi, safi);
+    {
+      bgp_advertise_clean (peer, adj, afi, safi);
+
+      if (attr && adj->attr && peer->sort != BGP_PEER_IBGP
+	  && bgp_adj_out_attr_same (adj, attr))
+	{
+	  peer->adv_cancelled++;
+	  return;
+	}
+      peer->adv_replaced++;
+    }
   
   adj->adv = bgp_advertise_new ();
+  peer->mem_adv += sizeof (struct bgp_advertise);
 
   adv = adj->adv;
   adv->rn = rn;
@@ -268,7 +545,7 @@ bgp_adj_out_set (struct bgp_node *rn, struct peer *peer, struct prefix *p,
 
 void
 bgp_adj_out_unset (struct bgp_node *rn, struct peer *peer, struct prefix *p, 
-		   afi_t afi, safi_t safi)
+		   afi_t afi, safi_t safi, u_int32_t addpath_tx_id)
 {
   struct bgp_adj_out *adj;
   struct bgp_advertise *adv;
@@ -277,21 +554,27 @@ bgp_adj_out_unset (struct bgp_node *rn, struct peer *peer, struct prefix *p,
     return;
 
   /* Lookup existing adjacency, if it is not there return immediately.  */
-  for (adj = rn->adj_out; adj; adj = adj->next)
-    if (adj->peer == peer)
-      break;
+  adj = bgp_adj_out_get (rn, peer, addpath_tx_id);
 
   if (! adj)
     return;
 
-  /* Clearn up previous advertisement.  */
+  /* Clearn up previous advertisement.  An announcement the peer never
+     got is cancelled by the withdrawal altogether.  */
   if (adj->adv)
-    bgp_advertise_clean (peer, adj, afi, safi);
+    {
+      bgp_advertise_clean (peer, adj, afi, safi);
+      if (adj->attr)
+	peer->adv_replaced++;
+      else
+	peer->adv_cancelled++;
+    }
 
   if (adj->attr)
     {
       /* We need advertisement structure.  */
       adj->adv = bgp_advertise_new ();
+      peer->mem_adv += sizeof (struct bgp_advertise);
       adv = adj->adv;
       adv->rn = rn;
       adv->adj = adj;
@@ -305,7 +588,7 @@ bgp_adj_out_unset (struct bgp_node *rn, struct peer *peer, struct prefix *p,
   else
     {
       /* Remove myself from adjacency. */
-      BGP_ADJ_OUT_DEL (rn, adj);
+      bgp_adj_out_unlink (rn, adj);
       
       /* Free allocated information.  */
       bgp_adj_out_free (adj);
@@ -324,7 +607,7 @@ bgp_adj_out_remove (struct bgp_node *rn, struct bgp_adj_out *adj,
   if (adj->adv)
     bgp_advertise_clean (peer, adj, afi, safi);
 
-  BGP_ADJ_OUT_DEL (rn, adj);
+  bgp_adj_out_unlink (rn, adj);
   bgp_adj_out_free (adj);
 }
 
@@ -332,31 +615,35 @@ void
 bgp_adj_in_set (struct bgp_node *rn, struct peer *peer, struct attr *attr)
 {
   struct bgp_adj_in *adj;
+  struct bgp_table *table;
 
-  for (adj = rn->adj_in; adj; adj = adj->next)
+  if ((adj = bgp_adj_in_get (rn, peer)) != NULL)
     {
-      if (adj->peer == peer)
+      if (adj->attr != attr)
 	{
-	  if (adj->attr != attr)
-	    {
-	      bgp_attr_unintern (&adj->attr);
-	      adj->attr = bgp_attr_intern (attr);
-	    }
-	  return;
+	  bgp_attr_unintern (&adj->attr);
+	  adj->attr = bgp_attr_intern (attr);
 	}
+      return;
     }
   adj = XCALLOC (MTYPE_BGP_ADJ_IN, sizeof (struct bgp_adj_in));
   adj->peer = peer_lock (peer); /* adj_in peer reference */
+  peer->mem_adj_in += sizeof (struct bgp_adj_in);
   adj->attr = bgp_attr_intern (attr);
-  BGP_ADJ_IN_ADD (rn, adj);
+  bgp_adj_in_link (rn, adj);
   bgp_lock_node (rn);
+  adj->rn = rn;
+  table = bgp_node_table (rn);
+  BGP_PEER_INDEX_ADD (&peer->adj_in[table->afi][table->safi], adj);
 }
 
 void
 bgp_adj_in_remove (struct bgp_node *rn, struct bgp_adj_in *bai)
 {
   bgp_attr_unintern (&bai->attr);
-  BGP_ADJ_IN_DEL (rn, bai);
+  bgp_adj_in_unlink (rn, bai);
+  BGP_PEER_INDEX_DEL (bai);
+  bai->peer->mem_adj_in -= sizeof (struct bgp_adj_in);
   peer_unlock (bai->peer); /* adj_in peer reference */
   XFREE (MTYPE_BGP_ADJ_IN, bai);
 }
@@ -365,16 +652,69 @@ void
 bgp_adj_in_unset (struct bgp_node *rn, struct peer *peer)
 {
   struct bgp_adj_in *adj;
+  struct bgp_info *ri;
 
-  for (adj = rn->adj_in; adj; adj = adj->next)
-    if (adj->peer == peer)
-      break;
+  for (ri = rn->info; ri; ri = ri->next)
+    if (ri->peer == peer)
+      UNSET_FLAG (ri->flags, BGP_INFO_ADJ_IN);
 
-  if (! adj)
+  if ((adj = bgp_adj_in_get (rn, peer)) == NULL)
+    return;
+
+  bgp_adj_in_remove (rn, adj);
+  bgp_unlock_node (rn);
+}
+
+/* Most routes are accepted with the attributes they were received
+   with, so keeping them in Adj-RIB-In as well only doubles the state
+   held per prefix and peer.  When the peer's route in the RIB carries
+   the very attributes received, drop its bgp_adj_in and mark the route
+   as standing for it instead. */
+void
+bgp_adj_in_share (struct bgp_node *rn, struct bgp_info *ri)
+{
+  struct bgp_adj_in *adj;
+
+  adj = bgp_adj_in_get (rn, ri->peer);
+  if (! adj || adj->attr != ri->attr)
     return;
 
   bgp_adj_in_remove (rn, adj);
   bgp_unlock_node (rn);
+  SET_FLAG (ri->flags, BGP_INFO_ADJ_IN);
+}
+
+/* The peer's route is about to change: give its received attributes
+   a bgp_adj_in of their own again. */
+void
+bgp_adj_in_unshare (struct bgp_node *rn, struct peer *peer)
+{
+  struct bgp_info *ri;
+
+  for (ri = rn->info; ri; ri = ri->next)
+    if (ri->peer == peer && CHECK_FLAG (ri->flags, BGP_INFO_ADJ_IN))
+      {
+	UNSET_FLAG (ri->flags, BGP_INFO_ADJ_IN);
+	bgp_adj_in_set (rn, peer, ri->attr);
+	return;
+      }
+}
+
+/* Attributes last received from the peer for the node, if kept. */
+struct attr *
+bgp_adj_in_attr (struct bgp_node *rn, const struct peer *peer)
+{
+  struct bgp_adj_in *adj;
+  struct bgp_info *ri;
+
+  if ((adj = bgp_adj_in_get (rn, peer)) != NULL)
+    return adj->attr;
+
+  for (ri = rn->info; ri; ri = ri->next)
+    if (ri->peer == peer && CHECK_FLAG (ri->flags, BGP_INFO_ADJ_IN))
+      return ri->attr;
+
+  return NULL;
 }
 
 void
@@ -393,7 +733,8 @@ bgp_sync_init (struct peer *peer)
 	FIFO_INIT (&sync->withdraw);
 	FIFO_INIT (&sync->withdraw_low);
 	peer->sync[afi][safi] = sync;
-	peer->hash[afi][safi] = hash_create (baa_hash_key, baa_hash_cmp);
+	peer->hash[afi][safi] = hash_create_open (0, baa_hash_key,
+						  baa_hash_cmp);
       }
 }
 
@@ -61,6 +61,9 @@ struct bgp_advertise
 
   /* BGP info.  */
   struct bgp_info *binfo;
+
+  /* When it was queued, for latency accounting.  */
+  unsigned long long queued;
 };
 
 /* BGP adjacency out.  */
@@ -73,11 +76,24 @@ struct bgp_adj_out
   /* Advertised peer.  */
   struct peer *peer;
 
+  /* Next adjacency in the same bucket of the node's index.  */
+  void *hash_next;
+
+  /* Path identifier the route is advertised under, 0 unless the peer
+     takes ADD-PATH.  */
+  u_int32_t addpath_tx_id;
+
   /* Advertised attribute.  */
   struct attr *attr;
 
   /* Advertisement information.  */
   struct bgp_advertise *adv;
+
+  /* Node the adjacency hangs off, and the peer's other adjacencies in
+     the address family. */
+  struct bgp_node *rn;
+  struct bgp_adj_out *peer_next;
+  struct bgp_adj_out **peer_prev;
 };
 
 /* BGP adjacency in. */
@@ -90,8 +106,30 @@ struct bgp_adj_in
   /* Received peer.  */
   struct peer *peer;
 
+  /* Next adjacency in the same bucket of the node's index.  */
+  void *hash_next;
+
   /* Received attribute.  */
   struct attr *attr;
+
+  /* Node the adjacency hangs off, and the peer's other adjacencies in
+     the address family. */
+  struct bgp_node *rn;
+  struct bgp_adj_in *peer_next;
+  struct bgp_adj_in **peer_prev;
+};
+
+/* Index of a node's adjacencies by peer, kept once a node has more
+   than BGP_ADJ_INDEX_MIN of them, so that a route server with hundreds
+   of clients does not scan them all for each one.  The buckets chain
+   through hash_next.  */
+#define BGP_ADJ_INDEX_MIN	16
+
+struct bgp_adj_index
+{
+  unsigned int count;
+  unsigned int size;		/* a power of two */
+  void **bucket;
 };
 
 /* BGP advertisement list.  */
@@ -122,6 +160,30 @@ struct bgp_synchronize
       (N)->TYPE = (A)->next;                          \
   } while (0)
 
+/* The per-peer lists of paths and adjacencies, see bgp_clear_route().
+   The back pointer points at whatever points at the entry, so entries
+   leave a list without knowing its head. */
+#define BGP_PEER_INDEX_ADD(H,A)                       \
+  do {                                                \
+    (A)->peer_next = *(H);                            \
+    if (*(H))                                         \
+      (*(H))->peer_prev = &(A)->peer_next;            \
+    (A)->peer_prev = (H);                             \
+    *(H) = (A);                                       \
+  } while (0)
+
+#define BGP_PEER_INDEX_DEL(A)                         \
+  do {                                                \
+    if ((A)->peer_prev)                               \
+      {                                               \
+        *(A)->peer_prev = (A)->peer_next;             \
+        if ((A)->peer_next)                           \
+          (A)->peer_next->peer_prev = (A)->peer_prev; \
+        (A)->peer_next = NULL;                        \
+        (A)->peer_prev = NULL;                        \
+      }                                               \
+  } while (0)
+
 #define BGP_ADJ_IN_ADD(N,A)    BGP_INFO_ADD(N,A,adj_in)
 #define BGP_ADJ_IN_DEL(N,A)    BGP_INFO_DEL(N,A,adj_in)
 #define BGP_ADJ_OUT_ADD(N,A)   BGP_INFO_ADD(N,A,adj_out)
@@ -131,7 +193,9 @@ struct bgp_synchronize
 extern void bgp_adj_out_set (struct bgp_node *, struct peer *, struct prefix *,
 		      struct attr *, afi_t, safi_t, struct bgp_info *);
 extern void bgp_adj_out_unset (struct bgp_node *, struct peer *, struct prefix *,
-			afi_t, safi_t);
+			afi_t, safi_t, u_int32_t);
+extern struct bgp_adj_out *bgp_adj_out_get (struct bgp_node *, struct peer *,
+					    u_int32_t);
 extern void bgp_adj_out_remove (struct bgp_node *, struct bgp_adj_out *, 
 			 struct peer *, afi_t, safi_t);
 extern int bgp_adj_out_lookup (struct peer *, struct prefix *, afi_t, safi_t,
@@ -140,6 +204,10 @@ extern int bgp_adj_out_lookup (struct peer *, struct prefix *, afi_t, safi_t,
 extern void bgp_adj_in_set (struct bgp_node *, struct peer *, struct attr *);
 extern void bgp_adj_in_unset (struct bgp_node *, struct peer *);
 extern void bgp_adj_in_remove (struct bgp_node *, struct bgp_adj_in *);
+extern void bgp_adj_in_share (struct bgp_node *, struct bgp_info *);
+extern void bgp_adj_in_unshare (struct bgp_node *, struct peer *);
+extern struct attr *bgp_adj_in_attr (struct bgp_node *,
+                                     const struct peer *);
 
 extern struct bgp_advertise *
 bgp_advertise_clean (struct peer *, struct bgp_adj_out *, afi_t, safi_t);
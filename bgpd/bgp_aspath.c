@@ -88,6 +88,9 @@ struct assegment_header
 /* Hash for aspath.  This is the top level structure of AS path. */
 static struct hash *ashash;
 
+/* Last serial number handed out to an interned path. */
+static u_int32_t aspath_serial;
+
 /* Stream for SNMP. See aspath_snmp_pathseg */
 static struct stream *snmp_stream;
 
@@ -321,7 +324,12 @@ aspath_free (struct aspath *aspath)
 {
   if (!aspath)
     return;
-  if (aspath->segments)
+  if (aspath->compact)
+    {
+      if (aspath->segments)
+	XFREE (MTYPE_AS_SEG, aspath->segments);
+    }
+  else if (aspath->segments)
     assegment_free_all (aspath->segments);
   if (aspath->str)
     XFREE (MTYPE_AS_STR, aspath->str);
@@ -406,6 +414,9 @@ aspath_count_confeds (struct aspath *aspath)
   int count = 0;
   struct assegment *seg = aspath->segments;
   
+  if (aspath->compact)
+    return aspath->confeds;
+
   while (seg)
     {
       if (seg->type == AS_CONFED_SEQUENCE)
@@ -424,6 +435,9 @@ aspath_count_hops (struct aspath *aspath)
   int count = 0;
   struct assegment *seg = aspath->segments;
   
+  if (aspath->compact)
+    return aspath->hops;
+
   while (seg)
     {
       if (seg->type == AS_SEQUENCE)
@@ -600,12 +614,63 @@ aspath_make_str_count (struct aspath *as)
   return;
 }
 
+/* The segments changed, the string is made again when next needed. */
 static void
 aspath_str_update (struct aspath *as)
 {
   if (as->str)
     XFREE (MTYPE_AS_STR, as->str);
-  aspath_make_str_count (as);
+  as->str = NULL;
+  as->str_len = 0;
+}
+
+/* Interned paths are never modified again, so their segments can be
+   copied into a single allocation, the ASNs of all segments following
+   each other, and the counts asked for on every best path run worked
+   out once. */
+static void
+aspath_compact (struct aspath *aspath)
+{
+  struct assegment *seg;
+  struct assegment *block;
+  struct assegment *new;
+  unsigned int nsegs = 0;
+  as_t *as;
+
+  assert (! aspath->compact);
+
+  aspath->hops = aspath_count_hops (aspath);
+  aspath->confeds = aspath_count_confeds (aspath);
+  aspath->count = assegment_count_asns (aspath->segments, 0);
+  aspath->asns = NULL;
+  aspath->compact = 1;
+  if (++aspath_serial == 0)
+    aspath_serial++;
+  aspath->serial = aspath_serial;
+
+  for (seg = aspath->segments; seg; seg = seg->next)
+    nsegs++;
+  if (! nsegs)
+    return;
+
+  block = new = XMALLOC (MTYPE_AS_SEG,
+			 nsegs * sizeof (struct assegment)
+			 + ASSEGMENT_DATA_SIZE (aspath->count, 1));
+  as = aspath->asns = (as_t *) (block + nsegs);
+
+  for (seg = aspath->segments; seg; seg = seg->next)
+    {
+      new->type = seg->type;
+      new->length = seg->length;
+      new->as = as;
+      new->next = seg->next ? new + 1 : NULL;
+      memcpy (as, seg->as, ASSEGMENT_DATA_SIZE (seg->length, 1));
+      as += seg->length;
+      new++;
+    }
+
+  assegment_free_all (aspath->segments);
+  aspath->segments = block;
 }
 
 /* Intern allocated AS path. */
@@ -614,15 +679,15 @@ aspath_intern (struct aspath *aspath)
 {
   struct aspath *find;
 
-  /* Assert this AS path structure is not interned and has the string
-     representation built. */
+  /* Assert this AS path structure is not interned. */
   assert (aspath->refcnt == 0);
-  assert (aspath->str);
 
   /* Check AS path hash. */
   find = hash_get (ashash, aspath, hash_alloc_intern);
   if (find != aspath)
     aspath_free (aspath);
+  else if (! find->compact)
+    aspath_compact (find);
 
   find->refcnt++;
 
@@ -663,11 +728,6 @@ aspath_hash_alloc (void *arg)
   const struct aspath *aspath = arg;
   struct aspath *new;
 
-  /* Malformed AS path value. */
-  assert (aspath->str);
-  if (! aspath->str)
-    return NULL;
-
   /* New aspath structure is needed. */
   new = XMALLOC (MTYPE_AS_PATH, sizeof (struct aspath));
 
@@ -676,6 +736,9 @@ aspath_hash_alloc (void *arg)
   new->segments = aspath->segments;
   new->str = aspath->str;
   new->str_len = aspath->str_len;
+  new->str_used = 0;
+  new->compact = 0;
+  aspath_compact (new);
 
   return new;
 }
@@ -812,8 +875,8 @@ aspath_parse (struct stream *s, size_t length, int use32bit)
   if (find->refcnt)
     {
       assegment_free_all (as.segments);
-      /* aspath_key_make() always updates the string */
-      XFREE (MTYPE_AS_STR, as.str);
+      if (as.str)
+	XFREE (MTYPE_AS_STR, as.str);
     }
 
   find->refcnt++;
@@ -1105,6 +1168,16 @@ aspath_loop_check (struct aspath *aspath, as_t asno)
   if ( (aspath == NULL) || (aspath->segments == NULL) )
     return 0;
   
+  if (aspath->compact)
+    {
+      unsigned int i;
+
+      for (i = 0; i < aspath->count; i++)
+	if (aspath->asns[i] == asno)
+	  count++;
+      return count;
+    }
+
   seg = aspath->segments;
   
   while (seg)
@@ -1438,6 +1511,52 @@ aspath_cmp_left (const struct aspath *aspath1, const struct aspath *aspath2)
   return 0;
 }
 
+/* The AS aspath_cmp_left() looks at: the first one of the first
+   non-confed segment, if that is an AS_SEQUENCE.  Return 0 if there is
+   none. */
+int
+aspath_left_as (const struct aspath *aspath, as_t *as)
+{
+  const struct assegment *seg;
+
+  if (! aspath)
+    return 0;
+
+  for (seg = aspath->segments; seg; seg = seg->next)
+    if (seg->type != AS_CONFED_SEQUENCE && seg->type != AS_CONFED_SET)
+      break;
+
+  if (! seg || seg->type != AS_SEQUENCE)
+    return 0;
+
+  *as = seg->as[0];
+  return 1;
+}
+
+/* The origin AS of RFC 6811: the last AS of the last non-confed
+   segment, if that is an AS_SEQUENCE.  Return 1 with it in *as, 0 if
+   there is no such segment, the route being from within the
+   confederation, or -1 if the path ends in a set. */
+int
+aspath_origin_as (const struct aspath *aspath, as_t *as)
+{
+  const struct assegment *seg;
+  const struct assegment *last = NULL;
+
+  if (aspath)
+    for (seg = aspath->segments; seg; seg = seg->next)
+      if (seg->type != AS_CONFED_SEQUENCE && seg->type != AS_CONFED_SET)
+	last = seg;
+
+  if (! last)
+    return 0;
+  if (last->type != AS_SEQUENCE || ! last->length)
+    return -1;
+
+  *as = last->as[last->length - 1];
+  return 1;
+}
+
 /* Truncate an aspath after a number of hops, and put the hops remaining
  * at the front of another aspath.  Needed for AS4 compat.
  *
@@ -1476,7 +1595,7 @@ aspath_reconcile_as4 ( struct aspath *aspath, struct aspath *as4path)
   
   if ( BGP_DEBUG(as4, AS4))
     zlog_debug("[AS4] got AS_PATH %s and AS4_PATH %s synthesizing now",
-               aspath->str, as4path->str);
+               aspath_print (aspath), aspath_print (as4path));
 
   while (seg && hops > 0)
     {
@@ -1535,7 +1654,7 @@ aspath_reconcile_as4 ( struct aspath *aspath, struct aspath *as4path)
   
   if ( BGP_DEBUG(as4, AS4))
     zlog_debug ("[AS4] result of synthesizing is %s",
-                mergedpath->str);
+                aspath_print (mergedpath));
   
   return mergedpath;
 }
@@ -1562,6 +1681,18 @@ aspath_cmp_left_confed (const struct aspath *aspath1, const struct aspath *aspat
   return 0;
 }
 
+/* And the one aspath_cmp_left_confed() looks at. */
+int
+aspath_left_confed_as (const struct aspath *aspath, as_t *as)
+{
+  if (! (aspath && aspath->segments)
+      || aspath->segments->type != AS_CONFED_SEQUENCE)
+    return 0;
+
+  *as = aspath->segments->as[0];
+  return 1;
+}
+
 /* Delete all leading AS_CONFED_SEQUENCE/SET segments from aspath.
  * See RFC3065, 6.1 c1 */
 struct aspath *
@@ -1648,7 +1779,6 @@ aspath_empty_get (void)
   struct aspath *aspath;
 
   aspath = aspath_new ();
-  aspath_make_str_count (aspath);
   return aspath;
 }
 
@@ -1657,6 +1787,12 @@ aspath_count (void)
 {
   return ashash->count;
 }     
+
+struct hash *
+aspath_hash (void)
+{
+  return ashash;
+}
 
 /* 
    Theoretically, one as path can have:
@@ -1807,8 +1943,6 @@ aspath_str2aspath (const char *str)
 	}
     }
 
-  aspath_make_str_count (aspath);
-
   return aspath;
 }
 
@@ -1817,12 +1951,14 @@ unsigned int
 aspath_key_make (void *p)
 {
   struct aspath *aspath = (struct aspath *) p;
-  unsigned int key = 0;
-
-  if (!aspath->str)
-    aspath_str_update (aspath);
+  struct assegment *seg;
+  unsigned int key = 2334325;
 
-  key = jhash (aspath->str, aspath->str_len, 2334325);
+  for (seg = aspath->segments; seg; seg = seg->next)
+    {
+      key = jhash_2words (seg->type, seg->length, key);
+      key = jhash2 (seg->as, seg->length, key);
+    }
 
   return key;
 }
@@ -1834,6 +1970,11 @@ aspath_cmp (const void *arg1, const void *arg2)
   const struct assegment *seg1 = ((const struct aspath *)arg1)->segments;
   const struct assegment *seg2 = ((const struct aspath *)arg2)->segments;
   
+  /* There is only one interned copy of each path. */
+  if (((const struct aspath *)arg1)->compact
+      && ((const struct aspath *)arg2)->compact)
+    return arg1 == arg2;
+
   while (seg1 || seg2)
     {
       int i;
@@ -1856,7 +1997,8 @@ aspath_cmp (const void *arg1, const void *arg2)
 void
 aspath_init (void)
 {
-  ashash = hash_create_size (32768, aspath_key_make, aspath_cmp);
+  ashash = hash_create_open (32768, aspath_key_make, aspath_cmp);
+  hash_set_name (ashash, "BGP AS paths");
 }
 
 void
@@ -1873,7 +2015,13 @@ aspath_finish (void)
 const char *
 aspath_print (struct aspath *as)
 {
-  return (as ? as->str : NULL);
+  if (! as)
+    return NULL;
+
+  if (! as->str)
+    aspath_make_str_count (as);
+  as->str_used = 1;
+  return as->str;
 }
 
 /* Printing functions */
@@ -1884,7 +2032,7 @@ void
 aspath_print_vty (struct vty *vty, const char *format, struct aspath *as, const char * suffix)
 {
   assert (format);
-  vty_out (vty, format, as->str);
+  vty_out (vty, format, aspath_print (as));
   if (as->str_len && strlen (suffix))
     vty_out (vty, "%s", suffix);
 }
@@ -1897,7 +2045,7 @@ aspath_show_all_iterator (struct hash_backet *backet, struct vty *vty)
   as = (struct aspath *) backet->data;
 
   vty_out (vty, "[%p:%u] (%ld) ", backet, backet->key, as->refcnt);
-  vty_out (vty, "%s%s", as->str, VTY_NEWLINE);
+  vty_out (vty, "%s%s", aspath_print (as), VTY_NEWLINE);
 }
 
 /* Print all aspath and hash information.  This function is used from
@@ -1910,3 +2058,22 @@ aspath_print_all_vty (struct vty *vty)
 		aspath_show_all_iterator,
 		vty);
 }
+
+static void
+aspath_str_sweep_iterator (struct hash_backet *backet, void *arg)
+{
+  struct aspath *as = backet->data;
+
+  if (as->str && ! as->str_used)
+    aspath_str_update (as);
+  as->str_used = 0;
+}
+
+/* Release the strings of interned paths which were not asked for since
+   the last sweep; most paths are never shown nor matched against a
+   regular expression, and their strings add up on a large table. */
+void
+aspath_str_sweep (void)
+{
+  hash_iterate (ashash, aspath_str_sweep_iterator, NULL);
+}
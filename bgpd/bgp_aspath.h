@@ -56,9 +56,25 @@ struct aspath
   struct assegment *segments;
   
   /* String expression of AS path.  This string is used by vty output
-     and AS path regular expression match.  */
+     and AS path regular expression match.  It is only made when first
+     asked for, use aspath_print(), and dropped from interned paths
+     again by aspath_str_sweep() when no longer used.  */
   char *str;
   unsigned short str_len;
+  u_char str_used;
+
+  /* Tells interned paths apart from earlier ones at the same address,
+     for caches keyed by interned path. */
+  u_int32_t serial;
+
+  /* Set once interned, see aspath_compact(): the segments and their
+     ASNs then sit in one allocation, all the ASNs in order from asns
+     on, and the counts below are valid. */
+  u_char compact;
+  as_t *asns;
+  unsigned int count;
+  unsigned int hops;
+  unsigned int confeds;
 };
 
 #define ASPATH_STR_DEFAULT_LEN 32
@@ -76,6 +92,9 @@ extern struct aspath *aspath_add_confed_seq (struct aspath *, as_t);
 extern int aspath_cmp (const void *, const void *);
 extern int aspath_cmp_left (const struct aspath *, const struct aspath *);
 extern int aspath_cmp_left_confed (const struct aspath *, const struct aspath *);
+extern int aspath_left_as (const struct aspath *, as_t *);
+extern int aspath_left_confed_as (const struct aspath *, as_t *);
+extern int aspath_origin_as (const struct aspath *, as_t *);
 extern struct aspath *aspath_delete_confed_seq (struct aspath *);
 extern struct aspath *aspath_empty (void);
 extern struct aspath *aspath_empty_get (void);
@@ -86,6 +105,7 @@ extern void aspath_unintern (struct aspath **);
 extern const char *aspath_print (struct aspath *);
 extern void aspath_print_vty (struct vty *, const char *, struct aspath *, const char *);
 extern void aspath_print_all_vty (struct vty *);
+extern void aspath_str_sweep (void);
 extern unsigned int aspath_key_make (void *);
 extern int aspath_loop_check (struct aspath *, as_t);
 extern int aspath_private_as_check (struct aspath *);
@@ -93,6 +113,7 @@ extern int aspath_firstas_check (struct aspath *, as_t);
 extern int aspath_confed_check (struct aspath *);
 extern int aspath_left_confed_check (struct aspath *);
 extern unsigned long aspath_count (void);
+extern struct hash *aspath_hash (void);
 extern unsigned int aspath_count_hops (struct aspath *);
 extern unsigned int aspath_count_confeds (struct aspath *);
 extern unsigned int aspath_size (struct aspath *);
@@ -82,16 +82,12 @@ cluster_hash_alloc (void *p)
   struct cluster_list * val = (struct cluster_list *) p;
   struct cluster_list *cluster;
 
-  cluster = XMALLOC (MTYPE_CLUSTER, sizeof (struct cluster_list));
+  /* The list goes along, a single allocation. */
+  cluster = XMALLOC (MTYPE_CLUSTER, sizeof (struct cluster_list)
+				    + val->length);
   cluster->length = val->length;
-
-  if (cluster->length)
-    {
-      cluster->list = XMALLOC (MTYPE_CLUSTER_VAL, val->length);
-      memcpy (cluster->list, val->list, val->length);
-    }
-  else
-    cluster->list = NULL;
+  cluster->list = cluster->data;
+  memcpy (cluster->data, val->list, val->length);
 
   cluster->refcnt = 0;
 
@@ -99,7 +95,7 @@ cluster_hash_alloc (void *p)
 }
 
 /* Cluster list related functions. */
-static struct cluster_list *
+struct cluster_list *
 cluster_parse (struct in_addr * pnt, int length)
 {
   struct cluster_list tmp;
@@ -145,8 +141,6 @@ cluster_hash_cmp (const void *p1, const void *p2)
 static void
 cluster_free (struct cluster_list *cluster)
 {
-  if (cluster->list)
-    XFREE (MTYPE_CLUSTER_VAL, cluster->list);
   XFREE (MTYPE_CLUSTER, cluster);
 }
 
@@ -198,7 +192,9 @@ cluster_unintern (struct cluster_list *cluster)
 static void
 cluster_init (void)
 {
-  cluster_hash = hash_create (cluster_hash_key_make, cluster_hash_cmp);
+  cluster_hash = hash_create_open (0, cluster_hash_key_make,
+				   cluster_hash_cmp);
+  hash_set_name (cluster_hash, "BGP cluster lists");
 }
 
 static void
@@ -275,6 +271,7 @@ static void
 transit_init (void)
 {
   transit_hash = hash_create (transit_hash_key_make, transit_hash_cmp);
+  hash_set_name (transit_hash, "BGP unknown transitives");
 }
 
 static void
@@ -287,6 +284,10 @@ transit_finish (void)
 /* Attribute hash routines. */
 static struct hash *attrhash;
 
+/* See bgp_packet_attribute(). */
+static unsigned long bgp_attr_encode_hits;
+static unsigned long bgp_attr_encode_misses;
+
 static struct attr_extra *
 bgp_attr_extra_new (void)
 {
@@ -355,54 +356,85 @@ attr_unknown_count (void)
   return transit_hash->count;
 }
 
+/* The fields attrhash_cmp() compares, packed.  Interned attributes are
+ * compared by pointer, so their pointer is all that needs hashing, not
+ * their contents: this is what keeps interning cheap for an UPDATE with
+ * a long AS path or many communities.
+ */
+struct attrhash_sig
+{
+  uintptr_t aspath;
+  uintptr_t community;
+  uintptr_t ecommunity;
+  uintptr_t cluster;
+  uintptr_t transit;
+  u_int32_t flag;
+  u_int32_t origin;		/* and whether there is extra */
+  u_int32_t nexthop;
+  u_int32_t med;
+  u_int32_t local_pref;
+  u_int32_t aggregator_as;
+  u_int32_t aggregator_addr;
+  u_int32_t weight;
+  u_int32_t mp_nexthop_global_in;
+#ifdef HAVE_IPV6
+  u_int32_t mp_nexthop_len;
+  struct in6_addr mp_nexthop_global;
+  struct in6_addr mp_nexthop_local;
+#endif /* HAVE_IPV6 */
+};
+
+#define ATTRHASH_SIG_WORDS \
+  ((sizeof (struct attrhash_sig) + sizeof (u_int64_t) - 1) / sizeof (u_int64_t))
+
 unsigned int
 attrhash_key_make (void *p)
 {
   const struct attr *attr = (struct attr *) p;
   const struct attr_extra *extra = attr->extra;
-  uint32_t key = 0;
-#define MIX(val)	key = jhash_1word(val, key)
-
-  MIX(attr->origin);
-  MIX(attr->nexthop.s_addr);
-  MIX(attr->med);
-  MIX(attr->local_pref);
+  union
+  {
+    struct attrhash_sig sig;
+    u_int64_t w[ATTRHASH_SIG_WORDS];
+  } u;
+  struct attrhash_sig *sig = &u.sig;
+  u_int64_t h = 0;
+  unsigned int i;
+
+  memset (&u, 0, sizeof (u));
+  sig->aspath = (uintptr_t) attr->aspath;
+  sig->community = (uintptr_t) attr->community;
+  sig->flag = attr->flag;
+  sig->origin = attr->origin;
+  sig->nexthop = attr->nexthop.s_addr;
+  sig->med = attr->med;
+  sig->local_pref = attr->local_pref;
 
-  key += attr->origin;
-  key += attr->nexthop.s_addr;
-  key += attr->med;
-  key += attr->local_pref;
-  
   if (extra)
     {
-      MIX(extra->aggregator_as);
-      MIX(extra->aggregator_addr.s_addr);
-      MIX(extra->weight);
-      MIX(extra->mp_nexthop_global_in.s_addr);
-    }
-  
-  if (attr->aspath)
-    MIX(aspath_key_make (attr->aspath));
-  if (attr->community)
-    MIX(community_hash_make (attr->community));
-  
-  if (extra)
-    {
-      if (extra->ecommunity)
-        MIX(ecommunity_hash_make (extra->ecommunity));
-      if (extra->cluster)
-        MIX(cluster_hash_key_make (extra->cluster));
-      if (extra->transit)
-        MIX(transit_hash_key_make (extra->transit));
-
+      sig->origin |= 1 << 8;
+      sig->ecommunity = (uintptr_t) extra->ecommunity;
+      sig->cluster = (uintptr_t) extra->cluster;
+      sig->transit = (uintptr_t) extra->transit;
+      sig->aggregator_as = extra->aggregator_as;
+      sig->aggregator_addr = extra->aggregator_addr.s_addr;
+      sig->weight = extra->weight;
+      sig->mp_nexthop_global_in = extra->mp_nexthop_global_in.s_addr;
 #ifdef HAVE_IPV6
-      MIX(extra->mp_nexthop_len);
-      key = jhash(extra->mp_nexthop_global.s6_addr, 16, key);
-      key = jhash(extra->mp_nexthop_local.s6_addr, 16, key);
+      sig->mp_nexthop_len = extra->mp_nexthop_len;
+      sig->mp_nexthop_global = extra->mp_nexthop_global;
+      sig->mp_nexthop_local = extra->mp_nexthop_local;
 #endif /* HAVE_IPV6 */
     }
 
-  return key;
+  /* A word at a time, multiply and fold: much cheaper than jhash2 over
+     the same bytes, and mixes pointers' low bits well enough. */
+  for (i = 0; i < ATTRHASH_SIG_WORDS; i++)
+    {
+      h = (h ^ u.w[i]) * 0x9e3779b97f4a7c15ULL;
+      h ^= h >> 29;
+    }
+  return (unsigned int) (h ^ (h >> 32));
 }
 
 int
@@ -448,7 +480,8 @@ attrhash_cmp (const void *p1, const void *p2)
 static void
 attrhash_init (void)
 {
-  attrhash = hash_create (attrhash_key_make, attrhash_cmp);
+  attrhash = hash_create_open (0, attrhash_key_make, attrhash_cmp);
+  hash_set_name (attrhash, "BGP attributes");
 }
 
 static void
@@ -467,6 +500,13 @@ attr_show_all_iterator (struct hash_backet *backet, struct vty *vty)
 	   inet_ntoa (attr->nexthop), VTY_NEWLINE);
 }
 
+static void
+attr_show_intern (struct vty *vty, const char *name, struct hash *hash)
+{
+  vty_out (vty, "%-22s %9lu %11lu %11lu%s", name, hash->count,
+	   hash->hits, hash->misses, VTY_NEWLINE);
+}
+
 void
 attr_show_all (struct vty *vty)
 {
@@ -474,6 +514,18 @@ attr_show_all (struct vty *vty)
 		(void (*)(struct hash_backet *, void *))
 		attr_show_all_iterator,
 		vty);
+  vty_out (vty, "Encoded attribute cache: %lu hits, %lu misses%s",
+	   bgp_attr_encode_hits, bgp_attr_encode_misses, VTY_NEWLINE);
+
+  /* A hit is an intern that found the value shared already. */
+  vty_out (vty, "%s%-22s %9s %11s %11s%s", VTY_NEWLINE,
+	   "Interned", "Entries", "Hits", "Misses", VTY_NEWLINE);
+  attr_show_intern (vty, "attributes", attrhash);
+  attr_show_intern (vty, "AS paths", aspath_hash ());
+  attr_show_intern (vty, "communities", community_hash ());
+  attr_show_intern (vty, "extended communities", ecommunity_hash ());
+  attr_show_intern (vty, "cluster lists", cluster_hash);
+  attr_show_intern (vty, "unknown transitives", transit_hash);
 }
 
 static void *
@@ -922,6 +974,11 @@ bgp_attr_flag_invalid (struct bgp_attr_parser_args *args)
   return 1;
 }
 
+/* The parsers of the attributes get the attribute's value at the getp
+   of the peer's ibuf, within the window bgp_attr_parse() checked.  So
+   the parsers of attributes of a fixed length read them unchecked, once
+   they have checked the length. */
+
 /* Get origin attribute of the update message. */
 static bgp_attr_parse_ret_t
 bgp_attr_origin (struct bgp_attr_parser_args *args)
@@ -945,7 +1002,7 @@ bgp_attr_origin (struct bgp_attr_parser_args *args)
     }
 
   /* Fetch origin attribute. */
-  attr->origin = stream_getc (BGP_INPUT (peer));
+  attr->origin = stream_wgetc (BGP_INPUT (peer));
 
   /* If the ORIGIN attribute has an undefined value, then the Error
      Subcode is set to Invalid Origin Attribute.  The Data field
@@ -1103,7 +1160,7 @@ bgp_attr_nexthop (struct bgp_attr_parser_args *args)
      At the same time, semantically incorrect NEXT_HOP is more likely to be just
      logged locally (this is implemented somewhere else). The UPDATE message
      gets ignored in any of these cases. */
-  nexthop_n = stream_get_ipv4 (peer->ibuf);
+  nexthop_n = stream_wget_ipv4 (peer->ibuf);
   nexthop_h = ntohl (nexthop_n);
   if (IPV4_NET0 (nexthop_h) || IPV4_NET127 (nexthop_h) || IPV4_CLASS_DE (nexthop_h))
     {
@@ -1140,7 +1197,7 @@ bgp_attr_med (struct bgp_attr_parser_args *args)
                                  args->total);
     }
 
-  attr->med = stream_getl (peer->ibuf);
+  attr->med = stream_wgetl (peer->ibuf);
 
   attr->flag |= ATTR_FLAG_BIT (BGP_ATTR_MULTI_EXIT_DISC);
 
@@ -1174,7 +1231,7 @@ bgp_attr_local_pref (struct bgp_attr_parser_args *args)
       return BGP_ATTR_PARSE_PROCEED;
     }
 
-  attr->local_pref = stream_getl (peer->ibuf);
+  attr->local_pref = stream_wgetl (peer->ibuf);
 
   /* Set atomic aggregate flag. */
   attr->flag |= ATTR_FLAG_BIT (BGP_ATTR_LOCAL_PREF);
@@ -1231,10 +1288,10 @@ bgp_attr_aggregator (struct bgp_attr_parser_args *args)
     }
   
   if ( CHECK_FLAG (peer->cap, PEER_CAP_AS4_RCV ) )
-    attre->aggregator_as = stream_getl (peer->ibuf);
+    attre->aggregator_as = stream_wgetl (peer->ibuf);
   else
-    attre->aggregator_as = stream_getw (peer->ibuf);
-  attre->aggregator_addr.s_addr = stream_get_ipv4 (peer->ibuf);
+    attre->aggregator_as = stream_wgetw (peer->ibuf);
+  attre->aggregator_addr.s_addr = stream_wget_ipv4 (peer->ibuf);
 
   /* Set atomic aggregate flag. */
   attr->flag |= ATTR_FLAG_BIT (BGP_ATTR_AGGREGATOR);
@@ -1261,8 +1318,8 @@ bgp_attr_as4_aggregator (struct bgp_attr_parser_args *args,
                                  0);
     }
   
-  *as4_aggregator_as = stream_getl (peer->ibuf);
-  as4_aggregator_addr->s_addr = stream_get_ipv4 (peer->ibuf);
+  *as4_aggregator_as = stream_wgetl (peer->ibuf);
+  as4_aggregator_addr->s_addr = stream_wget_ipv4 (peer->ibuf);
 
   attr->flag |= ATTR_FLAG_BIT (BGP_ATTR_AS4_AGGREGATOR);
 
@@ -1419,7 +1476,7 @@ bgp_attr_originator_id (struct bgp_attr_parser_args *args)
     }
 
   (bgp_attr_extra_get (attr))->originator_id.s_addr 
-    = stream_get_ipv4 (peer->ibuf);
+    = stream_wget_ipv4 (peer->ibuf);
 
   attr->flag |= ATTR_FLAG_BIT (BGP_ATTR_ORIGINATOR_ID);
 
@@ -1477,7 +1534,7 @@ bgp_mp_reach_parse (struct bgp_attr_parser_args *args,
   /* safe to read statically sized header? */
 #define BGP_MP_REACH_MIN_SIZE 5
 #define LEN_LEFT	(length - (stream_get_getp(s) - start))
-  if ((length > STREAM_READABLE(s)) || (length < BGP_MP_REACH_MIN_SIZE))
+  if (! stream_window (s, length) || (length < BGP_MP_REACH_MIN_SIZE))
     {
       zlog_info ("%s: %s sent invalid length, %lu", 
 		 __func__, peer->host, (unsigned long)length);
@@ -1485,11 +1542,11 @@ bgp_mp_reach_parse (struct bgp_attr_parser_args *args,
     }
   
   /* Load AFI, SAFI. */
-  afi = stream_getw (s);
-  safi = stream_getc (s);
+  afi = stream_wgetw (s);
+  safi = stream_wgetc (s);
 
   /* Get nexthop length. */
-  attre->mp_nexthop_len = stream_getc (s);
+  attre->mp_nexthop_len = stream_wgetc (s);
   
   if (LEN_LEFT < attre->mp_nexthop_len)
     {
@@ -1502,23 +1559,22 @@ bgp_mp_reach_parse (struct bgp_attr_parser_args *args,
   switch (attre->mp_nexthop_len)
     {
     case 4:
-      stream_get (&attre->mp_nexthop_global_in, s, 4);
+      stream_wget (&attre->mp_nexthop_global_in, s, 4);
       /* Probably needed for RFC 2283 */
       if (attr->nexthop.s_addr == 0)
         memcpy(&attr->nexthop.s_addr, &attre->mp_nexthop_global_in, 4);
       break;
     case 12:
-      stream_getl (s); /* RD high */
-      stream_getl (s); /* RD low */
-      stream_get (&attre->mp_nexthop_global_in, s, 4);
+      stream_wforward (s, 8); /* RD */
+      stream_wget (&attre->mp_nexthop_global_in, s, 4);
       break;
 #ifdef HAVE_IPV6
     case 16:
-      stream_get (&attre->mp_nexthop_global, s, 16);
+      stream_wget (&attre->mp_nexthop_global, s, 16);
       break;
     case 32:
-      stream_get (&attre->mp_nexthop_global, s, 16);
-      stream_get (&attre->mp_nexthop_local, s, 16);
+      stream_wget (&attre->mp_nexthop_global, s, 16);
+      stream_wget (&attre->mp_nexthop_local, s, 16);
       if (! IN6_IS_ADDR_LINKLOCAL (&attre->mp_nexthop_local))
 	{
 	  char buf1[INET6_ADDRSTRLEN];
@@ -1550,7 +1606,7 @@ bgp_mp_reach_parse (struct bgp_attr_parser_args *args,
   
   {
     u_char val; 
-    if ((val = stream_getc (s)))
+    if ((val = stream_wgetc (s)))
     zlog_warn ("%s sent non-zero value, %u, for defunct SNPA-length field",
                 peer->host, val);
   }
@@ -1602,11 +1658,11 @@ bgp_mp_unreach_parse (struct bgp_attr_parser_args *args,
   s = peer->ibuf;
   
 #define BGP_MP_UNREACH_MIN_SIZE 3
-  if ((length > STREAM_READABLE(s)) || (length <  BGP_MP_UNREACH_MIN_SIZE))
+  if (! stream_window (s, length) || (length <  BGP_MP_UNREACH_MIN_SIZE))
     return BGP_ATTR_PARSE_ERROR;
   
-  afi = stream_getw (s);
-  safi = stream_getc (s);
+  afi = stream_wgetw (s);
+  safi = stream_wgetc (s);
   
   withdraw_len = length - BGP_MP_UNREACH_MIN_SIZE;
 
@@ -1746,6 +1802,19 @@ bgp_attr_parse (struct peer *peer, struct attr *attr, bgp_size_t size,
   /* Initialize bitmap. */
   memset (seen, 0, BGP_ATTR_BITMAP_SIZE);
 
+  /* All the attributes are read from this window, so the length
+     checks below are all the bounds checks needed. */
+  if (! stream_window (BGP_INPUT (peer), size))
+    {
+      zlog (peer->log, LOG_WARNING,
+	    "%s: error BGP attribute length %u is past the message end",
+	    peer->host, size);
+      bgp_notify_send (peer, 
+		       BGP_NOTIFY_UPDATE_ERR, 
+		       BGP_NOTIFY_UPDATE_ATTR_LENG_ERR);
+      return BGP_ATTR_PARSE_ERROR;
+    }
+
   /* End pointer of BGP attribute. */
   endp = BGP_INPUT_PNT (peer) + size;
   
@@ -1772,8 +1841,8 @@ bgp_attr_parse (struct peer *peer, struct attr *attr, bgp_size_t size,
       /* "The lower-order four bits of the Attribute Flags octet are
          unused.  They MUST be zero when sent and MUST be ignored when
          received." */
-      flag = 0xF0 & stream_getc (BGP_INPUT (peer));
-      type = stream_getc (BGP_INPUT (peer));
+      flag = 0xF0 & stream_wgetc (BGP_INPUT (peer));
+      type = stream_wgetc (BGP_INPUT (peer));
 
       /* Check whether Extended-Length applies and is in bounds */
       if (CHECK_FLAG (flag, BGP_ATTR_FLAG_EXTLEN)
@@ -1792,9 +1861,9 @@ bgp_attr_parse (struct peer *peer, struct attr *attr, bgp_size_t size,
       
       /* Check extended attribue length bit. */
       if (CHECK_FLAG (flag, BGP_ATTR_FLAG_EXTLEN))
-	length = stream_getw (BGP_INPUT (peer));
+	length = stream_wgetw (BGP_INPUT (peer));
       else
-	length = stream_getc (BGP_INPUT (peer));
+	length = stream_wgetc (BGP_INPUT (peer));
       
       /* If any attribute appears more than once in the UPDATE
 	 message, then the Error Subcode is set to Malformed Attribute
@@ -2021,6 +2090,155 @@ bgp_attr_parse (struct peer *peer, struct attr *attr, bgp_size_t size,
   return BGP_ATTR_PARSE_PROCEED;
 }
 
+/* Peers tend to send the same path attributes over and over, one
+   UPDATE per handful of prefixes, so the outcome of bgp_attr_parse()
+   is remembered per peer, keyed by the raw attribute bytes.  Only
+   attributes which parsed cleanly and carried no MP NLRI are kept,
+   each entry holding its own references to the interned parts. */
+#define BGP_ATTR_CACHE_SIZE	64
+#define BGP_ATTR_CACHE_MAXLEN	1024
+
+struct bgp_attr_cache_entry
+{
+  unsigned int key;
+  bgp_size_t length;
+  u_char *data;
+  struct attr attr;
+  struct attr_extra extra;
+};
+
+struct bgp_attr_cache
+{
+  struct bgp_attr_cache_entry entry[BGP_ATTR_CACHE_SIZE];
+};
+
+/* Take another reference on everything bgp_attr_parse() interned. */
+static void
+bgp_attr_cache_ref (struct attr *attr)
+{
+  if (attr->aspath)
+    attr->aspath->refcnt++;
+  if (attr->community)
+    attr->community->refcnt++;
+  if (attr->extra)
+    {
+      if (attr->extra->ecommunity)
+	attr->extra->ecommunity->refcnt++;
+      if (attr->extra->cluster)
+	attr->extra->cluster->refcnt++;
+      if (attr->extra->transit)
+	attr->extra->transit->refcnt++;
+    }
+}
+
+/* Take another reference on an interned attribute, as interning it
+   again would, without hashing it. */
+struct attr *
+bgp_attr_ref (struct attr *attr)
+{
+  bgp_attr_cache_ref (attr);
+  attr->refcnt++;
+  return attr;
+}
+
+/* Look up the attributes at the peer's input pointer.  On a hit, fill
+   in attr, which must point at its own attr_extra, as bgp_attr_parse()
+   would have, and skip over the attributes in the input stream. */
+int
+bgp_attr_cache_get (struct peer *peer, struct attr *attr, bgp_size_t size)
+{
+  struct bgp_attr_cache_entry *e;
+  struct attr_extra *extra = attr->extra;
+  unsigned int key;
+
+  if (! peer->attr_cache || size > BGP_ATTR_CACHE_MAXLEN)
+    return 0;
+
+  key = jhash (BGP_INPUT_PNT (peer), size, 0);
+  e = &peer->attr_cache->entry[key % BGP_ATTR_CACHE_SIZE];
+  if (! e->data || e->key != key || e->length != size
+      || memcmp (e->data, BGP_INPUT_PNT (peer), size))
+    return 0;
+
+  *attr = e->attr;
+  if (e->attr.extra)
+    {
+      *extra = e->extra;
+      attr->extra = extra;
+    }
+  bgp_attr_cache_ref (attr);
+
+  stream_forward_getp (BGP_INPUT (peer), size);
+  return 1;
+}
+
+/* Remember the outcome of parsing the size bytes of attributes at
+   startp, which left attr behind. */
+void
+bgp_attr_cache_set (struct peer *peer, struct attr *attr,
+		    u_char *startp, bgp_size_t size)
+{
+  struct bgp_attr_cache_entry *e;
+  unsigned int key;
+
+  if (size > BGP_ATTR_CACHE_MAXLEN)
+    return;
+
+  if (! peer->attr_cache)
+    peer->attr_cache = XCALLOC (MTYPE_BGP_ATTR_CACHE,
+				sizeof (struct bgp_attr_cache));
+
+  key = jhash (startp, size, 0);
+  e = &peer->attr_cache->entry[key % BGP_ATTR_CACHE_SIZE];
+
+  if (e->data)
+    {
+      bgp_attr_unintern_sub (&e->attr);
+      if (e->length != size)
+	{
+	  XFREE (MTYPE_BGP_ATTR_CACHE_DATA, e->data);
+	  e->data = NULL;
+	}
+    }
+  if (! e->data)
+    e->data = XMALLOC (MTYPE_BGP_ATTR_CACHE_DATA, size);
+
+  e->key = key;
+  e->length = size;
+  memcpy (e->data, startp, size);
+
+  e->attr = *attr;
+  if (attr->extra)
+    {
+      e->extra = *attr->extra;
+      e->attr.extra = &e->extra;
+    }
+  bgp_attr_cache_ref (&e->attr);
+}
+
+/* Forget everything cached for the peer, e.g. when the session goes
+   down or the checks done while parsing change. */
+void
+bgp_attr_cache_flush (struct peer *peer)
+{
+  struct bgp_attr_cache_entry *e;
+  int i;
+
+  if (! peer->attr_cache)
+    return;
+
+  for (i = 0; i < BGP_ATTR_CACHE_SIZE; i++)
+    {
+      e = &peer->attr_cache->entry[i];
+      if (! e->data)
+	continue;
+      bgp_attr_unintern_sub (&e->attr);
+      XFREE (MTYPE_BGP_ATTR_CACHE_DATA, e->data);
+    }
+  XFREE (MTYPE_BGP_ATTR_CACHE, peer->attr_cache);
+  peer->attr_cache = NULL;
+}
+
 /* Well-known attribute check. */
 int
 bgp_attr_check (struct peer *peer, struct attr *attr)
@@ -2056,12 +2274,157 @@ bgp_attr_check (struct peer *peer, struct attr *attr)
 
 int stream_put_prefix (struct stream *, struct prefix *);
 
+/* The same interned attribute usually goes out to many peers which
+   all want it encoded the same way, so the encoding is remembered,
+   keyed by the attribute and everything about the peer, the route's
+   source and the instance that bgp_packet_attribute() looks at.  Each
+   entry holds a reference on its attribute, so the pointer can not be
+   reused while cached.  Only IPv4 unicast is cached, the other
+   families carry their NLRI inside MP_REACH_NLRI. */
+#define BGP_ATTR_ENCODE_SIZE	1024
+#define BGP_ATTR_ENCODE_MAXLEN	1024
+
+struct bgp_attr_encode_key
+{
+  struct attr *attr;
+  as_t local_as;
+  as_t change_local_as;
+  as_t confed_id;
+  struct in_addr cluster_id;
+  struct in_addr from_id;
+  u_int32_t af_flags;
+  u_char sort;
+  u_char from_sort;
+  u_char use32bit;
+  u_char replace_as;
+};
+
+struct bgp_attr_encode_entry
+{
+  struct bgp_attr_encode_key key;
+  bgp_size_t length;
+  u_char *data;
+};
+
+static struct bgp_attr_encode_entry bgp_attr_encode[BGP_ATTR_ENCODE_SIZE];
+
+static void
+bgp_attr_encode_key_make (struct bgp_attr_encode_key *key, struct bgp *bgp,
+			  struct peer *peer, struct attr *attr,
+			  struct peer *from)
+{
+  memset (key, 0, sizeof (struct bgp_attr_encode_key));
+  key->attr = attr;
+  key->local_as = peer->local_as;
+  key->change_local_as = peer->change_local_as;
+  if (CHECK_FLAG (bgp->config, BGP_CONFIG_CONFEDERATION))
+    key->confed_id = bgp->confed_id;
+  /* Reflected routes carry ORIGINATOR_ID and CLUSTER_LIST. */
+  if (peer->sort == BGP_PEER_IBGP && from && from->sort == BGP_PEER_IBGP)
+    {
+      if (bgp->config & BGP_CONFIG_CLUSTER_ID)
+	key->cluster_id = bgp->cluster_id;
+      else
+	key->cluster_id = bgp->router_id;
+      key->from_sort = from->sort;
+      key->from_id = from->remote_id;
+    }
+  key->af_flags = peer->af_flags[AFI_IP][SAFI_UNICAST]
+		  & (PEER_FLAG_AS_PATH_UNCHANGED | PEER_FLAG_RSERVER_CLIENT
+		     | PEER_FLAG_SEND_COMMUNITY
+		     | PEER_FLAG_SEND_EXT_COMMUNITY);
+  key->sort = peer->sort;
+  key->use32bit = CHECK_FLAG (peer->cap, PEER_CAP_AS4_RCV) ? 1 : 0;
+  key->replace_as = CHECK_FLAG (peer->flags, PEER_FLAG_LOCAL_AS_REPLACE_AS)
+		    ? 1 : 0;
+}
+
+/* Drop every cached encoding. */
+void
+bgp_attr_encode_flush (void)
+{
+  struct bgp_attr_encode_entry *e;
+  int i;
+
+  for (i = 0; i < BGP_ATTR_ENCODE_SIZE; i++)
+    {
+      e = &bgp_attr_encode[i];
+      if (! e->data)
+	continue;
+      bgp_attr_unintern (&e->key.attr);
+      XFREE (MTYPE_BGP_ATTR_ENCODE, e->data);
+      memset (e, 0, sizeof (struct bgp_attr_encode_entry));
+    }
+}
+
+static bgp_size_t bgp_packet_attribute_encode (struct bgp *, struct peer *,
+					       struct stream *, struct attr *,
+					       struct prefix *, afi_t, safi_t,
+					       struct peer *,
+					       struct prefix_rd *, u_char *);
+
 /* Make attribute packet. */
 bgp_size_t
 bgp_packet_attribute (struct bgp *bgp, struct peer *peer,
 		      struct stream *s, struct attr *attr, struct prefix *p,
 		      afi_t afi, safi_t safi, struct peer *from,
 		      struct prefix_rd *prd, u_char *tag)
+{
+  struct bgp_attr_encode_key key;
+  struct bgp_attr_encode_entry *e;
+  size_t cp;
+  bgp_size_t length;
+
+  if (! bgp)
+    bgp = bgp_get_default ();
+
+  if (p->family != AF_INET || safi != SAFI_UNICAST || ! attr->refcnt)
+    return bgp_packet_attribute_encode (bgp, peer, s, attr, p, afi, safi,
+					from, prd, tag);
+
+  bgp_attr_encode_key_make (&key, bgp, peer, attr, from);
+  e = &bgp_attr_encode[jhash (&key, sizeof (key), 0) % BGP_ATTR_ENCODE_SIZE];
+
+  if (e->data && ! memcmp (&e->key, &key, sizeof (key)))
+    {
+      bgp_attr_encode_hits++;
+      stream_put (s, e->data, e->length);
+      return e->length;
+    }
+
+  bgp_attr_encode_misses++;
+  cp = stream_get_endp (s);
+  length = bgp_packet_attribute_encode (bgp, peer, s, attr, p, afi, safi,
+					from, prd, tag);
+  if (length > BGP_ATTR_ENCODE_MAXLEN)
+    return length;
+
+  if (e->data)
+    {
+      bgp_attr_unintern (&e->key.attr);
+      if (e->length != length)
+	{
+	  XFREE (MTYPE_BGP_ATTR_ENCODE, e->data);
+	  e->data = NULL;
+	}
+    }
+  if (! e->data)
+    e->data = XMALLOC (MTYPE_BGP_ATTR_ENCODE, length);
+
+  e->key = key;
+  e->key.attr = bgp_attr_ref (attr);
+  e->length = length;
+  memcpy (e->data, STREAM_DATA (s) + cp, length);
+
+  return length;
+}
+
+static bgp_size_t
+bgp_packet_attribute_encode (struct bgp *bgp, struct peer *peer,
+			     struct stream *s, struct attr *attr,
+			     struct prefix *p, afi_t afi, safi_t safi,
+			     struct peer *from, struct prefix_rd *prd,
+			     u_char *tag)
 {
   size_t cp;
   size_t aspath_sizep;
@@ -2070,9 +2433,6 @@ bgp_packet_attribute (struct bgp *bgp, struct peer *peer,
   int send_as4_aggregator = 0;
   int use32bit = (CHECK_FLAG (peer->cap, PEER_CAP_AS4_RCV)) ? 1 : 0;
 
-  if (! bgp)
-    bgp = bgp_get_default ();
-
   /* Remember current pointer. */
   cp = stream_get_endp (s);
 
@@ -2460,6 +2820,8 @@ bgp_packet_attribute (struct bgp *bgp, struct peer *peer,
        * there! (JK) 
        * Folks, talk to me: what is reasonable here!?
        */
+      if (aspath == attr->aspath)
+	aspath = aspath_dup (aspath);
       aspath = aspath_delete_confed_seq (aspath);
 
       stream_putc (s, BGP_ATTR_FLAG_TRANS|BGP_ATTR_FLAG_OPTIONAL|BGP_ATTR_FLAG_EXTLEN);
@@ -2556,6 +2918,7 @@ bgp_attr_init (void)
 void
 bgp_attr_finish (void)
 {
+  bgp_attr_encode_flush ();
   aspath_finish ();
   attrhash_finish ();
   community_finish ();
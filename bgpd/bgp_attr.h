@@ -120,6 +120,9 @@ struct cluster_list
   unsigned long refcnt;
   int length;
   struct in_addr *list;
+
+  /* Where list points once interned. */
+  struct in_addr data[];
 };
 
 /* Unknown transit attribute. */
@@ -145,10 +148,15 @@ extern bgp_attr_parse_ret_t bgp_attr_parse (struct peer *, struct attr *,
                                            bgp_size_t, struct bgp_nlri *,
                                            struct bgp_nlri *);
 extern int bgp_attr_check (struct peer *, struct attr *);
+extern int bgp_attr_cache_get (struct peer *, struct attr *, bgp_size_t);
+extern void bgp_attr_cache_set (struct peer *, struct attr *, u_char *,
+				bgp_size_t);
+extern void bgp_attr_cache_flush (struct peer *);
 extern struct attr_extra *bgp_attr_extra_get (struct attr *);
 extern void bgp_attr_extra_free (struct attr *);
 extern void bgp_attr_dup (struct attr *, struct attr *);
 extern struct attr *bgp_attr_intern (struct attr *attr);
+extern struct attr *bgp_attr_ref (struct attr *);
 extern void bgp_attr_unintern_sub (struct attr *);
 extern void bgp_attr_unintern (struct attr **);
 extern void bgp_attr_flush (struct attr *);
@@ -161,6 +169,7 @@ extern bgp_size_t bgp_packet_attribute (struct bgp *bgp, struct peer *,
                                  struct stream *, struct attr *, 
                                  struct prefix *, afi_t, safi_t, 
                                  struct peer *, struct prefix_rd *, u_char *);
+extern void bgp_attr_encode_flush (void);
 extern bgp_size_t bgp_packet_withdraw (struct peer *peer, struct stream *s, 
                                 struct prefix *p, afi_t, safi_t, 
                                 struct prefix_rd *, u_char *);
@@ -174,6 +183,7 @@ extern unsigned long int attr_unknown_count (void);
 
 /* Cluster list prototypes. */
 extern int cluster_loop_check (struct cluster_list *, struct in_addr);
+extern struct cluster_list *cluster_parse (struct in_addr *, int);
 extern void cluster_unintern (struct cluster_list *);
 
 /* Transit attribute prototypes. */
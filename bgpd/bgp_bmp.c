@@ -0,0 +1,1106 @@
+/* BGP Monitoring Protocol (RFC 7854).
+   Copyright (C) 2026 The Quagga project
+
+This file is part of GNU Zebra.
+
+GNU Zebra is free software; you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation; either version 2, or (at your option) any
+later version.
+
+GNU Zebra is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with GNU Zebra; see the file COPYING.  If not, write to the Free
+Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+02111-1307, USA.  */
+
+/* bgpd connects out to each configured collector.  Once connected it
+   sends an Initiation, a Peer Up for each established peer of the
+   default instance and then, a slice of the RIB at a time, Route
+   Monitoring of what the peers sent: pre-policy from Adj-RIB-In where
+   soft-reconfiguration inbound keeps it, post-policy from the RIB.
+   End-of-RIB markers follow the last of it.  From then on updates and
+   withdraws are sent as they are received, both before and after
+   inbound policy, along with peer state changes and periodic
+   statistics.
+
+   Messages are queued on the collector's buffer and written as the
+   socket takes them.  A collector falling too far behind is reset and
+   synced afresh when it reconnects, as BMP has no way to skip
+   messages. */
+
+#include <zebra.h>
+
+#include "log.h"
+#include "prefix.h"
+#include "sockunion.h"
+#include "command.h"
+#include "thread.h"
+#include "linklist.h"
+#include "buffer.h"
+#include "stream.h"
+#include "memory.h"
+#include "network.h"
+#include "version.h"
+
+#include "bgpd/bgpd.h"
+#include "bgpd/bgp_table.h"
+#include "bgpd/bgp_route.h"
+#include "bgpd/bgp_attr.h"
+#include "bgpd/bgp_advertise.h"
+#include "bgpd/bgp_bmp.h"
+
+#define BMP_VERSION               3
+#define BMP_PORT_DEFAULT          11019
+
+/* Per-peer header flags. */
+#define BMP_PEER_FLAG_V           0x80  /* IPv6 peer address */
+#define BMP_PEER_FLAG_L           0x40  /* Post-policy */
+
+/* Information TLV types. */
+#define BMP_INFO_STRING           0
+#define BMP_INFO_SYSDESCR         1
+#define BMP_INFO_SYSNAME          2
+#define BMP_TERM_REASON           1
+#define BMP_TERM_ADMIN_CLOSE      0
+
+/* Peer Down reasons. */
+#define BMP_DOWN_LOCAL_NOTIFY     1
+#define BMP_DOWN_LOCAL_NO_NOTIFY  2
+#define BMP_DOWN_REMOTE_NOTIFY    3
+#define BMP_DOWN_REMOTE_NO_NOTIFY 4
+#define BMP_DOWN_DECONFIGURED     5
+
+/* Statistics types. */
+#define BMP_STAT_REJECTED         0
+#define BMP_STAT_LOC_RIB          8
+
+#define BMP_RECONNECT_TIME        30
+#define BMP_STATS_INTERVAL_DEFAULT 60
+
+/* RIB nodes put into Route Monitoring per write event while syncing. */
+#define BMP_SYNC_SLICE            1000
+
+/* A collector is reset once this many bytes wait to be written. */
+#define BMP_BACKLOG_MAX           (32 * 1024 * 1024)
+
+enum bmp_state
+{
+  BMP_IDLE,
+  BMP_CONNECTING,
+  BMP_UP
+};
+
+static const char *bmp_state_str[] = { "Idle", "Connecting", "Up" };
+
+struct bmp_collector
+{
+  union sockunion su;
+  u_int16_t port;
+
+  int fd;
+  enum bmp_state state;
+  struct buffer *obuf;
+  size_t backlog;
+
+  struct thread *t_connect;
+  struct thread *t_read;
+  struct thread *t_write;
+  struct thread *t_stats;
+
+  /* Sync position: the table being walked and its next node, both
+     locked, while syncing is set. */
+  int syncing;
+  unsigned int af;
+  struct bgp_table *table;
+  struct bgp_node *rn;
+
+  time_t uptime;
+  unsigned long messages;
+  unsigned long long bytes;
+  unsigned long connects;
+  unsigned long resets;
+};
+
+static const struct
+{
+  afi_t afi;
+  safi_t safi;
+} bmp_afs[] =
+{
+  { AFI_IP,  SAFI_UNICAST },
+  { AFI_IP,  SAFI_MULTICAST },
+  { AFI_IP6, SAFI_UNICAST },
+  { AFI_IP6, SAFI_MULTICAST },
+};
+#define BMP_AFS (sizeof (bmp_afs) / sizeof (bmp_afs[0]))
+
+static struct list *bmp_collectors;
+static int bmp_stats_time = BMP_STATS_INTERVAL_DEFAULT;
+
+/* Message under construction. */
+static struct stream *bmp_s;
+
+static void bmp_event (struct bmp_collector *);
+static void bmp_reset (struct bmp_collector *);
+
+static const char *
+bmp_name (struct bmp_collector *c)
+{
+  static char buf[SU_ADDRSTRLEN];
+
+  return sockunion2str (&c->su, buf, sizeof (buf));
+}
+
+static int
+bmp_af_supported (afi_t afi, safi_t safi)
+{
+  return ((afi == AFI_IP || afi == AFI_IP6)
+          && (safi == SAFI_UNICAST || safi == SAFI_MULTICAST));
+}
+
+/* Only the peers of the default instance are monitored. */
+static int
+bmp_peer_monitored (struct peer *peer)
+{
+  return (peer->status == Established && ! peer->bgp->name
+          && peer != peer->bgp->peer_self);
+}
+
+/* Message construction. */
+
+static void
+bmp_put_header (struct stream *s, u_char type)
+{
+  stream_reset (s);
+  stream_putc (s, BMP_VERSION);
+  stream_putl (s, 0);
+  stream_putc (s, type);
+}
+
+static void
+bmp_put_addr (struct stream *s, union sockunion *su)
+{
+  static const u_char zero[12];
+
+#ifdef HAVE_IPV6
+  if (su && su->sa.sa_family == AF_INET6)
+    {
+      stream_put (s, &su->sin6.sin6_addr, 16);
+      return;
+    }
+#endif /* HAVE_IPV6 */
+  stream_put (s, zero, 12);
+  if (su && su->sa.sa_family == AF_INET)
+    stream_put_in_addr (s, &su->sin.sin_addr);
+  else
+    stream_putl (s, 0);
+}
+
+static void
+bmp_put_peer_header (struct stream *s, struct peer *peer, u_char flags)
+{
+  struct timeval tv;
+
+  quagga_gettime (QUAGGA_CLK_REALTIME, &tv);
+
+#ifdef HAVE_IPV6
+  if (peer->su.sa.sa_family == AF_INET6)
+    flags |= BMP_PEER_FLAG_V;
+#endif /* HAVE_IPV6 */
+
+  stream_putc (s, 0);                   /* Global instance peer */
+  stream_putc (s, flags);
+  stream_putl (s, 0);                   /* Peer distinguisher */
+  stream_putl (s, 0);
+  bmp_put_addr (s, &peer->su);
+  stream_putl (s, peer->as);
+  stream_put_in_addr (s, &peer->remote_id);
+  stream_putl (s, tv.tv_sec);
+  stream_putl (s, tv.tv_usec);
+}
+
+static void
+bmp_put_info (struct stream *s, u_int16_t type, const char *str)
+{
+  size_t len = strlen (str);
+
+  stream_putw (s, type);
+  stream_putw (s, len);
+  stream_put (s, str, len);
+}
+
+static void
+bmp_put_mp_reach (struct stream *s, struct attr *attr, struct prefix *p,
+                  afi_t afi, safi_t safi)
+{
+  size_t lenp;
+
+  stream_putc (s, BGP_ATTR_FLAG_OPTIONAL | BGP_ATTR_FLAG_EXTLEN);
+  stream_putc (s, BGP_ATTR_MP_REACH_NLRI);
+  lenp = stream_get_endp (s);
+  stream_putw (s, 0);
+  stream_putw (s, afi);
+  stream_putc (s, safi);
+
+  if (afi == AFI_IP)
+    {
+      stream_putc (s, 4);
+      stream_put_in_addr (s, &attr->nexthop);
+    }
+#ifdef HAVE_IPV6
+  else if (attr->extra && attr->extra->mp_nexthop_len == 32)
+    {
+      stream_putc (s, 32);
+      stream_put (s, &attr->extra->mp_nexthop_global, 16);
+      stream_put (s, &attr->extra->mp_nexthop_local, 16);
+    }
+  else
+    {
+      stream_putc (s, 16);
+      if (attr->extra)
+        stream_put (s, &attr->extra->mp_nexthop_global, 16);
+      else
+        stream_put (s, NULL, 16);
+    }
+#endif /* HAVE_IPV6 */
+
+  stream_putc (s, 0);                   /* SNPA */
+  stream_put_prefix (s, p);
+  stream_putw_at (s, lenp, stream_get_endp (s) - lenp - 2);
+}
+
+/* Put a BGP UPDATE announcing p with attr, or withdrawing it if attr is
+   NULL.  With p NULL too it is an End-of-RIB marker.  Attributes are
+   encoded as the RIB holds them, with four octet AS numbers. */
+static void
+bmp_put_update (struct stream *s, struct prefix *p, struct attr *attr,
+                afi_t afi, safi_t safi)
+{
+  size_t start = stream_get_endp (s);
+  size_t lenp;
+  int i;
+
+  for (i = 0; i < BGP_MARKER_SIZE; i++)
+    stream_putc (s, 0xff);
+  stream_putw (s, 0);
+  stream_putc (s, BGP_MSG_UPDATE);
+
+  if (afi == AFI_IP && safi == SAFI_UNICAST)
+    {
+      if (p && ! attr)
+        {
+          stream_putw (s, PSIZE (p->prefixlen) + 1);
+          stream_put_prefix (s, p);
+          stream_putw (s, 0);
+        }
+      else
+        {
+          stream_putw (s, 0);
+          if (p)
+            {
+              bgp_dump_routes_attr (s, attr, p);
+              stream_put_prefix (s, p);
+            }
+          else
+            stream_putw (s, 0);
+        }
+    }
+  else
+    {
+      stream_putw (s, 0);
+      if (attr)
+        {
+          lenp = stream_get_endp (s);
+          bgp_dump_routes_attr (s, attr, NULL);
+          bmp_put_mp_reach (s, attr, p, afi, safi);
+          stream_putw_at (s, lenp, stream_get_endp (s) - lenp - 2);
+        }
+      else if (p)
+        {
+          lenp = stream_get_endp (s);
+          stream_putw (s, 0);
+          bgp_packet_withdraw (NULL, s, p, afi, safi, NULL, NULL);
+          stream_putw_at (s, lenp, stream_get_endp (s) - lenp - 2);
+        }
+      else
+        {
+          stream_putw (s, 6);
+          stream_putc (s, BGP_ATTR_FLAG_OPTIONAL);
+          stream_putc (s, BGP_ATTR_MP_UNREACH_NLRI);
+          stream_putc (s, 3);
+          stream_putw (s, afi);
+          stream_putc (s, safi);
+        }
+    }
+
+  stream_putw_at (s, start + BGP_MARKER_SIZE, stream_get_endp (s) - start);
+}
+
+static void
+bmp_put_route_monitoring (struct stream *s, struct peer *peer,
+                          struct prefix *p, struct attr *attr,
+                          afi_t afi, safi_t safi, int post_policy)
+{
+  bmp_put_header (s, BMP_ROUTE_MONITORING);
+  bmp_put_peer_header (s, peer, post_policy ? BMP_PEER_FLAG_L : 0);
+  bmp_put_update (s, p, attr, afi, safi);
+}
+
+static int
+bmp_put_peer_up (struct stream *s, struct peer *peer)
+{
+  if (! peer->open_sent || ! peer->open_rcvd
+      || ! peer->su_local || ! peer->su_remote)
+    return -1;
+
+  bmp_put_header (s, BMP_PEER_UP);
+  bmp_put_peer_header (s, peer, 0);
+  bmp_put_addr (s, peer->su_local);
+  if (peer->su_local->sa.sa_family == AF_INET)
+    {
+      stream_put (s, &peer->su_local->sin.sin_port, 2);
+      stream_put (s, &peer->su_remote->sin.sin_port, 2);
+    }
+#ifdef HAVE_IPV6
+  else
+    {
+      stream_put (s, &peer->su_local->sin6.sin6_port, 2);
+      stream_put (s, &peer->su_remote->sin6.sin6_port, 2);
+    }
+#endif /* HAVE_IPV6 */
+  stream_put (s, STREAM_DATA (peer->open_sent),
+              stream_get_endp (peer->open_sent));
+  stream_put (s, STREAM_DATA (peer->open_rcvd),
+              stream_get_endp (peer->open_rcvd));
+  return 0;
+}
+
+static void
+bmp_put_stats (struct stream *s, struct peer *peer)
+{
+  unsigned long long loc_rib = 0;
+  unsigned int i;
+
+  for (i = 0; i < BMP_AFS; i++)
+    loc_rib += peer->pcount[bmp_afs[i].afi][bmp_afs[i].safi];
+
+  bmp_put_header (s, BMP_STATISTICS_REPORT);
+  bmp_put_peer_header (s, peer, 0);
+  stream_putl (s, 2);
+  stream_putw (s, BMP_STAT_REJECTED);
+  stream_putw (s, 4);
+  stream_putl (s, peer->policy_rejected);
+  stream_putw (s, BMP_STAT_LOC_RIB);
+  stream_putw (s, 8);
+  stream_putq (s, loc_rib);
+}
+
+/* Collector output. */
+
+/* Queue the message in s for the collector. */
+static void
+bmp_send (struct bmp_collector *c, struct stream *s)
+{
+  size_t size = stream_get_endp (s);
+
+  if (c->state != BMP_UP)
+    return;
+
+  stream_putl_at (s, 1, size);
+
+  if (c->backlog + size > BMP_BACKLOG_MAX)
+    {
+      zlog_warn ("BMP collector %s fell too far behind, resetting",
+                 bmp_name (c));
+      bmp_reset (c);
+      return;
+    }
+
+  buffer_put (c->obuf, STREAM_DATA (s), size);
+  c->backlog += size;
+  c->messages++;
+  c->bytes += size;
+  bmp_event (c);
+}
+
+static void
+bmp_send_all (struct stream *s)
+{
+  struct bmp_collector *c;
+  struct listnode *node;
+
+  for (ALL_LIST_ELEMENTS_RO (bmp_collectors, node, c))
+    bmp_send (c, s);
+}
+
+static int
+bmp_collectors_up (void)
+{
+  struct bmp_collector *c;
+  struct listnode *node;
+
+  if (bmp_collectors)
+    for (ALL_LIST_ELEMENTS_RO (bmp_collectors, node, c))
+      if (c->state == BMP_UP)
+        return 1;
+  return 0;
+}
+
+/* Put the End-of-RIB markers of every monitored peer. */
+static void
+bmp_sync_end (struct bmp_collector *c)
+{
+  struct bgp *bgp;
+  struct peer *peer;
+  struct listnode *node;
+  unsigned int i;
+
+  bgp = bgp_get_default ();
+  if (bgp)
+    for (ALL_LIST_ELEMENTS_RO (bgp->peer, node, peer))
+      if (bmp_peer_monitored (peer))
+        for (i = 0; i < BMP_AFS; i++)
+          if (peer->afc_nego[bmp_afs[i].afi][bmp_afs[i].safi])
+            {
+              bmp_put_route_monitoring (bmp_s, peer, NULL, NULL,
+                                        bmp_afs[i].afi, bmp_afs[i].safi, 0);
+              bmp_send (c, bmp_s);
+              bmp_put_route_monitoring (bmp_s, peer, NULL, NULL,
+                                        bmp_afs[i].afi, bmp_afs[i].safi, 1);
+              bmp_send (c, bmp_s);
+            }
+  c->syncing = 0;
+}
+
+static void
+bmp_sync_node (struct bmp_collector *c, struct bgp_node *rn, afi_t afi,
+               safi_t safi)
+{
+  struct bgp_adj_in *ain;
+  struct bgp_info *ri;
+
+  for (ain = rn->adj_in; ain; ain = ain->next)
+    if (bmp_peer_monitored (ain->peer))
+      {
+        bmp_put_route_monitoring (bmp_s, ain->peer, &rn->p, ain->attr,
+                                  afi, safi, 0);
+        bmp_send (c, bmp_s);
+      }
+
+  for (ri = rn->info; ri; ri = ri->next)
+    if (bmp_peer_monitored (ri->peer)
+        && ri->type == ZEBRA_ROUTE_BGP && ri->sub_type == BGP_ROUTE_NORMAL
+        && ! CHECK_FLAG (ri->flags, BGP_INFO_REMOVED | BGP_INFO_HISTORY))
+      {
+        /* The path may stand for its Adj-RIB-In entry as well. */
+        if (CHECK_FLAG (ri->flags, BGP_INFO_ADJ_IN))
+          {
+            bmp_put_route_monitoring (bmp_s, ri->peer, &rn->p, ri->attr,
+                                      afi, safi, 0);
+            bmp_send (c, bmp_s);
+          }
+        bmp_put_route_monitoring (bmp_s, ri->peer, &rn->p, ri->attr,
+                                  afi, safi, 1);
+        bmp_send (c, bmp_s);
+      }
+}
+
+/* Send a slice of the RIB to a collector being synced. */
+static void
+bmp_sync (struct bmp_collector *c)
+{
+  struct bgp *bgp;
+  int count = 0;
+
+  while (c->syncing && c->state == BMP_UP && count < BMP_SYNC_SLICE)
+    {
+      if (! c->table)
+        {
+          bgp = bgp_get_default ();
+          if (! bgp || c->af >= BMP_AFS)
+            {
+              bmp_sync_end (c);
+              return;
+            }
+          c->table = bgp->rib[bmp_afs[c->af].afi][bmp_afs[c->af].safi];
+          bgp_table_lock (c->table);
+          c->rn = bgp_table_top (c->table);
+        }
+
+      while (c->rn && count < BMP_SYNC_SLICE)
+        {
+          if (c->rn->info || c->rn->adj_in)
+            {
+              bmp_sync_node (c, c->rn, bmp_afs[c->af].afi,
+                             bmp_afs[c->af].safi);
+              count++;
+
+              /* bmp_send may have reset the collector, which ends the
+                 sync. */
+              if (c->state != BMP_UP)
+                return;
+            }
+          c->rn = bgp_route_next (c->rn);
+        }
+
+      if (! c->rn)
+        {
+          bgp_table_unlock (c->table);
+          c->table = NULL;
+          c->af++;
+        }
+    }
+}
+
+static void
+bmp_sync_stop (struct bmp_collector *c)
+{
+  if (c->rn)
+    bgp_unlock_node (c->rn);
+  if (c->table)
+    bgp_table_unlock (c->table);
+  c->rn = NULL;
+  c->table = NULL;
+  c->syncing = 0;
+}
+
+static int
+bmp_write (struct thread *thread)
+{
+  struct bmp_collector *c = THREAD_ARG (thread);
+
+  c->t_write = NULL;
+
+  switch (buffer_flush_available (c->obuf, c->fd))
+    {
+    case BUFFER_ERROR:
+      zlog_warn ("BMP collector %s: write failed: %s",
+                 bmp_name (c), safe_strerror (errno));
+      bmp_reset (c);
+      return 0;
+    case BUFFER_PENDING:
+      bmp_event (c);
+      return 0;
+    case BUFFER_EMPTY:
+      c->backlog = 0;
+      break;
+    }
+
+  /* Everything queued so far is written, sync some more of the RIB. */
+  if (c->syncing)
+    {
+      bmp_sync (c);
+      if (c->state == BMP_UP && c->syncing)
+        bmp_event (c);
+    }
+  return 0;
+}
+
+static void
+bmp_event (struct bmp_collector *c)
+{
+  if (! c->t_write && c->state == BMP_UP)
+    c->t_write = thread_add_write (master, bmp_write, c, c->fd);
+}
+
+/* Collectors send nothing; reading is to notice them going away. */
+static int
+bmp_read (struct thread *thread)
+{
+  struct bmp_collector *c = THREAD_ARG (thread);
+  char buf[512];
+  ssize_t nbytes;
+
+  c->t_read = NULL;
+
+  nbytes = read (c->fd, buf, sizeof (buf));
+  if (nbytes == 0 || (nbytes < 0 && ! ERRNO_IO_RETRY (errno)))
+    {
+      zlog_info ("BMP collector %s closed the connection",
+                 bmp_name (c));
+      bmp_reset (c);
+      return 0;
+    }
+
+  c->t_read = thread_add_read (master, bmp_read, c, c->fd);
+  return 0;
+}
+
+static int
+bmp_stats (struct thread *thread)
+{
+  struct bmp_collector *c = THREAD_ARG (thread);
+  struct bgp *bgp;
+  struct peer *peer;
+  struct listnode *node;
+
+  c->t_stats = thread_add_timer (master, bmp_stats, c, bmp_stats_time);
+
+  bgp = bgp_get_default ();
+  if (bgp)
+    for (ALL_LIST_ELEMENTS_RO (bgp->peer, node, peer))
+      if (bmp_peer_monitored (peer) && c->state == BMP_UP)
+        {
+          bmp_put_stats (bmp_s, peer);
+          bmp_send (c, bmp_s);
+        }
+  return 0;
+}
+
+/* The connection is up: announce ourselves and the peers, and start
+   syncing the RIB. */
+static void
+bmp_up (struct bmp_collector *c)
+{
+  struct bgp *bgp;
+  struct peer *peer;
+  struct listnode *node;
+
+  zlog_info ("BMP collector %s connected", bmp_name (c));
+
+  c->state = BMP_UP;
+  c->uptime = bgp_clock ();
+  c->connects++;
+  c->obuf = buffer_new (0);
+  c->t_read = thread_add_read (master, bmp_read, c, c->fd);
+  c->t_stats = thread_add_timer (master, bmp_stats, c, bmp_stats_time);
+
+  bmp_put_header (bmp_s, BMP_INITIATION);
+  bmp_put_info (bmp_s, BMP_INFO_SYSDESCR, "Quagga " QUAGGA_VERSION);
+  bmp_put_info (bmp_s, BMP_INFO_SYSNAME, host.name ? host.name : "bgpd");
+  bmp_send (c, bmp_s);
+
+  bgp = bgp_get_default ();
+  if (bgp)
+    for (ALL_LIST_ELEMENTS_RO (bgp->peer, node, peer))
+      if (bmp_peer_monitored (peer) && bmp_put_peer_up (bmp_s, peer) == 0)
+        bmp_send (c, bmp_s);
+
+  c->syncing = 1;
+  c->af = 0;
+  bmp_event (c);
+}
+
+static int bmp_connect (struct thread *);
+
+static int
+bmp_connect_check (struct thread *thread)
+{
+  struct bmp_collector *c = THREAD_ARG (thread);
+  int status = 0;
+  socklen_t slen = sizeof (status);
+
+  c->t_connect = NULL;
+
+  if (getsockopt (c->fd, SOL_SOCKET, SO_ERROR, &status, &slen) < 0)
+    status = errno;
+  if (status)
+    {
+      zlog_info ("BMP collector %s: connect failed: %s",
+                 bmp_name (c), safe_strerror (status));
+      bmp_reset (c);
+      return 0;
+    }
+
+  bmp_up (c);
+  return 0;
+}
+
+static int
+bmp_connect (struct thread *thread)
+{
+  struct bmp_collector *c = THREAD_ARG (thread);
+
+  c->t_connect = NULL;
+
+  c->fd = sockunion_socket (&c->su);
+  if (c->fd < 0)
+    {
+      bmp_reset (c);
+      return 0;
+    }
+
+  switch (sockunion_connect (c->fd, &c->su, htons (c->port), 0))
+    {
+    case connect_error:
+      zlog_info ("BMP collector %s: connect failed: %s",
+                 bmp_name (c), safe_strerror (errno));
+      bmp_reset (c);
+      break;
+    case connect_success:
+      bmp_up (c);
+      break;
+    case connect_in_progress:
+      c->state = BMP_CONNECTING;
+      c->t_connect = thread_add_write (master, bmp_connect_check, c, c->fd);
+      break;
+    }
+  return 0;
+}
+
+/* Drop the connection and what was queued for it, and try again
+   later. */
+static void
+bmp_close (struct bmp_collector *c)
+{
+  bmp_sync_stop (c);
+  THREAD_OFF (c->t_connect);
+  THREAD_OFF (c->t_read);
+  THREAD_OFF (c->t_write);
+  THREAD_OFF (c->t_stats);
+  if (c->fd >= 0)
+    close (c->fd);
+  c->fd = -1;
+  if (c->obuf)
+    buffer_free (c->obuf);
+  c->obuf = NULL;
+  c->backlog = 0;
+  c->state = BMP_IDLE;
+}
+
+static void
+bmp_reset (struct bmp_collector *c)
+{
+  if (c->state == BMP_UP)
+    c->resets++;
+  bmp_close (c);
+  c->t_connect = thread_add_timer (master, bmp_connect, c,
+                                   BMP_RECONNECT_TIME);
+}
+
+/* Say goodbye to the collector, as far as the socket takes it. */
+static void
+bmp_terminate (struct bmp_collector *c)
+{
+  if (c->state == BMP_UP)
+    {
+      bmp_put_header (bmp_s, BMP_TERMINATION);
+      stream_putw (bmp_s, BMP_TERM_REASON);
+      stream_putw (bmp_s, 2);
+      stream_putw (bmp_s, BMP_TERM_ADMIN_CLOSE);
+      stream_putl_at (bmp_s, 1, stream_get_endp (bmp_s));
+      buffer_put (c->obuf, STREAM_DATA (bmp_s), stream_get_endp (bmp_s));
+      buffer_flush_available (c->obuf, c->fd);
+    }
+  bmp_close (c);
+}
+
+/* Hooks. */
+
+void
+bgp_bmp_peer_up (struct peer *peer)
+{
+  if (! bmp_collectors_up () || ! bmp_peer_monitored (peer))
+    return;
+
+  if (bmp_put_peer_up (bmp_s, peer) == 0)
+    bmp_send_all (bmp_s);
+}
+
+/* Called from bgp_stop while the peer is still Established. */
+void
+bgp_bmp_peer_down (struct peer *peer)
+{
+  u_char reason;
+
+  if (! bmp_collectors_up () || ! bmp_peer_monitored (peer))
+    return;
+
+  switch (peer->last_reset)
+    {
+    case PEER_DOWN_NOTIFY_RECEIVED:
+      reason = BMP_DOWN_REMOTE_NOTIFY;
+      break;
+    case PEER_DOWN_CLOSE_SESSION:
+    case PEER_DOWN_NSF_CLOSE_SESSION:
+      reason = BMP_DOWN_REMOTE_NO_NOTIFY;
+      break;
+    case PEER_DOWN_NEIGHBOR_DELETE:
+      reason = BMP_DOWN_DECONFIGURED;
+      break;
+    case PEER_DOWN_NOTIFY_SEND:
+      reason = BMP_DOWN_LOCAL_NO_NOTIFY;
+      break;
+    default:
+      reason = BMP_DOWN_LOCAL_NOTIFY;
+      break;
+    }
+
+  bmp_put_header (bmp_s, BMP_PEER_DOWN);
+  bmp_put_peer_header (bmp_s, peer, 0);
+  stream_putc (bmp_s, reason);
+
+  switch (reason)
+    {
+    case BMP_DOWN_LOCAL_NOTIFY:
+    case BMP_DOWN_REMOTE_NOTIFY:
+      {
+        u_char code = BGP_NOTIFY_CEASE;
+        u_char subcode = BGP_NOTIFY_CEASE_CONFIG_CHANGE;
+        int i;
+
+        if (reason == BMP_DOWN_REMOTE_NOTIFY)
+          {
+            code = peer->notify.code;
+            subcode = peer->notify.subcode;
+          }
+        else if (peer->last_reset == PEER_DOWN_USER_RESET)
+          subcode = BGP_NOTIFY_CEASE_ADMIN_RESET;
+        else if (peer->last_reset == PEER_DOWN_USER_SHUTDOWN)
+          subcode = BGP_NOTIFY_CEASE_ADMIN_SHUTDOWN;
+
+        for (i = 0; i < BGP_MARKER_SIZE; i++)
+          stream_putc (bmp_s, 0xff);
+        stream_putw (bmp_s, BGP_HEADER_SIZE + 2);
+        stream_putc (bmp_s, BGP_MSG_NOTIFY);
+        stream_putc (bmp_s, code);
+        stream_putc (bmp_s, subcode);
+      }
+      break;
+    case BMP_DOWN_LOCAL_NO_NOTIFY:
+      stream_putw (bmp_s, 0);           /* FSM event unknown */
+      break;
+    }
+
+  bmp_send_all (bmp_s);
+}
+
+/* Send the update or, with attr NULL, withdraw of p received from peer,
+   as it came in or as it came out of inbound policy. */
+void
+bgp_bmp_route (struct peer *peer, struct prefix *p, struct attr *attr,
+               afi_t afi, safi_t safi, int post_policy)
+{
+  if (! bmp_collectors_up () || ! bmp_peer_monitored (peer)
+      || ! bmp_af_supported (afi, safi))
+    return;
+
+  bmp_put_route_monitoring (bmp_s, peer, p, attr, afi, safi, post_policy);
+  bmp_send_all (bmp_s);
+}
+
+/* Configuration. */
+
+static struct bmp_collector *
+bmp_collector_lookup (union sockunion *su, u_int16_t port)
+{
+  struct bmp_collector *c;
+  struct listnode *node;
+
+  for (ALL_LIST_ELEMENTS_RO (bmp_collectors, node, c))
+    if (sockunion_same (&c->su, su) && c->port == port)
+      return c;
+  return NULL;
+}
+
+DEFUN (bmp_collector,
+       bmp_collector_cmd,
+       "bmp collector (A.B.C.D|X:X::X:X) <1-65535>",
+       "BGP Monitoring Protocol\n"
+       "Send BMP to a collector\n"
+       "Collector IPv4 address\n"
+       "Collector IPv6 address\n"
+       "Collector TCP port\n")
+{
+  struct bmp_collector *c;
+  union sockunion su;
+  u_int16_t port;
+
+  if (str2sockunion (argv[0], &su) < 0)
+    {
+      vty_out (vty, "%% Malformed address: %s%s", argv[0], VTY_NEWLINE);
+      return CMD_WARNING;
+    }
+  port = BMP_PORT_DEFAULT;
+  if (argc > 1)
+    VTY_GET_INTEGER_RANGE ("port", port, argv[1], 1, 65535);
+
+  if (bmp_collector_lookup (&su, port))
+    return CMD_SUCCESS;
+
+  c = XCALLOC (MTYPE_BGP_BMP, sizeof (struct bmp_collector));
+  c->su = su;
+  c->port = port;
+  c->fd = -1;
+  c->state = BMP_IDLE;
+  listnode_add (bmp_collectors, c);
+
+  c->t_connect = thread_add_event (master, bmp_connect, c, 0);
+  return CMD_SUCCESS;
+}
+
+ALIAS (bmp_collector,
+       bmp_collector_default_port_cmd,
+       "bmp collector (A.B.C.D|X:X::X:X)",
+       "BGP Monitoring Protocol\n"
+       "Send BMP to a collector\n"
+       "Collector IPv4 address\n"
+       "Collector IPv6 address\n")
+
+DEFUN (no_bmp_collector,
+       no_bmp_collector_cmd,
+       "no bmp collector (A.B.C.D|X:X::X:X) <1-65535>",
+       NO_STR
+       "BGP Monitoring Protocol\n"
+       "Send BMP to a collector\n"
+       "Collector IPv4 address\n"
+       "Collector IPv6 address\n"
+       "Collector TCP port\n")
+{
+  struct bmp_collector *c;
+  union sockunion su;
+  u_int16_t port;
+
+  if (str2sockunion (argv[0], &su) < 0)
+    {
+      vty_out (vty, "%% Malformed address: %s%s", argv[0], VTY_NEWLINE);
+      return CMD_WARNING;
+    }
+  port = BMP_PORT_DEFAULT;
+  if (argc > 1)
+    VTY_GET_INTEGER_RANGE ("port", port, argv[1], 1, 65535);
+
+  c = bmp_collector_lookup (&su, port);
+  if (! c)
+    {
+      vty_out (vty, "%% No such BMP collector%s", VTY_NEWLINE);
+      return CMD_WARNING;
+    }
+
+  bmp_terminate (c);
+  listnode_delete (bmp_collectors, c);
+  XFREE (MTYPE_BGP_BMP, c);
+  return CMD_SUCCESS;
+}
+
+ALIAS (no_bmp_collector,
+       no_bmp_collector_default_port_cmd,
+       "no bmp collector (A.B.C.D|X:X::X:X)",
+       NO_STR
+       "BGP Monitoring Protocol\n"
+       "Send BMP to a collector\n"
+       "Collector IPv4 address\n"
+       "Collector IPv6 address\n")
+
+DEFUN (bmp_stats_interval,
+       bmp_stats_interval_cmd,
+       "bmp stats-interval <5-3600>",
+       "BGP Monitoring Protocol\n"
+       "Interval between statistics reports\n"
+       "Seconds\n")
+{
+  VTY_GET_INTEGER_RANGE ("stats interval", bmp_stats_time, argv[0],
+                         5, 3600);
+  return CMD_SUCCESS;
+}
+
+DEFUN (no_bmp_stats_interval,
+       no_bmp_stats_interval_cmd,
+       "no bmp stats-interval [<5-3600>]",
+       NO_STR
+       "BGP Monitoring Protocol\n"
+       "Interval between statistics reports\n"
+       "Seconds\n")
+{
+  bmp_stats_time = BMP_STATS_INTERVAL_DEFAULT;
+  return CMD_SUCCESS;
+}
+
+DEFUN (show_bmp,
+       show_bmp_cmd,
+       "show bmp",
+       SHOW_STR
+       "BGP Monitoring Protocol\n")
+{
+  struct bmp_collector *c;
+  struct listnode *node;
+  char timebuf[BGP_UPTIME_LEN];
+
+  if (! listcount (bmp_collectors))
+    {
+      vty_out (vty, "No BMP collectors are configured%s", VTY_NEWLINE);
+      return CMD_SUCCESS;
+    }
+
+  for (ALL_LIST_ELEMENTS_RO (bmp_collectors, node, c))
+    {
+      vty_out (vty, "BMP collector %s port %u, %s", bmp_name (c),
+               c->port, bmp_state_str[c->state]);
+      if (c->state == BMP_UP)
+        vty_out (vty, " for %s%s",
+                 peer_uptime (c->uptime, timebuf, BGP_UPTIME_LEN),
+                 c->syncing ? ", syncing" : "");
+      vty_out (vty, "%s", VTY_NEWLINE);
+      vty_out (vty, "  %lu messages, %llu bytes, %lu bytes queued%s",
+               c->messages, c->bytes, (unsigned long) c->backlog,
+               VTY_NEWLINE);
+      vty_out (vty, "  %lu connects, %lu resets%s", c->connects, c->resets,
+               VTY_NEWLINE);
+    }
+  return CMD_SUCCESS;
+}
+
+int
+bgp_bmp_config_write (struct vty *vty)
+{
+  struct bmp_collector *c;
+  struct listnode *node;
+  int write = 0;
+
+  for (ALL_LIST_ELEMENTS_RO (bmp_collectors, node, c))
+    {
+      if (c->port == BMP_PORT_DEFAULT)
+        vty_out (vty, "bmp collector %s%s", bmp_name (c),
+                 VTY_NEWLINE);
+      else
+        vty_out (vty, "bmp collector %s %u%s", bmp_name (c),
+                 c->port, VTY_NEWLINE);
+      write++;
+    }
+  if (bmp_stats_time != BMP_STATS_INTERVAL_DEFAULT)
+    {
+      vty_out (vty, "bmp stats-interval %d%s", bmp_stats_time,
+               VTY_NEWLINE);
+      write++;
+    }
+  return write;
+}
+
+void
+bgp_bmp_init (void)
+{
+  bmp_collectors = list_new ();
+  bmp_s = stream_new (BGP_MAX_PACKET_SIZE * 2);
+
+  install_element (CONFIG_NODE, &bmp_collector_cmd);
+  install_element (CONFIG_NODE, &bmp_collector_default_port_cmd);
+  install_element (CONFIG_NODE, &no_bmp_collector_cmd);
+  install_element (CONFIG_NODE, &no_bmp_collector_default_port_cmd);
+  install_element (CONFIG_NODE, &bmp_stats_interval_cmd);
+  install_element (CONFIG_NODE, &no_bmp_stats_interval_cmd);
+  install_element (VIEW_NODE, &show_bmp_cmd);
+  install_element (ENABLE_NODE, &show_bmp_cmd);
+}
+
+void
+bgp_bmp_finish (void)
+{
+  struct bmp_collector *c;
+
+  while (listhead (bmp_collectors))
+    {
+      c = listgetdata (listhead (bmp_collectors));
+      bmp_terminate (c);
+      listnode_delete (bmp_collectors, c);
+      XFREE (MTYPE_BGP_BMP, c);
+    }
+  list_delete (bmp_collectors);
+  bmp_collectors = NULL;
+  stream_free (bmp_s);
+  bmp_s = NULL;
+}
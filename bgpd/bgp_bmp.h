@@ -0,0 +1,40 @@
+/* BGP Monitoring Protocol (RFC 7854).
+   Copyright (C) 2026 The Quagga project
+
+This file is part of GNU Zebra.
+
+GNU Zebra is free software; you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation; either version 2, or (at your option) any
+later version.
+
+GNU Zebra is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with GNU Zebra; see the file COPYING.  If not, write to the Free
+Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+02111-1307, USA.  */
+
+#ifndef _QUAGGA_BGP_BMP_H
+#define _QUAGGA_BGP_BMP_H
+
+/* BMP message types. */
+#define BMP_ROUTE_MONITORING      0
+#define BMP_STATISTICS_REPORT     1
+#define BMP_PEER_DOWN             2
+#define BMP_PEER_UP               3
+#define BMP_INITIATION            4
+#define BMP_TERMINATION           5
+
+extern void bgp_bmp_init (void);
+extern void bgp_bmp_finish (void);
+extern int bgp_bmp_config_write (struct vty *);
+extern void bgp_bmp_peer_up (struct peer *);
+extern void bgp_bmp_peer_down (struct peer *);
+extern void bgp_bmp_route (struct peer *, struct prefix *, struct attr *,
+                           afi_t, safi_t, int post_policy);
+
+#endif /* _QUAGGA_BGP_BMP_H */
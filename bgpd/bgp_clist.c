@@ -23,6 +23,7 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #include "command.h"
 #include "prefix.h"
 #include "memory.h"
+#include "hash.h"
 
 #include "bgpd/bgpd.h"
 #include "bgpd/bgp_community.h"
@@ -47,6 +48,14 @@ community_list_master_lookup (struct community_list_handler *ch, int master)
   return NULL;
 }
 
+static const char *
+community_list_name (const void *arg)
+{
+  const struct community_list *list = arg;
+
+  return list->name;
+}
+
 /* Allocate a new community list entry.  */
 static struct community_entry *
 community_entry_new (void)
@@ -119,6 +128,11 @@ community_list_insert (struct community_list_handler *ch,
   /* Allocate new community_list and copy given name. */
   new = community_list_new ();
   new->name = XSTRDUP (MTYPE_COMMUNITY_LIST_NAME, name);
+  new->master = cm;
+
+  if (! cm->hash)
+    cm->hash = hash_create_name (community_list_name);
+  hash_get (cm->hash, new, hash_alloc_intern);
 
   /* If name is made by all digit character.  We treat it as
      number. */
@@ -198,24 +212,16 @@ struct community_list *
 community_list_lookup (struct community_list_handler *ch,
 		       const char *name, int master)
 {
-  struct community_list *list;
   struct community_list_master *cm;
 
   if (!name)
     return NULL;
 
   cm = community_list_master_lookup (ch, master);
-  if (!cm)
+  if (!cm || !cm->hash)
     return NULL;
 
-  for (list = cm->num.head; list; list = list->next)
-    if (strcmp (list->name, name) == 0)
-      return list;
-  for (list = cm->str.head; list; list = list->next)
-    if (strcmp (list->name, name) == 0)
-      return list;
-
-  return NULL;
+  return hash_lookup_name (cm->hash, name);
 }
 
 static struct community_list *
@@ -254,6 +260,8 @@ community_list_delete (struct community_list *list)
   else
     clist->head = list->next;
 
+  hash_release (list->master->hash, list);
+
   community_list_free (list);
 }
 
@@ -434,7 +442,7 @@ community_list_match (struct community *com, struct community_list *list)
 
       if (entry->style == COMMUNITY_LIST_STANDARD)
         {
-          if (community_include (entry->u.com, COMMUNITY_INTERNET))
+          if (entry->internet)
             return entry->direct == COMMUNITY_PERMIT ? 1 : 0;
 
           if (community_match (com, entry->u.com))
@@ -488,7 +496,7 @@ community_list_exact_match (struct community *com,
 
       if (entry->style == COMMUNITY_LIST_STANDARD)
         {
-          if (community_include (entry->u.com, COMMUNITY_INTERNET))
+          if (entry->internet)
             return entry->direct == COMMUNITY_PERMIT ? 1 : 0;
 
           if (community_cmp (com, entry->u.com))
@@ -527,7 +535,7 @@ community_list_match_delete (struct community *com,
         }
 
       if ((entry->style == COMMUNITY_LIST_STANDARD) 
-          && (community_include (entry->u.com, COMMUNITY_INTERNET)
+          && (entry->internet
               || community_match (com, entry->u.com) ))
         {
               if (entry->direct == COMMUNITY_PERMIT)
@@ -637,6 +645,7 @@ community_list_set (struct community_list_handler *ch,
   entry->style = style;
   entry->any = (str ? 0 : 1);
   entry->u.com = com;
+  entry->internet = (com && community_include (com, COMMUNITY_INTERNET));
   entry->reg = regex;
   entry->config = (regex ? XSTRDUP (MTYPE_COMMUNITY_LIST_CONFIG, str) : NULL);
 
@@ -840,12 +849,16 @@ community_list_terminate (struct community_list_handler *ch)
     community_list_delete (list);
   while ((list = cm->str.head) != NULL)
     community_list_delete (list);
+  if (cm->hash)
+    hash_free (cm->hash);
 
   cm = &ch->extcommunity_list;
   while ((list = cm->num.head) != NULL)
     community_list_delete (list);
   while ((list = cm->str.head) != NULL)
     community_list_delete (list);
+  if (cm->hash)
+    hash_free (cm->hash);
 
   XFREE (MTYPE_COMMUNITY_LIST_HANDLER, ch);
 }
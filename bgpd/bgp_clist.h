@@ -51,6 +51,9 @@ struct community_list
   /* Link to upper list.  */
   struct community_list_list *parent;
 
+  /* Master the list is in.  */
+  struct community_list_master *master;
+
   /* Linked list for other community-list.  */
   struct community_list *next;
   struct community_list *prev;
@@ -75,6 +78,9 @@ struct community_entry
   /* Any match.  */
   u_char any;
 
+  /* Standard entry including "internet", which matches anything.  */
+  u_char internet;
+
   /* Community structure.  */
   union
   {
@@ -101,6 +107,9 @@ struct community_list_master
 {
   struct community_list_list num;
   struct community_list_list str;
+
+  /* Community-lists by name.  */
+  struct hash *hash;
 };
 
 /* Community-list handler.  community_list_init() returns this
@@ -130,11 +130,40 @@ community_compare (const void *a1, const void *a2)
   return 0;
 }
 
+/* Binary search for a value, in host order, among the sorted values
+   of com. */
+static int
+community_bsearch (const struct community *com, u_int32_t val)
+{
+  int lo = 0;
+  int hi = com->size - 1;
+  int mid;
+  u_int32_t v;
+
+  while (lo <= hi)
+    {
+      mid = (lo + hi) / 2;
+      memcpy (&v, com_nthval (com, mid), sizeof (u_int32_t));
+      v = ntohl (v);
+      if (v == val)
+	return 1;
+      if (v < val)
+	lo = mid + 1;
+      else
+	hi = mid - 1;
+    }
+  return 0;
+}
+
 int
 community_include (struct community *com, u_int32_t val)
 {
   int i;
 
+  /* Interned values are kept sorted, see community_intern(). */
+  if (com->refcnt)
+    return community_bsearch (com, val);
+
   val = htonl (val);
 
   for (i = 0; i < com->size; i++)
@@ -144,43 +173,32 @@ community_include (struct community *com, u_int32_t val)
   return 0;
 }
 
-static u_int32_t
-community_val_get (struct community *com, int i)
-{
-  u_char *p;
-  u_int32_t val;
-
-  p = (u_char *) com->val;
-  p += (i * 4);
-
-  memcpy (&val, p, sizeof (u_int32_t));
-
-  return ntohl (val);
-}
-
 /* Sort and uniq given community. */
 struct community *
 community_uniq_sort (struct community *com)
 {
   int i;
+  int n;
   struct community *new;
-  u_int32_t val;
 
   if (! com)
     return NULL;
   
-  new = community_new ();;
-  
-  for (i = 0; i < com->size; i++)
-    {
-      val = community_val_get (com, i);
+  new = community_new ();
 
-      if (! community_include (new, val))
-	community_add_val (new, val);
+  if (com->size)
+    {
+      new->val = XMALLOC (MTYPE_COMMUNITY_VAL, com_length (com));
+      memcpy (new->val, com->val, com_length (com));
+      qsort (new->val, com->size, sizeof (u_int32_t), community_compare);
+
+      /* Duplicates are now next to each other. */
+      for (i = 1, n = 1; i < com->size; i++)
+	if (new->val[i] != new->val[n - 1])
+	  new->val[n++] = new->val[i];
+      new->size = n;
     }
 
-  qsort (new->val, new->size, sizeof (u_int32_t), community_compare);
-
   return new;
 }
 
@@ -298,9 +316,20 @@ community_intern (struct community *com)
 {
   struct community *find;
 
+  int i;
+
   /* Assert this community structure is not interned. */
   assert (com->refcnt == 0);
 
+  /* Most values come through community_uniq_sort() already; sort the
+     odd one which didn't, so that lookups can rely on the order. */
+  for (i = 1; i < com->size; i++)
+    if (community_compare (com_nthval (com, i - 1), com_nthval (com, i)) > 0)
+      {
+	qsort (com->val, com->size, sizeof (u_int32_t), community_compare);
+	break;
+      }
+
   /* Lookup community hash. */
   find = (struct community *) hash_get (comhash, com, hash_alloc_intern);
 
@@ -425,6 +454,21 @@ community_match (const struct community *com1, const struct community *com2)
   if (com1->size < com2->size)
     return 0;
 
+  /* A handful of values, as matched by most community-lists, is
+     quicker looked up one by one in the sorted com1. */
+  if (com2->size <= 4)
+    {
+      u_int32_t val;
+
+      for (j = 0; j < com2->size; j++)
+	{
+	  memcpy (&val, com_nthval (com2, j), sizeof (u_int32_t));
+	  if (! community_bsearch (com1, ntohl (val)))
+	    return 0;
+	}
+      return 1;
+    }
+
   /* Every community on com2 needs to be on com1 for this to match */
   while (i < com1->size && j < com2->size)
     {
@@ -637,8 +681,10 @@ community_hash (void)
 void
 community_init (void)
 {
-  comhash = hash_create ((unsigned int (*) (void *))community_hash_make,
-			 (int (*) (const void *, const void *))community_cmp);
+  comhash = hash_create_open (0,
+			      (unsigned int (*) (void *))community_hash_make,
+			      (int (*) (const void *, const void *))community_cmp);
+  hash_set_name (comhash, "BGP communities");
 }
 
 void
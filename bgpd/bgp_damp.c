@@ -28,8 +28,8 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #include "thread.h"
 
 #include "bgpd/bgpd.h"
-#include "bgpd/bgp_damp.h"
 #include "bgpd/bgp_table.h"
+#include "bgpd/bgp_damp.h"
 #include "bgpd/bgp_route.h"
 #include "bgpd/bgp_attr.h" 
 #include "bgpd/bgp_advertise.h"
@@ -43,12 +43,16 @@ static struct bgp_damp_config *damp = &bgp_damp_cfg;
 #define BGP_DAMP_LIST_ADD(N,A)  BGP_INFO_ADD(N,A,no_reuse_list)
 #define BGP_DAMP_LIST_DEL(N,A)  BGP_INFO_DEL(N,A,no_reuse_list)
 
-/* Calculate reuse list index by penalty value.  */
+/* Calculate reuse list index by penalty value.  A route is looked at
+   no later than when it has been suppressed for max-suppress-time, so
+   that limit is enforced by the reuse timer rather than by waiting for
+   the next scan of the whole table.  */
 static int
-bgp_reuse_index (int penalty)
+bgp_reuse_index (int penalty, time_t suppress_time)
 {
   unsigned int i;
   int index;
+  time_t left;
 
   i = (int)(((double) penalty / damp->reuse_limit - 1.0) * damp->scale_factor);
   
@@ -57,6 +61,12 @@ bgp_reuse_index (int penalty)
 
   index = damp->reuse_index[i] - damp->reuse_index[0];
 
+  left = suppress_time + damp->max_suppress_time - bgp_clock ();
+  if (left <= 0)
+    index = 0;
+  else if ((left + DELTA_REUSE - 1) / DELTA_REUSE < index)
+    index = (left + DELTA_REUSE - 1) / DELTA_REUSE;
+
   return (damp->reuse_offset + index) % damp->reuse_list_size;  
 }
 
@@ -66,7 +76,7 @@ bgp_reuse_list_add (struct bgp_damp_info *bdi)
 {
   int index;
 
-  index = bdi->index = bgp_reuse_index (bdi->penalty);
+  index = bdi->index = bgp_reuse_index (bdi->penalty, bdi->suppress_time);
 
   bdi->prev = NULL;
   bdi->next = damp->reuse_list[index];
@@ -144,19 +154,26 @@ bgp_reuse_timer (struct thread *t)
       /* Set t-updated = t-now.  */
       bdi->t_updated = t_now;
 
+      /* A route suppressed for max-suppress-time is reused regardless,
+         with its penalty brought down to the reuse limit as in
+         bgp_damp_scan().  */
+      if (bdi->penalty >= damp->reuse_limit
+          && t_now - bdi->suppress_time >= damp->max_suppress_time)
+        bdi->penalty = damp->reuse_limit - 1;
+
       /* if (figure-of-merit < reuse).  */
       if (bdi->penalty < damp->reuse_limit)
 	{
 	  /* Reuse the route.  */
-	  bgp_info_unset_flag (bdi->rn, bdi->binfo, BGP_INFO_DAMPED);
+	  bgp_info_unset_flag (bdi->binfo->net, bdi->binfo, BGP_INFO_DAMPED);
 	  bdi->suppress_time = 0;
 
 	  if (bdi->lastrecord == BGP_RECORD_UPDATE)
 	    {
-	      bgp_info_unset_flag (bdi->rn, bdi->binfo, BGP_INFO_HISTORY);
-	      bgp_aggregate_increment (bgp, &bdi->rn->p, bdi->binfo,
+	      bgp_info_unset_flag (bdi->binfo->net, bdi->binfo, BGP_INFO_HISTORY);
+	      bgp_aggregate_increment (bgp, &bdi->binfo->net->p, bdi->binfo,
 				       bdi->afi, bdi->safi);   
-	      bgp_process (bgp, bdi->rn, bdi->afi, bdi->safi);
+	      bgp_process (bgp, bdi->binfo->net, bdi->afi, bdi->safi);
 	    }
 
 	  if (bdi->penalty <= damp->reuse_limit / 2.0)
@@ -198,7 +215,6 @@ bgp_damp_withdraw (struct bgp_info *binfo, struct bgp_node *rn,
 
       bdi =  XCALLOC (MTYPE_BGP_DAMP_INFO, sizeof (struct bgp_damp_info));
       bdi->binfo = binfo;
-      bdi->rn = rn;
       bdi->penalty = (attr_change ? DEFAULT_PENALTY / 2 : DEFAULT_PENALTY);
       bdi->flap = 1;
       bdi->start_time = t_now;
@@ -224,7 +240,7 @@ bgp_damp_withdraw (struct bgp_info *binfo, struct bgp_node *rn,
       bdi->flap++;
     }
   
-  assert ((rn == bdi->rn) && (binfo == bdi->binfo));
+  assert ((rn == binfo->net) && (binfo == bdi->binfo));
   
   bdi->lastrecord = BGP_RECORD_WITHDRAW;
   bdi->t_updated = t_now;
@@ -315,7 +331,7 @@ bgp_damp_scan (struct bgp_info *binfo, afi_t afi, safi_t safi)
 
       if (t_diff >= damp->max_suppress_time)
         {
-          bgp_info_unset_flag (bdi->rn, binfo, BGP_INFO_DAMPED);
+          bgp_info_unset_flag (bdi->binfo->net, binfo, BGP_INFO_DAMPED);
           bgp_reuse_list_delete (bdi);
 	  BGP_DAMP_LIST_ADD (damp, bdi);
           bdi->penalty = damp->reuse_limit;
@@ -362,10 +378,10 @@ bgp_damp_info_free (struct bgp_damp_info *bdi, int withdraw)
   else
     BGP_DAMP_LIST_DEL (damp, bdi);
 
-  bgp_info_unset_flag (bdi->rn, binfo, BGP_INFO_HISTORY|BGP_INFO_DAMPED);
+  bgp_info_unset_flag (bdi->binfo->net, binfo, BGP_INFO_HISTORY|BGP_INFO_DAMPED);
 
   if (bdi->lastrecord == BGP_RECORD_WITHDRAW && withdraw)
-    bgp_info_delete (bdi->rn, binfo);
+    bgp_info_delete (bdi->binfo->net, binfo);
   
   XFREE (MTYPE_BGP_DAMP_INFO, bdi);
 }
@@ -44,22 +44,19 @@ struct bgp_damp_info
   /* Time of route start to be suppressed.  */
   time_t suppress_time;
 
-  /* Back reference to bgp_info. */
+  /* Back reference to bgp_info, whose net is the bgp_node. */
   struct bgp_info *binfo;
 
-  /* Back reference to bgp_node. */
-  struct bgp_node *rn;
-
   /* Current index in the reuse_list. */
   int index;
 
+  afi_t afi;
+  safi_t safi;
+
   /* Last time message type. */
   u_char lastrecord;
 #define BGP_RECORD_UPDATE	1U
 #define BGP_RECORD_WITHDRAW	2U
-
-  afi_t afi;
-  safi_t safi;
 };
 
 /* Specified parameter set configuration. */
@@ -19,6 +19,7 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 02111-1307, USA.  */
 
 #include <zebra.h>
+#include <sys/wait.h>
 
 #include "log.h"
 #include "stream.h"
@@ -27,6 +28,7 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #include "prefix.h"
 #include "thread.h"
 #include "linklist.h"
+#include "buffer.h"
 #include "bgpd/bgp_table.h"
 
 #include "bgpd/bgpd.h"
@@ -41,23 +43,6 @@ enum bgp_dump_type
   BGP_DUMP_ROUTES
 };
 
-enum MRT_MSG_TYPES {
-   MSG_NULL,
-   MSG_START,                   /* sender is starting up */
-   MSG_DIE,                     /* receiver should shut down */
-   MSG_I_AM_DEAD,               /* sender is shutting down */
-   MSG_PEER_DOWN,               /* sender's peer is down */
-   MSG_PROTOCOL_BGP,            /* msg is a BGP packet */
-   MSG_PROTOCOL_RIP,            /* msg is a RIP packet */
-   MSG_PROTOCOL_IDRP,           /* msg is an IDRP packet */
-   MSG_PROTOCOL_RIPNG,          /* msg is a RIPNG packet */
-   MSG_PROTOCOL_BGP4PLUS,       /* msg is a BGP4+ packet */
-   MSG_PROTOCOL_BGP4PLUS_01,    /* msg is a BGP4+ (draft 01) packet */
-   MSG_PROTOCOL_OSPF,           /* msg is an OSPF packet */
-   MSG_TABLE_DUMP,              /* routing table dump */
-   MSG_TABLE_DUMP_V2            /* routing table dump, version 2 */
-};
-
 static int bgp_dump_interval_func (struct thread *);
 
 struct bgp_dump
@@ -73,8 +58,23 @@ struct bgp_dump
   char *interval_str;
 
   struct thread *t_interval;
+
+  /* BGP4MP records waiting to be written, so that the receive path
+     does not wait on the file. */
+  struct buffer *obuf;
+  size_t backlog;
+  struct thread *t_write;
+
+  /* Statistics. */
+  unsigned long records;
+  unsigned long bytes;
+  unsigned long drops;
+  unsigned long errors;
 };
 
+/* Records are dropped once this many bytes are waiting to be written. */
+#define BGP_DUMP_BACKLOG_MAX (16 * 1024 * 1024)
+
 /* BGP packet dump output buffer. */
 struct stream *bgp_dump_obuf;
 
@@ -87,9 +87,116 @@ struct bgp_dump bgp_dump_updates;
 /* BGP dump structure for 'dump bgp routes' */
 struct bgp_dump bgp_dump_routes;
 
-/* Dump whole BGP table is very heavy process.  */
+/* Dump whole BGP table is very heavy process, so it is done a slice
+   of nodes at a time from a background thread, holding a lock on the
+   node to resume from.  */
+#define BGP_DUMP_ROUTES_SLICE 1000
+
 struct thread *t_bgp_dump_routes;
+
+static struct
+{
+  struct bgp_table *table;
+  struct bgp_node *rn;
+  afi_t afi;
+  unsigned int seq;
+  unsigned int gen;
+} bgp_dump_routes_walk;
+
+/* Or else, with "dump bgp fork", the whole dump is written at once by a
+   child process, from the copy-on-write image of the RIB as it was at
+   the fork, while the parent carries on.  The child is reaped by a
+   timer polling for it. */
+#define BGP_DUMP_CHILD_POLL 1
+
+static int bgp_dump_fork;
+static pid_t bgp_dump_routes_child;
+static struct thread *t_bgp_dump_routes_child;
 
+/* Write what bgp_dump has buffered, and stop waiting to write more. */
+static void
+bgp_dump_flush (struct bgp_dump *bgp_dump)
+{
+  if (bgp_dump->t_write)
+    {
+      thread_cancel (bgp_dump->t_write);
+      bgp_dump->t_write = NULL;
+    }
+
+  if (bgp_dump->obuf && bgp_dump->fp)
+    if (buffer_flush_all (bgp_dump->obuf, fileno (bgp_dump->fp))
+        == BUFFER_ERROR)
+      {
+        bgp_dump->errors++;
+        buffer_reset (bgp_dump->obuf);
+      }
+  bgp_dump->backlog = 0;
+}
+
+static int
+bgp_dump_write_func (struct thread *t)
+{
+  struct bgp_dump *bgp_dump;
+
+  bgp_dump = THREAD_ARG (t);
+  bgp_dump->t_write = NULL;
+
+  switch (buffer_flush_available (bgp_dump->obuf, fileno (bgp_dump->fp)))
+    {
+    case BUFFER_PENDING:
+      bgp_dump->t_write = thread_add_write (master, bgp_dump_write_func,
+                                            bgp_dump, fileno (bgp_dump->fp));
+      break;
+    case BUFFER_ERROR:
+      zlog_warn ("bgp_dump_write_func: %s: %s", bgp_dump->filename,
+                 safe_strerror (errno));
+      bgp_dump->errors++;
+      buffer_reset (bgp_dump->obuf);
+      /* fall through */
+    case BUFFER_EMPTY:
+      bgp_dump->backlog = 0;
+      break;
+    }
+
+  return 0;
+}
+
+/* Queue the record in obuf for writing to the dump file.  When the
+   file falls too far behind the record is dropped. */
+static void
+bgp_dump_write (struct bgp_dump *bgp_dump, struct stream *obuf)
+{
+  size_t size = stream_get_endp (obuf);
+
+  if (bgp_dump->backlog + size > BGP_DUMP_BACKLOG_MAX)
+    {
+      bgp_dump->drops++;
+      return;
+    }
+
+  if (! bgp_dump->obuf)
+    bgp_dump->obuf = buffer_new (0);
+  buffer_put (bgp_dump->obuf, STREAM_DATA (obuf), size);
+  bgp_dump->backlog += size;
+  bgp_dump->records++;
+  bgp_dump->bytes += size;
+
+  if (! bgp_dump->t_write)
+    bgp_dump->t_write = thread_add_write (master, bgp_dump_write_func,
+                                          bgp_dump, fileno (bgp_dump->fp));
+}
+
+static void
+bgp_dump_close_file (struct bgp_dump *bgp_dump)
+{
+  if (bgp_dump->fp)
+    {
+      bgp_dump_flush (bgp_dump);
+      fclose (bgp_dump->fp);
+      bgp_dump->fp = NULL;
+    }
+}
+
 /* Some define for BGP packet dump. */
 static FILE *
 bgp_dump_open_file (struct bgp_dump *bgp_dump)
@@ -118,9 +225,7 @@ bgp_dump_open_file (struct bgp_dump *bgp_dump)
       return NULL;
     }
 
-  if (bgp_dump->fp)
-    fclose (bgp_dump->fp);
-
+  bgp_dump_close_file (bgp_dump);
 
   oldumask = umask(0777 & ~LOGFILE_MASK);
   bgp_dump->fp = fopen (realpath, "w");
@@ -261,6 +366,7 @@ bgp_dump_routes_index_table(struct bgp *bgp)
 
       /* Store the peer number for this peer */
       peer->table_dump_index = peerno;
+      peer->table_dump_gen = bgp_dump_routes_walk.gen;
       peerno++;
     }
 
@@ -271,115 +377,288 @@ bgp_dump_routes_index_table(struct bgp *bgp)
 }
 
 
-/* Runs under child process. */
-static unsigned int
-bgp_dump_routes_func (int afi, int first_run, unsigned int seq)
+/* Dump the paths of rn as one RIB entry.  Paths from peers that came
+   up after the index table was written have no index, and are left
+   out. */
+static void
+bgp_dump_routes_node (struct bgp_node *rn, afi_t afi, unsigned int seq)
 {
   struct stream *obuf;
   struct bgp_info *info;
-  struct bgp_node *rn;
-  struct bgp *bgp;
-  struct bgp_table *table;
 
-  bgp = bgp_get_default ();
-  if (!bgp)
-    return seq;
+  obuf = bgp_dump_obuf;
+  stream_reset(obuf);
 
-  if (bgp_dump_routes.fp == NULL)
-    return seq;
+  /* MRT header */
+  if (afi == AFI_IP)
+    {
+      bgp_dump_header (obuf, MSG_TABLE_DUMP_V2, TABLE_DUMP_V2_RIB_IPV4_UNICAST);
+    }
+#ifdef HAVE_IPV6
+  else if (afi == AFI_IP6)
+    {
+      bgp_dump_header (obuf, MSG_TABLE_DUMP_V2, TABLE_DUMP_V2_RIB_IPV6_UNICAST);
+    }
+#endif /* HAVE_IPV6 */
 
-  /* Note that bgp_dump_routes_index_table will do ipv4 and ipv6 peers,
-     so this should only be done on the first call to bgp_dump_routes_func.
-     ( this function will be called once for ipv4 and once for ipv6 ) */
-  if(first_run)
-    bgp_dump_routes_index_table(bgp);
+  /* Sequence number */
+  stream_putl(obuf, seq);
 
-  obuf = bgp_dump_obuf;
-  stream_reset(obuf);
+  /* Prefix length */
+  stream_putc (obuf, rn->p.prefixlen);
+
+  /* Prefix */
+  if (afi == AFI_IP)
+    {
+      /* We'll dump only the useful bits (those not 0), but have to align on 8 bits */
+      stream_write(obuf, (u_char *)&rn->p.u.prefix4, (rn->p.prefixlen+7)/8);
+    }
+#ifdef HAVE_IPV6
+  else if (afi == AFI_IP6)
+    {
+      /* We'll dump only the useful bits (those not 0), but have to align on 8 bits */
+      stream_write (obuf, (u_char *)&rn->p.u.prefix6, (rn->p.prefixlen+7)/8);
+    }
+#endif /* HAVE_IPV6 */
+
+  /* Save where we are now, so we can overwride the entry count later */
+  int sizep = stream_get_endp(obuf);
+
+  /* Entry count */
+  uint16_t entry_count = 0;
 
-  /* Walk down each BGP route. */
-  table = bgp->rib[afi][SAFI_UNICAST];
+  /* Entry count, note that this is overwritten later */
+  stream_putw(obuf, 0);
 
-  for (rn = bgp_table_top (table); rn; rn = bgp_route_next (rn))
+  for (info = rn->info; info; info = info->next)
     {
-      if(!rn->info)
+      if (info->peer->table_dump_gen != bgp_dump_routes_walk.gen)
         continue;
 
-      stream_reset(obuf);
+      entry_count++;
+
+      /* Peer index */
+      stream_putw(obuf, info->peer->table_dump_index);
+
+      /* Originated */
+#ifdef HAVE_CLOCK_MONOTONIC
+      stream_putl (obuf, time(NULL) - (bgp_clock() - info->uptime));
+#else
+      stream_putl (obuf, info->uptime);
+#endif /* HAVE_CLOCK_MONOTONIC */
+
+      /* Dump attribute. */
+      /* Skip prefix & AFI/SAFI for MP_NLRI */
+      bgp_dump_routes_attr (obuf, info->attr, &rn->p);
+    }
+
+  /* Overwrite the entry count, now that we know the right number */
+  stream_putw_at (obuf, sizep, entry_count);
+
+  bgp_dump_set_size(obuf, MSG_TABLE_DUMP_V2);
+  fwrite (STREAM_DATA (obuf), stream_get_endp (obuf), 1, bgp_dump_routes.fp);
+}
+
+/* Release what the route dump holds, and close its file. */
+static void
+bgp_dump_routes_stop (void)
+{
+  if (bgp_dump_routes_child > 0)
+    {
+      kill (bgp_dump_routes_child, SIGTERM);
+      waitpid (bgp_dump_routes_child, NULL, 0);
+      bgp_dump_routes_child = 0;
+    }
+  if (t_bgp_dump_routes_child)
+    {
+      thread_cancel (t_bgp_dump_routes_child);
+      t_bgp_dump_routes_child = NULL;
+    }
+
+  if (t_bgp_dump_routes)
+    {
+      thread_cancel (t_bgp_dump_routes);
+      t_bgp_dump_routes = NULL;
+    }
+
+  if (bgp_dump_routes_walk.rn)
+    bgp_unlock_node (bgp_dump_routes_walk.rn);
+  bgp_dump_routes_walk.rn = NULL;
+
+  if (bgp_dump_routes_walk.table)
+    bgp_table_unlock (bgp_dump_routes_walk.table);
+  bgp_dump_routes_walk.table = NULL;
+
+  /* For a RIB dump there's no point in leaving the file open until the
+     next scheduled dump starts. */
+  bgp_dump_close_file (&bgp_dump_routes);
+}
+
+/* Start walking the table of afi, or finish the dump if there is no
+   further address family to dump. */
+static void
+bgp_dump_routes_table (struct bgp *bgp, afi_t afi)
+{
+  if (bgp_dump_routes_walk.table)
+    bgp_table_unlock (bgp_dump_routes_walk.table);
+  bgp_dump_routes_walk.table = NULL;
 
-      /* MRT header */
-      if (afi == AFI_IP)
-        {
-          bgp_dump_header (obuf, MSG_TABLE_DUMP_V2, TABLE_DUMP_V2_RIB_IPV4_UNICAST);
-        }
 #ifdef HAVE_IPV6
-      else if (afi == AFI_IP6)
-        {
-          bgp_dump_header (obuf, MSG_TABLE_DUMP_V2, TABLE_DUMP_V2_RIB_IPV6_UNICAST);
-        }
+  if (afi > AFI_IP6)
+#else
+  if (afi > AFI_IP)
 #endif /* HAVE_IPV6 */
+    {
+      fflush (bgp_dump_routes.fp);
+      bgp_dump_routes_stop ();
+      return;
+    }
 
-      /* Sequence number */
-      stream_putl(obuf, seq);
+  bgp_dump_routes_walk.afi = afi;
+  bgp_dump_routes_walk.table = bgp->rib[afi][SAFI_UNICAST];
+  bgp_table_lock (bgp_dump_routes_walk.table);
+  bgp_dump_routes_walk.rn = bgp_table_top (bgp_dump_routes_walk.table);
+}
 
-      /* Prefix length */
-      stream_putc (obuf, rn->p.prefixlen);
+static int
+bgp_dump_routes_func (struct thread *t)
+{
+  struct bgp *bgp;
+  struct bgp_node *rn;
+  unsigned int count = 0;
 
-      /* Prefix */
-      if (afi == AFI_IP)
-        {
-          /* We'll dump only the useful bits (those not 0), but have to align on 8 bits */
-          stream_write(obuf, (u_char *)&rn->p.u.prefix4, (rn->p.prefixlen+7)/8);
-        }
-#ifdef HAVE_IPV6
-      else if (afi == AFI_IP6)
+  t_bgp_dump_routes = NULL;
+
+  /* The view may have gone away while the dump was paused. */
+  bgp = bgp_get_default ();
+  if (!bgp)
+    {
+      bgp_dump_routes_stop ();
+      return 0;
+    }
+
+  while (bgp_dump_routes_walk.table)
+    {
+      for (rn = bgp_dump_routes_walk.rn; rn; rn = bgp_route_next (rn))
         {
-          /* We'll dump only the useful bits (those not 0), but have to align on 8 bits */
-          stream_write (obuf, (u_char *)&rn->p.u.prefix6, (rn->p.prefixlen+7)/8);
+          if (count++ == BGP_DUMP_ROUTES_SLICE)
+            {
+              bgp_dump_routes_walk.rn = rn;
+              t_bgp_dump_routes = thread_add_background (master,
+                                                bgp_dump_routes_func, NULL, 0);
+              return 0;
+            }
+
+          if (!rn->info)
+            continue;
+
+          bgp_dump_routes_node (rn, bgp_dump_routes_walk.afi,
+                                bgp_dump_routes_walk.seq++);
         }
-#endif /* HAVE_IPV6 */
 
-      /* Save where we are now, so we can overwride the entry count later */
-      int sizep = stream_get_endp(obuf);
+      bgp_dump_routes_walk.rn = NULL;
+      bgp_dump_routes_table (bgp, bgp_dump_routes_walk.afi + 1);
+    }
+
+  return 0;
+}
 
-      /* Entry count */
-      uint16_t entry_count = 0;
+static int
+bgp_dump_routes_child_poll (struct thread *t)
+{
+  int status;
+  pid_t pid;
 
-      /* Entry count, note that this is overwritten later */
-      stream_putw(obuf, 0);
+  t_bgp_dump_routes_child = NULL;
 
-      for (info = rn->info; info; info = info->next)
-        {
-          entry_count++;
+  pid = waitpid (bgp_dump_routes_child, &status, WNOHANG);
+  if (pid == 0)
+    {
+      t_bgp_dump_routes_child =
+        thread_add_timer (master, bgp_dump_routes_child_poll, NULL,
+                          BGP_DUMP_CHILD_POLL);
+      return 0;
+    }
 
-          /* Peer index */
-          stream_putw(obuf, info->peer->table_dump_index);
+  if (pid < 0 || ! WIFEXITED (status) || WEXITSTATUS (status) != 0)
+    zlog_warn ("bgp_dump_routes: dump process %d failed",
+               (int) bgp_dump_routes_child);
+  bgp_dump_routes_child = 0;
+  return 0;
+}
 
-          /* Originated */
-#ifdef HAVE_CLOCK_MONOTONIC
-          stream_putl (obuf, time(NULL) - (bgp_clock() - info->uptime));
-#else
-          stream_putl (obuf, info->uptime);
-#endif /* HAVE_CLOCK_MONOTONIC */
+/* In the child: write the whole dump, and leave without running
+   anything of the parent's. */
+static void
+bgp_dump_routes_child_run (struct bgp *bgp)
+{
+  struct bgp_node *rn;
+  afi_t afi;
 
-          /* Dump attribute. */
-          /* Skip prefix & AFI/SAFI for MP_NLRI */
-          bgp_dump_routes_attr (obuf, info->attr, &rn->p);
-        }
+  signal (SIGTERM, SIG_DFL);
+
+  bgp_dump_routes_index_table (bgp);
+
+#ifdef HAVE_IPV6
+  for (afi = AFI_IP; afi <= AFI_IP6; afi++)
+#else
+  for (afi = AFI_IP; afi <= AFI_IP; afi++)
+#endif /* HAVE_IPV6 */
+    for (rn = bgp_table_top (bgp->rib[afi][SAFI_UNICAST]); rn;
+         rn = bgp_route_next (rn))
+      if (rn->info)
+        bgp_dump_routes_node (rn, afi, bgp_dump_routes_walk.seq++);
+
+  if (fclose (bgp_dump_routes.fp) != 0)
+    _exit (1);
+  _exit (0);
+}
 
-      /* Overwrite the entry count, now that we know the right number */
-      stream_putw_at (obuf, sizep, entry_count);
+/* Write the index table and schedule the walk of the RIB.  The file is
+   closed once the walk is done. */
+static void
+bgp_dump_routes_start (void)
+{
+  struct bgp *bgp;
+  pid_t pid;
 
-      seq++;
+  bgp = bgp_get_default ();
+  if (!bgp)
+    {
+      bgp_dump_routes_stop ();
+      return;
+    }
 
-      bgp_dump_set_size(obuf, MSG_TABLE_DUMP_V2);
-      fwrite (STREAM_DATA (obuf), stream_get_endp (obuf), 1, bgp_dump_routes.fp);
+  bgp_dump_routes_walk.gen++;
+  bgp_dump_routes_walk.seq = 0;
 
+  if (bgp_dump_fork)
+    {
+      pid = fork ();
+      if (pid == 0)
+        bgp_dump_routes_child_run (bgp);
+      if (pid > 0)
+        {
+          /* Nothing was written to the parent's copy of the file. */
+          fclose (bgp_dump_routes.fp);
+          bgp_dump_routes.fp = NULL;
+
+          bgp_dump_routes_child = pid;
+          t_bgp_dump_routes_child =
+            thread_add_timer (master, bgp_dump_routes_child_poll, NULL,
+                              BGP_DUMP_CHILD_POLL);
+          return;
+        }
+      zlog_warn ("bgp_dump_routes: fork failed: %s, dumping in process",
+                 safe_strerror (errno));
     }
 
-  fflush (bgp_dump_routes.fp);
+  /* Note that bgp_dump_routes_index_table will do ipv4 and ipv6 peers. */
+  bgp_dump_routes_index_table (bgp);
 
-  return seq;
+  bgp_dump_routes_table (bgp, AFI_IP);
+  t_bgp_dump_routes = thread_add_background (master, bgp_dump_routes_func,
+                                             NULL, 0);
 }
 
 static int
@@ -389,20 +668,18 @@ bgp_dump_interval_func (struct thread *t)
   bgp_dump = THREAD_ARG (t);
   bgp_dump->t_interval = NULL;
 
+  /* A route dump still being written is not cut short by the next. */
+  if (bgp_dump->type == BGP_DUMP_ROUTES
+      && (bgp_dump_routes_walk.table || bgp_dump_routes_child))
+    zlog_warn ("bgp_dump_interval_func: previous route dump still running,"
+               " skipping this one");
+
   /* Reschedule dump even if file couldn't be opened this time... */
-  if (bgp_dump_open_file (bgp_dump) != NULL)
+  else if (bgp_dump_open_file (bgp_dump) != NULL)
     {
       /* In case of bgp_dump_routes, we need special route dump function. */
       if (bgp_dump->type == BGP_DUMP_ROUTES)
-	{
-	  unsigned int seq = bgp_dump_routes_func (AFI_IP, 1, 0);
-#ifdef HAVE_IPV6
-	  bgp_dump_routes_func (AFI_IP6, 0, seq);
-#endif /* HAVE_IPV6 */
-	  /* Close the file now. For a RIB dump there's no point in leaving
-	   * it open until the next scheduled dump starts. */
-	  fclose(bgp_dump->fp); bgp_dump->fp = NULL;
-	}
+	bgp_dump_routes_start ();
     }
 
   /* if interval is set reschedule */
@@ -484,8 +761,7 @@ bgp_dump_state (struct peer *peer, int status_old, int status_new)
   bgp_dump_set_size (obuf, MSG_PROTOCOL_BGP4MP);
 
   /* Write to the stream. */
-  fwrite (STREAM_DATA (obuf), stream_get_endp (obuf), 1, bgp_dump_all.fp);
-  fflush (bgp_dump_all.fp);
+  bgp_dump_write (&bgp_dump_all, obuf);
 }
 
 static void
@@ -520,8 +796,7 @@ bgp_dump_packet_func (struct bgp_dump *bgp_dump, struct peer *peer,
   bgp_dump_set_size (obuf, MSG_PROTOCOL_BGP4MP);
 
   /* Write to the stream. */
-  fwrite (STREAM_DATA (obuf), stream_get_endp (obuf), 1, bgp_dump->fp);
-  fflush (bgp_dump->fp);
+  bgp_dump_write (bgp_dump, obuf);
 }
 
 /* Called from bgp_packet.c when BGP packet is received. */
@@ -632,6 +907,10 @@ bgp_dump_set (struct vty *vty, struct bgp_dump *bgp_dump,
     free (bgp_dump->filename);
   bgp_dump->filename = strdup (path);
 
+  /* A route dump still being written would go on in the new file. */
+  if (bgp_dump == &bgp_dump_routes)
+    bgp_dump_routes_stop ();
+
   /* This should be called when interval is expired. */
   bgp_dump_open_file (bgp_dump);
 
@@ -641,6 +920,9 @@ bgp_dump_set (struct vty *vty, struct bgp_dump *bgp_dump,
 static int
 bgp_dump_unset (struct vty *vty, struct bgp_dump *bgp_dump)
 {
+  if (bgp_dump == &bgp_dump_routes)
+    bgp_dump_routes_stop ();
+
   /* Set file name. */
   if (bgp_dump->filename)
     {
@@ -649,10 +931,12 @@ bgp_dump_unset (struct vty *vty, struct bgp_dump *bgp_dump)
     }
 
   /* This should be called when interval is expired. */
-  if (bgp_dump->fp)
+  bgp_dump_close_file (bgp_dump);
+
+  if (bgp_dump->obuf)
     {
-      fclose (bgp_dump->fp);
-      bgp_dump->fp = NULL;
+      buffer_free (bgp_dump->obuf);
+      bgp_dump->obuf = NULL;
     }
 
   /* Create interval thread. */
@@ -776,6 +1060,53 @@ DEFUN (no_dump_bgp_routes,
   return bgp_dump_unset (vty, &bgp_dump_routes);
 }
 
+DEFUN (dump_bgp_fork,
+       dump_bgp_fork_cmd,
+       "dump bgp fork",
+       "Dump packet\n"
+       "BGP packet dump\n"
+       "Write routing table dumps from a child process\n")
+{
+  bgp_dump_fork = 1;
+  return CMD_SUCCESS;
+}
+
+DEFUN (no_dump_bgp_fork,
+       no_dump_bgp_fork_cmd,
+       "no dump bgp fork",
+       NO_STR
+       "Dump packet\n"
+       "BGP packet dump\n"
+       "Write routing table dumps from a child process\n")
+{
+  bgp_dump_fork = 0;
+  return CMD_SUCCESS;
+}
+
+static void
+bgp_dump_show_statistics (struct vty *vty, const char *name,
+                          struct bgp_dump *bgp_dump)
+{
+  vty_out (vty, "%-8s %10lu %12lu %10lu %10lu %10lu%s", name,
+           bgp_dump->records, bgp_dump->bytes, (unsigned long) bgp_dump->backlog,
+           bgp_dump->drops, bgp_dump->errors, VTY_NEWLINE);
+}
+
+DEFUN (show_dump_bgp_statistics,
+       show_dump_bgp_statistics_cmd,
+       "show dump bgp statistics",
+       SHOW_STR
+       "Dump packet\n"
+       "BGP packet dump\n"
+       "Records written, waiting, and dropped\n")
+{
+  vty_out (vty, "%-8s %10s %12s %10s %10s %10s%s", "Dump", "Records",
+           "Bytes", "Backlog", "Dropped", "Errors", VTY_NEWLINE);
+  bgp_dump_show_statistics (vty, "all", &bgp_dump_all);
+  bgp_dump_show_statistics (vty, "updates", &bgp_dump_updates);
+  return CMD_SUCCESS;
+}
+
 /* BGP node structure. */
 static struct cmd_node bgp_dump_node =
 {
@@ -833,6 +1164,8 @@ config_write_bgp_dump (struct vty *vty)
 	vty_out (vty, "dump bgp updates %s%s", 
 		 bgp_dump_updates.filename, VTY_NEWLINE);
     }
+  if (bgp_dump_fork)
+    vty_out (vty, "dump bgp fork%s", VTY_NEWLINE);
   if (bgp_dump_routes.filename)
     {
       if (bgp_dump_routes.interval_str)
@@ -868,11 +1201,18 @@ bgp_dump_init (void)
   install_element (CONFIG_NODE, &dump_bgp_routes_cmd);
   install_element (CONFIG_NODE, &dump_bgp_routes_interval_cmd);
   install_element (CONFIG_NODE, &no_dump_bgp_routes_cmd);
+  install_element (CONFIG_NODE, &dump_bgp_fork_cmd);
+  install_element (CONFIG_NODE, &no_dump_bgp_fork_cmd);
+  install_element (VIEW_NODE, &show_dump_bgp_statistics_cmd);
+  install_element (ENABLE_NODE, &show_dump_bgp_statistics_cmd);
 }
 
 void
 bgp_dump_finish (void)
 {
+  bgp_dump_routes_stop ();
+  bgp_dump_unset (NULL, &bgp_dump_all);
+  bgp_dump_unset (NULL, &bgp_dump_updates);
   stream_free (bgp_dump_obuf);
   bgp_dump_obuf = NULL;
 }
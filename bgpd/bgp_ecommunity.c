@@ -44,7 +44,7 @@ ecommunity_new (void)
 void
 ecommunity_free (struct ecommunity **ecom)
 {
-  if ((*ecom)->val)
+  if ((*ecom)->val && (*ecom)->val != (*ecom)->data)
     XFREE (MTYPE_ECOMMUNITY_VAL, (*ecom)->val);
   if ((*ecom)->str)
     XFREE (MTYPE_ECOMMUNITY_STR, (*ecom)->str);
@@ -119,12 +119,34 @@ ecommunity_uniq_sort (struct ecommunity *ecom)
   return new;
 }
 
+/* An interned copy holds its values itself, a single allocation. */
+static void *
+ecommunity_hash_alloc (void *arg)
+{
+  struct ecommunity *ecom = arg;
+  struct ecommunity *new;
+
+  new = XMALLOC (MTYPE_ECOMMUNITY,
+		 sizeof (struct ecommunity) + ecom_length (ecom));
+  new->refcnt = 0;
+  new->size = ecom->size;
+  new->val = new->data;
+  memcpy (new->data, ecom->val, ecom_length (ecom));
+
+  /* Keep a string already made. */
+  new->str = ecom->str;
+  ecom->str = NULL;
+
+  return new;
+}
+
 /* Parse Extended Communites Attribute in BGP packet.  */
 struct ecommunity *
 ecommunity_parse (u_int8_t *pnt, u_short length)
 {
   struct ecommunity tmp;
   struct ecommunity *new;
+  int i;
 
   /* Length check.  */
   if (length % ECOMMUNITY_SIZE)
@@ -132,9 +154,23 @@ ecommunity_parse (u_int8_t *pnt, u_short length)
 
   /* Prepare tmporary structure for making a new Extended Communities
      Attribute.  */
+  memset (&tmp, 0, sizeof (struct ecommunity));
   tmp.size = length / ECOMMUNITY_SIZE;
   tmp.val = pnt;
 
+  /* Values usually come sorted and unique already: look them up as
+     they are, only an attribute not seen yet is copied. */
+  for (i = 1; i < tmp.size; i++)
+    if (memcmp (pnt + (i - 1) * ECOMMUNITY_SIZE, pnt + i * ECOMMUNITY_SIZE,
+		ECOMMUNITY_SIZE) >= 0)
+      break;
+  if (i >= tmp.size)
+    {
+      new = hash_get (ecomhash, &tmp, ecommunity_hash_alloc);
+      new->refcnt++;
+      return new;
+    }
+
   /* Create a new Extended Communities Attribute by uniq and sort each
      Extended Communities value  */
   new = ecommunity_uniq_sort (&tmp);
@@ -187,7 +223,8 @@ ecommunity_merge (struct ecommunity *ecom1, struct ecommunity *ecom2)
   return ecom1;
 }
 
-/* Intern Extended Communities Attribute.  */
+/* Intern Extended Communities Attribute.  ECOM is freed, use the
+   result. */
 struct ecommunity *
 ecommunity_intern (struct ecommunity *ecom)
 {
@@ -195,16 +232,11 @@ ecommunity_intern (struct ecommunity *ecom)
 
   assert (ecom->refcnt == 0);
 
-  find = (struct ecommunity *) hash_get (ecomhash, ecom, hash_alloc_intern);
-
-  if (find != ecom)
-    ecommunity_free (&ecom);
-
+  find = (struct ecommunity *) hash_get (ecomhash, ecom,
+					 ecommunity_hash_alloc);
+  ecommunity_free (&ecom);
   find->refcnt++;
 
-  if (! find->str)
-    find->str = ecommunity_ecom2str (find, ECOMMUNITY_FORMAT_DISPLAY);
-
   return find;
 }
 
@@ -269,6 +301,13 @@ void
 ecommunity_init (void)
 {
   ecomhash = hash_create (ecommunity_hash_make, ecommunity_cmp);
+  hash_set_name (ecomhash, "BGP extended communities");
+}
+
+struct hash *
+ecommunity_hash (void)
+{
+  return ecomhash;
 }
 
 void
@@ -53,8 +53,11 @@ struct ecommunity
   /* Extended Communities value.  */
   u_int8_t *val;
 
-  /* Human readable format string.  */
+  /* Human readable format string, made on first use.  */
   char *str;
+
+  /* Where val points once interned. */
+  u_int8_t data[];
 };
 
 /* Extended community value is eight octet.  */
@@ -80,5 +83,6 @@ extern struct ecommunity *ecommunity_str2com (const char *, int, int);
 extern char *ecommunity_ecom2str (struct ecommunity *, int);
 extern int ecommunity_match (const struct ecommunity *, const struct ecommunity *);
 extern char *ecommunity_str (struct ecommunity *);
+extern struct hash *ecommunity_hash (void);
 
 #endif /* _QUAGGA_BGP_ECOMMUNITY_H */
@@ -0,0 +1,802 @@
+/* BGP RIB export socket.
+   Copyright (C) 2026 The Quagga project
+
+This file is part of GNU Zebra.
+
+GNU Zebra is free software; you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation; either version 2, or (at your option) any
+later version.
+
+GNU Zebra is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with GNU Zebra; see the file COPYING.  If not, write to the Free
+Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+02111-1307, USA.  */
+
+/* The export socket hands the paths of the default instance's RIB to
+   monitoring clients as JSON lines, without going through the vty.
+
+   A client connects to the UNIX socket and sends one request line:
+
+     dump|since SEQ [afi ipv4|ipv6] [safi unicast|multicast]
+                    [peer ADDRESS] [follow]
+
+   "dump" sends every path, then an end record carrying the change
+   sequence number the dump is current to.  "since SEQ" sends the
+   prefixes changed after SEQ with their current paths; a prefix
+   without paths is sent as withdrawn.  With "follow" the connection
+   stays open and further changes are sent as they happen.  When the
+   change log no longer reaches back to what the client asked for, a
+   resync record is sent and the client has to dump again.
+
+   Output is made a slice at a time, and only once the socket has taken
+   all of the previous slice, so a slow client holds up nothing but
+   itself.  */
+
+#include <zebra.h>
+/* For sockaddr_un. */
+#include <sys/un.h>
+
+#include "log.h"
+#include "prefix.h"
+#include "sockunion.h"
+#include "command.h"
+#include "thread.h"
+#include "linklist.h"
+#include "buffer.h"
+#include "memory.h"
+#include "network.h"
+#include "privs.h"
+
+#include "bgpd/bgpd.h"
+#include "bgpd/bgp_table.h"
+#include "bgpd/bgp_route.h"
+#include "bgpd/bgp_attr.h"
+#include "bgpd/bgp_aspath.h"
+#include "bgpd/bgp_community.h"
+#include "bgpd/bgp_export.h"
+
+/* Nodes or changes made into output per write event. */
+#define BGP_EXPORT_SLICE 1000
+
+/* Changes kept for "since" and "follow" clients.  */
+#define BGP_EXPORT_LOG_SIZE (1 << 18)
+
+#define BGP_EXPORT_REQUEST_MAX 256
+
+enum bgp_export_state
+{
+  BGP_EXPORT_REQUEST,
+  BGP_EXPORT_WALK,
+  BGP_EXPORT_CHANGES,
+  BGP_EXPORT_DONE
+};
+
+static const char *bgp_export_state_str[] =
+{
+  "request",
+  "dump",
+  "changes",
+  "done"
+};
+
+static const struct
+{
+  afi_t afi;
+  safi_t safi;
+  const char *afi_str;
+  const char *safi_str;
+} bgp_export_afs[] =
+{
+  { AFI_IP,  SAFI_UNICAST,   "ipv4", "unicast" },
+  { AFI_IP,  SAFI_MULTICAST, "ipv4", "multicast" },
+  { AFI_IP6, SAFI_UNICAST,   "ipv6", "unicast" },
+  { AFI_IP6, SAFI_MULTICAST, "ipv6", "multicast" },
+};
+#define BGP_EXPORT_AFS (sizeof (bgp_export_afs) / sizeof (bgp_export_afs[0]))
+
+static const char *bgp_export_origin_str[] = { "igp", "egp", "incomplete" };
+
+struct bgp_export_client
+{
+  int fd;
+  struct buffer *obuf;
+  struct thread *t_read;
+  struct thread *t_write;
+
+  enum bgp_export_state state;
+
+  /* Request line, as far as it was read. */
+  char request[BGP_EXPORT_REQUEST_MAX];
+  size_t request_len;
+
+  /* What the client asked for.  afi and safi are 0 for all of them. */
+  afi_t afi;
+  safi_t safi;
+  union sockunion peer;
+  int peer_set;
+  int follow;
+
+  /* Dump position: the table being walked and its next node, both
+     locked. */
+  unsigned int af;
+  struct bgp_table *table;
+  struct bgp_node *rn;
+
+  /* Last change sent, or the change the dump is current to. */
+  u_int64_t seq;
+
+  unsigned long records;
+};
+
+struct bgp_export_change
+{
+  struct prefix p;
+  afi_t afi;
+  safi_t safi;
+};
+
+static char *bgp_export_path;
+static int bgp_export_sock = -1;
+static struct thread *t_bgp_export_accept;
+static struct list *bgp_export_clients;
+
+/* Change log, a ring holding the most recent changes.  Change seq is at
+   seq % BGP_EXPORT_LOG_SIZE.  The sequence starts from the time the log
+   is made, shifted well clear of any number of changes a bgpd may see
+   per second, so that numbers a client kept from an earlier run fall
+   behind the log rather than picking a wrong place in it. */
+static struct bgp_export_change *bgp_export_log;
+static u_int64_t bgp_export_seq;
+static u_int64_t bgp_export_seq_start;
+
+static void bgp_export_event (struct bgp_export_client *);
+
+static void
+bgp_export_client_free (struct bgp_export_client *client)
+{
+  THREAD_OFF (client->t_read);
+  THREAD_OFF (client->t_write);
+  if (client->rn)
+    bgp_unlock_node (client->rn);
+  if (client->table)
+    bgp_table_unlock (client->table);
+  close (client->fd);
+  buffer_free (client->obuf);
+  listnode_delete (bgp_export_clients, client);
+  XFREE (MTYPE_BGP_EXPORT, client);
+}
+
+static void
+bgp_export_record_end (struct bgp_export_client *client, const char *type)
+{
+  char buf[64];
+
+  snprintf (buf, sizeof (buf), "{\"type\":\"%s\",\"seq\":%llu}\n",
+            type, (unsigned long long) client->seq);
+  buffer_putstr (client->obuf, buf);
+}
+
+static void
+bgp_export_error (struct bgp_export_client *client, const char *message)
+{
+  buffer_putstr (client->obuf, "{\"type\":\"error\",\"message\":\"");
+  buffer_putstr (client->obuf, message);
+  buffer_putstr (client->obuf, "\"}\n");
+  client->state = BGP_EXPORT_DONE;
+}
+
+static void
+bgp_export_path_put (struct bgp_export_client *client, u_int64_t seq,
+                     unsigned int af, struct bgp_node *rn,
+                     struct bgp_info *ri)
+{
+  struct attr *attr = ri->attr;
+  char buf[BUFSIZ];
+  char pbuf[INET6_ADDRSTRLEN];
+  char nbuf[INET6_ADDRSTRLEN];
+  int len;
+
+  nbuf[0] = '\0';
+  if (bgp_export_afs[af].afi == AFI_IP)
+    inet_ntop (AF_INET, &attr->nexthop, nbuf, sizeof (nbuf));
+#ifdef HAVE_IPV6
+  else if (attr->extra)
+    inet_ntop (AF_INET6, &attr->extra->mp_nexthop_global, nbuf,
+               sizeof (nbuf));
+#endif /* HAVE_IPV6 */
+
+  len = snprintf (buf, sizeof (buf),
+                  "{\"seq\":%llu,\"afi\":\"%s\",\"safi\":\"%s\","
+                  "\"prefix\":\"%s/%d\",\"peer\":\"%s\",\"best\":%s,"
+                  "\"origin\":\"%s\",\"nexthop\":\"%s\"",
+                  (unsigned long long) seq,
+                  bgp_export_afs[af].afi_str, bgp_export_afs[af].safi_str,
+                  inet_ntop (rn->p.family, &rn->p.u.prefix, pbuf,
+                             sizeof (pbuf)),
+                  rn->p.prefixlen, ri->peer->host,
+                  CHECK_FLAG (ri->flags, BGP_INFO_SELECTED) ? "true" : "false",
+                  attr->origin <= BGP_ORIGIN_INCOMPLETE
+                  ? bgp_export_origin_str[attr->origin] : "incomplete",
+                  nbuf);
+
+  if (attr->flag & ATTR_FLAG_BIT (BGP_ATTR_MULTI_EXIT_DISC))
+    len += snprintf (buf + len, sizeof (buf) - len, ",\"med\":%u",
+                     attr->med);
+  if (attr->flag & ATTR_FLAG_BIT (BGP_ATTR_LOCAL_PREF))
+    len += snprintf (buf + len, sizeof (buf) - len, ",\"localpref\":%u",
+                     attr->local_pref);
+  buffer_putstr (client->obuf, buf);
+
+  /* AS paths and communities are digits, spaces and punctuation that
+     needs no escaping. */
+  buffer_putstr (client->obuf, ",\"aspath\":\"");
+  if (attr->aspath)
+    buffer_putstr (client->obuf, aspath_print (attr->aspath));
+  buffer_putc (client->obuf, '"');
+
+  if (attr->community)
+    {
+      buffer_putstr (client->obuf, ",\"community\":\"");
+      buffer_putstr (client->obuf, community_str (attr->community));
+      buffer_putc (client->obuf, '"');
+    }
+  buffer_putstr (client->obuf, "}\n");
+
+  client->records++;
+}
+
+/* Put the paths of rn the client asked for.  When there are none and
+   withdrawn is set, put that the prefix is withdrawn instead. */
+static void
+bgp_export_node_put (struct bgp_export_client *client, u_int64_t seq,
+                     unsigned int af, struct bgp_node *rn,
+                     struct prefix *p, int withdrawn)
+{
+  struct bgp_info *ri;
+  char buf[BUFSIZ];
+  char pbuf[INET6_ADDRSTRLEN];
+  int count = 0;
+
+  if (rn)
+    for (ri = rn->info; ri; ri = ri->next)
+      {
+        if (CHECK_FLAG (ri->flags, BGP_INFO_REMOVED))
+          continue;
+        if (client->peer_set && ! sockunion_same (&ri->peer->su,
+                                                  &client->peer))
+          continue;
+        bgp_export_path_put (client, seq, af, rn, ri);
+        count++;
+      }
+
+  if (count || ! withdrawn)
+    return;
+
+  snprintf (buf, sizeof (buf),
+            "{\"seq\":%llu,\"afi\":\"%s\",\"safi\":\"%s\","
+            "\"prefix\":\"%s/%d\",\"withdrawn\":true}\n",
+            (unsigned long long) seq,
+            bgp_export_afs[af].afi_str, bgp_export_afs[af].safi_str,
+            inet_ntop (p->family, &p->u.prefix, pbuf, sizeof (pbuf)),
+            p->prefixlen);
+  buffer_putstr (client->obuf, buf);
+  client->records++;
+}
+
+static int
+bgp_export_af_wanted (struct bgp_export_client *client, unsigned int af)
+{
+  return ((! client->afi || client->afi == bgp_export_afs[af].afi)
+          && (! client->safi || client->safi == bgp_export_afs[af].safi));
+}
+
+/* Dump a slice of the tables the client asked for. */
+static void
+bgp_export_walk (struct bgp_export_client *client)
+{
+  struct bgp *bgp;
+  int count = 0;
+
+  while (count < BGP_EXPORT_SLICE)
+    {
+      if (! client->table)
+        {
+          while (client->af < BGP_EXPORT_AFS
+                 && ! bgp_export_af_wanted (client, client->af))
+            client->af++;
+
+          bgp = bgp_get_default ();
+          if (client->af >= BGP_EXPORT_AFS || ! bgp)
+            {
+              bgp_export_record_end (client, "end");
+              client->state = client->follow ? BGP_EXPORT_CHANGES
+                                             : BGP_EXPORT_DONE;
+              return;
+            }
+
+          client->table = bgp->rib[bgp_export_afs[client->af].afi]
+                                  [bgp_export_afs[client->af].safi];
+          bgp_table_lock (client->table);
+          client->rn = bgp_table_top (client->table);
+        }
+
+      for (; client->rn && count < BGP_EXPORT_SLICE;
+           client->rn = bgp_route_next (client->rn))
+        if (client->rn->info)
+          {
+            bgp_export_node_put (client, client->seq, client->af,
+                                 client->rn, NULL, 0);
+            count++;
+          }
+
+      if (! client->rn)
+        {
+          bgp_table_unlock (client->table);
+          client->table = NULL;
+          client->af++;
+        }
+    }
+}
+
+/* Send a slice of the changes after client->seq.  Returns 1 if there are
+   more changes to send. */
+static int
+bgp_export_replay (struct bgp_export_client *client)
+{
+  struct bgp *bgp;
+  struct bgp_export_change *change;
+  struct bgp_node *rn;
+  unsigned int af;
+  int count;
+
+  if (client->seq > bgp_export_seq
+      || client->seq < bgp_export_seq_start
+      || bgp_export_seq - client->seq > BGP_EXPORT_LOG_SIZE)
+    {
+      client->seq = bgp_export_seq;
+      bgp_export_record_end (client, "resync");
+      client->state = BGP_EXPORT_DONE;
+      return 0;
+    }
+
+  bgp = bgp_get_default ();
+  for (count = 0; count < BGP_EXPORT_SLICE && client->seq < bgp_export_seq;
+       count++)
+    {
+      client->seq++;
+      change = &bgp_export_log[client->seq % BGP_EXPORT_LOG_SIZE];
+
+      for (af = 0; af < BGP_EXPORT_AFS; af++)
+        if (bgp_export_afs[af].afi == change->afi
+            && bgp_export_afs[af].safi == change->safi)
+          break;
+      if (af == BGP_EXPORT_AFS || ! bgp_export_af_wanted (client, af))
+        continue;
+
+      rn = bgp ? bgp_node_lookup (bgp->rib[change->afi][change->safi],
+                                  &change->p) : NULL;
+      bgp_export_node_put (client, client->seq, af, rn, &change->p, 1);
+      if (rn)
+        bgp_unlock_node (rn);
+    }
+
+  if (client->seq < bgp_export_seq)
+    return 1;
+
+  if (! client->follow)
+    {
+      bgp_export_record_end (client, "end");
+      client->state = BGP_EXPORT_DONE;
+    }
+  return 0;
+}
+
+static int
+bgp_export_request (struct bgp_export_client *client)
+{
+  const char *sep = " \t\r\n";
+  char *tok;
+  char *arg;
+  char *end;
+
+  tok = strtok (client->request, sep);
+  if (tok && strcmp (tok, "dump") == 0)
+    client->state = BGP_EXPORT_WALK;
+  else if (tok && strcmp (tok, "since") == 0)
+    {
+      arg = strtok (NULL, sep);
+      if (! arg)
+        return -1;
+      errno = 0;
+      client->seq = strtoull (arg, &end, 10);
+      if (*end != '\0' || errno)
+        return -1;
+      client->state = BGP_EXPORT_CHANGES;
+    }
+  else
+    return -1;
+
+  while ((tok = strtok (NULL, sep)) != NULL)
+    {
+      if (strcmp (tok, "follow") == 0)
+        {
+          client->follow = 1;
+          continue;
+        }
+
+      arg = strtok (NULL, sep);
+      if (! arg)
+        return -1;
+
+      if (strcmp (tok, "afi") == 0 && strcmp (arg, "ipv4") == 0)
+        client->afi = AFI_IP;
+      else if (strcmp (tok, "afi") == 0 && strcmp (arg, "ipv6") == 0)
+        client->afi = AFI_IP6;
+      else if (strcmp (tok, "safi") == 0 && strcmp (arg, "unicast") == 0)
+        client->safi = SAFI_UNICAST;
+      else if (strcmp (tok, "safi") == 0 && strcmp (arg, "multicast") == 0)
+        client->safi = SAFI_MULTICAST;
+      else if (strcmp (tok, "peer") == 0
+               && str2sockunion (arg, &client->peer) == 0)
+        client->peer_set = 1;
+      else
+        return -1;
+    }
+
+  /* A dump is current to the changes made before it starts. */
+  if (client->state == BGP_EXPORT_WALK)
+    client->seq = bgp_export_seq;
+
+  return 0;
+}
+
+static int
+bgp_export_read (struct thread *thread)
+{
+  struct bgp_export_client *client = THREAD_ARG (thread);
+  char buf[BGP_EXPORT_REQUEST_MAX];
+  char *nl;
+  ssize_t nbytes;
+
+  client->t_read = NULL;
+
+  nbytes = read (client->fd, buf, sizeof (buf));
+  if (nbytes < 0 && ERRNO_IO_RETRY (errno))
+    {
+      client->t_read = thread_add_read (master, bgp_export_read, client,
+                                        client->fd);
+      return 0;
+    }
+  if (nbytes <= 0)
+    {
+      bgp_export_client_free (client);
+      return 0;
+    }
+
+  /* Past the request, reading is only to notice the client going
+     away. */
+  client->t_read = thread_add_read (master, bgp_export_read, client,
+                                    client->fd);
+  if (client->state != BGP_EXPORT_REQUEST)
+    return 0;
+
+  if ((size_t) nbytes >= sizeof (client->request) - client->request_len)
+    {
+      bgp_export_error (client, "request too long");
+      bgp_export_event (client);
+      return 0;
+    }
+  memcpy (client->request + client->request_len, buf, nbytes);
+  client->request_len += nbytes;
+  client->request[client->request_len] = '\0';
+
+  nl = strchr (client->request, '\n');
+  if (! nl)
+    return 0;
+  *nl = '\0';
+
+  if (bgp_export_request (client) < 0)
+    bgp_export_error (client, "malformed request");
+  bgp_export_event (client);
+  return 0;
+}
+
+static int
+bgp_export_write (struct thread *thread)
+{
+  struct bgp_export_client *client = THREAD_ARG (thread);
+  int more = 0;
+
+  client->t_write = NULL;
+
+  switch (buffer_flush_available (client->obuf, client->fd))
+    {
+    case BUFFER_ERROR:
+      bgp_export_client_free (client);
+      return 0;
+    case BUFFER_PENDING:
+      bgp_export_event (client);
+      return 0;
+    case BUFFER_EMPTY:
+      break;
+    }
+
+  /* The socket took everything so far, make the next slice. */
+  switch (client->state)
+    {
+    case BGP_EXPORT_WALK:
+      bgp_export_walk (client);
+      more = 1;
+      break;
+    case BGP_EXPORT_CHANGES:
+      more = bgp_export_replay (client);
+      break;
+    default:
+      break;
+    }
+
+  switch (buffer_flush_available (client->obuf, client->fd))
+    {
+    case BUFFER_ERROR:
+      bgp_export_client_free (client);
+      return 0;
+    case BUFFER_PENDING:
+      more = 1;
+      break;
+    case BUFFER_EMPTY:
+      if (client->state == BGP_EXPORT_DONE)
+        {
+          bgp_export_client_free (client);
+          return 0;
+        }
+      break;
+    }
+
+  if (more || client->state == BGP_EXPORT_DONE)
+    bgp_export_event (client);
+  return 0;
+}
+
+static void
+bgp_export_event (struct bgp_export_client *client)
+{
+  if (! client->t_write)
+    client->t_write = thread_add_write (master, bgp_export_write, client,
+                                        client->fd);
+}
+
+static int
+bgp_export_accept (struct thread *thread)
+{
+  struct bgp_export_client *client;
+  struct sockaddr_un addr;
+  socklen_t len;
+  int sock;
+
+  t_bgp_export_accept = thread_add_read (master, bgp_export_accept, NULL,
+                                         bgp_export_sock);
+
+  len = sizeof (addr);
+  sock = accept (bgp_export_sock, (struct sockaddr *) &addr, &len);
+  if (sock < 0)
+    {
+      zlog_warn ("can't accept export socket: %s", safe_strerror (errno));
+      return -1;
+    }
+  set_nonblocking (sock);
+
+  client = XCALLOC (MTYPE_BGP_EXPORT, sizeof (struct bgp_export_client));
+  client->fd = sock;
+  client->obuf = buffer_new (0);
+  client->state = BGP_EXPORT_REQUEST;
+  listnode_add (bgp_export_clients, client);
+
+  client->t_read = thread_add_read (master, bgp_export_read, client, sock);
+  return 0;
+}
+
+static void
+bgp_export_stop (void)
+{
+  struct bgp_export_client *client;
+
+  while (bgp_export_clients && listhead (bgp_export_clients))
+    {
+      client = listgetdata (listhead (bgp_export_clients));
+      bgp_export_client_free (client);
+    }
+
+  THREAD_OFF (t_bgp_export_accept);
+  if (bgp_export_sock >= 0)
+    {
+      close (bgp_export_sock);
+      unlink (bgp_export_path);
+      bgp_export_sock = -1;
+    }
+  if (bgp_export_path)
+    XFREE (MTYPE_TMP, bgp_export_path);
+  bgp_export_path = NULL;
+  if (bgp_export_log)
+    XFREE (MTYPE_BGP_EXPORT, bgp_export_log);
+  bgp_export_log = NULL;
+}
+
+/* Listen for export clients on the UNIX socket at path, replacing any
+   socket there. */
+static int
+bgp_export_serv (const char *path)
+{
+  struct sockaddr_un serv;
+  struct zprivs_ids_t ids;
+  mode_t old_mask;
+  int sock, len;
+
+  unlink (path);
+  old_mask = umask (0007);
+
+  sock = socket (AF_UNIX, SOCK_STREAM, 0);
+  if (sock < 0)
+    {
+      zlog_err ("Cannot create unix stream socket: %s", safe_strerror (errno));
+      umask (old_mask);
+      return -1;
+    }
+
+  memset (&serv, 0, sizeof (struct sockaddr_un));
+  serv.sun_family = AF_UNIX;
+  strncpy (serv.sun_path, path, sizeof (serv.sun_path) - 1);
+#ifdef HAVE_STRUCT_SOCKADDR_UN_SUN_LEN
+  len = serv.sun_len = SUN_LEN(&serv);
+#else
+  len = sizeof (serv.sun_family) + strlen (serv.sun_path);
+#endif /* HAVE_STRUCT_SOCKADDR_UN_SUN_LEN */
+
+  if (bind (sock, (struct sockaddr *) &serv, len) < 0
+      || listen (sock, 5) < 0)
+    {
+      zlog_err ("Cannot listen on %s: %s", path, safe_strerror (errno));
+      close (sock);
+      umask (old_mask);
+      return -1;
+    }
+  umask (old_mask);
+  set_nonblocking (sock);
+
+  /* Let the vty group at it, as with the vtysh sockets. */
+  zprivs_get_ids (&ids);
+  if (ids.gid_vty > 0 && chown (path, -1, ids.gid_vty))
+    zlog_err ("bgp_export_serv: could not chown socket, %s",
+              safe_strerror (errno));
+
+  bgp_export_sock = sock;
+  bgp_export_path = XSTRDUP (MTYPE_TMP, path);
+  bgp_export_log = XCALLOC (MTYPE_BGP_EXPORT, BGP_EXPORT_LOG_SIZE
+                                              * sizeof (struct bgp_export_change));
+  bgp_export_seq_start = (u_int64_t) time (NULL) << 24;
+  bgp_export_seq = bgp_export_seq_start;
+  t_bgp_export_accept = thread_add_read (master, bgp_export_accept, NULL,
+                                         sock);
+  return 0;
+}
+
+/* Log that the paths of rn changed, for the clients following
+   changes.  Called for each node bgp_process runs over. */
+void
+bgp_export_change (struct bgp *bgp, struct bgp_node *rn, afi_t afi,
+                   safi_t safi)
+{
+  struct bgp_export_change *change;
+  struct bgp_export_client *client;
+  struct listnode *node;
+
+  if (! bgp_export_log || bgp->name)
+    return;
+
+  bgp_export_seq++;
+  change = &bgp_export_log[bgp_export_seq % BGP_EXPORT_LOG_SIZE];
+  prefix_copy (&change->p, &rn->p);
+  change->afi = afi;
+  change->safi = safi;
+
+  for (ALL_LIST_ELEMENTS_RO (bgp_export_clients, node, client))
+    if (client->state == BGP_EXPORT_CHANGES)
+      bgp_export_event (client);
+}
+
+DEFUN (bgp_export_socket,
+       bgp_export_socket_cmd,
+       "bgp export socket PATH",
+       BGP_STR
+       "Export the RIB to monitoring clients\n"
+       "Listen on a UNIX socket\n"
+       "Socket path\n")
+{
+  if (bgp_export_path && strcmp (bgp_export_path, argv[0]) == 0)
+    return CMD_SUCCESS;
+
+  bgp_export_stop ();
+  if (bgp_export_serv (argv[0]) < 0)
+    {
+      vty_out (vty, "%% Can't listen on %s: %s%s", argv[0],
+               safe_strerror (errno), VTY_NEWLINE);
+      return CMD_WARNING;
+    }
+  return CMD_SUCCESS;
+}
+
+DEFUN (no_bgp_export_socket,
+       no_bgp_export_socket_cmd,
+       "no bgp export socket [PATH]",
+       NO_STR
+       BGP_STR
+       "Export the RIB to monitoring clients\n"
+       "Listen on a UNIX socket\n"
+       "Socket path\n")
+{
+  bgp_export_stop ();
+  return CMD_SUCCESS;
+}
+
+DEFUN (show_bgp_export,
+       show_bgp_export_cmd,
+       "show bgp export",
+       SHOW_STR
+       BGP_STR
+       "RIB export socket\n")
+{
+  struct bgp_export_client *client;
+  struct listnode *node;
+
+  if (! bgp_export_path)
+    {
+      vty_out (vty, "RIB export is not configured%s", VTY_NEWLINE);
+      return CMD_SUCCESS;
+    }
+
+  vty_out (vty, "RIB export socket %s, change sequence %llu%s",
+           bgp_export_path, (unsigned long long) bgp_export_seq,
+           VTY_NEWLINE);
+  vty_out (vty, "%u clients%s", listcount (bgp_export_clients), VTY_NEWLINE);
+  for (ALL_LIST_ELEMENTS_RO (bgp_export_clients, node, client))
+    vty_out (vty, "  fd %d: %s%s, %lu records, at %llu%s", client->fd,
+             bgp_export_state_str[client->state],
+             client->follow ? " (follow)" : "",
+             client->records, (unsigned long long) client->seq, VTY_NEWLINE);
+
+  return CMD_SUCCESS;
+}
+
+int
+bgp_export_config_write (struct vty *vty)
+{
+  if (! bgp_export_path)
+    return 0;
+
+  vty_out (vty, "bgp export socket %s%s", bgp_export_path, VTY_NEWLINE);
+  return 1;
+}
+
+void
+bgp_export_init (void)
+{
+  bgp_export_clients = list_new ();
+
+  install_element (CONFIG_NODE, &bgp_export_socket_cmd);
+  install_element (CONFIG_NODE, &no_bgp_export_socket_cmd);
+  install_element (VIEW_NODE, &show_bgp_export_cmd);
+  install_element (ENABLE_NODE, &show_bgp_export_cmd);
+}
+
+void
+bgp_export_finish (void)
+{
+  bgp_export_stop ();
+  list_delete (bgp_export_clients);
+  bgp_export_clients = NULL;
+}
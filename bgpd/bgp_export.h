@@ -0,0 +1,33 @@
+/* BGP RIB export socket.
+   Copyright (C) 2026 The Quagga project
+
+This file is part of GNU Zebra.
+
+GNU Zebra is free software; you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation; either version 2, or (at your option) any
+later version.
+
+GNU Zebra is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with GNU Zebra; see the file COPYING.  If not, write to the Free
+Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+02111-1307, USA.  */
+
+#ifndef _QUAGGA_BGP_EXPORT_H
+#define _QUAGGA_BGP_EXPORT_H
+
+struct vty;
+struct bgp;
+struct bgp_node;
+
+extern void bgp_export_init (void);
+extern void bgp_export_finish (void);
+extern int bgp_export_config_write (struct vty *);
+extern void bgp_export_change (struct bgp *, struct bgp_node *, afi_t, safi_t);
+
+#endif /* _QUAGGA_BGP_EXPORT_H */
@@ -24,6 +24,7 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #include "log.h"
 #include "memory.h"
 #include "buffer.h"
+#include "hash.h"
 
 #include "bgpd/bgpd.h"
 #include "bgpd/bgp_aspath.h"
@@ -51,6 +52,9 @@ struct as_list_master
 
   /* Hook function which is executed when access_list is deleted. */
   void (*delete_hook) (void);
+
+  /* AS lists by name. */
+  struct hash *hash;
 };
 
 /* Element of AS path filter. */
@@ -71,6 +75,17 @@ enum as_list_type
   ACCESS_TYPE_NUMBER
 };
 
+/* Outcome of an earlier as_list_apply() to an interned path. */
+struct as_list_cache
+{
+  const struct aspath *aspath;
+  u_int32_t serial;
+  enum as_filter_type type;
+};
+
+/* Number of outcomes remembered per AS list; a power of 2. */
+#define AS_LIST_CACHE_SIZE	1024
+
 /* AS path filter list. */
 struct as_list
 {
@@ -83,6 +98,9 @@ struct as_list
 
   struct as_filter *head;
   struct as_filter *tail;
+
+  /* Lazily allocated, indexed by aspath serial. */
+  struct as_list_cache *cache;
 };
 
 /* ip as-path access-list 10 permit AS1. */
@@ -92,6 +110,7 @@ static struct as_list_master as_list_master =
   {NULL, NULL},
   {NULL, NULL},
   NULL,
+  NULL,
   NULL
 };
 
@@ -139,6 +158,15 @@ as_filter_lookup (struct as_list *aslist, const char *reg_str,
   return NULL;
 }
 
+/* The filters changed, so must any outcome of applying them. */
+static void
+as_list_cache_flush (struct as_list *aslist)
+{
+  if (aslist->cache)
+    XFREE (MTYPE_AS_LIST_CACHE, aslist->cache);
+  aslist->cache = NULL;
+}
+
 static void
 as_list_filter_add (struct as_list *aslist, struct as_filter *asfilter)
 {
@@ -150,26 +178,27 @@ as_list_filter_add (struct as_list *aslist, struct as_filter *asfilter)
   else
     aslist->head = asfilter;
   aslist->tail = asfilter;
+
+  as_list_cache_flush (aslist);
+}
+
+static const char *
+as_list_name (const void *arg)
+{
+  const struct as_list *aslist = arg;
+
+  return aslist->name;
 }
 
 /* Lookup as_list from list of as_list by name. */
 struct as_list *
 as_list_lookup (const char *name)
 {
-  struct as_list *aslist;
 
-  if (name == NULL)
+  if (name == NULL || as_list_master.hash == NULL)
     return NULL;
 
-  for (aslist = as_list_master.num.head; aslist; aslist = aslist->next)
-    if (strcmp (aslist->name, name) == 0)
-      return aslist;
-
-  for (aslist = as_list_master.str.head; aslist; aslist = aslist->next)
-    if (strcmp (aslist->name, name) == 0)
-      return aslist;
-
-  return NULL;
+  return hash_lookup_name (as_list_master.hash, name);
 }
 
 static struct as_list *
@@ -186,6 +215,7 @@ as_list_free (struct as_list *aslist)
       free (aslist->name);
       aslist->name = NULL;
     }
+  as_list_cache_flush (aslist);
   XFREE (MTYPE_AS_LIST, aslist);
 }
 
@@ -286,6 +316,10 @@ as_list_get (const char *name)
     {
       aslist = as_list_insert (name);
 
+      if (! as_list_master.hash)
+	as_list_master.hash = hash_create_name (as_list_name);
+      hash_get (as_list_master.hash, aslist, hash_alloc_intern);
+
       /* Run hook function. */
       if (as_list_master.add_hook)
 	(*as_list_master.add_hook) ();
@@ -335,6 +369,8 @@ as_list_delete (struct as_list *aslist)
   else
     list->head = aslist->next;
 
+  hash_release (as_list_master.hash, aslist);
+
   as_list_free (aslist);
 }
 
@@ -361,6 +397,7 @@ as_list_filter_delete (struct as_list *aslist, struct as_filter *asfilter)
     aslist->head = asfilter->next;
 
   as_filter_free (asfilter);
+  as_list_cache_flush (aslist);
 
   /* If access_list becomes empty delete it from access_master. */
   if (as_list_empty (aslist))
@@ -379,11 +416,26 @@ as_filter_match (struct as_filter *asfilter, struct aspath *aspath)
   return 0;
 }
 
-/* Apply AS path filter to AS. */
+static enum as_filter_type
+as_list_match (struct as_list *aslist, struct aspath *aspath)
+{
+  struct as_filter *asfilter;
+
+  for (asfilter = aslist->head; asfilter; asfilter = asfilter->next)
+    {
+      if (as_filter_match (asfilter, aspath))
+	return asfilter->type;
+    }
+  return AS_FILTER_DENY;
+}
+
+/* Apply AS path filter to AS.  The same list is applied to the same
+   interned path for every prefix sharing it, so the outcome is kept
+   and the regular expressions only run once per path. */
 enum as_filter_type
 as_list_apply (struct as_list *aslist, void *object)
 {
-  struct as_filter *asfilter;
+  struct as_list_cache *c;
   struct aspath *aspath;
 
   aspath = (struct aspath *) object;
@@ -391,12 +443,21 @@ as_list_apply (struct as_list *aslist, void *object)
   if (aslist == NULL)
     return AS_FILTER_DENY;
 
-  for (asfilter = aslist->head; asfilter; asfilter = asfilter->next)
+  if (! aspath->compact)
+    return as_list_match (aslist, aspath);
+
+  if (! aslist->cache)
+    aslist->cache = XCALLOC (MTYPE_AS_LIST_CACHE,
+			     AS_LIST_CACHE_SIZE * sizeof (struct as_list_cache));
+
+  c = &aslist->cache[aspath->serial & (AS_LIST_CACHE_SIZE - 1)];
+  if (c->aspath != aspath || c->serial != aspath->serial)
     {
-      if (as_filter_match (asfilter, aspath))
-	return asfilter->type;
+      c->aspath = aspath;
+      c->serial = aspath->serial;
+      c->type = as_list_match (aslist, aspath);
     }
-  return AS_FILTER_DENY;
+  return c->type;
 }
 
 /* Add hook function. */
@@ -40,6 +40,7 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #include "bgpd/bgp_route.h"
 #include "bgpd/bgp_dump.h"
 #include "bgpd/bgp_open.h"
+#include "bgpd/bgp_bmp.h"
 #ifdef HAVE_SNMP
 #include "bgpd/bgp_snmp.h"
 #endif /* HAVE_SNMP */
@@ -55,11 +56,10 @@ int bgp_event (struct thread *);
 /* BGP thread functions. */
 static int bgp_start_timer (struct thread *);
 static int bgp_connect_timer (struct thread *);
-static int bgp_holdtime_timer (struct thread *);
-static int bgp_keepalive_timer (struct thread *);
 
 /* BGP FSM functions. */
 static int bgp_start (struct peer *);
+static int bgp_fsm_event (struct peer *, int);
 
 /* BGP start timer jitter. */
 static int
@@ -98,8 +98,8 @@ bgp_timer_set (struct peer *peer)
 			peer->v_start + jitter);
 	}
       BGP_TIMER_OFF (peer->t_connect);
-      BGP_TIMER_OFF (peer->t_holdtime);
-      BGP_TIMER_OFF (peer->t_keepalive);
+      BGP_DEADLINE_OFF (peer->holdtime_expire);
+      BGP_DEADLINE_OFF (peer->keepalive_expire);
       BGP_TIMER_OFF (peer->t_asorig);
       BGP_TIMER_OFF (peer->t_routeadv);
       break;
@@ -110,8 +110,8 @@ bgp_timer_set (struct peer *peer)
          on. */
       BGP_TIMER_OFF (peer->t_start);
       BGP_TIMER_ON (peer->t_connect, bgp_connect_timer, peer->v_connect);
-      BGP_TIMER_OFF (peer->t_holdtime);
-      BGP_TIMER_OFF (peer->t_keepalive);
+      BGP_DEADLINE_OFF (peer->holdtime_expire);
+      BGP_DEADLINE_OFF (peer->keepalive_expire);
       BGP_TIMER_OFF (peer->t_asorig);
       BGP_TIMER_OFF (peer->t_routeadv);
       break;
@@ -130,8 +130,8 @@ bgp_timer_set (struct peer *peer)
 	{
 	  BGP_TIMER_ON (peer->t_connect, bgp_connect_timer, peer->v_connect);
 	}
-      BGP_TIMER_OFF (peer->t_holdtime);
-      BGP_TIMER_OFF (peer->t_keepalive);
+      BGP_DEADLINE_OFF (peer->holdtime_expire);
+      BGP_DEADLINE_OFF (peer->keepalive_expire);
       BGP_TIMER_OFF (peer->t_asorig);
       BGP_TIMER_OFF (peer->t_routeadv);
       break;
@@ -142,14 +142,13 @@ bgp_timer_set (struct peer *peer)
       BGP_TIMER_OFF (peer->t_connect);
       if (peer->v_holdtime != 0)
 	{
-	  BGP_TIMER_ON (peer->t_holdtime, bgp_holdtime_timer, 
-			peer->v_holdtime);
+	  BGP_DEADLINE_ON (peer->holdtime_expire, peer->v_holdtime);
 	}
       else
 	{
-	  BGP_TIMER_OFF (peer->t_holdtime);
+	  BGP_DEADLINE_OFF (peer->holdtime_expire);
 	}
-      BGP_TIMER_OFF (peer->t_keepalive);
+      BGP_DEADLINE_OFF (peer->keepalive_expire);
       BGP_TIMER_OFF (peer->t_asorig);
       BGP_TIMER_OFF (peer->t_routeadv);
       break;
@@ -163,15 +162,13 @@ bgp_timer_set (struct peer *peer)
          timer and KeepAlive timers are not started. */
       if (peer->v_holdtime == 0)
 	{
-	  BGP_TIMER_OFF (peer->t_holdtime);
-	  BGP_TIMER_OFF (peer->t_keepalive);
+	  BGP_DEADLINE_OFF (peer->holdtime_expire);
+	  BGP_DEADLINE_OFF (peer->keepalive_expire);
 	}
       else
 	{
-	  BGP_TIMER_ON (peer->t_holdtime, bgp_holdtime_timer,
-			peer->v_holdtime);
-	  BGP_TIMER_ON (peer->t_keepalive, bgp_keepalive_timer, 
-			peer->v_keepalive);
+	  BGP_DEADLINE_ON (peer->holdtime_expire, peer->v_holdtime);
+	  BGP_DEADLINE_ON (peer->keepalive_expire, peer->v_keepalive);
 	}
       BGP_TIMER_OFF (peer->t_asorig);
       BGP_TIMER_OFF (peer->t_routeadv);
@@ -187,15 +184,13 @@ bgp_timer_set (struct peer *peer)
          and keepalive must be turned off. */
       if (peer->v_holdtime == 0)
 	{
-	  BGP_TIMER_OFF (peer->t_holdtime);
-	  BGP_TIMER_OFF (peer->t_keepalive);
+	  BGP_DEADLINE_OFF (peer->holdtime_expire);
+	  BGP_DEADLINE_OFF (peer->keepalive_expire);
 	}
       else
 	{
-	  BGP_TIMER_ON (peer->t_holdtime, bgp_holdtime_timer,
-			peer->v_holdtime);
-	  BGP_TIMER_ON (peer->t_keepalive, bgp_keepalive_timer,
-			peer->v_keepalive);
+	  BGP_DEADLINE_ON (peer->holdtime_expire, peer->v_holdtime);
+	  BGP_DEADLINE_ON (peer->keepalive_expire, peer->v_keepalive);
 	}
       BGP_TIMER_OFF (peer->t_asorig);
       break;
@@ -206,8 +201,8 @@ bgp_timer_set (struct peer *peer)
     case Clearing:
       BGP_TIMER_OFF (peer->t_start);
       BGP_TIMER_OFF (peer->t_connect);
-      BGP_TIMER_OFF (peer->t_holdtime);
-      BGP_TIMER_OFF (peer->t_keepalive);
+      BGP_DEADLINE_OFF (peer->holdtime_expire);
+      BGP_DEADLINE_OFF (peer->keepalive_expire);
       BGP_TIMER_OFF (peer->t_asorig);
       BGP_TIMER_OFF (peer->t_routeadv);
     }
@@ -252,43 +247,160 @@ bgp_connect_timer (struct thread *thread)
   return 0;
 }
 
-/* BGP holdtime timer. */
-static int
-bgp_holdtime_timer (struct thread *thread)
+/* Timer wheel.  The hold and keepalive timers of all peers are
+   deadlines in whole seconds, and each peer is filed under the earlier
+   of its two in one of BGP_WHEEL_SLOTS lists, by second.  One thread
+   ticks every second while any peer is filed and looks at the peers of
+   the seconds gone by.  Pushing a deadline later, as every message
+   received does to the hold timer, is only a store: the peer stays where
+   it is, and is filed again under the new deadline when its slot comes
+   up. */
+#define BGP_WHEEL_SLOTS 64
+
+static struct peer *bgp_wheel[BGP_WHEEL_SLOTS];
+static unsigned long bgp_wheel_count;
+static struct thread *t_bgp_wheel;
+
+/* Last second looked at. */
+static time_t bgp_wheel_time;
+
+static int bgp_wheel_tick (struct thread *);
+
+static void
+bgp_wheel_link (struct peer **head, struct peer *peer)
 {
-  struct peer *peer;
+  peer->wheel_next = *head;
+  if (*head)
+    (*head)->wheel_prev = &peer->wheel_next;
+  peer->wheel_prev = head;
+  *head = peer;
+  bgp_wheel_count++;
+}
 
-  peer = THREAD_ARG (thread);
-  peer->t_holdtime = NULL;
+static void
+bgp_wheel_unlink (struct peer *peer)
+{
+  if (! peer->wheel_prev)
+    return;
+  if (peer->wheel_next)
+    peer->wheel_next->wheel_prev = peer->wheel_prev;
+  *peer->wheel_prev = peer->wheel_next;
+  peer->wheel_next = NULL;
+  peer->wheel_prev = NULL;
+  peer->wheel_due = 0;
+  bgp_wheel_count--;
+}
 
-  if (BGP_DEBUG (fsm, FSM))
-    zlog (peer->log, LOG_DEBUG,
-	  "%s [FSM] Timer (holdtime timer expire)",
-	  peer->host);
+/* File the peer again after its hold or keepalive deadline changed.
+   Only a deadline earlier than the one it is filed under, or none,
+   moves it now. */
+void
+bgp_timer_wheel_update (struct peer *peer)
+{
+  time_t due = peer->holdtime_expire;
 
-  THREAD_VAL (thread) = Hold_Timer_expired;
-  bgp_event (thread); /* bgp_event unlocks peer */
+  if (peer->keepalive_expire && (! due || peer->keepalive_expire < due))
+    due = peer->keepalive_expire;
 
-  return 0;
+  if (! due)
+    {
+      bgp_wheel_unlink (peer);
+      return;
+    }
+  if (peer->wheel_prev && peer->wheel_due <= due)
+    return;
+
+  bgp_wheel_unlink (peer);
+  if (! bgp_wheel_count)
+    bgp_wheel_time = bgp_clock ();
+  if (due <= bgp_wheel_time)
+    due = bgp_wheel_time + 1;
+  peer->wheel_due = due;
+  bgp_wheel_link (&bgp_wheel[due % BGP_WHEEL_SLOTS], peer);
+
+  if (! t_bgp_wheel)
+    t_bgp_wheel = thread_add_timer (master, bgp_wheel_tick, NULL, 1);
+}
+
+/* Run the timers of the peer due by the second being looked at. */
+static void
+bgp_timer_expire (struct peer *peer)
+{
+  if (peer->holdtime_expire && peer->holdtime_expire <= bgp_wheel_time)
+    {
+      peer->holdtime_expire = 0;
+
+      /* Hold time runs from the last message we processed, so a long
+	 run of route processing can expire it while the peer's KEEPALIVE
+	 is already sitting on the socket.  Let bgp_read have one look at
+	 it first. */
+      if (! CHECK_FLAG (peer->sflags, PEER_STATUS_HOLDTIME_GRACE)
+	  && bgp_read_pending (peer))
+	{
+	  if (BGP_DEBUG (fsm, FSM))
+	    zlog (peer->log, LOG_DEBUG,
+		  "%s [FSM] Timer (holdtime deferred, input pending)",
+		  peer->host);
+	  SET_FLAG (peer->sflags, PEER_STATUS_HOLDTIME_GRACE);
+	  peer->holdtime_expire = bgp_clock () + BGP_HOLDTIME_GRACE;
+	}
+      else
+	{
+	  if (BGP_DEBUG (fsm, FSM))
+	    zlog (peer->log, LOG_DEBUG,
+		  "%s [FSM] Timer (holdtime timer expire)",
+		  peer->host);
+	  bgp_timer_wheel_update (peer);
+	  bgp_fsm_event (peer, Hold_Timer_expired);
+	  return;
+	}
+    }
+
+  if (peer->keepalive_expire && peer->keepalive_expire <= bgp_wheel_time)
+    {
+      peer->keepalive_expire = 0;
+
+      if (BGP_DEBUG (fsm, FSM))
+	zlog (peer->log, LOG_DEBUG,
+	      "%s [FSM] Timer (keepalive timer expire)",
+	      peer->host);
+      bgp_timer_wheel_update (peer);
+      bgp_fsm_event (peer, KeepAlive_timer_expired);
+      return;
+    }
+
+  bgp_timer_wheel_update (peer);
 }
 
-/* BGP keepalive fire ! */
 static int
-bgp_keepalive_timer (struct thread *thread)
+bgp_wheel_tick (struct thread *thread)
 {
+  struct peer *pending = NULL;
   struct peer *peer;
+  time_t now = bgp_clock ();
 
-  peer = THREAD_ARG (thread);
-  peer->t_keepalive = NULL;
+  t_bgp_wheel = NULL;
 
-  if (BGP_DEBUG (fsm, FSM))
-    zlog (peer->log, LOG_DEBUG,
-	  "%s [FSM] Timer (keepalive timer expire)",
-	  peer->host);
+  while (bgp_wheel_time < now && bgp_wheel_count)
+    {
+      bgp_wheel_time++;
 
-  THREAD_VAL (thread) = KeepAlive_timer_expired;
-  bgp_event (thread); /* bgp_event unlocks peer */
+      /* Take the slot's peers off it first: running their timers can
+	 file them, or others, under it again. */
+      while ((peer = bgp_wheel[bgp_wheel_time % BGP_WHEEL_SLOTS]) != NULL)
+	{
+	  bgp_wheel_unlink (peer);
+	  bgp_wheel_link (&pending, peer);
+	}
+      while ((peer = pending) != NULL)
+	{
+	  bgp_wheel_unlink (peer);
+	  bgp_timer_expire (peer);
+	}
+    }
 
+  if (bgp_wheel_count && ! t_bgp_wheel)
+    t_bgp_wheel = thread_add_timer (master, bgp_wheel_tick, NULL, 1);
   return 0;
 }
 
@@ -360,6 +472,7 @@ bgp_graceful_restart_timer_expire (struct thread *thread)
 	bgp_clear_stale_route (peer, afi, safi);
 
   UNSET_FLAG (peer->sflags, PEER_STATUS_NSF_WAIT);
+  UNSET_FLAG (peer->sflags, PEER_STATUS_NSF_RELOAD);
   BGP_TIMER_OFF (peer->t_gr_stale);
 
   if (BGP_DEBUG (events, EVENTS))
@@ -392,9 +505,32 @@ bgp_graceful_stale_timer_expire (struct thread *thread)
       if (peer->nsf[afi][safi])
 	bgp_clear_stale_route (peer, afi, safi);
 
+  UNSET_FLAG (peer->sflags, PEER_STATUS_NSF_RELOAD);
   return 0;
 }
 
+/* Hold the paths reloaded for peer from a RIB snapshot as stale, as if
+   the peer had just gone down gracefully: they go if the peer does not
+   come up within the restart time, or has not refreshed them within
+   the stalepath time. */
+void
+bgp_graceful_reload (struct peer *peer)
+{
+  SET_FLAG (peer->sflags, PEER_STATUS_NSF_RELOAD);
+
+  if (BGP_DEBUG (events, EVENTS))
+    {
+      zlog_debug ("%s graceful restart timer started for %d sec",
+		  peer->host, peer->bgp->restart_time);
+      zlog_debug ("%s graceful restart stalepath timer started for %d sec",
+		  peer->host, peer->bgp->stalepath_time);
+    }
+  BGP_TIMER_ON (peer->t_gr_restart, bgp_graceful_restart_timer_expire,
+		peer->bgp->restart_time);
+  BGP_TIMER_ON (peer->t_gr_stale, bgp_graceful_stale_timer_expire,
+		peer->bgp->stalepath_time);
+}
+
 /* Called after event occured, this function change status and reset
    read/write and timer thread. */
 void
@@ -492,10 +628,15 @@ bgp_stop (struct peer *peer)
       bgpTrapBackwardTransition (peer);
 #endif /* HAVE_SNMP */
 
+      bgp_bmp_peer_down (peer);
+
       /* Reset peer synctime */
       peer->synctime = 0;
     }
 
+  UNSET_FLAG (peer->sflags, PEER_STATUS_HOLDTIME_GRACE);
+  UNSET_FLAG (peer->sflags, PEER_STATUS_EOR_IMPLICIT);
+
   /* Stop read and write threads when exists. */
   BGP_READ_OFF (peer->t_read);
   BGP_WRITE_OFF (peer->t_write);
@@ -503,8 +644,8 @@ bgp_stop (struct peer *peer)
   /* Stop all timers. */
   BGP_TIMER_OFF (peer->t_start);
   BGP_TIMER_OFF (peer->t_connect);
-  BGP_TIMER_OFF (peer->t_holdtime);
-  BGP_TIMER_OFF (peer->t_keepalive);
+  BGP_DEADLINE_OFF (peer->holdtime_expire);
+  BGP_DEADLINE_OFF (peer->keepalive_expire);
   BGP_TIMER_OFF (peer->t_asorig);
   BGP_TIMER_OFF (peer->t_routeadv);
 
@@ -514,17 +655,23 @@ bgp_stop (struct peer *peer)
   /* Clear input and output buffer.  */
   if (peer->ibuf)
     stream_reset (peer->ibuf);
+  if (peer->rbuf)
+    stream_reset (peer->rbuf);
   if (peer->work)
     stream_reset (peer->work);
   if (peer->obuf)
     stream_fifo_clean (peer->obuf);
 
+  /* Parsed attributes may not be valid for the next session. */
+  bgp_attr_cache_flush (peer);
+
   /* Close of file descriptor. */
   if (peer->fd >= 0)
     {
       close (peer->fd);
       peer->fd = -1;
     }
+  peer->sndbuf = 0;
 
   for (afi = AFI_IP ; afi < AFI_MAX ; afi++)
     for (safi = SAFI_UNICAST ; safi < SAFI_MAX ; safi++)
@@ -546,6 +693,10 @@ bgp_stop (struct peer *peer)
         /* ORF received prefix-filter pnt */
         sprintf (orf_name, "%s.%d.%d", peer->host, afi, safi);
         prefix_bgp_orf_remove_all (orf_name);
+
+        /* ORF prefix-filter sent, which the peer forgets too */
+        sprintf (orf_name, "%s.%d.%d.sent", peer->host, afi, safi);
+        prefix_bgp_orf_remove_all (orf_name);
       }
 
   /* Reset keepalive and holdtime */
@@ -753,7 +904,7 @@ bgp_fsm_open (struct peer *peer)
   bgp_keepalive_send (peer);
 
   /* Reset holdtimer value. */
-  BGP_TIMER_OFF (peer->t_holdtime);
+  BGP_DEADLINE_OFF (peer->holdtime_expire);
 
   return 0;
 }
@@ -797,6 +948,7 @@ bgp_establish (struct peer *peer)
   afi_t afi;
   safi_t safi;
   int nsf_af_count = 0;
+  int reload;
 
   /* Reset capability open status flag. */
   if (! CHECK_FLAG (peer->sflags, PEER_STATUS_CAPABILITY_OPEN))
@@ -813,6 +965,9 @@ bgp_establish (struct peer *peer)
 
   /* Increment established count. */
   peer->established++;
+
+  /* Nothing dropped over maximum-prefix on this session yet. */
+  memset (peer->pdiscard, 0, sizeof (peer->pdiscard));
   bgp_fsm_change_status (peer, Established);
 
   /* bgp log-neighbor-changes of neighbor Up */
@@ -821,6 +976,14 @@ bgp_establish (struct peer *peer)
 
   /* graceful restart */
   UNSET_FLAG (peer->sflags, PEER_STATUS_NSF_WAIT);
+
+  /* Paths reloaded from a RIB snapshot are ours, not left over from a
+     restart of the peer: keep them for the peer to refresh, whatever
+     it says about preserving its forwarding state, or until the
+     stalepath timer runs out if it won't send End-of-RIB. */
+  reload = CHECK_FLAG (peer->sflags, PEER_STATUS_NSF_RELOAD);
+  UNSET_FLAG (peer->sflags, PEER_STATUS_NSF_RELOAD);
+
   for (afi = AFI_IP ; afi < AFI_MAX ; afi++)
     for (safi = SAFI_UNICAST ; safi < SAFI_RESERVED_3 ; safi++)
       {
@@ -828,14 +991,14 @@ bgp_establish (struct peer *peer)
 	    && CHECK_FLAG (peer->cap, PEER_CAP_RESTART_ADV)
 	    && CHECK_FLAG (peer->af_cap[afi][safi], PEER_CAP_RESTART_AF_RCV))
 	  {
-	    if (peer->nsf[afi][safi]
+	    if (peer->nsf[afi][safi] && ! reload
 		&& ! CHECK_FLAG (peer->af_cap[afi][safi], PEER_CAP_RESTART_AF_PRESERVE_RCV))
 	      bgp_clear_stale_route (peer, afi, safi);
 
 	    peer->nsf[afi][safi] = 1;
 	    nsf_af_count++;
 	  }
-	else
+	else if (! reload)
 	  {
 	    if (peer->nsf[afi][safi])
 	      bgp_clear_stale_route (peer, afi, safi);
@@ -848,7 +1011,7 @@ bgp_establish (struct peer *peer)
   else
     {
       UNSET_FLAG (peer->sflags, PEER_STATUS_NSF_MODE);
-      if (peer->t_gr_stale)
+      if (peer->t_gr_stale && ! reload)
 	{
 	  BGP_TIMER_OFF (peer->t_gr_stale);
 	  if (BGP_DEBUG (events, EVENTS))
@@ -867,6 +1030,8 @@ bgp_establish (struct peer *peer)
   bgpTrapEstablished (peer);
 #endif /* HAVE_SNMP */
 
+  bgp_bmp_peer_up (peer);
+
   /* Reset uptime, send keepalive, send current table. */
   peer->uptime = bgp_clock ();
 
@@ -908,7 +1073,7 @@ bgp_fsm_keepalive (struct peer *peer)
   /* peer count update */
   peer->keepalive_in++;
 
-  BGP_TIMER_OFF (peer->t_holdtime);
+  BGP_DEADLINE_OFF (peer->holdtime_expire);
   return 0;
 }
 
@@ -916,7 +1081,7 @@ bgp_fsm_keepalive (struct peer *peer)
 static int
 bgp_fsm_update (struct peer *peer)
 {
-  BGP_TIMER_OFF (peer->t_holdtime);
+  BGP_DEADLINE_OFF (peer->holdtime_expire);
   return 0;
 }
 
@@ -1097,14 +1262,15 @@ static const char *bgp_event_str[] =
 /* Execute event process. */
 int
 bgp_event (struct thread *thread)
+{
+  return bgp_fsm_event (THREAD_ARG (thread), THREAD_VAL (thread));
+}
+
+static int
+bgp_fsm_event (struct peer *peer, int event)
 {
   int ret = 0;
-  int event;
   int next;
-  struct peer *peer;
-
-  peer = THREAD_ARG (thread);
-  event = THREAD_VAL (thread);
 
   /* Logging this event. */
   next = FSM [peer->status -1][event - 1].next_state;
@@ -59,10 +59,33 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
       THREAD_TIMER_OFF(T);			\
   } while (0)
 
+/* Same for the hold and keepalive timers, which are deadlines on the
+   timer wheel rather than threads. */
+#define BGP_DEADLINE_ON(D,V)			\
+  do {						\
+    if (!(D) && (peer->status != Deleted))	\
+      {						\
+	(D) = bgp_clock () + (V);		\
+	bgp_timer_wheel_update (peer);		\
+      }						\
+  } while (0)
+
+#define BGP_DEADLINE_OFF(D)			\
+  do {						\
+    if (D)					\
+      {						\
+	(D) = 0;				\
+	bgp_timer_wheel_update (peer);		\
+      }						\
+  } while (0)
+
 #define BGP_EVENT_ADD(P,E)			\
   do {						\
     if ((P)->status != Deleted)			\
-      thread_add_event (master, bgp_event, (P), (E)); \
+      {						\
+	(P)->fsm_events++;			\
+	thread_add_event (master, bgp_event, (P), (E)); \
+      }						\
   } while (0)
 
 #define BGP_EVENT_FLUSH(P)			\
@@ -75,7 +98,9 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 extern int bgp_event (struct thread *);
 extern int bgp_stop (struct peer *peer);
 extern void bgp_timer_set (struct peer *);
+extern void bgp_timer_wheel_update (struct peer *);
 extern void bgp_fsm_change_status (struct peer *peer, int status);
+extern void bgp_graceful_reload (struct peer *);
 extern const char *peer_down_str[];
 
 #endif /* _QUAGGA_BGP_FSM_H */
@@ -42,6 +42,11 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #include "bgpd/bgp_mplsvpn.h"
 #include "bgpd/bgp_aspath.h"
 #include "bgpd/bgp_dump.h"
+#include "bgpd/bgp_export.h"
+#include "bgpd/bgp_bmp.h"
+#include "bgpd/bgp_rpki.h"
+#include "bgpd/bgp_snapshot.h"
+#include "bgpd/bgp_statseg.h"
 #include "bgpd/bgp_route.h"
 #include "bgpd/bgp_nexthop.h"
 #include "bgpd/bgp_regex.h"
@@ -49,6 +54,7 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #include "bgpd/bgp_debug.h"
 #include "bgpd/bgp_filter.h"
 #include "bgpd/bgp_zebra.h"
+#include "bgpd/bgp_packet.h"
 
 /* bgpd options, we use GNU getopt library. */
 static const struct option longopts[] = 
@@ -198,6 +204,9 @@ sigint (void)
 {
   zlog_notice ("Terminating on signal");
 
+  /* Keep the RIB for the next start. */
+  bgp_snapshot_save ();
+
   if (! retain_mode)
     bgp_terminate ();
 
@@ -260,12 +269,30 @@ bgp_exit (int status)
     }
   list_free (iflist);
 
+  bgp_update_share_flush (NULL);
+  bgp_rmap_cache_flush ();
+
   /* reverse bgp_attr_init */
   bgp_attr_finish ();
 
   /* reverse bgp_dump_init */
   bgp_dump_finish ();
 
+  /* reverse bgp_export_init */
+  bgp_export_finish ();
+
+  /* reverse bgp_rpki_init */
+  bgp_rpki_finish ();
+
+  /* reverse bgp_bmp_init */
+  bgp_bmp_finish ();
+
+  /* reverse bgp_snapshot_init */
+  bgp_snapshot_finish ();
+
+  /* reverse bgp_statseg_init */
+  bgp_statseg_finish ();
+
   /* reverse bgp_route_init */
   bgp_route_finish ();
 
@@ -440,6 +467,9 @@ main (int argc, char **argv)
   /* Start execution only if not in dry-run mode */
   if(dryrun)
     return(0);
+
+  /* Reload the RIB as it was when bgpd last stopped. */
+  bgp_snapshot_load ();
   
   /* Turn into daemon if daemon_mode is set. */
   if (daemon_mode && daemon (0, 0) < 0)
@@ -25,7 +25,6 @@
 
 #include "command.h"
 #include "prefix.h"
-#include "linklist.h"
 #include "sockunion.h"
 #include "memory.h"
 
@@ -175,35 +174,52 @@ bgp_info_mpath_cmp (void *val1, void *val2)
  * selected by bgp_best_selection
  */
 void
-bgp_mp_list_init (struct list *mp_list)
+bgp_mp_list_init (struct bgp_mp_list *mp_list)
 {
   assert (mp_list);
-  memset (mp_list, 0, sizeof (struct list));
-  mp_list->cmp = bgp_info_mpath_cmp;
+  memset (mp_list, 0, sizeof (struct bgp_mp_list));
 }
 
 /*
  * bgp_mp_list_clear
  *
- * Clears all entries out of the mp_list
+ * Clears all entries out of the mp_list, keeping its array for the
+ * next selection
  */
 void
-bgp_mp_list_clear (struct list *mp_list)
+bgp_mp_list_clear (struct bgp_mp_list *mp_list)
 {
   assert (mp_list);
-  list_delete_all_node (mp_list);
+  mp_list->count = 0;
 }
 
 /*
  * bgp_mp_list_add
  *
- * Adds a multipath entry to the mp_list
+ * Adds a multipath entry to the mp_list, after any entries it
+ * compares equal to
  */
 void
-bgp_mp_list_add (struct list *mp_list, struct bgp_info *mpinfo)
+bgp_mp_list_add (struct bgp_mp_list *mp_list, struct bgp_info *mpinfo)
 {
+  unsigned int i;
+
   assert (mp_list && mpinfo);
-  listnode_add_sort (mp_list, mpinfo);
+
+  if (mp_list->count == mp_list->size)
+    {
+      mp_list->size = mp_list->size ? 2 * mp_list->size : 8;
+      mp_list->paths = XREALLOC (MTYPE_BGP_MPATH_LIST, mp_list->paths,
+                                 mp_list->size * sizeof (struct bgp_info *));
+    }
+
+  for (i = mp_list->count; i > 0; i--)
+    if (bgp_info_mpath_cmp (mpinfo, mp_list->paths[i - 1]) >= 0)
+      break;
+  memmove (&mp_list->paths[i + 1], &mp_list->paths[i],
+           (mp_list->count - i) * sizeof (struct bgp_info *));
+  mp_list->paths[i] = mpinfo;
+  mp_list->count++;
 }
 
 /*
@@ -394,11 +410,12 @@ bgp_info_mpath_attr_set (struct bgp_info *binfo, struct attr *attr)
  */
 void
 bgp_info_mpath_update (struct bgp_node *rn, struct bgp_info *new_best,
-                       struct bgp_info *old_best, struct list *mp_list,
+                       struct bgp_info *old_best, struct bgp_mp_list *mp_list,
                        struct bgp_maxpaths_cfg *mpath_cfg)
 {
   u_int16_t maxpaths, mpath_count, old_mpath_count;
-  struct listnode *mp_node, *mp_next_node;
+  unsigned int mp_index;
+  struct bgp_info *mp_node;
   struct bgp_info *cur_mpath, *new_mpath, *next_mpath, *prev_mpath;
   int mpath_changed, debug;
   char pfx_buf[INET_ADDRSTRLEN], nh_buf[2][INET_ADDRSTRLEN];
@@ -409,7 +426,8 @@ bgp_info_mpath_update (struct bgp_node *rn, struct bgp_info *new_best,
   cur_mpath = NULL;
   old_mpath_count = 0;
   prev_mpath = new_best;
-  mp_node = listhead (mp_list);
+  mp_index = 0;
+  mp_node = mp_list->count ? mp_list->paths[0] : NULL;
   debug = BGP_DEBUG (events, EVENTS);
 
   if (debug)
@@ -453,16 +471,14 @@ bgp_info_mpath_update (struct bgp_node *rn, struct bgp_info *new_best,
       if (!cur_mpath && (mpath_count >= maxpaths))
         break;
 
-      mp_next_node = mp_node ? listnextnode (mp_node) : NULL;
       next_mpath = cur_mpath ? bgp_info_mpath_next (cur_mpath) : NULL;
 
       /*
        * If equal, the path was a multipath and is still a multipath.
        * Insert onto new multipath list if maxpaths allows.
        */
-      if (mp_node && (listgetdata (mp_node) == cur_mpath))
+      if (mp_node && (mp_node == cur_mpath))
         {
-          list_delete_node (mp_list, mp_node);
           bgp_info_mpath_dequeue (cur_mpath);
           if ((mpath_count < maxpaths) &&
               bgp_info_nexthop_cmp (prev_mpath, cur_mpath))
@@ -481,14 +497,14 @@ bgp_info_mpath_update (struct bgp_node *rn, struct bgp_info *new_best,
                             sockunion2str (cur_mpath->peer->su_remote,
                                            nh_buf[1], sizeof (nh_buf[1])));
             }
-          mp_node = mp_next_node;
+          mp_node = (++mp_index < mp_list->count) ?
+            mp_list->paths[mp_index] : NULL;
           cur_mpath = next_mpath;
           continue;
         }
 
       if (cur_mpath && (!mp_node ||
-                        (bgp_info_mpath_cmp (cur_mpath,
-                                             listgetdata (mp_node)) < 0)))
+                        (bgp_info_mpath_cmp (cur_mpath, mp_node) < 0)))
         {
           /*
            * If here, we have an old multipath and either the mp_list
@@ -519,8 +535,7 @@ bgp_info_mpath_update (struct bgp_node *rn, struct bgp_info *new_best,
            *   point to the multipath after this one
            * - Dequeue the path from the multipath list just to make sure
            */
-          new_mpath = listgetdata (mp_node);
-          list_delete_node (mp_list, mp_node);
+          new_mpath = mp_node;
           if ((mpath_count < maxpaths) && (new_mpath != new_best) &&
               bgp_info_nexthop_cmp (prev_mpath, new_mpath))
             {
@@ -539,7 +554,8 @@ bgp_info_mpath_update (struct bgp_node *rn, struct bgp_info *new_best,
                             sockunion2str (new_mpath->peer->su_remote,
                                            nh_buf[1], sizeof (nh_buf[1])));
             }
-          mp_node = mp_next_node;
+          mp_node = (++mp_index < mp_list->count) ?
+            mp_list->paths[mp_index] : NULL;
         }
     }
 
@@ -48,6 +48,17 @@ struct bgp_info_mpath
   struct attr *mp_attr;
 };
 
+/* Candidate multipaths found by bgp_best_selection, kept sorted by
+ * bgp_info_mpath_cmp.  The array is kept from one selection to the
+ * next, so it is only allocated as it grows.
+ */
+struct bgp_mp_list
+{
+  struct bgp_info **paths;
+  unsigned int count;
+  unsigned int size;
+};
+
 /* Functions to support maximum-paths configuration */
 extern int bgp_maximum_paths_set (struct bgp *, afi_t, safi_t, int, u_int16_t);
 extern int bgp_maximum_paths_unset (struct bgp *, afi_t, safi_t, int);
@@ -55,12 +66,12 @@ extern int bgp_maximum_paths_unset (struct bgp *, afi_t, safi_t, int);
 /* Functions used by bgp_best_selection to record current
  * multipath selections
  */
-extern void bgp_mp_list_init (struct list *);
-extern void bgp_mp_list_clear (struct list *);
-extern void bgp_mp_list_add (struct list *, struct bgp_info *);
+extern void bgp_mp_list_init (struct bgp_mp_list *);
+extern void bgp_mp_list_clear (struct bgp_mp_list *);
+extern void bgp_mp_list_add (struct bgp_mp_list *, struct bgp_info *);
 extern void bgp_mp_dmed_deselect (struct bgp_info *);
 extern void bgp_info_mpath_update (struct bgp_node *, struct bgp_info *,
-                                   struct bgp_info *, struct list *,
+                                   struct bgp_info *, struct bgp_mp_list *,
                                    struct bgp_maxpaths_cfg *);
 extern void bgp_info_mpath_aggregate_update (struct bgp_info *,
                                              struct bgp_info *);
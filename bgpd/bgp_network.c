@@ -180,6 +180,8 @@ bgp_accept (struct thread *thread)
       sockopt_minttl (peer1->su.sa.sa_family, bgp_sock, MAXTTL + 1 - peer1->gtsm_hops);
   }
 
+  bgp_sock_profile_apply (peer1, bgp_sock);
+
   /* Make dummy peer until read Open packet. */
   if (BGP_DEBUG (events, EVENTS))
     zlog_debug ("[Event] Make dummy peer structure until read Open packet");
@@ -206,6 +208,22 @@ bgp_accept (struct thread *thread)
   return 0;
 }
 
+/* Size the buffers of fd, a connection to peer, and set its not sent low
+   water mark, as its socket profile has them.  What the profile leaves at
+   0 is left to the kernel. */
+void
+bgp_sock_profile_apply (struct peer *peer, int fd)
+{
+  const struct bgp_sock_profile *sp = peer_sock_profile (peer);
+
+  if (sp->sndbuf)
+    setsockopt_so_sendbuf (fd, sp->sndbuf);
+  if (sp->rcvbuf)
+    setsockopt_so_recvbuf (fd, sp->rcvbuf);
+  if (sp->notsent_lowat)
+    sockopt_notsent_lowat (fd, sp->notsent_lowat);
+}
+
 /* BGP socket bind. */
 static int
 bgp_bind (struct peer *peer)
@@ -315,6 +333,10 @@ bgp_connect (struct peer *peer)
 
   sockopt_reuseaddr (peer->fd);
   sockopt_reuseport (peer->fd);
+
+  /* Before the connect, for the window scale to suit the receive
+     buffer. */
+  bgp_sock_profile_apply (peer, peer->fd);
   
 #ifdef IPTOS_PREC_INTERNETCONTROL
   if (bgpd_privs.change (ZPRIVS_RAISE))
@@ -24,6 +24,7 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 extern int bgp_socket (unsigned short, const char *);
 extern void bgp_close (void);
 extern int bgp_connect (struct peer *);
+extern void bgp_sock_profile_apply (struct peer *, int);
 extern void bgp_getsockname (struct peer *);
 
 extern int bgp_md5_set (struct peer *);
@@ -36,6 +36,7 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #include "bgpd/bgp_route.h"
 #include "bgpd/bgp_attr.h"
 #include "bgpd/bgp_nexthop.h"
+#include "bgpd/bgp_aspath.h"
 #include "bgpd/bgp_debug.h"
 #include "bgpd/bgp_damp.h"
 #include "zebra/rib.h"
@@ -66,8 +67,21 @@ static struct bgp_table *cache2_table[AFI_MAX];
 /* Route table for connected route. */
 static struct bgp_table *bgp_connected_table[AFI_MAX];
 
+/* Pending re-check of paths whose nexthop must be on a connected
+   network, after a connected route changed. */
+static struct thread *bgp_onlink_thread = NULL;
+
 /* BGP nexthop lookup query client. */
 struct zclient *zlookup = NULL;
+
+/* Asynchronous zebra client, which carries nexthop tracking. */
+extern struct zclient *zclient;
+
+/* Paths which bgp_scan() is asked to re-evaluate. */
+#define BGP_SCAN_NEXTHOP   (1 << 0)
+#define BGP_SCAN_ONLINK    (1 << 1)
+#define BGP_SCAN_DAMPENING (1 << 2)
+#define BGP_SCAN_ALL       (BGP_SCAN_NEXTHOP|BGP_SCAN_ONLINK|BGP_SCAN_DAMPENING)
 
 /* Add nexthop to the end of the list.  */
 static void
@@ -106,9 +120,90 @@ bnc_new (void)
 static void
 bnc_free (struct bgp_nexthop_cache *bnc)
 {
+  struct bgp_info *ri;
+  struct bgp_info *next;
+
+  for (ri = bnc->paths; ri; ri = next)
+    {
+      next = ri->nh_next;
+      ri->nexthop_cache = NULL;
+      ri->nh_next = ri->nh_prev = NULL;
+    }
   bnc_nexthop_free (bnc);
   XFREE (MTYPE_BGP_NEXTHOP_CACHE, bnc);
 }
+
+/* Nexthops are tracked by zebra, rather than polled by bgp_scan(), as
+   long as both connections to zebra are up. */
+static int
+bgp_nht_active (void)
+{
+  return (zlookup->sock >= 0 && zclient && zclient->sock >= 0);
+}
+
+static void
+bnc_register (struct bgp_nexthop_cache *bnc)
+{
+  if (bnc->registered || ! zclient || zclient->sock < 0)
+    return;
+
+  if (zebra_nexthop_send (ZEBRA_NEXTHOP_REGISTER, zclient,
+			  &bnc->node->p) == 0)
+    bnc->registered = 1;
+}
+
+/* Forget a tracked entry nobody resolves over any more. */
+static void
+bnc_release (struct bgp_nexthop_cache *bnc)
+{
+  struct bgp_node *rn = bnc->node;
+
+  if (zclient && zclient->sock >= 0)
+    zebra_nexthop_send (ZEBRA_NEXTHOP_UNREGISTER, zclient, &rn->p);
+
+  rn->info = NULL;
+  bgp_unlock_node (rn);
+  bnc_free (bnc);
+}
+
+static void
+bnc_link (struct bgp_nexthop_cache *bnc, struct bgp_info *ri)
+{
+  if (ri->nexthop_cache == bnc)
+    return;
+
+  bgp_nexthop_unlink (ri);
+
+  ri->nh_prev = NULL;
+  ri->nh_next = bnc->paths;
+  if (bnc->paths)
+    bnc->paths->nh_prev = ri;
+  bnc->paths = ri;
+  ri->nexthop_cache = bnc;
+}
+
+/* Detach a path from the nexthop it was resolved over. */
+void
+bgp_nexthop_unlink (struct bgp_info *ri)
+{
+  struct bgp_nexthop_cache *bnc = ri->nexthop_cache;
+
+  if (! bnc)
+    return;
+
+  if (ri->nh_next)
+    ri->nh_next->nh_prev = ri->nh_prev;
+  if (ri->nh_prev)
+    ri->nh_prev->nh_next = ri->nh_next;
+  else
+    bnc->paths = ri->nh_next;
+
+  ri->nexthop_cache = NULL;
+  ri->nh_next = ri->nh_prev = NULL;
+
+  if (! bnc->paths && bnc->registered)
+    bnc_release (bnc);
+}
 
 static int
 bgp_nexthop_same (struct nexthop *next1, struct nexthop *next2)
@@ -219,39 +314,200 @@ bgp_nexthop_onlink (afi_t afi, struct attr *attr)
   return 0;
 }
 
+/* Lookups are pipelined on the zlookup connection: a request is
+   written without waiting for the answer and zebra answers requests in
+   the order it got them, so each reply belongs to the oldest request
+   still outstanding.  Completions are applied from the read thread. */
+struct bgp_zlookup
+{
+  struct bgp_zlookup *next;
+
+  /* Request number, for debugging. */
+  u_int32_t id;
+
+  u_int16_t command;
+  struct prefix p;
+
+  /* Static route being checked, for import lookups. */
+  struct bgp *bgp;
+  afi_t afi;
+  safi_t safi;
+
+  /* Called with the reply, or NULL if there will be none. */
+  void (*complete) (struct bgp_zlookup *, struct stream *);
+};
+
+static struct bgp_zlookup *zlookup_head = NULL;
+static struct bgp_zlookup *zlookup_tail = NULL;
+static u_int32_t zlookup_id;
+
+/* Import lookups still outstanding. */
+static unsigned long zlookup_imports;
+
+static void
+bgp_zlookup_free (struct bgp_zlookup *req)
+{
+  if (req->bgp)
+    bgp_unlock (req->bgp);
+  XFREE (MTYPE_BGP_ZLOOKUP, req);
+}
+
+/* The lookup connection went away: nothing outstanding will be
+   answered.  Unless we are shutting down, complete the requests as if
+   lookups were disabled. */
+static void
+bgp_zlookup_flush (int complete)
+{
+  struct bgp_zlookup *req;
+
+  while ((req = zlookup_head) != NULL)
+    {
+      zlookup_head = req->next;
+      if (complete)
+	(*req->complete) (req, NULL);
+      bgp_zlookup_free (req);
+    }
+  zlookup_tail = NULL;
+  zlookup_imports = 0;
+}
+
+static void
+bgp_zlookup_send (u_int16_t command, struct prefix *p, struct bgp *bgp,
+		  afi_t afi, safi_t safi,
+		  void (*complete) (struct bgp_zlookup *, struct stream *))
+{
+  struct bgp_zlookup *req;
+  struct stream *s;
+
+  req = XCALLOC (MTYPE_BGP_ZLOOKUP, sizeof (struct bgp_zlookup));
+  req->id = ++zlookup_id;
+  req->command = command;
+  prefix_copy (&req->p, p);
+  req->afi = afi;
+  req->safi = safi;
+  req->complete = complete;
+  if (bgp)
+    {
+      bgp_lock (bgp);
+      req->bgp = bgp;
+    }
+  if (command == ZEBRA_IPV4_IMPORT_LOOKUP)
+    zlookup_imports++;
+
+  s = zlookup->obuf;
+  stream_reset (s);
+  zclient_create_header (s, command);
+  switch (command)
+    {
+    case ZEBRA_IPV4_NEXTHOP_LOOKUP:
+      stream_put_in_addr (s, &p->u.prefix4);
+      break;
 #ifdef HAVE_IPV6
-/* Check specified next-hop is reachable or not. */
+    case ZEBRA_IPV6_NEXTHOP_LOOKUP:
+      stream_put (s, &p->u.prefix6, 16);
+      break;
+#endif /* HAVE_IPV6 */
+    case ZEBRA_IPV4_IMPORT_LOOKUP:
+      stream_putc (s, p->prefixlen);
+      stream_put_in_addr (s, &p->u.prefix4);
+      break;
+    }
+  stream_putw_at (s, 0, stream_get_endp (s));
+
+  if (zlookup_tail)
+    zlookup_tail->next = req;
+  else
+    zlookup_head = req;
+  zlookup_tail = req;
+
+  if (zclient_send_message (zlookup) < 0)
+    {
+      zlog_err ("can't write to zlookup->sock");
+      bgp_zlookup_flush (1);
+    }
+}
+
+/* Reply to the oldest outstanding lookup. */
 static int
-bgp_nexthop_lookup_ipv6 (struct peer *peer, struct bgp_info *ri, int *changed,
-			 int *metricchanged)
+bgp_zlookup_reply (int command, struct zclient *zlookup, zebra_size_t length)
 {
-  struct bgp_node *rn;
+  struct bgp_zlookup *req;
+  struct stream *s;
   struct prefix p;
-  struct bgp_nexthop_cache *bnc;
-  struct attr *attr;
-  
-  /* If lookup is not enabled, return valid. */
-  if (zlookup->sock < 0)
+  char buf[INET6_ADDRSTRLEN];
+
+  if ((req = zlookup_head) == NULL)
     {
-      if (ri->extra)
-        ri->extra->igpmetric = 0;
-      return 1;
+      zlog_warn ("%s: unsolicited %s", __func__,
+		 zserv_command_string (command));
+      return 0;
     }
-  
-  /* Only check IPv6 global address only nexthop. */
-  attr = ri->attr;
-
-  if (attr->extra->mp_nexthop_len != 16 
-      || IN6_IS_ADDR_LINKLOCAL (&attr->extra->mp_nexthop_global))
-    return 1;
+  zlookup_head = req->next;
+  if (! zlookup_head)
+    zlookup_tail = NULL;
+  if (req->command == ZEBRA_IPV4_IMPORT_LOOKUP)
+    zlookup_imports--;
 
+  s = zlookup->ibuf;
   memset (&p, 0, sizeof (struct prefix));
-  p.family = AF_INET6;
-  p.prefixlen = IPV6_MAX_BITLEN;
-  p.u.prefix6 = attr->extra->mp_nexthop_global;
+  p.family = req->p.family;
+  p.prefixlen = req->p.prefixlen;
+  if (p.family == AF_INET)
+    p.u.prefix4.s_addr = stream_get_ipv4 (s);
+#ifdef HAVE_IPV6
+  else if (p.family == AF_INET6)
+    stream_get (&p.u.prefix6, s, 16);
+#endif /* HAVE_IPV6 */
+
+  if (command != req->command || ! prefix_same (&p, &req->p))
+    {
+      zlog_err ("%s: %s does not answer lookup %u for %s", __func__,
+		zserv_command_string (command), req->id,
+		inet_ntop (req->p.family, &req->p.u.prefix, buf,
+			   INET6_ADDRSTRLEN));
+      s = NULL;
+    }
+
+  (*req->complete) (req, s);
+  bgp_zlookup_free (req);
+  return 0;
+}
+
+static void bnc_lookup_done (struct bgp_zlookup *, struct stream *);
+
+/* Copy what is known about a nexthop. */
+static void
+bnc_copy (struct bgp_nexthop_cache *bnc, struct bgp_nexthop_cache *from)
+{
+  struct nexthop *nexthop;
+  struct nexthop *copy;
+
+  bnc->valid = from->valid;
+  bnc->resolved = from->resolved;
+  bnc->metric = from->metric;
+  bnc->nexthop_num = from->nexthop_num;
+  for (nexthop = from->nexthop; nexthop; nexthop = nexthop->next)
+    {
+      copy = XCALLOC (MTYPE_NEXTHOP, sizeof (struct nexthop));
+      memcpy (copy, nexthop, sizeof (struct nexthop));
+      copy->next = copy->prev = NULL;
+      bnc_nexthop_add (bnc, copy);
+    }
+}
 
-  /* IBGP or ebgp-multihop */
-  rn = bgp_node_get (bgp_nexthop_cache_table[AFI_IP6], &p);
+/* Find or create the cache entry of a nexthop and resolve the path over
+   it.  A new entry is looked up asynchronously; until the answer comes
+   it carries what the previous scan found, if anything. */
+static int
+bgp_nexthop_cache_check (afi_t afi, struct prefix *p, struct bgp_info *ri,
+			 int *changed, int *metricchanged)
+{
+  struct bgp_node *rn;
+  struct bgp_nexthop_cache *bnc;
+  struct bgp_table *old;
+  struct bgp_node *oldrn;
+
+  rn = bgp_node_get (bgp_nexthop_cache_table[afi], p);
 
   if (rn->info)
     {
@@ -260,36 +516,33 @@ bgp_nexthop_lookup_ipv6 (struct peer *peer, struct bgp_info *ri, int *changed,
     }
   else
     {
-      if (NULL == (bnc = zlookup_query_ipv6 (&attr->extra->mp_nexthop_global)))
-	bnc = bnc_new ();
-      else
-	{
-	  if (changed)
-	    {
-	      struct bgp_table *old;
-	      struct bgp_node *oldrn;
-
-	      if (bgp_nexthop_cache_table[AFI_IP6] == cache1_table[AFI_IP6])
-		old = cache2_table[AFI_IP6];
-	      else
-		old = cache1_table[AFI_IP6];
-
-	      oldrn = bgp_node_lookup (old, &p);
-	      if (oldrn)
-		{
-		  struct bgp_nexthop_cache *oldbnc = oldrn->info;
-
-		  bnc->changed = bgp_nexthop_cache_different (bnc, oldbnc);
+      bnc = bnc_new ();
+      rn->info = bnc;
+      bnc->node = rn;
 
-		  if (bnc->metric != oldbnc->metric)
-		    bnc->metricchanged = 1;
+      if (bgp_nexthop_cache_table[afi] == cache1_table[afi])
+	old = cache2_table[afi];
+      else
+	old = cache1_table[afi];
 
-                  bgp_unlock_node (oldrn);
-		}
-	    }
+      oldrn = bgp_node_lookup (old, p);
+      if (oldrn)
+	{
+	  if (oldrn->info)
+	    bnc_copy (bnc, oldrn->info);
+	  bgp_unlock_node (oldrn);
 	}
-      rn->info = bnc;
+
+      /* Zebra answers a registration with the current state, so only
+	 ask separately if we could not register. */
+      bnc->pending = 1;
+      bnc_register (bnc);
+      if (! bnc->registered)
+	bgp_zlookup_send (afi == AFI_IP ? ZEBRA_IPV4_NEXTHOP_LOOKUP
+			  : ZEBRA_IPV6_NEXTHOP_LOOKUP,
+			  p, NULL, afi, SAFI_UNICAST, bnc_lookup_done);
     }
+  bnc_link (bnc, ri);
 
   if (changed)
     *changed = bnc->changed;
@@ -297,6 +550,11 @@ bgp_nexthop_lookup_ipv6 (struct peer *peer, struct bgp_info *ri, int *changed,
   if (metricchanged)
     *metricchanged = bnc->metricchanged;
 
+  /* Nothing known yet: a path already in the RIB keeps its state, a
+     new one waits for the answer. */
+  if (! bnc->resolved)
+    return ri->net ? (CHECK_FLAG (ri->flags, BGP_INFO_VALID) != 0) : 0;
+
   if (bnc->valid && bnc->metric)
     (bgp_info_extra_get (ri))->igpmetric = bnc->metric;
   else if (ri->extra)
@@ -304,6 +562,30 @@ bgp_nexthop_lookup_ipv6 (struct peer *peer, struct bgp_info *ri, int *changed,
 
   return bnc->valid;
 }
+
+#ifdef HAVE_IPV6
+/* Check specified next-hop is reachable or not. */
+static int
+bgp_nexthop_lookup_ipv6 (struct peer *peer, struct bgp_info *ri, int *changed,
+			 int *metricchanged)
+{
+  struct prefix p;
+  struct attr *attr;
+  
+  /* Only check IPv6 global address only nexthop. */
+  attr = ri->attr;
+
+  if (attr->extra->mp_nexthop_len != 16 
+      || IN6_IS_ADDR_LINKLOCAL (&attr->extra->mp_nexthop_global))
+    return 1;
+
+  memset (&p, 0, sizeof (struct prefix));
+  p.family = AF_INET6;
+  p.prefixlen = IPV6_MAX_BITLEN;
+  p.u.prefix6 = attr->extra->mp_nexthop_global;
+
+  return bgp_nexthop_cache_check (AFI_IP6, &p, ri, changed, metricchanged);
+}
 #endif /* HAVE_IPV6 */
 
 /* Check specified next-hop is reachable or not. */
@@ -311,14 +593,13 @@ int
 bgp_nexthop_lookup (afi_t afi, struct peer *peer, struct bgp_info *ri,
 		    int *changed, int *metricchanged)
 {
-  struct bgp_node *rn;
   struct prefix p;
-  struct bgp_nexthop_cache *bnc;
-  struct in_addr addr;
   
   /* If lookup is not enabled, return valid. */
   if (zlookup->sock < 0)
     {
+      if (zlookup_head)
+	bgp_zlookup_flush (1);
       if (ri->extra)
         ri->extra->igpmetric = 0;
       return 1;
@@ -329,66 +610,12 @@ bgp_nexthop_lookup (afi_t afi, struct peer *peer, struct bgp_info *ri,
     return bgp_nexthop_lookup_ipv6 (peer, ri, changed, metricchanged);
 #endif /* HAVE_IPV6 */
 
-  addr = ri->attr->nexthop;
-
   memset (&p, 0, sizeof (struct prefix));
   p.family = AF_INET;
   p.prefixlen = IPV4_MAX_BITLEN;
-  p.u.prefix4 = addr;
-
-  /* IBGP or ebgp-multihop */
-  rn = bgp_node_get (bgp_nexthop_cache_table[AFI_IP], &p);
-
-  if (rn->info)
-    {
-      bnc = rn->info;
-      bgp_unlock_node (rn);
-    }
-  else
-    {
-      if (NULL == (bnc = zlookup_query (addr)))
-	bnc = bnc_new ();
-      else
-	{
-	  if (changed)
-	    {
-	      struct bgp_table *old;
-	      struct bgp_node *oldrn;
-
-	      if (bgp_nexthop_cache_table[AFI_IP] == cache1_table[AFI_IP])
-		old = cache2_table[AFI_IP];
-	      else
-		old = cache1_table[AFI_IP];
-
-	      oldrn = bgp_node_lookup (old, &p);
-	      if (oldrn)
-		{
-		  struct bgp_nexthop_cache *oldbnc = oldrn->info;
-
-		  bnc->changed = bgp_nexthop_cache_different (bnc, oldbnc);
-
-		  if (bnc->metric != oldbnc->metric)
-		    bnc->metricchanged = 1;
-
-                  bgp_unlock_node (oldrn);
-		}
-	    }
-	}
-      rn->info = bnc;
-    }
-
-  if (changed)
-    *changed = bnc->changed;
+  p.u.prefix4 = ri->attr->nexthop;
 
-  if (metricchanged)
-    *metricchanged = bnc->metricchanged;
-
-  if (bnc->valid && bnc->metric)
-    (bgp_info_extra_get(ri))->igpmetric = bnc->metric;
-  else if (ri->extra)
-    ri->extra->igpmetric = 0;
-
-  return bnc->valid;
+  return bgp_nexthop_cache_check (AFI_IP, &p, ri, changed, metricchanged);
 }
 
 /* Reset and free all BGP nexthop cache. */
@@ -401,31 +628,121 @@ bgp_nexthop_cache_reset (struct bgp_table *table)
   for (rn = bgp_table_top (table); rn; rn = bgp_route_next (rn))
     if ((bnc = rn->info) != NULL)
       {
+	if (bnc->registered && zclient && zclient->sock >= 0)
+	  zebra_nexthop_send (ZEBRA_NEXTHOP_UNREGISTER, zclient, &rn->p);
 	bnc_free (bnc);
 	rn->info = NULL;
 	bgp_unlock_node (rn);
       }
 }
 
+/* Apply a new reachability verdict to a path.  Returns 1 if the path
+   changed state. */
+static int
+bgp_nexthop_path_set (struct bgp *bgp, struct bgp_node *rn,
+		      struct bgp_info *bi, afi_t afi, int valid, int changed)
+{
+  int current;
+
+  current = CHECK_FLAG (bi->flags, BGP_INFO_VALID) ? 1 : 0;
+
+  if (changed)
+    SET_FLAG (bi->flags, BGP_INFO_IGP_CHANGED);
+  else
+    UNSET_FLAG (bi->flags, BGP_INFO_IGP_CHANGED);
+
+  if (valid == current)
+    return 0;
+
+  if (CHECK_FLAG (bi->flags, BGP_INFO_VALID))
+    {
+      bgp_aggregate_decrement (bgp, &rn->p, bi, afi, SAFI_UNICAST);
+      bgp_info_unset_flag (rn, bi, BGP_INFO_VALID);
+    }
+  else
+    {
+      bgp_info_set_flag (rn, bi, BGP_INFO_VALID);
+      bgp_aggregate_increment (bgp, &rn->p, bi, afi, SAFI_UNICAST);
+    }
+  return 1;
+}
+
 static void
-bgp_scan (afi_t afi, safi_t safi)
+bgp_scan_table (struct bgp *bgp, afi_t afi, int flags)
 {
   struct bgp_node *rn;
-  struct bgp *bgp;
   struct bgp_info *bi;
   struct bgp_info *next;
-  struct peer *peer;
-  struct listnode *node, *nnode;
   int valid;
-  int current;
   int changed;
   int metricchanged;
+  int process;
+
+  for (rn = bgp_table_top (bgp->rib[afi][SAFI_UNICAST]); rn;
+       rn = bgp_route_next (rn))
+    {
+      process = CHECK_FLAG (flags, BGP_SCAN_NEXTHOP|BGP_SCAN_DAMPENING);
+
+      for (bi = rn->info; bi; bi = next)
+	{
+	  next = bi->next;
+
+	  if (bi->type == ZEBRA_ROUTE_BGP && bi->sub_type == BGP_ROUTE_NORMAL)
+	    {
+	      changed = 0;
+	      metricchanged = 0;
+
+	      if (bi->peer->sort == BGP_PEER_EBGP && bi->peer->ttl == 1
+		  && !CHECK_FLAG(bi->peer->flags, PEER_FLAG_DISABLE_CONNECTED_CHECK))
+		{
+		  if (CHECK_FLAG (flags, BGP_SCAN_ONLINK))
+		    {
+		      valid = bgp_nexthop_onlink (afi, bi->attr);
+		      if (bgp_nexthop_path_set (bgp, rn, bi, afi, valid, 0))
+			process = 1;
+		    }
+		}
+	      else if (CHECK_FLAG (flags, BGP_SCAN_NEXTHOP))
+		{
+		  valid = bgp_nexthop_lookup (afi, bi->peer, bi,
+					      &changed, &metricchanged);
+		  bgp_nexthop_path_set (bgp, rn, bi, afi, valid, changed);
+		}
+
+              if (CHECK_FLAG (flags, BGP_SCAN_DAMPENING)
+		  && CHECK_FLAG (bgp->af_flags[afi][SAFI_UNICAST],
+				 BGP_CONFIG_DAMPENING)
+                  &&  bi->extra && bi->extra->damp_info )
+                if (bgp_damp_scan (bi, afi, SAFI_UNICAST))
+		  bgp_aggregate_increment (bgp, &rn->p, bi,
+					   afi, SAFI_UNICAST);
+	    }
+	}
+      if (process)
+	bgp_process (bgp, rn, afi, SAFI_UNICAST);
+    }
+}
+
+static void
+bgp_scan (afi_t afi, safi_t safi)
+{
+  struct bgp *bgp;
+  struct peer *peer;
+  struct listnode *node, *nnode;
+  int nht;
+
+  /* With zebra tracking nexthops for us, only the housekeeping which
+     is time driven remains to be done here. */
+  nht = bgp_nht_active ();
 
   /* Change cache. */
-  if (bgp_nexthop_cache_table[afi] == cache1_table[afi])
-    bgp_nexthop_cache_table[afi] = cache2_table[afi];
-  else
-    bgp_nexthop_cache_table[afi] = cache1_table[afi];
+  if (! nht)
+    {
+      if (bgp_nexthop_cache_table[afi] == cache1_table[afi])
+	bgp_nexthop_cache_table[afi] = cache2_table[afi];
+      else
+	bgp_nexthop_cache_table[afi] = cache1_table[afi];
+    }
 
   /* Get default bgp. */
   bgp = bgp_get_default ();
@@ -446,81 +763,279 @@ bgp_scan (afi_t afi, safi_t safi)
 	bgp_maximum_prefix_overflow (peer, afi, SAFI_MPLS_VPN, 1);
     }
 
-  for (rn = bgp_table_top (bgp->rib[afi][SAFI_UNICAST]); rn;
-       rn = bgp_route_next (rn))
+  if (! nht)
+    bgp_scan_table (bgp, afi, BGP_SCAN_ALL);
+  else if (CHECK_FLAG (bgp->af_flags[afi][SAFI_UNICAST], BGP_CONFIG_DAMPENING))
+    bgp_scan_table (bgp, afi, BGP_SCAN_DAMPENING);
+
+  /* Flash old cache. */
+  if (! nht)
     {
-      for (bi = rn->info; bi; bi = next)
+      if (bgp_nexthop_cache_table[afi] == cache1_table[afi])
+	bgp_nexthop_cache_reset (cache2_table[afi]);
+      else
+	bgp_nexthop_cache_reset (cache1_table[afi]);
+    }
+
+  if (BGP_DEBUG (events, EVENTS))
+    {
+      if (afi == AFI_IP)
+	zlog_debug ("scanning IPv4 Unicast routing tables");
+      else if (afi == AFI_IP6)
+	zlog_debug ("scanning IPv6 Unicast routing tables");
+    }
+
+  /* Reevaluate default-originate route-maps and announce/withdraw
+   * default route if neccesary. */
+  for (ALL_LIST_ELEMENTS (bgp->peer, node, nnode, peer))
+    {
+      if (peer->status == Established
+	  && CHECK_FLAG(peer->af_flags[afi][safi], PEER_FLAG_DEFAULT_ORIGINATE)
+	  && peer->default_rmap[afi][safi].name)
+	bgp_default_originate (peer, afi, safi, 0);
+    }
+}
+
+/* A connected route came or went.  Tracked nexthops hear about it from
+   zebra, but directly connected EBGP peers' nexthops are checked
+   against our own copy of the connected table. */
+static int
+bgp_scan_onlink (struct thread *t)
+{
+  struct bgp *bgp;
+
+  bgp_onlink_thread = NULL;
+
+  bgp = bgp_get_default ();
+  if (bgp == NULL)
+    return 0;
+
+  bgp_scan_table (bgp, AFI_IP, BGP_SCAN_ONLINK);
+#ifdef HAVE_IPV6
+  bgp_scan_table (bgp, AFI_IP6, BGP_SCAN_ONLINK);
+#endif /* HAVE_IPV6 */
+  return 0;
+}
+
+static void
+bgp_scan_onlink_event (void)
+{
+  if (bgp_nht_active () && ! bgp_onlink_thread)
+    bgp_onlink_thread = thread_add_event (master, bgp_scan_onlink, NULL, 0);
+}
+
+/* Read the nexthops of a zebra nexthop lookup or update. */
+static void
+bnc_nexthop_read (struct stream *s, struct bgp_nexthop_cache *bnc,
+		  u_char nexthop_num)
+{
+  struct nexthop *nexthop;
+  int i;
+
+  for (i = 0; i < nexthop_num; i++)
+    {
+      nexthop = XCALLOC (MTYPE_NEXTHOP, sizeof (struct nexthop));
+      nexthop->type = stream_getc (s);
+      switch (nexthop->type)
 	{
-	  next = bi->next;
+	case ZEBRA_NEXTHOP_IPV4:
+	  nexthop->gate.ipv4.s_addr = stream_get_ipv4 (s);
+	  break;
+	case ZEBRA_NEXTHOP_IPV4_IFINDEX:
+	  nexthop->gate.ipv4.s_addr = stream_get_ipv4 (s);
+	  nexthop->ifindex = stream_getl (s);
+	  break;
+	case ZEBRA_NEXTHOP_IFINDEX:
+	case ZEBRA_NEXTHOP_IFNAME:
+	  nexthop->ifindex = stream_getl (s);
+	  break;
+#ifdef HAVE_IPV6
+	case ZEBRA_NEXTHOP_IPV6:
+	  stream_get (&nexthop->gate.ipv6, s, 16);
+	  break;
+	case ZEBRA_NEXTHOP_IPV6_IFINDEX:
+	case ZEBRA_NEXTHOP_IPV6_IFNAME:
+	  stream_get (&nexthop->gate.ipv6, s, 16);
+	  nexthop->ifindex = stream_getl (s);
+	  break;
+#endif /* HAVE_IPV6 */
+	default:
+	  /* do nothing */
+	  break;
+	}
+      bnc_nexthop_add (bnc, nexthop);
+    }
+}
 
-	  if (bi->type == ZEBRA_ROUTE_BGP && bi->sub_type == BGP_ROUTE_NORMAL)
-	    {
-	      changed = 0;
-	      metricchanged = 0;
+/* Read the reachability part of a zebra nexthop lookup or update. */
+static struct bgp_nexthop_cache *
+bnc_read (struct stream *s)
+{
+  struct bgp_nexthop_cache *bnc;
 
-	      if (bi->peer->sort == BGP_PEER_EBGP && bi->peer->ttl == 1
-		  && !CHECK_FLAG(bi->peer->flags, PEER_FLAG_DISABLE_CONNECTED_CHECK))
-		valid = bgp_nexthop_onlink (afi, bi->attr);
-	      else
-		valid = bgp_nexthop_lookup (afi, bi->peer, bi,
-					    &changed, &metricchanged);
+  bnc = bnc_new ();
+  bnc->metric = stream_getl (s);
+  bnc->nexthop_num = stream_getc (s);
+  bnc_nexthop_read (s, bnc, bnc->nexthop_num);
+  bnc->valid = (bnc->nexthop_num > 0);
+  if (! bnc->valid)
+    bnc->metric = 0;
+  return bnc;
+}
+
+/* Take over a fresh answer for a nexthop and re-evaluate just the
+   paths hanging off it, if anything they depend on changed. */
+static void
+bnc_apply (afi_t afi, struct bgp_nexthop_cache *bnc,
+	   struct bgp_nexthop_cache *new)
+{
+  struct bgp_info *ri;
+  struct bgp *bgp;
+  int changed = 0;
+  int metricchanged = 0;
+  char buf[INET6_ADDRSTRLEN];
+
+  if (bnc->resolved)
+    {
+      changed = (bnc->valid != new->valid
+		 || bgp_nexthop_cache_different (bnc, new));
+      metricchanged = (bnc->metric != new->metric);
+    }
+
+  bnc_nexthop_free (bnc);
+  bnc->nexthop = new->nexthop;
+  bnc->nexthop_num = new->nexthop_num;
+  bnc->valid = new->valid;
+  bnc->metric = new->metric;
+  bnc->changed = changed;
+  bnc->metricchanged = metricchanged;
+  new->nexthop = NULL;
+
+  bnc->pending = 0;
+  if (bnc->resolved && ! changed && ! metricchanged)
+    return;
+  bnc->resolved = 1;
+
+  if (BGP_DEBUG (events, EVENTS))
+    zlog_debug ("nexthop %s %s, metric %u",
+		inet_ntop (bnc->node->p.family, &bnc->node->p.u.prefix,
+			   buf, INET6_ADDRSTRLEN),
+		bnc->valid ? "reachable" : "unreachable", bnc->metric);
+
+  for (ri = bnc->paths; ri; ri = ri->nh_next)
+    {
+      if (! ri->net || CHECK_FLAG (ri->flags, BGP_INFO_REMOVED))
+	continue;
+
+      if (bnc->valid && bnc->metric)
+	(bgp_info_extra_get (ri))->igpmetric = bnc->metric;
+      else if (ri->extra)
+	ri->extra->igpmetric = 0;
 
-	      current = CHECK_FLAG (bi->flags, BGP_INFO_VALID) ? 1 : 0;
+      bgp = bgp_node_bgp (ri->net, ri->peer);
+      bgp_nexthop_path_set (bgp, ri->net, ri, afi, bnc->valid, changed);
+      bgp_process (bgp, ri->net, afi, SAFI_UNICAST);
+    }
+}
+
+/* Answer to an asynchronous nexthop lookup. */
+static void
+bnc_lookup_done (struct bgp_zlookup *req, struct stream *s)
+{
+  struct bgp_node *rn;
+  struct bgp_nexthop_cache *bnc;
+  struct bgp_nexthop_cache *new;
+  afi_t afi;
+
+  afi = family2afi (req->p.family);
+
+  if (s)
+    new = bnc_read (s);
+  else
+    {
+      /* No answer is coming; treat it like lookups being disabled. */
+      new = bnc_new ();
+      new->valid = 1;
+    }
+
+  rn = bgp_node_lookup (bgp_nexthop_cache_table[afi], &req->p);
+  if (rn)
+    {
+      bgp_unlock_node (rn);
+      if ((bnc = rn->info) != NULL && bnc->pending)
+	bnc_apply (afi, bnc, new);
+    }
+  bnc_free (new);
+}
+
+/* Zebra tells us a tracked nexthop resolves differently now, or
+   answers a registration. */
+int
+bgp_nexthop_update (int command, struct zclient *zclient,
+		    zebra_size_t length)
+{
+  struct stream *s;
+  struct prefix p;
+  struct bgp_node *rn;
+  struct bgp_nexthop_cache *bnc;
+  struct bgp_nexthop_cache *new;
+  afi_t afi;
+
+  s = zclient->ibuf;
+
+  memset (&p, 0, sizeof (struct prefix));
+  p.family = stream_getc (s);
+  switch (p.family)
+    {
+    case AF_INET:
+      p.prefixlen = IPV4_MAX_BITLEN;
+      p.u.prefix4.s_addr = stream_get_ipv4 (s);
+      break;
+#ifdef HAVE_IPV6
+    case AF_INET6:
+      p.prefixlen = IPV6_MAX_BITLEN;
+      stream_get (&p.u.prefix6, s, 16);
+      break;
+#endif /* HAVE_IPV6 */
+    default:
+      return -1;
+    }
+  afi = family2afi (p.family);
 
-	      if (changed)
-		SET_FLAG (bi->flags, BGP_INFO_IGP_CHANGED);
-	      else
-		UNSET_FLAG (bi->flags, BGP_INFO_IGP_CHANGED);
+  rn = bgp_node_lookup (bgp_nexthop_cache_table[afi], &p);
+  if (! rn)
+    return 0;
+  bgp_unlock_node (rn);
 
-	      if (valid != current)
-		{
-		  if (CHECK_FLAG (bi->flags, BGP_INFO_VALID))
-		    {
-		      bgp_aggregate_decrement (bgp, &rn->p, bi,
-					       afi, SAFI_UNICAST);
-		      bgp_info_unset_flag (rn, bi, BGP_INFO_VALID);
-		    }
-		  else
-		    {
-		      bgp_info_set_flag (rn, bi, BGP_INFO_VALID);
-		      bgp_aggregate_increment (bgp, &rn->p, bi,
-					       afi, SAFI_UNICAST);
-		    }
-		}
+  if ((bnc = rn->info) == NULL)
+    return 0;
 
-              if (CHECK_FLAG (bgp->af_flags[afi][SAFI_UNICAST],
-		  BGP_CONFIG_DAMPENING)
-                  &&  bi->extra && bi->extra->damp_info )
-                if (bgp_damp_scan (bi, afi, SAFI_UNICAST))
-		  bgp_aggregate_increment (bgp, &rn->p, bi,
-					   afi, SAFI_UNICAST);
-	    }
-	}
-      bgp_process (bgp, rn, afi, SAFI_UNICAST);
-    }
+  new = bnc_read (s);
+  bnc_apply (afi, bnc, new);
+  bnc_free (new);
+  return 0;
+}
 
-  /* Flash old cache. */
-  if (bgp_nexthop_cache_table[afi] == cache1_table[afi])
-    bgp_nexthop_cache_reset (cache2_table[afi]);
-  else
-    bgp_nexthop_cache_reset (cache1_table[afi]);
+/* (Re)connected to zebra: ask it to track every nexthop we know of. */
+void
+bgp_nexthop_zebra_connected (struct zclient *zclient)
+{
+  struct bgp_node *rn;
+  struct bgp_nexthop_cache *bnc;
+  afi_t afi;
 
-  if (BGP_DEBUG (events, EVENTS))
+  for (afi = AFI_IP; afi < AFI_MAX; afi++)
     {
-      if (afi == AFI_IP)
-	zlog_debug ("scanning IPv4 Unicast routing tables");
-      else if (afi == AFI_IP6)
-	zlog_debug ("scanning IPv6 Unicast routing tables");
-    }
+      if (! bgp_nexthop_cache_table[afi])
+	continue;
 
-  /* Reevaluate default-originate route-maps and announce/withdraw
-   * default route if neccesary. */
-  for (ALL_LIST_ELEMENTS (bgp->peer, node, nnode, peer))
-    {
-      if (peer->status == Established
-	  && CHECK_FLAG(peer->af_flags[afi][safi], PEER_FLAG_DEFAULT_ORIGINATE)
-	  && peer->default_rmap[afi][safi].name)
-	bgp_default_originate (peer, afi, safi, 0);
+      for (rn = bgp_table_top (bgp_nexthop_cache_table[afi]); rn;
+	   rn = bgp_route_next (rn))
+	if ((bnc = rn->info) != NULL)
+	  {
+	    bnc->registered = 0;
+	    bnc_register (bnc);
+	  }
     }
 }
 
@@ -540,6 +1055,8 @@ bgp_scan_timer (struct thread *t)
   bgp_scan (AFI_IP6, SAFI_UNICAST);
 #endif /* HAVE_IPV6 */
 
+  aspath_str_sweep ();
+
   return 0;
 }
 
@@ -697,6 +1214,8 @@ bgp_connected_add (struct connected *ifc)
 	}
     }
 #endif /* HAVE_IPV6 */
+
+  bgp_scan_onlink_event ();
 }
 
 void
@@ -766,6 +1285,8 @@ bgp_connected_delete (struct connected *ifc)
       bgp_unlock_node (rn);
     }
 #endif /* HAVE_IPV6 */
+
+  bgp_scan_onlink_event ();
 }
 
 int
@@ -782,340 +1303,262 @@ bgp_nexthop_self (struct attr *attr)
   return 0;
 }
 
-static struct bgp_nexthop_cache *
-zlookup_read (void)
+static void
+bgp_import_apply (struct bgp *bgp, struct bgp_node *rn,
+		  struct bgp_static *bgp_static, afi_t afi, safi_t safi,
+		  int valid, u_int32_t metric, struct in_addr *nexthop)
 {
-  struct stream *s;
-  uint16_t length;
-  u_char marker;
-  u_char version;
-  uint16_t command;
-  int nbytes;
-  struct in_addr raddr;
-  uint32_t metric;
-  int i;
-  u_char nexthop_num;
-  struct nexthop *nexthop;
-  struct bgp_nexthop_cache *bnc;
+  int old_valid;
+  u_int32_t old_metric;
+  struct in_addr old_nexthop;
 
-  s = zlookup->ibuf;
-  stream_reset (s);
+  old_valid = bgp_static->valid;
+  old_metric = bgp_static->igpmetric;
+  old_nexthop = bgp_static->igpnexthop;
 
-  nbytes = stream_read (s, zlookup->sock, 2);
-  length = stream_getw (s);
+  bgp_static->valid = valid;
+  bgp_static->igpmetric = metric;
+  if (nexthop)
+    bgp_static->igpnexthop = *nexthop;
 
-  nbytes = stream_read (s, zlookup->sock, length - 2);
-  marker = stream_getc (s);
-  version = stream_getc (s);
-  
-  if (version != ZSERV_VERSION || marker != ZEBRA_HEADER_MARKER)
+  if (bgp_static->valid != old_valid)
     {
-      zlog_err("%s: socket %d version mismatch, marker %d, version %d",
-               __func__, zlookup->sock, marker, version);
-      return NULL;
+      if (bgp_static->valid)
+	bgp_static_update (bgp, &rn->p, bgp_static, afi, safi);
+      else
+	bgp_static_withdraw (bgp, &rn->p, afi, safi);
     }
-    
-  command = stream_getw (s);
-  
-  raddr.s_addr = stream_get_ipv4 (s);
-  metric = stream_getl (s);
-  nexthop_num = stream_getc (s);
-
-  if (nexthop_num)
+  else if (bgp_static->valid)
     {
-      bnc = bnc_new ();
-      bnc->valid = 1;
-      bnc->metric = metric;
-      bnc->nexthop_num = nexthop_num;
-
-      for (i = 0; i < nexthop_num; i++)
-	{
-	  nexthop = XCALLOC (MTYPE_NEXTHOP, sizeof (struct nexthop));
-	  nexthop->type = stream_getc (s);
-	  switch (nexthop->type)
-	    {
-	    case ZEBRA_NEXTHOP_IPV4:
-	      nexthop->gate.ipv4.s_addr = stream_get_ipv4 (s);
-	      break;
-	    case ZEBRA_NEXTHOP_IPV4_IFINDEX:
-	      nexthop->gate.ipv4.s_addr = stream_get_ipv4 (s);
-	      nexthop->ifindex = stream_getl (s);
-	      break;
-	    case ZEBRA_NEXTHOP_IFINDEX:
-	    case ZEBRA_NEXTHOP_IFNAME:
-	      nexthop->ifindex = stream_getl (s);
-	      break;
-            default:
-              /* do nothing */
-              break;
-	    }
-	  bnc_nexthop_add (bnc, nexthop);
-	}
+      if (bgp_static->igpmetric != old_metric
+	  || bgp_static->igpnexthop.s_addr != old_nexthop.s_addr
+	  || bgp_static->rmap.name)
+	bgp_static_update (bgp, &rn->p, bgp_static, afi, safi);
     }
-  else
-    return NULL;
-
-  return bnc;
 }
 
-struct bgp_nexthop_cache *
-zlookup_query (struct in_addr addr)
+/* Read the metric and first nexthop of an import lookup or update;
+   whether the route is there. */
+static int
+bgp_import_read (struct stream *s, u_int32_t *metric,
+		 struct in_addr *nexthop)
 {
-  int ret;
-  struct stream *s;
+  nexthop->s_addr = 0;
+  *metric = stream_getl (s);
 
-  /* Check socket. */
-  if (zlookup->sock < 0)
-    return NULL;
+  /* If there is nexthop then this is active route. */
+  if (stream_getc (s) == 0)
+    return 0;
 
-  s = zlookup->obuf;
-  stream_reset (s);
-  zclient_create_header (s, ZEBRA_IPV4_NEXTHOP_LOOKUP);
-  stream_put_in_addr (s, &addr);
-  
-  stream_putw_at (s, 0, stream_get_endp (s));
-  
-  ret = writen (zlookup->sock, s->data, stream_get_endp (s));
-  if (ret < 0)
+  switch (stream_getc (s))
     {
-      zlog_err ("can't write to zlookup->sock");
-      close (zlookup->sock);
-      zlookup->sock = -1;
-      return NULL;
-    }
-  if (ret == 0)
-    {
-      zlog_err ("zlookup->sock connection closed");
-      close (zlookup->sock);
-      zlookup->sock = -1;
-      return NULL;
+    case ZEBRA_NEXTHOP_IPV4:
+      nexthop->s_addr = stream_get_ipv4 (s);
+      break;
+    case ZEBRA_NEXTHOP_IPV4_IFINDEX:
+      nexthop->s_addr = stream_get_ipv4 (s);
+      /* ifindex */ (void)stream_getl (s);
+      break;
+    default:
+      /* do nothing */
+      break;
     }
-
-  return zlookup_read ();
+  return 1;
 }
 
-#ifdef HAVE_IPV6
-static struct bgp_nexthop_cache *
-zlookup_read_ipv6 (void)
+/* Answer to an import check of a static route. */
+static void
+bgp_import_done (struct bgp_zlookup *req, struct stream *s)
 {
-  struct stream *s;
-  uint16_t length;
-  u_char version, marker;
-  uint16_t  command;
-  int nbytes;
-  struct in6_addr raddr;
-  uint32_t metric;
-  int i;
-  u_char nexthop_num;
-  struct nexthop *nexthop;
-  struct bgp_nexthop_cache *bnc;
+  struct bgp_node *rn;
+  struct bgp_static *bgp_static;
+  struct in_addr nexthop;
+  u_int32_t metric = 0;
+  int valid = 1;
 
-  s = zlookup->ibuf;
-  stream_reset (s);
+  nexthop.s_addr = 0;
 
-  nbytes = stream_read (s, zlookup->sock, 2);
-  length = stream_getw (s);
+  if (s)
+    valid = bgp_import_read (s, &metric, &nexthop);
 
-  nbytes = stream_read (s, zlookup->sock, length - 2);
-  marker = stream_getc (s);
-  version = stream_getc (s);
-  
-  if (version != ZSERV_VERSION || marker != ZEBRA_HEADER_MARKER)
-    {
-      zlog_err("%s: socket %d version mismatch, marker %d, version %d",
-               __func__, zlookup->sock, marker, version);
-      return NULL;
-    }
-    
-  command = stream_getw (s);
-  
-  stream_get (&raddr, s, 16);
+  /* The static route may have gone while the lookup was outstanding. */
+  rn = bgp_node_lookup (req->bgp->route[req->afi][req->safi], &req->p);
+  if (! rn)
+    return;
+  bgp_unlock_node (rn);
+
+  if ((bgp_static = rn->info) == NULL || bgp_static->backdoor)
+    return;
+
+  bgp_import_apply (req->bgp, rn, bgp_static, req->afi, req->safi,
+		    valid, metric, valid ? &nexthop : NULL);
+}
+
+/* Static routes under "bgp network import-check" are registered with
+ * zebra, which tells us when the route for the prefix comes or goes,
+ * as long as it supports that.  Otherwise bgp_import() polls them.
+ */
+static int
+bgp_import_tracked (void)
+{
+  return (zclient && zclient->sock >= 0
+	  && CHECK_FLAG (zclient->capabilities, ZEBRA_CAPABILITY_IMPORT_CHECK));
+}
+
+static int
+bgp_import_checked (struct bgp *bgp, afi_t afi, safi_t safi)
+{
+  return (bgp_flag_check (bgp, BGP_FLAG_IMPORT_CHECK)
+	  && afi == AFI_IP && safi == SAFI_UNICAST);
+}
 
-  metric = stream_getl (s);
-  nexthop_num = stream_getc (s);
+/* Whether any instance but EXCEPT import checks a static route for P. */
+static int
+bgp_import_wanted (struct prefix *p, struct bgp *except)
+{
+  struct bgp *bgp;
+  struct bgp_node *rn;
+  struct bgp_static *bgp_static;
+  struct listnode *node, *nnode;
 
-  if (nexthop_num)
+  for (ALL_LIST_ELEMENTS (bm->bgp, node, nnode, bgp))
     {
-      bnc = bnc_new ();
-      bnc->valid = 1;
-      bnc->metric = metric;
-      bnc->nexthop_num = nexthop_num;
+      if (bgp == except || ! bgp_import_checked (bgp, AFI_IP, SAFI_UNICAST))
+	continue;
 
-      for (i = 0; i < nexthop_num; i++)
-	{
-	  nexthop = XCALLOC (MTYPE_NEXTHOP, sizeof (struct nexthop));
-	  nexthop->type = stream_getc (s);
-	  switch (nexthop->type)
-	    {
-	    case ZEBRA_NEXTHOP_IPV6:
-	      stream_get (&nexthop->gate.ipv6, s, 16);
-	      break;
-	    case ZEBRA_NEXTHOP_IPV6_IFINDEX:
-	    case ZEBRA_NEXTHOP_IPV6_IFNAME:
-	      stream_get (&nexthop->gate.ipv6, s, 16);
-	      nexthop->ifindex = stream_getl (s);
-	      break;
-	    case ZEBRA_NEXTHOP_IFINDEX:
-	    case ZEBRA_NEXTHOP_IFNAME:
-	      nexthop->ifindex = stream_getl (s);
-	      break;
-	    default:
-	      /* do nothing */
-	      break;
-	    }
-	  bnc_nexthop_add (bnc, nexthop);
-	}
+      rn = bgp_node_lookup (bgp->route[AFI_IP][SAFI_UNICAST], p);
+      if (! rn)
+	continue;
+      bgp_unlock_node (rn);
+
+      if ((bgp_static = rn->info) != NULL && ! bgp_static->backdoor)
+	return 1;
     }
-  else
-    return NULL;
+  return 0;
+}
 
-  return bnc;
+/* A static route was configured at RN, or import checking turned on.
+   Zebra answers the registration with the current state. */
+void
+bgp_import_register (struct bgp *bgp, struct bgp_node *rn, afi_t afi,
+		     safi_t safi)
+{
+  struct bgp_static *bgp_static = rn->info;
+
+  if (! bgp_static || bgp_static->backdoor
+      || ! bgp_import_checked (bgp, afi, safi) || ! bgp_import_tracked ())
+    return;
+
+  zebra_import_send (ZEBRA_IMPORT_REGISTER, zclient, &rn->p);
 }
 
-struct bgp_nexthop_cache *
-zlookup_query_ipv6 (struct in6_addr *addr)
+/* The static route for P of BGP goes, or import checking is turned off
+   there.  Stop the check if no other instance needs it. */
+void
+bgp_import_unregister (struct bgp *bgp, struct prefix *p, afi_t afi,
+		       safi_t safi)
 {
-  int ret;
-  struct stream *s;
+  if (afi != AFI_IP || safi != SAFI_UNICAST || ! bgp_import_tracked ()
+      || bgp_import_wanted (p, bgp))
+    return;
 
-  /* Check socket. */
-  if (zlookup->sock < 0)
-    return NULL;
+  zebra_import_send (ZEBRA_IMPORT_UNREGISTER, zclient, p);
+}
 
-  s = zlookup->obuf;
-  stream_reset (s);
-  zclient_create_header (s, ZEBRA_IPV6_NEXTHOP_LOOKUP);
-  stream_put (s, addr, 16);
-  stream_putw_at (s, 0, stream_get_endp (s));
-  
-  ret = writen (zlookup->sock, s->data, stream_get_endp (s));
-  if (ret < 0)
-    {
-      zlog_err ("can't write to zlookup->sock");
-      close (zlookup->sock);
-      zlookup->sock = -1;
-      return NULL;
-    }
-  if (ret == 0)
-    {
-      zlog_err ("zlookup->sock connection closed");
-      close (zlookup->sock);
-      zlookup->sock = -1;
-      return NULL;
-    }
+/* "bgp network import-check" was turned on or off in BGP. */
+void
+bgp_import_check_changed (struct bgp *bgp)
+{
+  struct bgp_node *rn;
+  struct bgp_static *bgp_static;
+  struct in_addr nexthop;
+
+  nexthop.s_addr = 0;
 
-  return zlookup_read_ipv6 ();
+  for (rn = bgp_table_top (bgp->route[AFI_IP][SAFI_UNICAST]); rn;
+       rn = bgp_route_next (rn))
+    if ((bgp_static = rn->info) != NULL && ! bgp_static->backdoor)
+      {
+	if (bgp_import_checked (bgp, AFI_IP, SAFI_UNICAST))
+	  bgp_import_register (bgp, rn, AFI_IP, SAFI_UNICAST);
+	else
+	  {
+	    bgp_import_unregister (bgp, &rn->p, AFI_IP, SAFI_UNICAST);
+	    bgp_import_apply (bgp, rn, bgp_static, AFI_IP, SAFI_UNICAST,
+			      1, 0, &nexthop);
+	  }
+      }
 }
-#endif /* HAVE_IPV6 */
 
-static int
-bgp_import_check (struct prefix *p, u_int32_t *igpmetric,
-                  struct in_addr *igpnexthop)
+/* Zebra tells us whether the route for a registered prefix is there. */
+int
+bgp_import_update (int command, struct zclient *zclient,
+		   zebra_size_t length)
 {
   struct stream *s;
-  int ret;
-  u_int16_t length, command;
-  u_char version, marker;
-  int nbytes;
-  struct in_addr addr;
+  struct prefix p;
+  struct bgp *bgp;
+  struct bgp_node *rn;
+  struct bgp_static *bgp_static;
+  struct listnode *node, *nnode;
   struct in_addr nexthop;
-  u_int32_t metric = 0;
-  u_char nexthop_num;
-  u_char nexthop_type;
+  u_int32_t metric;
+  int valid;
 
-  /* If lookup connection is not available return valid. */
-  if (zlookup->sock < 0)
-    {
-      if (igpmetric)
-	*igpmetric = 0;
-      return 1;
-    }
+  s = zclient->ibuf;
 
-  /* Send query to the lookup connection */
-  s = zlookup->obuf;
-  stream_reset (s);
-  zclient_create_header (s, ZEBRA_IPV4_IMPORT_LOOKUP);
-  
-  stream_putc (s, p->prefixlen);
-  stream_put_in_addr (s, &p->u.prefix4);
-  
-  stream_putw_at (s, 0, stream_get_endp (s));
-  
-  /* Write the packet. */
-  ret = writen (zlookup->sock, s->data, stream_get_endp (s));
+  memset (&p, 0, sizeof (struct prefix));
+  p.family = stream_getc (s);
+  p.prefixlen = stream_getc (s);
+  if (p.family != AF_INET || p.prefixlen > IPV4_MAX_PREFIXLEN)
+    return -1;
+  stream_get (&p.u.prefix, s, PSIZE (p.prefixlen));
 
-  if (ret < 0)
-    {
-      zlog_err ("can't write to zlookup->sock");
-      close (zlookup->sock);
-      zlookup->sock = -1;
-      return 1;
-    }
-  if (ret == 0)
-    {
-      zlog_err ("zlookup->sock connection closed");
-      close (zlookup->sock);
-      zlookup->sock = -1;
-      return 1;
-    }
+  valid = bgp_import_read (s, &metric, &nexthop);
 
-  /* Get result. */
-  stream_reset (s);
+  if (BGP_DEBUG (events, EVENTS))
+    zlog_debug ("import check %s/%d %s, metric %u",
+		inet_ntoa (p.u.prefix4), p.prefixlen,
+		valid ? "present" : "absent", metric);
 
-  /* Fetch length. */
-  nbytes = stream_read (s, zlookup->sock, 2);
-  length = stream_getw (s);
+  for (ALL_LIST_ELEMENTS (bm->bgp, node, nnode, bgp))
+    {
+      if (! bgp_import_checked (bgp, AFI_IP, SAFI_UNICAST))
+	continue;
 
-  /* Fetch whole data. */
-  nbytes = stream_read (s, zlookup->sock, length - 2);
-  marker = stream_getc (s);
-  version = stream_getc (s);
+      rn = bgp_node_lookup (bgp->route[AFI_IP][SAFI_UNICAST], &p);
+      if (! rn)
+	continue;
+      bgp_unlock_node (rn);
 
-  if (version != ZSERV_VERSION || marker != ZEBRA_HEADER_MARKER)
-    {
-      zlog_err("%s: socket %d version mismatch, marker %d, version %d",
-               __func__, zlookup->sock, marker, version);
-      return 0;
+      if ((bgp_static = rn->info) != NULL && ! bgp_static->backdoor)
+	bgp_import_apply (bgp, rn, bgp_static, AFI_IP, SAFI_UNICAST,
+			  valid, metric, valid ? &nexthop : NULL);
     }
-    
-  command = stream_getw (s);
-  
-  addr.s_addr = stream_get_ipv4 (s);
-  metric = stream_getl (s);
-  nexthop_num = stream_getc (s);
+  return 0;
+}
 
-  /* Set IGP metric value. */
-  if (igpmetric)
-    *igpmetric = metric;
+/* Zebra answered the hello: register every import checked static
+   route if it can track them. */
+void
+bgp_import_zebra_hello (struct zclient *zclient)
+{
+  struct bgp *bgp;
+  struct bgp_node *rn;
+  struct listnode *node, *nnode;
 
-  /* If there is nexthop then this is active route. */
-  if (nexthop_num)
-    {
-      nexthop.s_addr = 0;
-      nexthop_type = stream_getc (s);
-      switch (nexthop_type)
-	{
-	case ZEBRA_NEXTHOP_IPV4:
-	  nexthop.s_addr = stream_get_ipv4 (s);
-	  break;
-	case ZEBRA_NEXTHOP_IPV4_IFINDEX:
-	  nexthop.s_addr = stream_get_ipv4 (s);
-	  /* ifindex */ (void)stream_getl (s);
-	  break;
-	default:
-	  /* do nothing */
-	  break;
-	}
-      *igpnexthop = nexthop;
+  if (! bgp_import_tracked ())
+    return;
 
-      return 1;
-    }
-  else
-    return 0;
+  for (ALL_LIST_ELEMENTS (bm->bgp, node, nnode, bgp))
+    if (bgp_import_checked (bgp, AFI_IP, SAFI_UNICAST))
+      for (rn = bgp_table_top (bgp->route[AFI_IP][SAFI_UNICAST]); rn;
+	   rn = bgp_route_next (rn))
+	bgp_import_register (bgp, rn, AFI_IP, SAFI_UNICAST);
 }
 
 /* Scan all configured BGP route then check the route exists in IGP or
-   not. */
+   not.  Only while zebra cannot track them for us. */
 static int
 bgp_import (struct thread *t)
 {
@@ -1123,18 +1566,29 @@ bgp_import (struct thread *t)
   struct bgp_node *rn;
   struct bgp_static *bgp_static;
   struct listnode *node, *nnode;
-  int valid;
-  u_int32_t metric;
   struct in_addr nexthop;
   afi_t afi;
   safi_t safi;
+  int busy;
 
   bgp_import_thread = 
     thread_add_timer (master, bgp_import, NULL, bgp_import_interval);
 
+  if (bgp_import_tracked ())
+    return 0;
+
   if (BGP_DEBUG (events, EVENTS))
     zlog_debug ("Import timer expired.");
 
+  if (zlookup->sock < 0 && zlookup_head)
+    bgp_zlookup_flush (1);
+
+  /* Don't pile up checks behind a previous round zebra is still
+     answering. */
+  busy = (zlookup_imports > 0);
+
+  nexthop.s_addr = 0;
+
   for (ALL_LIST_ELEMENTS (bm->bgp, node, nnode, bgp))
     {
       for (afi = AFI_IP; afi < AFI_MAX; afi++)
@@ -1146,35 +1600,19 @@ bgp_import (struct thread *t)
 		if (bgp_static->backdoor)
 		  continue;
 
-		valid = bgp_static->valid;
-		metric = bgp_static->igpmetric;
-		nexthop = bgp_static->igpnexthop;
-
-		if (bgp_flag_check (bgp, BGP_FLAG_IMPORT_CHECK)
-		    && afi == AFI_IP && safi == SAFI_UNICAST)
-		  bgp_static->valid = bgp_import_check (&rn->p, &bgp_static->igpmetric,
-						        &bgp_static->igpnexthop);
-		else
-		  {
-		    bgp_static->valid = 1;
-		    bgp_static->igpmetric = 0;
-		    bgp_static->igpnexthop.s_addr = 0;
-		  }
-
-		if (bgp_static->valid != valid)
-		  {
-		    if (bgp_static->valid)
-		      bgp_static_update (bgp, &rn->p, bgp_static, afi, safi);
-		    else
-		      bgp_static_withdraw (bgp, &rn->p, afi, safi);
-		  }
-		else if (bgp_static->valid)
+		if (bgp_import_checked (bgp, afi, safi))
 		  {
-		    if (bgp_static->igpmetric != metric
-			|| bgp_static->igpnexthop.s_addr != nexthop.s_addr
-			|| bgp_static->rmap.name)
-		      bgp_static_update (bgp, &rn->p, bgp_static, afi, safi);
+		    /* If lookup connection is not available it's valid. */
+		    if (zlookup->sock < 0)
+		      bgp_import_apply (bgp, rn, bgp_static, afi, safi,
+					1, 0, NULL);
+		    else if (! busy)
+		      bgp_zlookup_send (ZEBRA_IPV4_IMPORT_LOOKUP, &rn->p, bgp,
+					afi, safi, bgp_import_done);
 		  }
+		else
+		  bgp_import_apply (bgp, rn, bgp_static, afi, safi,
+				    1, 0, &nexthop);
 	      }
     }
   return 0;
@@ -1195,6 +1633,9 @@ zlookup_connect (struct thread *t)
   if (zclient_socket_connect (zlookup) < 0)
     return -1;
 
+  /* Replies are read asynchronously, see bgp_zlookup_reply. */
+  zclient_read_start (zlookup);
+
   return 0;
 }
 
@@ -1429,6 +1870,9 @@ bgp_scan_init (void)
 {
   zlookup = zclient_new ();
   zlookup->sock = -1;
+  zlookup->ipv4_nexthop_lookup = bgp_zlookup_reply;
+  zlookup->ipv6_nexthop_lookup = bgp_zlookup_reply;
+  zlookup->ipv4_import_lookup = bgp_zlookup_reply;
   zlookup->t_connect = thread_add_event (master, zlookup_connect, zlookup, 0);
 
   bgp_scan_interval = BGP_SCAN_INTERVAL_DEFAULT;
@@ -1439,12 +1883,14 @@ bgp_scan_init (void)
   bgp_nexthop_cache_table[AFI_IP] = cache1_table[AFI_IP];
 
   bgp_connected_table[AFI_IP] = bgp_table_init (AFI_IP, SAFI_UNICAST);
+  route_table_enable_index (bgp_connected_table[AFI_IP]->route_table);
 
 #ifdef HAVE_IPV6
   cache1_table[AFI_IP6] = bgp_table_init (AFI_IP6, SAFI_UNICAST);
   cache2_table[AFI_IP6] = bgp_table_init (AFI_IP6, SAFI_UNICAST);
   bgp_nexthop_cache_table[AFI_IP6] = cache1_table[AFI_IP6];
   bgp_connected_table[AFI_IP6] = bgp_table_init (AFI_IP6, SAFI_UNICAST);
+  route_table_enable_index (bgp_connected_table[AFI_IP6]->route_table);
 #endif /* HAVE_IPV6 */
 
   /* Make BGP scan thread. */
@@ -1466,6 +1912,8 @@ bgp_scan_init (void)
 void
 bgp_scan_finish (void)
 {
+  bgp_zlookup_flush (0);
+
   /* Only the current one needs to be reset. */
   bgp_nexthop_cache_reset (bgp_nexthop_cache_table[AFI_IP]);
 
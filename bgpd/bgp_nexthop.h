@@ -22,6 +22,7 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #define _QUAGGA_BGP_NEXTHOP_H
 
 #include "if.h"
+#include "zclient.h"
 
 #define BGP_SCAN_INTERVAL_DEFAULT   60
 #define BGP_IMPORT_INTERVAL_DEFAULT 15
@@ -44,6 +45,19 @@ struct bgp_nexthop_cache
   /* Nexthop number and nexthop linked list.*/
   u_char nexthop_num;
   struct nexthop *nexthop;
+
+  /* Zebra reports changes of this nexthop to us. */
+  u_char registered;
+
+  /* A lookup is outstanding; whether it already answered earlier. */
+  u_char pending;
+  u_char resolved;
+
+  /* Node of the nexthop cache table holding this entry. */
+  struct bgp_node *node;
+
+  /* Paths resolved over this nexthop. */
+  struct bgp_info *paths;
 };
 
 extern void bgp_scan_init (void);
@@ -57,5 +71,15 @@ extern int bgp_config_write_scan_time (struct vty *);
 extern int bgp_nexthop_onlink (afi_t, struct attr *);
 extern int bgp_nexthop_self (struct attr *);
 extern void bgp_address_init (void);
+extern void bgp_nexthop_unlink (struct bgp_info *);
+extern int bgp_nexthop_update (int, struct zclient *, zebra_size_t);
+extern void bgp_nexthop_zebra_connected (struct zclient *);
+extern void bgp_import_register (struct bgp *, struct bgp_node *, afi_t,
+				 safi_t);
+extern void bgp_import_unregister (struct bgp *, struct prefix *, afi_t,
+				   safi_t);
+extern void bgp_import_check_changed (struct bgp *);
+extern int bgp_import_update (int, struct zclient *, zebra_size_t);
+extern void bgp_import_zebra_hello (struct zclient *);
 
 #endif /* _QUAGGA_BGP_NEXTHOP_H */
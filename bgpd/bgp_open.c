@@ -414,6 +414,43 @@ bgp_capability_as4 (struct peer *peer, struct capability_header *hdr)
   return as4;
 }
 
+/* The peer tells which address families it can receive, or send,
+   several paths per prefix in.  Only sending is supported, and only
+   in IPv4 unicast. */
+static int
+bgp_capability_addpath (struct peer *peer, struct capability_header *hdr)
+{
+  struct stream *s = BGP_INPUT (peer);
+  size_t end = stream_get_getp (s) + hdr->length;
+
+  if (hdr->length % CAPABILITY_CODE_ADDPATH_LEN)
+    {
+      zlog_info ("%s ADD-PATH capability has incorrect data length %d",
+                 peer->host, hdr->length);
+      return -1;
+    }
+
+  while (stream_get_getp (s) + CAPABILITY_CODE_ADDPATH_LEN <= end)
+    {
+      afi_t afi = stream_getw (s);
+      safi_t safi = stream_getc (s);
+      u_char mode = stream_getc (s);
+
+      if (BGP_DEBUG (normal, NORMAL))
+        zlog_debug ("%s OPEN has ADD-PATH capability for afi/safi %u/%u,"
+                    " %s%s", peer->host, afi, safi,
+                    CHECK_FLAG (mode, ADDPATH_MODE_RECEIVE) ? "receive " : "",
+                    CHECK_FLAG (mode, ADDPATH_MODE_SEND) ? "send" : "");
+
+      if (afi != AFI_IP || safi != SAFI_UNICAST)
+        continue;
+
+      if (CHECK_FLAG (mode, ADDPATH_MODE_RECEIVE))
+        SET_FLAG (peer->af_cap[afi][safi], PEER_CAP_ADDPATH_AF_RX_RCV);
+    }
+  return 0;
+}
+
 static const struct message capcode_str[] =
 {
   { CAPABILITY_CODE_MP,			"MultiProtocol Extensions"	},
@@ -422,6 +459,7 @@ static const struct message capcode_str[] =
   { CAPABILITY_CODE_RESTART,		"Graceful Restart"		},
   { CAPABILITY_CODE_AS4,		"4-octet AS number"		},
   { CAPABILITY_CODE_DYNAMIC,		"Dynamic"			},
+  { CAPABILITY_CODE_ADDPATH,		"ADD-PATH"			},
   { CAPABILITY_CODE_REFRESH_OLD,	"Route Refresh (Old)"		},
   { CAPABILITY_CODE_ORF_OLD,		"ORF (Old)"			},
 };
@@ -436,6 +474,7 @@ static const size_t cap_minsizes[] =
   [CAPABILITY_CODE_RESTART]	= sizeof (struct capability_gr),
   [CAPABILITY_CODE_AS4]		= CAPABILITY_CODE_AS4_LEN,
   [CAPABILITY_CODE_DYNAMIC]	= CAPABILITY_CODE_DYNAMIC_LEN,
+  [CAPABILITY_CODE_ADDPATH]	= CAPABILITY_CODE_ADDPATH_LEN,
   [CAPABILITY_CODE_REFRESH_OLD]	= CAPABILITY_CODE_REFRESH_LEN,
   [CAPABILITY_CODE_ORF_OLD]	= sizeof (struct capability_orf_entry),
 };
@@ -500,6 +539,7 @@ bgp_capability_parse (struct peer *peer, size_t length, int *mp_capability,
           case CAPABILITY_CODE_RESTART:
           case CAPABILITY_CODE_AS4:
           case CAPABILITY_CODE_DYNAMIC:
+          case CAPABILITY_CODE_ADDPATH:
               /* Check length. */
               if (caphdr.length < cap_minsizes[caphdr.code])
                 {
@@ -561,6 +601,13 @@ bgp_capability_parse (struct peer *peer, size_t length, int *mp_capability,
           case CAPABILITY_CODE_DYNAMIC:
             SET_FLAG (peer->cap, PEER_CAP_DYNAMIC_RCV);
             break;
+          case CAPABILITY_CODE_ADDPATH:
+            if (bgp_capability_addpath (peer, &caphdr))
+              {
+                bgp_notify_send (peer, BGP_NOTIFY_CEASE, 0);
+                return -1;
+              }
+            break;
           case CAPABILITY_CODE_AS4:
               /* Already handled as a special-case parsing of the capabilities
                * at the beginning of OPEN processing. So we care not a jot
@@ -1010,6 +1057,21 @@ bgp_open_capability (struct stream *s, struct peer *peer)
 	  bgp_open_capability_orf (s, peer, afi, safi, CAPABILITY_CODE_ORF);
 	}
 
+  /* ADD-PATH capability, send only. */
+  if (peer->afc[AFI_IP][SAFI_UNICAST]
+      && CHECK_FLAG (peer->af_flags[AFI_IP][SAFI_UNICAST],
+                     PEER_FLAG_ADDPATH_TX_ALL_PATHS))
+    {
+      SET_FLAG (peer->af_cap[AFI_IP][SAFI_UNICAST], PEER_CAP_ADDPATH_AF_TX_ADV);
+      stream_putc (s, BGP_OPEN_OPT_CAP);
+      stream_putc (s, CAPABILITY_CODE_ADDPATH_LEN + 2);
+      stream_putc (s, CAPABILITY_CODE_ADDPATH);
+      stream_putc (s, CAPABILITY_CODE_ADDPATH_LEN);
+      stream_putw (s, AFI_IP);
+      stream_putc (s, SAFI_UNICAST);
+      stream_putc (s, ADDPATH_MODE_SEND);
+    }
+
   /* Dynamic capability. */
   if (CHECK_FLAG (peer->flags, PEER_FLAG_DYNAMIC_CAPABILITY))
     {
@@ -73,6 +73,7 @@ struct capability_gr
 #define CAPABILITY_CODE_RESTART        64 /* Graceful Restart Capability */
 #define CAPABILITY_CODE_AS4            65 /* 4-octet AS number Capability */
 #define CAPABILITY_CODE_DYNAMIC        66 /* Dynamic Capability */
+#define CAPABILITY_CODE_ADDPATH        69 /* Advertisement of Multiple Paths */
 #define CAPABILITY_CODE_REFRESH_OLD   128 /* Route Refresh Capability(cisco) */
 #define CAPABILITY_CODE_ORF_OLD       130 /* Cooperative Route Filtering Capability(cisco) */
 
@@ -82,6 +83,7 @@ struct capability_gr
 #define CAPABILITY_CODE_DYNAMIC_LEN     0
 #define CAPABILITY_CODE_RESTART_LEN     2 /* Receiving only case */
 #define CAPABILITY_CODE_AS4_LEN         4
+#define CAPABILITY_CODE_ADDPATH_LEN     4 /* Per address family */
 
 /* Cooperative Route Filtering Capability.  */
 
@@ -94,6 +96,10 @@ struct capability_gr
 #define ORF_MODE_SEND                   2 
 #define ORF_MODE_BOTH                   3 
 
+/* ADD-PATH Send/Receive */
+#define ADDPATH_MODE_RECEIVE            1
+#define ADDPATH_MODE_SEND               2
+
 /* Capability Message Action.  */
 #define CAPABILITY_ACTION_SET           0
 #define CAPABILITY_ACTION_UNSET         1
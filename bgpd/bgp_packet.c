@@ -28,8 +28,11 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #include "log.h"
 #include "memory.h"
 #include "sockunion.h"		/* for inet_ntop () */
+#include "sockopt.h"
 #include "linklist.h"
 #include "plist.h"
+#include "table.h"
+#include "trace.h"
 
 #include "bgpd/bgpd.h"
 #include "bgpd/bgp_table.h"
@@ -47,6 +50,7 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #include "bgpd/bgp_mplsvpn.h"
 #include "bgpd/bgp_advertise.h"
 #include "bgpd/bgp_vty.h"
+#include "bgpd/bgp_perf.h"
 
 int stream_put_prefix (struct stream *, struct prefix *);
 
@@ -84,10 +88,20 @@ bgp_packet_set_size (struct stream *s)
   return cp;
 }
 
+/* Number of queued packets gathered into one writev(). */
+#ifdef IOV_MAX
+#define BGP_WRITE_IOV_MAX ((IOV_MAX >= 64) ? 64 : IOV_MAX)
+#else
+#define BGP_WRITE_IOV_MAX 16
+#endif
+
 /* Add new packet to the peer. */
 static void
 bgp_packet_add (struct peer *peer, struct stream *s)
 {
+  if (! peer->obuf->count)
+    peer->perf->obuf_busy = bgp_perf_now ();
+
   /* Add packet to the end of list. */
   stream_fifo_push (peer->obuf, s);
 }
@@ -137,6 +151,243 @@ bgp_connect_check (struct peer *peer)
     }
 }
 
+/* UPDATE sharing between route-server clients.
+
+   Route-server clients usually receive the same routes with the same
+   attributes, and an attribute encodes identically for every client
+   whose relevant session properties match.  The first such client to
+   build an UPDATE leaves a clone of it here, together with the run of
+   prefixes it carried.  Later clients whose update queue starts with
+   the same attribute and prefixes queue a clone of that packet instead
+   of encoding it again.  */
+#define BGP_UPDATE_SHARE_MAX 32
+
+struct bgp_update_share_key
+{
+  struct bgp *bgp;
+  u_int16_t bgp_config;
+  bgp_peer_sort_t sort;
+  u_int32_t flags;
+  u_int32_t af_flags;
+  as_t local_as;
+  as_t change_local_as;
+  struct in_addr nexthop;
+  int use32bit;
+  int addpath;
+};
+
+/* A prefix of a shared UPDATE, and the path identifier it went with
+   for clients taking ADD-PATH. */
+struct bgp_update_share_nlri
+{
+  struct prefix_ipv4 p;
+  u_int32_t addpath_tx_id;
+};
+
+struct bgp_update_share
+{
+  struct bgp_update_share_key key;
+  struct attr *attr;
+  unsigned int count;
+  struct bgp_update_share_nlri *prefix;
+  struct stream *packet;
+};
+
+static struct bgp_update_share update_share[BGP_UPDATE_SHARE_MAX];
+static unsigned int update_share_next;
+
+/* Prefixes of the UPDATE being built; every prefix takes at least its
+   length byte. */
+static struct bgp_update_share_nlri *update_share_prefix;
+
+/* Attributes of an UPDATE being built after its withdrawn routes. */
+static struct stream *update_attr_scratch;
+
+/* Only IPv4 unicast to EBGP route-server clients: the attribute encoding
+   then depends on nothing but the attribute and the key below. */
+static int
+bgp_update_share_key (struct peer *peer, afi_t afi, safi_t safi,
+                      struct bgp_update_share_key *key)
+{
+  if (afi != AFI_IP || safi != SAFI_UNICAST
+      || peer->sort != BGP_PEER_EBGP
+      || ! CHECK_FLAG (peer->af_flags[afi][safi], PEER_FLAG_RSERVER_CLIENT)
+      || listcount (peer->bgp->rsclient)
+         + listcount (peer->bgp->rsclient_shared) < 2)
+    return 0;
+
+  memset (key, 0, sizeof (struct bgp_update_share_key));
+  key->bgp = peer->bgp;
+  key->bgp_config = peer->bgp->config;
+  key->sort = peer->sort;
+  key->flags = peer->flags;
+  key->af_flags = peer->af_flags[afi][safi];
+  key->local_as = peer->local_as;
+  key->change_local_as = peer->change_local_as;
+  key->nexthop = peer->nexthop.v4;
+  key->use32bit = CHECK_FLAG (peer->cap, PEER_CAP_AS4_RCV) ? 1 : 0;
+  key->addpath = PEER_ADDPATH_TX (peer, afi, safi) ? 1 : 0;
+  return 1;
+}
+
+static void
+bgp_update_share_release (struct bgp_update_share *us)
+{
+  if (! us->packet)
+    return;
+
+  bgp_attr_unintern (&us->attr);
+  XFREE (MTYPE_BGP_UPDATE_SHARE, us->prefix);
+  stream_free (us->packet);
+  memset (us, 0, sizeof (struct bgp_update_share));
+}
+
+/* Drop shared UPDATEs built for bgp, or all of them if bgp is NULL. */
+void
+bgp_update_share_flush (struct bgp *bgp)
+{
+  unsigned int i;
+
+  for (i = 0; i < BGP_UPDATE_SHARE_MAX; i++)
+    if (bgp == NULL || update_share[i].key.bgp == bgp)
+      bgp_update_share_release (&update_share[i]);
+
+  if (bgp == NULL && update_share_prefix)
+    XFREE (MTYPE_BGP_UPDATE_SHARE, update_share_prefix);
+
+  if (bgp == NULL && update_attr_scratch)
+    {
+      stream_free (update_attr_scratch);
+      update_attr_scratch = NULL;
+    }
+}
+
+static int
+bgp_update_share_nlri_same (struct bgp_update_share_nlri *nlri,
+                            struct bgp_advertise *adv)
+{
+  return (nlri->addpath_tx_id == adv->adj->addpath_tx_id
+          && prefix_same (&adv->rn->p, (struct prefix *) &nlri->p));
+}
+
+/* Does the update queue starting at adv begin with the prefixes of us?
+   This follows the order bgp_update_packet() consumes them in: the
+   queue head first, then the rest of its attribute's advertise list. */
+static int
+bgp_update_share_match (struct bgp_update_share *us,
+                        struct bgp_advertise *adv)
+{
+  struct bgp_advertise *next;
+  unsigned int i;
+
+  if (! bgp_update_share_nlri_same (&us->prefix[0], adv))
+    return 0;
+
+  next = adv->baa->adv;
+  for (i = 1; i < us->count; i++)
+    {
+      if (next == adv)
+        next = next->next;
+      if (! next || ! bgp_update_share_nlri_same (&us->prefix[i], next))
+        return 0;
+      next = next->next;
+    }
+  return 1;
+}
+
+static struct bgp_update_share *
+bgp_update_share_lookup (struct bgp_update_share_key *key,
+                         struct bgp_advertise *adv)
+{
+  unsigned int i;
+  struct bgp_update_share *us;
+
+  for (i = 0; i < BGP_UPDATE_SHARE_MAX; i++)
+    {
+      us = &update_share[i];
+      if (us->packet
+          && us->attr == adv->baa->attr
+          && ! memcmp (&us->key, key, sizeof (struct bgp_update_share_key))
+          && bgp_update_share_match (us, adv))
+        return us;
+    }
+  return NULL;
+}
+
+static void
+bgp_update_share_add (struct bgp_update_share_key *key, struct attr *attr,
+                      struct bgp_update_share_nlri *prefix,
+                      unsigned int count, struct stream *packet)
+{
+  struct bgp_update_share *us;
+
+  us = &update_share[update_share_next];
+  update_share_next = (update_share_next + 1) % BGP_UPDATE_SHARE_MAX;
+  bgp_update_share_release (us);
+
+  us->key = *key;
+  us->attr = bgp_attr_intern (attr);
+  us->count = count;
+  us->prefix = XMALLOC (MTYPE_BGP_UPDATE_SHARE,
+                        count * sizeof (struct bgp_update_share_nlri));
+  memcpy (us->prefix, prefix, count * sizeof (struct bgp_update_share_nlri));
+  us->packet = stream_clone (packet);
+}
+
+/* Record adj as advertised with the attribute of adv, and return the
+   next advertisement with the same attribute. */
+static struct bgp_advertise *
+bgp_update_packet_sync (struct peer *peer, struct bgp_adj_out *adj,
+                        struct bgp_advertise *adv, afi_t afi, safi_t safi)
+{
+  if (BGP_DEBUG (update, UPDATE_OUT))
+    {
+      char buf[INET6_BUFSIZ];
+
+      zlog (peer->log, LOG_DEBUG, "%s send UPDATE %s/%d",
+            peer->host,
+            inet_ntop (adv->rn->p.family, &(adv->rn->p.u.prefix), buf,
+                       INET6_BUFSIZ),
+            adv->rn->p.prefixlen);
+    }
+
+  bgp_perf_record (peer, BGP_PERF_ADJ_OUT, adv->queued);
+
+  /* Synchnorize attribute.  */
+  if (adj->attr)
+    bgp_attr_unintern (&adj->attr);
+  else
+    peer->scount[afi][safi]++;
+
+  adj->attr = bgp_attr_intern (adv->baa->attr);
+  peer->update_prefix_out++;
+
+  return bgp_advertise_clean (peer, adj, afi, safi);
+}
+
+/* Hand peer a shared UPDATE, consuming its prefixes from the
+   update queue. */
+static struct stream *
+bgp_update_packet_shared (struct peer *peer, struct bgp_update_share *us,
+                          afi_t afi, safi_t safi)
+{
+  struct bgp_advertise *adv;
+  struct stream *packet;
+  unsigned int i;
+
+  adv = FIFO_HEAD (&peer->sync[afi][safi]->update);
+  for (i = 0; i < us->count; i++)
+    {
+      assert (adv && bgp_update_share_nlri_same (&us->prefix[i], adv));
+      adv = bgp_update_packet_sync (peer, adv->adj, adv, afi, safi);
+    }
+
+  packet = stream_clone (us->packet);
+  bgp_packet_add (peer, packet);
+  BGP_WRITE_ON (peer->t_write, bgp_write, peer->fd);
+  return packet;
+}
+
 /* Make BGP update packet.  */
 static struct stream *
 bgp_update_packet (struct peer *peer, afi_t afi, safi_t safi)
@@ -149,12 +400,32 @@ bgp_update_packet (struct peer *peer, afi_t afi, safi_t safi)
   struct bgp_info *binfo = NULL;
   bgp_size_t total_attr_len = 0;
   unsigned long pos;
+  struct bgp_update_share_key key;
+  struct bgp_update_share *us;
+  struct attr *attr = NULL;
+  int share;
+  unsigned int share_count = 0;
+  int addpath = PEER_ADDPATH_TX (peer, afi, safi);
+  bgp_size_t idlen = addpath ? BGP_ADDPATH_ID_LEN : 0;
 
   s = peer->work;
   stream_reset (s);
 
   adv = FIFO_HEAD (&peer->sync[afi][safi]->update);
 
+  share = adv && bgp_update_share_key (peer, afi, safi, &key);
+  if (share)
+    {
+      if ((us = bgp_update_share_lookup (&key, adv)) != NULL)
+        return bgp_update_packet_shared (peer, us, afi, safi);
+
+      if (! update_share_prefix)
+        update_share_prefix = XMALLOC (MTYPE_BGP_UPDATE_SHARE,
+                                BGP_MAX_PACKET_SIZE
+                                * sizeof (struct bgp_update_share_nlri));
+      attr = adv->baa->attr;
+    }
+
   while (adv)
     {
       assert (adv->rn);
@@ -164,7 +435,7 @@ bgp_update_packet (struct peer *peer, afi_t afi, safi_t safi)
         binfo = adv->binfo;
 
       /* When remaining space can't include NLRI and it's length.  */
-      if (STREAM_REMAIN (s) <= BGP_NLRI_LENGTH + PSIZE (rn->p.prefixlen))
+      if (STREAM_REMAIN (s) <= BGP_NLRI_LENGTH + idlen + PSIZE (rn->p.prefixlen))
 	break;
 
       /* If packet is empty, set attribute. */
@@ -195,27 +466,20 @@ bgp_update_packet (struct peer *peer, afi_t afi, safi_t safi)
 	}
 
       if (afi == AFI_IP && safi == SAFI_UNICAST)
-	stream_put_prefix (s, &rn->p);
-      
-      if (BGP_DEBUG (update, UPDATE_OUT))
-        {
-          char buf[INET6_BUFSIZ];
+	{
+	  if (addpath)
+	    stream_putl (s, adj->addpath_tx_id);
+	  stream_put_prefix (s, &rn->p);
+	}
 
-          zlog (peer->log, LOG_DEBUG, "%s send UPDATE %s/%d",
-                peer->host,
-                inet_ntop (rn->p.family, &(rn->p.u.prefix), buf, INET6_BUFSIZ),
-                rn->p.prefixlen);
+      if (share)
+        {
+          update_share_prefix[share_count].p = *(struct prefix_ipv4 *) &rn->p;
+          update_share_prefix[share_count++].addpath_tx_id
+            = adj->addpath_tx_id;
         }
 
-      /* Synchnorize attribute.  */
-      if (adj->attr)
-	bgp_attr_unintern (&adj->attr);
-      else
-	peer->scount[afi][safi]++;
-
-      adj->attr = bgp_attr_intern (adv->baa->attr);
-
-      adv = bgp_advertise_clean (peer, adj, afi, safi);
+      adv = bgp_update_packet_sync (peer, adj, adv, afi, safi);
 
       if (! (afi == AFI_IP && safi == SAFI_UNICAST))
 	break;
@@ -228,6 +492,9 @@ bgp_update_packet (struct peer *peer, afi_t afi, safi_t safi)
       bgp_packet_add (peer, packet);
       BGP_WRITE_ON (peer->t_write, bgp_write, peer->fd);
       stream_reset (s);
+      if (share && share_count)
+        bgp_update_share_add (&key, attr, update_share_prefix, share_count,
+                              packet);
       return packet;
     }
   return NULL;
@@ -276,7 +543,88 @@ bgp_update_packet_eor (struct peer *peer, afi_t afi, safi_t safi)
   return packet;
 }
 
-/* Make BGP withdraw packet.  */
+/* May the update queue head be sent now?  Routes learned before the
+   last sync wait, and so do routes from a restarting peer until it has
+   sent its End-of-RIB.  */
+static int
+bgp_update_packet_ready (struct peer *peer, afi_t afi, safi_t safi)
+{
+  struct bgp_advertise *adv;
+
+  adv = FIFO_HEAD (&peer->sync[afi][safi]->update);
+  if (! adv || ! adv->binfo || adv->binfo->uptime >= peer->synctime)
+    return 0;
+
+  if (CHECK_FLAG (adv->binfo->peer->cap, PEER_CAP_RESTART_RCV)
+      && CHECK_FLAG (adv->binfo->peer->cap, PEER_CAP_RESTART_ADV)
+      && ! CHECK_FLAG (adv->binfo->flags, BGP_INFO_STALE)
+      && safi != SAFI_MPLS_VPN)
+    return CHECK_FLAG (adv->binfo->peer->af_sflags[afi][safi],
+                       PEER_STATUS_EOR_RECEIVED) ? 1 : 0;
+
+  return 1;
+}
+
+/* Fill the rest of the IPv4 unicast UPDATE s, whose withdrawn routes
+   are already written, with the attribute at the head of the update
+   queue and as many of its prefixes as fit.  The attribute is encoded
+   aside first, as s may not have room for it.  Returns the number of
+   prefixes added.  */
+static unsigned int
+bgp_withdraw_packet_update (struct peer *peer, struct stream *s,
+                            afi_t afi, safi_t safi)
+{
+  struct bgp_advertise *adv;
+  struct bgp_adj_out *adj;
+  struct bgp_node *rn;
+  struct peer *from = NULL;
+  bgp_size_t total_attr_len;
+  int addpath = PEER_ADDPATH_TX (peer, afi, safi);
+  bgp_size_t idlen = addpath ? BGP_ADDPATH_ID_LEN : 0;
+  unsigned int count = 0;
+
+  adv = FIFO_HEAD (&peer->sync[afi][safi]->update);
+  rn = adv->rn;
+
+  if (! update_attr_scratch)
+    update_attr_scratch = stream_new (BGP_MAX_PACKET_SIZE);
+  stream_reset (update_attr_scratch);
+
+  if (adv->binfo)
+    from = adv->binfo->peer;
+  total_attr_len = bgp_packet_attribute (NULL, peer, update_attr_scratch,
+                                         adv->baa->attr, &rn->p, afi, safi,
+                                         from, NULL, NULL);
+
+  if (STREAM_REMAIN (s) <= BGP_TOTAL_ATTR_LEN + total_attr_len
+                           + BGP_NLRI_LENGTH + idlen
+                           + PSIZE (rn->p.prefixlen))
+    return 0;
+
+  stream_putw (s, total_attr_len);
+  stream_put (s, STREAM_DATA (update_attr_scratch), total_attr_len);
+
+  while (adv)
+    {
+      rn = adv->rn;
+      adj = adv->adj;
+
+      if (STREAM_REMAIN (s) <= BGP_NLRI_LENGTH + idlen
+                               + PSIZE (rn->p.prefixlen))
+        break;
+
+      if (addpath)
+        stream_putl (s, adj->addpath_tx_id);
+      stream_put_prefix (s, &rn->p);
+      count++;
+
+      adv = bgp_update_packet_sync (peer, adj, adv, afi, safi);
+    }
+  return count;
+}
+
+/* Make BGP withdraw packet.  For IPv4 unicast, once the withdraw queue
+   is drained, any space left carries announcements as well.  */
 static struct stream *
 bgp_withdraw_packet (struct peer *peer, afi_t afi, safi_t safi)
 {
@@ -288,6 +636,8 @@ bgp_withdraw_packet (struct peer *peer, afi_t afi, safi_t safi)
   unsigned long pos;
   bgp_size_t unfeasible_len;
   bgp_size_t total_attr_len;
+  int addpath = PEER_ADDPATH_TX (peer, afi, safi);
+  bgp_size_t idlen = addpath ? BGP_ADDPATH_ID_LEN : 0;
 
   s = peer->work;
   stream_reset (s);
@@ -299,7 +649,8 @@ bgp_withdraw_packet (struct peer *peer, afi_t afi, safi_t safi)
       rn = adv->rn;
 
       if (STREAM_REMAIN (s) 
-	  < (BGP_NLRI_LENGTH + BGP_TOTAL_ATTR_LEN + PSIZE (rn->p.prefixlen)))
+	  < (BGP_NLRI_LENGTH + BGP_TOTAL_ATTR_LEN + idlen
+	     + PSIZE (rn->p.prefixlen)))
 	break;
 
       if (stream_empty (s))
@@ -309,7 +660,11 @@ bgp_withdraw_packet (struct peer *peer, afi_t afi, safi_t safi)
 	}
 
       if (afi == AFI_IP && safi == SAFI_UNICAST)
-	stream_put_prefix (s, &rn->p);
+	{
+	  if (addpath)
+	    stream_putl (s, adj->addpath_tx_id);
+	  stream_put_prefix (s, &rn->p);
+	}
       else
 	{
 	  struct prefix_rd *prd = NULL;
@@ -336,6 +691,8 @@ bgp_withdraw_packet (struct peer *peer, afi_t afi, safi_t safi)
         }
 
       peer->scount[afi][safi]--;
+      peer->update_prefix_out++;
+      bgp_perf_record (peer, BGP_PERF_ADJ_OUT, adv->queued);
 
       bgp_adj_out_remove (rn, adj, peer, afi, safi);
       bgp_unlock_node (rn);
@@ -351,7 +708,11 @@ bgp_withdraw_packet (struct peer *peer, afi_t afi, safi_t safi)
 	  unfeasible_len 
 	    = stream_get_endp (s) - BGP_HEADER_SIZE - BGP_UNFEASIBLE_LEN;
 	  stream_putw_at (s, BGP_HEADER_SIZE, unfeasible_len);
-	  stream_putw (s, 0);
+
+	  if (FIFO_HEAD (&peer->sync[afi][safi]->withdraw)
+	      || ! bgp_update_packet_ready (peer, afi, safi)
+	      || ! bgp_withdraw_packet_update (peer, s, afi, safi))
+	    stream_putw (s, 0);
 	}
       bgp_packet_set_size (s);
       packet = stream_dup (s);
@@ -412,15 +773,20 @@ bgp_default_update_send (struct peer *peer, struct attr *attr,
   /* Set Total Path Attribute Length. */
   stream_putw_at (s, pos, total_attr_len);
 
-  /* NLRI set. */
+  /* NLRI set.  No bgp_info is numbered 0 for ADD-PATH. */
   if (p.family == AF_INET && safi == SAFI_UNICAST)
-    stream_put_prefix (s, &p);
+    {
+      if (PEER_ADDPATH_TX (peer, afi, safi))
+	stream_putl (s, 0);
+      stream_put_prefix (s, &p);
+    }
 
   /* Set size. */
   bgp_packet_set_size (s);
 
   packet = stream_dup (s);
   stream_free (s);
+  peer->update_prefix_out++;
 
   /* Dump packet if debug option is set. */
 #ifdef DEBUG
@@ -478,6 +844,8 @@ bgp_default_withdraw_send (struct peer *peer, afi_t afi, safi_t safi)
   /* Withdrawn Routes. */
   if (p.family == AF_INET && safi == SAFI_UNICAST)
     {
+      if (PEER_ADDPATH_TX (peer, afi, safi))
+	stream_putl (s, 0);
       stream_put_prefix (s, &p);
 
       unfeasible_len = stream_get_endp (s) - cp - 2;
@@ -502,6 +870,7 @@ bgp_default_withdraw_send (struct peer *peer, afi_t afi, safi_t safi)
 
   packet = stream_dup (s);
   stream_free (s);
+  peer->update_prefix_out++;
 
   /* Add packet to the peer. */
   bgp_packet_add (peer, packet);
@@ -509,19 +878,16 @@ bgp_default_withdraw_send (struct peer *peer, afi_t afi, safi_t safi)
   BGP_WRITE_ON (peer->t_write, bgp_write, peer->fd);
 }
 
-/* Get next packet to be written.  */
+/* Make the next packet to be written from the peer's update queues,
+   and add it to the end of its output queue.  */
 static struct stream *
-bgp_write_packet (struct peer *peer)
+bgp_write_packet_make (struct peer *peer)
 {
   afi_t afi;
   safi_t safi;
   struct stream *s = NULL;
   struct bgp_advertise *adv;
 
-  s = stream_fifo_head (peer->obuf);
-  if (s)
-    return s;
-
   for (afi = AFI_IP; afi < AFI_MAX; afi++)
     for (safi = SAFI_UNICAST; safi < SAFI_MAX; safi++)
       {
@@ -537,32 +903,20 @@ bgp_write_packet (struct peer *peer)
   for (afi = AFI_IP; afi < AFI_MAX; afi++)
     for (safi = SAFI_UNICAST; safi < SAFI_MAX; safi++)
       {
-	adv = FIFO_HEAD (&peer->sync[afi][safi]->update);
-	if (adv)
+	if (bgp_update_packet_ready (peer, afi, safi))
 	  {
-            if (adv->binfo && adv->binfo->uptime < peer->synctime)
-	      {
-		if (CHECK_FLAG (adv->binfo->peer->cap, PEER_CAP_RESTART_RCV)
-		    && CHECK_FLAG (adv->binfo->peer->cap, PEER_CAP_RESTART_ADV)
-		    && ! CHECK_FLAG (adv->binfo->flags, BGP_INFO_STALE)
-		    && safi != SAFI_MPLS_VPN)
-		  {
-		    if (CHECK_FLAG (adv->binfo->peer->af_sflags[afi][safi],
-			PEER_STATUS_EOR_RECEIVED))
-		      s = bgp_update_packet (peer, afi, safi);
-		  }
-		else
-		  s = bgp_update_packet (peer, afi, safi);
-	      }
-
+	    s = bgp_update_packet (peer, afi, safi);
 	    if (s)
 	      return s;
 	  }
 
-	if (CHECK_FLAG (peer->cap, PEER_CAP_RESTART_RCV))
+	/* While update-delay holds our table back, so does End-of-RIB. */
+	if (CHECK_FLAG (peer->cap, PEER_CAP_RESTART_RCV)
+	    && ! BGP_UPDATE_DELAY_ACTIVE (peer->bgp))
 	  {
 	    if (peer->afc_nego[afi][safi] && peer->synctime
 		&& ! CHECK_FLAG (peer->af_sflags[afi][safi], PEER_STATUS_EOR_SEND)
+		&& ! bgp_announce_pending (peer, afi, safi)
 		&& safi != SAFI_MPLS_VPN)
 	      {
 		SET_FLAG (peer->af_sflags[afi][safi], PEER_STATUS_EOR_SEND);
@@ -574,6 +928,29 @@ bgp_write_packet (struct peer *peer)
   return NULL;
 }
 
+/* Get next packet to be written.  */
+static struct stream *
+bgp_write_packet (struct peer *peer)
+{
+  struct stream *s;
+
+  s = stream_fifo_head (peer->obuf);
+  if (s)
+    return s;
+
+  return bgp_write_packet_make (peer);
+}
+
+/* Get the packet to be written after s, which is queued. */
+static struct stream *
+bgp_write_packet_next (struct peer *peer, struct stream *s)
+{
+  if (s->next)
+    return s->next;
+
+  return bgp_write_packet_make (peer);
+}
+
 /* Is there partially written packet or updates we can send right
    now.  */
 static int
@@ -600,14 +977,21 @@ bgp_write_proceed (struct peer *peer)
   return 0;
 }
 
-/* Write packet to the peer. */
+/* Write packet to the peer.  Queued packets are gathered into one
+   writev(), up to the size of the socket send buffer.  With a not sent low
+   water mark on the socket no more than the mark is written per call, so
+   that little is queued in the kernel ahead of what is made next. */
 int
 bgp_write (struct thread *thread)
 {
   struct peer *peer;
   u_char type;
   struct stream *s; 
-  int num;
+  struct iovec iov[BGP_WRITE_IOV_MAX];
+  size_t total, limit, budget = 0, written = 0;
+  int iovcnt;
+  int i;
+  ssize_t num;
   unsigned int count = 0;
 
   /* Yes first of all get peer pointer. */
@@ -625,18 +1009,47 @@ bgp_write (struct thread *thread)
   if (!s)
     return 0;	/* nothing to send */
 
+  if (peer->sndbuf <= 0)
+    {
+      peer->sndbuf = getsockopt_so_sendbuf (peer->fd);
+      peer->notsent_lowat = getsockopt_notsent_lowat (peer->fd);
+    }
+  if (peer->sndbuf <= 0)
+    peer->sndbuf = BGP_MAX_PACKET_SIZE;
+  limit = peer->sndbuf;
+  if (peer->notsent_lowat > 0)
+    {
+      budget = peer->notsent_lowat;
+      limit = MIN (limit, budget);
+    }
+
   sockopt_cork (peer->fd, 1);
 
   /* Nonblocking write until TCP output buffer is full.  */
   do
     {
-      int writenum;
-
-      /* Number of bytes to be sent.  */
-      writenum = stream_get_endp (s) - stream_get_getp (s);
+      /* Gather queued packets, making more as needed.  Nothing may
+         follow a NOTIFY. */
+      iovcnt = 0;
+      total = 0;
+      do
+	{
+	  iov[iovcnt].iov_base = STREAM_PNT (s);
+	  iov[iovcnt].iov_len = STREAM_READABLE (s);
+	  total += iov[iovcnt].iov_len;
+	  iovcnt++;
 
-      /* Call write() system call.  */
-      num = write (peer->fd, STREAM_PNT (s), writenum);
+	  if (stream_getc_from (s, BGP_MARKER_SIZE + 2) == BGP_MSG_NOTIFY)
+	    break;
+	}
+      while (iovcnt < BGP_WRITE_IOV_MAX
+	     && count + iovcnt < BGP_WRITE_PACKET_MAX
+	     && total < limit
+	     && (s = bgp_write_packet_next (peer, s)) != NULL);
+
+      /* Call writev() system call.  */
+      num = writev (peer->fd, iov, iovcnt);
+      peer->write_calls++;
       if (num < 0)
 	{
 	  /* write failed either retry needed or error */
@@ -647,55 +1060,67 @@ bgp_write (struct thread *thread)
 	  return 0;
 	}
 
-      if (num != writenum)
+      for (i = 0; i < iovcnt; i++)
 	{
-	  /* Partial write */
-	  stream_forward_getp (s, num);
-	  break;
-	}
+	  s = stream_fifo_head (peer->obuf);
+
+	  if ((size_t) num < iov[i].iov_len)
+	    {
+	      /* Partial write */
+	      stream_forward_getp (s, num);
+	      break;
+	    }
+	  num -= iov[i].iov_len;
+	  written += iov[i].iov_len;
+	  count++;
 
-      /* Retrieve BGP packet type. */
-      stream_set_getp (s, BGP_MARKER_SIZE + 2);
-      type = stream_getc (s);
+	  /* Retrieve BGP packet type. */
+	  stream_set_getp (s, BGP_MARKER_SIZE + 2);
+	  type = stream_getc (s);
 
-      switch (type)
-	{
-	case BGP_MSG_OPEN:
-	  peer->open_out++;
-	  break;
-	case BGP_MSG_UPDATE:
-	  peer->update_out++;
-	  break;
-	case BGP_MSG_NOTIFY:
-	  peer->notify_out++;
-	  /* Double start timer. */
-	  peer->v_start *= 2;
-
-	  /* Overflow check. */
-	  if (peer->v_start >= (60 * 2))
-	    peer->v_start = (60 * 2);
-
-	  /* Flush any existing events */
-	  BGP_EVENT_ADD (peer, BGP_Stop);
-	  goto done;
+	  switch (type)
+	    {
+	    case BGP_MSG_OPEN:
+	      peer->open_out++;
+	      break;
+	    case BGP_MSG_UPDATE:
+	      peer->update_out++;
+	      break;
+	    case BGP_MSG_NOTIFY:
+	      peer->notify_out++;
+	      /* Double start timer. */
+	      peer->v_start *= 2;
+
+	      /* Overflow check. */
+	      if (peer->v_start >= (60 * 2))
+		peer->v_start = (60 * 2);
+
+	      /* Flush any existing events */
+	      BGP_EVENT_ADD (peer, BGP_Stop);
+	      goto done;
+
+	    case BGP_MSG_KEEPALIVE:
+	      peer->keepalive_out++;
+	      break;
+	    case BGP_MSG_ROUTE_REFRESH_NEW:
+	    case BGP_MSG_ROUTE_REFRESH_OLD:
+	      peer->refresh_out++;
+	      break;
+	    case BGP_MSG_CAPABILITY:
+	      peer->dynamic_cap_out++;
+	      break;
+	    }
 
-	case BGP_MSG_KEEPALIVE:
-	  peer->keepalive_out++;
-	  break;
-	case BGP_MSG_ROUTE_REFRESH_NEW:
-	case BGP_MSG_ROUTE_REFRESH_OLD:
-	  peer->refresh_out++;
-	  break;
-	case BGP_MSG_CAPABILITY:
-	  peer->dynamic_cap_out++;
-	  break;
+	  /* OK we send packet so delete it. */
+	  bgp_packet_delete (peer);
+	  if (! peer->obuf->count)
+	    bgp_perf_record (peer, BGP_PERF_WRITE, peer->perf->obuf_busy);
 	}
-
-      /* OK we send packet so delete it. */
-      bgp_packet_delete (peer);
     }
-  while (++count < BGP_WRITE_PACKET_MAX &&
-	 (s = bgp_write_packet (peer)) != NULL);
+  while (i == iovcnt
+	 && count < BGP_WRITE_PACKET_MAX
+	 && (budget == 0 || written < budget)
+	 && (s = bgp_write_packet (peer)) != NULL);
   
   if (bgp_write_proceed (peer))
     BGP_WRITE_ON (peer->t_write, bgp_write, peer->fd);
@@ -725,6 +1150,7 @@ bgp_write_notify (struct peer *peer)
   /* socket is in nonblocking mode, if we can't deliver the NOTIFY, well,
    * we only care about getting a clean shutdown at this point. */
   ret = write (peer->fd, STREAM_DATA (s), stream_get_endp (s));
+  peer->write_calls++;
 
   /* only connection reset/close gets counted as TCP_fatal_error, failure
    * to write the entire NOTIFY doesn't get different FSM treatment */
@@ -790,6 +1216,16 @@ bgp_keepalive_send (struct peer *peer)
   BGP_WRITE_ON (peer->t_write, bgp_write, peer->fd);
 }
 
+/* Keep a copy of the OPEN message in s, replacing the one in keep. */
+static void
+bgp_open_keep (struct stream **keep, struct stream *s)
+{
+  if (*keep)
+    stream_free (*keep);
+  *keep = stream_new (stream_get_endp (s));
+  stream_put (*keep, STREAM_DATA (s), stream_get_endp (s));
+}
+
 /* Make open packet and send it to the peer. */
 void
 bgp_open_send (struct peer *peer)
@@ -840,6 +1276,8 @@ bgp_open_send (struct peer *peer)
   /* Dump packet if debug option is set. */
   /* bgp_packet_dump (s); */
 
+  bgp_open_keep (&peer->open_sent, s);
+
   /* Add packet to the peer. */
   bgp_packet_add (peer, s);
 
@@ -959,6 +1397,8 @@ bgp_route_refresh_send (struct peer *peer, afi_t afi, safi_t safi,
   int length;
   struct bgp_filter *filter;
   int orf_refresh = 0;
+  int entries;
+  char orf_name[BUFSIZ];
 
   if (DISABLE_BGP_ANNOUNCE)
     return;
@@ -995,9 +1435,13 @@ bgp_route_refresh_send (struct peer *peer, afi_t afi, safi_t safi,
 	orfp = stream_get_endp (s);
 	stream_putw (s, 0);
 
+	/* What the peer has of our list, to send it only the changes. */
+	sprintf (orf_name, "%s.%d.%d.sent", peer->host, afi, safi);
+
 	if (remove)
 	  {
 	    UNSET_FLAG (peer->af_sflags[afi][safi], PEER_STATUS_ORF_PREFIX_SEND);
+	    prefix_bgp_orf_remove_all (orf_name);
 	    stream_putc (s, ORF_COMMON_PART_REMOVE_ALL);
 	    if (BGP_DEBUG (normal, NORMAL))
 	      zlog_debug ("%s sending REFRESH_REQ to remove ORF(%d) (%s) for afi/safi: %d/%d", 
@@ -1007,20 +1451,52 @@ bgp_route_refresh_send (struct peer *peer, afi_t afi, safi_t safi,
 	  }
 	else
 	  {
+	    if (! CHECK_FLAG (peer->af_sflags[afi][safi], PEER_STATUS_ORF_PREFIX_SEND))
+	      prefix_bgp_orf_remove_all (orf_name);
+
+	    /* Changes that do not fit go as the whole list, after
+	       having the peer drop what it has. */
+	    entries = prefix_bgp_orf_delta (s, orf_name,
+					    filter->plist[FILTER_IN].plist,
+					    ORF_COMMON_PART_ADD,
+					    ORF_COMMON_PART_REMOVE,
+					    ORF_COMMON_PART_PERMIT,
+					    ORF_COMMON_PART_DENY);
+	    if (entries < 0
+		&& CHECK_FLAG (peer->af_sflags[afi][safi], PEER_STATUS_ORF_PREFIX_SEND))
+	      {
+		bgp_route_refresh_send (peer, afi, safi, orf_type,
+					REFRESH_DEFER, 1);
+		entries = prefix_bgp_orf_delta (s, orf_name,
+						filter->plist[FILTER_IN].plist,
+						ORF_COMMON_PART_ADD,
+						ORF_COMMON_PART_REMOVE,
+						ORF_COMMON_PART_PERMIT,
+						ORF_COMMON_PART_DENY);
+	      }
+	    if (entries < 0)
+	      zlog_warn ("%s prefix-list %s is too long for an ORF",
+			 peer->host, filter->plist[FILTER_IN].name);
+
 	    SET_FLAG (peer->af_sflags[afi][safi], PEER_STATUS_ORF_PREFIX_SEND);
-	    prefix_bgp_orf_entry (s, filter->plist[FILTER_IN].plist,
-				  ORF_COMMON_PART_ADD, ORF_COMMON_PART_PERMIT,
-				  ORF_COMMON_PART_DENY);
 	    if (BGP_DEBUG (normal, NORMAL))
-	      zlog_debug ("%s sending REFRESH_REQ with pfxlist ORF(%d) (%s) for afi/safi: %d/%d", 
+	      zlog_debug ("%s sending REFRESH_REQ with pfxlist ORF(%d) (%s), %d entries changed, for afi/safi: %d/%d", 
 			 peer->host, orf_type,
 			 (when_to_refresh == REFRESH_DEFER ? "defer" : "immediate"),
-			 afi, safi);
+			 entries, afi, safi);
 	  }
 
 	/* Total ORF Entry Len. */
 	orf_len = stream_get_endp (s) - orfp - 2;
 	stream_putw_at (s, orfp, orf_len);
+
+	/* Nothing changed: ask for a plain refresh, the peer would not
+	   take an empty ORF. */
+	if (orf_len == 0)
+	  {
+	    stream_set_endp (s, orfp - 2);
+	    orf_refresh = 0;
+	  }
       }
 
   /* Set packet size. */
@@ -1161,6 +1637,48 @@ bgp_collision_detect (struct peer *new, struct in_addr remote_id)
   return 0;
 }
 
+/* Does rbuf hold the whole of the next message?  A header with an
+   impossible length counts too, so that it is reported straight away. */
+static int
+bgp_read_buffered (struct peer *peer)
+{
+  size_t size;
+
+  if (! peer->rbuf || STREAM_READABLE (peer->rbuf) < BGP_HEADER_SIZE)
+    return 0;
+
+  size = stream_getw_from (peer->rbuf,
+                           stream_get_getp (peer->rbuf) + BGP_MARKER_SIZE);
+  return size < BGP_HEADER_SIZE || size > BGP_MAX_PACKET_SIZE
+         || STREAM_READABLE (peer->rbuf) >= size;
+}
+
+/* Count the whole messages waiting in rbuf, and the bytes buffered. */
+unsigned long
+bgp_read_backlog (struct peer *peer, unsigned long *bytes)
+{
+  size_t getp, endp, size;
+  unsigned long count = 0;
+
+  *bytes = 0;
+  if (! peer->rbuf)
+    return 0;
+
+  getp = stream_get_getp (peer->rbuf);
+  endp = stream_get_endp (peer->rbuf);
+  *bytes = endp - getp;
+
+  while (endp - getp >= BGP_HEADER_SIZE)
+    {
+      size = stream_getw_from (peer->rbuf, getp + BGP_MARKER_SIZE);
+      if (size < BGP_HEADER_SIZE || endp - getp < size)
+	break;
+      getp += size;
+      count++;
+    }
+  return count;
+}
+
 static int
 bgp_open_receive (struct peer *peer, bgp_size_t size)
 {
@@ -1380,9 +1898,12 @@ bgp_open_receive (struct peer *peer, bgp_size_t size)
 
       /* Transfer input buffer. */
       stream_free (realpeer->ibuf);
+      stream_free (realpeer->rbuf);
       realpeer->ibuf = peer->ibuf;
+      realpeer->rbuf = peer->rbuf;
       realpeer->packet_size = peer->packet_size;
       peer->ibuf = NULL;
+      peer->rbuf = NULL;
 
       /* Transfer status. */
       realpeer->status = peer->status;
@@ -1398,6 +1919,13 @@ bgp_open_receive (struct peer *peer, bgp_size_t size)
 	  return -1;
 	}
       BGP_READ_ON (peer->t_read, bgp_read, peer->fd);
+
+      /* Whatever followed the OPEN has already been read. */
+      if (bgp_read_buffered (peer))
+	{
+	  BGP_READ_OFF (peer->t_read);
+	  peer->t_read = thread_add_event (master, bgp_read, peer, 0);
+	}
     }
 
   /* remote router-id check. */
@@ -1514,6 +2042,8 @@ bgp_open_receive (struct peer *peer, bgp_size_t size)
   /* Get sockname. */
   bgp_getsockname (peer);
 
+  bgp_open_keep (&peer->open_rcvd, peer->ibuf);
+
   BGP_EVENT_ADD (peer, Receive_OPEN_message);
 
   peer->packet_size = 0;
@@ -1549,6 +2079,8 @@ bgp_update_receive (struct peer *peer, bgp_size_t size)
       return -1;
     }
 
+  QUAGGA_TRACE (bgpd, update_receive, peer->host, size);
+
   /* Set initial values. */
   memset (&attr, 0, sizeof (struct attr));
   memset (&extra, 0, sizeof (struct attr_extra));
@@ -1589,13 +2121,9 @@ bgp_update_receive (struct peer *peer, bgp_size_t size)
       return -1;
     }
 
-  /* Unfeasible Route packet format check. */
+  /* Unfeasible Routes, checked as they are parsed. */
   if (withdraw_len > 0)
     {
-      ret = bgp_nlri_sanity_check (peer, AFI_IP, stream_pnt (s), withdraw_len);
-      if (ret < 0)
-	return -1;
-
       if (BGP_DEBUG (packet, PACKET_RECV))
 	zlog_debug ("%s [Update:RECV] Unfeasible NLRI received", peer->host);
 
@@ -1644,13 +2172,20 @@ bgp_update_receive (struct peer *peer, bgp_size_t size)
    */
 #define NLRI_ATTR_ARG (attr_parse_ret != BGP_ATTR_PARSE_WITHDRAW ? &attr : NULL)
 
-  /* Parse attribute when it exists. */
-  if (attribute_len)
+  /* Parse attribute when it exists, unless the very same attributes
+     were seen from this peer recently. */
+  if (attribute_len && ! bgp_attr_cache_get (peer, &attr, attribute_len))
     {
+      u_char *startp = stream_pnt (s);
+
       attr_parse_ret = bgp_attr_parse (peer, &attr, attribute_len, 
 			    &mp_update, &mp_withdraw);
       if (attr_parse_ret == BGP_ATTR_PARSE_ERROR)
 	return -1;
+
+      if (attr_parse_ret == BGP_ATTR_PARSE_PROCEED
+	  && ! mp_update.nlri && ! mp_withdraw.nlri)
+	bgp_attr_cache_set (peer, &attr, startp, attribute_len);
     }
   
   /* Logging the attribute. */
@@ -1679,15 +2214,7 @@ bgp_update_receive (struct peer *peer, bgp_size_t size)
 
   if (update_len)
     {
-      /* Check NLRI packet format and prefix length. */
-      ret = bgp_nlri_sanity_check (peer, AFI_IP, stream_pnt (s), update_len);
-      if (ret < 0)
-        {
-          bgp_attr_unintern_sub (&attr);
-	  return -1;
-	}
-
-      /* Set NLRI portion to structure. */
+      /* Set NLRI portion to structure, it is checked as it is parsed. */
       update.afi = AFI_IP;
       update.safi = SAFI_UNICAST;
       update.nlri = stream_pnt (s);
@@ -1696,11 +2223,28 @@ bgp_update_receive (struct peer *peer, bgp_size_t size)
     }
 
   /* NLRI is processed only when the peer is configured specific
-     Address Family and Subsequent Address Family. */
+     Address Family and Subsequent Address Family.  Otherwise, still
+     check its syntax. */
+  if (! peer->afc[AFI_IP][SAFI_UNICAST]
+      && ((withdraw.length
+	   && bgp_nlri_sanity_check (peer, AFI_IP, withdraw.nlri,
+				     withdraw.length) < 0)
+	  || (update.length
+	      && bgp_nlri_sanity_check (peer, AFI_IP, update.nlri,
+					update.length) < 0)))
+    {
+      bgp_attr_unintern_sub (&attr);
+      return -1;
+    }
+
   if (peer->afc[AFI_IP][SAFI_UNICAST])
     {
-      if (withdraw.length)
-	bgp_nlri_parse (peer, NULL, &withdraw);
+      if (withdraw.length
+	  && bgp_nlri_parse (peer, NULL, &withdraw) < 0)
+	{
+	  bgp_attr_unintern_sub (&attr);
+	  return -1;
+	}
 
       if (update.length)
 	{
@@ -1713,7 +2257,11 @@ bgp_update_receive (struct peer *peer, bgp_size_t size)
 	      return -1;
             }
 
-	  bgp_nlri_parse (peer, NLRI_ATTR_ARG, &update);
+	  if (bgp_nlri_parse (peer, NLRI_ATTR_ARG, &update) < 0)
+	    {
+	      bgp_attr_unintern_sub (&attr);
+	      return -1;
+	    }
 	}
 
       if (mp_update.length
@@ -1818,6 +2366,8 @@ bgp_update_receive (struct peer *peer, bgp_size_t size)
 	  && mp_withdraw.length == 0)
 	{
 	  /* End-of-RIB received */
+	  SET_FLAG (peer->af_sflags[AFI_IP6][SAFI_MULTICAST],
+		    PEER_STATUS_EOR_RECEIVED);
 
 	  /* NSF delete stale route */
 	  if (peer->nsf[AFI_IP6][SAFI_MULTICAST])
@@ -1862,12 +2412,15 @@ bgp_update_receive (struct peer *peer, bgp_size_t size)
   if (peer->status != Established)
     return 0;
 
+  /* This may have been the End-of-RIB update-delay waits for. */
+  bgp_update_delay_check (peer->bgp);
+
   /* Increment packet counter. */
   peer->update_in++;
   peer->update_time = bgp_clock ();
 
   /* Rearm holdtime timer */
-  BGP_TIMER_OFF (peer->t_holdtime);
+  BGP_DEADLINE_OFF (peer->holdtime_expire);
   bgp_timer_set (peer);
 
   return 0;
@@ -1953,6 +2506,16 @@ bgp_keepalive_receive (struct peer *peer, bgp_size_t size)
 {
   if (BGP_DEBUG (keepalive, KEEPALIVE))  
     zlog_debug ("%s KEEPALIVE rcvd", peer->host); 
+
+  /* Without End-of-RIB, the first KEEPALIVE once Established is the
+     best sign update-delay has that the peer sent what it had. */
+  if (peer->status == Established
+      && BGP_UPDATE_DELAY_ACTIVE (peer->bgp)
+      && ! CHECK_FLAG (peer->cap, PEER_CAP_RESTART_RCV))
+    {
+      SET_FLAG (peer->sflags, PEER_STATUS_EOR_IMPLICIT);
+      bgp_update_delay_check (peer->bgp);
+    }
   
   BGP_EVENT_ADD (peer, Receive_KEEPALIVE_message);
 }
@@ -1965,6 +2528,10 @@ bgp_route_refresh_receive (struct peer *peer, bgp_size_t size)
   safi_t safi;
   u_char reserved;
   struct stream *s;
+  struct route_table *orf_changed = NULL;
+  struct route_node *rn;
+  int orf = 0;
+  int orf_all = 0;
 
   /* If peer does not have the capability, send notification. */
   if (! CHECK_FLAG (peer->cap, PEER_CAP_REFRESH_ADV))
@@ -2021,6 +2588,7 @@ bgp_route_refresh_receive (struct peer *peer, bgp_size_t size)
       u_char when_to_refresh;
       u_char orf_type;
       u_int16_t orf_len;
+      int orf_was_set = (peer->orf_plist[afi][safi] != NULL);
 
       if (size - (BGP_MSG_ROUTE_REFRESH_MIN_SIZE - BGP_HEADER_SIZE) < 5)
         {
@@ -2059,9 +2627,13 @@ bgp_route_refresh_receive (struct peer *peer, bgp_size_t size)
 		}
 
               /* we're going to read at least 1 byte of common ORF header,
-               * and 7 bytes of ORF Address-filter entry from the stream
+               * and 7 bytes of ORF Address-filter entry from the stream,
+               * unless all there is is a lone Remove-All.
                */
-              if (orf_len < 7)
+              if (orf_len < 7
+                  && ! (orf_len >= 1
+                        && (*p_pnt & ORF_COMMON_PART_REMOVE_ALL)
+                           == ORF_COMMON_PART_REMOVE_ALL))
                 break; 
                 
 	      /* ORF prefix-list name */
@@ -2077,11 +2649,12 @@ bgp_route_refresh_receive (struct peer *peer, bgp_size_t size)
 		  memset (&orfp, 0, sizeof (struct orf_prefix));
 		  common = *p_pnt++;
 		  /* after ++: p_pnt <= p_end */
-		  if (common & ORF_COMMON_PART_REMOVE_ALL)
+		  if ((common & ORF_COMMON_PART_REMOVE_ALL) == ORF_COMMON_PART_REMOVE_ALL)
 		    {
 		      if (BGP_DEBUG (normal, NORMAL))
 			zlog_debug ("%s rcvd Remove-All pfxlist ORF request", peer->host);
 		      prefix_bgp_orf_remove_all (name);
+		      orf_all = 1;
 		      break;
 		    }
 		  ok = ((p_end - p_pnt) >= sizeof(u_int32_t)) ;
@@ -2143,27 +2716,73 @@ bgp_route_refresh_receive (struct peer *peer, bgp_size_t size)
 			zlog_debug ("%s Received misformatted prefixlist ORF."
 			            " Remove All pfxlist", peer->host);
 		      prefix_bgp_orf_remove_all (name);
+		      orf_all = 1;
 		      break;
 		    }
+
+		  /* Only the prefixes this entry covers can have a
+		     different outcome now. */
+		  if (! orf_changed)
+		    orf_changed = route_table_init ();
+		  apply_mask (&orfp.p);
+		  rn = route_node_get (orf_changed, &orfp.p);
+		  if (rn->info)
+		    route_unlock_node (rn);
+		  rn->info = orf_changed;
 		}
 	      peer->orf_plist[afi][safi] =
 			 prefix_list_lookup (AFI_ORF_PREFIX, name);
+	      orf = 1;
 	    }
 	  stream_forward_getp (s, orf_len);
 	}
       if (BGP_DEBUG (normal, NORMAL))
 	zlog_debug ("%s rcvd Refresh %s ORF request", peer->host,
 		   when_to_refresh == REFRESH_DEFER ? "Defer" : "Immediate");
+
+      /* Going from no list to a list or back changes the outcome for
+	 every prefix. */
+      if (orf_was_set != (peer->orf_plist[afi][safi] != NULL))
+	orf_all = 1;
+
       if (when_to_refresh == REFRESH_DEFER)
-	return;
+	{
+	  if (orf)
+	    SET_FLAG (peer->af_sflags[afi][safi], PEER_STATUS_ORF_DEFERRED);
+	  if (orf_changed)
+	    route_table_finish (orf_changed);
+	  return;
+	}
     }
 
   /* First update is deferred until ORF or ROUTE-REFRESH is received */
   if (CHECK_FLAG (peer->af_sflags[afi][safi], PEER_STATUS_ORF_WAIT_REFRESH))
-    UNSET_FLAG (peer->af_sflags[afi][safi], PEER_STATUS_ORF_WAIT_REFRESH);
+    {
+      UNSET_FLAG (peer->af_sflags[afi][safi], PEER_STATUS_ORF_WAIT_REFRESH);
+      orf_all = 1;
+    }
+
+  /* Changes held back by earlier ORFs are not known one by one. */
+  if (CHECK_FLAG (peer->af_sflags[afi][safi], PEER_STATUS_ORF_DEFERRED))
+    {
+      UNSET_FLAG (peer->af_sflags[afi][safi], PEER_STATUS_ORF_DEFERRED);
+      orf_all = 1;
+    }
+
+  /* Perform route refreshment to the peer, for an ORF only where its
+     entries changed, for a plain refresh from what it was sent. */
+  if (orf && ! orf_all)
+    {
+      if (orf_changed)
+	bgp_announce_route_prefixes (peer, afi, safi, orf_changed);
+    }
+  else if (orf_all)
+    bgp_announce_route (peer, afi, safi);
+  else
+    bgp_announce_route_refresh (peer, afi, safi);
 
-  /* Perform route refreshment to the peer */
-  bgp_announce_route (peer, afi, safi);
+  if (orf_changed)
+    route_table_finish (orf_changed);
 }
 
 static int
@@ -2319,21 +2938,23 @@ bgp_read_packet (struct peer *peer)
   int nbytes;
   int readsize;
 
-  readsize = peer->packet_size - stream_get_endp (peer->ibuf);
+  /* Make room behind any partial message. */
+  stream_pulldown (peer->rbuf);
+  readsize = STREAM_WRITEABLE (peer->rbuf);
 
   /* If size is zero then return. */
   if (! readsize)
     return 0;
 
-  /* Read packet from fd. */
-  nbytes = stream_read_try (peer->ibuf, peer->fd, readsize);
+  /* Read as much as is available from fd. */
+  nbytes = stream_read_try (peer->rbuf, peer->fd, readsize);
 
   /* If read byte is smaller than zero then error occured. */
   if (nbytes < 0) 
     {
-      /* Transient error should retry */
+      /* Transient error should retry, with what is buffered */
       if (nbytes == -2)
-	return -1;
+	return 0;
 
       plog_err (peer->log, "%s [Error] bgp_read_packet error: %s",
 		 peer->host, safe_strerror (errno));
@@ -2375,13 +2996,24 @@ bgp_read_packet (struct peer *peer)
       return -1;
     }
 
-  /* We read partial packet. */
-  if (stream_get_endp (peer->ibuf) != peer->packet_size)
-    return -1;
-
   return 0;
 }
 
+/* Is there input on the peer's socket which bgp_read has not seen yet? */
+int
+bgp_read_pending (struct peer *peer)
+{
+  int nbytes = 0;
+
+  if (peer->rbuf && STREAM_READABLE (peer->rbuf))
+    return 1;
+  if (peer->fd < 0)
+    return 0;
+  if (ioctl (peer->fd, FIONREAD, &nbytes) < 0)
+    return 0;
+  return nbytes > 0;
+}
+
 /* Marker check. */
 static int
 bgp_marker_all_one (struct stream *s, int length)
@@ -2413,6 +3045,8 @@ bgp_read (struct thread *thread)
   struct peer *peer;
   bgp_size_t size;
   char notify_data_length[2];
+  unsigned long long start;
+  u_int32_t fsm_events;
 
   /* Yes first of all get peer pointer. */
   peer = THREAD_ARG (thread);
@@ -2434,17 +3068,33 @@ bgp_read (struct thread *thread)
       BGP_READ_ON (peer->t_read, bgp_read, peer->fd);
     }
 
-  /* Read packet header to determine type of the packet */
-  if (peer->packet_size == 0)
-    peer->packet_size = BGP_HEADER_SIZE;
-
-  if (stream_get_endp (peer->ibuf) < BGP_HEADER_SIZE)
+  /* Read whatever is available, unless the next message is already
+     buffered. */
+  if (! bgp_read_buffered (peer))
     {
       ret = bgp_read_packet (peer);
-
-      /* Header read error or partial read packet. */
       if (ret < 0) 
 	goto done;
+      if (STREAM_READABLE (peer->rbuf) > peer->read_backlog_peak)
+	peer->read_backlog_peak = STREAM_READABLE (peer->rbuf);
+    }
+
+  /* Deficit round robin: each turn lets the peer process another
+     quantum's worth of bytes, so a peer sending a full table takes
+     about one UPDATE per turn while one sending keepalives or
+     withdrawals gets through many. */
+  peer->read_deficit += BGP_READ_QUANTUM;
+
+ next:
+  /* Read packet header to determine type of the packet */
+  if (peer->packet_size == 0)
+    {
+      /* Partial read header. */
+      if (STREAM_READABLE (peer->rbuf) < BGP_HEADER_SIZE)
+	goto done;
+
+      stream_clone_set (peer->ibuf, stream_get_getp (peer->rbuf),
+			BGP_HEADER_SIZE);
 
       /* Get size and type. */
       stream_forward_getp (peer->ibuf, BGP_MARKER_SIZE);
@@ -2511,10 +3161,22 @@ bgp_read (struct thread *thread)
       peer->packet_size = size;
     }
 
-  ret = bgp_read_packet (peer);
-  if (ret < 0) 
+  /* Partial read packet. */
+  if (STREAM_READABLE (peer->rbuf) < peer->packet_size)
     goto done;
 
+  /* Out of quota: carry the deficit over to the peer's next turn. */
+  if (peer->packet_size > peer->read_deficit)
+    goto yield;
+  peer->read_deficit -= peer->packet_size;
+  fsm_events = peer->fsm_events;
+
+  /* Point ibuf at the whole message and consume it from rbuf. */
+  stream_clone_set (peer->ibuf, stream_get_getp (peer->rbuf),
+		    peer->packet_size);
+  stream_set_getp (peer->ibuf, BGP_HEADER_SIZE);
+  stream_forward_getp (peer->rbuf, peer->packet_size);
+
   /* Get size and type again. */
   size = stream_getw_from (peer->ibuf, BGP_MARKER_SIZE);
   type = stream_getc_from (peer->ibuf, BGP_MARKER_SIZE + 2);
@@ -2533,7 +3195,11 @@ bgp_read (struct thread *thread)
       break;
     case BGP_MSG_UPDATE:
       peer->readtime = bgp_recent_clock ();
+      start = bgp_perf_now ();
+      bgp_perf_peer = peer;
       bgp_update_receive (peer, size);
+      bgp_perf_peer = NULL;
+      bgp_perf_record (peer, BGP_PERF_PARSE, start);
       break;
     case BGP_MSG_NOTIFY:
       bgp_notify_receive (peer, size);
@@ -2553,12 +3219,37 @@ bgp_read (struct thread *thread)
       break;
     }
 
+  /* A whole message went through, so any holdtime grace is used up. */
+  UNSET_FLAG (peer->sflags, PEER_STATUS_HOLDTIME_GRACE);
+
   /* Clear input buffer. */
   peer->packet_size = 0;
   if (peer->ibuf)
     stream_reset (peer->ibuf);
 
+  if (! bgp_read_buffered (peer))
+    goto done;
+
+  /* Routine messages are taken back to back while quota lasts.  Take
+     any other after pending events, which may include stopping the
+     session on account of this message. */
+  if ((type == BGP_MSG_UPDATE || type == BGP_MSG_KEEPALIVE)
+      && peer->status == Established && peer->fsm_events == fsm_events)
+    goto next;
+
+ yield:
+  /* Other peers go first, then this one resumes with what is buffered. */
+  peer->read_yields++;
+  BGP_READ_OFF (peer->t_read);
+  peer->t_read = thread_add_event (master, bgp_read, peer, 0);
+  goto out;
+
  done:
+  /* Nothing left buffered: a DRR deficit does not outlive the queue. */
+  peer->read_deficit = 0;
+
+ out:
+  peer->read_turns++;
   if (CHECK_FLAG (peer->sflags, PEER_STATUS_ACCEPT_PEER))
     {
       if (BGP_DEBUG (events, EVENTS))
@@ -23,8 +23,13 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 
 #define BGP_NLRI_LENGTH       1U
 #define BGP_TOTAL_ATTR_LEN    2U
+#define BGP_ADDPATH_ID_LEN    4U
 #define BGP_UNFEASIBLE_LEN    2U
-#define BGP_WRITE_PACKET_MAX 10U
+#define BGP_WRITE_PACKET_MAX 64U
+
+/* Bytes of input a peer may process per bgp_read turn.  At least one
+   maximum sized message, so every turn makes progress. */
+#define BGP_READ_QUANTUM BGP_MAX_PACKET_SIZE
 
 /* When to refresh */
 #define REFRESH_IMMEDIATE 1
@@ -40,6 +45,7 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 /* Packet send and receive function prototypes. */
 extern int bgp_read (struct thread *);
 extern int bgp_write (struct thread *);
+extern int bgp_read_pending (struct peer *);
 
 extern void bgp_keepalive_send (struct peer *);
 extern void bgp_open_send (struct peer *);
@@ -54,4 +60,7 @@ extern void bgp_default_withdraw_send (struct peer *, afi_t, safi_t);
 
 extern int bgp_capability_receive (struct peer *, bgp_size_t);
 
+extern void bgp_update_share_flush (struct bgp *);
+extern unsigned long bgp_read_backlog (struct peer *, unsigned long *);
+
 #endif /* _QUAGGA_BGP_PACKET_H */
@@ -0,0 +1,263 @@
+/* BGP per-peer processing latency accounting.
+   Copyright (C) 2026 The Quagga project
+
+This file is part of GNU Zebra.
+
+GNU Zebra is free software; you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation; either version 2, or (at your option) any
+later version.
+
+GNU Zebra is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with GNU Zebra; see the file COPYING.  If not, write to the Free
+Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+02111-1307, USA.  */
+
+/* Each peer keeps a histogram of how long its routes spend in every
+   phase of their way through bgpd, so that a slow peer, or a slow
+   phase, shows without a profiler.  An UPDATE received is timed as a
+   whole.  Every node it changes is timed from being queued for
+   processing to being picked up, and through best path selection,
+   against the peer that sent it.  Every prefix queued to go out is
+   timed from entering the Adj-RIB-Out queue to being put in an
+   UPDATE, against the peer it goes to, and the time that peer's
+   output queue stays busy is timed from the first packet queued to the
+   last written.  */
+
+#include <zebra.h>
+
+#include "command.h"
+#include "linklist.h"
+#include "memory.h"
+#include "sockunion.h"
+#include "thread.h"
+#include "vty.h"
+
+#include "bgpd/bgpd.h"
+#include "bgpd/bgp_perf.h"
+
+struct peer *bgp_perf_peer;
+
+static const char *bgp_perf_phase_str[BGP_PERF_MAX] =
+{
+  "Parse",
+  "Queue",
+  "Process",
+  "Adj-out",
+  "Write",
+};
+
+/* Monotonic time in microseconds. */
+unsigned long long
+bgp_perf_now (void)
+{
+  struct timeval tv;
+
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &tv);
+  return (unsigned long long) tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+static unsigned int
+bgp_perf_bucket (unsigned long usecs)
+{
+  unsigned int b = 0;
+
+  while (usecs && b < BGP_PERF_BUCKETS - 1)
+    {
+      usecs >>= 1;
+      b++;
+    }
+  return b;
+}
+
+/* Charge the time since START to PHASE of PEER.  Returns the time now,
+   for the caller to start the next phase from. */
+unsigned long long
+bgp_perf_record (struct peer *peer, enum bgp_perf_phase phase,
+                 unsigned long long start)
+{
+  struct bgp_perf_hist *h = &peer->perf->phase[phase];
+  unsigned long long now;
+  unsigned long usecs;
+
+  now = bgp_perf_now ();
+  usecs = now > start ? now - start : 0;
+
+  h->count++;
+  h->total += usecs;
+  if (usecs > h->max)
+    h->max = usecs;
+  h->bucket[bgp_perf_bucket (usecs)]++;
+  return now;
+}
+
+void
+bgp_perf_clear (struct peer *peer)
+{
+  memset (peer->perf->phase, 0, sizeof (peer->perf->phase));
+}
+
+/* Time that pct percent of the samples stayed within, in microseconds.
+   As precise as the histogram allows. */
+static unsigned long
+bgp_perf_percentile (struct bgp_perf_hist *h, unsigned int pct)
+{
+  unsigned long long want, seen;
+  unsigned int b;
+
+  want = ((unsigned long long) h->count * pct + 99) / 100;
+  seen = 0;
+  for (b = 0; b < BGP_PERF_BUCKETS - 1; b++)
+    {
+      seen += h->bucket[b];
+      if (seen >= want)
+	break;
+    }
+
+  if (b == BGP_PERF_BUCKETS - 1 || h->max < (1UL << b))
+    return h->max;
+  return 1UL << b;
+}
+
+static void
+bgp_perf_show (struct vty *vty, struct peer *peer)
+{
+  struct bgp_perf_hist *h;
+  int i, b;
+
+  vty_out (vty, "Processing latency for %s, in microseconds:%s%s",
+           peer->host, VTY_NEWLINE, VTY_NEWLINE);
+  vty_out (vty, "%-8s %10s %8s %8s %8s %8s %9s%s", "Phase", "Count",
+           "Avg", "P50", "P90", "P99", "Max", VTY_NEWLINE);
+
+  for (i = 0; i < BGP_PERF_MAX; i++)
+    {
+      h = &peer->perf->phase[i];
+
+      vty_out (vty, "%-8s %10lu %8llu %8lu %8lu %8lu %9lu%s",
+               bgp_perf_phase_str[i], h->count,
+               h->count ? h->total / h->count : 0,
+               bgp_perf_percentile (h, 50), bgp_perf_percentile (h, 90),
+               bgp_perf_percentile (h, 99), h->max, VTY_NEWLINE);
+
+      if (! h->count)
+        continue;
+
+      /* Non-empty buckets, as "upper bound in uSecs:samples". */
+      vty_out (vty, " ");
+      for (b = 0; b < BGP_PERF_BUCKETS; b++)
+        {
+          if (! h->bucket[b])
+            continue;
+          if (b == BGP_PERF_BUCKETS - 1)
+            vty_out (vty, " >%lu:%lu", 1UL << (b - 1), h->bucket[b]);
+          else
+            vty_out (vty, " %lu:%lu", 1UL << b, h->bucket[b]);
+        }
+      vty_out (vty, "%s", VTY_NEWLINE);
+    }
+}
+
+static struct peer *
+bgp_perf_peer_lookup (struct vty *vty, const char *ip_str)
+{
+  union sockunion su;
+  struct peer *peer;
+
+  if (str2sockunion (ip_str, &su) < 0)
+    {
+      vty_out (vty, "%% Malformed address: %s%s", ip_str, VTY_NEWLINE);
+      return NULL;
+    }
+
+  peer = peer_lookup (NULL, &su);
+  if (! peer)
+    vty_out (vty, "%% No such neighbor%s", VTY_NEWLINE);
+  return peer;
+}
+
+DEFUN (show_ip_bgp_neighbor_performance,
+       show_ip_bgp_neighbor_performance_cmd,
+       "show ip bgp neighbors (A.B.C.D|X:X::X:X) performance",
+       SHOW_STR
+       IP_STR
+       BGP_STR
+       "Detailed information on TCP and BGP neighbor connections\n"
+       "Neighbor to display information about\n"
+       "Neighbor to display information about\n"
+       "Display processing latency of the neighbor's routes\n")
+{
+  struct peer *peer;
+
+  peer = bgp_perf_peer_lookup (vty, argv[0]);
+  if (! peer)
+    return CMD_WARNING;
+
+  bgp_perf_show (vty, peer);
+  return CMD_SUCCESS;
+}
+
+ALIAS (show_ip_bgp_neighbor_performance,
+       show_bgp_neighbor_performance_cmd,
+       "show bgp neighbors (A.B.C.D|X:X::X:X) performance",
+       SHOW_STR
+       BGP_STR
+       "Detailed information on TCP and BGP neighbor connections\n"
+       "Neighbor to display information about\n"
+       "Neighbor to display information about\n"
+       "Display processing latency of the neighbor's routes\n")
+
+DEFUN (clear_ip_bgp_peer_performance,
+       clear_ip_bgp_peer_performance_cmd,
+       "clear ip bgp (A.B.C.D|X:X::X:X) performance",
+       CLEAR_STR
+       IP_STR
+       BGP_STR
+       "BGP neighbor address to clear\n"
+       "BGP IPv6 neighbor to clear\n"
+       "Processing latency of the neighbor's routes\n")
+{
+  struct peer *peer;
+
+  peer = bgp_perf_peer_lookup (vty, argv[0]);
+  if (! peer)
+    return CMD_WARNING;
+
+  bgp_perf_clear (peer);
+  return CMD_SUCCESS;
+}
+
+DEFUN (clear_ip_bgp_all_performance,
+       clear_ip_bgp_all_performance_cmd,
+       "clear ip bgp * performance",
+       CLEAR_STR
+       IP_STR
+       BGP_STR
+       "Clear all peers\n"
+       "Processing latency of the neighbors' routes\n")
+{
+  struct listnode *node, *pnode;
+  struct bgp *bgp;
+  struct peer *peer;
+
+  for (ALL_LIST_ELEMENTS_RO (bm->bgp, node, bgp))
+    for (ALL_LIST_ELEMENTS_RO (bgp->peer, pnode, peer))
+      bgp_perf_clear (peer);
+  return CMD_SUCCESS;
+}
+
+void
+bgp_perf_init (void)
+{
+  install_element (VIEW_NODE, &show_ip_bgp_neighbor_performance_cmd);
+  install_element (VIEW_NODE, &show_bgp_neighbor_performance_cmd);
+  install_element (ENABLE_NODE, &show_ip_bgp_neighbor_performance_cmd);
+  install_element (ENABLE_NODE, &show_bgp_neighbor_performance_cmd);
+  install_element (ENABLE_NODE, &clear_ip_bgp_peer_performance_cmd);
+  install_element (ENABLE_NODE, &clear_ip_bgp_all_performance_cmd);
+}
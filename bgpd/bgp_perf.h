@@ -0,0 +1,68 @@
+/* BGP per-peer processing latency accounting.
+   Copyright (C) 2026 The Quagga project
+
+This file is part of GNU Zebra.
+
+GNU Zebra is free software; you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation; either version 2, or (at your option) any
+later version.
+
+GNU Zebra is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with GNU Zebra; see the file COPYING.  If not, write to the Free
+Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+02111-1307, USA.  */
+
+#ifndef _QUAGGA_BGP_PERF_H
+#define _QUAGGA_BGP_PERF_H
+
+/* Phases a route goes through from the UPDATE that carried it in to
+   the UPDATE that carries it out.  The first three are charged to the
+   peer the route was learned from, the last two to the peer it is
+   sent to. */
+enum bgp_perf_phase
+{
+  BGP_PERF_PARSE,		/* Handling one received UPDATE */
+  BGP_PERF_QUEUE,		/* Waiting in the process queue */
+  BGP_PERF_PROCESS,		/* Best path selection for one node */
+  BGP_PERF_ADJ_OUT,		/* Waiting in the Adj-RIB-Out queue */
+  BGP_PERF_WRITE,		/* Output queue busy until drained */
+  BGP_PERF_MAX
+};
+
+/* Log2 buckets of microseconds, as for thread latency. */
+#define BGP_PERF_BUCKETS 24
+
+struct bgp_perf_hist
+{
+  unsigned long count;
+  unsigned long long total;
+  unsigned long max;
+  unsigned long bucket[BGP_PERF_BUCKETS];
+};
+
+struct bgp_perf
+{
+  struct bgp_perf_hist phase[BGP_PERF_MAX];
+
+  /* When the output queue last went from empty to busy. */
+  unsigned long long obuf_busy;
+};
+
+/* The peer whose UPDATE is being handled, if any, for work it
+   causes to be charged to. */
+extern struct peer *bgp_perf_peer;
+
+extern unsigned long long bgp_perf_now (void);
+extern unsigned long long bgp_perf_record (struct peer *,
+                                           enum bgp_perf_phase,
+                                           unsigned long long);
+extern void bgp_perf_clear (struct peer *);
+extern void bgp_perf_init (void);
+
+#endif /* _QUAGGA_BGP_PERF_H */
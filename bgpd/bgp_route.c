@@ -34,6 +34,7 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #include "plist.h"
 #include "thread.h"
 #include "workqueue.h"
+#include "trace.h"
 
 #include "bgpd/bgpd.h"
 #include "bgpd/bgp_table.h"
@@ -55,6 +56,10 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #include "bgpd/bgp_zebra.h"
 #include "bgpd/bgp_vty.h"
 #include "bgpd/bgp_mpath.h"
+#include "bgpd/bgp_export.h"
+#include "bgpd/bgp_bmp.h"
+#include "bgpd/bgp_rpki.h"
+#include "bgpd/bgp_perf.h"
 
 /* Extern from bgp_dump.c */
 extern const char *bgp_origin_str[];
@@ -122,10 +127,25 @@ struct bgp_info_extra *
 bgp_info_extra_get (struct bgp_info *ri)
 {
   if (!ri->extra)
-    ri->extra = bgp_info_extra_new();
+    {
+      ri->extra = bgp_info_extra_new();
+      if (ri->net)
+        ri->peer->mem_paths += sizeof (struct bgp_info_extra);
+    }
   return ri->extra;
 }
 
+/* Note the origin validation state of the route to p, on the extra
+   information only if it is not the NotFound paths without it have. */
+static void
+bgp_info_rpki_set (struct bgp_info *ri, struct prefix *p)
+{
+  int state = bgp_rpki_validate (p, ri->peer, ri->attr);
+
+  if (state != RPKI_NOTFOUND || ri->extra)
+    bgp_info_extra_get (ri)->rpki_state = state;
+}
+
 /* Allocate new bgp info structure. */
 static struct bgp_info *
 bgp_info_new (void)
@@ -140,9 +160,14 @@ bgp_info_free (struct bgp_info *binfo)
   if (binfo->attr)
     bgp_attr_unintern (&binfo->attr);
   
+  bgp_nexthop_unlink (binfo);
+  if (binfo->extra)
+    binfo->peer->mem_paths -= sizeof (struct bgp_info_extra);
   bgp_info_extra_free (&binfo->extra);
   bgp_info_mpath_free (&binfo->mpath);
 
+  BGP_PEER_INDEX_DEL (binfo);
+  binfo->peer->mem_paths -= sizeof (struct bgp_info);
   peer_unlock (binfo->peer); /* bgp_info peer reference */
 
   XFREE (MTYPE_BGP_ROUTE, binfo);
@@ -185,19 +210,39 @@ bgp_info_unlock (struct bgp_info *binfo)
 void
 bgp_info_add (struct bgp_node *rn, struct bgp_info *ri)
 {
+  static u_int32_t addpath_tx_id;
   struct bgp_info *top;
+  struct bgp_table *table;
+
+  /* Identifiers only need to tell apart the paths of one prefix. */
+  if (++addpath_tx_id == 0)
+    addpath_tx_id = 1;
+  ri->addpath_tx_id = addpath_tx_id;
 
   top = rn->info;
+
+  table = bgp_node_table (rn);
+  table->path_count++;
+  if (! top)
+    {
+      table->prefix_count++;
+      table->prefixlen_total += rn->p.prefixlen;
+    }
   
   ri->next = rn->info;
   ri->prev = NULL;
   if (top)
     top->prev = ri;
   rn->info = ri;
+  ri->net = rn;
+  BGP_PEER_INDEX_ADD (&ri->peer->paths[table->afi][table->safi], ri);
   
   bgp_info_lock (ri);
   bgp_lock_node (rn);
   peer_lock (ri->peer); /* bgp_info peer reference */
+  ri->peer->mem_paths += sizeof (struct bgp_info);
+  if (ri->extra)
+    ri->peer->mem_paths += sizeof (struct bgp_info_extra);
 }
 
 /* Do the actual removal of info from RIB, for use by bgp_process 
@@ -205,14 +250,26 @@ bgp_info_add (struct bgp_node *rn, struct bgp_info *ri)
 static void
 bgp_info_reap (struct bgp_node *rn, struct bgp_info *ri)
 {
+  struct bgp_table *table;
+
   if (ri->next)
     ri->next->prev = ri->prev;
   if (ri->prev)
     ri->prev->next = ri->next;
   else
     rn->info = ri->next;
+  BGP_PEER_INDEX_DEL (ri);
+
+  table = bgp_node_table (rn);
+  table->path_count--;
+  if (! rn->info)
+    {
+      table->prefix_count--;
+      table->prefixlen_total -= rn->p.prefixlen;
+    }
   
   bgp_info_mpath_dequeue (ri);
+  bgp_nexthop_unlink (ri);
   bgp_info_unlock (ri);
   bgp_unlock_node (rn);
 }
@@ -236,6 +293,16 @@ bgp_info_restore (struct bgp_node *rn, struct bgp_info *ri)
   SET_FLAG (ri->flags, BGP_INFO_VALID);
 }
 
+/* The instance whose RIB RN is in.  RS-client tables are of the
+   instance of PEER, which has a path there. */
+struct bgp *
+bgp_node_bgp (struct bgp_node *rn, struct peer *peer)
+{
+  struct bgp_table *table = bgp_node_table (rn);
+
+  return table->bgp ? table->bgp : peer->bgp;
+}
+
 /* Adjust pcount as required */   
 static void
 bgp_pcount_adjust (struct bgp_node *rn, struct bgp_info *ri)
@@ -247,9 +314,11 @@ bgp_pcount_adjust (struct bgp_node *rn, struct bgp_info *ri)
 
   table = bgp_node_table (rn);
 
-  /* Ignore 'pcount' for RS-client tables */
+  /* Ignore 'pcount' for RS-client tables, and for the instances taking
+     the peer's routes from its own. */
   if (table->type != BGP_TABLE_MAIN
-      || ri->peer == ri->peer->bgp->peer_self)
+      || ri->peer == ri->peer->bgp->peer_self
+      || (table->bgp && table->bgp != ri->peer->bgp))
     return;
     
   if (BGP_INFO_HOLDDOWN (ri)
@@ -321,21 +390,69 @@ bgp_med_value (struct attr *attr, struct bgp *bgp)
     }
 }
 
+/* What the first steps of bgp_info_cmp() look at, gathered from the
+   path and its attributes once per best path run, instead of once per
+   comparison, and kept next to each other. */
+struct bgp_info_key
+{
+  struct bgp_info *ri;
+  u_int32_t weight;
+  u_int32_t local_pref;
+  u_int32_t med;
+  unsigned int hops;
+  unsigned int confeds;
+  as_t left_as;
+  as_t left_confed_as;
+  u_char has_left_as;
+  u_char has_left_confed_as;
+  u_char origin;
+  u_char normal;
+};
+
+static void
+bgp_info_key_make (struct bgp *bgp, struct bgp_info *ri,
+		   struct bgp_info_key *key)
+{
+  struct attr *attr = ri->attr;
+
+  key->ri = ri;
+  key->weight = attr->extra ? attr->extra->weight : 0;
+  if (attr->flag & ATTR_FLAG_BIT (BGP_ATTR_LOCAL_PREF))
+    key->local_pref = attr->local_pref;
+  else
+    key->local_pref = bgp->default_local_pref;
+  key->med = bgp_med_value (attr, bgp);
+  key->hops = aspath_count_hops (attr->aspath);
+  key->confeds = aspath_count_confeds (attr->aspath);
+  key->has_left_as = aspath_left_as (attr->aspath, &key->left_as);
+  key->has_left_confed_as = aspath_left_confed_as (attr->aspath,
+						   &key->left_confed_as);
+  key->origin = attr->origin;
+  key->normal = (ri->sub_type == BGP_ROUTE_NORMAL);
+}
+
+/* Paths whose MEDs bgp_info_cmp() compares without "always-compare-med",
+   by aspath_cmp_left() or aspath_cmp_left_confed() of their AS paths. */
+static int
+bgp_info_key_same_left (const struct bgp_info_key *k1,
+			const struct bgp_info_key *k2)
+{
+  return ((k1->has_left_as && k2->has_left_as
+	   && k1->left_as == k2->left_as)
+	  || (k1->has_left_confed_as && k2->has_left_confed_as
+	      && k1->left_confed_as == k2->left_confed_as));
+}
+
 /* Compare two bgp route entity.  br is preferable then return 1. */
 static int
-bgp_info_cmp (struct bgp *bgp, struct bgp_info *new, struct bgp_info *exist,
-	      int *paths_eq)
+bgp_info_cmp (struct bgp *bgp, struct bgp_info_key *newkey,
+	      struct bgp_info_key *existkey, int *paths_eq)
 {
+  struct bgp_info *new, *exist;
   struct attr *newattr, *existattr;
   struct attr_extra *newattre, *existattre;
   bgp_peer_sort_t new_sort;
   bgp_peer_sort_t exist_sort;
-  u_int32_t new_pref;
-  u_int32_t exist_pref;
-  u_int32_t new_med;
-  u_int32_t exist_med;
-  u_int32_t new_weight;
-  u_int32_t exist_weight;
   uint32_t newm, existm;
   struct in_addr new_id;
   struct in_addr exist_id;
@@ -348,40 +465,21 @@ bgp_info_cmp (struct bgp *bgp, struct bgp_info *new, struct bgp_info *exist,
   *paths_eq = 0;
 
   /* 0. Null check. */
-  if (new == NULL)
+  if (newkey == NULL)
     return 0;
-  if (exist == NULL)
+  if (existkey == NULL)
     return 1;
 
-  newattr = new->attr;
-  existattr = exist->attr;
-  newattre = newattr->extra;
-  existattre = existattr->extra;
-
   /* 1. Weight check. */
-  new_weight = exist_weight = 0;
-
-  if (newattre)
-    new_weight = newattre->weight;
-  if (existattre)
-    exist_weight = existattre->weight;
-
-  if (new_weight > exist_weight)
+  if (newkey->weight > existkey->weight)
     return 1;
-  if (new_weight < exist_weight)
+  if (newkey->weight < existkey->weight)
     return 0;
 
   /* 2. Local preference check. */
-  new_pref = exist_pref = bgp->default_local_pref;
-
-  if (newattr->flag & ATTR_FLAG_BIT (BGP_ATTR_LOCAL_PREF))
-    new_pref = newattr->local_pref;
-  if (existattr->flag & ATTR_FLAG_BIT (BGP_ATTR_LOCAL_PREF))
-    exist_pref = existattr->local_pref;
-
-  if (new_pref > exist_pref)
+  if (newkey->local_pref > existkey->local_pref)
     return 1;
-  if (new_pref < exist_pref)
+  if (newkey->local_pref < existkey->local_pref)
     return 0;
 
   /* 3. Local route check. We prefer:
@@ -389,70 +487,59 @@ bgp_info_cmp (struct bgp *bgp, struct bgp_info *new, struct bgp_info *exist,
    *  - BGP_ROUTE_AGGREGATE
    *  - BGP_ROUTE_REDISTRIBUTE
    */
-  if (! (new->sub_type == BGP_ROUTE_NORMAL))
+  if (! newkey->normal)
      return 1;
-  if (! (exist->sub_type == BGP_ROUTE_NORMAL))
+  if (! existkey->normal)
      return 0;
 
   /* 4. AS path length check. */
   if (! bgp_flag_check (bgp, BGP_FLAG_ASPATH_IGNORE))
     {
-      int exist_hops = aspath_count_hops (existattr->aspath);
-      int exist_confeds = aspath_count_confeds (existattr->aspath);
-      
+      unsigned int newhops = newkey->hops;
+      unsigned int existhops = existkey->hops;
+
       if (bgp_flag_check (bgp, BGP_FLAG_ASPATH_CONFED))
 	{
-	  int aspath_hops;
-	  
-	  aspath_hops = aspath_count_hops (newattr->aspath);
-          aspath_hops += aspath_count_confeds (newattr->aspath);
-          
-	  if ( aspath_hops < (exist_hops + exist_confeds))
-	    return 1;
-	  if ( aspath_hops > (exist_hops + exist_confeds))
-	    return 0;
-	}
-      else
-	{
-	  int newhops = aspath_count_hops (newattr->aspath);
-	  
-	  if (newhops < exist_hops)
-	    return 1;
-          if (newhops > exist_hops)
-	    return 0;
+	  newhops += newkey->confeds;
+	  existhops += existkey->confeds;
 	}
+
+      if (newhops < existhops)
+	return 1;
+      if (newhops > existhops)
+	return 0;
     }
 
   /* 5. Origin check. */
-  if (newattr->origin < existattr->origin)
+  if (newkey->origin < existkey->origin)
     return 1;
-  if (newattr->origin > existattr->origin)
+  if (newkey->origin > existkey->origin)
     return 0;
 
   /* 6. MED check. */
-  internal_as_route = (aspath_count_hops (newattr->aspath) == 0
-		      && aspath_count_hops (existattr->aspath) == 0);
-  confed_as_route = (aspath_count_confeds (newattr->aspath) > 0
-		    && aspath_count_confeds (existattr->aspath) > 0
-		    && aspath_count_hops (newattr->aspath) == 0
-		    && aspath_count_hops (existattr->aspath) == 0);
+  internal_as_route = (newkey->hops == 0 && existkey->hops == 0);
+  confed_as_route = (newkey->confeds > 0 && existkey->confeds > 0
+		     && internal_as_route);
   
   if (bgp_flag_check (bgp, BGP_FLAG_ALWAYS_COMPARE_MED)
       || (bgp_flag_check (bgp, BGP_FLAG_MED_CONFED)
 	 && confed_as_route)
-      || aspath_cmp_left (newattr->aspath, existattr->aspath)
-      || aspath_cmp_left_confed (newattr->aspath, existattr->aspath)
+      || bgp_info_key_same_left (newkey, existkey)
       || internal_as_route)
     {
-      new_med = bgp_med_value (new->attr, bgp);
-      exist_med = bgp_med_value (exist->attr, bgp);
-
-      if (new_med < exist_med)
+      if (newkey->med < existkey->med)
 	return 1;
-      if (new_med > exist_med)
+      if (newkey->med > existkey->med)
 	return 0;
     }
 
+  new = newkey->ri;
+  exist = existkey->ri;
+  newattr = new->attr;
+  existattr = exist->attr;
+  newattre = newattr->extra;
+  existattre = existattr->extra;
+
   /* 7. Peer type check. */
   new_sort = new->peer->sort;
   exist_sort = exist->peer->sort;
@@ -550,6 +637,20 @@ bgp_info_cmp (struct bgp *bgp, struct bgp_info *new, struct bgp_info *exist,
   return 1;
 }
 
+/* Whether the decision process prefers new to exist, for callers outside
+   route selection. */
+int
+bgp_info_preferred (struct bgp *bgp, struct bgp_info *new,
+		    struct bgp_info *exist)
+{
+  struct bgp_info_key newkey, existkey;
+  int paths_eq;
+
+  bgp_info_key_make (bgp, new, &newkey);
+  bgp_info_key_make (bgp, exist, &existkey);
+  return bgp_info_cmp (bgp, &newkey, &existkey, &paths_eq);
+}
+
 static enum filter_type
 bgp_input_filter (struct peer *peer, struct prefix *p, struct attr *attr,
 		  afi_t afi, safi_t safi)
@@ -695,7 +796,7 @@ bgp_input_modifier (struct peer *peer, struct prefix *p, struct attr *attr,
       SET_FLAG (peer->rmap_type, PEER_RMAP_TYPE_IN); 
 
       /* Apply BGP route map to the attribute. */
-      ret = route_map_apply (ROUTE_MAP_IN (filter), p, RMAP_BGP, &info);
+      ret = bgp_route_map_apply (peer->bgp, ROUTE_MAP_IN (filter), p, &info);
 
       peer->rmap_type = 0;
 
@@ -729,7 +830,8 @@ bgp_export_modifier (struct peer *rsclient, struct peer *peer,
       SET_FLAG (rsclient->rmap_type, PEER_RMAP_TYPE_EXPORT);
 
       /* Apply BGP route map to the attribute. */
-      ret = route_map_apply (ROUTE_MAP_EXPORT (filter), p, RMAP_BGP, &info);
+      ret = bgp_route_map_apply (peer->bgp, ROUTE_MAP_EXPORT (filter), p,
+				 &info);
 
       rsclient->rmap_type = 0;
 
@@ -767,7 +869,8 @@ bgp_import_modifier (struct peer *rsclient, struct peer *peer,
       SET_FLAG (peer->rmap_type, PEER_RMAP_TYPE_IMPORT);
 
       /* Apply BGP route map to the attribute. */
-      ret = route_map_apply (ROUTE_MAP_IMPORT (filter), p, RMAP_BGP, &info);
+      ret = bgp_route_map_apply (peer->bgp, ROUTE_MAP_IMPORT (filter), p,
+				 &info);
 
       peer->rmap_type = 0;
 
@@ -781,33 +884,19 @@ bgp_import_modifier (struct peer *rsclient, struct peer *peer,
   return RMAP_PERMIT;
 }
 
+/* The checks of bgp_announce_check() against who the peer is, rather
+   than how it is configured. */
 static int
-bgp_announce_check (struct bgp_info *ri, struct peer *peer, struct prefix *p,
-		    struct attr *attr, afi_t afi, safi_t safi)
+bgp_announce_check_peer (struct bgp_info *ri, struct peer *peer,
+			 struct prefix *p, afi_t afi, safi_t safi)
 {
-  int ret;
   char buf[SU_ADDRSTRLEN];
-  struct bgp_filter *filter;
-  struct peer *from;
-  struct bgp *bgp;
-  int transparent;
-  int reflect;
   struct attr *riattr;
 
-  from = ri->peer;
-  filter = &peer->filter[afi][safi];
-  bgp = peer->bgp;
   riattr = bgp_info_mpath_count (ri) ? bgp_info_mpath_attr (ri) : ri->attr;
-  
-  if (DISABLE_BGP_ANNOUNCE)
-    return 0;
-
-  /* Do not send announces to RS-clients from the 'normal' bgp_table. */
-  if (CHECK_FLAG(peer->af_flags[afi][safi], PEER_FLAG_RSERVER_CLIENT))
-    return 0;
 
   /* Do not send back route to sender. */
-  if (from == peer)
+  if (ri->peer == peer)
     return 0;
 
   /* If peer's id and route's nexthop are same. draft-ietf-idr-bgp4-23 5.1.3 */
@@ -820,11 +909,6 @@ bgp_announce_check (struct bgp_info *ri, struct peer *peer, struct prefix *p,
     return 0;
 #endif
 
-  /* Aggregate-address suppress check. */
-  if (ri->extra && ri->extra->suppress)
-    if (! UNSUPPRESS_MAP_NAME (filter))
-      return 0;
-
   /* Default route check.  */
   if (CHECK_FLAG (peer->af_sflags[afi][safi], PEER_STATUS_DEFAULT_ORIGINATE))
     {
@@ -836,17 +920,6 @@ bgp_announce_check (struct bgp_info *ri, struct peer *peer, struct prefix *p,
 #endif /* HAVE_IPV6 */
     }
 
-  /* Transparency check. */
-  if (CHECK_FLAG (peer->af_flags[afi][safi], PEER_FLAG_RSERVER_CLIENT)
-      && CHECK_FLAG (from->af_flags[afi][safi], PEER_FLAG_RSERVER_CLIENT))
-    transparent = 1;
-  else
-    transparent = 0;
-
-  /* If community is not disabled check the no-export and local. */
-  if (! transparent && bgp_community_filter (peer, riattr))
-    return 0;
-
   /* If the attribute has originator-id and it is same as remote
      peer's id. */
   if (riattr->flag & ATTR_FLAG_BIT (BGP_ATTR_ORIGINATOR_ID))
@@ -862,6 +935,53 @@ bgp_announce_check (struct bgp_info *ri, struct peer *peer, struct prefix *p,
 	  return 0;
 	}
     }
+
+  return 1;
+}
+
+/* The rest of bgp_announce_check(), which depends on no more of the
+   peer than struct bgp_announce_key holds, see bgp_announce_key_make(). */
+static int
+bgp_announce_check_conf (struct bgp_info *ri, struct peer *peer,
+			 struct prefix *p, struct attr *attr,
+			 afi_t afi, safi_t safi)
+{
+  int ret;
+  char buf[SU_ADDRSTRLEN];
+  struct bgp_filter *filter;
+  struct peer *from;
+  struct bgp *bgp;
+  int transparent;
+  int reflect;
+  struct attr *riattr;
+
+  from = ri->peer;
+  filter = &peer->filter[afi][safi];
+  bgp = peer->bgp;
+  riattr = bgp_info_mpath_count (ri) ? bgp_info_mpath_attr (ri) : ri->attr;
+  
+  if (DISABLE_BGP_ANNOUNCE)
+    return 0;
+
+  /* Do not send announces to RS-clients from the 'normal' bgp_table. */
+  if (CHECK_FLAG(peer->af_flags[afi][safi], PEER_FLAG_RSERVER_CLIENT))
+    return 0;
+
+  /* Aggregate-address suppress check. */
+  if (ri->extra && ri->extra->suppress)
+    if (! UNSUPPRESS_MAP_NAME (filter))
+      return 0;
+
+  /* Transparency check. */
+  if (CHECK_FLAG (peer->af_flags[afi][safi], PEER_FLAG_RSERVER_CLIENT)
+      && CHECK_FLAG (from->af_flags[afi][safi], PEER_FLAG_RSERVER_CLIENT))
+    transparent = 1;
+  else
+    transparent = 0;
+
+  /* If community is not disabled check the no-export and local. */
+  if (! transparent && bgp_community_filter (peer, riattr))
+    return 0;
  
   /* ORF prefix-list filter check */
   if (CHECK_FLAG (peer->af_cap[afi][safi], PEER_CAP_ORF_PREFIX_RM_ADV)
@@ -1075,9 +1195,9 @@ bgp_announce_check (struct bgp_info *ri, struct peer *peer, struct prefix *p,
       SET_FLAG (peer->rmap_type, PEER_RMAP_TYPE_OUT); 
 
       if (ri->extra && ri->extra->suppress)
-	ret = route_map_apply (UNSUPPRESS_MAP (filter), p, RMAP_BGP, &info);
+	ret = bgp_route_map_apply (bgp, UNSUPPRESS_MAP (filter), p, &info);
       else
-	ret = route_map_apply (ROUTE_MAP_OUT (filter), p, RMAP_BGP, &info);
+	ret = bgp_route_map_apply (bgp, ROUTE_MAP_OUT (filter), p, &info);
 
       peer->rmap_type = 0;
 
@@ -1090,6 +1210,14 @@ bgp_announce_check (struct bgp_info *ri, struct peer *peer, struct prefix *p,
   return 1;
 }
 
+static int
+bgp_announce_check (struct bgp_info *ri, struct peer *peer, struct prefix *p,
+		    struct attr *attr, afi_t afi, safi_t safi)
+{
+  return bgp_announce_check_peer (ri, peer, p, afi, safi)
+	 && bgp_announce_check_conf (ri, peer, p, attr, afi, safi);
+}
+
 static int
 bgp_announce_check_rsclient (struct bgp_info *ri, struct peer *rsclient,
         struct prefix *p, struct attr *attr, afi_t afi, safi_t safi)
@@ -1294,6 +1422,84 @@ struct bgp_info_pair
   struct bgp_info *new;
 };
 
+/* Keys of the paths of the node being selected for, in list order.
+   bgpd runs best path selection from one thread only. */
+static struct bgp_info_key *bgp_info_keys;
+static unsigned int bgp_info_keys_size;
+
+static struct bgp_info_key *
+bgp_info_keys_make (struct bgp *bgp, struct bgp_node *rn)
+{
+  struct bgp_info *ri;
+  unsigned int n = 0;
+
+  for (ri = rn->info; ri; ri = ri->next)
+    n++;
+
+  if (n > bgp_info_keys_size)
+    {
+      bgp_info_keys_size = MAX (n, 2 * bgp_info_keys_size);
+      bgp_info_keys = XREALLOC (MTYPE_BGP_INFO_KEY, bgp_info_keys,
+				bgp_info_keys_size
+				* sizeof (struct bgp_info_key));
+    }
+
+  for (n = 0, ri = rn->info; ri; ri = ri->next, n++)
+    if (! BGP_INFO_HOLDDOWN (ri))
+      bgp_info_key_make (bgp, ri, &bgp_info_keys[n]);
+
+  return bgp_info_keys;
+}
+
+/* Select between the old best and HINT, the only path changed since.
+   Returns 0, having changed nothing, if the old best itself changed or
+   went away, which needs all paths compared. */
+static int
+bgp_best_selection_hint (struct bgp *bgp, struct bgp_node *rn,
+			 struct bgp_info *hint, struct bgp_info_pair *result)
+{
+  struct bgp_info *ri;
+  struct bgp_info *nextri;
+  struct bgp_info *old_select = NULL;
+  struct bgp_info_key new_key;
+  struct bgp_info_key old_key;
+  int found = 0;
+  int paths_eq;
+
+  for (ri = rn->info; ri; ri = ri->next)
+    {
+      if (CHECK_FLAG (ri->flags, BGP_INFO_SELECTED))
+	old_select = ri;
+      if (ri == hint)
+	found = 1;
+    }
+
+  if (! found || ! old_select || old_select == hint
+      || BGP_INFO_HOLDDOWN (old_select))
+    return 0;
+
+  result->old = old_select;
+  result->new = old_select;
+
+  if (! BGP_INFO_HOLDDOWN (hint))
+    {
+      bgp_info_key_make (bgp, hint, &new_key);
+      bgp_info_key_make (bgp, old_select, &old_key);
+      if (bgp_info_cmp (bgp, &new_key, &old_key, &paths_eq))
+	result->new = hint;
+    }
+
+  /* Reap REMOVED routes as the full selection does. */
+  for (ri = rn->info; ri; ri = nextri)
+    {
+      nextri = ri->next;
+      if (CHECK_FLAG (ri->flags, BGP_INFO_REMOVED) && ri != old_select)
+	bgp_info_reap (rn, ri);
+    }
+
+  return 1;
+}
+
 static void
 bgp_best_selection (struct bgp *bgp, struct bgp_node *rn,
 		    struct bgp_maxpaths_cfg *mpath_cfg,
@@ -1305,17 +1511,51 @@ bgp_best_selection (struct bgp *bgp, struct bgp_node *rn,
   struct bgp_info *ri1;
   struct bgp_info *ri2;
   struct bgp_info *nextri = NULL;
+  struct bgp_info *hint;
+  struct bgp_info_key *keys;
+  struct bgp_info_key *new_key;
+  unsigned int i, j;
   int paths_eq, do_mpath;
-  struct list mp_list;
+  static struct bgp_mp_list mp_list;
 
-  bgp_mp_list_init (&mp_list);
+  /* The candidate array of earlier selections is reused. */
+  bgp_mp_list_clear (&mp_list);
   do_mpath = (mpath_cfg->maxpaths_ebgp != BGP_DEFAULT_MAXPATHS ||
 	      mpath_cfg->maxpaths_ibgp != BGP_DEFAULT_MAXPATHS);
 
+  hint = rn->select_hint;
+  rn->select_hint = NULL;
+  if (CHECK_FLAG (rn->flags, BGP_NODE_SELECT_FULL))
+    {
+      UNSET_FLAG (rn->flags, BGP_NODE_SELECT_FULL);
+      hint = NULL;
+    }
+
+  /* Only one path changed, and the best one was not it: the best of the
+     other paths is still the old best, so only the changed path needs
+     comparing against it.  Multipath and deterministic-med need every
+     path looked at. */
+  if (hint && ! do_mpath
+      && ! bgp_flag_check (bgp, BGP_FLAG_DETERMINISTIC_MED)
+      && bgp_best_selection_hint (bgp, rn, hint, result))
+    {
+      bgp_node_table (rn)->select_fast++;
+      bgp_info_mpath_update (rn, result->new, result->old, &mp_list,
+			     mpath_cfg);
+      bgp_info_mpath_aggregate_update (result->new, result->old);
+      QUAGGA_TRACE (bgpd, best_selection, &rn->p, result->old, result->new,
+		    result->new ? result->new->peer->host : NULL, 1);
+      return;
+    }
+  bgp_node_table (rn)->select_full++;
+
+  /* Paths in holddown have no key made, and are never compared. */
+  keys = bgp_info_keys_make (bgp, rn);
+
   /* bgp deterministic-med */
   new_select = NULL;
   if (bgp_flag_check (bgp, BGP_FLAG_DETERMINISTIC_MED))
-    for (ri1 = rn->info; ri1; ri1 = ri1->next)
+    for (ri1 = rn->info, i = 0; ri1; ri1 = ri1->next, i++)
       {
 	if (CHECK_FLAG (ri1->flags, BGP_INFO_DMED_CHECK))
 	  continue;
@@ -1323,27 +1563,27 @@ bgp_best_selection (struct bgp *bgp, struct bgp_node *rn,
 	  continue;
 
 	new_select = ri1;
+	new_key = &keys[i];
 	if (do_mpath)
 	  bgp_mp_list_add (&mp_list, ri1);
 	old_select = CHECK_FLAG (ri1->flags, BGP_INFO_SELECTED) ? ri1 : NULL;
 	if (ri1->next)
-	  for (ri2 = ri1->next; ri2; ri2 = ri2->next)
+	  for (ri2 = ri1->next, j = i + 1; ri2; ri2 = ri2->next, j++)
 	    {
 	      if (CHECK_FLAG (ri2->flags, BGP_INFO_DMED_CHECK))
 		continue;
 	      if (BGP_INFO_HOLDDOWN (ri2))
 		continue;
 
-	      if (aspath_cmp_left (ri1->attr->aspath, ri2->attr->aspath)
-		  || aspath_cmp_left_confed (ri1->attr->aspath,
-					     ri2->attr->aspath))
+	      if (bgp_info_key_same_left (&keys[i], &keys[j]))
 		{
 		  if (CHECK_FLAG (ri2->flags, BGP_INFO_SELECTED))
 		    old_select = ri2;
-		  if (bgp_info_cmp (bgp, ri2, new_select, &paths_eq))
+		  if (bgp_info_cmp (bgp, &keys[j], new_key, &paths_eq))
 		    {
 		      bgp_info_unset_flag (rn, new_select, BGP_INFO_DMED_SELECTED);
 		      new_select = ri2;
+		      new_key = &keys[j];
 		      if (do_mpath && !paths_eq)
 			{
 			  bgp_mp_list_clear (&mp_list);
@@ -1367,7 +1607,9 @@ bgp_best_selection (struct bgp *bgp, struct bgp_node *rn,
   /* Check old selected route and new selected route. */
   old_select = NULL;
   new_select = NULL;
-  for (ri = rn->info; (ri != NULL) && (nextri = ri->next, 1); ri = nextri)
+  new_key = NULL;
+  for (ri = rn->info, i = 0; (ri != NULL) && (nextri = ri->next, 1);
+       ri = nextri, i++)
     {
       if (CHECK_FLAG (ri->flags, BGP_INFO_SELECTED))
 	old_select = ri;
@@ -1393,12 +1635,13 @@ bgp_best_selection (struct bgp *bgp, struct bgp_node *rn,
       bgp_info_unset_flag (rn, ri, BGP_INFO_DMED_CHECK);
       bgp_info_unset_flag (rn, ri, BGP_INFO_DMED_SELECTED);
 
-      if (bgp_info_cmp (bgp, ri, new_select, &paths_eq))
+      if (bgp_info_cmp (bgp, &keys[i], new_key, &paths_eq))
 	{
 	  if (do_mpath && bgp_flag_check (bgp, BGP_FLAG_DETERMINISTIC_MED))
 	    bgp_mp_dmed_deselect (new_select);
 
 	  new_select = ri;
+	  new_key = &keys[i];
 
 	  if (do_mpath && !paths_eq)
 	    {
@@ -1423,67 +1666,290 @@ bgp_best_selection (struct bgp *bgp, struct bgp_node *rn,
   result->old = old_select;
   result->new = new_select;
 
+  QUAGGA_TRACE (bgpd, best_selection, &rn->p, old_select, new_select,
+		new_select ? new_select->peer->host : NULL, 0);
   return;
 }
 
+/* Whether the path in the baseline RIB would have made it into the own
+   RIB of a shared RS-Client, see bgp_update_rsclient(). */
 static int
-bgp_process_announce_selected (struct peer *peer, struct bgp_info *selected,
-                               struct bgp_node *rn, afi_t afi, safi_t safi)
+bgp_rsclient_shared_eligible (struct peer *rsclient, struct bgp_info *ri,
+                              afi_t afi, safi_t safi)
 {
-  struct prefix *p;
-  struct attr attr;
-  struct attr_extra extra;
-
-  p = &rn->p;
+  struct attr *attr = ri->attr;
 
-  /* Announce route to Established peer. */
-  if (peer->status != Established)
+  if (ri->peer == rsclient)
     return 0;
 
-  /* Address family configuration check. */
-  if (! peer->afc_nego[afi][safi])
+  if (aspath_loop_check (attr->aspath, rsclient->as)
+      > ri->peer->allowas_in[afi][safi])
     return 0;
 
-  /* First update is deferred until ORF or ROUTE-REFRESH is received */
-  if (CHECK_FLAG (peer->af_sflags[afi][safi],
-      PEER_STATUS_ORF_WAIT_REFRESH))
+  if (attr->flag & ATTR_FLAG_BIT (BGP_ATTR_ORIGINATOR_ID)
+      && IPV4_ADDR_SAME (&rsclient->remote_id, &attr->extra->originator_id))
     return 0;
 
-  /* It's initialized in bgp_announce_[check|check_rsclient]() */
-  attr.extra = &extra;
+  return 1;
+}
 
-  switch (bgp_node_table (rn)->type)
+/* The path a shared RS-Client would select: the baseline's best one
+   when it may have it, or else the best of those it may have.  The
+   fallback does not group paths for deterministic-med. */
+static struct bgp_info *
+bgp_rsclient_shared_select (struct peer *rsclient, struct bgp_node *rn,
+                            afi_t afi, safi_t safi)
+{
+  struct bgp *bgp = rsclient->bgp;
+  struct bgp_info *ri;
+  struct bgp_info *select = NULL;
+  struct bgp_info_key key;
+  struct bgp_info_key select_key;
+  int paths_eq;
+
+  for (ri = rn->info; ri; ri = ri->next)
+    if (CHECK_FLAG (ri->flags, BGP_INFO_SELECTED))
+      break;
+
+  if (ri && ! BGP_INFO_HOLDDOWN (ri)
+      && bgp_rsclient_shared_eligible (rsclient, ri, afi, safi))
+    return ri;
+
+  for (ri = rn->info; ri; ri = ri->next)
     {
-      case BGP_TABLE_MAIN:
-      /* Announcement to peer->conf.  If the route is filtered,
-         withdraw it. */
-        if (selected && bgp_announce_check (selected, peer, p, &attr, afi, safi))
-          bgp_adj_out_set (rn, peer, p, &attr, afi, safi, selected);
-        else
-          bgp_adj_out_unset (rn, peer, p, afi, safi);
-        break;
-      case BGP_TABLE_RSCLIENT:
-        /* Announcement to peer->conf.  If the route is filtered, 
-           withdraw it. */
-        if (selected && 
-            bgp_announce_check_rsclient (selected, peer, p, &attr, afi, safi))
-          bgp_adj_out_set (rn, peer, p, &attr, afi, safi, selected);
-        else
-	  bgp_adj_out_unset (rn, peer, p, afi, safi);
-        break;
+      if (BGP_INFO_HOLDDOWN (ri)
+          || ! bgp_rsclient_shared_eligible (rsclient, ri, afi, safi))
+        continue;
+
+      bgp_info_key_make (bgp, ri, &key);
+      if (! select || bgp_info_cmp (bgp, &key, &select_key, &paths_eq))
+        {
+          select = ri;
+          select_key = key;
+        }
     }
 
-  return 0;
+  return select;
 }
 
-struct bgp_process_queue 
+/* Announce the node of the baseline RIB to a shared RS-Client.  Unless
+   force is set, a route the peer already has unchanged is not sent
+   again. */
+static void
+bgp_announce_shared (struct peer *peer, struct bgp_node *rn,
+                     afi_t afi, safi_t safi, int force)
 {
-  struct bgp *bgp;
-  struct bgp_node *rn;
-  afi_t afi;
-  safi_t safi;
-};
-
+  struct prefix *p = &rn->p;
+  struct bgp_info *select;
+  struct bgp_adj_out *adj;
+  struct attr attr;
+  struct attr_extra extra;
+
+  /* It's initialized in bgp_announce_check_rsclient() */
+  attr.extra = &extra;
+
+  select = bgp_rsclient_shared_select (peer, rn, afi, safi);
+  if (! select
+      || ! bgp_announce_check_rsclient (select, peer, p, &attr, afi, safi))
+    {
+      bgp_adj_out_unset (rn, peer, p, afi, safi, 0);
+      return;
+    }
+
+  /* Towards IBGP peers the encoding also depends on the peer the route
+     came from, which the adjacency does not record. */
+  adj = bgp_adj_out_get (rn, peer, 0);
+  if (! force && adj && ! adj->adv && adj->attr
+      && peer->sort != BGP_PEER_IBGP && attrhash_cmp (adj->attr, &attr))
+    return;
+
+  bgp_adj_out_set (rn, peer, p, &attr, afi, safi, select);
+}
+
+/* Announce every usable path of the node to a peer taking ADD-PATH,
+   and withdraw those that went away.  Unless force is set, paths the
+   peer already has unchanged are not sent again. */
+static void
+bgp_announce_addpath (struct peer *peer, struct bgp_node *rn,
+		      afi_t afi, safi_t safi, int force)
+{
+  struct prefix *p = &rn->p;
+  struct bgp_info *ri;
+  struct bgp_adj_out *adj;
+  struct bgp_adj_out *next;
+  struct attr attr;
+  struct attr_extra extra;
+  int rsclient = (bgp_node_table (rn)->type == BGP_TABLE_RSCLIENT);
+  int shared = CHECK_FLAG (peer->af_flags[afi][safi],
+                           PEER_FLAG_RSERVER_SHARED);
+  int ret;
+
+  /* It's initialized in bgp_announce_[check|check_rsclient]() */
+  attr.extra = &extra;
+
+  /* Paths reaped since they were announced. */
+  for (adj = rn->adj_out; adj; adj = next)
+    {
+      next = adj->next;
+      if (adj->peer != peer)
+	continue;
+      for (ri = rn->info; ri; ri = ri->next)
+	if (ri->addpath_tx_id == adj->addpath_tx_id)
+	  break;
+      if (! ri)
+	bgp_adj_out_unset (rn, peer, p, afi, safi, adj->addpath_tx_id);
+    }
+
+  for (ri = rn->info; ri; ri = ri->next)
+    {
+      if (BGP_INFO_HOLDDOWN (ri))
+	ret = 0;
+      else if (shared && ! bgp_rsclient_shared_eligible (peer, ri, afi, safi))
+	ret = 0;
+      else if (rsclient)
+	ret = bgp_announce_check_rsclient (ri, peer, p, &attr, afi, safi);
+      else
+	ret = bgp_announce_check (ri, peer, p, &attr, afi, safi);
+
+      if (! ret)
+	{
+	  bgp_adj_out_unset (rn, peer, p, afi, safi, ri->addpath_tx_id);
+	  continue;
+	}
+
+      /* Equal attributes share every pointer with the advertised ones,
+	 so nothing announce_check made needs releasing here. */
+      adj = bgp_adj_out_get (rn, peer, ri->addpath_tx_id);
+      if (! force && adj && ! adj->adv && adj->attr
+	  && attrhash_cmp (adj->attr, &attr))
+	continue;
+
+      bgp_adj_out_set (rn, peer, p, &attr, afi, safi, ri);
+    }
+}
+
+static int
+bgp_process_announce_selected (struct peer *peer, struct bgp_info *selected,
+                               struct bgp_node *rn, afi_t afi, safi_t safi)
+{
+  struct prefix *p;
+  struct attr attr;
+  struct attr_extra extra;
+
+  p = &rn->p;
+
+  /* Announce route to Established peer. */
+  if (peer->status != Established)
+    return 0;
+
+  /* Address family configuration check. */
+  if (! peer->afc_nego[afi][safi])
+    return 0;
+
+  /* First update is deferred until ORF or ROUTE-REFRESH is received */
+  if (CHECK_FLAG (peer->af_sflags[afi][safi],
+      PEER_STATUS_ORF_WAIT_REFRESH))
+    return 0;
+
+  if (PEER_ADDPATH_TX (peer, afi, safi))
+    {
+      bgp_announce_addpath (peer, rn, afi, safi, 0);
+      return 0;
+    }
+
+  /* It's initialized in bgp_announce_[check|check_rsclient]() */
+  attr.extra = &extra;
+
+  switch (bgp_node_table (rn)->type)
+    {
+      case BGP_TABLE_MAIN:
+      /* Announcement to peer->conf.  If the route is filtered,
+         withdraw it. */
+        if (selected && bgp_announce_check (selected, peer, p, &attr, afi, safi))
+          bgp_adj_out_set (rn, peer, p, &attr, afi, safi, selected);
+        else
+          bgp_adj_out_unset (rn, peer, p, afi, safi, 0);
+        break;
+      case BGP_TABLE_RSCLIENT:
+        /* Announcement to peer->conf.  If the route is filtered, 
+           withdraw it. */
+        if (selected && 
+            bgp_announce_check_rsclient (selected, peer, p, &attr, afi, safi))
+          bgp_adj_out_set (rn, peer, p, &attr, afi, safi, selected);
+        else
+	  bgp_adj_out_unset (rn, peer, p, afi, safi, 0);
+        break;
+    }
+
+  return 0;
+}
+
+/* The baseline RIB changed at the node: tell a shared RS-Client. */
+static void
+bgp_process_announce_shared (struct peer *peer, struct bgp_node *rn,
+                             afi_t afi, safi_t safi)
+{
+  if (peer->status != Established)
+    return;
+
+  if (! peer->afc_nego[afi][safi])
+    return;
+
+  if (CHECK_FLAG (peer->af_sflags[afi][safi],
+      PEER_STATUS_ORF_WAIT_REFRESH))
+    return;
+
+  if (PEER_ADDPATH_TX (peer, afi, safi))
+    bgp_announce_addpath (peer, rn, afi, safi, 0);
+  else
+    bgp_announce_shared (peer, rn, afi, safi, 0);
+}
+
+struct bgp_process_queue 
+{
+  struct bgp *bgp;
+  struct bgp_node *rn;
+  afi_t afi;
+  safi_t safi;
+
+  /* Peer whose UPDATE queued the node, for latency accounting, and
+     when the node was queued and when its processing started. */
+  struct peer *peer;
+  unsigned long long queued;
+  unsigned long long started;
+};
+
+/* Priority classes of the process queues, most urgent first, so that
+   a lost best path does not wait behind a table being loaded. */
+enum bgp_process_prio
+{
+  BGP_PROCESS_WITHDRAW,		/* the best path went away */
+  BGP_PROCESS_CHANGE,		/* routine changes */
+  BGP_PROCESS_EOR,		/* stale paths swept at end-of-RIB */
+  BGP_PROCESS_BULK,		/* initial loads, soft reconfiguration */
+  BGP_PROCESS_PRIO_MAX,
+};
+
+static const char *bgp_process_prio_names[BGP_PROCESS_PRIO_MAX] =
+{
+  "withdrawals",
+  "changes",
+  "end-of-RIB",
+  "bulk loads",
+};
+
+/* Class of the nodes scheduled by what runs now, unless they lost
+   their best path. */
+static enum bgp_process_prio bgp_process_prio_scope = BGP_PROCESS_CHANGE;
+
+/* Charge the time the node waited to the peer that queued it. */
+static void
+bgp_process_perf_start (struct bgp_process_queue *pq)
+{
+  if (pq->peer)
+    pq->started = bgp_perf_record (pq->peer, BGP_PERF_QUEUE, pq->queued);
+}
+
 static wq_item_status
 bgp_process_rsclient (struct work_queue *wq, void *data)
 {
@@ -1498,6 +1964,9 @@ bgp_process_rsclient (struct work_queue *wq, void *data)
   struct listnode *node, *nnode;
   struct peer *rsclient = bgp_node_table (rn)->owner;
   
+  QUAGGA_TRACE (bgpd, process_dequeue, &rn->p, afi, safi, BGP_TABLE_RSCLIENT);
+  bgp_process_perf_start (pq);
+
   /* Best path selection. */
   bgp_best_selection (bgp, rn, &bgp->maxpaths[afi][safi], &old_and_new);
   new_select = old_and_new.new;
@@ -1509,7 +1978,8 @@ bgp_process_rsclient (struct work_queue *wq, void *data)
         for (ALL_LIST_ELEMENTS (rsclient->group->peer, node, nnode, rsclient))
           {
             /* Nothing to do. */
-            if (old_select && old_select == new_select)
+            if (old_select && old_select == new_select
+                && ! PEER_ADDPATH_TX (rsclient, afi, safi))
               if (!CHECK_FLAG (old_select->flags, BGP_INFO_ATTR_CHANGED))
                 continue;
 
@@ -1537,6 +2007,14 @@ bgp_process_rsclient (struct work_queue *wq, void *data)
 	  UNSET_FLAG (new_select->flags, BGP_INFO_MULTIPATH_CHG);
 	}
       bgp_process_announce_selected (rsclient, new_select, rn, afi, safi);
+
+      /* Which path a shared RS-Client gets may change even when the
+         baseline's best one does not. */
+      if (rsclient == bgp->rsclient_base)
+        for (ALL_LIST_ELEMENTS (bgp->rsclient_shared, node, nnode, rsclient))
+          if (CHECK_FLAG (rsclient->af_flags[afi][safi],
+                          PEER_FLAG_RSERVER_SHARED))
+            bgp_process_announce_shared (rsclient, rn, afi, safi);
     }
 
   if (old_select && CHECK_FLAG (old_select->flags, BGP_INFO_REMOVED))
@@ -1561,19 +2039,31 @@ bgp_process_main (struct work_queue *wq, void *data)
   struct listnode *node, *nnode;
   struct peer *peer;
   
+  QUAGGA_TRACE (bgpd, process_dequeue, &rn->p, afi, safi, BGP_TABLE_MAIN);
+  bgp_process_perf_start (pq);
+
   /* Best path selection. */
   bgp_best_selection (bgp, rn, &bgp->maxpaths[afi][safi], &old_and_new);
   old_select = old_and_new.old;
   new_select = old_and_new.new;
 
+  bgp_export_change (bgp, rn, afi, safi);
+
   /* Nothing to do. */
   if (old_select && old_select == new_select)
     {
       if (! CHECK_FLAG (old_select->flags, BGP_INFO_ATTR_CHANGED))
         {
-          if (CHECK_FLAG (old_select->flags, BGP_INFO_IGP_CHANGED) ||
-	      CHECK_FLAG (old_select->flags, BGP_INFO_MULTIPATH_CHG))
+          /* zebra may follow the gateway by itself. */
+          if (CHECK_FLAG (old_select->flags, BGP_INFO_MULTIPATH_CHG)
+              || (CHECK_FLAG (old_select->flags, BGP_INFO_IGP_CHANGED)
+                  && ! bgp_zebra_follows_igp ()))
             bgp_zebra_announce (p, old_select, bgp, safi);
+
+          /* Other paths may still have changed. */
+          for (ALL_LIST_ELEMENTS (bgp->peer, node, nnode, peer))
+            if (PEER_ADDPATH_TX (peer, afi, safi))
+              bgp_process_announce_selected (peer, new_select, rn, afi, safi);
           
 	  UNSET_FLAG (old_select->flags, BGP_INFO_MULTIPATH_CHG);
           UNSET_FLAG (rn->flags, BGP_NODE_PROCESS_SCHEDULED);
@@ -1590,11 +2080,25 @@ bgp_process_main (struct work_queue *wq, void *data)
       UNSET_FLAG (new_select->flags, BGP_INFO_MULTIPATH_CHG);
     }
 
-
-  /* Check each BGP peer. */
-  for (ALL_LIST_ELEMENTS (bgp->peer, node, nnode, peer))
+  /* With suppress-fib-pending, a route zebra is to install is only sent
+     on once it is in the kernel, see bgp_fib_result. */
+  if (bgp_flag_check (bgp, BGP_FLAG_SUPPRESS_FIB_PENDING)
+      && afi == AFI_IP && safi == SAFI_UNICAST
+      && ! bgp->name && ! bgp_option_check (BGP_OPT_NO_FIB)
+      && new_select
+      && new_select->type == ZEBRA_ROUTE_BGP
+      && new_select->sub_type == BGP_ROUTE_NORMAL
+      && bgp_zebra_fib_notify ())
+    SET_FLAG (rn->flags, BGP_NODE_FIB_PENDING);
+  else
     {
-      bgp_process_announce_selected (peer, new_select, rn, afi, safi);
+      UNSET_FLAG (rn->flags, BGP_NODE_FIB_PENDING);
+
+      /* Check each BGP peer. */
+      for (ALL_LIST_ELEMENTS (bgp->peer, node, nnode, peer))
+	{
+	  bgp_process_announce_selected (peer, new_select, rn, afi, safi);
+	}
     }
 
   /* FIB update. */
@@ -1623,21 +2127,79 @@ bgp_process_main (struct work_queue *wq, void *data)
   return WQ_SUCCESS;
 }
 
+/* Zebra's answer for the route of a node held by suppress-fib-pending:
+   the selected path goes out now, or is withdrawn if the kernel would
+   not take it. */
+void
+bgp_fib_result (struct bgp *bgp, struct bgp_node *rn, afi_t afi, u_char status)
+{
+  struct bgp_info *selected;
+  struct listnode *node, *nnode;
+  struct peer *peer;
+
+  if (! CHECK_FLAG (rn->flags, BGP_NODE_FIB_PENDING))
+    return;
+  UNSET_FLAG (rn->flags, BGP_NODE_FIB_PENDING);
+
+  for (selected = rn->info; selected; selected = selected->next)
+    if (CHECK_FLAG (selected->flags, BGP_INFO_SELECTED))
+      break;
+  if (status == ZEBRA_FIB_FAILED)
+    selected = NULL;
+
+  for (ALL_LIST_ELEMENTS (bgp->peer, node, nnode, peer))
+    bgp_process_announce_selected (peer, selected, rn, afi, SAFI_UNICAST);
+}
+
 static void
 bgp_processq_del (struct work_queue *wq, void *data)
 {
   struct bgp_process_queue *pq = data;
   struct bgp_table *table = bgp_node_table (pq->rn);
   
+  /* Items are deleted as soon as they have been processed. */
+  if (pq->peer)
+    {
+      if (pq->started)
+        bgp_perf_record (pq->peer, BGP_PERF_PROCESS, pq->started);
+      peer_unlock (pq->peer);
+    }
+
   bgp_unlock (pq->bgp);
   bgp_unlock_node (pq->rn);
   bgp_table_unlock (table);
   XFREE (MTYPE_BGP_PROCESS_QUEUE, pq);
 }
 
+/* Set once a peer's routes have been cleared; the objects they used
+   are freed as the process queues run. */
+static int bgp_pool_trim_pending;
+
+/* Set when update-delay ended, until the nodes it held are processed. */
+static int bgp_update_delay_flush_pending;
+
+static void bgp_update_delay_flush (void);
+
+static void
+bgp_processq_complete (struct work_queue *wq)
+{
+  if (bgp_pool_trim_pending)
+    {
+      memory_pool_trim ();
+      bgp_pool_trim_pending = 0;
+    }
+
+  if (bgp_update_delay_flush_pending
+      && ! work_queue_item_count (bm->process_main_queue)
+      && ! work_queue_item_count (bm->process_rsclient_queue))
+    bgp_update_delay_flush ();
+}
+
 static void
 bgp_process_queue_init (void)
 {
+  int i;
+
   bm->process_main_queue
     = work_queue_new (bm->master, "process_main_queue");
   bm->process_rsclient_queue
@@ -1651,18 +2213,52 @@ bgp_process_queue_init (void)
   
   bm->process_main_queue->spec.workfunc = &bgp_process_main;
   bm->process_main_queue->spec.del_item_data = &bgp_processq_del;
+  bm->process_main_queue->spec.completion_func = &bgp_processq_complete;
   bm->process_main_queue->spec.max_retries = 0;
   bm->process_main_queue->spec.hold = 50;
+  for (i = 0; i < BGP_PROCESS_PRIO_MAX; i++)
+    bm->process_main_queue->spec.prio_names[i] = bgp_process_prio_names[i];
   
-  memcpy (bm->process_rsclient_queue, bm->process_main_queue,
-          sizeof (struct work_queue *));
+  /* RS-client tables share the main queue's spec, so their items are
+     released through bgp_processq_del as well. */
+  memcpy (&bm->process_rsclient_queue->spec, &bm->process_main_queue->spec,
+          sizeof (bm->process_rsclient_queue->spec));
   bm->process_rsclient_queue->spec.workfunc = &bgp_process_rsclient;
 }
 
-void
-bgp_process (struct bgp *bgp, struct bgp_node *rn, afi_t afi, safi_t safi)
+/* Which class of the process queue the node goes in. */
+static enum bgp_process_prio
+bgp_process_prio (struct bgp_node *rn, afi_t afi, safi_t safi)
+{
+  struct bgp_info *ri;
+  struct peer *peer = bgp_perf_peer;
+
+  for (ri = rn->info; ri; ri = ri->next)
+    if (CHECK_FLAG (ri->flags, BGP_INFO_SELECTED))
+      {
+	if (BGP_INFO_HOLDDOWN (ri))
+	  return BGP_PROCESS_WITHDRAW;
+	break;
+      }
+
+  if (bgp_process_prio_scope != BGP_PROCESS_CHANGE)
+    return bgp_process_prio_scope;
+
+  /* The peer's UPDATEs are part of its initial table until it sends
+     end-of-RIB, if it ever will. */
+  if (peer && CHECK_FLAG (peer->cap, PEER_CAP_RESTART_RCV)
+      && ! CHECK_FLAG (peer->af_sflags[afi][safi], PEER_STATUS_EOR_RECEIVED))
+    return BGP_PROCESS_BULK;
+
+  return BGP_PROCESS_CHANGE;
+}
+
+static void
+bgp_process_schedule (struct bgp *bgp, struct bgp_node *rn,
+		      afi_t afi, safi_t safi)
 {
   struct bgp_process_queue *pqnode;
+  enum bgp_process_prio prio;
   
   /* already scheduled for processing? */
   if (CHECK_FLAG (rn->flags, BGP_NODE_PROCESS_SCHEDULED))
@@ -1684,14 +2280,22 @@ bgp_process (struct bgp *bgp, struct bgp_node *rn, afi_t afi, safi_t safi)
   bgp_lock (bgp);
   pqnode->afi = afi;
   pqnode->safi = safi;
+  if (bgp_perf_peer)
+    {
+      pqnode->peer = peer_lock (bgp_perf_peer);
+      pqnode->queued = bgp_perf_now ();
+    }
   
+  prio = bgp_process_prio (rn, afi, safi);
+  QUAGGA_TRACE (bgpd, process_enqueue, &rn->p, afi, safi,
+		bgp_node_table (rn)->type, prio);
   switch (bgp_node_table (rn)->type)
     {
       case BGP_TABLE_MAIN:
-        work_queue_add (bm->process_main_queue, pqnode);
+        work_queue_add_prio (bm->process_main_queue, pqnode, prio);
         break;
       case BGP_TABLE_RSCLIENT:
-        work_queue_add (bm->process_rsclient_queue, pqnode);
+        work_queue_add_prio (bm->process_rsclient_queue, pqnode, prio);
         break;
     }
   
@@ -1699,47 +2303,206 @@ bgp_process (struct bgp *bgp, struct bgp_node *rn, afi_t afi, safi_t safi)
   return;
 }
 
+/* Schedule best path selection for the node after anything about it
+   changed. */
+void
+bgp_process (struct bgp *bgp, struct bgp_node *rn, afi_t afi, safi_t safi)
+{
+  SET_FLAG (rn->flags, BGP_NODE_SELECT_FULL);
+  bgp_process_schedule (bgp, rn, afi, safi);
+}
+
+/* Update-delay.  The process queues stay plugged while any instance
+   is starting up, so each node is queued once however many peers send
+   it, and selected once when the delay ends. */
+
+/* Has the peer sent its whole table?  Peers that cannot send End-of-RIB
+   are taken to have once they send a KEEPALIVE after their UPDATEs. */
 static int
-bgp_maximum_prefix_restart_timer (struct thread *thread)
+bgp_update_delay_peer_done (struct peer *peer)
+{
+  afi_t afi;
+  safi_t safi;
+
+  if (peer->status != Established)
+    return 0;
+
+  if (! CHECK_FLAG (peer->cap, PEER_CAP_RESTART_RCV))
+    return CHECK_FLAG (peer->sflags, PEER_STATUS_EOR_IMPLICIT) ? 1 : 0;
+
+  for (afi = AFI_IP; afi < AFI_MAX; afi++)
+    for (safi = SAFI_UNICAST; safi < SAFI_MAX; safi++)
+      if (peer->afc_nego[afi][safi] && safi != SAFI_MPLS_VPN
+	  && ! CHECK_FLAG (peer->af_sflags[afi][safi],
+			   PEER_STATUS_EOR_RECEIVED))
+	return 0;
+  return 1;
+}
+
+/* Let peers have the End-of-RIB held back by update-delay, now the
+   routes it held are announced. */
+static void
+bgp_update_delay_flush (void)
 {
+  struct listnode *node, *nnode, *pnode, *pnnode;
+  struct bgp *bgp;
   struct peer *peer;
 
-  peer = THREAD_ARG (thread);
-  peer->t_pmax_restart = NULL;
+  bgp_update_delay_flush_pending = 0;
 
-  if (BGP_DEBUG (events, EVENTS))
-    zlog_debug ("%s Maximum-prefix restart timer expired, restore peering",
-		peer->host);
+  for (ALL_LIST_ELEMENTS (bm->bgp, node, nnode, bgp))
+    for (ALL_LIST_ELEMENTS (bgp->peer, pnode, pnnode, peer))
+      if (peer->status == Established)
+	BGP_WRITE_ON (peer->t_write, bgp_write, peer->fd);
+}
 
-  peer_clear (peer);
+static void
+bgp_update_delay_over (struct bgp *bgp)
+{
+  /* The queues are gone once bgp_terminate() ran. */
+  if (--bm->update_delay_count || bm->process_main_queue == NULL)
+    return;
+
+  work_queue_unplug (bm->process_main_queue);
+  work_queue_unplug (bm->process_rsclient_queue);
+
+  bgp_update_delay_flush_pending = 1;
+  if (! work_queue_item_count (bm->process_main_queue)
+      && ! work_queue_item_count (bm->process_rsclient_queue))
+    bgp_update_delay_flush ();
+}
 
+static int
+bgp_update_delay_timer (struct thread *thread)
+{
+  struct bgp *bgp = THREAD_ARG (thread);
+
+  bgp->t_update_delay = NULL;
+  zlog_info ("BGP update-delay of %d seconds expired, selecting best paths",
+	     bgp->update_delay);
+  bgp_update_delay_over (bgp);
   return 0;
 }
 
-int
-bgp_maximum_prefix_overflow (struct peer *peer, afi_t afi, 
-                             safi_t safi, int always)
+/* Hold best path selection for the instance, if it is starting up, ie
+   none of its peers has been up yet. */
+void
+bgp_update_delay_begin (struct bgp *bgp)
 {
-  if (!CHECK_FLAG (peer->af_flags[afi][safi], PEER_FLAG_MAX_PREFIX))
-    return 0;
+  struct listnode *node, *nnode;
+  struct peer *peer;
 
-  if (peer->pcount[afi][safi] > peer->pmax[afi][safi])
-    {
-      if (CHECK_FLAG (peer->af_sflags[afi][safi], PEER_STATUS_PREFIX_LIMIT)
-         && ! always)
-       return 0;
+  if (BGP_UPDATE_DELAY_ACTIVE (bgp) || ! bgp->update_delay)
+    return;
 
-      zlog (peer->log, LOG_INFO,
-	    "%%MAXPFXEXCEED: No. of %s prefix received from %s %ld exceed, "
-	    "limit %ld", afi_safi_print (afi, safi), peer->host,
-	    peer->pcount[afi][safi], peer->pmax[afi][safi]);
-      SET_FLAG (peer->af_sflags[afi][safi], PEER_STATUS_PREFIX_LIMIT);
+  for (ALL_LIST_ELEMENTS (bgp->peer, node, nnode, peer))
+    if (peer->established)
+      return;
 
-      if (CHECK_FLAG (peer->af_flags[afi][safi], PEER_FLAG_MAX_PREFIX_WARNING))
-       return 0;
+  if ( (bm->process_main_queue == NULL) ||
+       (bm->process_rsclient_queue == NULL) )
+    bgp_process_queue_init ();
 
-      {
-       u_int8_t ndata[7];
+  if (bm->update_delay_count++ == 0)
+    {
+      work_queue_plug (bm->process_main_queue);
+      work_queue_plug (bm->process_rsclient_queue);
+    }
+
+  bgp->t_update_delay = thread_add_timer (bm->master, bgp_update_delay_timer,
+					  bgp, bgp->update_delay);
+}
+
+void
+bgp_update_delay_end (struct bgp *bgp)
+{
+  if (! BGP_UPDATE_DELAY_ACTIVE (bgp))
+    return;
+
+  BGP_TIMER_OFF (bgp->t_update_delay);
+  bgp_update_delay_over (bgp);
+}
+
+/* End update-delay once every peer that is not shut down has sent its
+   table. */
+void
+bgp_update_delay_check (struct bgp *bgp)
+{
+  struct listnode *node, *nnode;
+  struct peer *peer;
+
+  if (! BGP_UPDATE_DELAY_ACTIVE (bgp))
+    return;
+
+  for (ALL_LIST_ELEMENTS (bgp->peer, node, nnode, peer))
+    if (! CHECK_FLAG (peer->flags, PEER_FLAG_SHUTDOWN)
+	&& ! CHECK_FLAG (peer->sflags, PEER_STATUS_ACCEPT_PEER)
+	&& ! bgp_update_delay_peer_done (peer))
+      return;
+
+  zlog_info ("BGP update-delay over, every peer sent End-of-RIB");
+  bgp_update_delay_end (bgp);
+}
+
+/* Schedule best path selection for the node after only RI changed,
+   which lets it be compared with the current best alone. */
+static void
+bgp_process_info (struct bgp *bgp, struct bgp_node *rn, struct bgp_info *ri,
+		  afi_t afi, safi_t safi)
+{
+  if (! CHECK_FLAG (rn->flags, BGP_NODE_PROCESS_SCHEDULED))
+    {
+      UNSET_FLAG (rn->flags, BGP_NODE_SELECT_FULL);
+      rn->select_hint = ri;
+    }
+  else if (rn->select_hint != ri)
+    SET_FLAG (rn->flags, BGP_NODE_SELECT_FULL);
+
+  bgp_process_schedule (bgp, rn, afi, safi);
+}
+
+static int
+bgp_maximum_prefix_restart_timer (struct thread *thread)
+{
+  struct peer *peer;
+
+  peer = THREAD_ARG (thread);
+  peer->t_pmax_restart = NULL;
+
+  if (BGP_DEBUG (events, EVENTS))
+    zlog_debug ("%s Maximum-prefix restart timer expired, restore peering",
+		peer->host);
+
+  peer_clear (peer);
+
+  return 0;
+}
+
+int
+bgp_maximum_prefix_overflow (struct peer *peer, afi_t afi, 
+                             safi_t safi, int always)
+{
+  if (!CHECK_FLAG (peer->af_flags[afi][safi], PEER_FLAG_MAX_PREFIX))
+    return 0;
+
+  if (peer->pcount[afi][safi] > peer->pmax[afi][safi])
+    {
+      if (CHECK_FLAG (peer->af_sflags[afi][safi], PEER_STATUS_PREFIX_LIMIT)
+         && ! always)
+       return 0;
+
+      zlog (peer->log, LOG_INFO,
+	    "%%MAXPFXEXCEED: No. of %s prefix received from %s %ld exceed, "
+	    "limit %ld", afi_safi_print (afi, safi), peer->host,
+	    peer->pcount[afi][safi], peer->pmax[afi][safi]);
+      SET_FLAG (peer->af_sflags[afi][safi], PEER_STATUS_PREFIX_LIMIT);
+
+      if (CHECK_FLAG (peer->af_flags[afi][safi], PEER_FLAG_MAX_PREFIX_WARNING)
+	  || CHECK_FLAG (peer->af_flags[afi][safi], PEER_FLAG_MAX_PREFIX_DISCARD))
+       return 0;
+
+      {
+       u_int8_t ndata[7];
 
        if (safi == SAFI_MPLS_VPN)
          safi = SAFI_MPLS_LABELED_VPN;
@@ -1792,6 +2555,42 @@ bgp_maximum_prefix_overflow (struct peer *peer, afi_t afi,
   return 0;
 }
 
+/* With maximum-prefix discard-extra, whether to drop P from PEER before
+   anything is done for it: the limit is reached and the peer has no
+   path for P an update would replace. */
+static int
+bgp_maximum_prefix_discard (struct peer *peer, struct prefix *p,
+			    afi_t afi, safi_t safi)
+{
+  struct bgp_node *rn;
+  struct bgp_info *ri = NULL;
+
+  if (peer->pcount[afi][safi] < peer->pmax[afi][safi])
+    return 0;
+
+  rn = bgp_node_lookup (peer->bgp->rib[afi][safi], p);
+  if (rn)
+    {
+      for (ri = rn->info; ri; ri = ri->next)
+	if (ri->peer == peer && ! CHECK_FLAG (ri->flags, BGP_INFO_REMOVED))
+	  break;
+      bgp_unlock_node (rn);
+      if (ri)
+	return 0;
+    }
+
+  if (! CHECK_FLAG (peer->af_sflags[afi][safi], PEER_STATUS_PREFIX_LIMIT))
+    {
+      zlog (peer->log, LOG_INFO,
+	    "%%MAXPFXEXCEED: No. of %s prefix received from %s reached "
+	    "limit %ld, discarding new prefixes", afi_safi_print (afi, safi),
+	    peer->host, peer->pmax[afi][safi]);
+      SET_FLAG (peer->af_sflags[afi][safi], PEER_STATUS_PREFIX_LIMIT);
+    }
+  peer->pdiscard[afi][safi]++;
+  return 1;
+}
+
 /* Unconditionally remove the route from the RIB, without taking
  * damping into consideration (eg, because the session went down)
  */
@@ -1799,12 +2598,14 @@ static void
 bgp_rib_remove (struct bgp_node *rn, struct bgp_info *ri, struct peer *peer,
 		afi_t afi, safi_t safi)
 {
-  bgp_aggregate_decrement (peer->bgp, &rn->p, ri, afi, safi);
+  struct bgp *bgp = bgp_node_bgp (rn, peer);
+
+  bgp_aggregate_decrement (bgp, &rn->p, ri, afi, safi);
   
   if (!CHECK_FLAG (ri->flags, BGP_INFO_HISTORY))
     bgp_info_delete (rn, ri); /* keep historical info */
     
-  bgp_process (peer->bgp, rn, afi, safi);
+  bgp_process_info (bgp, rn, ri, afi, safi);
 }
 
 static void
@@ -1882,19 +2683,30 @@ bgp_update_rsclient (struct peer *rsclient, afi_t afi, safi_t safi,
       goto filtered;
     }
 
-  attr_new2 = bgp_attr_intern (&new_attr);
-  
-  /* Apply import policy. */
-  if (bgp_import_modifier (rsclient, peer, p, &new_attr, afi, safi) == RMAP_DENY)
+  /* Without an import route-map only the weight can change below, so
+     there is nothing of the export result to pin while it runs. */
+  if (! ROUTE_MAP_IMPORT_NAME (&rsclient->filter[afi][safi]))
     {
-      bgp_attr_unintern (&attr_new2);
-
-      reason = "import-policy;";
-      goto filtered;
+      bgp_import_modifier (rsclient, peer, p, &new_attr, afi, safi);
+      attr_new = bgp_attr_intern (&new_attr);
     }
+  else
+    {
+      attr_new2 = bgp_attr_intern (&new_attr);
 
-  attr_new = bgp_attr_intern (&new_attr);
-  bgp_attr_unintern (&attr_new2);
+      /* Apply import policy. */
+      if (bgp_import_modifier (rsclient, peer, p, &new_attr, afi, safi)
+          == RMAP_DENY)
+        {
+          bgp_attr_unintern (&attr_new2);
+
+          reason = "import-policy;";
+          goto filtered;
+        }
+
+      attr_new = bgp_attr_intern (&new_attr);
+      bgp_attr_unintern (&attr_new2);
+    }
 
   /* IPv4 unicast next hop check.  */
   if ((afi == AFI_IP) && ((safi == SAFI_UNICAST) || safi == SAFI_MULTICAST))
@@ -1952,6 +2764,8 @@ bgp_update_rsclient (struct peer *rsclient, afi_t afi, safi_t safi,
       /* Update to new attribute.  */
       bgp_attr_unintern (&ri->attr);
       ri->attr = attr_new;
+      if (safi == SAFI_UNICAST)
+        bgp_info_rpki_set (ri, p);
 
       /* Update MPLS tag.  */
       if (safi == SAFI_MPLS_VPN)
@@ -1982,6 +2796,8 @@ bgp_update_rsclient (struct peer *rsclient, afi_t afi, safi_t safi,
   new->peer = peer;
   new->attr = attr_new;
   new->uptime = bgp_clock ();
+  if (safi == SAFI_UNICAST)
+    bgp_info_rpki_set (new, p);
 
   /* Update MPLS tag. */
   if (safi == SAFI_MPLS_VPN)
@@ -2050,13 +2866,94 @@ bgp_withdraw_rsclient (struct peer *rsclient, afi_t afi, safi_t safi,
   bgp_unlock_node (rn);
 }
 
+/* The prefixes of one UPDATE share their attributes, so what
+   bgp_update_main() decides from the attributes alone is worked out
+   for the first prefix and reused for the rest, see bgp_nlri_parse(). */
+struct bgp_update_batch
+{
+  struct peer *peer;
+  struct attr *attr;
+  afi_t afi;
+  safi_t safi;
+
+  /* Outcome of bgp_update_attr_filter(), once checked. */
+  int checked;
+  const char *reason;
+
+  /* The interned attributes after inbound policy, when that does not
+     depend on the prefix, holding a reference. */
+  struct attr *attr_new;
+};
+
+static struct bgp_update_batch bgp_update_batch;
+static struct bgp_update_batch *bgp_update_batch_current;
+
+/* The checks on received attributes which do not depend on the
+   prefix.  Returns why the route is filtered, or NULL. */
+static const char *
+bgp_update_attr_filter (struct peer *peer, struct attr *attr,
+			afi_t afi, safi_t safi)
+{
+  struct bgp *bgp = peer->bgp;
+  int aspath_loop_count = 0;
+
+  /* AS path local-as loop check. */
+  if (peer->change_local_as)
+    {
+      if (! CHECK_FLAG (peer->flags, PEER_FLAG_LOCAL_AS_NO_PREPEND))
+	aspath_loop_count = 1;
+
+      if (aspath_loop_check (attr->aspath, peer->change_local_as) > aspath_loop_count) 
+	return "as-path contains our own AS;";
+    }
+
+  /* AS path loop check. */
+  if (aspath_loop_check (attr->aspath, bgp->as) > peer->allowas_in[afi][safi]
+      || (CHECK_FLAG(bgp->config, BGP_CONFIG_CONFEDERATION)
+	  && aspath_loop_check(attr->aspath, bgp->confed_id)
+	  > peer->allowas_in[afi][safi]))
+    return "as-path contains our own AS;";
+
+  /* Route reflector originator ID check.  */
+  if (attr->flag & ATTR_FLAG_BIT (BGP_ATTR_ORIGINATOR_ID)
+      && IPV4_ADDR_SAME (&bgp->router_id, &attr->extra->originator_id))
+    return "originator is us;";
+
+  /* Route reflector cluster ID check.  */
+  if (bgp_cluster_filter (peer, attr))
+    return "reflected from the same cluster;";
+
+  return NULL;
+}
+
+/* Mark a path received from PEER valid or not by its nexthop, as it
+   goes in. */
+static void
+bgp_info_nexthop_check (struct peer *peer, struct bgp_node *rn,
+			struct bgp_info *ri, afi_t afi, safi_t safi)
+{
+  if ((afi == AFI_IP || afi == AFI_IP6)
+      && safi == SAFI_UNICAST
+      && (peer->sort == BGP_PEER_IBGP
+          || peer->sort == BGP_PEER_CONFED
+	  || (peer->sort == BGP_PEER_EBGP && peer->ttl != 1)
+	  || CHECK_FLAG (peer->flags, PEER_FLAG_DISABLE_CONNECTED_CHECK)))
+    {
+      if (bgp_nexthop_lookup (afi, peer, ri, NULL, NULL))
+	bgp_info_set_flag (rn, ri, BGP_INFO_VALID);
+      else
+        bgp_info_unset_flag (rn, ri, BGP_INFO_VALID);
+    }
+  else
+    bgp_info_set_flag (rn, ri, BGP_INFO_VALID);
+}
+
 static int
 bgp_update_main (struct peer *peer, struct prefix *p, struct attr *attr,
 	    afi_t afi, safi_t safi, int type, int sub_type,
 	    struct prefix_rd *prd, u_char *tag, int soft_reconfig)
 {
   int ret;
-  int aspath_loop_count = 0;
   struct bgp_node *rn;
   struct bgp *bgp;
   struct attr new_attr;
@@ -2064,74 +2961,72 @@ bgp_update_main (struct peer *peer, struct prefix *p, struct attr *attr,
   struct attr *attr_new;
   struct bgp_info *ri;
   struct bgp_info *new;
+  struct bgp_update_batch *batch = bgp_update_batch_current;
   const char *reason;
   char buf[SU_ADDRSTRLEN];
+  int adj_in = 0;
+
+  if (batch && (soft_reconfig || batch->peer != peer || batch->attr != attr
+		|| batch->afi != afi || batch->safi != safi))
+    batch = NULL;
 
   bgp = peer->bgp;
   rn = bgp_afi_node_get (bgp->rib[afi][safi], afi, safi, p, prd);
   
   /* When peer's soft reconfiguration enabled.  Record input packet in
      Adj-RIBs-In.  */
-  if (! soft_reconfig && CHECK_FLAG (peer->af_flags[afi][safi], PEER_FLAG_SOFT_RECONFIG)
+  if (CHECK_FLAG (peer->af_flags[afi][safi], PEER_FLAG_SOFT_RECONFIG)
       && peer != bgp->peer_self)
-    bgp_adj_in_set (rn, peer, attr);
+    {
+      adj_in = 1;
+      bgp_adj_in_unshare (rn, peer);
+      if (! soft_reconfig)
+	bgp_adj_in_set (rn, peer, attr);
+    }
+
+  if (! soft_reconfig)
+    bgp_bmp_route (peer, p, attr, afi, safi, 0);
 
   /* Check previously received route. */
   for (ri = rn->info; ri; ri = ri->next)
     if (ri->peer == peer && ri->type == type && ri->sub_type == sub_type)
       break;
 
-  /* AS path local-as loop check. */
-  if (peer->change_local_as)
+  if (batch && batch->checked)
+    reason = batch->reason;
+  else
     {
-      if (! CHECK_FLAG (peer->flags, PEER_FLAG_LOCAL_AS_NO_PREPEND))
-	aspath_loop_count = 1;
-
-      if (aspath_loop_check (attr->aspath, peer->change_local_as) > aspath_loop_count) 
+      reason = bgp_update_attr_filter (peer, attr, afi, safi);
+      if (batch)
 	{
-	  reason = "as-path contains our own AS;";
-	  goto filtered;
+	  batch->checked = 1;
+	  batch->reason = reason;
 	}
     }
-
-  /* AS path loop check. */
-  if (aspath_loop_check (attr->aspath, bgp->as) > peer->allowas_in[afi][safi]
-      || (CHECK_FLAG(bgp->config, BGP_CONFIG_CONFEDERATION)
-	  && aspath_loop_check(attr->aspath, bgp->confed_id)
-	  > peer->allowas_in[afi][safi]))
-    {
-      reason = "as-path contains our own AS;";
-      goto filtered;
-    }
-
-  /* Route reflector originator ID check.  */
-  if (attr->flag & ATTR_FLAG_BIT (BGP_ATTR_ORIGINATOR_ID)
-      && IPV4_ADDR_SAME (&bgp->router_id, &attr->extra->originator_id))
-    {
-      reason = "originator is us;";
-      goto filtered;
-    }
-
-  /* Route reflector cluster ID check.  */
-  if (bgp_cluster_filter (peer, attr))
-    {
-      reason = "reflected from the same cluster;";
-      goto  filtered;
-    }
+  if (reason)
+    goto filtered;
 
   /* Apply incoming filter.  */
   if (bgp_input_filter (peer, p, attr, afi, safi) == FILTER_DENY)
     {
+      peer->policy_rejected++;
       reason = "filter;";
       goto filtered;
     }
 
+  if (batch && batch->attr_new)
+    {
+      attr_new = bgp_attr_ref (batch->attr_new);
+      goto interned;
+    }
+
   new_attr.extra = &new_extra;
   bgp_attr_dup (&new_attr, attr);
 
   /* Apply incoming route-map. */
   if (bgp_input_modifier (peer, p, &new_attr, afi, safi) == RMAP_DENY)
     {
+      peer->policy_rejected++;
       reason = "route-map;";
       goto filtered;
     }
@@ -2162,6 +3057,11 @@ bgp_update_main (struct peer *peer, struct prefix *p, struct attr *attr,
 
   attr_new = bgp_attr_intern (&new_attr);
 
+  /* Without an inbound route-map, the prefix played no part. */
+  if (batch && ! ROUTE_MAP_IN_NAME (&peer->filter[afi][safi]))
+    batch->attr_new = bgp_attr_ref (attr_new);
+
+ interned:
   /* If the update is implicit withdraw. */
   if (ri)
     {
@@ -2173,6 +3073,9 @@ bgp_update_main (struct peer *peer, struct prefix *p, struct attr *attr,
 	{
 	  bgp_info_unset_flag (rn, ri, BGP_INFO_ATTR_CHANGED);
 
+	  if (adj_in)
+	    bgp_adj_in_share (rn, ri);
+
 	  if (CHECK_FLAG (bgp->af_flags[afi][safi], BGP_CONFIG_DAMPENING)
 	      && peer->sort == BGP_PEER_EBGP
 	      && CHECK_FLAG (ri->flags, BGP_INFO_HISTORY))
@@ -2255,6 +3158,13 @@ bgp_update_main (struct peer *peer, struct prefix *p, struct attr *attr,
       /* Update to new attribute.  */
       bgp_attr_unintern (&ri->attr);
       ri->attr = attr_new;
+      if (safi == SAFI_UNICAST)
+        bgp_info_rpki_set (ri, p);
+
+      if (adj_in)
+	bgp_adj_in_share (rn, ri);
+
+      bgp_bmp_route (peer, p, attr_new, afi, safi, 1);
 
       /* Update MPLS tag.  */
       if (safi == SAFI_MPLS_VPN)
@@ -2274,25 +3184,12 @@ bgp_update_main (struct peer *peer, struct prefix *p, struct attr *attr,
 	}
 
       /* Nexthop reachability check. */
-      if ((afi == AFI_IP || afi == AFI_IP6)
-	  && safi == SAFI_UNICAST 
-	  && (peer->sort == BGP_PEER_IBGP
-              || peer->sort == BGP_PEER_CONFED
-	      || (peer->sort == BGP_PEER_EBGP && peer->ttl != 1)
-	      || CHECK_FLAG (peer->flags, PEER_FLAG_DISABLE_CONNECTED_CHECK)))
-	{
-	  if (bgp_nexthop_lookup (afi, peer, ri, NULL, NULL))
-	    bgp_info_set_flag (rn, ri, BGP_INFO_VALID);
-	  else
-	    bgp_info_unset_flag (rn, ri, BGP_INFO_VALID);
-	}
-      else
-        bgp_info_set_flag (rn, ri, BGP_INFO_VALID);
+      bgp_info_nexthop_check (peer, rn, ri, afi, safi);
 
       /* Process change. */
       bgp_aggregate_increment (bgp, p, ri, afi, safi);
 
-      bgp_process (bgp, rn, afi, safi);
+      bgp_process_info (bgp, rn, ri, afi, safi);
       bgp_unlock_node (rn);
 
       return 0;
@@ -2314,32 +3211,26 @@ bgp_update_main (struct peer *peer, struct prefix *p, struct attr *attr,
   new->peer = peer;
   new->attr = attr_new;
   new->uptime = bgp_clock ();
+  if (safi == SAFI_UNICAST)
+    bgp_info_rpki_set (new, p);
 
   /* Update MPLS tag. */
   if (safi == SAFI_MPLS_VPN)
     memcpy ((bgp_info_extra_get (new))->tag, tag, 3);
 
   /* Nexthop reachability check. */
-  if ((afi == AFI_IP || afi == AFI_IP6)
-      && safi == SAFI_UNICAST
-      && (peer->sort == BGP_PEER_IBGP
-          || peer->sort == BGP_PEER_CONFED
-	  || (peer->sort == BGP_PEER_EBGP && peer->ttl != 1)
-	  || CHECK_FLAG (peer->flags, PEER_FLAG_DISABLE_CONNECTED_CHECK)))
-    {
-      if (bgp_nexthop_lookup (afi, peer, new, NULL, NULL))
-	bgp_info_set_flag (rn, new, BGP_INFO_VALID);
-      else
-        bgp_info_unset_flag (rn, new, BGP_INFO_VALID);
-    }
-  else
-    bgp_info_set_flag (rn, new, BGP_INFO_VALID);
+  bgp_info_nexthop_check (peer, rn, new, afi, safi);
 
   /* Increment prefix */
   bgp_aggregate_increment (bgp, p, new, afi, safi);
   
   /* Register new BGP information. */
   bgp_info_add (rn, new);
+
+  if (adj_in)
+    bgp_adj_in_share (rn, new);
+
+  bgp_bmp_route (peer, p, attr_new, afi, safi, 1);
   
   /* route_node_get lock */
   bgp_unlock_node (rn);
@@ -2350,7 +3241,7 @@ bgp_update_main (struct peer *peer, struct prefix *p, struct attr *attr,
     return -1;
 
   /* Process change. */
-  bgp_process (bgp, rn, afi, safi);
+  bgp_process_info (bgp, rn, new, afi, safi);
 
   return 0;
 
@@ -2365,41 +3256,213 @@ bgp_update_main (struct peer *peer, struct prefix *p, struct attr *attr,
 	  p->prefixlen, reason);
 
   if (ri)
-    bgp_rib_remove (rn, ri, peer, afi, safi);
+    {
+      if (! CHECK_FLAG (ri->flags, BGP_INFO_REMOVED))
+        bgp_bmp_route (peer, p, NULL, afi, safi, 1);
+      bgp_rib_remove (rn, ri, peer, afi, safi);
+    }
 
   bgp_unlock_node (rn);
 
   return 0;
 }
 
-int
-bgp_update (struct peer *peer, struct prefix *p, struct attr *attr,
-            afi_t afi, safi_t safi, int type, int sub_type,
-            struct prefix_rd *prd, u_char *tag, int soft_reconfig)
+/* The path of PEER for the prefix of RN, as received. */
+static struct bgp_info *
+bgp_rib_in_view_lookup (struct bgp_node *rn, struct peer *peer)
 {
-  struct peer *rsclient;
-  struct listnode *node, *nnode;
-  struct bgp *bgp;
-  int ret;
+  struct bgp_info *ri;
 
-  ret = bgp_update_main (peer, p, attr, afi, safi, type, sub_type, prd, tag,
-          soft_reconfig);
+  for (ri = rn->info; ri; ri = ri->next)
+    if (ri->peer == peer && ri->type == ZEBRA_ROUTE_BGP
+	&& ri->sub_type == BGP_ROUTE_NORMAL)
+      break;
+  return ri;
+}
 
-  bgp = peer->bgp;
+/* Bring the path of PEER for P in the RIB of VIEW, an instance taking
+   its received routes from PEER's, in line with SRC, the path of PEER
+   in the RIB of its own instance, or NULL.  The path shares the
+   interned attributes of SRC.  Dampening is left to PEER's instance:
+   only what it withdrew is taken out. */
+static void
+bgp_rib_in_view_path (struct bgp *view, struct prefix *p,
+		      struct bgp_info *src, struct peer *peer,
+		      afi_t afi, safi_t safi)
+{
+  struct bgp_node *rn;
+  struct bgp_info *ri;
 
-  /* Process the update for each RS-client. */
-  for (ALL_LIST_ELEMENTS (bgp->rsclient, node, nnode, rsclient))
+  if (! src || CHECK_FLAG (src->flags, BGP_INFO_REMOVED|BGP_INFO_HISTORY))
     {
-      if (CHECK_FLAG (rsclient->af_flags[afi][safi], PEER_FLAG_RSERVER_CLIENT))
-        bgp_update_rsclient (rsclient, afi, safi, attr, peer, p, type,
-                sub_type, prd, tag);
+      if ((rn = bgp_node_lookup (view->rib[afi][safi], p)) == NULL)
+	return;
+      ri = bgp_rib_in_view_lookup (rn, peer);
+      if (ri && ! CHECK_FLAG (ri->flags, BGP_INFO_REMOVED))
+	bgp_rib_remove (rn, ri, peer, afi, safi);
+      bgp_unlock_node (rn);
+      return;
     }
 
-  return ret;
-}
+  rn = bgp_node_get (view->rib[afi][safi], p);
+  ri = bgp_rib_in_view_lookup (rn, peer);
 
-int
-bgp_withdraw (struct peer *peer, struct prefix *p, struct attr *attr, 
+  if (ri)
+    {
+      if (! CHECK_FLAG (ri->flags, BGP_INFO_REMOVED)
+	  && ri->attr == src->attr
+	  && CHECK_FLAG (ri->flags, BGP_INFO_STALE)
+	     == CHECK_FLAG (src->flags, BGP_INFO_STALE))
+	{
+	  bgp_unlock_node (rn);
+	  return;
+	}
+
+      if (CHECK_FLAG (ri->flags, BGP_INFO_REMOVED))
+	bgp_info_restore (rn, ri);
+      else
+	bgp_aggregate_decrement (view, p, ri, afi, safi);
+
+      if (ri->attr != src->attr)
+	{
+	  bgp_info_set_flag (rn, ri, BGP_INFO_ATTR_CHANGED);
+	  bgp_attr_unintern (&ri->attr);
+	  ri->attr = bgp_attr_ref (src->attr);
+	}
+      ri->uptime = bgp_clock ();
+    }
+  else
+    {
+      ri = bgp_info_new ();
+      ri->type = ZEBRA_ROUTE_BGP;
+      ri->sub_type = BGP_ROUTE_NORMAL;
+      ri->peer = peer;
+      ri->attr = bgp_attr_ref (src->attr);
+      ri->uptime = bgp_clock ();
+      bgp_info_add (rn, ri);
+    }
+
+  if (CHECK_FLAG (src->flags, BGP_INFO_STALE))
+    bgp_info_set_flag (rn, ri, BGP_INFO_STALE);
+  else
+    bgp_info_unset_flag (rn, ri, BGP_INFO_STALE);
+  if (safi == SAFI_UNICAST)
+    bgp_info_rpki_set (ri, p);
+  bgp_info_nexthop_check (peer, rn, ri, afi, safi);
+
+  bgp_aggregate_increment (view, p, ri, afi, safi);
+  bgp_process_info (view, rn, ri, afi, safi);
+  bgp_unlock_node (rn);
+}
+
+/* Pass what PEER's instance now has of the route PEER sent for P on
+   to the instances taking their received routes from it. */
+static void
+bgp_rib_in_view_sync (struct peer *peer, struct prefix *p,
+		      afi_t afi, safi_t safi, int type, int sub_type)
+{
+  struct bgp *bgp = peer->bgp;
+  struct bgp *view;
+  struct bgp_node *rn;
+  struct bgp_info *src = NULL;
+  struct listnode *node;
+
+  if (! bgp->rib_in_views || peer == bgp->peer_self
+      || type != ZEBRA_ROUTE_BGP || sub_type != BGP_ROUTE_NORMAL
+      || safi == SAFI_MPLS_VPN)
+    return;
+
+  if ((rn = bgp_node_lookup (bgp->rib[afi][safi], p)) != NULL)
+    src = bgp_rib_in_view_lookup (rn, peer);
+
+  for (ALL_LIST_ELEMENTS_RO (bm->bgp, node, view))
+    if (view->rib_in_view == bgp)
+      bgp_rib_in_view_path (view, p, src, peer, afi, safi);
+
+  if (rn)
+    bgp_unlock_node (rn);
+}
+
+/* Take into the RIB of BGP what the peers of the view it takes its
+   received routes from have there now. */
+void
+bgp_rib_in_view_fill (struct bgp *bgp)
+{
+  struct bgp *from = bgp->rib_in_view;
+  struct bgp_node *rn;
+  struct bgp_info *ri;
+  afi_t afi;
+  safi_t safi;
+
+  for (afi = AFI_IP; afi < AFI_MAX; afi++)
+    for (safi = SAFI_UNICAST; safi < SAFI_MAX; safi++)
+      {
+	if (safi == SAFI_MPLS_VPN)
+	  continue;
+	for (rn = bgp_table_top (from->rib[afi][safi]); rn;
+	     rn = bgp_route_next (rn))
+	  for (ri = rn->info; ri; ri = ri->next)
+	    if (ri->peer != from->peer_self
+		&& ri->type == ZEBRA_ROUTE_BGP
+		&& ri->sub_type == BGP_ROUTE_NORMAL)
+	      bgp_rib_in_view_path (bgp, &rn->p, ri, ri->peer, afi, safi);
+      }
+}
+
+/* Take the paths of the peers of other instances out of the RIB of
+   BGP. */
+void
+bgp_rib_in_view_flush (struct bgp *bgp)
+{
+  struct bgp_node *rn;
+  struct bgp_info *ri;
+  afi_t afi;
+  safi_t safi;
+
+  for (afi = AFI_IP; afi < AFI_MAX; afi++)
+    for (safi = SAFI_UNICAST; safi < SAFI_MAX; safi++)
+      {
+	if (safi == SAFI_MPLS_VPN)
+	  continue;
+	for (rn = bgp_table_top (bgp->rib[afi][safi]); rn;
+	     rn = bgp_route_next (rn))
+	  for (ri = rn->info; ri; ri = ri->next)
+	    if (ri->peer->bgp != bgp
+		&& ! CHECK_FLAG (ri->flags, BGP_INFO_REMOVED))
+	      bgp_rib_remove (rn, ri, ri->peer, afi, safi);
+      }
+}
+
+int
+bgp_update (struct peer *peer, struct prefix *p, struct attr *attr,
+            afi_t afi, safi_t safi, int type, int sub_type,
+            struct prefix_rd *prd, u_char *tag, int soft_reconfig)
+{
+  struct peer *rsclient;
+  struct listnode *node, *nnode;
+  struct bgp *bgp;
+  int ret;
+
+  ret = bgp_update_main (peer, p, attr, afi, safi, type, sub_type, prd, tag,
+          soft_reconfig);
+
+  bgp = peer->bgp;
+
+  bgp_rib_in_view_sync (peer, p, afi, safi, type, sub_type);
+
+  /* Process the update for each RS-client. */
+  for (ALL_LIST_ELEMENTS (bgp->rsclient, node, nnode, rsclient))
+    {
+      if (CHECK_FLAG (rsclient->af_flags[afi][safi], PEER_FLAG_RSERVER_CLIENT))
+        bgp_update_rsclient (rsclient, afi, safi, attr, peer, p, type,
+                sub_type, prd, tag);
+    }
+
+  return ret;
+}
+
+int
+bgp_withdraw (struct peer *peer, struct prefix *p, struct attr *attr, 
 	     afi_t afi, safi_t safi, int type, int sub_type, 
 	     struct prefix_rd *prd, u_char *tag)
 {
@@ -2435,6 +3498,8 @@ bgp_withdraw (struct peer *peer, struct prefix *p, struct attr *attr,
       && peer != bgp->peer_self)
     bgp_adj_in_unset (rn, peer);
 
+  bgp_bmp_route (peer, p, NULL, afi, safi, 0);
+
   /* Lookup withdrawn route. */
   for (ri = rn->info; ri; ri = ri->next)
     if (ri->peer == peer && ri->type == type && ri->sub_type == sub_type)
@@ -2442,13 +3507,19 @@ bgp_withdraw (struct peer *peer, struct prefix *p, struct attr *attr,
 
   /* Withdraw specified route from routing table. */
   if (ri && ! CHECK_FLAG (ri->flags, BGP_INFO_HISTORY))
-    bgp_rib_withdraw (rn, ri, peer, afi, safi);
+    {
+      if (! CHECK_FLAG (ri->flags, BGP_INFO_REMOVED))
+        bgp_bmp_route (peer, p, NULL, afi, safi, 1);
+      bgp_rib_withdraw (rn, ri, peer, afi, safi);
+    }
   else if (BGP_DEBUG (update, UPDATE_IN))
     zlog (peer->log, LOG_DEBUG, 
 	  "%s Can't find the route %s/%d", peer->host,
 	  inet_ntop (p->family, &p->u.prefix, buf, SU_ADDRSTRLEN),
 	  p->prefixlen);
 
+  bgp_rib_in_view_sync (peer, p, afi, safi, type, sub_type);
+
   /* Unlock bgp_node_get() lock. */
   bgp_unlock_node (rn);
 
@@ -2558,15 +3629,530 @@ bgp_default_originate (struct peer *peer, afi_t afi, safi_t safi, int withdraw)
   aspath_unintern (&aspath);
 }
 
+/* Version of all that outbound policy is made of.  Both parts only go
+   up, so their sum changes whenever either does. */
+static unsigned long
+bgp_policy_version (void)
+{
+  return bm->policy_version + route_map_version ();
+}
+
+/* Announce walks of a batch to members of the same peer-group are
+   likely to make the same of every route.  What bgp_announce_check_conf()
+   makes of a route depends on no more of the peer than this, as long as
+   bgp_announce_key_make() says so. */
+struct bgp_announce_key
+{
+  struct peer_group *group;
+  bgp_peer_sort_t sort;
+  as_t as;
+  u_int32_t af_flags;
+  struct in_addr nexthop;
+#ifdef HAVE_IPV6
+  struct in6_addr nexthop_global;
+  struct in6_addr nexthop_local;
+  int shared_network;
+#endif /* HAVE_IPV6 */
+};
+
+static int
+bgp_announce_key_make (struct peer *peer, afi_t afi, safi_t safi,
+                       struct bgp_announce_key *key)
+{
+  struct bgp_filter *filter = &peer->filter[afi][safi];
+
+  /* Outbound filters of members are those of the group.  The ORF of
+     each peer is its own, and so is the network EBGP next hops are
+     checked against, unless next-hop-self. */
+  if (! peer->group || ! peer->af_group[afi][safi]
+      || PEER_ADDPATH_TX (peer, afi, safi)
+      || peer->orf_plist[afi][safi]
+      || (peer->sort == BGP_PEER_EBGP
+          && ! CHECK_FLAG (peer->af_flags[afi][safi], PEER_FLAG_NEXTHOP_SELF))
+      || ! bgp_route_map_peer_independent (ROUTE_MAP_OUT (filter))
+      || ! bgp_route_map_peer_independent (UNSUPPRESS_MAP (filter))
+      || BGP_DEBUG (filter, FILTER))
+    return 0;
+
+  memset (key, 0, sizeof (struct bgp_announce_key));
+  key->group = peer->group;
+  key->sort = peer->sort;
+  key->as = peer->as;
+  key->af_flags = peer->af_flags[afi][safi];
+  key->nexthop = peer->nexthop.v4;
+#ifdef HAVE_IPV6
+  key->nexthop_global = peer->nexthop.v6_global;
+  key->nexthop_local = peer->nexthop.v6_local;
+  key->shared_network = peer->shared_network;
+#endif /* HAVE_IPV6 */
+  return 1;
+}
+
+/* Walks over a whole table on behalf of a peer.  On big tables they take
+   long, so they are done a piece at a time, bm->walk_budget msecs at a
+   go, to let keepalives and updates through meanwhile.  The table may
+   change in between: nodes already visited are kept up to date by
+   bgp_process() as usual, and the rest are seen as the walk gets
+   there. */
+struct bgp_walk
+{
+  struct peer *peer;
+  afi_t afi;
+  safi_t safi;
+  int type;
+#define BGP_WALK_CLEAR                  BGP_WALK_PEER_MAX
+
+  struct bgp_table *table;
+  bgp_table_iter_t iter;
+
+  /* For BGP_WALK_CLEAR, see bgp_clear_route_table(). */
+  enum bgp_clear_route_type purpose;
+
+  struct thread *t_walk;
+
+  /* Announce walks go with the batch of their table instead, and have
+     no iterator or thread of their own running.  A walk that joined
+     the batch part way through still needs the nodes up to stop, and
+     gets them after the batch has wrapped around. */
+  struct bgp_walk_batch *batch;
+  struct prefix stop;
+  u_char has_stop;
+  u_char wrapped;
+
+  /* An announce walk of a batch with a key takes what
+     bgp_announce_check_conf() makes of a node from its leader, an
+     earlier walk of the batch with the same key, or leads and keeps it
+     for the others, see bgp_walk_batch_share(). */
+  u_char shared;
+  struct bgp_announce_key key;
+  struct bgp_walk *leader;
+  struct bgp_node *share_rn;
+  struct bgp_info *share_ri;
+  struct attr *share_attr;	/* interned, NULL if denied */
+};
+
+/* All announce walks of the same type over a table, when peers come up
+   together.  The table is gone through once for all of them, a node
+   being announced to each peer in turn. */
+struct bgp_walk_batch
+{
+  struct bgp_table *table;
+  int type;
+  bgp_table_iter_t iter;
+
+  /* The walks along. */
+  struct list *walks;
+
+  /* The node last gone through in this pass, if any. */
+  struct prefix last;
+  int visited;
+
+  /* bgp_policy_version() when the leaders were picked, 0 to pick them
+     again. */
+  unsigned long share_version;
+
+  struct thread *t_walk;
+};
+
+static struct list *bgp_walk_batches;
+
+/* Check the walk's clock every so many nodes. */
+#define BGP_WALK_CHECK_NODES            16
+
+static int bgp_walk_node (struct bgp_walk *, struct bgp_node *);
+
+static struct bgp_walk *
+bgp_walk_new (struct peer *peer, afi_t afi, safi_t safi, int type,
+              struct bgp_table *table)
+{
+  struct bgp_walk *walk;
+
+  walk = XCALLOC (MTYPE_BGP_WALK, sizeof (struct bgp_walk));
+  walk->peer = peer_lock (peer); /* bgp_walk_free */
+  walk->afi = afi;
+  walk->safi = safi;
+  walk->type = type;
+  walk->table = table;
+  bgp_table_lock (table);
+  bgp_table_iter_init (&walk->iter, table);
+
+  return walk;
+}
+
 static void
-bgp_announce_table (struct peer *peer, afi_t afi, safi_t safi,
-                   struct bgp_table *table, int rsclient)
+bgp_walk_free (struct bgp_walk *walk)
+{
+  struct peer *peer = walk->peer;
+
+  THREAD_OFF (walk->t_walk);
+  bgp_table_iter_cleanup (&walk->iter);
+  bgp_table_unlock (walk->table);
+
+  if (walk->type < BGP_WALK_PEER_MAX
+      && peer->walk[walk->afi][walk->safi][walk->type] == walk)
+    peer->walk[walk->afi][walk->safi][walk->type] = NULL;
+
+  if (walk->share_attr)
+    bgp_attr_unintern (&walk->share_attr);
+
+  /* An empty batch goes away as it next runs.  Its walks led by this
+     one go on by themselves until leaders are picked again. */
+  if (walk->batch)
+    {
+      struct listnode *node;
+      struct bgp_walk *other;
+
+      listnode_delete (walk->batch->walks, walk);
+      for (ALL_LIST_ELEMENTS_RO (walk->batch->walks, node, other))
+        if (other->leader == walk)
+          other->leader = NULL;
+      walk->batch->share_version = 0;
+    }
+
+  XFREE (MTYPE_BGP_WALK, walk);
+  peer_unlock (peer); /* bgp_walk_new */
+}
+
+/* Whether what the walk is for still makes sense. */
+static int
+bgp_walk_valid (struct bgp_walk *walk)
+{
+  struct peer *peer = walk->peer;
+  afi_t afi = walk->afi;
+  safi_t safi = walk->safi;
+
+  switch (walk->type)
+    {
+    case BGP_WALK_ANNOUNCE:
+    case BGP_WALK_SOFT_IN:
+      return peer->status == Established;
+
+    case BGP_WALK_ANNOUNCE_RSCLIENT:
+      return peer->status == Established
+             && walk->table == peer->rib[afi][safi];
+
+    case BGP_WALK_SOFT_IN_RSCLIENT:
+      return peer->status != Deleted
+             && CHECK_FLAG (peer->af_flags[afi][safi],
+                            PEER_FLAG_RSERVER_CLIENT)
+             && peer->rib[afi][safi];
+
+    default:
+      return 1;
+    }
+}
+
+/* Walk on until done or out of time.  Returns 1 once the walk is
+   over. */
+static int
+bgp_walk_step (struct bgp_walk *walk)
+{
+  struct bgp_node *rn;
+  struct timeval start, now;
+  unsigned long budget;
+  unsigned int nodes = 0;
+
+  if (! bgp_walk_valid (walk))
+    return 1;
+
+  budget = bm->walk_budget * 1000;
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &start);
+
+  while ((rn = bgp_table_iter_next (&walk->iter)) != NULL)
+    {
+      if (bgp_walk_node (walk, rn) < 0)
+        return 1;
+
+      if (++nodes % BGP_WALK_CHECK_NODES)
+        continue;
+
+      quagga_gettime (QUAGGA_CLK_MONOTONIC, &now);
+      if ((now.tv_sec - start.tv_sec) * 1000000L
+          + (now.tv_usec - start.tv_usec) > (long) budget)
+        {
+          bgp_table_iter_pause (&walk->iter);
+          return 0;
+        }
+    }
+
+  return 1;
+}
+
+static int
+bgp_walk_timer (struct thread *thread)
+{
+  struct bgp_walk *walk = THREAD_ARG (thread);
+
+  walk->t_walk = NULL;
+
+  if (bgp_walk_step (walk))
+    bgp_walk_free (walk);
+  else
+    walk->t_walk = thread_add_event (bm->master, bgp_walk_timer, walk, 0);
+
+  return 0;
+}
+
+static void
+bgp_walk_batch_free (struct bgp_walk_batch *batch)
+{
+  struct bgp_walk *walk;
+
+  while (listcount (batch->walks))
+    {
+      walk = listgetdata (listhead (batch->walks));
+      bgp_walk_free (walk);
+    }
+
+  THREAD_OFF (batch->t_walk);
+  listnode_delete (bgp_walk_batches, batch);
+  list_delete (batch->walks);
+  bgp_table_iter_cleanup (&batch->iter);
+  bgp_table_unlock (batch->table);
+  XFREE (MTYPE_BGP_WALK_BATCH, batch);
+}
+
+/* Pick the leader of each announce walk of the batch that has a key:
+   the first walk of the batch with the same key. */
+static void
+bgp_walk_batch_share (struct bgp_walk_batch *batch)
+{
+  struct listnode *node, *lnode;
+  struct bgp_walk *walk, *leader;
+  unsigned int leaders = 0, shared = 0;
+
+  for (ALL_LIST_ELEMENTS_RO (batch->walks, node, walk))
+    {
+      walk->leader = NULL;
+      walk->shared = (walk->type == BGP_WALK_ANNOUNCE
+                      && bgp_announce_key_make (walk->peer, walk->afi,
+                                                walk->safi, &walk->key));
+      if (! walk->shared)
+        continue;
+
+      for (ALL_LIST_ELEMENTS_RO (batch->walks, lnode, leader))
+        {
+          if (leader == walk)
+            break;
+          if (leader->shared && ! leader->leader
+              && ! memcmp (&leader->key, &walk->key,
+                           sizeof (struct bgp_announce_key)))
+            {
+              walk->leader = leader;
+              shared++;
+              break;
+            }
+        }
+      if (! walk->leader)
+        leaders++;
+    }
+
+  batch->share_version = bgp_policy_version ();
+
+  if (BGP_DEBUG (events, EVENTS) && shared)
+    zlog_debug ("table announce to %u peer(s) shared from %u",
+                shared + leaders, leaders);
+}
+
+/* Go through the next nodes for every walk of the batch.  Returns 1
+   once no walk is left. */
+static int
+bgp_walk_batch_step (struct bgp_walk_batch *batch)
 {
   struct bgp_node *rn;
+  struct bgp_walk *walk;
+  struct listnode *node, *nnode;
+  struct timeval start, now;
+  unsigned long budget;
+  unsigned int nodes = 0;
+
+  if (batch->share_version != bgp_policy_version ())
+    bgp_walk_batch_share (batch);
+
+  budget = bm->walk_budget * 1000;
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &start);
+
+  while ((rn = bgp_table_iter_next (&batch->iter)) != NULL)
+    {
+      for (ALL_LIST_ELEMENTS (batch->walks, node, nnode, walk))
+        {
+          if (! bgp_walk_valid (walk)
+              || (walk->wrapped
+                  && route_table_prefix_iter_cmp (&rn->p, &walk->stop) > 0))
+            bgp_walk_free (walk);
+          else
+            bgp_walk_node (walk, rn);
+        }
+
+      if (list_isempty (batch->walks))
+        return 1;
+
+      prefix_copy (&batch->last, &rn->p);
+      batch->visited = 1;
+
+      if (++nodes % BGP_WALK_CHECK_NODES)
+        continue;
+
+      quagga_gettime (QUAGGA_CLK_MONOTONIC, &now);
+      if ((now.tv_sec - start.tv_sec) * 1000000L
+          + (now.tv_usec - start.tv_usec) > (long) budget)
+        {
+          bgp_table_iter_pause (&batch->iter);
+          return 0;
+        }
+    }
+
+  /* End of the table: those which came along from the top are done,
+     the others go round again for what they missed. */
+  for (ALL_LIST_ELEMENTS (batch->walks, node, nnode, walk))
+    {
+      if (! walk->has_stop || walk->wrapped)
+        bgp_walk_free (walk);
+      else
+        walk->wrapped = 1;
+    }
+
+  if (list_isempty (batch->walks))
+    return 1;
+
+  bgp_table_iter_cleanup (&batch->iter);
+  bgp_table_iter_init (&batch->iter, batch->table);
+  batch->visited = 0;
+  return 0;
+}
+
+static int
+bgp_walk_batch_timer (struct thread *thread)
+{
+  struct bgp_walk_batch *batch = THREAD_ARG (thread);
+
+  batch->t_walk = NULL;
+
+  if (list_isempty (batch->walks) || bgp_walk_batch_step (batch))
+    bgp_walk_batch_free (batch);
+  else
+    batch->t_walk = thread_add_event (bm->master, bgp_walk_batch_timer,
+                                      batch, 0);
+
+  return 0;
+}
+
+/* Put the walk into the batch going through its table, starting one if
+   there is none. */
+static void
+bgp_walk_batch_join (struct bgp_walk *walk)
+{
+  struct bgp_walk_batch *batch;
+  struct listnode *node;
+
+  if (! bgp_walk_batches)
+    bgp_walk_batches = list_new ();
+
+  for (ALL_LIST_ELEMENTS_RO (bgp_walk_batches, node, batch))
+    if (batch->table == walk->table && batch->type == walk->type)
+      break;
+
+  if (! batch)
+    {
+      batch = XCALLOC (MTYPE_BGP_WALK_BATCH, sizeof (struct bgp_walk_batch));
+      batch->table = walk->table;
+      bgp_table_lock (batch->table);
+      batch->type = walk->type;
+      bgp_table_iter_init (&batch->iter, batch->table);
+      batch->walks = list_new ();
+      listnode_add (bgp_walk_batches, batch);
+      batch->t_walk = thread_add_event (bm->master, bgp_walk_batch_timer,
+                                        batch, 0);
+    }
+
+  walk->batch = batch;
+  batch->share_version = 0;
+  if (batch->visited)
+    {
+      prefix_copy (&walk->stop, &batch->last);
+      walk->has_stop = 1;
+    }
+  listnode_add (batch->walks, walk);
+
+  if (BGP_DEBUG (events, EVENTS))
+    zlog_debug ("%s table announce %s, along with %u other peer(s)",
+                walk->peer->host, walk->has_stop ? "joined" : "started",
+                listcount (batch->walks) - 1);
+}
+
+/* Start walking the table for the peer, starting over if a walk of the
+   same type is under way already. */
+static void
+bgp_walk_start (struct peer *peer, afi_t afi, safi_t safi, int type,
+                struct bgp_table *table)
+{
+  struct bgp_walk *walk;
+
+  if (! table)
+    return;
+
+  if (peer->walk[afi][safi][type])
+    bgp_walk_free (peer->walk[afi][safi][type]);
+
+  walk = bgp_walk_new (peer, afi, safi, type, table);
+  peer->walk[afi][safi][type] = walk;
+
+  if (type == BGP_WALK_ANNOUNCE || type == BGP_WALK_ANNOUNCE_RSCLIENT)
+    bgp_walk_batch_join (walk);
+  else
+    walk->t_walk = thread_add_event (bm->master, bgp_walk_timer, walk, 0);
+}
+
+/* Is the full table still being announced to the peer? */
+int
+bgp_announce_pending (struct peer *peer, afi_t afi, safi_t safi)
+{
+  return peer->walk[afi][safi][BGP_WALK_ANNOUNCE] != NULL
+         || peer->walk[afi][safi][BGP_WALK_ANNOUNCE_RSCLIENT] != NULL;
+}
+
+static void
+bgp_announce_node (struct peer *peer, afi_t afi, safi_t safi,
+                   struct bgp_node *rn, int rsclient)
+{
   struct bgp_info *ri;
   struct attr attr;
   struct attr_extra extra;
 
+  if (PEER_ADDPATH_TX (peer, afi, safi))
+    {
+      bgp_announce_addpath (peer, rn, afi, safi, 1);
+      return;
+    }
+
+  if (rsclient
+      && CHECK_FLAG (peer->af_flags[afi][safi], PEER_FLAG_RSERVER_SHARED))
+    {
+      bgp_announce_shared (peer, rn, afi, safi, 1);
+      return;
+    }
+
+  /* It's initialized in bgp_announce_[check|check_rsclient]() */
+  attr.extra = &extra;
+
+  for (ri = rn->info; ri; ri = ri->next)
+    if (CHECK_FLAG (ri->flags, BGP_INFO_SELECTED) && ri->peer != peer)
+      {
+        if ( (rsclient) ?
+             (bgp_announce_check_rsclient (ri, peer, &rn->p, &attr, afi, safi))
+             : (bgp_announce_check (ri, peer, &rn->p, &attr, afi, safi)))
+          bgp_adj_out_set (rn, peer, &rn->p, &attr, afi, safi, ri);
+        else
+          bgp_adj_out_unset (rn, peer, &rn->p, afi, safi, 0);
+      }
+}
+
+static void
+bgp_announce_table (struct peer *peer, afi_t afi, safi_t safi,
+                   struct bgp_table *table, int rsclient)
+{
+  struct bgp_node *rn;
+
   if (! table)
     table = (rsclient) ? peer->rib[afi][safi] : peer->bgp->rib[afi][safi];
 
@@ -2574,20 +4160,18 @@ bgp_announce_table (struct peer *peer, afi_t afi, safi_t safi,
       && CHECK_FLAG (peer->af_flags[afi][safi], PEER_FLAG_DEFAULT_ORIGINATE))
     bgp_default_originate (peer, afi, safi, 0);
 
-  /* It's initialized in bgp_announce_[check|check_rsclient]() */
-  attr.extra = &extra;
+  /* Plain tables are walked a piece at a time.  The per-RD tables of
+     VPNs are still done in one go. */
+  if (safi != SAFI_MPLS_VPN)
+    {
+      bgp_walk_start (peer, afi, safi,
+                      rsclient ? BGP_WALK_ANNOUNCE_RSCLIENT : BGP_WALK_ANNOUNCE,
+                      table);
+      return;
+    }
 
   for (rn = bgp_table_top (table); rn; rn = bgp_route_next(rn))
-    for (ri = rn->info; ri; ri = ri->next)
-      if (CHECK_FLAG (ri->flags, BGP_INFO_SELECTED) && ri->peer != peer)
-	{
-         if ( (rsclient) ?
-              (bgp_announce_check_rsclient (ri, peer, &rn->p, &attr, afi, safi))
-              : (bgp_announce_check (ri, peer, &rn->p, &attr, afi, safi)))
-	    bgp_adj_out_set (rn, peer, &rn->p, &attr, afi, safi, ri);
-	  else
-	    bgp_adj_out_unset (rn, peer, &rn->p, afi, safi);
-	}
+    bgp_announce_node (peer, afi, safi, rn, rsclient);
 }
 
 void
@@ -2606,6 +4190,8 @@ bgp_announce_route (struct peer *peer, afi_t afi, safi_t safi)
   if (CHECK_FLAG (peer->af_sflags[afi][safi], PEER_STATUS_ORF_WAIT_REFRESH))
     return;
 
+  peer->policy_version[afi][safi] = bgp_policy_version ();
+
   if (safi != SAFI_MPLS_VPN)
     bgp_announce_table (peer, afi, safi, NULL, 0);
   else
@@ -2618,6 +4204,134 @@ bgp_announce_route (struct peer *peer, afi_t afi, safi_t safi)
     bgp_announce_table (peer, afi, safi, NULL, 1);
 }
 
+/* Announce the table to the peer again, for a ROUTE-REFRESH.  The
+   Adj-RIB-Out holds the attributes as outbound policy made them, so as
+   long as policy did not change since the table was last announced in
+   full, they are queued again as they are, without running the policy
+   over every route of the table once more.  Changes to the routes
+   themselves went through bgp_process() meanwhile.  Routes with an
+   advertisement still queued go out anyway. */
+void
+bgp_announce_route_refresh (struct peer *peer, afi_t afi, safi_t safi)
+{
+  struct bgp_adj_out *adj;
+  struct bgp_info *ri;
+  unsigned long count = 0;
+  int addpath;
+
+  if (peer->status != Established)
+    return;
+
+  if (! peer->afc_nego[afi][safi])
+    return;
+
+  if (peer->policy_version[afi][safi] != bgp_policy_version ()
+      || CHECK_FLAG (peer->af_sflags[afi][safi], PEER_STATUS_ORF_WAIT_REFRESH))
+    {
+      bgp_announce_route (peer, afi, safi);
+      return;
+    }
+
+  if (safi != SAFI_MPLS_VPN
+      && CHECK_FLAG (peer->af_flags[afi][safi], PEER_FLAG_DEFAULT_ORIGINATE))
+    bgp_default_originate (peer, afi, safi, 0);
+
+  addpath = PEER_ADDPATH_TX (peer, afi, safi);
+  for (adj = peer->adj_out[afi][safi]; adj; adj = adj->peer_next)
+    {
+      if (adj->adv || ! adj->attr)
+        continue;
+
+      /* The path advertised, which the encoding depends on. */
+      for (ri = adj->rn->info; ri; ri = ri->next)
+        if (addpath ? ri->addpath_tx_id == adj->addpath_tx_id
+            : CHECK_FLAG (ri->flags, BGP_INFO_SELECTED))
+          break;
+      if (! ri)
+        continue;
+
+      bgp_adj_out_set (adj->rn, peer, &adj->rn->p, adj->attr, afi, safi, ri);
+      count++;
+    }
+
+  if (BGP_DEBUG (events, EVENTS))
+    zlog_debug ("%s route refresh %s, %lu routes replayed from Adj-RIB-Out",
+                peer->host, afi_safi_print (afi, safi), count);
+}
+
+/* Announce to peer again the nodes of table at or under p. */
+static void
+bgp_announce_subtree (struct peer *peer, afi_t afi, safi_t safi,
+                      struct bgp_table *table, struct prefix *p, int rsclient)
+{
+  struct bgp_node *rn;
+
+  if ((rn = bgp_node_lookup (table, p)) != NULL)
+    {
+      bgp_announce_node (peer, afi, safi, rn, rsclient);
+      bgp_unlock_node (rn);
+    }
+
+  /* The nodes under p follow it in order of iteration. */
+  for (rn = bgp_table_get_next (table, p);
+       rn && prefix_match (p, &rn->p);
+       rn = bgp_route_next (rn))
+    bgp_announce_node (peer, afi, safi, rn, rsclient);
+  if (rn)
+    bgp_unlock_node (rn);
+}
+
+/* Announce to peer again only the routes under the prefixes of
+   prefixes, for an outbound filter whose outcome changed just there.
+   A prefix covering the whole table is left to bgp_announce_route(),
+   which walks it a piece at a time. */
+void
+bgp_announce_route_prefixes (struct peer *peer, afi_t afi, safi_t safi,
+                             struct route_table *prefixes)
+{
+  struct route_node *pn;
+  struct prefix *done = NULL;
+
+  if (peer->status != Established)
+    return;
+
+  if (! peer->afc_nego[afi][safi])
+    return;
+
+  if (CHECK_FLAG (peer->af_sflags[afi][safi], PEER_STATUS_ORF_WAIT_REFRESH))
+    return;
+
+  if (safi == SAFI_MPLS_VPN)
+    {
+      bgp_announce_route (peer, afi, safi);
+      return;
+    }
+
+  for (pn = route_top (prefixes); pn; pn = route_next (pn))
+    {
+      if (! pn->info)
+        continue;
+
+      if (pn->p.prefixlen == 0)
+        {
+          route_unlock_node (pn);
+          bgp_announce_route (peer, afi, safi);
+          return;
+        }
+
+      /* Already done as part of a shorter prefix. */
+      if (done && prefix_match (done, &pn->p))
+        continue;
+      done = &pn->p;
+
+      bgp_announce_subtree (peer, afi, safi, peer->bgp->rib[afi][safi],
+                            &pn->p, 0);
+      if (CHECK_FLAG (peer->af_flags[afi][safi], PEER_FLAG_RSERVER_CLIENT))
+        bgp_announce_subtree (peer, afi, safi, peer->rib[afi][safi],
+                              &pn->p, 1);
+    }
+}
+
 void
 bgp_announce_route_all (struct peer *peer)
 {
@@ -2628,26 +4342,37 @@ bgp_announce_route_all (struct peer *peer)
     for (safi = SAFI_UNICAST; safi < SAFI_MAX; safi++)
       bgp_announce_route (peer, afi, safi);
 }
-
+
+static void
+bgp_soft_reconfig_node_rsclient (struct peer *rsclient, afi_t afi,
+        safi_t safi, struct bgp_node *rn, struct prefix_rd *prd)
+{
+  struct bgp_adj_in *ain;
+  struct bgp_info *ri = rn->info;
+  u_char *tag = (ri && ri->extra) ? ri->extra->tag : NULL;
+
+  bgp_process_prio_scope = BGP_PROCESS_BULK;
+
+  for (ain = rn->adj_in; ain; ain = ain->next)
+    bgp_update_rsclient (rsclient, afi, safi, ain->attr, ain->peer,
+            &rn->p, ZEBRA_ROUTE_BGP, BGP_ROUTE_NORMAL, prd, tag);
+
+  for (ri = rn->info; ri; ri = ri->next)
+    if (CHECK_FLAG (ri->flags, BGP_INFO_ADJ_IN))
+      bgp_update_rsclient (rsclient, afi, safi, ri->attr, ri->peer,
+              &rn->p, ZEBRA_ROUTE_BGP, BGP_ROUTE_NORMAL, prd, tag);
+
+  bgp_process_prio_scope = BGP_PROCESS_CHANGE;
+}
+
 static void
 bgp_soft_reconfig_table_rsclient (struct peer *rsclient, afi_t afi,
         safi_t safi, struct bgp_table *table, struct prefix_rd *prd)
 {
   struct bgp_node *rn;
-  struct bgp_adj_in *ain;
-
-  if (! table)
-    table = rsclient->bgp->rib[afi][safi];
 
   for (rn = bgp_table_top (table); rn; rn = bgp_route_next (rn))
-    for (ain = rn->adj_in; ain; ain = ain->next)
-      {
-        struct bgp_info *ri = rn->info;
-        u_char *tag = (ri && ri->extra) ? ri->extra->tag : NULL;
-
-        bgp_update_rsclient (rsclient, afi, safi, ain->attr, ain->peer,
-                &rn->p, ZEBRA_ROUTE_BGP, BGP_ROUTE_NORMAL, prd, tag);
-      }
+    bgp_soft_reconfig_node_rsclient (rsclient, afi, safi, rn, prd);
 }
 
 void
@@ -2657,7 +4382,8 @@ bgp_soft_reconfig_rsclient (struct peer *rsclient, afi_t afi, safi_t safi)
   struct bgp_node *rn;
   
   if (safi != SAFI_MPLS_VPN)
-    bgp_soft_reconfig_table_rsclient (rsclient, afi, safi, NULL, NULL);
+    bgp_walk_start (rsclient, afi, safi, BGP_WALK_SOFT_IN_RSCLIENT,
+                    rsclient->bgp->rib[afi][safi]);
 
   else
     for (rn = bgp_table_top (rsclient->bgp->rib[afi][safi]); rn;
@@ -2672,37 +4398,41 @@ bgp_soft_reconfig_rsclient (struct peer *rsclient, afi_t afi, safi_t safi)
           bgp_soft_reconfig_table_rsclient (rsclient, afi, safi, table, &prd);
         }
 }
-
+
+/* Returns -1 if the peer went down meanwhile. */
+static int
+bgp_soft_reconfig_node (struct peer *peer, afi_t afi, safi_t safi,
+			struct bgp_node *rn, struct prefix_rd *prd)
+{
+  struct bgp_info *ri = rn->info;
+  u_char *tag = (ri && ri->extra) ? ri->extra->tag : NULL;
+  struct attr *attr;
+  int ret = 0;
+
+  /* At most one set of attributes is kept per peer, and it stays
+     referenced while the update moves it between bgp_adj_in and the
+     peer's route. */
+  bgp_process_prio_scope = BGP_PROCESS_BULK;
+  if ((attr = bgp_adj_in_attr (rn, peer)) != NULL)
+    if (bgp_update (peer, &rn->p, attr, afi, safi,
+		    ZEBRA_ROUTE_BGP, BGP_ROUTE_NORMAL,
+		    prd, tag, 1) < 0)
+      ret = -1;
+  bgp_process_prio_scope = BGP_PROCESS_CHANGE;
+  return ret;
+}
+
 static void
 bgp_soft_reconfig_table (struct peer *peer, afi_t afi, safi_t safi,
 			 struct bgp_table *table, struct prefix_rd *prd)
 {
-  int ret;
   struct bgp_node *rn;
-  struct bgp_adj_in *ain;
-
-  if (! table)
-    table = peer->bgp->rib[afi][safi];
 
   for (rn = bgp_table_top (table); rn; rn = bgp_route_next (rn))
-    for (ain = rn->adj_in; ain; ain = ain->next)
+    if (bgp_soft_reconfig_node (peer, afi, safi, rn, prd) < 0)
       {
-	if (ain->peer == peer)
-	  {
-	    struct bgp_info *ri = rn->info;
-	    u_char *tag = (ri && ri->extra) ? ri->extra->tag : NULL;
-
-	    ret = bgp_update (peer, &rn->p, ain->attr, afi, safi,
-			      ZEBRA_ROUTE_BGP, BGP_ROUTE_NORMAL,
-			      prd, tag, 1);
-
-	    if (ret < 0)
-	      {
-		bgp_unlock_node (rn);
-		return;
-	      }
-	    continue;
-	  }
+	bgp_unlock_node (rn);
+	return;
       }
 }
 
@@ -2716,7 +4446,8 @@ bgp_soft_reconfig_in (struct peer *peer, afi_t afi, safi_t safi)
     return;
 
   if (safi != SAFI_MPLS_VPN)
-    bgp_soft_reconfig_table (peer, afi, safi, NULL, NULL);
+    bgp_walk_start (peer, afi, safi, BGP_WALK_SOFT_IN,
+		    peer->bgp->rib[afi][safi]);
   else
     for (rn = bgp_table_top (peer->bgp->rib[afi][safi]); rn;
 	 rn = bgp_route_next (rn))
@@ -2730,14 +4461,144 @@ bgp_soft_reconfig_in (struct peer *peer, afi_t afi, safi_t safi)
           bgp_soft_reconfig_table (peer, afi, safi, table, &prd);
         }
 }
+
+/* Validate the origins of the routes of table within p again, after the
+   ROAs covering p changed.  The routes of peers which could be filtered
+   on the state are sent through inbound policy again first, when what
+   the peer sent was kept. */
+void
+bgp_rpki_revalidate (struct bgp *bgp, struct bgp_table *table,
+		     struct prefix *p, afi_t afi, safi_t safi)
+{
+  struct bgp_node *top;
+  struct bgp_node *rn;
+  struct bgp_adj_in *ain;
+  struct bgp_info *ri;
+  struct peer *peer;
+  int changed;
+  int state;
+
+  top = bgp_node_get (table, p);
+  for (rn = bgp_node_get (table, p); rn; rn = bgp_route_next_until (rn, top))
+    {
+      if (table == bgp->rib[afi][safi])
+	for (ain = rn->adj_in; ain; ain = ain->next)
+	  {
+	    peer = ain->peer;
+	    if (CHECK_FLAG (peer->af_flags[afi][safi], PEER_FLAG_SOFT_RECONFIG)
+		&& ROUTE_MAP_IN_NAME (&peer->filter[afi][safi])
+		&& bgp_soft_reconfig_node (peer, afi, safi, rn, NULL) < 0)
+	      break;
+	  }
+
+      changed = 0;
+      for (ri = rn->info; ri; ri = ri->next)
+	{
+	  if (ri->type != ZEBRA_ROUTE_BGP || ri->sub_type != BGP_ROUTE_NORMAL
+	      || CHECK_FLAG (ri->flags, BGP_INFO_REMOVED))
+	    continue;
+	  state = bgp_rpki_validate (&rn->p, ri->peer, ri->attr);
+	  if (state == (ri->extra ? ri->extra->rpki_state : RPKI_NOTFOUND))
+	    continue;
+	  bgp_info_extra_get (ri)->rpki_state = state;
+	  bgp_info_set_flag (rn, ri, BGP_INFO_ATTR_CHANGED);
+	  changed = 1;
+	}
+      if (changed)
+	bgp_process (bgp, rn, afi, safi);
+    }
+  bgp_unlock_node (top);
+}
 
 
 struct bgp_clear_node_queue
 {
   struct bgp_node *rn;
   enum bgp_clear_route_type purpose;
+  /* Instead of a node, the walk that queues them, which requeues itself
+     behind the nodes queued so far until it is done. */
+  struct bgp_walk *walk;
+
+  /* Or else, the peer's own entries in the address family, see
+     bgp_clear_route_index(). */
+  int index;
+  afi_t afi;
+  safi_t safi;
+  /* The peer's paths still to be done. */
+  struct bgp_info *paths;
 };
 
+/* Remove a path of the peer being cleared, or keep it as stale for
+   graceful restart. */
+static void
+bgp_clear_route_info (struct peer *peer, struct bgp_node *rn,
+                      struct bgp_info *ri, afi_t afi, safi_t safi)
+{
+  /* graceful restart STALE flag set. */
+  if (CHECK_FLAG (peer->sflags, PEER_STATUS_NSF_WAIT)
+      && peer->nsf[afi][safi]
+      && ! CHECK_FLAG (ri->flags, BGP_INFO_STALE)
+      && ! CHECK_FLAG (ri->flags, BGP_INFO_UNUSEABLE))
+    bgp_info_set_flag (rn, ri, BGP_INFO_STALE);
+  else
+    bgp_rib_remove (rn, ri, peer, afi, safi);
+}
+
+/* Clear the peer's entries off its lists until done or out of time.
+   Returns 1 once done. */
+static int
+bgp_clear_index_step (struct peer *peer, struct bgp_clear_node_queue *cnq)
+{
+  afi_t afi = cnq->afi;
+  safi_t safi = cnq->safi;
+  struct bgp_adj_in *ain;
+  struct bgp_adj_out *aout;
+  struct bgp_info *ri;
+  struct bgp_node *rn;
+  struct timeval start, now;
+  unsigned long budget;
+  unsigned int entries = 0;
+
+  budget = bm->walk_budget * 1000;
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &start);
+
+  while (1)
+    {
+      if ((ain = peer->adj_in[afi][safi]) != NULL)
+        {
+          rn = ain->rn;
+          bgp_adj_in_remove (rn, ain);
+          bgp_unlock_node (rn);
+        }
+      else if ((aout = peer->adj_out[afi][safi]) != NULL)
+        {
+          rn = aout->rn;
+          bgp_adj_out_remove (rn, aout, peer, afi, safi);
+          bgp_unlock_node (rn);
+        }
+      else if ((ri = cnq->paths) != NULL)
+        {
+          /* Back on the peer's list, for as long as it lasts. */
+          BGP_PEER_INDEX_DEL (ri);
+          BGP_PEER_INDEX_ADD (&peer->paths[afi][safi], ri);
+
+          UNSET_FLAG (ri->flags, BGP_INFO_ADJ_IN);
+          if (! CHECK_FLAG (ri->flags, BGP_INFO_REMOVED))
+            bgp_clear_route_info (peer, ri->net, ri, afi, safi);
+        }
+      else
+        return 1;
+
+      if (++entries % BGP_WALK_CHECK_NODES)
+        continue;
+
+      quagga_gettime (QUAGGA_CLK_MONOTONIC, &now);
+      if ((now.tv_sec - start.tv_sec) * 1000000L
+          + (now.tv_usec - start.tv_usec) > (long) budget)
+        return 0;
+    }
+}
+
 static wq_item_status
 bgp_clear_route_node (struct work_queue *wq, void *data)
 {
@@ -2745,22 +4606,24 @@ bgp_clear_route_node (struct work_queue *wq, void *data)
   struct bgp_node *rn = cnq->rn;
   struct peer *peer = wq->spec.data;
   struct bgp_info *ri;
-  afi_t afi = bgp_node_table (rn)->afi;
-  safi_t safi = bgp_node_table (rn)->safi;
+  afi_t afi;
+  safi_t safi;
   
+  if (cnq->walk)
+    return bgp_walk_step (cnq->walk) ? WQ_SUCCESS : WQ_REQUEUE;
+
+  if (cnq->index)
+    return bgp_clear_index_step (peer, cnq) ? WQ_SUCCESS : WQ_REQUEUE;
+
   assert (rn && peer);
   
+  afi = bgp_node_table (rn)->afi;
+  safi = bgp_node_table (rn)->safi;
+
   for (ri = rn->info; ri; ri = ri->next)
     if (ri->peer == peer || cnq->purpose == BGP_CLEAR_ROUTE_MY_RSCLIENT)
       {
-        /* graceful restart STALE flag set. */
-        if (CHECK_FLAG (peer->sflags, PEER_STATUS_NSF_WAIT)
-            && peer->nsf[afi][safi]
-            && ! CHECK_FLAG (ri->flags, BGP_INFO_STALE)
-            && ! CHECK_FLAG (ri->flags, BGP_INFO_UNUSEABLE))
-          bgp_info_set_flag (rn, ri, BGP_INFO_STALE);
-        else
-          bgp_rib_remove (rn, ri, peer, afi, safi);
+        bgp_clear_route_info (peer, rn, ri, afi, safi);
         break;
       }
   return WQ_SUCCESS;
@@ -2771,10 +4634,27 @@ bgp_clear_node_queue_del (struct work_queue *wq, void *data)
 {
   struct bgp_clear_node_queue *cnq = data;
   struct bgp_node *rn = cnq->rn;
-  struct bgp_table *table = bgp_node_table (rn);
   
-  bgp_unlock_node (rn); 
-  bgp_table_unlock (table);
+  if (cnq->walk)
+    bgp_walk_free (cnq->walk);
+  else if (cnq->index)
+    {
+      struct peer *peer = wq->spec.data;
+      struct bgp_info *ri;
+
+      while ((ri = cnq->paths) != NULL)
+        {
+          BGP_PEER_INDEX_DEL (ri);
+          BGP_PEER_INDEX_ADD (&peer->paths[cnq->afi][cnq->safi], ri);
+        }
+    }
+  else
+    {
+      struct bgp_table *table = bgp_node_table (rn);
+
+      bgp_unlock_node (rn); 
+      bgp_table_unlock (table);
+    }
   XFREE (MTYPE_BGP_CLEAR_NODE_QUEUE, cnq);
 }
 
@@ -2786,6 +4666,9 @@ bgp_clear_node_complete (struct work_queue *wq)
   /* Tickle FSM to start moving again */
   BGP_EVENT_ADD (peer, Clearing_Completed);
 
+  /* Hand slabs emptied by the peer going down back to the system. */
+  bgp_pool_trim_pending = 1;
+
   peer_unlock (peer); /* bgp_clear_route */
 }
 
@@ -2812,13 +4695,72 @@ bgp_clear_node_queue_init (struct peer *peer)
   peer->clear_node_queue->spec.data = peer;
 }
 
+static void
+bgp_clear_route_table_node (struct peer *peer, afi_t afi, safi_t safi,
+                            struct bgp_node *rn,
+                            enum bgp_clear_route_type purpose)
+{
+  struct bgp_info *ri;
+  struct bgp_adj_in *ain;
+  struct bgp_adj_out *aout;
+  struct bgp_adj_out *nextaout;
+
+  /* Only used to empty a route server client's own table: the peer's
+   * entries elsewhere are found through its lists, see
+   * bgp_clear_route_index().  There are 3 of them to scrub here:
+   *
+   * 1 routes visible via the RIB (ie accepted routes)
+   * 2 routes visible by the (optional) adj-in index
+   * 3 routes visible by the adj-out index
+   */
+  for (ain = rn->adj_in; ain; ain = ain->next)
+    if (ain->peer == peer || purpose == BGP_CLEAR_ROUTE_MY_RSCLIENT)
+      {
+        bgp_adj_in_remove (rn, ain);
+        bgp_unlock_node (rn);
+        break;
+      }
+  for (ri = rn->info; ri; ri = ri->next)
+    if (ri->peer == peer || purpose == BGP_CLEAR_ROUTE_MY_RSCLIENT)
+      UNSET_FLAG (ri->flags, BGP_INFO_ADJ_IN);
+  /* A peer taking ADD-PATH may have several. */
+  for (aout = rn->adj_out; aout; aout = nextaout)
+    {
+      nextaout = aout->next;
+      if (aout->peer == peer || purpose == BGP_CLEAR_ROUTE_MY_RSCLIENT)
+        {
+          bgp_adj_out_remove (rn, aout, peer, afi, safi);
+          bgp_unlock_node (rn);
+        }
+    }
+
+  for (ri = rn->info; ri; ri = ri->next)
+    if (ri->peer == peer || purpose == BGP_CLEAR_ROUTE_MY_RSCLIENT)
+      {
+        struct bgp_clear_node_queue *cnq;
+
+        /* both unlocked in bgp_clear_node_queue_del */
+        bgp_table_lock (bgp_node_table (rn));
+        bgp_lock_node (rn);
+        cnq = XCALLOC (MTYPE_BGP_CLEAR_NODE_QUEUE,
+                       sizeof (struct bgp_clear_node_queue));
+        cnq->rn = rn;
+        cnq->purpose = purpose;
+        work_queue_add (peer->clear_node_queue, cnq);
+        break;
+      }
+}
+
+/* Clear the peer from the table.  The table is walked from the peer's
+   clearing queue, a piece at a time like other walks, but the first
+   piece is done right away: small tables are finished with at once. */
 static void
 bgp_clear_route_table (struct peer *peer, afi_t afi, safi_t safi,
                        struct bgp_table *table, struct peer *rsclient,
                        enum bgp_clear_route_type purpose)
 {
-  struct bgp_node *rn;
-  
+  struct bgp_walk *walk;
+  struct bgp_clear_node_queue *cnq;
   
   if (! table)
     table = (rsclient) ? rsclient->rib[afi][safi] : peer->bgp->rib[afi][safi];
@@ -2827,86 +4769,142 @@ bgp_clear_route_table (struct peer *peer, afi_t afi, safi_t safi,
   if (! table)
     return;
   
-  for (rn = bgp_table_top (table); rn; rn = bgp_route_next (rn))
+  walk = bgp_walk_new (peer, afi, safi, BGP_WALK_CLEAR, table);
+  walk->purpose = purpose;
+
+  if (bgp_walk_step (walk))
     {
-      struct bgp_info *ri;
-      struct bgp_adj_in *ain;
-      struct bgp_adj_out *aout;
-
-      /* XXX:TODO: This is suboptimal, every non-empty route_node is
-       * queued for every clearing peer, regardless of whether it is
-       * relevant to the peer at hand.
-       *
-       * Overview: There are 3 different indices which need to be
-       * scrubbed, potentially, when a peer is removed:
-       *
-       * 1 peer's routes visible via the RIB (ie accepted routes)
-       * 2 peer's routes visible by the (optional) peer's adj-in index
-       * 3 other routes visible by the peer's adj-out index
-       *
-       * 3 there is no hurry in scrubbing, once the struct peer is
-       * removed from bgp->peer, we could just GC such deleted peer's
-       * adj-outs at our leisure.
-       *
-       * 1 and 2 must be 'scrubbed' in some way, at least made
-       * invisible via RIB index before peer session is allowed to be
-       * brought back up. So one needs to know when such a 'search' is
-       * complete.
-       *
-       * Ideally:
-       *
-       * - there'd be a single global queue or a single RIB walker
-       * - rather than tracking which route_nodes still need to be
-       *   examined on a peer basis, we'd track which peers still
-       *   aren't cleared
-       *
-       * Given that our per-peer prefix-counts now should be reliable,
-       * this may actually be achievable. It doesn't seem to be a huge
-       * problem at this time,
-       */
-      for (ain = rn->adj_in; ain; ain = ain->next)
-        if (ain->peer == peer || purpose == BGP_CLEAR_ROUTE_MY_RSCLIENT)
-          {
-            bgp_adj_in_remove (rn, ain);
-            bgp_unlock_node (rn);
-            break;
-          }
-      for (aout = rn->adj_out; aout; aout = aout->next)
-        if (aout->peer == peer || purpose == BGP_CLEAR_ROUTE_MY_RSCLIENT)
-          {
-            bgp_adj_out_remove (rn, aout, peer, afi, safi);
-            bgp_unlock_node (rn);
-            break;
-          }
+      bgp_walk_free (walk);
+      return;
+    }
 
-      for (ri = rn->info; ri; ri = ri->next)
-        if (ri->peer == peer || purpose == BGP_CLEAR_ROUTE_MY_RSCLIENT)
-          {
-            struct bgp_clear_node_queue *cnq;
-
-            /* both unlocked in bgp_clear_node_queue_del */
-            bgp_table_lock (bgp_node_table (rn));
-            bgp_lock_node (rn);
-            cnq = XCALLOC (MTYPE_BGP_CLEAR_NODE_QUEUE,
-                           sizeof (struct bgp_clear_node_queue));
-            cnq->rn = rn;
-            cnq->purpose = purpose;
-            work_queue_add (peer->clear_node_queue, cnq);
-            break;
-          }
+  cnq = XCALLOC (MTYPE_BGP_CLEAR_NODE_QUEUE,
+                 sizeof (struct bgp_clear_node_queue));
+  cnq->purpose = purpose;
+  cnq->walk = walk;
+  work_queue_add (peer->clear_node_queue, cnq);
+}
+
+/* Clear the peer's paths, Adj-RIB-In and Adj-RIB-Out entries from all
+   tables of the address family.  They are found through the peer's
+   lists rather than by walking the tables, so this takes time in
+   proportion to what the peer has, not to the size of the tables.  As
+   with a table walk, the first piece is done right away, and the rest
+   from the peer's clearing queue. */
+static void
+bgp_clear_route_index (struct peer *peer, afi_t afi, safi_t safi)
+{
+  struct bgp_clear_node_queue *cnq;
+
+  if (! peer->paths[afi][safi] && ! peer->adj_in[afi][safi]
+      && ! peer->adj_out[afi][safi])
+    return;
+
+  cnq = XCALLOC (MTYPE_BGP_CLEAR_NODE_QUEUE,
+                 sizeof (struct bgp_clear_node_queue));
+  cnq->purpose = BGP_CLEAR_ROUTE_NORMAL;
+  cnq->index = 1;
+  cnq->afi = afi;
+  cnq->safi = safi;
+
+  /* Take the paths there are now.  Those that outlive the clearing,
+     stale or history ones, are put back on the peer's list as they are
+     done with. */
+  cnq->paths = peer->paths[afi][safi];
+  if (cnq->paths)
+    cnq->paths->peer_prev = &cnq->paths;
+  peer->paths[afi][safi] = NULL;
+
+  if (bgp_clear_index_step (peer, cnq))
+    {
+      XFREE (MTYPE_BGP_CLEAR_NODE_QUEUE, cnq);
+      return;
     }
-  return;
+
+  work_queue_add (peer->clear_node_queue, cnq);
+}
+
+/* bgp_announce_node() for an announce walk with a key.  The leader
+   keeps what bgp_announce_check_conf() made of the selected path, even
+   where that path is not for its own peer, and the walks it leads take
+   it as it is, with only bgp_announce_check_peer() of their own. */
+static void
+bgp_walk_announce_node (struct bgp_walk *walk, struct bgp_node *rn)
+{
+  struct peer *peer = walk->peer;
+  struct bgp_walk *leader = walk->leader;
+  struct bgp_info *ri;
+  struct attr attr, *share;
+  struct attr_extra extra;
+  afi_t afi = walk->afi;
+  safi_t safi = walk->safi;
+
+  for (ri = rn->info; ri; ri = ri->next)
+    if (CHECK_FLAG (ri->flags, BGP_INFO_SELECTED))
+      break;
+
+  if (leader && (leader->share_rn != rn || leader->share_ri != ri))
+    leader = NULL;
+
+  if (! leader)
+    {
+      if (walk->share_attr)
+        bgp_attr_unintern (&walk->share_attr);
+      walk->share_rn = rn;
+      walk->share_ri = ri;
+      if (! ri)
+        return;
+
+      attr.extra = &extra;
+      if (bgp_announce_check_conf (ri, peer, &rn->p, &attr, afi, safi))
+        walk->share_attr = bgp_attr_intern (&attr);
+    }
+
+  if (! ri || ri->peer == peer)
+    return;
+
+  share = leader ? leader->share_attr : walk->share_attr;
+  if (share && bgp_announce_check_peer (ri, peer, &rn->p, afi, safi))
+    bgp_adj_out_set (rn, peer, &rn->p, share, afi, safi, ri);
+  else
+    bgp_adj_out_unset (rn, peer, &rn->p, afi, safi, 0);
+}
+
+static int
+bgp_walk_node (struct bgp_walk *walk, struct bgp_node *rn)
+{
+  switch (walk->type)
+    {
+    case BGP_WALK_ANNOUNCE:
+      if (walk->shared)
+        bgp_walk_announce_node (walk, rn);
+      else
+        bgp_announce_node (walk->peer, walk->afi, walk->safi, rn, 0);
+      break;
+    case BGP_WALK_ANNOUNCE_RSCLIENT:
+      bgp_announce_node (walk->peer, walk->afi, walk->safi, rn, 1);
+      break;
+    case BGP_WALK_SOFT_IN:
+      return bgp_soft_reconfig_node (walk->peer, walk->afi, walk->safi, rn,
+                                     NULL);
+    case BGP_WALK_SOFT_IN_RSCLIENT:
+      bgp_soft_reconfig_node_rsclient (walk->peer, walk->afi, walk->safi, rn,
+                                       NULL);
+      break;
+    case BGP_WALK_CLEAR:
+      bgp_clear_route_table_node (walk->peer, walk->afi, walk->safi, rn,
+                                  walk->purpose);
+      break;
+    default:
+      assert (0);
+    }
+  return 0;
 }
 
 void
 bgp_clear_route (struct peer *peer, afi_t afi, safi_t safi,
                  enum bgp_clear_route_type purpose)
 {
-  struct bgp_node *rn;
-  struct bgp_table *table;
-  struct peer *rsclient;
-  struct listnode *node, *nnode;
-
   if (peer->clear_node_queue == NULL)
     bgp_clear_node_queue_init (peer);
   
@@ -2928,18 +4926,7 @@ bgp_clear_route (struct peer *peer, afi_t afi, safi_t safi,
   switch (purpose)
     {
     case BGP_CLEAR_ROUTE_NORMAL:
-      if (safi != SAFI_MPLS_VPN)
-        bgp_clear_route_table (peer, afi, safi, NULL, NULL, purpose);
-      else
-        for (rn = bgp_table_top (peer->bgp->rib[afi][safi]); rn;
-             rn = bgp_route_next (rn))
-          if ((table = rn->info) != NULL)
-            bgp_clear_route_table (peer, afi, safi, table, NULL, purpose);
-
-      for (ALL_LIST_ELEMENTS (peer->bgp->rsclient, node, nnode, rsclient))
-        if (CHECK_FLAG(rsclient->af_flags[afi][safi],
-                       PEER_FLAG_RSERVER_CLIENT))
-          bgp_clear_route_table (peer, afi, safi, NULL, rsclient, purpose);
+      bgp_clear_route_index (peer, afi, safi);
       break;
 
     case BGP_CLEAR_ROUTE_MY_RSCLIENT:
@@ -2953,8 +4940,6 @@ bgp_clear_route (struct peer *peer, afi_t afi, safi_t safi,
   
   /* If no routes were cleared, nothing was added to workqueue, the
    * completion function won't be run by workqueue code - call it here. 
-   * XXX: Actually, this assumption doesn't hold, see
-   * bgp_clear_route_table(), we queue all non-empty nodes.
    *
    * Additionally, there is a presumption in FSM that clearing is only
    * really needed if peer state is Established - peers in
@@ -2988,43 +4973,80 @@ bgp_clear_route_all (struct peer *peer)
 void
 bgp_clear_adj_in (struct peer *peer, afi_t afi, safi_t safi)
 {
-  struct bgp_table *table;
   struct bgp_node *rn;
   struct bgp_adj_in *ain;
+  struct bgp_info *ri;
 
-  table = peer->bgp->rib[afi][safi];
+  for (ri = peer->paths[afi][safi]; ri; ri = ri->peer_next)
+    UNSET_FLAG (ri->flags, BGP_INFO_ADJ_IN);
 
-  for (rn = bgp_table_top (table); rn; rn = bgp_route_next (rn))
-    for (ain = rn->adj_in; ain ; ain = ain->next)
-      if (ain->peer == peer)
-	{
-          bgp_adj_in_remove (rn, ain);
-          bgp_unlock_node (rn);
-          break;
-	}
+  while ((ain = peer->adj_in[afi][safi]) != NULL)
+    {
+      rn = ain->rn;
+      bgp_adj_in_remove (rn, ain);
+      bgp_unlock_node (rn);
+    }
 }
 
 void
 bgp_clear_stale_route (struct peer *peer, afi_t afi, safi_t safi)
 {
+  struct bgp_info *ri;
+
+  bgp_process_prio_scope = BGP_PROCESS_EOR;
+
+  /* Removed paths stay on the list until bgp_process() reaps them. */
+  for (ri = peer->paths[afi][safi]; ri; ri = ri->peer_next)
+    if (CHECK_FLAG (ri->flags, BGP_INFO_STALE)
+        && ! CHECK_FLAG (ri->flags, BGP_INFO_REMOVED))
+      bgp_rib_remove (ri->net, ri, peer, afi, safi);
+
+  bgp_process_prio_scope = BGP_PROCESS_CHANGE;
+}
+
+/* Install a path of peer as it was before bgpd last stopped, marked
+   stale for the peer to refresh.  attr is what the path had after
+   inbound policy, so policy is not run again. */
+void
+bgp_update_stale (struct peer *peer, struct prefix *p, struct attr *attr,
+                  afi_t afi, safi_t safi)
+{
+  struct bgp *bgp = peer->bgp;
   struct bgp_node *rn;
   struct bgp_info *ri;
-  struct bgp_table *table;
+  struct bgp_info *new;
 
-  table = peer->bgp->rib[afi][safi];
+  rn = bgp_afi_node_get (bgp->rib[afi][safi], afi, safi, p, NULL);
 
-  for (rn = bgp_table_top (table); rn; rn = bgp_route_next (rn))
+  for (ri = rn->info; ri; ri = ri->next)
+    if (ri->peer == peer && ri->type == ZEBRA_ROUTE_BGP
+        && ri->sub_type == BGP_ROUTE_NORMAL)
+      break;
+  if (ri)
     {
-      for (ri = rn->info; ri; ri = ri->next)
-	if (ri->peer == peer)
-	  {
-	    if (CHECK_FLAG (ri->flags, BGP_INFO_STALE))
-	      bgp_rib_remove (rn, ri, peer, afi, safi);
-	    break;
-	  }
+      bgp_unlock_node (rn);
+      return;
     }
+
+  new = bgp_info_new ();
+  new->type = ZEBRA_ROUTE_BGP;
+  new->sub_type = BGP_ROUTE_NORMAL;
+  new->peer = peer;
+  new->attr = bgp_attr_intern (attr);
+  new->uptime = bgp_clock ();
+  SET_FLAG (new->flags, BGP_INFO_STALE);
+
+  /* The scanner checks iBGP nexthops again once zebra is there. */
+  bgp_info_set_flag (rn, new, BGP_INFO_VALID);
+
+  bgp_aggregate_increment (bgp, p, new, afi, safi);
+  bgp_info_add (rn, new);
+  bgp_unlock_node (rn);
+
+  bgp_process_info (bgp, rn, new, afi, safi);
+  bgp_rib_in_view_sync (peer, p, afi, safi, new->type, new->sub_type);
 }
-
+
 /* Delete all kernel routes. */
 void
 bgp_cleanup_routes (void)
@@ -3067,15 +5089,21 @@ bgp_reset (void)
 }
 
 /* Parse NLRI stream.  Withdraw NLRI is recognized by NULL attr
-   value. */
+   value.  The NLRI is checked for syntactic validity on the way, as
+   bgp_nlri_sanity_check() would; if it turns out malformed, the
+   peer is sent a NOTIFICATION and -1 returned, as it is when the
+   maximum prefix count is exceeded. */
 int
 bgp_nlri_parse (struct peer *peer, struct attr *attr, struct bgp_nlri *packet)
 {
   u_char *pnt;
   u_char *lim;
   struct prefix p;
+  struct bgp_update_batch *batch = &bgp_update_batch;
   int psize;
-  int ret;
+  int malformed = 0;
+  int discard;
+  int ret = 0;
 
   /* Check peer status. */
   if (peer->status != Established)
@@ -3084,6 +5112,22 @@ bgp_nlri_parse (struct peer *peer, struct attr *attr, struct bgp_nlri *packet)
   pnt = packet->nlri;
   lim = pnt + packet->length;
 
+  discard = (attr
+	     && CHECK_FLAG (peer->af_flags[packet->afi][packet->safi],
+			    PEER_FLAG_MAX_PREFIX)
+	     && CHECK_FLAG (peer->af_flags[packet->afi][packet->safi],
+			    PEER_FLAG_MAX_PREFIX_DISCARD));
+
+  if (attr)
+    {
+      memset (batch, 0, sizeof (struct bgp_update_batch));
+      batch->peer = peer;
+      batch->attr = attr;
+      batch->afi = packet->afi;
+      batch->safi = packet->safi;
+      bgp_update_batch_current = batch;
+    }
+
   for (; pnt < lim; pnt += psize)
     {
       /* Clear prefix structure. */
@@ -3093,18 +5137,32 @@ bgp_nlri_parse (struct peer *peer, struct attr *attr, struct bgp_nlri *packet)
       p.prefixlen = *pnt++;
       p.family = afi2family (packet->afi);
       
-      /* Already checked in nlri_sanity_check().  We do double check
-         here. */
+      /* RFC1771 6.3 The NLRI field in the UPDATE message is checked
+	 for syntactic validity.  If the field is syntactically
+	 incorrect, then the Error Subcode is set to Invalid Network
+	 Field. */
       if ((packet->afi == AFI_IP && p.prefixlen > 32)
 	  || (packet->afi == AFI_IP6 && p.prefixlen > 128))
-	return -1;
+	{
+	  plog_err (peer->log, 
+		    "%s [Error] Update packet error (wrong prefix length %d)",
+		    peer->host, p.prefixlen);
+	  malformed = 1;
+	  break;
+	}
 
       /* Packet size overflow check. */
       psize = PSIZE (p.prefixlen);
 
-      /* When packet overflow occur return immediately. */
       if (pnt + psize > lim)
-	return -1;
+	{
+	  plog_err (peer->log, 
+		    "%s [Error] Update packet error"
+		    " (prefix data overflow prefix size is %d)",
+		    peer->host, psize);
+	  malformed = 1;
+	  break;
+	}
 
       /* Fetch prefix from NLRI packet. */
       memcpy (&p.u.prefix, pnt, psize);
@@ -3125,7 +5183,7 @@ bgp_nlri_parse (struct peer *peer, struct attr *attr, struct bgp_nlri *packet)
 		    "IPv4 unicast NLRI is multicast address %s",
 		    inet_ntoa (p.u.prefix4));
 
-	      return -1;
+	      continue;
 	    }
 	}
 
@@ -3146,6 +5204,11 @@ bgp_nlri_parse (struct peer *peer, struct attr *attr, struct bgp_nlri *packet)
 	}
 #endif /* HAVE_IPV6 */
 
+      /* Over the limit, a leak costs a lookup per prefix, not a path. */
+      if (discard
+	  && bgp_maximum_prefix_discard (peer, &p, packet->afi, packet->safi))
+	continue;
+
       /* Normal process. */
       if (attr)
 	ret = bgp_update (peer, &p, attr, packet->afi, packet->safi, 
@@ -3157,13 +5220,32 @@ bgp_nlri_parse (struct peer *peer, struct attr *attr, struct bgp_nlri *packet)
       /* Address family configuration mismatch or maximum-prefix count
          overflow. */
       if (ret < 0)
-	return -1;
+	break;
     }
 
-  /* Packet length consistency check. */
-  if (pnt != lim)
+  if (attr)
+    {
+      bgp_update_batch_current = NULL;
+      if (batch->attr_new)
+	bgp_attr_unintern (&batch->attr_new);
+    }
+
+  if (ret < 0)
     return -1;
 
+  /* Packet length consistency check. */
+  if (malformed || pnt != lim)
+    {
+      if (! malformed)
+	plog_err (peer->log,
+		  "%s [Error] Update packet error"
+		  " (prefix length mismatch with total length)",
+		  peer->host);
+      bgp_notify_send (peer, BGP_NOTIFY_UPDATE_ERR, 
+		       BGP_NOTIFY_UPDATE_INVAL_NETWORK);
+      return -1;
+    }
+
   return 0;
 }
 
@@ -3764,6 +5846,8 @@ bgp_static_set (struct vty *vty, struct bgp *bgp, const char *ip_str,
       if (! bgp_static->backdoor)
 	bgp_static_update (bgp, &p, bgp_static, afi, safi);
     }
+  else
+    bgp_import_register (bgp, rn, afi, safi);
 
   return CMD_SUCCESS;
 }
@@ -3813,6 +5897,7 @@ bgp_static_unset (struct vty *vty, struct bgp *bgp, const char *ip_str,
   /* Clear configuration. */
   bgp_static_free (bgp_static);
   rn->info = NULL;
+  bgp_import_unregister (bgp, &p, afi, safi);
   bgp_unlock_node (rn);
   bgp_unlock_node (rn);
 
@@ -3858,6 +5943,7 @@ bgp_static_delete (struct bgp *bgp)
 		bgp_static_withdraw (bgp, &rn->p, afi, safi);
 		bgp_static_free (bgp_static);
 		rn->info = NULL;
+		bgp_import_unregister (bgp, &rn->p, afi, safi);
 		bgp_unlock_node (rn);
 	      }
 	  }
@@ -4480,6 +6566,14 @@ struct bgp_aggregate
 
   /* SAFI configuration. */
   safi_t safi;
+
+  /* What the contributing routes add up to, for as-set.  Routes are
+     merged in as they come; once one goes away, dirty is set and the
+     lot is merged again from scratch by bgp_aggregate_recompute(). */
+  u_char origin;
+  u_char dirty;
+  struct aspath *aspath;
+  struct community *community;
 };
 
 static struct bgp_aggregate *
@@ -4488,194 +6582,200 @@ bgp_aggregate_new (void)
   return XCALLOC (MTYPE_BGP_AGGREGATE, sizeof (struct bgp_aggregate));
 }
 
+/* Forget what the contributing routes added up to. */
+static void
+bgp_aggregate_reset (struct bgp_aggregate *aggregate)
+{
+  if (aggregate->aspath)
+    aspath_free (aggregate->aspath);
+  if (aggregate->community)
+    community_free (aggregate->community);
+  aggregate->aspath = NULL;
+  aggregate->community = NULL;
+  aggregate->origin = BGP_ORIGIN_IGP;
+  aggregate->dirty = 0;
+}
+
 static void
 bgp_aggregate_free (struct bgp_aggregate *aggregate)
 {
+  bgp_aggregate_reset (aggregate);
   XFREE (MTYPE_BGP_AGGREGATE, aggregate);
 }     
 
+/* Fold a contributing route's attributes into the as-set aggregate.
+
+   ORIGIN attribute: If at least one route among routes that are
+   aggregated has ORIGIN with the value INCOMPLETE, then the
+   aggregated route must have the ORIGIN attribute with the value
+   INCOMPLETE. Otherwise, if at least one route among routes that are
+   aggregated has ORIGIN with the value EGP, then the aggregated route
+   must have the origin attribute with the value EGP. In all other
+   case the value of the ORIGIN attribute of the aggregated route is
+   INTERNAL. */
+static void
+bgp_aggregate_merge (struct bgp_aggregate *aggregate, struct attr *attr)
+{
+  struct aspath *asmerge;
+  struct community *commerge;
+
+  if (aggregate->origin < attr->origin)
+    aggregate->origin = attr->origin;
+
+  if (aggregate->aspath)
+    {
+      asmerge = aspath_aggregate (aggregate->aspath, attr->aspath);
+      aspath_free (aggregate->aspath);
+      aggregate->aspath = asmerge;
+    }
+  else
+    aggregate->aspath = aspath_dup (attr->aspath);
+
+  if (attr->community)
+    {
+      if (aggregate->community)
+	{
+	  commerge = community_merge (aggregate->community, attr->community);
+	  aggregate->community = community_uniq_sort (commerge);
+	  community_free (commerge);
+	}
+      else
+	aggregate->community = community_dup (attr->community);
+    }
+}
+
+/* Whether the route counts towards the aggregates covering it, as
+   set by bgp_aggregate_increment(). */
+#define BGP_AGGREGATE_CONTRIBUTES(RI) \
+  (CHECK_FLAG ((RI)->flags, BGP_INFO_AGGREGATED) \
+   && (RI)->sub_type != BGP_ROUTE_AGGREGATE)
+
+/* Bring the aggregate route in the RIB in line with the aggregate:
+   there is one as long as a route contributes, with the attributes
+   the contributing routes add up to. */
+static void
+bgp_aggregate_install (struct bgp *bgp, struct prefix *p, afi_t afi,
+		       safi_t safi, struct bgp_aggregate *aggregate)
+{
+  struct bgp_node *rn;
+  struct bgp_info *ri;
+  struct bgp_info *new;
+  struct attr *attr;
+
+  rn = bgp_node_get (bgp->rib[afi][safi], p);
+
+  for (ri = rn->info; ri; ri = ri->next)
+    if (ri->peer == bgp->peer_self 
+	&& ri->type == ZEBRA_ROUTE_BGP
+	&& ri->sub_type == BGP_ROUTE_AGGREGATE
+	&& ! CHECK_FLAG (ri->flags, BGP_INFO_REMOVED))
+      break;
+
+  if (aggregate->count == 0)
+    {
+      bgp_aggregate_reset (aggregate);
+      if (ri)
+	{
+	  bgp_info_delete (rn, ri);
+	  bgp_process (bgp, rn, afi, safi);
+	}
+      bgp_unlock_node (rn);
+      return;
+    }
+
+  attr = bgp_attr_aggregate_intern (bgp, aggregate->origin,
+				    aggregate->aspath
+				    ? aspath_dup (aggregate->aspath) : NULL,
+				    aggregate->community
+				    ? community_dup (aggregate->community) : NULL,
+				    aggregate->as_set);
+  if (ri && ri->attr == attr)
+    bgp_attr_unintern (&attr);
+  else if (ri)
+    {
+      bgp_attr_unintern (&ri->attr);
+      ri->attr = attr;
+      ri->uptime = bgp_clock ();
+      bgp_info_set_flag (rn, ri, BGP_INFO_ATTR_CHANGED);
+      bgp_process (bgp, rn, afi, safi);
+    }
+  else
+    {
+      new = bgp_info_new ();
+      new->type = ZEBRA_ROUTE_BGP;
+      new->sub_type = BGP_ROUTE_AGGREGATE;
+      new->peer = bgp->peer_self;
+      SET_FLAG (new->flags, BGP_INFO_VALID);
+      new->attr = attr;
+      new->uptime = bgp_clock ();
+
+      bgp_info_add (rn, new);
+      bgp_process (bgp, rn, afi, safi);
+    }
+  bgp_unlock_node (rn);
+}
+
+/* Merge what the routes contributing to an as-set aggregate add up to
+   again, after some went away. */
 static void
-bgp_aggregate_route (struct bgp *bgp, struct prefix *p, struct bgp_info *rinew,
-		     afi_t afi, safi_t safi, struct bgp_info *del, 
-		     struct bgp_aggregate *aggregate)
+bgp_aggregate_remerge (struct bgp *bgp, struct prefix *p, afi_t afi,
+		       safi_t safi, struct bgp_aggregate *aggregate)
 {
   struct bgp_table *table;
   struct bgp_node *top;
   struct bgp_node *rn;
-  u_char origin;
-  struct aspath *aspath = NULL;
-  struct aspath *asmerge = NULL;
-  struct community *community = NULL;
-  struct community *commerge = NULL;
-  struct in_addr nexthop;
-  u_int32_t med = 0;
   struct bgp_info *ri;
-  struct bgp_info *new;
-  int first = 1;
-  unsigned long match = 0;
 
-  /* Record adding route's nexthop and med. */
-  if (rinew)
-    {
-      nexthop = rinew->attr->nexthop;
-      med = rinew->attr->med;
-    }
-
-  /* ORIGIN attribute: If at least one route among routes that are
-     aggregated has ORIGIN with the value INCOMPLETE, then the
-     aggregated route must have the ORIGIN attribute with the value
-     INCOMPLETE. Otherwise, if at least one route among routes that
-     are aggregated has ORIGIN with the value EGP, then the aggregated
-     route must have the origin attribute with the value EGP. In all
-     other case the value of the ORIGIN attribute of the aggregated
-     route is INTERNAL. */
-  origin = BGP_ORIGIN_IGP;
+  bgp_aggregate_reset (aggregate);
 
   table = bgp->rib[afi][safi];
 
   top = bgp_node_get (table, p);
   for (rn = bgp_node_get (table, p); rn; rn = bgp_route_next_until (rn, top))
     if (rn->p.prefixlen > p->prefixlen)
-      {
-	match = 0;
-
-	for (ri = rn->info; ri; ri = ri->next)
-	  {
-	    if (BGP_INFO_HOLDDOWN (ri))
-	      continue;
-
-	    if (del && ri == del)
-	      continue;
-
-	    if (! rinew && first)
-	      {
-		nexthop = ri->attr->nexthop;
-		med = ri->attr->med;
-		first = 0;
-	      }
-
-#ifdef AGGREGATE_NEXTHOP_CHECK
-	    if (! IPV4_ADDR_SAME (&ri->attr->nexthop, &nexthop)
-		|| ri->attr->med != med)
-	      {
-		if (aspath)
-		  aspath_free (aspath);
-		if (community)
-		  community_free (community);
-		bgp_unlock_node (rn);
-		bgp_unlock_node (top);
-		return;
-	      }
-#endif /* AGGREGATE_NEXTHOP_CHECK */
-
-	    if (ri->sub_type != BGP_ROUTE_AGGREGATE)
-	      {
-		if (aggregate->summary_only)
-		  {
-		    (bgp_info_extra_get (ri))->suppress++;
-		    bgp_info_set_flag (rn, ri, BGP_INFO_ATTR_CHANGED);
-		    match++;
-		  }
-
-		aggregate->count++;
-
-		if (aggregate->as_set)
-		  {
-		    if (origin < ri->attr->origin)
-		      origin = ri->attr->origin;
-
-		    if (aspath)
-		      {
-			asmerge = aspath_aggregate (aspath, ri->attr->aspath);
-			aspath_free (aspath);
-			aspath = asmerge;
-		      }
-		    else
-		      aspath = aspath_dup (ri->attr->aspath);
-
-		    if (ri->attr->community)
-		      {
-			if (community)
-			  {
-			    commerge = community_merge (community,
-							ri->attr->community);
-			    community = community_uniq_sort (commerge);
-			    community_free (commerge);
-			  }
-			else
-			  community = community_dup (ri->attr->community);
-		      }
-		  }
-	      }
-	  }
-	if (match)
-	  bgp_process (bgp, rn, afi, safi);
-      }
+      for (ri = rn->info; ri; ri = ri->next)
+	if (BGP_AGGREGATE_CONTRIBUTES (ri))
+	  bgp_aggregate_merge (aggregate, ri->attr);
   bgp_unlock_node (top);
 
-  if (rinew)
-    {
-      aggregate->count++;
-      
-      if (aggregate->summary_only)
-        (bgp_info_extra_get (rinew))->suppress++;
-
-      if (aggregate->as_set)
-	{
-	  if (origin < rinew->attr->origin)
-	    origin = rinew->attr->origin;
+  bgp_aggregate_install (bgp, p, afi, safi, aggregate);
+}
 
-	  if (aspath)
-	    {
-	      asmerge = aspath_aggregate (aspath, rinew->attr->aspath);
-	      aspath_free (aspath);
-	      aspath = asmerge;
-	    }
-	  else
-	    aspath = aspath_dup (rinew->attr->aspath);
+/* Event: merge again every as-set aggregate which lost a contributing
+   route since the last run, once for all of them. */
+static int
+bgp_aggregate_recompute (struct thread *thread)
+{
+  struct bgp *bgp = THREAD_ARG (thread);
+  struct bgp_node *rn;
+  struct bgp_aggregate *aggregate;
+  afi_t afi;
+  safi_t safi;
 
-	  if (rinew->attr->community)
-	    {
-	      if (community)
-		{
-		  commerge = community_merge (community,
-					      rinew->attr->community);
-		  community = community_uniq_sort (commerge);
-		  community_free (commerge);
-		}
-	      else
-		community = community_dup (rinew->attr->community);
-	    }
-	}
-    }
+  bgp->t_aggregate = NULL;
 
-  if (aggregate->count > 0)
-    {
-      rn = bgp_node_get (table, p);
-      new = bgp_info_new ();
-      new->type = ZEBRA_ROUTE_BGP;
-      new->sub_type = BGP_ROUTE_AGGREGATE;
-      new->peer = bgp->peer_self;
-      SET_FLAG (new->flags, BGP_INFO_VALID);
-      new->attr = bgp_attr_aggregate_intern (bgp, origin, aspath, community, aggregate->as_set);
-      new->uptime = bgp_clock ();
+  for (afi = AFI_IP; afi < AFI_MAX; afi++)
+    for (safi = SAFI_UNICAST; safi <= SAFI_MULTICAST; safi++)
+      for (rn = bgp_table_top (bgp->aggregate[afi][safi]); rn;
+	   rn = bgp_route_next (rn))
+	if ((aggregate = rn->info) != NULL && aggregate->dirty)
+	  bgp_aggregate_remerge (bgp, &rn->p, afi, safi, aggregate);
+  return 0;
+}
 
-      bgp_info_add (rn, new);
-      bgp_unlock_node (rn);
-      bgp_process (bgp, rn, afi, safi);
-    }
-  else
-    {
-      if (aspath)
-	aspath_free (aspath);
-      if (community)
-	community_free (community);
-    }
+/* Stop a pending bgp_aggregate_recompute(), e.g. as the instance goes. */
+void
+bgp_aggregate_cancel (struct bgp *bgp)
+{
+  THREAD_OFF (bgp->t_aggregate);
 }
 
 void bgp_aggregate_delete (struct bgp *, struct prefix *, afi_t, safi_t,
 			   struct bgp_aggregate *);
 
+/* The route starts contributing to the aggregates covering it: count
+   it, suppress it for summary-only, and fold its attributes into the
+   as-set ones.  Routes already counted are left alone. */
 void
 bgp_aggregate_increment (struct bgp *bgp, struct prefix *p,
 			 struct bgp_info *ri, afi_t afi, safi_t safi)
@@ -4689,16 +6789,20 @@ bgp_aggregate_increment (struct bgp *bgp, struct prefix *p,
   if (safi == SAFI_MPLS_VPN)
     return;
 
-  table = bgp->aggregate[afi][safi];
+  if (p->prefixlen == 0)
+    return;
 
-  /* No aggregates configured. */
-  if (bgp_table_top_nolock (table) == NULL)
+  if (BGP_INFO_HOLDDOWN (ri))
     return;
 
-  if (p->prefixlen == 0)
+  if (CHECK_FLAG (ri->flags, BGP_INFO_AGGREGATED))
     return;
+  SET_FLAG (ri->flags, BGP_INFO_AGGREGATED);
 
-  if (BGP_INFO_HOLDDOWN (ri))
+  table = bgp->aggregate[afi][safi];
+
+  /* No aggregates configured. */
+  if (bgp_table_top_nolock (table) == NULL)
     return;
 
   child = bgp_node_get (table, p);
@@ -4707,12 +6811,24 @@ bgp_aggregate_increment (struct bgp *bgp, struct prefix *p,
   for (rn = child; rn; rn = bgp_node_parent_nolock (rn))
     if ((aggregate = rn->info) != NULL && rn->p.prefixlen < p->prefixlen)
       {
-	bgp_aggregate_delete (bgp, &rn->p, afi, safi, aggregate);
-	bgp_aggregate_route (bgp, &rn->p, ri, afi, safi, NULL, aggregate);
+	aggregate->count++;
+
+	if (aggregate->summary_only)
+	  (bgp_info_extra_get (ri))->suppress++;
+
+	if (aggregate->as_set && ! aggregate->dirty)
+	  bgp_aggregate_merge (aggregate, ri->attr);
+
+	if (! aggregate->dirty)
+	  bgp_aggregate_install (bgp, &rn->p, afi, safi, aggregate);
       }
   bgp_unlock_node (child);
 }
 
+/* The route stops contributing to the aggregates covering it.  What
+   it added to as-set ones can not be taken out again, those are
+   merged anew from the remaining routes, by bgp_aggregate_recompute()
+   so that many routes going at once cost one walk. */
 void
 bgp_aggregate_decrement (struct bgp *bgp, struct prefix *p, 
 			 struct bgp_info *del, afi_t afi, safi_t safi)
@@ -4726,23 +6842,41 @@ bgp_aggregate_decrement (struct bgp *bgp, struct prefix *p,
   if (safi == SAFI_MPLS_VPN)
     return;
 
+  if (! CHECK_FLAG (del->flags, BGP_INFO_AGGREGATED))
+    return;
+  UNSET_FLAG (del->flags, BGP_INFO_AGGREGATED);
+
   table = bgp->aggregate[afi][safi];
 
   /* No aggregates configured. */
   if (bgp_table_top_nolock (table) == NULL)
     return;
 
-  if (p->prefixlen == 0)
-    return;
-
   child = bgp_node_get (table, p);
 
   /* Aggregate address configuration check. */
   for (rn = child; rn; rn = bgp_node_parent_nolock (rn))
     if ((aggregate = rn->info) != NULL && rn->p.prefixlen < p->prefixlen)
       {
-	bgp_aggregate_delete (bgp, &rn->p, afi, safi, aggregate);
-	bgp_aggregate_route (bgp, &rn->p, NULL, afi, safi, del, aggregate);
+	aggregate->count--;
+
+	if (aggregate->summary_only && del->extra
+	    && --del->extra->suppress == 0)
+	  {
+	    bgp_info_set_flag (del->net, del, BGP_INFO_ATTR_CHANGED);
+	    bgp_process (bgp, del->net, afi, safi);
+	  }
+
+	if (aggregate->as_set && aggregate->count)
+	  {
+	    aggregate->dirty = 1;
+	    if (! bgp->t_aggregate)
+	      bgp->t_aggregate = thread_add_event (bm->master,
+						   bgp_aggregate_recompute,
+						   bgp, 0);
+	  }
+	else
+	  bgp_aggregate_install (bgp, &rn->p, afi, safi, aggregate);
       }
   bgp_unlock_node (child);
 }
@@ -4754,14 +6888,8 @@ bgp_aggregate_add (struct bgp *bgp, struct prefix *p, afi_t afi, safi_t safi,
   struct bgp_table *table;
   struct bgp_node *top;
   struct bgp_node *rn;
-  struct bgp_info *new;
   struct bgp_info *ri;
   unsigned long match;
-  u_char origin = BGP_ORIGIN_IGP;
-  struct aspath *aspath = NULL;
-  struct aspath *asmerge = NULL;
-  struct community *community = NULL;
-  struct community *commerge = NULL;
 
   table = bgp->rib[afi][safi];
 
@@ -4779,52 +6907,22 @@ bgp_aggregate_add (struct bgp *bgp, struct prefix *p, afi_t afi, safi_t safi,
 	match = 0;
 
 	for (ri = rn->info; ri; ri = ri->next)
-	  {
-	    if (BGP_INFO_HOLDDOWN (ri))
-	      continue;
-
-	    if (ri->sub_type != BGP_ROUTE_AGGREGATE)
-	      {
-		/* summary-only aggregate route suppress aggregated
-		   route announcement.  */
-		if (aggregate->summary_only)
-		  {
-		    (bgp_info_extra_get (ri))->suppress++;
-		    bgp_info_set_flag (rn, ri, BGP_INFO_ATTR_CHANGED);
-		    match++;
-		  }
-		/* as-set aggregate route generate origin, as path,
-		   community aggregation.  */
-		if (aggregate->as_set)
-		  {
-		    if (origin < ri->attr->origin)
-		      origin = ri->attr->origin;
-
-		    if (aspath)
-		      {
-			asmerge = aspath_aggregate (aspath, ri->attr->aspath);
-			aspath_free (aspath);
-			aspath = asmerge;
-		      }
-		    else
-		      aspath = aspath_dup (ri->attr->aspath);
-
-		    if (ri->attr->community)
-		      {
-			if (community)
-			  {
-			    commerge = community_merge (community,
-							ri->attr->community);
-			    community = community_uniq_sort (commerge);
-			    community_free (commerge);
-			  }
-			else
-			  community = community_dup (ri->attr->community);
-		      }
-		  }
-		aggregate->count++;
-	      }
-	  }
+	  if (BGP_AGGREGATE_CONTRIBUTES (ri))
+	    {
+	      /* summary-only aggregate route suppress aggregated
+		 route announcement.  */
+	      if (aggregate->summary_only)
+		{
+		  (bgp_info_extra_get (ri))->suppress++;
+		  bgp_info_set_flag (rn, ri, BGP_INFO_ATTR_CHANGED);
+		  match++;
+		}
+	      /* as-set aggregate route generate origin, as path,
+		 community aggregation.  */
+	      if (aggregate->as_set)
+		bgp_aggregate_merge (aggregate, ri->attr);
+	      aggregate->count++;
+	    }
 	
 	/* If this node is suppressed, process the change. */
 	if (match)
@@ -4833,24 +6931,7 @@ bgp_aggregate_add (struct bgp *bgp, struct prefix *p, afi_t afi, safi_t safi,
   bgp_unlock_node (top);
 
   /* Add aggregate route to BGP table. */
-  if (aggregate->count)
-    {
-      rn = bgp_node_get (table, p);
-
-      new = bgp_info_new ();
-      new->type = ZEBRA_ROUTE_BGP;
-      new->sub_type = BGP_ROUTE_AGGREGATE;
-      new->peer = bgp->peer_self;
-      SET_FLAG (new->flags, BGP_INFO_VALID);
-      new->attr = bgp_attr_aggregate_intern (bgp, origin, aspath, community, aggregate->as_set);
-      new->uptime = bgp_clock ();
-
-      bgp_info_add (rn, new);
-      bgp_unlock_node (rn);
-      
-      /* Process change. */
-      bgp_process (bgp, rn, afi, safi);
-    }
+  bgp_aggregate_install (bgp, p, afi, safi, aggregate);
 }
 
 void
@@ -4878,25 +6959,20 @@ bgp_aggregate_delete (struct bgp *bgp, struct prefix *p, afi_t afi,
 	match = 0;
 
 	for (ri = rn->info; ri; ri = ri->next)
-	  {
-	    if (BGP_INFO_HOLDDOWN (ri))
-	      continue;
-
-	    if (ri->sub_type != BGP_ROUTE_AGGREGATE)
-	      {
-		if (aggregate->summary_only && ri->extra)
-		  {
-		    ri->extra->suppress--;
+	  if (BGP_AGGREGATE_CONTRIBUTES (ri))
+	    {
+	      if (aggregate->summary_only && ri->extra)
+		{
+		  ri->extra->suppress--;
 
-		    if (ri->extra->suppress == 0)
-		      {
-			bgp_info_set_flag (rn, ri, BGP_INFO_ATTR_CHANGED);
-			match++;
-		      }
-		  }
-		aggregate->count--;
-	      }
-	  }
+		  if (ri->extra->suppress == 0)
+		    {
+		      bgp_info_set_flag (rn, ri, BGP_INFO_ATTR_CHANGED);
+		      match++;
+		    }
+		}
+	      aggregate->count--;
+	    }
 
 	/* If this node was suppressed, process the change. */
 	if (match)
@@ -4905,23 +6981,8 @@ bgp_aggregate_delete (struct bgp *bgp, struct prefix *p, afi_t afi,
   bgp_unlock_node (top);
 
   /* Delete aggregate route from BGP table. */
-  rn = bgp_node_get (table, p);
-
-  for (ri = rn->info; ri; ri = ri->next)
-    if (ri->peer == bgp->peer_self 
-	&& ri->type == ZEBRA_ROUTE_BGP
-	&& ri->sub_type == BGP_ROUTE_AGGREGATE)
-      break;
-
-  /* Withdraw static BGP route from routing table. */
-  if (ri)
-    {
-      bgp_info_delete (rn, ri);
-      bgp_process (bgp, rn, afi, safi);
-    }
-
-  /* Unlock bgp_node_lookup. */
-  bgp_unlock_node (rn);
+  aggregate->count = 0;
+  bgp_aggregate_install (bgp, p, afi, safi, aggregate);
 }
 
 /* Aggregate route attribute. */
@@ -6076,7 +8137,7 @@ route_vty_out_detail (struct vty *vty, struct bgp *bgp, struct prefix *p,
       /* Line 5 display Extended-community */
       if (attr->flag & ATTR_FLAG_BIT(BGP_ATTR_EXT_COMMUNITIES))
 	vty_out (vty, "      Extended Community: %s%s", 
-	         attr->extra->ecommunity->str, VTY_NEWLINE);
+	         ecommunity_str (attr->extra->ecommunity), VTY_NEWLINE);
 	  
       /* Line 6 display Originator, Cluster-id */
       if ((attr->flag & ATTR_FLAG_BIT(BGP_ATTR_ORIGINATOR_ID)) ||
@@ -6101,6 +8162,12 @@ route_vty_out_detail (struct vty *vty, struct bgp *bgp, struct prefix *p,
       if (binfo->extra && binfo->extra->damp_info)
 	bgp_damp_info_vty (vty, binfo);
 
+      if (bgp_rpki_enabled () && binfo->type == ZEBRA_ROUTE_BGP
+	  && binfo->sub_type == BGP_ROUTE_NORMAL)
+	vty_out (vty, "      Origin validation: %s%s",
+		 bgp_rpki_state_str (binfo->extra ? binfo->extra->rpki_state
+				     : RPKI_NOTFOUND), VTY_NEWLINE);
+
       /* Line 7 display Uptime */
 #ifdef HAVE_CLOCK_MONOTONIC
       tbuf = time(NULL) - (bgp_clock() - binfo->uptime);
@@ -6147,21 +8214,34 @@ enum bgp_show_type
   bgp_show_type_damp_neighbor
 };
 
+/* Show the routes of table, starting after the prefix after if it is
+   given, and stopping once limit prefixes are shown if limit is not 0.
+   Large tables can so be shown a bounded piece at a time.  */
 static int
-bgp_show_table (struct vty *vty, struct bgp_table *table, struct in_addr *router_id,
-	  enum bgp_show_type type, void *output_arg)
+bgp_show_table_range (struct vty *vty, struct bgp_table *table,
+                      struct in_addr *router_id, enum bgp_show_type type,
+                      void *output_arg, struct prefix *after,
+                      unsigned long limit)
 {
   struct bgp_info *ri;
   struct bgp_node *rn;
   int header = 1;
   int display;
   unsigned long output_count;
+  char buf[INET6_ADDRSTRLEN];
 
   /* This is first entry point, so reset total line. */
   output_count = 0;
 
+  /* The prefix to start after need not be in the table: getting its
+     node makes the walk start at its successor either way. */
+  if (after)
+    rn = bgp_route_next (bgp_node_get (table, after));
+  else
+    rn = bgp_table_top (table);
+
   /* Start processing of routes. */
-  for (rn = bgp_table_top (table); rn; rn = bgp_route_next (rn)) 
+  for (; rn; rn = bgp_route_next (rn)) 
     if (rn->info != NULL)
       {
 	display = 0;
@@ -6356,6 +8436,17 @@ bgp_show_table (struct vty *vty, struct bgp_table *table, struct in_addr *router
 	  }
 	if (display)
 	  output_count++;
+
+	if (limit && output_count == limit)
+	  {
+	    vty_out (vty, "%sLimit reached, continue after %s/%d%s",
+		     VTY_NEWLINE,
+		     inet_ntop (rn->p.family, &rn->p.u.prefix, buf,
+				INET6_ADDRSTRLEN),
+		     rn->p.prefixlen, VTY_NEWLINE);
+	    bgp_unlock_node (rn);
+	    break;
+	  }
       }
 
   /* No route is displayed */
@@ -6371,6 +8462,14 @@ bgp_show_table (struct vty *vty, struct bgp_table *table, struct in_addr *router
   return CMD_SUCCESS;
 }
 
+static int
+bgp_show_table (struct vty *vty, struct bgp_table *table, struct in_addr *router_id,
+	  enum bgp_show_type type, void *output_arg)
+{
+  return bgp_show_table_range (vty, table, router_id, type, output_arg,
+                               NULL, 0);
+}
+
 static int
 bgp_show (struct vty *vty, struct bgp *bgp, afi_t afi, safi_t safi,
          enum bgp_show_type type, void *output_arg)
@@ -6393,6 +8492,39 @@ bgp_show (struct vty *vty, struct bgp *bgp, afi_t afi, safi_t safi,
   return bgp_show_table (vty, table, &bgp->router_id, type, output_arg);
 }
 
+/* Show a piece of the default instance's table of afi; see
+   bgp_show_table_range.  */
+static int
+bgp_show_range_vty (struct vty *vty, afi_t afi, const char *after_str,
+                    const char *limit_str)
+{
+  struct bgp *bgp;
+  struct prefix after;
+  unsigned long limit;
+
+  bgp = bgp_get_default ();
+  if (bgp == NULL)
+    {
+      vty_out (vty, "No BGP process is configured%s", VTY_NEWLINE);
+      return CMD_WARNING;
+    }
+
+  if (after_str && (! str2prefix (after_str, &after)
+                    || after.family != afi2family (afi)))
+    {
+      vty_out (vty, "%% Malformed prefix%s", VTY_NEWLINE);
+      return CMD_WARNING;
+    }
+  if (after_str)
+    apply_mask (&after);
+
+  VTY_GET_ULONG ("limit", limit, limit_str);
+
+  return bgp_show_table_range (vty, bgp->rib[afi][SAFI_UNICAST],
+                               &bgp->router_id, bgp_show_type_normal, NULL,
+                               after_str ? &after : NULL, limit);
+}
+
 /* Header of detailed BGP route information */
 static void
 route_vty_out_detail_header (struct vty *vty, struct bgp *bgp,
@@ -6615,6 +8747,32 @@ DEFUN (show_ip_bgp,
   return bgp_show (vty, NULL, AFI_IP, SAFI_UNICAST, bgp_show_type_normal, NULL);
 }
 
+DEFUN (show_ip_bgp_limit,
+       show_ip_bgp_limit_cmd,
+       "show ip bgp limit <1-4294967295>",
+       SHOW_STR
+       IP_STR
+       BGP_STR
+       "Show at most this many prefixes\n"
+       "Number of prefixes\n")
+{
+  return bgp_show_range_vty (vty, AFI_IP, NULL, argv[0]);
+}
+
+DEFUN (show_ip_bgp_after_limit,
+       show_ip_bgp_after_limit_cmd,
+       "show ip bgp after A.B.C.D/M limit <1-4294967295>",
+       SHOW_STR
+       IP_STR
+       BGP_STR
+       "Start after this prefix\n"
+       "IP prefix <network>/<length>, e.g., 35.0.0.0/8\n"
+       "Show at most this many prefixes\n"
+       "Number of prefixes\n")
+{
+  return bgp_show_range_vty (vty, AFI_IP, argv[0], argv[1]);
+}
+
 DEFUN (show_ip_bgp_ipv4,
        show_ip_bgp_ipv4_cmd,
        "show ip bgp ipv4 (unicast|multicast)",
@@ -6848,6 +9006,30 @@ DEFUN (show_bgp,
                    NULL);
 }
 
+DEFUN (show_bgp_limit,
+       show_bgp_limit_cmd,
+       "show bgp limit <1-4294967295>",
+       SHOW_STR
+       BGP_STR
+       "Show at most this many prefixes\n"
+       "Number of prefixes\n")
+{
+  return bgp_show_range_vty (vty, AFI_IP6, NULL, argv[0]);
+}
+
+DEFUN (show_bgp_after_limit,
+       show_bgp_after_limit_cmd,
+       "show bgp after X:X::X:X/M limit <1-4294967295>",
+       SHOW_STR
+       BGP_STR
+       "Start after this prefix\n"
+       "IPv6 prefix <network>/<length>\n"
+       "Show at most this many prefixes\n"
+       "Number of prefixes\n")
+{
+  return bgp_show_range_vty (vty, AFI_IP6, argv[0], argv[1]);
+}
+
 ALIAS (show_bgp,
        show_bgp_ipv6_cmd,
        "show bgp ipv6",
@@ -9253,6 +11435,8 @@ enum bgp_stats
   BGP_STATS_ASPATH_MAXSIZE,
   BGP_STATS_ASPATH_TOTSIZE,
   BGP_STATS_ASN_HIGHEST,
+  BGP_STATS_SELECT_FAST,
+  BGP_STATS_SELECT_FULL,
   BGP_STATS_MAX,
 };
 
@@ -9271,6 +11455,8 @@ static const char *table_stats_strs[] =
   [BGP_STATS_ASPATH_TOTHOPS]      = "Average AS-Path length (hops)",
   [BGP_STATS_ASPATH_TOTSIZE]      = "Average AS-Path size (bytes)",
   [BGP_STATS_ASN_HIGHEST]         = "Highest public ASN",
+  [BGP_STATS_SELECT_FAST]         = "Incremental path selections",
+  [BGP_STATS_SELECT_FULL]         = "Full path selections",
   [BGP_STATS_MAX] = NULL,
 };
 
@@ -9400,8 +11586,26 @@ bgp_table_stats_walker (struct thread *t)
   return 0;
 }
 
+/* Is the statistic kept by the table itself, so that it can be shown
+   without walking the table? */
 static int
-bgp_table_stats (struct vty *vty, struct bgp *bgp, afi_t afi, safi_t safi)
+bgp_table_stats_kept (unsigned int i)
+{
+  switch (i)
+    {
+      case BGP_STATS_PREFIXES:
+      case BGP_STATS_TOTPLEN:
+      case BGP_STATS_RIB:
+      case BGP_STATS_SELECT_FAST:
+      case BGP_STATS_SELECT_FULL:
+        return 1;
+    }
+  return 0;
+}
+
+static int
+bgp_table_stats (struct vty *vty, struct bgp *bgp, afi_t afi, safi_t safi,
+                 int detail)
 {
   struct bgp_table_stats ts;
   unsigned int i;
@@ -9414,7 +11618,16 @@ bgp_table_stats (struct vty *vty, struct bgp *bgp, afi_t afi, safi_t safi)
   
   memset (&ts, 0, sizeof (ts));
   ts.table = bgp->rib[afi][safi];
-  thread_execute (bm->master, bgp_table_stats_walker, &ts, 0);
+  if (detail)
+    thread_execute (bm->master, bgp_table_stats_walker, &ts, 0);
+  else
+    {
+      ts.counts[BGP_STATS_PREFIXES] = ts.table->prefix_count;
+      ts.counts[BGP_STATS_TOTPLEN] = ts.table->prefixlen_total;
+      ts.counts[BGP_STATS_RIB] = ts.table->path_count;
+    }
+  ts.counts[BGP_STATS_SELECT_FAST] = ts.table->select_fast;
+  ts.counts[BGP_STATS_SELECT_FULL] = ts.table->select_full;
 
   vty_out (vty, "BGP %s RIB statistics%s%s",
            afi_safi_print (afi, safi), VTY_NEWLINE, VTY_NEWLINE);
@@ -9423,6 +11636,9 @@ bgp_table_stats (struct vty *vty, struct bgp *bgp, afi_t afi, safi_t safi)
     {
       if (!table_stats_strs[i])
         continue;
+
+      if (!detail && !bgp_table_stats_kept (i))
+        continue;
       
       switch (i)
         {
@@ -9486,7 +11702,7 @@ bgp_table_stats (struct vty *vty, struct bgp *bgp, afi_t afi, safi_t safi)
 
 static int
 bgp_table_stats_vty (struct vty *vty, const char *name,
-                     const char *afi_str, const char *safi_str)
+                     const char *afi_str, const char *safi_str, int detail)
 {
   struct bgp *bgp;
   afi_t afi;
@@ -9534,7 +11750,7 @@ bgp_table_stats_vty (struct vty *vty, const char *name,
       return CMD_WARNING;
     }
 
-  return bgp_table_stats (vty, bgp, afi, safi);
+  return bgp_table_stats (vty, bgp, afi, safi, detail);
 }
 
 DEFUN (show_bgp_statistics,
@@ -9548,7 +11764,7 @@ DEFUN (show_bgp_statistics,
        "Address Family modifier\n"
        "BGP RIB advertisement statistics\n")
 {
-  return bgp_table_stats_vty (vty, NULL, argv[0], argv[1]);
+  return bgp_table_stats_vty (vty, NULL, argv[0], argv[1], 0);
 }
 
 ALIAS (show_bgp_statistics,
@@ -9572,7 +11788,7 @@ DEFUN (show_bgp_statistics_view,
        "Address Family modifier\n"
        "BGP RIB advertisement statistics\n")
 {
-  return bgp_table_stats_vty (vty, NULL, argv[0], argv[1]);
+  return bgp_table_stats_vty (vty, NULL, argv[0], argv[1], 0);
 }
 
 ALIAS (show_bgp_statistics_view,
@@ -9585,6 +11801,31 @@ ALIAS (show_bgp_statistics_view,
        "Address Family modifier\n"
        "BGP RIB advertisement statistics\n")
 
+DEFUN (show_bgp_statistics_detail,
+       show_bgp_statistics_detail_cmd,
+       "show bgp (ipv4|ipv6) (unicast|multicast) statistics detail",
+       SHOW_STR
+       BGP_STR
+       "Address family\n"
+       "Address family\n"
+       "Address Family modifier\n"
+       "Address Family modifier\n"
+       "BGP RIB advertisement statistics\n"
+       "Walk the RIB for statistics not kept as it changes\n")
+{
+  return bgp_table_stats_vty (vty, NULL, argv[0], argv[1], 1);
+}
+
+ALIAS (show_bgp_statistics_detail,
+       show_bgp_statistics_detail_vpnv4_cmd,
+       "show bgp (ipv4) (vpnv4) statistics detail",
+       SHOW_STR
+       BGP_STR
+       "Address family\n"
+       "Address Family modifier\n"
+       "BGP RIB advertisement statistics\n"
+       "Walk the RIB for statistics not kept as it changes\n")
+
 enum bgp_pcounts
 {
   PCOUNT_ADJ_IN = 0,
@@ -9629,12 +11870,10 @@ bgp_peer_count_walker (struct thread *t)
   
   for (rn = bgp_table_top (pc->table); rn; rn = bgp_route_next (rn))
     {
-      struct bgp_adj_in *ain;
       struct bgp_info *ri;
       
-      for (ain = rn->adj_in; ain; ain = ain->next)
-        if (ain->peer == peer)
-          pc->count[PCOUNT_ADJ_IN]++;
+      if (bgp_adj_in_attr (rn, peer))
+        pc->count[PCOUNT_ADJ_IN]++;
 
       for (ri = rn->info; ri; ri = ri->next)
         {
@@ -9825,7 +12064,7 @@ show_adj_route (struct vty *vty, struct peer *peer, afi_t afi, safi_t safi,
 		int in)
 {
   struct bgp_table *table;
-  struct bgp_adj_in *ain;
+  struct attr *attr;
   struct bgp_adj_out *adj;
   unsigned long output_count;
   struct bgp_node *rn;
@@ -9857,8 +12096,7 @@ show_adj_route (struct vty *vty, struct peer *peer, afi_t afi, safi_t safi,
   for (rn = bgp_table_top (table); rn; rn = bgp_route_next (rn))
     if (in)
       {
-	for (ain = rn->adj_in; ain; ain = ain->next)
-	  if (ain->peer == peer)
+	if ((attr = bgp_adj_in_attr (rn, peer)) != NULL)
 	    {
 	      if (header1)
 		{
@@ -9872,11 +12110,8 @@ show_adj_route (struct vty *vty, struct peer *peer, afi_t afi, safi_t safi,
 		  vty_out (vty, BGP_SHOW_HEADER, VTY_NEWLINE);
 		  header2 = 0;
 		}
-	      if (ain->attr)
-		{ 
-		  route_vty_out_tmp (vty, &rn->p, ain->attr, safi);
-		  output_count++;
-		}
+	      route_vty_out_tmp (vty, &rn->p, attr, safi);
+	      output_count++;
 	    }
       }
     else
@@ -12476,6 +14711,8 @@ bgp_route_init (void)
   install_element (BGP_IPV4M_NODE, &no_aggregate_address_mask_summary_as_set_cmd);
 
   install_element (VIEW_NODE, &show_ip_bgp_cmd);
+  install_element (VIEW_NODE, &show_ip_bgp_limit_cmd);
+  install_element (VIEW_NODE, &show_ip_bgp_after_limit_cmd);
   install_element (VIEW_NODE, &show_ip_bgp_ipv4_cmd);
   install_element (VIEW_NODE, &show_bgp_ipv4_safi_cmd);
   install_element (VIEW_NODE, &show_ip_bgp_route_cmd);
@@ -12609,6 +14846,8 @@ bgp_route_init (void)
   install_element (RESTRICTED_NODE, &show_bgp_view_ipv4_safi_rsclient_prefix_cmd);
 
   install_element (ENABLE_NODE, &show_ip_bgp_cmd);
+  install_element (ENABLE_NODE, &show_ip_bgp_limit_cmd);
+  install_element (ENABLE_NODE, &show_ip_bgp_after_limit_cmd);
   install_element (ENABLE_NODE, &show_ip_bgp_ipv4_cmd);
   install_element (ENABLE_NODE, &show_bgp_ipv4_safi_cmd);
   install_element (ENABLE_NODE, &show_ip_bgp_route_cmd);
@@ -12736,6 +14975,8 @@ bgp_route_init (void)
   install_element (BGP_NODE, &old_no_ipv6_aggregate_address_summary_only_cmd);
 
   install_element (VIEW_NODE, &show_bgp_cmd);
+  install_element (VIEW_NODE, &show_bgp_limit_cmd);
+  install_element (VIEW_NODE, &show_bgp_after_limit_cmd);
   install_element (VIEW_NODE, &show_bgp_ipv6_cmd);
   install_element (VIEW_NODE, &show_bgp_ipv6_safi_cmd);
   install_element (VIEW_NODE, &show_bgp_route_cmd);
@@ -12860,6 +15101,8 @@ bgp_route_init (void)
   install_element (RESTRICTED_NODE, &show_bgp_view_ipv6_safi_rsclient_prefix_cmd);
 
   install_element (ENABLE_NODE, &show_bgp_cmd);
+  install_element (ENABLE_NODE, &show_bgp_limit_cmd);
+  install_element (ENABLE_NODE, &show_bgp_after_limit_cmd);
   install_element (ENABLE_NODE, &show_bgp_ipv6_cmd);
   install_element (ENABLE_NODE, &show_bgp_ipv6_safi_cmd);
   install_element (ENABLE_NODE, &show_bgp_route_cmd);
@@ -12948,6 +15191,8 @@ bgp_route_init (void)
   install_element (ENABLE_NODE, &show_bgp_statistics_vpnv4_cmd);
   install_element (ENABLE_NODE, &show_bgp_statistics_view_cmd);
   install_element (ENABLE_NODE, &show_bgp_statistics_view_vpnv4_cmd);
+  install_element (ENABLE_NODE, &show_bgp_statistics_detail_cmd);
+  install_element (ENABLE_NODE, &show_bgp_statistics_detail_vpnv4_cmd);
   
   /* old command */
   install_element (VIEW_NODE, &show_ipv6_bgp_cmd);
@@ -13117,4 +15362,8 @@ bgp_route_finish (void)
 {
   bgp_table_unlock (bgp_distance_table);
   bgp_distance_table = NULL;
+
+  if (bgp_info_keys)
+    XFREE (MTYPE_BGP_INFO_KEY, bgp_info_keys);
+  bgp_info_keys_size = 0;
 }
@@ -40,6 +40,9 @@ struct bgp_info_extra
 
   /* MPLS label.  */
   u_char tag[3];  
+
+  /* Origin validation state, see bgp_rpki.h.  */
+  u_char rpki_state;
 };
 
 struct bgp_info
@@ -61,9 +64,26 @@ struct bgp_info
   /* Multipath information */
   struct bgp_info_mpath *mpath;
 
+  /* Route node this path hangs off. */
+  struct bgp_node *net;
+
+  /* The peer's other paths in the address family, see
+     bgp_clear_route(). */
+  struct bgp_info *peer_next;
+  struct bgp_info **peer_prev;
+
+  /* Nexthop cache entry the path was resolved over, and the other
+     paths resolved over it. */
+  struct bgp_nexthop_cache *nexthop_cache;
+  struct bgp_info *nh_next;
+  struct bgp_info *nh_prev;
+
   /* Uptime.  */
   time_t uptime;
 
+  /* Path identifier for peers the path is sent to with ADD-PATH. */
+  u_int32_t addpath_tx_id;
+
   /* reference count */
   int lock;
   
@@ -82,6 +102,8 @@ struct bgp_info
 #define BGP_INFO_COUNTED	(1 << 10)
 #define BGP_INFO_MULTIPATH      (1 << 11)
 #define BGP_INFO_MULTIPATH_CHG  (1 << 12)
+#define BGP_INFO_ADJ_IN         (1 << 13)
+#define BGP_INFO_AGGREGATED     (1 << 14)
 
   /* BGP route type.  This can be static, RIP, OSPF, BGP etc.  */
   u_char type;
@@ -174,9 +196,15 @@ extern void bgp_route_init (void);
 extern void bgp_route_finish (void);
 extern void bgp_cleanup_routes (void);
 extern void bgp_announce_route (struct peer *, afi_t, safi_t);
+extern void bgp_announce_route_refresh (struct peer *, afi_t, safi_t);
+extern void bgp_announce_route_prefixes (struct peer *, afi_t, safi_t,
+                                         struct route_table *);
 extern void bgp_announce_route_all (struct peer *);
+extern int bgp_announce_pending (struct peer *, afi_t, safi_t);
 extern void bgp_default_originate (struct peer *, afi_t, safi_t, int);
 extern void bgp_soft_reconfig_in (struct peer *, afi_t, safi_t);
+extern void bgp_rpki_revalidate (struct bgp *, struct bgp_table *,
+				 struct prefix *, afi_t, safi_t);
 extern void bgp_soft_reconfig_rsclient (struct peer *, afi_t, safi_t);
 extern void bgp_check_local_routes_rsclient (struct peer *rsclient, afi_t afi, safi_t safi);
 extern void bgp_clear_route (struct peer *, afi_t, safi_t,
@@ -184,14 +212,24 @@ extern void bgp_clear_route (struct peer *, afi_t, safi_t,
 extern void bgp_clear_route_all (struct peer *);
 extern void bgp_clear_adj_in (struct peer *, afi_t, safi_t);
 extern void bgp_clear_stale_route (struct peer *, afi_t, safi_t);
+extern void bgp_rib_in_view_fill (struct bgp *);
+extern void bgp_rib_in_view_flush (struct bgp *);
+extern void bgp_update_delay_begin (struct bgp *);
+extern void bgp_update_delay_end (struct bgp *);
+extern void bgp_update_delay_check (struct bgp *);
+extern void bgp_update_stale (struct peer *, struct prefix *, struct attr *,
+                              afi_t, safi_t);
 
 extern struct bgp_info *bgp_info_lock (struct bgp_info *);
 extern struct bgp_info *bgp_info_unlock (struct bgp_info *);
 extern void bgp_info_add (struct bgp_node *rn, struct bgp_info *ri);
+extern struct bgp *bgp_node_bgp (struct bgp_node *, struct peer *);
 extern void bgp_info_delete (struct bgp_node *rn, struct bgp_info *ri);
 extern struct bgp_info_extra *bgp_info_extra_get (struct bgp_info *);
 extern void bgp_info_set_flag (struct bgp_node *, struct bgp_info *, u_int32_t);
 extern void bgp_info_unset_flag (struct bgp_node *, struct bgp_info *, u_int32_t);
+extern int bgp_info_preferred (struct bgp *, struct bgp_info *,
+			       struct bgp_info *);
 
 extern int bgp_nlri_sanity_check (struct peer *, int, u_char *, bgp_size_t);
 extern int bgp_nlri_parse (struct peer *, struct attr *, struct bgp_nlri *);
@@ -224,6 +262,7 @@ extern int bgp_withdraw (struct peer *, struct prefix *, struct attr *,
 
 /* for bgp_nexthop and bgp_damp */
 extern void bgp_process (struct bgp *, struct bgp_node *, afi_t, safi_t);
+extern void bgp_fib_result (struct bgp *, struct bgp_node *, afi_t, u_char);
 extern int bgp_config_write_network (struct vty *, struct bgp *, afi_t, safi_t, int *);
 extern int bgp_config_write_distance (struct vty *, struct bgp *);
 
@@ -231,9 +270,15 @@ extern void bgp_aggregate_increment (struct bgp *, struct prefix *, struct bgp_i
 			      afi_t, safi_t);
 extern void bgp_aggregate_decrement (struct bgp *, struct prefix *, struct bgp_info *,
 			      afi_t, safi_t);
+extern void bgp_aggregate_cancel (struct bgp *);
 
 extern u_char bgp_distance_apply (struct prefix *, struct bgp_info *, struct bgp *);
 
+extern int bgp_route_map_apply (struct bgp *, struct route_map *,
+				struct prefix *, struct bgp_info *);
+extern void bgp_rmap_cache_flush (void);
+extern int bgp_route_map_peer_independent (struct route_map *);
+
 extern afi_t bgp_node_afi (struct vty *);
 extern safi_t bgp_node_safi (struct vty *);
 
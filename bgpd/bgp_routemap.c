@@ -39,6 +39,8 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #endif /* HAVE_LIBPCREPOSIX */
 #include "buffer.h"
 #include "sockunion.h"
+#include "hash.h"
+#include "jhash.h"
 
 #include "bgpd/bgpd.h"
 #include "bgpd/bgp_table.h"
@@ -52,6 +54,7 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #include "bgpd/bgp_mplsvpn.h"
 #include "bgpd/bgp_ecommunity.h"
 #include "bgpd/bgp_vty.h"
+#include "bgpd/bgp_rpki.h"
 
 /* Memo of route-map commands.
 
@@ -383,12 +386,19 @@ route_match_ip_address_prefix_list_free (void *rule)
   XFREE (MTYPE_ROUTE_MAP_COMPILED, rule);
 }
 
+static struct prefix_list *
+route_match_ip_address_prefix_list_plist (void *rule)
+{
+  return prefix_list_lookup (AFI_IP, (char *) rule);
+}
+
 struct route_map_rule_cmd route_match_ip_address_prefix_list_cmd =
 {
   "ip address prefix-list",
   route_match_ip_address_prefix_list,
   route_match_ip_address_prefix_list_compile,
-  route_match_ip_address_prefix_list_free
+  route_match_ip_address_prefix_list_free,
+  route_match_ip_address_prefix_list_plist
 };
 
 /* `match ip next-hop prefix-list PREFIX_LIST' */
@@ -793,6 +803,62 @@ struct route_map_rule_cmd route_match_origin_cmd =
   route_match_origin_free
 };
 
+/* `match rpki' */
+
+/* The state is computed rather than read off the path, as inbound
+   policy runs before there is one. */
+static route_map_result_t
+route_match_rpki (void *rule, struct prefix *prefix, 
+		  route_map_object_t type, void *object)
+{
+  int *state;
+  struct bgp_info *bgp_info;
+
+  if (type == RMAP_BGP)
+    {
+      state = rule;
+      bgp_info = object;
+
+      if (bgp_rpki_validate (prefix, bgp_info->peer, bgp_info->attr)
+	  == *state)
+	return RMAP_MATCH;
+    }
+
+  return RMAP_NOMATCH;
+}
+
+static void *
+route_match_rpki_compile (const char *arg)
+{
+  int *state;
+
+  state = XMALLOC (MTYPE_ROUTE_MAP_COMPILED, sizeof (int));
+
+  if (strcmp (arg, "valid") == 0)
+    *state = RPKI_VALID;
+  else if (strcmp (arg, "invalid") == 0)
+    *state = RPKI_INVALID;
+  else
+    *state = RPKI_NOTFOUND;
+
+  return state;
+}
+
+static void
+route_match_rpki_free (void *rule)
+{
+  XFREE (MTYPE_ROUTE_MAP_COMPILED, rule);
+}
+
+/* Route map commands for origin validation state matching. */
+struct route_map_rule_cmd route_match_rpki_cmd =
+{
+  "rpki",
+  route_match_rpki,
+  route_match_rpki_compile,
+  route_match_rpki_free
+};
+
 /* match probability  { */
 
 static route_map_result_t
@@ -1950,12 +2016,19 @@ route_match_ipv6_address_prefix_list_free (void *rule)
   XFREE (MTYPE_ROUTE_MAP_COMPILED, rule);
 }
 
+static struct prefix_list *
+route_match_ipv6_address_prefix_list_plist (void *rule)
+{
+  return prefix_list_lookup (AFI_IP6, (char *) rule);
+}
+
 struct route_map_rule_cmd route_match_ipv6_address_prefix_list_cmd =
 {
   "ipv6 address prefix-list",
   route_match_ipv6_address_prefix_list,
   route_match_ipv6_address_prefix_list_compile,
-  route_match_ipv6_address_prefix_list_free
+  route_match_ipv6_address_prefix_list_free,
+  route_match_ipv6_address_prefix_list_plist
 };
 
 /* `set ipv6 nexthop global IP_ADDRESS' */
@@ -2389,6 +2462,12 @@ bgp_route_map_update (const char *unused)
 			 route_map_lookup_by_name (bgp_static->rmap.name);
 		else
 		  bgp_static->rmap.map = NULL;
+
+		/* Static routes are no longer re-announced periodically,
+		   apply the changed route-map now. */
+		if (safi != SAFI_MPLS_VPN && bgp_static->rmap.name
+		    && bgp_static->valid && ! bgp_static->backdoor)
+		  bgp_static_update (bgp, &bn->p, bgp_static, afi, safi);
 	      }
     }
 
@@ -2409,6 +2488,256 @@ bgp_route_map_update (const char *unused)
     }
 }
 
+/* Route-map results cache.
+
+   Most routes from a peer share one interned attribute, and applying a
+   route map that only looks at and changes attributes gives the same
+   result for each of them.  So with "bgp route-map cache" configured,
+   the result of such a route map for an attribute is kept, together
+   with the interned attribute it produced, and reused.
+
+   A cache entry is keyed on the route map and the attribute it was
+   applied to.  Route maps are only cached when all of their rules, and
+   those of the maps they call, are in bgp_rmap_cache_rules below: the
+   prefix, the peer and chance must not come into it.  The whole cache
+   is dropped when any route map, or any list they refer to, changes. */
+#define BGP_RMAP_CACHE_MAX 32768
+
+struct bgp_rmap_cache
+{
+  struct route_map *map;
+
+  /* Attribute the map was applied to, and what it made of it, if it
+     did not deny.  Both interned. */
+  struct attr *in;
+  struct attr *out;
+
+  route_map_result_t ret;
+};
+
+struct bgp_rmap_cache_map
+{
+  struct route_map *map;
+  int cacheable;
+};
+
+static struct hash *bgp_rmap_cache;
+static struct hash *bgp_rmap_cache_maps;
+static unsigned long bgp_rmap_cache_version;
+
+static struct route_map_rule_cmd *bgp_rmap_cache_rules[] =
+{
+  &route_match_ip_next_hop_cmd,
+  &route_match_ip_next_hop_prefix_list_cmd,
+  &route_match_metric_cmd,
+  &route_match_aspath_cmd,
+  &route_match_community_cmd,
+  &route_match_ecommunity_cmd,
+  &route_match_origin_cmd,
+  &route_set_local_pref_cmd,
+  &route_set_weight_cmd,
+  &route_set_metric_cmd,
+  &route_set_aspath_prepend_cmd,
+  &route_set_aspath_exclude_cmd,
+  &route_set_community_cmd,
+  &route_set_community_delete_cmd,
+  &route_set_ecommunity_rt_cmd,
+  &route_set_ecommunity_soo_cmd,
+  &route_set_origin_cmd,
+  &route_set_atomic_aggregate_cmd,
+  &route_set_aggregator_as_cmd,
+  &route_set_vpnv4_nexthop_cmd,
+  &route_set_originator_id_cmd,
+#ifdef HAVE_IPV6
+  &route_match_ipv6_next_hop_cmd,
+  &route_set_ipv6_nexthop_global_cmd,
+  &route_set_ipv6_nexthop_local_cmd,
+#endif /* HAVE_IPV6 */
+};
+
+static int
+bgp_rmap_cache_rule_check (struct route_map_rule_cmd *cmd, void *value)
+{
+  unsigned int i;
+
+  /* Unless it is the peer's address. */
+  if (cmd == &route_set_ip_nexthop_cmd)
+    return ! ((struct rmap_ip_nexthop_set *) value)->peer_address;
+
+  for (i = 0; i < sizeof (bgp_rmap_cache_rules) / sizeof (bgp_rmap_cache_rules[0]); i++)
+    if (cmd == bgp_rmap_cache_rules[i])
+      return 1;
+  return 0;
+}
+
+/* Rules which go by the peer of the route, the peer announced to for
+   outbound policy. */
+static int
+bgp_route_map_peer_rule_check (struct route_map_rule_cmd *cmd, void *value)
+{
+  if (cmd == &route_set_ip_nexthop_cmd)
+    return ! ((struct rmap_ip_nexthop_set *) value)->peer_address;
+
+  return (cmd != &route_match_peer_cmd
+	  && cmd != &route_match_ip_route_source_cmd
+	  && cmd != &route_match_ip_route_source_prefix_list_cmd
+	  && cmd != &route_match_rpki_cmd
+	  && cmd != &route_match_probability_cmd);
+}
+
+/* Whether the route map comes out the same for a route whichever peer
+   it is announced to. */
+int
+bgp_route_map_peer_independent (struct route_map *map)
+{
+  return ! map || route_map_check_rules (map, bgp_route_map_peer_rule_check);
+}
+
+static unsigned int
+bgp_rmap_cache_key (void *arg)
+{
+  const struct bgp_rmap_cache *entry = arg;
+
+  return jhash_2words ((uintptr_t) entry->map,
+		       attrhash_key_make (entry->in), 0);
+}
+
+static int
+bgp_rmap_cache_cmp (const void *arg1, const void *arg2)
+{
+  const struct bgp_rmap_cache *entry1 = arg1;
+  const struct bgp_rmap_cache *entry2 = arg2;
+
+  return entry1->map == entry2->map && attrhash_cmp (entry1->in, entry2->in);
+}
+
+static unsigned int
+bgp_rmap_cache_map_key (void *arg)
+{
+  const struct bgp_rmap_cache_map *cmap = arg;
+
+  return jhash_1word ((uintptr_t) cmap->map, 0);
+}
+
+static int
+bgp_rmap_cache_map_cmp (const void *arg1, const void *arg2)
+{
+  const struct bgp_rmap_cache_map *cmap1 = arg1;
+  const struct bgp_rmap_cache_map *cmap2 = arg2;
+
+  return cmap1->map == cmap2->map;
+}
+
+static void *
+bgp_rmap_cache_map_alloc (void *arg)
+{
+  struct bgp_rmap_cache_map *cmap;
+
+  cmap = XMALLOC (MTYPE_BGP_RMAP_CACHE, sizeof (struct bgp_rmap_cache_map));
+  cmap->map = ((struct bgp_rmap_cache_map *) arg)->map;
+  cmap->cacheable = route_map_check_rules (cmap->map,
+					   bgp_rmap_cache_rule_check);
+  return cmap;
+}
+
+static void
+bgp_rmap_cache_free (void *arg)
+{
+  struct bgp_rmap_cache *entry = arg;
+
+  bgp_attr_unintern (&entry->in);
+  if (entry->out)
+    bgp_attr_unintern (&entry->out);
+  XFREE (MTYPE_BGP_RMAP_CACHE, entry);
+}
+
+static void
+bgp_rmap_cache_map_free (void *arg)
+{
+  XFREE (MTYPE_BGP_RMAP_CACHE, arg);
+}
+
+/* Drop all cached route-map results. */
+void
+bgp_rmap_cache_flush (void)
+{
+  if (bgp_rmap_cache)
+    {
+      hash_clean (bgp_rmap_cache, bgp_rmap_cache_free);
+      hash_free (bgp_rmap_cache);
+      bgp_rmap_cache = NULL;
+    }
+  if (bgp_rmap_cache_maps)
+    {
+      hash_clean (bgp_rmap_cache_maps, bgp_rmap_cache_map_free);
+      hash_free (bgp_rmap_cache_maps);
+      bgp_rmap_cache_maps = NULL;
+    }
+}
+
+/* Apply a route map to a route, like route_map_apply(), through the
+   cache when the BGP instance has it enabled.  Returns a
+   route_map_result_t. */
+int
+bgp_route_map_apply (struct bgp *bgp, struct route_map *map,
+		     struct prefix *p, struct bgp_info *info)
+{
+  struct bgp_rmap_cache key;
+  struct bgp_rmap_cache *entry;
+  struct bgp_rmap_cache_map ckey;
+  struct bgp_rmap_cache_map *cmap;
+  route_map_result_t ret;
+
+  if (! map || ! bgp_flag_check (bgp, BGP_FLAG_RMAP_CACHE))
+    return route_map_apply (map, p, RMAP_BGP, info);
+
+  if (bgp_rmap_cache_version != route_map_version ())
+    {
+      bgp_rmap_cache_flush ();
+      bgp_rmap_cache_version = route_map_version ();
+    }
+
+  if (! bgp_rmap_cache)
+    {
+      bgp_rmap_cache = hash_create_size (BGP_RMAP_CACHE_MAX / 8,
+					 bgp_rmap_cache_key,
+					 bgp_rmap_cache_cmp);
+      bgp_rmap_cache_maps = hash_create (bgp_rmap_cache_map_key,
+					 bgp_rmap_cache_map_cmp);
+    }
+
+  ckey.map = map;
+  cmap = hash_get (bgp_rmap_cache_maps, &ckey, bgp_rmap_cache_map_alloc);
+  if (! cmap->cacheable)
+    return route_map_apply (map, p, RMAP_BGP, info);
+
+  key.map = map;
+  key.in = info->attr;
+  entry = hash_lookup (bgp_rmap_cache, &key);
+  if (entry)
+    {
+      if (entry->out)
+	bgp_attr_dup (info->attr, entry->out);
+      return entry->ret;
+    }
+
+  if (bgp_rmap_cache->count >= BGP_RMAP_CACHE_MAX)
+    hash_clean (bgp_rmap_cache, bgp_rmap_cache_free);
+
+  entry = XCALLOC (MTYPE_BGP_RMAP_CACHE, sizeof (struct bgp_rmap_cache));
+  entry->map = map;
+  entry->in = bgp_attr_intern (info->attr);
+
+  ret = route_map_apply (map, p, RMAP_BGP, info);
+
+  entry->ret = ret;
+  if (ret != RMAP_DENYMATCH)
+    entry->out = bgp_attr_intern (info->attr);
+  hash_get (bgp_rmap_cache, entry, hash_alloc_intern);
+
+  return ret;
+}
+
 DEFUN (match_peer,
        match_peer_cmd,
        "match peer (A.B.C.D|X:X::X:X)",
@@ -2915,6 +3244,45 @@ ALIAS (no_match_origin,
        "local IGP\n"
        "unknown heritage\n")
 
+DEFUN (match_rpki,
+       match_rpki_cmd,
+       "match rpki (valid|invalid|notfound)",
+       MATCH_STR
+       "Origin validation state\n"
+       "Covered by a ROA of the origin AS\n"
+       "Covered by ROAs, none of the origin AS\n"
+       "Not covered by any ROA\n")
+{
+  if (strncmp (argv[0], "valid", 1) == 0)
+    return bgp_route_match_add (vty, vty->index, "rpki", "valid");
+  if (strncmp (argv[0], "invalid", 1) == 0)
+    return bgp_route_match_add (vty, vty->index, "rpki", "invalid");
+  if (strncmp (argv[0], "notfound", 1) == 0)
+    return bgp_route_match_add (vty, vty->index, "rpki", "notfound");
+
+  return CMD_WARNING;
+}
+
+DEFUN (no_match_rpki,
+       no_match_rpki_cmd,
+       "no match rpki",
+       NO_STR
+       MATCH_STR
+       "Origin validation state\n")
+{
+  return bgp_route_match_delete (vty, vty->index, "rpki", NULL);
+}
+
+ALIAS (no_match_rpki,
+       no_match_rpki_val_cmd,
+       "no match rpki (valid|invalid|notfound)",
+       NO_STR
+       MATCH_STR
+       "Origin validation state\n"
+       "Covered by a ROA of the origin AS\n"
+       "Covered by ROAs, none of the origin AS\n"
+       "Not covered by any ROA\n")
+
 DEFUN (set_ip_nexthop,
        set_ip_nexthop_cmd,
        "set ip next-hop A.B.C.D",
@@ -3855,6 +4223,7 @@ bgp_route_map_init (void)
   route_map_install_match (&route_match_ecommunity_cmd);
   route_map_install_match (&route_match_metric_cmd);
   route_map_install_match (&route_match_origin_cmd);
+  route_map_install_match (&route_match_rpki_cmd);
   route_map_install_match (&route_match_probability_cmd);
 
   route_map_install_set (&route_set_ip_nexthop_cmd);
@@ -3914,6 +4283,9 @@ bgp_route_map_init (void)
   install_element (RMAP_NODE, &match_origin_cmd);
   install_element (RMAP_NODE, &no_match_origin_cmd);
   install_element (RMAP_NODE, &no_match_origin_val_cmd);
+  install_element (RMAP_NODE, &match_rpki_cmd);
+  install_element (RMAP_NODE, &no_match_rpki_cmd);
+  install_element (RMAP_NODE, &no_match_rpki_val_cmd);
   install_element (RMAP_NODE, &match_probability_cmd);
   install_element (RMAP_NODE, &no_match_probability_cmd);
   install_element (RMAP_NODE, &no_match_probability_val_cmd);
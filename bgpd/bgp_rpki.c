@@ -0,0 +1,924 @@
+/* BGP prefix origin validation (RFC 6811) with an RPKI-RTR cache.
+   Copyright (C) 2026 The Quagga project
+
+This file is part of GNU Zebra.
+
+GNU Zebra is free software; you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation; either version 2, or (at your option) any
+later version.
+
+GNU Zebra is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with GNU Zebra; see the file COPYING.  If not, write to the Free
+Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+02111-1307, USA.  */
+
+/* bgpd connects out to the configured RPKI cache and keeps the ROAs it
+   is given, by RPKI-RTR version 0 (RFC 6810), in a route table per
+   address family: each node holds the ROAs for its prefix, with their
+   max-length and origin AS.  The ROAs covering a prefix are then on the
+   path from its longest match to the top of the table, so validating a
+   route costs about its prefix length whatever the number of ROAs.
+
+   A path's state is computed as it is received and kept on its
+   bgp_info_extra, where "match rpki" and "show ip bgp" find it.  The
+   prefixes of ROAs announced or withdrawn are noted as the cache sends
+   them, and at End of Data only the routes within those prefixes are
+   validated again: a path whose state changed is processed as if its
+   attributes had, and sent through inbound policy again if that could
+   look at the state and soft-reconfiguration inbound kept what the
+   peer sent.  */
+
+#include <zebra.h>
+
+#include "log.h"
+#include "prefix.h"
+#include "sockunion.h"
+#include "command.h"
+#include "thread.h"
+#include "linklist.h"
+#include "memory.h"
+#include "network.h"
+#include "table.h"
+
+#include "bgpd/bgpd.h"
+#include "bgpd/bgp_table.h"
+#include "bgpd/bgp_route.h"
+#include "bgpd/bgp_attr.h"
+#include "bgpd/bgp_aspath.h"
+#include "bgpd/bgp_rpki.h"
+
+#define RPKI_RTR_VERSION          0
+#define RPKI_PORT_DEFAULT         323
+#define RPKI_RECONNECT_TIME       30
+#define RPKI_POLLING_DEFAULT      300
+
+/* PDU types. */
+#define RTR_SERIAL_NOTIFY         0
+#define RTR_SERIAL_QUERY          1
+#define RTR_RESET_QUERY           2
+#define RTR_CACHE_RESPONSE        3
+#define RTR_IPV4_PREFIX           4
+#define RTR_IPV6_PREFIX           6
+#define RTR_END_OF_DATA           7
+#define RTR_CACHE_RESET           8
+#define RTR_ERROR_REPORT          10
+
+#define RTR_HEADER_SIZE           8
+#define RTR_IPV4_PREFIX_SIZE      20
+#define RTR_IPV6_PREFIX_SIZE      32
+#define RTR_SERIAL_SIZE           12
+#define RTR_FLAG_ANNOUNCE         0x01
+
+/* Largest PDU taken, which only an Error Report with long texts would
+   get near. */
+#define RTR_PDU_MAX               4096
+#define RTR_BUF_SIZE              (RTR_PDU_MAX * 4)
+
+enum rpki_state
+{
+  RPKI_IDLE,
+  RPKI_CONNECTING,
+  RPKI_UP
+};
+
+static const char *rpki_state_str[] = { "Idle", "Connecting", "Up" };
+
+struct rpki_cache
+{
+  union sockunion su;
+  u_int16_t port;
+
+  int fd;
+  enum rpki_state state;
+  u_char ibuf[RTR_BUF_SIZE];
+  size_t ilen;
+
+  struct thread *t_connect;
+  struct thread *t_read;
+  struct thread *t_poll;
+
+  /* Session and serial of the data held, once the first End of Data
+     gave them. */
+  u_int16_t session;
+  u_int32_t serial;
+  int synced;
+
+  /* Between Cache Response and End of Data, and whether the data is a
+     full set answering a Reset Query. */
+  int loading;
+  int reset;
+
+  time_t uptime;
+  time_t updated;
+  unsigned long connects;
+  unsigned long resets;
+};
+
+/* ROA of a node of the ROA table. */
+struct rpki_roa
+{
+  struct rpki_roa *next;
+  as_t as;
+  u_char maxlen;
+
+  /* Not yet sent again by a cache resending everything. */
+  u_char stale;
+};
+
+static struct rpki_cache *rpki_cache;
+static int rpki_polling_period = RPKI_POLLING_DEFAULT;
+
+/* ROAs by prefix, and how many. */
+static struct route_table *rpki_roas[AFI_MAX];
+static unsigned long rpki_roa_count[AFI_MAX];
+
+/* Prefixes of the ROAs changed since routes were last validated. */
+static struct route_table *rpki_changed[AFI_MAX];
+
+static void rpki_reset (struct rpki_cache *);
+
+static const char *
+rpki_name (struct rpki_cache *c)
+{
+  static char buf[SU_ADDRSTRLEN];
+
+  return sockunion2str (&c->su, buf, sizeof (buf));
+}
+
+const char *
+bgp_rpki_state_str (int state)
+{
+  switch (state)
+    {
+    case RPKI_VALID:
+      return "valid";
+    case RPKI_INVALID:
+      return "invalid";
+    default:
+      return "not found";
+    }
+}
+
+/* Whether there is a cache or any ROA, so states mean anything. */
+int
+bgp_rpki_enabled (void)
+{
+  return rpki_cache || rpki_roa_count[AFI_IP] || rpki_roa_count[AFI_IP6];
+}
+
+/* The origin validation state of a route to p with attr from peer. */
+int
+bgp_rpki_validate (struct prefix *p, struct peer *peer, struct attr *attr)
+{
+  struct route_node *top;
+  struct route_node *rn;
+  struct rpki_roa *roa;
+  as_t origin = 0;
+  afi_t afi;
+  int state;
+
+  afi = family2afi (p->family);
+  if ((afi != AFI_IP && afi != AFI_IP6) || ! rpki_roa_count[afi])
+    return RPKI_NOTFOUND;
+
+  /* Routes from within the confederation have our AS as origin, ones
+     ending in a set have none, which no ROA matches. */
+  if (aspath_origin_as (attr->aspath, &origin) == 0)
+    origin = peer->bgp->confed_id ? peer->bgp->confed_id : peer->bgp->as;
+
+  top = route_node_match (rpki_roas[afi], p);
+  if (! top)
+    return RPKI_NOTFOUND;
+
+  state = RPKI_INVALID;
+  for (rn = top; rn; rn = rn->parent)
+    for (roa = rn->info; roa; roa = roa->next)
+      if (origin && roa->as == origin && p->prefixlen <= roa->maxlen)
+	{
+	  state = RPKI_VALID;
+	  goto done;
+	}
+
+ done:
+  route_unlock_node (top);
+  return state;
+}
+
+/* ROA table. */
+
+static void
+rpki_changed_add (afi_t afi, struct prefix *p)
+{
+  struct route_node *rn;
+
+  if (! rpki_changed[afi])
+    rpki_changed[afi] = route_table_init ();
+
+  rn = route_node_get (rpki_changed[afi], p);
+  if (rn->info)
+    route_unlock_node (rn);
+  else
+    rn->info = rpki_changed[afi];
+}
+
+static void
+rpki_roa_add (afi_t afi, struct prefix *p, u_char maxlen, as_t as)
+{
+  struct route_node *rn;
+  struct rpki_roa *roa;
+
+  rn = route_node_get (rpki_roas[afi], p);
+  if (rn->info)
+    route_unlock_node (rn);
+
+  for (roa = rn->info; roa; roa = roa->next)
+    if (roa->as == as && roa->maxlen == maxlen)
+      {
+	roa->stale = 0;
+	return;
+      }
+
+  roa = XCALLOC (MTYPE_BGP_RPKI_ROA, sizeof (struct rpki_roa));
+  roa->as = as;
+  roa->maxlen = maxlen;
+  roa->next = rn->info;
+  rn->info = roa;
+  rpki_roa_count[afi]++;
+
+  rpki_changed_add (afi, p);
+}
+
+static void
+rpki_roa_delete (afi_t afi, struct route_node *rn, struct rpki_roa **roap)
+{
+  struct rpki_roa *roa = *roap;
+
+  *roap = roa->next;
+  XFREE (MTYPE_BGP_RPKI_ROA, roa);
+  rpki_roa_count[afi]--;
+
+  rpki_changed_add (afi, &rn->p);
+
+  if (! rn->info)
+    route_unlock_node (rn);
+}
+
+static void
+rpki_roa_withdraw (afi_t afi, struct prefix *p, u_char maxlen, as_t as)
+{
+  struct route_node *rn;
+  struct rpki_roa **roap;
+
+  rn = route_node_lookup (rpki_roas[afi], p);
+  if (! rn)
+    return;
+  route_unlock_node (rn);
+
+  for (roap = (struct rpki_roa **) &rn->info; *roap; roap = &(*roap)->next)
+    if ((*roap)->as == as && (*roap)->maxlen == maxlen)
+      {
+	rpki_roa_delete (afi, rn, roap);
+	return;
+      }
+}
+
+/* Mark all ROAs stale, or not. */
+static void
+rpki_roa_stale_set (int stale)
+{
+  struct route_node *rn;
+  struct rpki_roa *roa;
+  afi_t afi;
+
+  for (afi = AFI_IP; afi < AFI_MAX; afi++)
+    for (rn = route_top (rpki_roas[afi]); rn; rn = route_next (rn))
+      for (roa = rn->info; roa; roa = roa->next)
+	roa->stale = stale;
+}
+
+/* Drop the stale ROAs, or all of them. */
+static void
+rpki_roa_sweep (int all)
+{
+  struct route_node *rn;
+  struct route_node *next;
+  struct rpki_roa **roap;
+  afi_t afi;
+
+  for (afi = AFI_IP; afi < AFI_MAX; afi++)
+    for (rn = route_top (rpki_roas[afi]); rn; rn = next)
+      {
+	/* Keep the node while its last ROA goes. */
+	route_lock_node (rn);
+	for (roap = (struct rpki_roa **) &rn->info; *roap; )
+	  if (all || (*roap)->stale)
+	    rpki_roa_delete (afi, rn, roap);
+	  else
+	    roap = &(*roap)->next;
+	next = route_next (rn);
+	route_unlock_node (rn);
+      }
+}
+
+/* Validate again the routes within the prefixes of changed ROAs, each
+   route once however many of the prefixes cover it. */
+static void
+rpki_revalidate (void)
+{
+  struct route_node *rn;
+  struct route_node *covered = NULL;
+  struct bgp *bgp;
+  struct peer *peer;
+  struct listnode *node, *pnode;
+  afi_t afi;
+
+  for (afi = AFI_IP; afi < AFI_MAX; afi++)
+    {
+      if (! rpki_changed[afi])
+	continue;
+
+      for (rn = route_top (rpki_changed[afi]); rn; rn = route_next (rn))
+	{
+	  if (! rn->info
+	      || (covered && prefix_match (&covered->p, &rn->p)))
+	    continue;
+	  covered = rn;
+
+	  for (ALL_LIST_ELEMENTS_RO (bm->bgp, node, bgp))
+	    {
+	      bgp_rpki_revalidate (bgp, bgp->rib[afi][SAFI_UNICAST], &rn->p,
+				   afi, SAFI_UNICAST);
+	      for (ALL_LIST_ELEMENTS_RO (bgp->rsclient, pnode, peer))
+		if (peer->rib[afi][SAFI_UNICAST])
+		  bgp_rpki_revalidate (bgp, peer->rib[afi][SAFI_UNICAST],
+				       &rn->p, afi, SAFI_UNICAST);
+	    }
+	}
+
+      route_table_finish (rpki_changed[afi]);
+      rpki_changed[afi] = NULL;
+      covered = NULL;
+    }
+}
+
+/* RPKI-RTR. */
+
+static void
+rpki_send (struct rpki_cache *c, u_char type, u_int16_t session,
+	   int serial)
+{
+  u_char buf[RTR_SERIAL_SIZE];
+  u_int16_t w;
+  u_int32_t l;
+  size_t len = serial ? RTR_SERIAL_SIZE : RTR_HEADER_SIZE;
+
+  buf[0] = RPKI_RTR_VERSION;
+  buf[1] = type;
+  w = htons (session);
+  memcpy (buf + 2, &w, 2);
+  l = htonl (len);
+  memcpy (buf + 4, &l, 4);
+  l = htonl (c->serial);
+  memcpy (buf + 8, &l, 4);
+
+  if (write (c->fd, buf, len) != (ssize_t) len)
+    {
+      zlog_warn ("RPKI cache %s: write failed: %s", rpki_name (c),
+		 safe_strerror (errno));
+      rpki_reset (c);
+    }
+}
+
+/* Ask for what changed since the data held, or for everything. */
+static void
+rpki_query (struct rpki_cache *c)
+{
+  if (c->synced)
+    rpki_send (c, RTR_SERIAL_QUERY, c->session, 1);
+  else
+    {
+      c->reset = 1;
+      rpki_send (c, RTR_RESET_QUERY, 0, 0);
+    }
+}
+
+static int
+rpki_poll (struct thread *thread)
+{
+  struct rpki_cache *c = THREAD_ARG (thread);
+
+  c->t_poll = NULL;
+  if (c->state == RPKI_UP && ! c->loading)
+    rpki_query (c);
+  return 0;
+}
+
+static void
+rpki_prefix_pdu (struct rpki_cache *c, u_char *pdu, afi_t afi)
+{
+  struct prefix p;
+  u_char flags = pdu[8];
+  u_char maxlen = pdu[10];
+  u_int32_t as;
+  size_t alen = (afi == AFI_IP ? IPV4_MAX_BYTELEN : IPV6_MAX_BYTELEN);
+
+  memset (&p, 0, sizeof (struct prefix));
+  p.family = afi2family (afi);
+  p.prefixlen = pdu[9];
+  memcpy (&p.u.prefix, pdu + 12, alen);
+  memcpy (&as, pdu + 12 + alen, 4);
+  as = ntohl (as);
+
+  if (p.prefixlen > alen * 8 || maxlen > alen * 8 || maxlen < p.prefixlen)
+    {
+      zlog_warn ("RPKI cache %s: malformed prefix PDU", rpki_name (c));
+      return;
+    }
+  apply_mask (&p);
+
+  if (flags & RTR_FLAG_ANNOUNCE)
+    rpki_roa_add (afi, &p, maxlen, as);
+  else
+    rpki_roa_withdraw (afi, &p, maxlen, as);
+}
+
+/* Take one PDU.  Returns -1 if the connection was reset. */
+static int
+rpki_pdu (struct rpki_cache *c, u_char *pdu, u_int32_t len)
+{
+  u_int16_t session;
+  u_int32_t serial;
+
+  memcpy (&session, pdu + 2, 2);
+  session = ntohs (session);
+
+  if (pdu[0] != RPKI_RTR_VERSION)
+    {
+      zlog_warn ("RPKI cache %s: unsupported version %d", rpki_name (c),
+		 pdu[0]);
+      rpki_reset (c);
+      return -1;
+    }
+
+  switch (pdu[1])
+    {
+    case RTR_SERIAL_NOTIFY:
+      if (! c->loading)
+	{
+	  THREAD_OFF (c->t_poll);
+	  c->t_poll = thread_add_event (master, rpki_poll, c, 0);
+	}
+      break;
+
+    case RTR_CACHE_RESPONSE:
+      c->loading = 1;
+      c->session = session;
+      if (c->reset)
+	rpki_roa_stale_set (1);
+      break;
+
+    case RTR_IPV4_PREFIX:
+    case RTR_IPV6_PREFIX:
+      if (pdu[1] == RTR_IPV4_PREFIX ? len != RTR_IPV4_PREFIX_SIZE
+	  : len != RTR_IPV6_PREFIX_SIZE)
+	goto malformed;
+      if (c->loading)
+	rpki_prefix_pdu (c, pdu,
+			 pdu[1] == RTR_IPV4_PREFIX ? AFI_IP : AFI_IP6);
+      break;
+
+    case RTR_END_OF_DATA:
+      if (len < RTR_SERIAL_SIZE)
+	goto malformed;
+      memcpy (&serial, pdu + 8, 4);
+      c->serial = ntohl (serial);
+      c->session = session;
+      c->synced = 1;
+      c->loading = 0;
+      if (c->reset)
+	rpki_roa_sweep (0);
+      c->reset = 0;
+      c->updated = bgp_clock ();
+      rpki_revalidate ();
+
+      THREAD_OFF (c->t_poll);
+      c->t_poll = thread_add_timer (master, rpki_poll, c,
+				    rpki_polling_period);
+      break;
+
+    case RTR_CACHE_RESET:
+      c->synced = 0;
+      rpki_query (c);
+      break;
+
+    case RTR_ERROR_REPORT:
+      zlog_warn ("RPKI cache %s: error report, code %d", rpki_name (c),
+		 session);
+      rpki_reset (c);
+      return -1;
+
+    default:
+      zlog_warn ("RPKI cache %s: unknown PDU type %d", rpki_name (c), pdu[1]);
+      break;
+    }
+  return 0;
+
+ malformed:
+  zlog_warn ("RPKI cache %s: malformed PDU type %d", rpki_name (c), pdu[1]);
+  rpki_reset (c);
+  return -1;
+}
+
+static int
+rpki_read (struct thread *thread)
+{
+  struct rpki_cache *c = THREAD_ARG (thread);
+  ssize_t nbytes;
+  u_int32_t len;
+  size_t off;
+
+  c->t_read = NULL;
+
+  nbytes = read (c->fd, c->ibuf + c->ilen, sizeof (c->ibuf) - c->ilen);
+  if (nbytes == 0 || (nbytes < 0 && ! ERRNO_IO_RETRY (errno)))
+    {
+      zlog_info ("RPKI cache %s closed the connection", rpki_name (c));
+      rpki_reset (c);
+      return 0;
+    }
+  if (nbytes > 0)
+    c->ilen += nbytes;
+
+  for (off = 0; c->ilen - off >= RTR_HEADER_SIZE; off += len)
+    {
+      memcpy (&len, c->ibuf + off + 4, 4);
+      len = ntohl (len);
+      if (len < RTR_HEADER_SIZE || len > RTR_PDU_MAX)
+	{
+	  zlog_warn ("RPKI cache %s: bad PDU length %u", rpki_name (c), len);
+	  rpki_reset (c);
+	  return 0;
+	}
+      if (c->ilen - off < len)
+	break;
+      if (rpki_pdu (c, c->ibuf + off, len) < 0)
+	return 0;
+    }
+
+  memmove (c->ibuf, c->ibuf + off, c->ilen - off);
+  c->ilen -= off;
+
+  c->t_read = thread_add_read (master, rpki_read, c, c->fd);
+  return 0;
+}
+
+static void
+rpki_up (struct rpki_cache *c)
+{
+  zlog_info ("RPKI cache %s connected", rpki_name (c));
+
+  c->state = RPKI_UP;
+  c->uptime = bgp_clock ();
+  c->connects++;
+  c->ilen = 0;
+  c->t_read = thread_add_read (master, rpki_read, c, c->fd);
+
+  rpki_query (c);
+}
+
+static int rpki_connect (struct thread *);
+
+static int
+rpki_connect_check (struct thread *thread)
+{
+  struct rpki_cache *c = THREAD_ARG (thread);
+  int status = 0;
+  socklen_t slen = sizeof (status);
+
+  c->t_connect = NULL;
+
+  if (getsockopt (c->fd, SOL_SOCKET, SO_ERROR, &status, &slen) < 0)
+    status = errno;
+  if (status)
+    {
+      zlog_info ("RPKI cache %s: connect failed: %s",
+		 rpki_name (c), safe_strerror (status));
+      rpki_reset (c);
+      return 0;
+    }
+
+  rpki_up (c);
+  return 0;
+}
+
+static int
+rpki_connect (struct thread *thread)
+{
+  struct rpki_cache *c = THREAD_ARG (thread);
+
+  c->t_connect = NULL;
+
+  c->fd = sockunion_socket (&c->su);
+  if (c->fd < 0)
+    {
+      rpki_reset (c);
+      return 0;
+    }
+
+  switch (sockunion_connect (c->fd, &c->su, htons (c->port), 0))
+    {
+    case connect_error:
+      zlog_info ("RPKI cache %s: connect failed: %s",
+		 rpki_name (c), safe_strerror (errno));
+      rpki_reset (c);
+      break;
+    case connect_success:
+      rpki_up (c);
+      break;
+    case connect_in_progress:
+      c->state = RPKI_CONNECTING;
+      c->t_connect = thread_add_write (master, rpki_connect_check, c, c->fd);
+      break;
+    }
+  return 0;
+}
+
+/* Drop the connection, keeping the ROAs: they stay good until the
+   cache can be asked again. */
+static void
+rpki_close (struct rpki_cache *c)
+{
+  THREAD_OFF (c->t_connect);
+  THREAD_OFF (c->t_read);
+  THREAD_OFF (c->t_poll);
+  if (c->fd >= 0)
+    close (c->fd);
+  c->fd = -1;
+  c->ilen = 0;
+  c->state = RPKI_IDLE;
+
+  /* A full set cut short must not sweep what it did not get to. */
+  if (c->loading && c->reset)
+    rpki_roa_stale_set (0);
+  c->loading = 0;
+  c->reset = 0;
+}
+
+static void
+rpki_reset (struct rpki_cache *c)
+{
+  if (c->state == RPKI_UP)
+    c->resets++;
+  rpki_close (c);
+  c->t_connect = thread_add_timer (master, rpki_connect, c,
+				   RPKI_RECONNECT_TIME);
+}
+
+/* Forget the cache, and the ROAs it gave. */
+static void
+rpki_cache_delete (void)
+{
+  if (! rpki_cache)
+    return;
+
+  rpki_close (rpki_cache);
+  XFREE (MTYPE_BGP_RPKI, rpki_cache);
+  rpki_cache = NULL;
+
+  rpki_roa_sweep (1);
+  rpki_revalidate ();
+}
+
+/* Configuration. */
+
+DEFUN (rpki_cache_server,
+       rpki_cache_server_cmd,
+       "rpki cache (A.B.C.D|X:X::X:X) <1-65535>",
+       "Resource Public Key Infrastructure\n"
+       "Validate route origins with ROAs from an RPKI-RTR cache\n"
+       "Cache IPv4 address\n"
+       "Cache IPv6 address\n"
+       "Cache TCP port\n")
+{
+  union sockunion su;
+  u_int16_t port;
+
+  if (str2sockunion (argv[0], &su) < 0)
+    {
+      vty_out (vty, "%% Malformed address: %s%s", argv[0], VTY_NEWLINE);
+      return CMD_WARNING;
+    }
+  port = RPKI_PORT_DEFAULT;
+  if (argc > 1)
+    VTY_GET_INTEGER_RANGE ("port", port, argv[1], 1, 65535);
+
+  if (rpki_cache && sockunion_same (&rpki_cache->su, &su)
+      && rpki_cache->port == port)
+    return CMD_SUCCESS;
+
+  /* A different cache has its own serials, so start from a full set,
+     keeping the ROAs in use until it has been received. */
+  if (rpki_cache)
+    {
+      rpki_close (rpki_cache);
+      rpki_cache->synced = 0;
+    }
+  else
+    rpki_cache = XCALLOC (MTYPE_BGP_RPKI, sizeof (struct rpki_cache));
+
+  rpki_cache->su = su;
+  rpki_cache->port = port;
+  rpki_cache->fd = -1;
+  rpki_cache->state = RPKI_IDLE;
+  rpki_cache->t_connect = thread_add_event (master, rpki_connect,
+					    rpki_cache, 0);
+  return CMD_SUCCESS;
+}
+
+ALIAS (rpki_cache_server,
+       rpki_cache_server_default_port_cmd,
+       "rpki cache (A.B.C.D|X:X::X:X)",
+       "Resource Public Key Infrastructure\n"
+       "Validate route origins with ROAs from an RPKI-RTR cache\n"
+       "Cache IPv4 address\n"
+       "Cache IPv6 address\n")
+
+DEFUN (no_rpki_cache_server,
+       no_rpki_cache_server_cmd,
+       "no rpki cache",
+       NO_STR
+       "Resource Public Key Infrastructure\n"
+       "Validate route origins with ROAs from an RPKI-RTR cache\n")
+{
+  rpki_cache_delete ();
+  return CMD_SUCCESS;
+}
+
+ALIAS (no_rpki_cache_server,
+       no_rpki_cache_server_arg_cmd,
+       "no rpki cache (A.B.C.D|X:X::X:X) [<1-65535>]",
+       NO_STR
+       "Resource Public Key Infrastructure\n"
+       "Validate route origins with ROAs from an RPKI-RTR cache\n"
+       "Cache IPv4 address\n"
+       "Cache IPv6 address\n"
+       "Cache TCP port\n")
+
+DEFUN (rpki_polling_period_set,
+       rpki_polling_period_cmd,
+       "rpki polling-period <1-86400>",
+       "Resource Public Key Infrastructure\n"
+       "Interval between queries to the cache\n"
+       "Seconds\n")
+{
+  VTY_GET_INTEGER_RANGE ("polling period", rpki_polling_period, argv[0],
+			 1, 86400);
+  return CMD_SUCCESS;
+}
+
+DEFUN (no_rpki_polling_period,
+       no_rpki_polling_period_cmd,
+       "no rpki polling-period [<1-86400>]",
+       NO_STR
+       "Resource Public Key Infrastructure\n"
+       "Interval between queries to the cache\n"
+       "Seconds\n")
+{
+  rpki_polling_period = RPKI_POLLING_DEFAULT;
+  return CMD_SUCCESS;
+}
+
+DEFUN (show_rpki_cache_connection,
+       show_rpki_cache_connection_cmd,
+       "show rpki cache-connection",
+       SHOW_STR
+       "Resource Public Key Infrastructure\n"
+       "Connection to the RPKI-RTR cache\n")
+{
+  struct rpki_cache *c = rpki_cache;
+  char timebuf[BGP_UPTIME_LEN];
+
+  if (! c)
+    {
+      vty_out (vty, "No RPKI cache is configured%s", VTY_NEWLINE);
+      return CMD_SUCCESS;
+    }
+
+  vty_out (vty, "RPKI cache %s port %u, %s", rpki_name (c), c->port,
+	   rpki_state_str[c->state]);
+  if (c->state == RPKI_UP)
+    vty_out (vty, " for %s%s",
+	     peer_uptime (c->uptime, timebuf, BGP_UPTIME_LEN),
+	     c->loading ? ", loading" : "");
+  vty_out (vty, "%s", VTY_NEWLINE);
+  if (c->synced)
+    vty_out (vty, "  session %u, serial %u, updated %s ago%s", c->session,
+	     c->serial, peer_uptime (c->updated, timebuf, BGP_UPTIME_LEN),
+	     VTY_NEWLINE);
+  vty_out (vty, "  %lu IPv4 ROAs, %lu IPv6 ROAs%s", rpki_roa_count[AFI_IP],
+	   rpki_roa_count[AFI_IP6], VTY_NEWLINE);
+  vty_out (vty, "  %lu connects, %lu resets%s", c->connects, c->resets,
+	   VTY_NEWLINE);
+  return CMD_SUCCESS;
+}
+
+DEFUN (show_rpki_prefix_table,
+       show_rpki_prefix_table_cmd,
+       "show rpki prefix-table",
+       SHOW_STR
+       "Resource Public Key Infrastructure\n"
+       "ROAs received from the cache\n")
+{
+  struct route_node *rn;
+  struct rpki_roa *roa;
+  char addr[INET6_ADDRSTRLEN];
+  char buf[BUFSIZ];
+  afi_t afi;
+
+  vty_out (vty, "%-43s %-10s %s%s", "Prefix", "Max", "Origin-AS",
+	   VTY_NEWLINE);
+  for (afi = AFI_IP; afi < AFI_MAX; afi++)
+    for (rn = route_top (rpki_roas[afi]); rn; rn = route_next (rn))
+      for (roa = rn->info; roa; roa = roa->next)
+	{
+	  snprintf (buf, sizeof (buf), "%s/%d",
+		    inet_ntop (rn->p.family, &rn->p.u.prefix, addr,
+			       INET6_ADDRSTRLEN),
+		    rn->p.prefixlen);
+	  vty_out (vty, "%-43s %-10d %u%s", buf, roa->maxlen, roa->as,
+		   VTY_NEWLINE);
+	}
+  vty_out (vty, "%sTotal number of ROAs %lu%s", VTY_NEWLINE,
+	   rpki_roa_count[AFI_IP] + rpki_roa_count[AFI_IP6], VTY_NEWLINE);
+  return CMD_SUCCESS;
+}
+
+int
+bgp_rpki_config_write (struct vty *vty)
+{
+  int write = 0;
+
+  if (rpki_cache)
+    {
+      if (rpki_cache->port == RPKI_PORT_DEFAULT)
+	vty_out (vty, "rpki cache %s%s", rpki_name (rpki_cache),
+		 VTY_NEWLINE);
+      else
+	vty_out (vty, "rpki cache %s %u%s", rpki_name (rpki_cache),
+		 rpki_cache->port, VTY_NEWLINE);
+      write++;
+    }
+  if (rpki_polling_period != RPKI_POLLING_DEFAULT)
+    {
+      vty_out (vty, "rpki polling-period %d%s", rpki_polling_period,
+	       VTY_NEWLINE);
+      write++;
+    }
+  return write;
+}
+
+void
+bgp_rpki_init (void)
+{
+  rpki_roas[AFI_IP] = route_table_init ();
+  rpki_roas[AFI_IP6] = route_table_init ();
+
+  install_element (CONFIG_NODE, &rpki_cache_server_cmd);
+  install_element (CONFIG_NODE, &rpki_cache_server_default_port_cmd);
+  install_element (CONFIG_NODE, &no_rpki_cache_server_cmd);
+  install_element (CONFIG_NODE, &no_rpki_cache_server_arg_cmd);
+  install_element (CONFIG_NODE, &rpki_polling_period_cmd);
+  install_element (CONFIG_NODE, &no_rpki_polling_period_cmd);
+  install_element (VIEW_NODE, &show_rpki_cache_connection_cmd);
+  install_element (ENABLE_NODE, &show_rpki_cache_connection_cmd);
+  install_element (VIEW_NODE, &show_rpki_prefix_table_cmd);
+  install_element (ENABLE_NODE, &show_rpki_prefix_table_cmd);
+}
+
+void
+bgp_rpki_finish (void)
+{
+  afi_t afi;
+
+  if (rpki_cache)
+    {
+      rpki_close (rpki_cache);
+      XFREE (MTYPE_BGP_RPKI, rpki_cache);
+      rpki_cache = NULL;
+    }
+
+  rpki_roa_sweep (1);
+  for (afi = AFI_IP; afi < AFI_MAX; afi++)
+    {
+      route_table_finish (rpki_roas[afi]);
+      rpki_roas[afi] = NULL;
+      route_table_finish (rpki_changed[afi]);
+      rpki_changed[afi] = NULL;
+    }
+}
@@ -0,0 +1,37 @@
+/* BGP prefix origin validation (RFC 6811) with an RPKI-RTR cache.
+   Copyright (C) 2026 The Quagga project
+
+This file is part of GNU Zebra.
+
+GNU Zebra is free software; you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation; either version 2, or (at your option) any
+later version.
+
+GNU Zebra is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with GNU Zebra; see the file COPYING.  If not, write to the Free
+Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+02111-1307, USA.  */
+
+#ifndef _QUAGGA_BGP_RPKI_H
+#define _QUAGGA_BGP_RPKI_H
+
+/* Origin validation states.  NotFound is 0, what paths without
+   bgp_info_extra have. */
+#define RPKI_NOTFOUND             0
+#define RPKI_VALID                1
+#define RPKI_INVALID              2
+
+extern void bgp_rpki_init (void);
+extern void bgp_rpki_finish (void);
+extern int bgp_rpki_config_write (struct vty *);
+extern int bgp_rpki_enabled (void);
+extern int bgp_rpki_validate (struct prefix *, struct peer *, struct attr *);
+extern const char *bgp_rpki_state_str (int);
+
+#endif /* _QUAGGA_BGP_RPKI_H */
@@ -0,0 +1,638 @@
+/* BGP RIB snapshot.
+   Copyright (C) 2026 The Quagga project
+
+This file is part of GNU Zebra.
+
+GNU Zebra is free software; you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation; either version 2, or (at your option) any
+later version.
+
+GNU Zebra is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with GNU Zebra; see the file COPYING.  If not, write to the Free
+Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+02111-1307, USA.  */
+
+/* A RIB snapshot keeps the paths learnt from peers by the default
+   instance across a restart of bgpd.  It is written when bgpd stops,
+   and every interval if one is set.  When bgpd starts it reloads the
+   snapshot into the RIB before any session is up, with every path
+   marked stale, so the tables are full and can be announced from the
+   start instead of from whenever the last peer has sent its table.
+   As each peer comes up and resends its routes the stale marks go,
+   and whatever it does not resend is removed on its End-of-RIB or
+   when the graceful restart stalepath timer runs out, just as for a
+   peer that restarted itself.
+
+   The file holds a header and then one record per path, each the
+   path's address family, peer, prefix and attributes after inbound
+   policy, all in network byte order.  Unknown transitive attributes
+   are not kept.  Records for peers no longer configured for the
+   address family are skipped.  */
+
+#include <zebra.h>
+
+#include "log.h"
+#include "prefix.h"
+#include "sockunion.h"
+#include "command.h"
+#include "thread.h"
+#include "linklist.h"
+#include "stream.h"
+#include "memory.h"
+
+#include "bgpd/bgpd.h"
+#include "bgpd/bgp_table.h"
+#include "bgpd/bgp_route.h"
+#include "bgpd/bgp_attr.h"
+#include "bgpd/bgp_aspath.h"
+#include "bgpd/bgp_community.h"
+#include "bgpd/bgp_ecommunity.h"
+#include "bgpd/bgp_fsm.h"
+#include "bgpd/bgp_debug.h"
+#include "bgpd/bgp_snapshot.h"
+
+#define BGP_SNAPSHOT_MAGIC   0x51425253	/* "QBRS" */
+#define BGP_SNAPSHOT_VERSION 1
+
+/* Largest record, well over what a path can carry after a 4096 byte
+   UPDATE has been widened to 4-byte ASNs. */
+#define BGP_SNAPSHOT_RECORD_MAX 65536
+
+static const struct
+{
+  afi_t afi;
+  safi_t safi;
+} bgp_snapshot_afs[] =
+{
+  { AFI_IP,  SAFI_UNICAST },
+  { AFI_IP,  SAFI_MULTICAST },
+#ifdef HAVE_IPV6
+  { AFI_IP6, SAFI_UNICAST },
+  { AFI_IP6, SAFI_MULTICAST },
+#endif /* HAVE_IPV6 */
+};
+#define BGP_SNAPSHOT_AFS (sizeof (bgp_snapshot_afs) / sizeof (bgp_snapshot_afs[0]))
+
+static char *bgp_snapshot_path;
+static int bgp_snapshot_interval;
+static struct thread *t_bgp_snapshot;
+static struct stream *bgp_snapshot_s;
+
+static time_t bgp_snapshot_saved;
+static unsigned long bgp_snapshot_saved_paths;
+static time_t bgp_snapshot_loaded;
+static unsigned long bgp_snapshot_loaded_paths;
+static unsigned long bgp_snapshot_skipped_paths;
+
+static int bgp_snapshot_timer (struct thread *);
+
+static void
+bgp_snapshot_timer_set (void)
+{
+  THREAD_TIMER_OFF (t_bgp_snapshot);
+  if (bgp_snapshot_path && bgp_snapshot_interval)
+    t_bgp_snapshot = thread_add_timer (master, bgp_snapshot_timer, NULL,
+                                       bgp_snapshot_interval);
+}
+
+static void
+bgp_snapshot_addr_put (struct stream *s, union sockunion *su)
+{
+#ifdef HAVE_IPV6
+  if (su->sa.sa_family == AF_INET6)
+    {
+      stream_putw (s, AFI_IP6);
+      stream_put (s, &su->sin6.sin6_addr, IPV6_MAX_BYTELEN);
+      return;
+    }
+#endif /* HAVE_IPV6 */
+  stream_putw (s, AFI_IP);
+  stream_put_in_addr (s, &su->sin.sin_addr);
+}
+
+static void
+bgp_snapshot_path_put (struct stream *s, struct bgp_node *rn,
+                       struct bgp_info *ri, afi_t afi, safi_t safi)
+{
+  struct attr *attr = ri->attr;
+  struct attr_extra *ae = attr->extra;
+  size_t lenp;
+
+  stream_putl (s, 0);
+  stream_putw (s, afi);
+  stream_putc (s, safi);
+  bgp_snapshot_addr_put (s, &ri->peer->su);
+  stream_putc (s, rn->p.prefixlen);
+  stream_put (s, &rn->p.u.prefix, PSIZE (rn->p.prefixlen));
+
+  stream_putl (s, attr->flag);
+  stream_putc (s, attr->origin);
+  stream_put_in_addr (s, &attr->nexthop);
+  stream_putl (s, attr->med);
+  stream_putl (s, attr->local_pref);
+
+  lenp = stream_get_endp (s);
+  stream_putw (s, 0);
+  if (attr->aspath)
+    stream_putw_at (s, lenp, aspath_put (s, attr->aspath, 1));
+
+  if (attr->community)
+    {
+      stream_putw (s, attr->community->size * 4);
+      stream_put (s, attr->community->val, attr->community->size * 4);
+    }
+  else
+    stream_putw (s, 0);
+
+  stream_putc (s, ae != NULL);
+  if (ae)
+    {
+      stream_putl (s, ae->weight);
+      stream_putl (s, ae->aggregator_as);
+      stream_put_in_addr (s, &ae->aggregator_addr);
+      stream_put_in_addr (s, &ae->originator_id);
+      stream_putc (s, ae->mp_nexthop_len);
+      stream_put_in_addr (s, &ae->mp_nexthop_global_in);
+#ifdef HAVE_IPV6
+      if (afi == AFI_IP6)
+        {
+          stream_put (s, &ae->mp_nexthop_global, IPV6_MAX_BYTELEN);
+          stream_put (s, &ae->mp_nexthop_local, IPV6_MAX_BYTELEN);
+        }
+#endif /* HAVE_IPV6 */
+      if (ae->ecommunity)
+        {
+          stream_putw (s, ae->ecommunity->size * ECOMMUNITY_SIZE);
+          stream_put (s, ae->ecommunity->val,
+                      ae->ecommunity->size * ECOMMUNITY_SIZE);
+        }
+      else
+        stream_putw (s, 0);
+      if (ae->cluster)
+        {
+          stream_putw (s, ae->cluster->length);
+          stream_put (s, ae->cluster->list, ae->cluster->length);
+        }
+      else
+        stream_putw (s, 0);
+    }
+
+  stream_putl_at (s, 0, stream_get_endp (s) - 4);
+}
+
+/* Whether ri is a path learnt from a peer, and so worth keeping. */
+static int
+bgp_snapshot_path_wanted (struct bgp *bgp, struct bgp_info *ri)
+{
+  return ri->type == ZEBRA_ROUTE_BGP
+         && ri->sub_type == BGP_ROUTE_NORMAL
+         && ri->peer != bgp->peer_self
+         && ri->peer != bgp->rsclient_base
+         && ! CHECK_FLAG (ri->flags, BGP_INFO_REMOVED | BGP_INFO_HISTORY);
+}
+
+/* Write the snapshot, to a temporary file first so that a snapshot
+   cut short never replaces a whole one. */
+int
+bgp_snapshot_save (void)
+{
+  struct bgp *bgp;
+  struct bgp_node *rn;
+  struct bgp_info *ri;
+  struct stream *s = bgp_snapshot_s;
+  unsigned int af;
+  unsigned long paths = 0;
+  char tmp[MAXPATHLEN];
+  FILE *fp;
+  int failed;
+
+  if (! bgp_snapshot_path || ! (bgp = bgp_get_default ()))
+    return 0;
+
+  snprintf (tmp, sizeof (tmp), "%s.tmp", bgp_snapshot_path);
+  fp = fopen (tmp, "w");
+  if (! fp)
+    {
+      zlog_err ("Can't write RIB snapshot %s: %s", tmp,
+                safe_strerror (errno));
+      return -1;
+    }
+
+  stream_reset (s);
+  stream_putl (s, BGP_SNAPSHOT_MAGIC);
+  stream_putl (s, BGP_SNAPSHOT_VERSION);
+  stream_putl (s, bgp->as);
+  stream_putl (s, time (NULL));
+  fwrite (STREAM_DATA (s), stream_get_endp (s), 1, fp);
+
+  for (af = 0; af < BGP_SNAPSHOT_AFS; af++)
+    {
+      afi_t afi = bgp_snapshot_afs[af].afi;
+      safi_t safi = bgp_snapshot_afs[af].safi;
+
+      for (rn = bgp_table_top (bgp->rib[afi][safi]); rn;
+           rn = bgp_route_next (rn))
+        for (ri = rn->info; ri; ri = ri->next)
+          if (bgp_snapshot_path_wanted (bgp, ri))
+            {
+              stream_reset (s);
+              bgp_snapshot_path_put (s, rn, ri, afi, safi);
+              fwrite (STREAM_DATA (s), stream_get_endp (s), 1, fp);
+              paths++;
+            }
+    }
+
+  failed = ferror (fp);
+  if (fclose (fp) || failed || rename (tmp, bgp_snapshot_path) < 0)
+    {
+      zlog_err ("Can't write RIB snapshot %s: %s", bgp_snapshot_path,
+                safe_strerror (errno));
+      unlink (tmp);
+      return -1;
+    }
+
+  bgp_snapshot_saved = bgp_clock ();
+  bgp_snapshot_saved_paths = paths;
+  if (BGP_DEBUG (events, EVENTS))
+    zlog_debug ("RIB snapshot %s saved, %lu paths", bgp_snapshot_path, paths);
+  return 0;
+}
+
+static int
+bgp_snapshot_timer (struct thread *thread)
+{
+  t_bgp_snapshot = NULL;
+  bgp_snapshot_save ();
+  bgp_snapshot_timer_set ();
+  return 0;
+}
+
+/* Read one record into s.  Returns 1 for a record, 0 at the end of the
+   file and -1 if the file is cut short. */
+static int
+bgp_snapshot_read (FILE *fp, struct stream *s)
+{
+  u_char len[4];
+  size_t length;
+
+  stream_reset (s);
+  if (fread (len, sizeof (len), 1, fp) != 1)
+    return feof (fp) ? 0 : -1;
+  length = (len[0] << 24) | (len[1] << 16) | (len[2] << 8) | len[3];
+  if (length > STREAM_SIZE (s)
+      || fread (STREAM_DATA (s), length, 1, fp) != 1)
+    return -1;
+  stream_set_endp (s, length);
+  return 1;
+}
+
+#define BGP_SNAPSHOT_NEED(S, N) \
+  do { if (STREAM_READABLE (S) < (size_t) (N)) goto malformed; } while (0)
+
+/* Turn the record in s back into a path and install it.  Returns -1 if
+   the record does not make sense. */
+static int
+bgp_snapshot_path_get (struct bgp *bgp, struct stream *s)
+{
+  struct attr attr;
+  struct attr_extra extra;
+  struct prefix p;
+  union sockunion su;
+  struct peer *peer;
+  afi_t afi, peer_afi;
+  safi_t safi;
+  u_int16_t length;
+  int ret = -1;
+
+  memset (&attr, 0, sizeof (struct attr));
+  memset (&extra, 0, sizeof (struct attr_extra));
+  memset (&p, 0, sizeof (struct prefix));
+  memset (&su, 0, sizeof (union sockunion));
+
+  BGP_SNAPSHOT_NEED (s, 5);
+  afi = stream_getw (s);
+  safi = stream_getc (s);
+  peer_afi = stream_getw (s);
+  if (peer_afi == AFI_IP)
+    {
+      BGP_SNAPSHOT_NEED (s, IPV4_MAX_BYTELEN);
+      su.sin.sin_family = AF_INET;
+      stream_get (&su.sin.sin_addr, s, IPV4_MAX_BYTELEN);
+    }
+#ifdef HAVE_IPV6
+  else if (peer_afi == AFI_IP6)
+    {
+      BGP_SNAPSHOT_NEED (s, IPV6_MAX_BYTELEN);
+      su.sin6.sin6_family = AF_INET6;
+      stream_get (&su.sin6.sin6_addr, s, IPV6_MAX_BYTELEN);
+    }
+#endif /* HAVE_IPV6 */
+  else
+    goto malformed;
+
+  BGP_SNAPSHOT_NEED (s, 1);
+  p.family = afi2family (afi);
+  p.prefixlen = stream_getc (s);
+  if (! p.family || p.prefixlen > prefix_blen (&p) * 8)
+    goto malformed;
+  BGP_SNAPSHOT_NEED (s, PSIZE (p.prefixlen));
+  stream_get (&p.u.prefix, s, PSIZE (p.prefixlen));
+
+  BGP_SNAPSHOT_NEED (s, 17);
+  attr.flag = stream_getl (s);
+  attr.origin = stream_getc (s);
+  attr.nexthop.s_addr = stream_get_ipv4 (s);
+  attr.med = stream_getl (s);
+  attr.local_pref = stream_getl (s);
+
+  BGP_SNAPSHOT_NEED (s, 2);
+  length = stream_getw (s);
+  BGP_SNAPSHOT_NEED (s, length);
+  if (! (attr.aspath = aspath_parse (s, length, 1)))
+    goto malformed;
+
+  BGP_SNAPSHOT_NEED (s, 2);
+  length = stream_getw (s);
+  BGP_SNAPSHOT_NEED (s, length);
+  if (length)
+    {
+      attr.community = community_parse ((u_int32_t *) stream_pnt (s),
+                                        length);
+      if (! attr.community)
+        goto malformed;
+      stream_forward_getp (s, length);
+    }
+
+  BGP_SNAPSHOT_NEED (s, 1);
+  if (stream_getc (s))
+    {
+      attr.extra = &extra;
+
+      BGP_SNAPSHOT_NEED (s, 21);
+      extra.weight = stream_getl (s);
+      extra.aggregator_as = stream_getl (s);
+      extra.aggregator_addr.s_addr = stream_get_ipv4 (s);
+      extra.originator_id.s_addr = stream_get_ipv4 (s);
+      extra.mp_nexthop_len = stream_getc (s);
+      BGP_SNAPSHOT_NEED (s, 4);
+      extra.mp_nexthop_global_in.s_addr = stream_get_ipv4 (s);
+#ifdef HAVE_IPV6
+      if (afi == AFI_IP6)
+        {
+          BGP_SNAPSHOT_NEED (s, 2 * IPV6_MAX_BYTELEN);
+          stream_get (&extra.mp_nexthop_global, s, IPV6_MAX_BYTELEN);
+          stream_get (&extra.mp_nexthop_local, s, IPV6_MAX_BYTELEN);
+        }
+#endif /* HAVE_IPV6 */
+
+      BGP_SNAPSHOT_NEED (s, 2);
+      length = stream_getw (s);
+      BGP_SNAPSHOT_NEED (s, length);
+      if (length)
+        {
+          extra.ecommunity = ecommunity_parse (stream_pnt (s), length);
+          if (! extra.ecommunity)
+            goto malformed;
+          stream_forward_getp (s, length);
+        }
+
+      BGP_SNAPSHOT_NEED (s, 2);
+      length = stream_getw (s);
+      BGP_SNAPSHOT_NEED (s, length);
+      if (length)
+        {
+          if (length % 4)
+            goto malformed;
+          extra.cluster = cluster_parse ((struct in_addr *) stream_pnt (s),
+                                         length);
+          stream_forward_getp (s, length);
+        }
+    }
+
+  /* Only for a peer still there to refresh it. */
+  ret = 0;
+  peer = peer_lookup (bgp, &su);
+  if (! peer || ! peer->afc[afi][safi]
+      || CHECK_FLAG (peer->flags, PEER_FLAG_SHUTDOWN))
+    bgp_snapshot_skipped_paths++;
+  else
+    {
+      bgp_update_stale (peer, &p, &attr, afi, safi);
+      peer->nsf[afi][safi] = 1;
+      bgp_snapshot_loaded_paths++;
+    }
+
+ malformed:
+  bgp_attr_unintern_sub (&attr);
+  return ret;
+}
+
+/* Reload the snapshot into the default instance.  Called once, after
+   the configuration has been read and before any session is up. */
+void
+bgp_snapshot_load (void)
+{
+  struct bgp *bgp;
+  struct peer *peer;
+  struct listnode *node;
+  struct stream *s = bgp_snapshot_s;
+  unsigned int af;
+  FILE *fp;
+  int ret;
+
+  if (! bgp_snapshot_path || ! (bgp = bgp_get_default ()))
+    return;
+
+  fp = fopen (bgp_snapshot_path, "r");
+  if (! fp)
+    {
+      if (errno != ENOENT)
+        zlog_err ("Can't read RIB snapshot %s: %s", bgp_snapshot_path,
+                  safe_strerror (errno));
+      return;
+    }
+
+  stream_reset (s);
+  if (fread (STREAM_DATA (s), 16, 1, fp) != 1)
+    {
+      zlog_warn ("RIB snapshot %s is truncated, not loaded",
+                 bgp_snapshot_path);
+      fclose (fp);
+      return;
+    }
+  stream_set_endp (s, 16);
+  if (stream_getl (s) != BGP_SNAPSHOT_MAGIC
+      || stream_getl (s) != BGP_SNAPSHOT_VERSION)
+    {
+      zlog_warn ("%s is not a RIB snapshot, not loaded", bgp_snapshot_path);
+      fclose (fp);
+      return;
+    }
+  if (stream_getl (s) != bgp->as)
+    {
+      zlog_warn ("RIB snapshot %s is for another AS, not loaded",
+                 bgp_snapshot_path);
+      fclose (fp);
+      return;
+    }
+
+  while ((ret = bgp_snapshot_read (fp, s)) > 0)
+    if (bgp_snapshot_path_get (bgp, s) < 0)
+      break;
+  if (ret)
+    zlog_warn ("RIB snapshot %s is damaged, loaded as far as it goes",
+               bgp_snapshot_path);
+  fclose (fp);
+
+  bgp_snapshot_loaded = bgp_clock ();
+
+  for (ALL_LIST_ELEMENTS_RO (bgp->peer, node, peer))
+    for (af = 0; af < BGP_SNAPSHOT_AFS; af++)
+      if (peer->nsf[bgp_snapshot_afs[af].afi][bgp_snapshot_afs[af].safi])
+        {
+          bgp_graceful_reload (peer);
+          break;
+        }
+
+  zlog_info ("RIB snapshot %s loaded, %lu paths, %lu skipped",
+             bgp_snapshot_path, bgp_snapshot_loaded_paths,
+             bgp_snapshot_skipped_paths);
+}
+
+DEFUN (bgp_rib_snapshot,
+       bgp_rib_snapshot_cmd,
+       "bgp rib-snapshot PATH",
+       BGP_STR
+       "Keep the RIB across restarts\n"
+       "Snapshot file\n")
+{
+  int interval = 0;
+
+  if (argc > 1)
+    VTY_GET_INTEGER_RANGE ("snapshot interval", interval, argv[1], 60, 86400);
+
+  if (bgp_snapshot_path)
+    XFREE (MTYPE_TMP, bgp_snapshot_path);
+  bgp_snapshot_path = XSTRDUP (MTYPE_TMP, argv[0]);
+  bgp_snapshot_interval = interval;
+  bgp_snapshot_timer_set ();
+  return CMD_SUCCESS;
+}
+
+ALIAS (bgp_rib_snapshot,
+       bgp_rib_snapshot_interval_cmd,
+       "bgp rib-snapshot PATH <60-86400>",
+       BGP_STR
+       "Keep the RIB across restarts\n"
+       "Snapshot file\n"
+       "Also save the snapshot every so many seconds\n")
+
+DEFUN (no_bgp_rib_snapshot,
+       no_bgp_rib_snapshot_cmd,
+       "no bgp rib-snapshot",
+       NO_STR
+       BGP_STR
+       "Keep the RIB across restarts\n")
+{
+  if (bgp_snapshot_path)
+    XFREE (MTYPE_TMP, bgp_snapshot_path);
+  bgp_snapshot_path = NULL;
+  bgp_snapshot_interval = 0;
+  bgp_snapshot_timer_set ();
+  return CMD_SUCCESS;
+}
+
+ALIAS (no_bgp_rib_snapshot,
+       no_bgp_rib_snapshot_path_cmd,
+       "no bgp rib-snapshot PATH",
+       NO_STR
+       BGP_STR
+       "Keep the RIB across restarts\n"
+       "Snapshot file\n")
+
+ALIAS (no_bgp_rib_snapshot,
+       no_bgp_rib_snapshot_interval_cmd,
+       "no bgp rib-snapshot PATH <60-86400>",
+       NO_STR
+       BGP_STR
+       "Keep the RIB across restarts\n"
+       "Snapshot file\n"
+       "Also save the snapshot every so many seconds\n")
+
+DEFUN (show_bgp_rib_snapshot,
+       show_bgp_rib_snapshot_cmd,
+       "show bgp rib-snapshot",
+       SHOW_STR
+       BGP_STR
+       "RIB snapshot\n")
+{
+  if (! bgp_snapshot_path)
+    {
+      vty_out (vty, "RIB snapshot is not configured%s", VTY_NEWLINE);
+      return CMD_SUCCESS;
+    }
+
+  vty_out (vty, "RIB snapshot %s", bgp_snapshot_path);
+  if (bgp_snapshot_interval)
+    vty_out (vty, ", saved every %d seconds", bgp_snapshot_interval);
+  vty_out (vty, "%s", VTY_NEWLINE);
+  if (bgp_snapshot_loaded)
+    vty_out (vty, "  Loaded %ld seconds ago, %lu paths, %lu skipped%s",
+             (long) (bgp_clock () - bgp_snapshot_loaded),
+             bgp_snapshot_loaded_paths, bgp_snapshot_skipped_paths,
+             VTY_NEWLINE);
+  if (bgp_snapshot_saved)
+    vty_out (vty, "  Saved %ld seconds ago, %lu paths%s",
+             (long) (bgp_clock () - bgp_snapshot_saved),
+             bgp_snapshot_saved_paths, VTY_NEWLINE);
+  if (t_bgp_snapshot)
+    vty_out (vty, "  Next save in %ld seconds%s",
+             thread_timer_remain_second (t_bgp_snapshot), VTY_NEWLINE);
+
+  return CMD_SUCCESS;
+}
+
+int
+bgp_snapshot_config_write (struct vty *vty)
+{
+  if (! bgp_snapshot_path)
+    return 0;
+
+  if (bgp_snapshot_interval)
+    vty_out (vty, "bgp rib-snapshot %s %d%s", bgp_snapshot_path,
+             bgp_snapshot_interval, VTY_NEWLINE);
+  else
+    vty_out (vty, "bgp rib-snapshot %s%s", bgp_snapshot_path, VTY_NEWLINE);
+  return 1;
+}
+
+void
+bgp_snapshot_init (void)
+{
+  bgp_snapshot_s = stream_new (BGP_SNAPSHOT_RECORD_MAX);
+
+  install_element (CONFIG_NODE, &bgp_rib_snapshot_cmd);
+  install_element (CONFIG_NODE, &bgp_rib_snapshot_interval_cmd);
+  install_element (CONFIG_NODE, &no_bgp_rib_snapshot_cmd);
+  install_element (CONFIG_NODE, &no_bgp_rib_snapshot_path_cmd);
+  install_element (CONFIG_NODE, &no_bgp_rib_snapshot_interval_cmd);
+  install_element (VIEW_NODE, &show_bgp_rib_snapshot_cmd);
+  install_element (ENABLE_NODE, &show_bgp_rib_snapshot_cmd);
+}
+
+void
+bgp_snapshot_finish (void)
+{
+  THREAD_TIMER_OFF (t_bgp_snapshot);
+  if (bgp_snapshot_path)
+    XFREE (MTYPE_TMP, bgp_snapshot_path);
+  bgp_snapshot_path = NULL;
+  stream_free (bgp_snapshot_s);
+  bgp_snapshot_s = NULL;
+}
@@ -618,6 +618,40 @@ bgpRcvdPathAttrTable (struct variable *v, oid name[], size_t *length,
   return NULL;
 }
 
+#define BGP_PATHATTR_ENTRY_OFFSET \
+          (IN_ADDR_SIZE + 1 + IN_ADDR_SIZE)
+
+/* The node of the row bgp4PathAttrLookup() last returned to a GETNEXT,
+   and its index.  A walk asks for the row after the one it was given
+   last, which is then found from the node without a lookup.  The node
+   and its table are locked while they are kept. */
+static struct
+{
+  struct bgp_table *table;
+  struct bgp_node *rn;
+  oid index[BGP_PATHATTR_ENTRY_OFFSET];
+} bgp4PathAttrCursor;
+
+static void
+bgp4PathAttrCursor_set (struct bgp_table *table, struct bgp_node *rn,
+			oid *index)
+{
+  struct bgp_table *old_table = bgp4PathAttrCursor.table;
+  struct bgp_node *old_rn = bgp4PathAttrCursor.rn;
+
+  bgp_table_lock (table);
+  bgp_lock_node (rn);
+  bgp4PathAttrCursor.table = table;
+  bgp4PathAttrCursor.rn = rn;
+  oid_copy (bgp4PathAttrCursor.index, index, BGP_PATHATTR_ENTRY_OFFSET);
+
+  if (old_rn)
+    {
+      bgp_unlock_node (old_rn);
+      bgp_table_unlock (old_table);
+    }
+}
+
 static struct bgp_info *
 bgp4PathAttrLookup (struct variable *v, oid name[], size_t *length,
 		    struct bgp *bgp, struct prefix_ipv4 *addr, int exact)
@@ -631,9 +665,6 @@ bgp4PathAttrLookup (struct variable *v, oid name[], size_t *length,
   unsigned int len;
   struct in_addr paddr;
 
-#define BGP_PATHATTR_ENTRY_OFFSET \
-          (IN_ADDR_SIZE + 1 + IN_ADDR_SIZE)
-
   if (exact)
     {
       if (*length - v->namelen != BGP_PATHATTR_ENTRY_OFFSET)
@@ -672,6 +703,17 @@ bgp4PathAttrLookup (struct variable *v, oid name[], size_t *length,
 
       if (offsetlen == 0)
 	rn = bgp_table_top (bgp->rib[AFI_IP][SAFI_UNICAST]);
+      else if (offsetlen == BGP_PATHATTR_ENTRY_OFFSET
+	       && bgp4PathAttrCursor.rn
+	       && bgp4PathAttrCursor.table == bgp->rib[AFI_IP][SAFI_UNICAST]
+	       && oid_compare (offset, offsetlen, bgp4PathAttrCursor.index,
+			       BGP_PATHATTR_ENTRY_OFFSET) == 0)
+	{
+	  /* The row after the one returned last. */
+	  rn = bgp_lock_node (bgp4PathAttrCursor.rn);
+	  offset += IN_ADDR_SIZE + 1;
+	  offsetlen -= IN_ADDR_SIZE + 1;
+	}
       else
 	{
 	  if (len > IN_ADDR_SIZE)
@@ -743,6 +785,8 @@ bgp4PathAttrLookup (struct variable *v, oid name[], size_t *length,
 	      addr->prefix = rn->p.u.prefix4;
 	      addr->prefixlen = rn->p.prefixlen;
 
+	      bgp4PathAttrCursor_set (bgp->rib[AFI_IP][SAFI_UNICAST], rn,
+				      name + v->namelen);
 	      bgp_unlock_node (rn);
 
 	      return min;
@@ -0,0 +1,462 @@
+/* BGP shared memory statistics segment.
+   Copyright (C) 2026 The Quagga project
+
+This file is part of GNU Zebra.
+
+GNU Zebra is free software; you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation; either version 2, or (at your option) any
+later version.
+
+GNU Zebra is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with GNU Zebra; see the file COPYING.  If not, write to the Free
+Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+02111-1307, USA.  */
+
+/* The statistics segment lets a metrics exporter read the peer
+   counters, work queue depths, thread accounting and memory type
+   counts of bgpd without a vty session, and so without waiting on, or
+   adding to, the work of the event loop.  Every interval bgpd copies
+   them to a file it keeps mapped shared; a reader maps the same file
+   and follows the sequence count protocol described in bgp_statseg.h
+   to get a consistent copy.  Counters are copied rather than kept in
+   the segment, so nothing changes where they are counted.  */
+
+#include <zebra.h>
+#include <sys/mman.h>
+
+#include "command.h"
+#include "linklist.h"
+#include "memory.h"
+#include "stream.h"
+#include "thread.h"
+#include "workqueue.h"
+#include "log.h"
+#include "vty.h"
+
+#include "bgpd/bgpd.h"
+#include "bgpd/bgp_statseg.h"
+
+#define BGP_STATSEG_INTERVAL_DEFAULT 5
+
+static char *bgp_statseg_path;
+static int bgp_statseg_interval = BGP_STATSEG_INTERVAL_DEFAULT;
+static struct thread *t_bgp_statseg;
+
+static int bgp_statseg_fd = -1;
+static u_char *bgp_statseg_base;
+static size_t bgp_statseg_mapped;
+
+static int bgp_statseg_timer (struct thread *);
+
+#define BGP_STATSEG_HDR(B) ((struct bgp_statseg_header *) (B))
+
+static void
+bgp_statseg_close (void)
+{
+  if (bgp_statseg_base)
+    {
+      BGP_STATSEG_HDR (bgp_statseg_base)->pid = 0;
+      munmap (bgp_statseg_base, bgp_statseg_mapped);
+    }
+  bgp_statseg_base = NULL;
+  bgp_statseg_mapped = 0;
+
+  if (bgp_statseg_fd >= 0)
+    {
+      close (bgp_statseg_fd);
+      unlink (bgp_statseg_path);
+    }
+  bgp_statseg_fd = -1;
+}
+
+static int
+bgp_statseg_open (void)
+{
+  bgp_statseg_fd = open (bgp_statseg_path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (bgp_statseg_fd < 0)
+    {
+      zlog_warn ("Can't open statistics segment %s: %s", bgp_statseg_path,
+                 safe_strerror (errno));
+      return -1;
+    }
+  return 0;
+}
+
+/* Make the segment at least size bytes, mapping it again if it grows.
+   It grows a page at a time, and never shrinks. */
+static int
+bgp_statseg_reserve (size_t size)
+{
+  long page = sysconf (_SC_PAGESIZE);
+  size_t want;
+  void *base;
+
+  if (size <= bgp_statseg_mapped)
+    return 0;
+
+  want = (size + page - 1) / page * page;
+  if (ftruncate (bgp_statseg_fd, want) < 0)
+    {
+      zlog_warn ("Can't size statistics segment %s: %s", bgp_statseg_path,
+                 safe_strerror (errno));
+      return -1;
+    }
+
+  base = mmap (NULL, want, PROT_READ | PROT_WRITE, MAP_SHARED,
+               bgp_statseg_fd, 0);
+  if (base == MAP_FAILED)
+    {
+      zlog_warn ("Can't map statistics segment %s: %s", bgp_statseg_path,
+                 safe_strerror (errno));
+      return -1;
+    }
+
+  if (bgp_statseg_base)
+    munmap (bgp_statseg_base, bgp_statseg_mapped);
+  bgp_statseg_base = base;
+  bgp_statseg_mapped = want;
+  return 0;
+}
+
+static void
+bgp_statseg_name (char *dst, const char *src)
+{
+  memset (dst, 0, BGP_STATSEG_NAME_LEN);
+  if (src)
+    strncpy (dst, src, BGP_STATSEG_NAME_LEN - 1);
+}
+
+static void
+bgp_statseg_peer_put (struct bgp_statseg_peer *r, struct bgp *bgp,
+                      struct peer *peer)
+{
+  afi_t afi;
+  safi_t safi;
+
+  memset (r, 0, sizeof (*r));
+  bgp_statseg_name (r->host, peer->host);
+  bgp_statseg_name (r->view, bgp->name);
+  r->local_as = peer->local_as;
+  r->remote_as = peer->as;
+  r->status = peer->status;
+  r->established = peer->established;
+  r->dropped = peer->dropped;
+  r->outq = peer->obuf ? peer->obuf->count : 0;
+  r->uptime = peer->uptime ? bgp_clock () - peer->uptime : 0;
+  r->open_in = peer->open_in;
+  r->open_out = peer->open_out;
+  r->update_in = peer->update_in;
+  r->update_out = peer->update_out;
+  r->keepalive_in = peer->keepalive_in;
+  r->keepalive_out = peer->keepalive_out;
+  r->notify_in = peer->notify_in;
+  r->notify_out = peer->notify_out;
+  r->refresh_in = peer->refresh_in;
+  r->refresh_out = peer->refresh_out;
+  r->dynamic_cap_in = peer->dynamic_cap_in;
+  r->dynamic_cap_out = peer->dynamic_cap_out;
+  r->write_calls = peer->write_calls;
+  r->update_prefix_out = peer->update_prefix_out;
+  r->adv_replaced = peer->adv_replaced;
+  r->adv_cancelled = peer->adv_cancelled;
+  r->policy_rejected = peer->policy_rejected;
+
+  for (afi = AFI_IP; afi < AFI_MAX; afi++)
+    for (safi = SAFI_UNICAST; safi < SAFI_MAX; safi++)
+      {
+        r->prefix_accepted += peer->pcount[afi][safi];
+        r->prefix_sent += peer->scount[afi][safi];
+      }
+}
+
+/* Work queues and thread records are gathered by walking, twice: once
+   to count, once to copy. */
+struct bgp_statseg_walk
+{
+  unsigned int count;
+  u_char *next;
+};
+
+static void
+bgp_statseg_wq_put (struct work_queue *wq, void *arg)
+{
+  struct bgp_statseg_walk *w = arg;
+  struct bgp_statseg_work_queue *r;
+
+  w->count++;
+  if (! w->next)
+    return;
+
+  r = (struct bgp_statseg_work_queue *) w->next;
+  memset (r, 0, sizeof (*r));
+  bgp_statseg_name (r->name, wq->name);
+  r->items = work_queue_item_count (wq);
+  r->runs = wq->runs;
+  r->cycles_total = wq->cycles.total;
+  r->cycles_best = wq->cycles.best;
+  r->cycles_granularity = wq->cycles.granularity;
+  w->next += sizeof (*r);
+}
+
+static void
+bgp_statseg_thread_put (struct cpu_thread_history *a, void *arg)
+{
+  struct bgp_statseg_walk *w = arg;
+  struct bgp_statseg_thread *r;
+
+  w->count++;
+  if (! w->next)
+    return;
+
+  r = (struct bgp_statseg_thread *) w->next;
+  memset (r, 0, sizeof (*r));
+  bgp_statseg_name (r->funcname, a->funcname);
+  r->types = a->types;
+  r->calls = a->total_calls;
+  r->real_total = a->real.total;
+  r->real_max = a->real.max;
+#ifdef HAVE_RUSAGE
+  r->cpu_total = a->cpu.total;
+  r->cpu_max = a->cpu.max;
+#endif
+  w->next += sizeof (*r);
+}
+
+static void
+bgp_statseg_section_set (struct bgp_statseg_header *h,
+                         enum bgp_statseg_type type, unsigned int count,
+                         size_t record_size, size_t *offset)
+{
+  h->section[type].count = count;
+  h->section[type].record_size = record_size;
+  h->section[type].offset = *offset;
+  *offset += count * record_size;
+}
+
+static void
+bgp_statseg_update (void)
+{
+  struct bgp_statseg_header *h;
+  struct bgp_statseg_walk wq_walk = { 0, NULL };
+  struct bgp_statseg_walk thread_walk = { 0, NULL };
+  struct listnode *node, *pnode;
+  struct bgp *bgp;
+  struct peer *peer;
+  struct mlist *ml;
+  struct memory_list *m;
+  struct bgp_statseg_peer *rp;
+  struct bgp_statseg_memtype *rm;
+  unsigned int peers = 0, memtypes = 0;
+  size_t size;
+
+  for (ALL_LIST_ELEMENTS_RO (bm->bgp, node, bgp))
+    peers += listcount (bgp->peer);
+  work_queue_walk (bgp_statseg_wq_put, &wq_walk);
+  thread_cpu_record_walk (bgp_statseg_thread_put, &thread_walk);
+  for (ml = mlists; ml->list; ml++)
+    for (m = ml->list; m->index >= 0; m++)
+      if (m->index)
+        memtypes++;
+
+  size = sizeof (struct bgp_statseg_header)
+         + peers * sizeof (struct bgp_statseg_peer)
+         + wq_walk.count * sizeof (struct bgp_statseg_work_queue)
+         + thread_walk.count * sizeof (struct bgp_statseg_thread)
+         + memtypes * sizeof (struct bgp_statseg_memtype);
+  if (bgp_statseg_reserve (size) < 0)
+    return;
+
+  h = BGP_STATSEG_HDR (bgp_statseg_base);
+  h->seq++;
+  __sync_synchronize ();
+
+  h->magic = BGP_STATSEG_MAGIC;
+  h->version = BGP_STATSEG_VERSION;
+  h->pid = getpid ();
+  h->size = size;
+  h->updated = time (NULL);
+  h->interval = bgp_statseg_interval;
+  h->section_count = BGP_STATSEG_MAX;
+
+  size = sizeof (struct bgp_statseg_header);
+  bgp_statseg_section_set (h, BGP_STATSEG_PEER, peers,
+                           sizeof (struct bgp_statseg_peer), &size);
+  bgp_statseg_section_set (h, BGP_STATSEG_WORK_QUEUE, wq_walk.count,
+                           sizeof (struct bgp_statseg_work_queue), &size);
+  bgp_statseg_section_set (h, BGP_STATSEG_THREAD, thread_walk.count,
+                           sizeof (struct bgp_statseg_thread), &size);
+  bgp_statseg_section_set (h, BGP_STATSEG_MEMTYPE, memtypes,
+                           sizeof (struct bgp_statseg_memtype), &size);
+
+  rp = (struct bgp_statseg_peer *)
+       (bgp_statseg_base + h->section[BGP_STATSEG_PEER].offset);
+  for (ALL_LIST_ELEMENTS_RO (bm->bgp, node, bgp))
+    for (ALL_LIST_ELEMENTS_RO (bgp->peer, pnode, peer))
+      bgp_statseg_peer_put (rp++, bgp, peer);
+
+  /* Nothing is added to either between the two walks. */
+  wq_walk.count = 0;
+  wq_walk.next = bgp_statseg_base
+                 + h->section[BGP_STATSEG_WORK_QUEUE].offset;
+  work_queue_walk (bgp_statseg_wq_put, &wq_walk);
+
+  thread_walk.count = 0;
+  thread_walk.next = bgp_statseg_base + h->section[BGP_STATSEG_THREAD].offset;
+  thread_cpu_record_walk (bgp_statseg_thread_put, &thread_walk);
+
+  rm = (struct bgp_statseg_memtype *)
+       (bgp_statseg_base + h->section[BGP_STATSEG_MEMTYPE].offset);
+  for (ml = mlists; ml->list; ml++)
+    for (m = ml->list; m->index >= 0; m++)
+      if (m->index)
+        {
+          bgp_statseg_name (rm->name, m->format);
+          rm->alloc = mtype_stats_alloc (m->index);
+          rm++;
+        }
+
+  __sync_synchronize ();
+  h->seq++;
+}
+
+static void
+bgp_statseg_timer_set (void)
+{
+  THREAD_TIMER_OFF (t_bgp_statseg);
+  if (bgp_statseg_base)
+    t_bgp_statseg = thread_add_timer (master, bgp_statseg_timer, NULL,
+                                      bgp_statseg_interval);
+}
+
+static int
+bgp_statseg_timer (struct thread *t)
+{
+  t_bgp_statseg = NULL;
+  bgp_statseg_update ();
+  bgp_statseg_timer_set ();
+  return 0;
+}
+
+static void
+bgp_statseg_start (void)
+{
+  if (bgp_statseg_open () < 0)
+    return;
+  if (bgp_statseg_reserve (sizeof (struct bgp_statseg_header)) < 0)
+    {
+      bgp_statseg_close ();
+      return;
+    }
+  bgp_statseg_update ();
+}
+
+DEFUN (bgp_stats_segment,
+       bgp_stats_segment_cmd,
+       "bgp stats-segment PATH",
+       BGP_STR
+       "Share statistics with a metrics exporter\n"
+       "Segment file\n")
+{
+  int interval = BGP_STATSEG_INTERVAL_DEFAULT;
+
+  if (argc > 1)
+    VTY_GET_INTEGER_RANGE ("statistics interval", interval, argv[1], 1, 3600);
+
+  if (bgp_statseg_path && strcmp (bgp_statseg_path, argv[0]))
+    {
+      bgp_statseg_close ();
+      XFREE (MTYPE_TMP, bgp_statseg_path);
+    }
+  if (! bgp_statseg_path)
+    bgp_statseg_path = XSTRDUP (MTYPE_TMP, argv[0]);
+  bgp_statseg_interval = interval;
+
+  if (bgp_statseg_fd < 0)
+    bgp_statseg_start ();
+  if (bgp_statseg_fd < 0)
+    vty_out (vty, "%% Can't set up statistics segment %s%s", argv[0],
+             VTY_NEWLINE);
+  bgp_statseg_timer_set ();
+  return CMD_SUCCESS;
+}
+
+ALIAS (bgp_stats_segment,
+       bgp_stats_segment_interval_cmd,
+       "bgp stats-segment PATH <1-3600>",
+       BGP_STR
+       "Share statistics with a metrics exporter\n"
+       "Segment file\n"
+       "Seconds between updates\n")
+
+DEFUN (no_bgp_stats_segment,
+       no_bgp_stats_segment_cmd,
+       "no bgp stats-segment",
+       NO_STR
+       BGP_STR
+       "Share statistics with a metrics exporter\n")
+{
+  THREAD_TIMER_OFF (t_bgp_statseg);
+  bgp_statseg_close ();
+  if (bgp_statseg_path)
+    XFREE (MTYPE_TMP, bgp_statseg_path);
+  bgp_statseg_path = NULL;
+  bgp_statseg_interval = BGP_STATSEG_INTERVAL_DEFAULT;
+  return CMD_SUCCESS;
+}
+
+ALIAS (no_bgp_stats_segment,
+       no_bgp_stats_segment_path_cmd,
+       "no bgp stats-segment PATH",
+       NO_STR
+       BGP_STR
+       "Share statistics with a metrics exporter\n"
+       "Segment file\n")
+
+ALIAS (no_bgp_stats_segment,
+       no_bgp_stats_segment_interval_cmd,
+       "no bgp stats-segment PATH <1-3600>",
+       NO_STR
+       BGP_STR
+       "Share statistics with a metrics exporter\n"
+       "Segment file\n"
+       "Seconds between updates\n")
+
+int
+bgp_statseg_config_write (struct vty *vty)
+{
+  if (! bgp_statseg_path)
+    return 0;
+
+  if (bgp_statseg_interval != BGP_STATSEG_INTERVAL_DEFAULT)
+    vty_out (vty, "bgp stats-segment %s %d%s", bgp_statseg_path,
+             bgp_statseg_interval, VTY_NEWLINE);
+  else
+    vty_out (vty, "bgp stats-segment %s%s", bgp_statseg_path, VTY_NEWLINE);
+  return 1;
+}
+
+void
+bgp_statseg_init (void)
+{
+  install_element (CONFIG_NODE, &bgp_stats_segment_cmd);
+  install_element (CONFIG_NODE, &bgp_stats_segment_interval_cmd);
+  install_element (CONFIG_NODE, &no_bgp_stats_segment_cmd);
+  install_element (CONFIG_NODE, &no_bgp_stats_segment_path_cmd);
+  install_element (CONFIG_NODE, &no_bgp_stats_segment_interval_cmd);
+}
+
+void
+bgp_statseg_finish (void)
+{
+  THREAD_TIMER_OFF (t_bgp_statseg);
+  bgp_statseg_close ();
+  if (bgp_statseg_path)
+    XFREE (MTYPE_TMP, bgp_statseg_path);
+  bgp_statseg_path = NULL;
+}
@@ -0,0 +1,135 @@
+/* BGP shared memory statistics segment.
+   Copyright (C) 2026 The Quagga project
+
+This file is part of GNU Zebra.
+
+GNU Zebra is free software; you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation; either version 2, or (at your option) any
+later version.
+
+GNU Zebra is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with GNU Zebra; see the file COPYING.  If not, write to the Free
+Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+02111-1307, USA.  */
+
+#ifndef _QUAGGA_BGP_STATSEG_H
+#define _QUAGGA_BGP_STATSEG_H
+
+/* Layout of the statistics segment, a file bgpd keeps mapped and
+   rewrites every interval.  Everything is in host byte order.  The
+   header is followed by one array of fixed size records per section,
+   each found by its offset from the start of the segment.  Readers
+   must use the record size the section gives, records may grow at the
+   end within a version.
+
+   bgpd makes seq odd while it rewrites the segment and even again when
+   done.  A reader takes seq, retries if it is odd, copies what it
+   wants, and retries if seq has changed meanwhile.  If size has grown
+   past what the reader mapped it must map the segment again.  pid is
+   0 once bgpd has stopped.  */
+
+#define BGP_STATSEG_MAGIC   0x51425353	/* "QBSS" */
+#define BGP_STATSEG_VERSION 1
+
+enum bgp_statseg_type
+{
+  BGP_STATSEG_PEER,
+  BGP_STATSEG_WORK_QUEUE,
+  BGP_STATSEG_THREAD,
+  BGP_STATSEG_MEMTYPE,
+  BGP_STATSEG_MAX
+};
+
+struct bgp_statseg_section
+{
+  u_int32_t count;
+  u_int32_t record_size;
+  u_int64_t offset;
+};
+
+struct bgp_statseg_header
+{
+  u_int32_t magic;
+  u_int32_t version;
+  volatile u_int32_t seq;
+  u_int32_t pid;
+  u_int64_t size;		/* Bytes in use */
+  u_int64_t updated;		/* Wall clock time of the last rewrite */
+  u_int32_t interval;		/* Seconds between rewrites */
+  u_int32_t section_count;
+  struct bgp_statseg_section section[BGP_STATSEG_MAX];
+};
+
+#define BGP_STATSEG_NAME_LEN 64
+
+struct bgp_statseg_peer
+{
+  char host[BGP_STATSEG_NAME_LEN];
+  char view[BGP_STATSEG_NAME_LEN];	/* Empty for the default instance */
+  u_int32_t local_as;
+  u_int32_t remote_as;
+  u_int32_t status;		/* FSM state, as in bgpd.h */
+  u_int32_t established;
+  u_int32_t dropped;
+  u_int32_t outq;		/* Packets waiting to be written */
+  u_int64_t uptime;		/* Seconds in or out of Established */
+  u_int64_t open_in;
+  u_int64_t open_out;
+  u_int64_t update_in;
+  u_int64_t update_out;
+  u_int64_t keepalive_in;
+  u_int64_t keepalive_out;
+  u_int64_t notify_in;
+  u_int64_t notify_out;
+  u_int64_t refresh_in;
+  u_int64_t refresh_out;
+  u_int64_t dynamic_cap_in;
+  u_int64_t dynamic_cap_out;
+  u_int64_t write_calls;
+  u_int64_t update_prefix_out;
+  u_int64_t adv_replaced;
+  u_int64_t adv_cancelled;
+  u_int64_t policy_rejected;
+  u_int64_t prefix_accepted;	/* Over all address families */
+  u_int64_t prefix_sent;	/* Over all address families */
+};
+
+struct bgp_statseg_work_queue
+{
+  char name[BGP_STATSEG_NAME_LEN];
+  u_int64_t items;
+  u_int64_t runs;
+  u_int64_t cycles_total;
+  u_int32_t cycles_best;
+  u_int32_t cycles_granularity;
+};
+
+struct bgp_statseg_thread
+{
+  char funcname[BGP_STATSEG_NAME_LEN];
+  u_int32_t types;		/* Bit per thread type */
+  u_int32_t pad;
+  u_int64_t calls;
+  u_int64_t real_total;		/* Microseconds */
+  u_int64_t real_max;
+  u_int64_t cpu_total;		/* 0 without getrusage() */
+  u_int64_t cpu_max;
+};
+
+struct bgp_statseg_memtype
+{
+  char name[BGP_STATSEG_NAME_LEN];
+  u_int64_t alloc;
+};
+
+extern void bgp_statseg_init (void);
+extern void bgp_statseg_finish (void);
+extern int bgp_statseg_config_write (struct vty *);
+
+#endif /* _QUAGGA_BGP_STATSEG_H */
@@ -110,6 +110,7 @@ bgp_table_init (afi_t afi, safi_t safi)
   rt = XCALLOC (MTYPE_BGP_TABLE, sizeof (struct bgp_table));
 
   rt->route_table = route_table_init_with_delegate (&bgp_table_delegate);
+  route_table_set_family (rt->route_table, afi2family (afi));
 
   /*
    * Set up back pointer to bgp_table.
@@ -23,6 +23,8 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 
 #include "table.h"
 
+struct bgp_adj_index;
+
 typedef enum
 {
   BGP_TABLE_MAIN,
@@ -42,7 +44,23 @@ struct bgp_table
   /* The owner of this 'bgp_table' structure. */
   struct peer *owner;
 
+  /* The instance whose RIB this is, for the main RIB of an instance.
+     Its paths may be of peers of another instance, see
+     bgp_rib_in_view_set(). */
+  struct bgp *bgp;
+
   struct route_table *route_table;
+
+  /* Best path selections done by comparing one changed path against
+     the current best, and by comparing every path of the node. */
+  unsigned long select_fast;
+  unsigned long select_full;
+
+  /* Nodes with paths, paths, and the sum of the prefix lengths of the
+     nodes, kept as paths are added and reaped. */
+  unsigned long prefix_count;
+  unsigned long path_count;
+  unsigned long long prefixlen_total;
 };
 
 struct bgp_node
@@ -61,10 +79,20 @@ struct bgp_node
 
   struct bgp_adj_in *adj_in;
 
+  /* The adjacencies by peer, for nodes with many, see bgp_advertise.c. */
+  struct bgp_adj_index *adj_out_index;
+  struct bgp_adj_index *adj_in_index;
+
   struct bgp_node *prn;
 
+  /* Only path changed since the node was last selected for, unless
+     BGP_NODE_SELECT_FULL is set. */
+  struct bgp_info *select_hint;
+
   u_char flags;
 #define BGP_NODE_PROCESS_SCHEDULED	(1 << 0)
+#define BGP_NODE_SELECT_FULL		(1 << 1)
+#define BGP_NODE_FIB_PENDING		(1 << 2)
 };
 
 /*
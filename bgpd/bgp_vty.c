@@ -30,6 +30,7 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #include "log.h"
 #include "memory.h"
 #include "hash.h"
+#include "sockopt.h"
 
 #include "bgpd/bgpd.h"
 #include "bgpd/bgp_advertise.h"
@@ -43,6 +44,7 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #include "bgpd/bgp_mplsvpn.h"
 #include "bgpd/bgp_nexthop.h"
 #include "bgpd/bgp_open.h"
+#include "bgpd/bgp_packet.h"
 #include "bgpd/bgp_regex.h"
 #include "bgpd/bgp_route.h"
 #include "bgpd/bgp_zebra.h"
@@ -220,6 +222,18 @@ bgp_vty_return (struct vty *vty, int ret)
     case BGP_ERR_NO_IBGP_WITH_TTLHACK:
       str = "ttl-security only allowed for EBGP peers";
       break;
+    case BGP_ERR_RSCLIENT_SHARED_GROUP:
+      str = "Shared route server clients cannot be peer-groups or their members";
+      break;
+    case BGP_ERR_RSCLIENT_SHARED_IMPORT:
+      str = "Shared route server clients cannot have an import policy";
+      break;
+    case BGP_ERR_RSCLIENT_SHARED_CHANGE:
+      str = "Remove the route-server-client configuration first";
+      break;
+    case BGP_ERR_RIB_IN_VIEW_CHAIN:
+      str = "A view taking received routes from another cannot pass them on";
+      break;
     }
   if (str)
     {
@@ -259,6 +273,29 @@ DEFUN (no_bgp_multiple_instance,
   return CMD_SUCCESS;
 }
 
+DEFUN (bgp_walk_budget,
+       bgp_walk_budget_cmd,
+       "bgp walk-budget <1-10000>",
+       BGP_STR
+       "Time a walk of a whole table may run before letting other work in\n"
+       "Milliseconds\n")
+{
+  VTY_GET_INTEGER_RANGE ("walk budget", bm->walk_budget, argv[0], 1, 10000);
+  return CMD_SUCCESS;
+}
+
+DEFUN (no_bgp_walk_budget,
+       no_bgp_walk_budget_cmd,
+       "no bgp walk-budget [<1-10000>]",
+       NO_STR
+       BGP_STR
+       "Time a walk of a whole table may run before letting other work in\n"
+       "Milliseconds\n")
+{
+  bm->walk_budget = BGP_WALK_BUDGET_DEFAULT;
+  return CMD_SUCCESS;
+}
+
 DEFUN (bgp_config_type,
        bgp_config_type_cmd,
        "bgp config-type (cisco|zebra)",
@@ -849,7 +886,68 @@ ALIAS (no_bgp_timers,
        "BGP timers\n"
        "Keepalive interval\n"
        "Holdtime\n")
-
+
+#define BGP_SOCK_PROFILE_CMD \
+  "socket-profile send-buffer <0-67108864> receive-buffer <0-67108864> " \
+  "notsent-lowat <0-67108864>"
+#define BGP_SOCK_PROFILE_STR \
+  "Socket buffers and not sent low water mark of the TCP connection\n" \
+  "Socket send buffer\n" \
+  "Bytes, 0 for the kernel to tune it\n" \
+  "Socket receive buffer\n" \
+  "Bytes, 0 for the kernel to tune it\n" \
+  "Unsent bytes above which the socket is not written to\n" \
+  "Bytes, 0 for no mark\n"
+
+static int
+bgp_sock_profile_get_vty (struct vty *vty, const char **argv,
+			  struct bgp_sock_profile *sp)
+{
+  VTY_GET_INTEGER_RANGE ("send buffer", sp->sndbuf, argv[0],
+			 0, BGP_SOCK_PROFILE_MAX);
+  VTY_GET_INTEGER_RANGE ("receive buffer", sp->rcvbuf, argv[1],
+			 0, BGP_SOCK_PROFILE_MAX);
+  VTY_GET_INTEGER_RANGE ("not sent low water mark", sp->notsent_lowat,
+			 argv[2], 0, BGP_SOCK_PROFILE_MAX);
+  return CMD_SUCCESS;
+}
+
+DEFUN (bgp_sock_profile,
+       bgp_sock_profile_cmd,
+       "bgp " BGP_SOCK_PROFILE_CMD,
+       "BGP specific commands\n"
+       BGP_SOCK_PROFILE_STR)
+{
+  struct bgp_sock_profile sp;
+
+  if (bgp_sock_profile_get_vty (vty, argv, &sp) != CMD_SUCCESS)
+    return CMD_WARNING;
+
+  return bgp_vty_return (vty, bgp_sock_profile_set (vty->index, &sp));
+}
+
+DEFUN (no_bgp_sock_profile,
+       no_bgp_sock_profile_cmd,
+       "no bgp socket-profile",
+       NO_STR
+       "BGP specific commands\n"
+       "Socket buffers and not sent low water mark of the TCP connection\n")
+{
+  struct bgp *bgp;
+
+  bgp = vty->index;
+  bgp_sock_profile_unset (bgp);
+
+  return CMD_SUCCESS;
+}
+
+ALIAS (no_bgp_sock_profile,
+       no_bgp_sock_profile_arg_cmd,
+       "no bgp " BGP_SOCK_PROFILE_CMD,
+       NO_STR
+       "BGP specific commands\n"
+       BGP_SOCK_PROFILE_STR)
+
 DEFUN (bgp_client_to_client_reflection,
        bgp_client_to_client_reflection_cmd,
        "bgp client-to-client reflection",
@@ -935,6 +1033,103 @@ DEFUN (no_bgp_deterministic_med,
   return CMD_SUCCESS;
 }
 
+/* "bgp adj-rib-in view" configuration. */
+DEFUN (bgp_adj_rib_in_view,
+       bgp_adj_rib_in_view_cmd,
+       "bgp adj-rib-in view WORD",
+       "BGP specific commands\n"
+       "Take the routes received by the peers of another view\n"
+       "BGP view\n"
+       "View name\n")
+{
+  struct bgp *bgp;
+
+  bgp = vty->index;
+  return bgp_vty_return (vty, bgp_rib_in_view_set (bgp, argv[0]));
+}
+
+DEFUN (no_bgp_adj_rib_in_view,
+       no_bgp_adj_rib_in_view_cmd,
+       "no bgp adj-rib-in view",
+       NO_STR
+       "BGP specific commands\n"
+       "Take the routes received by the peers of another view\n"
+       "BGP view\n")
+{
+  struct bgp *bgp;
+
+  bgp = vty->index;
+  return bgp_vty_return (vty, bgp_rib_in_view_unset (bgp));
+}
+
+ALIAS (no_bgp_adj_rib_in_view,
+       no_bgp_adj_rib_in_view_name_cmd,
+       "no bgp adj-rib-in view WORD",
+       NO_STR
+       "BGP specific commands\n"
+       "Take the routes received by the peers of another view\n"
+       "BGP view\n"
+       "View name\n")
+
+/* "bgp route-map cache" configuration. */
+DEFUN (bgp_rmap_cache,
+       bgp_rmap_cache_cmd,
+       "bgp route-map cache",
+       "BGP specific commands\n"
+       "Route-map processing\n"
+       "Keep the results of route-maps that only depend on attributes\n")
+{
+  struct bgp *bgp;
+
+  bgp = vty->index;
+  bgp_flag_set (bgp, BGP_FLAG_RMAP_CACHE);
+  return CMD_SUCCESS;
+}
+
+DEFUN (no_bgp_rmap_cache,
+       no_bgp_rmap_cache_cmd,
+       "no bgp route-map cache",
+       NO_STR
+       "BGP specific commands\n"
+       "Route-map processing\n"
+       "Keep the results of route-maps that only depend on attributes\n")
+{
+  struct bgp *bgp;
+
+  bgp = vty->index;
+  bgp_flag_unset (bgp, BGP_FLAG_RMAP_CACHE);
+  bgp_rmap_cache_flush ();
+  return CMD_SUCCESS;
+}
+
+/* "bgp suppress-fib-pending" configuration. */
+DEFUN (bgp_suppress_fib_pending,
+       bgp_suppress_fib_pending_cmd,
+       "bgp suppress-fib-pending",
+       "BGP specific commands\n"
+       "Advertise routes only once they are installed in the FIB\n")
+{
+  struct bgp *bgp;
+
+  bgp = vty->index;
+  bgp_flag_set (bgp, BGP_FLAG_SUPPRESS_FIB_PENDING);
+  return CMD_SUCCESS;
+}
+
+DEFUN (no_bgp_suppress_fib_pending,
+       no_bgp_suppress_fib_pending_cmd,
+       "no bgp suppress-fib-pending",
+       NO_STR
+       "BGP specific commands\n"
+       "Advertise routes only once they are installed in the FIB\n")
+{
+  struct bgp *bgp;
+
+  bgp = vty->index;
+  bgp_flag_unset (bgp, BGP_FLAG_SUPPRESS_FIB_PENDING);
+  return CMD_SUCCESS;
+}
+
 /* "bgp graceful-restart" configuration. */
 DEFUN (bgp_graceful_restart,
        bgp_graceful_restart_cmd,
@@ -1010,6 +1205,53 @@ ALIAS (no_bgp_graceful_restart_stalepath_time,
        "Set the max time to hold onto restarting peer's stale paths\n"
        "Delay value (seconds)\n")
 
+/* "bgp update-delay" configuration. */
+DEFUN (bgp_update_delay,
+       bgp_update_delay_cmd,
+       "bgp update-delay <1-3600>",
+       "BGP specific commands\n"
+       "Select best paths at startup only once every peer sent its table\n"
+       "Longest delay (seconds)\n")
+{
+  struct bgp *bgp;
+  u_int16_t delay;
+
+  bgp = vty->index;
+  if (! bgp)
+    return CMD_WARNING;
+
+  VTY_GET_INTEGER_RANGE ("update-delay", delay, argv[0], 1, 3600);
+  bgp->update_delay = delay;
+  bgp_update_delay_begin (bgp);
+  return CMD_SUCCESS;
+}
+
+DEFUN (no_bgp_update_delay,
+       no_bgp_update_delay_cmd,
+       "no bgp update-delay",
+       NO_STR
+       "BGP specific commands\n"
+       "Select best paths at startup only once every peer sent its table\n")
+{
+  struct bgp *bgp;
+
+  bgp = vty->index;
+  if (! bgp)
+    return CMD_WARNING;
+
+  bgp->update_delay = 0;
+  bgp_update_delay_end (bgp);
+  return CMD_SUCCESS;
+}
+
+ALIAS (no_bgp_update_delay,
+       no_bgp_update_delay_val_cmd,
+       "no bgp update-delay <1-3600>",
+       NO_STR
+       "BGP specific commands\n"
+       "Select best paths at startup only once every peer sent its table\n"
+       "Longest delay (seconds)\n")
+
 /* "bgp fast-external-failover" configuration. */
 DEFUN (bgp_fast_external_failover,
        bgp_fast_external_failover_cmd,
@@ -1046,9 +1288,15 @@ DEFUN (bgp_enforce_first_as,
        "Enforce the first AS for EBGP routes\n")
 {
   struct bgp *bgp;
+  struct peer *peer;
+  struct listnode *node, *nnode;
 
   bgp = vty->index;
   bgp_flag_set (bgp, BGP_FLAG_ENFORCE_FIRST_AS);
+
+  /* Attributes cached before would not have been checked. */
+  for (ALL_LIST_ELEMENTS (bgp->peer, node, nnode, peer))
+    bgp_attr_cache_flush (peer);
   return CMD_SUCCESS;
 }
 
@@ -1328,6 +1576,7 @@ DEFUN (bgp_network_import_check,
 
   bgp = vty->index;
   bgp_flag_set (bgp, BGP_FLAG_IMPORT_CHECK);
+  bgp_import_check_changed (bgp);
   return CMD_SUCCESS;
 }
 
@@ -1343,6 +1592,7 @@ DEFUN (no_bgp_network_import_check,
 
   bgp = vty->index;
   bgp_flag_unset (bgp, BGP_FLAG_IMPORT_CHECK);
+  bgp_import_check_changed (bgp);
   return CMD_SUCCESS;
 }
 
@@ -2107,6 +2357,32 @@ DEFUN (no_neighbor_remove_private_as,
 				 bgp_node_safi (vty),
 				 PEER_FLAG_REMOVE_PRIVATE_AS);
 }
+
+/* neighbor addpath-tx-all-paths. */
+DEFUN (neighbor_addpath_tx_all_paths,
+       neighbor_addpath_tx_all_paths_cmd,
+       NEIGHBOR_CMD2 "addpath-tx-all-paths",
+       NEIGHBOR_STR
+       NEIGHBOR_ADDR_STR2
+       "Use addpath to advertise all paths to a neighbor\n")
+{
+  return peer_af_flag_set_vty (vty, argv[0], bgp_node_afi (vty),
+			       bgp_node_safi (vty),
+			       PEER_FLAG_ADDPATH_TX_ALL_PATHS);
+}
+
+DEFUN (no_neighbor_addpath_tx_all_paths,
+       no_neighbor_addpath_tx_all_paths_cmd,
+       NO_NEIGHBOR_CMD2 "addpath-tx-all-paths",
+       NO_STR
+       NEIGHBOR_STR
+       NEIGHBOR_ADDR_STR2
+       "Use addpath to advertise all paths to a neighbor\n")
+{
+  return peer_af_flag_unset_vty (vty, argv[0], bgp_node_afi (vty),
+				 bgp_node_safi (vty),
+				 PEER_FLAG_ADDPATH_TX_ALL_PATHS);
+}
 
 /* neighbor send-community. */
 DEFUN (neighbor_send_community,
@@ -2362,6 +2638,9 @@ peer_rsclient_unset_vty (struct vty *vty, const char *peer_str,
   if ( ! CHECK_FLAG (peer->af_flags[afi][safi], PEER_FLAG_RSERVER_CLIENT) )
     return CMD_SUCCESS;
 
+  if (CHECK_FLAG (peer->af_flags[afi][safi], PEER_FLAG_RSERVER_SHARED))
+    return bgp_vty_return (vty, peer_rsclient_shared_unset (peer, afi, safi));
+
   if (CHECK_FLAG(peer->sflags, PEER_STATUS_GROUP))
     {
       group = peer->group;
@@ -2417,6 +2696,34 @@ DEFUN (no_neighbor_route_server_client,
   return peer_rsclient_unset_vty (vty, argv[0], bgp_node_afi(vty),
                   bgp_node_safi(vty));
 }
+
+DEFUN (neighbor_route_server_client_shared,
+       neighbor_route_server_client_shared_cmd,
+       NEIGHBOR_CMD2 "route-server-client shared",
+       NEIGHBOR_STR
+       NEIGHBOR_ADDR_STR2
+       "Configure a neighbor as Route Server client\n"
+       "Share the RIB of the Route Server clients without an import policy\n")
+{
+  struct peer *peer;
+
+  peer = peer_and_group_lookup_vty (vty, argv[0]);
+  if (! peer)
+    return CMD_WARNING;
+
+  return bgp_vty_return (vty, peer_rsclient_shared_set (peer,
+                                                        bgp_node_afi (vty),
+                                                        bgp_node_safi (vty)));
+}
+
+ALIAS (no_neighbor_route_server_client,
+       no_neighbor_route_server_client_shared_cmd,
+       NO_NEIGHBOR_CMD2 "route-server-client shared",
+       NO_STR
+       NEIGHBOR_STR
+       NEIGHBOR_ADDR_STR2
+       "Configure a neighbor as Route Server client\n"
+       "Share the RIB of the Route Server clients without an import policy\n")
 
 DEFUN (neighbor_nexthop_local_unchanged,
        neighbor_nexthop_local_unchanged_cmd,
@@ -3386,6 +3693,51 @@ ALIAS (no_neighbor_timers_connect,
        "BGP per neighbor timers\n"
        "BGP connect timer\n"
        "Connect timer\n")
+
+DEFUN (neighbor_sock_profile,
+       neighbor_sock_profile_cmd,
+       NEIGHBOR_CMD2 BGP_SOCK_PROFILE_CMD,
+       NEIGHBOR_STR
+       NEIGHBOR_ADDR_STR2
+       BGP_SOCK_PROFILE_STR)
+{
+  struct peer *peer;
+  struct bgp_sock_profile sp;
+
+  peer = peer_and_group_lookup_vty (vty, argv[0]);
+  if (! peer)
+    return CMD_WARNING;
+
+  if (bgp_sock_profile_get_vty (vty, argv + 1, &sp) != CMD_SUCCESS)
+    return CMD_WARNING;
+
+  return bgp_vty_return (vty, peer_sock_profile_set (peer, &sp));
+}
+
+DEFUN (no_neighbor_sock_profile,
+       no_neighbor_sock_profile_cmd,
+       NO_NEIGHBOR_CMD2 "socket-profile",
+       NO_STR
+       NEIGHBOR_STR
+       NEIGHBOR_ADDR_STR2
+       "Socket buffers and not sent low water mark of the TCP connection\n")
+{
+  struct peer *peer;
+
+  peer = peer_and_group_lookup_vty (vty, argv[0]);
+  if (! peer)
+    return CMD_WARNING;
+
+  return bgp_vty_return (vty, peer_sock_profile_unset (peer));
+}
+
+ALIAS (no_neighbor_sock_profile,
+       no_neighbor_sock_profile_val_cmd,
+       NO_NEIGHBOR_CMD2 BGP_SOCK_PROFILE_CMD,
+       NO_STR
+       NEIGHBOR_STR
+       NEIGHBOR_ADDR_STR2
+       BGP_SOCK_PROFILE_STR)
 
 static int
 peer_advertise_interval_vty (struct vty *vty, const char *ip_str, 
@@ -3870,7 +4222,7 @@ static int
 peer_maximum_prefix_set_vty (struct vty *vty, const char *ip_str, afi_t afi,
 			     safi_t safi, const char *num_str,  
 			     const char *threshold_str, int warning,
-			     const char *restart_str)
+			     int discard, const char *restart_str)
 {
   int ret;
   struct peer *peer;
@@ -3893,7 +4245,8 @@ peer_maximum_prefix_set_vty (struct vty *vty, const char *ip_str, afi_t afi,
   else
     restart = 0;
 
-  ret = peer_maximum_prefix_set (peer, afi, safi, max, threshold, warning, restart);
+  ret = peer_maximum_prefix_set (peer, afi, safi, max, threshold, warning,
+				 discard, restart);
 
   return bgp_vty_return (vty, ret);
 }
@@ -3926,7 +4279,7 @@ DEFUN (neighbor_maximum_prefix,
        "maximum no. of prefix limit\n")
 {
   return peer_maximum_prefix_set_vty (vty, argv[0], bgp_node_afi (vty),
-				      bgp_node_safi (vty), argv[1], NULL, 0,
+				      bgp_node_safi (vty), argv[1], NULL, 0, 0,
 				      NULL);
 }
 
@@ -3940,7 +4293,7 @@ DEFUN (neighbor_maximum_prefix_threshold,
        "Threshold value (%) at which to generate a warning msg\n")
 {
   return peer_maximum_prefix_set_vty (vty, argv[0], bgp_node_afi (vty),
-				      bgp_node_safi (vty), argv[1], argv[2], 0,
+				      bgp_node_safi (vty), argv[1], argv[2], 0, 0,
 				      NULL);
 }
 
@@ -3954,7 +4307,7 @@ DEFUN (neighbor_maximum_prefix_warning,
        "Only give warning message when limit is exceeded\n")
 {
   return peer_maximum_prefix_set_vty (vty, argv[0], bgp_node_afi (vty),
-				      bgp_node_safi (vty), argv[1], NULL, 1,
+				      bgp_node_safi (vty), argv[1], NULL, 1, 0,
 				      NULL);
 }
 
@@ -3969,7 +4322,37 @@ DEFUN (neighbor_maximum_prefix_threshold_warning,
        "Only give warning message when limit is exceeded\n")
 {
   return peer_maximum_prefix_set_vty (vty, argv[0], bgp_node_afi (vty),
-				      bgp_node_safi (vty), argv[1], argv[2], 1, NULL);
+				      bgp_node_safi (vty), argv[1], argv[2], 1, 0,
+				      NULL);
+}
+
+DEFUN (neighbor_maximum_prefix_discard,
+       neighbor_maximum_prefix_discard_cmd,
+       NEIGHBOR_CMD2 "maximum-prefix <1-4294967295> discard-extra",
+       NEIGHBOR_STR
+       NEIGHBOR_ADDR_STR2
+       "Maximum number of prefix accept from this peer\n"
+       "maximum no. of prefix limit\n"
+       "Drop new prefixes over the limit instead of resetting the session\n")
+{
+  return peer_maximum_prefix_set_vty (vty, argv[0], bgp_node_afi (vty),
+				      bgp_node_safi (vty), argv[1], NULL, 0, 1,
+				      NULL);
+}
+
+DEFUN (neighbor_maximum_prefix_threshold_discard,
+       neighbor_maximum_prefix_threshold_discard_cmd,
+       NEIGHBOR_CMD2 "maximum-prefix <1-4294967295> <1-100> discard-extra",
+       NEIGHBOR_STR
+       NEIGHBOR_ADDR_STR2
+       "Maximum number of prefix accept from this peer\n"
+       "maximum no. of prefix limit\n"
+       "Threshold value (%) at which to generate a warning msg\n"
+       "Drop new prefixes over the limit instead of resetting the session\n")
+{
+  return peer_maximum_prefix_set_vty (vty, argv[0], bgp_node_afi (vty),
+				      bgp_node_safi (vty), argv[1], argv[2], 0, 1,
+				      NULL);
 }
 
 DEFUN (neighbor_maximum_prefix_restart,
@@ -3983,7 +4366,8 @@ DEFUN (neighbor_maximum_prefix_restart,
        "Restart interval in minutes")
 {
   return peer_maximum_prefix_set_vty (vty, argv[0], bgp_node_afi (vty),
-				      bgp_node_safi (vty), argv[1], NULL, 0, argv[2]);
+				      bgp_node_safi (vty), argv[1], NULL, 0, 0,
+				      argv[2]);
 }
 
 DEFUN (neighbor_maximum_prefix_threshold_restart,
@@ -3998,7 +4382,8 @@ DEFUN (neighbor_maximum_prefix_threshold_restart,
        "Restart interval in minutes")
 {
   return peer_maximum_prefix_set_vty (vty, argv[0], bgp_node_afi (vty),
-				      bgp_node_safi (vty), argv[1], argv[2], 0, argv[3]);
+				      bgp_node_safi (vty), argv[1], argv[2], 0, 0,
+				      argv[3]);
 }
 
 DEFUN (no_neighbor_maximum_prefix,
@@ -4053,6 +4438,27 @@ ALIAS (no_neighbor_maximum_prefix,
        "Threshold value (%) at which to generate a warning msg\n"
        "Only give warning message when limit is exceeded\n")
 
+ALIAS (no_neighbor_maximum_prefix,
+       no_neighbor_maximum_prefix_discard_cmd,
+       NO_NEIGHBOR_CMD2 "maximum-prefix <1-4294967295> discard-extra",
+       NO_STR
+       NEIGHBOR_STR
+       NEIGHBOR_ADDR_STR2
+       "Maximum number of prefix accept from this peer\n"
+       "maximum no. of prefix limit\n"
+       "Drop new prefixes over the limit instead of resetting the session\n")
+
+ALIAS (no_neighbor_maximum_prefix,
+       no_neighbor_maximum_prefix_threshold_discard_cmd,
+       NO_NEIGHBOR_CMD2 "maximum-prefix <1-4294967295> <1-100> discard-extra",
+       NO_STR
+       NEIGHBOR_STR
+       NEIGHBOR_ADDR_STR2
+       "Maximum number of prefix accept from this peer\n"
+       "maximum no. of prefix limit\n"
+       "Threshold value (%) at which to generate a warning msg\n"
+       "Drop new prefixes over the limit instead of resetting the session\n")
+
 ALIAS (no_neighbor_maximum_prefix,
        no_neighbor_maximum_prefix_restart_cmd,
        NO_NEIGHBOR_CMD2 "maximum-prefix <1-4294967295> restart <1-65535>",
@@ -6889,6 +7295,110 @@ DEFUN (show_bgp_memory,
   return CMD_SUCCESS;
 }
 
+/* RIB memory held for a peer, see "show bgp memory peers". */
+struct bgp_peer_mem
+{
+  struct peer *peer;
+  unsigned long rsnodes;
+  unsigned long total;
+};
+
+static int
+bgp_peer_mem_cmp (const void *a, const void *b)
+{
+  const struct bgp_peer_mem *m1 = a;
+  const struct bgp_peer_mem *m2 = b;
+
+  if (m1->total != m2->total)
+    return m1->total > m2->total ? -1 : 1;
+  return 0;
+}
+
+static void
+bgp_peer_mem_get (struct bgp_peer_mem *m, struct peer *peer)
+{
+  struct bgp_table *table;
+  afi_t afi;
+  safi_t safi;
+
+  m->peer = peer;
+  m->rsnodes = 0;
+  for (afi = AFI_IP; afi < AFI_MAX; afi++)
+    for (safi = SAFI_UNICAST; safi < SAFI_MAX; safi++)
+      if ((table = peer->rib[afi][safi]) != NULL && table->owner == peer)
+	m->rsnodes += route_table_count (table->route_table)
+		      * sizeof (struct bgp_node);
+  m->total = peer->mem_paths + peer->mem_adj_in + peer->mem_adj_out
+	     + peer->mem_adv + m->rsnodes;
+}
+
+DEFUN (show_bgp_memory_peers,
+       show_bgp_memory_peers_cmd,
+       "show bgp memory peers",
+       SHOW_STR
+       BGP_STR
+       "Global BGP memory statistics\n"
+       "RIB memory held for each peer, largest first\n")
+{
+  struct bgp_peer_mem *mem;
+  struct bgp *bgp;
+  struct peer *peer;
+  struct listnode *node, *pnode;
+  unsigned long count = 0;
+  unsigned long i, n;
+  unsigned long limit = 0;
+  char buf[6][MTYPE_MEMSTR_LEN];
+
+  if (argc > 0)
+    VTY_GET_INTEGER_RANGE ("count", limit, argv[0], 1, 65535);
+
+  for (ALL_LIST_ELEMENTS_RO (bm->bgp, node, bgp))
+    count += listcount (bgp->peer) + (bgp->rsclient_base ? 1 : 0);
+  if (! count)
+    return CMD_SUCCESS;
+
+  mem = XCALLOC (MTYPE_TMP, count * sizeof (struct bgp_peer_mem));
+  n = 0;
+  for (ALL_LIST_ELEMENTS_RO (bm->bgp, node, bgp))
+    {
+      for (ALL_LIST_ELEMENTS_RO (bgp->peer, pnode, peer))
+	bgp_peer_mem_get (&mem[n++], peer);
+      if (bgp->rsclient_base)
+	bgp_peer_mem_get (&mem[n++], bgp->rsclient_base);
+    }
+  qsort (mem, n, sizeof (struct bgp_peer_mem), bgp_peer_mem_cmp);
+  if (limit && limit < n)
+    n = limit;
+
+  vty_out (vty, "%-16s %10s %10s %10s %10s %10s %10s%s", "Neighbor",
+	   "Paths", "Adj-In", "Adj-Out", "Queued", "RS-Nodes", "Total",
+	   VTY_NEWLINE);
+  for (i = 0; i < n; i++)
+    {
+      peer = mem[i].peer;
+      vty_out (vty, "%-16s %10s %10s %10s %10s %10s %10s%s", peer->host,
+	       mtype_memstr (buf[0], MTYPE_MEMSTR_LEN, peer->mem_paths),
+	       mtype_memstr (buf[1], MTYPE_MEMSTR_LEN, peer->mem_adj_in),
+	       mtype_memstr (buf[2], MTYPE_MEMSTR_LEN, peer->mem_adj_out),
+	       mtype_memstr (buf[3], MTYPE_MEMSTR_LEN, peer->mem_adv),
+	       mtype_memstr (buf[4], MTYPE_MEMSTR_LEN, mem[i].rsnodes),
+	       mtype_memstr (buf[5], MTYPE_MEMSTR_LEN, mem[i].total),
+	       VTY_NEWLINE);
+    }
+
+  XFREE (MTYPE_TMP, mem);
+  return CMD_SUCCESS;
+}
+
+ALIAS (show_bgp_memory_peers,
+       show_bgp_memory_peers_count_cmd,
+       "show bgp memory peers <1-65535>",
+       SHOW_STR
+       BGP_STR
+       "Global BGP memory statistics\n"
+       "RIB memory held for each peer, largest first\n"
+       "Number of peers to show\n")
+
 /* Show BGP peer's summary information. */
 static int
 bgp_show_summary (struct vty *vty, struct bgp *bgp, int afi, int safi)
@@ -6930,7 +7440,12 @@ bgp_show_summary (struct vty *vty, struct bgp *bgp, int afi, int safi)
                                      ents * sizeof (struct peer)),
                        VTY_NEWLINE);
               
-              if ((ents = listcount (bgp->rsclient)))
+              ents = listcount (bgp->rsclient)
+                     + listcount (bgp->rsclient_shared)
+                     - (bgp->rsclient_base
+                        && listnode_lookup (bgp->rsclient,
+                                            bgp->rsclient_base) ? 1 : 0);
+              if (ents)
                 vty_out (vty, "RS-Client peers %ld, using %s of memory%s",
                          ents,
                          mtype_memstr (memstrbuf, sizeof (memstrbuf),
@@ -6945,6 +7460,10 @@ bgp_show_summary (struct vty *vty, struct bgp *bgp, int afi, int safi)
 
               if (CHECK_FLAG (bgp->af_flags[afi][safi], BGP_CONFIG_DAMPENING))
                 vty_out (vty, "Dampening enabled.%s", VTY_NEWLINE);
+              if (BGP_UPDATE_DELAY_ACTIVE (bgp))
+                vty_out (vty, "Update-delay in progress, %lu seconds left.%s",
+                         thread_timer_remain_second (bgp->t_update_delay),
+                         VTY_NEWLINE);
               vty_out (vty, "%s", VTY_NEWLINE);
               vty_out (vty, "%s%s", header, VTY_NEWLINE);
             }
@@ -7374,12 +7893,17 @@ bgp_show_peer_afi (struct vty *vty, struct peer *p, afi_t afi, safi_t safi)
 
   if (CHECK_FLAG (p->af_flags[afi][safi], PEER_FLAG_REFLECTOR_CLIENT))
     vty_out (vty, "  Route-Reflector Client%s", VTY_NEWLINE);
-  if (CHECK_FLAG (p->af_flags[afi][safi], PEER_FLAG_RSERVER_CLIENT))
+  if (CHECK_FLAG (p->af_flags[afi][safi], PEER_FLAG_RSERVER_SHARED))
+    vty_out (vty, "  Route-Server Client, sharing the baseline RIB%s",
+             VTY_NEWLINE);
+  else if (CHECK_FLAG (p->af_flags[afi][safi], PEER_FLAG_RSERVER_CLIENT))
     vty_out (vty, "  Route-Server Client%s", VTY_NEWLINE);
   if (CHECK_FLAG (p->af_flags[afi][safi], PEER_FLAG_SOFT_RECONFIG))
     vty_out (vty, "  Inbound soft reconfiguration allowed%s", VTY_NEWLINE);
   if (CHECK_FLAG (p->af_flags[afi][safi], PEER_FLAG_REMOVE_PRIVATE_AS))
     vty_out (vty, "  Private AS number removed from updates to this neighbor%s", VTY_NEWLINE);
+  if (CHECK_FLAG (p->af_flags[afi][safi], PEER_FLAG_ADDPATH_TX_ALL_PATHS))
+    vty_out (vty, "  Advertise all paths via addpath%s", VTY_NEWLINE);
   if (CHECK_FLAG (p->af_flags[afi][safi], PEER_FLAG_NEXTHOP_SELF))
     vty_out (vty, "  NEXT_HOP is always this router%s", VTY_NEWLINE);
   if (CHECK_FLAG (p->af_flags[afi][safi], PEER_FLAG_AS_PATH_UNCHANGED))
@@ -7500,9 +8024,14 @@ bgp_show_peer_afi (struct vty *vty, struct peer *p, afi_t afi, safi_t safi)
   /* Maximum prefix */
   if (CHECK_FLAG (p->af_flags[afi][safi], PEER_FLAG_MAX_PREFIX))
     {
-      vty_out (vty, "  Maximum prefixes allowed %ld%s%s", p->pmax[afi][safi],
+      vty_out (vty, "  Maximum prefixes allowed %ld%s%s%s", p->pmax[afi][safi],
 	       CHECK_FLAG (p->af_flags[afi][safi], PEER_FLAG_MAX_PREFIX_WARNING)
-	       ? " (warning-only)" : "", VTY_NEWLINE);
+	       ? " (warning-only)" : "",
+	       CHECK_FLAG (p->af_flags[afi][safi], PEER_FLAG_MAX_PREFIX_DISCARD)
+	       ? " (discard-extra)" : "", VTY_NEWLINE);
+      if (CHECK_FLAG (p->af_flags[afi][safi], PEER_FLAG_MAX_PREFIX_DISCARD))
+	vty_out (vty, "  %u prefixes discarded over the limit%s",
+		 p->pdiscard[afi][safi], VTY_NEWLINE);
       vty_out (vty, "  Threshold for warning message %d%%",
 	       p->pmax_threshold[afi][safi]);
       if (p->pmax_restart[afi][safi])
@@ -7513,6 +8042,46 @@ bgp_show_peer_afi (struct vty *vty, struct peer *p, afi_t afi, safi_t safi)
   vty_out (vty, "%s", VTY_NEWLINE);
 }
 
+/* A socket profile value, 0 being what the kernel does. */
+static const char *
+bgp_sock_profile_str (u_int32_t val, const char *zero, char *buf, size_t len)
+{
+  if (val == 0)
+    return zero;
+  snprintf (buf, len, "%u", val);
+  return buf;
+}
+
+/* The socket profile of the peer, and the buffer sizes and mark its
+   connection has for it. */
+static void
+bgp_show_peer_socket (struct vty *vty, struct peer *p)
+{
+  const struct bgp_sock_profile *sp = peer_sock_profile (p);
+  char buf1[16], buf2[16], buf3[16];
+  int lowat;
+
+  vty_out (vty, "  Socket profile%s: send buffer %s, receive buffer %s,"
+	   " not sent low water mark %s%s",
+	   CHECK_FLAG (p->config, PEER_CONFIG_SOCK_PROFILE) ? "" : " (bgp)",
+	   bgp_sock_profile_str (sp->sndbuf, "auto", buf1, sizeof (buf1)),
+	   bgp_sock_profile_str (sp->rcvbuf, "auto", buf2, sizeof (buf2)),
+	   bgp_sock_profile_str (sp->notsent_lowat, "none", buf3,
+				 sizeof (buf3)),
+	   VTY_NEWLINE);
+
+  if (p->fd < 0 || p->status == Connect)
+    return;
+
+  lowat = getsockopt_notsent_lowat (p->fd);
+  vty_out (vty, "    In effect: send buffer %d, receive buffer %d,"
+	   " not sent low water mark %s%s",
+	   getsockopt_so_sendbuf (p->fd), getsockopt_so_recvbuf (p->fd),
+	   bgp_sock_profile_str (lowat > 0 ? lowat : 0, "none", buf3,
+				 sizeof (buf3)),
+	   VTY_NEWLINE);
+}
+
 static void
 bgp_show_peer (struct vty *vty, struct peer *p)
 {
@@ -7521,6 +8090,8 @@ bgp_show_peer (struct vty *vty, struct peer *p)
   char timebuf[BGP_UPTIME_LEN];
   afi_t afi;
   safi_t safi;
+  u_int32_t msgs_out;
+  unsigned long inq, inq_bytes;
 
   bgp = p->bgp;
 
@@ -7652,6 +8223,25 @@ bgp_show_peer (struct vty *vty, struct peer *p)
 	      vty_out (vty, "%s", VTY_NEWLINE);
 	    }
 
+	  /* ADD-PATH */
+	  if (CHECK_FLAG (p->af_cap[AFI_IP][SAFI_UNICAST],
+			  PEER_CAP_ADDPATH_AF_TX_ADV)
+	      || CHECK_FLAG (p->af_cap[AFI_IP][SAFI_UNICAST],
+			     PEER_CAP_ADDPATH_AF_RX_RCV))
+	    {
+	      vty_out (vty, "    AddPath:%s", VTY_NEWLINE);
+	      vty_out (vty, "      %s: TX", afi_safi_print (AFI_IP, SAFI_UNICAST));
+	      if (CHECK_FLAG (p->af_cap[AFI_IP][SAFI_UNICAST],
+			      PEER_CAP_ADDPATH_AF_TX_ADV))
+		vty_out (vty, " advertised");
+	      if (CHECK_FLAG (p->af_cap[AFI_IP][SAFI_UNICAST],
+			      PEER_CAP_ADDPATH_AF_RX_RCV))
+		vty_out (vty, " %sreceived",
+			 CHECK_FLAG (p->af_cap[AFI_IP][SAFI_UNICAST],
+				     PEER_CAP_ADDPATH_AF_TX_ADV) ? "and " : "");
+	      vty_out (vty, "%s", VTY_NEWLINE);
+	    }
+
 	  /* Multiprotocol Extensions */
 	  for (afi = AFI_IP ; afi < AFI_MAX ; afi++)
 	    for (safi = SAFI_UNICAST ; safi < SAFI_MAX ; safi++)
@@ -7748,7 +8338,11 @@ bgp_show_peer (struct vty *vty, struct peer *p)
 
   /* Packet counts. */
   vty_out (vty, "  Message statistics:%s", VTY_NEWLINE);
-  vty_out (vty, "    Inq depth is 0%s", VTY_NEWLINE);
+  inq = bgp_read_backlog (p, &inq_bytes);
+  vty_out (vty, "    Inq depth is %lu (%lu bytes, peak %lu)%s",
+	   inq, inq_bytes, p->read_backlog_peak, VTY_NEWLINE);
+  vty_out (vty, "    Read turns %u, yielded %u with input pending%s",
+	   p->read_turns, p->read_yields, VTY_NEWLINE);
   vty_out (vty, "    Outq depth is %lu%s", (unsigned long) p->obuf->count, VTY_NEWLINE);
   vty_out (vty, "                         Sent       Rcvd%s", VTY_NEWLINE);
   vty_out (vty, "    Opens:         %10d %10d%s", p->open_out, p->open_in, VTY_NEWLINE);
@@ -7761,6 +8355,18 @@ bgp_show_peer (struct vty *vty, struct peer *p)
 	   p->update_out + p->keepalive_out + p->refresh_out + p->dynamic_cap_out,
 	   p->open_in + p->notify_in + p->update_in + p->keepalive_in + p->refresh_in +
 	   p->dynamic_cap_in, VTY_NEWLINE);
+  msgs_out = p->open_out + p->notify_out + p->update_out + p->keepalive_out
+	     + p->refresh_out + p->dynamic_cap_out;
+  vty_out (vty, "    Write calls:   %10u (%.2f per message)%s", p->write_calls,
+	   msgs_out ? (double) p->write_calls / msgs_out : 0.0, VTY_NEWLINE);
+  vty_out (vty, "    Update prefixes: %8u (%.2f updates per prefix)%s",
+	   p->update_prefix_out,
+	   p->update_prefix_out
+	   ? (double) p->update_out / p->update_prefix_out : 0.0, VTY_NEWLINE);
+  vty_out (vty, "    Coalesced:     %10u replaced, %u cancelled%s",
+	   p->adv_replaced, p->adv_cancelled, VTY_NEWLINE);
+
+  bgp_show_peer_socket (vty, p);
 
   /* advertisement-interval */
   vty_out (vty, "  Minimum time between advertisement runs is %d seconds%s",
@@ -8277,6 +8883,9 @@ bgp_write_rsclient_summary (struct vty *vty, struct peer *rsclient,
       sprintf (rmbuf, "%13s", "...");
       rmname = strncpy (rmbuf, rmname, 10);
     }
+  else if (CHECK_FLAG (rsclient->af_flags[afi][safi],
+                       PEER_FLAG_RSERVER_SHARED))
+    rmname = "<shared>";
   else if (! rmname)
     rmname = "<none>";
   vty_out (vty, " %13s ", rmname);
@@ -8301,32 +8910,41 @@ bgp_show_rsclient_summary (struct vty *vty, struct bgp *bgp,
 {
   struct peer *peer;
   struct listnode *node, *nnode;
+  struct list *rsclients[2];
+  int i;
   int count = 0;
 
   /* Header string for each address family. */
   static char header[] = "Neighbor        V    AS  Export-Policy  Import-Policy  Up/Down  State";
 
-  for (ALL_LIST_ELEMENTS (bgp->rsclient, node, nnode, peer))
-    {
-      if (peer->afc[afi][safi] &&
-         CHECK_FLAG (peer->af_flags[afi][safi], PEER_FLAG_RSERVER_CLIENT))
-       {
-         if (! count)
-           {
-             vty_out (vty,
-                      "Route Server's BGP router identifier %s%s",
-                      inet_ntoa (bgp->router_id), VTY_NEWLINE);
-             vty_out (vty,
-              "Route Server's local AS number %u%s", bgp->as,
-                       VTY_NEWLINE);
+  rsclients[0] = bgp->rsclient;
+  rsclients[1] = bgp->rsclient_shared;
 
-             vty_out (vty, "%s", VTY_NEWLINE);
-             vty_out (vty, "%s%s", header, VTY_NEWLINE);
-           }
+  for (i = 0; i < 2; i++)
+    for (ALL_LIST_ELEMENTS (rsclients[i], node, nnode, peer))
+      {
+        if (peer == bgp->rsclient_base)
+          continue;
+
+        if (peer->afc[afi][safi] &&
+            CHECK_FLAG (peer->af_flags[afi][safi], PEER_FLAG_RSERVER_CLIENT))
+          {
+            if (! count)
+              {
+                vty_out (vty,
+                         "Route Server's BGP router identifier %s%s",
+                         inet_ntoa (bgp->router_id), VTY_NEWLINE);
+                vty_out (vty,
+                         "Route Server's local AS number %u%s", bgp->as,
+                         VTY_NEWLINE);
 
-         count += bgp_write_rsclient_summary (vty, peer, afi, safi);
-       }
-    }
+                vty_out (vty, "%s", VTY_NEWLINE);
+                vty_out (vty, "%s%s", header, VTY_NEWLINE);
+              }
+
+            count += bgp_write_rsclient_summary (vty, peer, afi, safi);
+          }
+      }
 
   if (count)
     vty_out (vty, "%sTotal number of Route Server Clients %d%s", VTY_NEWLINE,
@@ -9078,6 +9696,10 @@ bgp_vty_init (void)
   install_element (CONFIG_NODE, &bgp_multiple_instance_cmd);
   install_element (CONFIG_NODE, &no_bgp_multiple_instance_cmd);
 
+  /* "bgp walk-budget" commands. */
+  install_element (CONFIG_NODE, &bgp_walk_budget_cmd);
+  install_element (CONFIG_NODE, &no_bgp_walk_budget_cmd);
+
   /* "bgp config-type" commands. */
   install_element (CONFIG_NODE, &bgp_config_type_cmd);
   install_element (CONFIG_NODE, &no_bgp_config_type_cmd);
@@ -9131,6 +9753,9 @@ bgp_vty_init (void)
   /* "timers bgp" commands. */
   install_element (BGP_NODE, &bgp_timers_cmd);
   install_element (BGP_NODE, &no_bgp_timers_cmd);
+  install_element (BGP_NODE, &bgp_sock_profile_cmd);
+  install_element (BGP_NODE, &no_bgp_sock_profile_cmd);
+  install_element (BGP_NODE, &no_bgp_sock_profile_arg_cmd);
   install_element (BGP_NODE, &no_bgp_timers_arg_cmd);
 
   /* "bgp client-to-client reflection" commands */
@@ -9145,12 +9770,30 @@ bgp_vty_init (void)
   install_element (BGP_NODE, &bgp_deterministic_med_cmd);
   install_element (BGP_NODE, &no_bgp_deterministic_med_cmd);
 
+  /* "bgp adj-rib-in view" commands. */
+  install_element (BGP_NODE, &bgp_adj_rib_in_view_cmd);
+  install_element (BGP_NODE, &no_bgp_adj_rib_in_view_cmd);
+  install_element (BGP_NODE, &no_bgp_adj_rib_in_view_name_cmd);
+
+  /* "bgp route-map cache" commands */
+  install_element (BGP_NODE, &bgp_rmap_cache_cmd);
+  install_element (BGP_NODE, &no_bgp_rmap_cache_cmd);
+
+  /* "bgp suppress-fib-pending" commands. */
+  install_element (BGP_NODE, &bgp_suppress_fib_pending_cmd);
+  install_element (BGP_NODE, &no_bgp_suppress_fib_pending_cmd);
+
   /* "bgp graceful-restart" commands */
   install_element (BGP_NODE, &bgp_graceful_restart_cmd);
   install_element (BGP_NODE, &no_bgp_graceful_restart_cmd);
   install_element (BGP_NODE, &bgp_graceful_restart_stalepath_time_cmd);
   install_element (BGP_NODE, &no_bgp_graceful_restart_stalepath_time_cmd);
   install_element (BGP_NODE, &no_bgp_graceful_restart_stalepath_time_val_cmd);
+
+  /* "bgp update-delay" commands. */
+  install_element (BGP_NODE, &bgp_update_delay_cmd);
+  install_element (BGP_NODE, &no_bgp_update_delay_cmd);
+  install_element (BGP_NODE, &no_bgp_update_delay_val_cmd);
  
   /* "bgp fast-external-failover" commands */
   install_element (BGP_NODE, &bgp_fast_external_failover_cmd);
@@ -9437,6 +10080,12 @@ bgp_vty_init (void)
   install_element (BGP_VPNV4_NODE, &neighbor_remove_private_as_cmd);
   install_element (BGP_VPNV4_NODE, &no_neighbor_remove_private_as_cmd);
 
+  /* "neighbor addpath-tx-all-paths" commands.*/
+  install_element (BGP_NODE, &neighbor_addpath_tx_all_paths_cmd);
+  install_element (BGP_NODE, &no_neighbor_addpath_tx_all_paths_cmd);
+  install_element (BGP_IPV4_NODE, &neighbor_addpath_tx_all_paths_cmd);
+  install_element (BGP_IPV4_NODE, &no_neighbor_addpath_tx_all_paths_cmd);
+
   /* "neighbor send-community" commands.*/
   install_element (BGP_NODE, &neighbor_send_community_cmd);
   install_element (BGP_NODE, &neighbor_send_community_type_cmd);
@@ -9480,16 +10129,28 @@ bgp_vty_init (void)
   /* "neighbor route-server" commands.*/
   install_element (BGP_NODE, &neighbor_route_server_client_cmd);
   install_element (BGP_NODE, &no_neighbor_route_server_client_cmd);
+  install_element (BGP_NODE, &neighbor_route_server_client_shared_cmd);
+  install_element (BGP_NODE, &no_neighbor_route_server_client_shared_cmd);
   install_element (BGP_IPV4_NODE, &neighbor_route_server_client_cmd);
   install_element (BGP_IPV4_NODE, &no_neighbor_route_server_client_cmd);
+  install_element (BGP_IPV4_NODE, &neighbor_route_server_client_shared_cmd);
+  install_element (BGP_IPV4_NODE, &no_neighbor_route_server_client_shared_cmd);
   install_element (BGP_IPV4M_NODE, &neighbor_route_server_client_cmd);
   install_element (BGP_IPV4M_NODE, &no_neighbor_route_server_client_cmd);
+  install_element (BGP_IPV4M_NODE, &neighbor_route_server_client_shared_cmd);
+  install_element (BGP_IPV4M_NODE, &no_neighbor_route_server_client_shared_cmd);
   install_element (BGP_IPV6_NODE, &neighbor_route_server_client_cmd);
   install_element (BGP_IPV6_NODE, &no_neighbor_route_server_client_cmd);
+  install_element (BGP_IPV6_NODE, &neighbor_route_server_client_shared_cmd);
+  install_element (BGP_IPV6_NODE, &no_neighbor_route_server_client_shared_cmd);
   install_element (BGP_IPV6M_NODE, &neighbor_route_server_client_cmd);
   install_element (BGP_IPV6M_NODE, &no_neighbor_route_server_client_cmd);
+  install_element (BGP_IPV6M_NODE, &neighbor_route_server_client_shared_cmd);
+  install_element (BGP_IPV6M_NODE, &no_neighbor_route_server_client_shared_cmd);
   install_element (BGP_VPNV4_NODE, &neighbor_route_server_client_cmd);
   install_element (BGP_VPNV4_NODE, &no_neighbor_route_server_client_cmd);
+  install_element (BGP_VPNV4_NODE, &neighbor_route_server_client_shared_cmd);
+  install_element (BGP_VPNV4_NODE, &no_neighbor_route_server_client_shared_cmd);
 
   /* "neighbor passive" commands. */
   install_element (BGP_NODE, &neighbor_passive_cmd);
@@ -9591,6 +10252,9 @@ bgp_vty_init (void)
   /* "neighbor timers connect" commands. */
   install_element (BGP_NODE, &neighbor_timers_connect_cmd);
   install_element (BGP_NODE, &no_neighbor_timers_connect_cmd);
+  install_element (BGP_NODE, &neighbor_sock_profile_cmd);
+  install_element (BGP_NODE, &no_neighbor_sock_profile_cmd);
+  install_element (BGP_NODE, &no_neighbor_sock_profile_val_cmd);
   install_element (BGP_NODE, &no_neighbor_timers_connect_val_cmd);
 
   /* "neighbor advertisement-interval" commands. */
@@ -9680,6 +10344,8 @@ bgp_vty_init (void)
   install_element (BGP_NODE, &neighbor_maximum_prefix_threshold_cmd);
   install_element (BGP_NODE, &neighbor_maximum_prefix_warning_cmd);
   install_element (BGP_NODE, &neighbor_maximum_prefix_threshold_warning_cmd);
+  install_element (BGP_NODE, &neighbor_maximum_prefix_discard_cmd);
+  install_element (BGP_NODE, &neighbor_maximum_prefix_threshold_discard_cmd);
   install_element (BGP_NODE, &neighbor_maximum_prefix_restart_cmd);
   install_element (BGP_NODE, &neighbor_maximum_prefix_threshold_restart_cmd);
   install_element (BGP_NODE, &no_neighbor_maximum_prefix_cmd);
@@ -9687,12 +10353,16 @@ bgp_vty_init (void)
   install_element (BGP_NODE, &no_neighbor_maximum_prefix_threshold_cmd);
   install_element (BGP_NODE, &no_neighbor_maximum_prefix_warning_cmd);
   install_element (BGP_NODE, &no_neighbor_maximum_prefix_threshold_warning_cmd);
+  install_element (BGP_NODE, &no_neighbor_maximum_prefix_discard_cmd);
+  install_element (BGP_NODE, &no_neighbor_maximum_prefix_threshold_discard_cmd);
   install_element (BGP_NODE, &no_neighbor_maximum_prefix_restart_cmd);
   install_element (BGP_NODE, &no_neighbor_maximum_prefix_threshold_restart_cmd);
   install_element (BGP_IPV4_NODE, &neighbor_maximum_prefix_cmd);
   install_element (BGP_IPV4_NODE, &neighbor_maximum_prefix_threshold_cmd);
   install_element (BGP_IPV4_NODE, &neighbor_maximum_prefix_warning_cmd);
   install_element (BGP_IPV4_NODE, &neighbor_maximum_prefix_threshold_warning_cmd);
+  install_element (BGP_IPV4_NODE, &neighbor_maximum_prefix_discard_cmd);
+  install_element (BGP_IPV4_NODE, &neighbor_maximum_prefix_threshold_discard_cmd);
   install_element (BGP_IPV4_NODE, &neighbor_maximum_prefix_restart_cmd);
   install_element (BGP_IPV4_NODE, &neighbor_maximum_prefix_threshold_restart_cmd);
   install_element (BGP_IPV4_NODE, &no_neighbor_maximum_prefix_cmd);
@@ -9700,12 +10370,16 @@ bgp_vty_init (void)
   install_element (BGP_IPV4_NODE, &no_neighbor_maximum_prefix_threshold_cmd);
   install_element (BGP_IPV4_NODE, &no_neighbor_maximum_prefix_warning_cmd);
   install_element (BGP_IPV4_NODE, &no_neighbor_maximum_prefix_threshold_warning_cmd);
+  install_element (BGP_IPV4_NODE, &no_neighbor_maximum_prefix_discard_cmd);
+  install_element (BGP_IPV4_NODE, &no_neighbor_maximum_prefix_threshold_discard_cmd);
   install_element (BGP_IPV4_NODE, &no_neighbor_maximum_prefix_restart_cmd);
   install_element (BGP_IPV4_NODE, &no_neighbor_maximum_prefix_threshold_restart_cmd);
   install_element (BGP_IPV4M_NODE, &neighbor_maximum_prefix_cmd);
   install_element (BGP_IPV4M_NODE, &neighbor_maximum_prefix_threshold_cmd);
   install_element (BGP_IPV4M_NODE, &neighbor_maximum_prefix_warning_cmd);
   install_element (BGP_IPV4M_NODE, &neighbor_maximum_prefix_threshold_warning_cmd);
+  install_element (BGP_IPV4M_NODE, &neighbor_maximum_prefix_discard_cmd);
+  install_element (BGP_IPV4M_NODE, &neighbor_maximum_prefix_threshold_discard_cmd);
   install_element (BGP_IPV4M_NODE, &neighbor_maximum_prefix_restart_cmd);
   install_element (BGP_IPV4M_NODE, &neighbor_maximum_prefix_threshold_restart_cmd);
   install_element (BGP_IPV4M_NODE, &no_neighbor_maximum_prefix_cmd);
@@ -9713,12 +10387,16 @@ bgp_vty_init (void)
   install_element (BGP_IPV4M_NODE, &no_neighbor_maximum_prefix_threshold_cmd);
   install_element (BGP_IPV4M_NODE, &no_neighbor_maximum_prefix_warning_cmd);
   install_element (BGP_IPV4M_NODE, &no_neighbor_maximum_prefix_threshold_warning_cmd);
+  install_element (BGP_IPV4M_NODE, &no_neighbor_maximum_prefix_discard_cmd);
+  install_element (BGP_IPV4M_NODE, &no_neighbor_maximum_prefix_threshold_discard_cmd);
   install_element (BGP_IPV4M_NODE, &no_neighbor_maximum_prefix_restart_cmd);
   install_element (BGP_IPV4M_NODE, &no_neighbor_maximum_prefix_threshold_restart_cmd);
   install_element (BGP_IPV6_NODE, &neighbor_maximum_prefix_cmd);
   install_element (BGP_IPV6_NODE, &neighbor_maximum_prefix_threshold_cmd);
   install_element (BGP_IPV6_NODE, &neighbor_maximum_prefix_warning_cmd);
   install_element (BGP_IPV6_NODE, &neighbor_maximum_prefix_threshold_warning_cmd);
+  install_element (BGP_IPV6_NODE, &neighbor_maximum_prefix_discard_cmd);
+  install_element (BGP_IPV6_NODE, &neighbor_maximum_prefix_threshold_discard_cmd);
   install_element (BGP_IPV6_NODE, &neighbor_maximum_prefix_restart_cmd);
   install_element (BGP_IPV6_NODE, &neighbor_maximum_prefix_threshold_restart_cmd);
   install_element (BGP_IPV6_NODE, &no_neighbor_maximum_prefix_cmd);
@@ -9726,12 +10404,16 @@ bgp_vty_init (void)
   install_element (BGP_IPV6_NODE, &no_neighbor_maximum_prefix_threshold_cmd);
   install_element (BGP_IPV6_NODE, &no_neighbor_maximum_prefix_warning_cmd);
   install_element (BGP_IPV6_NODE, &no_neighbor_maximum_prefix_threshold_warning_cmd);
+  install_element (BGP_IPV6_NODE, &no_neighbor_maximum_prefix_discard_cmd);
+  install_element (BGP_IPV6_NODE, &no_neighbor_maximum_prefix_threshold_discard_cmd);
   install_element (BGP_IPV6_NODE, &no_neighbor_maximum_prefix_restart_cmd);
   install_element (BGP_IPV6_NODE, &no_neighbor_maximum_prefix_threshold_restart_cmd);
   install_element (BGP_IPV6M_NODE, &neighbor_maximum_prefix_cmd);
   install_element (BGP_IPV6M_NODE, &neighbor_maximum_prefix_threshold_cmd);
   install_element (BGP_IPV6M_NODE, &neighbor_maximum_prefix_warning_cmd);
   install_element (BGP_IPV6M_NODE, &neighbor_maximum_prefix_threshold_warning_cmd);
+  install_element (BGP_IPV6M_NODE, &neighbor_maximum_prefix_discard_cmd);
+  install_element (BGP_IPV6M_NODE, &neighbor_maximum_prefix_threshold_discard_cmd);
   install_element (BGP_IPV6M_NODE, &neighbor_maximum_prefix_restart_cmd);
   install_element (BGP_IPV6M_NODE, &neighbor_maximum_prefix_threshold_restart_cmd);
   install_element (BGP_IPV6M_NODE, &no_neighbor_maximum_prefix_cmd);
@@ -9739,6 +10421,8 @@ bgp_vty_init (void)
   install_element (BGP_IPV6M_NODE, &no_neighbor_maximum_prefix_threshold_cmd);
   install_element (BGP_IPV6M_NODE, &no_neighbor_maximum_prefix_warning_cmd);
   install_element (BGP_IPV6M_NODE, &no_neighbor_maximum_prefix_threshold_warning_cmd);
+  install_element (BGP_IPV6M_NODE, &no_neighbor_maximum_prefix_discard_cmd);
+  install_element (BGP_IPV6M_NODE, &no_neighbor_maximum_prefix_threshold_discard_cmd);
   install_element (BGP_IPV6M_NODE, &no_neighbor_maximum_prefix_restart_cmd);
   install_element (BGP_IPV6M_NODE, &no_neighbor_maximum_prefix_threshold_restart_cmd);
   install_element (BGP_VPNV4_NODE, &neighbor_maximum_prefix_cmd);
@@ -10180,6 +10864,10 @@ bgp_vty_init (void)
   install_element (VIEW_NODE, &show_bgp_memory_cmd);
   install_element (RESTRICTED_NODE, &show_bgp_memory_cmd);
   install_element (ENABLE_NODE, &show_bgp_memory_cmd);
+  install_element (VIEW_NODE, &show_bgp_memory_peers_cmd);
+  install_element (ENABLE_NODE, &show_bgp_memory_peers_cmd);
+  install_element (VIEW_NODE, &show_bgp_memory_peers_count_cmd);
+  install_element (ENABLE_NODE, &show_bgp_memory_peers_count_cmd);
   
   /* "show bgp views" commands. */
   install_element (VIEW_NODE, &show_bgp_views_cmd);
@@ -10270,6 +10958,8 @@ community_list_set_vty (struct vty *vty, int argc, const char **argv,
   /* When community_list_set() return nevetive value, it means
      malformed community string.  */
   ret = community_list_set (bgp_clist, argv[0], str, direct, style);
+  bgp_rmap_cache_flush ();
+  bgp_policy_changed ();
 
   /* Free temporary community list string allocated by
      argv_concat().  */
@@ -10315,6 +11005,8 @@ community_list_unset_vty (struct vty *vty, int argc, const char **argv,
 
   /* Unset community list.  */
   ret = community_list_unset (bgp_clist, argv[0], str, direct, style);
+  bgp_rmap_cache_flush ();
+  bgp_policy_changed ();
 
   /* Free temporary community list string allocated by
      argv_concat().  */
@@ -10623,6 +11315,8 @@ extcommunity_list_set_vty (struct vty *vty, int argc, const char **argv,
     str = NULL;
 
   ret = extcommunity_list_set (bgp_clist, argv[0], str, direct, style);
+  bgp_rmap_cache_flush ();
+  bgp_policy_changed ();
 
   /* Free temporary community list string allocated by
      argv_concat().  */
@@ -10665,6 +11359,8 @@ extcommunity_list_unset_vty (struct vty *vty, int argc, const char **argv,
 
   /* Unset community list.  */
   ret = extcommunity_list_unset (bgp_clist, argv[0], str, direct, style);
+  bgp_rmap_cache_flush ();
+  bgp_policy_changed ();
 
   /* Free temporary community list string allocated by
      argv_concat().  */
@@ -97,7 +97,7 @@ bgp_interface_delete (int command, struct zclient *zclient,
 
   s = zclient->ibuf;
   ifp = zebra_interface_state_read (s);
-  ifp->ifindex = IFINDEX_INTERNAL;
+  if_set_index (ifp, IFINDEX_INTERNAL);
 
   if (BGP_DEBUG(zebra, ZEBRA))
     zlog_debug("Zebra rcvd: interface delete %s", ifp->name);
@@ -646,6 +646,56 @@ bgp_nexthop_set (union sockunion *local, union sockunion *remote,
   return ret;
 }
 
+/* Whether zebra moves our routes over to wherever their nexthop now
+   resolves, so an IGP change alone need not send them again. */
+int
+bgp_zebra_follows_igp (void)
+{
+  return zclient && zclient->sock >= 0
+         && CHECK_FLAG (zclient->capabilities, ZEBRA_CAPABILITY_FOLLOW_IGP);
+}
+
+/* Whether zebra tells when our routes made it to the kernel. */
+int
+bgp_zebra_fib_notify (void)
+{
+  return zclient && zclient->sock >= 0
+         && CHECK_FLAG (zclient->capabilities, ZEBRA_CAPABILITY_FIB_NOTIFY);
+}
+
+/* Zebra's word on a route of ours it tried to install. */
+static int
+bgp_zebra_route_notify (int command, struct zclient *zclient,
+			zebra_size_t length)
+{
+  struct stream *s;
+  struct bgp *bgp;
+  struct bgp_node *rn;
+  struct prefix p;
+  u_char status;
+
+  s = zclient->ibuf;
+  stream_getc (s);
+  status = stream_getc (s);
+
+  memset (&p, 0, sizeof (struct prefix));
+  p.family = stream_getc (s);
+  p.prefixlen = stream_getc (s);
+  if (p.family != AF_INET || p.prefixlen > IPV4_MAX_BITLEN)
+    return 0;
+  stream_get (&p.u.prefix4, s, PSIZE (p.prefixlen));
+
+  if ((bgp = bgp_get_default ()) == NULL)
+    return 0;
+
+  rn = bgp_node_lookup (bgp->rib[AFI_IP][SAFI_UNICAST], &p);
+  if (! rn)
+    return 0;
+  bgp_fib_result (bgp, rn, AFI_IP, status);
+  bgp_unlock_node (rn);
+  return 0;
+}
+
 void
 bgp_zebra_announce (struct prefix *p, struct bgp_info *info, struct bgp *bgp, safi_t safi)
 {
@@ -1077,6 +1127,11 @@ bgp_zebra_init (void)
   zclient->ipv4_route_delete = zebra_read_ipv4;
   zclient->interface_up = bgp_interface_up;
   zclient->interface_down = bgp_interface_down;
+  zclient->nexthop_update = bgp_nexthop_update;
+  zclient->zebra_connected = bgp_nexthop_zebra_connected;
+  zclient->import_update = bgp_import_update;
+  zclient->zebra_hello = bgp_import_zebra_hello;
+  zclient->route_notify = bgp_zebra_route_notify;
 #ifdef HAVE_IPV6
   zclient->ipv6_route_add = zebra_read_ipv6;
   zclient->ipv6_route_delete = zebra_read_ipv6;
@@ -32,6 +32,8 @@ extern int bgp_config_write_maxpaths (struct vty *, struct bgp *, afi_t,
 extern int bgp_config_write_redistribute (struct vty *, struct bgp *, afi_t, safi_t,
 				   int *);
 extern void bgp_zebra_announce (struct prefix *, struct bgp_info *, struct bgp *, safi_t);
+extern int bgp_zebra_follows_igp (void);
+extern int bgp_zebra_fib_notify (void);
 extern void bgp_zebra_withdraw (struct prefix *, struct bgp_info *, safi_t);
 
 extern int bgp_redistribute_set (struct bgp *, afi_t, int);
@@ -35,12 +35,20 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #include "plist.h"
 #include "linklist.h"
 #include "workqueue.h"
+#include "hash.h"
+#include "jhash.h"
 
 #include "bgpd/bgpd.h"
 #include "bgpd/bgp_table.h"
 #include "bgpd/bgp_aspath.h"
 #include "bgpd/bgp_route.h"
 #include "bgpd/bgp_dump.h"
+#include "bgpd/bgp_export.h"
+#include "bgpd/bgp_bmp.h"
+#include "bgpd/bgp_rpki.h"
+#include "bgpd/bgp_snapshot.h"
+#include "bgpd/bgp_perf.h"
+#include "bgpd/bgp_statseg.h"
 #include "bgpd/bgp_debug.h"
 #include "bgpd/bgp_community.h"
 #include "bgpd/bgp_attr.h"
@@ -120,6 +128,7 @@ bgp_option_check (int flag)
 int
 bgp_flag_set (struct bgp *bgp, int flag)
 {
+  bgp_policy_changed ();
   SET_FLAG (bgp->flags, flag);
   return 0;
 }
@@ -127,6 +136,7 @@ bgp_flag_set (struct bgp *bgp, int flag)
 int
 bgp_flag_unset (struct bgp *bgp, int flag)
 {
+  bgp_policy_changed ();
   UNSET_FLAG (bgp->flags, flag);
   return 0;
 }
@@ -136,6 +146,15 @@ bgp_flag_check (struct bgp *bgp, int flag)
 {
   return CHECK_FLAG (bgp->flags, flag);
 }
+
+/* Something that may change what peers are announced changed: the
+   Adj-RIB-Out no longer goes for what outbound policy would make of the
+   routes, so a ROUTE-REFRESH runs the policy again. */
+void
+bgp_policy_changed (void)
+{
+  bm->policy_version++;
+}
 
 /* Internal function to set BGP structure configureation flag.  */
 static void
@@ -274,6 +293,26 @@ bgp_timers_unset (struct bgp *bgp)
   return 0;
 }
 
+/* BGP socket profile, for the peers with none of their own, taking
+   effect on their next connection. */
+int
+bgp_sock_profile_set (struct bgp *bgp, const struct bgp_sock_profile *sp)
+{
+  if (sp->sndbuf > BGP_SOCK_PROFILE_MAX || sp->rcvbuf > BGP_SOCK_PROFILE_MAX
+      || sp->notsent_lowat > BGP_SOCK_PROFILE_MAX)
+    return BGP_ERR_INVALID_VALUE;
+
+  bgp->sock_profile = *sp;
+  return 0;
+}
+
+int
+bgp_sock_profile_unset (struct bgp *bgp)
+{
+  memset (&bgp->sock_profile, 0, sizeof (bgp->sock_profile));
+  return 0;
+}
+
 /* BGP confederation configuration.  */
 int
 bgp_confederation_id_set (struct bgp *bgp, as_t as)
@@ -509,6 +548,83 @@ bgp_default_local_preference_unset (struct bgp *bgp)
   return 0;
 }
 
+/* Whether another instance takes, or will once this one exists, its
+   received routes from BGP. */
+static int
+bgp_rib_in_view_source (struct bgp *bgp)
+{
+  struct listnode *node;
+  struct bgp *other;
+
+  if (! bgp->name)
+    return 0;
+
+  for (ALL_LIST_ELEMENTS_RO (bm->bgp, node, other))
+    if (other->rib_in_view_name
+	&& strcmp (other->rib_in_view_name, bgp->name) == 0)
+      return 1;
+  return 0;
+}
+
+static void
+bgp_rib_in_view_attach (struct bgp *bgp, struct bgp *view)
+{
+  bgp->rib_in_view = view;
+  view->rib_in_views++;
+  bgp_rib_in_view_fill (bgp);
+}
+
+static void
+bgp_rib_in_view_detach (struct bgp *bgp)
+{
+  if (! bgp->rib_in_view)
+    return;
+
+  bgp_rib_in_view_flush (bgp);
+  bgp->rib_in_view->rib_in_views--;
+  bgp->rib_in_view = NULL;
+}
+
+/* Take the routes received by the peers of view NAME into the RIB of
+   BGP, besides those of its own peers, as the view has them after its
+   inbound policy.  The paths share the interned attributes of the
+   view's, so an UPDATE is parsed, filtered and interned once for all
+   the instances that take it.  The view need not exist yet. */
+int
+bgp_rib_in_view_set (struct bgp *bgp, const char *name)
+{
+  struct bgp *view;
+
+  if (bgp->name && strcmp (bgp->name, name) == 0)
+    return BGP_ERR_INVALID_VALUE;
+
+  view = bgp_lookup_by_name (name);
+  if (bgp_rib_in_view_source (bgp) || (view && view->rib_in_view_name))
+    return BGP_ERR_RIB_IN_VIEW_CHAIN;
+
+  if (bgp->rib_in_view_name && strcmp (bgp->rib_in_view_name, name) == 0)
+    return 0;
+
+  bgp_rib_in_view_unset (bgp);
+  bgp->rib_in_view_name = strdup (name);
+  if (view)
+    bgp_rib_in_view_attach (bgp, view);
+
+  return 0;
+}
+
+int
+bgp_rib_in_view_unset (struct bgp *bgp)
+{
+  bgp_rib_in_view_detach (bgp);
+  if (bgp->rib_in_view_name)
+    {
+      free (bgp->rib_in_view_name);
+      bgp->rib_in_view_name = NULL;
+    }
+  return 0;
+}
+
 /* If peer is RSERVER_CLIENT in at least one address family and is not member
     of a peer_group for that family, return 1.
     Used to check wether the peer is included in list bgp->rsclient. */
@@ -526,6 +642,39 @@ peer_rsclient_active (struct peer *peer)
   return 0;
 }
 
+static void peer_rsclient_shared_detach (struct peer *, afi_t, safi_t);
+
+static unsigned int
+peer_hash_key (void *arg)
+{
+  const struct peer *peer = arg;
+
+  switch (peer->su.sa.sa_family)
+    {
+    case AF_INET:
+      return jhash_1word (peer->su.sin.sin_addr.s_addr, 0);
+#ifdef HAVE_IPV6
+    case AF_INET6:
+      return jhash2 ((const u_int32_t *) &peer->su.sin6.sin6_addr,
+                     sizeof (struct in6_addr) / 4, 0);
+#endif /* HAVE_IPV6 */
+    }
+  return 0;
+}
+
+static int
+peer_hash_cmp (const void *arg1, const void *arg2)
+{
+  const struct peer *p1 = arg1;
+  const struct peer *p2 = arg2;
+
+  /* Almost all peers are IPv4, compare those here. */
+  if (p1->su.sa.sa_family == AF_INET && p2->su.sa.sa_family == AF_INET)
+    return p1->su.sin.sin_addr.s_addr == p2->su.sin.sin_addr.s_addr;
+
+  return sockunion_same (&p1->su, &p2->su);
+}
+
 /* Peer comparison function for sorting.  */
 static int
 peer_cmp (struct peer *p1, struct peer *p2)
@@ -596,6 +745,8 @@ peer_af_flag_reset (struct peer *peer, afi_t afi, safi_t safi)
   peer->orf_plist[afi][safi] = NULL;
   sprintf (orf_name, "%s.%d.%d", peer->host, afi, safi);
   prefix_bgp_orf_remove_all (orf_name);
+  sprintf (orf_name, "%s.%d.%d.sent", peer->host, afi, safi);
+  prefix_bgp_orf_remove_all (orf_name);
 
   /* Set default neighbor send-community.  */
   if (! bgp_option_check (BGP_OPT_CONFIG_CISCO))
@@ -737,7 +888,14 @@ peer_free (struct peer *peer)
   if (peer->clear_node_queue)
     work_queue_free (peer->clear_node_queue);
   
+  if (peer->open_sent)
+    stream_free (peer->open_sent);
+  if (peer->open_rcvd)
+    stream_free (peer->open_rcvd);
+
   bgp_sync_delete (peer);
+  bgp_attr_cache_flush (peer);
+  XFREE (MTYPE_BGP_PERF, peer->perf);
   memset (peer, 0, sizeof (struct peer));
   
   XFREE (MTYPE_BGP_PEER, peer);
@@ -829,11 +987,13 @@ peer_new (struct bgp *bgp)
   SET_FLAG (peer->sflags, PEER_STATUS_CAPABILITY_OPEN);
 
   /* Create buffers.  */
-  peer->ibuf = stream_new (BGP_MAX_PACKET_SIZE);
+  peer->rbuf = stream_new (BGP_READ_BUFFER_SIZE);
+  peer->ibuf = stream_clone (peer->rbuf);
   peer->obuf = stream_fifo_new ();
   peer->work = stream_new (BGP_MAX_PACKET_SIZE);
 
   bgp_sync_init (peer);
+  peer->perf = XCALLOC (MTYPE_BGP_PERF, sizeof (struct bgp_perf));
 
   /* Get service port number.  */
   sp = getservbyname ("bgp", "tcp");
@@ -865,6 +1025,7 @@ peer_create (union sockunion *su, struct bgp *bgp, as_t local_as,
     
   peer = peer_lock (peer); /* bgp peer list reference */
   listnode_add_sort (bgp->peer, peer);
+  hash_get (bgp->peerhash, peer, hash_alloc_intern);
 
   active = peer_active (peer);
 
@@ -1109,6 +1270,9 @@ peer_deactivate (struct peer *peer, afi_t afi, safi_t safi)
   if (! peer->afc[afi][safi])
     return 0;
 
+  if (CHECK_FLAG (peer->af_flags[afi][safi], PEER_FLAG_RSERVER_SHARED))
+    peer_rsclient_shared_detach (peer, afi, safi);
+
   /* De-activate the address family configuration. */
   peer->afc[afi][safi] = 0;
   peer_af_flag_reset (peer, afi, safi);
@@ -1156,6 +1320,7 @@ peer_nsf_stop (struct peer *peer)
 
   UNSET_FLAG (peer->sflags, PEER_STATUS_NSF_WAIT);
   UNSET_FLAG (peer->sflags, PEER_STATUS_NSF_MODE);
+  UNSET_FLAG (peer->sflags, PEER_STATUS_NSF_RELOAD);
 
   for (afi = AFI_IP ; afi < AFI_MAX ; afi++)
     for (safi = SAFI_UNICAST ; safi < SAFI_RESERVED_3 ; safi++)
@@ -1240,10 +1405,18 @@ peer_delete (struct peer *peer)
   if (! CHECK_FLAG (peer->sflags, PEER_STATUS_GROUP)
       && (pn = listnode_lookup (bgp->peer, peer)))
     {
+      if (hash_lookup (bgp->peerhash, peer) == peer)
+        hash_release (bgp->peerhash, peer);
       peer_unlock (peer); /* bgp peer list reference */
       list_delete_node (bgp->peer, pn);
     }
       
+  /* Shared RS-Clients only let go of the baseline RIB. */
+  for (afi = AFI_IP; afi < AFI_MAX; afi++)
+    for (safi = SAFI_UNICAST; safi < SAFI_MAX; safi++)
+      if (CHECK_FLAG (peer->af_flags[afi][safi], PEER_FLAG_RSERVER_SHARED))
+        peer_rsclient_shared_detach (peer, afi, safi);
+
   if (peer_rsclient_active (peer)
       && (pn = listnode_lookup (bgp->rsclient, peer)))
     {
@@ -1268,12 +1441,14 @@ peer_delete (struct peer *peer)
   /* Buffers.  */
   if (peer->ibuf)
     stream_free (peer->ibuf);
+  if (peer->rbuf)
+    stream_free (peer->rbuf);
   if (peer->obuf)
     stream_fifo_free (peer->obuf);
   if (peer->work)
     stream_free (peer->work);
   peer->obuf = NULL;
-  peer->work = peer->ibuf = NULL;
+  peer->work = peer->ibuf = peer->rbuf = NULL;
 
   /* Local and remote addresses. */
   if (peer->su_local)
@@ -1323,6 +1498,14 @@ peer_delete (struct peer *peer)
   return 0;
 }
 
+static const char *
+peer_group_name (const void *arg)
+{
+  const struct peer_group *group = arg;
+
+  return group->name;
+}
+
 static int
 peer_group_cmp (struct peer_group *g1, struct peer_group *g2)
 {
@@ -1359,15 +1542,7 @@ peer_group_free (struct peer_group *group)
 struct peer_group *
 peer_group_lookup (struct bgp *bgp, const char *name)
 {
-  struct peer_group *group;
-  struct listnode *node, *nnode;
-
-  for (ALL_LIST_ELEMENTS (bgp->group, node, nnode, group))
-    {
-      if (strcmp (group->name, name) == 0)
-	return group;
-    }
-  return NULL;
+  return hash_lookup_name (bgp->grouphash, name);
 }
 
 struct peer_group *
@@ -1394,11 +1569,13 @@ peer_group_get (struct bgp *bgp, const char *name)
   group->conf->v_routeadv = BGP_DEFAULT_EBGP_ROUTEADV;
   UNSET_FLAG (group->conf->config, PEER_CONFIG_TIMER);
   UNSET_FLAG (group->conf->config, PEER_CONFIG_CONNECT);
+  UNSET_FLAG (group->conf->config, PEER_CONFIG_SOCK_PROFILE);
   group->conf->keepalive = 0;
   group->conf->holdtime = 0;
   group->conf->connect = 0;
   SET_FLAG (group->conf->sflags, PEER_STATUS_GROUP);
   listnode_add_sort (bgp->group, group);
+  hash_get (bgp->grouphash, group, hash_alloc_intern);
 
   return 0;
 }
@@ -1450,6 +1627,9 @@ peer_group2peer_config_copy (struct peer_group *group, struct peer *peer,
   else
     peer->v_connect = BGP_DEFAULT_CONNECT_RETRY;
 
+  /* socket profile */
+  peer->sock_profile = conf->sock_profile;
+
   /* advertisement-interval reset */
   if (peer_sort (peer) == BGP_PEER_IBGP)
     peer->v_routeadv = BGP_DEFAULT_IBGP_ROUTEADV;
@@ -1702,6 +1882,7 @@ peer_group_delete (struct peer_group *group)
     }
   list_delete (group->peer);
 
+  hash_release (bgp->grouphash, group);
   free (group->name);
   group->name = NULL;
 
@@ -1778,6 +1959,9 @@ peer_group_bind (struct bgp *bgp, union sockunion *su,
       return 0;
     }
 
+  if (CHECK_FLAG (peer->af_flags[afi][safi], PEER_FLAG_RSERVER_SHARED))
+    return BGP_ERR_RSCLIENT_SHARED_GROUP;
+
   /* Check current peer group configuration.  */
   if (peer_group_active (peer)
       && strcmp (peer->group->name, group->name) != 0)
@@ -1941,12 +2125,16 @@ bgp_create (as_t *as, const char *name)
 
   bgp->peer = list_new ();
   bgp->peer->cmp = (int (*)(void *, void *)) peer_cmp;
+  bgp->peerhash = hash_create_open (0, peer_hash_key, peer_hash_cmp);
 
   bgp->group = list_new ();
   bgp->group->cmp = (int (*)(void *, void *)) peer_group_cmp;
+  bgp->grouphash = hash_create_open_name (0, peer_group_name);
 
   bgp->rsclient = list_new ();
   bgp->rsclient->cmp = (int (*)(void*, void*)) peer_cmp;
+  bgp->rsclient_shared = list_new ();
+  bgp->rsclient_shared->cmp = (int (*)(void*, void*)) peer_cmp;
 
   for (afi = AFI_IP; afi < AFI_MAX; afi++)
     for (safi = SAFI_UNICAST; safi < SAFI_MAX; safi++)
@@ -1954,6 +2142,7 @@ bgp_create (as_t *as, const char *name)
 	bgp->route[afi][safi] = bgp_table_init (afi, safi);
 	bgp->aggregate[afi][safi] = bgp_table_init (afi, safi);
 	bgp->rib[afi][safi] = bgp_table_init (afi, safi);
+	bgp->rib[afi][safi]->bgp = bgp;
 	bgp->maxpaths[afi][safi].maxpaths_ebgp = BGP_DEFAULT_MAXPATHS;
 	bgp->maxpaths[afi][safi].maxpaths_ibgp = BGP_DEFAULT_MAXPATHS;
       }
@@ -2071,6 +2260,18 @@ bgp_get (struct bgp **bgp_val, as_t *as, const char *name)
 
   listnode_add (bm->bgp, bgp);
 
+  /* Instances configured to take their received routes from it. */
+  if (name)
+    {
+      struct listnode *node;
+      struct bgp *other;
+
+      for (ALL_LIST_ELEMENTS_RO (bm->bgp, node, other))
+	if (other->rib_in_view_name && ! other->rib_in_view
+	    && strcmp (other->rib_in_view_name, name) == 0)
+	  bgp_rib_in_view_attach (other, bgp);
+    }
+
   return 0;
 }
 
@@ -2080,14 +2281,24 @@ bgp_delete (struct bgp *bgp)
 {
   struct peer *peer;
   struct peer_group *group;
+  struct bgp *other;
   struct listnode *node;
   struct listnode *next;
   afi_t afi;
   int i;
 
+  bgp_update_delay_end (bgp);
+
   /* Delete static route. */
   bgp_static_delete (bgp);
 
+  /* The instances taking received routes from it wait for it to come
+     back. */
+  bgp_rib_in_view_unset (bgp);
+  for (ALL_LIST_ELEMENTS (bm->bgp, node, next, other))
+    if (other->rib_in_view == bgp)
+      bgp_rib_in_view_detach (other);
+
   /* Unset redistribution. */
   for (afi = AFI_IP; afi < AFI_MAX; afi++)
     for (i = 0; i < ZEBRA_ROUTE_MAX; i++) 
@@ -2101,11 +2312,20 @@ bgp_delete (struct bgp *bgp)
     peer_group_delete (group);
 
   assert (listcount (bgp->rsclient) == 0);
+  assert (listcount (bgp->rsclient_shared) == 0);
+
+  bgp_update_share_flush (bgp);
 
   if (bgp->peer_self) {
     peer_delete(bgp->peer_self);
     bgp->peer_self = NULL;
   }
+
+  if (bgp->rsclient_base)
+    {
+      peer_delete (bgp->rsclient_base);
+      bgp->rsclient_base = NULL;
+    }
   
   /* Remove visibility via the master list - there may however still be
    * routes to be processed still referencing the struct bgp.
@@ -2144,6 +2364,13 @@ bgp_free (struct bgp *bgp)
   list_delete (bgp->group);
   list_delete (bgp->peer);
   list_delete (bgp->rsclient);
+  list_delete (bgp->rsclient_shared);
+  hash_clean (bgp->grouphash, NULL);
+  hash_free (bgp->grouphash);
+  hash_clean (bgp->peerhash, NULL);
+  hash_free (bgp->peerhash);
+
+  bgp_aggregate_cancel (bgp);
 
   if (bgp->name)
     free (bgp->name);
@@ -2161,28 +2388,30 @@ bgp_free (struct bgp *bgp)
   XFREE (MTYPE_BGP, bgp);
 }
 
+/* Find the configured peer with address su in bgp's hash. */
+static struct peer *
+peer_lookup_hash (struct bgp *bgp, union sockunion *su)
+{
+  struct peer key;
+
+  key.su = *su;
+  return hash_lookup (bgp->peerhash, &key);
+}
+
 struct peer *
 peer_lookup (struct bgp *bgp, union sockunion *su)
 {
   struct peer *peer;
-  struct listnode *node, *nnode;
 
   if (bgp != NULL)
-    {
-      for (ALL_LIST_ELEMENTS (bgp->peer, node, nnode, peer))
-        if (sockunion_same (&peer->su, su)
-            && ! CHECK_FLAG (peer->sflags, PEER_STATUS_ACCEPT_PEER))
-          return peer;
-    }
+    return peer_lookup_hash (bgp, su);
   else if (bm->bgp != NULL)
     {
       struct listnode *bgpnode, *nbgpnode;
   
       for (ALL_LIST_ELEMENTS (bm->bgp, bgpnode, nbgpnode, bgp))
-        for (ALL_LIST_ELEMENTS (bgp->peer, node, nnode, peer))
-          if (sockunion_same (&peer->su, su)
-              && ! CHECK_FLAG (peer->sflags, PEER_STATUS_ACCEPT_PEER))
-            return peer;
+        if ((peer = peer_lookup_hash (bgp, su)) != NULL)
+          return peer;
     }
   return NULL;
 }
@@ -2192,7 +2421,6 @@ peer_lookup_with_open (union sockunion *su, as_t remote_as,
 		       struct in_addr *remote_id, int *as)
 {
   struct peer *peer;
-  struct listnode *node;
   struct listnode *bgpnode;
   struct bgp *bgp;
 
@@ -2201,31 +2429,15 @@ peer_lookup_with_open (union sockunion *su, as_t remote_as,
 
   for (ALL_LIST_ELEMENTS_RO (bm->bgp, bgpnode, bgp))
     {
-      for (ALL_LIST_ELEMENTS_RO (bgp->peer, node, peer))
-        {
-          if (sockunion_same (&peer->su, su)
-              && ! CHECK_FLAG (peer->sflags, PEER_STATUS_ACCEPT_PEER))
-            {
-              if (peer->as == remote_as
-                  && peer->remote_id.s_addr == remote_id->s_addr)
-                return peer;
-              if (peer->as == remote_as)
-                *as = 1;
-            }
-        }
+      if ((peer = peer_lookup_hash (bgp, su)) == NULL)
+        continue;
 
-      for (ALL_LIST_ELEMENTS_RO (bgp->peer, node, peer))
-        {
-          if (sockunion_same (&peer->su, su)
-              &&  ! CHECK_FLAG (peer->sflags, PEER_STATUS_ACCEPT_PEER))
-            {
-              if (peer->as == remote_as
-                  && peer->remote_id.s_addr == 0)
-                return peer;
-              if (peer->as == remote_as)
-                *as = 1;
-            }
-        }
+      if (peer->as == remote_as
+          && (peer->remote_id.s_addr == remote_id->s_addr
+              || peer->remote_id.s_addr == 0))
+        return peer;
+      if (peer->as == remote_as)
+        *as = 1;
     }
   return NULL;
 }
@@ -2331,6 +2543,7 @@ static const struct peer_flag_action peer_af_flag_action_list[] =
     { PEER_FLAG_ORF_PREFIX_SM,            1, peer_change_reset },
     { PEER_FLAG_ORF_PREFIX_RM,            1, peer_change_reset },
     { PEER_FLAG_NEXTHOP_LOCAL_UNCHANGED,  0, peer_change_reset_out },
+    { PEER_FLAG_ADDPATH_TX_ALL_PATHS,     1, peer_change_reset },
     { 0, 0, 0 }
   };
 
@@ -2444,6 +2657,8 @@ peer_flag_modify (struct peer *peer, u_int32_t flag, int set)
   struct listnode *node, *nnode;
   struct peer_flag_action action;
 
+  bgp_policy_changed ();
+
   memset (&action, 0, sizeof (struct peer_flag_action));
   size = sizeof peer_flag_action_list / sizeof (struct peer_flag_action);
 
@@ -2547,6 +2762,8 @@ peer_af_flag_modify (struct peer *peer, afi_t afi, safi_t safi, u_int32_t flag,
   struct peer_group *group;
   struct peer_flag_action action;
 
+  bgp_policy_changed ();
+
   memset (&action, 0, sizeof (struct peer_flag_action));
   size = sizeof peer_af_flag_action_list / sizeof (struct peer_flag_action);
   
@@ -2610,6 +2827,8 @@ peer_af_flag_modify (struct peer *peer, afi_t afi, safi_t safi, u_int32_t flag,
            peer->last_reset = PEER_DOWN_CAPABILITY_CHANGE;
          else if (flag == PEER_FLAG_ORF_PREFIX_RM)
            peer->last_reset = PEER_DOWN_CAPABILITY_CHANGE;
+         else if (flag == PEER_FLAG_ADDPATH_TX_ALL_PATHS)
+           peer->last_reset = PEER_DOWN_CAPABILITY_CHANGE;
 
          peer_change_action (peer, afi, safi, action.type);
        }
@@ -2651,6 +2870,8 @@ peer_af_flag_modify (struct peer *peer, afi_t afi, safi_t safi, u_int32_t flag,
                    peer->last_reset = PEER_DOWN_CAPABILITY_CHANGE;
                  else if (flag == PEER_FLAG_ORF_PREFIX_RM)
                    peer->last_reset = PEER_DOWN_CAPABILITY_CHANGE;
+                 else if (flag == PEER_FLAG_ADDPATH_TX_ALL_PATHS)
+                   peer->last_reset = PEER_DOWN_CAPABILITY_CHANGE;
 
                  peer_change_action (peer, afi, safi, action.type);
                }
@@ -2671,6 +2892,177 @@ peer_af_flag_unset (struct peer *peer, afi_t afi, safi_t safi, u_int32_t flag)
 {
   return peer_af_flag_modify (peer, afi, safi, flag, 0);
 }
+
+/* If peer is a shared RSERVER_CLIENT in at least one address family,
+    return 1.  Used to check wether the peer is included in list
+    bgp->rsclient_shared. */
+static int
+peer_rsclient_shared_active (struct peer *peer)
+{
+  int i;
+  int j;
+
+  for (i=AFI_IP; i < AFI_MAX; i++)
+    for (j=SAFI_UNICAST; j < SAFI_MAX; j++)
+      if (CHECK_FLAG(peer->af_flags[i][j], PEER_FLAG_RSERVER_SHARED))
+        return 1;
+  return 0;
+}
+
+/* Make bgp->rsclient_base a RS-Client for the family, so that every
+   announcement is put into its RIB as into that of any other RS-Client
+   without a policy of its own. */
+static struct peer *
+bgp_rsclient_base_get (struct bgp *bgp, afi_t afi, safi_t safi)
+{
+  struct peer *base;
+
+  if (! bgp->rsclient_base)
+    {
+      bgp->rsclient_base = peer_new (bgp);
+      bgp->rsclient_base->host = XSTRDUP (MTYPE_BGP_PEER_HOST,
+                                          "Route server baseline");
+    }
+  base = bgp->rsclient_base;
+
+  if (CHECK_FLAG (base->af_flags[afi][safi], PEER_FLAG_RSERVER_CLIENT))
+    return base;
+
+  if (! peer_rsclient_active (base))
+    {
+      peer_lock (base); /* rsclient peer list reference */
+      listnode_add_sort (bgp->rsclient, base);
+    }
+
+  base->afc[afi][safi] = 1;
+  SET_FLAG (base->af_flags[afi][safi], PEER_FLAG_RSERVER_CLIENT);
+
+  base->rib[afi][safi] = bgp_table_init (afi, safi);
+  base->rib[afi][safi]->type = BGP_TABLE_RSCLIENT;
+  /* RIB peer reference.  Released when table is free'd in bgp_table_free. */
+  base->rib[afi][safi]->owner = peer_lock (base);
+
+  bgp_check_local_routes_rsclient (base, afi, safi);
+  bgp_soft_reconfig_rsclient (base, afi, safi);
+
+  return base;
+}
+
+/* Once no shared RS-Client is left in the family, drop the RIB of
+   bgp->rsclient_base for it. */
+static void
+bgp_rsclient_base_release (struct bgp *bgp, afi_t afi, safi_t safi)
+{
+  struct peer *base = bgp->rsclient_base;
+  struct peer *peer;
+  struct listnode *node;
+
+  if (! base
+      || ! CHECK_FLAG (base->af_flags[afi][safi], PEER_FLAG_RSERVER_CLIENT))
+    return;
+
+  for (ALL_LIST_ELEMENTS_RO (bgp->rsclient_shared, node, peer))
+    if (CHECK_FLAG (peer->af_flags[afi][safi], PEER_FLAG_RSERVER_SHARED))
+      return;
+
+  UNSET_FLAG (base->af_flags[afi][safi], PEER_FLAG_RSERVER_CLIENT);
+  base->afc[afi][safi] = 0;
+
+  bgp_clear_route (base, afi, safi, BGP_CLEAR_ROUTE_MY_RSCLIENT);
+  if (! peer_rsclient_active (base))
+    {
+      listnode_delete (bgp->rsclient, base);
+      peer_unlock (base); /* rsclient peer list reference */
+    }
+
+  bgp_table_finish (&base->rib[afi][safi]);
+}
+
+static void
+peer_rsclient_shared_detach (struct peer *peer, afi_t afi, safi_t safi)
+{
+  struct bgp *bgp = peer->bgp;
+  struct listnode *pn;
+
+  UNSET_FLAG (peer->af_flags[afi][safi], PEER_FLAG_RSERVER_SHARED);
+  bgp_table_finish (&peer->rib[afi][safi]);
+
+  if (! peer_rsclient_shared_active (peer)
+      && (pn = listnode_lookup (bgp->rsclient_shared, peer)))
+    {
+      list_delete_node (bgp->rsclient_shared, pn);
+      peer_unlock (peer); /* rsclient_shared list reference */
+    }
+
+  bgp_rsclient_base_release (bgp, afi, safi);
+}
+
+/* Make peer a RS-Client which uses the RIB of bgp->rsclient_base
+   instead of one of its own.  What it is sent differs from the
+   baseline only where the baseline's best path may not go to it, and
+   that is worked out as it is announced. */
+int
+peer_rsclient_shared_set (struct peer *peer, afi_t afi, safi_t safi)
+{
+  struct bgp *bgp = peer->bgp;
+  struct peer *base;
+  int ret;
+
+  if (CHECK_FLAG (peer->sflags, PEER_STATUS_GROUP)
+      || peer_is_group_member (peer, afi, safi))
+    return BGP_ERR_RSCLIENT_SHARED_GROUP;
+
+  if (CHECK_FLAG (peer->af_flags[afi][safi], PEER_FLAG_RSERVER_SHARED))
+    return 0;
+
+  if (CHECK_FLAG (peer->af_flags[afi][safi], PEER_FLAG_RSERVER_CLIENT))
+    return BGP_ERR_RSCLIENT_SHARED_CHANGE;
+
+  if (! peer->afc[afi][safi])
+    return BGP_ERR_PEER_INACTIVE;
+
+  if (ROUTE_MAP_IMPORT_NAME (&peer->filter[afi][safi]))
+    return BGP_ERR_RSCLIENT_SHARED_IMPORT;
+
+  base = bgp_rsclient_base_get (bgp, afi, safi);
+
+  SET_FLAG (peer->af_flags[afi][safi], PEER_FLAG_RSERVER_SHARED);
+  ret = peer_af_flag_set (peer, afi, safi, PEER_FLAG_RSERVER_CLIENT);
+  if (ret < 0)
+    {
+      UNSET_FLAG (peer->af_flags[afi][safi], PEER_FLAG_RSERVER_SHARED);
+      bgp_rsclient_base_release (bgp, afi, safi);
+      return ret;
+    }
+
+  if (! listnode_lookup (bgp->rsclient_shared, peer))
+    {
+      peer_lock (peer); /* rsclient_shared list reference */
+      listnode_add_sort (bgp->rsclient_shared, peer);
+    }
+
+  peer->rib[afi][safi] = base->rib[afi][safi];
+  bgp_table_lock (peer->rib[afi][safi]);
+
+  return 0;
+}
+
+int
+peer_rsclient_shared_unset (struct peer *peer, afi_t afi, safi_t safi)
+{
+  int ret;
+
+  if (! CHECK_FLAG (peer->af_flags[afi][safi], PEER_FLAG_RSERVER_SHARED))
+    return 0;
+
+  ret = peer_af_flag_unset (peer, afi, safi, PEER_FLAG_RSERVER_CLIENT);
+  if (ret < 0)
+    return ret;
+
+  peer_rsclient_shared_detach (peer, afi, safi);
+
+  return 0;
+}
 
 /* EBGP multihop configuration. */
 int
@@ -3021,6 +3413,8 @@ peer_default_originate_set (struct peer *peer, afi_t afi, safi_t safi,
   struct peer_group *group;
   struct listnode *node, *nnode;
 
+  bgp_policy_changed ();
+
   /* Adress family must be activated.  */
   if (! peer->afc[afi][safi])
     return BGP_ERR_PEER_INACTIVE;
@@ -3077,6 +3471,8 @@ peer_default_originate_unset (struct peer *peer, afi_t afi, safi_t safi)
   struct peer_group *group;
   struct listnode *node, *nnode;
 
+  bgp_policy_changed ();
+
   /* Adress family must be activated.  */
   if (! peer->afc[afi][safi])
     return BGP_ERR_PEER_INACTIVE;
@@ -3286,6 +3682,70 @@ peer_timers_connect_unset (struct peer *peer)
   return 0;
 }
 
+/* The socket profile of the peer, its own or its instance's.  A change
+   takes effect on the next connection. */
+const struct bgp_sock_profile *
+peer_sock_profile (struct peer *peer)
+{
+  if (CHECK_FLAG (peer->config, PEER_CONFIG_SOCK_PROFILE))
+    return &peer->sock_profile;
+  return &peer->bgp->sock_profile;
+}
+
+int
+peer_sock_profile_set (struct peer *peer, const struct bgp_sock_profile *sp)
+{
+  struct peer_group *group;
+  struct listnode *node, *nnode;
+
+  if (peer_group_active (peer))
+    return BGP_ERR_INVALID_FOR_PEER_GROUP_MEMBER;
+
+  if (sp->sndbuf > BGP_SOCK_PROFILE_MAX || sp->rcvbuf > BGP_SOCK_PROFILE_MAX
+      || sp->notsent_lowat > BGP_SOCK_PROFILE_MAX)
+    return BGP_ERR_INVALID_VALUE;
+
+  SET_FLAG (peer->config, PEER_CONFIG_SOCK_PROFILE);
+  peer->sock_profile = *sp;
+
+  if (! CHECK_FLAG (peer->sflags, PEER_STATUS_GROUP))
+    return 0;
+
+  /* peer-group member updates. */
+  group = peer->group;
+  for (ALL_LIST_ELEMENTS (group->peer, node, nnode, peer))
+    {
+      SET_FLAG (peer->config, PEER_CONFIG_SOCK_PROFILE);
+      peer->sock_profile = *sp;
+    }
+  return 0;
+}
+
+int
+peer_sock_profile_unset (struct peer *peer)
+{
+  struct peer_group *group;
+  struct listnode *node, *nnode;
+
+  if (peer_group_active (peer))
+    return BGP_ERR_INVALID_FOR_PEER_GROUP_MEMBER;
+
+  UNSET_FLAG (peer->config, PEER_CONFIG_SOCK_PROFILE);
+  memset (&peer->sock_profile, 0, sizeof (peer->sock_profile));
+
+  if (! CHECK_FLAG (peer->sflags, PEER_STATUS_GROUP))
+    return 0;
+
+  /* peer-group member updates. */
+  group = peer->group;
+  for (ALL_LIST_ELEMENTS (group->peer, node, nnode, peer))
+    {
+      UNSET_FLAG (peer->config, PEER_CONFIG_SOCK_PROFILE);
+      memset (&peer->sock_profile, 0, sizeof (peer->sock_profile));
+    }
+  return 0;
+}
+
 int
 peer_advertise_interval_set (struct peer *peer, u_int32_t routeadv)
 {
@@ -3643,6 +4103,8 @@ peer_distribute_set (struct peer *peer, afi_t afi, safi_t safi, int direct,
   struct peer_group *group;
   struct listnode *node, *nnode;
 
+  bgp_policy_changed ();
+
   if (! peer->afc[afi][safi])
     return BGP_ERR_PEER_INACTIVE;
 
@@ -3690,6 +4152,8 @@ peer_distribute_unset (struct peer *peer, afi_t afi, safi_t safi, int direct)
   struct peer_group *group;
   struct listnode *node, *nnode;
 
+  bgp_policy_changed ();
+
   if (! peer->afc[afi][safi])
     return BGP_ERR_PEER_INACTIVE;
 
@@ -3755,6 +4219,11 @@ peer_distribute_update (struct access_list *access)
   struct peer_group *group;
   struct bgp_filter *filter;
 
+  bgp_policy_changed ();
+
+  /* Route maps may refer to the list. */
+  bgp_rmap_cache_flush ();
+
   for (ALL_LIST_ELEMENTS (bm->bgp, mnode, mnnode, bgp))
     {
       for (ALL_LIST_ELEMENTS (bgp->peer, node, nnode, peer))
@@ -3803,6 +4272,8 @@ peer_prefix_list_set (struct peer *peer, afi_t afi, safi_t safi, int direct,
   struct peer_group *group;
   struct listnode *node, *nnode;
 
+  bgp_policy_changed ();
+
   if (! peer->afc[afi][safi])
     return BGP_ERR_PEER_INACTIVE;
 
@@ -3849,6 +4320,8 @@ peer_prefix_list_unset (struct peer *peer, afi_t afi, safi_t safi, int direct)
   struct peer_group *group;
   struct listnode *node, *nnode;
 
+  bgp_policy_changed ();
+
   if (! peer->afc[afi][safi])
     return BGP_ERR_PEER_INACTIVE;
 
@@ -3914,6 +4387,11 @@ peer_prefix_list_update (struct prefix_list *plist)
   safi_t safi;
   int direct;
 
+  bgp_policy_changed ();
+
+  /* Route maps may refer to the list. */
+  bgp_rmap_cache_flush ();
+
   for (ALL_LIST_ELEMENTS (bm->bgp, mnode, mnnode, bgp))
     {
       for (ALL_LIST_ELEMENTS (bgp->peer, node, nnode, peer))
@@ -3961,6 +4439,8 @@ peer_aslist_set (struct peer *peer, afi_t afi, safi_t safi, int direct,
   struct peer_group *group;
   struct listnode *node, *nnode;
 
+  bgp_policy_changed ();
+
   if (! peer->afc[afi][safi])
     return BGP_ERR_PEER_INACTIVE;
 
@@ -4004,6 +4484,8 @@ peer_aslist_unset (struct peer *peer,afi_t afi, safi_t safi, int direct)
   struct peer_group *group;
   struct listnode *node, *nnode;
 
+  bgp_policy_changed ();
+
   if (! peer->afc[afi][safi])
     return BGP_ERR_PEER_INACTIVE;
 
@@ -4068,6 +4550,11 @@ peer_aslist_update (void)
   struct peer_group *group;
   struct bgp_filter *filter;
 
+  bgp_policy_changed ();
+
+  /* Route maps may refer to the list. */
+  bgp_rmap_cache_flush ();
+
   for (ALL_LIST_ELEMENTS (bm->bgp, mnode, mnnode, bgp))
     {
       for (ALL_LIST_ELEMENTS (bgp->peer, node, nnode, peer))
@@ -4116,6 +4603,8 @@ peer_route_map_set (struct peer *peer, afi_t afi, safi_t safi, int direct,
   struct peer_group *group;
   struct listnode *node, *nnode;
 
+  bgp_policy_changed ();
+
   if (! peer->afc[afi][safi])
     return BGP_ERR_PEER_INACTIVE;
 
@@ -4127,6 +4616,10 @@ peer_route_map_set (struct peer *peer, afi_t afi, safi_t safi, int direct,
       && peer_is_group_member (peer, afi, safi))
     return BGP_ERR_INVALID_FOR_PEER_GROUP_MEMBER;
 
+  if (direct == RMAP_IMPORT
+      && CHECK_FLAG (peer->af_flags[afi][safi], PEER_FLAG_RSERVER_SHARED))
+    return BGP_ERR_RSCLIENT_SHARED_IMPORT;
+
   filter = &peer->filter[afi][safi];
 
   if (filter->map[direct].name)
@@ -4163,6 +4656,8 @@ peer_route_map_unset (struct peer *peer, afi_t afi, safi_t safi, int direct)
   struct peer_group *group;
   struct listnode *node, *nnode;
 
+  bgp_policy_changed ();
+
   if (! peer->afc[afi][safi])
     return BGP_ERR_PEER_INACTIVE;
 
@@ -4224,6 +4719,8 @@ peer_unsuppress_map_set (struct peer *peer, afi_t afi, safi_t safi,
   struct peer_group *group;
   struct listnode *node, *nnode;
 
+  bgp_policy_changed ();
+
   if (! peer->afc[afi][safi])
     return BGP_ERR_PEER_INACTIVE;
 
@@ -4265,6 +4762,8 @@ peer_unsuppress_map_unset (struct peer *peer, afi_t afi, safi_t safi)
   struct peer_group *group;
   struct listnode *node, *nnode;
 
+  bgp_policy_changed ();
+
   if (! peer->afc[afi][safi])
     return BGP_ERR_PEER_INACTIVE;
   
@@ -4300,7 +4799,7 @@ peer_unsuppress_map_unset (struct peer *peer, afi_t afi, safi_t safi)
 int
 peer_maximum_prefix_set (struct peer *peer, afi_t afi, safi_t safi,
 			 u_int32_t max, u_char threshold,
-			 int warning, u_int16_t restart)
+			 int warning, int discard, u_int16_t restart)
 {
   struct peer_group *group;
   struct listnode *node, *nnode;
@@ -4316,6 +4815,10 @@ peer_maximum_prefix_set (struct peer *peer, afi_t afi, safi_t safi,
     SET_FLAG (peer->af_flags[afi][safi], PEER_FLAG_MAX_PREFIX_WARNING);
   else
     UNSET_FLAG (peer->af_flags[afi][safi], PEER_FLAG_MAX_PREFIX_WARNING);
+  if (discard)
+    SET_FLAG (peer->af_flags[afi][safi], PEER_FLAG_MAX_PREFIX_DISCARD);
+  else
+    UNSET_FLAG (peer->af_flags[afi][safi], PEER_FLAG_MAX_PREFIX_DISCARD);
 
   if (! CHECK_FLAG (peer->sflags, PEER_STATUS_GROUP))
     return 0;
@@ -4334,6 +4837,10 @@ peer_maximum_prefix_set (struct peer *peer, afi_t afi, safi_t safi,
 	SET_FLAG (peer->af_flags[afi][safi], PEER_FLAG_MAX_PREFIX_WARNING);
       else
 	UNSET_FLAG (peer->af_flags[afi][safi], PEER_FLAG_MAX_PREFIX_WARNING);
+      if (discard)
+	SET_FLAG (peer->af_flags[afi][safi], PEER_FLAG_MAX_PREFIX_DISCARD);
+      else
+	UNSET_FLAG (peer->af_flags[afi][safi], PEER_FLAG_MAX_PREFIX_DISCARD);
     }
   return 0;
 }
@@ -4362,6 +4869,12 @@ peer_maximum_prefix_unset (struct peer *peer, afi_t afi, safi_t safi)
       else
 	UNSET_FLAG (peer->af_flags[afi][safi], PEER_FLAG_MAX_PREFIX_WARNING);
 
+      if (CHECK_FLAG (peer->group->conf->af_flags[afi][safi],
+	  PEER_FLAG_MAX_PREFIX_DISCARD))
+	SET_FLAG (peer->af_flags[afi][safi], PEER_FLAG_MAX_PREFIX_DISCARD);
+      else
+	UNSET_FLAG (peer->af_flags[afi][safi], PEER_FLAG_MAX_PREFIX_DISCARD);
+
       peer->pmax[afi][safi] = peer->group->conf->pmax[afi][safi];
       peer->pmax_threshold[afi][safi] = peer->group->conf->pmax_threshold[afi][safi];
       peer->pmax_restart[afi][safi] = peer->group->conf->pmax_restart[afi][safi];
@@ -4370,6 +4883,7 @@ peer_maximum_prefix_unset (struct peer *peer, afi_t afi, safi_t safi)
 
   UNSET_FLAG (peer->af_flags[afi][safi], PEER_FLAG_MAX_PREFIX);
   UNSET_FLAG (peer->af_flags[afi][safi], PEER_FLAG_MAX_PREFIX_WARNING);
+  UNSET_FLAG (peer->af_flags[afi][safi], PEER_FLAG_MAX_PREFIX_DISCARD);
   peer->pmax[afi][safi] = 0;
   peer->pmax_threshold[afi][safi] = 0;
   peer->pmax_restart[afi][safi] = 0;
@@ -4385,6 +4899,7 @@ peer_maximum_prefix_unset (struct peer *peer, afi_t afi, safi_t safi)
 
       UNSET_FLAG (peer->af_flags[afi][safi], PEER_FLAG_MAX_PREFIX);
       UNSET_FLAG (peer->af_flags[afi][safi], PEER_FLAG_MAX_PREFIX_WARNING);
+      UNSET_FLAG (peer->af_flags[afi][safi], PEER_FLAG_MAX_PREFIX_DISCARD);
       peer->pmax[afi][safi] = 0;
       peer->pmax_threshold[afi][safi] = 0;
       peer->pmax_restart[afi][safi] = 0;
@@ -4566,6 +5081,9 @@ peer_clear_soft (struct peer *peer, afi_t afi, safi_t safi,
     {
       if (! CHECK_FLAG (peer->af_flags[afi][safi], PEER_FLAG_RSERVER_CLIENT))
         return 0;
+      /* A shared RS-Client has the baseline RIB rebuilt instead. */
+      if (CHECK_FLAG (peer->af_flags[afi][safi], PEER_FLAG_RSERVER_SHARED))
+        peer = peer->bgp->rsclient_base;
       bgp_check_local_routes_rsclient (peer, afi, safi);
       bgp_soft_reconfig_rsclient (peer, afi, safi);
     }
@@ -4587,14 +5105,10 @@ peer_clear_soft (struct peer *peer, afi_t afi, safi_t safi,
 	  else
 	    prefix_type = ORF_TYPE_PREFIX_OLD;
 
+	  /* Only the entries changed since last sent go out. */
 	  if (filter->plist[FILTER_IN].plist)
-	    {
-	      if (CHECK_FLAG (peer->af_sflags[afi][safi], PEER_STATUS_ORF_PREFIX_SEND))
-		bgp_route_refresh_send (peer, afi, safi,
-					prefix_type, REFRESH_DEFER, 1);
-	      bgp_route_refresh_send (peer, afi, safi, prefix_type,
-				      REFRESH_IMMEDIATE, 0);
-	    }
+	    bgp_route_refresh_send (peer, afi, safi, prefix_type,
+				    REFRESH_IMMEDIATE, 0);
 	  else
 	    {
 	      if (CHECK_FLAG (peer->af_sflags[afi][safi], PEER_STATUS_ORF_PREFIX_SEND))
@@ -4875,6 +5389,14 @@ bgp_config_write_peer (struct vty *vty, struct bgp *bgp,
 	  vty_out (vty, " neighbor %s timers connect %d%s", addr, 
 	  peer->connect, VTY_NEWLINE);
 
+      /* socket profile */
+      if (CHECK_FLAG (peer->config, PEER_CONFIG_SOCK_PROFILE)
+	  && ! peer_group_active (peer))
+	vty_out (vty, " neighbor %s socket-profile send-buffer %u"
+		 " receive-buffer %u notsent-lowat %u%s", addr,
+		 peer->sock_profile.sndbuf, peer->sock_profile.rcvbuf,
+		 peer->sock_profile.notsent_lowat, VTY_NEWLINE);
+
       /* Default weight. */
       if (CHECK_FLAG (peer->config, PEER_CONFIG_WEIGHT))
         if (! peer_group_active (peer) ||
@@ -4973,6 +5495,12 @@ bgp_config_write_peer (struct vty *vty, struct bgp *bgp,
     vty_out (vty, " neighbor %s remove-private-AS%s",
 	     addr, VTY_NEWLINE);
 
+  /* ADD-PATH. */
+  if (peer_af_flag_check (peer, afi, safi, PEER_FLAG_ADDPATH_TX_ALL_PATHS)
+      && ! peer->af_group[afi][safi])
+    vty_out (vty, " neighbor %s addpath-tx-all-paths%s",
+	     addr, VTY_NEWLINE);
+
   /* send-community print. */
   if (! peer->af_group[afi][safi])
     {
@@ -5025,13 +5553,17 @@ bgp_config_write_peer (struct vty *vty, struct bgp *bgp,
 	|| g_peer->pmax[afi][safi] != peer->pmax[afi][safi]
         || g_peer->pmax_threshold[afi][safi] != peer->pmax_threshold[afi][safi]
 	|| CHECK_FLAG (g_peer->af_flags[afi][safi], PEER_FLAG_MAX_PREFIX_WARNING)
-	   != CHECK_FLAG (peer->af_flags[afi][safi], PEER_FLAG_MAX_PREFIX_WARNING))
+	   != CHECK_FLAG (peer->af_flags[afi][safi], PEER_FLAG_MAX_PREFIX_WARNING)
+	|| CHECK_FLAG (g_peer->af_flags[afi][safi], PEER_FLAG_MAX_PREFIX_DISCARD)
+	   != CHECK_FLAG (peer->af_flags[afi][safi], PEER_FLAG_MAX_PREFIX_DISCARD))
       {
 	vty_out (vty, " neighbor %s maximum-prefix %ld", addr, peer->pmax[afi][safi]);
 	if (peer->pmax_threshold[afi][safi] != MAXIMUM_PREFIX_THRESHOLD_DEFAULT)
 	  vty_out (vty, " %d", peer->pmax_threshold[afi][safi]);
 	if (CHECK_FLAG (peer->af_flags[afi][safi], PEER_FLAG_MAX_PREFIX_WARNING))
 	  vty_out (vty, " warning-only");
+	if (CHECK_FLAG (peer->af_flags[afi][safi], PEER_FLAG_MAX_PREFIX_DISCARD))
+	  vty_out (vty, " discard-extra");
 	if (peer->pmax_restart[afi][safi])
 	  vty_out (vty, " restart %d", peer->pmax_restart[afi][safi]);
 	vty_out (vty, "%s", VTY_NEWLINE);
@@ -5040,7 +5572,9 @@ bgp_config_write_peer (struct vty *vty, struct bgp *bgp,
   /* Route server client. */
   if (CHECK_FLAG (peer->af_flags[afi][safi], PEER_FLAG_RSERVER_CLIENT)
       && ! peer->af_group[afi][safi])
-    vty_out (vty, " neighbor %s route-server-client%s", addr, VTY_NEWLINE);
+    vty_out (vty, " neighbor %s route-server-client%s%s", addr,
+             CHECK_FLAG (peer->af_flags[afi][safi], PEER_FLAG_RSERVER_SHARED)
+             ? " shared" : "", VTY_NEWLINE);
 
   /* Nexthop-local unchanged. */
   if (CHECK_FLAG (peer->af_flags[afi][safi], PEER_FLAG_NEXTHOP_LOCAL_UNCHANGED)
@@ -5176,6 +5710,12 @@ bgp_config_write (struct vty *vty)
       write++;
     }
 
+  if (bm->walk_budget != BGP_WALK_BUDGET_DEFAULT)
+    {
+      vty_out (vty, "bgp walk-budget %lu%s", bm->walk_budget, VTY_NEWLINE);
+      write++;
+    }
+
   /* BGP Config type. */
   if (bgp_option_check (BGP_OPT_CONFIG_CISCO))
     {    
@@ -5183,6 +5723,21 @@ bgp_config_write (struct vty *vty)
       write++;
     }
 
+  /* RIB export socket. */
+  write += bgp_export_config_write (vty);
+
+  /* BMP collectors. */
+  write += bgp_bmp_config_write (vty);
+
+  /* RPKI cache. */
+  write += bgp_rpki_config_write (vty);
+
+  /* RIB snapshot. */
+  write += bgp_snapshot_config_write (vty);
+
+  /* Statistics segment. */
+  write += bgp_statseg_config_write (vty);
+
   /* BGP configuration. */
   for (ALL_LIST_ELEMENTS (bm->bgp, mnode, mnnode, bgp))
     {
@@ -5264,6 +5819,11 @@ bgp_config_write (struct vty *vty)
       if (bgp_flag_check (bgp, BGP_FLAG_DETERMINISTIC_MED))
 	vty_out (vty, " bgp deterministic-med%s", VTY_NEWLINE);
 
+      /* Received routes of another view. */
+      if (bgp->rib_in_view_name)
+	vty_out (vty, " bgp adj-rib-in view %s%s", bgp->rib_in_view_name,
+		 VTY_NEWLINE);
+
       /* BGP graceful-restart. */
       if (bgp->stalepath_time != BGP_DEFAULT_STALEPATH_TIME)
 	vty_out (vty, " bgp graceful-restart stalepath-time %d%s",
@@ -5271,6 +5831,10 @@ bgp_config_write (struct vty *vty)
       if (bgp_flag_check (bgp, BGP_FLAG_GRACEFUL_RESTART))
        vty_out (vty, " bgp graceful-restart%s", VTY_NEWLINE);
 
+      /* BGP update-delay. */
+      if (bgp->update_delay)
+	vty_out (vty, " bgp update-delay %d%s", bgp->update_delay, VTY_NEWLINE);
+
       /* BGP bestpath method. */
       if (bgp_flag_check (bgp, BGP_FLAG_ASPATH_IGNORE))
 	vty_out (vty, " bgp bestpath as-path ignore%s", VTY_NEWLINE);
@@ -5293,6 +5857,14 @@ bgp_config_write (struct vty *vty)
       if (bgp_flag_check (bgp, BGP_FLAG_IMPORT_CHECK))
 	vty_out (vty, " bgp network import-check%s", VTY_NEWLINE);
 
+      /* BGP route-map cache. */
+      if (bgp_flag_check (bgp, BGP_FLAG_RMAP_CACHE))
+	vty_out (vty, " bgp route-map cache%s", VTY_NEWLINE);
+
+      /* BGP suppress-fib-pending. */
+      if (bgp_flag_check (bgp, BGP_FLAG_SUPPRESS_FIB_PENDING))
+	vty_out (vty, " bgp suppress-fib-pending%s", VTY_NEWLINE);
+
       /* BGP scan interval. */
       bgp_config_write_scan_time (vty);
 
@@ -5313,6 +5885,14 @@ bgp_config_write (struct vty *vty)
 	vty_out (vty, " timers bgp %d %d%s", bgp->default_keepalive, 
 		 bgp->default_holdtime, VTY_NEWLINE);
 
+      /* BGP socket profile. */
+      if (bgp->sock_profile.sndbuf || bgp->sock_profile.rcvbuf
+	  || bgp->sock_profile.notsent_lowat)
+	vty_out (vty, " bgp socket-profile send-buffer %u receive-buffer %u"
+		 " notsent-lowat %u%s", bgp->sock_profile.sndbuf,
+		 bgp->sock_profile.rcvbuf, bgp->sock_profile.notsent_lowat,
+		 VTY_NEWLINE);
+
       /* peer-group */
       for (ALL_LIST_ELEMENTS (bgp->group, node, nnode, group))
 	{
@@ -5364,6 +5944,8 @@ bgp_master_init (void)
   bm->port = BGP_PORT_DEFAULT;
   bm->master = thread_master_create ();
   bm->start_time = bgp_clock ();
+  bm->walk_budget = BGP_WALK_BUDGET_DEFAULT;
+  bm->policy_version = 1;
 }
 
 
@@ -5380,6 +5962,12 @@ bgp_init (void)
   bgp_attr_init ();
   bgp_debug_init ();
   bgp_dump_init ();
+  bgp_export_init ();
+  bgp_bmp_init ();
+  bgp_rpki_init ();
+  bgp_snapshot_init ();
+  bgp_perf_init ();
+  bgp_statseg_init ();
   bgp_route_init ();
   bgp_route_map_init ();
   bgp_address_init ();
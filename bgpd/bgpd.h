@@ -60,8 +60,30 @@ struct bgp_master
 #define BGP_OPT_MULTIPLE_INSTANCE        (1 << 1)
 #define BGP_OPT_CONFIG_CISCO             (1 << 2)
 #define BGP_OPT_NO_LISTEN                (1 << 3)
+
+  /* Milliseconds a table walk may run before yielding. */
+  unsigned long walk_budget;
+#define BGP_WALK_BUDGET_DEFAULT         10
+
+  /* Instances in update-delay, holding the process queues plugged. */
+  unsigned int update_delay_count;
+
+  /* Bumped on every change, other than to route-maps, that may change
+     what peers are announced, see bgp_policy_changed(). */
+  unsigned long policy_version;
 };
 
+/* Socket buffer sizes and not sent low water mark of the TCP connection
+   to a peer.  0 leaves each to the kernel, whose buffers are then tuned
+   to the connection as it goes. */
+struct bgp_sock_profile
+{
+  u_int32_t sndbuf;
+  u_int32_t rcvbuf;
+  u_int32_t notsent_lowat;
+};
+#define BGP_SOCK_PROFILE_MAX            (64 * 1024 * 1024)
+
 /* BGP instance structure.  */
 struct bgp 
 {
@@ -80,12 +102,32 @@ struct bgp
   /* BGP peer. */
   struct list *peer;
 
+  /* Configured peers by address, for peer_lookup().  Accept peers,
+     which share their address with a configured peer, are left out. */
+  struct hash *peerhash;
+
   /* BGP peer group.  */
   struct list *group;
 
+  /* Peer groups by name. */
+  struct hash *grouphash;
+
   /* BGP route-server-clients. */
   struct list *rsclient;
 
+  /* Shared route-server-clients.  They have no RIB of their own, but
+     share the one of rsclient_base, an rsclient which never comes up,
+     and are not on the rsclient list. */
+  struct peer *rsclient_base;
+  struct list *rsclient_shared;
+
+  /* The view this instance takes its received routes from, by name as
+     configured and once that exists, and the number of instances
+     taking theirs from this one.  See bgp_rib_in_view_set(). */
+  char *rib_in_view_name;
+  struct bgp *rib_in_view;
+  int rib_in_views;
+
   /* BGP configuration.  */
   u_int16_t config;
 #define BGP_CONFIG_ROUTER_ID              (1 << 0)
@@ -120,6 +162,8 @@ struct bgp
 #define BGP_FLAG_LOG_NEIGHBOR_CHANGES     (1 << 11)
 #define BGP_FLAG_GRACEFUL_RESTART         (1 << 12)
 #define BGP_FLAG_ASPATH_CONFED            (1 << 13)
+#define BGP_FLAG_RMAP_CACHE               (1 << 14)
+#define BGP_FLAG_SUPPRESS_FIB_PENDING     (1 << 15)
 
   /* BGP Per AF flags */
   u_int16_t af_flags[AFI_MAX][SAFI_MAX];
@@ -160,10 +204,22 @@ struct bgp
   u_int32_t default_holdtime;
   u_int32_t default_keepalive;
 
+  /* Socket profile of the peers with none of their own. */
+  struct bgp_sock_profile sock_profile;
+
   /* BGP graceful restart */
   u_int32_t restart_time;
   u_int32_t stalepath_time;
 
+  /* Update-delay: at startup, best path selection waits until every
+     peer has sent End-of-RIB, or this many seconds. */
+  u_int16_t update_delay;
+  struct thread *t_update_delay;
+#define BGP_UPDATE_DELAY_ACTIVE(B) ((B)->t_update_delay != NULL)
+
+  /* Pending merge of as-set aggregates which lost routes. */
+  struct thread *t_aggregate;
+
   /* Maximum-paths configuration */
   struct bgp_maxpaths_cfg {
     u_int16_t maxpaths_ebgp;
@@ -307,17 +363,28 @@ struct peer
   /* Peer specific RIB when configured as route-server-client. */
   struct bgp_table *rib[AFI_MAX][SAFI_MAX];
 
-  /* Packet receive and send buffer. */
+  /* Packet receive and send buffer.  ibuf is a view of the message
+     being processed, in the socket data buffered in rbuf. */
   struct stream *ibuf;
+  struct stream *rbuf;
   struct stream_fifo *obuf;
   struct stream *work;
 
+  /* Copies of the last OPEN messages sent and received, for BMP. */
+  struct stream *open_sent;
+  struct stream *open_rcvd;
+
+  /* Recently parsed path attributes, see bgp_attr_cache_get(). */
+  struct bgp_attr_cache *attr_cache;
+
   /* Status of the peer. */
   int status;
   int ostatus;
 
-  /* Peer index, used for dumping TABLE_DUMP_V2 format */
+  /* Peer index, used for dumping TABLE_DUMP_V2 format, and the route
+     dump whose index table it is valid for. */
   uint16_t table_dump_index;
+  unsigned int table_dump_gen;
 
   /* Peer information */
   int fd;			/* File descriptor */
@@ -370,6 +437,8 @@ struct peer
 #define PEER_CAP_ORF_PREFIX_RM_OLD_RCV      (1 << 5) /* receive-mode received */
 #define PEER_CAP_RESTART_AF_RCV             (1 << 6) /* graceful restart afi/safi received */
 #define PEER_CAP_RESTART_AF_PRESERVE_RCV    (1 << 7) /* graceful restart afi/safi F-bit received */
+#define PEER_CAP_ADDPATH_AF_TX_ADV          (1 << 8) /* addpath send advertised */
+#define PEER_CAP_ADDPATH_AF_RX_RCV          (1 << 9) /* addpath receive received */
 
   /* Global configuration flags. */
   u_int32_t flags;
@@ -405,6 +474,9 @@ struct peer
 #define PEER_FLAG_MAX_PREFIX                (1 << 14) /* maximum prefix */
 #define PEER_FLAG_MAX_PREFIX_WARNING        (1 << 15) /* maximum prefix warning-only */
 #define PEER_FLAG_NEXTHOP_LOCAL_UNCHANGED   (1 << 16) /* leave link-local nexthop unchanged */
+#define PEER_FLAG_ADDPATH_TX_ALL_PATHS      (1 << 17) /* addpath-tx-all-paths */
+#define PEER_FLAG_RSERVER_SHARED            (1 << 18) /* route-server-client shared */
+#define PEER_FLAG_MAX_PREFIX_DISCARD        (1 << 19) /* maximum prefix discard-extra */
 
   /* MD5 password */
   char *password;
@@ -425,6 +497,9 @@ struct peer
 #define PEER_STATUS_GROUP             (1 << 4) /* peer-group conf */
 #define PEER_STATUS_NSF_MODE          (1 << 5) /* NSF aware peer */
 #define PEER_STATUS_NSF_WAIT          (1 << 6) /* wait comeback peer */
+#define PEER_STATUS_HOLDTIME_GRACE    (1 << 7) /* holdtime deferred for input */
+#define PEER_STATUS_NSF_RELOAD        (1 << 8) /* stale paths from a RIB snapshot */
+#define PEER_STATUS_EOR_IMPLICIT      (1 << 9) /* keepalive taken for end-of-rib */
 
   /* Peer status af flags (reset in bgp_stop) */
   u_int16_t af_sflags[AFI_MAX][SAFI_MAX];
@@ -435,6 +510,7 @@ struct peer
 #define PEER_STATUS_PREFIX_LIMIT      (1 << 4) /* exceed prefix-limit */
 #define PEER_STATUS_EOR_SEND          (1 << 5) /* end-of-rib send to peer */
 #define PEER_STATUS_EOR_RECEIVED      (1 << 6) /* end-of-rib received from peer */
+#define PEER_STATUS_ORF_DEFERRED      (1 << 7) /* ORF changes awaiting refresh */
 
   /* Default attribute value for the peer. */
   u_int32_t config;
@@ -442,11 +518,13 @@ struct peer
 #define PEER_CONFIG_TIMER             (1 << 1) /* keepalive & holdtime */
 #define PEER_CONFIG_CONNECT           (1 << 2) /* connect */
 #define PEER_CONFIG_ROUTEADV          (1 << 3) /* route advertise */
+#define PEER_CONFIG_SOCK_PROFILE      (1 << 4) /* socket profile */
   u_int32_t weight;
   u_int32_t holdtime;
   u_int32_t keepalive;
   u_int32_t connect;
   u_int32_t routeadv;
+  struct bgp_sock_profile sock_profile;
 
   /* Timer values. */
   u_int32_t v_start;
@@ -458,21 +536,52 @@ struct peer
   u_int32_t v_pmax_restart;
   u_int32_t v_gr_restart;
 
+  /* Send buffer size and not sent low water mark of the socket, 0
+     until known, the mark negative for none. */
+  int sndbuf;
+  int notsent_lowat;
+
   /* Threads. */
   struct thread *t_read;
   struct thread *t_write;
   struct thread *t_start;
   struct thread *t_connect;
-  struct thread *t_holdtime;
-  struct thread *t_keepalive;
   struct thread *t_asorig;
   struct thread *t_routeadv;
   struct thread *t_pmax_restart;
   struct thread *t_gr_restart;
   struct thread *t_gr_stale;
+
+  /* Hold and keepalive timers, as the bgp_clock () second they expire
+     in or 0, and the slot of the timer wheel they are filed in, see
+     bgp_timer_wheel_update(). */
+  time_t holdtime_expire;
+  time_t keepalive_expire;
+  time_t wheel_due;
+  struct peer *wheel_next;
+  struct peer **wheel_prev;
   
   /* workqueues */
   struct work_queue *clear_node_queue;
+
+  /* Table walks in progress for the peer, see bgp_walk_start(). */
+#define BGP_WALK_ANNOUNCE               0
+#define BGP_WALK_ANNOUNCE_RSCLIENT      1
+#define BGP_WALK_SOFT_IN                2
+#define BGP_WALK_SOFT_IN_RSCLIENT       3
+#define BGP_WALK_PEER_MAX               4
+  struct bgp_walk *walk[AFI_MAX][SAFI_MAX][BGP_WALK_PEER_MAX];
+
+  /* Version of outbound policy when the table was last announced in
+     full, 0 if it never was, see bgp_announce_route_refresh(). */
+  unsigned long policy_version[AFI_MAX][SAFI_MAX];
+
+  /* The peer's paths, Adj-RIB-In and Adj-RIB-Out entries in all tables
+     of each address family, so that clearing the peer does not have to
+     walk the tables. */
+  struct bgp_info *paths[AFI_MAX][SAFI_MAX];
+  struct bgp_adj_in *adj_in[AFI_MAX][SAFI_MAX];
+  struct bgp_adj_out *adj_out[AFI_MAX][SAFI_MAX];
   
   /* Statistics field */
   u_int32_t open_in;		/* Open message input count */
@@ -488,6 +597,18 @@ struct peer
   u_int32_t refresh_out;	/* Route Refresh output count */
   u_int32_t dynamic_cap_in;	/* Dynamic Capability input count.  */
   u_int32_t dynamic_cap_out;	/* Dynamic Capability output count.  */
+  u_int32_t write_calls;	/* write() calls made for output */
+  u_int32_t update_prefix_out;	/* Prefixes put in UPDATEs for output */
+  u_int32_t adv_replaced;	/* Queued route changes superseded */
+  u_int32_t adv_cancelled;	/* Queued route changes netted out */
+  u_int32_t policy_rejected;	/* Prefixes denied by inbound policy */
+  u_int32_t read_turns;		/* bgp_read turns taken */
+  u_int32_t read_yields;	/* Turns ended with input still buffered */
+  u_int32_t fsm_events;		/* FSM events queued */
+  unsigned long read_backlog_peak; /* Most bytes buffered for input */
+
+  /* Processing latency of each phase, see bgp_perf.c. */
+  struct bgp_perf *perf;
 
   /* BGP state count */
   u_int32_t established;	/* Established */
@@ -503,12 +624,23 @@ struct peer
   /* Announcement attribute hash.  */
   struct hash *hash[AFI_MAX][SAFI_MAX];
 
+  /* Bytes of RIB memory held for the peer: its paths, wherever they
+     are, what it sent us, and what it was or is to be sent. */
+  unsigned long mem_paths;
+  unsigned long mem_adj_in;
+  unsigned long mem_adj_out;
+  unsigned long mem_adv;
+
   /* Notify data. */
   struct bgp_notify notify;
 
   /* Whole packet size to be read. */
   unsigned long packet_size;
 
+  /* Bytes of input this peer may still process before yielding to
+     other peers, see bgp_read. */
+  unsigned long read_deficit;
+
   /* Filter structure. */
   struct bgp_filter filter[AFI_MAX][SAFI_MAX];
 
@@ -518,6 +650,10 @@ struct peer
   /* Prefix count. */
   unsigned long pcount[AFI_MAX][SAFI_MAX];
 
+  /* Prefixes dropped over the limit by maximum-prefix discard-extra,
+     since the session came up. */
+  u_int32_t pdiscard[AFI_MAX][SAFI_MAX];
+
   /* Max prefix count. */
   unsigned long pmax[AFI_MAX][SAFI_MAX];
   u_char pmax_threshold[AFI_MAX][SAFI_MAX];
@@ -567,6 +703,12 @@ struct peer
 #define PEER_PASSWORD_MINLEN	(1)
 #define PEER_PASSWORD_MAXLEN	(80)
 
+/* Routes sent to the peer in the address family carry a path
+   identifier, and may be several per prefix. */
+#define PEER_ADDPATH_TX(P,A,S) \
+  (CHECK_FLAG ((P)->af_cap[(A)][(S)], PEER_CAP_ADDPATH_AF_TX_ADV) \
+   && CHECK_FLAG ((P)->af_cap[(A)][(S)], PEER_CAP_ADDPATH_AF_RX_RCV))
+
 /* This structure's member directly points incoming packet data
    stream. */
 struct bgp_nlri
@@ -594,6 +736,7 @@ struct bgp_nlri
 #define BGP_MARKER_SIZE		                16
 #define BGP_HEADER_SIZE		                19
 #define BGP_MAX_PACKET_SIZE                   4096
+#define BGP_READ_BUFFER_SIZE                  (BGP_MAX_PACKET_SIZE * 8)
 
 /* BGP minimum message size.  */
 #define BGP_MSG_OPEN_MIN_SIZE                   (BGP_HEADER_SIZE + 10)
@@ -734,6 +877,7 @@ struct bgp_nlri
 #define BGP_ERROR_START_TIMER                   30
 #define BGP_DEFAULT_HOLDTIME                   180
 #define BGP_DEFAULT_KEEPALIVE                   60 
+#define BGP_HOLDTIME_GRACE                       1
 #define BGP_DEFAULT_ASORIGINATE                 15
 #define BGP_DEFAULT_EBGP_ROUTEADV               30
 #define BGP_DEFAULT_IBGP_ROUTEADV                5
@@ -816,6 +960,10 @@ enum bgp_clear_type
 #define BGP_ERR_NO_IBGP_WITH_TTLHACK		-31
 #define BGP_ERR_MAX				-32
 #define BGP_ERR_CANNOT_HAVE_LOCAL_AS_SAME_AS_REMOTE_AS    -33
+#define BGP_ERR_RSCLIENT_SHARED_GROUP           -34
+#define BGP_ERR_RSCLIENT_SHARED_IMPORT          -35
+#define BGP_ERR_RSCLIENT_SHARED_CHANGE          -36
+#define BGP_ERR_RIB_IN_VIEW_CHAIN               -37
 
 extern struct bgp_master *bm;
 
@@ -861,6 +1009,7 @@ extern int bgp_delete (struct bgp *);
 extern int bgp_flag_set (struct bgp *, int);
 extern int bgp_flag_unset (struct bgp *, int);
 extern int bgp_flag_check (struct bgp *, int);
+extern void bgp_policy_changed (void);
 
 extern void bgp_lock (struct bgp *);
 extern void bgp_unlock (struct bgp *);
@@ -880,10 +1029,18 @@ extern int bgp_confederation_peers_remove (struct bgp *, as_t);
 extern int bgp_timers_set (struct bgp *, u_int32_t, u_int32_t);
 extern int bgp_timers_unset (struct bgp *);
 
+extern int bgp_sock_profile_set (struct bgp *, const struct bgp_sock_profile *);
+extern int bgp_sock_profile_unset (struct bgp *);
+
 extern int bgp_default_local_preference_set (struct bgp *, u_int32_t);
 extern int bgp_default_local_preference_unset (struct bgp *);
 
+extern int bgp_rib_in_view_set (struct bgp *, const char *);
+extern int bgp_rib_in_view_unset (struct bgp *);
+
 extern int peer_rsclient_active (struct peer *);
+extern int peer_rsclient_shared_set (struct peer *, afi_t, safi_t);
+extern int peer_rsclient_shared_unset (struct peer *, afi_t, safi_t);
 
 extern int peer_remote_as (struct bgp *, union sockunion *, as_t *, afi_t, safi_t);
 extern int peer_group_remote_as (struct bgp *, const char *, as_t *);
@@ -931,6 +1088,11 @@ extern int peer_timers_unset (struct peer *);
 extern int peer_timers_connect_set (struct peer *, u_int32_t);
 extern int peer_timers_connect_unset (struct peer *);
 
+extern int peer_sock_profile_set (struct peer *,
+				  const struct bgp_sock_profile *);
+extern int peer_sock_profile_unset (struct peer *);
+extern const struct bgp_sock_profile *peer_sock_profile (struct peer *);
+
 extern int peer_advertise_interval_set (struct peer *, u_int32_t);
 extern int peer_advertise_interval_unset (struct peer *);
 
@@ -962,7 +1124,7 @@ extern int peer_password_unset (struct peer *);
 
 extern int peer_unsuppress_map_unset (struct peer *, afi_t, safi_t);
 
-extern int peer_maximum_prefix_set (struct peer *, afi_t, safi_t, u_int32_t, u_char, int, u_int16_t);
+extern int peer_maximum_prefix_set (struct peer *, afi_t, safi_t, u_int32_t, u_char, int, int, u_int16_t);
 extern int peer_maximum_prefix_unset (struct peer *, afi_t, safi_t);
 
 extern int peer_clear (struct peer *);
@@ -73,9 +73,10 @@
  *
  * All messages sent over the connection start with a short FPM
  * header, fpm_msg_hdr_t. In the case of route add/delete messages,
- * the header is followed by a netlink message. Zebra should send a
- * complete copy of the forwarding table(s) to the FPM, including
- * routes that it may have picked up from the kernel.
+ * the header is followed by a netlink message, or by a compact record
+ * (see FPM_MSG_TYPE_COMPACT below) if the FPM asked for those. Zebra
+ * should send a complete copy of the forwarding table(s) to the FPM,
+ * including routes that it may have picked up from the kernel.
  *
  * The FPM interface uses replace semantics. That is, if a 'route add'
  * message for a prefix is followed by another 'route add' message, the
@@ -133,8 +134,117 @@ typedef enum fpm_msg_type_e_ {
    * message.
    */
   FPM_MSG_TYPE_NETLINK = 1,
+
+  /*
+   * Indicates that the payload is a compact record, see
+   * fpm_compact_hdr_t.
+   */
+  FPM_MSG_TYPE_COMPACT = 2,
 } fpm_msg_type_e;
 
+/*
+ * Compact messages.
+ *
+ * Routes are sent as lists of densely packed prefixes that refer to a
+ * nexthop group defined earlier on the same connection, instead of
+ * carrying their nexthops themselves. Each compact message holds
+ * exactly one record, which starts with the header below. All fields
+ * are in network byte order.
+ *
+ * Nexthop group IDs are only meaningful for the lifetime of the
+ * connection. A group is never redefined with different contents
+ * while the connection is up. Zebra may still send netlink messages
+ * on a compact connection, for routes it cannot express compactly.
+ */
+typedef struct fpm_compact_hdr_t_
+{
+  /*
+   * Kind of record, see below.
+   */
+  uint8_t op;
+
+  /*
+   * Address family of nexthops or prefixes, AF_INET or AF_INET6.
+   */
+  uint8_t family;
+
+  /*
+   * Number of nexthops (for FPM_COMPACT_OP_NHG_ADD) or of prefixes
+   * that follow.
+   */
+  uint16_t count;
+
+  /*
+   * Nexthop group that is defined, or used by the routes added. Zero
+   * for deletions.
+   */
+  uint32_t nhg_id;
+} fpm_compact_hdr_t;
+
+/*
+ * Define nexthop group 'nhg_id'. The header is followed by an
+ * fpm_compact_nhg_t, then 'count' nexthops, each an fpm_compact_nh_t
+ * optionally followed by a gateway address, and then the preferred
+ * source address if FPM_COMPACT_NHG_F_PREFSRC is set.
+ */
+#define FPM_COMPACT_OP_NHG_ADD   1
+
+/*
+ * Add or replace routes to the prefixes that follow the header, all
+ * using nexthop group 'nhg_id'. Each prefix is a prefix length octet
+ * followed by as many octets of address as the length covers.
+ */
+#define FPM_COMPACT_OP_ROUTE_ADD 2
+
+/*
+ * Delete routes to the prefixes that follow the header, encoded as
+ * for FPM_COMPACT_OP_ROUTE_ADD.
+ */
+#define FPM_COMPACT_OP_ROUTE_DEL 3
+
+typedef struct fpm_compact_nhg_t_
+{
+  /*
+   * FPM_COMPACT_NHG_*.
+   */
+  uint8_t type;
+
+  /*
+   * Zebra route type (ZEBRA_ROUTE_*) the routes were learnt by.
+   */
+  uint8_t route_type;
+
+  /*
+   * FPM_COMPACT_NHG_F_*.
+   */
+  uint8_t flags;
+  uint8_t reserved;
+
+  uint32_t metric;
+} fpm_compact_nhg_t;
+
+#define FPM_COMPACT_NHG_UNICAST     1
+#define FPM_COMPACT_NHG_BLACKHOLE   2
+#define FPM_COMPACT_NHG_UNREACHABLE 3
+
+#define FPM_COMPACT_NHG_F_PREFSRC   0x01
+
+typedef struct fpm_compact_nh_t_
+{
+  uint32_t if_index;
+
+  /*
+   * FPM_COMPACT_NH_F_*.
+   */
+  uint8_t flags;
+  uint8_t reserved[3];
+} fpm_compact_nh_t;
+
+/*
+ * A gateway address of the size of the family follows.
+ */
+#define FPM_COMPACT_NH_F_GATEWAY    0x01
+
 /*
  * The FPM message header is aligned to the same boundary as netlink
  * messages (4). This means that a netlink message does not need
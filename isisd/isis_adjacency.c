@@ -233,9 +233,8 @@ isis_adj_state_change (struct isis_adjacency *adj, enum isis_adj_state new_state
           circuit->upadjcount[level - 1]--;
           if (circuit->upadjcount[level - 1] == 0)
             {
-              /* Clean lsp_queue when no adj is up. */
-              if (circuit->lsp_queue)
-                list_delete_all_node (circuit->lsp_queue);
+              /* Clean the transmit queue when no adj is up. */
+              flags_tx_flush (circuit->srm_queue);
             }
           isis_event_adjacency_state_change (adj, new_state);
           isis_delete_adj (adj);
@@ -282,9 +281,8 @@ isis_adj_state_change (struct isis_adjacency *adj, enum isis_adj_state new_state
           circuit->upadjcount[level - 1]--;
           if (circuit->upadjcount[level - 1] == 0)
             {
-              /* Clean lsp_queue when no adj is up. */
-              if (circuit->lsp_queue)
-                list_delete_all_node (circuit->lsp_queue);
+              /* Clean the transmit queue when no adj is up. */
+              flags_tx_flush (circuit->srm_queue);
             }
           isis_event_adjacency_state_change (adj, new_state);
           isis_delete_adj (adj);
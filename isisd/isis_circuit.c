@@ -97,6 +97,7 @@ isis_circuit_new ()
       circuit->metrics[i].metric_delay = METRICS_UNSUPPORTED;
       circuit->te_metric[i] = DEFAULT_CIRCUIT_METRIC;
     }
+  flags_circuit_init (circuit);
 
   return circuit;
 }
@@ -109,6 +110,8 @@ isis_circuit_del (struct isis_circuit *circuit)
 
   isis_circuit_if_unbind (circuit, circuit->interface);
 
+  flags_circuit_finish (circuit);
+
   /* and lastly the circuit itself */
   XFREE (MTYPE_ISIS_CIRCUIT, circuit);
 
@@ -144,6 +147,7 @@ void
 isis_circuit_deconfigure (struct isis_circuit *circuit, struct isis_area *area)
 {
   /* Free the index of SRM and SSN flags */
+  flags_circuit_clear (circuit);
   flags_free_index (&area->flags, circuit->idx);
   circuit->idx = 0;
   /* Remove circuit from area */
@@ -542,11 +546,10 @@ isis_circuit_if_unbind (struct isis_circuit *circuit, struct interface *ifp)
 }
 
 static void
-isis_circuit_update_all_srmflags (struct isis_circuit *circuit, int is_set)
+isis_circuit_set_all_srmflags (struct isis_circuit *circuit)
 {
   struct isis_area *area;
   struct isis_lsp *lsp;
-  dnode_t *dnode, *dnode_next;
   int level;
 
   assert (circuit);
@@ -557,22 +560,11 @@ isis_circuit_update_all_srmflags (struct isis_circuit *circuit, int is_set)
       if (level & circuit->is_type)
         {
           if (area->lspdb[level - 1] &&
-              dict_count (area->lspdb[level - 1]) > 0)
+              lsp_db_count (area->lspdb[level - 1]) > 0)
             {
-              for (dnode = dict_first (area->lspdb[level - 1]);
-                   dnode != NULL; dnode = dnode_next)
-                {
-                  dnode_next = dict_next (area->lspdb[level - 1], dnode);
-                  lsp = dnode_get (dnode);
-                  if (is_set)
-                    {
-                      ISIS_SET_FLAG (lsp->SRMflags, circuit);
-                    }
-                  else
-                    {
-                      ISIS_CLEAR_FLAG (lsp->SRMflags, circuit);
-                    }
-                }
+              for (lsp = lsp_db_first (area->lspdb[level - 1]);
+                   lsp != NULL; lsp = lsp_db_next (lsp))
+                flags_set_srm (lsp, circuit);
             }
         }
     }
@@ -584,7 +576,7 @@ isis_circuit_up (struct isis_circuit *circuit)
   int retv;
 
   /* Set the flags for all the lsps of the circuit. */
-  isis_circuit_update_all_srmflags (circuit, 1);
+  isis_circuit_set_all_srmflags (circuit);
 
   if (circuit->state == C_STATE_UP)
     return ISIS_OK;
@@ -702,7 +694,6 @@ isis_circuit_up (struct isis_circuit *circuit)
                    circuit->fd);
 #endif
 
-  circuit->lsp_queue = list_new ();
   circuit->lsp_queue_last_cleared = time (NULL);
 
   return ISIS_OK;
@@ -715,7 +706,7 @@ isis_circuit_down (struct isis_circuit *circuit)
     return;
 
   /* Clear the flags for all the lsps of the circuit. */
-  isis_circuit_update_all_srmflags (circuit, 0);
+  flags_circuit_clear (circuit);
 
   if (circuit->circ_type == CIRCUIT_T_BROADCAST)
     {
@@ -778,12 +769,7 @@ isis_circuit_down (struct isis_circuit *circuit)
   THREAD_TIMER_OFF (circuit->t_send_psnp[1]);
   THREAD_OFF (circuit->t_read);
 
-  if (circuit->lsp_queue)
-    {
-      circuit->lsp_queue->del = NULL;
-      list_delete (circuit->lsp_queue);
-      circuit->lsp_queue = NULL;
-    }
+  THREAD_OFF (circuit->t_send_lsp);
 
   /* send one gratuitous hello to spead up convergence */
   if (circuit->is_type & IS_LEVEL_1)
@@ -796,10 +782,7 @@ isis_circuit_down (struct isis_circuit *circuit)
 
   /* close the socket */
   if (circuit->fd)
-    {
-      close (circuit->fd);
-      circuit->fd = 0;
-    }
+    isis_sock_close (circuit);
 
   if (circuit->rcv_stream != NULL)
     {
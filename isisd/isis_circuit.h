@@ -68,6 +68,9 @@ struct isis_circuit
   struct interface *interface;	/* interface info from z */
   int fd;			/* IS-IS l1/2 socket */
   int sap_length;		/* SAP length for DLPI */
+  struct isis_ring *rx_ring;	/* PF_PACKET rings mapped, if any */
+  struct isis_ring *tx_ring;
+  struct thread *t_tx_flush;	/* sends the frames queued on tx_ring */
   struct nlpids nlpids;
   /*
    * Threads
@@ -75,7 +78,9 @@ struct isis_circuit
   struct thread *t_read;
   struct thread *t_send_csnp[2];
   struct thread *t_send_psnp[2];
-  struct list *lsp_queue;	/* LSPs to be txed (both levels) */
+  struct thread *t_send_lsp;
+  struct flags_queue *srm_queue;	/* LSPs to be txed (both levels) */
+  struct flags_queue *ssn_queue;	/* LSPs to be acked (both levels) */
   time_t lsp_queue_last_cleared;/* timestamp used to enforce transmit interval;
                                  * for scalability, use one timestamp per 
                                  * circuit, instead of one per lsp per circuit
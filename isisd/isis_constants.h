@@ -72,10 +72,13 @@
 #define DEFAULT_MIN_LSP_GEN_INTERVAL  30
 
 #define MIN_LSP_TRANS_INTERVAL        5
+#define LSP_TX_BURST                  10 /* LSPs sent per circuit ... */
+#define LSP_TX_INTERVAL               33 /* ... every this many ms */
 
 #define MIN_CSNP_INTERVAL             1
 #define MAX_CSNP_INTERVAL             600
 #define DEFAULT_CSNP_INTERVAL         10
+#define CSNP_CACHE_REFRESH            30 /* lifetimes in cached CSNPs, s */
 
 #define MIN_PSNP_INTERVAL             1
 #define MAX_PSNP_INTERVAL             120
@@ -516,6 +516,13 @@ end:
   return retval;
 }
 
+void
+isis_sock_close (struct isis_circuit *circuit)
+{
+  close (circuit->fd);
+  circuit->fd = 0;
+}
+
 int
 isis_recv_pdu_bcast (struct isis_circuit *circuit, u_char * ssnpa)
 {
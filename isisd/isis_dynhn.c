@@ -30,6 +30,8 @@
 #include "command.h"
 #include "if.h"
 #include "thread.h"
+#include "hash.h"
+#include "jhash.h"
 
 #include "isisd/dict.h"
 #include "isisd/isis_constants.h"
@@ -43,14 +45,71 @@
 
 extern struct host host;
 
-struct list *dyn_cache = NULL;
+/* The hostnames, indexed by system ID and in a list ordered by their
+   last refresh, oldest first, so that the cleanup stops at the first
+   one still fresh. */
+static struct
+{
+  struct hash *index;
+  struct isis_dynhn *head;
+  struct isis_dynhn *tail;
+} dyn_cache;
+
 static int dyn_cache_cleanup (struct thread *);
 
+static unsigned int
+dynhn_hash_key (void *data)
+{
+  struct isis_dynhn *dyn = data;
+
+  return jhash (dyn->id, ISIS_SYS_ID_LEN, 0);
+}
+
+static int
+dynhn_hash_cmp (const void *a, const void *b)
+{
+  return memcmp (((const struct isis_dynhn *) a)->id,
+		 ((const struct isis_dynhn *) b)->id, ISIS_SYS_ID_LEN) == 0;
+}
+
+static void
+dyn_cache_link (struct isis_dynhn *dyn)
+{
+  dyn->next = NULL;
+  dyn->prev = dyn_cache.tail;
+  if (dyn_cache.tail)
+    dyn_cache.tail->next = dyn;
+  else
+    dyn_cache.head = dyn;
+  dyn_cache.tail = dyn;
+}
+
+static void
+dyn_cache_unlink (struct isis_dynhn *dyn)
+{
+  if (dyn->prev)
+    dyn->prev->next = dyn->next;
+  else
+    dyn_cache.head = dyn->next;
+  if (dyn->next)
+    dyn->next->prev = dyn->prev;
+  else
+    dyn_cache.tail = dyn->prev;
+}
+
+static void
+dyn_cache_delete (struct isis_dynhn *dyn)
+{
+  hash_release (dyn_cache.index, dyn);
+  dyn_cache_unlink (dyn);
+  XFREE (MTYPE_ISIS_DYNHN, dyn);
+}
+
 void
 dyn_cache_init (void)
 {
-  if (dyn_cache == NULL)
-    dyn_cache = list_new ();
+  if (dyn_cache.index == NULL)
+    dyn_cache.index = hash_create_open (0, dynhn_hash_key, dynhn_hash_cmp);
   THREAD_TIMER_ON (master, isis->t_dync_clean, dyn_cache_cleanup, NULL, 120);
   return;
 }
@@ -58,20 +117,12 @@ dyn_cache_init (void)
 static int
 dyn_cache_cleanup (struct thread *thread)
 {
-  struct listnode *node, *nnode;
-  struct isis_dynhn *dyn;
   time_t now = time (NULL);
 
   isis->t_dync_clean = NULL;
 
-  for (ALL_LIST_ELEMENTS (dyn_cache, node, nnode, dyn))
-    {
-      if ((now - dyn->refresh) < MAX_LSP_LIFETIME)
-        continue;
-
-      list_delete_node (dyn_cache, node);
-      XFREE (MTYPE_ISIS_DYNHN, dyn);
-    }
+  while (dyn_cache.head && (now - dyn_cache.head->refresh) >= MAX_LSP_LIFETIME)
+    dyn_cache_delete (dyn_cache.head);
 
   THREAD_TIMER_ON (master, isis->t_dync_clean, dyn_cache_cleanup, NULL, 120);
   return ISIS_OK;
@@ -80,23 +131,21 @@ dyn_cache_cleanup (struct thread *thread)
 struct isis_dynhn *
 dynhn_find_by_id (u_char * id)
 {
-  struct listnode *node = NULL;
-  struct isis_dynhn *dyn = NULL;
+  struct isis_dynhn key;
 
-  for (ALL_LIST_ELEMENTS_RO (dyn_cache, node, dyn))
-    if (memcmp (dyn->id, id, ISIS_SYS_ID_LEN) == 0)
-      return dyn;
+  if (dyn_cache.index == NULL)
+    return NULL;
 
-  return NULL;
+  memcpy (key.id, id, ISIS_SYS_ID_LEN);
+  return hash_lookup (dyn_cache.index, &key);
 }
 
 struct isis_dynhn *
 dynhn_find_by_name (const char *hostname)
 {
-  struct listnode *node = NULL;
-  struct isis_dynhn *dyn = NULL;
+  struct isis_dynhn *dyn;
 
-  for (ALL_LIST_ELEMENTS_RO (dyn_cache, node, dyn))
+  for (dyn = dyn_cache.head; dyn; dyn = dyn->next)
     if (strncmp ((char *)dyn->name.name, hostname, 255) == 0)
       return dyn;
 
@@ -112,8 +161,9 @@ isis_dynhn_insert (u_char * id, struct hostname *hostname, int level)
   if (dyn)
     {
       memcpy (&dyn->name, hostname, hostname->namelen + 1);
-      memcpy (dyn->id, id, ISIS_SYS_ID_LEN);
       dyn->refresh = time (NULL);
+      dyn_cache_unlink (dyn);
+      dyn_cache_link (dyn);
       return;
     }
   dyn = XCALLOC (MTYPE_ISIS_DYNHN, sizeof (struct isis_dynhn));
@@ -129,7 +179,8 @@ isis_dynhn_insert (u_char * id, struct hostname *hostname, int level)
   dyn->refresh = time (NULL);
   dyn->level = level;
 
-  listnode_add (dyn_cache, dyn);
+  hash_get (dyn_cache.index, dyn, hash_alloc_intern);
+  dyn_cache_link (dyn);
 
   return;
 }
@@ -142,8 +193,7 @@ isis_dynhn_remove (u_char * id)
   dyn = dynhn_find_by_id (id);
   if (!dyn)
     return;
-  listnode_delete (dyn_cache, dyn);
-  XFREE (MTYPE_ISIS_DYNHN, dyn);
+  dyn_cache_delete (dyn);
   return;
 }
 
@@ -156,11 +206,10 @@ isis_dynhn_remove (u_char * id)
 void
 dynhn_print_all (struct vty *vty)
 {
-  struct listnode *node;
   struct isis_dynhn *dyn;
 
   vty_out (vty, "Level  System ID      Dynamic Hostname%s", VTY_NEWLINE);
-  for (ALL_LIST_ELEMENTS_RO (dyn_cache, node, dyn))
+  for (dyn = dyn_cache.head; dyn; dyn = dyn->next)
     {
       vty_out (vty, "%-7d", dyn->level);
       vty_out (vty, "%-15s%-15s%s", sysid_print (dyn->id), dyn->name.name,
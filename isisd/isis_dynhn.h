@@ -29,6 +29,7 @@ struct isis_dynhn
   struct hostname name;
   time_t refresh;
   int level;
+  struct isis_dynhn *prev, *next;	/* by refresh, see isis_dynhn.c */
 };
 
 void dyn_cache_init (void);
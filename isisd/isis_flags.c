@@ -24,10 +24,24 @@
 #include <zebra.h>
 #include "log.h"
 #include "linklist.h"
+#include "memory.h"
+#include "hash.h"
+#include "jhash.h"
+#include "stream.h"
+#include "vty.h"
+#include "if.h"
 
+#include "isisd/dict.h"
 #include "isisd/isis_constants.h"
 #include "isisd/isis_common.h"
 #include "isisd/isis_flags.h"
+#include "isisd/isis_circuit.h"
+#include "isisd/isis_tlv.h"
+#include "isisd/isisd.h"
+#include "isisd/isis_lsp.h"
+
+#define FLAG_SET(F,C)    ((F)[(C)->idx >> 5] |= (1 << ((C)->idx & 0x1F)))
+#define FLAG_CLEAR(F,C)  ((F)[(C)->idx >> 5] &= ~(1 << ((C)->idx & 0x1F)))
 
 void
 flags_initialize (struct flags *flags)
@@ -76,11 +90,221 @@ flags_free_index (struct flags *flags, long int index)
   return;
 }
 
-int
-flags_any_set (u_int32_t * flags)
+static unsigned int
+flags_entry_hash_key (void *data)
+{
+  struct flags_entry *entry = data;
+
+  return jhash (&entry->lsp, sizeof (entry->lsp), 0);
+}
+
+static int
+flags_entry_hash_cmp (const void *a, const void *b)
+{
+  return ((const struct flags_entry *) a)->lsp
+    == ((const struct flags_entry *) b)->lsp;
+}
+
+static struct flags_queue *
+flags_queue_new (void)
+{
+  struct flags_queue *queue;
+
+  queue = XCALLOC (MTYPE_ISIS_FLAGS, sizeof (struct flags_queue));
+  queue->index = hash_create_open (0, flags_entry_hash_key,
+				   flags_entry_hash_cmp);
+  return queue;
+}
+
+static struct flags_entry *
+flags_queue_lookup (struct flags_queue *queue, struct isis_lsp *lsp)
 {
-  u_int32_t zero[ISIS_MAX_CIRCUITS];
-  memset (zero, 0x00, ISIS_MAX_CIRCUITS * 4);
+  struct flags_entry key;
 
-  return bcmp (flags, zero, ISIS_MAX_CIRCUITS * 4);
+  key.lsp = lsp;
+  return hash_lookup (queue->index, &key);
+}
+
+static void
+flags_queue_add (struct flags_queue *queue, struct isis_lsp *lsp)
+{
+  struct flags_entry *entry;
+
+  entry = XCALLOC (MTYPE_ISIS_FLAGS, sizeof (struct flags_entry));
+  entry->lsp = lsp;
+  hash_get (queue->index, entry, hash_alloc_intern);
+
+  entry->prev = queue->tail;
+  if (queue->tail)
+    queue->tail->next = entry;
+  else
+    queue->head = entry;
+  queue->tail = entry;
+  queue->count++;
+}
+
+static void
+flags_queue_del (struct flags_queue *queue, struct flags_entry *entry)
+{
+  if (entry->tx_queued)
+    flags_tx_del (queue, entry);
+
+  if (entry->prev)
+    entry->prev->next = entry->next;
+  else
+    queue->head = entry->next;
+  if (entry->next)
+    entry->next->prev = entry->prev;
+  else
+    queue->tail = entry->prev;
+  queue->count--;
+
+  hash_release (queue->index, entry);
+  XFREE (MTYPE_ISIS_FLAGS, entry);
+}
+
+static void
+flags_set (u_int32_t * flags, struct flags_queue *queue,
+	   struct isis_lsp *lsp, struct isis_circuit *circuit)
+{
+  if (ISIS_CHECK_FLAG (flags, circuit))
+    return;
+  FLAG_SET (flags, circuit);
+  flags_queue_add (queue, lsp);
+}
+
+static void
+flags_clear (u_int32_t * flags, struct flags_queue *queue,
+	     struct isis_lsp *lsp, struct isis_circuit *circuit)
+{
+  struct flags_entry *entry;
+
+  if (!ISIS_CHECK_FLAG (flags, circuit))
+    return;
+  FLAG_CLEAR (flags, circuit);
+  entry = flags_queue_lookup (queue, lsp);
+  if (entry)
+    flags_queue_del (queue, entry);
+}
+
+void
+flags_set_srm (struct isis_lsp *lsp, struct isis_circuit *circuit)
+{
+  /* nothing is ever sent on passive circuits */
+  if (circuit->is_passive)
+    return;
+  flags_set (lsp->SRMflags, circuit->srm_queue, lsp, circuit);
+}
+
+void
+flags_clear_srm (struct isis_lsp *lsp, struct isis_circuit *circuit)
+{
+  flags_clear (lsp->SRMflags, circuit->srm_queue, lsp, circuit);
+}
+
+void
+flags_set_ssn (struct isis_lsp *lsp, struct isis_circuit *circuit)
+{
+  flags_set (lsp->SSNflags, circuit->ssn_queue, lsp, circuit);
+}
+
+void
+flags_clear_ssn (struct isis_lsp *lsp, struct isis_circuit *circuit)
+{
+  flags_clear (lsp->SSNflags, circuit->ssn_queue, lsp, circuit);
+}
+
+void
+flags_clear_all_srm (struct isis_lsp *lsp)
+{
+  struct listnode *node;
+  struct isis_circuit *circuit;
+
+  if (lsp->area == NULL)
+    return;
+  for (ALL_LIST_ELEMENTS_RO (lsp->area->circuit_list, node, circuit))
+    flags_clear_srm (lsp, circuit);
+}
+
+void
+flags_clear_all_ssn (struct isis_lsp *lsp)
+{
+  struct listnode *node;
+  struct isis_circuit *circuit;
+
+  if (lsp->area == NULL)
+    return;
+  for (ALL_LIST_ELEMENTS_RO (lsp->area->circuit_list, node, circuit))
+    flags_clear_ssn (lsp, circuit);
+}
+
+void
+flags_circuit_init (struct isis_circuit *circuit)
+{
+  circuit->srm_queue = flags_queue_new ();
+  circuit->ssn_queue = flags_queue_new ();
+}
+
+/*
+ * Clear every flag of the circuit, eg when it goes down or leaves the
+ * area and gives up its index
+ */
+void
+flags_circuit_clear (struct isis_circuit *circuit)
+{
+  while (circuit->srm_queue->head)
+    flags_clear_srm (circuit->srm_queue->head->lsp, circuit);
+  while (circuit->ssn_queue->head)
+    flags_clear_ssn (circuit->ssn_queue->head->lsp, circuit);
+}
+
+void
+flags_circuit_finish (struct isis_circuit *circuit)
+{
+  flags_circuit_clear (circuit);
+  hash_free (circuit->srm_queue->index);
+  hash_free (circuit->ssn_queue->index);
+  XFREE (MTYPE_ISIS_FLAGS, circuit->srm_queue);
+  XFREE (MTYPE_ISIS_FLAGS, circuit->ssn_queue);
+}
+
+void
+flags_tx_add (struct flags_queue *queue, struct flags_entry *entry)
+{
+  if (entry->tx_queued)
+    return;
+  entry->tx_queued = 1;
+  entry->tx_next = NULL;
+  entry->tx_prev = queue->tx_tail;
+  if (queue->tx_tail)
+    queue->tx_tail->tx_next = entry;
+  else
+    queue->tx_head = entry;
+  queue->tx_tail = entry;
+  queue->tx_count++;
+}
+
+void
+flags_tx_del (struct flags_queue *queue, struct flags_entry *entry)
+{
+  if (!entry->tx_queued)
+    return;
+  if (entry->tx_prev)
+    entry->tx_prev->tx_next = entry->tx_next;
+  else
+    queue->tx_head = entry->tx_next;
+  if (entry->tx_next)
+    entry->tx_next->tx_prev = entry->tx_prev;
+  else
+    queue->tx_tail = entry->tx_prev;
+  entry->tx_prev = entry->tx_next = NULL;
+  entry->tx_queued = 0;
+  queue->tx_count--;
+}
+
+void
+flags_tx_flush (struct flags_queue *queue)
+{
+  while (queue->tx_head)
+    flags_tx_del (queue, queue->tx_head);
 }
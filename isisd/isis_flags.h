@@ -37,32 +37,51 @@ struct flags
   struct list *free_idcs;
 };
 
+/*
+ * The LSPs with the SRM or SSN flag set for one circuit, in the order the
+ * flags were set, so that flooding and acking only look at what is
+ * pending rather than at the whole LSPDB.  The SRM queue also links the
+ * LSPs due for transmission on the circuit.
+ */
+struct flags_entry
+{
+  struct isis_lsp *lsp;
+  struct flags_entry *prev, *next;
+  struct flags_entry *tx_prev, *tx_next;
+  u_char tx_queued;
+};
+
+struct flags_queue
+{
+  struct hash *index;		/* entries by LSP */
+  struct flags_entry *head, *tail;
+  unsigned long count;
+  struct flags_entry *tx_head, *tx_tail;
+  unsigned long tx_count;
+};
+
+struct isis_lsp;
+struct isis_circuit;
+
 void flags_initialize (struct flags *flags);
 long int flags_get_index (struct flags *flags);
 void flags_free_index (struct flags *flags, long int index);
-int flags_any_set (u_int32_t * flags);
 
-#define ISIS_SET_FLAG(F,C) \
-        { \
-          F[C->idx>>5] |= (1<<(C->idx & 0x1F)); \
-        }
+void flags_set_srm (struct isis_lsp *lsp, struct isis_circuit *circuit);
+void flags_clear_srm (struct isis_lsp *lsp, struct isis_circuit *circuit);
+void flags_set_ssn (struct isis_lsp *lsp, struct isis_circuit *circuit);
+void flags_clear_ssn (struct isis_lsp *lsp, struct isis_circuit *circuit);
+void flags_clear_all_srm (struct isis_lsp *lsp);
+void flags_clear_all_ssn (struct isis_lsp *lsp);
 
-#define ISIS_CLEAR_FLAG(F,C) \
-        { \
-          F[C->idx>>5] &= ~(1<<(C->idx & 0x1F)); \
-        }
+void flags_circuit_init (struct isis_circuit *circuit);
+void flags_circuit_clear (struct isis_circuit *circuit);
+void flags_circuit_finish (struct isis_circuit *circuit);
 
-#define ISIS_CHECK_FLAG(F, C)  (F[(C)->idx>>5] & (1<<(C->idx & 0x1F)))
-
-/* sets all u_32int_t flags to 1 */
-#define ISIS_FLAGS_SET_ALL(FLAGS) \
-        { \
-          memset(FLAGS,0xFF,ISIS_MAX_CIRCUITS*4); \
-        }
+void flags_tx_add (struct flags_queue *queue, struct flags_entry *entry);
+void flags_tx_del (struct flags_queue *queue, struct flags_entry *entry);
+void flags_tx_flush (struct flags_queue *queue);
 
-#define ISIS_FLAGS_CLEAR_ALL(FLAGS) \
-        { \
-          memset(FLAGS,0x00,ISIS_MAX_CIRCUITS*4); \
-        }
+#define ISIS_CHECK_FLAG(F, C)  (F[(C)->idx>>5] & (1<<(C->idx & 0x1F)))
 
 #endif /* _ZEBRA_ISIS_FLAGS_H */
@@ -32,6 +32,7 @@
 #include "prefix.h"
 #include "command.h"
 #include "hash.h"
+#include "jhash.h"
 #include "if.h"
 #include "checksum.h"
 #include "md5.h"
@@ -69,38 +70,193 @@ lsp_id_cmp (u_char * id1, u_char * id2)
   return memcmp (id1, id2, ISIS_SYS_ID_LEN + 2);
 }
 
-dict_t *
+/* The LSPs of a level are kept in two indexes, both keyed on the LSP ID
+ * read as a 64-bit integer, so that integer order is the memcmp order
+ * of lsp_id_cmp():
+ *
+ *  - an open hash, for lsp_search();
+ *  - a skiplist, for walks and for the ranges of CSNPs.  Its lowest
+ *    level is the db_next list of the LSPs themselves, and only the LSPs
+ *    with more levels carry an array of further links.
+ */
+
+static u_int64_t
+lsp_id_key (const u_char *id)
+{
+  u_int64_t key = 0;
+  int i;
+
+  for (i = 0; i < ISIS_SYS_ID_LEN + 2; i++)
+    key = (key << 8) | id[i];
+  return key;
+}
+
+static unsigned int
+lsp_db_hash_key (void *arg)
+{
+  struct isis_lsp *lsp = arg;
+
+  return jhash_2words ((u_int32_t) (lsp->db_key >> 32),
+                       (u_int32_t) lsp->db_key, 0);
+}
+
+static int
+lsp_db_hash_cmp (const void *arg1, const void *arg2)
+{
+  const struct isis_lsp *lsp1 = arg1;
+  const struct isis_lsp *lsp2 = arg2;
+
+  return lsp1->db_key == lsp2->db_key;
+}
+
+struct isis_lspdb *
 lsp_db_init (void)
 {
-  dict_t *dict;
+  struct isis_lspdb *lspdb;
+
+  lspdb = XCALLOC (MTYPE_ISIS_LSPDB, sizeof (struct isis_lspdb));
+  lspdb->index = hash_create_open (0, lsp_db_hash_key, lsp_db_hash_cmp);
+
+  return lspdb;
+}
+
+/* Link at level i after lsp, or from the head for NULL. */
+static struct isis_lsp **
+lsp_db_forward (struct isis_lspdb *lspdb, struct isis_lsp *lsp, int i)
+{
+  if (lsp == NULL)
+    return &lspdb->skip[i];
+  if (i == 0)
+    return &lsp->db_next;
+  return &lsp->db_skip[i - 1];
+}
+
+/* Find the last LSP before key at each level, and return the first one
+   at or after it. */
+static struct isis_lsp *
+lsp_db_lower_bound (struct isis_lspdb *lspdb, u_int64_t key,
+                    struct isis_lsp **update)
+{
+  struct isis_lsp *x = NULL, *next;
+  int i;
 
-  dict = dict_create (DICTCOUNT_T_MAX, (dict_comp_t) lsp_id_cmp);
+  for (i = lspdb->level - 1; i >= 0; i--)
+    {
+      while ((next = *lsp_db_forward (lspdb, x, i)) != NULL
+             && next->db_key < key)
+        x = next;
+      if (update)
+        update[i] = x;
+    }
+
+  return *lsp_db_forward (lspdb, x, 0);
+}
+
+static int
+lsp_db_random_level (void)
+{
+  int level = 1;
 
-  return dict;
+  while (level < ISIS_LSPDB_SKIP_LEVELS && (random () & 3) == 0)
+    level++;
+  return level;
+}
+
+static void
+lsp_db_add (struct isis_lspdb *lspdb, struct isis_lsp *lsp)
+{
+  struct isis_lsp *update[ISIS_LSPDB_SKIP_LEVELS];
+  struct isis_lsp **forward;
+  struct isis_lsp *found;
+  int level, i;
+
+  lsp->db_key = lsp_id_key (lsp->lsp_header->lsp_id);
+  found = lsp_db_lower_bound (lspdb, lsp->db_key, update);
+  assert (found == NULL || found->db_key != lsp->db_key);
+
+  level = lsp_db_random_level ();
+  for (i = lspdb->level; i < level; i++)
+    update[i] = NULL;
+  if (level > lspdb->level)
+    lspdb->level = level;
+
+  lsp->db_skip_level = level - 1;
+  if (lsp->db_skip_level)
+    lsp->db_skip = XCALLOC (MTYPE_ISIS_LSPDB,
+                            lsp->db_skip_level * sizeof (struct isis_lsp *));
+
+  for (i = 0; i < level; i++)
+    {
+      forward = lsp_db_forward (lspdb, update[i], i);
+      *lsp_db_forward (lspdb, lsp, i) = *forward;
+      *forward = lsp;
+    }
+
+  hash_get (lspdb->index, lsp, hash_alloc_intern);
+  lspdb->count++;
+  lspdb->generation++;
+}
+
+/* Unlink lsp, which keeps its db_next link for walks still holding it. */
+static void
+lsp_db_remove (struct isis_lspdb *lspdb, struct isis_lsp *lsp)
+{
+  struct isis_lsp *update[ISIS_LSPDB_SKIP_LEVELS];
+  struct isis_lsp *found;
+  int i;
+
+  found = lsp_db_lower_bound (lspdb, lsp->db_key, update);
+  assert (found == lsp);
+
+  for (i = 0; i <= lsp->db_skip_level; i++)
+    *lsp_db_forward (lspdb, update[i], i) = *lsp_db_forward (lspdb, lsp, i);
+
+  if (lsp->db_skip)
+    XFREE (MTYPE_ISIS_LSPDB, lsp->db_skip);
+  lsp->db_skip_level = 0;
+
+  while (lspdb->level > 0 && lspdb->skip[lspdb->level - 1] == NULL)
+    lspdb->level--;
+
+  hash_release (lspdb->index, lsp);
+  lspdb->count--;
+  lspdb->generation++;
+}
+
+/* An LSP of the area changed in place: its sequence number, checksum or
+   a lifetime gone to zero, all of which the CSNPs carry. */
+static void
+lsp_db_changed (struct isis_lsp *lsp)
+{
+  if (lsp->area && (lsp->level == IS_LEVEL_1 || lsp->level == IS_LEVEL_2)
+      && lsp->area->lspdb[lsp->level - 1])
+    lsp->area->lspdb[lsp->level - 1]->generation++;
 }
 
 struct isis_lsp *
-lsp_search (u_char * id, dict_t * lspdb)
+lsp_db_first (struct isis_lspdb *lspdb)
 {
-  dnode_t *node;
+  return lspdb->skip[0];
+}
+
+struct isis_lsp *
+lsp_search (u_char * id, struct isis_lspdb *lspdb)
+{
+  struct isis_lsp key;
 
 #ifdef EXTREME_DEBUG
-  dnode_t *dn;
+  struct isis_lsp *lsp;
 
   zlog_debug ("searching db");
-  for (dn = dict_first (lspdb); dn; dn = dict_next (lspdb, dn))
+  for (lsp = lsp_db_first (lspdb); lsp; lsp = lsp_db_next (lsp))
     {
-      zlog_debug ("%s\t%pX", rawlspid_print ((u_char *) dnode_getkey (dn)),
-		  dnode_get (dn));
+      zlog_debug ("%s\t%pX", rawlspid_print (lsp->lsp_header->lsp_id),
+		  lsp);
     }
 #endif /* EXTREME DEBUG */
 
-  node = dict_lookup (lspdb, id);
-
-  if (node)
-    return (struct isis_lsp *) dnode_get (node);
-
-  return NULL;
+  key.db_key = lsp_id_key (id);
+  return hash_lookup (lspdb->index, &key);
 }
 
 static void
@@ -128,23 +284,12 @@ lsp_clear_data (struct isis_lsp *lsp)
 static void
 lsp_destroy (struct isis_lsp *lsp)
 {
-  struct listnode *cnode, *lnode, *lnnode;
-  struct isis_lsp *lsp_in_list;
-  struct isis_circuit *circuit;
-
   if (!lsp)
     return;
 
-  for (ALL_LIST_ELEMENTS_RO (lsp->area->circuit_list, cnode, circuit))
-    {
-      if (circuit->lsp_queue == NULL)
-        continue;
-      for (ALL_LIST_ELEMENTS (circuit->lsp_queue, lnode, lnnode, lsp_in_list))
-        if (lsp_in_list == lsp)
-          list_delete_node(circuit->lsp_queue, lnode);
-    }
-  ISIS_FLAGS_CLEAR_ALL (lsp->SSNflags);
-  ISIS_FLAGS_CLEAR_ALL (lsp->SRMflags);
+  /* off the flag and transmit queues of the circuits */
+  flags_clear_all_ssn (lsp);
+  flags_clear_all_srm (lsp);
 
   lsp_clear_data (lsp);
 
@@ -154,10 +299,7 @@ lsp_destroy (struct isis_lsp *lsp)
       lsp->lspu.frags = NULL;
     }
 
-  isis_spf_schedule (lsp->area, lsp->level);
-#ifdef HAVE_IPV6
-  isis_spf_schedule6 (lsp->area, lsp->level);
-#endif
+  isis_spf_schedule (lsp->area, lsp->level, lsp->lsp_header->lsp_id, 1);
 
   if (lsp->pdu)
     stream_free (lsp->pdu);
@@ -165,22 +307,20 @@ lsp_destroy (struct isis_lsp *lsp)
 }
 
 void
-lsp_db_destroy (dict_t * lspdb)
+lsp_db_destroy (struct isis_lspdb *lspdb)
 {
-  dnode_t *dnode, *next;
-  struct isis_lsp *lsp;
+  struct isis_lsp *lsp, *next;
 
-  dnode = dict_first (lspdb);
-  while (dnode)
+  for (lsp = lsp_db_first (lspdb); lsp; lsp = next)
     {
-      next = dict_next (lspdb, dnode);
-      lsp = dnode_get (dnode);
+      next = lsp_db_next (lsp);
+      lsp_db_remove (lspdb, lsp);
       lsp_destroy (lsp);
-      dict_delete_free (lspdb, dnode);
-      dnode = next;
     }
 
-  dict_free (lspdb);
+  hash_free (lspdb->index);
+  csnp_cache_free (lspdb);
+  XFREE (MTYPE_ISIS_LSPDB, lspdb);
 
   return;
 }
@@ -189,17 +329,15 @@ lsp_db_destroy (dict_t * lspdb)
  * Remove all the frags belonging to the given lsp
  */
 static void
-lsp_remove_frags (struct list *frags, dict_t * lspdb)
+lsp_remove_frags (struct list *frags, struct isis_lspdb *lspdb)
 {
-  dnode_t *dnode;
   struct listnode *lnode, *lnnode;
   struct isis_lsp *lsp;
 
   for (ALL_LIST_ELEMENTS (frags, lnode, lnnode, lsp))
     {
-      dnode = dict_lookup (lspdb, lsp->lsp_header->lsp_id);
+      lsp_db_remove (lspdb, lsp);
       lsp_destroy (lsp);
-      dnode_destroy (dict_delete (lspdb, dnode));
     }
 
   list_delete_all_node (frags);
@@ -208,16 +346,14 @@ lsp_remove_frags (struct list *frags, dict_t * lspdb)
 }
 
 void
-lsp_search_and_destroy (u_char * id, dict_t * lspdb)
+lsp_search_and_destroy (u_char * id, struct isis_lspdb *lspdb)
 {
-  dnode_t *node;
   struct isis_lsp *lsp;
 
-  node = dict_lookup (lspdb, id);
-  if (node)
+  lsp = lsp_search (id, lspdb);
+  if (lsp)
     {
-      node = dict_delete (lspdb, node);
-      lsp = dnode_get (node);
+      lsp_db_remove (lspdb, lsp);
       /*
        * If this is a zero lsp, remove all the frags now 
        */
@@ -235,7 +371,6 @@ lsp_search_and_destroy (u_char * id, dict_t * lspdb)
 	    listnode_delete (lsp->lspu.zero_lsp->lspu.frags, lsp);
 	}
       lsp_destroy (lsp);
-      dnode_destroy (node);
     }
 }
 
@@ -412,11 +547,9 @@ lsp_inc_seqnum (struct isis_lsp *lsp, u_int32_t seq_num)
    */
   fletcher_checksum(STREAM_DATA (lsp->pdu) + 12,
                     ntohs (lsp->lsp_header->pdu_len) - 12, 12);
+  lsp_db_changed (lsp);
 
-  isis_spf_schedule (lsp->area, lsp->level);
-#ifdef HAVE_IPV6
-  isis_spf_schedule6 (lsp->area, lsp->level);
-#endif
+  isis_spf_schedule (lsp->area, lsp->level, lsp->lsp_header->lsp_id, 1);
 
   return;
 }
@@ -482,23 +615,17 @@ lsp_update_data (struct isis_lsp *lsp, struct stream *stream,
    */
   expected |= TLVFLAG_AUTH_INFO;
   expected |= TLVFLAG_AREA_ADDRS;
-  expected |= TLVFLAG_IS_NEIGHS;
   expected |= TLVFLAG_NLPID;
   if (area->dynhostname)
     expected |= TLVFLAG_DYN_HOSTNAME;
   if (area->newmetric)
-    {
-      expected |= TLVFLAG_TE_IS_NEIGHS;
-      expected |= TLVFLAG_TE_IPV4_REACHABILITY;
-      expected |= TLVFLAG_TE_ROUTER_ID;
-    }
+    expected |= TLVFLAG_TE_ROUTER_ID;
   expected |= TLVFLAG_IPV4_ADDR;
-  expected |= TLVFLAG_IPV4_INT_REACHABILITY;
-  expected |= TLVFLAG_IPV4_EXT_REACHABILITY;
 #ifdef HAVE_IPV6
   expected |= TLVFLAG_IPV6_ADDR;
-  expected |= TLVFLAG_IPV6_REACHABILITY;
 #endif /* HAVE_IPV6 */
+  /* Neighbors and reachability are not listed: SPF and the show
+   * commands walk them in the PDU with lsp_tlv_first() */
 
   retval = parse_tlvs (area->area_tag, STREAM_DATA (lsp->pdu) +
                        ISIS_FIXED_HDR_LEN + ISIS_LSP_HDR_LEN,
@@ -522,24 +649,96 @@ lsp_update_data (struct isis_lsp *lsp, struct stream *stream,
   return;
 }
 
+/*
+ * First entry of the TLVs of the given type in an LSP PDU, walked in
+ * place with tlv_iter_next()
+ */
+void *
+lsp_tlv_first (struct tlv_iter *iter, struct stream *pdu, u_char type)
+{
+  size_t hdr_len = ISIS_FIXED_HDR_LEN + ISIS_LSP_HDR_LEN;
+  size_t endp = stream_get_endp (pdu);
+
+  return tlv_iter_first (iter, STREAM_DATA (pdu) + hdr_len,
+			 endp > hdr_len ? endp - hdr_len : 0, type);
+}
+
+/*
+ * Whether two LSP PDUs carry the same neighbor TLV entries of a type,
+ * comparing the first len bytes of each entry
+ */
+static int
+lsp_same_neighs (struct stream *a, struct stream *b, u_char type,
+		 size_t len)
+{
+  struct tlv_iter ia, ib;
+  u_char *ea, *eb;
+
+  for (ea = lsp_tlv_first (&ia, a, type), eb = lsp_tlv_first (&ib, b, type);
+       ea && eb; ea = tlv_iter_next (&ia), eb = tlv_iter_next (&ib))
+    if (memcmp (ea, eb, len))
+      return 0;
+  return ea == NULL && eb == NULL;
+}
+
 void
 lsp_update (struct isis_lsp *lsp, struct stream *stream,
             struct isis_area *area, int level)
 {
-  dnode_t *dnode = NULL;
+  struct isis_lsp *found;
+  struct stream *old_pdu;
+  struct nlpids nlpids, *old_nlpids;
+  u_char old_bits;
+  int was_live, prc;
 
   /* Remove old LSP from database. This is required since the
    * lsp_update_data will free the lsp->pdu (which has the key, lsp_id)
    * and will update it with the new data in the stream. */
-  dnode = dict_lookup (area->lspdb[level - 1], lsp->lsp_header->lsp_id);
-  if (dnode)
-    dnode_destroy (dict_delete (area->lspdb[level - 1], dnode));
+  found = lsp_search (lsp->lsp_header->lsp_id, area->lspdb[level - 1]);
+  was_live = (found && lsp->lsp_header->seq_num != 0
+	      && lsp->lsp_header->rem_lifetime != 0);
+  if (found)
+    lsp_db_remove (area->lspdb[level - 1], found);
+
+  /* Keep what SPF depends on, and the PDU the neighbors are read from,
+   * to tell whether only prefixes changed */
+  old_nlpids = NULL;
+  if (lsp->tlv_data.nlpids)
+    {
+      nlpids = *lsp->tlv_data.nlpids;
+      old_nlpids = &nlpids;
+    }
+  old_bits = lsp->lsp_header->lsp_bits;
+  old_pdu = lsp->pdu;
+  lsp->pdu = NULL;
 
   /* rebuild the lsp data */
   lsp_update_data (lsp, stream, area, level);
 
+  prc = (was_live
+	 && lsp->lsp_header->seq_num != 0
+	 && lsp->lsp_header->rem_lifetime != 0
+	 && lsp->lsp_header->lsp_bits == old_bits
+	 && old_nlpids && lsp->tlv_data.nlpids
+	 && old_nlpids->count == lsp->tlv_data.nlpids->count
+	 && !memcmp (old_nlpids->nlpids, lsp->tlv_data.nlpids->nlpids,
+		     old_nlpids->count)
+	 && old_pdu
+	 && lsp_same_neighs (old_pdu, lsp->pdu, IS_NEIGHBOURS,
+			     sizeof (struct is_neigh))
+	 && lsp_same_neighs (old_pdu, lsp->pdu, TE_IS_NEIGHBOURS,
+			     offsetof (struct te_is_neigh, sub_tlvs_length)));
+  if (old_pdu)
+    stream_free (old_pdu);
+
   /* insert the lsp back into the database */
-  lsp_insert (lsp, area->lspdb[level - 1]);
+  if (prc)
+    {
+      lsp_db_add (area->lspdb[level - 1], lsp);
+      isis_spf_schedule (area, level, lsp->lsp_header->lsp_id, 0);
+    }
+  else
+    lsp_insert (lsp, area->lspdb[level - 1]);
 }
 
 /* creation of LSP directly from what we received */
@@ -621,15 +820,12 @@ lsp_new (u_char * lsp_id, u_int16_t rem_lifetime, u_int32_t seq_num,
 }
 
 void
-lsp_insert (struct isis_lsp *lsp, dict_t * lspdb)
+lsp_insert (struct isis_lsp *lsp, struct isis_lspdb *lspdb)
 {
-  dict_alloc_insert (lspdb, lsp->lsp_header->lsp_id, lsp);
+  lsp_db_add (lspdb, lsp);
   if (lsp->lsp_header->seq_num != 0)
     {
-      isis_spf_schedule (lsp->area, lsp->level);
-#ifdef HAVE_IPV6
-      isis_spf_schedule6 (lsp->area, lsp->level);
-#endif
+      isis_spf_schedule (lsp->area, lsp->level, lsp->lsp_header->lsp_id, 1);
     }
 }
 
@@ -638,30 +834,15 @@ lsp_insert (struct isis_lsp *lsp, dict_t * lspdb)
  */
 void
 lsp_build_list_nonzero_ht (u_char * start_id, u_char * stop_id,
-			   struct list *list, dict_t * lspdb)
+			   struct list *list, struct isis_lspdb *lspdb)
 {
-  dnode_t *first, *last, *curr;
-
-  first = dict_lower_bound (lspdb, start_id);
-  if (!first)
-    return;
-
-  last = dict_upper_bound (lspdb, stop_id);
-
-  curr = first;
-
-  if (((struct isis_lsp *) (curr->dict_data))->lsp_header->rem_lifetime)
-    listnode_add (list, first->dict_data);
+  struct isis_lsp *lsp;
+  u_int64_t stop = lsp_id_key (stop_id);
 
-  while (curr)
-    {
-      curr = dict_next (lspdb, curr);
-      if (curr &&
-	  ((struct isis_lsp *) (curr->dict_data))->lsp_header->rem_lifetime)
-	listnode_add (list, curr->dict_data);
-      if (curr == last)
-	break;
-    }
+  for (lsp = lsp_db_lower_bound (lspdb, lsp_id_key (start_id), NULL);
+       lsp && lsp->db_key <= stop; lsp = lsp_db_next (lsp))
+    if (lsp->lsp_header->rem_lifetime)
+      listnode_add (list, lsp);
 
   return;
 }
@@ -671,32 +852,18 @@ lsp_build_list_nonzero_ht (u_char * start_id, u_char * stop_id,
  */
 void
 lsp_build_list (u_char * start_id, u_char * stop_id, u_char num_lsps,
-		struct list *list, dict_t * lspdb)
+		struct list *list, struct isis_lspdb *lspdb)
 {
-  u_char count;
-  dnode_t *first, *last, *curr;
-
-  first = dict_lower_bound (lspdb, start_id);
-  if (!first)
-    return;
-
-  last = dict_upper_bound (lspdb, stop_id);
-
-  curr = first;
-
-  listnode_add (list, first->dict_data);
-  count = 1;
+  struct isis_lsp *lsp;
+  u_int64_t stop = lsp_id_key (stop_id);
+  u_char count = 0;
 
-  while (curr)
+  for (lsp = lsp_db_lower_bound (lspdb, lsp_id_key (start_id), NULL);
+       lsp && lsp->db_key <= stop && count < num_lsps;
+       lsp = lsp_db_next (lsp))
     {
-      curr = dict_next (lspdb, curr);
-      if (curr)
-        {
-          listnode_add (list, curr->dict_data);
-          count++;
-        }
-      if (count == num_lsps || curr == last)
-        break;
+      listnode_add (list, lsp);
+      count++;
     }
 
   return;
@@ -706,26 +873,20 @@ lsp_build_list (u_char * start_id, u_char * stop_id, u_char num_lsps,
  * Build a list of LSPs with SSN flag set for the given circuit
  */
 void
-lsp_build_list_ssn (struct isis_circuit *circuit, u_char num_lsps,
-                    struct list *list, dict_t * lspdb)
+lsp_build_list_ssn (struct isis_circuit *circuit, int level, u_char num_lsps,
+                    struct list *list)
 {
-  dnode_t *dnode, *next;
-  struct isis_lsp *lsp;
+  struct flags_entry *entry;
   u_char count = 0;
 
-  dnode = dict_first (lspdb);
-  while (dnode != NULL)
+  for (entry = circuit->ssn_queue->head; entry && count < num_lsps;
+       entry = entry->next)
     {
-      next = dict_next (lspdb, dnode);
-      lsp = dnode_get (dnode);
-      if (ISIS_CHECK_FLAG (lsp->SSNflags, circuit))
+      if (entry->lsp->level == level)
         {
-          listnode_add (list, lsp);
+          listnode_add (list, entry->lsp);
           ++count;
         }
-      if (count == num_lsps)
-        break;
-      dnode = next;
     }
 
   return;
@@ -824,6 +985,7 @@ lsp_print_detail (struct isis_lsp *lsp, struct vty *vty, char dynhost)
   struct area_addr *area_addr;
   int i;
   struct listnode *lnode;
+  struct tlv_iter iter;
   struct is_neigh *is_neigh;
   struct te_is_neigh *te_is_neigh;
   struct ipv4_reachability *ipv4_reach;
@@ -905,8 +1067,8 @@ lsp_print_detail (struct isis_lsp *lsp, struct vty *vty, char dynhost)
       }
 
   /* for the IS neighbor tlv */
-  if (lsp->tlv_data.is_neighs)
-    for (ALL_LIST_ELEMENTS_RO (lsp->tlv_data.is_neighs, lnode, is_neigh))
+  for (is_neigh = lsp_tlv_first (&iter, lsp->pdu, IS_NEIGHBOURS); is_neigh;
+       is_neigh = tlv_iter_next (&iter))
       {
 	lspid_print (is_neigh->neigh_id, LSPid, dynhost, 0);
 	vty_out (vty, "  Metric      : %-8d IS            : %s%s",
@@ -914,9 +1076,8 @@ lsp_print_detail (struct isis_lsp *lsp, struct vty *vty, char dynhost)
       }
   
   /* for the internal reachable tlv */
-  if (lsp->tlv_data.ipv4_int_reachs)
-    for (ALL_LIST_ELEMENTS_RO (lsp->tlv_data.ipv4_int_reachs, lnode,
-			       ipv4_reach))
+  for (ipv4_reach = lsp_tlv_first (&iter, lsp->pdu, IPV4_INT_REACHABILITY);
+       ipv4_reach; ipv4_reach = tlv_iter_next (&iter))
     {
       memcpy (ipv4_reach_prefix, inet_ntoa (ipv4_reach->prefix),
 	      sizeof (ipv4_reach_prefix));
@@ -928,9 +1089,8 @@ lsp_print_detail (struct isis_lsp *lsp, struct vty *vty, char dynhost)
     }
 
   /* for the external reachable tlv */
-  if (lsp->tlv_data.ipv4_ext_reachs)
-    for (ALL_LIST_ELEMENTS_RO (lsp->tlv_data.ipv4_ext_reachs, lnode, 
-			       ipv4_reach))
+  for (ipv4_reach = lsp_tlv_first (&iter, lsp->pdu, IPV4_EXT_REACHABILITY);
+       ipv4_reach; ipv4_reach = tlv_iter_next (&iter))
     {
       memcpy (ipv4_reach_prefix, inet_ntoa (ipv4_reach->prefix),
 	      sizeof (ipv4_reach_prefix));
@@ -943,8 +1103,8 @@ lsp_print_detail (struct isis_lsp *lsp, struct vty *vty, char dynhost)
   
   /* IPv6 tlv */
 #ifdef HAVE_IPV6
-  if (lsp->tlv_data.ipv6_reachs)
-    for (ALL_LIST_ELEMENTS_RO (lsp->tlv_data.ipv6_reachs, lnode, ipv6_reach))
+  for (ipv6_reach = lsp_tlv_first (&iter, lsp->pdu, IPV6_REACHABILITY);
+       ipv6_reach; ipv6_reach = tlv_iter_next (&iter))
     {
       memset (&in6, 0, sizeof (in6));
       memcpy (in6.s6_addr, ipv6_reach->prefix,
@@ -963,8 +1123,8 @@ lsp_print_detail (struct isis_lsp *lsp, struct vty *vty, char dynhost)
 #endif
 
   /* TE IS neighbor tlv */
-  if (lsp->tlv_data.te_is_neighs)
-    for (ALL_LIST_ELEMENTS_RO (lsp->tlv_data.te_is_neighs, lnode, te_is_neigh))
+  for (te_is_neigh = lsp_tlv_first (&iter, lsp->pdu, TE_IS_NEIGHBOURS);
+       te_is_neigh; te_is_neigh = tlv_iter_next (&iter))
     {
       lspid_print (te_is_neigh->neigh_id, LSPid, dynhost, 0);
       vty_out (vty, "  Metric      : %-8d IS-Extended   : %s%s",
@@ -972,9 +1132,8 @@ lsp_print_detail (struct isis_lsp *lsp, struct vty *vty, char dynhost)
     }
 
   /* TE IPv4 tlv */
-  if (lsp->tlv_data.te_ipv4_reachs)
-    for (ALL_LIST_ELEMENTS_RO (lsp->tlv_data.te_ipv4_reachs, lnode,
-			       te_ipv4_reach))
+  for (te_ipv4_reach = lsp_tlv_first (&iter, lsp->pdu, TE_IPV4_REACHABILITY);
+       te_ipv4_reach; te_ipv4_reach = tlv_iter_next (&iter))
     {
       /* FIXME: There should be better way to output this stuff. */
       vty_out (vty, "  Metric      : %-8d IPv4-Extended : %s/%d%s",
@@ -990,33 +1149,21 @@ lsp_print_detail (struct isis_lsp *lsp, struct vty *vty, char dynhost)
 
 /* print all the lsps info in the local lspdb */
 int
-lsp_print_all (struct vty *vty, dict_t * lspdb, char detail, char dynhost)
+lsp_print_all (struct vty *vty, struct isis_lspdb *lspdb, char detail,
+               char dynhost)
 {
-
-  dnode_t *node = dict_first (lspdb), *next;
+  struct isis_lsp *lsp;
   int lsp_count = 0;
 
-  if (detail == ISIS_UI_LEVEL_BRIEF)
+  for (lsp = lsp_db_first (lspdb); lsp; lsp = lsp_db_next (lsp))
     {
-      while (node != NULL)
-	{
-	  /* I think it is unnecessary, so I comment it out */
-	  /* dict_contains (lspdb, node); */
-	  next = dict_next (lspdb, node);
-	  lsp_print (dnode_get (node), vty, dynhost);
-	  node = next;
-	  lsp_count++;
-	}
-    }
-  else if (detail == ISIS_UI_LEVEL_DETAIL)
-    {
-      while (node != NULL)
-	{
-	  next = dict_next (lspdb, node);
-	  lsp_print_detail (dnode_get (node), vty, dynhost);
-	  node = next;
-	  lsp_count++;
-	}
+      if (detail == ISIS_UI_LEVEL_BRIEF)
+        lsp_print (lsp, vty, dynhost);
+      else if (detail == ISIS_UI_LEVEL_DETAIL)
+        lsp_print_detail (lsp, vty, dynhost);
+      else
+        continue;
+      lsp_count++;
     }
 
   return lsp_count;
@@ -1118,8 +1265,8 @@ lsp_refresh_time (struct isis_lsp *lsp, u_int16_t rem_lifetime)
 }
 
 static struct isis_lsp *
-lsp_next_frag (u_char frag_num, struct isis_lsp *lsp0, struct isis_area *area,
-	       int level)
+lsp_frag (u_char frag_num, struct isis_lsp *lsp0, struct isis_area *area,
+	  int level, int clear)
 {
   struct isis_lsp *lsp;
   u_char frag_id[ISIS_SYS_ID_LEN + 2];
@@ -1131,7 +1278,8 @@ lsp_next_frag (u_char frag_num, struct isis_lsp *lsp0, struct isis_area *area,
   if (lsp)
     {
       /* Clear the TLVs */
-      lsp_clear_data (lsp);
+      if (clear)
+        lsp_clear_data (lsp);
       return lsp;
     }
   lsp = lsp_new (frag_id, ntohs(lsp0->lsp_header->rem_lifetime), 0,
@@ -1144,6 +1292,293 @@ lsp_next_frag (u_char frag_num, struct isis_lsp *lsp0, struct isis_area *area,
   return lsp;
 }
 
+#ifdef TOPOLOGY_GENERATE
+static struct isis_lsp *
+lsp_next_frag (u_char frag_num, struct isis_lsp *lsp0, struct isis_area *area,
+	       int level)
+{
+  return lsp_frag (frag_num, lsp0, area, level, 1);
+}
+#endif /* TOPOLOGY_GENERATE */
+
+/* Empty a fragment of our own LSP, down to its header. */
+static void
+lsp_reset_frag (struct isis_lsp *lsp)
+{
+  lsp_clear_data (lsp);
+  stream_reset (lsp->pdu);
+  stream_forward_endp (lsp->pdu, ISIS_FIXED_HDR_LEN + ISIS_LSP_HDR_LEN);
+  lsp->lsp_header->pdu_len = htons (stream_get_endp (lsp->pdu));
+}
+
+/*
+ * The entries that lsp_build() spreads over the fragments of our LSP, in
+ * the order they are written into each fragment.  An entry is known by
+ * its key, the part of it that does not change with its metric, so that
+ * it goes back to the fragment that carried it before.  A change then
+ * rewrites only the fragments whose entries changed.
+ */
+struct lsp_tlv_kind
+{
+  size_t list;				/* offset of its list in struct tlvs */
+  int tlvsize;
+  int (*build) (struct list *, struct stream *);
+  int (*key) (void *, u_char **);
+};
+
+static int
+lsp_ipv4_reach_key (void *entry, u_char **key)
+{
+  struct ipv4_reachability *ipreach = entry;
+
+  *key = (u_char *) &ipreach->prefix;
+  return 2 * sizeof (struct in_addr);
+}
+
+static int
+lsp_te_ipv4_reach_key (void *entry, u_char **key)
+{
+  struct te_ipv4_reachability *te_ipreach = entry;
+
+  *key = &te_ipreach->control;
+  return 1 + ((te_ipreach->control & 0x3F) + 7) / 8;
+}
+
+#ifdef HAVE_IPV6
+static int
+lsp_ipv6_reach_key (void *entry, u_char **key)
+{
+  struct ipv6_reachability *ip6reach = entry;
+
+  *key = &ip6reach->prefix_len;
+  return 1 + sizeof (ip6reach->prefix);
+}
+#endif /* HAVE_IPV6 */
+
+static int
+lsp_is_neigh_key (void *entry, u_char **key)
+{
+  *key = ((struct is_neigh *) entry)->neigh_id;
+  return ISIS_SYS_ID_LEN + 1;
+}
+
+static int
+lsp_te_is_neigh_key (void *entry, u_char **key)
+{
+  *key = ((struct te_is_neigh *) entry)->neigh_id;
+  return ISIS_SYS_ID_LEN + 1;
+}
+
+/* FIXME: We pass maximum te_ipv4_reachability length to the lsp_tlv_fit()
+ * for now. lsp_tlv_fit() needs to be fixed to deal with variable length
+ * TLVs (sub TLVs!). */
+static const struct lsp_tlv_kind lsp_tlv_kinds[] =
+{
+  { offsetof (struct tlvs, ipv4_int_reachs), IPV4_REACH_LEN,
+    tlv_add_ipv4_reachs, lsp_ipv4_reach_key },
+  { offsetof (struct tlvs, te_ipv4_reachs), TE_IPV4_REACH_LEN,
+    tlv_add_te_ipv4_reachs, lsp_te_ipv4_reach_key },
+#ifdef HAVE_IPV6
+  { offsetof (struct tlvs, ipv6_reachs), IPV6_REACH_LEN,
+    tlv_add_ipv6_reachs, lsp_ipv6_reach_key },
+#endif /* HAVE_IPV6 */
+  { offsetof (struct tlvs, is_neighs), IS_NEIGHBOURS_LEN,
+    tlv_add_is_neighs, lsp_is_neigh_key },
+  { offsetof (struct tlvs, te_is_neighs), IS_NEIGHBOURS_LEN,
+    tlv_add_te_is_neighs, lsp_te_is_neigh_key },
+};
+#define LSP_TLV_KINDS (sizeof (lsp_tlv_kinds) / sizeof (lsp_tlv_kinds[0]))
+
+#define LSP_TLV_LIST(T, K) \
+  ((struct list **) ((char *) (T) + lsp_tlv_kinds[K].list))
+
+/* Fragment that carried an entry in the previous build */
+struct lsp_tlv_home
+{
+  u_char kind;
+  u_char frag;
+  u_char keylen;
+  u_char key[1 + 16];
+};
+
+static unsigned int
+lsp_tlv_home_key (void *arg)
+{
+  struct lsp_tlv_home *home = arg;
+
+  return jhash (home->key, home->keylen, home->kind);
+}
+
+static int
+lsp_tlv_home_cmp (const void *arg1, const void *arg2)
+{
+  const struct lsp_tlv_home *home1 = arg1;
+  const struct lsp_tlv_home *home2 = arg2;
+
+  return (home1->kind == home2->kind && home1->keylen == home2->keylen
+	  && !memcmp (home1->key, home2->key, home1->keylen));
+}
+
+static void
+lsp_tlv_home_free (void *arg)
+{
+  XFREE (MTYPE_ISIS_TMP, arg);
+}
+
+static void
+lsp_tlv_home_key_set (struct lsp_tlv_home *home, int kind, void *entry)
+{
+  u_char *key;
+
+  home->kind = kind;
+  home->keylen = lsp_tlv_kinds[kind].key (entry, &key);
+  assert (home->keylen <= sizeof (home->key));
+  memcpy (home->key, key, home->keylen);
+}
+
+/* Record where the entries of one fragment are, before it is rebuilt. */
+static void
+lsp_tlv_homes_add (struct hash *homes, struct isis_lsp *lsp)
+{
+  struct lsp_tlv_home *home, *found;
+  struct listnode *node;
+  struct list *list;
+  void *entry;
+  unsigned int kind;
+
+  for (kind = 0; kind < LSP_TLV_KINDS; kind++)
+    {
+      list = *LSP_TLV_LIST (&lsp->tlv_data, kind);
+      if (list == NULL)
+	continue;
+      for (ALL_LIST_ELEMENTS_RO (list, node, entry))
+	{
+	  home = XMALLOC (MTYPE_ISIS_TMP, sizeof (struct lsp_tlv_home));
+	  lsp_tlv_home_key_set (home, kind, entry);
+	  home->frag = LSP_FRAGMENT (lsp->lsp_header->lsp_id);
+	  found = hash_get (homes, home, hash_alloc_intern);
+	  if (found != home)
+	    XFREE (MTYPE_ISIS_TMP, home);
+	}
+    }
+}
+
+/* Write as many entries of *from as fit into lsp, and move them onto
+ * its tlv_data. */
+static void
+lsp_tlv_place (struct isis_lsp *lsp, int kind, struct list **from,
+	       int frag_thold)
+{
+  struct list **to = LSP_TLV_LIST (&lsp->tlv_data, kind);
+  struct list *fit;
+  struct listnode *node;
+  void *entry;
+
+  fit = list_new ();
+  lsp_tlv_fit (lsp, from, &fit, lsp_tlv_kinds[kind].tlvsize, frag_thold,
+	       lsp_tlv_kinds[kind].build);
+  if (*to == NULL)
+    {
+      *to = list_new ();
+      (*to)->del = free_tlv;
+    }
+  for (ALL_LIST_ELEMENTS_RO (fit, node, entry))
+    listnode_add (*to, entry);
+  fit->del = NULL;
+  list_delete (fit);
+}
+
+/*
+ * Spread the entries of tlv_data over lsp0 and its fragments, which have
+ * been emptied.  Each entry first goes back to the fragment named in
+ * homes.  Entries without a home, or that no longer fit there, then fill
+ * the fragments in order, new fragments last.
+ */
+static void
+lsp_tlv_spread (struct isis_lsp *lsp0, struct tlvs *tlv_data,
+		struct hash *homes, struct isis_area *area, int level)
+{
+  struct list *pending[LSP_TLV_KINDS];
+  struct list **placed;
+  struct list *list;
+  struct listnode *node;
+  struct lsp_tlv_home key, *home;
+  struct isis_lsp *lsp;
+  void *entry;
+  unsigned int kind;
+  int frag, nfrags;
+
+  nfrags = 1;
+  for (ALL_LIST_ELEMENTS_RO (lsp0->lspu.frags, node, lsp))
+    if (LSP_FRAGMENT (lsp->lsp_header->lsp_id) >= nfrags)
+      nfrags = LSP_FRAGMENT (lsp->lsp_header->lsp_id) + 1;
+
+  placed = XCALLOC (MTYPE_ISIS_TMP,
+		    nfrags * LSP_TLV_KINDS * sizeof (struct list *));
+  for (kind = 0; kind < LSP_TLV_KINDS; kind++)
+    {
+      pending[kind] = list_new ();
+      pending[kind]->del = free_tlv;
+      list = *LSP_TLV_LIST (tlv_data, kind);
+      if (list == NULL)
+	continue;
+      for (ALL_LIST_ELEMENTS_RO (list, node, entry))
+	{
+	  lsp_tlv_home_key_set (&key, kind, entry);
+	  home = hash_lookup (homes, &key);
+	  if (home == NULL || home->frag >= nfrags)
+	    {
+	      listnode_add (pending[kind], entry);
+	      continue;
+	    }
+	  if (placed[home->frag * LSP_TLV_KINDS + kind] == NULL)
+	    {
+	      placed[home->frag * LSP_TLV_KINDS + kind] = list_new ();
+	      placed[home->frag * LSP_TLV_KINDS + kind]->del = free_tlv;
+	    }
+	  listnode_add (placed[home->frag * LSP_TLV_KINDS + kind], entry);
+	}
+      /* the entries now belong to pending and placed */
+      list->del = NULL;
+      list_delete (list);
+      *LSP_TLV_LIST (tlv_data, kind) = NULL;
+    }
+
+  for (frag = 0; frag < nfrags; frag++)
+    {
+      lsp = frag ? lsp_frag (frag, lsp0, area, level, 0) : lsp0;
+      for (kind = 0; kind < LSP_TLV_KINDS; kind++)
+	{
+	  list = placed[frag * LSP_TLV_KINDS + kind];
+	  if (list == NULL)
+	    continue;
+	  lsp_tlv_place (lsp, kind, &list, area->lsp_frag_threshold);
+	  if (list)
+	    {
+	      for (ALL_LIST_ELEMENTS_RO (list, node, entry))
+		listnode_add (pending[kind], entry);
+	      list->del = NULL;
+	      list_delete (list);
+	    }
+	}
+    }
+  XFREE (MTYPE_ISIS_TMP, placed);
+
+  for (kind = 0; kind < LSP_TLV_KINDS; kind++)
+    {
+      frag = 0;
+      lsp = lsp0;
+      while (pending[kind] && listcount (pending[kind]))
+	{
+	  lsp_tlv_place (lsp, kind, &pending[kind], area->lsp_frag_threshold);
+	  if (pending[kind] && listcount (pending[kind]))
+	    lsp = lsp_frag (++frag, lsp0, area, level, 0);
+	}
+      if (pending[kind])
+	list_delete (pending[kind]);
+    }
+}
+
 /*
  * Builds the LSP data part. This func creates a new frag whenever 
  * area->lsp_frag_threshold is exceeded.
@@ -1165,7 +1600,8 @@ lsp_build (struct isis_lsp *lsp, struct isis_area *area)
   struct ipv6_reachability *ip6reach;
 #endif /* HAVE_IPV6 */
   struct tlvs tlv_data;
-  struct isis_lsp *lsp0 = lsp;
+  struct isis_lsp *lsp0 = lsp, *frag;
+  struct hash *homes;
   struct in_addr *routerid;
   uint32_t expected = 0, found = 0;
   uint32_t metric;
@@ -1173,15 +1609,24 @@ lsp_build (struct isis_lsp *lsp, struct isis_area *area)
   int retval = ISIS_OK;
 
   /*
-   * Building the zero lsp
+   * Remember which fragment carried each entry, then empty them all
    */
-  memset (zero_id, 0, ISIS_SYS_ID_LEN + 1);
+  homes = hash_create (lsp_tlv_home_key, lsp_tlv_home_cmp);
+  lsp_tlv_homes_add (homes, lsp0);
+  for (ALL_LIST_ELEMENTS_RO (lsp0->lspu.frags, node, frag))
+    lsp_tlv_homes_add (homes, frag);
 
   /* Reset stream endp. Stream is always there and on every LSP refresh only
    * TLV part of it is overwritten. So we must seek past header we will not
    * touch. */
-  stream_reset (lsp->pdu);
-  stream_forward_endp (lsp->pdu, ISIS_FIXED_HDR_LEN + ISIS_LSP_HDR_LEN);
+  lsp_reset_frag (lsp0);
+  for (ALL_LIST_ELEMENTS_RO (lsp0->lspu.frags, node, frag))
+    lsp_reset_frag (frag);
+
+  /*
+   * Building the zero lsp
+   */
+  memset (zero_id, 0, ISIS_SYS_ID_LEN + 1);
 
   /*
    * Add the authentication info if its present
@@ -1478,74 +1923,10 @@ lsp_build (struct isis_lsp *lsp, struct isis_area *area)
 	}
     }
 
-  while (tlv_data.ipv4_int_reachs && listcount (tlv_data.ipv4_int_reachs))
-    {
-      if (lsp->tlv_data.ipv4_int_reachs == NULL)
-	lsp->tlv_data.ipv4_int_reachs = list_new ();
-      lsp_tlv_fit (lsp, &tlv_data.ipv4_int_reachs,
-		   &lsp->tlv_data.ipv4_int_reachs,
-		   IPV4_REACH_LEN, area->lsp_frag_threshold,
-		   tlv_add_ipv4_reachs);
-      if (tlv_data.ipv4_int_reachs && listcount (tlv_data.ipv4_int_reachs))
-	lsp = lsp_next_frag (LSP_FRAGMENT (lsp->lsp_header->lsp_id) + 1,
-			     lsp0, area, level);
-    }
-
-  /* FIXME: We pass maximum te_ipv4_reachability length to the lsp_tlv_fit()
-   * for now. lsp_tlv_fit() needs to be fixed to deal with variable length
-   * TLVs (sub TLVs!). */
-  while (tlv_data.te_ipv4_reachs && listcount (tlv_data.te_ipv4_reachs))
-    {
-      if (lsp->tlv_data.te_ipv4_reachs == NULL)
-	lsp->tlv_data.te_ipv4_reachs = list_new ();
-      lsp_tlv_fit (lsp, &tlv_data.te_ipv4_reachs,
-		   &lsp->tlv_data.te_ipv4_reachs,
-		   TE_IPV4_REACH_LEN, area->lsp_frag_threshold,
-		   tlv_add_te_ipv4_reachs);
-      if (tlv_data.te_ipv4_reachs && listcount (tlv_data.te_ipv4_reachs))
-	lsp = lsp_next_frag (LSP_FRAGMENT (lsp->lsp_header->lsp_id) + 1,
-			     lsp0, area, level);
-    }
-
-#ifdef  HAVE_IPV6
-  while (tlv_data.ipv6_reachs && listcount (tlv_data.ipv6_reachs))
-    {
-      if (lsp->tlv_data.ipv6_reachs == NULL)
-	lsp->tlv_data.ipv6_reachs = list_new ();
-      lsp_tlv_fit (lsp, &tlv_data.ipv6_reachs,
-		   &lsp->tlv_data.ipv6_reachs,
-		   IPV6_REACH_LEN, area->lsp_frag_threshold,
-		   tlv_add_ipv6_reachs);
-      if (tlv_data.ipv6_reachs && listcount (tlv_data.ipv6_reachs))
-	lsp = lsp_next_frag (LSP_FRAGMENT (lsp->lsp_header->lsp_id) + 1,
-			     lsp0, area, level);
-    }
-#endif /* HAVE_IPV6 */
-
-  while (tlv_data.is_neighs && listcount (tlv_data.is_neighs))
-    {
-      if (lsp->tlv_data.is_neighs == NULL)
-	lsp->tlv_data.is_neighs = list_new ();
-      lsp_tlv_fit (lsp, &tlv_data.is_neighs,
-		   &lsp->tlv_data.is_neighs,
-		   IS_NEIGHBOURS_LEN, area->lsp_frag_threshold,
-		   tlv_add_is_neighs);
-      if (tlv_data.is_neighs && listcount (tlv_data.is_neighs))
-	lsp = lsp_next_frag (LSP_FRAGMENT (lsp->lsp_header->lsp_id) + 1,
-			     lsp0, area, level);
-    }
+  lsp_tlv_spread (lsp0, &tlv_data, homes, area, level);
+  hash_clean (homes, lsp_tlv_home_free);
+  hash_free (homes);
 
-  while (tlv_data.te_is_neighs && listcount (tlv_data.te_is_neighs))
-    {
-      if (lsp->tlv_data.te_is_neighs == NULL)
-	lsp->tlv_data.te_is_neighs = list_new ();
-      lsp_tlv_fit (lsp, &tlv_data.te_is_neighs, &lsp->tlv_data.te_is_neighs,
-		   IS_NEIGHBOURS_LEN, area->lsp_frag_threshold,
-		   tlv_add_te_is_neighs);
-      if (tlv_data.te_is_neighs && listcount (tlv_data.te_is_neighs))
-	lsp = lsp_next_frag (LSP_FRAGMENT (lsp->lsp_header->lsp_id) + 1,
-			     lsp0, area, level);
-    }
   lsp->lsp_header->pdu_len = htons (stream_get_endp (lsp->pdu));
 
   free_tlvs (&tlv_data);
@@ -1601,6 +1982,7 @@ lsp_generate (struct isis_area *area, int level)
   lsp_set_all_srmflags (newlsp);
 
   refresh_time = lsp_refresh_time (newlsp, rem_lifetime);
+  area->lsp_refresh_due[level - 1] = time (NULL) + refresh_time;
   THREAD_TIMER_OFF (area->t_lsp_refresh[level - 1]);
   if (level == IS_LEVEL_1)
     THREAD_TIMER_ON (master, area->t_lsp_refresh[level - 1],
@@ -1625,17 +2007,49 @@ lsp_generate (struct isis_area *area, int level)
   return ISIS_OK;
 }
 
+/* Whether a rebuilt fragment is the same as its copy old from before
+ * the rebuild.  The header still holds the old sequence number and
+ * checksum, so an HMAC over the new data must come out the same too. */
+static int
+lsp_frag_same (struct isis_lsp *lsp, struct stream *old)
+{
+  if (old == NULL || stream_get_endp (old) != stream_get_endp (lsp->pdu))
+    return 0;
+
+  lsp_auth_update (lsp);
+  return !memcmp (STREAM_DATA (old), STREAM_DATA (lsp->pdu),
+                  stream_get_endp (old));
+}
+
+/* Sequence number, lifetime and flooding of a rebuilt fragment */
+static void
+lsp_frag_reissue (struct isis_lsp *lsp, u_int16_t rem_lifetime)
+{
+  lsp->lsp_header->rem_lifetime = htons (rem_lifetime);
+  lsp_inc_seqnum (lsp, 0);
+  lsp_set_all_srmflags (lsp);
+}
+
 /*
  * Search own LSPs, update holding time and set SRM
+ *
+ * On a refresh every fragment is reissued, with the same lifetime, so
+ * that no fragment expires before the lsp is refreshed again.  On a
+ * change only the fragments whose content changed are; the others keep
+ * their lifetime, and the refresh stays due when it was.
  */
 static int
-lsp_regenerate (struct isis_area *area, int level)
+lsp_regenerate (struct isis_area *area, int level, int refresh)
 {
-  dict_t *lspdb;
+  struct isis_lspdb *lspdb;
   struct isis_lsp *lsp, *frag;
   struct listnode *node;
+  struct stream *old_pdu[256];	/* by fragment number */
   u_char lspid[ISIS_SYS_ID_LEN + 2];
+  u_char lsp_bits;
   u_int16_t rem_lifetime, refresh_time;
+  int changed = 0, i;
+  time_t now;
 
   if ((area == NULL) || (area->is_type & level) != level)
     return ISIS_ERROR;
@@ -1654,27 +2068,53 @@ lsp_regenerate (struct isis_area *area, int level)
       return ISIS_ERROR;
     }
 
-  lsp_clear_data (lsp);
+  now = time (NULL);
+  if (area->lsp_refresh_due[level - 1] <= now)
+    refresh = 1;
+
+  memset (old_pdu, 0, sizeof (old_pdu));
+  if (!refresh)
+    {
+      old_pdu[0] = stream_dup (lsp->pdu);
+      for (ALL_LIST_ELEMENTS_RO (lsp->lspu.frags, node, frag))
+        old_pdu[LSP_FRAGMENT (frag->lsp_header->lsp_id)] =
+          stream_dup (frag->pdu);
+    }
+
   lsp_build (lsp, area);
-  lsp->lsp_header->lsp_bits = lsp_bits_generate (level, area->overload_bit);
+  lsp_bits = lsp_bits_generate (level, area->overload_bit);
   rem_lifetime = lsp_rem_lifetime (area, level);
-  lsp->lsp_header->rem_lifetime = htons (rem_lifetime);
-  lsp_seqnum_update (lsp);
 
-  lsp->last_generated = time (NULL);
-  lsp_set_all_srmflags (lsp);
+  lsp->lsp_header->lsp_bits = lsp_bits;
+  if (refresh || !lsp_frag_same (lsp, old_pdu[0]))
+    {
+      lsp_frag_reissue (lsp, rem_lifetime);
+      changed++;
+    }
   for (ALL_LIST_ELEMENTS_RO (lsp->lspu.frags, node, frag))
     {
-      frag->lsp_header->lsp_bits = lsp_bits_generate (level,
-                                                      area->overload_bit);
-      /* Set the lifetime values of all the fragments to the same value,
-       * so that no fragment expires before the lsp is refreshed.
-       */
-      frag->lsp_header->rem_lifetime = htons (rem_lifetime);
-      lsp_set_all_srmflags (frag);
+      frag->lsp_header->lsp_bits = lsp_bits;
+      if (refresh
+          || !lsp_frag_same (frag,
+                             old_pdu[LSP_FRAGMENT (frag->lsp_header->lsp_id)]))
+        {
+          lsp_frag_reissue (frag, rem_lifetime);
+          changed++;
+        }
     }
+  for (i = 0; i < 256; i++)
+    if (old_pdu[i])
+      stream_free (old_pdu[i]);
+
+  lsp->last_generated = now;
+  if (refresh)
+    {
+      refresh_time = lsp_refresh_time (lsp, rem_lifetime);
+      area->lsp_refresh_due[level - 1] = now + refresh_time;
+    }
+  else
+    refresh_time = area->lsp_refresh_due[level - 1] - now;
 
-  refresh_time = lsp_refresh_time (lsp, rem_lifetime);
   if (level == IS_LEVEL_1)
     THREAD_TIMER_ON (master, area->t_lsp_refresh[level - 1],
                      lsp_l1_refresh, area, refresh_time);
@@ -1684,15 +2124,16 @@ lsp_regenerate (struct isis_area *area, int level)
 
   if (isis->debugs & DEBUG_UPDATE_PACKETS)
     {
-      zlog_debug ("ISIS-Upd (%s): Refreshing our L%d LSP %s, len %d, "
-                  "seq 0x%08x, cksum 0x%04x, lifetime %us refresh %us",
-                  area->area_tag, level,
+      zlog_debug ("ISIS-Upd (%s): %s our L%d LSP %s, len %d, "
+                  "seq 0x%08x, cksum 0x%04x, lifetime %us refresh %us, "
+                  "%d of %d fragments reissued",
+                  area->area_tag, refresh ? "Refreshing" : "Updating", level,
                   rawlspid_print (lsp->lsp_header->lsp_id),
                   ntohl (lsp->lsp_header->pdu_len),
                   ntohl (lsp->lsp_header->seq_num),
                   ntohs (lsp->lsp_header->checksum),
                   ntohs (lsp->lsp_header->rem_lifetime),
-                  refresh_time);
+                  refresh_time, changed, 1 + listcount (lsp->lspu.frags));
     }
 
   return ISIS_OK;
@@ -1705,34 +2146,38 @@ static int
 lsp_l1_refresh (struct thread *thread)
 {
   struct isis_area *area;
+  int refresh;
 
   area = THREAD_ARG (thread);
   assert (area);
 
   area->t_lsp_refresh[0] = NULL;
+  refresh = !area->lsp_regenerate_pending[0];
   area->lsp_regenerate_pending[0] = 0;
 
   if ((area->is_type & IS_LEVEL_1) == 0)
     return ISIS_ERROR;
 
-  return lsp_regenerate (area, IS_LEVEL_1);
+  return lsp_regenerate (area, IS_LEVEL_1, refresh);
 }
 
 static int
 lsp_l2_refresh (struct thread *thread)
 {
   struct isis_area *area;
+  int refresh;
 
   area = THREAD_ARG (thread);
   assert (area);
 
   area->t_lsp_refresh[1] = NULL;
+  refresh = !area->lsp_regenerate_pending[1];
   area->lsp_regenerate_pending[1] = 0;
 
   if ((area->is_type & IS_LEVEL_2) == 0)
     return ISIS_ERROR;
 
-  return lsp_regenerate (area, IS_LEVEL_2);
+  return lsp_regenerate (area, IS_LEVEL_2, refresh);
 }
 
 int
@@ -1783,7 +2228,7 @@ lsp_regenerate_schedule (struct isis_area *area, int level, int all_pseudo)
         }
       else
         {
-          lsp_regenerate (area, lvl);
+          lsp_regenerate (area, lvl, 0);
         }
     }
 
@@ -1923,7 +2368,7 @@ lsp_build_pseudo (struct isis_lsp *lsp, struct isis_circuit *circuit,
 int
 lsp_generate_pseudo (struct isis_circuit *circuit, int level)
 {
-  dict_t *lspdb = circuit->area->lspdb[level - 1];
+  struct isis_lspdb *lspdb = circuit->area->lspdb[level - 1];
   struct isis_lsp *lsp;
   u_char lsp_id[ISIS_SYS_ID_LEN + 2];
   u_int16_t rem_lifetime, refresh_time;
@@ -1984,7 +2429,7 @@ lsp_generate_pseudo (struct isis_circuit *circuit, int level)
 static int
 lsp_regenerate_pseudo (struct isis_circuit *circuit, int level)
 {
-  dict_t *lspdb = circuit->area->lspdb[level - 1];
+  struct isis_lspdb *lspdb = circuit->area->lspdb[level - 1];
   struct isis_lsp *lsp;
   u_char lsp_id[ISIS_SYS_ID_LEN + 2];
   u_int16_t rem_lifetime, refresh_time;
@@ -2164,32 +2609,28 @@ lsp_tick (struct thread *thread)
   struct isis_area *area;
   struct isis_circuit *circuit;
   struct isis_lsp *lsp;
-  struct list *lsp_list;
-  struct listnode *lspnode, *cnode;
-  dnode_t *dnode, *dnode_next;
+  struct listnode *cnode;
+  struct isis_lsp *lsp_next;
+  struct flags_entry *entry;
   int level;
   u_int16_t rem_lifetime;
 
-  lsp_list = list_new ();
-
   area = THREAD_ARG (thread);
   assert (area);
   area->t_tick = NULL;
   THREAD_TIMER_ON (master, area->t_tick, lsp_tick, area, 1);
 
   /*
-   * Build a list of LSPs with (any) SRMflag set
-   * and removed the ones that have aged out
+   * Remove the LSPs that have aged out
    */
   for (level = 0; level < ISIS_LEVELS; level++)
     {
-      if (area->lspdb[level] && dict_count (area->lspdb[level]) > 0)
+      if (area->lspdb[level] && lsp_db_count (area->lspdb[level]) > 0)
         {
-          for (dnode = dict_first (area->lspdb[level]);
-               dnode != NULL; dnode = dnode_next)
+          for (lsp = lsp_db_first (area->lspdb[level]);
+               lsp != NULL; lsp = lsp_next)
             {
-              dnode_next = dict_next (area->lspdb[level], dnode);
-              lsp = dnode_get (dnode);
+              lsp_next = lsp_db_next (lsp);
 
               /*
                * The lsp rem_lifetime is kept at 0 for MaxAge or
@@ -2207,6 +2648,7 @@ lsp_tick (struct thread *thread)
                */
               if (rem_lifetime == 1 && lsp->lsp_header->seq_num != 0)
                 {
+                  lsp_db_changed (lsp);
                   /* 7.3.16.4 a) set SRM flags on all */
                   lsp_set_all_srmflags (lsp);
                   /* 7.3.16.4 b) retain only the header FIXME  */
@@ -2228,46 +2670,30 @@ lsp_tick (struct thread *thread)
                   if (lsp->from_topology)
                     THREAD_TIMER_OFF (lsp->t_lsp_top_ref);
 #endif /* TOPOLOGY_GENERATE */
+                  lsp_db_remove (area->lspdb[level], lsp);
                   lsp_destroy (lsp);
-                  lsp = NULL;
-                  dict_delete_free (area->lspdb[level], dnode);
                 }
-              else if (flags_any_set (lsp->SRMflags))
-                listnode_add (lsp_list, lsp);
-            }
-
-          /*
-           * Send LSPs on circuits indicated by the SRMflags
-           */
-          if (listcount (lsp_list) > 0)
-            {
-              for (ALL_LIST_ELEMENTS_RO (area->circuit_list, cnode, circuit))
-                {
-                  int diff = time (NULL) - circuit->lsp_queue_last_cleared;
-                  if (circuit->lsp_queue == NULL ||
-                      diff < MIN_LSP_TRANS_INTERVAL)
-                    continue;
-                  for (ALL_LIST_ELEMENTS_RO (lsp_list, lspnode, lsp))
-                    {
-                      if (circuit->upadjcount[lsp->level - 1] &&
-                          ISIS_CHECK_FLAG (lsp->SRMflags, circuit))
-                        {
-                          /* Add the lsp only if it is not already in lsp
-                           * queue */
-                          if (! listnode_lookup (circuit->lsp_queue, lsp))
-                            {
-                              listnode_add (circuit->lsp_queue, lsp);
-                              thread_add_event (master, send_lsp, circuit, 0);
-                            }
-                        }
-                    }
-                }
-              list_delete_all_node (lsp_list);
             }
         }
     }
 
-  list_delete (lsp_list);
+  /*
+   * Send LSPs on circuits indicated by the SRMflags, from the queue
+   * of the LSPs flagged on each circuit
+   */
+  for (ALL_LIST_ELEMENTS_RO (area->circuit_list, cnode, circuit))
+    {
+      int diff = time (NULL) - circuit->lsp_queue_last_cleared;
+      if (circuit->state != C_STATE_UP || circuit->is_passive ||
+          circuit->srm_queue->count == circuit->srm_queue->tx_count ||
+          diff < MIN_LSP_TRANS_INTERVAL)
+        continue;
+      for (entry = circuit->srm_queue->head; entry; entry = entry->next)
+        if (circuit->upadjcount[entry->lsp->level - 1])
+          flags_tx_add (circuit->srm_queue, entry);
+      if (circuit->srm_queue->tx_head && circuit->t_send_lsp == NULL)
+        circuit->t_send_lsp = thread_add_event (master, send_lsp, circuit, 0);
+    }
 
   return ISIS_OK;
 }
@@ -2310,6 +2736,7 @@ lsp_purge_pseudo (u_char * id, struct isis_circuit *circuit, int level)
   lsp_auth_update (lsp);
   fletcher_checksum(STREAM_DATA (lsp->pdu) + 12,
                     ntohs (lsp->lsp_header->pdu_len) - 12, 12);
+  lsp_db_changed (lsp);
 
   lsp_set_all_srmflags (lsp);
 
@@ -2379,15 +2806,11 @@ void lsp_set_all_srmflags (struct isis_lsp *lsp)
 
   assert (lsp);
 
-  ISIS_FLAGS_CLEAR_ALL(lsp->SRMflags);
-
   if (lsp->area)
     {
       struct list *circuit_list = lsp->area->circuit_list;
       for (ALL_LIST_ELEMENTS_RO (circuit_list, node, circuit))
-        {
-          ISIS_SET_FLAG(lsp->SRMflags, circuit);
-        }
+        flags_set_srm (lsp, circuit);
     }
 }
 
@@ -2480,21 +2903,17 @@ generate_topology_lsps (struct isis_area *area)
 void
 remove_topology_lsps (struct isis_area *area)
 {
-  struct isis_lsp *lsp;
-  dnode_t *dnode, *dnode_next;
+  struct isis_lsp *lsp, *lsp_next;
 
-  dnode = dict_first (area->lspdb[0]);
-  while (dnode != NULL)
+  for (lsp = lsp_db_first (area->lspdb[0]); lsp != NULL; lsp = lsp_next)
     {
-      dnode_next = dict_next (area->lspdb[0], dnode);
-      lsp = dnode_get (dnode);
+      lsp_next = lsp_db_next (lsp);
       if (lsp->from_topology)
 	{
 	  THREAD_TIMER_OFF (lsp->t_lsp_top_ref);
+	  lsp_db_remove (area->lspdb[0], lsp);
 	  lsp_destroy (lsp);
-	  dict_delete (area->lspdb[0], dnode);
 	}
-      dnode = dnode_next;
     }
 }
 
@@ -24,6 +24,8 @@
 #ifndef _ZEBRA_ISIS_LSP_H
 #define _ZEBRA_ISIS_LSP_H
 
+#define ISIS_LSPDB_SKIP_LEVELS 16
+
 /* Structure for isis_lsp, this structure will only support the fixed
  * System ID (Currently 6) (atleast for now). In order to support more
  * We will have to split the header into two parts, and for readability
@@ -54,10 +56,29 @@ struct isis_lsp
   int age_out;
   struct isis_area *area;
   struct tlvs tlv_data;		/* Simplifies TLV access */
+  u_int64_t db_key;		/* LSP ID as an integer, see isis_lsp.c */
+  struct isis_lsp *db_next;	/* next in the LSDB */
+  struct isis_lsp **db_skip;	/* LSDB skiplist links above db_next */
+  u_char db_skip_level;		/* number of those */
+};
+
+/* Link-state database of one level */
+struct isis_lspdb
+{
+  struct hash *index;		/* by LSP ID */
+  /* skiplist heads, skip[0] the first LSP; see isis_lsp.c */
+  struct isis_lsp *skip[ISIS_LSPDB_SKIP_LEVELS];
+  int level;
+  unsigned long count;
+  u_int32_t generation;		/* changed with any LSP in it */
+  struct list *csnp_cache;	/* encoded CSNPs, see isis_pdu.c */
 };
 
-dict_t *lsp_db_init (void);
-void lsp_db_destroy (dict_t * lspdb);
+struct isis_lspdb *lsp_db_init (void);
+void lsp_db_destroy (struct isis_lspdb *lspdb);
+struct isis_lsp *lsp_db_first (struct isis_lspdb *lspdb);
+#define lsp_db_next(L) ((L)->db_next)
+#define lsp_db_count(D) ((D)->count)
 int lsp_tick (struct thread *thread);
 
 int lsp_generate (struct isis_area *area, int level);
@@ -74,17 +95,19 @@ struct isis_lsp *lsp_new_from_stream_ptr (struct stream *stream,
 					  struct isis_lsp *lsp0,
 					  struct isis_area *area,
                                           int level);
-void lsp_insert (struct isis_lsp *lsp, dict_t * lspdb);
-struct isis_lsp *lsp_search (u_char * id, dict_t * lspdb);
+void lsp_insert (struct isis_lsp *lsp, struct isis_lspdb *lspdb);
+struct isis_lsp *lsp_search (u_char * id, struct isis_lspdb *lspdb);
+void *lsp_tlv_first (struct tlv_iter *iter, struct stream *pdu,
+		     u_char type);
 
 void lsp_build_list (u_char * start_id, u_char * stop_id, u_char num_lsps,
-		     struct list *list, dict_t * lspdb);
+		     struct list *list, struct isis_lspdb *lspdb);
 void lsp_build_list_nonzero_ht (u_char * start_id, u_char * stop_id,
-				struct list *list, dict_t * lspdb);
-void lsp_build_list_ssn (struct isis_circuit *circuit, u_char num_lsps,
-                         struct list *list, dict_t * lspdb);
+				struct list *list, struct isis_lspdb *lspdb);
+void lsp_build_list_ssn (struct isis_circuit *circuit, int level,
+                         u_char num_lsps, struct list *list);
 
-void lsp_search_and_destroy (u_char * id, dict_t * lspdb);
+void lsp_search_and_destroy (u_char * id, struct isis_lspdb *lspdb);
 void lsp_purge_pseudo (u_char * id, struct isis_circuit *circuit, int level);
 void lsp_purge_non_exist (struct isis_link_state_hdr *lsp_hdr,
 			  struct isis_area *area);
@@ -107,7 +130,7 @@ void lsp_update (struct isis_lsp *lsp, struct stream *stream,
 void lsp_inc_seqnum (struct isis_lsp *lsp, u_int32_t seq_num);
 void lsp_print (struct isis_lsp *lsp, struct vty *vty, char dynhost);
 void lsp_print_detail (struct isis_lsp *lsp, struct vty *vty, char dynhost);
-int lsp_print_all (struct vty *vty, dict_t * lspdb, char detail,
+int lsp_print_all (struct vty *vty, struct isis_lspdb *lspdb, char detail,
 		   char dynhost);
 const char *lsp_bits2string (u_char *);
 
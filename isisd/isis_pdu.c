@@ -1409,26 +1409,26 @@ dontcheckadj:
 		  /* ii */
                   lsp_set_all_srmflags (lsp);
 		  /* iii */
-		  ISIS_CLEAR_FLAG (lsp->SRMflags, circuit);
+		  flags_clear_srm (lsp, circuit);
 		  /* v */
-		  ISIS_FLAGS_CLEAR_ALL (lsp->SSNflags);	/* FIXME: OTHER than c */
+		  flags_clear_all_ssn (lsp);	/* FIXME: OTHER than c */
 		  /* iv */
 		  if (circuit->circ_type != CIRCUIT_T_BROADCAST)
-		    ISIS_SET_FLAG (lsp->SSNflags, circuit);
+		    flags_set_ssn (lsp, circuit);
 
 		}		/* 7.3.16.4 b) 2) */
 	      else if (comp == LSP_EQUAL)
 		{
 		  /* i */
-		  ISIS_CLEAR_FLAG (lsp->SRMflags, circuit);
+		  flags_clear_srm (lsp, circuit);
 		  /* ii */
 		  if (circuit->circ_type != CIRCUIT_T_BROADCAST)
-		    ISIS_SET_FLAG (lsp->SSNflags, circuit);
+		    flags_set_ssn (lsp, circuit);
 		}		/* 7.3.16.4 b) 3) */
 	      else
 		{
-		  ISIS_SET_FLAG (lsp->SRMflags, circuit);
-		  ISIS_CLEAR_FLAG (lsp->SSNflags, circuit);
+		  flags_set_srm (lsp, circuit);
+		  flags_clear_ssn (lsp, circuit);
 		}
 	    }
           else if (lsp->lsp_header->rem_lifetime != 0)
@@ -1441,8 +1441,8 @@ dontcheckadj:
                 }
               else
                 {
-                  ISIS_SET_FLAG (lsp->SRMflags, circuit);
-                  ISIS_CLEAR_FLAG (lsp->SSNflags, circuit);
+                  flags_set_srm (lsp, circuit);
+                  flags_clear_ssn (lsp, circuit);
                 }
               if (isis->debugs & DEBUG_UPDATE_PACKETS)
                 zlog_debug ("ISIS-Upd (%s): (1) re-originating LSP %s new "
@@ -1519,26 +1519,26 @@ dontcheckadj:
 	  /* ii */
           lsp_set_all_srmflags (lsp);
 	  /* iii */
-	  ISIS_CLEAR_FLAG (lsp->SRMflags, circuit);
+	  flags_clear_srm (lsp, circuit);
 
 	  /* iv */
 	  if (circuit->circ_type != CIRCUIT_T_BROADCAST)
-	    ISIS_SET_FLAG (lsp->SSNflags, circuit);
+	    flags_set_ssn (lsp, circuit);
 	  /* FIXME: v) */
 	}
       /* 7.3.15.1 e) 2) LSP equal to the one in db */
       else if (comp == LSP_EQUAL)
 	{
-	  ISIS_CLEAR_FLAG (lsp->SRMflags, circuit);
+	  flags_clear_srm (lsp, circuit);
 	  lsp_update (lsp, circuit->rcv_stream, circuit->area, level);
 	  if (circuit->circ_type != CIRCUIT_T_BROADCAST)
-	    ISIS_SET_FLAG (lsp->SSNflags, circuit);
+	    flags_set_ssn (lsp, circuit);
 	}
       /* 7.3.15.1 e) 3) LSP older than the one in db */
       else
 	{
-	  ISIS_SET_FLAG (lsp->SRMflags, circuit);
-	  ISIS_CLEAR_FLAG (lsp->SSNflags, circuit);
+	  flags_set_srm (lsp, circuit);
+	  flags_clear_ssn (lsp, circuit);
 	}
     }
   return retval;
@@ -1767,13 +1767,13 @@ process_snp (int snp_type, int level, struct isis_circuit *circuit,
 	    if (cmp == LSP_EQUAL)
 	      {
 		/* if (circuit->circ_type != CIRCUIT_T_BROADCAST) */
-	        ISIS_CLEAR_FLAG (lsp->SRMflags, circuit);
+	        flags_clear_srm (lsp, circuit);
 	      }
 	    /* 7.3.15.2 b) 3) if it is older, clear SSN and set SRM */
 	    else if (cmp == LSP_OLDER)
 	      {
-		ISIS_CLEAR_FLAG (lsp->SSNflags, circuit);
-		ISIS_SET_FLAG (lsp->SRMflags, circuit);
+		flags_clear_ssn (lsp, circuit);
+		flags_set_srm (lsp, circuit);
 	      }
 	    /* 7.3.15.2 b) 4) if it is newer, set SSN and clear SRM on p2p */
 	    else
@@ -1781,13 +1781,13 @@ process_snp (int snp_type, int level, struct isis_circuit *circuit,
 		if (own_lsp)
 		  {
 		    lsp_inc_seqnum (lsp, ntohl (entry->seq_num));
-		    ISIS_SET_FLAG (lsp->SRMflags, circuit);
+		    flags_set_srm (lsp, circuit);
 		  }
 		else
 		  {
-		    ISIS_SET_FLAG (lsp->SSNflags, circuit);
+		    flags_set_ssn (lsp, circuit);
 		    /* if (circuit->circ_type != CIRCUIT_T_BROADCAST) */
-		    ISIS_CLEAR_FLAG (lsp->SRMflags, circuit);
+		    flags_clear_srm (lsp, circuit);
 		  }
 	      }
 	  }
@@ -1802,8 +1802,8 @@ process_snp (int snp_type, int level, struct isis_circuit *circuit,
 			       0, 0, entry->checksum, level);
 		lsp->area = circuit->area;
 		lsp_insert (lsp, circuit->area->lspdb[level - 1]);
-		ISIS_FLAGS_CLEAR_ALL (lsp->SRMflags);
-		ISIS_SET_FLAG (lsp->SSNflags, circuit);
+		flags_clear_all_srm (lsp);
+		flags_set_ssn (lsp, circuit);
 	      }
 	  }
       }
@@ -1837,7 +1837,7 @@ process_snp (int snp_type, int level, struct isis_circuit *circuit,
 	}
       /* on remaining LSPs we set SRM (neighbor knew not of) */
       for (ALL_LIST_ELEMENTS_RO (lsp_list, node, lsp))
-	ISIS_SET_FLAG (lsp->SRMflags, circuit);
+	flags_set_srm (lsp, circuit);
       /* lets free it */
       list_delete (lsp_list);
 
@@ -2106,17 +2106,22 @@ isis_receive (struct thread *thread)
    */
   circuit = THREAD_ARG (thread);
   assert (circuit);
+  circuit->t_read = NULL;
 
-  if (circuit->rcv_stream == NULL)
-    circuit->rcv_stream = stream_new (ISO_MTU (circuit));
-  else
-    stream_reset (circuit->rcv_stream);
+  /* With a receive ring, all the PDUs ready are handled in one go. */
+  do
+    {
+      if (circuit->rcv_stream == NULL)
+	circuit->rcv_stream = stream_new (ISO_MTU (circuit));
+      else
+	stream_reset (circuit->rcv_stream);
 
-  retval = circuit->rx (circuit, ssnpa);
-  circuit->t_read = NULL;
+      retval = circuit->rx (circuit, ssnpa);
 
-  if (retval == ISIS_OK)
-    retval = isis_handle_pdu (circuit, ssnpa);
+      if (retval == ISIS_OK)
+	retval = isis_handle_pdu (circuit, ssnpa);
+    }
+  while (circuit->fd && isis_recv_pending (circuit));
 
   /* 
    * prepare for next packet. 
@@ -2668,11 +2673,57 @@ max_lsps_per_snp (int snp_type, int level, struct isis_circuit *circuit)
 }
 
 /*
- * FIXME: support multiple CSNPs
+ * The CSNPs of a level are the same on every circuit of the same
+ * maximum PDU size, and the same from one interval to the next while no
+ * LSP changed: they are kept encoded on the LSPDB, one set for each size,
+ * and rebuilt once its generation moved, the SNP password changed, or
+ * the remaining lifetimes in them are CSNP_CACHE_REFRESH seconds old.
  */
+struct isis_csnp_cache
+{
+  size_t size;			/* of the streams they are sent from */
+  u_int32_t generation;		/* of the LSPDB they were built from */
+  time_t built;
+  struct isis_passwd passwd;	/* they were authenticated with */
+  struct list *pdus;		/* struct stream, in LSP ID order */
+};
 
-int
-send_csnp (struct isis_circuit *circuit, int level)
+static void
+csnp_cache_pdus_free (struct isis_csnp_cache *cache)
+{
+  struct listnode *node, *nnode;
+  struct stream *pdu;
+
+  for (ALL_LIST_ELEMENTS (cache->pdus, node, nnode, pdu))
+    {
+      stream_free (pdu);
+      list_delete_node (cache->pdus, node);
+    }
+}
+
+void
+csnp_cache_free (struct isis_lspdb *lspdb)
+{
+  struct listnode *node;
+  struct isis_csnp_cache *cache;
+
+  if (lspdb->csnp_cache == NULL)
+    return;
+
+  for (ALL_LIST_ELEMENTS_RO (lspdb->csnp_cache, node, cache))
+    {
+      csnp_cache_pdus_free (cache);
+      list_delete (cache->pdus);
+      XFREE (MTYPE_ISIS_CSNP, cache);
+    }
+  list_delete (lspdb->csnp_cache);
+  lspdb->csnp_cache = NULL;
+}
+
+/* Encode the CSNPs of the level for the circuit's PDU size into cache. */
+static int
+csnp_cache_build (struct isis_circuit *circuit, int level,
+                  struct isis_csnp_cache *cache)
 {
   u_char start[ISIS_SYS_ID_LEN + 2];
   u_char stop[ISIS_SYS_ID_LEN + 2];
@@ -2682,9 +2733,7 @@ send_csnp (struct isis_circuit *circuit, int level)
   u_char num_lsps, loop = 1;
   int i, retval = ISIS_OK;
 
-  if (circuit->area->lspdb[level - 1] == NULL ||
-      dict_count (circuit->area->lspdb[level - 1]) == 0)
-    return retval;
+  csnp_cache_pdus_free (cache);
 
   memset (start, 0x00, ISIS_SYS_ID_LEN + 2);
   memset (stop, 0xff, ISIS_SYS_ID_LEN + 2);
@@ -2716,12 +2765,13 @@ send_csnp (struct isis_circuit *circuit, int level)
           zlog_err ("ISIS-Snp (%s): Build L%d CSNP on %s failed",
                     circuit->area->area_tag, level, circuit->interface->name);
           list_delete (list);
+          csnp_cache_pdus_free (cache);
           return retval;
         }
 
       if (isis->debugs & DEBUG_SNP_PACKETS)
         {
-          zlog_debug ("ISIS-Snp (%s): Sent L%d CSNP on %s, length %ld",
+          zlog_debug ("ISIS-Snp (%s): Built L%d CSNP for %s, length %ld",
                       circuit->area->area_tag, level, circuit->interface->name,
                       stream_get_endp (circuit->snd_stream));
           for (ALL_LIST_ELEMENTS_RO (list, node, lsp))
@@ -2734,20 +2784,9 @@ send_csnp (struct isis_circuit *circuit, int level)
                           ntohs (lsp->lsp_header->checksum),
                           ntohs (lsp->lsp_header->rem_lifetime));
             }
-          if (isis->debugs & DEBUG_PACKET_DUMP)
-            zlog_dump_data (STREAM_DATA (circuit->snd_stream),
-                            stream_get_endp (circuit->snd_stream));
         }
 
-      retval = circuit->tx (circuit, level);
-      if (retval != ISIS_OK)
-        {
-          zlog_err ("ISIS-Snp (%s): Send L%d CSNP on %s failed",
-                    circuit->area->area_tag, level,
-                    circuit->interface->name);
-          list_delete (list);
-          return retval;
-        }
+      listnode_add (cache->pdus, stream_dup (circuit->snd_stream));
 
       /*
        * Start lsp_id of the next CSNP should be one plus the
@@ -2771,6 +2810,97 @@ send_csnp (struct isis_circuit *circuit, int level)
   return retval;
 }
 
+/* The CSNPs of the level for the circuit, built if not current. */
+static struct isis_csnp_cache *
+csnp_cache_get (struct isis_circuit *circuit, int level)
+{
+  struct isis_lspdb *lspdb = circuit->area->lspdb[level - 1];
+  struct isis_passwd *passwd;
+  struct isis_csnp_cache *cache;
+  struct listnode *node;
+  time_t now = time (NULL);
+
+  if (level == IS_LEVEL_1)
+    passwd = &circuit->area->area_passwd;
+  else
+    passwd = &circuit->area->domain_passwd;
+
+  if (lspdb->csnp_cache == NULL)
+    lspdb->csnp_cache = list_new ();
+  for (ALL_LIST_ELEMENTS_RO (lspdb->csnp_cache, node, cache))
+    if (cache->size == stream_get_size (circuit->snd_stream))
+      break;
+  if (node == NULL)
+    {
+      cache = XCALLOC (MTYPE_ISIS_CSNP, sizeof (struct isis_csnp_cache));
+      cache->size = stream_get_size (circuit->snd_stream);
+      cache->pdus = list_new ();
+      listnode_add (lspdb->csnp_cache, cache);
+    }
+
+  if (listcount (cache->pdus) == 0
+      || cache->generation != lspdb->generation
+      || now - cache->built >= CSNP_CACHE_REFRESH
+      || memcmp (&cache->passwd, passwd, sizeof (*passwd)))
+    {
+      if (csnp_cache_build (circuit, level, cache) != ISIS_OK)
+        return NULL;
+      cache->generation = lspdb->generation;
+      cache->built = now;
+      cache->passwd = *passwd;
+    }
+
+  return cache;
+}
+
+int
+send_csnp (struct isis_circuit *circuit, int level)
+{
+  struct isis_csnp_cache *cache;
+  struct listnode *node;
+  struct stream *pdu;
+  int retval = ISIS_OK;
+
+  if (circuit->area->lspdb[level - 1] == NULL ||
+      lsp_db_count (circuit->area->lspdb[level - 1]) == 0)
+    return retval;
+
+  if (circuit->snd_stream == NULL)
+    circuit->snd_stream = stream_new (ISO_MTU (circuit));
+
+  cache = csnp_cache_get (circuit, level);
+  if (cache == NULL)
+    return ISIS_WARNING;
+
+  for (ALL_LIST_ELEMENTS_RO (cache->pdus, node, pdu))
+    {
+      stream_reset (circuit->snd_stream);
+      stream_put (circuit->snd_stream, STREAM_DATA (pdu),
+                  stream_get_endp (pdu));
+
+      if (isis->debugs & DEBUG_SNP_PACKETS)
+        {
+          zlog_debug ("ISIS-Snp (%s): Sent L%d CSNP on %s, length %ld",
+                      circuit->area->area_tag, level, circuit->interface->name,
+                      stream_get_endp (circuit->snd_stream));
+          if (isis->debugs & DEBUG_PACKET_DUMP)
+            zlog_dump_data (STREAM_DATA (circuit->snd_stream),
+                            stream_get_endp (circuit->snd_stream));
+        }
+
+      retval = circuit->tx (circuit, level);
+      if (retval != ISIS_OK)
+        {
+          zlog_err ("ISIS-Snp (%s): Send L%d CSNP on %s failed",
+                    circuit->area->area_tag, level,
+                    circuit->interface->name);
+          return retval;
+        }
+    }
+
+  return retval;
+}
+
 int
 send_l1_csnp (struct thread *thread)
 {
@@ -2939,7 +3069,7 @@ send_psnp (int level, struct isis_circuit *circuit)
     return ISIS_OK;
 
   if (circuit->area->lspdb[level - 1] == NULL ||
-      dict_count (circuit->area->lspdb[level - 1]) == 0)
+      lsp_db_count (circuit->area->lspdb[level - 1]) == 0)
     return ISIS_OK;
 
   if (! circuit->snd_stream)
@@ -2950,8 +3080,7 @@ send_psnp (int level, struct isis_circuit *circuit)
   while (1)
     {
       list = list_new ();
-      lsp_build_list_ssn (circuit, num_lsps, list,
-                          circuit->area->lspdb[level - 1]);
+      lsp_build_list_ssn (circuit, level, num_lsps, list);
 
       if (listcount (list) == 0)
         {
@@ -2994,7 +3123,7 @@ send_psnp (int level, struct isis_circuit *circuit)
        * for the LSPs in list
        */
       for (ALL_LIST_ELEMENTS_RO (list, node, lsp))
-        ISIS_CLEAR_FLAG (lsp->SSNflags, circuit);
+        flags_clear_ssn (lsp, circuit);
       list_delete (list);
     }
 
@@ -3047,99 +3176,89 @@ send_l2_psnp (struct thread *thread)
 
 /*
  * ISO 10589 - 7.3.14.3
+ * Send the LSPs due on the circuit, at most LSP_TX_BURST of them every
+ * LSP_TX_INTERVAL milliseconds
  */
 int
 send_lsp (struct thread *thread)
 {
   struct isis_circuit *circuit;
   struct isis_lsp *lsp;
-  struct listnode *node;
+  struct flags_queue *queue;
+  int sent = 0;
   int retval = ISIS_OK;
 
   circuit = THREAD_ARG (thread);
   assert (circuit);
+  circuit->t_send_lsp = NULL;
 
   if (circuit->state != C_STATE_UP || circuit->is_passive == 1)
   {
     return retval;
   }
 
-  node = listhead (circuit->lsp_queue);
-
-  /*
-   * Handle case where there are no LSPs on the queue. This can
-   * happen, for instance, if an adjacency goes down before this
-   * thread gets a chance to run.
-   */
-  if (!node)
+  queue = circuit->srm_queue;
+  while (queue->tx_head && sent < LSP_TX_BURST)
     {
-      return retval;
-    }
+      lsp = queue->tx_head->lsp;
+      flags_tx_del (queue, queue->tx_head);
 
-  lsp = listgetdata(node);
-
-  /*
-   * Do not send if levels do not match
-   */
-  if (!(lsp->level & circuit->is_type))
-    {
-      list_delete_node (circuit->lsp_queue, node);
-      return retval;
-    }
+      /*
+       * Do not send if levels do not match
+       */
+      if (!(lsp->level & circuit->is_type))
+        continue;
 
-  /*
-   * Do not send if we do not have adjacencies in state up on the circuit
-   */
-  if (circuit->upadjcount[lsp->level - 1] == 0)
-    {
-      list_delete_node (circuit->lsp_queue, node);
-      return retval;
-    }
+      /*
+       * Do not send if we do not have adjacencies in state up on the
+       * circuit
+       */
+      if (circuit->upadjcount[lsp->level - 1] == 0)
+        continue;
 
-  /* copy our lsp to the send buffer */
-  stream_copy (circuit->snd_stream, lsp->pdu);
+      /* copy our lsp to the send buffer */
+      stream_copy (circuit->snd_stream, lsp->pdu);
 
-  if (isis->debugs & DEBUG_UPDATE_PACKETS)
-    {
-      zlog_debug
-        ("ISIS-Upd (%s): Sent L%d LSP %s, seq 0x%08x, cksum 0x%04x,"
-         " lifetime %us on %s", circuit->area->area_tag, lsp->level,
-         rawlspid_print (lsp->lsp_header->lsp_id),
-         ntohl (lsp->lsp_header->seq_num),
-         ntohs (lsp->lsp_header->checksum),
-         ntohs (lsp->lsp_header->rem_lifetime),
-         circuit->interface->name);
-      if (isis->debugs & DEBUG_PACKET_DUMP)
-        zlog_dump_data (STREAM_DATA (circuit->snd_stream),
-                        stream_get_endp (circuit->snd_stream));
-    }
+      if (isis->debugs & DEBUG_UPDATE_PACKETS)
+        {
+          zlog_debug
+            ("ISIS-Upd (%s): Sent L%d LSP %s, seq 0x%08x, cksum 0x%04x,"
+             " lifetime %us on %s", circuit->area->area_tag, lsp->level,
+             rawlspid_print (lsp->lsp_header->lsp_id),
+             ntohl (lsp->lsp_header->seq_num),
+             ntohs (lsp->lsp_header->checksum),
+             ntohs (lsp->lsp_header->rem_lifetime),
+             circuit->interface->name);
+          if (isis->debugs & DEBUG_PACKET_DUMP)
+            zlog_dump_data (STREAM_DATA (circuit->snd_stream),
+                            stream_get_endp (circuit->snd_stream));
+        }
 
-  retval = circuit->tx (circuit, lsp->level);
-  if (retval != ISIS_OK)
-    {
-      zlog_err ("ISIS-Upd (%s): Send L%d LSP on %s failed",
-                circuit->area->area_tag, lsp->level,
-                circuit->interface->name);
-      return retval;
-    }
+      retval = circuit->tx (circuit, lsp->level);
+      if (retval != ISIS_OK)
+        {
+          /* SRM stays set, the next tick queues it again */
+          zlog_err ("ISIS-Upd (%s): Send L%d LSP on %s failed",
+                    circuit->area->area_tag, lsp->level,
+                    circuit->interface->name);
+          break;
+        }
+      sent++;
 
-  /*
-   * If the sending succeeded, we can del the lsp from circuits
-   * lsp_queue
-   */
-  list_delete_node (circuit->lsp_queue, node);
+      /* Set the last-cleared time if the queue is empty. */
+      if (queue->tx_head == NULL)
+        circuit->lsp_queue_last_cleared = time (NULL);
 
-  /* Set the last-cleared time if the queue is empty. */
-  /* TODO: Is is possible that new lsps keep being added to the queue
-   * that the queue is never empty? */
-  if (list_isempty (circuit->lsp_queue))
-    circuit->lsp_queue_last_cleared = time (NULL);
+      /*
+       * On broadcast circuits also the SRMflag can be cleared
+       */
+      if (circuit->circ_type == CIRCUIT_T_BROADCAST)
+        flags_clear_srm (lsp, circuit);
+    }
 
-  /*
-   * On broadcast circuits also the SRMflag can be cleared
-   */
-  if (circuit->circ_type == CIRCUIT_T_BROADCAST)
-    ISIS_CLEAR_FLAG (lsp->SRMflags, circuit);
+  if (queue->tx_head)
+    THREAD_TIMER_MSEC_ON (master, circuit->t_send_lsp, send_lsp, circuit,
+                          LSP_TX_INTERVAL);
 
   return retval;
 }
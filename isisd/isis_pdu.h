@@ -261,6 +261,8 @@ int send_lan_l1_hello (struct thread *thread);
 int send_lan_l2_hello (struct thread *thread);
 int send_p2p_hello (struct thread *thread);
 int send_csnp (struct isis_circuit *circuit, int level);
+struct isis_lspdb;
+void csnp_cache_free (struct isis_lspdb *lspdb);
 int send_l1_csnp (struct thread *thread);
 int send_l2_csnp (struct thread *thread);
 int send_l1_psnp (struct thread *thread);
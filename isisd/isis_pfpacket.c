@@ -22,12 +22,15 @@
 
 #include <zebra.h>
 #if ISIS_METHOD == ISIS_METHOD_PFPACKET
+#include <sys/mman.h>
 #include <net/ethernet.h>	/* the L2 protocols */
-#include <netpacket/packet.h>
+#include <linux/if_packet.h>	/* with the packet rings */
 
 #include "log.h"
 #include "stream.h"
 #include "if.h"
+#include "thread.h"
+#include "memory.h"
 
 #include "isisd/dict.h"
 #include "isisd/include-netbsd/iso.h"
@@ -57,6 +60,266 @@ u_char ALL_ESS[6] = { 0x09, 0x00, 0x2B, 0x00, 0x00, 0x04 };
 static char discard_buff[8192];
 static char sock_buff[8192];
 
+#if defined (PACKET_RX_RING) && defined (TPACKET3_HDRLEN)
+/*
+ * Packet rings shared with the kernel.  The socket of a broadcast circuit
+ * receives into a TPACKET_V3 ring: the kernel fills a block with the
+ * frames arriving within ISIS_RX_RING_TIMEOUT msec, and isis_receive()
+ * handles all the frames of the blocks ready in one wakeup, without a
+ * recvfrom() each.  PDUs are sent through a TPACKET_V2 ring of a second
+ * socket: the frames queued there by a burst, as send_lsp() makes, go out
+ * with one send() once the current event has run.
+ */
+#define ISIS_RING 1
+#define ISIS_RING_BLOCK_SIZE     (1 << 16)
+#define ISIS_RX_RING_BLOCKS      8
+#define ISIS_RX_RING_FRAME_SIZE  2048	/* not used by TPACKET_V3 */
+#define ISIS_RX_RING_TIMEOUT     4	/* msec */
+#define ISIS_TX_RING_BLOCKS      1
+
+struct isis_ring
+{
+  int fd;
+  u_char *map;
+  size_t size;
+  unsigned int block_nr;
+  unsigned int frame_size;
+  unsigned int frame_nr;
+  unsigned int next;		/* block to read, or frame to write */
+  struct tpacket3_hdr *frame;	/* next frame of the block being read */
+  unsigned int left;		/* frames left in the block being read */
+};
+
+#define ISIS_RING_BLOCK(R,N) \
+  ((struct tpacket_block_desc *) ((R)->map + (size_t) (N) * ISIS_RING_BLOCK_SIZE))
+#define ISIS_RING_FRAME(R,N) \
+  ((struct tpacket2_hdr *) ((R)->map + \
+			    ((N) / (ISIS_RING_BLOCK_SIZE / (R)->frame_size)) \
+			    * ISIS_RING_BLOCK_SIZE \
+			    + ((N) % (ISIS_RING_BLOCK_SIZE / (R)->frame_size)) \
+			    * (R)->frame_size))
+/* Where a frame to send starts, as the kernel expects it. */
+#define ISIS_TX_FRAME_DATA(F) \
+  ((u_char *) (F) + TPACKET2_HDRLEN - sizeof (struct sockaddr_ll))
+
+static int isis_recv_pdu_ring (struct isis_circuit *circuit, u_char * ssnpa);
+
+/* Set up a ring of type (PACKET_RX_RING or PACKET_TX_RING) on fd and map
+   it, or return NULL with errno set, the socket left without a ring. */
+static struct isis_ring *
+isis_ring_map (int fd, int version, int type, void *req, size_t req_len,
+	       unsigned int block_nr, unsigned int frame_size)
+{
+  struct isis_ring *ring;
+  size_t size = (size_t) block_nr * ISIS_RING_BLOCK_SIZE;
+  u_char *map;
+  int err;
+
+  if (setsockopt (fd, SOL_PACKET, PACKET_VERSION, &version,
+		  sizeof (version)) < 0
+      || setsockopt (fd, SOL_PACKET, type, req, req_len) < 0)
+    return NULL;
+
+  map = mmap (NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (map == MAP_FAILED)
+    {
+      err = errno;
+      memset (req, 0, req_len);
+      setsockopt (fd, SOL_PACKET, type, req, req_len);
+      errno = err;
+      return NULL;
+    }
+
+  ring = XCALLOC (MTYPE_ISIS_RING, sizeof (struct isis_ring));
+  ring->fd = fd;
+  ring->map = map;
+  ring->size = size;
+  ring->block_nr = block_nr;
+  ring->frame_size = frame_size;
+  ring->frame_nr = block_nr * (ISIS_RING_BLOCK_SIZE / frame_size);
+  return ring;
+}
+
+static void
+isis_ring_unmap (struct isis_ring *ring)
+{
+  munmap (ring->map, ring->size);
+  XFREE (MTYPE_ISIS_RING, ring);
+}
+
+/* Before the socket is bound, so no frame is queued outside the ring. */
+static void
+isis_rx_ring_open (struct isis_circuit *circuit)
+{
+  struct tpacket_req3 req;
+
+  memset (&req, 0, sizeof (req));
+  req.tp_block_size = ISIS_RING_BLOCK_SIZE;
+  req.tp_block_nr = ISIS_RX_RING_BLOCKS;
+  req.tp_frame_size = ISIS_RX_RING_FRAME_SIZE;
+  req.tp_frame_nr = ISIS_RX_RING_BLOCKS
+		    * (ISIS_RING_BLOCK_SIZE / ISIS_RX_RING_FRAME_SIZE);
+  req.tp_retire_blk_tov = ISIS_RX_RING_TIMEOUT;
+
+  circuit->rx_ring = isis_ring_map (circuit->fd, TPACKET_V3, PACKET_RX_RING,
+				    &req, sizeof (req), ISIS_RX_RING_BLOCKS,
+				    ISIS_RX_RING_FRAME_SIZE);
+  if (circuit->rx_ring == NULL)
+    zlog_warn ("%s: no receive ring on %s, reading each PDU: %s", __func__,
+	       circuit->interface->name, safe_strerror (errno));
+}
+
+static void
+isis_tx_ring_open (struct isis_circuit *circuit)
+{
+  struct tpacket_req req;
+  struct sockaddr_ll s_addr;
+  unsigned int frame_size;
+  int fd;
+
+  frame_size = TPACKET_ALIGN (TPACKET2_HDRLEN - sizeof (struct sockaddr_ll)
+			      + ETH_HLEN + circuit->interface->mtu);
+  if (frame_size > ISIS_RING_BLOCK_SIZE)
+    return;
+
+  /* Bound to no protocol, it receives nothing. */
+  fd = socket (PF_PACKET, SOCK_RAW, 0);
+  if (fd < 0)
+    return;
+
+  memset (&req, 0, sizeof (req));
+  req.tp_block_size = ISIS_RING_BLOCK_SIZE;
+  req.tp_block_nr = ISIS_TX_RING_BLOCKS;
+  req.tp_frame_size = frame_size;
+  req.tp_frame_nr = ISIS_TX_RING_BLOCKS * (ISIS_RING_BLOCK_SIZE / frame_size);
+
+  memset (&s_addr, 0, sizeof (struct sockaddr_ll));
+  s_addr.sll_family = AF_PACKET;
+  s_addr.sll_ifindex = circuit->interface->ifindex;
+
+  circuit->tx_ring = isis_ring_map (fd, TPACKET_V2, PACKET_TX_RING, &req,
+				    sizeof (req), ISIS_TX_RING_BLOCKS,
+				    frame_size);
+  if (circuit->tx_ring == NULL
+      || bind (fd, (struct sockaddr *) &s_addr,
+	       sizeof (struct sockaddr_ll)) < 0)
+    {
+      zlog_warn ("%s: no transmit ring on %s, sending each PDU: %s",
+		 __func__, circuit->interface->name, safe_strerror (errno));
+      if (circuit->tx_ring)
+	isis_ring_unmap (circuit->tx_ring);
+      circuit->tx_ring = NULL;
+      close (fd);
+    }
+}
+
+/* The next frame of the receive ring, or NULL until the kernel hands over
+   another block.  isis_rx_ring_done() when done with it. */
+static struct tpacket3_hdr *
+isis_rx_ring_frame (struct isis_ring *ring)
+{
+  struct tpacket_block_desc *block;
+  struct tpacket3_hdr *frame;
+
+  if (ring->left == 0)
+    {
+      block = ISIS_RING_BLOCK (ring, ring->next);
+      if (!(block->hdr.bh1.block_status & TP_STATUS_USER)
+	  || block->hdr.bh1.num_pkts == 0)
+	return NULL;
+      __sync_synchronize ();
+      ring->left = block->hdr.bh1.num_pkts;
+      ring->frame = (struct tpacket3_hdr *)
+	((u_char *) block + block->hdr.bh1.offset_to_first_pkt);
+    }
+
+  frame = ring->frame;
+  ring->frame = (struct tpacket3_hdr *)
+    ((u_char *) frame + frame->tp_next_offset);
+  return frame;
+}
+
+/* A block goes back to the kernel as soon as its last frame is read, or
+   the socket stays readable. */
+static void
+isis_rx_ring_done (struct isis_ring *ring)
+{
+  if (--ring->left > 0)
+    return;
+  __sync_synchronize ();
+  ISIS_RING_BLOCK (ring, ring->next)->hdr.bh1.block_status = TP_STATUS_KERNEL;
+  ring->next = (ring->next + 1) % ring->block_nr;
+}
+
+static void
+isis_tx_ring_send (struct isis_circuit *circuit, int flags)
+{
+  THREAD_OFF (circuit->t_tx_flush);
+  if (send (circuit->tx_ring->fd, NULL, 0, flags) < 0
+      && errno != EAGAIN && errno != ENOBUFS)
+    zlog_warn ("isis_tx_ring_send(): send() on %s failed: %s",
+	       circuit->interface->name, safe_strerror (errno));
+}
+
+static int
+isis_tx_ring_flush (struct thread *thread)
+{
+  struct isis_circuit *circuit = THREAD_ARG (thread);
+
+  circuit->t_tx_flush = NULL;
+  isis_tx_ring_send (circuit, MSG_DONTWAIT);
+  return 0;
+}
+
+/* Queue the PDU of snd_stream for the MAC address dst.  Returns
+   ISIS_WARNING if it has to be sent without the ring. */
+static int
+isis_tx_ring_queue (struct isis_circuit *circuit, u_char *dst)
+{
+  struct isis_ring *ring = circuit->tx_ring;
+  struct tpacket2_hdr *frame = ISIS_RING_FRAME (ring, ring->next);
+  size_t len = stream_get_endp (circuit->snd_stream);
+  u_char *data;
+
+  if (circuit->interface->hw_addr_len != ETH_ALEN
+      || ISIS_TX_FRAME_DATA (frame) + ETH_HLEN + LLC_LEN + len
+	 > (u_char *) frame + ring->frame_size)
+    return ISIS_WARNING;
+
+  if (frame->tp_status == TP_STATUS_WRONG_FORMAT)
+    {
+      zlog_warn ("isis_tx_ring_queue(): a frame on %s was not sent",
+		 circuit->interface->name);
+      frame->tp_status = TP_STATUS_AVAILABLE;
+    }
+  /* The ring is full: it is sent now, and the frame has to be free. */
+  if (frame->tp_status != TP_STATUS_AVAILABLE)
+    isis_tx_ring_send (circuit, 0);
+  if (frame->tp_status != TP_STATUS_AVAILABLE)
+    return ISIS_WARNING;
+
+  /* an 802.3 header, with the length, then the LLC */
+  data = ISIS_TX_FRAME_DATA (frame);
+  memcpy (data, dst, ETH_ALEN);
+  memcpy (data + ETH_ALEN, circuit->interface->hw_addr, ETH_ALEN);
+  data[2 * ETH_ALEN] = (len + LLC_LEN) >> 8;
+  data[2 * ETH_ALEN + 1] = (len + LLC_LEN) & 0xff;
+  data[ETH_HLEN] = ISO_SAP;
+  data[ETH_HLEN + 1] = ISO_SAP;
+  data[ETH_HLEN + 2] = 0x03;
+  memcpy (data + ETH_HLEN + LLC_LEN, circuit->snd_stream->data, len);
+  frame->tp_len = ETH_HLEN + LLC_LEN + len;
+  __sync_synchronize ();
+  frame->tp_status = TP_STATUS_SEND_REQUEST;
+  ring->next = (ring->next + 1) % ring->frame_nr;
+
+  if (circuit->t_tx_flush == NULL)
+    circuit->t_tx_flush = thread_add_event (master, isis_tx_ring_flush,
+					    circuit, 0);
+  return ISIS_OK;
+}
+#endif /* PACKET_RX_RING && TPACKET3_HDRLEN */
+
 /*
  * if level is 0 we are joining p2p multicast
  * FIXME: and the p2p multicast being ???
@@ -109,13 +372,23 @@ open_packet_socket (struct isis_circuit *circuit)
   struct sockaddr_ll s_addr;
   int fd, retval = ISIS_OK;
 
-  fd = socket (PF_PACKET, SOCK_DGRAM, htons (ETH_P_ALL));
+  /* It receives once bound to the protocol. */
+  fd = socket (PF_PACKET, SOCK_DGRAM, 0);
   if (fd < 0)
     {
       zlog_warn ("open_packet_socket(): socket() failed %s",
 		 safe_strerror (errno));
       return ISIS_WARNING;
     }
+  circuit->fd = fd;
+
+#ifdef ISIS_RING
+  if (if_is_broadcast (circuit->interface))
+    {
+      isis_rx_ring_open (circuit);
+      isis_tx_ring_open (circuit);
+    }
+#endif /* ISIS_RING */
 
   /*
    * Bind to the physical interface
@@ -129,12 +402,10 @@ open_packet_socket (struct isis_circuit *circuit)
 	    sizeof (struct sockaddr_ll)) < 0)
     {
       zlog_warn ("open_packet_socket(): bind() failed: %s", safe_strerror (errno));
-      close (fd);
+      isis_sock_close (circuit);
       return ISIS_WARNING;
     }
 
-  circuit->fd = fd;
-
   if (if_is_broadcast (circuit->interface))
     {
       /*
@@ -186,6 +457,10 @@ isis_sock_init (struct isis_circuit *circuit)
     {
       circuit->tx = isis_send_pdu_bcast;
       circuit->rx = isis_recv_pdu_bcast;
+#ifdef ISIS_RING
+      if (circuit->rx_ring)
+	circuit->rx = isis_recv_pdu_ring;
+#endif /* ISIS_RING */
     }
   else if (if_is_pointopoint (circuit->interface))
     {
@@ -273,6 +548,62 @@ isis_recv_pdu_bcast (struct isis_circuit *circuit, u_char * ssnpa)
   return ISIS_OK;
 }
 
+#ifdef ISIS_RING
+static int
+isis_recv_pdu_ring (struct isis_circuit *circuit, u_char * ssnpa)
+{
+  struct isis_ring *ring = circuit->rx_ring;
+  struct tpacket3_hdr *frame;
+  struct sockaddr_ll *s_addr;
+  u_char *llc;
+  size_t len;
+  int retval = ISIS_WARNING;
+
+  frame = isis_rx_ring_frame (ring);
+  if (frame == NULL)
+    return ISIS_WARNING;
+
+  s_addr = (struct sockaddr_ll *)
+    ((u_char *) frame + TPACKET_ALIGN (sizeof (struct tpacket3_hdr)));
+  llc = (u_char *) frame + frame->tp_mac;
+
+  /*
+   * Filtering by llc field, discard packets sent by this host (other circuit)
+   */
+  if (frame->tp_snaplen >= LLC_LEN && llc_check (llc)
+      && s_addr->sll_pkttype != PACKET_OUTGOING)
+    {
+      /* we lose the LLC */
+      len = frame->tp_snaplen - LLC_LEN;
+      if (len > STREAM_WRITEABLE (circuit->rcv_stream))
+	len = STREAM_WRITEABLE (circuit->rcv_stream);
+      stream_write (circuit->rcv_stream, llc + LLC_LEN, len);
+      memcpy (ssnpa, &s_addr->sll_addr, ETH_ALEN);
+      retval = ISIS_OK;
+    }
+
+  isis_rx_ring_done (ring);
+  return retval;
+}
+#endif /* ISIS_RING */
+
+/* Whether isis_receive() can take another PDU without waiting. */
+int
+isis_recv_pending (struct isis_circuit *circuit)
+{
+#ifdef ISIS_RING
+  struct isis_ring *ring = circuit->rx_ring;
+
+  if (ring == NULL)
+    return 0;
+  return (ring->left > 0
+	  || (ISIS_RING_BLOCK (ring, ring->next)->hdr.bh1.block_status
+	      & TP_STATUS_USER));
+#else
+  return 0;
+#endif /* ISIS_RING */
+}
+
 int
 isis_recv_pdu_p2p (struct isis_circuit *circuit, u_char * ssnpa)
 {
@@ -340,6 +671,17 @@ isis_send_pdu_bcast (struct isis_circuit *circuit, int level)
   else
     memcpy (&sa.sll_addr, ALL_L2_ISS, ETH_ALEN);
 
+#ifdef ISIS_RING
+  if (circuit->tx_ring)
+    {
+      if (isis_tx_ring_queue (circuit, sa.sll_addr) == ISIS_OK)
+	return ISIS_OK;
+      /* keep the order of what is queued */
+      if (circuit->t_tx_flush)
+	isis_tx_ring_send (circuit, 0);
+    }
+#endif /* ISIS_RING */
+
   /* on a broadcast circuit */
   /* first we put the LLC in */
   sock_buff[0] = 0xFE;
@@ -389,4 +731,27 @@ isis_send_pdu_p2p (struct isis_circuit *circuit, int level)
   return ISIS_OK;
 }
 
+void
+isis_sock_close (struct isis_circuit *circuit)
+{
+#ifdef ISIS_RING
+  if (circuit->tx_ring)
+    {
+      /* what is queued, as the last hellos, still goes out */
+      if (circuit->t_tx_flush)
+	isis_tx_ring_send (circuit, 0);
+      close (circuit->tx_ring->fd);
+      isis_ring_unmap (circuit->tx_ring);
+      circuit->tx_ring = NULL;
+    }
+  if (circuit->rx_ring)
+    {
+      isis_ring_unmap (circuit->rx_ring);
+      circuit->rx_ring = NULL;
+    }
+#endif /* ISIS_RING */
+  close (circuit->fd);
+  circuit->fd = 0;
+}
+
 #endif /* ISIS_METHOD == ISIS_METHOD_PFPACKET */
@@ -33,6 +33,7 @@
 #include "hash.h"
 #include "if.h"
 #include "table.h"
+#include "zclient.h"
 
 #include "isis_constants.h"
 #include "isis_common.h"
@@ -409,11 +410,36 @@ isis_route_info_same (struct isis_route_info *new,
   return 1;
 }
 
+/* Take a route off the lists of its spftree. */
+static void
+isis_route_unlist (struct isis_spftree *spftree, struct isis_route_info *rinfo)
+{
+  if (rinfo->run == spftree->runcount + 1)
+    ilist_delete (&spftree->routes, &rinfo->node);
+  else
+    ilist_delete (&spftree->stale, &rinfo->node);
+  if (CHECK_FLAG (rinfo->flag, ISIS_ROUTE_FLAG_CHANGED))
+    {
+      ilist_delete (&spftree->changes, &rinfo->change_node);
+      UNSET_FLAG (rinfo->flag, ISIS_ROUTE_FLAG_CHANGED);
+    }
+}
+
+static void
+isis_route_changed (struct isis_spftree *spftree, struct isis_route_info *rinfo)
+{
+  if (CHECK_FLAG (rinfo->flag, ISIS_ROUTE_FLAG_CHANGED))
+    return;
+  SET_FLAG (rinfo->flag, ISIS_ROUTE_FLAG_CHANGED);
+  ilist_add (&spftree->changes, &rinfo->change_node);
+}
+
 struct isis_route_info *
 isis_route_create (struct prefix *prefix, u_int32_t cost, u_int32_t depth,
-		   struct list *adjacencies, struct isis_area *area,
+		   struct list *adjacencies, struct isis_spftree *spftree,
 		   int level)
 {
+  struct isis_area *area = spftree->area;
   struct route_node *route_node;
   struct isis_route_info *rinfo_new, *rinfo_old, *route_info = NULL;
   u_char buff[BUFSIZ];
@@ -453,6 +479,10 @@ isis_route_create (struct prefix *prefix, u_int32_t cost, u_int32_t depth,
     }
   else
     {
+      /* The node is held by the route already. */
+      route_unlock_node (route_node);
+      isis_route_unlist (spftree, rinfo_old);
+
       if (isis->debugs & DEBUG_RTE_EVENTS)
         zlog_debug ("ISIS-Rte (%s) route already exists: %s", area->area_tag,
                    buff);
@@ -477,6 +507,11 @@ isis_route_create (struct prefix *prefix, u_int32_t cost, u_int32_t depth,
 
   SET_FLAG (route_info->flag, ISIS_ROUTE_FLAG_ACTIVE);
   route_node->info = route_info;
+  route_info->rn = route_node;
+  route_info->run = spftree->runcount + 1;
+  ilist_add (&spftree->routes, &route_info->node);
+  if (!CHECK_FLAG (route_info->flag, ISIS_ROUTE_FLAG_ZEBRA_SYNCED))
+    isis_route_changed (spftree, route_info);
 
   return route_info;
 }
@@ -515,6 +550,153 @@ isis_route_delete (struct prefix *prefix, struct route_table *table)
   return;
 }
 
+/* At the start of an SPF run, all the routes of the last one are stale:
+ * isis_route_create() takes those it finds again back, and those left are
+ * gone after the run. */
+void
+isis_route_stale (struct isis_spftree *spftree)
+{
+  assert (spftree->stale.count == 0);
+  spftree->stale = spftree->routes;
+  memset (&spftree->routes, 0, sizeof (struct ilist));
+}
+
+static struct route_table *
+isis_route_table (struct isis_area *area, int family, int level)
+{
+  if (family == AF_INET)
+    return area->route_table[level - 1];
+#ifdef HAVE_IPV6
+  else if (family == AF_INET6)
+    return area->route_table6[level - 1];
+#endif
+  return NULL;
+}
+
+static struct isis_spftree *
+isis_route_spftree (struct isis_area *area, int family, int level)
+{
+  if (family == AF_INET)
+    return area->spftree[level - 1];
+#ifdef HAVE_IPV6
+  else if (family == AF_INET6)
+    return area->spftree6[level - 1];
+#endif
+  return NULL;
+}
+
+/* Bring zebra up to date for one prefix.  Of an L1L2 area, the route of
+ * both levels is looked at: L1 routes are preferred over the L2 ones, and
+ * zebra has one IS-IS route for a prefix, so adding the preferred route
+ * replaces the other.  A route zebra could not take stays on the changes
+ * of its spftree for the next run. */
+static void
+isis_route_sync (struct isis_area *area, struct prefix *prefix)
+{
+  struct isis_route_info *rinfo[ISIS_LEVELS], *best = NULL;
+  struct isis_spftree *spftree;
+  struct route_table *table;
+  struct route_node *rn;
+  int level, best_level = 0;
+
+  for (level = IS_LEVEL_1; level <= IS_LEVEL_2; level++)
+    {
+      rinfo[level - 1] = NULL;
+      if (!(area->is_type & level))
+	continue;
+      table = isis_route_table (area, prefix->family, level);
+      if (table == NULL || (rn = route_node_lookup (table, prefix)) == NULL)
+	continue;
+      route_unlock_node (rn);
+      rinfo[level - 1] = rn->info;
+      if (best == NULL && rn->info
+	  && CHECK_FLAG (rinfo[level - 1]->flag, ISIS_ROUTE_FLAG_ACTIVE))
+	{
+	  best = rinfo[level - 1];
+	  best_level = level;
+	}
+    }
+
+  for (level = IS_LEVEL_1; level <= IS_LEVEL_2; level++)
+    {
+      if (rinfo[level - 1] == NULL || rinfo[level - 1] == best
+	  || !CHECK_FLAG (rinfo[level - 1]->flag, ISIS_ROUTE_FLAG_ZEBRA_SYNCED))
+	continue;
+      if (best)
+	UNSET_FLAG (rinfo[level - 1]->flag, ISIS_ROUTE_FLAG_ZEBRA_SYNCED);
+      else
+	isis_zebra_route_update (prefix, rinfo[level - 1]);
+    }
+
+  if (best == NULL)
+    return;
+  isis_zebra_route_update (prefix, best);
+  if (!CHECK_FLAG (best->flag, ISIS_ROUTE_FLAG_ZEBRA_SYNCED)
+      && (spftree = isis_route_spftree (area, prefix->family, best_level)))
+    isis_route_changed (spftree, best);
+}
+
+/* After an SPF run, propagate the routes it changed into RIB, and delete
+ * the routes it did not find again: the rest of the tables is left. */
+void
+isis_route_validate_spftree (struct isis_spftree *spftree)
+{
+  struct isis_area *area = spftree->area;
+  struct isis_route_info *rinfo;
+  struct ilist changes;
+  struct ilistnode *node, *nnode;
+  struct listnode *cnode;
+  struct isis_circuit *circuit;
+  u_char buff[BUFSIZ];
+
+  for (ALL_ILIST_ELEMENTS_RO (&spftree->stale, node, rinfo,
+			      struct isis_route_info, node))
+    UNSET_FLAG (rinfo->flag, ISIS_ROUTE_FLAG_ACTIVE);
+
+  zclient_cork (zclient);
+
+  changes = spftree->changes;
+  memset (&spftree->changes, 0, sizeof (struct ilist));
+  for (ALL_ILIST_ELEMENTS (&changes, node, nnode, rinfo,
+			   struct isis_route_info, change_node))
+    {
+      ilist_delete (&changes, node);
+      UNSET_FLAG (rinfo->flag, ISIS_ROUTE_FLAG_CHANGED);
+      if (isis->debugs & DEBUG_RTE_EVENTS)
+	{
+	  prefix2str (&rinfo->rn->p, (char *) buff, BUFSIZ);
+	  zlog_debug ("ISIS-Rte (%s): route validate: %s %s", area->area_tag,
+		      (CHECK_FLAG (rinfo->flag, ISIS_ROUTE_FLAG_ACTIVE) ?
+		      "active" : "inactive"), buff);
+	}
+      isis_route_sync (area, &rinfo->rn->p);
+    }
+
+  while (spftree->stale.head)
+    {
+      rinfo = ilist_entry (spftree->stale.head, struct isis_route_info, node);
+      isis_route_unlist (spftree, rinfo);
+      rinfo->rn->info = NULL;
+      if (isis->debugs & DEBUG_RTE_EVENTS)
+	{
+	  prefix2str (&rinfo->rn->p, (char *) buff, BUFSIZ);
+	  zlog_debug ("ISIS-Rte (%s): route delete %s", area->area_tag, buff);
+	}
+      /* zebra is told of the route of the other level, if there is one */
+      if (CHECK_FLAG (rinfo->flag, ISIS_ROUTE_FLAG_ZEBRA_SYNCED))
+	isis_zebra_route_update (&rinfo->rn->p, rinfo);
+      isis_route_sync (area, &rinfo->rn->p);
+      route_unlock_node (rinfo->rn);
+      isis_route_info_delete (rinfo);
+    }
+
+  zclient_uncork (zclient);
+
+  /* walk all circuits and reset any spf specific flags */
+  for (ALL_LIST_ELEMENTS_RO (area->circuit_list, cnode, circuit))
+    UNSET_FLAG(circuit->flags, ISIS_CIRCUIT_FLAPPED_AFTER_SPF);
+}
+
 /* Validating routes in particular table. */
 static void
 isis_route_validate_table (struct isis_area *area, struct route_table *table)
@@ -48,6 +48,7 @@ struct isis_route_info
 #define ISIS_ROUTE_FLAG_ACTIVE       0x01  /* active route for the prefix */
 #define ISIS_ROUTE_FLAG_ZEBRA_SYNCED 0x02  /* set when route synced to zebra */
 #define ISIS_ROUTE_FLAG_ZEBRA_RESYNC 0x04  /* set when route needs to sync */
+#define ISIS_ROUTE_FLAG_CHANGED      0x08  /* on the changes of its spftree */
   u_char flag;
   u_int32_t cost;
   u_int32_t depth;
@@ -55,13 +56,22 @@ struct isis_route_info
 #ifdef HAVE_IPV6
   struct list *nexthops6;
 #endif				/* HAVE_IPV6 */
+  struct route_node *rn;	/* of the level route table, for the prefix */
+  unsigned int run;		/* the SPF run which found it last */
+  struct ilistnode node;	/* on the routes or stale of its spftree */
+  struct ilistnode change_node;	/* on the changes of its spftree */
 };
 
+struct isis_spftree;
+
 struct isis_route_info *isis_route_create (struct prefix *prefix,
 					   u_int32_t cost, u_int32_t depth,
 					   struct list *adjacencies,
-					   struct isis_area *area, int level);
+					   struct isis_spftree *spftree,
+					   int level);
 
+void isis_route_stale (struct isis_spftree *spftree);
+void isis_route_validate_spftree (struct isis_spftree *spftree);
 void isis_route_validate (struct isis_area *area);
 void isis_route_invalidate_table (struct isis_area *area,
                                   struct route_table *table);
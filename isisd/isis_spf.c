@@ -31,8 +31,12 @@
 #include "memory.h"
 #include "prefix.h"
 #include "hash.h"
+#include "jhash.h"
+#include "pqueue.h"
+#include "spf_backoff.h"
 #include "if.h"
 #include "table.h"
+#include "trace.h"
 
 #include "isis_constants.h"
 #include "isis_common.h"
@@ -183,18 +187,10 @@ vid2string (struct isis_vertex *vertex, u_char * buff)
   return (char *) buff;
 }
 
-static struct isis_vertex *
-isis_vertex_new (void *id, enum vertextype vtype)
+static void
+isis_vertex_id_init (struct isis_vertex *vertex, void *id,
+		     enum vertextype vtype)
 {
-  struct isis_vertex *vertex;
-
-  vertex = XCALLOC (MTYPE_ISIS_VERTEX, sizeof (struct isis_vertex));
-  if (vertex == NULL)
-    {
-      zlog_err ("isis_vertex_new Out of memory!");
-      return NULL;
-    }
-
   vertex->type = vtype;
   switch (vtype)
     {
@@ -220,7 +216,22 @@ isis_vertex_new (void *id, enum vertextype vtype)
     default:
       zlog_err ("WTF!");
     }
+}
 
+static struct isis_vertex *
+isis_vertex_new (void *id, enum vertextype vtype)
+{
+  struct isis_vertex *vertex;
+
+  vertex = XCALLOC (MTYPE_ISIS_VERTEX, sizeof (struct isis_vertex));
+  if (vertex == NULL)
+    {
+      zlog_err ("isis_vertex_new Out of memory!");
+      return NULL;
+    }
+
+  isis_vertex_id_init (vertex, id, vtype);
+  vertex->tent_pos = -1;
   vertex->Adj_N = list_new ();
   vertex->parents = list_new ();
   vertex->children = list_new ();
@@ -259,6 +270,78 @@ isis_vertex_adj_del (struct isis_vertex *vertex, struct isis_adjacency *adj)
   return;
 }
 
+/*
+ * TENT is a heap by d(N), tie broken by vertextype
+ */
+static int
+isis_vertex_tent_cmp (void *a, void *b)
+{
+  struct isis_vertex *va = a, *vb = b;
+
+  if (va->d_N != vb->d_N)
+    return (va->d_N < vb->d_N ? -1 : 1);
+  if (va->type != vb->type)
+    return (va->type < vb->type ? -1 : 1);
+  return 0;
+}
+
+static void
+isis_vertex_tent_update (void *node, int pos)
+{
+  ((struct isis_vertex *) node)->tent_pos = pos;
+}
+
+/*
+ * Vertices on PATHS or TENT are indexed by vertextype and id
+ */
+static unsigned int
+isis_vertex_hash_key (void *data)
+{
+  struct isis_vertex *vertex = data;
+  struct prefix *p;
+
+  switch (vertex->type)
+    {
+    case VTYPE_ES:
+    case VTYPE_NONPSEUDO_IS:
+    case VTYPE_NONPSEUDO_TE_IS:
+      return jhash (vertex->N.id, ISIS_SYS_ID_LEN, vertex->type);
+    case VTYPE_PSEUDO_IS:
+    case VTYPE_PSEUDO_TE_IS:
+      return jhash (vertex->N.id, ISIS_SYS_ID_LEN + 1, vertex->type);
+    default:
+      p = &vertex->N.prefix;
+      return jhash (&p->u.prefix, PSIZE (p->prefixlen),
+		    (vertex->type << 16) | (p->family << 8) | p->prefixlen);
+    }
+}
+
+static int
+isis_vertex_hash_cmp (const void *a, const void *b)
+{
+  const struct isis_vertex *va = a, *vb = b;
+  const struct prefix *p1, *p2;
+
+  if (va->type != vb->type)
+    return 0;
+  switch (va->type)
+    {
+    case VTYPE_ES:
+    case VTYPE_NONPSEUDO_IS:
+    case VTYPE_NONPSEUDO_TE_IS:
+      return memcmp (va->N.id, vb->N.id, ISIS_SYS_ID_LEN) == 0;
+    case VTYPE_PSEUDO_IS:
+    case VTYPE_PSEUDO_TE_IS:
+      return memcmp (va->N.id, vb->N.id, ISIS_SYS_ID_LEN + 1) == 0;
+    default:
+      p1 = &va->N.prefix;
+      p2 = &vb->N.prefix;
+      return (p1->family == p2->family && p1->prefixlen == p2->prefixlen &&
+	      memcmp (&p1->u.prefix, &p2->u.prefix,
+		      PSIZE (p1->prefixlen)) == 0);
+    }
+}
+
 struct isis_spftree *
 isis_spftree_new (struct isis_area *area)
 {
@@ -271,28 +354,54 @@ isis_spftree_new (struct isis_area *area)
       return NULL;
     }
 
-  tree->tents = list_new ();
-  tree->paths = list_new ();
+  tree->tents = pqueue_create ();
+  tree->tents->cmp = isis_vertex_tent_cmp;
+  tree->tents->update = isis_vertex_tent_update;
+  tree->vertices = hash_create_open (1024, isis_vertex_hash_key,
+				     isis_vertex_hash_cmp);
   tree->area = area;
   tree->last_run_timestamp = 0;
   tree->last_run_duration = 0;
   tree->runcount = 0;
+  tree->prc_runcount = 0;
   tree->pending = 0;
+  tree->full = 1;
   return tree;
 }
 
+/*
+ * Free all vertices on PATHS and TENT
+ */
+static void
+isis_spftree_clear (struct isis_spftree *spftree)
+{
+  struct isis_vertex *vertex;
+  int i;
+
+  hash_clean (spftree->vertices, NULL);
+  for (i = 0; i < spftree->tents->size; i++)
+    isis_vertex_del (spftree->tents->array[i]);
+  spftree->tents->size = 0;
+  while (spftree->paths.head)
+    {
+      vertex = ilist_entry (spftree->paths.head, struct isis_vertex,
+			    path_node);
+      ilist_delete (&spftree->paths, &vertex->path_node);
+      isis_vertex_del (vertex);
+    }
+}
+
 void
 isis_spftree_del (struct isis_spftree *spftree)
 {
   THREAD_TIMER_OFF (spftree->t_spf);
 
-  spftree->tents->del = (void (*)(void *)) isis_vertex_del;
-  list_delete (spftree->tents);
-  spftree->tents = NULL;
+  isis_spftree_clear (spftree);
 
-  spftree->paths->del = (void (*)(void *)) isis_vertex_del;
-  list_delete (spftree->paths);
-  spftree->paths = NULL;
+  pqueue_delete (spftree->tents);
+  spftree->tents = NULL;
+  hash_free (spftree->vertices);
+  spftree->vertices = NULL;
 
   XFREE (MTYPE_ISIS_SPFTREE, spftree);
 
@@ -302,13 +411,16 @@ isis_spftree_del (struct isis_spftree *spftree)
 void
 isis_spftree_adj_del (struct isis_spftree *spftree, struct isis_adjacency *adj)
 {
-  struct listnode *node;
+  struct ilistnode *node;
+  struct isis_vertex *vertex;
+  int i;
   if (!adj)
     return;
-  for (node = listhead (spftree->tents); node; node = listnextnode (node))
-    isis_vertex_adj_del (listgetdata (node), adj);
-  for (node = listhead (spftree->paths); node; node = listnextnode (node))
-    isis_vertex_adj_del (listgetdata (node), adj);
+  for (i = 0; i < spftree->tents->size; i++)
+    isis_vertex_adj_del (spftree->tents->array[i], adj);
+  for (ALL_ILIST_ELEMENTS_RO (&spftree->paths, node, vertex,
+			      struct isis_vertex, path_node))
+    isis_vertex_adj_del (vertex, adj);
   return;
 }
 
@@ -442,7 +554,8 @@ isis_spf_add_root (struct isis_spftree *spftree, int level, u_char *sysid)
   else
     vertex = isis_vertex_new (sysid, VTYPE_NONPSEUDO_IS);
 
-  listnode_add (spftree->paths, vertex);
+  ilist_add (&spftree->paths, &vertex->path_node);
+  hash_get (spftree->vertices, vertex, hash_alloc_intern);
 
 #ifdef EXTREME_DEBUG
   zlog_debug ("ISIS-Spf: added this IS  %s %s depth %d dist %d to PATHS",
@@ -454,69 +567,40 @@ isis_spf_add_root (struct isis_spftree *spftree, int level, u_char *sysid)
 }
 
 static struct isis_vertex *
-isis_find_vertex (struct list *list, void *id, enum vertextype vtype)
+isis_find_vertex (struct isis_spftree *spftree, void *id,
+		  enum vertextype vtype)
 {
-  struct listnode *node;
-  struct isis_vertex *vertex;
-  struct prefix *p1, *p2;
+  struct isis_vertex key;
 
-  for (ALL_LIST_ELEMENTS_RO (list, node, vertex))
-    {
-      if (vertex->type != vtype)
-	continue;
-      switch (vtype)
-	{
-	case VTYPE_ES:
-	case VTYPE_NONPSEUDO_IS:
-	case VTYPE_NONPSEUDO_TE_IS:
-	  if (memcmp ((u_char *) id, vertex->N.id, ISIS_SYS_ID_LEN) == 0)
-	    return vertex;
-	  break;
-	case VTYPE_PSEUDO_IS:
-	case VTYPE_PSEUDO_TE_IS:
-	  if (memcmp ((u_char *) id, vertex->N.id, ISIS_SYS_ID_LEN + 1) == 0)
-	    return vertex;
-	  break;
-	case VTYPE_IPREACH_INTERNAL:
-	case VTYPE_IPREACH_EXTERNAL:
-	case VTYPE_IPREACH_TE:
-#ifdef HAVE_IPV6
-	case VTYPE_IP6REACH_INTERNAL:
-	case VTYPE_IP6REACH_EXTERNAL:
-#endif /* HAVE_IPV6 */
-	  p1 = (struct prefix *) id;
-	  p2 = (struct prefix *) &vertex->N.id;
-	  if (p1->family == p2->family && p1->prefixlen == p2->prefixlen &&
-	      memcmp (&p1->u.prefix, &p2->u.prefix,
-		      PSIZE (p1->prefixlen)) == 0)
-	    return vertex;
-	  break;
-	}
-    }
+  memset (&key, 0, sizeof (key));
+  isis_vertex_id_init (&key, id, vtype);
+  return hash_lookup (spftree->vertices, &key);
+}
 
-  return NULL;
+static struct isis_vertex *
+isis_find_path (struct isis_spftree *spftree, void *id, enum vertextype vtype)
+{
+  struct isis_vertex *vertex;
+
+  vertex = isis_find_vertex (spftree, id, vtype);
+  return (vertex && vertex->tent_pos < 0) ? vertex : NULL;
 }
 
-/*
- * Add a vertex to TENT sorted by cost and by vertextype on tie break situation
- */
 static struct isis_vertex *
-isis_spf_add2tent (struct isis_spftree *spftree, enum vertextype vtype,
-		   void *id, uint32_t cost, int depth, int family,
-		   struct isis_adjacency *adj, struct isis_vertex *parent)
+isis_find_tent (struct isis_spftree *spftree, void *id, enum vertextype vtype)
+{
+  struct isis_vertex *vertex;
+
+  vertex = isis_find_vertex (spftree, id, vtype);
+  return (vertex && vertex->tent_pos >= 0) ? vertex : NULL;
+}
+
+static void
+isis_vertex_add_parent (struct isis_vertex *vertex,
+			struct isis_adjacency *adj, struct isis_vertex *parent)
 {
-  struct isis_vertex *vertex, *v;
   struct listnode *node;
   struct isis_adjacency *parent_adj;
-#ifdef EXTREME_DEBUG
-  u_char buff[BUFSIZ];
-#endif
-
-  assert (isis_find_vertex (spftree->paths, id, vtype) == NULL);
-  assert (isis_find_vertex (spftree->tents, id, vtype) == NULL);
-  vertex = isis_vertex_new (id, vtype);
-  vertex->d_N = cost;
-  vertex->depth = depth;
 
   if (parent) {
     listnode_add (vertex->parents, parent);
@@ -530,6 +614,26 @@ isis_spf_add2tent (struct isis_spftree *spftree, enum vertextype vtype,
   } else if (adj) {
     listnode_add (vertex->Adj_N, adj);
   }
+}
+
+/*
+ * Add a vertex to TENT, sorted by cost and by vertextype on tie break
+ */
+static struct isis_vertex *
+isis_spf_add2tent (struct isis_spftree *spftree, enum vertextype vtype,
+		   void *id, uint32_t cost, int depth, int family,
+		   struct isis_adjacency *adj, struct isis_vertex *parent)
+{
+  struct isis_vertex *vertex;
+#ifdef EXTREME_DEBUG
+  u_char buff[BUFSIZ];
+#endif
+
+  assert (isis_find_vertex (spftree, id, vtype) == NULL);
+  vertex = isis_vertex_new (id, vtype);
+  vertex->d_N = cost;
+  vertex->depth = depth;
+  isis_vertex_add_parent (vertex, adj, parent);
 
 #ifdef EXTREME_DEBUG
   zlog_debug ("ISIS-Spf: add to TENT %s %s %s depth %d dist %d adjcount %d",
@@ -538,33 +642,35 @@ isis_spf_add2tent (struct isis_spftree *spftree, enum vertextype vtype,
 	      vertex->depth, vertex->d_N, listcount(vertex->Adj_N));
 #endif /* EXTREME_DEBUG */
 
-  if (list_isempty (spftree->tents))
-    {
-      listnode_add (spftree->tents, vertex);
-      return vertex;
-    }
+  hash_get (spftree->vertices, vertex, hash_alloc_intern);
+  pqueue_enqueue (vertex, spftree->tents);
 
-  /* XXX: This cant use the standard ALL_LIST_ELEMENTS macro */
-  for (node = listhead (spftree->tents); node; node = listnextnode (node))
-    {
-      v = listgetdata (node);
-      if (v->d_N > vertex->d_N)
-	{
-	  list_add_node_prev (spftree->tents, node, vertex);
-	  break;
-	}
-      else if (v->d_N == vertex->d_N && v->type > vertex->type)
-	{
-	  /*  Tie break, add according to type */
-          list_add_node_prev (spftree->tents, node, vertex);
-	  break;
-	}
-    }
+  return vertex;
+}
 
-  if (node == NULL)
-      listnode_add (spftree->tents, vertex);
+/*
+ * A shorter path to a vertex on TENT was found: it replaces the ones
+ * known, and the vertex moves up TENT.
+ */
+static void
+isis_spf_tent_decrease (struct isis_spftree *spftree,
+			struct isis_vertex *vertex, uint32_t cost, int depth,
+			struct isis_adjacency *adj, struct isis_vertex *parent)
+{
+  struct listnode *pnode, *pnextnode;
+  struct isis_vertex *pvertex;
 
-  return vertex;
+  assert (cost < vertex->d_N);
+  assert (listcount (vertex->children) == 0);
+  for (ALL_LIST_ELEMENTS (vertex->parents, pnode, pnextnode, pvertex))
+    listnode_delete (pvertex->children, vertex);
+  list_delete_all_node (vertex->parents);
+  list_delete_all_node (vertex->Adj_N);
+
+  vertex->d_N = cost;
+  vertex->depth = depth;
+  isis_vertex_add_parent (vertex, adj, parent);
+  trickle_up (vertex->tent_pos, spftree->tents);
 }
 
 static void
@@ -574,7 +680,7 @@ isis_spf_add_local (struct isis_spftree *spftree, enum vertextype vtype,
 {
   struct isis_vertex *vertex;
 
-  vertex = isis_find_vertex (spftree->tents, id, vtype);
+  vertex = isis_find_tent (spftree, id, vtype);
 
   if (vertex)
     {
@@ -599,13 +705,8 @@ isis_spf_add_local (struct isis_spftree *spftree, enum vertextype vtype,
 	}
       else {  /* vertex->d_N > cost */
 	  /*         f) */
-	  struct listnode *pnode, *pnextnode;
-	  struct isis_vertex *pvertex;
-	  listnode_delete (spftree->tents, vertex);
-	  assert (listcount (vertex->children) == 0);
-	  for (ALL_LIST_ELEMENTS (vertex->parents, pnode, pnextnode, pvertex))
-	    listnode_delete(pvertex->children, vertex);
-	  isis_vertex_del (vertex);
+	  isis_spf_tent_decrease (spftree, vertex, cost, 1, adj, parent);
+	  return;
       }
     }
 
@@ -639,7 +740,7 @@ process_N (struct isis_spftree *spftree, enum vertextype vtype, void *id,
     }
 
   /*       c)    */
-  vertex = isis_find_vertex (spftree->paths, id, vtype);
+  vertex = isis_find_path (spftree, id, vtype);
   if (vertex)
     {
 #ifdef EXTREME_DEBUG
@@ -651,7 +752,7 @@ process_N (struct isis_spftree *spftree, enum vertextype vtype, void *id,
       return;
     }
 
-  vertex = isis_find_vertex (spftree->tents, id, vtype);
+  vertex = isis_find_tent (spftree, id, vtype);
   /*       d)    */
   if (vertex)
     {
@@ -687,13 +788,8 @@ process_N (struct isis_spftree *spftree, enum vertextype vtype, void *id,
 	}
       else
 	{
-	  struct listnode *pnode, *pnextnode;
-	  struct isis_vertex *pvertex;
-	  listnode_delete (spftree->tents, vertex);
-	  assert (listcount (vertex->children) == 0);
-	  for (ALL_LIST_ELEMENTS (vertex->parents, pnode, pnextnode, pvertex))
-	    listnode_delete(pvertex->children, vertex);
-	  isis_vertex_del (vertex);
+	  isis_spf_tent_decrease (spftree, vertex, dist, depth, NULL, parent);
+	  return;
 	}
     }
 
@@ -708,17 +804,16 @@ process_N (struct isis_spftree *spftree, enum vertextype vtype, void *id,
 }
 
 /*
- * C.2.6 Step 1
+ * The prefixes of one LSP fragment, all leaves of the tree
  */
-static int
-isis_spf_process_lsp (struct isis_spftree *spftree, struct isis_lsp *lsp,
-		      uint32_t cost, uint16_t depth, int family,
-		      u_char *root_sysid, struct isis_vertex *parent)
+static void
+isis_spf_process_lsp_prefixes (struct isis_spftree *spftree,
+			       struct isis_lsp *lsp, uint32_t cost,
+			       uint16_t depth, int family,
+			       struct isis_vertex *parent)
 {
-  struct listnode *node, *fragnode = NULL;
+  struct tlv_iter iter;
   uint32_t dist;
-  struct is_neigh *is_neigh;
-  struct te_is_neigh *te_is_neigh;
   struct ipv4_reachability *ipreach;
   struct te_ipv4_reachability *te_ipv4_reach;
   enum vertextype vtype;
@@ -726,63 +821,12 @@ isis_spf_process_lsp (struct isis_spftree *spftree, struct isis_lsp *lsp,
 #ifdef HAVE_IPV6
   struct ipv6_reachability *ip6reach;
 #endif /* HAVE_IPV6 */
-  static const u_char null_sysid[ISIS_SYS_ID_LEN];
-
-  if (!speaks (lsp->tlv_data.nlpids, family))
-    return ISIS_OK;
-
-lspfragloop:
-  if (lsp->lsp_header->seq_num == 0)
-    {
-      zlog_warn ("isis_spf_process_lsp(): lsp with 0 seq_num - ignore");
-      return ISIS_WARNING;
-    }
-
-#ifdef EXTREME_DEBUG
-      zlog_debug ("ISIS-Spf: process_lsp %s", print_sys_hostname(lsp->lsp_header->lsp_id));
-#endif /* EXTREME_DEBUG */
-
-  if (!ISIS_MASK_LSP_OL_BIT (lsp->lsp_header->lsp_bits))
-  {
-    if (lsp->tlv_data.is_neighs)
-    {
-      for (ALL_LIST_ELEMENTS_RO (lsp->tlv_data.is_neighs, node, is_neigh))
-      {
-        /* C.2.6 a) */
-        /* Two way connectivity */
-        if (!memcmp (is_neigh->neigh_id, root_sysid, ISIS_SYS_ID_LEN))
-          continue;
-        if (!memcmp (is_neigh->neigh_id, null_sysid, ISIS_SYS_ID_LEN))
-          continue;
-        dist = cost + is_neigh->metrics.metric_default;
-        vtype = LSP_PSEUDO_ID (is_neigh->neigh_id) ? VTYPE_PSEUDO_IS
-          : VTYPE_NONPSEUDO_IS;
-        process_N (spftree, vtype, (void *) is_neigh->neigh_id, dist,
-            depth + 1, family, parent);
-      }
-    }
-    if (lsp->tlv_data.te_is_neighs)
-    {
-      for (ALL_LIST_ELEMENTS_RO (lsp->tlv_data.te_is_neighs, node,
-            te_is_neigh))
-      {
-        if (!memcmp (te_is_neigh->neigh_id, root_sysid, ISIS_SYS_ID_LEN))
-          continue;
-        if (!memcmp (te_is_neigh->neigh_id, null_sysid, ISIS_SYS_ID_LEN))
-          continue;
-        dist = cost + GET_TE_METRIC(te_is_neigh);
-        vtype = LSP_PSEUDO_ID (te_is_neigh->neigh_id) ? VTYPE_PSEUDO_TE_IS
-          : VTYPE_NONPSEUDO_TE_IS;
-        process_N (spftree, vtype, (void *) te_is_neigh->neigh_id, dist,
-            depth + 1, family, parent);
-      }
-    }
-  }
 
-  if (family == AF_INET && lsp->tlv_data.ipv4_int_reachs)
+  if (family == AF_INET)
   {
     prefix.family = AF_INET;
-    for (ALL_LIST_ELEMENTS_RO (lsp->tlv_data.ipv4_int_reachs, node, ipreach))
+    for (ipreach = lsp_tlv_first (&iter, lsp->pdu, IPV4_INT_REACHABILITY);
+         ipreach; ipreach = tlv_iter_next (&iter))
     {
       dist = cost + ipreach->metrics.metric_default;
       vtype = VTYPE_IPREACH_INTERNAL;
@@ -793,10 +837,11 @@ lspfragloop:
                  family, parent);
     }
   }
-  if (family == AF_INET && lsp->tlv_data.ipv4_ext_reachs)
+  if (family == AF_INET)
   {
     prefix.family = AF_INET;
-    for (ALL_LIST_ELEMENTS_RO (lsp->tlv_data.ipv4_ext_reachs, node, ipreach))
+    for (ipreach = lsp_tlv_first (&iter, lsp->pdu, IPV4_EXT_REACHABILITY);
+         ipreach; ipreach = tlv_iter_next (&iter))
     {
       dist = cost + ipreach->metrics.metric_default;
       vtype = VTYPE_IPREACH_EXTERNAL;
@@ -807,11 +852,12 @@ lspfragloop:
                  family, parent);
     }
   }
-  if (family == AF_INET && lsp->tlv_data.te_ipv4_reachs)
+  if (family == AF_INET && spftree->area->newmetric)
   {
     prefix.family = AF_INET;
-    for (ALL_LIST_ELEMENTS_RO (lsp->tlv_data.te_ipv4_reachs,
-                               node, te_ipv4_reach))
+    for (te_ipv4_reach = lsp_tlv_first (&iter, lsp->pdu,
+                                        TE_IPV4_REACHABILITY);
+         te_ipv4_reach; te_ipv4_reach = tlv_iter_next (&iter))
     {
       assert ((te_ipv4_reach->control & 0x3F) <= IPV4_MAX_BITLEN);
 
@@ -826,10 +872,11 @@ lspfragloop:
     }
   }
 #ifdef HAVE_IPV6
-  if (family == AF_INET6 && lsp->tlv_data.ipv6_reachs)
+  if (family == AF_INET6)
   {
     prefix.family = AF_INET6;
-    for (ALL_LIST_ELEMENTS_RO (lsp->tlv_data.ipv6_reachs, node, ip6reach))
+    for (ip6reach = lsp_tlv_first (&iter, lsp->pdu, IPV6_REACHABILITY);
+         ip6reach; ip6reach = tlv_iter_next (&iter))
     {
       assert (ip6reach->prefix_len <= IPV6_MAX_BITLEN);
 
@@ -845,6 +892,74 @@ lspfragloop:
     }
   }
 #endif /* HAVE_IPV6 */
+}
+
+/*
+ * C.2.6 Step 1
+ */
+static int
+isis_spf_process_lsp (struct isis_spftree *spftree, struct isis_lsp *lsp,
+		      uint32_t cost, uint16_t depth, int family,
+		      u_char *root_sysid, struct isis_vertex *parent)
+{
+  struct listnode *fragnode = NULL;
+  struct tlv_iter iter;
+  uint32_t dist;
+  struct is_neigh *is_neigh;
+  struct te_is_neigh *te_is_neigh;
+  enum vertextype vtype;
+  static const u_char null_sysid[ISIS_SYS_ID_LEN];
+
+  if (!speaks (lsp->tlv_data.nlpids, family))
+    return ISIS_OK;
+
+lspfragloop:
+  if (lsp->lsp_header->seq_num == 0)
+    {
+      zlog_warn ("isis_spf_process_lsp(): lsp with 0 seq_num - ignore");
+      return ISIS_WARNING;
+    }
+
+#ifdef EXTREME_DEBUG
+      zlog_debug ("ISIS-Spf: process_lsp %s", print_sys_hostname(lsp->lsp_header->lsp_id));
+#endif /* EXTREME_DEBUG */
+
+  if (!ISIS_MASK_LSP_OL_BIT (lsp->lsp_header->lsp_bits))
+  {
+    for (is_neigh = lsp_tlv_first (&iter, lsp->pdu, IS_NEIGHBOURS);
+         is_neigh; is_neigh = tlv_iter_next (&iter))
+    {
+      /* C.2.6 a) */
+      /* Two way connectivity */
+      if (!memcmp (is_neigh->neigh_id, root_sysid, ISIS_SYS_ID_LEN))
+        continue;
+      if (!memcmp (is_neigh->neigh_id, null_sysid, ISIS_SYS_ID_LEN))
+        continue;
+      dist = cost + is_neigh->metrics.metric_default;
+      vtype = LSP_PSEUDO_ID (is_neigh->neigh_id) ? VTYPE_PSEUDO_IS
+        : VTYPE_NONPSEUDO_IS;
+      process_N (spftree, vtype, (void *) is_neigh->neigh_id, dist,
+          depth + 1, family, parent);
+    }
+    if (spftree->area->newmetric)
+    {
+      for (te_is_neigh = lsp_tlv_first (&iter, lsp->pdu, TE_IS_NEIGHBOURS);
+           te_is_neigh; te_is_neigh = tlv_iter_next (&iter))
+      {
+        if (!memcmp (te_is_neigh->neigh_id, root_sysid, ISIS_SYS_ID_LEN))
+          continue;
+        if (!memcmp (te_is_neigh->neigh_id, null_sysid, ISIS_SYS_ID_LEN))
+          continue;
+        dist = cost + GET_TE_METRIC(te_is_neigh);
+        vtype = LSP_PSEUDO_ID (te_is_neigh->neigh_id) ? VTYPE_PSEUDO_TE_IS
+          : VTYPE_NONPSEUDO_TE_IS;
+        process_N (spftree, vtype, (void *) te_is_neigh->neigh_id, dist,
+            depth + 1, family, parent);
+      }
+    }
+  }
+
+  isis_spf_process_lsp_prefixes (spftree, lsp, cost, depth, family, parent);
 
   if (fragnode == NULL)
     fragnode = listhead (lsp->lspu.frags);
@@ -867,7 +982,8 @@ isis_spf_process_pseudo_lsp (struct isis_spftree *spftree,
 			     u_char *root_sysid,
 			     struct isis_vertex *parent)
 {
-  struct listnode *node, *fragnode = NULL;
+  struct listnode *fragnode = NULL;
+  struct tlv_iter iter;
   struct is_neigh *is_neigh;
   struct te_is_neigh *te_is_neigh;
   enum vertextype vtype;
@@ -889,8 +1005,8 @@ pseudofragloop:
 
   /* RFC3787 section 4 SHOULD ignore overload bit in pseudo LSPs */
 
-  if (lsp->tlv_data.is_neighs)
-    for (ALL_LIST_ELEMENTS_RO (lsp->tlv_data.is_neighs, node, is_neigh))
+  for (is_neigh = lsp_tlv_first (&iter, lsp->pdu, IS_NEIGHBOURS);
+       is_neigh; is_neigh = tlv_iter_next (&iter))
       {
 	/* Two way connectivity */
 	if (!memcmp (is_neigh->neigh_id, root_sysid, ISIS_SYS_ID_LEN))
@@ -901,8 +1017,9 @@ pseudofragloop:
         process_N (spftree, vtype, (void *) is_neigh->neigh_id, dist,
             depth + 1, family, parent);
       }
-  if (lsp->tlv_data.te_is_neighs)
-    for (ALL_LIST_ELEMENTS_RO (lsp->tlv_data.te_is_neighs, node, te_is_neigh))
+  if (spftree->area->newmetric)
+    for (te_is_neigh = lsp_tlv_first (&iter, lsp->pdu, TE_IS_NEIGHBOURS);
+         te_is_neigh; te_is_neigh = tlv_iter_next (&iter))
       {
 	/* Two way connectivity */
 	if (!memcmp (te_is_neigh->neigh_id, root_sysid, ISIS_SYS_ID_LEN))
@@ -928,67 +1045,88 @@ pseudofragloop:
   return ISIS_OK;
 }
 
+/*
+ * Whether the circuit takes part in the SPF of this level and family
+ */
+static int
+isis_spf_circuit_usable (struct isis_circuit *circuit, int level, int family)
+{
+  if (circuit->state != C_STATE_UP)
+    return 0;
+  if (!(circuit->is_type & level))
+    return 0;
+  if (family == AF_INET && !circuit->ip_router)
+    return 0;
+#ifdef HAVE_IPV6
+  if (family == AF_INET6 && !circuit->ipv6_router)
+    return 0;
+#endif /* HAVE_IPV6 */
+  return 1;
+}
+
+/*
+ * Add IP(v6) addresses of this circuit
+ */
+static void
+isis_spf_add_circuit_prefixes (struct isis_spftree *spftree,
+			       struct isis_circuit *circuit, int family,
+			       struct isis_vertex *parent)
+{
+  struct listnode *ipnode;
+  struct prefix_ipv4 *ipv4;
+  struct prefix prefix;
+#ifdef HAVE_IPV6
+  struct prefix_ipv6 *ipv6;
+#endif /* HAVE_IPV6 */
+
+  if (family == AF_INET)
+    {
+      prefix.family = AF_INET;
+      for (ALL_LIST_ELEMENTS_RO (circuit->ip_addrs, ipnode, ipv4))
+	{
+	  prefix.u.prefix4 = ipv4->prefix;
+	  prefix.prefixlen = ipv4->prefixlen;
+	  apply_mask (&prefix);
+	  isis_spf_add_local (spftree, VTYPE_IPREACH_INTERNAL, &prefix,
+			      NULL, 0, family, parent);
+	}
+    }
+#ifdef HAVE_IPV6
+  if (family == AF_INET6)
+    {
+      prefix.family = AF_INET6;
+      for (ALL_LIST_ELEMENTS_RO (circuit->ipv6_non_link, ipnode, ipv6))
+	{
+	  prefix.prefixlen = ipv6->prefixlen;
+	  prefix.u.prefix6 = ipv6->prefix;
+	  apply_mask (&prefix);
+	  isis_spf_add_local (spftree, VTYPE_IP6REACH_INTERNAL,
+			      &prefix, NULL, 0, family, parent);
+	}
+    }
+#endif /* HAVE_IPV6 */
+}
+
 static int
 isis_spf_preload_tent (struct isis_spftree *spftree, int level,
 		       int family, u_char *root_sysid,
 		       struct isis_vertex *parent)
 {
   struct isis_circuit *circuit;
-  struct listnode *cnode, *anode, *ipnode;
+  struct listnode *cnode, *anode;
   struct isis_adjacency *adj;
   struct isis_lsp *lsp;
   struct list *adj_list;
   struct list *adjdb;
-  struct prefix_ipv4 *ipv4;
-  struct prefix prefix;
   int retval = ISIS_OK;
   u_char lsp_id[ISIS_SYS_ID_LEN + 2];
   static u_char null_lsp_id[ISIS_SYS_ID_LEN + 2];
-#ifdef HAVE_IPV6
-  struct prefix_ipv6 *ipv6;
-#endif /* HAVE_IPV6 */
 
   for (ALL_LIST_ELEMENTS_RO (spftree->area->circuit_list, cnode, circuit))
     {
-      if (circuit->state != C_STATE_UP)
-	continue;
-      if (!(circuit->is_type & level))
-	continue;
-      if (family == AF_INET && !circuit->ip_router)
+      if (!isis_spf_circuit_usable (circuit, level, family))
 	continue;
-#ifdef HAVE_IPV6
-      if (family == AF_INET6 && !circuit->ipv6_router)
-	continue;
-#endif /* HAVE_IPV6 */
-      /* 
-       * Add IP(v6) addresses of this circuit
-       */
-      if (family == AF_INET)
-	{
-	  prefix.family = AF_INET;
-          for (ALL_LIST_ELEMENTS_RO (circuit->ip_addrs, ipnode, ipv4))
-	    {
-	      prefix.u.prefix4 = ipv4->prefix;
-	      prefix.prefixlen = ipv4->prefixlen;
-              apply_mask (&prefix);
-	      isis_spf_add_local (spftree, VTYPE_IPREACH_INTERNAL, &prefix,
-				  NULL, 0, family, parent);
-	    }
-	}
-#ifdef HAVE_IPV6
-      if (family == AF_INET6)
-	{
-	  prefix.family = AF_INET6;
-	  for (ALL_LIST_ELEMENTS_RO (circuit->ipv6_non_link, ipnode, ipv6))
-	    {
-	      prefix.prefixlen = ipv6->prefixlen;
-	      prefix.u.prefix6 = ipv6->prefix;
-              apply_mask (&prefix);
-	      isis_spf_add_local (spftree, VTYPE_IP6REACH_INTERNAL,
-				  &prefix, NULL, 0, family, parent);
-	    }
-	}
-#endif /* HAVE_IPV6 */
+      isis_spf_add_circuit_prefixes (spftree, circuit, family, parent);
       if (circuit->circ_type == CIRCUIT_T_BROADCAST)
 	{
 	  /*
@@ -1133,10 +1271,9 @@ add_to_paths (struct isis_spftree *spftree, struct isis_vertex *vertex,
 	      int level)
 {
   u_char buff[BUFSIZ];
+  struct isis_route_info *rinfo;
 
-  if (isis_find_vertex (spftree->paths, vertex->N.id, vertex->type))
-    return;
-  listnode_add (spftree->paths, vertex);
+  ilist_add (&spftree->paths, &vertex->path_node);
 
 #ifdef EXTREME_DEBUG
   zlog_debug ("ISIS-Spf: added %s %s %s depth %d dist %d to PATHS",
@@ -1148,8 +1285,13 @@ add_to_paths (struct isis_spftree *spftree, struct isis_vertex *vertex,
   if (vertex->type > VTYPE_ES)
     {
       if (listcount (vertex->Adj_N) > 0)
-	isis_route_create ((struct prefix *) &vertex->N.prefix, vertex->d_N,
-			   vertex->depth, vertex->Adj_N, spftree->area, level);
+	{
+	  rinfo = isis_route_create ((struct prefix *) &vertex->N.prefix,
+				     vertex->d_N, vertex->depth, vertex->Adj_N,
+				     spftree, level);
+	  if (rinfo && !CHECK_FLAG (rinfo->flag, ISIS_ROUTE_FLAG_ZEBRA_SYNCED))
+	    spftree->changed++;
+	}
       else if (isis->debugs & DEBUG_SPF_EVENTS)
 	zlog_debug ("ISIS-Spf: no adjacencies do not install route for "
                     "%s depth %d dist %d", vid2string (vertex, buff),
@@ -1162,26 +1304,96 @@ add_to_paths (struct isis_spftree *spftree, struct isis_vertex *vertex,
 static void
 init_spt (struct isis_spftree *spftree)
 {
-  spftree->tents->del = spftree->paths->del = (void (*)(void *)) isis_vertex_del;
-  list_delete_all_node (spftree->tents);
-  list_delete_all_node (spftree->paths);
-  spftree->tents->del = spftree->paths->del = NULL;
+  isis_spftree_clear (spftree);
   return;
 }
 
+/*
+ * Partial route calculation, when only prefixes changed since the last
+ * run: the IS vertices on PATHS are kept, and the prefixes advertised by
+ * them are resolved again against their distances.
+ */
+static void
+isis_spf_prc (struct isis_spftree *spftree, int level, int family)
+{
+  struct isis_area *area = spftree->area;
+  struct ilistnode *node, *nnode;
+  struct listnode *cnode, *cnnode, *fragnode;
+  struct isis_vertex *vertex, *child, *root;
+  struct isis_circuit *circuit;
+  struct isis_lsp *lsp;
+  u_char lsp_id[ISIS_SYS_ID_LEN + 2];
+
+  /* Prefixes are leaves: forget them, and they are gone from the tree */
+  for (ALL_ILIST_ELEMENTS (&spftree->paths, node, nnode, vertex,
+			   struct isis_vertex, path_node))
+    {
+      if (vertex->type > VTYPE_ES)
+	{
+	  hash_release (spftree->vertices, vertex);
+	  ilist_delete (&spftree->paths, node);
+	  isis_vertex_del (vertex);
+	  continue;
+	}
+      for (ALL_LIST_ELEMENTS (vertex->children, cnode, cnnode, child))
+	if (child->type > VTYPE_ES)
+	  list_delete_node (vertex->children, cnode);
+    }
+
+  root = ilist_head_entry (&spftree->paths, struct isis_vertex, path_node);
+  for (ALL_LIST_ELEMENTS_RO (area->circuit_list, cnode, circuit))
+    if (isis_spf_circuit_usable (circuit, level, family))
+      isis_spf_add_circuit_prefixes (spftree, circuit, family, root);
+
+  for (ALL_ILIST_ELEMENTS_RO (&spftree->paths, node, vertex,
+			      struct isis_vertex, path_node))
+    {
+      if (vertex == root
+	  || (vertex->type != VTYPE_NONPSEUDO_IS
+	      && vertex->type != VTYPE_NONPSEUDO_TE_IS))
+	continue;
+      memcpy (lsp_id, vertex->N.id, ISIS_SYS_ID_LEN);
+      LSP_PSEUDO_ID (lsp_id) = 0;
+      LSP_FRAGMENT (lsp_id) = 0;
+      lsp = lsp_search (lsp_id, area->lspdb[level - 1]);
+      if (lsp == NULL || lsp->lsp_header->rem_lifetime == 0
+	  || !speaks (lsp->tlv_data.nlpids, family))
+	continue;
+
+      fragnode = NULL;
+      while (lsp)
+	{
+	  if (lsp->lsp_header->seq_num == 0)
+	    break;
+	  isis_spf_process_lsp_prefixes (spftree, lsp, vertex->d_N,
+					 vertex->depth, family, vertex);
+	  fragnode = (fragnode == NULL) ? listhead (lsp->lspu.frags)
+					: listnextnode (fragnode);
+	  lsp = fragnode ? listgetdata (fragnode) : NULL;
+	}
+    }
+
+  while (spftree->tents->size > 0)
+    {
+      vertex = pqueue_dequeue (spftree->tents);
+      vertex->tent_pos = -1;
+      add_to_paths (spftree, vertex, level);
+    }
+}
+
 static int
 isis_run_spf (struct isis_area *area, int level, int family, u_char *sysid)
 {
   int retval = ISIS_OK;
-  struct listnode *node;
   struct isis_vertex *vertex;
   struct isis_vertex *root_vertex;
   struct isis_spftree *spftree = NULL;
   u_char lsp_id[ISIS_SYS_ID_LEN + 2];
   struct isis_lsp *lsp;
-  struct route_table *table = NULL;
   struct timeval time_now;
   unsigned long long start_time, end_time;
+  struct isis_spf_log *log;
+  int prc = 0;
 
   /* Get time that can't roll backwards. */
   quagga_gettime(QUAGGA_CLK_MONOTONIC, &time_now);
@@ -1197,15 +1409,23 @@ isis_run_spf (struct isis_area *area, int level, int family, u_char *sysid)
   assert (spftree);
   assert (sysid);
 
-  /* Make all routes in current route table inactive. */
-  if (family == AF_INET)
-    table = area->route_table[level - 1];
-#ifdef HAVE_IPV6
-  else if (family == AF_INET6)
-    table = area->route_table6[level - 1];
-#endif
+  QUAGGA_TRACE (isisd, spf_entry, area->area_tag, level, family);
 
-  isis_route_invalidate_table (area, table);
+  /* The routes of the last run are stale until this one finds them. */
+  isis_route_stale (spftree);
+  spftree->changed = 0;
+
+  if (!spftree->full && spftree->paths.count > 0)
+    {
+      prc = 1;
+      if (isis->debugs & DEBUG_SPF_EVENTS)
+	zlog_debug ("ISIS-Spf (%s) L%d only prefixes changed, PRC",
+		    area->area_tag, level);
+      isis_spf_prc (spftree, level, family);
+      spftree->prc_runcount++;
+      goto out;
+    }
+  spftree->full = 0;
 
   /*
    * C.2.5 Step 0
@@ -1218,22 +1438,23 @@ isis_run_spf (struct isis_area *area, int level, int family, u_char *sysid)
   if (retval != ISIS_OK)
     {
       zlog_warn ("ISIS-Spf: failed to load TENT SPF-root:%s", print_sys_hostname(sysid));
+      spftree->full = 1;
       goto out;
     }
 
   /*
    * C.2.7 Step 2
    */
-  if (listcount (spftree->tents) == 0)
+  if (spftree->tents->size == 0)
     {
       zlog_warn ("ISIS-Spf: TENT is empty SPF-root:%s", print_sys_hostname(sysid));
       goto out;
     }
 
-  while (listcount (spftree->tents) > 0)
+  while (spftree->tents->size > 0)
     {
-      node = listhead (spftree->tents);
-      vertex = listgetdata (node);
+      vertex = pqueue_dequeue (spftree->tents);
+      vertex->tent_pos = -1;
 
 #ifdef EXTREME_DEBUG
   zlog_debug ("ISIS-Spf: get TENT node %s %s depth %d dist %d to PATHS",
@@ -1241,8 +1462,7 @@ isis_run_spf (struct isis_area *area, int level, int family, u_char *sysid)
 	      vtype2string (vertex->type), vertex->depth, vertex->d_N);
 #endif /* EXTREME_DEBUG */
 
-      /* Remove from tent list and add to paths list */
-      list_delete_node (spftree->tents, node);
+      /* Removed from tent list, add to paths list */
       add_to_paths (spftree, vertex, level);
       switch (vertex->type)
         {
@@ -1278,7 +1498,7 @@ isis_run_spf (struct isis_area *area, int level, int family, u_char *sysid)
     }
 
 out:
-  isis_route_validate (area);
+  isis_route_validate_spftree (spftree);
   spftree->pending = 0;
   spftree->runcount++;
   spftree->last_run_timestamp = time (NULL);
@@ -1287,7 +1507,19 @@ out:
   end_time = (end_time * 1000000) + time_now.tv_usec;
   spftree->last_run_duration = end_time - start_time;
 
-
+  log = &spftree->log[spftree->log_next];
+  spftree->log_next = (spftree->log_next + 1) % ISIS_SPF_LOG_SIZE;
+  log->timestamp = spftree->last_run_timestamp;
+  memcpy (log->trigger_lsp, spftree->trigger_lsp, ISIS_SYS_ID_LEN + 2);
+  log->triggers = spftree->triggers;
+  log->prc = prc;
+  log->duration = spftree->last_run_duration;
+  log->vertices = spftree->paths.count;
+  log->changed = spftree->changed;
+  spftree->triggers = 0;
+
+  QUAGGA_TRACE (isisd, spf_exit, area->area_tag, level, family, prc,
+		spftree->paths.count, spftree->last_run_duration);
   return retval;
 }
 
@@ -1348,8 +1580,12 @@ isis_run_spf_l2 (struct thread *thread)
   return retval;
 }
 
-int
-isis_spf_schedule (struct isis_area *area, int level)
+/*
+ * delay is in msec, from the SPF back-off of the level, or negative for
+ * the classic min_spf_interval throttle.
+ */
+static int
+spf_schedule (struct isis_area *area, int level, int full, long delay)
 {
   struct isis_spftree *spftree = area->spftree[level - 1];
   time_t now = time (NULL);
@@ -1362,11 +1598,28 @@ isis_spf_schedule (struct isis_area *area, int level)
     zlog_debug ("ISIS-Spf (%s) L%d SPF schedule called, lastrun %d sec ago",
                 area->area_tag, level, diff);
 
+  if (full)
+    spftree->full = 1;
   if (spftree->pending)
     return ISIS_OK;
 
   THREAD_TIMER_OFF (spftree->t_spf);
 
+  if (delay >= 0)
+    {
+      if (level == 1)
+        THREAD_TIMER_MSEC_ON (master, spftree->t_spf, isis_run_spf_l1, area, delay);
+      else
+        THREAD_TIMER_MSEC_ON (master, spftree->t_spf, isis_run_spf_l2, area, delay);
+
+      if (isis->debugs & DEBUG_SPF_EVENTS)
+        zlog_debug ("ISIS-Spf (%s) L%d SPF scheduled %ld msec from now",
+                    area->area_tag, level, delay);
+
+      spftree->pending = 1;
+      return ISIS_OK;
+    }
+
   /* wait configured min_spf_interval before doing the SPF */
   if (diff >= area->min_spf_interval[level-1])
       return isis_run_spf (area, level, AF_INET, isis->sysid);
@@ -1444,8 +1697,8 @@ isis_run_spf6_l2 (struct thread *thread)
   return retval;
 }
 
-int
-isis_spf_schedule6 (struct isis_area *area, int level)
+static int
+spf_schedule6 (struct isis_area *area, int level, int full, long delay)
 {
   int retval = ISIS_OK;
   struct isis_spftree *spftree = area->spftree6[level - 1];
@@ -1459,11 +1712,28 @@ isis_spf_schedule6 (struct isis_area *area, int level)
     zlog_debug ("ISIS-Spf (%s) L%d SPF schedule called, lastrun %d sec ago",
                 area->area_tag, level, diff);
 
+  if (full)
+    spftree->full = 1;
   if (spftree->pending)
     return ISIS_OK;
 
   THREAD_TIMER_OFF (spftree->t_spf);
 
+  if (delay >= 0)
+    {
+      if (level == 1)
+        THREAD_TIMER_MSEC_ON (master, spftree->t_spf, isis_run_spf6_l1, area, delay);
+      else
+        THREAD_TIMER_MSEC_ON (master, spftree->t_spf, isis_run_spf6_l2, area, delay);
+
+      if (isis->debugs & DEBUG_SPF_EVENTS)
+        zlog_debug ("ISIS-Spf (%s) L%d SPF scheduled %ld msec from now",
+                    area->area_tag, level, delay);
+
+      spftree->pending = 1;
+      return ISIS_OK;
+    }
+
   /* wait configured min_spf_interval before doing the SPF */
   if (diff >= area->min_spf_interval[level-1])
       return isis_run_spf (area, level, AF_INET6, isis->sysid);
@@ -1483,12 +1753,48 @@ isis_spf_schedule6 (struct isis_area *area, int level)
 
   return retval;
 }
+
+#endif
+
+static void
+spf_trigger_note (struct isis_spftree *spftree, u_char *lsp_id)
+{
+  if (spftree->triggers++ > 0)
+    return;
+  if (lsp_id)
+    memcpy (spftree->trigger_lsp, lsp_id, ISIS_SYS_ID_LEN + 2);
+  else
+    memset (spftree->trigger_lsp, 0, ISIS_SYS_ID_LEN + 2);
+}
+
+/*
+ * An LSP of this level changed, both families are scheduled. Unless full
+ * is set, only prefixes changed, and unless SPF is due anyway the routes
+ * are calculated again against the existing trees.
+ */
+int
+isis_spf_schedule (struct isis_area *area, int level, u_char *lsp_id,
+                   int full)
+{
+  int retval;
+  long delay = -1;
+
+  if (area->spf_delay_ietf[level - 1])
+    delay = spf_backoff_event (area->spf_delay_ietf[level - 1]);
+
+  spf_trigger_note (area->spftree[level - 1], lsp_id);
+  retval = spf_schedule (area, level, full, delay);
+#ifdef HAVE_IPV6
+  spf_trigger_note (area->spftree6[level - 1], lsp_id);
+  spf_schedule6 (area, level, full, delay);
 #endif
+  return retval;
+}
 
 static void
-isis_print_paths (struct vty *vty, struct list *paths, u_char *root_sysid)
+isis_print_paths (struct vty *vty, struct ilist *paths, u_char *root_sysid)
 {
-  struct listnode *node;
+  struct ilistnode *node;
   struct listnode *anode;
   struct isis_vertex *vertex;
   struct isis_adjacency *adj;
@@ -1497,7 +1803,8 @@ isis_print_paths (struct vty *vty, struct list *paths, u_char *root_sysid)
   vty_out (vty, "Vertex               Type         Metric "
                 "Next-Hop             Interface Parent%s", VTY_NEWLINE);
 
-  for (ALL_LIST_ELEMENTS_RO (paths, node, vertex)) {
+  for (ALL_ILIST_ELEMENTS_RO (paths, node, vertex,
+			      struct isis_vertex, path_node)) {
       if (memcmp (vertex->N.id, root_sysid, ISIS_SYS_ID_LEN) == 0) {
 	vty_out (vty, "%-20s %-12s %-6s", print_sys_hostname (root_sysid),
 	         "", "");
@@ -1578,21 +1885,21 @@ DEFUN (show_isis_topology,
       for (level = 0; level < ISIS_LEVELS; level++)
 	{
 	  if (area->ip_circuits > 0 && area->spftree[level]
-	      && area->spftree[level]->paths->count > 0)
+	      && area->spftree[level]->paths.count > 0)
 	    {
 	      vty_out (vty, "IS-IS paths to level-%d routers that speak IP%s",
 		       level + 1, VTY_NEWLINE);
-	      isis_print_paths (vty, area->spftree[level]->paths, isis->sysid);
+	      isis_print_paths (vty, &area->spftree[level]->paths, isis->sysid);
 	      vty_out (vty, "%s", VTY_NEWLINE);
 	    }
 #ifdef HAVE_IPV6
 	  if (area->ipv6_circuits > 0 && area->spftree6[level]
-	      && area->spftree6[level]->paths->count > 0)
+	      && area->spftree6[level]->paths.count > 0)
 	    {
 	      vty_out (vty,
 		       "IS-IS paths to level-%d routers that speak IPv6%s",
 		       level + 1, VTY_NEWLINE);
-	      isis_print_paths (vty, area->spftree6[level]->paths, isis->sysid);
+	      isis_print_paths (vty, &area->spftree6[level]->paths, isis->sysid);
 	      vty_out (vty, "%s", VTY_NEWLINE);
 	    }
 #endif /* HAVE_IPV6 */
@@ -1624,20 +1931,20 @@ DEFUN (show_isis_topology_l1,
 	       VTY_NEWLINE);
 
       if (area->ip_circuits > 0 && area->spftree[0]
-	  && area->spftree[0]->paths->count > 0)
+	  && area->spftree[0]->paths.count > 0)
 	{
 	  vty_out (vty, "IS-IS paths to level-1 routers that speak IP%s",
 		   VTY_NEWLINE);
-	  isis_print_paths (vty, area->spftree[0]->paths, isis->sysid);
+	  isis_print_paths (vty, &area->spftree[0]->paths, isis->sysid);
 	  vty_out (vty, "%s", VTY_NEWLINE);
 	}
 #ifdef HAVE_IPV6
       if (area->ipv6_circuits > 0 && area->spftree6[0]
-	  && area->spftree6[0]->paths->count > 0)
+	  && area->spftree6[0]->paths.count > 0)
 	{
 	  vty_out (vty, "IS-IS paths to level-1 routers that speak IPv6%s",
 		   VTY_NEWLINE);
-	  isis_print_paths (vty, area->spftree6[0]->paths, isis->sysid);
+	  isis_print_paths (vty, &area->spftree6[0]->paths, isis->sysid);
 	  vty_out (vty, "%s", VTY_NEWLINE);
 	}
 #endif /* HAVE_IPV6 */
@@ -1667,20 +1974,20 @@ DEFUN (show_isis_topology_l2,
 	       VTY_NEWLINE);
 
       if (area->ip_circuits > 0 && area->spftree[1]
-	  && area->spftree[1]->paths->count > 0)
+	  && area->spftree[1]->paths.count > 0)
 	{
 	  vty_out (vty, "IS-IS paths to level-2 routers that speak IP%s",
 		   VTY_NEWLINE);
-	  isis_print_paths (vty, area->spftree[1]->paths, isis->sysid);
+	  isis_print_paths (vty, &area->spftree[1]->paths, isis->sysid);
 	  vty_out (vty, "%s", VTY_NEWLINE);
 	}
 #ifdef HAVE_IPV6
       if (area->ipv6_circuits > 0 && area->spftree6[1]
-	  && area->spftree6[1]->paths->count > 0)
+	  && area->spftree6[1]->paths.count > 0)
 	{
 	  vty_out (vty, "IS-IS paths to level-2 routers that speak IPv6%s",
 		   VTY_NEWLINE);
-	  isis_print_paths (vty, area->spftree6[1]->paths, isis->sysid);
+	  isis_print_paths (vty, &area->spftree6[1]->paths, isis->sysid);
 	  vty_out (vty, "%s", VTY_NEWLINE);
 	}
 #endif /* HAVE_IPV6 */
@@ -1690,14 +1997,81 @@ DEFUN (show_isis_topology_l2,
   return CMD_SUCCESS;
 }
 
+static void
+isis_print_spf_log (struct vty *vty, struct isis_spftree *spftree,
+		    const char *family, int level)
+{
+  struct isis_spf_log *log;
+  time_t now = time (NULL);
+  unsigned int i, n;
+  static const u_char zero_lsp[ISIS_SYS_ID_LEN + 2];
+
+  if (spftree->runcount == 0)
+    return;
+
+  vty_out (vty, "IS-IS level-%d %s SPF log, newest first%s", level, family,
+	   VTY_NEWLINE);
+  vty_out (vty, "      Ago  Type  Duration(us)  Nodes  Changed  Triggers"
+	   "  First trigger LSP%s", VTY_NEWLINE);
+
+  n = spftree->runcount < ISIS_SPF_LOG_SIZE ?
+      spftree->runcount : ISIS_SPF_LOG_SIZE;
+  for (i = 1; i <= n; i++)
+    {
+      log = &spftree->log[(spftree->log_next + ISIS_SPF_LOG_SIZE - i)
+			  % ISIS_SPF_LOG_SIZE];
+      vty_out (vty, "%8lds  %-4s  %12lu  %5u  %7u  %8u  %s%s",
+	       (long) (now - log->timestamp), log->prc ? "PRC" : "FULL",
+	       log->duration, log->vertices, log->changed, log->triggers,
+	       memcmp (log->trigger_lsp, zero_lsp, sizeof (zero_lsp)) ?
+	       rawlspid_print (log->trigger_lsp) : "-", VTY_NEWLINE);
+    }
+  vty_out (vty, "%s", VTY_NEWLINE);
+}
+
+DEFUN (show_isis_spf_log,
+       show_isis_spf_log_cmd,
+       "show isis spf-log",
+       SHOW_STR
+       "IS-IS information\n"
+       "IS-IS SPF run log\n")
+{
+  struct listnode *node;
+  struct isis_area *area;
+  int level;
+
+  if (!isis->area_list || isis->area_list->count == 0)
+    return CMD_SUCCESS;
+
+  for (ALL_LIST_ELEMENTS_RO (isis->area_list, node, area))
+    {
+      vty_out (vty, "Area %s:%s", area->area_tag ? area->area_tag : "null",
+	       VTY_NEWLINE);
+
+      for (level = 0; level < ISIS_LEVELS; level++)
+	{
+	  if (area->spftree[level])
+	    isis_print_spf_log (vty, area->spftree[level], "IP", level + 1);
+#ifdef HAVE_IPV6
+	  if (area->spftree6[level])
+	    isis_print_spf_log (vty, area->spftree6[level], "IPv6", level + 1);
+#endif /* HAVE_IPV6 */
+	}
+    }
+
+  return CMD_SUCCESS;
+}
+
 void
 isis_spf_cmds_init ()
 {
   install_element (VIEW_NODE, &show_isis_topology_cmd);
   install_element (VIEW_NODE, &show_isis_topology_l1_cmd);
   install_element (VIEW_NODE, &show_isis_topology_l2_cmd);
+  install_element (VIEW_NODE, &show_isis_spf_log_cmd);
 
   install_element (ENABLE_NODE, &show_isis_topology_cmd);
   install_element (ENABLE_NODE, &show_isis_topology_l1_cmd);
   install_element (ENABLE_NODE, &show_isis_topology_l2_cmd);
+  install_element (ENABLE_NODE, &show_isis_spf_log_cmd);
 }
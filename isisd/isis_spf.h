@@ -56,21 +56,47 @@ struct isis_vertex
 
   u_int32_t d_N;		/* d(N) Distance from this IS      */
   u_int16_t depth;		/* The depth in the imaginary tree */
+  int tent_pos;			/* position in TENT, -1 if not on it */
   struct list *Adj_N;		/* {Adj(N)} next hop or neighbor list */
   struct list *parents;         /* list of parents for ECMP */
   struct list *children;        /* list of children used for tree dump */
+  struct ilistnode path_node;	/* on PATHS */
 };
 
+/* One SPF run, as shown by "show isis spf-log" */
+struct isis_spf_log
+{
+  time_t timestamp;		/* end of the run */
+  u_char trigger_lsp[ISIS_SYS_ID_LEN + 2]; /* first LSP that asked for it */
+  unsigned int triggers;	/* scheduling requests folded into the run */
+  u_char prc;			/* partial route calculation */
+  unsigned long duration;	/* usec */
+  unsigned int vertices;	/* on PATHS afterwards */
+  unsigned int changed;		/* routes added or changed */
+};
+#define ISIS_SPF_LOG_SIZE 32
+
 struct isis_spftree
 {
   struct thread *t_spf;		/* spf threads */
-  struct list *paths;		/* the SPT */
-  struct list *tents;		/* TENT */
+  struct ilist paths;		/* the SPT, of vertices by path_node */
+  struct pqueue *tents;		/* TENT, by d(N) then vertextype */
+  struct hash *vertices;	/* PATHS and TENT, by vertextype and id */
   struct isis_area *area;       /* back pointer to area */
   int pending;			/* already scheduled */
+  int full;			/* topology changed, a PRC is not enough */
   unsigned int runcount;        /* number of runs since uptime */
+  unsigned int prc_runcount;    /* of which were partial route calculations */
   time_t last_run_timestamp;    /* last run timestamp for scheduling */
   time_t last_run_duration;     /* last run duration in msec */
+  u_char trigger_lsp[ISIS_SYS_ID_LEN + 2]; /* for the pending run */
+  unsigned int triggers;
+  unsigned int changed;		/* routes changed by the current run */
+  struct ilist routes;		/* isis_route_info found by this run */
+  struct ilist stale;		/* of the last run, not found again yet */
+  struct ilist changes;		/* new or changed, to sync to zebra */
+  struct isis_spf_log log[ISIS_SPF_LOG_SIZE];
+  unsigned int log_next;	/* ring index of the next entry */
 };
 
 struct isis_spftree * isis_spftree_new (struct isis_area *area);
@@ -81,9 +107,7 @@ void spftree_area_init (struct isis_area *area);
 void spftree_area_del (struct isis_area *area);
 void spftree_area_adj_del (struct isis_area *area,
                            struct isis_adjacency *adj);
-int isis_spf_schedule (struct isis_area *area, int level);
+int isis_spf_schedule (struct isis_area *area, int level, u_char *lsp_id,
+                       int full);
 void isis_spf_cmds_init (void);
-#ifdef HAVE_IPV6
-int isis_spf_schedule6 (struct isis_area *area, int level);
-#endif
 #endif /* _ZEBRA_ISIS_SPF_H */
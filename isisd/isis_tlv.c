@@ -92,6 +92,110 @@ free_tlvs (struct tlvs *tlvs)
   return;
 }
 
+/*
+ * Length of the entry at pnt of a TLV of the given type, with avail
+ * bytes left in the TLV, or 0 if it is malformed.
+ */
+static int
+tlv_entry_len (u_char type, u_char * pnt, int avail)
+{
+  int len;
+
+  switch (type)
+    {
+    case IS_NEIGHBOURS:
+      len = 4 + ISIS_SYS_ID_LEN + 1;
+      break;
+    case TE_IS_NEIGHBOURS:
+      if (avail < ISIS_SYS_ID_LEN + 5)
+	return 0;
+      len = ISIS_SYS_ID_LEN + 5 + pnt[ISIS_SYS_ID_LEN + 4];
+      break;
+    case IPV4_INT_REACHABILITY:
+    case IPV4_EXT_REACHABILITY:
+      len = 12;
+      break;
+    case TE_IPV4_REACHABILITY:
+      if (avail < 5 || (pnt[4] & 0x3F) > IPV4_MAX_BITLEN)
+	return 0;
+      len = 5 + ((pnt[4] & 0x3F) + 7) / 8;
+      if (pnt[4] & 0x40)
+	{
+	  if (avail < len + 1)
+	    return 0;
+	  len += 1 + pnt[len];
+	}
+      break;
+#ifdef HAVE_IPV6
+    case IPV6_REACHABILITY:
+      if (avail < 6 || pnt[5] > IPV6_MAX_BITLEN)
+	return 0;
+      len = 6 + (pnt[5] + 7) / 8;
+      if (pnt[4] & CTRL_INFO_SUBTLVS)
+	{
+	  if (avail < len + 1)
+	    return 0;
+	  len += 1 + pnt[len];
+	}
+      break;
+#endif /* HAVE_IPV6 */
+    default:
+      return 0;
+    }
+
+  return (len <= avail) ? len : 0;
+}
+
+void *
+tlv_iter_first (struct tlv_iter *iter, u_char * stream, int size,
+		u_char type)
+{
+  iter->pnt = stream;
+  iter->end = stream + size;
+  iter->entry = iter->entry_end = NULL;
+  iter->type = type;
+
+  return tlv_iter_next (iter);
+}
+
+void *
+tlv_iter_next (struct tlv_iter *iter)
+{
+  u_char *entry;
+  int len;
+
+  while (1)
+    {
+      if (iter->entry < iter->entry_end)
+	{
+	  len = tlv_entry_len (iter->type, iter->entry,
+			       iter->entry_end - iter->entry);
+	  if (len)
+	    {
+	      entry = iter->entry;
+	      iter->entry += len;
+	      return entry;
+	    }
+	}
+
+      /* on to the next TLV of the type */
+      while (iter->pnt + 2 <= iter->end && *iter->pnt != iter->type)
+	iter->pnt += 2 + iter->pnt[1];
+      if (iter->pnt + 2 > iter->end
+	  || iter->pnt + 2 + iter->pnt[1] > iter->end)
+	{
+	  iter->pnt = iter->end;
+	  return NULL;
+	}
+      iter->entry = iter->pnt + 2;
+      iter->entry_end = iter->entry + iter->pnt[1];
+      iter->pnt = iter->entry_end;
+      /* skip the virtual flag */
+      if (iter->type == IS_NEIGHBOURS)
+	iter->entry++;
+    }
+}
+
 /*
  * Parses the tlvs found in the variant length part of the PDU.
  * Caller tells with flags in "expected" which TLV's it is interested in.
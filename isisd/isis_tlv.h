@@ -263,6 +263,22 @@ struct tlvs
   struct isis_passwd auth_info;
 };
 
+/*
+ * Walk over the entries of one TLV type in place, in all the TLVs of that
+ * type, without building lists.  For IS neighbours, TE IS neighbours, IPv4
+ * internal, external and extended reachability, and IPv6 reachability.
+ * An entry that does not fit in its TLV, or has a bad prefix length, ends
+ * the walk of that TLV.
+ */
+struct tlv_iter
+{
+  u_char *pnt;			/* next TLV */
+  u_char *end;			/* end of the TLVs */
+  u_char *entry;		/* next entry of the current TLV */
+  u_char *entry_end;		/* end of the current TLV */
+  u_char type;
+};
+
 /*
  * Own definitions - used to bitmask found and expected
  */
@@ -295,6 +311,9 @@ void free_tlvs (struct tlvs *tlvs);
 int parse_tlvs (char *areatag, u_char * stream, int size,
 		u_int32_t * expected, u_int32_t * found, struct tlvs *tlvs,
                 u_int32_t * auth_tlv_offset);
+void *tlv_iter_first (struct tlv_iter *iter, u_char * stream, int size,
+		      u_char type);
+void *tlv_iter_next (struct tlv_iter *iter);
 int add_tlv (u_char, u_char, u_char *, struct stream *);
 void free_tlv (void *val);
 
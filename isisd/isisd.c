@@ -34,6 +34,7 @@
 #include "stream.h"
 #include "prefix.h"
 #include "table.h"
+#include "spf_backoff.h"
 
 #include "isisd/dict.h"
 #include "isisd/include-netbsd/iso.h"
@@ -219,6 +220,7 @@ isis_area_destroy (struct vty *vty, const char *area_tag)
   struct listnode *node, *nnode;
   struct isis_circuit *circuit;
   struct area_addr *addr;
+  int i;
 
   area = isis_area_lookup (area_tag);
 
@@ -255,6 +257,10 @@ isis_area_destroy (struct vty *vty, const char *area_tag)
 
   spftree_area_del (area);
 
+  for (i = 0; i < ISIS_LEVELS; i++)
+    if (area->spf_delay_ietf[i])
+      spf_backoff_free (area->spf_delay_ietf[i]);
+
   /* invalidate and validate would delete all routes from zebra */
   isis_route_invalidate (area);
   isis_route_validate (area);
@@ -1270,8 +1276,13 @@ DEFUN (show_isis_summary,
       else
         vty_out (vty, "    IPv4 SPF:%s", VTY_NEWLINE);
 
-      vty_out (vty, "      minimum interval  : %d%s",
-          area->min_spf_interval[level - 1], VTY_NEWLINE);
+      if (area->spf_delay_ietf[level - 1])
+        vty_out (vty, "      back-off state    : %s%s",
+                 spf_backoff_state_str (area->spf_delay_ietf[level - 1]),
+                 VTY_NEWLINE);
+      else
+        vty_out (vty, "      minimum interval  : %d%s",
+            area->min_spf_interval[level - 1], VTY_NEWLINE);
 
       vty_out (vty, "      last run elapsed  : ");
       vty_out_timestr(vty, spftree->last_run_timestamp);
@@ -1283,6 +1294,9 @@ DEFUN (show_isis_summary,
       vty_out (vty, "      run count         : %d%s",
           spftree->runcount, VTY_NEWLINE);
 
+      vty_out (vty, "      of which PRC      : %u%s",
+          spftree->prc_runcount, VTY_NEWLINE);
+
 #ifdef HAVE_IPV6
       spftree = area->spftree6[level - 1];
       if (spftree->pending)
@@ -1290,8 +1304,13 @@ DEFUN (show_isis_summary,
       else
         vty_out (vty, "    IPv6 SPF:%s", VTY_NEWLINE);
 
-      vty_out (vty, "      minimum interval  : %d%s",
-          area->min_spf_interval[level - 1], VTY_NEWLINE);
+      if (area->spf_delay_ietf[level - 1])
+        vty_out (vty, "      back-off state    : %s%s",
+                 spf_backoff_state_str (area->spf_delay_ietf[level - 1]),
+                 VTY_NEWLINE);
+      else
+        vty_out (vty, "      minimum interval  : %d%s",
+            area->min_spf_interval[level - 1], VTY_NEWLINE);
 
       vty_out (vty, "      last run elapsed  : ");
       vty_out_timestr(vty, spftree->last_run_timestamp);
@@ -1302,6 +1321,9 @@ DEFUN (show_isis_summary,
 
       vty_out (vty, "      run count         : %d%s",
           spftree->runcount, VTY_NEWLINE);
+
+      vty_out (vty, "      of which PRC      : %u%s",
+          spftree->prc_runcount, VTY_NEWLINE);
 #endif
     }
   }
@@ -1382,7 +1404,7 @@ show_isis_database (struct vty *vty, const char *argv, int ui_level)
 
       for (level = 0; level < ISIS_LEVELS; level++)
         {
-          if (area->lspdb[level] && dict_count (area->lspdb[level]) > 0)
+          if (area->lspdb[level] && lsp_db_count (area->lspdb[level]) > 0)
             {
               lsp = NULL;
               if (argv != NULL)
@@ -2333,6 +2355,68 @@ ALIAS (no_spf_interval,
        "Set interval for level 2 only\n"
        "Minimum interval between consecutive SPFs in seconds\n")
 
+DEFUN (spf_delay_ietf,
+       spf_delay_ietf_cmd,
+       "spf-delay-ietf init-delay <0-60000> short-delay <0-60000> "
+       "long-delay <0-60000> holddown <0-60000> time-to-learn <0-60000>",
+       "IETF SPF delay algorithm (RFC 8405)\n"
+       "Delay used while in QUIET state\n"
+       "Delay (msec)\n"
+       "Delay used while in SHORT_WAIT state\n"
+       "Delay (msec)\n"
+       "Delay used while in LONG_WAIT state\n"
+       "Delay (msec)\n"
+       "Time with no received IGP events before considering IGP stable\n"
+       "Time (msec)\n"
+       "Maximum duration needed to learn all the events related to a "
+       "single failure\n"
+       "Time (msec)\n")
+{
+  struct isis_area *area;
+  unsigned int init_delay, short_delay, long_delay, holddown, ttl;
+  int i;
+
+  area = vty->index;
+
+  VTY_GET_INTEGER_RANGE ("init-delay", init_delay, argv[0], 0, 60000);
+  VTY_GET_INTEGER_RANGE ("short-delay", short_delay, argv[1], 0, 60000);
+  VTY_GET_INTEGER_RANGE ("long-delay", long_delay, argv[2], 0, 60000);
+  VTY_GET_INTEGER_RANGE ("holddown", holddown, argv[3], 0, 60000);
+  VTY_GET_INTEGER_RANGE ("time-to-learn", ttl, argv[4], 0, 60000);
+
+  /* Same parameters, but each level reacts to its own events */
+  for (i = 0; i < ISIS_LEVELS; i++)
+    {
+      if (area->spf_delay_ietf[i])
+        spf_backoff_free (area->spf_delay_ietf[i]);
+      area->spf_delay_ietf[i] = spf_backoff_new (init_delay, short_delay,
+                                                 long_delay, holddown, ttl);
+    }
+
+  return CMD_SUCCESS;
+}
+
+DEFUN (no_spf_delay_ietf,
+       no_spf_delay_ietf_cmd,
+       "no spf-delay-ietf",
+       NO_STR
+       "IETF SPF delay algorithm (RFC 8405)\n")
+{
+  struct isis_area *area;
+  int i;
+
+  area = vty->index;
+
+  for (i = 0; i < ISIS_LEVELS; i++)
+    if (area->spf_delay_ietf[i])
+      {
+        spf_backoff_free (area->spf_delay_ietf[i]);
+        area->spf_delay_ietf[i] = NULL;
+      }
+
+  return CMD_SUCCESS;
+}
+
 static int
 set_lsp_max_lifetime (struct vty *vty, struct isis_area *area,
                       uint16_t interval, int level)
@@ -2375,6 +2459,7 @@ set_lsp_max_lifetime (struct vty *vty, struct isis_area *area,
       /* Automatically reducing lsp_refresh_interval to interval - 300 */
       if (set_refresh_interval[lvl-1])
         area->lsp_refresh[lvl-1] = refresh_interval;
+      area->lsp_refresh_due[lvl-1] = 0;
     }
 
   lsp_regenerate_schedule (area, level, 1);
@@ -2532,6 +2617,7 @@ set_lsp_refresh_interval (struct vty *vty, struct isis_area *area,
       if (!(lvl & level))
         continue;
       area->lsp_refresh[lvl-1] = interval;
+      area->lsp_refresh_due[lvl-1] = 0;
     }
   lsp_regenerate_schedule (area, level, 1);
 
@@ -2982,6 +3068,17 @@ isis_config_write (struct vty *vty)
 		write++;
 	      }
 	  }
+	if (area->spf_delay_ietf[0])
+	  {
+	    struct spf_backoff *backoff = area->spf_delay_ietf[0];
+
+	    vty_out (vty, " spf-delay-ietf init-delay %u short-delay %u "
+		     "long-delay %u holddown %u time-to-learn %u%s",
+		     backoff->init_delay, backoff->short_delay,
+		     backoff->long_delay, backoff->holddown,
+		     backoff->time_to_learn, VTY_NEWLINE);
+	    write++;
+	  }
 	/* Authentication passwords. */
 	if (area->area_passwd.type == ISIS_PASSWD_TYPE_HMAC_MD5)
 	  {
@@ -3221,6 +3318,8 @@ isis_init ()
   install_element (ISIS_NODE, &spf_interval_l2_cmd);
   install_element (ISIS_NODE, &no_spf_interval_l2_cmd);
   install_element (ISIS_NODE, &no_spf_interval_l2_arg_cmd);
+  install_element (ISIS_NODE, &spf_delay_ietf_cmd);
+  install_element (ISIS_NODE, &no_spf_delay_ietf_cmd);
 
   install_element (ISIS_NODE, &max_lsp_lifetime_cmd);
   install_element (ISIS_NODE, &no_max_lsp_lifetime_cmd);
@@ -84,7 +84,7 @@ extern struct isis *isis;
 struct isis_area
 {
   struct isis *isis;				  /* back pointer */
-  dict_t *lspdb[ISIS_LEVELS];			  /* link-state dbs */
+  struct isis_lspdb *lspdb[ISIS_LEVELS];	  /* link-state dbs */
   struct isis_spftree *spftree[ISIS_LEVELS];	  /* The v4 SPTs */
   struct route_table *route_table[ISIS_LEVELS];	  /* IPv4 routes */
 #ifdef HAVE_IPV6
@@ -97,6 +97,7 @@ struct isis_area
   struct thread *t_tick;	/* LSP walker */
   struct thread *t_lsp_refresh[ISIS_LEVELS];
   int lsp_regenerate_pending[ISIS_LEVELS];
+  time_t lsp_refresh_due[ISIS_LEVELS];	/* of all our LSP fragments */
 
   /*
    * Configurables 
@@ -121,6 +122,8 @@ struct isis_area
   u_int16_t lsp_gen_interval[ISIS_LEVELS];
   /* min interval between between consequtive SPFs */
   u_int16_t min_spf_interval[ISIS_LEVELS];
+  /* RFC 8405 SPF back-off, replaces the above when set */
+  struct spf_backoff *spf_delay_ietf[ISIS_LEVELS];
   /* the percentage of LSP mtu size used, before generating a new frag */
   int lsp_frag_threshold;
   int ip_circuits;
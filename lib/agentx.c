@@ -30,6 +30,11 @@
 
 int agentx_enabled = 0;
 
+/* Repetitions of a GETBULK answered in one request.  The tables are
+   answered in the main thread, so a walk of a large one is spread over
+   several requests, with the daemon's own work run in between. */
+#define AGENTX_GETBULK_REPEATS 64
+
 /* AgentX node. */
 static struct cmd_node agentx_node =
 {
@@ -106,6 +111,11 @@ smux_init (struct thread_master *tm)
 			  SNMP_CALLBACK_LOGGING,
 			  agentx_log_callback,
 			  NULL);
+#ifdef NETSNMP_DS_AGENT_MAX_GETBULKREPEATS
+  netsnmp_ds_set_int (NETSNMP_DS_APPLICATION_ID,
+		      NETSNMP_DS_AGENT_MAX_GETBULKREPEATS,
+		      AGENTX_GETBULK_REPEATS);
+#endif
   init_agent ("quagga");
 
   install_node (&agentx_node, config_write_agentx);
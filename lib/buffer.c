@@ -39,6 +39,9 @@ struct buffer
   
   /* Size of each buffer_data chunk. */
   size_t size;
+
+  /* Bytes waiting to be flushed. */
+  size_t length;
 };
 
 /* Data container. */
@@ -62,8 +65,30 @@ struct buffer_data
    next page boundery. */
 #define BUFFER_SIZE_DEFAULT		4096
 
+/* Default-sized chunks kept for reuse rather than freed, at most. */
+#define BUFFER_POOL_MAX			64
+
+/* Default chunk size, BUFFER_SIZE_DEFAULT rounded up to a page. */
+static size_t buffer_default_size;
+
+/* Free default-sized chunks, linked through next. */
+static struct buffer_data *buffer_pool;
+static unsigned int buffer_pool_count;
 
-#define BUFFER_DATA_FREE(D) XFREE(MTYPE_BUFFER_DATA, (D))
+#define BUFFER_DATA_FREE(B, D) buffer_data_free ((B), (D))
+
+static void
+buffer_data_free (struct buffer *b, struct buffer_data *d)
+{
+  if (b->size == buffer_default_size && buffer_pool_count < BUFFER_POOL_MAX)
+    {
+      d->next = buffer_pool;
+      buffer_pool = d;
+      buffer_pool_count++;
+    }
+  else
+    XFREE (MTYPE_BUFFER_DATA, d);
+}
 
 /* Make new buffer. */
 struct buffer *
@@ -73,18 +98,16 @@ buffer_new (size_t size)
 
   b = XCALLOC (MTYPE_BUFFER, sizeof (struct buffer));
 
+  if (!buffer_default_size)
+    {
+      long pgsz = sysconf(_SC_PAGESIZE);
+      buffer_default_size = ((((BUFFER_SIZE_DEFAULT-1)/pgsz)+1)*pgsz);
+    }
+
   if (size)
     b->size = size;
   else
-    {
-      static size_t default_size;
-      if (!default_size)
-        {
-	  long pgsz = sysconf(_SC_PAGESIZE);
-	  default_size = ((((BUFFER_SIZE_DEFAULT-1)/pgsz)+1)*pgsz);
-	}
-      b->size = default_size;
-    }
+    b->size = buffer_default_size;
 
   return b;
 }
@@ -127,6 +150,13 @@ buffer_empty (struct buffer *b)
   return (b->head == NULL);
 }
 
+/* Return the number of bytes not flushed yet. */
+size_t
+buffer_length (struct buffer *b)
+{
+  return b->length;
+}
+
 /* Clear and free all allocated data. */
 void
 buffer_reset (struct buffer *b)
@@ -137,9 +167,10 @@ buffer_reset (struct buffer *b)
   for (data = b->head; data; data = next)
     {
       next = data->next;
-      BUFFER_DATA_FREE(data);
+      BUFFER_DATA_FREE(b, data);
     }
   b->head = b->tail = NULL;
+  b->length = 0;
 }
 
 /* Add buffer_data to the end of buffer. */
@@ -148,7 +179,14 @@ buffer_add (struct buffer *b)
 {
   struct buffer_data *d;
 
-  d = XMALLOC(MTYPE_BUFFER_DATA, offsetof(struct buffer_data, data[b->size]));
+  if (b->size == buffer_default_size && buffer_pool)
+    {
+      d = buffer_pool;
+      buffer_pool = d->next;
+      buffer_pool_count--;
+    }
+  else
+    d = XMALLOC(MTYPE_BUFFER_DATA, offsetof(struct buffer_data, data[b->size]));
   d->cp = d->sp = 0;
   d->next = NULL;
 
@@ -182,9 +220,63 @@ buffer_put(struct buffer *b, const void *p, size_t size)
       size -= chunk;
       ptr += chunk;
       data->cp += chunk;
+      b->length += chunk;
     }
 }
 
+/* Format into the buffer.  The output goes straight into the last
+   chunk when it fits there. */
+int
+buffer_vprintf (struct buffer *b, const char *format, va_list args)
+{
+  struct buffer_data *data = b->tail;
+  char buf[1024];
+  char *p;
+  size_t room;
+  va_list ac;
+  int len;
+
+  if (data && data->cp < b->size)
+    {
+      room = b->size - data->cp;
+      va_copy (ac, args);
+      len = vsnprintf ((char *)(data->data + data->cp), room, format, ac);
+      va_end (ac);
+      if (len < 0)
+	return len;
+      if ((size_t) len < room)
+	{
+	  data->cp += len;
+	  b->length += len;
+	  return len;
+	}
+    }
+  else
+    {
+      va_copy (ac, args);
+      len = vsnprintf (buf, sizeof (buf), format, ac);
+      va_end (ac);
+      if (len < 0)
+	return len;
+      if ((size_t) len < sizeof (buf))
+	{
+	  buffer_put (b, buf, len);
+	  return len;
+	}
+    }
+
+  /* Does not fit where it was tried. */
+  if ((size_t) len < sizeof (buf))
+    p = buf;
+  else
+    p = XMALLOC (MTYPE_TMP, len + 1);
+  vsnprintf (p, len + 1, format, args);
+  buffer_put (b, p, len);
+  if (p != buf)
+    XFREE (MTYPE_TMP, p);
+  return len;
+}
+
 /* Insert character into the buffer. */
 void
 buffer_putc (struct buffer *b, u_char c)
@@ -304,6 +396,7 @@ buffer_flush_window (struct buffer *b, int fd, int width, int height,
         }
       iov[iov_index].iov_base = (char *)(data->data + data->sp);
       iov[iov_index++].iov_len = cp-data->sp;
+      b->length -= cp-data->sp;
       data->sp = cp;
 
       if (iov_index == iov_alloc)
@@ -374,7 +467,7 @@ buffer_flush_window (struct buffer *b, int fd, int width, int height,
       struct buffer_data *del;
       if (!(b->head = (del = b->head)->next))
         b->tail = NULL;
-      BUFFER_DATA_FREE(del);
+      BUFFER_DATA_FREE(b, del);
     }
 
   if (iov != small_iov)
@@ -430,6 +523,7 @@ in one shot. */
 		__func__, fd, safe_strerror(errno));
       return BUFFER_ERROR;
     }
+  b->length -= written;
 
   /* Free printed buffer data. */
   while (written > 0)
@@ -450,7 +544,7 @@ in one shot. */
       written -= (d->cp-d->sp);
       if (!(b->head = d->next))
         b->tail = NULL;
-      BUFFER_DATA_FREE(d);
+      BUFFER_DATA_FREE(b, d);
     }
 
   return b->head ? BUFFER_PENDING : BUFFER_EMPTY;
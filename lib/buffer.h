@@ -42,6 +42,9 @@ extern void buffer_put (struct buffer *, const void *, size_t);
 extern void buffer_putc (struct buffer *, u_char);
 /* Add a NUL-terminated string to the end of the buffer. */
 extern void buffer_putstr (struct buffer *, const char *);
+/* Add formatted output to the end of the buffer; returns its length, or
+   a negative value on a formatting error. */
+extern int buffer_vprintf (struct buffer *, const char *, va_list);
 
 /* Combine all accumulated (and unflushed) data inside the buffer into a
    single NUL-terminated string allocated using XMALLOC(MTYPE_TMP).  Note
@@ -52,6 +55,9 @@ char *buffer_getstr (struct buffer *);
 /* Returns 1 if there is no pending data in the buffer.  Otherwise returns 0. */
 int buffer_empty (struct buffer *);
 
+/* Returns the number of bytes of pending data in the buffer. */
+extern size_t buffer_length (struct buffer *);
+
 typedef enum
   {
     /* An I/O error occurred.  The buffer should be destroyed and the
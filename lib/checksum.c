@@ -9,6 +9,10 @@
 #include <zebra.h>
 #include "checksum.h"
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 int			/* return checksum in low-order 16 bits */
 in_cksum(void *parg, int nbytes)
 {
@@ -49,6 +53,64 @@ in_cksum(void *parg, int nbytes)
 /* Fletcher Checksum -- Refer to RFC1008. */
 #define MODX                 4102   /* 5802 should be fine */
 
+/* Run the Fletcher sums over n bytes, no more than MODX.  Fed bytes
+   b[0..k-1] one at a time, c1 gains k * c0 + sum (k - j) * b[j] and c0
+   gains sum b[j], so whole chunks can be summed independently instead of
+   through a chain of dependent adds.  Reduction is left to the caller. */
+static void
+fletcher_sum (const u_int8_t *p, size_t n, unsigned int *pc0,
+	      unsigned int *pc1)
+{
+  unsigned int c0 = *pc0, c1 = *pc1;
+
+#ifdef __SSE2__
+  if (n >= 16)
+    {
+      const __m128i zero = _mm_setzero_si128 ();
+      const __m128i wlo = _mm_set_epi16 (9, 10, 11, 12, 13, 14, 15, 16);
+      const __m128i whi = _mm_set_epi16 (1, 2, 3, 4, 5, 6, 7, 8);
+      __m128i v, vs = zero, vps = zero, vt = zero;
+      size_t chunks = n / 16, i;
+
+      /* vs: bytes summed so far, vps: vs before each chunk, vt: the
+	 weighted sums within chunks. */
+      for (i = 0; i < chunks; i++, p += 16)
+	{
+	  v = _mm_loadu_si128 ((const __m128i *) p);
+	  vps = _mm_add_epi32 (vps, vs);
+	  vs = _mm_add_epi32 (vs, _mm_sad_epu8 (v, zero));
+	  vt = _mm_add_epi32 (vt, _mm_madd_epi16 (_mm_unpacklo_epi8 (v, zero),
+						  wlo));
+	  vt = _mm_add_epi32 (vt, _mm_madd_epi16 (_mm_unpackhi_epi8 (v, zero),
+						  whi));
+	}
+      vs = _mm_add_epi32 (vs, _mm_srli_si128 (vs, 8));
+      vps = _mm_add_epi32 (vps, _mm_srli_si128 (vps, 8));
+      vt = _mm_add_epi32 (vt, _mm_srli_si128 (vt, 8));
+      vt = _mm_add_epi32 (vt, _mm_srli_si128 (vt, 4));
+
+      c1 += chunks * 16 * c0 + 16 * (unsigned int) _mm_cvtsi128_si32 (vps)
+	    + (unsigned int) _mm_cvtsi128_si32 (vt);
+      c0 += (unsigned int) _mm_cvtsi128_si32 (vs);
+      n -= chunks * 16;
+    }
+#endif /* __SSE2__ */
+
+  for (; n >= 4; n -= 4, p += 4)
+    {
+      c1 += 4 * c0 + 4 * p[0] + 3 * p[1] + 2 * p[2] + p[3];
+      c0 += p[0] + p[1] + p[2] + p[3];
+    }
+  for (; n; n--)
+    {
+      c0 += *(p++);
+      c1 += c0;
+    }
+
+  *pc0 = c0;
+  *pc1 = c1;
+}
+
 /* To be consistent, offset is 0-based index, rather than the 1-based 
    index required in the specification ISO 8473, Annex C.1 */
 /* calling with offset == FLETCHER_CHECKSUM_VALIDATE will validate the checksum
@@ -57,10 +119,11 @@ u_int16_t
 fletcher_checksum(u_char * buffer, const size_t len, const uint16_t offset)
 {
   u_int8_t *p;
-  int x, y, c0, c1;
+  int x, y;
+  unsigned int c0, c1;
   u_int16_t checksum;
   u_int16_t *csum;
-  size_t partial_len, i, left = len;
+  size_t partial_len, left = len;
   
   checksum = 0;
 
@@ -81,11 +144,8 @@ fletcher_checksum(u_char * buffer, const size_t len, const uint16_t offset)
     {
       partial_len = MIN(left, MODX);
 
-      for (i = 0; i < partial_len; i++)
-	{
-	  c0 = c0 + *(p++);
-	  c1 += c0;
-	}
+      fletcher_sum (p, partial_len, &c0, &c1);
+      p += partial_len;
 
       c0 = c0 % 255;
       c1 = c1 % 255;
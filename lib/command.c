@@ -26,6 +26,7 @@ Boston, MA 02111-1307, USA.  */
 #include "log.h"
 #include <lib/version.h>
 #include "thread.h"
+#include "hash.h"
 #include "vector.h"
 #include "vty.h"
 #include "command.h"
@@ -186,6 +187,50 @@ argv_concat (const char **argv, int argc, int shift)
   return str;
 }
 
+/* The commands of a node indexed by their first token.  Executing a
+   line first filters the node's commands by the line's first word;
+   with the index only the commands whose first token can match it
+   are looked at, instead of the whole node.  The index holds
+   positions in cmd_vector so that the candidates keep the order of
+   cmd_vector, which the filters depend on. */
+struct cmd_index_keyword
+{
+  const char *keyword;
+  unsigned int pos;
+};
+
+struct cmd_index
+{
+  /* Commands whose first token is a keyword, sorted by keyword. */
+  struct cmd_index_keyword *keywords;
+  unsigned int nkeywords;
+
+  /* Commands whose first token may be anything else. */
+  unsigned int *wild;
+  unsigned int nwild;
+
+  /* Room for collecting the candidates of one line. */
+  unsigned int *scratch;
+};
+
+static void
+cmd_index_free (struct cmd_node *cnode)
+{
+  struct cmd_index *index = cnode->cmd_index;
+
+  if (index == NULL)
+    return;
+
+  if (index->keywords)
+    XFREE (MTYPE_CMD_INDEX, index->keywords);
+  if (index->wild)
+    XFREE (MTYPE_CMD_INDEX, index->wild);
+  if (index->scratch)
+    XFREE (MTYPE_CMD_INDEX, index->scratch);
+  XFREE (MTYPE_CMD_INDEX, index);
+  cnode->cmd_index = NULL;
+}
+
 /* Install top node of command vector. */
 void
 install_node (struct cmd_node *node, 
@@ -194,6 +239,7 @@ install_node (struct cmd_node *node,
   vector_set_index (cmdvec, node->node, node);
   node->func = func;
   node->cmd_vector = vector_init (VECTOR_MIN_SIZE);
+  node->cmd_index = NULL;
 }
 
 /* Compare two command's string.  Used in sort_node (). */
@@ -240,6 +286,9 @@ sort_node ()
 	      qsort (descvec->index, vector_active (descvec), 
 	             sizeof (void *), cmp_desc);
 	    }
+
+	/* Positions have changed. */
+	cmd_index_free (cnode);
       }
 }
 
@@ -497,6 +546,7 @@ install_element (enum node_type ntype, struct cmd_element *cmd)
     }
 
   vector_set (cnode->cmd_vector, cmd);
+  cmd_index_free (cnode);
 
   if (cmd->strvec == NULL)
     cmd->strvec = cmd_make_descvec (cmd->string, cmd->doc);
@@ -607,6 +657,17 @@ config_write_host (struct vty *vty)
     vty_out (vty, "log timestamp precision %d%s",
 	     zlog_default->timestamp_precision, VTY_NEWLINE);
 
+  if (zlog_default->async)
+    {
+      unsigned long dropped;
+      unsigned int size = zlog_async_size (zlog_default, &dropped);
+
+      if (size != ZLOG_ASYNC_DEFAULT)
+	vty_out (vty, "log async %u%s", size, VTY_NEWLINE);
+      else
+	vty_out (vty, "log async%s", VTY_NEWLINE);
+    }
+
   if (host.advanced)
     vty_out (vty, "service advanced-vty%s", VTY_NEWLINE);
 
@@ -617,6 +678,9 @@ config_write_host (struct vty *vty)
     vty_out (vty, "service terminal-length %d%s", host.lines,
 	     VTY_NEWLINE);
 
+  if (thread_lag_warn)
+    vty_out (vty, "thread lag-warning %lu%s", thread_lag_warn, VTY_NEWLINE);
+
   if (host.motdfile)
     vty_out (vty, "banner motd file %s%s", host.motdfile, VTY_NEWLINE);
   else if (! host.motd)
@@ -633,6 +697,157 @@ cmd_node_vector (vector v, enum node_type ntype)
   return cnode->cmd_vector;
 }
 
+/* Is str a literal keyword, i.e. matched by comparing strings? */
+static int
+cmd_keyword (const char *str)
+{
+  return ! (CMD_VARARG (str) || CMD_RANGE (str)
+	    || CMD_IPV6 (str) || CMD_IPV6_PREFIX (str)
+	    || CMD_IPV4 (str) || CMD_IPV4_PREFIX (str)
+	    || CMD_OPTION (str) || CMD_VARIABLE (str));
+}
+
+static int
+cmp_index_keyword (const void *p, const void *q)
+{
+  const struct cmd_index_keyword *a = p;
+  const struct cmd_index_keyword *b = q;
+  int ret;
+
+  ret = strcmp (a->keyword, b->keyword);
+  if (ret)
+    return ret;
+  return (a->pos > b->pos) - (a->pos < b->pos);
+}
+
+static int
+cmp_index_pos (const void *p, const void *q)
+{
+  unsigned int a = *(const unsigned int *) p;
+  unsigned int b = *(const unsigned int *) q;
+
+  return (a > b) - (a < b);
+}
+
+static struct cmd_index *
+cmd_index_build (struct cmd_node *cnode)
+{
+  struct cmd_index *index;
+  struct cmd_element *cmd_element;
+  vector descvec;
+  struct desc *desc;
+  unsigned int i, j, ncmds, nkeywords = 0, wild;
+
+  /* Size the tables. */
+  for (i = 0; i < vector_active (cnode->cmd_vector); i++)
+    if ((cmd_element = vector_slot (cnode->cmd_vector, i)) != NULL
+	&& vector_active (cmd_element->strvec))
+      {
+	descvec = vector_slot (cmd_element->strvec, 0);
+	for (j = 0; j < vector_active (descvec); j++)
+	  if ((desc = vector_slot (descvec, j)) != NULL)
+	    nkeywords++;
+      }
+
+  index = XCALLOC (MTYPE_CMD_INDEX, sizeof (struct cmd_index));
+  ncmds = vector_active (cnode->cmd_vector);
+  index->keywords = XCALLOC (MTYPE_CMD_INDEX,
+			     sizeof (struct cmd_index_keyword) * (nkeywords + 1));
+  index->wild = XCALLOC (MTYPE_CMD_INDEX, sizeof (unsigned int) * (ncmds + 1));
+  index->scratch = XCALLOC (MTYPE_CMD_INDEX,
+			    sizeof (unsigned int) * (nkeywords + ncmds + 1));
+
+  /* A command whose first token has any non-keyword alternative goes
+     into wild as a whole; the others are listed under each keyword.
+     Commands with no tokens cannot match a word and are left out. */
+  for (i = 0; i < vector_active (cnode->cmd_vector); i++)
+    if ((cmd_element = vector_slot (cnode->cmd_vector, i)) != NULL
+	&& vector_active (cmd_element->strvec))
+      {
+	descvec = vector_slot (cmd_element->strvec, 0);
+	wild = 0;
+	for (j = 0; j < vector_active (descvec); j++)
+	  if ((desc = vector_slot (descvec, j)) != NULL
+	      && ! cmd_keyword (desc->cmd))
+	    wild = 1;
+
+	if (wild)
+	  {
+	    index->wild[index->nwild++] = i;
+	    continue;
+	  }
+
+	for (j = 0; j < vector_active (descvec); j++)
+	  if ((desc = vector_slot (descvec, j)) != NULL)
+	    {
+	      index->keywords[index->nkeywords].keyword = desc->cmd;
+	      index->keywords[index->nkeywords].pos = i;
+	      index->nkeywords++;
+	    }
+      }
+
+  qsort (index->keywords, index->nkeywords, sizeof (struct cmd_index_keyword),
+	 cmp_index_keyword);
+
+  cnode->cmd_index = index;
+  return index;
+}
+
+/* Return a new vector of the commands of the current node that the
+   first word of vline may match, in cmd_vector order.  This is a
+   superset of what the filters keep at index 0, and the commands left
+   out would not have contributed to the match type there either. */
+static vector
+cmd_node_candidates (enum node_type ntype, vector vline)
+{
+  struct cmd_node *cnode = vector_slot (cmdvec, ntype);
+  struct cmd_index *index;
+  const char *word;
+  size_t len;
+  unsigned int lo, hi, mid, n, i;
+  vector v;
+
+  if (vector_active (vline) == 0
+      || (word = vector_slot (vline, 0)) == NULL)
+    return vector_copy (cnode->cmd_vector);
+
+  index = cnode->cmd_index;
+  if (index == NULL)
+    index = cmd_index_build (cnode);
+
+  /* First keyword not below word; the keywords word abbreviates
+     follow it. */
+  lo = 0;
+  hi = index->nkeywords;
+  while (lo < hi)
+    {
+      mid = lo + (hi - lo) / 2;
+      if (strcmp (index->keywords[mid].keyword, word) < 0)
+	lo = mid + 1;
+      else
+	hi = mid;
+    }
+
+  len = strlen (word);
+  n = 0;
+  for (i = lo; i < index->nkeywords; i++)
+    {
+      if (strncmp (index->keywords[i].keyword, word, len) != 0)
+	break;
+      index->scratch[n++] = index->keywords[i].pos;
+    }
+  for (i = 0; i < index->nwild; i++)
+    index->scratch[n++] = index->wild[i];
+
+  qsort (index->scratch, n, sizeof (unsigned int), cmp_index_pos);
+
+  v = vector_init (n);
+  for (i = 0; i < n; i++)
+    if (i == 0 || index->scratch[i] != index->scratch[i - 1])
+      vector_set (v, vector_slot (cnode->cmd_vector, index->scratch[i]));
+  return v;
+}
+
 #if 0
 /* Filter command vector by symbol.  This function is not actually used;
  * should it be deleted? */
@@ -1942,8 +2157,8 @@ cmd_execute_command_real (vector vline, struct vty *vty,
   int varflag;
   char *command;
 
-  /* Make copy of command elements. */
-  cmd_vector = vector_copy (cmd_node_vector (cmdvec, vty->node));
+  /* Make copy of the command elements the first word may match. */
+  cmd_vector = cmd_node_candidates (vty->node, vline);
 
   for (index = 0; index < vector_active (vline); index++)
     if ((command = vector_slot (vline, index)))
@@ -2121,8 +2336,8 @@ cmd_execute_command_strict (vector vline, struct vty *vty,
   enum match_type match = 0;
   char *command;
 
-  /* Make copy of command element */
-  cmd_vector = vector_copy (cmd_node_vector (cmdvec, vty->node));
+  /* Make copy of the command elements the first word may match. */
+  cmd_vector = cmd_node_candidates (vty->node, vline);
 
   for (index = 0; index < vector_active (vline); index++)
     if ((command = vector_slot (vline, index)))
@@ -3038,6 +3253,17 @@ DEFUN (show_logging,
   vty_out (vty, "Timestamp precision: %d%s",
 	   zl->timestamp_precision, VTY_NEWLINE);
 
+  if (zl->async)
+    {
+      unsigned long dropped;
+      unsigned int size = zlog_async_size (zl, &dropped);
+
+      vty_out (vty, "File writes: by writer thread, %u kbyte buffer, "
+	       "%lu messages dropped%s", size, dropped, VTY_NEWLINE);
+    }
+  else
+    vty_out (vty, "File writes: synchronous%s", VTY_NEWLINE);
+
   return CMD_SUCCESS;
 }
 
@@ -3392,6 +3618,38 @@ DEFUN (no_config_log_timestamp_precision,
   return CMD_SUCCESS;
 }
 
+DEFUN (config_log_async,
+       config_log_async_cmd,
+       "log async [<64-65536>]",
+       "Logging control\n"
+       "Leave writing the log file to a separate thread\n"
+       "Size of the buffer for messages not written yet, in kbytes\n")
+{
+  unsigned int size = ZLOG_ASYNC_DEFAULT;
+
+  if (argc > 0)
+    VTY_GET_INTEGER_RANGE ("buffer size", size, argv[0], 64, 65536);
+
+  if (zlog_set_async (NULL, size) < 0)
+    {
+      vty_out (vty, "%% Not supported without thread support%s", VTY_NEWLINE);
+      return CMD_WARNING;
+    }
+  return CMD_SUCCESS;
+}
+
+DEFUN (no_config_log_async,
+       no_config_log_async_cmd,
+       "no log async [<64-65536>]",
+       NO_STR
+       "Logging control\n"
+       "Write the log file from the daemon itself\n"
+       "Size of the buffer for messages not written yet, in kbytes\n")
+{
+  zlog_set_async (NULL, 0);
+  return CMD_SUCCESS;
+}
+
 DEFUN (banner_motd_file,
        banner_motd_file_cmd,
        "banner motd file [FILE]",
@@ -3565,6 +3823,8 @@ cmd_init (int terminal)
       install_element (CONFIG_NODE, &no_config_log_record_priority_cmd);
       install_element (CONFIG_NODE, &config_log_timestamp_precision_cmd);
       install_element (CONFIG_NODE, &no_config_log_timestamp_precision_cmd);
+      install_element (CONFIG_NODE, &config_log_async_cmd);
+      install_element (CONFIG_NODE, &no_config_log_async_cmd);
       install_element (CONFIG_NODE, &service_password_encrypt_cmd);
       install_element (CONFIG_NODE, &no_service_password_encrypt_cmd);
       install_element (CONFIG_NODE, &banner_motd_default_cmd);
@@ -3572,12 +3832,23 @@ cmd_init (int terminal)
       install_element (CONFIG_NODE, &no_banner_motd_cmd);
       install_element (CONFIG_NODE, &service_terminal_length_cmd);
       install_element (CONFIG_NODE, &no_service_terminal_length_cmd);
+      install_element (CONFIG_NODE, &thread_lag_warning_cmd);
+      install_element (CONFIG_NODE, &no_thread_lag_warning_cmd);
 
       install_element (VIEW_NODE, &show_thread_cpu_cmd);
       install_element (ENABLE_NODE, &show_thread_cpu_cmd);
       install_element (RESTRICTED_NODE, &show_thread_cpu_cmd);
+      install_element (VIEW_NODE, &show_thread_latency_cmd);
+      install_element (ENABLE_NODE, &show_thread_latency_cmd);
+      install_element (VIEW_NODE, &show_thread_timers_cmd);
+      install_element (ENABLE_NODE, &show_thread_timers_cmd);
+      install_element (VIEW_NODE, &show_thread_lag_cmd);
+      install_element (ENABLE_NODE, &show_thread_lag_cmd);
+      install_element (VIEW_NODE, &show_hash_statistics_cmd);
+      install_element (ENABLE_NODE, &show_hash_statistics_cmd);
       
       install_element (ENABLE_NODE, &clear_thread_cpu_cmd);
+      install_element (ENABLE_NODE, &clear_thread_lag_cmd);
       install_element (VIEW_NODE, &show_work_queues_cmd);
       install_element (ENABLE_NODE, &show_work_queues_cmd);
     }
@@ -3627,6 +3898,7 @@ cmd_terminate ()
                 }
 
             vector_free (cmd_node_v);
+            cmd_index_free (cmd_node);
           }
 
       vector_free (cmdvec);
@@ -123,6 +123,9 @@ struct cmd_node
 
   /* Vector of this node's command list. */
   vector cmd_vector;	
+
+  /* cmd_vector indexed by first token, built on first use. */
+  struct cmd_index *cmd_index;
 };
 
 enum
@@ -633,6 +633,7 @@ config_show_distribute (struct vty *vty)
   else
     vty_out (vty, "  Outgoing update filter list for all interface is not set%s", VTY_NEWLINE);
 
+  hash_rehash_finish (disthash);
   for (i = 0; i < disthash->size; i++)
     for (mp = disthash->index[i]; mp; mp = mp->next)
       {
@@ -668,6 +669,7 @@ config_show_distribute (struct vty *vty)
   else
     vty_out (vty, "  Incoming update filter list for all interface is not set%s", VTY_NEWLINE);
 
+  hash_rehash_finish (disthash);
   for (i = 0; i < disthash->size; i++)
     for (mp = disthash->index[i]; mp; mp = mp->next)
       {
@@ -696,6 +698,7 @@ config_write_distribute (struct vty *vty)
   struct hash_backet *mp;
   int write = 0;
 
+  hash_rehash_finish (disthash);
   for (i = 0; i < disthash->size; i++)
     for (mp = disthash->index[i]; mp; mp = mp->next)
       {
@@ -28,6 +28,8 @@
 #include "sockunion.h"
 #include "buffer.h"
 #include "log.h"
+#include "table.h"
+#include "hash.h"
 
 struct filter_cisco
 {
@@ -66,6 +68,21 @@ struct filter
       struct filter_cisco cfilter;
       struct filter_zebra zfilter;
     } u;
+
+  /* Position in the list, and next filter in the same index chain. */
+  int order;
+  struct filter *index_next;
+};
+
+/* An access-list's filters by the prefix they match on, each node of a
+   table chaining its filters in list order.  Zebra filters are keyed by
+   their prefix, standard cisco ones with a contiguous wildcard by the
+   address bits they compare; the other filters are just chained. */
+struct access_list_index
+{
+  struct route_table *zebra;
+  struct route_table *cisco;
+  struct filter *other;
 };
 
 /* List of access_list. */
@@ -89,6 +106,9 @@ struct access_master
 
   /* Hook function which is executed when access_list is deleted. */
   void (*delete_hook) (struct access_list *);
+
+  /* Access lists by name. */
+  struct hash *hash;
 };
 
 /* Static structure for IPv4 access_list's master. */
@@ -198,17 +218,144 @@ filter_match_zebra (struct filter *mfilter, struct prefix *p)
       if (filter->exact)
 	{
 	  if (filter->prefix.prefixlen == p->prefixlen)
-	    return prefix_match (&filter->prefix, p);
+	    return prefix_match_inline (&filter->prefix, p);
 	  else
 	    return 0;
 	}
       else
-	return prefix_match (&filter->prefix, p);
+	return prefix_match_inline (&filter->prefix, p);
     }
   else
     return 0;
 }
 
+static int
+filter_match (struct filter *mfilter, struct prefix *p)
+{
+  if (mfilter->cisco)
+    return filter_match_cisco (mfilter, p);
+  else
+    return filter_match_zebra (mfilter, p);
+}
+
+/* Append filter to the chain at pp. */
+static void
+access_list_index_chain (struct filter **pp, struct filter *filter)
+{
+  while (*pp)
+    pp = &(*pp)->index_next;
+  *pp = filter;
+}
+
+static void
+access_list_index_add (struct route_table **table, struct prefix *p,
+		       struct filter *filter)
+{
+  struct route_node *rn;
+
+  if (! *table)
+    *table = route_table_init ();
+
+  apply_mask (p);
+  rn = route_node_get (*table, p);
+  if (rn->info)
+    route_unlock_node (rn);
+  access_list_index_chain ((struct filter **) &rn->info, filter);
+}
+
+static struct access_list_index *
+access_list_index_build (struct access_list *access)
+{
+  struct access_list_index *index;
+  struct filter *filter;
+  struct filter_cisco *cfilter;
+  struct prefix p;
+  struct in_addr mask;
+  u_int32_t wildcard;
+  int order = 0;
+
+  index = XCALLOC (MTYPE_ACCESS_INDEX, sizeof (struct access_list_index));
+
+  for (filter = access->head; filter; filter = filter->next)
+    {
+      filter->order = order++;
+      filter->index_next = NULL;
+
+      if (! filter->cisco)
+	{
+	  prefix_copy (&p, &filter->u.zfilter.prefix);
+	  access_list_index_add (&index->zebra, &p, filter);
+	  continue;
+	}
+
+      cfilter = &filter->u.cfilter;
+      wildcard = ntohl (cfilter->addr_mask.s_addr);
+      if (! cfilter->extended && (wildcard & (wildcard + 1)) == 0)
+	{
+	  memset (&p, 0, sizeof (struct prefix));
+	  p.family = AF_INET;
+	  p.u.prefix4 = cfilter->addr;
+	  mask.s_addr = ~cfilter->addr_mask.s_addr;
+	  p.prefixlen = ip_masklen (mask);
+	  access_list_index_add (&index->cisco, &p, filter);
+	}
+      else
+	access_list_index_chain (&index->other, filter);
+    }
+
+  return index;
+}
+
+static void
+access_list_index_free (struct access_list *access)
+{
+  if (! access->index)
+    return;
+  if (access->index->zebra)
+    route_table_finish (access->index->zebra);
+  if (access->index->cisco)
+    route_table_finish (access->index->cisco);
+  XFREE (MTYPE_ACCESS_INDEX, access->index);
+}
+
+/* First filter in chain, before matched, that matches p. */
+static struct filter *
+access_list_index_match (struct filter *chain, struct filter *matched,
+			 struct prefix *p)
+{
+  struct filter *filter;
+
+  for (filter = chain; filter; filter = filter->index_next)
+    {
+      if (matched && filter->order >= matched->order)
+	break;
+      if (filter_match (filter, p))
+	return filter;
+    }
+  return matched;
+}
+
+/* Filters of table that may match p are at its longest match of p and
+   its parents. */
+static struct filter *
+access_list_index_lookup (struct route_table *table, struct filter *matched,
+			  struct prefix *p)
+{
+  struct route_node *top;
+  struct route_node *rn;
+
+  if (! table)
+    return matched;
+
+  top = route_node_match (table, p);
+  for (rn = top; rn; rn = rn->parent)
+    matched = access_list_index_match (rn->info, matched, p);
+  if (top)
+    route_unlock_node (top);
+
+  return matched;
+}
+
 /* Allocate new access list structure. */
 static struct access_list *
 access_list_new (void)
@@ -233,6 +380,8 @@ access_list_delete (struct access_list *access)
   struct access_list_list *list;
   struct access_master *master;
 
+  access_list_index_free (access);
+
   for (filter = access->head; filter; filter = next)
     {
       next = filter->next;
@@ -256,6 +405,8 @@ access_list_delete (struct access_list *access)
   else
     list->head = access->next;
 
+  hash_release (master->hash, access);
+
   if (access->name)
     XFREE (MTYPE_ACCESS_LIST_STR, access->name);
 
@@ -357,29 +508,28 @@ access_list_insert (afi_t afi, const char *name)
   return access;
 }
 
+static const char *
+access_list_name (const void *arg)
+{
+  const struct access_list *access = arg;
+
+  return access->name;
+}
+
 /* Lookup access_list from list of access_list by name. */
 struct access_list *
 access_list_lookup (afi_t afi, const char *name)
 {
-  struct access_list *access;
   struct access_master *master;
 
   if (name == NULL)
     return NULL;
 
   master = access_master_get (afi);
-  if (master == NULL)
+  if (master == NULL || master->hash == NULL)
     return NULL;
 
-  for (access = master->num.head; access; access = access->next)
-    if (strcmp (access->name, name) == 0)
-      return access;
-
-  for (access = master->str.head; access; access = access->next)
-    if (strcmp (access->name, name) == 0)
-      return access;
-
-  return NULL;
+  return hash_lookup_name (master->hash, name);
 }
 
 /* Get access list from list of access_list.  If there isn't matched
@@ -391,7 +541,15 @@ access_list_get (afi_t afi, const char *name)
 
   access = access_list_lookup (afi, name);
   if (access == NULL)
-    access = access_list_insert (afi, name);
+    {
+      access = access_list_insert (afi, name);
+      if (access)
+	{
+	  if (! access->master->hash)
+	    access->master->hash = hash_create_name (access_list_name);
+	  hash_get (access->master->hash, access, hash_alloc_intern);
+	}
+    }
   return access;
 }
 
@@ -399,28 +557,37 @@ access_list_get (afi_t afi, const char *name)
 enum filter_type
 access_list_apply (struct access_list *access, void *object)
 {
-  struct filter *filter;
+  struct access_list_index *index;
+  struct filter *matched;
   struct prefix *p;
+  struct prefix_ipv4 host;
 
   p = (struct prefix *) object;
 
   if (access == NULL)
     return FILTER_DENY;
 
-  for (filter = access->head; filter; filter = filter->next)
+  if (! access->index)
+    access->index = access_list_index_build (access);
+  index = access->index;
+
+  matched = access_list_index_lookup (index->zebra, NULL, p);
+
+  /* Cisco filters only look at the address. */
+  if (index->cisco)
     {
-      if (filter->cisco)
-	{
-	  if (filter_match_cisco (filter, p))
-	    return filter->type;
-	}
-      else
-	{
-	  if (filter_match_zebra (filter, p))
-	    return filter->type;
-	}
+      host.family = AF_INET;
+      host.prefixlen = IPV4_MAX_BITLEN;
+      host.prefix = p->u.prefix4;
+      matched = access_list_index_lookup (index->cisco, matched,
+					  (struct prefix *) &host);
     }
 
+  matched = access_list_index_match (index->other, matched, p);
+
+  if (matched)
+    return matched->type;
+
   return FILTER_DENY;
 }
 
@@ -444,6 +611,47 @@ access_list_delete_hook (void (*func) (struct access_list *access))
 #endif /* HAVE_IPV6 */
 }
 
+/* Non-zero while add hooks are held back, see access_list_hook_defer(). */
+static int access_list_hook_deferred;
+
+static void
+access_list_list_run_pending (struct access_master *master,
+			      struct access_list_list *list)
+{
+  struct access_list *access;
+
+  for (access = list->head; access; access = access->next)
+    if (access->hook_pending)
+      {
+	access->hook_pending = 0;
+	if (master->add_hook)
+	  (*master->add_hook) (access);
+      }
+}
+
+static void
+access_master_run_pending (struct access_master *master)
+{
+  access_list_list_run_pending (master, &master->num);
+  access_list_list_run_pending (master, &master->str);
+}
+
+/* While deferred, filter additions only mark their access-list and
+   the add hook runs once per marked list when deferral is switched
+   off.  Delete hooks are never deferred. */
+void
+access_list_hook_defer (int defer)
+{
+  access_list_hook_deferred = defer;
+  if (defer)
+    return;
+
+  access_master_run_pending (&access_master_ipv4);
+#ifdef HAVE_IPV6
+  access_master_run_pending (&access_master_ipv6);
+#endif /* HAVE_IPV6 */
+}
+
 /* Add new filter to the end of specified access_list. */
 static void
 access_list_filter_add (struct access_list *access, struct filter *filter)
@@ -457,8 +665,12 @@ access_list_filter_add (struct access_list *access, struct filter *filter)
     access->head = filter;
   access->tail = filter;
 
+  access_list_index_free (access);
+
   /* Run hook function. */
-  if (access->master->add_hook)
+  if (access_list_hook_deferred)
+    access->hook_pending = 1;
+  else if (access->master->add_hook)
     (*access->master->add_hook) (access);
 }
 
@@ -492,6 +704,7 @@ access_list_filter_delete (struct access_list *access, struct filter *filter)
     access->head = filter->next;
 
   filter_free (filter);
+  access_list_index_free (access);
 
   /* If access_list becomes empty delete it from access_master. */
   if (access_list_empty (access))
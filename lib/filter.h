@@ -54,6 +54,12 @@ struct access_list
 
   struct filter *head;
   struct filter *tail;
+
+  /* Filters by prefix, built by access_list_apply(). */
+  struct access_list_index *index;
+
+  /* Add hook held back by access_list_hook_defer(). */
+  int hook_pending;
 };
 
 /* Prototypes for access-list. */
@@ -61,6 +67,7 @@ extern void access_list_init (void);
 extern void access_list_reset (void);
 extern void access_list_add_hook (void (*func)(struct access_list *));
 extern void access_list_delete_hook (void (*func)(struct access_list *));
+extern void access_list_hook_defer (int);
 extern struct access_list *access_list_lookup (afi_t, const char *);
 extern enum filter_type access_list_apply (struct access_list *, void *);
 
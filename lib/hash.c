@@ -23,16 +23,26 @@
 
 #include "hash.h"
 #include "memory.h"
+#include "command.h"
+#include "vty.h"
 
-/* Allocate a new hash.  */
+/* Hashes listed by show hash statistics. */
+static struct hash *hash_named;
+
+/* Allocate a new hash.  The size is rounded up to a power of 2, so it
+   can be the number of entries expected.  */
 struct hash *
 hash_create_size (unsigned int size, unsigned int (*hash_key) (void *),
                                      int (*hash_cmp) (const void *, const void *))
 {
   struct hash *hash;
+  unsigned int n;
+
+  for (n = 1; n < size && n < (1U << 31); n <<= 1)
+    ;
+  size = n;
 
-  assert ((size & (size-1)) == 0);
-  hash = XMALLOC (MTYPE_HASH, sizeof (struct hash));
+  hash = XCALLOC (MTYPE_HASH, sizeof (struct hash));
   hash->index = XCALLOC (MTYPE_HASH_INDEX,
 			 sizeof (struct hash_backet *) * size);
   hash->size = size;
@@ -43,6 +53,25 @@ hash_create_size (unsigned int size, unsigned int (*hash_key) (void *),
   return hash;
 }
 
+/* Allocate a new open addressing hash, for about size entries.  */
+struct hash *
+hash_create_open (unsigned int size, unsigned int (*hash_key) (void *),
+		  int (*hash_cmp) (const void *, const void *))
+{
+  struct hash *hash;
+
+  hash = hash_create_size (1, hash_key, hash_cmp);
+  XFREE (MTYPE_HASH_INDEX, hash->index);
+  hash->index = NULL;
+
+  size = (unsigned long long) size * 100 / HASH_OPEN_LOAD;
+  for (hash->size = 16; hash->size < size && hash->size < (1U << 31); )
+    hash->size <<= 1;
+  hash->slots = XCALLOC (MTYPE_HASH_INDEX,
+			 sizeof (struct hash_slot) * hash->size);
+  return hash;
+}
+
 /* Allocate a new hash with default hash size.  */
 struct hash *
 hash_create (unsigned int (*hash_key) (void *), 
@@ -51,6 +80,50 @@ hash_create (unsigned int (*hash_key) (void *),
   return hash_create_size (HASH_INITIAL_SIZE, hash_key, hash_cmp);
 }
 
+/* Allocate a new hash of named entries.  */
+struct hash *
+hash_create_name (const char * (*name_of) (const void *))
+{
+  struct hash *hash;
+
+  hash = hash_create_size (HASH_INITIAL_SIZE, NULL, NULL);
+  hash->name_of = name_of;
+  return hash;
+}
+
+/* Same, open addressing, for about size entries.  */
+struct hash *
+hash_create_open_name (unsigned int size,
+		       const char * (*name_of) (const void *))
+{
+  struct hash *hash;
+
+  hash = hash_create_open (size, NULL, NULL);
+  hash->name_of = name_of;
+  return hash;
+}
+
+/* Hash key of data, by name for tables of named entries.  */
+static unsigned int
+hash_make_key (struct hash *hash, void *data)
+{
+  if (hash->name_of)
+    return string_hash_make ((*hash->name_of) (data));
+  return (*hash->hash_key) (data);
+}
+
+/* Whether the entry found is data or, if name is set, is known by
+   that name.  */
+static int
+hash_match (struct hash *hash, const void *entry, const void *data,
+	    const char *name)
+{
+  if (hash->name_of)
+    return strcmp ((*hash->name_of) (entry),
+		   name ? name : (*hash->name_of) (data)) == 0;
+  return (*hash->hash_cmp) (entry, data);
+}
+
 /* Utility function for hash_get().  When this function is specified
    as alloc_func, return arugment as it is.  This function is used for
    intern already allocated value.  */
@@ -60,50 +133,342 @@ hash_alloc_intern (void *arg)
   return arg;
 }
 
-/* Expand hash if the chain length exceeds the threshold. */
-static void hash_expand (struct hash *hash)
+/* Open addressing tables.  Robin Hood linear probing: an entry is
+ * never further from its home slot than the ones it passed on insert,
+ * so a lookup can stop as soon as it meets an entry closer to home
+ * than it is.  Releases shift the entries after back by one.
+ *
+ * While hash_iterate() walks a table, entries cannot move: releases
+ * leave a tombstone, adds take the first free slot without regard to
+ * order, and the table is put back in order once the walk is done.
+ * Tables grow like chained ones, the entries of the old array moving a
+ * few slots at a time on later inserts, and tombstones marking those
+ * moved or released meanwhile.
+ */
+static char hash_tombstone;
+#define HASH_TOMB ((void *) &hash_tombstone)
+
+/* How far the entry in slot i is from its home slot. */
+#define HASH_SLOT_DIST(S,I,MASK) (((I) - ((S)[I].key & (MASK))) & (MASK))
+
+static struct hash_slot *
+hash_open_find (struct hash *hash, struct hash_slot *slots, unsigned int size,
+		unsigned int key, void *data, const char *name, int ordered)
 {
-  unsigned int i, new_size, losers;
-  struct hash_backet *hb, *hbnext, **new_index;
+  unsigned int mask = size - 1;
+  unsigned int i, dist;
 
-  new_size = hash->size * 2;
-  new_index = XCALLOC(MTYPE_HASH_INDEX, sizeof(struct hash_backet *) * new_size);
-  if (new_index == NULL)
+  for (i = key & mask, dist = 0; dist < size; i = (i + 1) & mask, dist++)
+    {
+      if (slots[i].data == NULL)
+	return NULL;
+      if (slots[i].data != HASH_TOMB && slots[i].key == key
+	  && hash_match (hash, slots[i].data, data, name))
+	return &slots[i];
+      if (ordered && HASH_SLOT_DIST (slots, i, mask) < dist)
+	return NULL;
+    }
+  return NULL;
+}
+
+static void
+hash_open_insert (struct hash *hash, unsigned int key, void *data)
+{
+  struct hash_slot *slots = hash->slots;
+  unsigned int mask = hash->size - 1;
+  unsigned int i, dist, sdist;
+  struct hash_slot tmp;
+
+  for (i = key & mask, dist = 0; ; i = (i + 1) & mask, dist++)
+    {
+      if (slots[i].data == NULL)
+	{
+	  slots[i].data = data;
+	  slots[i].key = key;
+	  return;
+	}
+      if (hash->iterating)
+	{
+	  /* Only a tombstone can be reused without moving anything. */
+	  hash->unordered = 1;
+	  if (slots[i].data == HASH_TOMB)
+	    {
+	      slots[i].data = data;
+	      slots[i].key = key;
+	      hash->tombs--;
+	      return;
+	    }
+	  continue;
+	}
+      sdist = HASH_SLOT_DIST (slots, i, mask);
+      if (sdist < dist)
+	{
+	  tmp = slots[i];
+	  slots[i].data = data;
+	  slots[i].key = key;
+	  data = tmp.data;
+	  key = tmp.key;
+	  dist = sdist;
+	}
+    }
+}
+
+/* Move up to n slots of the old array into the new one. */
+static void
+hash_open_rehash_step (struct hash *hash, unsigned int n)
+{
+  struct hash_slot *s;
+
+  while (n-- && hash->old_slots)
+    {
+      s = &hash->old_slots[hash->rehash++];
+      if (s->data && s->data != HASH_TOMB)
+	{
+	  hash_open_insert (hash, s->key, s->data);
+	  s->data = HASH_TOMB;
+	}
+
+      if (hash->rehash == hash->old_size)
+	{
+	  XFREE (MTYPE_HASH_INDEX, hash->old_slots);
+	  hash->old_slots = NULL;
+	  hash->old_size = hash->rehash = 0;
+	}
+    }
+}
+
+/* Start growing, if the table is full enough. */
+static void
+hash_open_expand (struct hash *hash)
+{
+  if (hash->old_slots || hash->iterating
+      || (unsigned long long) (hash->count + hash->tombs + 1) * 100
+	 <= (unsigned long long) hash->size * HASH_OPEN_LOAD)
     return;
 
+  hash->old_slots = hash->slots;
+  hash->old_size = hash->size;
+  hash->rehash = 0;
+  hash->size *= 2;
+  hash->slots = XCALLOC (MTYPE_HASH_INDEX,
+			 sizeof (struct hash_slot) * hash->size);
+  hash->expansions++;
+}
+
+static void *
+hash_open_get (struct hash *hash, void *data, void * (*alloc_func) (void *))
+{
+  struct hash_slot *s;
+  unsigned int key;
+  void *newdata;
+
+  key = hash_make_key (hash, data);
+  s = hash_open_find (hash, hash->slots, hash->size, key, data, NULL,
+		      !hash->unordered);
+  if (!s && hash->old_slots)
+    s = hash_open_find (hash, hash->old_slots, hash->old_size, key, data,
+			NULL, 1);
+  if (s)
+    {
+      if (alloc_func)
+	hash->hits++;
+      return s->data;
+    }
+
+  if (alloc_func)
+    {
+      newdata = (*alloc_func) (data);
+      if (newdata == NULL)
+	return NULL;
+      hash->misses++;
+
+      hash_open_expand (hash);
+      if (hash->old_slots)
+	hash_open_rehash_step (hash, HASH_REHASH_STEP);
+
+      /* Only adding a fifth of the entries within a single
+	 hash_iterate() gets here. */
+      assert (hash->count + hash->tombs < hash->size);
+      hash_open_insert (hash, key, newdata);
+      hash->count++;
+      return newdata;
+    }
+  return NULL;
+}
+
+static void *
+hash_open_release (struct hash *hash, void *data)
+{
+  struct hash_slot *s;
+  unsigned int mask = hash->size - 1;
+  unsigned int i, next;
+  unsigned int key;
+  void *ret;
+
+  key = hash_make_key (hash, data);
+  if ((s = hash_open_find (hash, hash->slots, hash->size, key, data, NULL,
+			   !hash->unordered)) != NULL)
+    {
+      ret = s->data;
+      if (hash->iterating || hash->unordered)
+	{
+	  s->data = HASH_TOMB;
+	  hash->tombs++;
+	}
+      else
+	{
+	  /* Shift back the entries that are not home. */
+	  for (i = s - hash->slots; ; i = next)
+	    {
+	      next = (i + 1) & mask;
+	      if (hash->slots[next].data == NULL
+		  || HASH_SLOT_DIST (hash->slots, next, mask) == 0)
+		break;
+	      hash->slots[i] = hash->slots[next];
+	    }
+	  hash->slots[i].data = NULL;
+	}
+    }
+  else if (hash->old_slots
+	   && (s = hash_open_find (hash, hash->old_slots, hash->old_size, key,
+				   data, NULL, 1)) != NULL)
+    {
+      ret = s->data;
+      s->data = HASH_TOMB;
+    }
+  else
+    return NULL;
+
+  hash->count--;
+  return ret;
+}
+
+/* Put the table back in order after hash_iterate(). */
+static void
+hash_open_reorder (struct hash *hash)
+{
+  struct hash_slot *old = hash->slots;
+  unsigned int i;
+
+  hash->slots = XCALLOC (MTYPE_HASH_INDEX,
+			 sizeof (struct hash_slot) * hash->size);
+  hash->tombs = 0;
+  hash->unordered = 0;
   for (i = 0; i < hash->size; i++)
-    for (hb = hash->index[i]; hb; hb = hbnext)
-      {
-	unsigned int h = hb->key & (new_size - 1);
+    if (old[i].data && old[i].data != HASH_TOMB)
+      hash_open_insert (hash, old[i].key, old[i].data);
+  XFREE (MTYPE_HASH_INDEX, old);
+}
 
-	hbnext = hb->next;
-	hb->next = new_index[h];
-	new_index[h] = hb;
+static void
+hash_open_iterate (struct hash *hash,
+		   void (*func) (struct hash_backet *, void *), void *arg)
+{
+  struct hash_backet hb;
+  unsigned int i;
+
+  hash->iterating++;
+  for (i = 0; i < hash->size; i++)
+    if (hash->slots[i].data && hash->slots[i].data != HASH_TOMB)
+      {
+	hb.next = NULL;
+	hb.key = hash->slots[i].key;
+	hb.data = hash->slots[i].data;
+	(*func) (&hb, arg);
       }
+  if (--hash->iterating == 0 && (hash->tombs || hash->unordered))
+    hash_open_reorder (hash);
+}
 
-  /* Switch to new table */
-  XFREE(MTYPE_HASH_INDEX, hash->index);
-  hash->size = new_size;
-  hash->index = new_index;
+/* Where the chain for key is: in the old index until its backet there
+   has been moved.  */
+static struct hash_backet **
+hash_head (struct hash *hash, unsigned int key)
+{
+  unsigned int i;
 
-  /* Ideally, new index should have chains half as long as the original.
-     If expansion didn't help, then not worth expanding again,
-     the problem is the hash function. */
-  losers = 0;
-  for (i = 0; i < hash->size; i++)
+  if (hash->old_index && (i = key & (hash->old_size - 1)) >= hash->rehash)
+    return &hash->old_index[i];
+  return &hash->index[key & (hash->size - 1)];
+}
+
+/* Move up to n backets of the old index into the new one. */
+static void
+hash_rehash_step (struct hash *hash, unsigned int n)
+{
+  struct hash_backet *hb, *hbnext;
+  unsigned int i, j, len;
+
+  while (n-- && hash->old_index)
     {
-      unsigned int len = 0;
-      for (hb = hash->index[i]; hb; hb = hb->next)
+      i = hash->rehash++;
+      for (hb = hash->old_index[i]; hb; hb = hbnext)
+	{
+	  struct hash_backet **head = &hash->index[hb->key & (hash->size - 1)];
+
+	  hbnext = hb->next;
+	  hb->next = *head;
+	  *head = hb;
+	}
+      hash->old_index[i] = NULL;
+
+      /* Ideally, new index should have chains half as long as the
+	 original.  The old backet went to these two. */
+      for (j = i; j < hash->size; j += hash->old_size)
 	{
-	  if (++len > HASH_THRESHOLD/2)
-	    ++losers;
-	  if (len >= HASH_THRESHOLD)
+	  len = 0;
+	  for (hb = hash->index[j]; hb; hb = hb->next)
+	    {
+	      if (++len > HASH_THRESHOLD/2)
+		++hash->losers;
+	      if (len >= HASH_THRESHOLD)
+		hash->no_expand = 1;
+	    }
+	}
+
+      if (hash->rehash == hash->old_size)
+	{
+	  XFREE (MTYPE_HASH_INDEX, hash->old_index);
+	  hash->old_index = NULL;
+	  hash->old_size = hash->rehash = 0;
+
+	  /* If expansion didn't help, then not worth expanding again,
+	     the problem is the hash function. */
+	  if (hash->losers > hash->count / 2)
 	    hash->no_expand = 1;
 	}
     }
+}
+
+void
+hash_rehash_finish (struct hash *hash)
+{
+  if (hash->old_slots)
+    hash_open_rehash_step (hash, hash->old_size - hash->rehash);
+  if (hash->old_index)
+    hash_rehash_step (hash, hash->old_size - hash->rehash);
+}
+
+/* Expand hash if the chain length exceeds the threshold.  Rather than
+   moving every entry at once, which takes long with millions of them,
+   the old index is emptied a few backets at a time by later inserts.  */
+static void hash_expand (struct hash *hash)
+{
+  unsigned int new_size;
+  struct hash_backet **new_index;
+
+  new_size = hash->size * 2;
+  new_index = XCALLOC(MTYPE_HASH_INDEX, sizeof(struct hash_backet *) * new_size);
+  if (new_index == NULL)
+    return;
 
-  if (losers > hash->count / 2)
-    hash->no_expand = 1;
+  hash->old_index = hash->index;
+  hash->old_size = hash->size;
+  hash->rehash = 0;
+  hash->losers = 0;
+  hash->index = new_index;
+  hash->size = new_size;
+  hash->expansions++;
 }
 
 /* Lookup and return hash backet in hash.  If there is no
@@ -113,19 +478,26 @@ void *
 hash_get (struct hash *hash, void *data, void * (*alloc_func) (void *))
 {
   unsigned int key;
-  unsigned int index;
   void *newdata;
   unsigned int len;
   struct hash_backet *backet;
+  struct hash_backet **head;
+
+  if (hash->slots)
+    return hash_open_get (hash, data, alloc_func);
 
-  key = (*hash->hash_key) (data);
-  index = key & (hash->size - 1);
+  key = hash_make_key (hash, data);
+  head = hash_head (hash, key);
   len = 0;
 
-  for (backet = hash->index[index]; backet != NULL; backet = backet->next)
+  for (backet = *head; backet != NULL; backet = backet->next)
     {
-      if (backet->key == key && (*hash->hash_cmp) (backet->data, data))
-	return backet->data;
+      if (backet->key == key && hash_match (hash, backet->data, data, NULL))
+	{
+	  if (alloc_func)
+	    hash->hits++;
+	  return backet->data;
+	}
       ++len;
     }
 
@@ -134,18 +506,21 @@ hash_get (struct hash *hash, void *data, void * (*alloc_func) (void *))
       newdata = (*alloc_func) (data);
       if (newdata == NULL)
 	return NULL;
+      hash->misses++;
 
-      if (len > HASH_THRESHOLD && !hash->no_expand)
+      if (len > HASH_THRESHOLD && !hash->no_expand && !hash->old_index)
+	hash_expand (hash);
+      if (hash->old_index)
 	{
-	  hash_expand (hash);
-	  index = key & (hash->size - 1);
+	  hash_rehash_step (hash, HASH_REHASH_STEP);
+	  head = hash_head (hash, key);
 	}
 
       backet = XMALLOC (MTYPE_HASH_BACKET, sizeof (struct hash_backet));
       backet->data = newdata;
       backet->key = key;
-      backet->next = hash->index[index];
-      hash->index[index] = backet;
+      backet->next = *head;
+      *head = backet;
       hash->count++;
       return backet->data;
     }
@@ -159,6 +534,31 @@ hash_lookup (struct hash *hash, void *data)
   return hash_get (hash, data, NULL);
 }
 
+/* Lookup by name alone, in a table of named entries.  */
+void *
+hash_lookup_name (struct hash *hash, const char *name)
+{
+  unsigned int key;
+  struct hash_backet *backet;
+  struct hash_slot *s;
+
+  key = string_hash_make (name);
+  if (hash->slots)
+    {
+      s = hash_open_find (hash, hash->slots, hash->size, key, NULL, name,
+			  !hash->unordered);
+      if (!s && hash->old_slots)
+	s = hash_open_find (hash, hash->old_slots, hash->old_size, key, NULL,
+			    name, 1);
+      return s ? s->data : NULL;
+    }
+
+  for (backet = *hash_head (hash, key); backet; backet = backet->next)
+    if (backet->key == key && hash_match (hash, backet->data, NULL, name))
+      return backet->data;
+  return NULL;
+}
+
 /* Simple Bernstein hash which is simple and fast for common case */
 unsigned int string_hash_make (const char *str)
 {
@@ -178,19 +578,22 @@ hash_release (struct hash *hash, void *data)
 {
   void *ret;
   unsigned int key;
-  unsigned int index;
+  struct hash_backet **head;
   struct hash_backet *backet;
   struct hash_backet *pp;
 
-  key = (*hash->hash_key) (data);
-  index = key & (hash->size - 1);
+  if (hash->slots)
+    return hash_open_release (hash, data);
 
-  for (backet = pp = hash->index[index]; backet; backet = backet->next)
+  key = hash_make_key (hash, data);
+  head = hash_head (hash, key);
+
+  for (backet = pp = *head; backet; backet = backet->next)
     {
-      if (backet->key == key && (*hash->hash_cmp) (backet->data, data)) 
+      if (backet->key == key && hash_match (hash, backet->data, data, NULL)) 
 	{
 	  if (backet == pp) 
-	    hash->index[index] = backet->next;
+	    *head = backet->next;
 	  else 
 	    pp->next = backet->next;
 
@@ -213,6 +616,15 @@ hash_iterate (struct hash *hash,
   struct hash_backet *hb;
   struct hash_backet *hbnext;
 
+  /* Costs no more than the walk, and func may add or release. */
+  hash_rehash_finish (hash);
+
+  if (hash->slots)
+    {
+      hash_open_iterate (hash, func, arg);
+      return;
+    }
+
   for (i = 0; i < hash->size; i++)
     for (hb = hash->index[i]; hb; hb = hbnext)
       {
@@ -232,6 +644,22 @@ hash_clean (struct hash *hash, void (*free_func) (void *))
   struct hash_backet *hb;
   struct hash_backet *next;
 
+  hash_rehash_finish (hash);
+
+  if (hash->slots)
+    {
+      for (i = 0; i < hash->size; i++)
+	{
+	  if (hash->slots[i].data && hash->slots[i].data != HASH_TOMB
+	      && free_func)
+	    (*free_func) (hash->slots[i].data);
+	  hash->slots[i].data = NULL;
+	}
+      hash->count = hash->tombs = 0;
+      hash->unordered = 0;
+      return;
+    }
+
   for (i = 0; i < hash->size; i++)
     {
       for (hb = hash->index[i]; hb; hb = next)
@@ -253,6 +681,123 @@ hash_clean (struct hash *hash, void (*free_func) (void *))
 void
 hash_free (struct hash *hash)
 {
-  XFREE (MTYPE_HASH_INDEX, hash->index);
+  if (hash->prev_named)
+    {
+      if (hash->next_named)
+	hash->next_named->prev_named = hash->prev_named;
+      *hash->prev_named = hash->next_named;
+    }
+  if (hash->old_index)
+    XFREE (MTYPE_HASH_INDEX, hash->old_index);
+  if (hash->index)
+    XFREE (MTYPE_HASH_INDEX, hash->index);
+  if (hash->old_slots)
+    XFREE (MTYPE_HASH_INDEX, hash->old_slots);
+  if (hash->slots)
+    XFREE (MTYPE_HASH_INDEX, hash->slots);
   XFREE (MTYPE_HASH, hash);
 }
+
+void
+hash_set_name (struct hash *hash, const char *name)
+{
+  hash->name = name;
+  if (hash->prev_named)
+    return;
+  if ((hash->next_named = hash_named) != NULL)
+    hash_named->prev_named = &hash->next_named;
+  hash->prev_named = &hash_named;
+  hash_named = hash;
+}
+
+/* Count chain lengths of one index. */
+static void
+hash_chain_stats (struct hash_backet **index, unsigned int from,
+		  unsigned int size, unsigned long *used, unsigned int *max)
+{
+  struct hash_backet *hb;
+  unsigned int i, len;
+
+  for (i = from; i < size; i++)
+    {
+      len = 0;
+      for (hb = index[i]; hb; hb = hb->next)
+	len++;
+      if (len)
+	(*used)++;
+      if (len > *max)
+	*max = len;
+    }
+}
+
+/* Same for an open addressing table, counting probes instead: slots
+   looked at to find each entry. */
+static void
+hash_slot_stats (struct hash_slot *slots, unsigned int from,
+		 unsigned int size, unsigned long *probes, unsigned int *max)
+{
+  unsigned int i, dist;
+
+  for (i = from; i < size; i++)
+    if (slots[i].data && slots[i].data != HASH_TOMB)
+      {
+	dist = HASH_SLOT_DIST (slots, i, size - 1) + 1;
+	*probes += dist;
+	if (dist > *max)
+	  *max = dist;
+      }
+}
+
+DEFUN (show_hash_statistics,
+       show_hash_statistics_cmd,
+       "show hash statistics",
+       SHOW_STR
+       "Hash tables\n"
+       "Sizes and chain lengths\n")
+{
+  struct hash *hash;
+  unsigned long used;
+  unsigned int max;
+  double avg;
+
+  vty_out (vty, "%-28s %9s %9s %9s %6s %5s %4s %s%s",
+	   "Name", "Entries", "Backets", "Used", "Avg", "Max", "Exp",
+	   "Rehash", VTY_NEWLINE);
+
+  for (hash = hash_named; hash; hash = hash->next_named)
+    {
+      used = 0;
+      max = 0;
+      if (hash->slots)
+	{
+	  unsigned long probes = 0;
+
+	  hash_slot_stats (hash->slots, 0, hash->size, &probes, &max);
+	  if (hash->old_slots)
+	    hash_slot_stats (hash->old_slots, hash->rehash, hash->old_size,
+			     &probes, &max);
+	  used = hash->count;
+	  avg = used ? (double) probes / used : 0.0;
+	}
+      else
+	{
+	  hash_chain_stats (hash->index, 0, hash->size, &used, &max);
+	  if (hash->old_index)
+	    hash_chain_stats (hash->old_index, hash->rehash, hash->old_size,
+			      &used, &max);
+	  avg = used ? (double) hash->count / used : 0.0;
+	}
+
+      vty_out (vty, "%-28s %9lu %9u %9lu %6.2f %5u %4u ",
+	       hash->name, hash->count, hash->size, used, avg, max,
+	       hash->expansions);
+      if (hash->old_index || hash->old_slots)
+	vty_out (vty, "%u%%", hash->rehash * 100 / hash->old_size);
+      else if (hash->no_expand)
+	vty_out (vty, "stopped");
+      else
+	vty_out (vty, "-");
+      vty_out (vty, "%s", VTY_NEWLINE);
+    }
+  return CMD_SUCCESS;
+}
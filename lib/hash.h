@@ -24,6 +24,8 @@ Boston, MA 02111-1307, USA.  */
 /* Default hash table size.  */ 
 #define HASH_INITIAL_SIZE     256	/* initial number of backets. */
 #define HASH_THRESHOLD	      10	/* expand when backet. */
+#define HASH_REHASH_STEP      8		/* old backets moved per insert */
+#define HASH_OPEN_LOAD        80	/* open tables grow past this % full */
 
 struct hash_backet
 {
@@ -37,16 +39,46 @@ struct hash_backet
   void *data;
 };
 
+/* Slot of an open addressing table, see hash_create_open(). */
+struct hash_slot
+{
+  void *data;			/* NULL if empty */
+  unsigned int key;
+};
+
 struct hash
 {
   /* Hash backet. */
   struct hash_backet **index;
 
+  /* Instead of index, for open addressing tables: the same role for
+     slots and old_slots as index and old_index, and old slots below
+     rehash have been moved. */
+  struct hash_slot *slots;
+  struct hash_slot *old_slots;
+  unsigned int tombs;		/* released while iterating */
+  int iterating;
+  int unordered;		/* added while iterating */
+
   /* Hash table size. Must be power of 2 */
   unsigned int size;
 
+  /* Index being emptied into the new one, half its size, while
+     expanding.  Its backets below rehash have been moved already. */
+  struct hash_backet **old_index;
+  unsigned int old_size;
+  unsigned int rehash;
+
+  /* Chains over HASH_THRESHOLD/2 seen while moving, see hash_expand() */
+  unsigned long losers;
+
   /* If expansion failed. */
   int no_expand;
+  unsigned int expansions;
+
+  /* For show hash statistics, if set. */
+  const char *name;
+  struct hash *next_named, **prev_named;
 
   /* Key make function. */
   unsigned int (*hash_key) (void *);
@@ -54,8 +86,17 @@ struct hash
   /* Data compare function. */
   int (*hash_cmp) (const void *, const void *);
 
+  /* Instead of the two above, for tables of entries known by name:
+     the name of an entry, see hash_create_name(). */
+  const char *(*name_of) (const void *);
+
   /* Backet alloc. */
   unsigned long count;
+
+  /* hash_get() with an alloc function: data found, or allocated.  For
+     interned objects, how much they are shared. */
+  unsigned long hits;
+  unsigned long misses;
 };
 
 extern struct hash *hash_create (unsigned int (*) (void *), 
@@ -63,9 +104,23 @@ extern struct hash *hash_create (unsigned int (*) (void *),
 extern struct hash *hash_create_size (unsigned int, unsigned int (*) (void *), 
                                              int (*) (const void *, const void *));
 
+/* Same API, but the entries are kept in one array rather than in a
+   backet each: less memory, and fewer cache misses to find them.
+   hash->index cannot be walked directly, and the backet passed by
+   hash_iterate() only lives for the call. */
+extern struct hash *hash_create_open (unsigned int, unsigned int (*) (void *), 
+                                      int (*) (const void *, const void *));
+
+/* Tables of entries keyed by the name that name_of returns for them,
+   which can also be searched by name alone with hash_lookup_name(). */
+extern struct hash *hash_create_name (const char * (*) (const void *));
+extern struct hash *hash_create_open_name (unsigned int,
+					   const char * (*) (const void *));
+
 extern void *hash_get (struct hash *, void *, void * (*) (void *));
 extern void *hash_alloc_intern (void *);
 extern void *hash_lookup (struct hash *, void *);
+extern void *hash_lookup_name (struct hash *, const char *);
 extern void *hash_release (struct hash *, void *);
 
 extern void hash_iterate (struct hash *, 
@@ -74,6 +129,14 @@ extern void hash_iterate (struct hash *,
 extern void hash_clean (struct hash *, void (*) (void *));
 extern void hash_free (struct hash *);
 
+/* Finish moving backets into the new index.  Must be called before
+   walking hash->index directly, rather than through hash_iterate. */
+extern void hash_rehash_finish (struct hash *);
+
+/* List the hash in show hash statistics under name, a static string. */
+extern void hash_set_name (struct hash *, const char *);
+extern struct cmd_element show_hash_statistics_cmd;
+
 extern unsigned int string_hash_make (const char *);
 
 #endif /* _ZEBRA_HASH_H */
@@ -35,10 +35,22 @@
 #include "buffer.h"
 #include "str.h"
 #include "log.h"
+#include "hash.h"
+#include "jhash.h"
 
 /* Master list of interfaces. */
 struct list *iflist;
 
+/* Interfaces of iflist by name and by ifindex, and their connected
+   IPv4 addresses by address, so lookups need not scan iflist.  Names
+   are unique.  Indexes normally are too; an interface whose index is
+   hashed for another already is counted in if_index_shadowed, and
+   takes over when that one goes. */
+static struct hash *if_name_hash;
+static struct hash *if_index_hash;
+static unsigned int if_index_shadowed;
+static struct route_table *if_addr_table;
+
 /* One for each program.  This structure is needed to store hooks. */
 struct if_master
 {
@@ -111,6 +123,86 @@ if_cmp_func (struct interface *ifp1, struct interface *ifp2)
   return 0;
 }
 
+static unsigned int
+if_name_hash_key (void *arg)
+{
+  struct interface *ifp = arg;
+
+  return string_hash_make (ifp->name);
+}
+
+static int
+if_name_hash_cmp (const void *arg1, const void *arg2)
+{
+  const struct interface *ifp1 = arg1;
+  const struct interface *ifp2 = arg2;
+
+  return strcmp (ifp1->name, ifp2->name) == 0;
+}
+
+static unsigned int
+if_index_hash_key (void *arg)
+{
+  struct interface *ifp = arg;
+
+  return jhash_1word (ifp->ifindex, 0);
+}
+
+static int
+if_index_hash_cmp (const void *arg1, const void *arg2)
+{
+  const struct interface *ifp1 = arg1;
+  const struct interface *ifp2 = arg2;
+
+  return ifp1->ifindex == ifp2->ifindex;
+}
+
+static void
+if_index_hash_add (struct interface *ifp)
+{
+  if (ifp->ifindex == IFINDEX_INTERNAL)
+    return;
+  if (hash_get (if_index_hash, ifp, hash_alloc_intern) != ifp)
+    if_index_shadowed++;
+}
+
+static void
+if_index_hash_delete (struct interface *ifp)
+{
+  struct listnode *node;
+  struct interface *other;
+
+  if (ifp->ifindex == IFINDEX_INTERNAL)
+    return;
+  if (hash_lookup (if_index_hash, ifp) != ifp)
+    {
+      if_index_shadowed--;
+      return;
+    }
+  hash_release (if_index_hash, ifp);
+
+  if (if_index_shadowed)
+    for (ALL_LIST_ELEMENTS_RO (iflist, node, other))
+      if (other != ifp && other->ifindex == ifp->ifindex)
+	{
+	  hash_get (if_index_hash, other, hash_alloc_intern);
+	  if_index_shadowed--;
+	  break;
+	}
+}
+
+/* Set the ifindex of an interface.  It must not be assigned directly,
+   lookups by index would miss the change. */
+void
+if_set_index (struct interface *ifp, unsigned int ifindex)
+{
+  if (ifp->ifindex == ifindex)
+    return;
+  if_index_hash_delete (ifp);
+  ifp->ifindex = ifindex;
+  if_index_hash_add (ifp);
+}
+
 /* Create new interface structure. */
 struct interface *
 if_create (const char *name, int namelen)
@@ -125,7 +217,10 @@ if_create (const char *name, int namelen)
   strncpy (ifp->name, name, namelen);
   ifp->name[namelen] = '\0';
   if (if_lookup_by_name(ifp->name) == NULL)
-    listnode_add_sort (iflist, ifp);
+    {
+      listnode_add_sort (iflist, ifp);
+      hash_get (if_name_hash, ifp, hash_alloc_intern);
+    }
   else
     zlog_err("if_create(%s): corruption detected -- interface with this "
 	     "name exists already!", ifp->name);
@@ -138,14 +233,21 @@ if_create (const char *name, int namelen)
   return ifp;
 }
 
+static void if_addr_delete (struct connected *);
+
 /* Delete interface structure. */
 void
 if_delete_retain (struct interface *ifp)
 {
+  struct listnode *node;
+  struct connected *ifc;
+
   if (if_master.if_delete_hook)
     (*if_master.if_delete_hook) (ifp);
 
   /* Free connected address list */
+  for (ALL_LIST_ELEMENTS_RO (ifp->connected, node, ifc))
+    if_addr_delete (ifc);
   list_delete_all_node (ifp->connected);
 }
 
@@ -154,6 +256,9 @@ void
 if_delete (struct interface *ifp)
 {
   listnode_delete (iflist, ifp);
+  if (hash_lookup (if_name_hash, ifp) == ifp)
+    hash_release (if_name_hash, ifp);
+  if_index_hash_delete (ifp);
 
   if_delete_retain(ifp);
 
@@ -184,7 +289,15 @@ if_lookup_by_index (unsigned int index)
 {
   struct listnode *node;
   struct interface *ifp;
+  struct interface key;
+
+  if (index != IFINDEX_INTERNAL)
+    {
+      key.ifindex = index;
+      return hash_lookup (if_index_hash, &key);
+    }
 
+  /* Not hashed, any pseudo interface has it. */
   for (ALL_LIST_ELEMENTS_RO(iflist, node, ifp))
     {
       if (ifp->ifindex == index)
@@ -215,59 +328,91 @@ ifname2ifindex (const char *name)
 struct interface *
 if_lookup_by_name (const char *name)
 {
-  struct listnode *node;
-  struct interface *ifp;
-  
-  if (name)
-    for (ALL_LIST_ELEMENTS_RO (iflist, node, ifp))
-      {
-        if (strcmp(name, ifp->name) == 0)
-          return ifp;
-      }
-  return NULL;
+  if (! name)
+    return NULL;
+  return if_lookup_by_name_len (name, strlen (name));
 }
 
 struct interface *
 if_lookup_by_name_len(const char *name, size_t namelen)
 {
-  struct listnode *node;
-  struct interface *ifp;
+  struct interface key;
 
   if (namelen > INTERFACE_NAMSIZ)
     return NULL;
 
-  for (ALL_LIST_ELEMENTS_RO (iflist, node, ifp))
+  memcpy (key.name, name, namelen);
+  key.name[namelen] = '\0';
+  return hash_lookup (if_name_hash, &key);
+}
+
+/* Connected IPv4 addresses by address: the table has a host route for
+   each, with the list of their connected structures as info. */
+static void
+if_addr_key (struct prefix_ipv4 *p, struct in_addr *addr)
+{
+  memset (p, 0, sizeof (struct prefix_ipv4));
+  p->family = AF_INET;
+  p->prefixlen = IPV4_MAX_PREFIXLEN;
+  p->prefix = *addr;
+}
+
+static void
+if_addr_add (struct connected *ifc)
+{
+  struct prefix_ipv4 p;
+  struct route_node *rn;
+
+  if (! ifc->address || ifc->address->family != AF_INET)
+    return;
+
+  if_addr_key (&p, &ifc->address->u.prefix4);
+  rn = route_node_get (if_addr_table, (struct prefix *) &p);
+  if (rn->info)
+    route_unlock_node (rn);
+  else
+    rn->info = list_new ();
+  listnode_add (rn->info, ifc);
+}
+
+static void
+if_addr_delete (struct connected *ifc)
+{
+  struct prefix_ipv4 p;
+  struct route_node *rn;
+
+  if (! ifc->address || ifc->address->family != AF_INET)
+    return;
+
+  if_addr_key (&p, &ifc->address->u.prefix4);
+  rn = route_node_lookup (if_addr_table, (struct prefix *) &p);
+  if (! rn)
+    return;
+  listnode_delete (rn->info, ifc);
+  if (list_isempty ((struct list *) rn->info))
     {
-      if (!memcmp(name, ifp->name, namelen) && (ifp->name[namelen] == '\0'))
-	return ifp;
+      list_free (rn->info);
+      rn->info = NULL;
+      route_unlock_node (rn);
     }
-  return NULL;
+  route_unlock_node (rn);
 }
 
 /* Lookup interface by IPv4 address. */
 struct interface *
 if_lookup_exact_address (struct in_addr src)
 {
-  struct listnode *node;
-  struct listnode *cnode;
-  struct interface *ifp;
-  struct prefix *p;
+  struct prefix_ipv4 p;
+  struct route_node *rn;
   struct connected *c;
 
-  for (ALL_LIST_ELEMENTS_RO (iflist, node, ifp))
-    {
-      for (ALL_LIST_ELEMENTS_RO (ifp->connected, cnode, c))
-	{
-	  p = c->address;
-
-	  if (p && p->family == AF_INET)
-	    {
-	      if (IPV4_ADDR_SAME (&p->u.prefix4, &src))
-		return ifp;
-	    }	      
-	}
-    }
-  return NULL;
+  if_addr_key (&p, &src);
+  rn = route_node_lookup (if_addr_table, (struct prefix *) &p);
+  if (! rn)
+    return NULL;
+  c = listgetdata (listhead ((struct list *) rn->info));
+  route_unlock_node (rn);
+  return c->ifp;
 }
 
 /* Lookup interface by IPv4 address. */
@@ -667,6 +812,23 @@ connected_log (struct connected *connected, char *str)
   zlog (NULL, LOG_INFO, "%s", logbuf);
 }
 
+/* Add a connected address to the list of its interface.  The address
+   must be set already, and not change while it is on the list. */
+void
+connected_add (struct interface *ifp, struct connected *ifc)
+{
+  listnode_add (ifp->connected, ifc);
+  if_addr_add (ifc);
+}
+
+/* Take a connected address off the list of its interface. */
+void
+connected_delete (struct interface *ifp, struct connected *ifc)
+{
+  if_addr_delete (ifc);
+  listnode_delete (ifp->connected, ifc);
+}
+
 /* If two connected address has same prefix return 1. */
 static int
 connected_same_prefix (struct prefix *p1, struct prefix *p2)
@@ -700,7 +862,7 @@ connected_delete_by_prefix (struct interface *ifp, struct prefix *p)
 
       if (connected_same_prefix (ifc->address, p))
 	{
-	  listnode_delete (ifp->connected, ifc);
+	  connected_delete (ifp, ifc);
 	  return ifc;
 	}
     }
@@ -755,7 +917,7 @@ connected_add_by_prefix (struct interface *ifp, struct prefix *p,
     }
 
   /* Add connected address to the interface. */
-  listnode_add (ifp->connected, ifc);
+  connected_add (ifp, ifc);
   return ifc;
 }
 
@@ -867,6 +1029,11 @@ void
 if_init (void)
 {
   iflist = list_new ();
+  if_name_hash = hash_create (if_name_hash_key, if_name_hash_cmp);
+  hash_set_name (if_name_hash, "Interfaces by name");
+  if_index_hash = hash_create (if_index_hash_key, if_index_hash_cmp);
+  hash_set_name (if_index_hash, "Interfaces by index");
+  if_addr_table = route_table_init ();
 #if 0
   ifaddr_ipv4_table = route_table_init ();
 #endif /* ifaddr_ipv4_table */
@@ -895,4 +1062,13 @@ if_terminate (void)
 
   list_delete (iflist);
   iflist = NULL;
+  hash_clean (if_name_hash, NULL);
+  hash_free (if_name_hash);
+  if_name_hash = NULL;
+  hash_clean (if_index_hash, NULL);
+  hash_free (if_index_hash);
+  if_index_hash = NULL;
+  if_index_shadowed = 0;
+  route_table_finish (if_addr_table);
+  if_addr_table = NULL;
 }
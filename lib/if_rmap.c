@@ -282,6 +282,7 @@ config_write_if_rmap (struct vty *vty)
   struct hash_backet *mp;
   int write = 0;
 
+  hash_rehash_finish (ifrmaphash);
   for (i = 0; i < ifrmaphash->size; i++)
     for (mp = ifrmaphash->index[i]; mp; mp = mp->next)
       {
@@ -112,6 +112,7 @@ extern void list_add_list (struct list *, struct list *);
 #define LISTNODE_ATTACH(L,N) \
   do { \
     (N)->prev = (L)->tail; \
+    (N)->next = NULL; \
     if ((L)->head == NULL) \
       (L)->head = (N); \
     else \
@@ -134,6 +135,48 @@ extern void list_add_list (struct list *, struct list *);
     (L)->count--; \
   } while (0)
 
+/* Intrusive lists.  The element embeds a struct ilistnode, so adding
+ * to and deleting from the list allocate nothing.  An element is on at
+ * most one list through each ilistnode it embeds.  Initialise an ilist
+ * and an ilistnode by zeroing them.
+ */
+struct ilistnode
+{
+  struct ilistnode *next;
+  struct ilistnode *prev;
+};
+
+struct ilist
+{
+  struct ilistnode *head;
+  struct ilistnode *tail;
+  unsigned int count;
+};
+
+/* The element embedding node N as MEMBER. */
+#define ilist_entry(N,type,member) \
+  ((type *) ((char *) (N) - offsetof (type, member)))
+
+#define ilist_add(L,N) LISTNODE_ATTACH(L,N)
+#define ilist_delete(L,N) LISTNODE_DETACH(L,N)
+#define ilist_head_entry(L,type,member) \
+  ((L)->head ? ilist_entry ((L)->head, type, member) : NULL)
+
+/* As ALL_LIST_ELEMENTS: it is safe to delete the element from the list
+ * in the body of the loop.
+ */
+#define ALL_ILIST_ELEMENTS(list,node,nextnode,data,type,member) \
+  (node) = (list)->head, ((data) = NULL); \
+  (node) != NULL && \
+    ((data) = ilist_entry (node, type, member), \
+     (nextnode) = (node)->next, 1); \
+  (node) = (nextnode), ((data) = NULL)
+
+#define ALL_ILIST_ELEMENTS_RO(list,node,data,type,member) \
+  (node) = (list)->head, ((data) = NULL); \
+  (node) != NULL && ((data) = ilist_entry (node, type, member), 1); \
+  (node) = (node)->next, ((data) = NULL)
+
 /* Deprecated: 20050406 */
 #if !defined(QUAGGA_NO_DEPRECATED_INTERFACES)
 #warning "Using deprecated libzebra interfaces"
@@ -34,9 +34,38 @@
 #ifdef HAVE_UCONTEXT_H
 #include <ucontext.h>
 #endif
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif /* HAVE_PTHREAD */
 
 static int logfile_fd = -1;	/* Used in signal handler. */
 
+/* Longest line queued for the writer thread, longer ones are cut. */
+#define ZLOG_ASYNC_LINE 1024
+
+/* File output through a ring buffer.  Callers format their line and
+ * copy it in, the writer thread takes it out and write()s it, so a slow
+ * or stalled disk only ever costs the daemon dropped messages.
+ */
+struct zlog_async
+{
+#ifdef HAVE_PTHREAD
+  pthread_mutex_t mtx;
+  pthread_cond_t data;		/* something to write */
+  pthread_cond_t drained;	/* nothing left to write */
+  pthread_t thread;
+#endif /* HAVE_PTHREAD */
+  int started;
+  int stop;
+  int busy;			/* writer has a chunk out */
+  int fd;			/* -1 while the file is being changed */
+  char *buf;
+  size_t size;
+  /* Free running offsets into buf. */
+  unsigned long head, tail;
+  unsigned long dropped, reported;
+};
+
 struct zlog *zlog_default = NULL;
 
 const char *zlog_proto_names[] = 
@@ -146,6 +175,253 @@ time_print(FILE *fp, struct timestamp_control *ctl)
 }
   
 
+#ifdef HAVE_PTHREAD
+static void
+zlog_async_write (int fd, const char *buf, size_t len)
+{
+  ssize_t n;
+
+  while (len > 0)
+    {
+      if ((n = write (fd, buf, len)) < 0)
+	{
+	  if (errno == EINTR)
+	    continue;
+	  return;
+	}
+      buf += n;
+      len -= n;
+    }
+}
+
+static void *
+zlog_async_thread (void *arg)
+{
+  struct zlog_async *a = arg;
+  unsigned long dropped;
+  size_t off, len;
+  char note[64];
+  int fd;
+
+  pthread_mutex_lock (&a->mtx);
+  while (1)
+    {
+      while (a->head == a->tail && a->dropped == a->reported && !a->stop)
+	{
+	  pthread_cond_broadcast (&a->drained);
+	  pthread_cond_wait (&a->data, &a->mtx);
+	}
+      if (a->head == a->tail && a->dropped == a->reported)
+	break;
+
+      off = a->tail % a->size;
+      len = a->head - a->tail;
+      dropped = 0;
+      if (off + len > a->size)
+	len = a->size - off;
+      else
+	{
+	  /* Only after whole lines. */
+	  dropped = a->dropped - a->reported;
+	  a->reported = a->dropped;
+	}
+      fd = a->fd;
+      a->busy = 1;
+      pthread_mutex_unlock (&a->mtx);
+
+      if (fd >= 0)
+	{
+	  zlog_async_write (fd, a->buf + off, len);
+	  if (dropped)
+	    {
+	      snprintf (note, sizeof (note),
+			"log buffer full, %lu messages dropped\n", dropped);
+	      zlog_async_write (fd, note, strlen (note));
+	    }
+	}
+
+      pthread_mutex_lock (&a->mtx);
+      a->tail += len;
+      a->busy = 0;
+    }
+  pthread_cond_broadcast (&a->drained);
+  pthread_mutex_unlock (&a->mtx);
+  return NULL;
+}
+
+/* Wait for everything queued to be written.  With the lock held on
+   return, so that the caller can change the file under the writer. */
+static void
+zlog_async_drain (struct zlog_async *a)
+{
+  pthread_mutex_lock (&a->mtx);
+  while (a->started && (a->head != a->tail || a->busy))
+    pthread_cond_wait (&a->drained, &a->mtx);
+}
+
+/* Queue one line for the file.  Returns -1 to have the caller write it
+   itself, as the writer could not be started. */
+static int
+zlog_async_put (struct zlog *zl, int priority, struct timestamp_control *ctl,
+		const char *format, va_list args)
+{
+  struct zlog_async *a = zl->async;
+  char line[ZLOG_ASYNC_LINE];
+  size_t len, off, n;
+  va_list ac;
+  sigset_t all, old;
+  int ret;
+
+  if (!ctl->already_rendered)
+    {
+      ctl->len = quagga_timestamp (ctl->precision, ctl->buf, sizeof (ctl->buf));
+      ctl->already_rendered = 1;
+    }
+  len = snprintf (line, sizeof (line), "%s %s%s%s: ", ctl->buf,
+		  zl->record_priority ? zlog_priority[priority] : "",
+		  zl->record_priority ? ": " : "",
+		  zlog_proto_names[zl->protocol]);
+  if (len < sizeof (line))
+    {
+      va_copy (ac, args);
+      len += vsnprintf (line + len, sizeof (line) - len, format, ac);
+      va_end (ac);
+    }
+  if (len > sizeof (line) - 1)
+    len = sizeof (line) - 1;
+  line[len++] = '\n';
+
+  pthread_mutex_lock (&a->mtx);
+  if (!a->started)
+    {
+      /* Here rather than in zlog_set_async(), as threads do not survive
+	 daemon().  Signals are for the main thread to handle. */
+      sigfillset (&all);
+      pthread_sigmask (SIG_SETMASK, &all, &old);
+      ret = pthread_create (&a->thread, NULL, zlog_async_thread, a);
+      pthread_sigmask (SIG_SETMASK, &old, NULL);
+      if (ret)
+	{
+	  pthread_mutex_unlock (&a->mtx);
+	  return -1;
+	}
+      a->started = 1;
+    }
+
+  if (a->size - (a->head - a->tail) < len)
+    a->dropped++;
+  else
+    {
+      off = a->head % a->size;
+      n = (off + len > a->size) ? a->size - off : len;
+      memcpy (a->buf + off, line, n);
+      memcpy (a->buf, line + n, len - n);
+      if (a->head == a->tail)
+	pthread_cond_signal (&a->data);
+      a->head += len;
+    }
+  pthread_mutex_unlock (&a->mtx);
+  return 0;
+}
+#else
+static int
+zlog_async_put (struct zlog *zl, int priority, struct timestamp_control *ctl,
+		const char *format, va_list args)
+{
+  return -1;
+}
+#endif /* HAVE_PTHREAD */
+
+/* Stop writing to the file, after what is queued. */
+static void
+zlog_async_hold (struct zlog *zl)
+{
+#ifdef HAVE_PTHREAD
+  if (zl->async)
+    {
+      zlog_async_drain (zl->async);
+      zl->async->fd = -1;
+      pthread_mutex_unlock (&zl->async->mtx);
+    }
+#endif /* HAVE_PTHREAD */
+}
+
+/* Resume writing, to the newly opened file. */
+static void
+zlog_async_resume (struct zlog *zl)
+{
+#ifdef HAVE_PTHREAD
+  if (zl->async && zl->fp)
+    {
+      pthread_mutex_lock (&zl->async->mtx);
+      zl->async->fd = fileno (zl->fp);
+      pthread_mutex_unlock (&zl->async->mtx);
+    }
+#endif /* HAVE_PTHREAD */
+}
+
+int
+zlog_set_async (struct zlog *zl, unsigned int kbytes)
+{
+#ifdef HAVE_PTHREAD
+  struct zlog_async *a;
+
+  if (zl == NULL)
+    zl = zlog_default;
+
+  if ((a = zl->async) != NULL)
+    {
+      if (a->size == (size_t) kbytes * 1024)
+	return 0;
+
+      zl->async = NULL;
+      zlog_async_drain (a);
+      a->stop = 1;
+      pthread_cond_signal (&a->data);
+      pthread_mutex_unlock (&a->mtx);
+      if (a->started)
+	pthread_join (a->thread, NULL);
+      pthread_mutex_destroy (&a->mtx);
+      pthread_cond_destroy (&a->data);
+      pthread_cond_destroy (&a->drained);
+      XFREE (MTYPE_ZLOG, a->buf);
+      XFREE (MTYPE_ZLOG, a);
+    }
+
+  if (kbytes == 0)
+    return 0;
+
+  a = XCALLOC (MTYPE_ZLOG, sizeof (struct zlog_async));
+  a->size = (size_t) kbytes * 1024;
+  a->buf = XMALLOC (MTYPE_ZLOG, a->size);
+  a->fd = zl->fp ? fileno (zl->fp) : -1;
+  pthread_mutex_init (&a->mtx, NULL);
+  pthread_cond_init (&a->data, NULL);
+  pthread_cond_init (&a->drained, NULL);
+  zl->async = a;
+  return 0;
+#else
+  return (kbytes ? -1 : 0);
+#endif /* HAVE_PTHREAD */
+}
+
+unsigned int
+zlog_async_size (struct zlog *zl, unsigned long *dropped)
+{
+  if (zl == NULL)
+    zl = zlog_default;
+
+  *dropped = 0;
+  if (zl->async == NULL)
+    return 0;
+#ifdef HAVE_PTHREAD
+  pthread_mutex_lock (&zl->async->mtx);
+  *dropped = zl->async->dropped;
+  pthread_mutex_unlock (&zl->async->mtx);
+#endif /* HAVE_PTHREAD */
+  return zl->async->size / 1024;
+}
+
 /* va_list version of zlog. */
 static void
 vzlog (struct zlog *zl, int priority, const char *format, va_list args)
@@ -182,7 +458,10 @@ vzlog (struct zlog *zl, int priority, const char *format, va_list args)
     }
 
   /* File output. */
-  if ((priority <= zl->maxlvl[ZLOG_DEST_FILE]) && zl->fp)
+  if ((priority <= zl->maxlvl[ZLOG_DEST_FILE]) && zl->fp && zl->async
+      && zlog_async_put (zl, priority, &tsctl, format, args) == 0)
+    ;
+  else if ((priority <= zl->maxlvl[ZLOG_DEST_FILE]) && zl->fp)
     {
       va_list ac;
       time_print (zl->fp, &tsctl);
@@ -354,6 +633,27 @@ open_crashlog(void)
 #undef CRASHLOG_PREFIX
 }
 
+/* Write out whatever the writer thread did not get to yet, using only
+   async-signal-safe functions and without locking: the lock may be held
+   by the thread that is going down. */
+static void
+zlog_async_flush_unlocked (struct zlog_async *a, int fd)
+{
+  size_t off = a->tail % a->size, len = a->head - a->tail;
+
+  if (len <= a->size)
+    {
+      if (off + len > a->size)
+	{
+	  write (fd, a->buf + off, a->size - off);
+	  len -= a->size - off;
+	  off = 0;
+	}
+      write (fd, a->buf + off, len);
+    }
+  a->head = a->tail;
+}
+
 /* Note: the goal here is to use only async-signal-safe functions. */
 void
 zlog_signal(int signo, const char *action
@@ -400,6 +700,9 @@ zlog_signal(int signo, const char *action
 #define PRI LOG_CRIT
 
 #define DUMP(FD) write(FD, buf, s-buf);
+  /* Whatever the writer thread did not get to yet goes first. */
+  if (zlog_default && zlog_default->async && (logfile_fd >= 0))
+    zlog_async_flush_unlocked (zlog_default->async, logfile_fd);
   /* If no file logging configured, try to write to fallback log file. */
   if ((logfile_fd >= 0) || ((logfile_fd = open_crashlog()) >= 0))
     DUMP(logfile_fd)
@@ -608,6 +911,15 @@ void
 _zlog_assert_failed (const char *assertion, const char *file,
 		     unsigned int line, const char *function)
 {
+  /* Write the message out before abort(), not just queue it.  The
+     writer thread is left alone, this must not wait on it. */
+  if (zlog_default && zlog_default->async)
+    {
+      if (zlog_default->fp)
+	zlog_async_flush_unlocked (zlog_default->async,
+				   fileno (zlog_default->fp));
+      zlog_default->async = NULL;
+    }
   /* Force fallback file logging? */
   if (zlog_default && !zlog_default->fp &&
       ((logfile_fd = open_crashlog()) >= 0) &&
@@ -651,6 +963,8 @@ closezlog (struct zlog *zl)
 {
   closelog();
 
+  zlog_set_async (zl, 0);
+
   if (zl->fp != NULL)
     fclose (zl->fp);
 
@@ -695,6 +1009,7 @@ zlog_set_file (struct zlog *zl, const char *filename, int log_level)
   zl->maxlvl[ZLOG_DEST_FILE] = log_level;
   zl->fp = fp;
   logfile_fd = fileno(fp);
+  zlog_async_resume (zl);
 
   return 1;
 }
@@ -706,6 +1021,7 @@ zlog_reset_file (struct zlog *zl)
   if (zl == NULL)
     zl = zlog_default;
 
+  zlog_async_hold (zl);
   if (zl->fp)
     fclose (zl->fp);
   zl->fp = NULL;
@@ -728,6 +1044,7 @@ zlog_rotate (struct zlog *zl)
   if (zl == NULL)
     zl = zlog_default;
 
+  zlog_async_hold (zl);
   if (zl->fp)
     fclose (zl->fp);
   zl->fp = NULL;
@@ -752,6 +1069,7 @@ zlog_rotate (struct zlog *zl)
         }	
       logfile_fd = fileno(zl->fp);
       zl->maxlvl[ZLOG_DEST_FILE] = level;
+      zlog_async_resume (zl);
     }
 
   return 1;
@@ -845,6 +1163,15 @@ static const struct zebra_desc_table command_types[] = {
   DESC_ENTRY	(ZEBRA_ROUTER_ID_DELETE),
   DESC_ENTRY	(ZEBRA_ROUTER_ID_UPDATE),
   DESC_ENTRY	(ZEBRA_HELLO),
+  DESC_ENTRY	(ZEBRA_NEXTHOP_REGISTER),
+  DESC_ENTRY	(ZEBRA_NEXTHOP_UNREGISTER),
+  DESC_ENTRY	(ZEBRA_NEXTHOP_UPDATE),
+  DESC_ENTRY	(ZEBRA_IPV4_ROUTE_BULK_ADD),
+  DESC_ENTRY	(ZEBRA_IPV4_ROUTE_BULK_DELETE),
+  DESC_ENTRY	(ZEBRA_ROUTE_NOTIFY),
+  DESC_ENTRY	(ZEBRA_IMPORT_REGISTER),
+  DESC_ENTRY	(ZEBRA_IMPORT_UNREGISTER),
+  DESC_ENTRY	(ZEBRA_IMPORT_UPDATE),
 };
 #undef DESC_ENTRY
 
@@ -69,6 +69,11 @@ typedef enum
 } zlog_dest_t;
 #define ZLOG_NUM_DESTS		(ZLOG_DEST_FILE+1)
 
+/* Default size of the file logging buffer, in kbytes (see zlog_set_async) */
+#define ZLOG_ASYNC_DEFAULT	1024
+
+struct zlog_async;
+
 struct zlog 
 {
   const char *ident;	/* daemon name (first arg to openlog) */
@@ -83,6 +88,7 @@ struct zlog
   			   priority of the message? */
   int syslog_options;	/* 2nd arg to openlog */
   int timestamp_precision;	/* # of digits of subsecond precision */
+  struct zlog_async *async;	/* file output left to a writer thread */
 };
 
 /* Message structure. */
@@ -146,6 +152,14 @@ extern int zlog_reset_file (struct zlog *zl);
 /* Rotate log. */
 extern int zlog_rotate (struct zlog *);
 
+/* Leave file output to a writer thread, through a buffer of kbytes.
+   Messages that do not fit are dropped and counted.  0 goes back to
+   writing in the caller.  Returns -1 if pthreads are not available. */
+extern int zlog_set_async (struct zlog *zl, unsigned int kbytes);
+
+/* Buffer size in kbytes, 0 if not async, and messages dropped so far. */
+extern unsigned int zlog_async_size (struct zlog *zl, unsigned long *dropped);
+
 /* For hackey message lookup and check */
 #define LOOKUP_DEF(x, y, def) mes_lookup(x, x ## _max, y, def, #x)
 #define LOOKUP(x, y) LOOKUP_DEF(x, y, "(no item found)")
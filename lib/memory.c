@@ -22,16 +22,257 @@
 
 #include <zebra.h>
 /* malloc.h is generally obsolete, however GNU Libc mallinfo wants it. */
-#if !defined(HAVE_STDLIB_H) || (defined(GNU_LINUX) && defined(HAVE_MALLINFO))
+#if !defined(HAVE_STDLIB_H) || (defined(GNU_LINUX) && defined(HAVE_MALLINFO)) \
+    || defined(HAVE_MALLOC_USABLE_SIZE)
 #include <malloc.h>
-#endif /* !HAVE_STDLIB_H || HAVE_MALLINFO */
+#endif /* !HAVE_STDLIB_H || HAVE_MALLINFO || HAVE_MALLOC_USABLE_SIZE */
+
+#if defined(HAVE_SYS_MMAN_H) && defined(HAVE_MMAP) && defined(HAVE_MUNMAP)
+#include <sys/mman.h>
+#define HAVE_MEMORY_POOL
+#if !defined(MAP_ANON) && defined(MAP_ANONYMOUS)
+#define MAP_ANON MAP_ANONYMOUS
+#endif
+#endif
+
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif /* HAVE_PTHREAD */
+
+#ifdef HAVE_GLIBC_BACKTRACE
+#include <execinfo.h>
+#endif /* HAVE_GLIBC_BACKTRACE */
 
 #include "log.h"
 #include "memory.h"
+#include "thread.h"
 
-static void alloc_inc (int);
-static void alloc_dec (int);
+static void alloc_inc (int, size_t);
+static void alloc_dec (int, size_t);
+static void alloc_resize (int, size_t, size_t);
+static size_t alloc_size (int, void *);
 static void log_memstats(int log_priority);
+
+#ifdef HAVE_MEMORY_POOL
+/* Fixed-size object pools, for the types flagged MEMORY_POOL in
+ * memtypes.c.  Objects are carved out of slabs mapped straight from the
+ * system, which saves the per-object overhead of malloc and keeps the
+ * objects of a type together.  Slabs are aligned to their size, so the
+ * slab of an object is found from its address alone.  Slabs which empty
+ * out are kept for reuse until memory_pool_trim() unmaps them.
+ *
+ * The object size of a pool is set by its first allocation, so only
+ * types which are always allocated at one size, with XMALLOC or XCALLOC,
+ * may be pooled.
+ */
+#define MPOOL_SLAB_SIZE (64 * 1024)
+#define MPOOL_ALIGN 8
+#define MPOOL_ROUNDUP(S) (((S) + MPOOL_ALIGN - 1) & ~((size_t) MPOOL_ALIGN - 1))
+
+struct mpool_slab
+{
+  struct mpool_slab *next;
+  struct mpool_slab *prev;
+
+  /* Freed objects, linked through their first word. */
+  void *free;
+
+  /* Objects in use, and objects ever carved out of the slab. */
+  unsigned int used;
+  unsigned int carved;
+};
+
+#define MPOOL_SLAB_HDR MPOOL_ROUNDUP (sizeof (struct mpool_slab))
+
+struct mpool
+{
+  int pooled;
+  size_t objsize;
+  unsigned int per_slab;
+
+  /* Slabs with free objects, without, and with none in use. */
+  struct mpool_slab *partial;
+  struct mpool_slab *full;
+  struct mpool_slab *empty;
+
+  unsigned long slabs;
+  unsigned long empty_slabs;
+  unsigned long used;
+};
+
+static struct mpool mpool[MTYPE_MAX];
+static int mpool_ready;
+
+static void
+mpool_setup (void)
+{
+  struct mlist *ml;
+  struct memory_list *m;
+
+  for (ml = mlists; ml->list; ml++)
+    for (m = ml->list; m->index >= 0; m++)
+      if (m->index && (m->flags & MEMORY_POOL))
+	mpool[m->index].pooled = 1;
+
+  mpool_ready = 1;
+}
+
+static int
+mpool_enabled (int type)
+{
+  if (! mpool_ready)
+    mpool_setup ();
+  return mpool[type].pooled;
+}
+
+static void
+mpool_slab_unlink (struct mpool_slab **list, struct mpool_slab *slab)
+{
+  if (slab->next)
+    slab->next->prev = slab->prev;
+  if (slab->prev)
+    slab->prev->next = slab->next;
+  else
+    *list = slab->next;
+  slab->next = slab->prev = NULL;
+}
+
+static void
+mpool_slab_push (struct mpool_slab **list, struct mpool_slab *slab)
+{
+  slab->prev = NULL;
+  slab->next = *list;
+  if (*list)
+    (*list)->prev = slab;
+  *list = slab;
+}
+
+/* Map a slab aligned to its size. */
+static struct mpool_slab *
+mpool_slab_map (void)
+{
+  char *p, *slab;
+  size_t lead;
+
+  p = mmap (NULL, 2 * MPOOL_SLAB_SIZE, PROT_READ | PROT_WRITE,
+	    MAP_PRIVATE | MAP_ANON, -1, 0);
+  if (p == MAP_FAILED)
+    return NULL;
+
+  slab = (char *) (((uintptr_t) p + MPOOL_SLAB_SIZE - 1)
+		   & ~((uintptr_t) MPOOL_SLAB_SIZE - 1));
+  lead = slab - p;
+  if (lead)
+    munmap (p, lead);
+  munmap (slab + MPOOL_SLAB_SIZE, MPOOL_SLAB_SIZE - lead);
+
+  return (struct mpool_slab *) slab;
+}
+
+static void *
+mpool_alloc (struct mpool *pool, size_t size)
+{
+  struct mpool_slab *slab;
+  void *obj;
+
+  if (! pool->objsize)
+    {
+      pool->objsize = MPOOL_ROUNDUP (size ? size : 1);
+      pool->per_slab = (MPOOL_SLAB_SIZE - MPOOL_SLAB_HDR) / pool->objsize;
+      assert (pool->per_slab > 0);
+    }
+  assert (size <= pool->objsize);
+
+  if ((slab = pool->partial) == NULL)
+    {
+      if ((slab = pool->empty) != NULL)
+	{
+	  mpool_slab_unlink (&pool->empty, slab);
+	  pool->empty_slabs--;
+	}
+      else
+	{
+	  if ((slab = mpool_slab_map ()) == NULL)
+	    return NULL;
+	  memset (slab, 0, sizeof (struct mpool_slab));
+	  pool->slabs++;
+	}
+      mpool_slab_push (&pool->partial, slab);
+    }
+
+  if (slab->free)
+    {
+      obj = slab->free;
+      slab->free = *(void **) obj;
+    }
+  else
+    obj = (char *) slab + MPOOL_SLAB_HDR + slab->carved++ * pool->objsize;
+
+  pool->used++;
+  if (++slab->used == pool->per_slab)
+    {
+      mpool_slab_unlink (&pool->partial, slab);
+      mpool_slab_push (&pool->full, slab);
+    }
+
+  return obj;
+}
+
+static void
+mpool_free (struct mpool *pool, void *obj)
+{
+  struct mpool_slab *slab;
+
+  slab = (struct mpool_slab *) ((uintptr_t) obj
+				& ~((uintptr_t) MPOOL_SLAB_SIZE - 1));
+
+  if (slab->used == pool->per_slab)
+    {
+      mpool_slab_unlink (&pool->full, slab);
+      mpool_slab_push (&pool->partial, slab);
+    }
+
+  *(void **) obj = slab->free;
+  slab->free = obj;
+  pool->used--;
+
+  if (--slab->used == 0)
+    {
+      mpool_slab_unlink (&pool->partial, slab);
+      mpool_slab_push (&pool->empty, slab);
+      pool->empty_slabs++;
+    }
+}
+
+void
+memory_pool_trim (void)
+{
+  struct mpool *pool;
+  struct mpool_slab *slab;
+  int type;
+
+  for (type = 0; type < MTYPE_MAX; type++)
+    {
+      pool = &mpool[type];
+      while ((slab = pool->empty) != NULL)
+	{
+	  mpool_slab_unlink (&pool->empty, slab);
+	  munmap (slab, MPOOL_SLAB_SIZE);
+	  pool->slabs--;
+	  pool->empty_slabs--;
+	}
+    }
+}
+#else
+#define mpool_enabled(T) (0)
+#define mpool_alloc(P, S) (NULL)
+#define mpool_free(P, O)
+
+void
+memory_pool_trim (void)
+{
+}
+#endif /* HAVE_MEMORY_POOL */
 
 static const struct message mstr [] =
 {
@@ -58,6 +299,41 @@ zerror (const char *fname, int type, size_t size)
   abort();
 }
 
+#ifdef HAVE_PTHREAD
+/* Set through memory_threads() while pthreads other than the main one
+ * may allocate: pools and statistics are then only touched under lock.
+ */
+static int memory_threaded;
+static pthread_mutex_t memory_mtx = PTHREAD_MUTEX_INITIALIZER;
+
+#define MEMORY_LOCK() \
+  do { \
+    if (memory_threaded) \
+      pthread_mutex_lock (&memory_mtx); \
+  } while (0)
+#define MEMORY_UNLOCK() \
+  do { \
+    if (memory_threaded) \
+      pthread_mutex_unlock (&memory_mtx); \
+  } while (0)
+
+/* To be called by the main thread only, with no other thread running
+ * allocations. */
+void
+memory_threads (int on)
+{
+  memory_threaded = on;
+}
+#else
+#define MEMORY_LOCK()
+#define MEMORY_UNLOCK()
+
+void
+memory_threads (int on)
+{
+}
+#endif /* HAVE_PTHREAD */
+
 /*
  * Allocate memory of a given size, to be tracked by a given type.
  * Effects: Returns a pointer to usable memory.  If memory cannot
@@ -68,12 +344,17 @@ zmalloc (int type, size_t size)
 {
   void *memory;
 
-  memory = malloc (size);
+  MEMORY_LOCK ();
+  if (mpool_enabled (type))
+    memory = mpool_alloc (&mpool[type], size);
+  else
+    memory = malloc (size);
 
   if (memory == NULL)
     zerror ("malloc", type, size);
 
-  alloc_inc (type);
+  alloc_inc (type, alloc_size (type, memory));
+  MEMORY_UNLOCK ();
 
   return memory;
 }
@@ -86,12 +367,20 @@ zcalloc (int type, size_t size)
 {
   void *memory;
 
-  memory = calloc (1, size);
+  MEMORY_LOCK ();
+  if (mpool_enabled (type))
+    {
+      if ((memory = mpool_alloc (&mpool[type], size)) != NULL)
+	memset (memory, 0, size);
+    }
+  else
+    memory = calloc (1, size);
 
   if (memory == NULL)
     zerror ("calloc", type, size);
 
-  alloc_inc (type);
+  alloc_inc (type, alloc_size (type, memory));
+  MEMORY_UNLOCK ();
 
   return memory;
 }
@@ -107,12 +396,25 @@ void *
 zrealloc (int type, void *ptr, size_t size)
 {
   void *memory;
+  size_t oldsize;
 
+  /* Pooled objects have a fixed size. */
+  if (mpool_enabled (type))
+    {
+      assert (ptr == NULL);
+      return zmalloc (type, size);
+    }
+
+  MEMORY_LOCK ();
+  oldsize = ptr ? alloc_size (type, ptr) : 0;
   memory = realloc (ptr, size);
   if (memory == NULL)
     zerror ("realloc", type, size);
   if (ptr == NULL)
-    alloc_inc (type);
+    alloc_inc (type, alloc_size (type, memory));
+  else
+    alloc_resize (type, oldsize, alloc_size (type, memory));
+  MEMORY_UNLOCK ();
 
   return memory;
 }
@@ -128,8 +430,13 @@ zfree (int type, void *ptr)
 {
   if (ptr != NULL)
     {
-      alloc_dec (type);
-      free (ptr);
+      MEMORY_LOCK ();
+      alloc_dec (type, alloc_size (type, ptr));
+      if (mpool_enabled (type))
+	mpool_free (&mpool[type], ptr);
+      else
+	free (ptr);
+      MEMORY_UNLOCK ();
     }
 }
 
@@ -144,13 +451,28 @@ zstrdup (int type, const char *str)
 {
   void *dup;
 
+  assert (! mpool_enabled (type));
+  MEMORY_LOCK ();
   dup = strdup (str);
   if (dup == NULL)
     zerror ("strdup", type, strlen (str));
-  alloc_inc (type);
+  alloc_inc (type, alloc_size (type, dup));
+  MEMORY_UNLOCK ();
   return dup;
 }
 
+/* Counters of a type besides its live allocations, for "show memory
+   statistics".  Allocations and frees count from the last "clear memory
+   statistics", which also restarts the peaks from the current values.
+   Bytes are those the allocator handed out, which may be more than were
+   asked for, and stay 0 where malloc_usable_size() is missing. */
+#define MSTAT_COUNTERS \
+  unsigned long allocs; \
+  unsigned long frees; \
+  long peak; \
+  unsigned long bytes; \
+  unsigned long peak_bytes;
+
 #ifdef MEMORY_LOG
 static struct 
 {
@@ -163,6 +485,7 @@ static struct
   unsigned long t_realloc;
   unsigned long t_free;
   unsigned long c_strdup;
+  MSTAT_COUNTERS
 } mstat [MTYPE_MAX];
 
 static void
@@ -243,21 +566,141 @@ static struct
 {
   char *name;
   long alloc;
+  MSTAT_COUNTERS
 } mstat [MTYPE_MAX];
 #endif /* MEMORY_LOG */
 
+/* Allocations ever made, of any type. */
+static unsigned long alloc_total;
+
+/* When the statistics were last cleared. */
+static time_t mstat_reset;
+
+#ifdef HAVE_GLIBC_BACKTRACE
+/* Call sites sampled by "debug memory allocations", one in every
+ * allocations of the type.  Sites are told apart by their innermost
+ * MTRACE_DEPTH frames; a site beyond MTRACE_SITES is only counted as
+ * dropped.
+ */
+#define MTRACE_DEPTH 6
+#define MTRACE_SITES 32
+
+/* Frames of mtrace_sample(), alloc_inc() and the z*() function. */
+#define MTRACE_SKIP 3
+
+struct mtrace_site
+{
+  void *pc[MTRACE_DEPTH];
+  int depth;
+  unsigned long count;
+};
+
+static struct
+{
+  /* Type being sampled, 0 for none, and the type last sampled. */
+  int active;
+  int type;
+  unsigned int every;
+  unsigned long seen;
+  unsigned long samples;
+  unsigned long dropped;
+  int nsites;
+  struct mtrace_site site[MTRACE_SITES];
+} mtrace;
+
+static void __attribute__ ((noinline))
+mtrace_sample (void)
+{
+  void *pc[MTRACE_DEPTH + MTRACE_SKIP];
+  struct mtrace_site *site;
+  int depth;
+  int i;
+
+  if (++mtrace.seen % mtrace.every)
+    return;
+  mtrace.samples++;
+
+  depth = backtrace (pc, array_size (pc)) - MTRACE_SKIP;
+  if (depth <= 0)
+    {
+      mtrace.dropped++;
+      return;
+    }
+
+  for (i = 0; i < mtrace.nsites; i++)
+    {
+      site = &mtrace.site[i];
+      if (site->depth == depth
+	  && memcmp (site->pc, pc + MTRACE_SKIP, depth * sizeof (void *)) == 0)
+	{
+	  site->count++;
+	  return;
+	}
+    }
+
+  if (mtrace.nsites == MTRACE_SITES)
+    {
+      mtrace.dropped++;
+      return;
+    }
+  site = &mtrace.site[mtrace.nsites++];
+  memcpy (site->pc, pc + MTRACE_SKIP, depth * sizeof (void *));
+  site->depth = depth;
+  site->count = 1;
+}
+#endif /* HAVE_GLIBC_BACKTRACE */
+
+/* Bytes the allocator gave for an allocation of the type. */
+static size_t
+alloc_size (int type, void *ptr)
+{
+#ifdef HAVE_MEMORY_POOL
+  if (mpool[type].pooled)
+    return mpool[type].objsize;
+#endif /* HAVE_MEMORY_POOL */
+#ifdef HAVE_MALLOC_USABLE_SIZE
+  return malloc_usable_size (ptr);
+#else
+  return 0;
+#endif /* HAVE_MALLOC_USABLE_SIZE */
+}
+
 /* Increment allocation counter. */
-static void
-alloc_inc (int type)
+static void __attribute__ ((noinline))
+alloc_inc (int type, size_t size)
 {
   mstat[type].alloc++;
+  alloc_total++;
+
+  mstat[type].allocs++;
+  if (mstat[type].alloc > mstat[type].peak)
+    mstat[type].peak = mstat[type].alloc;
+  mstat[type].bytes += size;
+  if (mstat[type].bytes > mstat[type].peak_bytes)
+    mstat[type].peak_bytes = mstat[type].bytes;
+
+#ifdef HAVE_GLIBC_BACKTRACE
+  if (mtrace.active && mtrace.active == type)
+    mtrace_sample ();
+#endif /* HAVE_GLIBC_BACKTRACE */
 }
 
 /* Decrement allocation counter. */
 static void
-alloc_dec (int type)
+alloc_dec (int type, size_t size)
 {
   mstat[type].alloc--;
+  mstat[type].frees++;
+  mstat[type].bytes -= size;
+}
+
+/* Account a reallocation of a live object. */
+static void
+alloc_resize (int type, size_t oldsize, size_t newsize)
+{
+  mstat[type].bytes += newsize - oldsize;
+  if (mstat[type].bytes > mstat[type].peak_bytes)
+    mstat[type].peak_bytes = mstat[type].bytes;
 }
 
 /* Looking up memory status from vty interface. */
@@ -328,6 +771,46 @@ show_separator(struct vty *vty)
   vty_out (vty, "-----------------------------\r\n");
 }
 
+/* Slab usage of the pooled types in list.  Fill is the share of the
+   pool's slab space holding objects in use, so a low fill after routes
+   went away means free but unreturned slab space. */
+static int
+show_memory_pools (struct vty *vty, struct memory_list *list, int needsep)
+{
+#ifdef HAVE_MEMORY_POOL
+  struct memory_list *m;
+  struct mpool *pool;
+  char buf[MTYPE_MEMSTR_LEN];
+  int shown = 0;
+
+  for (m = list; m->index >= 0; m++)
+    {
+      if (m->index == 0)
+	continue;
+      pool = &mpool[m->index];
+      if (! pool->slabs)
+	continue;
+
+      if (! shown)
+	{
+	  if (needsep)
+	    show_separator (vty);
+	  vty_out (vty, "%-30s  %6s %8s %6s %10s %5s\r\n", "Memory pool",
+		   "Object", "Slabs", "Empty", "Mapped", "Fill");
+	  shown = 1;
+	}
+      vty_out (vty, "%-30s: %6lu %8lu %6lu %10s %4lu%%\r\n", m->format,
+	       (unsigned long) pool->objsize, pool->slabs, pool->empty_slabs,
+	       mtype_memstr (buf, MTYPE_MEMSTR_LEN,
+			     pool->slabs * MPOOL_SLAB_SIZE),
+	       (pool->used * 100) / (pool->slabs * pool->per_slab));
+    }
+  return shown;
+#else
+  return 0;
+#endif /* HAVE_MEMORY_POOL */
+}
+
 static int
 show_memory_vty (struct vty *vty, struct memory_list *list)
 {
@@ -348,6 +831,10 @@ show_memory_vty (struct vty *vty, struct memory_list *list)
 	vty_out (vty, "%-30s: %10ld\r\n", m->format, mstat[m->index].alloc);
 	needsep = 1;
       }
+
+  if (show_memory_pools (vty, list, needsep))
+    needsep = 1;
+
   return needsep;
 }
 
@@ -433,6 +920,14 @@ DEFUN (show_memory_lib,
   return CMD_SUCCESS;
 }
 
+static void (*show_memory_zebra_func) (struct vty *);
+
+void
+memory_show_zebra_hook (void (*func) (struct vty *))
+{
+  show_memory_zebra_func = func;
+}
+
 DEFUN (show_memory_zebra,
        show_memory_zebra_cmd,
        "show memory zebra",
@@ -440,7 +935,10 @@ DEFUN (show_memory_zebra,
        "Memory statistics\n"
        "Zebra memory\n")
 {
-  show_memory_vty (vty, memory_list_zebra);
+  if (show_memory_vty (vty, memory_list_zebra) && show_memory_zebra_func)
+    show_separator (vty);
+  if (show_memory_zebra_func)
+    (*show_memory_zebra_func) (vty);
   return CMD_SUCCESS;
 }
 
@@ -521,9 +1019,216 @@ DEFUN (show_memory_isis,
   return CMD_SUCCESS;
 }
 
+/* The type whose memory_list description is name, or 0. */
+static int
+mtype_lookup (const char *name)
+{
+  struct mlist *ml;
+  struct memory_list *m;
+
+  for (ml = mlists; ml->list; ml++)
+    for (m = ml->list; m->index >= 0; m++)
+      if (m->index && strcasecmp (m->format, name) == 0)
+	return m->index;
+  return 0;
+}
+
+#ifdef HAVE_GLIBC_BACKTRACE
+/* The memory_list description of type. */
+static const char *
+mtype_format (int type)
+{
+  struct mlist *ml;
+  struct memory_list *m;
+
+  for (ml = mlists; ml->list; ml++)
+    for (m = ml->list; m->index >= 0; m++)
+      if (m->index == type)
+	return m->format;
+  return "unknown type";
+}
+#endif /* HAVE_GLIBC_BACKTRACE */
+
+DEFUN (show_memory_statistics,
+       show_memory_statistics_cmd,
+       "show memory statistics",
+       SHOW_STR
+       "Memory statistics\n"
+       "Allocation rates and peaks of each type\n")
+{
+  struct mlist *ml;
+  struct memory_list *m;
+  struct timeval now;
+  time_t elapsed;
+  char buf[2][MTYPE_MEMSTR_LEN];
+
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &now);
+  elapsed = now.tv_sec - mstat_reset;
+  if (elapsed < 1)
+    elapsed = 1;
+
+  vty_out (vty, "Counted over the last %ld seconds%s%s", (long) elapsed,
+	   VTY_NEWLINE, VTY_NEWLINE);
+  vty_out (vty, "%-30s  %10s %10s %10s %10s %9s %9s%s", "Type", "Current",
+	   "Peak", "Bytes", "Peak bytes", "Allocs/s", "Frees/s", VTY_NEWLINE);
+  for (ml = mlists; ml->list; ml++)
+    for (m = ml->list; m->index >= 0; m++)
+      {
+	if (m->index == 0 || ! mstat[m->index].peak)
+	  continue;
+	vty_out (vty, "%-30s: %10ld %10ld %10s %10s %9lu %9lu%s", m->format,
+		 mstat[m->index].alloc, mstat[m->index].peak,
+		 mtype_memstr (buf[0], MTYPE_MEMSTR_LEN,
+			       mstat[m->index].bytes),
+		 mtype_memstr (buf[1], MTYPE_MEMSTR_LEN,
+			       mstat[m->index].peak_bytes),
+		 mstat[m->index].allocs / elapsed,
+		 mstat[m->index].frees / elapsed, VTY_NEWLINE);
+      }
+
+  return CMD_SUCCESS;
+}
+
+DEFUN (clear_memory_statistics,
+       clear_memory_statistics_cmd,
+       "clear memory statistics",
+       CLEAR_STR
+       "Memory statistics\n"
+       "Allocation rates, peaks and sampled call sites\n")
+{
+  struct timeval now;
+  int type;
+
+  MEMORY_LOCK ();
+  for (type = 0; type < MTYPE_MAX; type++)
+    {
+      mstat[type].allocs = mstat[type].frees = 0;
+      mstat[type].peak = mstat[type].alloc;
+      mstat[type].peak_bytes = mstat[type].bytes;
+    }
+#ifdef HAVE_GLIBC_BACKTRACE
+  mtrace.seen = mtrace.samples = mtrace.dropped = 0;
+  mtrace.nsites = 0;
+#endif /* HAVE_GLIBC_BACKTRACE */
+  MEMORY_UNLOCK ();
+
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &now);
+  mstat_reset = now.tv_sec;
+  return CMD_SUCCESS;
+}
+
+#ifdef HAVE_GLIBC_BACKTRACE
+DEFUN (debug_memory_allocations,
+       debug_memory_allocations_cmd,
+       "debug memory allocations <1-65535> .TYPE",
+       DEBUG_STR
+       "Memory allocation\n"
+       "Sample the call sites allocating a type\n"
+       "Sample one in this many allocations\n"
+       "Memory type, as named by show memory\n")
+{
+  unsigned int every;
+  char *name;
+  int type;
+
+  VTY_GET_INTEGER_RANGE ("sampling interval", every, argv[0], 1, 65535);
+  name = argv_concat (argv, argc, 1);
+  type = mtype_lookup (name);
+  if (! type)
+    {
+      vty_out (vty, "%% No memory type %s%s", name, VTY_NEWLINE);
+      XFREE (MTYPE_TMP, name);
+      return CMD_WARNING;
+    }
+  XFREE (MTYPE_TMP, name);
+
+  MEMORY_LOCK ();
+  mtrace.active = mtrace.type = type;
+  mtrace.every = every;
+  mtrace.seen = mtrace.samples = mtrace.dropped = 0;
+  mtrace.nsites = 0;
+  MEMORY_UNLOCK ();
+  return CMD_SUCCESS;
+}
+
+DEFUN (no_debug_memory_allocations,
+       no_debug_memory_allocations_cmd,
+       "no debug memory allocations",
+       NO_STR
+       DEBUG_STR
+       "Memory allocation\n"
+       "Sample the call sites allocating a type\n")
+{
+  MEMORY_LOCK ();
+  mtrace.active = 0;
+  MEMORY_UNLOCK ();
+  return CMD_SUCCESS;
+}
+
+static int
+mtrace_site_cmp (const void *a, const void *b)
+{
+  const struct mtrace_site *s1 = a;
+  const struct mtrace_site *s2 = b;
+
+  if (s1->count != s2->count)
+    return s1->count > s2->count ? -1 : 1;
+  return 0;
+}
+
+DEFUN (show_memory_allocations,
+       show_memory_allocations_cmd,
+       "show memory allocations",
+       SHOW_STR
+       "Memory statistics\n"
+       "Call sites sampled by debug memory allocations\n")
+{
+  struct mtrace_site site[MTRACE_SITES];
+  int nsites;
+  char **sym;
+  int i, j;
+
+  if (! mtrace.type)
+    {
+      vty_out (vty, "No allocations sampled%s", VTY_NEWLINE);
+      return CMD_SUCCESS;
+    }
+
+  MEMORY_LOCK ();
+  nsites = mtrace.nsites;
+  memcpy (site, mtrace.site, nsites * sizeof (struct mtrace_site));
+  MEMORY_UNLOCK ();
+  qsort (site, nsites, sizeof (struct mtrace_site), mtrace_site_cmp);
+
+  vty_out (vty, "%s, one in %u allocations%s: %lu samples, %lu dropped%s",
+	   mtype_format (mtrace.type),
+	   mtrace.every, mtrace.active ? "" : " (stopped)", mtrace.samples,
+	   mtrace.dropped, VTY_NEWLINE);
+  for (i = 0; i < nsites; i++)
+    {
+      vty_out (vty, "%s%lu samples%s", VTY_NEWLINE, site[i].count,
+	       VTY_NEWLINE);
+      sym = backtrace_symbols (site[i].pc, site[i].depth);
+      for (j = 0; j < site[i].depth; j++)
+	if (sym)
+	  vty_out (vty, "  %s%s", sym[j], VTY_NEWLINE);
+	else
+	  vty_out (vty, "  %p%s", site[i].pc[j], VTY_NEWLINE);
+      free (sym);
+    }
+
+  return CMD_SUCCESS;
+}
+#endif /* HAVE_GLIBC_BACKTRACE */
+
 void
 memory_init (void)
 {
+  struct timeval now;
+
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &now);
+  mstat_reset = now.tv_sec;
+
   install_element (RESTRICTED_NODE, &show_memory_cmd);
   install_element (RESTRICTED_NODE, &show_memory_all_cmd);
   install_element (RESTRICTED_NODE, &show_memory_lib_cmd);
@@ -557,6 +1262,17 @@ memory_init (void)
   install_element (ENABLE_NODE, &show_memory_ospf_cmd);
   install_element (ENABLE_NODE, &show_memory_ospf6_cmd);
   install_element (ENABLE_NODE, &show_memory_isis_cmd);
+
+  install_element (RESTRICTED_NODE, &show_memory_statistics_cmd);
+  install_element (VIEW_NODE, &show_memory_statistics_cmd);
+  install_element (ENABLE_NODE, &show_memory_statistics_cmd);
+  install_element (ENABLE_NODE, &clear_memory_statistics_cmd);
+#ifdef HAVE_GLIBC_BACKTRACE
+  install_element (VIEW_NODE, &show_memory_allocations_cmd);
+  install_element (ENABLE_NODE, &show_memory_allocations_cmd);
+  install_element (ENABLE_NODE, &debug_memory_allocations_cmd);
+  install_element (ENABLE_NODE, &no_debug_memory_allocations_cmd);
+#endif /* HAVE_GLIBC_BACKTRACE */
 }
 
 /* Stats querying from users */
@@ -627,3 +1343,26 @@ mtype_stats_alloc (int type)
 {
   return mstat[type].alloc;
 }
+
+unsigned long
+mtype_stats_total (void)
+{
+  return alloc_total;
+}
+
+unsigned long
+mtype_stats_bytes (void)
+{
+  unsigned long bytes = 0;
+  int i;
+
+  for (i = 0; i < MTYPE_MAX; i++)
+    bytes += mstat[i].bytes;
+  return bytes;
+}
+
+unsigned long
+mtype_stats_type_bytes (int type)
+{
+  return mstat[type].bytes;
+}
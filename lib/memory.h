@@ -28,8 +28,12 @@ struct memory_list
 {
   int index;
   const char *format;
+  int flags;
 };
 
+/* memory_list flags */
+#define MEMORY_POOL	(1 << 0)	/* allocate from fixed-size slabs */
+
 struct mlist {
   struct memory_list *list;
   const char *name;
@@ -90,6 +94,25 @@ extern void log_memstats_stderr (const char *);
 /* return number of allocations outstanding for the type */
 extern unsigned long mtype_stats_alloc (int);
 
+/* return number of allocations ever made, of all types */
+extern unsigned long mtype_stats_total (void);
+
+/* return bytes held by the allocations outstanding, of all types */
+extern unsigned long mtype_stats_bytes (void);
+
+/* return bytes held by the allocations outstanding for the type */
+extern unsigned long mtype_stats_type_bytes (int);
+
+/* Set what a daemon adds to "show memory zebra", e.g. per route use */
+struct vty;
+extern void memory_show_zebra_hook (void (*) (struct vty *));
+
+/* Return memory pool slabs with nothing allocated to the system */
+extern void memory_pool_trim (void);
+
+/* Set while pthreads besides the main one allocate, see memory.c */
+extern void memory_threads (int);
+
 /* Human friendly string for given byte count */
 #define MTYPE_MEMSTR_LEN 20
 extern const char *mtype_memstr (char *, size_t, unsigned long);
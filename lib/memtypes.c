@@ -5,6 +5,10 @@
  *
  * The script is sensitive to the format (though not whitespace), see
  * the top of memtypes.awk for more details.
+ *
+ * Types flagged MEMORY_POOL are allocated from fixed-size slabs, see
+ * memory.c.  Only types which are always allocated at the same size may
+ * be flagged.
  */
 
 #include "zebra.h"
@@ -16,11 +20,12 @@ struct memory_list memory_list_lib[] =
   { MTYPE_STRVEC,		"String vector"			},
   { MTYPE_VECTOR,		"Vector"			},
   { MTYPE_VECTOR_INDEX,		"Vector index"			},
-  { MTYPE_LINK_LIST,		"Link List"			},
-  { MTYPE_LINK_NODE,		"Link Node"			},
+  { MTYPE_LINK_LIST,		"Link List",			MEMORY_POOL },
+  { MTYPE_LINK_NODE,		"Link Node",			MEMORY_POOL },
   { MTYPE_THREAD,		"Thread"			},
   { MTYPE_THREAD_MASTER,	"Thread master"			},
   { MTYPE_THREAD_STATS,		"Thread stats"			},
+  { MTYPE_THREAD_FDTBL,		"Thread fd table"		},
   { MTYPE_VTY,			"VTY"				},
   { MTYPE_VTY_OUT_BUF,		"VTY output buffer"		},
   { MTYPE_VTY_HIST,		"VTY history"			},
@@ -39,22 +44,27 @@ struct memory_list memory_list_lib[] =
   { MTYPE_HASH_BACKET,		"Hash Bucket"			},
   { MTYPE_HASH_INDEX,		"Hash Index"			},
   { MTYPE_ROUTE_TABLE,		"Route table"			},
-  { MTYPE_ROUTE_NODE,		"Route node"			},
+  { MTYPE_ROUTE_NODE,		"Route node",			MEMORY_POOL },
+  { MTYPE_ROUTE_INDEX,		"Route table index"		},
   { MTYPE_DISTRIBUTE,		"Distribute list"		},
   { MTYPE_DISTRIBUTE_IFNAME,	"Dist-list ifname"		},
   { MTYPE_ACCESS_LIST,		"Access List"			},
   { MTYPE_ACCESS_LIST_STR,	"Access List Str"		},
   { MTYPE_ACCESS_FILTER,	"Access Filter"			},
+  { MTYPE_ACCESS_INDEX,		"Access List Index"		},
   { MTYPE_PREFIX_LIST,		"Prefix List"			},
   { MTYPE_PREFIX_LIST_ENTRY,	"Prefix List Entry"		},
   { MTYPE_PREFIX_LIST_STR,	"Prefix List Str"		},
+  { MTYPE_PREFIX_SET,		"Prefix Set"			},
   { MTYPE_ROUTE_MAP,		"Route map"			},
   { MTYPE_ROUTE_MAP_NAME,	"Route map name"		},
   { MTYPE_ROUTE_MAP_INDEX,	"Route map index"		},
   { MTYPE_ROUTE_MAP_RULE,	"Route map rule"		},
   { MTYPE_ROUTE_MAP_RULE_STR,	"Route map rule str"		},
   { MTYPE_ROUTE_MAP_COMPILED,	"Route map compiled"		},
+  { MTYPE_ROUTE_MAP_DISPATCH,	"Route map dispatch"		},
   { MTYPE_DESC,			"Command desc"			},
+  { MTYPE_CMD_INDEX,		"Command index"			},
   { MTYPE_KEY,			"Key"				},
   { MTYPE_KEYCHAIN,		"Key chain"			},
   { MTYPE_IF_RMAP,		"Interface route map"		},
@@ -66,8 +76,11 @@ struct memory_list memory_list_lib[] =
   { MTYPE_WORK_QUEUE,		"Work queue"			},
   { MTYPE_WORK_QUEUE_ITEM,	"Work queue item"		},
   { MTYPE_WORK_QUEUE_NAME,	"Work queue name string"	},
+  { MTYPE_WORK_QUEUE_MT,	"Work queue thread batch"	},
   { MTYPE_PQUEUE,		"Priority queue"		},
   { MTYPE_PQUEUE_DATA,		"Priority queue data"		},
+  { MTYPE_SPF_BACKOFF,		"SPF back-off"			},
+  { MTYPE_WHEEL,		"Timer wheel"			},
   { MTYPE_HOST,			"Host config"			},
   { -1, NULL },
 };
@@ -75,15 +88,25 @@ struct memory_list memory_list_lib[] =
 struct memory_list memory_list_zebra[] = 
 {
   { MTYPE_RTADV_PREFIX,		"Router Advertisement Prefix"	},
+  { MTYPE_RTADV_PACKET,		"Router Advertisement packet"	},
   { MTYPE_VRF,			"VRF"				},
   { MTYPE_VRF_NAME,		"VRF name"			},
-  { MTYPE_NEXTHOP,		"Nexthop"			},
-  { MTYPE_RIB,			"RIB"				},
+  { MTYPE_NEXTHOP,		"Nexthop",			MEMORY_POOL },
+  { MTYPE_RIB,			"RIB",				MEMORY_POOL },
   { MTYPE_RIB_QUEUE,		"RIB process work queue"	},
   { MTYPE_STATIC_IPV4,		"Static IPv4 route"		},
   { MTYPE_STATIC_IPV6,		"Static IPv6 route"		},
-  { MTYPE_RIB_DEST,		"RIB destination"		},
+  { MTYPE_RIB_DEST,		"RIB destination",		MEMORY_POOL },
   { MTYPE_RIB_TABLE_INFO,	"RIB table info"		},
+  { MTYPE_ZEBRA_NHT,		"Zebra nexthop tracking"	},
+  { MTYPE_REDIST_PENDING,	"Redistribution queue"		},
+  { MTYPE_NL_BATCH,		"Netlink batch"			},
+  { MTYPE_NL_BUF,		"Netlink receive buffers"	},
+  { MTYPE_NEXTHOP_RESOLVE,	"Nexthop resolution"		},
+  { MTYPE_RIB_WORKERS,		"RIB worker threads"		},
+  { MTYPE_FPM_NHG,		"FPM nexthop group"		},
+  { MTYPE_NHOBJ,		"Kernel nexthop object"		},
+  { MTYPE_NHOBJ_DEP,		"Kernel nexthop object use",	MEMORY_POOL },
   { -1, NULL },
 };
 
@@ -96,29 +119,37 @@ struct memory_list memory_list_bgp[] =
   { MTYPE_PEER_GROUP,		"Peer group"			},
   { MTYPE_PEER_DESC,		"Peer description"		},
   { MTYPE_PEER_PASSWORD,	"Peer password string"		},
-  { MTYPE_ATTR,			"BGP attribute"			},
-  { MTYPE_ATTR_EXTRA,		"BGP extra attributes"		},
+  { MTYPE_ATTR,			"BGP attribute",			MEMORY_POOL },
+  { MTYPE_ATTR_EXTRA,		"BGP extra attributes",		MEMORY_POOL },
+  { MTYPE_BGP_ATTR_CACHE,	"BGP parsed attribute cache"	},
+  { MTYPE_BGP_ATTR_CACHE_DATA,	"BGP parsed attribute cache data" },
+  { MTYPE_BGP_ATTR_ENCODE,	"BGP encoded attribute cache data" },
   { MTYPE_AS_PATH,		"BGP aspath"			},
   { MTYPE_AS_SEG,		"BGP aspath seg"		},
   { MTYPE_AS_SEG_DATA,		"BGP aspath segment data"	},
   { MTYPE_AS_STR,		"BGP aspath str"		},
   { 0, NULL },
   { MTYPE_BGP_TABLE,		"BGP table"			},
-  { MTYPE_BGP_NODE,		"BGP node"			},
-  { MTYPE_BGP_ROUTE,		"BGP route"			},
-  { MTYPE_BGP_ROUTE_EXTRA,	"BGP ancillary route info"	},
+  { MTYPE_BGP_NODE,		"BGP node",			MEMORY_POOL },
+  { MTYPE_BGP_ROUTE,		"BGP route",			MEMORY_POOL },
+  { MTYPE_BGP_ROUTE_EXTRA,	"BGP ancillary route info",	MEMORY_POOL },
   { MTYPE_BGP_CONN,		"BGP connected"			},
   { MTYPE_BGP_STATIC,		"BGP static"			},
   { MTYPE_BGP_ADVERTISE_ATTR,	"BGP adv attr"			},
-  { MTYPE_BGP_ADVERTISE,	"BGP adv"			},
+  { MTYPE_BGP_ADVERTISE,	"BGP adv",			MEMORY_POOL },
   { MTYPE_BGP_SYNCHRONISE,	"BGP synchronise"		},
-  { MTYPE_BGP_ADJ_IN,		"BGP adj in"			},
-  { MTYPE_BGP_ADJ_OUT,		"BGP adj out"			},
-  { MTYPE_BGP_MPATH_INFO,	"BGP multipath info"		},
+  { MTYPE_BGP_ADJ_IN,		"BGP adj in",			MEMORY_POOL },
+  { MTYPE_BGP_ADJ_OUT,		"BGP adj out",			MEMORY_POOL },
+  { MTYPE_BGP_ADJ_INDEX,	"BGP adj index"			},
+  { MTYPE_BGP_UPDATE_SHARE,	"BGP shared UPDATE"		},
+  { MTYPE_BGP_MPATH_INFO,	"BGP multipath info",		MEMORY_POOL },
+  { MTYPE_BGP_MPATH_LIST,	"BGP multipath candidates"	},
+  { MTYPE_BGP_INFO_KEY,		"BGP best path keys"		},
   { 0, NULL },
   { MTYPE_AS_LIST,		"BGP AS list"			},
   { MTYPE_AS_FILTER,		"BGP AS filter"			},
   { MTYPE_AS_FILTER_STR,	"BGP AS filter str"		},
+  { MTYPE_AS_LIST_CACHE,	"BGP AS list match cache"	},
   { 0, NULL },
   { MTYPE_COMMUNITY,		"community"			},
   { MTYPE_COMMUNITY_VAL,	"community val"			},
@@ -139,12 +170,20 @@ struct memory_list memory_list_bgp[] =
   { 0, NULL },
   { MTYPE_BGP_PROCESS_QUEUE,	"BGP Process queue"		},
   { MTYPE_BGP_CLEAR_NODE_QUEUE, "BGP node clear queue"		},
+  { MTYPE_BGP_WALK,		"BGP table walk"		},
+  { MTYPE_BGP_WALK_BATCH,	"BGP table walk batch"		},
+  { MTYPE_BGP_EXPORT,		"BGP RIB export"		},
+  { MTYPE_BGP_BMP,		"BGP BMP collector"		},
+  { MTYPE_BGP_RPKI,		"BGP RPKI cache"		},
+  { MTYPE_BGP_RPKI_ROA,		"BGP RPKI ROA"			},
+  { MTYPE_BGP_PERF,		"BGP peer latency"		},
   { 0, NULL },
   { MTYPE_TRANSIT,		"BGP transit attr"		},
   { MTYPE_TRANSIT_VAL,		"BGP transit val"		},
   { 0, NULL },
   { MTYPE_BGP_DISTANCE,		"BGP distance"			},
   { MTYPE_BGP_NEXTHOP_CACHE,	"BGP nexthop"			},
+  { MTYPE_BGP_ZLOOKUP,		"BGP zebra lookup"		},
   { MTYPE_BGP_CONFED_LIST,	"BGP confed list"		},
   { MTYPE_PEER_UPDATE_SOURCE,	"BGP peer update interface"	},
   { MTYPE_BGP_DAMP_INFO,	"Dampening info"		},
@@ -152,6 +191,7 @@ struct memory_list memory_list_bgp[] =
   { MTYPE_BGP_REGEXP,		"BGP regexp"			},
   { MTYPE_BGP_AGGREGATE,	"BGP aggregate"			},
   { MTYPE_BGP_ADDR,		"BGP own address"		},
+  { MTYPE_BGP_RMAP_CACHE,	"BGP route-map cache"		},
   { -1, NULL }
 };
 
@@ -198,6 +238,7 @@ struct memory_list memory_list_ospf[] =
   { MTYPE_OSPF_LSA,           "OSPF LSA"			},
   { MTYPE_OSPF_LSA_DATA,      "OSPF LSA data"			},
   { MTYPE_OSPF_LSDB,          "OSPF LSDB"			},
+  { MTYPE_OSPF_LS_RXMT,       "OSPF LS retransmission",	MEMORY_POOL },
   { MTYPE_OSPF_PACKET,        "OSPF packet"			},
   { MTYPE_OSPF_FIFO,          "OSPF FIFO queue"			},
   { MTYPE_OSPF_VERTEX,        "OSPF vertex"			},
@@ -206,6 +247,7 @@ struct memory_list memory_list_ospf[] =
   { MTYPE_OSPF_PATH,	      "OSPF path"			},
   { MTYPE_OSPF_VL_DATA,       "OSPF VL data"			},
   { MTYPE_OSPF_CRYPT_KEY,     "OSPF crypt key"			},
+  { MTYPE_OSPF_SPF_WORKERS,   "OSPF SPF worker threads"		},
   { MTYPE_OSPF_EXTERNAL_INFO, "OSPF ext. info"			},
   { MTYPE_OSPF_DISTANCE,      "OSPF distance"			},
   { MTYPE_OSPF_IF_INFO,       "OSPF if info"			},
@@ -221,11 +263,13 @@ struct memory_list memory_list_ospf6[] =
   { MTYPE_OSPF6_IF,           "OSPF6 interface"			},
   { MTYPE_OSPF6_NEIGHBOR,     "OSPF6 neighbor"			},
   { MTYPE_OSPF6_ROUTE,        "OSPF6 route"			},
+  { MTYPE_OSPF6_ROUTE_TABLE,  "OSPF6 route table"		},
   { MTYPE_OSPF6_PREFIX,       "OSPF6 prefix"			},
   { MTYPE_OSPF6_MESSAGE,      "OSPF6 message"			},
   { MTYPE_OSPF6_LSA,          "OSPF6 LSA"			},
   { MTYPE_OSPF6_LSA_SUMMARY,  "OSPF6 LSA summary"		},
   { MTYPE_OSPF6_LSDB,         "OSPF6 LSA database"		},
+  { MTYPE_OSPF6_RETRANS,      "OSPF6 LS retransmission",	MEMORY_POOL },
   { MTYPE_OSPF6_VERTEX,       "OSPF6 vertex"			},
   { MTYPE_OSPF6_SPFTREE,      "OSPF6 SPF tree"			},
   { MTYPE_OSPF6_NEXTHOP,      "OSPF6 nexthop"			},
@@ -240,6 +284,8 @@ struct memory_list memory_list_isis[] =
   { MTYPE_ISIS_TMP,           "ISIS TMP"			},
   { MTYPE_ISIS_CIRCUIT,       "ISIS circuit"			},
   { MTYPE_ISIS_LSP,           "ISIS LSP"			},
+  { MTYPE_ISIS_LSPDB,         "ISIS LSP database"		},
+  { MTYPE_ISIS_FLAGS,         "ISIS SRM/SSN flag queue"	},
   { MTYPE_ISIS_ADJACENCY,     "ISIS adjacency"			},
   { MTYPE_ISIS_AREA,          "ISIS area"			},
   { MTYPE_ISIS_AREA_ADDR,     "ISIS area address"		},
@@ -252,6 +298,8 @@ struct memory_list memory_list_isis[] =
   { MTYPE_ISIS_NEXTHOP6,      "ISIS nexthop6"			},
   { MTYPE_ISIS_DICT,          "ISIS dictionary"			},
   { MTYPE_ISIS_DICT_NODE,     "ISIS dictionary node"		},
+  { MTYPE_ISIS_RING,          "ISIS packet ring"		},
+  { MTYPE_ISIS_CSNP,          "ISIS CSNP cache"			},
   { -1, NULL },
 };
 
@@ -93,3 +93,37 @@ set_nonblocking(int fd)
     }
   return 0;
 }
+
+int
+sendmsg_batch (int fd, struct mmsghdr *msgs, unsigned int vlen, int flags)
+{
+#ifdef HAVE_SENDMMSG
+  return sendmmsg (fd, msgs, vlen, flags);
+#else
+  unsigned int i;
+  int ret;
+
+  for (i = 0; i < vlen; i++)
+    {
+      if ((ret = sendmsg (fd, &msgs[i].msg_hdr, flags)) < 0)
+	return i ? (int) i : -1;
+      msgs[i].msg_len = ret;
+    }
+  return vlen;
+#endif /* HAVE_SENDMMSG */
+}
+
+int
+recvmsg_batch (int fd, struct mmsghdr *msgs, unsigned int vlen)
+{
+#ifdef HAVE_RECVMMSG
+  return recvmmsg (fd, msgs, vlen, MSG_WAITFORONE, NULL);
+#else
+  int ret;
+
+  if ((ret = recvmsg (fd, &msgs[0].msg_hdr, 0)) < 0)
+    return -1;
+  msgs[0].msg_len = ret;
+  return 1;
+#endif /* HAVE_RECVMMSG */
+}
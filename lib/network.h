@@ -33,6 +33,24 @@ extern int writen (int, const u_char *, int);
    -1 on error. */
 extern int set_nonblocking(int fd);
 
+/* Datagram batches, one system call each where the platform allows it. */
+#if !defined(HAVE_SENDMMSG) && !defined(HAVE_RECVMMSG)
+struct mmsghdr
+{
+  struct msghdr msg_hdr;
+  unsigned int msg_len;
+};
+#endif
+
+/* Send up to vlen messages.  Returns the number sent, which is short of
+   vlen when a message fails, or -1 if the first one does. */
+extern int sendmsg_batch (int fd, struct mmsghdr *, unsigned int vlen,
+			  int flags);
+
+/* Wait for one message, then take any others already queued, up to vlen.
+   Returns the number received, or -1 on error. */
+extern int recvmsg_batch (int fd, struct mmsghdr *, unsigned int vlen);
+
 /* Does the I/O error indicate that the operation should be retried later? */
 #define ERRNO_IO_RETRY(EN) \
 	(((EN) == EAGAIN) || ((EN) == EWOULDBLOCK) || ((EN) == EINTR))
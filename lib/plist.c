@@ -20,6 +20,7 @@
  */
 
 #include <zebra.h>
+#include <sys/mman.h>
 
 #include "prefix.h"
 #include "command.h"
@@ -29,6 +30,8 @@
 #include "buffer.h"
 #include "stream.h"
 #include "log.h"
+#include "table.h"
+#include "hash.h"
 
 /* Each prefix-list's entry. */
 struct prefix_list_entry
@@ -48,6 +51,28 @@ struct prefix_list_entry
 
   struct prefix_list_entry *next;
   struct prefix_list_entry *prev;
+
+  /* Next entry with the same prefix, in order of seq. */
+  struct prefix_list_entry *trie_next;
+};
+
+/* A mapped prefix set file, see struct prefix_set_header. */
+struct prefix_set
+{
+  char *path;
+
+  u_char *base;
+  size_t size;
+
+  int family;
+  int maxlen;
+  int addrlen;
+  int esize;
+
+  const struct prefix_set_header *hdr;
+  const u_char *entries;
+
+  unsigned long hitcnt;
 };
 
 /* List of struct prefix_list. */
@@ -77,6 +102,9 @@ struct prefix_master
 
   /* Hook function which is executed when prefix_list is deleted. */
   void (*delete_hook) (struct prefix_list *);
+
+  /* Prefix lists by name. */
+  struct hash *hash;
 };
 
 /* Static structure of IPv4 prefix_list's master. */
@@ -125,29 +153,28 @@ prefix_master_get (afi_t afi)
   return NULL;
 }
 
+static const char *
+prefix_list_name (const void *arg)
+{
+  const struct prefix_list *plist = arg;
+
+  return plist->name;
+}
+
 /* Lookup prefix_list from list of prefix_list by name. */
 struct prefix_list *
 prefix_list_lookup (afi_t afi, const char *name)
 {
-  struct prefix_list *plist;
   struct prefix_master *master;
 
   if (name == NULL)
     return NULL;
 
   master = prefix_master_get (afi);
-  if (master == NULL)
+  if (master == NULL || master->hash == NULL)
     return NULL;
 
-  for (plist = master->num.head; plist; plist = plist->next)
-    if (strcmp (plist->name, name) == 0)
-      return plist;
-
-  for (plist = master->str.head; plist; plist = plist->next)
-    if (strcmp (plist->name, name) == 0)
-      return plist;
-
-  return NULL;
+  return hash_lookup_name (master->hash, name);
 }
 
 static struct prefix_list *
@@ -180,6 +207,10 @@ prefix_list_entry_free (struct prefix_list_entry *pentry)
   XFREE (MTYPE_PREFIX_LIST_ENTRY, pentry);
 }
 
+/* Bumped whenever a prefix-list is added, deleted or has its entries
+   changed. */
+static unsigned long prefix_list_version_counter;
+
 /* Insert new prefix list to list of prefix_list.  Each prefix_list
    is sorted by the name. */
 static struct prefix_list *
@@ -200,6 +231,11 @@ prefix_list_insert (afi_t afi, const char *name)
   plist = prefix_list_new ();
   plist->name = XSTRDUP (MTYPE_PREFIX_LIST_STR, name);
   plist->master = master;
+  prefix_list_version_counter++;
+
+  if (! master->hash)
+    master->hash = hash_create_name (prefix_list_name);
+  hash_get (master->hash, plist, hash_alloc_intern);
 
   /* If name is made by all digit character.  We treat it as
      number. */
@@ -284,6 +320,236 @@ prefix_list_get (afi_t afi, const char *name)
   return plist;
 }
 
+/* The entries of a prefix-list are also kept in a route table by
+   prefix, each node holding the entries for its prefix in order of seq.
+   The entries whose prefix covers a given one are then found on the path
+   from its longest match to the top of the table, so applying a list
+   costs about the prefix length rather than the list length. */
+static void
+prefix_list_trie_add (struct prefix_list *plist,
+		      struct prefix_list_entry *pentry)
+{
+  struct route_node *rn;
+  struct prefix_list_entry **pp;
+  struct prefix p;
+
+  if (! plist->trie)
+    plist->trie = route_table_init ();
+
+  /* Entries may be configured with host bits set. */
+  prefix_copy (&p, &pentry->prefix);
+  apply_mask (&p);
+
+  rn = route_node_get (plist->trie, &p);
+  if (rn->info)
+    route_unlock_node (rn);
+
+  for (pp = (struct prefix_list_entry **) &rn->info; *pp; pp = &(*pp)->trie_next)
+    if ((*pp)->seq > pentry->seq)
+      break;
+  pentry->trie_next = *pp;
+  *pp = pentry;
+  prefix_list_version_counter++;
+}
+
+static void
+prefix_list_trie_delete (struct prefix_list *plist,
+			 struct prefix_list_entry *pentry)
+{
+  struct route_node *rn;
+  struct prefix_list_entry **pp;
+  struct prefix p;
+
+  prefix_copy (&p, &pentry->prefix);
+  apply_mask (&p);
+
+  rn = route_node_lookup (plist->trie, &p);
+  assert (rn);
+  route_unlock_node (rn);
+
+  for (pp = (struct prefix_list_entry **) &rn->info; *pp; pp = &(*pp)->trie_next)
+    if (*pp == pentry)
+      {
+	*pp = pentry->trie_next;
+	break;
+      }
+  pentry->trie_next = NULL;
+  prefix_list_version_counter++;
+
+  if (! rn->info)
+    route_unlock_node (rn);
+}
+
+static void
+prefix_set_free (struct prefix_set *set)
+{
+  munmap (set->base, set->size);
+  XFREE (MTYPE_PREFIX_LIST_STR, set->path);
+  XFREE (MTYPE_PREFIX_SET, set);
+}
+
+/* Map and check the prefix set file at path, which is expected to be
+   replaced by renaming a new one over it rather than rewritten, so a
+   mapping stays good.  On failure NULL with the reason in *err. */
+static struct prefix_set *
+prefix_set_load (afi_t afi, const char *path, const char **err)
+{
+  struct prefix_set *set;
+  const struct prefix_set_header *hdr;
+  const u_char *e;
+  struct stat st;
+  u_char *base;
+  u_int32_t i;
+  int maxlen;
+  int esize;
+  int len;
+  int fd;
+
+  if ((fd = open (path, O_RDONLY)) < 0)
+    {
+      *err = safe_strerror (errno);
+      return NULL;
+    }
+  if (fstat (fd, &st) < 0)
+    {
+      *err = safe_strerror (errno);
+      close (fd);
+      return NULL;
+    }
+  if ((size_t) st.st_size < sizeof (struct prefix_set_header))
+    {
+      *err = "file too short";
+      close (fd);
+      return NULL;
+    }
+  base = mmap (NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close (fd);
+  if (base == MAP_FAILED)
+    {
+      *err = safe_strerror (errno);
+      return NULL;
+    }
+
+  hdr = (const struct prefix_set_header *) base;
+  maxlen = (afi == AFI_IP ? IPV4_MAX_BITLEN : IPV6_MAX_BITLEN);
+  esize = maxlen / 8 + 2;
+  *err = NULL;
+
+  if (hdr->magic != PREFIX_SET_MAGIC)
+    *err = "not a prefix set file";
+  else if (hdr->afi != afi)
+    *err = "prefix set file of the other address family";
+  else if ((size_t) st.st_size != sizeof (struct prefix_set_header)
+	   + (size_t) hdr->count * esize)
+    *err = "file size does not match the prefix count";
+  else if (hdr->start[0] != 0)
+    *err = "bad length index";
+  else
+    for (len = 0; len <= PREFIX_SET_MAXLEN; len++)
+      if (hdr->start[len + 1] < hdr->start[len]
+	  || (len >= maxlen && hdr->start[len + 1] != hdr->count))
+	{
+	  *err = "bad length index";
+	  break;
+	}
+
+  /* Binary search needs each length in order, and masked. */
+  e = base + sizeof (struct prefix_set_header);
+  for (len = 0; ! *err && len <= maxlen; len++)
+    for (i = hdr->start[len]; i < hdr->start[len + 1]; i++)
+      {
+	struct prefix p;
+
+	p.family = (afi == AFI_IP ? AF_INET : AF_INET6);
+	p.prefixlen = len;
+	memcpy (&p.u.prefix, e + i * esize, maxlen / 8);
+	apply_mask (&p);
+
+	if (memcmp (&p.u.prefix, e + i * esize, maxlen / 8) != 0
+	    || (i > hdr->start[len]
+		&& memcmp (e + (i - 1) * esize, e + i * esize, maxlen / 8) > 0))
+	  {
+	    *err = "prefixes not masked or not in order";
+	    break;
+	  }
+      }
+
+  if (*err)
+    {
+      munmap (base, st.st_size);
+      return NULL;
+    }
+
+  set = XCALLOC (MTYPE_PREFIX_SET, sizeof (struct prefix_set));
+  set->path = XSTRDUP (MTYPE_PREFIX_LIST_STR, path);
+  set->base = base;
+  set->size = st.st_size;
+  set->family = (afi == AFI_IP ? AF_INET : AF_INET6);
+  set->maxlen = maxlen;
+  set->addrlen = maxlen / 8;
+  set->esize = esize;
+  set->hdr = hdr;
+  set->entries = e;
+  return set;
+}
+
+/* Whether an entry of the set permits p: at each length up to p's,
+   binary search that length's entries for p masked to it. */
+static int
+prefix_set_match (struct prefix_set *set, struct prefix *p)
+{
+  const struct prefix_set_header *hdr = set->hdr;
+  const u_char *e;
+  struct prefix key;
+  u_int32_t lo, hi, mid;
+  int len;
+  int ge, le;
+
+  if (p->family != set->family)
+    return 0;
+
+  for (len = 0; len <= p->prefixlen && len <= set->maxlen; len++)
+    {
+      lo = hdr->start[len];
+      hi = hdr->start[len + 1];
+      if (lo == hi)
+	continue;
+
+      prefix_copy (&key, p);
+      key.prefixlen = len;
+      apply_mask (&key);
+
+      while (lo < hi)
+	{
+	  mid = lo + (hi - lo) / 2;
+	  if (memcmp (set->entries + mid * set->esize, &key.u.prefix,
+		      set->addrlen) < 0)
+	    lo = mid + 1;
+	  else
+	    hi = mid;
+	}
+
+      /* The same prefix may be there with different ge and le. */
+      for (; lo < hdr->start[len + 1]; lo++)
+	{
+	  e = set->entries + lo * set->esize;
+	  if (memcmp (e, &key.u.prefix, set->addrlen) != 0)
+	    break;
+
+	  ge = e[set->addrlen];
+	  le = e[set->addrlen + 1];
+	  if (! le && ! ge)
+	    {
+	      if (p->prefixlen == len)
+		return 1;
+	    }
+	  else if ((! le || p->prefixlen <= le) && (! ge || p->prefixlen >= ge))
+	    return 1;
+	}
+    }
+  return 0;
+}
+
 /* Delete prefix-list from prefix_list_master and free it. */
 static void
 prefix_list_delete (struct prefix_list *plist)
@@ -301,6 +567,12 @@ prefix_list_delete (struct prefix_list *plist)
       plist->count--;
     }
 
+  if (plist->trie)
+    route_table_finish (plist->trie);
+  if (plist->set)
+    prefix_set_free (plist->set);
+  prefix_list_version_counter++;
+
   master = plist->master;
 
   if (plist->type == PREFIX_TYPE_NUMBER)
@@ -318,6 +590,8 @@ prefix_list_delete (struct prefix_list *plist)
   else
     list->head = plist->next;
 
+  hash_release (master->hash, plist);
+
   if (plist->desc)
     XFREE (MTYPE_TMP, plist->desc);
 
@@ -374,6 +648,47 @@ prefix_list_delete_hook (void (*func) (struct prefix_list *plist))
 #endif /* HAVE_IPVt6 */
 }
 
+/* Non-zero while add hooks are held back, see prefix_list_hook_defer(). */
+static int prefix_list_hook_deferred;
+
+static void
+prefix_list_list_run_pending (struct prefix_master *master,
+			      struct prefix_list_list *list)
+{
+  struct prefix_list *plist;
+
+  for (plist = list->head; plist; plist = plist->next)
+    if (plist->hook_pending)
+      {
+	plist->hook_pending = 0;
+	if (master->add_hook)
+	  (*master->add_hook) (plist);
+      }
+}
+
+static void
+prefix_master_run_pending (struct prefix_master *master)
+{
+  prefix_list_list_run_pending (master, &master->num);
+  prefix_list_list_run_pending (master, &master->str);
+}
+
+/* While deferred, entry additions only mark their prefix-list and the
+   add hook runs once per marked list when deferral is switched off.
+   Delete hooks are never deferred. */
+void
+prefix_list_hook_defer (int defer)
+{
+  prefix_list_hook_deferred = defer;
+  if (defer)
+    return;
+
+  prefix_master_run_pending (&prefix_master_ipv4);
+#ifdef HAVE_IPV6
+  prefix_master_run_pending (&prefix_master_ipv6);
+#endif /* HAVE_IPV6 */
+}
+
 /* Calculate new sequential number. */
 static int
 prefix_new_seq_get (struct prefix_list *plist)
@@ -446,6 +761,7 @@ prefix_list_entry_delete (struct prefix_list *plist,
   else
     plist->tail = pentry->prev;
 
+  prefix_list_trie_delete (plist, pentry);
   prefix_list_entry_free (pentry);
 
   plist->count--;
@@ -455,7 +771,8 @@ prefix_list_entry_delete (struct prefix_list *plist,
       if (plist->master->delete_hook)
 	(*plist->master->delete_hook) (plist);
 
-      if (plist->head == NULL && plist->tail == NULL && plist->desc == NULL)
+      if (plist->head == NULL && plist->tail == NULL && plist->desc == NULL
+	  && plist->set == NULL)
 	prefix_list_delete (plist);
       else
 	plist->master->recent = plist;
@@ -507,11 +824,15 @@ prefix_list_entry_add (struct prefix_list *plist,
       plist->tail = pentry;
     }
 
+  prefix_list_trie_add (plist, pentry);
+
   /* Increment count. */
   plist->count++;
 
   /* Run hook function. */
-  if (plist->master->add_hook)
+  if (prefix_list_hook_deferred)
+    plist->hook_pending = 1;
+  else if (plist->master->add_hook)
     (*plist->master->add_hook) (plist);
 
   plist->master->recent = plist;
@@ -537,7 +858,7 @@ prefix_list_entry_match (struct prefix_list_entry *pentry, struct prefix *p)
 {
   int ret;
 
-  ret = prefix_match (&pentry->prefix, p);
+  ret = prefix_match_inline (&pentry->prefix, p);
   if (! ret)
     return 0;
   
@@ -560,10 +881,16 @@ prefix_list_entry_match (struct prefix_list_entry *pentry, struct prefix *p)
   return 1;
 }
 
+/* The first entry by seq to match p.  Entries whose prefix covers p
+   and come before it, or all of them when none matches, are counted as
+   looked at. */
 enum prefix_list_type
 prefix_list_apply (struct prefix_list *plist, void *object)
 {
   struct prefix_list_entry *pentry;
+  struct prefix_list_entry *matched;
+  struct route_node *top;
+  struct route_node *rn;
   struct prefix *p;
 
   p = (struct prefix *) object;
@@ -571,20 +898,92 @@ prefix_list_apply (struct prefix_list *plist, void *object)
   if (plist == NULL)
     return PREFIX_DENY;
 
-  if (plist->count == 0)
+  if (plist->count == 0 && ! plist->set)
     return PREFIX_PERMIT;
 
-  for (pentry = plist->head; pentry; pentry = pentry->next)
+  matched = NULL;
+  top = plist->trie ? route_node_match (plist->trie, p) : NULL;
+  if (! top)
+    goto set;
+
+  for (rn = top; rn; rn = rn->parent)
+    for (pentry = rn->info; pentry; pentry = pentry->trie_next)
+      {
+	if (matched && pentry->seq >= matched->seq)
+	  break;
+	if (prefix_list_entry_match (pentry, p))
+	  {
+	    matched = pentry;
+	    break;
+	  }
+      }
+
+  for (rn = top; rn; rn = rn->parent)
+    for (pentry = rn->info; pentry; pentry = pentry->trie_next)
+      {
+	if (matched && pentry->seq > matched->seq)
+	  break;
+	pentry->refcnt++;
+      }
+
+  route_unlock_node (top);
+
+ set:
+  if (! matched)
     {
-      pentry->refcnt++;
-      if (prefix_list_entry_match (pentry, p))
+      if (plist->set && prefix_set_match (plist->set, p))
 	{
-	  pentry->hitcnt++;
-	  return pentry->type;
+	  plist->set->hitcnt++;
+	  return PREFIX_PERMIT;
 	}
+      return PREFIX_DENY;
     }
 
-  return PREFIX_DENY;
+  matched->hitcnt++;
+  return matched->type;
+}
+
+/* Version of the prefix-lists, which changes whenever any of them do,
+   for callers keeping something derived from their entries. */
+unsigned long
+prefix_list_version (void)
+{
+  return prefix_list_version_counter;
+}
+
+/* Call func with the masked prefix of each permit entry of plist, and
+   of its prefix set.  A prefix the list permits is covered by at least
+   one of them. */
+void
+prefix_list_permit_walk (struct prefix_list *plist,
+			 void (*func) (struct prefix *, void *), void *arg)
+{
+  struct prefix_list_entry *pentry;
+  struct prefix_set *set = plist->set;
+  struct prefix p;
+  u_int32_t i;
+  int len;
+
+  for (pentry = plist->head; pentry; pentry = pentry->next)
+    if (pentry->type == PREFIX_PERMIT)
+      {
+	prefix_copy (&p, &pentry->prefix);
+	apply_mask (&p);
+	(*func) (&p, arg);
+      }
+
+  if (! set)
+    return;
+
+  memset (&p, 0, sizeof (struct prefix));
+  p.family = set->family;
+  for (len = 0; len <= set->maxlen; len++)
+    for (i = set->hdr->start[len]; i < set->hdr->start[len + 1]; i++)
+      {
+	p.prefixlen = len;
+	memcpy (&p.u.prefix, set->entries + i * set->esize, set->addrlen);
+	(*func) (&p, arg);
+      }
 }
 
 static void __attribute__ ((unused))
@@ -903,6 +1302,70 @@ vty_prefix_list_desc_unset (struct vty *vty, afi_t afi, const char *name)
       plist->desc = NULL;
     }
 
+  if (plist->head == NULL && plist->tail == NULL && plist->desc == NULL
+      && plist->set == NULL)
+    prefix_list_delete (plist);
+
+  return CMD_SUCCESS;
+}
+
+/* Map the prefix set file at path for the list, replacing any it had
+   only once the new one is known good. */
+static int
+vty_prefix_list_file_set (struct vty *vty, afi_t afi, const char *name,
+			  const char *path)
+{
+  struct prefix_list *plist;
+  struct prefix_set *set;
+  const char *err;
+
+  set = prefix_set_load (afi, path, &err);
+  if (! set)
+    {
+      vty_out (vty, "%% Can't load prefix set %s: %s%s", path, err,
+	       VTY_NEWLINE);
+      return CMD_WARNING;
+    }
+
+  plist = prefix_list_get (afi, name);
+  if (plist->set)
+    prefix_set_free (plist->set);
+  plist->set = set;
+  prefix_list_version_counter++;
+
+  /* Run hook function. */
+  if (prefix_list_hook_deferred)
+    plist->hook_pending = 1;
+  else if (plist->master->add_hook)
+    (*plist->master->add_hook) (plist);
+
+  plist->master->recent = plist;
+
+  return CMD_SUCCESS;
+}
+
+static int
+vty_prefix_list_file_unset (struct vty *vty, afi_t afi, const char *name)
+{
+  struct prefix_list *plist;
+
+  plist = prefix_list_lookup (afi, name);
+  if (! plist)
+    {
+      vty_out (vty, "%% Can't find specified prefix-list%s", VTY_NEWLINE);
+      return CMD_WARNING;
+    }
+
+  if (! plist->set)
+    return CMD_SUCCESS;
+
+  prefix_set_free (plist->set);
+  plist->set = NULL;
+  prefix_list_version_counter++;
+
+  if (plist->master->delete_hook)
+    (*plist->master->delete_hook) (plist);
+
   if (plist->head == NULL && plist->tail == NULL && plist->desc == NULL)
     prefix_list_delete (plist);
 
@@ -937,6 +1400,9 @@ vty_show_prefix_entry (struct vty *vty, afi_t afi, struct prefix_list *plist,
 	       plist->name, plist->count, VTY_NEWLINE);
       if (plist->desc)
 	vty_out (vty, "   Description: %s%s", plist->desc, VTY_NEWLINE);
+      if (plist->set)
+	vty_out (vty, "   File: %s, %u prefixes%s", plist->set->path,
+		 plist->set->hdr->count, VTY_NEWLINE);
     }
   else if (dtype == summary_display || dtype == detail_display)
     {
@@ -951,6 +1417,11 @@ vty_show_prefix_entry (struct vty *vty, afi_t afi, struct prefix_list *plist,
 	       plist->head ? plist->head->seq : 0, 
 	       plist->tail ? plist->tail->seq : 0,
 	       VTY_NEWLINE);
+
+      if (plist->set)
+	vty_out (vty, "   file: %s, prefixes: %u, hit count: %lu%s",
+		 plist->set->path, plist->set->hdr->count,
+		 plist->set->hitcnt, VTY_NEWLINE);
     }
 
   if (dtype != summary_display)
@@ -1608,6 +2079,40 @@ ALIAS (no_ip_prefix_list_description,
        "Prefix-list specific description\n"
        "Up to 80 characters describing this prefix-list\n")
 
+DEFUN (ip_prefix_list_file,
+       ip_prefix_list_file_cmd,
+       "ip prefix-list WORD file FILENAME",
+       IP_STR
+       PREFIX_LIST_STR
+       "Name of a prefix list\n"
+       "Also permit the prefixes of a prefix set file\n"
+       "Prefix set file, as written by plistcompile\n")
+{
+  return vty_prefix_list_file_set (vty, AFI_IP, argv[0], argv[1]);
+}
+
+DEFUN (no_ip_prefix_list_file,
+       no_ip_prefix_list_file_cmd,
+       "no ip prefix-list WORD file",
+       NO_STR
+       IP_STR
+       PREFIX_LIST_STR
+       "Name of a prefix list\n"
+       "Also permit the prefixes of a prefix set file\n")
+{
+  return vty_prefix_list_file_unset (vty, AFI_IP, argv[0]);
+}
+
+ALIAS (no_ip_prefix_list_file,
+       no_ip_prefix_list_file_arg_cmd,
+       "no ip prefix-list WORD file FILENAME",
+       NO_STR
+       IP_STR
+       PREFIX_LIST_STR
+       "Name of a prefix list\n"
+       "Also permit the prefixes of a prefix set file\n"
+       "Prefix set file, as written by plistcompile\n")
+
 DEFUN (show_ip_prefix_list,
        show_ip_prefix_list_cmd,
        "show ip prefix-list",
@@ -2204,6 +2709,40 @@ ALIAS (no_ipv6_prefix_list_description,
        "Prefix-list specific description\n"
        "Up to 80 characters describing this prefix-list\n")
 
+DEFUN (ipv6_prefix_list_file,
+       ipv6_prefix_list_file_cmd,
+       "ipv6 prefix-list WORD file FILENAME",
+       IPV6_STR
+       PREFIX_LIST_STR
+       "Name of a prefix list\n"
+       "Also permit the prefixes of a prefix set file\n"
+       "Prefix set file, as written by plistcompile\n")
+{
+  return vty_prefix_list_file_set (vty, AFI_IP6, argv[0], argv[1]);
+}
+
+DEFUN (no_ipv6_prefix_list_file,
+       no_ipv6_prefix_list_file_cmd,
+       "no ipv6 prefix-list WORD file",
+       NO_STR
+       IPV6_STR
+       PREFIX_LIST_STR
+       "Name of a prefix list\n"
+       "Also permit the prefixes of a prefix set file\n")
+{
+  return vty_prefix_list_file_unset (vty, AFI_IP6, argv[0]);
+}
+
+ALIAS (no_ipv6_prefix_list_file,
+       no_ipv6_prefix_list_file_arg_cmd,
+       "no ipv6 prefix-list WORD file FILENAME",
+       NO_STR
+       IPV6_STR
+       PREFIX_LIST_STR
+       "Name of a prefix list\n"
+       "Also permit the prefixes of a prefix set file\n"
+       "Prefix set file, as written by plistcompile\n")
+
 DEFUN (show_ipv6_prefix_list,
        show_ipv6_prefix_list_cmd,
        "show ipv6 prefix-list",
@@ -2386,6 +2925,14 @@ config_write_prefix_afi (afi_t afi, struct vty *vty)
 	  write++;
 	}
 
+      if (plist->set)
+	{
+	  vty_out (vty, "ip%s prefix-list %s file %s%s",
+		   afi == AFI_IP ? "" : "v6",
+		   plist->name, plist->set->path, VTY_NEWLINE);
+	  write++;
+	}
+
       for (pentry = plist->head; pentry; pentry = pentry->next)
 	{
 	  vty_out (vty, "ip%s prefix-list %s ",
@@ -2429,6 +2976,14 @@ config_write_prefix_afi (afi_t afi, struct vty *vty)
 	  write++;
 	}
 
+      if (plist->set)
+	{
+	  vty_out (vty, "ip%s prefix-list %s file %s%s",
+		   afi == AFI_IP ? "" : "v6",
+		   plist->name, plist->set->path, VTY_NEWLINE);
+	  write++;
+	}
+
       for (pentry = plist->head; pentry; pentry = pentry->next)
 	{
 	  vty_out (vty, "ip%s prefix-list %s ",
@@ -2464,6 +3019,17 @@ config_write_prefix_afi (afi_t afi, struct vty *vty)
   return write;
 }
 
+static void
+prefix_bgp_orf_entry_put (struct stream *s, struct prefix_list_entry *pentry,
+			  u_char flag)
+{
+  stream_putc (s, flag);
+  stream_putl (s, (u_int32_t)pentry->seq);
+  stream_putc (s, (u_char)pentry->ge);
+  stream_putc (s, (u_char)pentry->le);
+  stream_put_prefix (s, &pentry->prefix);
+}
+
 struct stream *
 prefix_bgp_orf_entry (struct stream *s, struct prefix_list *plist,
 		      u_char init_flag, u_char permit_flag, u_char deny_flag)
@@ -2474,20 +3040,107 @@ prefix_bgp_orf_entry (struct stream *s, struct prefix_list *plist,
     return s;
 
   for (pentry = plist->head; pentry; pentry = pentry->next)
+    prefix_bgp_orf_entry_put (s, pentry, init_flag
+			      | (pentry->type == PREFIX_PERMIT ?
+				 permit_flag : deny_flag));
+
+  return s;
+}
+
+/* Whether entries a and b of two lists say the same. */
+static int
+prefix_list_entry_same (struct prefix_list_entry *a,
+			struct prefix_list_entry *b)
+{
+  return a->seq == b->seq && a->type == b->type
+	 && a->ge == b->ge && a->le == b->le
+	 && prefix_same (&a->prefix, &b->prefix);
+}
+
+/* Count the entries of list from that list to does not have as they
+   are, and write them to s with flag if s is given. */
+static int
+prefix_bgp_orf_diff (struct stream *s, struct prefix_list *from,
+		     struct prefix_list *to, u_char flag, u_char permit_flag,
+		     u_char deny_flag)
+{
+  struct prefix_list_entry *pentry;
+  struct prefix_list_entry *pos;
+  int count = 0;
+
+  if (! from)
+    return 0;
+
+  /* Both lists are in order of seq. */
+  pos = to ? to->head : NULL;
+  for (pentry = from->head; pentry; pentry = pentry->next)
     {
-      u_char flag = init_flag;
-      struct prefix *p = &pentry->prefix;
+      while (pos && pos->seq < pentry->seq)
+	pos = pos->next;
+      if (pos && prefix_list_entry_same (pentry, pos))
+	continue;
+
+      count++;
+      if (s)
+	prefix_bgp_orf_entry_put (s, pentry, flag
+				  | (pentry->type == PREFIX_PERMIT ?
+				     permit_flag : deny_flag));
+    }
+  return count;
+}
+
+/* Write to s the ORF entries that take the peer from what was last sent
+   to it, kept as ORF list sent, to plist, and keep plist as sent.
+   Removals go first, as the peer refuses an entry it already has under
+   another seq.  Nothing is written if the entries do not fit in s, and
+   -1 is returned; otherwise the number of entries written. */
+int
+prefix_bgp_orf_delta (struct stream *s, const char *sent,
+		      struct prefix_list *plist, u_char add_flag,
+		      u_char remove_flag, u_char permit_flag, u_char deny_flag)
+{
+  struct prefix_list *old;
+  struct prefix_list_entry *pentry, *copy;
+  /* Flag, seq, ge, le, prefix length and the longest prefix. */
+  size_t entry_max = 8 + sizeof (struct in6_addr);
+  int count;
+
+  old = prefix_list_lookup (AFI_ORF_PREFIX, sent);
+
+  count = prefix_bgp_orf_diff (NULL, old, plist, 0, 0, 0)
+	  + prefix_bgp_orf_diff (NULL, plist, old, 0, 0, 0);
+  if (count * entry_max > STREAM_WRITEABLE (s))
+    return -1;
+  if (! count)
+    return 0;
+
+  prefix_bgp_orf_diff (s, old, plist, remove_flag, permit_flag, deny_flag);
+  prefix_bgp_orf_diff (s, plist, old, add_flag, permit_flag, deny_flag);
 
-      flag |= (pentry->type == PREFIX_PERMIT ?
-               permit_flag : deny_flag);
-      stream_putc (s, flag);
-      stream_putl (s, (u_int32_t)pentry->seq);
-      stream_putc (s, (u_char)pentry->ge);
-      stream_putc (s, (u_char)pentry->le);
-      stream_put_prefix (s, p);
+  /* Keep a copy of plist as sent, appending as its entries come in
+     order of seq. */
+  if (old)
+    prefix_list_delete (old);
+  if (plist && plist->head)
+    {
+      old = prefix_list_get (AFI_ORF_PREFIX, sent);
+      for (pentry = plist->head; pentry; pentry = pentry->next)
+	{
+	  copy = prefix_list_entry_make (&pentry->prefix, pentry->type,
+					 pentry->seq, pentry->le,
+					 pentry->ge, pentry->any);
+	  copy->prev = old->tail;
+	  if (old->tail)
+	    old->tail->next = copy;
+	  else
+	    old->head = copy;
+	  old->tail = copy;
+	  prefix_list_trie_add (old, copy);
+	  old->count++;
+	}
     }
 
-  return s;
+  return count;
 }
 
 int
@@ -2700,6 +3353,10 @@ prefix_list_init_ipv4 (void)
   install_element (CONFIG_NODE, &no_ip_prefix_list_description_cmd);
   install_element (CONFIG_NODE, &no_ip_prefix_list_description_arg_cmd);
 
+  install_element (CONFIG_NODE, &ip_prefix_list_file_cmd);
+  install_element (CONFIG_NODE, &no_ip_prefix_list_file_cmd);
+  install_element (CONFIG_NODE, &no_ip_prefix_list_file_arg_cmd);
+
   install_element (CONFIG_NODE, &ip_prefix_list_sequence_number_cmd);
   install_element (CONFIG_NODE, &no_ip_prefix_list_sequence_number_cmd);
 
@@ -2809,6 +3466,10 @@ prefix_list_init_ipv6 (void)
   install_element (CONFIG_NODE, &no_ipv6_prefix_list_description_cmd);
   install_element (CONFIG_NODE, &no_ipv6_prefix_list_description_arg_cmd);
 
+  install_element (CONFIG_NODE, &ipv6_prefix_list_file_cmd);
+  install_element (CONFIG_NODE, &no_ipv6_prefix_list_file_cmd);
+  install_element (CONFIG_NODE, &no_ipv6_prefix_list_file_arg_cmd);
+
   install_element (CONFIG_NODE, &ipv6_prefix_list_sequence_number_cmd);
   install_element (CONFIG_NODE, &no_ipv6_prefix_list_sequence_number_cmd);
 
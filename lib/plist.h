@@ -37,6 +37,8 @@ enum prefix_name_type
   PREFIX_TYPE_NUMBER
 };
 
+struct prefix_set;
+
 struct prefix_list
 {
   char *name;
@@ -52,6 +54,15 @@ struct prefix_list
   struct prefix_list_entry *head;
   struct prefix_list_entry *tail;
 
+  /* Entries by prefix, for prefix_list_apply(). */
+  struct route_table *trie;
+
+  /* Prefix set file, permitting what no entry matches, or NULL. */
+  struct prefix_set *set;
+
+  /* Add hook held back by prefix_list_hook_defer(). */
+  int hook_pending;
+
   struct prefix_list *next;
   struct prefix_list *prev;
 };
@@ -64,18 +75,45 @@ struct orf_prefix
   struct prefix p;
 };
 
+/* A prefix set file holds the prefixes of permit entries, with their
+   ge and le, to be mapped and searched in place instead of parsed into
+   entries.  After the header come count entries ordered by length then
+   address, each the address bytes masked to the length, then ge and
+   le, 0 when not given.  Numbers are in host byte order; plistcompile
+   in tests/ writes the files. */
+#define PREFIX_SET_MAGIC  0x51505331	/* "QPS1" */
+#define PREFIX_SET_MAXLEN 128
+
+struct prefix_set_header
+{
+  u_int32_t magic;
+  u_int32_t afi;
+  u_int32_t count;
+
+  /* Entries of length len are start[len] up to start[len + 1]. */
+  u_int32_t start[PREFIX_SET_MAXLEN + 2];
+};
+
 /* Prototypes. */
 extern void prefix_list_init (void);
 extern void prefix_list_reset (void);
 extern void prefix_list_add_hook (void (*func) (struct prefix_list *));
 extern void prefix_list_delete_hook (void (*func) (struct prefix_list *));
+extern void prefix_list_hook_defer (int);
 
 extern struct prefix_list *prefix_list_lookup (afi_t, const char *);
 extern enum prefix_list_type prefix_list_apply (struct prefix_list *, void *);
+extern unsigned long prefix_list_version (void);
+extern void prefix_list_permit_walk (struct prefix_list *,
+				     void (*) (struct prefix *, void *),
+				     void *);
 
 extern struct stream * prefix_bgp_orf_entry (struct stream *,
                                              struct prefix_list *,
                                              u_char, u_char, u_char);
+extern int prefix_bgp_orf_delta (struct stream *, const char *,
+                                 struct prefix_list *, u_char, u_char,
+                                 u_char, u_char);
 extern int prefix_bgp_orf_set (char *, afi_t, struct orf_prefix *, int, int);
 extern void prefix_bgp_orf_remove_all (char *);
 extern int prefix_bgp_show_prefix_list (struct vty *, afi_t, char *);
@@ -165,6 +165,19 @@ static const struct in6_addr maskbytes6[] =
   /* /128 */ { { { 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff } } }
 };
 
+const u_int32_t prefix_ipv4_masks[] =
+{
+  0x00000000, 0x80000000, 0xc0000000, 0xe0000000,
+  0xf0000000, 0xf8000000, 0xfc000000, 0xfe000000,
+  0xff000000, 0xff800000, 0xffc00000, 0xffe00000,
+  0xfff00000, 0xfff80000, 0xfffc0000, 0xfffe0000,
+  0xffff0000, 0xffff8000, 0xffffc000, 0xffffe000,
+  0xfffff000, 0xfffff800, 0xfffffc00, 0xfffffe00,
+  0xffffff00, 0xffffff80, 0xffffffc0, 0xffffffe0,
+  0xfffffff0, 0xfffffff8, 0xfffffffc, 0xfffffffe,
+  0xffffffff
+};
+
 /* Number of bits in prefix type. */
 #ifndef PNBBY
 #define PNBBY 8
@@ -224,6 +237,13 @@ prefix_match (const struct prefix *n, const struct prefix *p)
   if (n->prefixlen > p->prefixlen)
     return 0;
 
+  if (n->family == AF_INET && n->prefixlen <= IPV4_MAX_BITLEN)
+    return prefix_match_ipv4 (&n->u.prefix4, &p->u.prefix4, n->prefixlen);
+#ifdef HAVE_IPV6
+  if (n->family == AF_INET6 && n->prefixlen <= IPV6_MAX_BITLEN)
+    return prefix_match_ipv6 (&n->u.prefix6, &p->u.prefix6, n->prefixlen);
+#endif /* HAVE_IPV6 */
+
   /* Set both prefix's head pointer. */
   np = (const u_char *)&n->u.prefix;
   pp = (const u_char *)&p->u.prefix;
@@ -281,12 +301,11 @@ prefix_same (const struct prefix *p1, const struct prefix *p2)
   if (p1->family == p2->family && p1->prefixlen == p2->prefixlen)
     {
       if (p1->family == AF_INET)
-	if (IPV4_ADDR_SAME (&p1->u.prefix4.s_addr, &p2->u.prefix4.s_addr))
-	  return 1;
+	return p1->u.prefix4.s_addr == p2->u.prefix4.s_addr;
 #ifdef HAVE_IPV6
-      if (p1->family == AF_INET6 )
-	if (IPV6_ADDR_SAME (&p1->u.prefix6.s6_addr, &p2->u.prefix6.s6_addr))
-	  return 1;
+      if (p1->family == AF_INET6)
+	return prefix_match_ipv6 (&p1->u.prefix6, &p2->u.prefix6,
+				  IPV6_MAX_BITLEN);
 #endif /* HAVE_IPV6 */
     }
   return 0;
@@ -305,28 +324,12 @@ prefix_same (const struct prefix *p1, const struct prefix *p2)
 int
 prefix_cmp (const struct prefix *p1, const struct prefix *p2)
 {
-  int offset;
-  int shift;
-
-  /* Set both prefix's head pointer. */
-  const u_char *pp1 = (const u_char *)&p1->u.prefix;
-  const u_char *pp2 = (const u_char *)&p2->u.prefix;
-
   if (p1->family != p2->family || p1->prefixlen != p2->prefixlen)
     return 1;
 
-  offset = p1->prefixlen / PNBBY;
-  shift = p1->prefixlen % PNBBY;
-
-  if (shift)
-    if (maskbit[shift] & (pp1[offset] ^ pp2[offset]))
-      return 1;
-
-  while (offset--)
-    if (pp1[offset] != pp2[offset])
-      return 1;
-
-  return 0;
+  /* Of the same length, the network parts are the same if either
+     matches the other. */
+  return ! prefix_match_inline (p1, p2);
 }
 
 /*
@@ -196,4 +196,58 @@ extern const char *inet6_ntoa (struct in6_addr);
 
 extern int all_digit (const char *);
 
+/* Host order netmask of each IPv4 prefix length, 0 to 32. */
+extern const u_int32_t prefix_ipv4_masks[];
+
+/* Whether the first len bits, at most 32, of two IPv4 addresses are the
+   same. */
+static inline int
+prefix_match_ipv4 (const struct in_addr *a, const struct in_addr *b,
+		   u_char len)
+{
+  return ((a->s_addr ^ b->s_addr) & htonl (prefix_ipv4_masks[len])) == 0;
+}
+
+#ifdef HAVE_IPV6
+/* Whether the first len bits, at most 128, of two IPv6 addresses are the
+   same, compared a 32 bit word at a time. */
+static inline int
+prefix_match_ipv6 (const struct in6_addr *a, const struct in6_addr *b,
+		   u_char len)
+{
+  const u_char *pa = a->s6_addr;
+  const u_char *pb = b->s6_addr;
+  u_int32_t wa, wb;
+
+  for (; len >= 32; len -= 32, pa += 4, pb += 4)
+    {
+      memcpy (&wa, pa, sizeof (wa));
+      memcpy (&wb, pb, sizeof (wb));
+      if (wa != wb)
+	return 0;
+    }
+  if (len == 0)
+    return 1;
+  memcpy (&wa, pa, sizeof (wa));
+  memcpy (&wb, pb, sizeof (wb));
+  return ((wa ^ wb) & htonl (prefix_ipv4_masks[len])) == 0;
+}
+#endif /* HAVE_IPV6 */
+
+/* prefix_match () with the IPv4 and IPv6 compares inline, for the
+   lookups of filters and prefix-lists. */
+static inline int
+prefix_match_inline (const struct prefix *n, const struct prefix *p)
+{
+  if (n->prefixlen > p->prefixlen)
+    return 0;
+  if (n->family == AF_INET && n->prefixlen <= IPV4_MAX_BITLEN)
+    return prefix_match_ipv4 (&n->u.prefix4, &p->u.prefix4, n->prefixlen);
+#ifdef HAVE_IPV6
+  if (n->family == AF_INET6 && n->prefixlen <= IPV6_MAX_BITLEN)
+    return prefix_match_ipv6 (&n->u.prefix6, &p->u.prefix6, n->prefixlen);
+#endif /* HAVE_IPV6 */
+  return prefix_match (n, p);
+}
+
 #endif /* _ZEBRA_PREFIX_H */
@@ -28,6 +28,9 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #include "command.h"
 #include "vty.h"
 #include "log.h"
+#include "hash.h"
+#include "table.h"
+#include "plist.h"
 
 /* Vector for route match rules. */
 static vector route_match_vec;
@@ -61,10 +64,59 @@ struct route_map_list
   void (*add_hook) (const char *);
   void (*delete_hook) (const char *);
   void (*event_hook) (route_map_event_t, const char *); 
+
+  /* Route maps by name. */
+  struct hash *hash;
+
+  /* Bumped on any change to any route map. */
+  unsigned long version;
+};
+
+/* Indexes of a route map which can match a given prefix.  An index
+   with a match rule giving a prefix-list (func_prefix_list) can only
+   match prefixes covered by one of the list's permit entries, so it is
+   entered in the trie under each of those prefixes.  Like the list,
+   the trie compares prefixes by their bits whatever the family.  Any
+   other index is always a candidate.  The candidates for a prefix
+   are then the always ones plus those entered on the path from its
+   longest match to the top of the trie. */
+struct route_map_dispatch
+{
+  /* route_map_version() and prefix_list_version() when built. */
+  unsigned long version;
+  unsigned long plist_version;
+
+  /* Indexes in order, and bitmaps of them in words of 32. */
+  int count;
+  int words;
+  struct route_map_index **index;
+  u_int32_t *always;
+  u_int32_t *cand;
+
+  /* Whether cand is in use by route_map_apply(). */
+  int busy;
+
+  /* Entered indexes, by prefix. */
+  struct route_table *trie;
+};
+
+/* Index entered under a prefix in a dispatch trie. */
+struct route_map_dispatch_entry
+{
+  int pos;
+  struct route_map_dispatch_entry *next;
 };
 
 /* Master list of route map. */
-static struct route_map_list route_map_master = { NULL, NULL, NULL, NULL };
+static struct route_map_list route_map_master = { NULL, NULL, NULL, NULL, NULL, 0 };
+
+static const char *
+route_map_name (const void *arg)
+{
+  const struct route_map *map = arg;
+
+  return map->name;
+}
 
 static void
 route_map_rule_delete (struct route_map_rule_list *,
@@ -72,6 +124,25 @@ route_map_rule_delete (struct route_map_rule_list *,
 
 static void
 route_map_index_delete (struct route_map_index *, int);
+
+static void
+route_map_dispatch_free (struct route_map_dispatch *);
+
+/* Non-zero while hooks are held back, see route_map_hook_defer(). */
+static int route_map_hook_deferred;
+
+/* Execute event hook, or remember the event while deferred. */
+static void
+route_map_event (struct route_map *map, route_map_event_t event)
+{
+  if (route_map_hook_deferred)
+    {
+      map->event_pending = 1;
+      map->pending_event = event;
+    }
+  else if (route_map_master.event_hook)
+    (*route_map_master.event_hook) (event, map->name);
+}
 
 /* New route map allocation. Please note route map's name must be
    specified. */
@@ -103,8 +174,15 @@ route_map_add (const char *name)
     list->head = map;
   list->tail = map;
 
+  if (! list->hash)
+    list->hash = hash_create_name (route_map_name);
+  hash_get (list->hash, map, hash_alloc_intern);
+  list->version++;
+
   /* Execute hook. */
-  if (route_map_master.add_hook)
+  if (route_map_hook_deferred)
+    map->add_pending = 1;
+  else if (route_map_master.add_hook)
     (*route_map_master.add_hook) (name);
 
   return map;
@@ -135,6 +213,10 @@ route_map_delete (struct route_map *map)
   else
     list->head = map->next;
 
+  hash_release (list->hash, map);
+  list->version++;
+
+  route_map_dispatch_free (map->dispatch);
   XFREE (MTYPE_ROUTE_MAP, map);
 
   /* Execute deletion hook. */
@@ -150,12 +232,11 @@ route_map_delete (struct route_map *map)
 struct route_map *
 route_map_lookup_by_name (const char *name)
 {
-  struct route_map *map;
 
-  for (map = route_map_master.head; map; map = map->next)
-    if (strcmp (map->name, name) == 0)
-      return map;
-  return NULL;
+  if (! route_map_master.hash)
+    return NULL;
+
+  return hash_lookup_name (route_map_master.hash, name);
 }
 
 /* Lookup route map.  If there isn't route map create one and return
@@ -318,10 +399,11 @@ route_map_index_delete (struct route_map_index *index, int notify)
   if (index->nextrm)
     XFREE (MTYPE_ROUTE_MAP_NAME, index->nextrm);
 
+  route_map_master.version++;
+
     /* Execute event hook. */
-  if (route_map_master.event_hook && notify)
-    (*route_map_master.event_hook) (RMAP_EVENT_INDEX_DELETED,
-				    index->map->name);
+  if (notify)
+    route_map_event (index->map, RMAP_EVENT_INDEX_DELETED);
 
   XFREE (MTYPE_ROUTE_MAP_INDEX, index);
 }
@@ -384,10 +466,10 @@ route_map_index_add (struct route_map *map, enum route_map_type type,
       point->prev = index;
     }
 
+  route_map_master.version++;
+
   /* Execute event hook. */
-  if (route_map_master.event_hook)
-    (*route_map_master.event_hook) (RMAP_EVENT_INDEX_ADDED,
-				    map->name);
+  route_map_event (map, RMAP_EVENT_INDEX_ADDED);
 
   return index;
 }
@@ -475,6 +557,8 @@ route_map_rule_add (struct route_map_rule_list *list,
   else
     list->head = rule;
   list->tail = rule;
+
+  route_map_master.version++;
 }
 
 /* Delete rule from rule list. */
@@ -498,6 +582,7 @@ route_map_rule_delete (struct route_map_rule_list *list,
     list->head = rule->next;
 
   XFREE (MTYPE_ROUTE_MAP_RULE, rule);
+  route_map_master.version++;
 }
 
 /* strcmp wrapper function which don't crush even argument is NULL. */
@@ -571,11 +656,8 @@ route_map_add_match (struct route_map_index *index, const char *match_name,
   route_map_rule_add (&index->match_list, rule);
 
   /* Execute event hook. */
-  if (route_map_master.event_hook)
-    (*route_map_master.event_hook) (replaced ?
-				    RMAP_EVENT_MATCH_REPLACED:
-				    RMAP_EVENT_MATCH_ADDED,
-				    index->map->name);
+  route_map_event (index->map, replaced ?
+		   RMAP_EVENT_MATCH_REPLACED : RMAP_EVENT_MATCH_ADDED);
 
   return 0;
 }
@@ -598,9 +680,7 @@ route_map_delete_match (struct route_map_index *index, const char *match_name,
       {
 	route_map_rule_delete (&index->match_list, rule);
 	/* Execute event hook. */
-	if (route_map_master.event_hook)
-	  (*route_map_master.event_hook) (RMAP_EVENT_MATCH_DELETED,
-					  index->map->name);
+	route_map_event (index->map, RMAP_EVENT_MATCH_DELETED);
 	return 0;
       }
   /* Can't find matched rule. */
@@ -658,11 +738,8 @@ route_map_add_set (struct route_map_index *index, const char *set_name,
   route_map_rule_add (&index->set_list, rule);
 
   /* Execute event hook. */
-  if (route_map_master.event_hook)
-    (*route_map_master.event_hook) (replaced ?
-				    RMAP_EVENT_SET_REPLACED:
-				    RMAP_EVENT_SET_ADDED,
-				    index->map->name);
+  route_map_event (index->map, replaced ?
+		   RMAP_EVENT_SET_REPLACED : RMAP_EVENT_SET_ADDED);
   return 0;
 }
 
@@ -684,9 +761,7 @@ route_map_delete_set (struct route_map_index *index, const char *set_name,
       {
         route_map_rule_delete (&index->set_list, rule);
 	/* Execute event hook. */
-	if (route_map_master.event_hook)
-	  (*route_map_master.event_hook) (RMAP_EVENT_SET_DELETED,
-					  index->map->name);
+	route_map_event (index->map, RMAP_EVENT_SET_DELETED);
         return 0;
       }
   /* Can't find matched rule. */
@@ -769,6 +844,200 @@ route_map_apply_match (struct route_map_rule_list *match_list,
   return ret;
 }
 
+static void
+route_map_dispatch_trie_free (struct route_table *trie)
+{
+  struct route_node *rn;
+  struct route_map_dispatch_entry *entry;
+  struct route_map_dispatch_entry *next;
+
+  if (! trie)
+    return;
+
+  for (rn = route_top (trie); rn; rn = route_next (rn))
+    for (entry = rn->info; entry; entry = next)
+      {
+	next = entry->next;
+	XFREE (MTYPE_ROUTE_MAP_DISPATCH, entry);
+      }
+  route_table_finish (trie);
+}
+
+static void
+route_map_dispatch_free (struct route_map_dispatch *d)
+{
+  if (! d)
+    return;
+
+  route_map_dispatch_trie_free (d->trie);
+  XFREE (MTYPE_ROUTE_MAP_DISPATCH, d->index);
+  XFREE (MTYPE_ROUTE_MAP_DISPATCH, d->always);
+  XFREE (MTYPE_ROUTE_MAP_DISPATCH, d->cand);
+  XFREE (MTYPE_ROUTE_MAP_DISPATCH, d);
+}
+
+struct route_map_dispatch_arg
+{
+  struct route_map_dispatch *d;
+  int pos;
+};
+
+/* prefix_list_permit_walk() callback entering an index under p. */
+static void
+route_map_dispatch_enter (struct prefix *p, void *arg)
+{
+  struct route_map_dispatch_arg *da = arg;
+  struct route_map_dispatch *d = da->d;
+  struct route_map_dispatch_entry *entry;
+  struct route_node *rn;
+
+  rn = route_node_get (d->trie, p);
+  if (rn->info)
+    {
+      route_unlock_node (rn);
+      /* An index may have entries with the same prefix. */
+      if (((struct route_map_dispatch_entry *) rn->info)->pos == da->pos)
+	return;
+    }
+
+  entry = XMALLOC (MTYPE_ROUTE_MAP_DISPATCH,
+		   sizeof (struct route_map_dispatch_entry));
+  entry->pos = da->pos;
+  entry->next = rn->info;
+  rn->info = entry;
+}
+
+static struct route_map_dispatch *
+route_map_dispatch_build (struct route_map *map)
+{
+  struct route_map_dispatch *d;
+  struct route_map_dispatch_arg da;
+  struct route_map_index *index;
+  struct route_map_rule *match;
+  struct prefix_list *plist = NULL;
+  int entered = 0;
+  int pos;
+
+  d = XCALLOC (MTYPE_ROUTE_MAP_DISPATCH, sizeof (struct route_map_dispatch));
+  d->version = route_map_master.version;
+  d->plist_version = prefix_list_version ();
+
+  for (index = map->head; index; index = index->next)
+    d->count++;
+  d->words = (d->count + 31) / 32;
+  d->index = XCALLOC (MTYPE_ROUTE_MAP_DISPATCH,
+		      sizeof (struct route_map_index *) * (d->count + 1));
+  d->always = XCALLOC (MTYPE_ROUTE_MAP_DISPATCH,
+		       sizeof (u_int32_t) * (d->words + 1));
+  d->cand = XCALLOC (MTYPE_ROUTE_MAP_DISPATCH,
+		     sizeof (u_int32_t) * (d->words + 1));
+  d->trie = route_table_init ();
+
+  da.d = d;
+  for (pos = 0, index = map->head; index; pos++, index = index->next)
+    {
+      d->index[pos] = index;
+
+      /* The first rule with a non-empty list, or none, is enough to
+         narrow the index down. */
+      for (match = index->match_list.head; match; match = match->next)
+	if (match->cmd->func_prefix_list)
+	  {
+	    plist = (*match->cmd->func_prefix_list) (match->value);
+	    if (plist == NULL || plist->count != 0 || plist->set != NULL)
+	      break;
+	  }
+
+      if (! match)
+	{
+	  d->always[pos / 32] |= 1U << (pos % 32);
+	  continue;
+	}
+
+      /* With no list, or no permit entry, the index is never entered
+         and never a candidate. */
+      entered++;
+      if (plist)
+	{
+	  da.pos = pos;
+	  prefix_list_permit_walk (plist, route_map_dispatch_enter, &da);
+	}
+    }
+
+  /* Nothing to skip, so route_map_apply() just walks the indexes. */
+  if (! entered)
+    d->count = 0;
+
+  return d;
+}
+
+/* The dispatch of map with the candidates for prefix marked in cand,
+   or NULL if every index has to be looked at. */
+static struct route_map_dispatch *
+route_map_dispatch_get (struct route_map *map, struct prefix *prefix)
+{
+  struct route_map_dispatch *d = map->dispatch;
+  struct route_map_dispatch_entry *entry;
+  struct route_node *top;
+  struct route_node *rn;
+
+  if (d && (d->version != route_map_master.version
+	    || d->plist_version != prefix_list_version ()))
+    {
+      if (d->busy)
+	return NULL;
+      route_map_dispatch_free (d);
+      d = map->dispatch = NULL;
+    }
+  if (! d)
+    d = map->dispatch = route_map_dispatch_build (map);
+
+  if (d->count == 0 || d->busy)
+    return NULL;
+
+  memcpy (d->cand, d->always, sizeof (u_int32_t) * d->words);
+
+  if ((top = route_node_match (d->trie, prefix)) != NULL)
+    {
+      for (rn = top; rn; rn = rn->parent)
+	for (entry = rn->info; entry; entry = entry->next)
+	  d->cand[entry->pos / 32] |= 1U << (entry->pos % 32);
+      route_unlock_node (top);
+    }
+
+  return d;
+}
+
+/* The first candidate index at or after pos, with pos updated. */
+static struct route_map_index *
+route_map_dispatch_next (struct route_map_dispatch *d, int *pos)
+{
+  int word = *pos / 32;
+  u_int32_t bits;
+
+  if (*pos >= d->count)
+    return NULL;
+
+  bits = d->cand[word] & (~0U << (*pos % 32));
+  while (! bits)
+    {
+      if (++word >= d->words)
+	{
+	  *pos = d->count;
+	  return NULL;
+	}
+      bits = d->cand[word];
+    }
+
+  *pos = word * 32;
+  while (! (bits & 1))
+    {
+      bits >>= 1;
+      (*pos)++;
+    }
+  return d->index[*pos];
+}
+
 /* Apply route map to the object. */
 route_map_result_t
 route_map_apply (struct route_map *map, struct prefix *prefix,
@@ -778,6 +1047,8 @@ route_map_apply (struct route_map *map, struct prefix *prefix,
   int ret = 0;
   struct route_map_index *index;
   struct route_map_rule *set;
+  struct route_map_dispatch *d;
+  int pos;
 
   if (recursion > RMAP_RECURSION_LIMIT)
     {
@@ -791,7 +1062,20 @@ route_map_apply (struct route_map *map, struct prefix *prefix,
   if (map == NULL)
     return RMAP_DENYMATCH;
 
-  for (index = map->head; index; index = index->next)
+  /* Only the candidate indexes for the prefix, if known, are looked at:
+     the others would not match. */
+  d = route_map_dispatch_get (map, prefix);
+  pos = 0;
+  if (d)
+    {
+      d->busy = 1;
+      index = route_map_dispatch_next (d, &pos);
+    }
+  else
+    index = map->head;
+
+  for (; index; index = d ? (pos++, route_map_dispatch_next (d, &pos))
+			  : index->next)
     {
       /* Apply this index. */
       ret = route_map_apply_match (&index->match_list, prefix, type, object);
@@ -825,13 +1109,13 @@ route_map_apply (struct route_map *map, struct prefix *prefix,
 
                   /* If nextrm returned 'deny', finish. */
                   if (ret == RMAP_DENYMATCH)
-                    return ret;
+                    goto done;
                 }
                 
               switch (index->exitpolicy)
                 {
                   case RMAP_EXIT:
-                    return ret;
+                    goto done;
                   case RMAP_NEXT:
                     continue;
                   case RMAP_GOTO:
@@ -844,11 +1128,12 @@ route_map_apply (struct route_map *map, struct prefix *prefix,
                         {
                           index = next;
                           next = next->next;
+                          pos++;
                         }
                       if (next == NULL)
                         {
                           /* No clauses match! */
-                          return ret;
+                          goto done;
                         }
                     }
                 }
@@ -856,12 +1141,65 @@ route_map_apply (struct route_map *map, struct prefix *prefix,
           else if (index->type == RMAP_DENY)
             /* 'deny' */
             {
-                return RMAP_DENYMATCH;
+              ret = RMAP_DENYMATCH;
+              goto done;
             }
         }
     }
   /* Finally route-map does not match at all. */
-  return RMAP_DENYMATCH;
+  ret = RMAP_DENYMATCH;
+
+ done:
+  if (d)
+    d->busy = 0;
+  return ret;
+}
+
+/* Version of the route maps, which changes whenever any of them do,
+   for callers keeping results of route_map_apply(). */
+unsigned long
+route_map_version (void)
+{
+  return route_map_master.version;
+}
+
+static int
+route_map_check_rules_depth (struct route_map *map,
+			     int (*check) (struct route_map_rule_cmd *, void *),
+			     int depth)
+{
+  struct route_map_index *index;
+  struct route_map_rule *rule;
+  struct route_map *nextrm;
+
+  if (depth > RMAP_RECURSION_LIMIT)
+    return 0;
+
+  for (index = map->head; index; index = index->next)
+    {
+      for (rule = index->match_list.head; rule; rule = rule->next)
+	if (! (*check) (rule->cmd, rule->value))
+	  return 0;
+      for (rule = index->set_list.head; rule; rule = rule->next)
+	if (! (*check) (rule->cmd, rule->value))
+	  return 0;
+
+      if (index->nextrm
+	  && (nextrm = route_map_lookup_by_name (index->nextrm)) != NULL
+	  && ! route_map_check_rules_depth (nextrm, check, depth + 1))
+	return 0;
+    }
+  return 1;
+}
+
+/* Whether check passes for every match and set rule of the route map,
+   and of the route maps it calls, given the rule's command and its
+   compiled value. */
+int
+route_map_check_rules (struct route_map *map,
+		       int (*check) (struct route_map_rule_cmd *, void *))
+{
+  return route_map_check_rules_depth (map, check, 0);
 }
 
 void
@@ -882,6 +1220,35 @@ route_map_event_hook (void (*func) (route_map_event_t, const char *))
   route_map_master.event_hook = func;
 }
 
+/* While deferred, route map additions and changes are only recorded
+   on the route map; switching deferral off runs the add hook and the
+   last event once for each route map that changed.  Delete hooks are
+   never deferred. */
+void
+route_map_hook_defer (int defer)
+{
+  struct route_map *map;
+
+  route_map_hook_deferred = defer;
+  if (defer)
+    return;
+
+  for (map = route_map_master.head; map; map = map->next)
+    {
+      if (map->add_pending)
+	{
+	  map->add_pending = 0;
+	  if (route_map_master.add_hook)
+	    (*route_map_master.add_hook) (map->name);
+	}
+      if (map->event_pending)
+	{
+	  map->event_pending = 0;
+	  route_map_event (map, map->pending_event);
+	}
+    }
+}
+
 void
 route_map_init (void)
 {
@@ -897,6 +1264,13 @@ route_map_finish (void)
   route_match_vec = NULL;
   vector_free (route_set_vec);
   route_set_vec = NULL;
+
+  if (route_map_master.hash)
+    {
+      hash_clean (route_map_master.hash, NULL);
+      hash_free (route_map_master.hash);
+      route_map_master.hash = NULL;
+    }
 }
 
 /* VTY related functions. */
@@ -1052,6 +1426,7 @@ DEFUN (rmap_onmatch_next,
 
   if (index)
     index->exitpolicy = RMAP_NEXT;
+  route_map_master.version++;
 
   return CMD_SUCCESS;
 }
@@ -1069,6 +1444,7 @@ DEFUN (no_rmap_onmatch_next,
   
   if (index)
     index->exitpolicy = RMAP_EXIT;
+  route_map_master.version++;
 
   return CMD_SUCCESS;
 }
@@ -1101,6 +1477,7 @@ DEFUN (rmap_onmatch_goto,
 	{
 	  index->exitpolicy = RMAP_GOTO;
 	  index->nextpref = d;
+	  route_map_master.version++;
 	}
     }
   return CMD_SUCCESS;
@@ -1119,6 +1496,7 @@ DEFUN (no_rmap_onmatch_goto,
 
   if (index)
     index->exitpolicy = RMAP_EXIT;
+  route_map_master.version++;
   
   return CMD_SUCCESS;
 }
@@ -1182,6 +1560,7 @@ DEFUN (rmap_call,
       if (index->nextrm)
           XFREE (MTYPE_ROUTE_MAP_NAME, index->nextrm);
       index->nextrm = XSTRDUP (MTYPE_ROUTE_MAP_NAME, argv[0]);
+      route_map_master.version++;
     }
   return CMD_SUCCESS;
 }
@@ -1200,6 +1579,7 @@ DEFUN (no_rmap_call,
     {
       XFREE (MTYPE_ROUTE_MAP_NAME, index->nextrm);
       index->nextrm = NULL;
+      route_map_master.version++;
     }
 
   return CMD_SUCCESS;
@@ -72,6 +72,9 @@ typedef enum
 /* Depth limit in RMAP recursion using RMAP_CALL. */
 #define RMAP_RECURSION_LIMIT      10
 
+struct prefix_list;
+struct route_map_dispatch;
+
 /* Route map rule structure for matching and setting. */
 struct route_map_rule_cmd
 {
@@ -87,6 +90,12 @@ struct route_map_rule_cmd
 
   /* Free allocated value by func_compile (). */
   void (*func_free)(void *);
+
+  /* Optional, for match rules which only match a prefix permitted by a
+     prefix-list: the list for the compiled value, or NULL if there is
+     none, in which case the rule never matches.  Lets route_map_apply()
+     skip indexes which cannot match a prefix. */
+  struct prefix_list *(*func_prefix_list)(void *);
 };
 
 /* Route map apply error. */
@@ -149,6 +158,14 @@ struct route_map
   /* Make linked list. */
   struct route_map *next;
   struct route_map *prev;
+
+  /* Hooks held back by route_map_hook_defer(), and the last event. */
+  int add_pending;
+  int event_pending;
+  route_map_event_t pending_event;
+
+  /* Candidate indexes by prefix, built by route_map_apply(). */
+  struct route_map_dispatch *dispatch;
 };
 
 /* Prototypes. */
@@ -191,8 +208,14 @@ extern route_map_result_t route_map_apply (struct route_map *map,
                                            route_map_object_t object_type,
                                            void *object);
 
+extern unsigned long route_map_version (void);
+extern int route_map_check_rules (struct route_map *,
+				  int (*check) (struct route_map_rule_cmd *,
+						void *));
+
 extern void route_map_add_hook (void (*func) (const char *));
 extern void route_map_delete_hook (void (*func) (const char *));
 extern void route_map_event_hook (void (*func) (route_map_event_t, const char *));
+extern void route_map_hook_defer (int);
 
 #endif /* _ZEBRA_ROUTEMAP_H */
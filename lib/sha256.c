@@ -0,0 +1,199 @@
+/*
+ * SHA-256 and HMAC-SHA-256 (FIPS 180-2, RFC 2104).
+ *
+ * This file is part of GNU Zebra.
+ *
+ * GNU Zebra is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * GNU Zebra is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Zebra; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.  
+ */
+
+#include <zebra.h>
+
+#include "sha256.h"
+
+static const uint32_t K[64] =
+{
+  0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+  0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+  0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+  0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+  0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+  0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+  0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+  0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+  0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+  0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+  0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+  0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+  0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+  0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+  0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+  0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+#define ROTR(x, n)	(((x) >> (n)) | ((x) << (32 - (n))))
+#define CH(x, y, z)	(((x) & (y)) ^ (~(x) & (z)))
+#define MAJ(x, y, z)	(((x) & (y)) ^ ((x) & (z)) ^ ((y) & (z)))
+#define S0(x)		(ROTR (x, 2) ^ ROTR (x, 13) ^ ROTR (x, 22))
+#define S1(x)		(ROTR (x, 6) ^ ROTR (x, 11) ^ ROTR (x, 25))
+#define s0(x)		(ROTR (x, 7) ^ ROTR (x, 18) ^ ((x) >> 3))
+#define s1(x)		(ROTR (x, 17) ^ ROTR (x, 19) ^ ((x) >> 10))
+
+static void
+sha256_transform (uint32_t *state, const uint8_t *block)
+{
+  uint32_t W[64];
+  uint32_t a, b, c, d, e, f, g, h, t1, t2;
+  int i;
+
+  for (i = 0; i < 16; i++)
+    W[i] = ((uint32_t) block[i * 4] << 24) | ((uint32_t) block[i * 4 + 1] << 16)
+	   | ((uint32_t) block[i * 4 + 2] << 8) | (uint32_t) block[i * 4 + 3];
+  for (i = 16; i < 64; i++)
+    W[i] = s1 (W[i - 2]) + W[i - 7] + s0 (W[i - 15]) + W[i - 16];
+
+  a = state[0]; b = state[1]; c = state[2]; d = state[3];
+  e = state[4]; f = state[5]; g = state[6]; h = state[7];
+
+  for (i = 0; i < 64; i++)
+    {
+      t1 = h + S1 (e) + CH (e, f, g) + K[i] + W[i];
+      t2 = S0 (a) + MAJ (a, b, c);
+      h = g; g = f; f = e; e = d + t1;
+      d = c; c = b; b = a; a = t1 + t2;
+    }
+
+  state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+  state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+}
+
+void
+SHA256_Init (SHA256_CTX *ctx)
+{
+  ctx->state[0] = 0x6a09e667;
+  ctx->state[1] = 0xbb67ae85;
+  ctx->state[2] = 0x3c6ef372;
+  ctx->state[3] = 0xa54ff53a;
+  ctx->state[4] = 0x510e527f;
+  ctx->state[5] = 0x9b05688c;
+  ctx->state[6] = 0x1f83d9ab;
+  ctx->state[7] = 0x5be0cd19;
+  ctx->count = 0;
+}
+
+void
+SHA256_Update (SHA256_CTX *ctx, const void *in, size_t len)
+{
+  const uint8_t *src = in;
+  size_t used = ctx->count % SHA256_BLOCK_SIZE;
+  size_t n;
+
+  ctx->count += len;
+
+  /* Finish a partial block first. */
+  if (used)
+    {
+      n = MIN (len, SHA256_BLOCK_SIZE - used);
+      memcpy (ctx->buf + used, src, n);
+      src += n;
+      len -= n;
+      if (used + n < SHA256_BLOCK_SIZE)
+	return;
+      sha256_transform (ctx->state, ctx->buf);
+    }
+
+  /* Whole blocks straight from the input. */
+  for (; len >= SHA256_BLOCK_SIZE; len -= SHA256_BLOCK_SIZE)
+    {
+      sha256_transform (ctx->state, src);
+      src += SHA256_BLOCK_SIZE;
+    }
+
+  memcpy (ctx->buf, src, len);
+}
+
+void
+SHA256_Final (uint8_t *digest, SHA256_CTX *ctx)
+{
+  uint64_t bits = ctx->count << 3;
+  size_t used = ctx->count % SHA256_BLOCK_SIZE;
+  int i;
+
+  /* Pad with 0x80, zeros, then the message length in bits. */
+  ctx->buf[used++] = 0x80;
+  if (used > SHA256_BLOCK_SIZE - 8)
+    {
+      memset (ctx->buf + used, 0, SHA256_BLOCK_SIZE - used);
+      sha256_transform (ctx->state, ctx->buf);
+      used = 0;
+    }
+  memset (ctx->buf + used, 0, SHA256_BLOCK_SIZE - 8 - used);
+  for (i = 0; i < 8; i++)
+    ctx->buf[SHA256_BLOCK_SIZE - 1 - i] = bits >> (i * 8);
+  sha256_transform (ctx->state, ctx->buf);
+
+  for (i = 0; i < 8; i++)
+    {
+      digest[i * 4] = ctx->state[i] >> 24;
+      digest[i * 4 + 1] = ctx->state[i] >> 16;
+      digest[i * 4 + 2] = ctx->state[i] >> 8;
+      digest[i * 4 + 3] = ctx->state[i];
+    }
+  memset (ctx, 0, sizeof (SHA256_CTX));
+}
+
+/* Key both hash states.  Keys longer than a block are hashed first. */
+void
+HMAC_SHA256_Init (HMAC_SHA256_CTX *ctx, const void *key, size_t len)
+{
+  uint8_t pad[SHA256_BLOCK_SIZE];
+  uint8_t khash[SHA256_DIGEST_SIZE];
+  size_t i;
+
+  if (len > SHA256_BLOCK_SIZE)
+    {
+      SHA256_Init (&ctx->ictx);
+      SHA256_Update (&ctx->ictx, key, len);
+      SHA256_Final (khash, &ctx->ictx);
+      key = khash;
+      len = SHA256_DIGEST_SIZE;
+    }
+
+  memset (pad, 0x36, sizeof (pad));
+  for (i = 0; i < len; i++)
+    pad[i] ^= ((const uint8_t *) key)[i];
+  SHA256_Init (&ctx->ictx);
+  SHA256_Update (&ctx->ictx, pad, sizeof (pad));
+
+  memset (pad, 0x5c, sizeof (pad));
+  for (i = 0; i < len; i++)
+    pad[i] ^= ((const uint8_t *) key)[i];
+  SHA256_Init (&ctx->octx);
+  SHA256_Update (&ctx->octx, pad, sizeof (pad));
+
+  memset (pad, 0, sizeof (pad));
+  memset (khash, 0, sizeof (khash));
+}
+
+void
+HMAC_SHA256_Final (uint8_t *digest, HMAC_SHA256_CTX *ctx)
+{
+  uint8_t ihash[SHA256_DIGEST_SIZE];
+
+  SHA256_Final (ihash, &ctx->ictx);
+  SHA256_Update (&ctx->octx, ihash, sizeof (ihash));
+  SHA256_Final (digest, &ctx->octx);
+  memset (ihash, 0, sizeof (ihash));
+}
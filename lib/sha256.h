@@ -0,0 +1,51 @@
+/*
+ * SHA-256 and HMAC-SHA-256 (FIPS 180-2, RFC 2104).
+ *
+ * This file is part of GNU Zebra.
+ *
+ * GNU Zebra is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * GNU Zebra is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Zebra; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.  
+ */
+
+#ifndef _ZEBRA_SHA256_H
+#define _ZEBRA_SHA256_H
+
+#define SHA256_BLOCK_SIZE	64
+#define SHA256_DIGEST_SIZE	32
+
+typedef struct
+{
+  uint32_t state[8];
+  uint64_t count;
+  uint8_t buf[SHA256_BLOCK_SIZE];
+} SHA256_CTX;
+
+/* An HMAC key, with the inner and outer hash states already keyed.  Copy
+   it for each message rather than keying again. */
+typedef struct
+{
+  SHA256_CTX ictx;
+  SHA256_CTX octx;
+} HMAC_SHA256_CTX;
+
+extern void SHA256_Init (SHA256_CTX *);
+extern void SHA256_Update (SHA256_CTX *, const void *, size_t);
+extern void SHA256_Final (uint8_t *, SHA256_CTX *);
+
+extern void HMAC_SHA256_Init (HMAC_SHA256_CTX *, const void *, size_t);
+#define HMAC_SHA256_Update(x, y, z) SHA256_Update (&(x)->ictx, (y), (z))
+extern void HMAC_SHA256_Final (uint8_t *, HMAC_SHA256_CTX *);
+
+#endif /* _ZEBRA_SHA256_H */
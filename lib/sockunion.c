@@ -496,6 +496,45 @@ sockopt_cork (int sock, int onoff)
 #endif
 }
 
+/* Have the socket writable only while fewer than bytes of what was
+   written to it are not yet sent, 0 to lift the mark. */
+int
+sockopt_notsent_lowat (int sock, int bytes)
+{
+#ifdef TCP_NOTSENT_LOWAT
+  int ret;
+
+  if (bytes == 0)
+    bytes = INT_MAX;
+  ret = setsockopt (sock, IPPROTO_TCP, TCP_NOTSENT_LOWAT, &bytes,
+		    sizeof (bytes));
+  if (ret < 0)
+    zlog (NULL, LOG_WARNING,
+	  "can't set sockopt TCP_NOTSENT_LOWAT to %d on socket %d: %s",
+	  bytes, sock, safe_strerror (errno));
+  return ret;
+#else
+  errno = EOPNOTSUPP;
+  return -1;
+#endif /* TCP_NOTSENT_LOWAT */
+}
+
+/* The not sent low water mark of the socket, -1 if it has none. */
+int
+getsockopt_notsent_lowat (int sock)
+{
+#ifdef TCP_NOTSENT_LOWAT
+  int bytes;
+  socklen_t len = sizeof (bytes);
+
+  if (getsockopt (sock, IPPROTO_TCP, TCP_NOTSENT_LOWAT, &bytes, &len) < 0)
+    return -1;
+  return bytes;
+#else
+  return -1;
+#endif /* TCP_NOTSENT_LOWAT */
+}
+
 int
 sockopt_minttl (int family, int sock, int minttl)
 {
@@ -552,7 +591,7 @@ sockopt_v6only (int family, int sock)
 
 /* If same family and same prefix return 1. */
 int
-sockunion_same (union sockunion *su1, union sockunion *su2)
+sockunion_same (const union sockunion *su1, const union sockunion *su2)
 {
   int ret = 0;
 
@@ -562,13 +601,12 @@ sockunion_same (union sockunion *su1, union sockunion *su2)
   switch (su1->sa.sa_family)
     {
     case AF_INET:
-      ret = memcmp (&su1->sin.sin_addr, &su2->sin.sin_addr,
-		    sizeof (struct in_addr));
+      ret = (su1->sin.sin_addr.s_addr != su2->sin.sin_addr.s_addr);
       break;
 #ifdef HAVE_IPV6
     case AF_INET6:
-      ret = memcmp (&su1->sin6.sin6_addr, &su2->sin6.sin6_addr,
-		    sizeof (struct in6_addr));
+      ret = ! prefix_match_ipv6 (&su1->sin6.sin6_addr, &su2->sin6.sin6_addr,
+				 IPV6_MAX_BITLEN);
       break;
 #endif /* HAVE_IPV6 */
     }
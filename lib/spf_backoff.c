@@ -0,0 +1,118 @@
+/*
+ * SPF back-off state machine (RFC 8405).
+ *
+ * This file is part of GNU Zebra.
+ *
+ * GNU Zebra is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * GNU Zebra is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Zebra; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.  
+ */
+
+#include <zebra.h>
+
+#include "memory.h"
+#include "thread.h"
+#include "spf_backoff.h"
+
+struct spf_backoff *
+spf_backoff_new (unsigned int init_delay, unsigned int short_delay,
+                 unsigned int long_delay, unsigned int holddown,
+                 unsigned int time_to_learn)
+{
+  struct spf_backoff *backoff;
+
+  backoff = XCALLOC (MTYPE_SPF_BACKOFF, sizeof (struct spf_backoff));
+  backoff->init_delay = init_delay;
+  backoff->short_delay = short_delay;
+  backoff->long_delay = long_delay;
+  backoff->holddown = holddown;
+  backoff->time_to_learn = time_to_learn;
+  backoff->state = SPF_BACKOFF_QUIET;
+  return backoff;
+}
+
+void
+spf_backoff_free (struct spf_backoff *backoff)
+{
+  XFREE (MTYPE_SPF_BACKOFF, backoff);
+}
+
+static long
+spf_backoff_elapsed (struct timeval *now, struct timeval *then)
+{
+  return (now->tv_sec - then->tv_sec) * 1000L
+         + (now->tv_usec - then->tv_usec) / 1000L;
+}
+
+/* The state once the timers that would have run since the last event
+   fired: HOLDDOWN, restarted on every event, back to QUIET, and
+   TIME_TO_LEARN, started on leaving QUIET, on to LONG_WAIT. */
+static enum spf_backoff_state
+spf_backoff_current (struct spf_backoff *backoff, struct timeval *now)
+{
+  if (backoff->state == SPF_BACKOFF_QUIET)
+    return SPF_BACKOFF_QUIET;
+  if (spf_backoff_elapsed (now, &backoff->last_event) >= backoff->holddown)
+    return SPF_BACKOFF_QUIET;
+  if (backoff->state == SPF_BACKOFF_SHORT_WAIT
+      && spf_backoff_elapsed (now, &backoff->first_event)
+         >= backoff->time_to_learn)
+    return SPF_BACKOFF_LONG_WAIT;
+  return backoff->state;
+}
+
+unsigned int
+spf_backoff_event (struct spf_backoff *backoff)
+{
+  struct timeval now;
+  unsigned int delay;
+
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &now);
+
+  backoff->state = spf_backoff_current (backoff, &now);
+  switch (backoff->state)
+    {
+    case SPF_BACKOFF_QUIET:
+      backoff->state = SPF_BACKOFF_SHORT_WAIT;
+      backoff->first_event = now;
+      delay = backoff->init_delay;
+      break;
+    case SPF_BACKOFF_SHORT_WAIT:
+      delay = backoff->short_delay;
+      break;
+    default:
+      delay = backoff->long_delay;
+      break;
+    }
+  backoff->last_event = now;
+
+  return delay;
+}
+
+const char *
+spf_backoff_state_str (struct spf_backoff *backoff)
+{
+  struct timeval now;
+
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &now);
+  switch (spf_backoff_current (backoff, &now))
+    {
+    case SPF_BACKOFF_QUIET:
+      return "QUIET";
+    case SPF_BACKOFF_SHORT_WAIT:
+      return "SHORT_WAIT";
+    default:
+      return "LONG_WAIT";
+    }
+}
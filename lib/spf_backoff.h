@@ -0,0 +1,68 @@
+/*
+ * SPF back-off state machine (RFC 8405).
+ *
+ * This file is part of GNU Zebra.
+ *
+ * GNU Zebra is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * GNU Zebra is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Zebra; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.  
+ */
+
+#ifndef _ZEBRA_SPF_BACKOFF_H
+#define _ZEBRA_SPF_BACKOFF_H
+
+/* After a quiet period, the first IGP event is answered after
+   init_delay, those within time_to_learn of it after short_delay, and
+   later ones after long_delay, until no event was seen for holddown.
+   All times are in milliseconds. */
+enum spf_backoff_state
+{
+  SPF_BACKOFF_QUIET,
+  SPF_BACKOFF_SHORT_WAIT,
+  SPF_BACKOFF_LONG_WAIT,
+};
+
+struct spf_backoff
+{
+  unsigned int init_delay;
+  unsigned int short_delay;
+  unsigned int long_delay;
+  unsigned int holddown;
+  unsigned int time_to_learn;
+
+  enum spf_backoff_state state;
+  struct timeval first_event;	/* left QUIET */
+  struct timeval last_event;
+};
+
+#define SPF_BACKOFF_INIT_DELAY_DEFAULT        50
+#define SPF_BACKOFF_SHORT_DELAY_DEFAULT      200
+#define SPF_BACKOFF_LONG_DELAY_DEFAULT      5000
+#define SPF_BACKOFF_HOLDDOWN_DEFAULT       10000
+#define SPF_BACKOFF_TIME_TO_LEARN_DEFAULT    500
+
+extern struct spf_backoff *spf_backoff_new (unsigned int init_delay,
+                                            unsigned int short_delay,
+                                            unsigned int long_delay,
+                                            unsigned int holddown,
+                                            unsigned int time_to_learn);
+extern void spf_backoff_free (struct spf_backoff *);
+
+/* Account an IGP event, and return the delay after which SPF should
+   run, if it is not scheduled already. */
+extern unsigned int spf_backoff_event (struct spf_backoff *);
+
+extern const char *spf_backoff_state_str (struct spf_backoff *);
+
+#endif /* _ZEBRA_SPF_BACKOFF_H */
@@ -111,6 +111,7 @@ stream_new (size_t size)
     }
   
   s->size = size;
+  s->refcnt = 1;
   return s;
 }
 
@@ -121,6 +122,17 @@ stream_free (struct stream *s)
   if (!s)
     return;
   
+  if (s->origin)
+    {
+      struct stream *origin = s->origin;
+
+      XFREE (MTYPE_STREAM, s);
+      s = origin;
+    }
+
+  if (--s->refcnt > 0)
+    return;
+
   XFREE (MTYPE_STREAM_DATA, s->data);
   XFREE (MTYPE_STREAM, s);
 }
@@ -154,11 +166,46 @@ stream_dup (struct stream *s)
   return (stream_copy (new, s));
 }
 
+/* Read-only stream sharing the data segment of s. */
+struct stream *
+stream_clone (struct stream *s)
+{
+  struct stream *new;
+
+  STREAM_VERIFY_SANE (s);
+
+  new = XCALLOC (MTYPE_STREAM, sizeof (struct stream));
+  new->origin = s->origin ? s->origin : s;
+  new->origin->refcnt++;
+
+  new->data = s->data;
+  new->size = s->endp;
+  new->endp = s->endp;
+  new->getp = s->getp;
+
+  return new;
+}
+
+/* Point clone at size bytes of the shared data segment, starting at from
+   in it, and rewind its getp. */
+void
+stream_clone_set (struct stream *clone, size_t from, size_t size)
+{
+  STREAM_VERIFY_SANE (clone);
+  assert (clone->origin);
+  assert (from + size <= clone->origin->size);
+
+  clone->data = clone->origin->data + from;
+  clone->size = clone->endp = size;
+  clone->getp = 0;
+}
+
 size_t
 stream_resize (struct stream *s, size_t newsize)
 {
   u_char *newdata;
   STREAM_VERIFY_SANE (s);
+  assert (s->origin == NULL && s->refcnt == 1);
   
   newdata = XREALLOC (MTYPE_STREAM_DATA, s->data, newsize);
   
@@ -906,6 +953,23 @@ stream_reset (struct stream *s)
   s->getp = s->endp = 0;
 }
 
+/* Move the readable data in s to its start, making room for more. */
+void
+stream_pulldown (struct stream *s)
+{
+  size_t len;
+
+  STREAM_VERIFY_SANE (s);
+
+  if (s->getp == 0)
+    return;
+
+  len = STREAM_READABLE (s);
+  memmove (s->data, s->data + s->getp, len);
+  s->getp = 0;
+  s->endp = len;
+}
+
 /* Write stream contens to the file discriptor. */
 int
 stream_flush (struct stream *s, int fd)
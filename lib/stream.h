@@ -89,6 +89,14 @@
  *
  * Best practice is to use stream_put (<stream *>, NULL, <size>) to zero out
  * any part of a stream which isn't otherwise written to.
+ *
+ * stream_clone() returns a stream which shares the data segment of its
+ * source rather than copying it, with its own getp and endp.  The data
+ * segment is freed with the last stream sharing it.  A stream must not be
+ * resized while it is shared, and anything written to it shows through
+ * its clones.  Clones are read-only: their size is their endp, so any put
+ * will fail its bounds check.  stream_clone_set() points a clone at a
+ * different part of the shared segment.
  */
 
 /* Stream buffer. */
@@ -104,6 +112,9 @@ struct stream
   size_t endp;		/* last valid data position */
   size_t size;		/* size of data segment */
   unsigned char *data; /* data pointer */
+
+  struct stream *origin; /* owner of a data segment shared by stream_clone */
+  unsigned int refcnt;	/* streams using this one's data segment */
 };
 
 /* First in first out queue structure. */
@@ -139,6 +150,8 @@ extern struct stream *stream_new (size_t);
 extern void stream_free (struct stream *);
 extern struct stream * stream_copy (struct stream *, struct stream *src);
 extern struct stream *stream_dup (struct stream *);
+extern struct stream *stream_clone (struct stream *);
+extern void stream_clone_set (struct stream *, size_t from, size_t size);
 extern size_t stream_resize (struct stream *, size_t);
 extern size_t stream_get_getp (struct stream *);
 extern size_t stream_get_endp (struct stream *);
@@ -205,6 +218,7 @@ extern size_t stream_write (struct stream *, const void *, size_t);
 
 /* reset the stream. See Note above */
 extern void stream_reset (struct stream *);
+extern void stream_pulldown (struct stream *);
 extern int stream_flush (struct stream *, int);
 extern int stream_empty (struct stream *); /* is the stream empty? */
 
@@ -219,4 +233,70 @@ extern struct stream *stream_fifo_head (struct stream_fifo *fifo);
 extern void stream_fifo_clean (struct stream_fifo *fifo);
 extern void stream_fifo_free (struct stream_fifo *fifo);
 
+/*
+ * Validated reads.
+ *
+ * stream_getc() and friends check the bounds of the stream for every
+ * field, and fail with an assertion.  A parser which knows how many
+ * bytes it is about to decode checks once that they are there with
+ * stream_window(), which is 0 if fewer than len bytes are left to read,
+ * and then decodes up to len bytes with the inline stream_w*()
+ * accessors below, which do no checking at all.  Reading past a window
+ * not checked is as wrong as reading past the end of an array.
+ */
+static inline int
+stream_window (const struct stream *s, size_t len)
+{
+  return STREAM_READABLE (s) >= len;
+}
+
+static inline u_char
+stream_wgetc (struct stream *s)
+{
+  return s->data[s->getp++];
+}
+
+static inline u_int16_t
+stream_wgetw (struct stream *s)
+{
+  const u_char *p = s->data + s->getp;
+
+  s->getp += 2;
+  return (p[0] << 8) | p[1];
+}
+
+static inline u_int32_t
+stream_wgetl (struct stream *s)
+{
+  const u_char *p = s->data + s->getp;
+
+  s->getp += 4;
+  return ((u_int32_t) p[0] << 24) | ((u_int32_t) p[1] << 16)
+	 | ((u_int32_t) p[2] << 8) | p[3];
+}
+
+/* In network byte order, as stream_get_ipv4(). */
+static inline u_int32_t
+stream_wget_ipv4 (struct stream *s)
+{
+  u_int32_t l;
+
+  memcpy (&l, s->data + s->getp, sizeof (l));
+  s->getp += sizeof (l);
+  return l;
+}
+
+static inline void
+stream_wget (void *dst, struct stream *s, size_t size)
+{
+  memcpy (dst, s->data + s->getp, size);
+  s->getp += size;
+}
+
+static inline void
+stream_wforward (struct stream *s, size_t size)
+{
+  s->getp += size;
+}
+
 #endif /* _ZEBRA_STREAM_H */
@@ -29,6 +29,49 @@
 
 static void route_node_delete (struct route_node *);
 static void route_table_free (struct route_table *);
+static void route_index_add (struct route_table *, struct route_node *);
+static void route_index_free (struct route_table *);
+
+/*
+ * Longest-prefix match index.
+ *
+ * The radix tree costs a pointer chase per prefix bit on lookup.  An
+ * indexed table also keeps its nodes in a multibit trie: the first level
+ * is indexed by the first 8 bits of an address, each level below by the
+ * next 4.  Each entry of a level holds the longest node whose prefix ends
+ * within that level and covers the entry, and the level below it, if any.
+ * A lookup takes one entry per level, keeping the last node seen.
+ *
+ * All nodes are indexed, whether or not they carry info, as the table
+ * itself only knows when nodes come and go.  So a lookup ends by walking
+ * up from the node found to the first with info, just as
+ * route_node_match() would have remembered it on its way down.  The nodes
+ * covering an address are all on one path in the tree, so this is exact.
+ */
+#define ROUTE_INDEX_ROOT_STRIDE 8
+#define ROUTE_INDEX_STRIDE 4
+
+struct route_index_level;
+
+struct route_index_entry
+{
+  struct route_node *node;
+  struct route_index_level *child;
+};
+
+struct route_index_level
+{
+  /* Entries with a node or a child. */
+  unsigned int count;
+  struct route_index_entry entry[1];
+};
+
+struct route_table_index
+{
+  u_char family;
+  struct route_node *zero;
+  struct route_index_level *root;
+};
 
 
 /*
@@ -67,6 +110,7 @@ route_node_set (struct route_table *table, struct prefix *prefix)
 
   prefix_copy (&node->p, prefix);
   node->table = table;
+  route_index_add (table, node);
 
   return node;
 }
@@ -129,10 +173,251 @@ route_table_free (struct route_table *rt)
  
   assert (rt->count == 0);
 
+  route_index_free (rt);
   XFREE (MTYPE_ROUTE_TABLE, rt);
   return;
 }
 
+/* Length bits of the prefix bytes at bit offset start, which is either 0
+   or on a stride boundary, so never crossing a byte. */
+static inline unsigned int
+route_index_bits (const u_char *prefix, int start, int length)
+{
+  return (prefix[start / 8] >> (8 - (start % 8) - length))
+	 & ((1 << length) - 1);
+}
+
+static struct route_index_level *
+route_index_level_new (int stride)
+{
+  return XCALLOC (MTYPE_ROUTE_INDEX,
+		  sizeof (struct route_index_level)
+		  + ((1 << stride) - 1) * sizeof (struct route_index_entry));
+}
+
+static void
+route_index_level_free (struct route_index_level *level, int stride)
+{
+  int i;
+
+  for (i = 0; i < (1 << stride); i++)
+    if (level->entry[i].child)
+      route_index_level_free (level->entry[i].child, ROUTE_INDEX_STRIDE);
+  XFREE (MTYPE_ROUTE_INDEX, level);
+}
+
+static void
+route_index_free (struct route_table *table)
+{
+  if (! table->index)
+    return;
+  if (table->index->root)
+    route_index_level_free (table->index->root, ROUTE_INDEX_ROOT_STRIDE);
+  XFREE (MTYPE_ROUTE_INDEX, table->index);
+}
+
+static void
+route_index_add (struct route_table *table, struct route_node *node)
+{
+  struct route_table_index *index = table->index;
+  struct route_index_level *level;
+  struct route_index_entry *e;
+  const u_char *prefix = &node->p.u.prefix;
+  int prefixlen = node->p.prefixlen;
+  int start = 0;
+  int stride = ROUTE_INDEX_ROOT_STRIDE;
+  int rest;
+  unsigned int i, first, last;
+
+  if (! index)
+    return;
+
+  /* The trie is for one address family. */
+  if (! index->family)
+    index->family = node->p.family;
+  if (index->family != node->p.family)
+    {
+      route_index_free (table);
+      return;
+    }
+
+  if (prefixlen == 0)
+    {
+      index->zero = node;
+      return;
+    }
+
+  if (! index->root)
+    index->root = route_index_level_new (ROUTE_INDEX_ROOT_STRIDE);
+  level = index->root;
+
+  while (start + stride < prefixlen)
+    {
+      e = &level->entry[route_index_bits (prefix, start, stride)];
+      if (! e->child)
+	{
+	  if (! e->node)
+	    level->count++;
+	  e->child = route_index_level_new (ROUTE_INDEX_STRIDE);
+	}
+      level = e->child;
+      start += stride;
+      stride = ROUTE_INDEX_STRIDE;
+    }
+
+  /* Expand the prefix over the entries of its last level. */
+  rest = prefixlen - start;
+  first = route_index_bits (prefix, start, rest) << (stride - rest);
+  last = first + (1 << (stride - rest));
+  for (i = first; i < last; i++)
+    {
+      e = &level->entry[i];
+      if (e->node && e->node->p.prefixlen >= prefixlen)
+	continue;
+      if (! e->node && ! e->child)
+	level->count++;
+      e->node = node;
+    }
+}
+
+#define ROUTE_INDEX_DEPTH_MAX \
+  (1 + (IPV6_MAX_BITLEN - ROUTE_INDEX_ROOT_STRIDE) / ROUTE_INDEX_STRIDE)
+
+static void
+route_index_delete (struct route_table *table, struct route_node *node)
+{
+  struct route_table_index *index = table->index;
+  struct route_index_level *path[ROUTE_INDEX_DEPTH_MAX];
+  struct route_index_entry *up[ROUTE_INDEX_DEPTH_MAX];
+  struct route_index_level *level;
+  struct route_index_entry *e;
+  struct route_node *parent;
+  const u_char *prefix = &node->p.u.prefix;
+  int prefixlen = node->p.prefixlen;
+  int start = 0;
+  int stride = ROUTE_INDEX_ROOT_STRIDE;
+  int depth = 0;
+  int rest;
+  unsigned int i, first, last;
+
+  if (! index)
+    return;
+
+  if (prefixlen == 0)
+    {
+      if (index->zero == node)
+	index->zero = NULL;
+      return;
+    }
+
+  level = index->root;
+  path[0] = level;
+  up[0] = NULL;
+  while (level && start + stride < prefixlen)
+    {
+      e = &level->entry[route_index_bits (prefix, start, stride)];
+      level = e->child;
+      start += stride;
+      stride = ROUTE_INDEX_STRIDE;
+      path[++depth] = level;
+      up[depth] = e;
+    }
+  if (! level)
+    return;
+
+  /* The entries fall back to the longest node left covering them, which
+     is the parent, if it ends within this level too. */
+  parent = node->parent;
+  if (parent && parent->p.prefixlen <= start)
+    parent = NULL;
+
+  rest = prefixlen - start;
+  first = route_index_bits (prefix, start, rest) << (stride - rest);
+  last = first + (1 << (stride - rest));
+  for (i = first; i < last; i++)
+    {
+      e = &level->entry[i];
+      if (e->node != node)
+	continue;
+      e->node = parent;
+      if (! parent && ! e->child)
+	level->count--;
+    }
+
+  /* Release levels left empty, except the first. */
+  while (depth > 0 && path[depth]->count == 0)
+    {
+      XFREE (MTYPE_ROUTE_INDEX, path[depth]);
+      e = up[depth--];
+      e->child = NULL;
+      if (! e->node)
+	path[depth]->count--;
+    }
+}
+
+/* Longest indexed node covering p, with info. */
+static struct route_node *
+route_index_match (const struct route_table_index *index,
+		   const struct prefix *p)
+{
+  const struct route_index_level *level = index->root;
+  const struct route_index_entry *e;
+  struct route_node *matched = index->zero;
+  const u_char *prefix = &p->u.prefix;
+  int start = 0;
+  int stride = ROUTE_INDEX_ROOT_STRIDE;
+
+  while (level && start < p->prefixlen)
+    {
+      e = &level->entry[route_index_bits (prefix, start, stride)];
+      if (e->node)
+	matched = e->node;
+      level = e->child;
+      start += stride;
+      stride = ROUTE_INDEX_STRIDE;
+    }
+
+  while (matched && (matched->p.prefixlen > p->prefixlen || ! matched->info))
+    matched = matched->parent;
+
+  return matched;
+}
+
+/*
+ * route_table_enable_index
+ *
+ * Keep a multibit trie index of the table for route_node_match().  The
+ * table must only hold prefixes of one address family.
+ */
+void
+route_table_enable_index (struct route_table *table)
+{
+  struct route_node *node;
+
+  if (table->index)
+    return;
+
+  table->index = XCALLOC (MTYPE_ROUTE_INDEX, sizeof (struct route_table_index));
+
+  /* Index the nodes already there, parents first. */
+  for (node = table->top; node && table->index; )
+    {
+      route_index_add (table, node);
+
+      if (node->l_left)
+	node = node->l_left;
+      else if (node->l_right)
+	node = node->l_right;
+      else
+	{
+	  while (node->parent
+		 && (node->parent->l_right == node || ! node->parent->l_right))
+	    node = node->parent;
+	  node = node->parent ? node->parent->l_right : NULL;
+	}
+    }
+}
+
 /* Utility mask array. */
 static const u_char maskbit[] =
 {
@@ -183,6 +468,145 @@ set_link (struct route_node *node, struct route_node *new)
   new->parent = node;
 }
 
+/*
+ * Family specialised walks.
+ *
+ * prefix_match() and prefix_bit() take the address a byte at a time,
+ * whatever its family.  In a table declared by route_table_set_family()
+ * to hold one family, prefixes of that family are walked to on their
+ * address as a key of host order 64-bit words instead: an IPv4 address
+ * in the top of the first word, an IPv6 one over both.  A node then
+ * costs one masked compare and a shift per level.
+ *
+ * The walks are written once, with the family as an argument, and
+ * inlined with a constant family into the functions below, which pick
+ * the copy for the table.  AF_UNSPEC is the generic byte walk.
+ */
+struct route_key
+{
+  u_int64_t w[2];
+};
+
+#define ROUTE_WALK static inline __attribute__ ((always_inline))
+
+ROUTE_WALK void
+route_key_get (struct route_key *k, const struct prefix *p, int family)
+{
+  u_int32_t a[4];
+
+  if (family == AF_INET)
+    {
+      k->w[0] = (u_int64_t) ntohl (p->u.prefix4.s_addr) << 32;
+      k->w[1] = 0;
+    }
+  else
+    {
+      memcpy (a, &p->u.prefix, sizeof (a));
+      k->w[0] = ((u_int64_t) ntohl (a[0]) << 32) | ntohl (a[1]);
+      k->w[1] = ((u_int64_t) ntohl (a[2]) << 32) | ntohl (a[3]);
+    }
+}
+
+/* The first len bits of a word, 0 < len <= 64. */
+#define ROUTE_KEY_MASK(len) (~(u_int64_t) 0 << (64 - (len)))
+
+/* Does node cover the prefix p, with key k?  The node's prefix length
+   is no longer than p's. */
+ROUTE_WALK int
+route_walk_covers (const struct route_node *node, const struct prefix *p,
+		   const struct route_key *k, int family)
+{
+  struct route_key nk;
+  int len = node->p.prefixlen;
+
+  if (family == AF_UNSPEC)
+    return prefix_match (&node->p, p);
+
+  if (len == 0)
+    return 1;
+  route_key_get (&nk, &node->p, family);
+  if (family == AF_INET || len <= 64)
+    return ((nk.w[0] ^ k->w[0]) & ROUTE_KEY_MASK (len)) == 0;
+  return nk.w[0] == k->w[0]
+	 && ((nk.w[1] ^ k->w[1]) & ROUTE_KEY_MASK (len - 64)) == 0;
+}
+
+/* Bit len of the prefix p, with key k: the link to follow from a node
+   of that length. */
+ROUTE_WALK unsigned int
+route_walk_bit (const struct prefix *p, const struct route_key *k, int len,
+		int family)
+{
+  if (family == AF_UNSPEC)
+    return prefix_bit (&p->u.prefix, len);
+  if (family == AF_INET || len < 64)
+    return (k->w[0] >> (63 - len)) & 1;
+  return (k->w[1] >> (127 - len)) & 1;
+}
+
+/* Walk down towards p.  Returns the node for p, if there is one.  Else
+   *match is the longest node covering p, with info if info_only, and
+   *stop, when given, the node the walk ended on, which p does not
+   cover, or NULL. */
+ROUTE_WALK struct route_node *
+route_walk (const struct route_table *table, const struct prefix *p,
+	    int info_only, struct route_node **match,
+	    struct route_node **stop, int family)
+{
+  struct route_node *node = table->top;
+  struct route_key k;
+
+  if (family != AF_UNSPEC)
+    route_key_get (&k, p, family);
+
+  *match = NULL;
+  while (node && node->p.prefixlen <= p->prefixlen
+	 && route_walk_covers (node, p, &k, family))
+    {
+      if (node->p.prefixlen == p->prefixlen)
+	return node;
+      if (node->info || ! info_only)
+	*match = node;
+      node = node->link[route_walk_bit (p, &k, node->p.prefixlen, family)];
+    }
+
+  if (stop)
+    *stop = node;
+  return NULL;
+}
+
+/* route_walk() with the copy for the table and p. */
+static struct route_node *
+route_walk_table (const struct route_table *table, const struct prefix *p,
+		  int info_only, struct route_node **match,
+		  struct route_node **stop)
+{
+  if (table->family && table->family == p->family)
+    switch (table->family)
+      {
+      case AF_INET:
+	return route_walk (table, p, info_only, match, stop, AF_INET);
+#ifdef HAVE_IPV6
+      case AF_INET6:
+	return route_walk (table, p, info_only, match, stop, AF_INET6);
+#endif /* HAVE_IPV6 */
+      }
+  return route_walk (table, p, info_only, match, stop, AF_UNSPEC);
+}
+
+/*
+ * route_table_set_family
+ *
+ * Declare that the table only holds prefixes of the family, so walks
+ * to them can be specialised for its addresses.  Prefixes of any other
+ * family still work, walked to byte by byte.
+ */
+void
+route_table_set_family (struct route_table *table, u_char family)
+{
+  table->family = family;
+}
+
 /* Lock node. */
 struct route_node *
 route_lock_node (struct route_node *node)
@@ -209,22 +633,17 @@ route_node_match (const struct route_table *table, const struct prefix *p)
   struct route_node *node;
   struct route_node *matched;
 
-  matched = NULL;
-  node = table->top;
+  if (table->index && p->family == table->index->family)
+    {
+      matched = route_index_match (table->index, p);
+      return matched ? route_lock_node (matched) : NULL;
+    }
 
   /* Walk down tree.  If there is matched route then store it to
      matched. */
-  while (node && node->p.prefixlen <= p->prefixlen && 
-	 prefix_match (&node->p, p))
-    {
-      if (node->info)
-	matched = node;
-      
-      if (node->p.prefixlen == p->prefixlen)
-        break;
-      
-      node = node->link[prefix_bit(&p->u.prefix, node->p.prefixlen)];
-    }
+  node = route_walk_table (table, p, 1, &matched, NULL);
+  if (node && node->info)
+    matched = node;
 
   /* If matched route found, return it. */
   if (matched)
@@ -268,19 +687,11 @@ struct route_node *
 route_node_lookup (const struct route_table *table, struct prefix *p)
 {
   struct route_node *node;
-  u_char prefixlen = p->prefixlen;
-  const u_char *prefix = &p->u.prefix;
-
-  node = table->top;
+  struct route_node *match;
 
-  while (node && node->p.prefixlen <= prefixlen &&
-	 prefix_match (&node->p, p))
-    {
-      if (node->p.prefixlen == prefixlen)
-        return node->info ? route_lock_node (node) : NULL;
-
-      node = node->link[prefix_bit(prefix, node->p.prefixlen)];
-    }
+  node = route_walk_table (table, p, 1, &match, NULL);
+  if (node && node->info)
+    return route_lock_node (node);
 
   return NULL;
 }
@@ -292,20 +703,10 @@ route_node_get (struct route_table *const table, struct prefix *p)
   struct route_node *new;
   struct route_node *node;
   struct route_node *match;
-  u_char prefixlen = p->prefixlen;
-  const u_char *prefix = &p->u.prefix;
 
-  match = NULL;
-  node = table->top;
-  while (node && node->p.prefixlen <= prefixlen &&
-	 prefix_match (&node->p, p))
-    {
-      if (node->p.prefixlen == prefixlen)
-        return route_lock_node (node);
-
-      match = node;
-      node = node->link[prefix_bit(prefix, node->p.prefixlen)];
-    }
+  new = route_walk_table (table, p, 0, &match, &node);
+  if (new)
+    return route_lock_node (new);
 
   if (node == NULL)
     {
@@ -322,6 +723,7 @@ route_node_get (struct route_table *const table, struct prefix *p)
       new->p.family = p->family;
       new->table = table;
       set_link (new, node);
+      route_index_add (table, new);
 
       if (match)
 	set_link (match, new);
@@ -362,6 +764,8 @@ route_node_delete (struct route_node *node)
 
   parent = node->parent;
 
+  route_index_delete (node->table, node);
+
   if (child)
     child->parent = parent;
 
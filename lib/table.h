@@ -28,6 +28,7 @@
  */
 struct route_node;
 struct route_table;
+struct route_table_index;
 
 /*
  * route_table_delegate_t
@@ -60,7 +61,20 @@ struct route_table
   route_table_delegate_t *delegate;
   
   unsigned long count;
+
+  /*
+   * Address family of all the prefixes in the table, or 0 if it may
+   * hold several.
+   * @see route_table_set_family
+   */
+  u_char family;
   
+  /*
+   * Optional multibit trie over the nodes, for longest-prefix match.
+   * @see route_table_enable_index
+   */
+  struct route_table_index *index;
+
   /*
    * User data.
    */
@@ -142,6 +156,8 @@ extern struct route_table *
 route_table_init_with_delegate (route_table_delegate_t *);
 
 extern void route_table_finish (struct route_table *);
+extern void route_table_enable_index (struct route_table *);
+extern void route_table_set_family (struct route_table *, u_char);
 extern void route_unlock_node (struct route_node *node);
 extern struct route_node *route_top (struct route_table *);
 extern struct route_node *route_next (struct route_node *);
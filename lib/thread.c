@@ -29,6 +29,10 @@
 #include "hash.h"
 #include "command.h"
 #include "sigevent.h"
+#include "pqueue.h"
+#include "linklist.h"
+#include "network.h"
+#include "trace.h"
 
 #if defined HAVE_SNMP && defined SNMP_AGENTX
 #include <net-snmp/net-snmp-config.h>
@@ -39,11 +43,40 @@
 extern int agentx_enabled;
 #endif
 
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif /* HAVE_PTHREAD */
+
+#if defined(HAVE_SYS_MMAN_H) && defined(HAVE_MMAP)
+#include <sys/mman.h>
+#endif
+
 #if defined(__APPLE__)
 #include <mach/mach.h>
 #include <mach/mach_time.h>
 #endif
 
+/* net-snmp can only merge its descriptors into our fd_sets, so AgentX
+ * builds keep using select(). */
+#if defined HAVE_SNMP && defined SNMP_AGENTX
+#undef HAVE_EPOLL
+#undef HAVE_KQUEUE
+#endif
+
+#if defined(HAVE_EPOLL)
+#include <sys/epoll.h>
+#elif defined(HAVE_KQUEUE)
+#include <sys/event.h>
+#endif
+
+/* fd_armed flags */
+#define THREAD_IO_READ		(1 << 0)
+#define THREAD_IO_WRITE		(1 << 1)
+#define THREAD_IO_REGISTERED	(1 << 2)
+
+/* Number of ready descriptors fetched from the kernel per wait. */
+#define THREAD_IO_EVENTS	256
+
 
 /* Recent absolute time of day */
 struct timeval recent_time;
@@ -55,6 +88,20 @@ static struct timeval relative_time_base;
 static unsigned short timers_inited;
 
 static struct hash *cpu_record = NULL;
+
+unsigned long thread_lag_warn = 0;
+
+/* Shared event loop heartbeat, see thread_heartbeat_start(). */
+static struct thread_heartbeat *thread_heartbeat;
+
+/* Direct-mapped cache in front of cpu_record, for threads that have no
+   history pointer yet: thread structures reused for another function,
+   and the dummies of thread_execute(). */
+#define CPU_RECORD_CACHE_SIZE 64
+static struct cpu_thread_history *cpu_record_cache[CPU_RECORD_CACHE_SIZE];
+
+/* All thread masters, for "show thread timers" */
+static struct list *thread_masters;
 
 /* Struct timeval's tv_usec one second value.  */
 #define TIMER_SECOND_MICRO 1000000L
@@ -278,19 +325,74 @@ cpu_record_hash_free (void *a)
   XFREE (MTYPE_THREAD_STATS, hist);
 }
 
+static struct cpu_thread_history *
+cpu_record_get (int (*func) (struct thread *), const char *funcname)
+{
+  struct cpu_thread_history **slot;
+  struct cpu_thread_history tmp;
+
+  slot = &cpu_record_cache[((uintptr_t) func >> 4) % CPU_RECORD_CACHE_SIZE];
+  if (*slot && (*slot)->func == func)
+    return *slot;
+
+  tmp.func = func;
+  strcpy (tmp.funcname, funcname);
+  *slot = hash_get (cpu_record, &tmp,
+		    (void * (*) (void *)) cpu_record_hash_alloc);
+  return *slot;
+}
+
+/* Histogram bucket for a call that took the given time. */
+static inline unsigned int
+cpu_record_bucket (unsigned long usecs)
+{
+  unsigned int b = 0;
+
+  while (usecs && b < THREAD_HIST_BUCKETS - 1)
+    {
+      usecs >>= 1;
+      b++;
+    }
+  return b;
+}
+
+/* Time that pct percent of the calls stayed within, in microseconds.
+   As precise as the histogram allows. */
+static unsigned long
+cpu_record_percentile (struct cpu_thread_history *a, unsigned int pct)
+{
+  unsigned long long want, seen;
+  unsigned int b;
+
+  want = ((unsigned long long) a->total_calls * pct + 99) / 100;
+  seen = 0;
+  for (b = 0; b < THREAD_HIST_BUCKETS - 1; b++)
+    {
+      seen += a->real_hist[b];
+      if (seen >= want)
+	break;
+    }
+
+  if (b == THREAD_HIST_BUCKETS - 1 || a->real.max < (1UL << b))
+    return a->real.max;
+  return 1UL << b;
+}
+
 static void 
 vty_out_cpu_thread_history(struct vty* vty,
 			   struct cpu_thread_history *a)
 {
 #ifdef HAVE_RUSAGE
-  vty_out(vty, "%7ld.%03ld %9d %8ld %9ld %8ld %9ld",
+  vty_out(vty, "%7ld.%03ld %9d %8ld %9ld %8ld %9ld %8lu",
 	  a->cpu.total/1000, a->cpu.total%1000, a->total_calls,
 	  a->cpu.total/a->total_calls, a->cpu.max,
-	  a->real.total/a->total_calls, a->real.max);
+	  a->real.total/a->total_calls, a->real.max,
+	  cpu_record_percentile (a, 99));
 #else
-  vty_out(vty, "%7ld.%03ld %9d %8ld %9ld",
+  vty_out(vty, "%7ld.%03ld %9d %8ld %9ld %8lu",
 	  a->real.total/1000, a->real.total%1000, a->total_calls,
-	  a->real.total/a->total_calls, a->real.max);
+	  a->real.total/a->total_calls, a->real.max,
+	  cpu_record_percentile (a, 99));
 #endif
   vty_out(vty, " %c%c%c%c%c%c %s%s",
 	  a->types & (1 << THREAD_READ) ? 'R':' ',
@@ -310,15 +412,18 @@ cpu_record_hash_print(struct hash_backet *bucket,
   struct vty *vty = args[1];
   thread_type *filter = args[2];
   struct cpu_thread_history *a = bucket->data;
+  int i;
   
   a = bucket->data;
-  if ( !(a->types & *filter) )
+  if ( !(a->types & *filter) || !a->total_calls )
        return;
   vty_out_cpu_thread_history(vty,a);
   totals->total_calls += a->total_calls;
   totals->real.total += a->real.total;
   if (totals->real.max < a->real.max)
     totals->real.max = a->real.max;
+  for (i = 0; i < THREAD_HIST_BUCKETS; i++)
+    totals->real_hist[i] += a->real_hist[i];
 #ifdef HAVE_RUSAGE
   totals->cpu.total += a->cpu.total;
   if (totals->cpu.max < a->cpu.max)
@@ -338,13 +443,13 @@ cpu_record_print(struct vty *vty, thread_type filter)
 
 #ifdef HAVE_RUSAGE
   vty_out(vty, "%21s %18s %18s%s",
-  	  "", "CPU (user+system):", "Real (wall-clock):", VTY_NEWLINE);
+  	  "", "CPU (thread):", "Real (wall-clock):", VTY_NEWLINE);
 #endif
   vty_out(vty, "Runtime(ms)   Invoked Avg uSec Max uSecs");
 #ifdef HAVE_RUSAGE
   vty_out(vty, " Avg uSec Max uSecs");
 #endif
-  vty_out(vty, "  Type  Thread%s", VTY_NEWLINE);
+  vty_out(vty, " P99 uSec  Type  Thread%s", VTY_NEWLINE);
   hash_iterate(cpu_record,
 	       (void(*)(struct hash_backet*,void*))cpu_record_hash_print,
 	       args);
@@ -353,13 +458,10 @@ cpu_record_print(struct vty *vty, thread_type filter)
     vty_out_cpu_thread_history(vty, &tmp);
 }
 
-DEFUN(show_thread_cpu,
-      show_thread_cpu_cmd,
-      "show thread cpu [FILTER]",
-      SHOW_STR
-      "Thread information\n"
-      "Thread CPU usage\n"
-      "Display filter (rwtexb)\n")
+/* Parse the optional FILTER argument of the thread cpu commands. */
+static int
+cpu_record_filter (struct vty *vty, int argc, const char **argv,
+		   thread_type *filterp)
 {
   int i = 0;
   thread_type filter = (thread_type) -1U;
@@ -409,10 +511,80 @@ DEFUN(show_thread_cpu,
 	}
     }
 
+  *filterp = filter;
+  return CMD_SUCCESS;
+}
+
+DEFUN(show_thread_cpu,
+      show_thread_cpu_cmd,
+      "show thread cpu [FILTER]",
+      SHOW_STR
+      "Thread information\n"
+      "Thread CPU usage\n"
+      "Display filter (rwtexb)\n")
+{
+  thread_type filter;
+
+  if (cpu_record_filter (vty, argc, argv, &filter) != CMD_SUCCESS)
+    return CMD_WARNING;
+
   cpu_record_print(vty, filter);
   return CMD_SUCCESS;
 }
 
+static void
+cpu_record_hash_print_latency (struct hash_backet *bucket, void *args[])
+{
+  struct vty *vty = args[0];
+  thread_type *filter = args[1];
+  struct cpu_thread_history *a = bucket->data;
+  int b;
+
+  if (!(a->types & *filter) || !a->total_calls)
+    return;
+
+  vty_out (vty, "%-32s %9u %8lu %8lu %8lu %9lu%s", a->funcname,
+	   a->total_calls, cpu_record_percentile (a, 50),
+	   cpu_record_percentile (a, 90), cpu_record_percentile (a, 99),
+	   a->real.max, VTY_NEWLINE);
+
+  /* Non-empty buckets, as "upper bound in uSecs:calls". */
+  vty_out (vty, " ");
+  for (b = 0; b < THREAD_HIST_BUCKETS; b++)
+    {
+      if (!a->real_hist[b])
+	continue;
+      if (b == THREAD_HIST_BUCKETS - 1)
+	vty_out (vty, " >%lu:%u", 1UL << (b - 1), a->real_hist[b]);
+      else
+	vty_out (vty, " %lu:%u", 1UL << b, a->real_hist[b]);
+    }
+  vty_out (vty, "%s", VTY_NEWLINE);
+}
+
+DEFUN(show_thread_latency,
+      show_thread_latency_cmd,
+      "show thread latency [FILTER]",
+      SHOW_STR
+      "Thread information\n"
+      "Thread wall-clock latency histograms\n"
+      "Display filter (rwtexb)\n")
+{
+  thread_type filter;
+  void *args[2] = {vty, &filter};
+
+  if (cpu_record_filter (vty, argc, argv, &filter) != CMD_SUCCESS)
+    return CMD_WARNING;
+
+  vty_out (vty, "%-32s %9s %8s %8s %8s %9s%s", "Thread", "Invoked",
+	   "P50 uSec", "P90 uSec", "P99 uSec", "Max uSecs", VTY_NEWLINE);
+  hash_iterate (cpu_record,
+	        (void (*) (struct hash_backet*,void*))
+		cpu_record_hash_print_latency,
+	        args);
+  return CMD_SUCCESS;
+}
+
 static void
 cpu_record_hash_clear (struct hash_backet *bucket, 
 		      void *args)
@@ -424,7 +596,15 @@ cpu_record_hash_clear (struct hash_backet *bucket,
   if ( !(a->types & *filter) )
        return;
   
-  hash_release (cpu_record, bucket->data);
+  /* Reset the record rather than removing it, threads keep pointers
+     to it. */
+  a->total_calls = 0;
+  memset (&a->real, 0, sizeof (a->real));
+#ifdef HAVE_RUSAGE
+  memset (&a->cpu, 0, sizeof (a->cpu));
+#endif
+  memset (a->real_hist, 0, sizeof (a->real_hist));
+  a->types = 0;
 }
 
 static void
@@ -436,6 +616,30 @@ cpu_record_clear (thread_type filter)
 	        tmp);
 }
 
+struct cpu_record_walk_args
+{
+  void (*func) (struct cpu_thread_history *, void *);
+  void *arg;
+};
+
+static void
+cpu_record_hash_walk (struct hash_backet *bucket, void *args)
+{
+  struct cpu_record_walk_args *w = args;
+
+  w->func (bucket->data, w->arg);
+}
+
+void
+thread_cpu_record_walk (void (*func) (struct cpu_thread_history *, void *),
+                        void *arg)
+{
+  struct cpu_record_walk_args w = { func, arg };
+
+  if (cpu_record)
+    hash_iterate (cpu_record, cpu_record_hash_walk, &w);
+}
+
 DEFUN(clear_thread_cpu,
       clear_thread_cpu_cmd,
       "clear thread cpu [FILTER]",
@@ -444,58 +648,118 @@ DEFUN(clear_thread_cpu,
       "Thread CPU usage\n"
       "Display filter (rwtexb)\n")
 {
-  int i = 0;
-  thread_type filter = (thread_type) -1U;
+  thread_type filter;
 
-  if (argc > 0)
-    {
-      filter = 0;
-      while (argv[0][i] != '\0')
-	{
-	  switch ( argv[0][i] )
-	    {
-	    case 'r':
-	    case 'R':
-	      filter |= (1 << THREAD_READ);
-	      break;
-	    case 'w':
-	    case 'W':
-	      filter |= (1 << THREAD_WRITE);
-	      break;
-	    case 't':
-	    case 'T':
-	      filter |= (1 << THREAD_TIMER);
-	      break;
-	    case 'e':
-	    case 'E':
-	      filter |= (1 << THREAD_EVENT);
-	      break;
-	    case 'x':
-	    case 'X':
-	      filter |= (1 << THREAD_EXECUTE);
-	      break;
-	    case 'b':
-	    case 'B':
-	      filter |= (1 << THREAD_BACKGROUND);
-	      break;
-	    default:
-	      break;
-	    }
-	  ++i;
-	}
-      if (filter == 0)
-	{
-	  vty_out(vty, "Invalid filter \"%s\" specified,"
-                  " must contain at least one of 'RWTEXB'%s",
-		  argv[0], VTY_NEWLINE);
-	  return CMD_WARNING;
-	}
-    }
+  if (cpu_record_filter (vty, argc, argv, &filter) != CMD_SUCCESS)
+    return CMD_WARNING;
 
   cpu_record_clear (filter);
   return CMD_SUCCESS;
 }
 
+static void
+vty_out_timer_queue (struct vty *vty, const char *name,
+                     struct pqueue *queue, int peak)
+{
+  vty_out (vty, "  %-10s %8d %8d", name, queue->size, peak);
+  if (queue->size)
+    {
+      struct thread *next_timer = queue->array[0];
+      struct timeval remain;
+
+      remain = timeval_subtract (next_timer->u.sands, relative_time);
+      vty_out (vty, " %6ld.%03ld %s", (long) remain.tv_sec,
+               (long) remain.tv_usec / 1000, next_timer->funcname);
+    }
+  vty_out (vty, "%s", VTY_NEWLINE);
+}
+
+DEFUN(show_thread_timers,
+      show_thread_timers_cmd,
+      "show thread timers",
+      SHOW_STR
+      "Thread information\n"
+      "Timer queue depth\n")
+{
+  struct listnode *node;
+  struct thread_master *m;
+
+  quagga_get_relative (NULL);
+  vty_out (vty, "  %-10s %8s %8s %10s %s%s",
+           "Queue", "Pending", "Peak", "Next(s)", "Thread", VTY_NEWLINE);
+  for (ALL_LIST_ELEMENTS_RO (thread_masters, node, m))
+    {
+      vty_out_timer_queue (vty, "timer", m->timer, m->timer_peak);
+      vty_out_timer_queue (vty, "background", m->background,
+                           m->background_peak);
+    }
+  return CMD_SUCCESS;
+}
+
+DEFUN(show_thread_lag,
+      show_thread_lag_cmd,
+      "show thread lag",
+      SHOW_STR
+      "Thread information\n"
+      "Event loop lag\n")
+{
+  struct listnode *node;
+  struct thread_master *m;
+  int i = 0;
+
+  vty_out (vty, "Warning threshold: ");
+  if (thread_lag_warn)
+    vty_out (vty, "%lu msecs%s", thread_lag_warn, VTY_NEWLINE);
+  else
+    vty_out (vty, "none%s", VTY_NEWLINE);
+
+  vty_out (vty, "  %-6s %10s %9s %9s %8s %10s%s", "Master", "Timers",
+           "Avg uSec", "Max uSecs", "Late", "Ready peak", VTY_NEWLINE);
+  for (ALL_LIST_ELEMENTS_RO (thread_masters, node, m))
+    vty_out (vty, "  %-6d %10lu %9lu %9lu %8lu %10d%s", i++, m->lag.timers,
+             m->lag.timers ? m->lag.total / m->lag.timers : 0, m->lag.max,
+             m->lag.late, m->lag.ready_peak, VTY_NEWLINE);
+  return CMD_SUCCESS;
+}
+
+DEFUN(clear_thread_lag,
+      clear_thread_lag_cmd,
+      "clear thread lag",
+      "Clear stored data\n"
+      "Thread information\n"
+      "Event loop lag\n")
+{
+  struct listnode *node;
+  struct thread_master *m;
+
+  for (ALL_LIST_ELEMENTS_RO (thread_masters, node, m))
+    memset (&m->lag, 0, sizeof (m->lag));
+  return CMD_SUCCESS;
+}
+
+DEFUN(thread_lag_warning,
+      thread_lag_warning_cmd,
+      "thread lag-warning <1-600000>",
+      "Thread configuration\n"
+      "Log timers dispatched late, with the task that held them up\n"
+      "Lateness in milliseconds\n")
+{
+  VTY_GET_INTEGER_RANGE ("lag warning", thread_lag_warn, argv[0], 1, 600000);
+  return CMD_SUCCESS;
+}
+
+DEFUN(no_thread_lag_warning,
+      no_thread_lag_warning_cmd,
+      "no thread lag-warning [<1-600000>]",
+      NO_STR
+      "Thread configuration\n"
+      "Log timers dispatched late, with the task that held them up\n"
+      "Lateness in milliseconds\n")
+{
+  thread_lag_warn = 0;
+  return CMD_SUCCESS;
+}
+
 /* List allocation and head/tail print out. */
 static void
 thread_list_debug (struct thread_list *list)
@@ -513,29 +777,333 @@ thread_master_debug (struct thread_master *m)
   thread_list_debug (&m->read);
   printf ("writelist : ");
   thread_list_debug (&m->write);
-  printf ("timerlist : ");
-  thread_list_debug (&m->timer);
+  printf ("timerqueue: count [%d] peak [%d]\n",
+          m->timer->size, m->timer_peak);
   printf ("eventlist : ");
   thread_list_debug (&m->event);
   printf ("unuselist : ");
   thread_list_debug (&m->unuse);
-  printf ("bgndlist : ");
-  thread_list_debug (&m->background);
+  printf ("bgndqueue : count [%d] peak [%d]\n",
+          m->background->size, m->background_peak);
   printf ("total alloc: [%ld]\n", m->alloc);
   printf ("-----------\n");
 }
 
+/* Timer queue ordering: earliest deadline at the top of the heap. */
+static int
+thread_timer_cmp (void *a, void *b)
+{
+  struct thread *thread_a = a;
+  struct thread *thread_b = b;
+  long cmp = timeval_cmp (thread_a->u.sands, thread_b->u.sands);
+
+  if (cmp < 0)
+    return -1;
+  if (cmp > 0)
+    return 1;
+  return 0;
+}
+
+/* Track each timer's heap position, so it can be cancelled in O(log n). */
+static void
+thread_timer_update (void *node, int actual_position)
+{
+  struct thread *thread = node;
+
+  thread->index = actual_position;
+}
+
+static struct pqueue *
+thread_timer_queue_create (void)
+{
+  struct pqueue *queue = pqueue_create ();
+
+  queue->cmp = thread_timer_cmp;
+  queue->update = thread_timer_update;
+  return queue;
+}
+
+/* Open the kernel event queue, if we have one.  On failure io_fd stays
+   -1 and the master falls back to select(). */
+static void
+thread_io_init (struct thread_master *m)
+{
+  m->io_fd = -1;
+#if defined(HAVE_EPOLL)
+  m->io_fd = epoll_create (THREAD_IO_EVENTS);
+  if (m->io_fd >= 0)
+    m->io_events = XCALLOC (MTYPE_THREAD_FDTBL,
+                            THREAD_IO_EVENTS * sizeof (struct epoll_event));
+#elif defined(HAVE_KQUEUE)
+  m->io_fd = kqueue ();
+  if (m->io_fd >= 0)
+    m->io_events = XCALLOC (MTYPE_THREAD_FDTBL,
+                            THREAD_IO_EVENTS * sizeof (struct kevent));
+#endif
+  if (m->io_fd >= 0)
+    fcntl (m->io_fd, F_SETFD, FD_CLOEXEC);
+#if defined(HAVE_EPOLL) || defined(HAVE_KQUEUE)
+  else
+    zlog_warn ("thread: cannot create event queue (%s), using select()",
+               safe_strerror (errno));
+#endif
+}
+
+/* An event posted by another pthread.  These are malloc()ed, as
+ * memory.c keeps its counts without locking. */
+struct thread_post
+{
+  int (*func) (struct thread *);
+  void *arg;
+  int val;
+  const char *funcname;
+  struct thread_post *next;
+};
+
+struct thread_inbox
+{
+#ifdef HAVE_PTHREAD
+  pthread_mutex_t mtx;
+#endif /* HAVE_PTHREAD */
+  struct thread_post *head, *tail;
+  /* Written to when the inbox gets its first post, wakes thread_fetch(). */
+  int wakeup[2];
+  struct thread *t_read;
+};
+
+static int thread_inbox_read (struct thread *);
+
+static void
+thread_inbox_lock (struct thread_inbox *inbox)
+{
+#ifdef HAVE_PTHREAD
+  pthread_mutex_lock (&inbox->mtx);
+#endif /* HAVE_PTHREAD */
+}
+
+static void
+thread_inbox_unlock (struct thread_inbox *inbox)
+{
+#ifdef HAVE_PTHREAD
+  pthread_mutex_unlock (&inbox->mtx);
+#endif /* HAVE_PTHREAD */
+}
+
+static void
+thread_inbox_init (struct thread_master *m)
+{
+  struct thread_inbox *inbox;
+
+  inbox = XCALLOC (MTYPE_THREAD_MASTER, sizeof (struct thread_inbox));
+  if (pipe (inbox->wakeup) < 0)
+    {
+      zlog_err ("%s: could not open pipe: %s", __func__,
+		safe_strerror (errno));
+      XFREE (MTYPE_THREAD_MASTER, inbox);
+      return;
+    }
+  set_nonblocking (inbox->wakeup[0]);
+  set_nonblocking (inbox->wakeup[1]);
+#ifdef HAVE_PTHREAD
+  pthread_mutex_init (&inbox->mtx, NULL);
+#endif /* HAVE_PTHREAD */
+  m->inbox = inbox;
+}
+
+static void
+thread_inbox_free (struct thread_master *m)
+{
+  struct thread_inbox *inbox = m->inbox;
+  struct thread_post *post;
+
+  if (! inbox)
+    return;
+
+  while ((post = inbox->head) != NULL)
+    {
+      inbox->head = post->next;
+      free (post);
+    }
+  close (inbox->wakeup[0]);
+  close (inbox->wakeup[1]);
+#ifdef HAVE_PTHREAD
+  pthread_mutex_destroy (&inbox->mtx);
+#endif /* HAVE_PTHREAD */
+  XFREE (MTYPE_THREAD_MASTER, inbox);
+  m->inbox = NULL;
+}
+
 /* Allocate new thread master.  */
 struct thread_master *
 thread_master_create ()
 {
+  struct thread_master *m;
+
   if (cpu_record == NULL) 
-    cpu_record 
-      = hash_create ((unsigned int (*) (void *))cpu_record_hash_key,
-		     (int (*) (const void *, const void *))cpu_record_hash_cmp);
+    {
+      cpu_record 
+	= hash_create ((unsigned int (*) (void *))cpu_record_hash_key,
+		       (int (*) (const void *, const void *))cpu_record_hash_cmp);
+      hash_set_name (cpu_record, "Thread CPU records");
+    }
+  if (thread_masters == NULL)
+    thread_masters = list_new ();
     
-  return (struct thread_master *) XCALLOC (MTYPE_THREAD_MASTER,
-					   sizeof (struct thread_master));
+  m = XCALLOC (MTYPE_THREAD_MASTER, sizeof (struct thread_master));
+  m->fd_max = -1;
+  m->timer = thread_timer_queue_create ();
+  m->background = thread_timer_queue_create ();
+  thread_io_init (m);
+  thread_inbox_init (m);
+  if (m->inbox)
+    m->inbox->t_read = funcname_thread_add_read (m, thread_inbox_read, m,
+						 m->inbox->wakeup[0],
+						 "thread_inbox_read");
+  listnode_add (thread_masters, m);
+
+  return m;
+}
+
+/* Make sure the per-fd tables can be indexed by fd. */
+static void
+thread_fd_grow (struct thread_master *m, int fd)
+{
+  int size = m->fd_size ? m->fd_size : 64;
+
+  if (fd < m->fd_size)
+    return;
+
+  while (size <= fd)
+    size *= 2;
+
+  m->fd_read = XREALLOC (MTYPE_THREAD_FDTBL, m->fd_read,
+                         size * sizeof (struct thread *));
+  m->fd_write = XREALLOC (MTYPE_THREAD_FDTBL, m->fd_write,
+                          size * sizeof (struct thread *));
+  m->fd_armed = XREALLOC (MTYPE_THREAD_FDTBL, m->fd_armed, size);
+
+  memset (m->fd_read + m->fd_size, 0,
+          (size - m->fd_size) * sizeof (struct thread *));
+  memset (m->fd_write + m->fd_size, 0,
+          (size - m->fd_size) * sizeof (struct thread *));
+  memset (m->fd_armed + m->fd_size, 0, size - m->fd_size);
+  m->fd_size = size;
+}
+
+#if defined(HAVE_EPOLL) || defined(HAVE_KQUEUE)
+/* Bring the kernel's view of fd in line with the read/write threads we
+ * hold for it.  Registrations are one-shot, so a descriptor which fired
+ * is already disarmed and only needs re-arming if it is wanted again.
+ */
+static void
+thread_io_update (struct thread_master *m, int fd)
+{
+  u_char want = 0;
+  u_char armed = m->fd_armed[fd];
+
+  if (m->fd_read[fd])
+    want |= THREAD_IO_READ;
+  if (m->fd_write[fd])
+    want |= THREAD_IO_WRITE;
+
+  if (want == (armed & (THREAD_IO_READ|THREAD_IO_WRITE)))
+    return;
+
+#if defined(HAVE_EPOLL)
+  {
+    struct epoll_event ev;
+    int op;
+
+    if (!want)
+      {
+        /* The descriptor may already be closed; nothing to report then. */
+        if (armed & THREAD_IO_REGISTERED)
+          epoll_ctl (m->io_fd, EPOLL_CTL_DEL, fd, NULL);
+        m->fd_armed[fd] = 0;
+        return;
+      }
+
+    memset (&ev, 0, sizeof (ev));
+    ev.events = EPOLLONESHOT;
+    if (want & THREAD_IO_READ)
+      ev.events |= EPOLLIN;
+    if (want & THREAD_IO_WRITE)
+      ev.events |= EPOLLOUT;
+    ev.data.fd = fd;
+
+    op = (armed & THREAD_IO_REGISTERED) ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+    if (epoll_ctl (m->io_fd, op, fd, &ev) < 0)
+      {
+        /* Closing a descriptor silently drops it from the set, and a
+         * recycled descriptor number may still be known to the kernel. */
+        if (errno == ENOENT)
+          op = EPOLL_CTL_ADD;
+        else if (errno == EEXIST)
+          op = EPOLL_CTL_MOD;
+        else
+          op = -1;
+        if (op < 0 || epoll_ctl (m->io_fd, op, fd, &ev) < 0)
+          zlog_warn ("epoll_ctl fd %d: %s", fd, safe_strerror (errno));
+      }
+  }
+#elif defined(HAVE_KQUEUE)
+  {
+    struct kevent kev[2];
+    int n = 0;
+
+    if ((want ^ armed) & THREAD_IO_READ)
+      EV_SET (&kev[n++], fd, EVFILT_READ,
+              (want & THREAD_IO_READ) ? (EV_ADD|EV_ONESHOT) : EV_DELETE,
+              0, 0, NULL);
+    if ((want ^ armed) & THREAD_IO_WRITE)
+      EV_SET (&kev[n++], fd, EVFILT_WRITE,
+              (want & THREAD_IO_WRITE) ? (EV_ADD|EV_ONESHOT) : EV_DELETE,
+              0, 0, NULL);
+
+    /* EV_DELETE of an already fired or closed filter fails harmlessly. */
+    if (kevent (m->io_fd, kev, n, NULL, 0, NULL) < 0 && want
+        && errno != ENOENT && errno != EBADF)
+      zlog_warn ("kevent fd %d: %s", fd, safe_strerror (errno));
+  }
+#endif /* HAVE_KQUEUE */
+
+  m->fd_armed[fd] = want | (want ? THREAD_IO_REGISTERED : 0);
+}
+#endif /* HAVE_EPOLL || HAVE_KQUEUE */
+
+/* Register or deregister a read/write thread in the per-fd table. */
+static void
+thread_fd_set (struct thread_master *m, int type, int fd,
+               struct thread *thread)
+{
+  if (type == THREAD_READ)
+    m->fd_read[fd] = thread;
+  else
+    m->fd_write[fd] = thread;
+
+  if (thread)
+    {
+      if (fd > m->fd_max)
+        m->fd_max = fd;
+    }
+  else
+    while (m->fd_max >= 0
+           && !m->fd_read[m->fd_max] && !m->fd_write[m->fd_max])
+      m->fd_max--;
+
+  if (m->io_fd < 0)
+    {
+      fd_set *fdset = (type == THREAD_READ) ? &m->readfd : &m->writefd;
+
+      if (thread)
+        FD_SET (fd, fdset);
+      else
+        FD_CLR (fd, fdset);
+    }
+#if defined(HAVE_EPOLL) || defined(HAVE_KQUEUE)
+  else
+    thread_io_update (m, fd);
+#endif
 }
 
 /* Add a new thread to the list.  */
@@ -552,22 +1120,6 @@ thread_list_add (struct thread_list *list, struct thread *thread)
   list->count++;
 }
 
-/* Add a new thread just before the point.  */
-static void
-thread_list_add_before (struct thread_list *list, 
-			struct thread *point, 
-			struct thread *thread)
-{
-  thread->next = point;
-  thread->prev = point->prev;
-  if (point->prev)
-    point->prev->next = thread;
-  else
-    list->head = thread;
-  point->prev = thread;
-  list->count++;
-}
-
 /* Delete a thread from the list. */
 static struct thread *
 thread_list_delete (struct thread_list *list, struct thread *thread)
@@ -613,17 +1165,45 @@ thread_list_free (struct thread_master *m, struct thread_list *list)
     }
 }
 
+/* Free all threads in a timer queue, and the queue itself. */
+static void
+thread_queue_free (struct thread_master *m, struct pqueue *queue)
+{
+  int i;
+
+  for (i = 0; i < queue->size; i++)
+    {
+      XFREE (MTYPE_THREAD, queue->array[i]);
+      m->alloc--;
+    }
+  pqueue_delete (queue);
+}
+
 /* Stop thread scheduler. */
 void
 thread_master_free (struct thread_master *m)
 {
+  listnode_delete (thread_masters, m);
+
   thread_list_free (m, &m->read);
   thread_list_free (m, &m->write);
-  thread_list_free (m, &m->timer);
+  thread_queue_free (m, m->timer);
   thread_list_free (m, &m->event);
   thread_list_free (m, &m->ready);
   thread_list_free (m, &m->unuse);
-  thread_list_free (m, &m->background);
+  thread_queue_free (m, m->background);
+  thread_inbox_free (m);
+
+  if (m->io_fd >= 0)
+    close (m->io_fd);
+  if (m->io_events)
+    XFREE (MTYPE_THREAD_FDTBL, m->io_events);
+  if (m->fd_size)
+    {
+      XFREE (MTYPE_THREAD_FDTBL, m->fd_read);
+      XFREE (MTYPE_THREAD_FDTBL, m->fd_write);
+      XFREE (MTYPE_THREAD_FDTBL, m->fd_armed);
+    }
   
   XFREE (MTYPE_THREAD_MASTER, m);
 
@@ -632,6 +1212,12 @@ thread_master_free (struct thread_master *m)
       hash_clean (cpu_record, cpu_record_hash_free);
       hash_free (cpu_record);
       cpu_record = NULL;
+      memset (cpu_record_cache, 0, sizeof (cpu_record_cache));
+    }
+  if (thread_masters && listcount (thread_masters) == 0)
+    {
+      list_delete (thread_masters);
+      thread_masters = NULL;
     }
 }
 
@@ -700,6 +1286,9 @@ thread_get (struct thread_master *m, u_char type,
       thread = XCALLOC (MTYPE_THREAD, sizeof (struct thread));
       m->alloc++;
     }
+  /* The cached history pointer is only good for the same function. */
+  if (thread->func != func)
+    thread->hist = NULL;
   thread->type = type;
   thread->add_type = type;
   thread->master = m;
@@ -720,16 +1309,23 @@ funcname_thread_add_read (struct thread_master *m,
 
   assert (m != NULL);
 
-  if (FD_ISSET (fd, &m->readfd))
+  if (fd < 0 || (m->io_fd < 0 && fd >= FD_SETSIZE))
+    {
+      zlog (NULL, LOG_ERR, "Cannot poll read fd [%d]", fd);
+      return NULL;
+    }
+
+  thread_fd_grow (m, fd);
+  if (m->fd_read[fd])
     {
       zlog (NULL, LOG_WARNING, "There is already read fd [%d]", fd);
       return NULL;
     }
 
   thread = thread_get (m, THREAD_READ, func, arg, funcname);
-  FD_SET (fd, &m->readfd);
   thread->u.fd = fd;
   thread_list_add (&m->read, thread);
+  thread_fd_set (m, THREAD_READ, fd, thread);
 
   return thread;
 }
@@ -743,16 +1339,23 @@ funcname_thread_add_write (struct thread_master *m,
 
   assert (m != NULL);
 
-  if (FD_ISSET (fd, &m->writefd))
+  if (fd < 0 || (m->io_fd < 0 && fd >= FD_SETSIZE))
+    {
+      zlog (NULL, LOG_ERR, "Cannot poll write fd [%d]", fd);
+      return NULL;
+    }
+
+  thread_fd_grow (m, fd);
+  if (m->fd_write[fd])
     {
       zlog (NULL, LOG_WARNING, "There is already write fd [%d]", fd);
       return NULL;
     }
 
   thread = thread_get (m, THREAD_WRITE, func, arg, funcname);
-  FD_SET (fd, &m->writefd);
   thread->u.fd = fd;
   thread_list_add (&m->write, thread);
+  thread_fd_set (m, THREAD_WRITE, fd, thread);
 
   return thread;
 }
@@ -766,16 +1369,15 @@ funcname_thread_add_timer_timeval (struct thread_master *m,
                                   const char* funcname)
 {
   struct thread *thread;
-  struct thread_list *list;
+  struct pqueue *queue;
   struct timeval alarm_time;
-  struct thread *tt;
 
   assert (m != NULL);
 
   assert (type == THREAD_TIMER || type == THREAD_BACKGROUND);
   assert (time_relative);
   
-  list = ((type == THREAD_TIMER) ? &m->timer : &m->background);
+  queue = ((type == THREAD_TIMER) ? m->timer : m->background);
   thread = thread_get (m, type, func, arg, funcname);
 
   /* Do we need jitter here? */
@@ -784,15 +1386,15 @@ funcname_thread_add_timer_timeval (struct thread_master *m,
   alarm_time.tv_usec = relative_time.tv_usec + time_relative->tv_usec;
   thread->u.sands = timeval_adjust(alarm_time);
 
-  /* Sort by timeval. */
-  for (tt = list->head; tt; tt = tt->next)
-    if (timeval_cmp (thread->u.sands, tt->u.sands) <= 0)
-      break;
+  pqueue_enqueue (thread, queue);
 
-  if (tt)
-    thread_list_add_before (list, tt, thread);
-  else
-    thread_list_add (list, thread);
+  if (type == THREAD_TIMER)
+    {
+      if (queue->size > m->timer_peak)
+        m->timer_peak = queue->size;
+    }
+  else if (queue->size > m->background_peak)
+    m->background_peak = queue->size;
 
   return thread;
 }
@@ -874,26 +1476,97 @@ funcname_thread_add_event (struct thread_master *m,
   return thread;
 }
 
+/* Queue an event for the master from any pthread.  Cannot be cancelled
+ * until it has become an event thread.  Returns -1 if the master has no
+ * inbox or memory ran out.
+ */
+int
+funcname_thread_post_event (struct thread_master *m,
+			    int (*func) (struct thread *), void *arg, int val,
+			    const char *funcname)
+{
+  struct thread_inbox *inbox = m->inbox;
+  struct thread_post *post;
+  int wake;
+  char c = 0;
+
+  if (! inbox || (post = malloc (sizeof (struct thread_post))) == NULL)
+    return -1;
+  post->func = func;
+  post->arg = arg;
+  post->val = val;
+  post->funcname = funcname;
+  post->next = NULL;
+
+  thread_inbox_lock (inbox);
+  wake = (inbox->head == NULL);
+  if (inbox->tail)
+    inbox->tail->next = post;
+  else
+    inbox->head = post;
+  inbox->tail = post;
+  thread_inbox_unlock (inbox);
+
+  /* Later posts find the master already woken.  A full pipe means the
+   * same. */
+  if (wake && write (inbox->wakeup[1], &c, 1) < 0 && errno != EAGAIN)
+    return -1;
+  return 0;
+}
+
+/* Turn the posted events into event threads, in the order posted. */
+static int
+thread_inbox_read (struct thread *thread)
+{
+  struct thread_master *m = THREAD_ARG (thread);
+  struct thread_inbox *inbox = m->inbox;
+  struct thread_post *post, *next;
+  char buf[64];
+
+  inbox->t_read = funcname_thread_add_read (m, thread_inbox_read, m,
+					    inbox->wakeup[0],
+					    "thread_inbox_read");
+
+  /* Drain before taking the posts, so none is left without a wakeup. */
+  while (read (inbox->wakeup[0], buf, sizeof (buf)) > 0)
+    ;
+
+  thread_inbox_lock (inbox);
+  post = inbox->head;
+  inbox->head = inbox->tail = NULL;
+  thread_inbox_unlock (inbox);
+
+  for (; post; post = next)
+    {
+      next = post->next;
+      funcname_thread_add_event (m, post->func, post->arg, post->val,
+				 post->funcname);
+      free (post);
+    }
+  return 0;
+}
+
 /* Cancel thread from scheduler. */
 void
 thread_cancel (struct thread *thread)
 {
-  struct thread_list *list;
+  struct thread_list *list = NULL;
+  struct pqueue *queue = NULL;
   
   switch (thread->type)
     {
     case THREAD_READ:
-      assert (FD_ISSET (thread->u.fd, &thread->master->readfd));
-      FD_CLR (thread->u.fd, &thread->master->readfd);
+      assert (thread->master->fd_read[thread->u.fd] == thread);
+      thread_fd_set (thread->master, THREAD_READ, thread->u.fd, NULL);
       list = &thread->master->read;
       break;
     case THREAD_WRITE:
-      assert (FD_ISSET (thread->u.fd, &thread->master->writefd));
-      FD_CLR (thread->u.fd, &thread->master->writefd);
+      assert (thread->master->fd_write[thread->u.fd] == thread);
+      thread_fd_set (thread->master, THREAD_WRITE, thread->u.fd, NULL);
       list = &thread->master->write;
       break;
     case THREAD_TIMER:
-      list = &thread->master->timer;
+      queue = thread->master->timer;
       break;
     case THREAD_EVENT:
       list = &thread->master->event;
@@ -902,13 +1575,21 @@ thread_cancel (struct thread *thread)
       list = &thread->master->ready;
       break;
     case THREAD_BACKGROUND:
-      list = &thread->master->background;
+      queue = thread->master->background;
       break;
     default:
       return;
       break;
     }
-  thread_list_delete (list, thread);
+
+  if (queue)
+    {
+      assert (thread->index >= 0 && thread->index < queue->size);
+      assert (queue->array[thread->index] == thread);
+      pqueue_remove_at (thread->index, queue);
+    }
+  else
+    thread_list_delete (list, thread);
   thread->type = THREAD_UNUSED;
   thread_add_unuse (thread->master, thread);
 }
@@ -954,70 +1635,229 @@ thread_cancel_event (struct thread_master *m, void *arg)
           thread_add_unuse (m, t);
         }
     }
+
+  /* or still in the inbox */
+  if (m->inbox)
+    {
+      struct thread_post **pp, *post;
+
+      thread_inbox_lock (m->inbox);
+      m->inbox->tail = NULL;
+      for (pp = &m->inbox->head; (post = *pp) != NULL; )
+        if (post->arg == arg)
+          {
+            ret++;
+            *pp = post->next;
+            free (post);
+          }
+        else
+          {
+            m->inbox->tail = post;
+            pp = &post->next;
+          }
+      thread_inbox_unlock (m->inbox);
+    }
   return ret;
 }
 
 static struct timeval *
-thread_timer_wait (struct thread_list *tlist, struct timeval *timer_val)
+thread_timer_wait (struct pqueue *queue, struct timeval *timer_val)
 {
-  if (!thread_empty (tlist))
+  if (queue->size)
     {
-      *timer_val = timeval_subtract (tlist->head->u.sands, relative_time);
+      struct thread *next_timer = queue->array[0];
+      *timer_val = timeval_subtract (next_timer->u.sands, relative_time);
       return timer_val;
     }
   return NULL;
 }
 
+/* Account for how late a timer is dispatched, and who is to blame. */
+static void
+thread_lag_timer (struct thread_master *m, struct thread *thread)
+{
+  unsigned long lag = 0;
+
+  if (timeval_cmp (relative_time, thread->u.sands) > 0)
+    lag = timeval_elapsed (relative_time, thread->u.sands);
+
+  m->lag.timers++;
+  m->lag.total += lag;
+  if (m->lag.max < lag)
+    m->lag.max = lag;
+
+  if (thread_lag_warn && lag > thread_lag_warn * 1000)
+    {
+      m->lag.late++;
+      zlog_warn ("timer %s dispatched %lums late, longest task since the "
+		 "previous timer: %s (%lums)", thread->funcname, lag / 1000,
+		 m->lag.slowest ? m->lag.slowest->funcname : "none",
+		 m->lag.slowest_real / 1000);
+    }
+
+  m->lag.slowest = NULL;
+  m->lag.slowest_real = 0;
+}
+
 static struct thread *
 thread_run (struct thread_master *m, struct thread *thread,
 	    struct thread *fetch)
 {
+  /* The thread has been taken off the ready list already. */
+  if (m->ready.count >= m->lag.ready_peak)
+    m->lag.ready_peak = m->ready.count + 1;
+  if (thread->add_type == THREAD_TIMER)
+    thread_lag_timer (m, thread);
+  if (thread_heartbeat)
+    thread_heartbeat->count++;
+
   *fetch = *thread;
   thread->type = THREAD_UNUSED;
   thread_add_unuse (m, thread);
   return fetch;
 }
 
+/* Move the read or write thread registered for fd onto the ready list. */
 static int
-thread_process_fd (struct thread_list *list, fd_set *fdset, fd_set *mfdset)
+thread_process_fd (struct thread_master *m, int type, int fd)
 {
   struct thread *thread;
-  struct thread *next;
-  int ready = 0;
-  
-  assert (list);
-  
-  for (thread = list->head; thread; thread = next)
+
+  if (fd >= m->fd_size)
+    return 0;
+
+  thread = (type == THREAD_READ) ? m->fd_read[fd] : m->fd_write[fd];
+  if (!thread)
+    return 0;
+
+  thread_list_delete ((type == THREAD_READ) ? &m->read : &m->write, thread);
+  thread_fd_set (m, type, fd, NULL);
+  thread_list_add (&m->ready, thread);
+  thread->type = THREAD_READY;
+  return 1;
+}
+
+/* Wait for I/O readiness or until timer_wait expires.  Returns the number
+ * of ready descriptors, 0 on timeout and -1 on error, as select() does.
+ */
+static int
+thread_io_wait (struct thread_master *m, fd_set *readfd, fd_set *writefd,
+                fd_set *exceptfd, int nfds, struct timeval *timer_wait)
+{
+#if defined(HAVE_EPOLL)
+  if (m->io_fd >= 0)
     {
-      next = thread->next;
+      int timeout = -1;
 
-      if (FD_ISSET (THREAD_FD (thread), fdset))
+      /* Round up, so we never wake just before a timer is due. */
+      if (timer_wait)
+        timeout = timer_wait->tv_sec * 1000
+                  + (timer_wait->tv_usec + 999) / 1000;
+      return epoll_wait (m->io_fd, m->io_events, THREAD_IO_EVENTS, timeout);
+    }
+#elif defined(HAVE_KQUEUE)
+  if (m->io_fd >= 0)
+    {
+      struct timespec ts;
+
+      if (timer_wait)
         {
-          assert (FD_ISSET (THREAD_FD (thread), mfdset));
-          FD_CLR(THREAD_FD (thread), mfdset);
-          thread_list_delete (list, thread);
-          thread_list_add (&thread->master->ready, thread);
-          thread->type = THREAD_READY;
-          ready++;
+          ts.tv_sec = timer_wait->tv_sec;
+          ts.tv_nsec = timer_wait->tv_usec * 1000;
+        }
+      return kevent (m->io_fd, NULL, 0, m->io_events, THREAD_IO_EVENTS,
+                     timer_wait ? &ts : NULL);
+    }
+#endif
+  return select (nfds, readfd, writefd, exceptfd, timer_wait);
+}
+
+/* Move the threads of the num descriptors reported by thread_io_wait()
+ * onto the ready list. */
+static void
+thread_io_dispatch (struct thread_master *m, int num,
+                    fd_set *readfd, fd_set *writefd)
+{
+  int fd;
+
+#if defined(HAVE_EPOLL)
+  if (m->io_fd >= 0)
+    {
+      struct epoll_event *ev = m->io_events;
+      int i;
+
+      for (i = 0; i < num; i++)
+        {
+          fd = ev[i].data.fd;
+          if (fd >= m->fd_size)
+            continue;
+
+          /* One-shot: the kernel has disarmed the descriptor. */
+          m->fd_armed[fd] &= THREAD_IO_REGISTERED;
+          if (ev[i].events & (EPOLLIN|EPOLLHUP|EPOLLERR))
+            thread_process_fd (m, THREAD_READ, fd);
+          if (ev[i].events & (EPOLLOUT|EPOLLHUP|EPOLLERR))
+            thread_process_fd (m, THREAD_WRITE, fd);
+          /* Re-arm whichever direction is still waiting. */
+          thread_io_update (m, fd);
+        }
+      return;
+    }
+#elif defined(HAVE_KQUEUE)
+  if (m->io_fd >= 0)
+    {
+      struct kevent *kev = m->io_events;
+      int i;
+
+      for (i = 0; i < num; i++)
+        {
+          fd = kev[i].ident;
+          if (fd >= m->fd_size || (kev[i].flags & EV_ERROR))
+            continue;
+          if (kev[i].filter == EVFILT_READ)
+            {
+              m->fd_armed[fd] &= ~THREAD_IO_READ;
+              thread_process_fd (m, THREAD_READ, fd);
+            }
+          else if (kev[i].filter == EVFILT_WRITE)
+            {
+              m->fd_armed[fd] &= ~THREAD_IO_WRITE;
+              thread_process_fd (m, THREAD_WRITE, fd);
+            }
+        }
+      return;
+    }
+#endif
+
+  /* select(): walk the descriptor range, but never the thread lists. */
+  for (fd = 0; fd <= m->fd_max && num > 0; fd++)
+    {
+      if (FD_ISSET (fd, readfd))
+        {
+          num--;
+          thread_process_fd (m, THREAD_READ, fd);
+        }
+      if (FD_ISSET (fd, writefd))
+        {
+          num--;
+          thread_process_fd (m, THREAD_WRITE, fd);
         }
     }
-  return ready;
 }
 
 /* Add all timers that have popped to the ready list. */
 static unsigned int
-thread_timer_process (struct thread_list *list, struct timeval *timenow)
+thread_timer_process (struct pqueue *queue, struct timeval *timenow)
 {
   struct thread *thread;
-  struct thread *next;
   unsigned int ready = 0;
   
-  for (thread = list->head; thread; thread = next)
+  while (queue->size)
     {
-      next = thread->next;
+      thread = queue->array[0];
       if (timeval_cmp (*timenow, thread->u.sands) < 0)
         return ready;
-      thread_list_delete (list, thread);
+      pqueue_dequeue (queue);
       thread->type = THREAD_READY;
       thread_list_add (&thread->master->ready, thread);
       ready++;
@@ -1061,10 +1901,10 @@ thread_fetch (struct thread_master *m, struct thread *fetch)
   while (1)
     {
       int num = 0;
+      int nfds;
 #if defined HAVE_SNMP && defined SNMP_AGENTX
       struct timeval snmp_timer_wait;
       int snmpblock = 0;
-      int fdsetsize;
 #endif
       
       /* Signals pre-empt everything */
@@ -1084,17 +1924,21 @@ thread_fetch (struct thread_master *m, struct thread *fetch)
       /* Normal event are the next highest priority.  */
       thread_process (&m->event);
       
-      /* Structure copy.  */
-      readfd = m->readfd;
-      writefd = m->writefd;
-      exceptfd = m->exceptfd;
+      /* Structure copy, only needed for select().  */
+      if (m->io_fd < 0)
+        {
+          readfd = m->readfd;
+          writefd = m->writefd;
+          exceptfd = m->exceptfd;
+        }
+      nfds = m->fd_max + 1;
       
       /* Calculate select wait timer if nothing else to do */
       if (m->ready.count == 0)
         {
           quagga_get_relative (NULL);
-          timer_wait = thread_timer_wait (&m->timer, &timer_val);
-          timer_wait_bg = thread_timer_wait (&m->background, &timer_val_bg);
+          timer_wait = thread_timer_wait (m->timer, &timer_val);
+          timer_wait_bg = thread_timer_wait (m->background, &timer_val_bg);
           
           if (timer_wait_bg &&
               (!timer_wait || (timeval_cmp (*timer_wait, *timer_wait_bg) > 0)))
@@ -1109,26 +1953,27 @@ thread_fetch (struct thread_master *m, struct thread *fetch)
 	 new timer only if it is still set to 0. */
       if (agentx_enabled)
         {
-          fdsetsize = FD_SETSIZE;
           snmpblock = 1;
           if (timer_wait)
             {
               snmpblock = 0;
               memcpy(&snmp_timer_wait, timer_wait, sizeof(struct timeval));
             }
-          snmp_select_info(&fdsetsize, &readfd, &snmp_timer_wait, &snmpblock);
+          snmp_select_info(&nfds, &readfd, &snmp_timer_wait, &snmpblock);
           if (snmpblock == 0)
             timer_wait = &snmp_timer_wait;
         }
 #endif
-      num = select (FD_SETSIZE, &readfd, &writefd, &exceptfd, timer_wait);
+      num = thread_io_wait (m, &readfd, &writefd, &exceptfd, nfds,
+                            timer_wait);
       
       /* Signals should get quick treatment */
       if (num < 0)
         {
           if (errno == EINTR)
             continue; /* signal received - process it */
-          zlog_warn ("select() error: %s", safe_strerror (errno));
+          zlog_warn ("%s error: %s", m->io_fd < 0 ? "select()" : "poll",
+                     safe_strerror (errno));
             return NULL;
         }
 
@@ -1150,16 +1995,11 @@ thread_fetch (struct thread_master *m, struct thread *fetch)
          priority than I/O threads, so let's push them onto the ready
 	 list in front of the I/O threads. */
       quagga_get_relative (NULL);
-      thread_timer_process (&m->timer, &relative_time);
+      thread_timer_process (m->timer, &relative_time);
       
       /* Got IO, process it */
       if (num > 0)
-        {
-          /* Normal priority read thead. */
-          thread_process_fd (&m->read, &readfd, &m->readfd);
-          /* Write thead. */
-          thread_process_fd (&m->write, &writefd, &m->writefd);
-        }
+        thread_io_dispatch (m, num, &readfd, &writefd);
 
 #if 0
       /* If any threads were made ready above (I/O or foreground timer),
@@ -1171,7 +2011,7 @@ thread_fetch (struct thread_master *m, struct thread *fetch)
 #endif
 
       /* Background timer/events, lowest priority */
-      thread_timer_process (&m->background, &relative_time);
+      thread_timer_process (m->background, &relative_time);
       
       if ((thread = thread_trim_head (&m->ready)) != NULL)
         return thread_run (m, thread, fetch);
@@ -1208,6 +2048,47 @@ thread_should_yield (struct thread *thread)
   	  THREAD_YIELD_TIME_SLOT);
 }
 
+/* Publish a count of dispatched threads in a small shared file, so that
+   a watchdog can tell a daemon that is busy but still running its event
+   loop from one that has stalled, without waiting on the daemon itself.
+   The file is recreated, like the vty socket it sits next to. */
+int
+thread_heartbeat_start (const char *path)
+{
+#if defined(HAVE_SYS_MMAN_H) && defined(HAVE_MMAP)
+  struct thread_heartbeat *hb;
+  int fd;
+
+  if (thread_heartbeat)
+    return 0;
+
+  unlink (path);
+  if ((fd = open (path, O_RDWR | O_CREAT | O_EXCL, 0660)) < 0)
+    return -1;
+  if (ftruncate (fd, sizeof (*hb)) < 0)
+    {
+      close (fd);
+      unlink (path);
+      return -1;
+    }
+  hb = mmap (NULL, sizeof (*hb), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close (fd);
+  if (hb == MAP_FAILED)
+    {
+      unlink (path);
+      return -1;
+    }
+
+  hb->magic = THREAD_HEARTBEAT_MAGIC;
+  hb->pid = getpid ();
+  hb->count = 0;
+  thread_heartbeat = hb;
+  return 0;
+#else
+  return -1;
+#endif /* HAVE_SYS_MMAN_H && HAVE_MMAP */
+}
+
 void
 thread_getrusage (RUSAGE_T *r)
 {
@@ -1226,14 +2107,37 @@ thread_getrusage (RUSAGE_T *r)
 #endif /* HAVE_CLOCK_MONOTONIC */
 }
 
-/* We check thread consumed time. If the system has getrusage, we'll
-   use that to get in-depth stats on the performance of the thread in addition
-   to wall clock time stats from gettimeofday. */
+/* CPU time used so far, in microseconds.  The calling thread's own
+   clock is used if there is one: it is cheaper to read than getrusage(),
+   and leaves out other threads of the process. */
+static unsigned long
+thread_cputime (void)
+{
+#if defined(HAVE_CLOCK_MONOTONIC) && defined(CLOCK_THREAD_CPUTIME_ID)
+  struct timespec tp;
+
+  if (clock_gettime (CLOCK_THREAD_CPUTIME_ID, &tp) < 0)
+    return 0;
+  return tp.tv_sec * 1000000UL + tp.tv_nsec / 1000;
+#elif defined(HAVE_RUSAGE)
+  struct rusage ru;
+
+  getrusage (RUSAGE_SELF, &ru);
+  return (ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1000000UL
+	 + ru.ru_utime.tv_usec + ru.ru_stime.tv_usec;
+#else
+  return 0;
+#endif
+}
+
+/* We check thread consumed time: wall clock time from the monotonic
+   clock, and CPU time if the system can tell, see thread_cputime().
+   Wall clock time also goes into a histogram of the task's latency. */
 void
 thread_call (struct thread *thread)
 {
   unsigned long realtime, cputime;
-  RUSAGE_T before, after;
+  unsigned long cpu_before;
 
  /* Cache a pointer to the relevant cpu history thread, if the thread
   * does not have it yet.
@@ -1242,27 +2146,28 @@ thread_call (struct thread *thread)
   * thread->cpu is NULL
   */
   if (!thread->hist)
-    {
-      struct cpu_thread_history tmp;
-      
-      tmp.func = thread->func;
-      strcpy(tmp.funcname, thread->funcname);
-      
-      thread->hist = hash_get (cpu_record, &tmp, 
-                    (void * (*) (void *))cpu_record_hash_alloc);
-    }
+    thread->hist = cpu_record_get (thread->func, thread->funcname);
 
-  GETRUSAGE (&before);
-  thread->real = before.real;
+  quagga_get_relative (NULL);
+#ifdef HAVE_CLOCK_MONOTONIC
+  /* See thread_getrusage(). */
+  quagga_gettimeofday (&recent_time);
+#endif /* HAVE_CLOCK_MONOTONIC */
+  thread->real = relative_time;
+  cpu_before = thread_cputime ();
 
+  QUAGGA_TRACE (lib, thread_entry, thread->funcname, thread->func);
   (*thread->func) (thread);
 
-  GETRUSAGE (&after);
+  quagga_get_relative (NULL);
+  realtime = timeval_elapsed (relative_time, thread->real);
+  cputime = thread_cputime () - cpu_before;
+  QUAGGA_TRACE (lib, thread_exit, thread->funcname, realtime, cputime);
 
-  realtime = thread_consumed_time (&after, &before, &cputime);
   thread->hist->real.total += realtime;
   if (thread->hist->real.max < realtime)
     thread->hist->real.max = realtime;
+  thread->hist->real_hist[cpu_record_bucket (realtime)]++;
 #ifdef HAVE_RUSAGE
   thread->hist->cpu.total += cputime;
   if (thread->hist->cpu.max < cputime)
@@ -1272,6 +2177,12 @@ thread_call (struct thread *thread)
   ++(thread->hist->total_calls);
   thread->hist->types |= (1 << thread->add_type);
 
+  if (thread->master && thread->master->lag.slowest_real <= realtime)
+    {
+      thread->master->lag.slowest = thread->hist;
+      thread->master->lag.slowest_real = realtime;
+    }
+
 #ifdef CONSUMED_TIME_CHECK
   if (realtime > CONSUMED_TIME_CHECK)
     {
@@ -37,6 +37,8 @@ struct rusage_t
 #define GETRUSAGE(X) thread_getrusage(X)
 
 /* Linked list of thread. */
+struct thread_inbox;
+
 struct thread_list
 {
   struct thread *head;
@@ -49,15 +51,40 @@ struct thread_master
 {
   struct thread_list read;
   struct thread_list write;
-  struct thread_list timer;
+  struct pqueue *timer;
   struct thread_list event;
   struct thread_list ready;
   struct thread_list unuse;
-  struct thread_list background;
+  struct pqueue *background;
+  int timer_peak;		/* high-water mark of timer queue */
+  int background_peak;
   fd_set readfd;
   fd_set writefd;
   fd_set exceptfd;
+  /* Read/write threads indexed by file descriptor. */
+  struct thread **fd_read;
+  struct thread **fd_write;
+  u_char *fd_armed;		/* events registered with the I/O backend */
+  int fd_size;
+  int fd_max;
+  /* epoll/kqueue descriptor, or -1 when falling back to select(). */
+  int io_fd;
+  void *io_events;
   unsigned long alloc;
+  /* Event loop lag: how late timers were dispatched, see thread_run(). */
+  struct thread_lag
+  {
+    unsigned long timers;	/* timers dispatched */
+    unsigned long total;	/* sum of their lateness, usecs */
+    unsigned long max;
+    unsigned long late;		/* later than thread_lag_warn */
+    int ready_peak;		/* high-water mark of ready list */
+    /* Longest task since the last timer was dispatched. */
+    struct cpu_thread_history *slowest;
+    unsigned long slowest_real;
+  } lag;
+  /* Events posted from other pthreads, see thread_post_event(). */
+  struct thread_inbox *inbox;
 };
 
 typedef unsigned char thread_type;
@@ -73,6 +100,7 @@ struct thread
   struct thread *next;		/* next pointer of the thread */   
   struct thread *prev;		/* previous pointer of the thread */
   struct thread_master *master;	/* pointer to the struct thread_master. */
+  int index;			/* position in timer queue */
   int (*func) (struct thread *); /* event function */
   void *arg;			/* event argument */
   union {
@@ -85,6 +113,11 @@ struct thread
   char funcname[FUNCNAME_LEN];
 };
 
+/* Buckets of the wall-clock latency histogram of a task: bucket 0 counts
+   the calls that took less than a microsecond, bucket i those that took
+   [2^(i-1), 2^i) microseconds, and the last one anything longer. */
+#define THREAD_HIST_BUCKETS 24
+
 struct cpu_thread_history 
 {
   int (*func)(struct thread *);
@@ -96,6 +129,7 @@ struct cpu_thread_history
 #ifdef HAVE_RUSAGE
   struct time_stats cpu;
 #endif
+  unsigned int real_hist[THREAD_HIST_BUCKETS];
   thread_type types;
   char funcname[FUNCNAME_LEN];
 };
@@ -169,6 +203,10 @@ enum quagga_clkid {
 #define thread_add_event(m,f,a,v) funcname_thread_add_event(m,f,a,v,#f)
 #define thread_execute(m,f,a,v) funcname_thread_execute(m,f,a,v,#f)
 
+/* The only way to schedule a thread from a pthread other than the one
+ * running the master: it is run as an event, soon after. */
+#define thread_post_event(m,f,a,v) funcname_thread_post_event(m,f,a,v,#f)
+
 /* The 4th arg to thread_add_background is the # of milliseconds to delay. */
 #define thread_add_background(m,f,a,v) funcname_thread_add_background(m,f,a,v,#f)
 
@@ -199,6 +237,9 @@ extern struct thread *funcname_thread_add_background (struct thread_master *,
 extern struct thread *funcname_thread_execute (struct thread_master *,
                                                int (*)(struct thread *),
                                                void *, int, const char *);
+extern int funcname_thread_post_event (struct thread_master *,
+                                       int (*)(struct thread *),
+                                       void *, int, const char *);
 extern void thread_cancel (struct thread *);
 extern unsigned int thread_cancel_event (struct thread_master *, void *);
 extern struct thread *thread_fetch (struct thread_master *, struct thread *);
@@ -206,10 +247,38 @@ extern void thread_call (struct thread *);
 extern unsigned long thread_timer_remain_second (struct thread *);
 extern int thread_should_yield (struct thread *);
 
+/* Call func on the accounting record of every known thread function. */
+extern void thread_cpu_record_walk (void (*func) (struct cpu_thread_history *,
+                                                  void *),
+                                    void *arg);
+
 /* Internal libzebra exports */
 extern void thread_getrusage (RUSAGE_T *);
 extern struct cmd_element show_thread_cpu_cmd;
+extern struct cmd_element show_thread_latency_cmd;
 extern struct cmd_element clear_thread_cpu_cmd;
+extern struct cmd_element show_thread_timers_cmd;
+extern struct cmd_element show_thread_lag_cmd;
+extern struct cmd_element clear_thread_lag_cmd;
+extern struct cmd_element thread_lag_warning_cmd;
+extern struct cmd_element no_thread_lag_warning_cmd;
+
+/* Warn about timers dispatched this many msecs late, 0 for never. */
+extern unsigned long thread_lag_warn;
+
+/* Event loop heartbeat shared with watchquagga: count is bumped for
+   every thread dispatched, see thread_heartbeat_start(). */
+#define THREAD_HEARTBEAT_MAGIC	0x51484254	/* "QHBT" */
+#define THREAD_HEARTBEAT_SUFFIX	".heartbeat"
+
+struct thread_heartbeat
+{
+  u_int32_t magic;
+  u_int32_t pid;
+  u_int64_t count;
+};
+
+extern int thread_heartbeat_start (const char *path);
 
 /* replacements for the system gettimeofday(), clock_gettime() and
  * time() functions, providing support for non-decrementing clock on
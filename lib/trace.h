@@ -0,0 +1,45 @@
+/* Static tracepoints.
+   Copyright (C) 2026 The Quagga project
+
+This file is part of GNU Zebra.
+
+GNU Zebra is free software; you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation; either version 2, or (at your option) any
+later version.
+
+GNU Zebra is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with GNU Zebra; see the file COPYING.  If not, write to the Free
+Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+02111-1307, USA.  */
+
+#ifndef _ZEBRA_TRACE_H
+#define _ZEBRA_TRACE_H
+
+/* QUAGGA_TRACE (provider, name, args...) marks a USDT probe point, for
+ * perf, bpftrace or systemtap to attach to, e.g.
+ *
+ *   bpftrace -e 'usdt:/usr/sbin/bgpd:bgpd:update_receive
+ *                { @[str(arg0)] = count(); }'
+ *
+ * With --enable-usdt a probe is a single nop in the code plus a note in
+ * the binary naming it and where its arguments live; nothing runs until
+ * a tracer attaches.  Without, probes compile to nothing and their
+ * arguments are not evaluated.  Arguments are at most 12 integers or
+ * pointers, and should be cheap to compute, as they are computed on
+ * every pass whether traced or not.
+ */
+#ifdef HAVE_USDT
+#include <sys/sdt.h>
+#define QUAGGA_TRACE(provider, name, ...) \
+  STAP_PROBEV (provider, name, ## __VA_ARGS__)
+#else
+#define QUAGGA_TRACE(provider, name, ...) do { } while (0)
+#endif /* HAVE_USDT */
+
+#endif /* _ZEBRA_TRACE_H */
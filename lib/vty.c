@@ -33,6 +33,8 @@
 #include "log.h"
 #include "prefix.h"
 #include "filter.h"
+#include "plist.h"
+#include "routemap.h"
 #include "vty.h"
 #include "privs.h"
 #include "network.h"
@@ -96,9 +98,6 @@ vty_out (struct vty *vty, const char *format, ...)
 {
   va_list args;
   int len = 0;
-  int size = 1024;
-  char buf[1024];
-  char *p = NULL;
 
   if (vty_shell (vty))
     {
@@ -108,88 +107,92 @@ vty_out (struct vty *vty, const char *format, ...)
     }
   else
     {
-      /* Try to write to initial buffer.  */
+      /* Formatted straight into the output buffer. */
       va_start (args, format);
-      len = vsnprintf (buf, sizeof buf, format, args);
+      len = buffer_vprintf (vty->obuf, format, args);
       va_end (args);
-
-      /* Initial buffer is not enough.  */
-      if (len < 0 || len >= size)
-	{
-	  while (1)
-	    {
-	      if (len > -1)
-		size = len + 1;
-	      else
-		size = size * 2;
-
-	      p = XREALLOC (MTYPE_VTY_OUT_BUF, p, size);
-	      if (! p)
-		return -1;
-
-	      va_start (args, format);
-	      len = vsnprintf (p, size, format, args);
-	      va_end (args);
-
-	      if (len > -1 && len < size)
-		break;
-	    }
-	}
-
-      /* When initial buffer is enough to store all output.  */
-      if (! p)
-	p = buf;
-
-      /* Pointer p must point out buffer. */
-      buffer_put (vty->obuf, (u_char *) p, len);
-
-      /* If p is not different with buf, it is allocated buffer.  */
-      if (p != buf)
-	XFREE (MTYPE_VTY_OUT_BUF, p);
     }
 
   return len;
 }
 
+/* Render a log message for the terminal monitors into buf, with the
+   timestamp and "\r\n" on the end.  Returns the length, or -1 if it did
+   not fit. */
 static int
-vty_log_out (struct vty *vty, const char *level, const char *proto_str,
-	     const char *format, struct timestamp_control *ctl, va_list va)
+vty_log_format (char *buf, size_t size, const char *level,
+		const char *proto_str, const char *format,
+		struct timestamp_control *ctl, va_list va)
 {
   int ret;
   int len;
-  char buf[1024];
 
   if (!ctl->already_rendered)
     {
       ctl->len = quagga_timestamp(ctl->precision, ctl->buf, sizeof(ctl->buf));
       ctl->already_rendered = 1;
     }
-  if (ctl->len+1 >= sizeof(buf))
+  if (ctl->len+1 >= size)
     return -1;
   memcpy(buf, ctl->buf, len = ctl->len);
   buf[len++] = ' ';
   buf[len] = '\0';
 
   if (level)
-    ret = snprintf(buf+len, sizeof(buf)-len, "%s: %s: ", level, proto_str);
+    ret = snprintf(buf+len, size-len, "%s: %s: ", level, proto_str);
   else
-    ret = snprintf(buf+len, sizeof(buf)-len, "%s: ", proto_str);
-  if ((ret < 0) || ((size_t)(len += ret) >= sizeof(buf)))
+    ret = snprintf(buf+len, size-len, "%s: ", proto_str);
+  if ((ret < 0) || ((size_t)(len += ret) >= size))
     return -1;
 
-  if (((ret = vsnprintf(buf+len, sizeof(buf)-len, format, va)) < 0) ||
-      ((size_t)((len += ret)+2) > sizeof(buf)))
+  if (((ret = vsnprintf(buf+len, size-len, format, va)) < 0) ||
+      ((size_t)((len += ret)+2) > size))
     return -1;
 
   buf[len++] = '\r';
   buf[len++] = '\n';
+  return len;
+}
+
+/* Queue a rendered log message on a terminal monitor.  The message goes
+   through the vty's output buffer, so that it is written when the socket
+   takes it rather than the daemon waiting on a slow terminal.  Once
+   VTY_MONITOR_MAX bytes are queued further messages are dropped and
+   counted, and the count is reported ahead of the next one that fits. */
+static void
+vty_log_out (struct vty *vty, const char *buf, size_t len)
+{
+  char note[64];
+  int notelen;
+  buffer_status_t ret;
+
+  if (vty->status == VTY_CLOSE)
+    return;
+
+  if (buffer_length (vty->obuf) >= VTY_MONITOR_MAX)
+    {
+      vty->monitor_dropped++;
+      vty->monitor_unreported++;
+      return;
+    }
 
-  if (write(vty->fd, buf, len) < 0)
+  if (vty->monitor_unreported)
     {
-      if (ERRNO_IO_RETRY(errno))
-	/* Kernel buffer is full, probably too much debugging output, so just
-	   drop the data and ignore. */
-	return -1;
+      notelen = snprintf (note, sizeof (note),
+			  "%% %lu log messages dropped\r\n",
+			  vty->monitor_unreported);
+      vty->monitor_unreported = 0;
+      buffer_put (vty->obuf, note, notelen);
+    }
+
+  /* buffer_write logs its errors, which must not come back here. */
+  vty->monitor = 0;
+  ret = buffer_write (vty->obuf, vty->fd, buf, len);
+  vty->monitor = 1;
+
+  switch (ret)
+    {
+    case BUFFER_ERROR:
       /* Fatal I/O error. */
       vty->monitor = 0; /* disable monitoring to avoid infinite recursion */
       zlog_warn("%s: write failed to vty client fd %d, closing: %s",
@@ -199,9 +202,24 @@ vty_log_out (struct vty *vty, const char *level, const char *proto_str,
          to access the vty struct */
       vty->status = VTY_CLOSE;
       shutdown(vty->fd, SHUT_RDWR);
-      return -1;
+      break;
+    case BUFFER_PENDING:
+      /* At a --More-- prompt the rest waits for the key press. */
+      if (vty->status != VTY_NORMAL || vty->t_write)
+	break;
+#ifdef VTYSH
+      if (vty->type == VTY_SHELL_SERV)
+	vty_event (VTYSH_WRITE, vty->fd, vty);
+      else
+#endif /* VTYSH */
+	{
+	  vty->monitor_pending = 1;
+	  vty_event (VTY_WRITE, vty->fd, vty);
+	}
+      break;
+    case BUFFER_EMPTY:
+      break;
     }
-  return 0;
 }
 
 /* Output current time to the vty. */
@@ -1273,6 +1291,9 @@ vty_execute (struct vty *vty)
 
   ret = CMD_SUCCESS;
 
+  /* Any monitor output still queued is paged with the command's. */
+  vty->monitor_pending = 0;
+
   switch (vty->node)
     {
     case AUTH_NODE:
@@ -1557,6 +1578,29 @@ vty_flush (struct thread *thread)
 
   vty->t_write = NULL;
 
+  /* Terminal monitor output queued while the vty was idle is written out
+     as the socket takes it, without the --More-- paging. */
+  if (vty->monitor_pending)
+    {
+      switch (buffer_flush_available (vty->obuf, vty_sock))
+	{
+	case BUFFER_ERROR:
+	  vty->monitor = 0; /* disable monitoring to avoid infinite recursion */
+	  zlog_warn("buffer_flush failed on vty client fd %d, closing",
+		    vty->fd);
+	  buffer_reset(vty->obuf);
+	  vty_close(vty);
+	  break;
+	case BUFFER_PENDING:
+	  vty_event (VTY_WRITE, vty_sock, vty);
+	  break;
+	case BUFFER_EMPTY:
+	  vty->monitor_pending = 0;
+	  break;
+	}
+      return 0;
+    }
+
   /* Tempolary disable read thread. */
   if ((vty->lines == 0) && vty->t_read)
     {
@@ -1910,6 +1954,31 @@ vty_serv_sock_family (const char* addr, unsigned short port, int family)
 /* For sockaddr_un. */
 #include <sys/un.h>
 
+/* Event loop heartbeat for watchquagga, next to the vtysh socket:
+   bgpd.vty gets bgpd.heartbeat. */
+static void
+vty_serv_heartbeat (const char *path, gid_t gid)
+{
+  char hbpath[MAXPATHLEN];
+  size_t len = strlen (path);
+
+  if (len > 4 && ! strcmp (path + len - 4, ".vty"))
+    len -= 4;
+  if (snprintf (hbpath, sizeof (hbpath), "%.*s%s", (int) len, path,
+                THREAD_HEARTBEAT_SUFFIX) >= (int) sizeof (hbpath))
+    return;
+
+  if (thread_heartbeat_start (hbpath) < 0)
+    {
+      zlog_warn ("Cannot create heartbeat file %s: %s", hbpath,
+                 safe_strerror (errno));
+      return;
+    }
+  if (gid > 0 && chown (hbpath, -1, gid))
+    zlog_err ("vty_serv_un: could chown heartbeat file, %s",
+              safe_strerror (errno));
+}
+
 /* VTY shell UNIX domain socket. */
 static void
 vty_serv_un (const char *path)
@@ -1974,6 +2043,8 @@ vty_serv_un (const char *path)
         }
     }
 
+  vty_serv_heartbeat (path, ids.gid_vty);
+
   vty_event (VTYSH_SERV, sock, NULL);
 }
 
@@ -2233,9 +2304,19 @@ vty_read_file (FILE *confp)
   vty->type = VTY_TERM;
   vty->node = CONFIG_NODE;
   
+  /* Filter and route map changes are applied to their users once the
+     whole file is read, not after every line. */
+  access_list_hook_defer (1);
+  prefix_list_hook_defer (1);
+  route_map_hook_defer (1);
+
   /* Execute configuration file */
   ret = config_from_file (vty, confp);
 
+  access_list_hook_defer (0);
+  prefix_list_hook_defer (0);
+  route_map_hook_defer (0);
+
   if ( !((ret == CMD_SUCCESS) || (ret == CMD_ERR_NOTHING_TODO)) ) 
     {
       switch (ret)
@@ -2423,13 +2504,17 @@ vty_read_config (char *config_file,
     XFREE (MTYPE_TMP, fullpath);
 }
 
-/* Small utility function which output log to the VTY. */
+/* Small utility function which output log to the VTY.  The message is
+   rendered once, on finding the first terminal monitor, and the same
+   text is queued on each of them. */
 void
 vty_log (const char *level, const char *proto_str,
 	 const char *format, struct timestamp_control *ctl, va_list va)
 {
   unsigned int i;
   struct vty *vty;
+  char buf[1024];
+  int len = 0;
   
   if (!vtyvec)
     return;
@@ -2438,10 +2523,17 @@ vty_log (const char *level, const char *proto_str,
     if ((vty = vector_slot (vtyvec, i)) != NULL)
       if (vty->monitor)
 	{
-	  va_list ac;
-	  va_copy(ac, va);
-	  vty_log_out (vty, level, proto_str, format, ctl, ac);
-	  va_end(ac);
+	  if (len == 0)
+	    {
+	      va_list ac;
+	      va_copy(ac, va);
+	      len = vty_log_format (buf, sizeof (buf), level, proto_str,
+				    format, ctl, ac);
+	      va_end(ac);
+	    }
+	  if (len < 0)
+	    return;
+	  vty_log_out (vty, buf, len);
 	}
 }
 
@@ -2560,9 +2652,15 @@ DEFUN (config_who,
 
   for (i = 0; i < vector_active (vtyvec); i++)
     if ((v = vector_slot (vtyvec, i)) != NULL)
-      vty_out (vty, "%svty[%d] connected from %s.%s",
-	       v->config ? "*" : " ",
-	       i, v->address, VTY_NEWLINE);
+      {
+	vty_out (vty, "%svty[%d] connected from %s.",
+		 v->config ? "*" : " ",
+		 i, v->address);
+	if (v->monitor)
+	  vty_out (vty, " Monitor, %lu log messages dropped.",
+		   v->monitor_dropped);
+	vty_out (vty, "%s", VTY_NEWLINE);
+      }
   return CMD_SUCCESS;
 }
 
@@ -2776,6 +2874,7 @@ DEFUN (terminal_monitor,
        "Copy debug output to the current terminal line\n")
 {
   vty->monitor = 1;
+  vty->monitor_dropped = vty->monitor_unreported = 0;
   return CMD_SUCCESS;
 }
 
@@ -103,8 +103,14 @@ struct vty
   /* Configure lines. */
   int lines;
 
-  /* Terminal monitor. */
+  /* Terminal monitor, and the log messages dropped while its output
+     buffer was full: in all, and not yet reported to it. */
   int monitor;
+  unsigned long monitor_dropped;
+  unsigned long monitor_unreported;
+
+  /* The output buffer holds only monitor output, written unpaged. */
+  int monitor_pending;
 
   /* In configure mode. */
   int config;
@@ -130,6 +136,10 @@ struct vty
 /* Default time out value */
 #define VTY_TIMEOUT_DEFAULT 600
 
+/* Log output queued on a terminal monitor beyond which further
+   messages are dropped. */
+#define VTY_MONITOR_MAX (64 * 1024)
+
 /* Vty read buffer size. */
 #define VTY_READ_BUFSIZ 512
 
@@ -0,0 +1,160 @@
+/*
+ * Timer wheel: one second buckets for many coarse timers.
+ *
+ * This file is part of GNU Zebra.
+ *
+ * GNU Zebra is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * GNU Zebra is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Zebra; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.  
+ */
+
+#include <zebra.h>
+
+#include "memory.h"
+#include "thread.h"
+#include "wheel.h"
+
+static int wheel_tick (struct thread *);
+
+static void
+wheel_timer_link (struct wheel_timer *head, struct wheel_timer *timer)
+{
+  timer->prev = head->prev;
+  timer->next = head;
+  head->prev->next = timer;
+  head->prev = timer;
+}
+
+static void
+wheel_timer_unlink (struct wheel_timer *timer)
+{
+  timer->prev->next = timer->next;
+  timer->next->prev = timer->prev;
+  timer->prev = timer->next = NULL;
+}
+
+struct wheel *
+wheel_new (struct thread_master *master, unsigned int size)
+{
+  struct wheel *wheel;
+  struct timeval now;
+  unsigned int i;
+
+  wheel = XCALLOC (MTYPE_WHEEL, sizeof (struct wheel));
+  wheel->master = master;
+  wheel->size = size;
+  wheel->buckets = XCALLOC (MTYPE_WHEEL, size * sizeof (struct wheel_timer));
+  for (i = 0; i < size; i++)
+    wheel->buckets[i].prev = wheel->buckets[i].next = &wheel->buckets[i];
+
+  /* Also brings the relative time the timers are armed with up to date */
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &now);
+  wheel->now = now.tv_sec;
+
+  wheel->t_tick = thread_add_timer (master, wheel_tick, wheel, 1);
+  return wheel;
+}
+
+void
+wheel_free (struct wheel *wheel)
+{
+  unsigned int i;
+
+  THREAD_TIMER_OFF (wheel->t_tick);
+  for (i = 0; i < wheel->size; i++)
+    while (wheel->buckets[i].next != &wheel->buckets[i])
+      wheel_timer_unlink (wheel->buckets[i].next);
+  XFREE (MTYPE_WHEEL, wheel->buckets);
+  XFREE (MTYPE_WHEEL, wheel);
+}
+
+void
+wheel_timer_on (struct wheel *wheel, struct wheel_timer *timer,
+                int (*func) (struct wheel_timer *), void *arg, long seconds)
+{
+  if (WHEEL_TIMER_ARMED (timer))
+    wheel_timer_unlink (timer);
+  else
+    wheel->count++;
+
+  timer->expire = recent_relative_time ().tv_sec + seconds;
+  /* The bucket of the current second has run already */
+  if (timer->expire <= wheel->now)
+    timer->expire = wheel->now + 1;
+  timer->func = func;
+  timer->arg = arg;
+  wheel_timer_link (&wheel->buckets[timer->expire % wheel->size], timer);
+}
+
+void
+wheel_timer_off (struct wheel *wheel, struct wheel_timer *timer)
+{
+  if (!WHEEL_TIMER_ARMED (timer))
+    return;
+  wheel_timer_unlink (timer);
+  wheel->count--;
+}
+
+long
+wheel_timer_remain (struct wheel_timer *timer)
+{
+  long remain;
+
+  remain = timer->expire - recent_relative_time ().tv_sec;
+  return remain > 0 ? remain : 0;
+}
+
+/* Run the buckets of the seconds gone since the last tick.  The timers
+   due are moved to a list of their own first, so that they can turn
+   off or re-arm each other as they run. */
+static int
+wheel_tick (struct thread *thread)
+{
+  struct wheel *wheel = THREAD_ARG (thread);
+  struct wheel_timer due, *timer, *next, *head;
+  time_t now, sec, end;
+
+  wheel->t_tick = thread_add_timer (wheel->master, wheel_tick, wheel, 1);
+
+  now = recent_relative_time ().tv_sec;
+  end = now;
+  if (end - wheel->now > (time_t) wheel->size)
+    end = wheel->now + wheel->size;
+
+  due.prev = due.next = &due;
+  for (sec = wheel->now + 1; sec <= end; sec++)
+    {
+      head = &wheel->buckets[sec % wheel->size];
+      for (timer = head->next; timer != head; timer = next)
+        {
+          next = timer->next;
+          if (timer->expire <= now)
+            {
+              wheel_timer_unlink (timer);
+              wheel_timer_link (&due, timer);
+            }
+        }
+    }
+  wheel->now = now;
+
+  while (due.next != &due)
+    {
+      timer = due.next;
+      wheel_timer_unlink (timer);
+      wheel->count--;
+      (*timer->func) (timer);
+    }
+
+  return 0;
+}
@@ -0,0 +1,67 @@
+/*
+ * Timer wheel: one second buckets for many coarse timers.
+ *
+ * This file is part of GNU Zebra.
+ *
+ * GNU Zebra is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * GNU Zebra is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Zebra; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.  
+ */
+
+#ifndef _ZEBRA_WHEEL_H
+#define _ZEBRA_WHEEL_H
+
+/* A timer kept in its owner, and linked into the bucket of the second
+   it expires in while armed.  Arming, re-arming and turning it off only
+   touch that bucket rather than the thread master's timer list, for the
+   timers of every route of a protocol.  Timers run at most a second
+   late, from a single thread ticking once a second. */
+struct wheel_timer
+{
+  struct wheel_timer *prev, *next;	/* NULL if not armed */
+  time_t expire;			/* relative time, in seconds */
+  int (*func) (struct wheel_timer *);
+  void *arg;
+};
+
+struct wheel
+{
+  struct thread_master *master;
+  unsigned int size;
+  struct wheel_timer *buckets;		/* list heads, size of them */
+  time_t now;				/* buckets up to now have run */
+  unsigned long count;			/* armed timers */
+  struct thread *t_tick;
+};
+
+#define WHEEL_TIMER_ARMED(T)  ((T)->next != NULL)
+#define WHEEL_ARG(T)          ((T)->arg)
+
+/* Buckets for a wheel: timers further away than that many seconds go
+   round it more than once. */
+#define WHEEL_SIZE_DEFAULT    512
+
+extern struct wheel *wheel_new (struct thread_master *, unsigned int size);
+/* Turns off the timers still armed. */
+extern void wheel_free (struct wheel *);
+
+/* (Re)arm timer to run func after seconds. */
+extern void wheel_timer_on (struct wheel *, struct wheel_timer *,
+                            int (*func) (struct wheel_timer *), void *arg,
+                            long seconds);
+extern void wheel_timer_off (struct wheel *, struct wheel_timer *);
+/* Seconds before an armed timer runs. */
+extern long wheel_timer_remain (struct wheel_timer *);
+
+#endif /* _ZEBRA_WHEEL_H */
@@ -29,28 +29,135 @@
 #include "command.h"
 #include "log.h"
 
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif /* HAVE_PTHREAD */
+
 /* master list of work_queues */
 static struct list work_queues;
 
 #define WORK_QUEUE_MIN_GRANULARITY 1
 
-static struct work_queue_item *
-work_queue_item_new (struct work_queue *wq)
+#ifdef HAVE_PTHREAD
+/* Items handed to each pool thread per run. */
+#define WORK_QUEUE_MT_BATCH 128
+
+/* A slice of a work queue's batch, for one pool thread to run. */
+struct wq_job
 {
-  struct work_queue_item *item;
-  assert (wq);
+  struct work_queue *wq;
+  unsigned int first, last;
+  struct wq_job *next;
+};
+
+/* Threads shared by all work queues with spec.threads set.  They only
+ * ever call workfuncs: the items they ran are taken off the queue by
+ * work_queue_mt_done(), posted to the queue's thread master once its
+ * whole batch is done.
+ */
+static struct
+{
+  pthread_mutex_t mtx;
+  pthread_cond_t work;
+  pthread_t threads[WORK_QUEUE_MAX_THREADS];
+  unsigned int count;
 
-  item = XCALLOC (MTYPE_WORK_QUEUE_ITEM, 
-                  sizeof (struct work_queue_item));
-  
-  return item;
+  /* jobs not taken by a thread yet */
+  struct wq_job *head, *tail;
+
+  int started;
+  int failed;
+} wq_pool;
+
+static int work_queue_mt_done (struct thread *);
+#endif /* HAVE_PTHREAD */
+
+/* Slots a ring starts with, and the most an empty one keeps. */
+#define WORK_QUEUE_RING_MIN	64
+#define WORK_QUEUE_RING_KEEP	4096
+
+/* Make room in ring for another item, doubling its slots. */
+static void
+work_queue_ring_grow (struct work_queue *wq, struct work_queue_ring *ring)
+{
+  struct work_queue_item *slots;
+  unsigned int size, i;
+
+  size = ring->size ? ring->size * 2 : WORK_QUEUE_RING_MIN;
+  slots = XMALLOC (MTYPE_WORK_QUEUE_ITEM, size * sizeof (*slots));
+  for (i = 0; i < ring->count; i++)
+    slots[i] = ring->slots[(ring->head + i) & (ring->size - 1)];
+
+  if (ring->slots)
+    XFREE (MTYPE_WORK_QUEUE_ITEM, ring->slots);
+  ring->slots = slots;
+  ring->size = size;
+  ring->head = 0;
+  wq->allocs++;
 }
 
+/* Put item back on the ring of its class, at the end or, if front is
+ * set, the head.  It stays counted in wq->count meanwhile.
+ */
 static void
-work_queue_item_free (struct work_queue_item *item)
+work_queue_push (struct work_queue *wq, struct work_queue_item *item,
+                 int front)
 {
-  XFREE (MTYPE_WORK_QUEUE_ITEM, item);
-  return;
+  struct work_queue_ring *ring = &wq->ring[item->prio];
+
+  if (ring->count == ring->size)
+    work_queue_ring_grow (wq, ring);
+
+  if (front)
+    {
+      ring->head = (ring->head - 1) & (ring->size - 1);
+      ring->slots[ring->head] = *item;
+    }
+  else
+    ring->slots[(ring->head + ring->count) & (ring->size - 1)] = *item;
+  ring->count++;
+}
+
+/* Take the first item of the most urgent class off its ring, into
+ * item.  Returns 0 if there is none.
+ */
+static int
+work_queue_pop (struct work_queue *wq, struct work_queue_item *item)
+{
+  struct work_queue_ring *ring;
+  unsigned int i;
+
+  for (i = 0; i < WORK_QUEUE_PRIOS; i++)
+    {
+      ring = &wq->ring[i];
+      if (ring->count == 0)
+        continue;
+
+      *item = ring->slots[ring->head];
+      ring->head = (ring->head + 1) & (ring->size - 1);
+
+      /* Give back what a burst of items grew the ring to. */
+      if (--ring->count == 0 && ring->size > WORK_QUEUE_RING_KEEP)
+        {
+          XFREE (MTYPE_WORK_QUEUE_ITEM, ring->slots);
+          ring->size = ring->head = 0;
+        }
+      return 1;
+    }
+  return 0;
+}
+
+/* Item has left the queue for good. */
+static void
+work_queue_item_done (struct work_queue *wq, struct work_queue_item *item)
+{
+  assert (item->data);
+
+  /* call private data deletion callback if needed */  
+  if (wq->spec.del_item_data)
+    wq->spec.del_item_data (wq, item->data);
+
+  wq->count--;
 }
 
 /* create new work queue */
@@ -68,16 +175,6 @@ work_queue_new (struct thread_master *m, const char *queue_name)
   new->master = m;
   SET_FLAG (new->flags, WQ_UNPLUGGED);
   
-  if ( (new->items = list_new ()) == NULL)
-    {
-      XFREE (MTYPE_WORK_QUEUE_NAME, new->name);
-      XFREE (MTYPE_WORK_QUEUE, new);
-      
-      return NULL;
-    }
-  
-  new->items->del = (void (*)(void *)) work_queue_item_free;  
-  
   listnode_add (&work_queues, new);
   
   new->cycles.granularity = WORK_QUEUE_MIN_GRANULARITY;
@@ -91,11 +188,35 @@ work_queue_new (struct thread_master *m, const char *queue_name)
 void
 work_queue_free (struct work_queue *wq)
 {
+  unsigned int i;
+
   if (wq->thread != NULL)
     thread_cancel(wq->thread);
+
+#ifdef HAVE_PTHREAD
+  if (wq->mt.size)
+    {
+      /* The pool threads may still be running workfuncs on our items. */
+      pthread_mutex_lock (&wq_pool.mtx);
+      while (wq->mt.jobs_left)
+	{
+	  pthread_mutex_unlock (&wq_pool.mtx);
+	  usleep (1000);
+	  pthread_mutex_lock (&wq_pool.mtx);
+	}
+      pthread_mutex_unlock (&wq_pool.mtx);
+      thread_cancel_event (wq->master, wq);
+
+      XFREE (MTYPE_WORK_QUEUE_MT, wq->mt.items);
+      XFREE (MTYPE_WORK_QUEUE_MT, wq->mt.status);
+      XFREE (MTYPE_WORK_QUEUE_MT, wq->mt.jobs);
+    }
+#endif /* HAVE_PTHREAD */
   
-  /* list_delete frees items via callback */
-  list_delete (wq->items);
+  /* as ever, the items' data is the user's to free */
+  for (i = 0; i < WORK_QUEUE_PRIOS; i++)
+    if (wq->ring[i].slots)
+      XFREE (MTYPE_WORK_QUEUE_ITEM, wq->ring[i].slots);
   listnode_delete (&work_queues, wq);
   
   XFREE (MTYPE_WORK_QUEUE_NAME, wq->name);
@@ -109,7 +230,7 @@ work_queue_schedule (struct work_queue *wq, unsigned int delay)
   /* if appropriate, schedule work queue thread */
   if ( CHECK_FLAG (wq->flags, WQ_UNPLUGGED)
        && (wq->thread == NULL)
-       && (listcount (wq->items) > 0) )
+       && (wq->count > 0) )
     {
       wq->thread = thread_add_background (wq->master, work_queue_run, 
                                           wq, delay);
@@ -120,48 +241,37 @@ work_queue_schedule (struct work_queue *wq, unsigned int delay)
 }
   
 void
-work_queue_add (struct work_queue *wq, void *data)
+work_queue_add_prio (struct work_queue *wq, void *data, unsigned int prio)
 {
-  struct work_queue_item *item;
+  struct work_queue_item item;
   
-  assert (wq);
+  assert (wq && data && prio < WORK_QUEUE_PRIOS);
 
-  if (!(item = work_queue_item_new (wq)))
-    {
-      zlog_err ("%s: unable to get new queue item", __func__);
-      return;
-    }
-  
-  item->data = data;
-  listnode_add (wq->items, item);
+  item.data = data;
+  item.ran = 0;
+  item.prio = prio;
+  work_queue_push (wq, &item, 0);
+  wq->count++;
   
   work_queue_schedule (wq, wq->spec.hold);
   
   return;
 }
 
-static void
-work_queue_item_remove (struct work_queue *wq, struct listnode *ln)
+void
+work_queue_add (struct work_queue *wq, void *data)
 {
-  struct work_queue_item *item = listgetdata (ln);
-
-  assert (item && item->data);
-
-  /* call private data deletion callback if needed */  
-  if (wq->spec.del_item_data)
-    wq->spec.del_item_data (wq, item->data);
-
-  list_delete_node (wq->items, ln);
-  work_queue_item_free (item);
-  
-  return;
+  work_queue_add_prio (wq, data, WORK_QUEUE_PRIOS - 1);
 }
 
-static void
-work_queue_item_requeue (struct work_queue *wq, struct listnode *ln)
+void
+work_queue_walk (void (*func) (struct work_queue *, void *), void *arg)
 {
-  LISTNODE_DETACH (wq->items, ln);
-  LISTNODE_ATTACH (wq->items, ln); /* attach to end of list */
+  struct listnode *node;
+  struct work_queue *wq;
+
+  for (ALL_LIST_ELEMENTS_RO ((&work_queues), node, wq))
+    func (wq, arg);
 }
 
 DEFUN(show_work_queues,
@@ -172,33 +282,47 @@ DEFUN(show_work_queues,
 {
   struct listnode *node;
   struct work_queue *wq;
+  unsigned long slots;
+  unsigned int i;
   
   vty_out (vty, 
-           "%c %8s %5s %8s %21s%s",
-           ' ', "List","(ms) ","Q. Runs","Cycle Counts   ",
+           "%c %8s %5s %8s %21s %17s%s",
+           ' ', "List","(ms) ","Q. Runs","Cycle Counts   ","Item Store   ",
            VTY_NEWLINE);
   vty_out (vty,
-           "%c %8s %5s %8s %7s %6s %6s %s%s",
+           "%c %8s %5s %8s %7s %6s %6s %8s %8s %s%s",
            'P',
            "Items",
            "Hold",
            "Total",
            "Best","Gran.","Avg.", 
+           "Slots","Allocs",
            "Name", 
            VTY_NEWLINE);
  
   for (ALL_LIST_ELEMENTS_RO ((&work_queues), node, wq))
     {
-      vty_out (vty,"%c %8d %5d %8ld %7d %6d %6u %s%s",
+      for (slots = 0, i = 0; i < WORK_QUEUE_PRIOS; i++)
+        slots += wq->ring[i].size;
+
+      vty_out (vty,"%c %8lu %5d %8ld %7d %6d %6u %8lu %8lu %s%s",
                (CHECK_FLAG (wq->flags, WQ_UNPLUGGED) ? ' ' : 'P'),
-               listcount (wq->items),
+               wq->count,
                wq->spec.hold,
                wq->runs,
                wq->cycles.best, wq->cycles.granularity,
                  (wq->runs) ? 
                    (unsigned int) (wq->cycles.total / wq->runs) : 0,
+               slots, wq->allocs,
                wq->name,
                VTY_NEWLINE);
+
+      /* depth of each priority class the queue names */
+      for (i = 0; i < WORK_QUEUE_PRIOS; i++)
+        if (wq->spec.prio_names[i])
+          vty_out (vty, "  %8u %*s%s%s",
+                   wq->ring[i].count, 57, "", wq->spec.prio_names[i],
+                   VTY_NEWLINE);
     }
     
   return CMD_SUCCESS;
@@ -230,6 +354,253 @@ work_queue_unplug (struct work_queue *wq)
   work_queue_schedule (wq, wq->spec.hold);
 }
 
+#ifdef HAVE_PTHREAD
+static void *
+work_queue_mt_thread (void *arg)
+{
+  struct wq_job *job;
+  struct work_queue *wq;
+  struct work_queue_item *item;
+  wq_item_status ret;
+  unsigned int i;
+  int last;
+
+  pthread_mutex_lock (&wq_pool.mtx);
+  while (1)
+    {
+      while (wq_pool.head == NULL)
+	pthread_cond_wait (&wq_pool.work, &wq_pool.mtx);
+      job = wq_pool.head;
+      if ((wq_pool.head = job->next) == NULL)
+	wq_pool.tail = NULL;
+      pthread_mutex_unlock (&wq_pool.mtx);
+
+      wq = job->wq;
+      for (i = job->first; i < job->last; i++)
+	{
+	  item = &wq->mt.items[i];
+	  do
+	    {
+	      ret = wq->spec.workfunc (wq, item->data);
+	      item->ran++;
+	    }
+	  while ((ret == WQ_RETRY_NOW)
+		 && (item->ran < wq->spec.max_retries));
+	  wq->mt.status[i] = ret;
+	}
+
+      /* jobs_left counts the post too, so that work_queue_free()
+       * waits for it. */
+      pthread_mutex_lock (&wq_pool.mtx);
+      last = (--wq->mt.jobs_left == 1);
+      if (last)
+	{
+	  pthread_mutex_unlock (&wq_pool.mtx);
+	  while (thread_post_event (wq->master, work_queue_mt_done, wq, 0) < 0)
+	    usleep (1000);
+	  pthread_mutex_lock (&wq_pool.mtx);
+	  wq->mt.jobs_left--;
+	}
+    }
+  return NULL;
+}
+
+/* Make sure the pool has up to 'want' threads, started on first use as
+ * threads do not survive daemon().  Returns how many it has.
+ */
+static unsigned int
+work_queue_mt_start (unsigned int want)
+{
+  sigset_t all, old;
+  int ret;
+
+  if (want > WORK_QUEUE_MAX_THREADS)
+    want = WORK_QUEUE_MAX_THREADS;
+
+  if (! wq_pool.started)
+    {
+      pthread_mutex_init (&wq_pool.mtx, NULL);
+      pthread_cond_init (&wq_pool.work, NULL);
+      wq_pool.started = 1;
+    }
+
+  if (wq_pool.count >= want || wq_pool.failed)
+    return wq_pool.count;
+
+  /* Signals are for the main thread to handle. */
+  sigfillset (&all);
+  pthread_sigmask (SIG_SETMASK, &all, &old);
+  for (; wq_pool.count < want; wq_pool.count++)
+    {
+      ret = pthread_create (&wq_pool.threads[wq_pool.count], NULL,
+			    work_queue_mt_thread, NULL);
+      if (ret)
+	{
+	  zlog_err ("%s: could not start work queue thread: %s",
+		    __func__, safe_strerror (ret));
+	  /* Do not try again. */
+	  wq_pool.failed = 1;
+	  break;
+	}
+    }
+  pthread_sigmask (SIG_SETMASK, &old, NULL);
+
+  return wq_pool.count;
+}
+
+/* Hand the head of the queue to the pool.  Returns 0 if it should be
+ * run in the thread master instead.
+ */
+static int
+work_queue_run_mt (struct work_queue *wq)
+{
+  struct work_queue_item item;
+  unsigned int threads, want, count, per, i;
+  struct wq_job *job;
+
+  if (wq->mt.count)
+    return 1;
+
+  /* Needed to hear back from the pool. */
+  if (wq->master->inbox == NULL)
+    return 0;
+  threads = work_queue_mt_start (wq->spec.threads);
+  if (wq->spec.threads < threads)
+    threads = wq->spec.threads;
+  if (threads == 0)
+    return 0;
+
+  want = threads * WORK_QUEUE_MT_BATCH;
+  if (wq->mt.size < want)
+    {
+      wq->mt.size = want;
+      wq->mt.items = XREALLOC (MTYPE_WORK_QUEUE_MT, wq->mt.items,
+			       want * sizeof (struct work_queue_item));
+      wq->mt.status = XREALLOC (MTYPE_WORK_QUEUE_MT, wq->mt.status,
+				want * sizeof (wq_item_status));
+      if (wq->mt.jobs == NULL)
+	wq->mt.jobs = XCALLOC (MTYPE_WORK_QUEUE_MT,
+			       WORK_QUEUE_MAX_THREADS * sizeof (struct wq_job));
+    }
+
+  /* The batch is taken off the rings, which the workfuncs may add to
+   * meanwhile, but stays counted in wq->count.
+   */
+  count = 0;
+  while (count < want && work_queue_pop (wq, &item))
+    {
+      /* dont run items which are past their allowed retries */
+      if (item.ran > wq->spec.max_retries)
+	{
+	  if (wq->spec.errorfunc)
+	    wq->spec.errorfunc (wq, item.data);
+	  work_queue_item_done (wq, &item);
+	  continue;
+	}
+
+      wq->mt.items[count++] = item;
+    }
+
+  if (count == 0)
+    {
+      if (wq->spec.completion_func)
+	wq->spec.completion_func (wq);
+      return 1;
+    }
+
+  /* Small batches are not worth waking every thread for. */
+  per = (count + threads - 1) / threads;
+  if (per < WORK_QUEUE_MT_BATCH / 4 && count > WORK_QUEUE_MT_BATCH / 4)
+    per = WORK_QUEUE_MT_BATCH / 4;
+
+  pthread_mutex_lock (&wq_pool.mtx);
+  wq->mt.count = count;
+  wq->mt.jobs_left = 1;
+  for (i = 0, job = wq->mt.jobs; i < count; i += per, job++)
+    {
+      wq->mt.jobs_left++;
+      job->wq = wq;
+      job->first = i;
+      job->last = (i + per < count) ? i + per : count;
+      job->next = NULL;
+      if (wq_pool.tail)
+	wq_pool.tail->next = job;
+      else
+	wq_pool.head = job;
+      wq_pool.tail = job;
+    }
+  pthread_cond_broadcast (&wq_pool.work);
+  pthread_mutex_unlock (&wq_pool.mtx);
+
+  return 1;
+}
+
+/* Take the items of a finished batch off the queue, as work_queue_run()
+ * would have.
+ */
+static void
+work_queue_mt_finish (struct work_queue *wq)
+{
+  struct work_queue_item *item;
+  unsigned int i, count;
+
+  count = wq->mt.count;
+  wq->mt.count = 0;
+
+  for (i = 0; i < count; i++)
+    {
+      item = &wq->mt.items[i];
+
+      switch (wq->mt.status[i])
+	{
+	case WQ_QUEUE_BLOCKED:
+	  item->ran--;
+	  /* fall through */
+	case WQ_RETRY_LATER:
+	  /* back to the head, below */
+	  break;
+	case WQ_REQUEUE:
+	  item->ran--;
+	  work_queue_push (wq, item, 0);
+	  break;
+	case WQ_RETRY_NOW:
+	case WQ_ERROR:
+	  if (wq->spec.errorfunc)
+	    wq->spec.errorfunc (wq, item->data);
+	  /* fall through */
+	case WQ_SUCCESS:
+	default:
+	  work_queue_item_done (wq, item);
+	  break;
+	}
+    }
+
+  /* Items to retry go back ahead of the rest, in their order. */
+  for (i = count; i-- > 0; )
+    if (wq->mt.status[i] == WQ_RETRY_LATER
+        || wq->mt.status[i] == WQ_QUEUE_BLOCKED)
+      work_queue_push (wq, &wq->mt.items[i], 1);
+
+  wq->runs++;
+  wq->cycles.total += count;
+  if (count > wq->cycles.best)
+    wq->cycles.best = count;
+  wq->cycles.granularity = count;
+
+  if (wq->count > 0)
+    work_queue_schedule (wq, 0);
+  else if (wq->spec.completion_func)
+    wq->spec.completion_func (wq);
+}
+
+static int
+work_queue_mt_done (struct thread *thread)
+{
+  work_queue_mt_finish (THREAD_ARG (thread));
+  return 0;
+}
+#endif /* HAVE_PTHREAD */
+
 /* timer thread to process a work queue
  * will reschedule itself if required,
  * otherwise work_queue_item_add 
@@ -238,16 +609,20 @@ int
 work_queue_run (struct thread *thread)
 {
   struct work_queue *wq;
-  struct work_queue_item *item;
+  struct work_queue_item item;
   wq_item_status ret;
   unsigned int cycles = 0;
-  struct listnode *node, *nnode;
   char yielded = 0;
 
   wq = THREAD_ARG (thread);
   wq->thread = NULL;
 
-  assert (wq && wq->items);
+  assert (wq);
+
+#ifdef HAVE_PTHREAD
+  if (wq->spec.threads && work_queue_run_mt (wq))
+    return 0;
+#endif /* HAVE_PTHREAD */
 
   /* calculate cycle granularity:
    * list iteration == 1 cycle
@@ -269,28 +644,29 @@ work_queue_run (struct thread *thread)
    if (wq->cycles.granularity == 0)
      wq->cycles.granularity = WORK_QUEUE_MIN_GRANULARITY;
 
-  for (ALL_LIST_ELEMENTS (wq->items, node, nnode, item))
+  /* Each item is taken off its ring to be run, so that the workfunc
+   * can queue more, and put back if it is to stay.
+   */
+  while (work_queue_pop (wq, &item))
   {
-    assert (item && item->data);
-    
     /* dont run items which are past their allowed retries */
-    if (item->ran > wq->spec.max_retries)
+    if (item.ran > wq->spec.max_retries)
       {
         /* run error handler, if any */
 	if (wq->spec.errorfunc)
-	  wq->spec.errorfunc (wq, item->data);
-	work_queue_item_remove (wq, node);
+	  wq->spec.errorfunc (wq, item.data);
+	work_queue_item_done (wq, &item);
 	continue;
       }
 
     /* run and take care of items that want to be retried immediately */
     do
       {
-        ret = wq->spec.workfunc (wq, item->data);
-        item->ran++;
+        ret = wq->spec.workfunc (wq, item.data);
+        item.ran++;
       }
     while ((ret == WQ_RETRY_NOW) 
-           && (item->ran < wq->spec.max_retries));
+           && (item.ran < wq->spec.max_retries));
 
     switch (ret)
       {
@@ -299,16 +675,20 @@ work_queue_run (struct thread *thread)
           /* decrement item->ran again, cause this isn't an item
            * specific error, and fall through to WQ_RETRY_LATER
            */
-          item->ran--;
+          item.ran--;
         }
       case WQ_RETRY_LATER:
 	{
+	  work_queue_push (wq, &item, 1);
 	  goto stats;
 	}
       case WQ_REQUEUE:
 	{
-	  item->ran--;
-	  work_queue_item_requeue (wq, node);
+	  item.ran--;
+	  /* A single item requeueing itself, like zebra's meta queue,
+	   * keeps going until it is time to yield.
+	   */
+	  work_queue_push (wq, &item, 0);
 	  break;
 	}
       case WQ_RETRY_NOW:
@@ -316,13 +696,13 @@ work_queue_run (struct thread *thread)
       case WQ_ERROR:
 	{
 	  if (wq->spec.errorfunc)
-	    wq->spec.errorfunc (wq, item);
+	    wq->spec.errorfunc (wq, &item);
 	}
 	/* fall through here is deliberate */
       case WQ_SUCCESS:
       default:
 	{
-	  work_queue_item_remove (wq, node);
+	  work_queue_item_done (wq, &item);
 	  break;
 	}
       }
@@ -373,7 +753,7 @@ stats:
 #endif
   
   /* Is the queue done yet? If it is, call the completion callback. */
-  if (listcount (wq->items) > 0)
+  if (wq->count > 0)
     work_queue_schedule (wq, 0);
   else if (wq->spec.completion_func)
     wq->spec.completion_func (wq);
@@ -40,15 +40,26 @@ typedef enum
                          * the particular item.. */
 } wq_item_status;
 
+/* Priority classes items can be queued in, see work_queue_add_prio().
+ * Lower numbered classes run first, items of one class in order.
+ */
+#define WORK_QUEUE_PRIOS	4
+
 /* A single work queue item, unsurprisingly */
 struct work_queue_item
 {
   void *data;                           /* opaque data */
   unsigned short ran;			/* # of times item has been run */
+  u_char prio;				/* priority class */
 };
 
 #define WQ_UNPLUGGED	(1 << 0) /* available for draining */
 
+/* Most pool threads a work queue can use */
+#define WORK_QUEUE_MAX_THREADS	64
+
+struct wq_job;
+
 struct work_queue
 {
   /* Everything but the specification struct is private
@@ -84,11 +95,36 @@ struct work_queue
     unsigned int max_retries;	
 
     unsigned int hold;	/* hold time for first run, in ms */
+
+    /* If set, run workfunc on up to this many pool threads at once,
+     * rather than on the thread master.  workfunc must then be safe to
+     * call concurrently, and from a thread other than the main one:
+     * neither memory.c nor log.c are.  Everything else, item deletion
+     * and the error and completion callbacks included, still runs on
+     * the thread master.  Needs pthreads, ignored otherwise.
+     */
+    unsigned int threads;
+
+    /* optional, names of the priority classes in use, for
+     * 'show work-queues' to give their depths.
+     */
+    const char *prio_names[WORK_QUEUE_PRIOS];
   } spec;
   
   /* remaining fields should be opaque to users */
-  struct list *items;                 /* queue item list */
   unsigned long runs;                 /* runs count */
+
+  /* Items of each priority class, stored in place in a ring of slots,
+   * so queueing one allocates nothing until the ring is full.
+   */
+  struct work_queue_ring {
+    struct work_queue_item *slots;
+    unsigned int size;		/* slots, a power of 2 */
+    unsigned int head;		/* slot of the first item */
+    unsigned int count;		/* items in the ring */
+  } ring[WORK_QUEUE_PRIOS];
+  unsigned long count;		/* items, those being run included */
+  unsigned long allocs;		/* times a ring was (re)allocated */
   
   struct {
     unsigned int best;
@@ -98,6 +134,16 @@ struct work_queue
   
   /* private state */
   u_int16_t flags;		/* user set flag */
+
+  /* items handed to pool threads, see work_queue_run_mt() */
+  struct {
+    struct work_queue_item *items;
+    wq_item_status *status;
+    struct wq_job *jobs;
+    unsigned int count;		/* items out, 0 if none */
+    unsigned int size;		/* items the arrays have room for */
+    unsigned int jobs_left;	/* jobs not done, +1 until the result is posted */
+  } mt;
 };
 
 /* User API */
@@ -108,17 +154,29 @@ struct work_queue
  */
 extern struct work_queue *work_queue_new (struct thread_master *,
                                           const char *);
+/* how many items are queued, or being run */
+#define work_queue_item_count(WQ) ((WQ)->count)
+
 /* destroy work queue */
 extern void work_queue_free (struct work_queue *);
 
 /* Add the supplied data as an item onto the workqueue */
 extern void work_queue_add (struct work_queue *, void *);
 
+/* Add it ahead of all items of a lower priority class, ie higher
+ * numbered.  work_queue_add() uses the lowest class.
+ */
+extern void work_queue_add_prio (struct work_queue *, void *, unsigned int);
+
 /* plug the queue, ie prevent it from being drained / processed */
 extern void work_queue_plug (struct work_queue *wq);
 /* unplug the queue, allow it to be drained again */
 extern void work_queue_unplug (struct work_queue *wq);
 
+/* Call func on every work queue */
+extern void work_queue_walk (void (*func) (struct work_queue *, void *),
+                             void *arg);
+
 /* Helpers, exported for thread.c and command.c */
 extern int work_queue_run (struct thread *);
 extern struct cmd_element show_work_queues_cmd;
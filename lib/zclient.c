@@ -54,7 +54,9 @@ zclient_new ()
   zclient = XCALLOC (MTYPE_ZCLIENT, sizeof (struct zclient));
 
   zclient->ibuf = stream_new (ZEBRA_MAX_PACKET_SIZ);
+  zclient->rbuf = stream_new (ZEBRA_RECV_BUF_SIZE);
   zclient->obuf = stream_new (ZEBRA_MAX_PACKET_SIZ);
+  zclient->bulk = stream_new (ZEBRA_MAX_PACKET_SIZ);
   zclient->wb = buffer_new(0);
 
   return zclient;
@@ -70,8 +72,12 @@ zclient_free (struct zclient *zclient)
 {
   if (zclient->ibuf)
     stream_free(zclient->ibuf);
+  if (zclient->rbuf)
+    stream_free(zclient->rbuf);
   if (zclient->obuf)
     stream_free(zclient->obuf);
+  if (zclient->bulk)
+    stream_free(zclient->bulk);
   if (zclient->wb)
     buffer_free(zclient->wb);
 
@@ -121,13 +127,20 @@ zclient_stop (struct zclient *zclient)
   THREAD_OFF(zclient->t_read);
   THREAD_OFF(zclient->t_connect);
   THREAD_OFF(zclient->t_write);
+  THREAD_OFF(zclient->t_bulk);
 
   /* Reset streams. */
   stream_reset(zclient->ibuf);
+  stream_reset(zclient->rbuf);
   stream_reset(zclient->obuf);
+  stream_reset(zclient->bulk);
+
+  /* Whatever was agreed on must be negotiated again. */
+  zclient->capabilities = 0;
 
   /* Empty the write buffer. */
   buffer_reset(zclient->wb);
+  zclient->corked = 0;
 
   /* Close socket. */
   if (zclient->sock >= 0)
@@ -234,6 +247,20 @@ zclient_socket_connect (struct zclient *zclient)
   return zclient->sock;
 }
 
+/* Read messages asynchronously from a connection made with
+   zclient_socket_connect, for clients which do not use zclient_start. */
+void
+zclient_read_start (struct zclient *zclient)
+{
+  if (zclient->sock < 0)
+    return;
+
+  if (set_nonblocking (zclient->sock) < 0)
+    zlog_warn ("%s: set_nonblocking(%d) failed", __func__, zclient->sock);
+
+  zclient_event (ZCLIENT_READ, zclient);
+}
+
 static int
 zclient_failed(struct zclient *zclient)
 {
@@ -268,13 +295,18 @@ zclient_flush_data(struct thread *thread)
   return 0;
 }
 
-int
-zclient_send_message(struct zclient *zclient)
+static int
+zclient_write_stream (struct zclient *zclient, struct stream *s)
 {
   if (zclient->sock < 0)
     return -1;
-  switch (buffer_write(zclient->wb, zclient->sock, STREAM_DATA(zclient->obuf),
-		       stream_get_endp(zclient->obuf)))
+  if (zclient->corked)
+    {
+      buffer_put (zclient->wb, STREAM_DATA(s), stream_get_endp(s));
+      return 0;
+    }
+  switch (buffer_write(zclient->wb, zclient->sock, STREAM_DATA(s),
+		       stream_get_endp(s)))
     {
     case BUFFER_ERROR:
       zlog_warn("%s: buffer_write failed to zclient fd %d, closing",
@@ -292,6 +324,73 @@ zclient_send_message(struct zclient *zclient)
   return 0;
 }
 
+/* Send the bulk route message being collected, if any. */
+static int
+zclient_bulk_flush (struct zclient *zclient)
+{
+  struct stream *s = zclient->bulk;
+  int ret;
+
+  THREAD_OFF (zclient->t_bulk);
+  if (stream_get_endp (s) == 0)
+    return 0;
+
+  stream_putw_at (s, 0, stream_get_endp (s));
+  ret = zclient_write_stream (zclient, s);
+  stream_reset (s);
+  return ret;
+}
+
+static int
+zclient_bulk_timer (struct thread *thread)
+{
+  struct zclient *zclient = THREAD_ARG (thread);
+
+  zclient->t_bulk = NULL;
+  zclient_bulk_flush (zclient);
+  return 0;
+}
+
+/* Hold messages to zebra in the write buffer, to go out in as few
+   writes as possible once uncorked. */
+void
+zclient_cork (struct zclient *zclient)
+{
+  zclient->corked = 1;
+}
+
+void
+zclient_uncork (struct zclient *zclient)
+{
+  zclient->corked = 0;
+  if (zclient->sock >= 0 && ! buffer_empty (zclient->wb))
+    THREAD_WRITE_ON(master, zclient->t_write,
+		    zclient_flush_data, zclient, zclient->sock);
+}
+
+/* Send what is collected or buffered, as far as the socket takes it
+   without blocking, for a client that is about to stop. */
+void
+zclient_flush (struct zclient *zclient)
+{
+  zclient->corked = 0;
+  if (zclient_bulk_flush (zclient) < 0 || zclient->sock < 0)
+    return;
+  if (buffer_flush_all (zclient->wb, zclient->sock) == BUFFER_ERROR)
+    zlog_warn ("%s: buffer_flush_all failed to zclient fd %d",
+	       __func__, zclient->sock);
+}
+
+int
+zclient_send_message(struct zclient *zclient)
+{
+  /* Keep messages in order behind the routes still being collected. */
+  if (stream_get_endp (zclient->bulk) && zclient_bulk_flush (zclient) < 0)
+    return -1;
+
+  return zclient_write_stream (zclient, zclient->obuf);
+}
+
 void
 zclient_create_header (struct stream *s, uint16_t command)
 {
@@ -330,6 +429,10 @@ zebra_hello_send (struct zclient *zclient)
 
       zclient_create_header (s, ZEBRA_HELLO);
       stream_putc (s, zclient->redist_default);
+      if (zclient->route_notify)
+	stream_putl (s, ZEBRA_CAPABILITY_ALL);
+      else
+	stream_putl (s, ZEBRA_CAPABILITY_ALL & ~ZEBRA_CAPABILITY_FIB_NOTIFY);
       stream_putw_at (s, 0, stream_get_endp (s));
       return zclient_send_message(zclient);
     }
@@ -395,6 +498,9 @@ zclient_start (struct zclient *zclient)
   if (zclient->default_information)
     zebra_message_send (zclient, ZEBRA_REDISTRIBUTE_DEFAULT_ADD);
 
+  if (zclient->zebra_connected)
+    (*zclient->zebra_connected) (zclient);
+
   return 0;
 }
 
@@ -458,30 +564,11 @@ zclient_connect (struct thread *t)
   *
   * XXX: No attention paid to alignment.
   */ 
-int
-zapi_ipv4_route (u_char cmd, struct zclient *zclient, struct prefix_ipv4 *p,
-                 struct zapi_ipv4 *api)
+/* Put the nexthops, distance and metric of an IPv4 route. */
+static void
+zapi_ipv4_put_attr (struct stream *s, struct zapi_ipv4 *api)
 {
   int i;
-  int psize;
-  struct stream *s;
-
-  /* Reset stream. */
-  s = zclient->obuf;
-  stream_reset (s);
-  
-  zclient_create_header (s, cmd);
-  
-  /* Put type and nexthop. */
-  stream_putc (s, api->type);
-  stream_putc (s, api->flags);
-  stream_putc (s, api->message);
-  stream_putw (s, api->safi);
-
-  /* Put prefix information. */
-  psize = PSIZE (p->prefixlen);
-  stream_putc (s, p->prefixlen);
-  stream_write (s, (u_char *) & p->prefix, psize);
 
   /* Nexthop, ifindex, distance and metric information. */
   if (CHECK_FLAG (api->message, ZAPI_MESSAGE_NEXTHOP))
@@ -512,6 +599,94 @@ zapi_ipv4_route (u_char cmd, struct zclient *zclient, struct prefix_ipv4 *p,
     stream_putc (s, api->distance);
   if (CHECK_FLAG (api->message, ZAPI_MESSAGE_METRIC))
     stream_putl (s, api->metric);
+}
+
+/* Queue an IPv4 route add or delete into the bulk message.  A bulk
+ * message carries the attributes once, preceded by their length, then
+ * the prefixes sharing them.  Routes queued during one event go out
+ * together; a route with other attributes, or any other message, sends
+ * what was collected first.
+ */
+static int
+zapi_ipv4_route_bulk (u_char cmd, struct zclient *zclient,
+		      struct prefix_ipv4 *p, struct zapi_ipv4 *api)
+{
+  struct stream *s;
+  struct stream *bulk = zclient->bulk;
+  size_t attr;
+  int psize;
+
+  /* Build the message head in obuf to compare it to the one being
+     collected. */
+  s = zclient->obuf;
+  stream_reset (s);
+
+  zclient_create_header (s, cmd == ZEBRA_IPV4_ROUTE_ADD ?
+			 ZEBRA_IPV4_ROUTE_BULK_ADD :
+			 ZEBRA_IPV4_ROUTE_BULK_DELETE);
+  stream_putc (s, api->type);
+  stream_putc (s, api->flags);
+  stream_putc (s, api->message);
+  stream_putw (s, api->safi);
+  attr = stream_get_endp (s);
+  stream_putw (s, 0);
+  zapi_ipv4_put_attr (s, api);
+  stream_putw_at (s, attr, stream_get_endp (s) - attr - 2);
+
+  psize = PSIZE (p->prefixlen);
+
+  if (stream_get_endp (bulk)
+      && (zclient->bulk_attr != stream_get_endp (s)
+	  || memcmp (STREAM_DATA (bulk), STREAM_DATA (s),
+		     zclient->bulk_attr) != 0
+	  || STREAM_WRITEABLE (bulk) < (size_t) psize + 1))
+    if (zclient_bulk_flush (zclient) < 0)
+      return -1;
+
+  if (stream_get_endp (bulk) == 0)
+    {
+      stream_put (bulk, STREAM_DATA (s), stream_get_endp (s));
+      zclient->bulk_attr = stream_get_endp (s);
+    }
+
+  stream_putc (bulk, p->prefixlen);
+  stream_write (bulk, (u_char *) & p->prefix, psize);
+
+  if (! zclient->t_bulk)
+    zclient->t_bulk = thread_add_event (master, zclient_bulk_timer,
+					zclient, 0);
+  return 0;
+}
+
+int
+zapi_ipv4_route (u_char cmd, struct zclient *zclient, struct prefix_ipv4 *p,
+                 struct zapi_ipv4 *api)
+{
+  int psize;
+  struct stream *s;
+
+  if (CHECK_FLAG (zclient->capabilities, ZEBRA_CAPABILITY_ROUTE_BULK)
+      && (cmd == ZEBRA_IPV4_ROUTE_ADD || cmd == ZEBRA_IPV4_ROUTE_DELETE))
+    return zapi_ipv4_route_bulk (cmd, zclient, p, api);
+
+  /* Reset stream. */
+  s = zclient->obuf;
+  stream_reset (s);
+  
+  zclient_create_header (s, cmd);
+  
+  /* Put type and nexthop. */
+  stream_putc (s, api->type);
+  stream_putc (s, api->flags);
+  stream_putc (s, api->message);
+  stream_putw (s, api->safi);
+
+  /* Put prefix information. */
+  psize = PSIZE (p->prefixlen);
+  stream_putc (s, p->prefixlen);
+  stream_write (s, (u_char *) & p->prefix, psize);
+
+  zapi_ipv4_put_attr (s, api);
 
   /* Put length at the first point of the stream. */
   stream_putw_at (s, 0, stream_get_endp (s));
@@ -596,6 +771,53 @@ zebra_redistribute_send (int command, struct zclient *zclient, int type)
   return zclient_send_message(zclient);
 }
 
+/* Nexthop tracking registration.  The message carries the address
+ * family followed by the host address to be tracked.
+ */
+int
+zebra_nexthop_send (int command, struct zclient *zclient, struct prefix *p)
+{
+  struct stream *s;
+
+  if (zclient->sock < 0)
+    return -1;
+
+  s = zclient->obuf;
+  stream_reset (s);
+
+  zclient_create_header (s, command);
+  stream_putc (s, p->family);
+  stream_put (s, &p->u.prefix, PSIZE (p->prefixlen));
+
+  stream_putw_at (s, 0, stream_get_endp (s));
+
+  return zclient_send_message(zclient);
+}
+
+/* Import check registration.  Unlike a nexthop, the prefix is matched
+ * exactly, so its length follows the address family.
+ */
+int
+zebra_import_send (int command, struct zclient *zclient, struct prefix *p)
+{
+  struct stream *s;
+
+  if (zclient->sock < 0)
+    return -1;
+
+  s = zclient->obuf;
+  stream_reset (s);
+
+  zclient_create_header (s, command);
+  stream_putc (s, p->family);
+  stream_putc (s, p->prefixlen);
+  stream_put (s, &p->u.prefix, PSIZE (p->prefixlen));
+
+  stream_putw_at (s, 0, stream_get_endp (s));
+
+  return zclient_send_message(zclient);
+}
+
 /* Router-id update from zebra daemon. */
 void
 zebra_router_id_update_read (struct stream *s, struct prefix *rid)
@@ -724,7 +946,7 @@ void
 zebra_interface_if_set_value (struct stream *s, struct interface *ifp)
 {
   /* Read interface's index. */
-  ifp->ifindex = stream_getl (s);
+  if_set_index (ifp, stream_getl (s));
   ifp->status = stream_getc (s);
 
   /* Read interface's value. */
@@ -817,97 +1039,10 @@ zebra_interface_address_read (int type, struct stream *s)
 }
 
 
-/* Zebra client message read function. */
-static int
-zclient_read (struct thread *thread)
+/* Hand the message in ibuf, its header read, to the daemon. */
+static void
+zclient_dispatch (struct zclient *zclient, uint16_t command, uint16_t length)
 {
-  size_t already;
-  uint16_t length, command;
-  uint8_t marker, version;
-  struct zclient *zclient;
-
-  /* Get socket to zebra. */
-  zclient = THREAD_ARG (thread);
-  zclient->t_read = NULL;
-
-  /* Read zebra header (if we don't have it already). */
-  if ((already = stream_get_endp(zclient->ibuf)) < ZEBRA_HEADER_SIZE)
-    {
-      ssize_t nbyte;
-      if (((nbyte = stream_read_try(zclient->ibuf, zclient->sock,
-				     ZEBRA_HEADER_SIZE-already)) == 0) ||
-	  (nbyte == -1))
-	{
-	  if (zclient_debug)
-	   zlog_debug ("zclient connection closed socket [%d].", zclient->sock);
-	  return zclient_failed(zclient);
-	}
-      if (nbyte != (ssize_t)(ZEBRA_HEADER_SIZE-already))
-	{
-	  /* Try again later. */
-	  zclient_event (ZCLIENT_READ, zclient);
-	  return 0;
-	}
-      already = ZEBRA_HEADER_SIZE;
-    }
-
-  /* Reset to read from the beginning of the incoming packet. */
-  stream_set_getp(zclient->ibuf, 0);
-
-  /* Fetch header values. */
-  length = stream_getw (zclient->ibuf);
-  marker = stream_getc (zclient->ibuf);
-  version = stream_getc (zclient->ibuf);
-  command = stream_getw (zclient->ibuf);
-  
-  if (marker != ZEBRA_HEADER_MARKER || version != ZSERV_VERSION)
-    {
-      zlog_err("%s: socket %d version mismatch, marker %d, version %d",
-               __func__, zclient->sock, marker, version);
-      return zclient_failed(zclient);
-    }
-  
-  if (length < ZEBRA_HEADER_SIZE) 
-    {
-      zlog_err("%s: socket %d message length %u is less than %d ",
-	       __func__, zclient->sock, length, ZEBRA_HEADER_SIZE);
-      return zclient_failed(zclient);
-    }
-
-  /* Length check. */
-  if (length > STREAM_SIZE(zclient->ibuf))
-    {
-      struct stream *ns;
-      zlog_warn("%s: message size %u exceeds buffer size %lu, expanding...",
-	        __func__, length, (u_long)STREAM_SIZE(zclient->ibuf));
-      ns = stream_new(length);
-      stream_copy(ns, zclient->ibuf);
-      stream_free (zclient->ibuf);
-      zclient->ibuf = ns;
-    }
-
-  /* Read rest of zebra packet. */
-  if (already < length)
-    {
-      ssize_t nbyte;
-      if (((nbyte = stream_read_try(zclient->ibuf, zclient->sock,
-				     length-already)) == 0) ||
-	  (nbyte == -1))
-	{
-	  if (zclient_debug)
-	    zlog_debug("zclient connection closed socket [%d].", zclient->sock);
-	  return zclient_failed(zclient);
-	}
-      if (nbyte != (ssize_t)(length-already))
-	{
-	  /* Try again later. */
-	  zclient_event (ZCLIENT_READ, zclient);
-	  return 0;
-	}
-    }
-
-  length -= ZEBRA_HEADER_SIZE;
-
   if (zclient_debug)
     zlog_debug("zclient 0x%p command 0x%x \n", zclient, command);
 
@@ -957,16 +1092,131 @@ zclient_read (struct thread *thread)
       if (zclient->ipv6_route_delete)
 	(*zclient->ipv6_route_delete) (command, zclient, length);
       break;
+    case ZEBRA_HELLO:
+      zclient->capabilities = (stream_getl (zclient->ibuf)
+			       & ZEBRA_CAPABILITY_ALL);
+      if (zclient->zebra_hello)
+	(*zclient->zebra_hello) (zclient);
+      break;
+    case ZEBRA_NEXTHOP_UPDATE:
+      if (zclient->nexthop_update)
+	(*zclient->nexthop_update) (command, zclient, length);
+      break;
+    case ZEBRA_ROUTE_NOTIFY:
+      if (zclient->route_notify)
+	(*zclient->route_notify) (command, zclient, length);
+      break;
+    case ZEBRA_IMPORT_UPDATE:
+      if (zclient->import_update)
+	(*zclient->import_update) (command, zclient, length);
+      break;
+    case ZEBRA_IPV4_NEXTHOP_LOOKUP:
+      if (zclient->ipv4_nexthop_lookup)
+	(*zclient->ipv4_nexthop_lookup) (command, zclient, length);
+      break;
+    case ZEBRA_IPV6_NEXTHOP_LOOKUP:
+      if (zclient->ipv6_nexthop_lookup)
+	(*zclient->ipv6_nexthop_lookup) (command, zclient, length);
+      break;
+    case ZEBRA_IPV4_IMPORT_LOOKUP:
+      if (zclient->ipv4_import_lookup)
+	(*zclient->ipv4_import_lookup) (command, zclient, length);
+      break;
     default:
       break;
     }
+}
 
-  if (zclient->sock < 0)
-    /* Connection was closed during packet processing. */
-    return -1;
+/* Zebra client message read function.  Reads what there is from the
+   socket, then takes the whole messages read one after the other until
+   the thread has run for its time slot. */
+static int
+zclient_read (struct thread *thread)
+{
+  ssize_t nbyte;
+  size_t start;
+  uint16_t length, command;
+  uint8_t marker, version;
+  struct zclient *zclient;
+  struct stream *rbuf;
+  unsigned int count = 0;
 
-  /* Register read thread. */
-  stream_reset(zclient->ibuf);
+  /* Get socket to zebra. */
+  zclient = THREAD_ARG (thread);
+  zclient->t_read = NULL;
+  rbuf = zclient->rbuf;
+
+  /* After a yield the buffer may be full of messages not yet taken. */
+  if (STREAM_WRITEABLE (rbuf) > 0)
+    {
+      nbyte = stream_read_try (rbuf, zclient->sock, STREAM_WRITEABLE (rbuf));
+      if (nbyte == 0 || nbyte == -1)
+	{
+	  if (zclient_debug)
+	    zlog_debug ("zclient connection closed socket [%d].", zclient->sock);
+	  return zclient_failed(zclient);
+	}
+    }
+
+  while (STREAM_READABLE (rbuf) >= ZEBRA_HEADER_SIZE)
+    {
+      /* Fetch header values. */
+      start = stream_get_getp (rbuf);
+      length = stream_getw_from (rbuf, start);
+      marker = stream_getc_from (rbuf, start + 2);
+      version = stream_getc_from (rbuf, start + 3);
+      command = stream_getw_from (rbuf, start + 4);
+
+      if (marker != ZEBRA_HEADER_MARKER || version != ZSERV_VERSION)
+	{
+	  zlog_err("%s: socket %d version mismatch, marker %d, version %d",
+		   __func__, zclient->sock, marker, version);
+	  return zclient_failed(zclient);
+	}
+
+      if (length < ZEBRA_HEADER_SIZE)
+	{
+	  zlog_err("%s: socket %d message length %u is less than %d ",
+		   __func__, zclient->sock, length, ZEBRA_HEADER_SIZE);
+	  return zclient_failed(zclient);
+	}
+
+      /* The rest of the message is still to come. */
+      if (STREAM_READABLE (rbuf) < length)
+	break;
+
+      /* Length check. */
+      if (length > STREAM_SIZE(zclient->ibuf))
+	{
+	  zlog_warn("%s: message size %u exceeds buffer size %lu, expanding...",
+		    __func__, length, (u_long)STREAM_SIZE(zclient->ibuf));
+	  stream_free (zclient->ibuf);
+	  zclient->ibuf = stream_new(length);
+	}
+
+      /* The message alone in ibuf, read from after its header. */
+      stream_reset (zclient->ibuf);
+      stream_put (zclient->ibuf, STREAM_PNT (rbuf), length);
+      stream_forward_getp (rbuf, length);
+      stream_set_getp (zclient->ibuf, ZEBRA_HEADER_SIZE);
+
+      zclient_dispatch (zclient, command, length - ZEBRA_HEADER_SIZE);
+
+      if (zclient->sock < 0)
+	/* Connection was closed during packet processing. */
+	return -1;
+
+      if ((++count & 0x3f) == 0 && thread_should_yield (thread))
+	{
+	  stream_pulldown (rbuf);
+	  zclient->t_read = thread_add_event (master, zclient_read, zclient, 0);
+	  return 0;
+	}
+    }
+
+  /* Keep what there is of the next message, and read on. */
+  stream_pulldown (rbuf);
+  stream_reset (zclient->ibuf);
   zclient_event (ZCLIENT_READ, zclient);
 
   return 0;
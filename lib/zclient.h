@@ -31,6 +31,10 @@
 /* For input/output buffer to zebra. */
 #define ZEBRA_MAX_PACKET_SIZ          4096
 
+/* Read from a zebra socket at once, as many messages as there are.  At
+   least the largest message, whose length is 16 bits. */
+#define ZEBRA_RECV_BUF_SIZE           (128 * 1024)
+
 /* Zebra header size. */
 #define ZEBRA_HEADER_SIZE             6
 
@@ -50,6 +54,9 @@ struct zclient
   /* Input buffer for zebra message. */
   struct stream *ibuf;
 
+  /* Bytes read from zebra, taken into ibuf one message at a time. */
+  struct stream *rbuf;
+
   /* Output buffer for zebra message. */
   struct stream *obuf;
 
@@ -63,6 +70,18 @@ struct zclient
   /* Thread to write buffered data to zebra. */
   struct thread *t_write;
 
+  /* Messages are only buffered, see zclient_cork. */
+  int corked;
+
+  /* Features zebra agreed to in its hello reply. */
+  u_int32_t capabilities;
+
+  /* Route adds or deletes sharing the same attributes, collected into
+     one bulk message until the current event has run. */
+  struct stream *bulk;
+  size_t bulk_attr;
+  struct thread *t_bulk;
+
   /* Redistribute information. */
   u_char redist_default;
   u_char redist[ZEBRA_ROUTE_MAX];
@@ -82,6 +101,23 @@ struct zclient
   int (*ipv4_route_delete) (int, struct zclient *, uint16_t);
   int (*ipv6_route_add) (int, struct zclient *, uint16_t);
   int (*ipv6_route_delete) (int, struct zclient *, uint16_t);
+  int (*nexthop_update) (int, struct zclient *, uint16_t);
+  int (*ipv4_nexthop_lookup) (int, struct zclient *, uint16_t);
+  int (*ipv6_nexthop_lookup) (int, struct zclient *, uint16_t);
+  int (*ipv4_import_lookup) (int, struct zclient *, uint16_t);
+
+  /* Outcome of the IPv4 unicast routes added, ZEBRA_ROUTE_NOTIFY.  Only
+     asked for in the hello when set. */
+  int (*route_notify) (int, struct zclient *, uint16_t);
+
+  /* State of a prefix registered for import checking. */
+  int (*import_update) (int, struct zclient *, uint16_t);
+
+  /* Called once the connection to zebra is (re)established. */
+  void (*zebra_connected) (struct zclient *);
+
+  /* Called once zebra answered the hello, capabilities are known. */
+  void (*zebra_hello) (struct zclient *);
 };
 
 /* Zebra API message flag. */
@@ -133,11 +169,25 @@ extern void zclient_reset (struct zclient *);
 extern void zclient_free (struct zclient *);
 
 extern int  zclient_socket_connect (struct zclient *);
+extern void zclient_read_start (struct zclient *);
 extern void zclient_serv_path_set  (char *path);
 
 /* Send redistribute command to zebra daemon. Do not update zclient state. */
 extern int zebra_redistribute_send (int command, struct zclient *, int type);
 
+/* Ask zebra to (stop) track(ing) reachability of a nexthop address.
+   Zebra answers a registration with ZEBRA_NEXTHOP_UPDATE and sends a
+   new one whenever the resolution of the address changes. */
+extern int zebra_nexthop_send (int command, struct zclient *,
+                               struct prefix *p);
+
+/* Ask zebra to (stop) check(ing) whether a prefix is in its RIB.  Zebra
+   answers a registration with ZEBRA_IMPORT_UPDATE and sends a new one
+   whenever the route for exactly that prefix changes.  Only to be used
+   once zebra confirmed ZEBRA_CAPABILITY_IMPORT_CHECK. */
+extern int zebra_import_send (int command, struct zclient *,
+                              struct prefix *p);
+
 /* If state has changed, update state and call zebra_redistribute_send. */
 extern void zclient_redistribute (int command, struct zclient *, int type);
 
@@ -147,6 +197,9 @@ extern void zclient_redistribute_default (int command, struct zclient *);
 /* Send the message in zclient->obuf to the zebra daemon (or enqueue it).
    Returns 0 for success or -1 on an I/O error. */
 extern int zclient_send_message(struct zclient *);
+extern void zclient_cork (struct zclient *);
+extern void zclient_uncork (struct zclient *);
+extern void zclient_flush (struct zclient *);
 
 /* create header for command, length to be filled in by user later */
 extern void zclient_create_header (struct stream *, uint16_t);
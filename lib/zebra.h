@@ -425,7 +425,37 @@ struct in_pktinfo
 #define ZEBRA_ROUTER_ID_DELETE            21
 #define ZEBRA_ROUTER_ID_UPDATE            22
 #define ZEBRA_HELLO                       23
-#define ZEBRA_MESSAGE_MAX                 24
+#define ZEBRA_NEXTHOP_REGISTER            24
+#define ZEBRA_NEXTHOP_UNREGISTER          25
+#define ZEBRA_NEXTHOP_UPDATE              26
+#define ZEBRA_IPV4_ROUTE_BULK_ADD         27
+#define ZEBRA_IPV4_ROUTE_BULK_DELETE      28
+#define ZEBRA_ROUTE_NOTIFY                29
+#define ZEBRA_IMPORT_REGISTER             30
+#define ZEBRA_IMPORT_UNREGISTER           31
+#define ZEBRA_IMPORT_UPDATE               32
+#define ZEBRA_MESSAGE_MAX                 33
+
+/* Optional protocol features, offered by the client in ZEBRA_HELLO and
+ * confirmed by zebra in its reply.  A client must not use a feature
+ * before zebra has confirmed it.
+ */
+#define ZEBRA_CAPABILITY_ROUTE_BULK     0x01
+#define ZEBRA_CAPABILITY_FOLLOW_IGP     0x02	/* No need to resend routes
+						   when their gateway moves */
+#define ZEBRA_CAPABILITY_FIB_NOTIFY     0x04	/* ZEBRA_ROUTE_NOTIFY of how
+						   the IPv4 unicast routes
+						   added came out */
+#define ZEBRA_CAPABILITY_IMPORT_CHECK   0x08	/* ZEBRA_IMPORT_REGISTER */
+#define ZEBRA_CAPABILITY_ALL            (ZEBRA_CAPABILITY_ROUTE_BULK \
+					 | ZEBRA_CAPABILITY_FOLLOW_IGP \
+					 | ZEBRA_CAPABILITY_FIB_NOTIFY \
+					 | ZEBRA_CAPABILITY_IMPORT_CHECK)
+
+/* Outcome of a route add, in ZEBRA_ROUTE_NOTIFY. */
+#define ZEBRA_FIB_INSTALLED              1	/* in the FIB */
+#define ZEBRA_FIB_FAILED                 2	/* the kernel refused it */
+#define ZEBRA_FIB_NOT_SELECTED           3	/* another route won */
 
 /* Marker value used in new Zserv, in the byte location corresponding
  * the command value in the old zserv header. To allow old and new
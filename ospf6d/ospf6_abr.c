@@ -240,7 +240,7 @@ ospf6_abr_originate_summary_to_area (struct ospf6_route *route,
     }
 
   /* do not generate if the nexthops belongs to the target area */
-  oi = ospf6_interface_lookup_by_ifindex (route->nexthop[0].ifindex);
+  oi = ospf6_interface_lookup_by_ifindex (ospf6_route_ifindex (route));
   if (oi && oi->area && oi->area == area)
     {
       if (is_debug)
@@ -413,7 +413,10 @@ ospf6_abr_originate_summary_to_area (struct ospf6_route *route,
   summary->path.area_id = area->area_id;
   summary->path.type = OSPF6_PATH_TYPE_INTER;
   summary->path.cost = route->path.cost;
-  summary->nexthop[0] = route->nexthop[0];
+  if (ospf6_route_num_nexthops (route))
+    ospf6_route_set_nexthops (summary, ospf6_route_nexthop (route, 0), 1);
+  else
+    ospf6_route_set_nexthops (summary, NULL, 0);
 
   /* prepare buffer */
   memset (buffer, 0, sizeof (buffer));
@@ -534,7 +537,6 @@ ospf6_abr_examin_summary (struct ospf6_lsa *lsa, struct ospf6_area *oa)
   u_int8_t prefix_options = 0;
   u_int32_t cost = 0;
   u_char router_bits = 0;
-  int i;
   char buf[64];
   int is_debug = 0;
 
@@ -714,8 +716,7 @@ ospf6_abr_examin_summary (struct ospf6_lsa *lsa, struct ospf6_area *oa)
   route->path.area_id = oa->area_id;
   route->path.type = OSPF6_PATH_TYPE_INTER;
   route->path.cost = abr_entry->path.cost + cost;
-  for (i = 0; i < OSPF6_MULTI_PATH_LIMIT; i++)
-    route->nexthop[i] = abr_entry->nexthop[i];
+  ospf6_route_copy_nexthops (route, abr_entry);
 
   if (is_debug)
     zlog_debug ("Install route: %s", buf);
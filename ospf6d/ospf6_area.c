@@ -270,6 +270,9 @@ ospf6_area_show (struct vty *vty, struct ospf6_area *oa)
   vty_out (vty, " Area %s%s", oa->name, VNL);
   vty_out (vty, "     Number of Area scoped LSAs is %u%s",
            oa->lsdb->count, VNL);
+  vty_out (vty, "     SPF algorithm executed %u times, "
+           "%u with the tree unchanged%s",
+           oa->spf_calculation, oa->spf_unchanged, VNL);
 
   vty_out (vty, "     Interface attached to this area:");
   for (ALL_LIST_ELEMENTS_RO (oa->if_list, i, oi))
@@ -58,9 +58,14 @@ struct ospf6_area
   struct thread  *thread_spf_calculation;
   struct thread  *thread_route_calculation;
   u_int32_t spf_calculation;	/* SPF calculation count */
+  u_int32_t spf_unchanged;	/* of which left the tree as it was */
 
   struct thread *thread_router_lsa;
   struct thread *thread_intra_prefix_lsa;
+
+  /* Last Intra-Area-Prefix LSA origination, for MinLSInterval */
+  struct timeval ts_intra_prefix_lsa;
+
   u_int32_t router_lsa_size_limit;
 
   /* Area announce list */
@@ -159,7 +159,6 @@ ospf6_asbr_lsa_add (struct ospf6_lsa *lsa)
   struct prefix asbr_id;
   struct ospf6_route *asbr_entry, *route;
   char buf[64];
-  int i;
 
   external = (struct ospf6_as_external_lsa *)
     OSPF6_LSA_HEADER_END (lsa->header);
@@ -221,8 +220,7 @@ ospf6_asbr_lsa_add (struct ospf6_lsa *lsa)
       route->path.cost_e2 = 0;
     }
 
-  for (i = 0; i < OSPF6_MULTI_PATH_LIMIT; i++)
-    ospf6_nexthop_copy (&route->nexthop[i], &asbr_entry->nexthop[i]);
+  ospf6_route_copy_nexthops (route, asbr_entry);
 
   if (IS_OSPF6_DEBUG_EXAMIN (AS_EXTERNAL))
     {
@@ -399,7 +397,7 @@ ospf6_asbr_redistribute_unset (int type)
       if (info->type != type)
         continue;
 
-      ospf6_asbr_redistribute_remove (info->type, route->nexthop[0].ifindex,
+      ospf6_asbr_redistribute_remove (info->type, ospf6_route_ifindex (route),
                                       &route->prefix);
     }
 }
@@ -411,6 +409,7 @@ ospf6_asbr_redistribute_add (int type, int ifindex, struct prefix *prefix,
   int ret;
   struct ospf6_route troute;
   struct ospf6_external_info tinfo;
+  struct ospf6_nexthop nh;
   struct ospf6_route *route, *match;
   struct ospf6_external_info *info;
   struct prefix prefix_id;
@@ -477,9 +476,11 @@ ospf6_asbr_redistribute_add (int type, int ifindex, struct prefix *prefix,
         }
 
       info->type = type;
-      match->nexthop[0].ifindex = ifindex;
+      ospf6_nexthop_clear (&nh);
+      nh.ifindex = ifindex;
       if (nexthop_num && nexthop)
-        memcpy (&match->nexthop[0].address, nexthop, sizeof (struct in6_addr));
+        memcpy (&nh.address, nexthop, sizeof (struct in6_addr));
+      ospf6_route_set_nexthops (match, &nh, 1);
 
       /* create/update binding in external_id_table */
       prefix_id.family = AF_INET;
@@ -522,9 +523,11 @@ ospf6_asbr_redistribute_add (int type, int ifindex, struct prefix *prefix,
     }
 
   info->type = type;
-  route->nexthop[0].ifindex = ifindex;
+  ospf6_nexthop_clear (&nh);
+  nh.ifindex = ifindex;
   if (nexthop_num && nexthop)
-    memcpy (&route->nexthop[0].address, nexthop, sizeof (struct in6_addr));
+    memcpy (&nh.address, nexthop, sizeof (struct in6_addr));
+  ospf6_route_set_nexthops (route, &nh, 1);
 
   /* create/update binding in external_id_table */
   prefix_id.family = AF_INET;
@@ -1223,7 +1226,7 @@ ospf6_asbr_external_route_show (struct vty *vty, struct ospf6_route *route)
     inet_ntop (AF_INET6, &info->forwarding, forwarding, sizeof (forwarding));
   else
     snprintf (forwarding, sizeof (forwarding), ":: (ifindex %d)",
-              route->nexthop[0].ifindex);
+              ospf6_route_ifindex (route));
 
   vty_out (vty, "%c %-32s %-15s type-%d %5lu %s%s",
            zebra_route_char(info->type),
@@ -26,6 +26,9 @@
 #include "linklist.h"
 #include "vty.h"
 #include "command.h"
+#include "memory.h"
+#include "hash.h"
+#include "jhash.h"
 
 #include "ospf6d.h"
 #include "ospf6_proto.h"
@@ -93,6 +96,7 @@ ospf6_lsa_originate (struct ospf6_lsa *lsa)
 {
   struct ospf6_lsa *old;
   struct ospf6_lsdb *lsdb_self;
+  unsigned int index;
 
   /* find previous LSA */
   old = ospf6_lsdb_lookup (lsa->header->type, lsa->header->id,
@@ -108,6 +112,10 @@ ospf6_lsa_originate (struct ospf6_lsa *lsa)
       return;
     }
 
+  index = ntohs (lsa->header->type) & OSPF6_LSTYPE_FCODE_MASK;
+  if (ospf6 && index < OSPF6_LSTYPE_SIZE)
+    ospf6->lsa_originated[index]++;
+
   /* store it in the LSDB for self-originated LSAs */
   lsdb_self = ospf6_get_scoped_lsdb_self (lsa);
   ospf6_lsdb_add (ospf6_lsa_copy (lsa), lsdb_self);
@@ -173,35 +181,130 @@ ospf6_lsa_purge (struct ospf6_lsa *lsa)
 }
 
 
+/* Neighbors' retransmission lists.
+
+   Each entry links an LSA instance to a neighbor it is waiting to be
+   acknowledged by.  It is queued on the neighbor's retrans_list and is
+   in the LSA's retrans set, and the process-wide retrans hash finds it
+   by neighbor and LSA key.  The LSA is referenced rather than copied
+   for each neighbor, and is locked once while its set is not empty. */
+static unsigned int
+ospf6_retrans_hash_key (void *arg)
+{
+  struct ospf6_retrans *rt = arg;
+  struct ospf6_lsa_header *header = rt->lsa->header;
+
+  return jhash_3words (header->type, header->id, header->adv_router,
+                       (u_int32_t) (uintptr_t) rt->on);
+}
+
+static int
+ospf6_retrans_hash_cmp (const void *arg1, const void *arg2)
+{
+  const struct ospf6_retrans *rt1 = arg1;
+  const struct ospf6_retrans *rt2 = arg2;
+
+  return (rt1->on == rt2->on &&
+          rt1->lsa->header->type == rt2->lsa->header->type &&
+          rt1->lsa->header->id == rt2->lsa->header->id &&
+          rt1->lsa->header->adv_router == rt2->lsa->header->adv_router);
+}
+
+void
+ospf6_retrans_init (struct ospf6 *o)
+{
+  o->retrans = hash_create_open (0, ospf6_retrans_hash_key,
+                                 ospf6_retrans_hash_cmp);
+  hash_set_name (o->retrans, "OSPF6 retransmission lists");
+}
+
 void
-ospf6_increment_retrans_count (struct ospf6_lsa *lsa)
+ospf6_retrans_finish (struct ospf6 *o)
+{
+  hash_free (o->retrans);
+  o->retrans = NULL;
+}
+
+/* The entry of on for the key of lsa, whichever its instance. */
+static struct ospf6_retrans *
+ospf6_retrans_find (struct ospf6_neighbor *on, struct ospf6_lsa *lsa)
+{
+  struct ospf6_retrans key;
+
+  if (on->retrans_list.count == 0)
+    return NULL;
+
+  key.on = on;
+  key.lsa = lsa;
+  return hash_lookup (on->ospf6_if->area->ospf6->retrans, &key);
+}
+
+static void
+ospf6_retrans_free (struct ospf6_retrans *rt)
 {
-  /* The LSA must be the original one (see the description
-     in ospf6_decrement_retrans_count () below) */
-  lsa->retrans_count++;
+  struct ospf6_lsa *lsa = rt->lsa;
+
+  hash_release (rt->on->ospf6_if->area->ospf6->retrans, rt);
+  ilist_delete (&rt->on->retrans_list, &rt->on_node);
+  ilist_delete (&lsa->retrans, &rt->lsa_node);
+  XFREE (MTYPE_OSPF6_RETRANS, rt);
+
+  if (lsa->retrans.count == 0)
+    ospf6_lsa_unlock (lsa);
 }
 
+/* Add this instance of lsa to the retransmission list of on, in place
+   of any other instance. */
 void
-ospf6_decrement_retrans_count (struct ospf6_lsa *lsa)
+ospf6_retrans_add (struct ospf6_neighbor *on, struct ospf6_lsa *lsa)
 {
-  struct ospf6_lsdb *lsdb;
-  struct ospf6_lsa *orig;
-
-  /* The LSA must be on the retrans-list of a neighbor. It means
-     the "lsa" is a copied one, and we have to decrement the
-     retransmission count of the original one (instead of this "lsa"'s).
-     In order to find the original LSA, first we have to find
-     appropriate LSDB that have the original LSA. */
-  lsdb = ospf6_get_scoped_lsdb (lsa);
-
-  /* Find the original LSA of which the retrans_count should be decremented */
-  orig = ospf6_lsdb_lookup (lsa->header->type, lsa->header->id,
-                            lsa->header->adv_router, lsdb);
-  if (orig)
+  struct ospf6_retrans *rt;
+
+  if ((rt = ospf6_retrans_find (on, lsa)) != NULL)
     {
-      orig->retrans_count--;
-      assert (orig->retrans_count >= 0);
+      if (rt->lsa == lsa)
+        return;
+      ospf6_retrans_free (rt);
     }
+
+  rt = XCALLOC (MTYPE_OSPF6_RETRANS, sizeof (struct ospf6_retrans));
+  rt->on = on;
+  rt->lsa = lsa;
+  if (lsa->retrans.count == 0)
+    ospf6_lsa_lock (lsa);
+  ilist_add (&on->retrans_list, &rt->on_node);
+  ilist_add (&lsa->retrans, &rt->lsa_node);
+  hash_get (on->ospf6_if->area->ospf6->retrans, rt, hash_alloc_intern);
+}
+
+/* Remove the instance with the key of lsa from the list of on. */
+void
+ospf6_retrans_delete (struct ospf6_neighbor *on, struct ospf6_lsa *lsa)
+{
+  struct ospf6_retrans *rt;
+
+  if ((rt = ospf6_retrans_find (on, lsa)) != NULL)
+    ospf6_retrans_free (rt);
+}
+
+/* The instance with the key of lsa on the list of on, if any. */
+struct ospf6_lsa *
+ospf6_retrans_lookup (struct ospf6_neighbor *on, struct ospf6_lsa *lsa)
+{
+  struct ospf6_retrans *rt = ospf6_retrans_find (on, lsa);
+
+  return rt ? rt->lsa : NULL;
+}
+
+void
+ospf6_retrans_clear (struct ospf6_neighbor *on)
+{
+  struct ilistnode *node, *nnode;
+  struct ospf6_retrans *rt;
+
+  for (ALL_ILIST_ELEMENTS (&on->retrans_list, node, nnode, rt,
+                           struct ospf6_retrans, on_node))
+    ospf6_retrans_free (rt);
 }
 
 /* RFC2328 section 13.2 Installing LSAs in the database */
@@ -329,8 +432,7 @@ ospf6_flood_interface (struct ospf6_neighbor *from,
       /* (d) add retrans-list, schedule retransmission */
       if (is_debug)
         zlog_debug ("Add retrans-list of this neighbor");
-      ospf6_increment_retrans_count (lsa);
-      ospf6_lsdb_add (ospf6_lsa_copy (lsa), on->retrans_list);
+      ospf6_retrans_add (on, lsa);
       if (on->thread_send_lsupdate == NULL)
         on->thread_send_lsupdate =
           thread_add_timer (master, ospf6_lsupdate_send_neighbor,
@@ -440,80 +542,25 @@ ospf6_flood (struct ospf6_neighbor *from, struct ospf6_lsa *lsa)
   ospf6_flood_process (from, lsa, ospf6);
 }
 
-static void
-ospf6_flood_clear_interface (struct ospf6_lsa *lsa, struct ospf6_interface *oi)
-{
-  struct listnode *node, *nnode;
-  struct ospf6_neighbor *on;
-  struct ospf6_lsa *rem;
-
-  for (ALL_LIST_ELEMENTS (oi->neighbor_list, node, nnode, on))
-    {
-      rem = ospf6_lsdb_lookup (lsa->header->type, lsa->header->id,
-                               lsa->header->adv_router, on->retrans_list);
-      if (rem && ! ospf6_lsa_compare (rem, lsa))
-        {
-          if (IS_OSPF6_DEBUG_FLOODING ||
-              IS_OSPF6_DEBUG_FLOOD_TYPE (lsa->header->type))
-            zlog_debug ("Remove %s from retrans_list of %s",
-                       rem->name, on->name);
-          ospf6_decrement_retrans_count (rem);
-          ospf6_lsdb_remove (rem, on->retrans_list);
-        }
-    }
-}
-
-static void
-ospf6_flood_clear_area (struct ospf6_lsa *lsa, struct ospf6_area *oa)
-{
-  struct listnode *node, *nnode;
-  struct ospf6_interface *oi;
-
-  for (ALL_LIST_ELEMENTS (oa->if_list, node, nnode, oi))
-    {
-      if (OSPF6_LSA_SCOPE (lsa->header->type) == OSPF6_SCOPE_LINKLOCAL &&
-          oi != OSPF6_INTERFACE (lsa->lsdb->data))
-        continue;
-
-#if 0
-      if (OSPF6_LSA_SCOPE (lsa->header->type) == OSPF6_SCOPE_AS &&
-          ospf6_is_interface_virtual_link (oi))
-        continue;
-#endif/*0*/
-
-      ospf6_flood_clear_interface (lsa, oi);
-    }
-}
-
-static void
-ospf6_flood_clear_process (struct ospf6_lsa *lsa, struct ospf6 *process)
+/* Remove this instance of the LSA from the retransmission lists of
+   every neighbor it is on. */
+void
+ospf6_flood_clear (struct ospf6_lsa *lsa)
 {
-  struct listnode *node, *nnode;
-  struct ospf6_area *oa;
+  struct ilistnode *node, *nnode;
+  struct ospf6_retrans *rt;
 
-  for (ALL_LIST_ELEMENTS (process->area_list, node, nnode, oa))
+  for (ALL_ILIST_ELEMENTS (&lsa->retrans, node, nnode, rt,
+                           struct ospf6_retrans, lsa_node))
     {
-      if (OSPF6_LSA_SCOPE (lsa->header->type) == OSPF6_SCOPE_AREA &&
-          oa != OSPF6_AREA (lsa->lsdb->data))
-        continue;
-      if (OSPF6_LSA_SCOPE (lsa->header->type) == OSPF6_SCOPE_LINKLOCAL &&
-          oa != OSPF6_INTERFACE (lsa->lsdb->data)->area)
-        continue;
-
-      if (ntohs (lsa->header->type) == OSPF6_LSTYPE_AS_EXTERNAL &&
-          IS_AREA_STUB (oa))
-        continue;
-
-      ospf6_flood_clear_area (lsa, oa);
+      if (IS_OSPF6_DEBUG_FLOODING ||
+          IS_OSPF6_DEBUG_FLOOD_TYPE (lsa->header->type))
+        zlog_debug ("Remove %s from retrans_list of %s",
+                    lsa->name, rt->on->name);
+      ospf6_retrans_free (rt);
     }
 }
 
-void
-ospf6_flood_clear (struct ospf6_lsa *lsa)
-{
-  ospf6_flood_clear_process (lsa, ospf6);
-}
-
 
 /* RFC2328 13.5 (Table 19): Sending link state acknowledgements. */
 static void
@@ -731,7 +778,7 @@ void
 ospf6_receive_lsa (struct ospf6_neighbor *from,
                    struct ospf6_lsa_header *lsa_header)
 {
-  struct ospf6_lsa *new = NULL, *old = NULL, *rem = NULL;
+  struct ospf6_lsa *new = NULL, *old = NULL;
   int ismore_recent;
   int is_debug = 0;
 
@@ -913,9 +960,7 @@ ospf6_receive_lsa (struct ospf6_neighbor *from,
         zlog_debug ("The same instance as database copy (neither recent)");
 
       /* (a) if on retrans-list, Treat this LSA as an Ack: Implied Ack */
-      rem = ospf6_lsdb_lookup (new->header->type, new->header->id,
-                               new->header->adv_router, from->retrans_list);
-      if (rem)
+      if (ospf6_retrans_lookup (from, new))
         {
           if (is_debug)
             {
@@ -923,8 +968,7 @@ ospf6_receive_lsa (struct ospf6_neighbor *from,
               zlog_debug ("Treat as an Implied acknowledgement");
             }
           SET_FLAG (new->flag, OSPF6_LSA_IMPLIEDACK);
-          ospf6_decrement_retrans_count (rem);
-          ospf6_lsdb_remove (rem, from->retrans_list);
+          ospf6_retrans_delete (from, new);
         }
 
       if (is_debug)
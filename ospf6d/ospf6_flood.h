@@ -31,6 +31,17 @@ extern unsigned char conf_debug_ospf6_flooding;
 #define IS_OSPF6_DEBUG_FLOODING \
   (conf_debug_ospf6_flooding)
 
+/* An LSA instance waiting to be acknowledged by a neighbor. */
+struct ospf6_retrans
+{
+  struct ospf6_lsa *lsa;
+  struct ospf6_neighbor *on;
+
+  /* On lsa->retrans and on on->retrans_list. */
+  struct ilistnode lsa_node;
+  struct ilistnode on_node;
+};
+
 /* Function Prototypes */
 extern struct ospf6_lsdb *ospf6_get_scoped_lsdb (struct ospf6_lsa *lsa);
 extern struct ospf6_lsdb *ospf6_get_scoped_lsdb_self (struct ospf6_lsa *lsa);
@@ -45,9 +56,16 @@ extern void ospf6_lsa_originate_interface (struct ospf6_lsa *lsa,
                                            struct ospf6_interface *oi);
 extern void ospf6_lsa_purge (struct ospf6_lsa *lsa);
 
-/* access method to retrans_count */
-extern void ospf6_increment_retrans_count (struct ospf6_lsa *lsa);
-extern void ospf6_decrement_retrans_count (struct ospf6_lsa *lsa);
+/* neighbor's retransmission list */
+extern void ospf6_retrans_init (struct ospf6 *o);
+extern void ospf6_retrans_finish (struct ospf6 *o);
+extern void ospf6_retrans_add (struct ospf6_neighbor *on,
+                               struct ospf6_lsa *lsa);
+extern void ospf6_retrans_delete (struct ospf6_neighbor *on,
+                                  struct ospf6_lsa *lsa);
+extern struct ospf6_lsa *ospf6_retrans_lookup (struct ospf6_neighbor *on,
+                                               struct ospf6_lsa *lsa);
+extern void ospf6_retrans_clear (struct ospf6_neighbor *on);
 
 /* flooding & clear flooding */
 extern void ospf6_flood_clear (struct ospf6_lsa *lsa);
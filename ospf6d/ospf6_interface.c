@@ -313,6 +313,7 @@ ospf6_interface_connected_route_update (struct interface *ifp)
   struct ospf6_route *route;
   struct connected *c;
   struct listnode *node, *nnode;
+  struct ospf6_nexthop nh;
 
   oi = (struct ospf6_interface *) ifp->info;
   if (oi == NULL)
@@ -365,8 +366,9 @@ ospf6_interface_connected_route_update (struct interface *ifp)
       route->path.area_id = oi->area->area_id;
       route->path.type = OSPF6_PATH_TYPE_INTRA;
       route->path.cost = oi->cost;
-      route->nexthop[0].ifindex = oi->interface->ifindex;
-      inet_pton (AF_INET6, "::1", &route->nexthop[0].address);
+      nh.ifindex = oi->interface->ifindex;
+      inet_pton (AF_INET6, "::1", &nh.address);
+      ospf6_route_set_nexthops (route, &nh, 1);
       ospf6_route_add (route, oi->route_connected);
     }
 
@@ -103,6 +103,10 @@ struct ospf6_interface
   struct thread *thread_link_lsa;
   struct thread *thread_intra_prefix_lsa;
 
+  /* Last Link and Intra-Area-Prefix LSA originations, for MinLSInterval */
+  struct timeval ts_link_lsa;
+  struct timeval ts_intra_prefix_lsa;
+
   struct ospf6_route_table *route_connected;
 
   /* prefix-list name to filter connected prefix */
@@ -516,6 +516,40 @@ ospf6_link_lsa_show (struct vty *vty, struct ospf6_lsa *lsa)
   return 0;
 }
 
+/* Schedule an origination through *t.  Triggers that come while one is
+   pending are merged into it, and a run comes no sooner than
+   MinLSInterval after the last one at *last, so that an address flap
+   storm originates, floods and has the SPF run once per interval. */
+void
+ospf6_lsa_schedule_throttled (struct thread **t, int (*func) (struct thread *),
+                              void *arg, struct timeval *last)
+{
+  struct timeval now, res;
+  long msec;
+
+  if (*t)
+    {
+      if (ospf6)
+        ospf6->lsa_coalesced++;
+      return;
+    }
+
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &now);
+  timersub (&now, last, &res);
+  msec = res.tv_sec * 1000 + res.tv_usec / 1000;
+
+  if (! timerisset (last) || msec >= MIN_LS_INTERVAL * 1000)
+    {
+      *t = thread_add_event (master, func, arg, 0);
+      return;
+    }
+
+  *t = thread_add_timer_msec (master, func, arg,
+                              MIN_LS_INTERVAL * 1000 - msec);
+  if (ospf6)
+    ospf6->lsa_throttled++;
+}
+
 int
 ospf6_link_lsa_originate (struct thread *thread)
 {
@@ -531,6 +565,7 @@ ospf6_link_lsa_originate (struct thread *thread)
 
   oi = (struct ospf6_interface *) THREAD_ARG (thread);
   oi->thread_link_lsa = NULL;
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &oi->ts_link_lsa);
 
   assert (oi->area);
 
@@ -694,6 +729,7 @@ ospf6_intra_prefix_lsa_originate_stub (struct thread *thread)
 
   oa = (struct ospf6_area *) THREAD_ARG (thread);
   oa->thread_intra_prefix_lsa = NULL;
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &oa->ts_intra_prefix_lsa);
 
   /* find previous LSA */
   old = ospf6_lsdb_lookup (htons (OSPF6_LSTYPE_INTRA_PREFIX),
@@ -846,6 +882,7 @@ ospf6_intra_prefix_lsa_originate_transit (struct thread *thread)
 
   oi = (struct ospf6_interface *) THREAD_ARG (thread);
   oi->thread_intra_prefix_lsa = NULL;
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &oi->ts_intra_prefix_lsa);
 
   assert (oi->area);
 
@@ -1025,7 +1062,7 @@ ospf6_intra_prefix_lsa_add (struct ospf6_lsa *lsa)
   struct ospf6_intra_prefix_lsa *intra_prefix_lsa;
   struct prefix ls_prefix;
   struct ospf6_route *route, *ls_entry;
-  int i, prefix_num;
+  int prefix_num;
   struct ospf6_prefix *op;
   char *start, *current, *end;
   char buf[64];
@@ -1095,9 +1132,7 @@ ospf6_intra_prefix_lsa_add (struct ospf6_lsa *lsa)
       route->path.cost = ls_entry->path.cost +
                          ntohs (op->prefix_metric);
 
-      for (i = 0; ospf6_nexthop_is_set (&ls_entry->nexthop[i]) &&
-           i < OSPF6_MULTI_PATH_LIMIT; i++)
-        ospf6_nexthop_copy (&route->nexthop[i], &ls_entry->nexthop[i]);
+      ospf6_route_copy_nexthops (route, ls_entry);
 
       if (IS_OSPF6_DEBUG_EXAMIN (INTRA_PREFIX))
         {
@@ -1229,8 +1264,7 @@ ospf6_intra_route_calculation (struct ospf6_area *oa)
       else if (CHECK_FLAG (route->flag, OSPF6_ROUTE_ADD) ||
                CHECK_FLAG (route->flag, OSPF6_ROUTE_CHANGE))
         {
-          if (hook_add)
-            (*hook_add) (route);
+          ospf6_route_notify_add (route, oa->route_table);
         }
 
       route->flag = 0;
@@ -1397,8 +1431,7 @@ ospf6_intra_brouter_calculation (struct ospf6_area *oa)
                        brouter_name, oa->name);
 
           /* newly added */
-          if (hook_add)
-            (*hook_add) (brouter);
+          ospf6_route_notify_add (brouter, oa->ospf6->brouter_table);
         }
       else
         {
@@ -159,26 +159,20 @@ struct ospf6_intra_prefix_lsa
       (oi)->thread_network_lsa = \
         thread_add_event (master, ospf6_network_lsa_originate, oi, 0); \
   } while (0)
+/* Link and Intra-Area-Prefix LSAs are throttled to MinLSInterval, see
+   ospf6_lsa_schedule_throttled(). */
 #define OSPF6_LINK_LSA_SCHEDULE(oi) \
-  do { \
-    if (! (oi)->thread_link_lsa) \
-      (oi)->thread_link_lsa = \
-        thread_add_event (master, ospf6_link_lsa_originate, oi, 0); \
-  } while (0)
+  ospf6_lsa_schedule_throttled (&(oi)->thread_link_lsa, \
+                                ospf6_link_lsa_originate, oi, \
+                                &(oi)->ts_link_lsa)
 #define OSPF6_INTRA_PREFIX_LSA_SCHEDULE_STUB(oa) \
-  do { \
-    if (! (oa)->thread_intra_prefix_lsa) \
-      (oa)->thread_intra_prefix_lsa = \
-        thread_add_event (master, ospf6_intra_prefix_lsa_originate_stub, \
-                          oa, 0); \
-  } while (0)
+  ospf6_lsa_schedule_throttled (&(oa)->thread_intra_prefix_lsa, \
+                                ospf6_intra_prefix_lsa_originate_stub, oa, \
+                                &(oa)->ts_intra_prefix_lsa)
 #define OSPF6_INTRA_PREFIX_LSA_SCHEDULE_TRANSIT(oi) \
-  do { \
-    if (! (oi)->thread_intra_prefix_lsa) \
-      (oi)->thread_intra_prefix_lsa = \
-        thread_add_event (master, ospf6_intra_prefix_lsa_originate_transit, \
-                          oi, 0); \
-  } while (0)
+  ospf6_lsa_schedule_throttled (&(oi)->thread_intra_prefix_lsa, \
+                                ospf6_intra_prefix_lsa_originate_transit, oi, \
+                                &(oi)->ts_intra_prefix_lsa)
 
 #define OSPF6_NETWORK_LSA_EXECUTE(oi) \
   do { \
@@ -205,6 +199,9 @@ extern int ospf6_network_lsa_originate (struct thread *);
 extern int ospf6_link_lsa_originate (struct thread *);
 extern int ospf6_intra_prefix_lsa_originate_transit (struct thread *);
 extern int ospf6_intra_prefix_lsa_originate_stub (struct thread *);
+extern void ospf6_lsa_schedule_throttled (struct thread **,
+                                          int (*) (struct thread *),
+                                          void *, struct timeval *);
 extern void ospf6_intra_prefix_lsa_add (struct ospf6_lsa *lsa);
 extern void ospf6_intra_prefix_lsa_remove (struct ospf6_lsa *lsa);
 
@@ -236,16 +236,24 @@ ospf6_lsa_age_current (struct ospf6_lsa *lsa)
   return age;
 }
 
-/* update age field of LSA header with adding InfTransDelay */
-void
-ospf6_lsa_age_update_to_send (struct ospf6_lsa *lsa, u_int32_t transdelay)
+/* age of LSA with adding InfTransDelay, for a copy being sent, without
+   changing the LSA itself */
+u_int16_t
+ospf6_lsa_age_to_send (struct ospf6_lsa *lsa, u_int32_t transdelay)
 {
-  unsigned short age;
+  u_int32_t age;
 
   age = ospf6_lsa_age_current (lsa) + transdelay;
   if (age > MAXAGE)
     age = MAXAGE;
-  lsa->header->age = htons (age);
+  return age;
+}
+
+/* update age field of LSA header with adding InfTransDelay */
+void
+ospf6_lsa_age_update_to_send (struct ospf6_lsa *lsa, u_int32_t transdelay)
+{
+  lsa->header->age = htons (ospf6_lsa_age_to_send (lsa, transdelay));
 }
 
 void
@@ -22,6 +22,8 @@
 #ifndef OSPF6_LSA_H
 #define OSPF6_LSA_H
 
+#include "linklist.h"
+
 /* Debug option */
 #define OSPF6_LSA_DEBUG           0x01
 #define OSPF6_LSA_DEBUG_ORIGINATE 0x02
@@ -116,6 +118,8 @@ struct ospf6_lsa
 
   struct ospf6_lsa *prev;
   struct ospf6_lsa *next;
+  struct ospf6_lsa **skip;          /* LSDB skiplist links above next */
+  u_char            skip_level;     /* number of those */
 
   unsigned char     lock;           /* reference counter */
   unsigned char     flag;           /* special meaning (e.g. floodback) */
@@ -128,7 +132,8 @@ struct ospf6_lsa
   struct thread    *expire;
   struct thread    *refresh;        /* For self-originated LSA */
 
-  int               retrans_count;
+  /* neighbors' retransmission lists this instance is on */
+  struct ilist      retrans;        /* struct ospf6_retrans */
 
   struct ospf6_lsdb *lsdb;
 
@@ -212,6 +217,7 @@ extern u_char ospf6_lstype_debug (u_int16_t type);
 extern int ospf6_lsa_is_differ (struct ospf6_lsa *lsa1, struct ospf6_lsa *lsa2);
 extern int ospf6_lsa_is_changed (struct ospf6_lsa *lsa1, struct ospf6_lsa *lsa2);
 extern u_int16_t ospf6_lsa_age_current (struct ospf6_lsa *);
+extern u_int16_t ospf6_lsa_age_to_send (struct ospf6_lsa *, u_int32_t);
 extern void ospf6_lsa_age_update_to_send (struct ospf6_lsa *, u_int32_t);
 extern void ospf6_lsa_premature_aging (struct ospf6_lsa *);
 extern int ospf6_lsa_compare (struct ospf6_lsa *, struct ospf6_lsa *);
@@ -27,12 +27,43 @@
 #include "prefix.h"
 #include "table.h"
 #include "vty.h"
+#include "hash.h"
+#include "jhash.h"
 
 #include "ospf6_proto.h"
 #include "ospf6_lsa.h"
 #include "ospf6_lsdb.h"
 #include "ospf6d.h"
 
+/* The LSAs of an LSDB are kept in two indexes:
+ *
+ *  - an open hash by type, ID and advertising router, for lookups;
+ *  - a skiplist in order of type, advertising router and ID, for walks
+ *    and for the start of a type or type and router range.  Its lowest
+ *    level is the prev/next list of the LSAs themselves, and only the
+ *    LSAs with more levels carry an array of further links.
+ */
+
+static unsigned int
+ospf6_lsdb_hash_key (void *arg)
+{
+  struct ospf6_lsa *lsa = arg;
+
+  return jhash_3words (lsa->header->type, lsa->header->id,
+                       lsa->header->adv_router, 0);
+}
+
+static int
+ospf6_lsdb_hash_cmp (const void *arg1, const void *arg2)
+{
+  const struct ospf6_lsa *lsa1 = arg1;
+  const struct ospf6_lsa *lsa2 = arg2;
+
+  return (lsa1->header->type == lsa2->header->type &&
+          lsa1->header->id == lsa2->header->id &&
+          lsa1->header->adv_router == lsa2->header->adv_router);
+}
+
 struct ospf6_lsdb *
 ospf6_lsdb_create (void *data)
 {
@@ -47,7 +78,8 @@ ospf6_lsdb_create (void *data)
   memset (lsdb, 0, sizeof (struct ospf6_lsdb));
 
   lsdb->data = data;
-  lsdb->table = route_table_init ();
+  lsdb->index = hash_create_open (0, ospf6_lsdb_hash_key,
+                                  ospf6_lsdb_hash_cmp);
   return lsdb;
 }
 
@@ -55,19 +87,139 @@ void
 ospf6_lsdb_delete (struct ospf6_lsdb *lsdb)
 {
   ospf6_lsdb_remove_all (lsdb);
-  route_table_finish (lsdb->table);
+  hash_free (lsdb->index);
   XFREE (MTYPE_OSPF6_LSDB, lsdb);
 }
 
+/* Order of the skiplist: the key in network byte order, compared as
+   the bytes of type, advertising router and ID. */
+static int
+ospf6_lsdb_key_cmp (struct ospf6_lsa *lsa, u_int16_t type,
+                    u_int32_t adv_router, u_int32_t id)
+{
+  if (lsa->header->type != type)
+    return (ntohs (lsa->header->type) < ntohs (type) ? -1 : 1);
+  if (lsa->header->adv_router != adv_router)
+    return (ntohl (lsa->header->adv_router) < ntohl (adv_router) ? -1 : 1);
+  if (lsa->header->id != id)
+    return (ntohl (lsa->header->id) < ntohl (id) ? -1 : 1);
+  return 0;
+}
+
+/* Link at level i after lsa, or from the head for NULL. */
+static struct ospf6_lsa **
+ospf6_lsdb_forward (struct ospf6_lsdb *lsdb, struct ospf6_lsa *lsa, int i)
+{
+  if (lsa == NULL)
+    return &lsdb->skip[i];
+  if (i == 0)
+    return &lsa->next;
+  return &lsa->skip[i - 1];
+}
+
+/* Find the last LSA before the key at each level, and return the first
+   one at or after it. */
+static struct ospf6_lsa *
+ospf6_lsdb_search (struct ospf6_lsdb *lsdb, u_int16_t type,
+                   u_int32_t adv_router, u_int32_t id,
+                   struct ospf6_lsa **update)
+{
+  struct ospf6_lsa *x = NULL, *next;
+  int i;
+
+  for (i = lsdb->level - 1; i >= 0; i--)
+    {
+      while ((next = *ospf6_lsdb_forward (lsdb, x, i)) != NULL &&
+             ospf6_lsdb_key_cmp (next, type, adv_router, id) < 0)
+        x = next;
+      if (update)
+        update[i] = x;
+    }
+
+  return *ospf6_lsdb_forward (lsdb, x, 0);
+}
+
+static int
+ospf6_lsdb_random_level (void)
+{
+  int level = 1;
+
+  while (level < OSPF6_LSDB_SKIP_LEVELS && (random () & 3) == 0)
+    level++;
+  return level;
+}
+
+static void
+ospf6_lsdb_skip_insert (struct ospf6_lsdb *lsdb, struct ospf6_lsa *lsa,
+                        struct ospf6_lsa **update)
+{
+  struct ospf6_lsa **forward;
+  int level, i;
+
+  level = ospf6_lsdb_random_level ();
+  for (i = lsdb->level; i < level; i++)
+    update[i] = NULL;
+  if (level > lsdb->level)
+    lsdb->level = level;
+
+  lsa->skip_level = level - 1;
+  if (lsa->skip_level)
+    lsa->skip = XCALLOC (MTYPE_OSPF6_LSDB,
+                         lsa->skip_level * sizeof (struct ospf6_lsa *));
+
+  for (i = 0; i < level; i++)
+    {
+      forward = ospf6_lsdb_forward (lsdb, update[i], i);
+      *ospf6_lsdb_forward (lsdb, lsa, i) = *forward;
+      *forward = lsa;
+    }
+
+  lsa->prev = update[0];
+  if (lsa->next)
+    lsa->next->prev = lsa;
+}
+
+/* Put lsa in the place of old, which keeps its next link for walks
+   still holding it. */
 static void
-ospf6_lsdb_set_key (struct prefix_ipv6 *key, void *value, int len)
+ospf6_lsdb_skip_replace (struct ospf6_lsdb *lsdb, struct ospf6_lsa *old,
+                         struct ospf6_lsa *lsa, struct ospf6_lsa **update)
 {
-  assert (key->prefixlen % 8 == 0);
+  int i;
+
+  for (i = 0; i <= old->skip_level; i++)
+    *ospf6_lsdb_forward (lsdb, update[i], i) = lsa;
+
+  lsa->prev = old->prev;
+  lsa->next = old->next;
+  if (lsa->next)
+    lsa->next->prev = lsa;
+
+  lsa->skip = old->skip;
+  lsa->skip_level = old->skip_level;
+  old->skip = NULL;
+  old->skip_level = 0;
+}
+
+/* Unlink lsa, which also keeps its next link. */
+static void
+ospf6_lsdb_skip_remove (struct ospf6_lsdb *lsdb, struct ospf6_lsa *lsa,
+                        struct ospf6_lsa **update)
+{
+  int i;
+
+  for (i = 0; i <= lsa->skip_level; i++)
+    *ospf6_lsdb_forward (lsdb, update[i], i) =
+      *ospf6_lsdb_forward (lsdb, lsa, i);
+  if (lsa->next)
+    lsa->next->prev = lsa->prev;
+
+  if (lsa->skip)
+    XFREE (MTYPE_OSPF6_LSDB, lsa->skip);
+  lsa->skip_level = 0;
 
-  memcpy ((caddr_t) &key->prefix + key->prefixlen / 8,
-          (caddr_t) value, len);
-  key->family = AF_INET6;
-  key->prefixlen += len * 8;
+  while (lsdb->level > 0 && lsdb->skip[lsdb->level - 1] == NULL)
+    lsdb->level--;
 }
 
 #ifndef NDEBUG
@@ -101,66 +253,32 @@ _lsdb_count_assert (struct ospf6_lsdb *lsdb)
 void
 ospf6_lsdb_add (struct ospf6_lsa *lsa, struct ospf6_lsdb *lsdb)
 {
-  struct prefix_ipv6 key;
-  struct route_node *current, *nextnode, *prevnode;
-  struct ospf6_lsa *next, *prev, *old = NULL;
-
-  memset (&key, 0, sizeof (key));
-  ospf6_lsdb_set_key (&key, &lsa->header->type, sizeof (lsa->header->type));
-  ospf6_lsdb_set_key (&key, &lsa->header->adv_router,
-                      sizeof (lsa->header->adv_router));
-  ospf6_lsdb_set_key (&key, &lsa->header->id, sizeof (lsa->header->id));
-
-  current = route_node_get (lsdb->table, (struct prefix *) &key);
-  old = current->info;
-  current->info = lsa;
+  struct ospf6_lsa *update[OSPF6_LSDB_SKIP_LEVELS];
+  struct ospf6_lsa *old;
+
+  old = ospf6_lsdb_search (lsdb, lsa->header->type, lsa->header->adv_router,
+                           lsa->header->id, update);
+  if (old && ospf6_lsdb_key_cmp (old, lsa->header->type,
+                                 lsa->header->adv_router,
+                                 lsa->header->id) != 0)
+    old = NULL;
+
+  if (old == lsa)
+    return;
+
   ospf6_lsa_lock (lsa);
 
   if (old)
     {
-      if (old->prev)
-        old->prev->next = lsa;
-      if (old->next)
-        old->next->prev = lsa;
-      lsa->next = old->next;
-      lsa->prev = old->prev;
+      ospf6_lsdb_skip_replace (lsdb, old, lsa, update);
+      hash_release (lsdb->index, old);
     }
   else
     {
-      /* next link */
-      nextnode = current;
-      route_lock_node (nextnode);
-      do {
-        nextnode = route_next (nextnode);
-      } while (nextnode && nextnode->info == NULL);
-      if (nextnode == NULL)
-        lsa->next = NULL;
-      else
-        {
-          next = nextnode->info;
-          lsa->next = next;
-          next->prev = lsa;
-          route_unlock_node (nextnode);
-        }
-
-      /* prev link */
-      prevnode = current;
-      route_lock_node (prevnode);
-      do {
-        prevnode = route_prev (prevnode);
-      } while (prevnode && prevnode->info == NULL);
-      if (prevnode == NULL)
-        lsa->prev = NULL;
-      else
-        {
-          prev = prevnode->info;
-          lsa->prev = prev;
-          prev->next = lsa;
-          route_unlock_node (prevnode);
-        }
-
+      ospf6_lsdb_skip_insert (lsdb, lsa, update);
       lsdb->count++;
     }
+  hash_get (lsdb->index, lsa, hash_alloc_intern);
 
   if (old)
     {
@@ -208,31 +326,22 @@ ospf6_lsdb_add (struct ospf6_lsa *lsa, struct ospf6_lsdb *lsdb)
 void
 ospf6_lsdb_remove (struct ospf6_lsa *lsa, struct ospf6_lsdb *lsdb)
 {
-  struct route_node *node;
-  struct prefix_ipv6 key;
-
-  memset (&key, 0, sizeof (key));
-  ospf6_lsdb_set_key (&key, &lsa->header->type, sizeof (lsa->header->type));
-  ospf6_lsdb_set_key (&key, &lsa->header->adv_router,
-                      sizeof (lsa->header->adv_router));
-  ospf6_lsdb_set_key (&key, &lsa->header->id, sizeof (lsa->header->id));
+  struct ospf6_lsa *update[OSPF6_LSDB_SKIP_LEVELS];
+  struct ospf6_lsa *found;
 
-  node = route_node_lookup (lsdb->table, (struct prefix *) &key);
-  assert (node && node->info == lsa);
+  found = ospf6_lsdb_search (lsdb, lsa->header->type,
+                             lsa->header->adv_router, lsa->header->id,
+                             update);
+  assert (found == lsa);
 
-  if (lsa->prev)
-    lsa->prev->next = lsa->next;
-  if (lsa->next)
-    lsa->next->prev = lsa->prev;
-
-  node->info = NULL;
+  ospf6_lsdb_skip_remove (lsdb, lsa, update);
+  hash_release (lsdb->index, lsa);
   lsdb->count--;
 
   if (lsdb->hook_remove)
     (*lsdb->hook_remove) (lsa);
 
   ospf6_lsa_unlock (lsa);
-  route_unlock_node (node);
 
   ospf6_lsdb_count_assert (lsdb);
 }
@@ -241,115 +350,45 @@ struct ospf6_lsa *
 ospf6_lsdb_lookup (u_int16_t type, u_int32_t id, u_int32_t adv_router,
                    struct ospf6_lsdb *lsdb)
 {
-  struct route_node *node;
-  struct prefix_ipv6 key;
+  struct ospf6_lsa_header header;
+  struct ospf6_lsa key;
 
   if (lsdb == NULL)
     return NULL;
 
-  memset (&key, 0, sizeof (key));
-  ospf6_lsdb_set_key (&key, &type, sizeof (type));
-  ospf6_lsdb_set_key (&key, &adv_router, sizeof (adv_router));
-  ospf6_lsdb_set_key (&key, &id, sizeof (id));
+  header.type = type;
+  header.id = id;
+  header.adv_router = adv_router;
+  key.header = &header;
 
-  node = route_node_lookup (lsdb->table, (struct prefix *) &key);
-  if (node == NULL || node->info == NULL)
-    return NULL;
-  return (struct ospf6_lsa *) node->info;
+  return hash_lookup (lsdb->index, &key);
 }
 
+/* The LSA following the key, whether or not an LSA has that key. */
 struct ospf6_lsa *
 ospf6_lsdb_lookup_next (u_int16_t type, u_int32_t id, u_int32_t adv_router,
                         struct ospf6_lsdb *lsdb)
 {
-  struct route_node *node;
-  struct route_node *matched = NULL;
-  struct prefix_ipv6 key;
-  struct prefix *p;
+  struct ospf6_lsa *lsa;
 
   if (lsdb == NULL)
     return NULL;
 
-  memset (&key, 0, sizeof (key));
-  ospf6_lsdb_set_key (&key, &type, sizeof (type));
-  ospf6_lsdb_set_key (&key, &adv_router, sizeof (adv_router));
-  ospf6_lsdb_set_key (&key, &id, sizeof (id));
-  p = (struct prefix *) &key;
-
-  {
-    char buf[64];
-    prefix2str (p, buf, sizeof (buf));
-    zlog_debug ("lsdb_lookup_next: key: %s", buf);
-  }
-
-  node = lsdb->table->top;
-  /* walk down tree. */
-  while (node && node->p.prefixlen <= p->prefixlen &&
-         prefix_match (&node->p, p))
-    {
-      matched = node;
-      node = node->link[prefix_bit(&p->u.prefix, node->p.prefixlen)];
-    }
-
-  if (matched)
-    node = matched;
-  else
-    node = lsdb->table->top;
-  route_lock_node (node);
-
-  /* skip to real existing entry */
-  while (node && node->info == NULL)
-    node = route_next (node);
-
-  if (! node)
-    return NULL;
-
-  if (prefix_same (&node->p, p))
-    {
-      struct route_node *prev = node;
-      struct ospf6_lsa *lsa_prev;
-      struct ospf6_lsa *lsa_next;
-
-      node = route_next (node);
-      while (node && node->info == NULL)
-        node = route_next (node);
-
-      lsa_prev = prev->info;
-      lsa_next = (node ? node->info : NULL);
-      assert (lsa_prev);
-      assert (lsa_prev->next == lsa_next);
-      if (lsa_next)
-        assert (lsa_next->prev == lsa_prev);
-      zlog_debug ("lsdb_lookup_next: assert OK with previous LSA");
-    }
-
-  if (! node)
-    return NULL;
-
-  route_unlock_node (node);
-  return (struct ospf6_lsa *) node->info;
+  lsa = ospf6_lsdb_search (lsdb, type, adv_router, id, NULL);
+  if (lsa && ospf6_lsdb_key_cmp (lsa, type, adv_router, id) == 0)
+    lsa = lsa->next;
+  return lsa;
 }
 
 /* Iteration function */
 struct ospf6_lsa *
 ospf6_lsdb_head (struct ospf6_lsdb *lsdb)
 {
-  struct route_node *node;
+  struct ospf6_lsa *lsa = lsdb->skip[0];
 
-  node = route_top (lsdb->table);
-  if (node == NULL)
-    return NULL;
-
-  /* skip to the existing lsdb entry */
-  while (node && node->info == NULL)
-    node = route_next (node);
-  if (node == NULL)
-    return NULL;
-
-  route_unlock_node (node);
-  if (node->info)
-    ospf6_lsa_lock ((struct ospf6_lsa *) node->info);
-  return (struct ospf6_lsa *) node->info;
+  if (lsa)
+    ospf6_lsa_lock (lsa);
+  return lsa;
 }
 
 struct ospf6_lsa *
@@ -368,37 +407,14 @@ struct ospf6_lsa *
 ospf6_lsdb_type_router_head (u_int16_t type, u_int32_t adv_router,
                              struct ospf6_lsdb *lsdb)
 {
-  struct route_node *node;
-  struct prefix_ipv6 key;
   struct ospf6_lsa *lsa;
 
-  memset (&key, 0, sizeof (key));
-  ospf6_lsdb_set_key (&key, &type, sizeof (type));
-  ospf6_lsdb_set_key (&key, &adv_router, sizeof (adv_router));
-
-  node = lsdb->table->top;
-
-  /* Walk down tree. */
-  while (node && node->p.prefixlen <= key.prefixlen &&
-	 prefix_match (&node->p, (struct prefix *) &key))
-    node = node->link[prefix6_bit(&key.prefix, node->p.prefixlen)];
-
-  if (node)
-    route_lock_node (node);
-  while (node && node->info == NULL)
-    node = route_next (node);
-
-  if (node == NULL)
+  lsa = ospf6_lsdb_search (lsdb, type, adv_router, 0, NULL);
+  if (lsa == NULL || lsa->header->type != type ||
+      lsa->header->adv_router != adv_router)
     return NULL;
-  else
-    route_unlock_node (node);
 
-  if (! prefix_match ((struct prefix *) &key, &node->p))
-    return NULL;
-
-  lsa = node->info;
   ospf6_lsa_lock (lsa);
-
   return lsa;
 }
 
@@ -424,35 +440,13 @@ ospf6_lsdb_type_router_next (u_int16_t type, u_int32_t adv_router,
 struct ospf6_lsa *
 ospf6_lsdb_type_head (u_int16_t type, struct ospf6_lsdb *lsdb)
 {
-  struct route_node *node;
-  struct prefix_ipv6 key;
   struct ospf6_lsa *lsa;
 
-  memset (&key, 0, sizeof (key));
-  ospf6_lsdb_set_key (&key, &type, sizeof (type));
-
-  /* Walk down tree. */
-  node = lsdb->table->top;
-  while (node && node->p.prefixlen <= key.prefixlen &&
-	 prefix_match (&node->p, (struct prefix *) &key))
-    node = node->link[prefix6_bit(&key.prefix, node->p.prefixlen)];
-
-  if (node)
-    route_lock_node (node);
-  while (node && node->info == NULL)
-    node = route_next (node);
-
-  if (node == NULL)
-    return NULL;
-  else
-    route_unlock_node (node);
-
-  if (! prefix_match ((struct prefix *) &key, &node->p))
+  lsa = ospf6_lsdb_search (lsdb, type, 0, 0, NULL);
+  if (lsa == NULL || lsa->header->type != type)
     return NULL;
 
-  lsa = node->info;
   ospf6_lsa_lock (lsa);
-
   return lsa;
 }
 
@@ -25,10 +25,15 @@
 #include "prefix.h"
 #include "table.h"
 
+#define OSPF6_LSDB_SKIP_LEVELS 16
+
 struct ospf6_lsdb
 {
   void *data; /* data structure that holds this lsdb */
-  struct route_table *table;
+  struct hash *index; /* by type, ID and advertising router */
+  /* skiplist heads, skip[0] the first LSA; see ospf6_lsdb.c */
+  struct ospf6_lsa *skip[OSPF6_LSDB_SKIP_LEVELS];
+  int level;
   u_int32_t count;
   void (*hook_add) (struct ospf6_lsa *);
   void (*hook_remove) (struct ospf6_lsa *);
@@ -41,7 +46,7 @@ struct ospf6_lsdb
       {                                                                  \
         if (! OSPF6_LSA_IS_MAXAGE (lsa))                                 \
           continue;                                                      \
-        if (lsa->retrans_count != 0)                                     \
+        if (lsa->retrans.count != 0)                                     \
           continue;                                                      \
         if (IS_OSPF6_DEBUG_LSA_TYPE (lsa->header->type))                 \
           zlog_debug ("Remove MaxAge %s", lsa->name);                    \
@@ -1434,8 +1434,7 @@ ospf6_lsack_recv (struct in6_addr *src, struct in6_addr *dst,
         }
 
       /* Check if the LSA is on his retrans-list */
-      mine = ospf6_lsdb_lookup (his->header->type, his->header->id,
-                                his->header->adv_router, on->retrans_list);
+      mine = ospf6_retrans_lookup (on, his);
       if (mine == NULL)
         {
           if (IS_OSPF6_DEBUG_MESSAGE (oh->type, RECV))
@@ -1458,16 +1457,16 @@ ospf6_lsack_recv (struct in6_addr *src, struct in6_addr *dst,
         zlog_debug ("Acknowledged, remove from %s's retrans-list",
 		    on->name);
 
-      ospf6_decrement_retrans_count (mine);
       if (OSPF6_LSA_IS_MAXAGE (mine))
         ospf6_maxage_remove (on->ospf6_if->area->ospf6);
-      ospf6_lsdb_remove (mine, on->retrans_list);
+      ospf6_retrans_delete (on, mine);
       ospf6_lsa_delete (his);
     }
 
   assert (p == OSPF6_MESSAGE_END (oh));
 }
 
+/* recvbuf holds OSPF6_RECVMSG_BATCH buffers of iobuflen each. */
 static u_char *recvbuf = NULL;
 static u_char *sendbuf = NULL;
 static unsigned int iobuflen = 0;
@@ -1480,7 +1479,7 @@ ospf6_iobuf_size (unsigned int size)
   if (size <= iobuflen)
     return iobuflen;
 
-  recvnew = XMALLOC (MTYPE_OSPF6_MESSAGE, size);
+  recvnew = XMALLOC (MTYPE_OSPF6_MESSAGE, size * OSPF6_RECVMSG_BATCH);
   sendnew = XMALLOC (MTYPE_OSPF6_MESSAGE, size);
   if (recvnew == NULL || sendnew == NULL)
     {
@@ -1521,57 +1520,39 @@ ospf6_message_terminate (void)
   iobuflen = 0;
 }
 
-int
-ospf6_receive (struct thread *thread)
+/* Process one received message of len bytes. */
+static void
+ospf6_receive_message (struct in6_addr *src, struct in6_addr *dst,
+                       unsigned int ifindex, u_char *buf, unsigned int len)
 {
-  int sockfd;
-  unsigned int len;
   char srcname[64], dstname[64];
-  struct in6_addr src, dst;
-  unsigned int ifindex;
-  struct iovec iovector[2];
   struct ospf6_interface *oi;
   struct ospf6_header *oh;
 
-  /* add next read thread */
-  sockfd = THREAD_FD (thread);
-  thread_add_read (master, ospf6_receive, NULL, sockfd);
-
-  /* initialize */
-  memset (&src, 0, sizeof (src));
-  memset (&dst, 0, sizeof (dst));
-  ifindex = 0;
-  memset (recvbuf, 0, iobuflen);
-  iovector[0].iov_base = recvbuf;
-  iovector[0].iov_len = iobuflen;
-  iovector[1].iov_base = NULL;
-  iovector[1].iov_len = 0;
-
-  /* receive message */
-  len = ospf6_recvmsg (&src, &dst, &ifindex, iovector);
   if (len > iobuflen)
     {
       zlog_err ("Excess message read");
-      return 0;
+      return;
     }
+  memset (buf + len, 0, iobuflen - len);
 
   oi = ospf6_interface_lookup_by_ifindex (ifindex);
   if (oi == NULL || oi->area == NULL)
     {
       zlog_debug ("Message received on disabled interface");
-      return 0;
+      return;
     }
   if (CHECK_FLAG (oi->flag, OSPF6_INTERFACE_PASSIVE))
     {
       if (IS_OSPF6_DEBUG_MESSAGE (OSPF6_MESSAGE_TYPE_UNKNOWN, RECV))
         zlog_debug ("%s: Ignore message on passive interface %s",
                     __func__, oi->interface->name);
-      return 0;
+      return;
     }
 
-  oh = (struct ospf6_header *) recvbuf;
+  oh = (struct ospf6_header *) buf;
   if (ospf6_rxpacket_examin (oi, oh, len) != MSG_OK)
-    return 0;
+    return;
 
   /* Being here means, that no sizing/alignment issues were detected in
      the input packet. This renders the additional checks performed below
@@ -1581,8 +1562,8 @@ ospf6_receive (struct thread *thread)
   /* Log */
   if (IS_OSPF6_DEBUG_MESSAGE (oh->type, RECV))
     {
-      inet_ntop (AF_INET6, &src, srcname, sizeof (srcname));
-      inet_ntop (AF_INET6, &dst, dstname, sizeof (dstname));
+      inet_ntop (AF_INET6, src, srcname, sizeof (srcname));
+      inet_ntop (AF_INET6, dst, dstname, sizeof (dstname));
       zlog_debug ("%s received on %s",
                  LOOKUP (ospf6_message_type_str, oh->type), oi->interface->name);
       zlog_debug ("    src: %s", srcname);
@@ -1613,29 +1594,62 @@ ospf6_receive (struct thread *thread)
   switch (oh->type)
     {
       case OSPF6_MESSAGE_TYPE_HELLO:
-        ospf6_hello_recv (&src, &dst, oi, oh);
+        ospf6_hello_recv (src, dst, oi, oh);
         break;
 
       case OSPF6_MESSAGE_TYPE_DBDESC:
-        ospf6_dbdesc_recv (&src, &dst, oi, oh);
+        ospf6_dbdesc_recv (src, dst, oi, oh);
         break;
 
       case OSPF6_MESSAGE_TYPE_LSREQ:
-        ospf6_lsreq_recv (&src, &dst, oi, oh);
+        ospf6_lsreq_recv (src, dst, oi, oh);
         break;
 
       case OSPF6_MESSAGE_TYPE_LSUPDATE:
-        ospf6_lsupdate_recv (&src, &dst, oi, oh);
+        ospf6_lsupdate_recv (src, dst, oi, oh);
         break;
 
       case OSPF6_MESSAGE_TYPE_LSACK:
-        ospf6_lsack_recv (&src, &dst, oi, oh);
+        ospf6_lsack_recv (src, dst, oi, oh);
         break;
 
       default:
         assert (0);
     }
 
+}
+
+int
+ospf6_receive (struct thread *thread)
+{
+  int sockfd;
+  int count, i;
+  struct in6_addr src[OSPF6_RECVMSG_BATCH], dst[OSPF6_RECVMSG_BATCH];
+  unsigned int ifindex[OSPF6_RECVMSG_BATCH];
+  struct iovec iovector[OSPF6_RECVMSG_BATCH];
+  int len[OSPF6_RECVMSG_BATCH];
+
+  /* add next read thread */
+  sockfd = THREAD_FD (thread);
+  thread_add_read (master, ospf6_receive, NULL, sockfd);
+
+  /* initialize */
+  memset (src, 0, sizeof (src));
+  memset (dst, 0, sizeof (dst));
+  memset (ifindex, 0, sizeof (ifindex));
+  for (i = 0; i < OSPF6_RECVMSG_BATCH; i++)
+    {
+      iovector[i].iov_base = recvbuf + i * iobuflen;
+      iovector[i].iov_len = iobuflen;
+    }
+
+  /* receive what has queued up, then process it in order */
+  count = ospf6_recvmsg_batch (src, dst, ifindex, iovector, len,
+                               OSPF6_RECVMSG_BATCH);
+  for (i = 0; i < count; i++)
+    ospf6_receive_message (&src[i], &dst[i], ifindex[i],
+                           iovector[i].iov_base, len[i]);
+
   return 0;
 }
 
@@ -1863,24 +1877,23 @@ ospf6_dbdesc_send_newone (struct thread *thread)
   on = (struct ospf6_neighbor *) THREAD_ARG (thread);
   ospf6_lsdb_remove_all (on->dbdesc_list);
 
-  /* move LSAs from summary_list to dbdesc_list (within neighbor structure)
-     so that ospf6_send_dbdesc () can send those LSAs */
+  /* take the headers of the next LSAs of summary_list to dbdesc_list
+     (within neighbor structure) so that ospf6_send_dbdesc () can send
+     those, and send them again if need be */
   size = sizeof (struct ospf6_lsa_header) + sizeof (struct ospf6_dbdesc);
-  for (lsa = ospf6_lsdb_head (on->summary_list); lsa;
-       lsa = ospf6_lsdb_next (lsa))
+  while ((lsa = ospf6_summary_head (on)) != NULL)
     {
       if (size + sizeof (struct ospf6_lsa_header) > ospf6_packet_max(on->ospf6_if))
-        {
-          ospf6_lsa_unlock (lsa);
-          break;
-        }
+        break;
 
-      ospf6_lsdb_add (ospf6_lsa_copy (lsa), on->dbdesc_list);
-      ospf6_lsdb_remove (lsa, on->summary_list);
+      ospf6_lsa_age_current (lsa);
+      ospf6_lsdb_add (ospf6_lsa_create_headeronly (lsa->header),
+                      on->dbdesc_list);
+      ospf6_summary_advance (on, lsa);
       size += sizeof (struct ospf6_lsa_header);
     }
 
-  if (on->summary_list->count == 0)
+  if (lsa == NULL)
     UNSET_FLAG (on->dbdesc_bits, OSPF6_DBDESC_MBIT);
 
   /* If slave, More bit check must be done here */
@@ -1966,6 +1979,8 @@ ospf6_lsupdate_send_neighbor (struct thread *thread)
   u_char *p;
   int num;
   struct ospf6_lsa *lsa;
+  struct ospf6_retrans *rt;
+  unsigned int count;
 
   on = (struct ospf6_neighbor *) THREAD_ARG (thread);
   on->thread_send_lsupdate = (struct thread *) NULL;
@@ -1983,7 +1998,7 @@ ospf6_lsupdate_send_neighbor (struct thread *thread)
 
   /* if we have nothing to send, return */
   if (on->lsupdate_list->count == 0 &&
-      on->retrans_list->count == 0)
+      on->retrans_list.count == 0)
     {
       if (IS_OSPF6_DEBUG_MESSAGE (OSPF6_MESSAGE_TYPE_LSUPDATE, SEND))
         zlog_debug ("Quit to send (nothing to send)");
@@ -2020,21 +2035,29 @@ ospf6_lsupdate_send_neighbor (struct thread *thread)
       ospf6_lsdb_remove (lsa, on->lsupdate_list);
     }
 
-  for (lsa = ospf6_lsdb_head (on->retrans_list); lsa;
-       lsa = ospf6_lsdb_next (lsa))
+  /* retransmissions, from the head of the queue: those sent go to its
+     tail, so that the next packet starts with those left out of this
+     one.  The LSAs are the database copies, their age is set in the
+     packet only. */
+  for (count = on->retrans_list.count; count > 0; count--)
     {
+      rt = ilist_head_entry (&on->retrans_list, struct ospf6_retrans,
+                             on_node);
+      lsa = rt->lsa;
+
       /* MTU check */
       if ( (p - sendbuf + (unsigned int)OSPF6_LSA_SIZE (lsa->header))
           > ospf6_packet_max(on->ospf6_if))
-        {
-          ospf6_lsa_unlock (lsa);
-          break;
-        }
+        break;
 
-      ospf6_lsa_age_update_to_send (lsa, on->ospf6_if->transdelay);
       memcpy (p, lsa->header, OSPF6_LSA_SIZE (lsa->header));
+      ((struct ospf6_lsa_header *) p)->age =
+        htons (ospf6_lsa_age_to_send (lsa, on->ospf6_if->transdelay));
       p += OSPF6_LSA_SIZE (lsa->header);
       num++;
+
+      ilist_delete (&on->retrans_list, &rt->on_node);
+      ilist_add (&on->retrans_list, &rt->on_node);
     }
 
   lsupdate->lsa_number = htonl (num);
@@ -2046,7 +2069,7 @@ ospf6_lsupdate_send_neighbor (struct thread *thread)
               on->ospf6_if, oh);
 
   if (on->lsupdate_list->count != 0 ||
-      on->retrans_list->count != 0)
+      on->retrans_list.count != 0)
     {
       if (on->lsupdate_list->count != 0)
         on->thread_send_lsupdate =
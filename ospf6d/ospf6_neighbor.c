@@ -93,9 +93,8 @@ ospf6_neighbor_create (u_int32_t router_id, struct ospf6_interface *oi)
   quagga_gettime (QUAGGA_CLK_MONOTONIC, &on->last_changed);
   on->router_id = router_id;
 
-  on->summary_list = ospf6_lsdb_create (on);
+  ospf6_summary_clear (on);
   on->request_list = ospf6_lsdb_create (on);
-  on->retrans_list = ospf6_lsdb_create (on);
 
   on->dbdesc_list = ospf6_lsdb_create (on);
   on->lsreq_list = ospf6_lsdb_create (on);
@@ -109,25 +108,16 @@ ospf6_neighbor_create (u_int32_t router_id, struct ospf6_interface *oi)
 void
 ospf6_neighbor_delete (struct ospf6_neighbor *on)
 {
-  struct ospf6_lsa *lsa;
-
-  ospf6_lsdb_remove_all (on->summary_list);
+  ospf6_summary_clear (on);
   ospf6_lsdb_remove_all (on->request_list);
-  for (lsa = ospf6_lsdb_head (on->retrans_list); lsa;
-       lsa = ospf6_lsdb_next (lsa))
-    {
-      ospf6_decrement_retrans_count (lsa);
-      ospf6_lsdb_remove (lsa, on->retrans_list);
-    }
+  ospf6_retrans_clear (on);
 
   ospf6_lsdb_remove_all (on->dbdesc_list);
   ospf6_lsdb_remove_all (on->lsreq_list);
   ospf6_lsdb_remove_all (on->lsupdate_list);
   ospf6_lsdb_remove_all (on->lsack_list);
 
-  ospf6_lsdb_delete (on->summary_list);
   ospf6_lsdb_delete (on->request_list);
-  ospf6_lsdb_delete (on->retrans_list);
 
   ospf6_lsdb_delete (on->dbdesc_list);
   ospf6_lsdb_delete (on->lsreq_list);
@@ -144,6 +134,92 @@ ospf6_neighbor_delete (struct ospf6_neighbor *on)
   XFREE (MTYPE_OSPF6_NEIGHBOR, on);
 }
 
+/* The LSDB walked for a scope of the summary list of on. */
+static struct ospf6_lsdb *
+ospf6_summary_lsdb (struct ospf6_neighbor *on, int scope)
+{
+  switch (scope)
+    {
+    case OSPF6_SUMMARY_INTERFACE:
+      return on->ospf6_if->lsdb;
+    case OSPF6_SUMMARY_AREA:
+      return on->ospf6_if->area->lsdb;
+    case OSPF6_SUMMARY_AS:
+      return on->ospf6_if->area->ospf6->lsdb;
+    }
+  return NULL;
+}
+
+/* Start the summary list of on, as of now, at the first LSDB. */
+static void
+ospf6_summary_start (struct ospf6_neighbor *on)
+{
+  struct ospf6_summary *sum = &on->summary_list;
+  int scope;
+
+  memset (sum, 0, sizeof (struct ospf6_summary));
+  sum->scope = OSPF6_SUMMARY_INTERFACE;
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &sum->start);
+  for (scope = OSPF6_SUMMARY_INTERFACE; scope < OSPF6_SUMMARY_DONE; scope++)
+    sum->count += ospf6_summary_lsdb (on, scope)->count;
+}
+
+void
+ospf6_summary_clear (struct ospf6_neighbor *on)
+{
+  memset (&on->summary_list, 0, sizeof (struct ospf6_summary));
+  on->summary_list.scope = OSPF6_SUMMARY_DONE;
+}
+
+/* Move the summary list of on past lsa, the one its walk is at. */
+void
+ospf6_summary_advance (struct ospf6_neighbor *on, struct ospf6_lsa *lsa)
+{
+  struct ospf6_summary *sum = &on->summary_list;
+
+  sum->started = 1;
+  sum->type = lsa->header->type;
+  sum->id = lsa->header->id;
+  sum->adv_router = lsa->header->adv_router;
+  if (sum->count)
+    sum->count--;
+}
+
+/* The next LSA of the summary list of on, NULL at its end.  LSAs
+   installed since the exchange started were flooded to the neighbor and
+   are passed over, and MaxAge LSAs go to its retransmission list
+   instead, as the walk meets them. */
+struct ospf6_lsa *
+ospf6_summary_head (struct ospf6_neighbor *on)
+{
+  struct ospf6_summary *sum = &on->summary_list;
+  struct ospf6_lsdb *lsdb;
+  struct ospf6_lsa *lsa;
+
+  for (; sum->scope < OSPF6_SUMMARY_DONE; sum->scope++, sum->started = 0)
+    {
+      lsdb = ospf6_summary_lsdb (on, sum->scope);
+      if (sum->started)
+        lsa = ospf6_lsdb_lookup_next (sum->type, sum->id, sum->adv_router,
+                                      lsdb);
+      else
+        lsa = lsdb->skip[0];
+
+      for (; lsa; lsa = lsa->next)
+        {
+          if (! timercmp (&lsa->installed, &sum->start, >))
+            {
+              if (! OSPF6_LSA_IS_MAXAGE (lsa))
+                return lsa;
+              ospf6_retrans_add (on, lsa);
+            }
+          ospf6_summary_advance (on, lsa);
+        }
+    }
+
+  return NULL;
+}
+
 static void
 ospf6_neighbor_state_change (u_char next_state, struct ospf6_neighbor *on)
 {
@@ -269,7 +345,6 @@ int
 negotiation_done (struct thread *thread)
 {
   struct ospf6_neighbor *on;
-  struct ospf6_lsa *lsa;
 
   on = (struct ospf6_neighbor *) THREAD_ARG (thread);
   assert (on);
@@ -281,53 +356,12 @@ negotiation_done (struct thread *thread)
     zlog_debug ("Neighbor Event %s: *NegotiationDone*", on->name);
 
   /* clear ls-list */
-  ospf6_lsdb_remove_all (on->summary_list);
+  ospf6_summary_clear (on);
   ospf6_lsdb_remove_all (on->request_list);
-  for (lsa = ospf6_lsdb_head (on->retrans_list); lsa;
-       lsa = ospf6_lsdb_next (lsa))
-    {
-      ospf6_decrement_retrans_count (lsa);
-      ospf6_lsdb_remove (lsa, on->retrans_list);
-    }
+  ospf6_retrans_clear (on);
 
-  /* Interface scoped LSAs */
-  for (lsa = ospf6_lsdb_head (on->ospf6_if->lsdb); lsa;
-       lsa = ospf6_lsdb_next (lsa))
-    {
-      if (OSPF6_LSA_IS_MAXAGE (lsa))
-        {
-          ospf6_increment_retrans_count (lsa);
-          ospf6_lsdb_add (ospf6_lsa_copy (lsa), on->retrans_list);
-        }
-      else
-        ospf6_lsdb_add (ospf6_lsa_copy (lsa), on->summary_list);
-    }
-
-  /* Area scoped LSAs */
-  for (lsa = ospf6_lsdb_head (on->ospf6_if->area->lsdb); lsa;
-       lsa = ospf6_lsdb_next (lsa))
-    {
-      if (OSPF6_LSA_IS_MAXAGE (lsa))
-        {
-          ospf6_increment_retrans_count (lsa);
-          ospf6_lsdb_add (ospf6_lsa_copy (lsa), on->retrans_list);
-        }
-      else
-        ospf6_lsdb_add (ospf6_lsa_copy (lsa), on->summary_list);
-    }
-
-  /* AS scoped LSAs */
-  for (lsa = ospf6_lsdb_head (on->ospf6_if->area->ospf6->lsdb); lsa;
-       lsa = ospf6_lsdb_next (lsa))
-    {
-      if (OSPF6_LSA_IS_MAXAGE (lsa))
-        {
-          ospf6_increment_retrans_count (lsa);
-          ospf6_lsdb_add (ospf6_lsa_copy (lsa), on->retrans_list);
-        }
-      else
-        ospf6_lsdb_add (ospf6_lsa_copy (lsa), on->summary_list);
-    }
+  /* Interface, area and AS scoped LSAs, walked as DbDescs are sent */
+  ospf6_summary_start (on);
 
   UNSET_FLAG (on->dbdesc_bits, OSPF6_DBDESC_IBIT);
   ospf6_neighbor_state_change (OSPF6_NEIGHBOR_EXCHANGE, on);
@@ -390,7 +424,6 @@ int
 adj_ok (struct thread *thread)
 {
   struct ospf6_neighbor *on;
-  struct ospf6_lsa *lsa;
 
   on = (struct ospf6_neighbor *) THREAD_ARG (thread);
   assert (on);
@@ -414,14 +447,9 @@ adj_ok (struct thread *thread)
            ! need_adjacency (on))
     {
       ospf6_neighbor_state_change (OSPF6_NEIGHBOR_TWOWAY, on);
-      ospf6_lsdb_remove_all (on->summary_list);
+      ospf6_summary_clear (on);
       ospf6_lsdb_remove_all (on->request_list);
-      for (lsa = ospf6_lsdb_head (on->retrans_list); lsa;
-           lsa = ospf6_lsdb_next (lsa))
-        {
-          ospf6_decrement_retrans_count (lsa);
-          ospf6_lsdb_remove (lsa, on->retrans_list);
-        }
+      ospf6_retrans_clear (on);
     }
 
   return 0;
@@ -431,7 +459,6 @@ int
 seqnumber_mismatch (struct thread *thread)
 {
   struct ospf6_neighbor *on;
-  struct ospf6_lsa *lsa;
 
   on = (struct ospf6_neighbor *) THREAD_ARG (thread);
   assert (on);
@@ -447,14 +474,9 @@ seqnumber_mismatch (struct thread *thread)
   SET_FLAG (on->dbdesc_bits, OSPF6_DBDESC_MBIT);
   SET_FLAG (on->dbdesc_bits, OSPF6_DBDESC_IBIT);
 
-  ospf6_lsdb_remove_all (on->summary_list);
+  ospf6_summary_clear (on);
   ospf6_lsdb_remove_all (on->request_list);
-  for (lsa = ospf6_lsdb_head (on->retrans_list); lsa;
-       lsa = ospf6_lsdb_next (lsa))
-    {
-      ospf6_decrement_retrans_count (lsa);
-      ospf6_lsdb_remove (lsa, on->retrans_list);
-    }
+  ospf6_retrans_clear (on);
 
   THREAD_OFF (on->thread_send_dbdesc);
   on->thread_send_dbdesc =
@@ -467,7 +489,6 @@ int
 bad_lsreq (struct thread *thread)
 {
   struct ospf6_neighbor *on;
-  struct ospf6_lsa *lsa;
 
   on = (struct ospf6_neighbor *) THREAD_ARG (thread);
   assert (on);
@@ -483,14 +504,9 @@ bad_lsreq (struct thread *thread)
   SET_FLAG (on->dbdesc_bits, OSPF6_DBDESC_MBIT);
   SET_FLAG (on->dbdesc_bits, OSPF6_DBDESC_IBIT);
 
-  ospf6_lsdb_remove_all (on->summary_list);
+  ospf6_summary_clear (on);
   ospf6_lsdb_remove_all (on->request_list);
-  for (lsa = ospf6_lsdb_head (on->retrans_list); lsa;
-       lsa = ospf6_lsdb_next (lsa))
-    {
-      ospf6_decrement_retrans_count (lsa);
-      ospf6_lsdb_remove (lsa, on->retrans_list);
-    }
+  ospf6_retrans_clear (on);
 
   THREAD_OFF (on->thread_send_dbdesc);
   on->thread_send_dbdesc =
@@ -503,7 +519,6 @@ int
 oneway_received (struct thread *thread)
 {
   struct ospf6_neighbor *on;
-  struct ospf6_lsa *lsa;
 
   on = (struct ospf6_neighbor *) THREAD_ARG (thread);
   assert (on);
@@ -517,14 +532,9 @@ oneway_received (struct thread *thread)
   ospf6_neighbor_state_change (OSPF6_NEIGHBOR_INIT, on);
   thread_add_event (master, neighbor_change, on->ospf6_if, 0);
 
-  ospf6_lsdb_remove_all (on->summary_list);
+  ospf6_summary_clear (on);
   ospf6_lsdb_remove_all (on->request_list);
-  for (lsa = ospf6_lsdb_head (on->retrans_list); lsa;
-       lsa = ospf6_lsdb_next (lsa))
-    {
-      ospf6_decrement_retrans_count (lsa);
-      ospf6_lsdb_remove (lsa, on->retrans_list);
-    }
+  ospf6_retrans_clear (on);
 
   THREAD_OFF (on->thread_send_dbdesc);
   THREAD_OFF (on->thread_send_lsreq);
@@ -659,6 +669,8 @@ ospf6_neighbor_show_detail (struct vty *vty, struct ospf6_neighbor *on)
   char linklocal_addr[64], duration[32];
   struct timeval now, res;
   struct ospf6_lsa *lsa;
+  struct ilistnode *node;
+  struct ospf6_retrans *rt;
 
   inet_ntop (AF_INET6, &on->linklocal_addr, linklocal_addr,
              sizeof (linklocal_addr));
@@ -692,11 +704,9 @@ ospf6_neighbor_show_detail (struct vty *vty, struct ospf6_neighbor *on)
             "Master" : "Slave"), (u_long) ntohl (on->dbdesc_seqnum),
            VNL);
 
-  vty_out (vty, "    Summary-List: %d LSAs%s", on->summary_list->count,
+  /* The summary list is the LSDBs still to walk, only counted. */
+  vty_out (vty, "    Summary-List: %d LSAs%s", on->summary_list.count,
            VNL);
-  for (lsa = ospf6_lsdb_head (on->summary_list); lsa;
-       lsa = ospf6_lsdb_next (lsa))
-    vty_out (vty, "      %s%s", lsa->name, VNL);
 
   vty_out (vty, "    Request-List: %d LSAs%s", on->request_list->count,
            VNL);
@@ -704,11 +714,11 @@ ospf6_neighbor_show_detail (struct vty *vty, struct ospf6_neighbor *on)
        lsa = ospf6_lsdb_next (lsa))
     vty_out (vty, "      %s%s", lsa->name, VNL);
 
-  vty_out (vty, "    Retrans-List: %d LSAs%s", on->retrans_list->count,
+  vty_out (vty, "    Retrans-List: %d LSAs%s", on->retrans_list.count,
            VNL);
-  for (lsa = ospf6_lsdb_head (on->retrans_list); lsa;
-       lsa = ospf6_lsdb_next (lsa))
-    vty_out (vty, "      %s%s", lsa->name, VNL);
+  for (ALL_ILIST_ELEMENTS_RO (&on->retrans_list, node, rt,
+                              struct ospf6_retrans, on_node))
+    vty_out (vty, "      %s%s", rt->lsa->name, VNL);
 
   timerclear (&res);
   if (on->thread_send_dbdesc)
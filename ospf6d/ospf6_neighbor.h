@@ -34,6 +34,31 @@ extern unsigned char conf_debug_ospf6_neighbor;
   (conf_debug_ospf6_neighbor & OSPF6_DEBUG_NEIGHBOR_ ## level)
 
 /* Neighbor structure */
+/* Database summary list of a neighbor, walked from the interface, area
+   and AS scoped LSDBs as the DbDesc packets are made rather than copied
+   from them. */
+struct ospf6_summary
+{
+  /* LSDB walked, OSPF6_SUMMARY_DONE after the last, and the key of the
+     LSA last passed in it, if started. */
+  int scope;
+  int started;
+  u_int16_t type;
+  u_int32_t id;
+  u_int32_t adv_router;
+
+  /* LSAs installed after this were flooded to the neighbor instead. */
+  struct timeval start;
+
+  /* LSAs left to walk, for display. */
+  u_int32_t count;
+};
+
+#define OSPF6_SUMMARY_INTERFACE 0
+#define OSPF6_SUMMARY_AREA      1
+#define OSPF6_SUMMARY_AS        2
+#define OSPF6_SUMMARY_DONE      3
+
 struct ospf6_neighbor
 {
   /* Neighbor Router ID String */
@@ -76,9 +101,9 @@ struct ospf6_neighbor
   struct ospf6_dbdesc  dbdesc_last;
 
   /* LS-list */
-  struct ospf6_lsdb *summary_list;
+  struct ospf6_summary summary_list;
   struct ospf6_lsdb *request_list;
-  struct ospf6_lsdb *retrans_list;
+  struct ilist retrans_list;            /* struct ospf6_retrans */
 
   /* LSA list for message transmission */
   struct ospf6_lsdb *dbdesc_list;
@@ -113,6 +138,11 @@ extern const char *ospf6_neighbor_state_str[];
 int ospf6_neighbor_cmp (void *va, void *vb);
 void ospf6_neighbor_dbex_init (struct ospf6_neighbor *on);
 
+extern struct ospf6_lsa *ospf6_summary_head (struct ospf6_neighbor *on);
+extern void ospf6_summary_advance (struct ospf6_neighbor *on,
+                                   struct ospf6_lsa *lsa);
+extern void ospf6_summary_clear (struct ospf6_neighbor *on);
+
 struct ospf6_neighbor *ospf6_neighbor_lookup (u_int32_t,
                                               struct ospf6_interface *);
 struct ospf6_neighbor *ospf6_neighbor_create (u_int32_t,
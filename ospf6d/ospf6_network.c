@@ -26,6 +26,7 @@
 #include "sockunion.h"
 #include "sockopt.h"
 #include "privs.h"
+#include "network.h"
 
 #include "ospf6_proto.h"
 #include "ospf6_network.h"
@@ -265,3 +266,60 @@ ospf6_recvmsg (struct in6_addr *src, struct in6_addr *dst,
 }
 
 
+
+/* Receive up to vlen messages, each into its single message[i] buffer.
+   Their lengths go to len[i].  Returns the number received. */
+int
+ospf6_recvmsg_batch (struct in6_addr *src, struct in6_addr *dst,
+                     unsigned int *ifindex, struct iovec *message,
+                     int *len, unsigned int vlen)
+{
+  int retval, i;
+  struct mmsghdr rmmsg[OSPF6_RECVMSG_BATCH];
+  struct cmsghdr *rcmsgp;
+  u_char cmsgbuf[OSPF6_RECVMSG_BATCH][CMSG_SPACE(sizeof (struct in6_pktinfo))];
+  struct in6_pktinfo *pktinfo;
+  struct sockaddr_in6 src_sin6[OSPF6_RECVMSG_BATCH];
+
+  assert (vlen <= OSPF6_RECVMSG_BATCH);
+
+  memset (rmmsg, 0, sizeof (rmmsg));
+  memset (src_sin6, 0, sizeof (src_sin6));
+  for (i = 0; i < (int) vlen; i++)
+    {
+      /* receive control msg */
+      rcmsgp = (struct cmsghdr *)cmsgbuf[i];
+      rcmsgp->cmsg_level = IPPROTO_IPV6;
+      rcmsgp->cmsg_type = IPV6_PKTINFO;
+      rcmsgp->cmsg_len = CMSG_LEN (sizeof (struct in6_pktinfo));
+
+      /* receive msg hdr */
+      rmmsg[i].msg_hdr.msg_iov = &message[i];
+      rmmsg[i].msg_hdr.msg_iovlen = 1;
+      rmmsg[i].msg_hdr.msg_name = (caddr_t) &src_sin6[i];
+      rmmsg[i].msg_hdr.msg_namelen = sizeof (struct sockaddr_in6);
+      rmmsg[i].msg_hdr.msg_control = (caddr_t) cmsgbuf[i];
+      rmmsg[i].msg_hdr.msg_controllen = sizeof (cmsgbuf[i]);
+    }
+
+  retval = recvmsg_batch (ospf6_sock, rmmsg, vlen);
+  if (retval < 0)
+    {
+      zlog_warn ("recvmsg failed: %s", safe_strerror (errno));
+      return retval;
+    }
+
+  for (i = 0; i < retval; i++)
+    {
+      len[i] = rmmsg[i].msg_len;
+      if (rmmsg[i].msg_len == message[i].iov_len)
+        zlog_warn ("recvmsg read full buffer size: %d", len[i]);
+
+      pktinfo = (struct in6_pktinfo *)(CMSG_DATA((struct cmsghdr *)cmsgbuf[i]));
+      memcpy (&src[i], &src_sin6[i].sin6_addr, sizeof (struct in6_addr));
+      ifindex[i] = pktinfo->ipi6_ifindex;
+      memcpy (&dst[i], &pktinfo->ipi6_addr, sizeof (struct in6_addr));
+    }
+
+  return retval;
+}
@@ -24,6 +24,9 @@
 
 
 
+/* Messages taken per system call on the OSPFv3 socket. */
+#define OSPF6_RECVMSG_BATCH 16
+
 extern int ospf6_sock;
 extern struct in6_addr allspfrouters6;
 extern struct in6_addr alldrouters6;
@@ -41,6 +44,9 @@ extern int ospf6_sendmsg (struct in6_addr *, struct in6_addr *,
                           unsigned int *, struct iovec *);
 extern int ospf6_recvmsg (struct in6_addr *, struct in6_addr *,
                           unsigned int *, struct iovec *);
+extern int ospf6_recvmsg_batch (struct in6_addr *, struct in6_addr *,
+                                unsigned int *, struct iovec *, int *,
+                                unsigned int);
 
 #endif /* OSPF6_NETWORK_H */
 
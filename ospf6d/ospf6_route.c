@@ -28,6 +28,8 @@
 #include "vty.h"
 #include "command.h"
 #include "linklist.h"
+#include "hash.h"
+#include "jhash.h"
 
 #include "ospf6_proto.h"
 #include "ospf6_lsa.h"
@@ -173,6 +175,136 @@ const char *ospf6_path_type_substr[OSPF6_PATH_TYPE_MAX] =
 { "??", "IA", "IE", "E1", "E2", };
 
 
+/* Interned nexthop sets */
+static struct hash *ospf6_nexthop_sets;
+
+static unsigned int
+ospf6_nexthop_set_key (void *data)
+{
+  struct ospf6_nexthop_set *set = data;
+  return jhash (set->nexthop, set->count * sizeof (struct ospf6_nexthop),
+                set->count);
+}
+
+static int
+ospf6_nexthop_set_cmp (const void *a, const void *b)
+{
+  const struct ospf6_nexthop_set *sa = a, *sb = b;
+  return (sa->count == sb->count &&
+          memcmp (sa->nexthop, sb->nexthop,
+                  sa->count * sizeof (struct ospf6_nexthop)) == 0);
+}
+
+static void *
+ospf6_nexthop_set_alloc (void *data)
+{
+  struct ospf6_nexthop_set *key = data, *set;
+  size_t size;
+
+  size = sizeof (struct ospf6_nexthop_set)
+         + key->count * sizeof (struct ospf6_nexthop);
+  set = XMALLOC (MTYPE_OSPF6_NEXTHOP, size);
+  memcpy (set, key, size);
+  set->refcnt = 0;
+  return set;
+}
+
+/* Returns the locked set of the nexthops that are set among the first
+   count, or NULL if there are none. */
+static struct ospf6_nexthop_set *
+ospf6_nexthop_set_intern (struct ospf6_nexthop *nexthop, int count)
+{
+  union
+  {
+    struct ospf6_nexthop_set set;
+    char buf[sizeof (struct ospf6_nexthop_set)
+             + OSPF6_MULTI_PATH_LIMIT * sizeof (struct ospf6_nexthop)];
+  } key;
+  struct ospf6_nexthop_set *set;
+  int i;
+
+  key.set.refcnt = 0;
+  key.set.count = 0;
+  for (i = 0; i < count && key.set.count < OSPF6_MULTI_PATH_LIMIT; i++)
+    if (ospf6_nexthop_is_set (&nexthop[i]))
+      {
+        ospf6_nexthop_copy (&key.set.nexthop[key.set.count], &nexthop[i]);
+        key.set.count++;
+      }
+  if (key.set.count == 0)
+    return NULL;
+
+  if (ospf6_nexthop_sets == NULL)
+    ospf6_nexthop_sets = hash_create_open (256, ospf6_nexthop_set_key,
+                                           ospf6_nexthop_set_cmp);
+  set = hash_get (ospf6_nexthop_sets, &key.set, ospf6_nexthop_set_alloc);
+  set->refcnt++;
+  return set;
+}
+
+static void
+ospf6_nexthop_set_unintern (struct ospf6_nexthop_set *set)
+{
+  if (set == NULL)
+    return;
+
+  assert (set->refcnt > 0);
+  if (--set->refcnt > 0)
+    return;
+
+  hash_release (ospf6_nexthop_sets, set);
+  XFREE (MTYPE_OSPF6_NEXTHOP, set);
+}
+
+unsigned long
+ospf6_nexthop_set_count (void)
+{
+  return (ospf6_nexthop_sets ? ospf6_nexthop_sets->count : 0);
+}
+
+void
+ospf6_route_set_nexthops (struct ospf6_route *route,
+                          struct ospf6_nexthop *nexthop, int count)
+{
+  struct ospf6_nexthop_set *set;
+
+  set = ospf6_nexthop_set_intern (nexthop, count);
+  ospf6_nexthop_set_unintern (route->nh);
+  route->nh = set;
+}
+
+void
+ospf6_route_copy_nexthops (struct ospf6_route *dst, struct ospf6_route *src)
+{
+  if (src->nh)
+    src->nh->refcnt++;
+  ospf6_nexthop_set_unintern (dst->nh);
+  dst->nh = src->nh;
+}
+
+/* Adds the nexthop unless the route has it already, or is at the
+   multipath limit. */
+void
+ospf6_route_add_nexthop (struct ospf6_route *route,
+                         struct ospf6_nexthop *nexthop)
+{
+  struct ospf6_nexthop nexthops[OSPF6_MULTI_PATH_LIMIT];
+  int i, count;
+
+  count = ospf6_route_num_nexthops (route);
+  if (count >= OSPF6_MULTI_PATH_LIMIT || ! ospf6_nexthop_is_set (nexthop))
+    return;
+
+  for (i = 0; i < count; i++)
+    {
+      if (ospf6_nexthop_is_same (ospf6_route_nexthop (route, i), nexthop))
+        return;
+      ospf6_nexthop_copy (&nexthops[i], ospf6_route_nexthop (route, i));
+    }
+  ospf6_nexthop_copy (&nexthops[count], nexthop);
+  ospf6_route_set_nexthops (route, nexthops, count + 1);
+}
+
 struct ospf6_route *
 ospf6_route_create (void)
 {
@@ -184,6 +316,7 @@ ospf6_route_create (void)
 void
 ospf6_route_delete (struct ospf6_route *route)
 {
+  ospf6_nexthop_set_unintern (route->nh);
   XFREE (MTYPE_OSPF6_ROUTE, route);
 }
 
@@ -199,6 +332,8 @@ ospf6_route_copy (struct ospf6_route *route)
   new->next = NULL;
   new->table = NULL;
   new->lock = 0;
+  if (new->nh)
+    new->nh->refcnt++;
   return new;
 }
 
@@ -452,8 +587,7 @@ ospf6_route_add (struct ospf6_route *route,
       SET_FLAG (route->flag, OSPF6_ROUTE_CHANGE);
       ospf6_route_table_assert (table);
 
-      if (table->hook_add)
-        (*table->hook_add) (route);
+      ospf6_route_notify_add (route, table);
 
       return route;
     }
@@ -501,8 +635,7 @@ ospf6_route_add (struct ospf6_route *route,
       ospf6_route_table_assert (table);
 
       SET_FLAG (route->flag, OSPF6_ROUTE_ADD);
-      if (table->hook_add)
-        (*table->hook_add) (route);
+      ospf6_route_notify_add (route, table);
 
       return route;
     }
@@ -568,8 +701,7 @@ ospf6_route_add (struct ospf6_route *route,
   ospf6_route_table_assert (table);
 
   SET_FLAG (route->flag, OSPF6_ROUTE_ADD);
-  if (table->hook_add)
-    (*table->hook_add) (route);
+  ospf6_route_notify_add (route, table);
 
   return route;
 }
@@ -635,6 +767,89 @@ ospf6_route_remove (struct ospf6_route *route,
   ospf6_route_unlock (route);
 }
 
+/* Tell the hooks of table about a new or changed route, or hold it back
+   until the end of the batch. */
+void
+ospf6_route_notify_add (struct ospf6_route *route,
+                        struct ospf6_route_table *table)
+{
+  if (table->hook_add == NULL)
+    return;
+
+  if (table->batch == 0)
+    {
+      (*table->hook_add) (route);
+      return;
+    }
+
+  ospf6_route_lock (route);
+  listnode_add (table->pending, route);
+}
+
+void
+ospf6_route_table_batch_begin (struct ospf6_route_table *table)
+{
+  if (table->batch++ == 0 && table->pending == NULL)
+    table->pending = list_new ();
+}
+
+static int
+ospf6_route_in_table (struct ospf6_route *route)
+{
+  struct ospf6_route *current;
+
+  if (CHECK_FLAG (route->flag, OSPF6_ROUTE_WAS_REMOVED) ||
+      route->rnode == NULL)
+    return 0;
+
+  /* a route replaced by another of the same origin is no longer linked */
+  for (current = route->rnode->info;
+       current && ospf6_route_is_same (current, route);
+       current = current->next)
+    if (current == route)
+      return 1;
+  return 0;
+}
+
+void
+ospf6_route_table_batch_end (struct ospf6_route_table *table)
+{
+  struct list *routes;
+  struct listnode *node;
+  struct ospf6_route *route;
+
+  assert (table->batch > 0);
+  if (--table->batch > 0 || listcount (table->pending) == 0)
+    return;
+
+  /* Drop the routes gone since, keeping the others in order. */
+  routes = list_new ();
+  for (ALL_LIST_ELEMENTS_RO (table->pending, node, route))
+    {
+      if (ospf6_route_in_table (route))
+        {
+          ospf6_route_lock (route);
+          listnode_add (routes, route);
+        }
+      ospf6_route_unlock (route);
+    }
+  list_delete_all_node (table->pending);
+
+  if (IS_OSPF6_DEBUG_ROUTE (TABLE))
+    zlog_debug ("%s: batch end: %u routes added or changed",
+                ospf6_route_table_name (table), listcount (routes));
+
+  if (table->hook_commit)
+    (*table->hook_commit) (table, routes);
+  else if (table->hook_add)
+    for (ALL_LIST_ELEMENTS_RO (routes, node, route))
+      (*table->hook_add) (route);
+
+  for (ALL_LIST_ELEMENTS_RO (routes, node, route))
+    ospf6_route_unlock (route);
+  list_delete (routes);
+}
+
 struct ospf6_route *
 ospf6_route_head (struct ospf6_route_table *table)
 {
@@ -765,7 +980,7 @@ struct ospf6_route_table *
 ospf6_route_table_create (int s, int t)
 {
   struct ospf6_route_table *new;
-  new = XCALLOC (MTYPE_OSPF6_ROUTE, sizeof (struct ospf6_route_table));
+  new = XCALLOC (MTYPE_OSPF6_ROUTE_TABLE, sizeof (struct ospf6_route_table));
   new->table = route_table_init ();
   new->scope_type = s;
   new->table_type = t;
@@ -776,8 +991,10 @@ void
 ospf6_route_table_delete (struct ospf6_route_table *table)
 {
   ospf6_route_remove_all (table);
+  if (table->pending)
+    list_delete (table->pending);
   route_table_finish (table->table);
-  XFREE (MTYPE_OSPF6_ROUTE, table);
+  XFREE (MTYPE_OSPF6_ROUTE_TABLE, table);
 }
 
 
@@ -788,6 +1005,7 @@ ospf6_route_show (struct vty *vty, struct ospf6_route *route)
   int i;
   char destination[64], nexthop[64];
   char duration[16], ifname[IFNAMSIZ];
+  struct ospf6_nexthop none, *nh;
   struct timeval now, res;
 
   quagga_gettime (QUAGGA_CLK_MONOTONIC, &now);
@@ -805,10 +1023,12 @@ ospf6_route_show (struct vty *vty, struct ospf6_route *route)
     prefix2str (&route->prefix, destination, sizeof (destination));
 
   /* nexthop */
-  inet_ntop (AF_INET6, &route->nexthop[0].address, nexthop,
-             sizeof (nexthop));
-  if (! if_indextoname (route->nexthop[0].ifindex, ifname))
-    snprintf (ifname, sizeof (ifname), "%d", route->nexthop[0].ifindex);
+  ospf6_nexthop_clear (&none);
+  nh = (ospf6_route_num_nexthops (route) ?
+        ospf6_route_nexthop (route, 0) : &none);
+  inet_ntop (AF_INET6, &nh->address, nexthop, sizeof (nexthop));
+  if (! if_indextoname (nh->ifindex, ifname))
+    snprintf (ifname, sizeof (ifname), "%d", nh->ifindex);
 
   vty_out (vty, "%c%1s %2s %-30s %-25s %6.*s %s%s",
            (ospf6_route_is_best (route) ? '*' : ' '),
@@ -816,14 +1036,13 @@ ospf6_route_show (struct vty *vty, struct ospf6_route *route)
            OSPF6_PATH_TYPE_SUBSTR (route->path.type),
            destination, nexthop, IFNAMSIZ, ifname, duration, VNL);
 
-  for (i = 1; ospf6_nexthop_is_set (&route->nexthop[i]) &&
-       i < OSPF6_MULTI_PATH_LIMIT; i++)
+  for (i = 1; i < ospf6_route_num_nexthops (route); i++)
     {
       /* nexthop */
-      inet_ntop (AF_INET6, &route->nexthop[i].address, nexthop,
-                 sizeof (nexthop));
-      if (! if_indextoname (route->nexthop[i].ifindex, ifname))
-        snprintf (ifname, sizeof (ifname), "%d", route->nexthop[i].ifindex);
+      nh = ospf6_route_nexthop (route, i);
+      inet_ntop (AF_INET6, &nh->address, nexthop, sizeof (nexthop));
+      if (! if_indextoname (nh->ifindex, ifname))
+        snprintf (ifname, sizeof (ifname), "%d", nh->ifindex);
 
       vty_out (vty, "%c%1s %2s %-30s %-25s %6.*s %s%s",
                ' ', "", "", "", nexthop, IFNAMSIZ, ifname, "", VNL);
@@ -837,6 +1056,7 @@ ospf6_route_show_detail (struct vty *vty, struct ospf6_route *route)
   char area_id[16], id[16], adv_router[16], capa[16], options[16];
   struct timeval now, res;
   char duration[16];
+  struct ospf6_nexthop *nh;
   int i;
 
   quagga_gettime (QUAGGA_CLK_MONOTONIC, &now);
@@ -913,14 +1133,13 @@ ospf6_route_show_detail (struct vty *vty, struct ospf6_route *route)
 
   /* Nexthops */
   vty_out (vty, "Nexthop:%s", VNL);
-  for (i = 0; ospf6_nexthop_is_set (&route->nexthop[i]) &&
-       i < OSPF6_MULTI_PATH_LIMIT; i++)
+  for (i = 0; i < ospf6_route_num_nexthops (route); i++)
     {
       /* nexthop */
-      inet_ntop (AF_INET6, &route->nexthop[i].address, nexthop,
-                 sizeof (nexthop));
-      if (! if_indextoname (route->nexthop[i].ifindex, ifname))
-        snprintf (ifname, sizeof (ifname), "%d", route->nexthop[i].ifindex);
+      nh = ospf6_route_nexthop (route, i);
+      inet_ntop (AF_INET6, &nh->address, nexthop, sizeof (nexthop));
+      if (! if_indextoname (nh->ifindex, ifname))
+        snprintf (ifname, sizeof (ifname), "%d", nh->ifindex);
       vty_out (vty, "  %s %.*s%s", nexthop, IFNAMSIZ, ifname, VNL);
     }
   vty_out (vty, "%s", VNL);
@@ -946,9 +1165,9 @@ ospf6_route_show_table_summary (struct vty *vty,
         destination++;
       else
         alternative++;
-      if (! ospf6_nexthop_is_set (&route->nexthop[0]))
+      if (ospf6_route_num_nexthops (route) == 0)
         nhinval++;
-      else if (ospf6_nexthop_is_set (&route->nexthop[1]))
+      else if (ospf6_route_num_nexthops (route) > 1)
         ecmp++;
       pathtype[route->path.type]++;
       number++;
@@ -962,6 +1181,8 @@ ospf6_route_show_table_summary (struct vty *vty,
   vty_out (vty, "Number of Destination: %d%s", destination, VNL);
   vty_out (vty, "Number of Alternative routes: %d%s", alternative, VNL);
   vty_out (vty, "Number of Equal Cost Multi Path: %d%s", ecmp, VNL);
+  vty_out (vty, "Number of shared Nexthop sets: %lu%s",
+           ospf6_nexthop_set_count (), VNL);
   for (i = OSPF6_PATH_TYPE_INTRA; i <= OSPF6_PATH_TYPE_EXTERNAL2; i++)
     {
       vty_out (vty, "Number of %s routes: %d%s",
@@ -64,6 +64,20 @@ struct ospf6_nexthop
             sizeof (struct in6_addr));                        \
   } while (0)
 
+/* The nexthops of a route.  Sets are interned, so that all copies of
+   a route, and routes with the same nexthops, share one; a set is
+   never modified once interned.  Routes without nexthops have none. */
+struct ospf6_nexthop_set
+{
+  unsigned int refcnt;
+  u_char count;
+  struct ospf6_nexthop nexthop[];
+};
+
+#define ospf6_route_num_nexthops(r) ((r)->nh ? (r)->nh->count : 0)
+#define ospf6_route_nexthop(r, i) (&(r)->nh->nexthop[(i)])
+#define ospf6_route_ifindex(r) ((r)->nh ? (r)->nh->nexthop[0].ifindex : 0)
+
 /* Path */
 struct ospf6_ls_origin
 {
@@ -136,7 +150,7 @@ struct ospf6_route
   struct ospf6_path path;
 
   /* nexthop */
-  struct ospf6_nexthop nexthop[OSPF6_MULTI_PATH_LIMIT];
+  struct ospf6_nexthop_set *nh;
 
   /* route option */
   void *route_option;
@@ -176,6 +190,14 @@ struct ospf6_route_table
   void (*hook_add) (struct ospf6_route *);
   void (*hook_change) (struct ospf6_route *);
   void (*hook_remove) (struct ospf6_route *);
+
+  /* Within a batch, additions and changes are held back on the pending
+     list and notified once at its end, through hook_commit if set, else
+     hook_add for each.  Nothing is held back without hook_add.  Removals
+     are still notified right away. */
+  void (*hook_commit) (struct ospf6_route_table *, struct list *);
+  int batch;
+  struct list *pending;
 };
 
 #define OSPF6_SCOPE_TYPE_NONE      0
@@ -231,8 +253,7 @@ extern const char *ospf6_path_type_substr[OSPF6_PATH_TYPE_MAX];
   ((ra)->type == (rb)->type && \
    memcmp (&(ra)->prefix, &(rb)->prefix, sizeof (struct prefix)) == 0 && \
    memcmp (&(ra)->path, &(rb)->path, sizeof (struct ospf6_path)) == 0 && \
-   memcmp (&(ra)->nexthop, &(rb)->nexthop,                               \
-           sizeof (struct ospf6_nexthop) * OSPF6_MULTI_PATH_LIMIT) == 0)
+   (ra)->nh == (rb)->nh)
 #define ospf6_route_is_best(r) (CHECK_FLAG ((r)->flag, OSPF6_ROUTE_BEST))
 
 #define ospf6_linkstate_prefix_adv_router(x) \
@@ -255,6 +276,15 @@ extern struct ospf6_route *ospf6_route_create (void);
 extern void ospf6_route_delete (struct ospf6_route *);
 extern struct ospf6_route *ospf6_route_copy (struct ospf6_route *route);
 
+extern void ospf6_route_set_nexthops (struct ospf6_route *route,
+                                      struct ospf6_nexthop *nexthop,
+                                      int count);
+extern void ospf6_route_copy_nexthops (struct ospf6_route *dst,
+                                       struct ospf6_route *src);
+extern void ospf6_route_add_nexthop (struct ospf6_route *route,
+                                     struct ospf6_nexthop *nexthop);
+extern unsigned long ospf6_nexthop_set_count (void);
+
 extern void ospf6_route_lock (struct ospf6_route *route);
 extern void ospf6_route_unlock (struct ospf6_route *route);
 
@@ -279,6 +309,11 @@ extern struct ospf6_route *ospf6_route_match_head (struct prefix *prefix,
 extern struct ospf6_route *ospf6_route_match_next (struct prefix *prefix,
                                             struct ospf6_route *route);
 
+extern void ospf6_route_notify_add (struct ospf6_route *route,
+                                    struct ospf6_route_table *table);
+extern void ospf6_route_table_batch_begin (struct ospf6_route_table *);
+extern void ospf6_route_table_batch_end (struct ospf6_route_table *);
+
 extern void ospf6_route_remove_all (struct ospf6_route_table *);
 extern struct ospf6_route_table *ospf6_route_table_create (int s, int t);
 extern void ospf6_route_table_delete (struct ospf6_route_table *);
@@ -1097,7 +1097,7 @@ ospfv3NbrEntry (struct variable *v, oid *name, size_t *length,
     case OSPFv3NBREVENTS:
       return SNMP_INTEGER (on->state_change);
     case OSPFv3NBRLSRETRANSQLEN:
-      return SNMP_INTEGER (on->retrans_list->count);
+      return SNMP_INTEGER (on->retrans_list.count);
     case OSPFv3NBRHELLOSUPPRESSED:
       return SNMP_INTEGER (SNMP_FALSE);
     case OSPFv3NBRIFID:
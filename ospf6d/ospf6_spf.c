@@ -281,7 +281,7 @@ ospf6_spf_install (struct ospf6_vertex *v,
                    struct ospf6_route_table *result_table)
 {
   struct ospf6_route *route;
-  int i, j;
+  int i;
   struct ospf6_vertex *prev;
 
   if (IS_OSPF6_DEBUG_SPF (PROCESS))
@@ -304,21 +304,7 @@ ospf6_spf_install (struct ospf6_vertex *v,
 
       for (i = 0; ospf6_nexthop_is_set (&v->nexthop[i]) &&
            i < OSPF6_MULTI_PATH_LIMIT; i++)
-        {
-          for (j = 0; j < OSPF6_MULTI_PATH_LIMIT; j++)
-            {
-              if (ospf6_nexthop_is_set (&route->nexthop[j]))
-                {
-                  if (ospf6_nexthop_is_same (&route->nexthop[j],
-                                             &v->nexthop[i]))
-                    break;
-                  else
-                    continue;
-                }
-              ospf6_nexthop_copy (&route->nexthop[j], &v->nexthop[i]);
-              break;
-            }
-        }
+        ospf6_route_add_nexthop (route, &v->nexthop[i]);
 
       prev = (struct ospf6_vertex *) route->route_option;
       assert (prev->hops <= v->hops);
@@ -351,9 +337,7 @@ ospf6_spf_install (struct ospf6_vertex *v,
   route->path.options[1] = v->options[1];
   route->path.options[2] = v->options[2];
 
-  for (i = 0; ospf6_nexthop_is_set (&v->nexthop[i]) &&
-       i < OSPF6_MULTI_PATH_LIMIT; i++)
-    ospf6_nexthop_copy (&route->nexthop[i], &v->nexthop[i]);
+  ospf6_route_set_nexthops (route, v->nexthop, OSPF6_MULTI_PATH_LIMIT);
 
   if (v->parent)
     listnode_add_sort (v->parent->child_list, v);
@@ -502,14 +486,45 @@ ospf6_spf_log_database (struct ospf6_area *oa)
   zlog_debug ("%s", buffer);
 }
 
+/* Whether two SPF results have the same vertices, with the same costs,
+ * options and nexthops.  Both tables are walked in prefix order.
+ */
 static int
-ospf6_spf_calculation_thread (struct thread *t)
+ospf6_spf_table_same (struct ospf6_route_table *a,
+                      struct ospf6_route_table *b)
 {
-  struct ospf6_area *oa;
-  struct timeval start, end, runtime;
+  struct ospf6_route *ra, *rb;
+  int same;
 
-  oa = (struct ospf6_area *) THREAD_ARG (t);
-  oa->thread_spf_calculation = NULL;
+  if (a->count != b->count)
+    return 0;
+
+  ra = ospf6_route_head (a);
+  rb = ospf6_route_head (b);
+  while (ra && rb && ospf6_route_is_identical (ra, rb))
+    {
+      ra = ospf6_route_next (ra);
+      rb = ospf6_route_next (rb);
+    }
+
+  same = (ra == NULL && rb == NULL);
+  if (ra)
+    ospf6_route_unlock (ra);
+  if (rb)
+    ospf6_route_unlock (rb);
+  return same;
+}
+
+/* Calculate the tree of the area afresh.  Returns whether it differs
+ * from the previous one, that is whether the routes of the area have to
+ * be derived again.
+ */
+static int
+ospf6_spf_calculation_area (struct ospf6_area *oa)
+{
+  struct timeval start, end, runtime;
+  struct ospf6_route_table *result_table;
+  int changed;
 
   if (IS_OSPF6_DEBUG_SPF (PROCESS))
     zlog_debug ("SPF calculation for Area %s", oa->name);
@@ -518,17 +533,76 @@ ospf6_spf_calculation_thread (struct thread *t)
 
   /* execute SPF calculation */
   quagga_gettime (QUAGGA_CLK_MONOTONIC, &start);
-  ospf6_spf_calculation (oa->ospf6->router_id, oa->spf_table, oa);
+  result_table = OSPF6_ROUTE_TABLE_CREATE (AREA, SPF_RESULTS);
+  result_table->scope = oa;
+  ospf6_spf_calculation (oa->ospf6->router_id, result_table, oa);
+
+  changed = ! ospf6_spf_table_same (oa->spf_table, result_table);
+  ospf6_spf_table_finish (oa->spf_table);
+  ospf6_route_table_delete (oa->spf_table);
+  oa->spf_table = result_table;
+  if (! changed)
+    oa->spf_unchanged++;
+
   quagga_gettime (QUAGGA_CLK_MONOTONIC, &end);
   timersub (&end, &start, &runtime);
 
   if (IS_OSPF6_DEBUG_SPF (PROCESS) || IS_OSPF6_DEBUG_SPF (TIME))
-    zlog_debug ("SPF runtime: %ld sec %ld usec",
-		runtime.tv_sec, runtime.tv_usec);
+    zlog_debug ("SPF runtime: %ld sec %ld usec, tree %s",
+		runtime.tv_sec, runtime.tv_usec,
+		(changed ? "changed" : "unchanged"));
+
+  return changed;
+}
+
+/* Calculate the trees of all the areas with a calculation pending,
+ * then derive the routes of those whose tree changed, one area after
+ * the other, so that the inter-area and ABR processing these trigger
+ * sees all trees up to date instead of one area's at a time.  The
+ * border router and routing tables are batched meanwhile, so that
+ * their hooks hear of each new or changed route once, at the end.
+ */
+static int
+ospf6_spf_calculation_thread (struct thread *t)
+{
+  struct ospf6_area *oa;
+  struct ospf6 *o;
+  struct list *batch, *changed;
+  struct listnode *node;
+
+  oa = (struct ospf6_area *) THREAD_ARG (t);
+  oa->thread_spf_calculation = NULL;
+  o = oa->ospf6;
+
+  batch = list_new ();
+  listnode_add (batch, oa);
+  for (ALL_LIST_ELEMENTS_RO (o->area_list, node, oa))
+    if (oa->thread_spf_calculation)
+      {
+        THREAD_OFF (oa->thread_spf_calculation);
+        listnode_add (batch, oa);
+      }
+
+  changed = list_new ();
+  for (ALL_LIST_ELEMENTS_RO (batch, node, oa))
+    if (ospf6_spf_calculation_area (oa))
+      listnode_add (changed, oa);
+
+  ospf6_route_table_batch_begin (o->route_table);
+  ospf6_route_table_batch_begin (o->brouter_table);
+
+  for (ALL_LIST_ELEMENTS_RO (changed, node, oa))
+    {
+      ospf6_intra_route_calculation (oa);
+      ospf6_intra_brouter_calculation (oa);
+    }
 
-  ospf6_intra_route_calculation (oa);
-  ospf6_intra_brouter_calculation (oa);
+  /* border routers first, their hooks add to the routing table */
+  ospf6_route_table_batch_end (o->brouter_table);
+  ospf6_route_table_batch_end (o->route_table);
 
+  list_delete (changed);
+  list_delete (batch);
   return 0;
 }
 
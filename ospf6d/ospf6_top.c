@@ -95,6 +95,21 @@ ospf6_top_route_hook_remove (struct ospf6_route *route)
   ospf6_zebra_route_update_remove (route);
 }
 
+/* The routes of a whole calculation, with the zebra messages corked. */
+static void
+ospf6_top_route_hook_commit (struct ospf6_route_table *table,
+                             struct list *routes)
+{
+  struct listnode *node;
+  struct ospf6_route *route;
+
+  zclient_cork (zclient);
+  for (ALL_LIST_ELEMENTS_RO (routes, node, route))
+    if (table->hook_add)
+      (*table->hook_add) (route);
+  zclient_uncork (zclient);
+}
+
 static void
 ospf6_top_brouter_hook_add (struct ospf6_route *route)
 {
@@ -126,11 +141,13 @@ ospf6_create (void)
   o->lsdb_self = ospf6_lsdb_create (o);
   o->lsdb->hook_add = ospf6_top_lsdb_hook_add;
   o->lsdb->hook_remove = ospf6_top_lsdb_hook_remove;
+  ospf6_retrans_init (o);
 
   o->route_table = OSPF6_ROUTE_TABLE_CREATE (GLOBAL, ROUTES);
   o->route_table->scope = o;
   o->route_table->hook_add = ospf6_top_route_hook_add;
   o->route_table->hook_remove = ospf6_top_route_hook_remove;
+  o->route_table->hook_commit = ospf6_top_route_hook_commit;
 
   o->brouter_table = OSPF6_ROUTE_TABLE_CREATE (GLOBAL, BORDER_ROUTERS);
   o->brouter_table->scope = o;
@@ -159,6 +176,7 @@ ospf6_delete (struct ospf6 *o)
 
   ospf6_lsdb_delete (o->lsdb);
   ospf6_lsdb_delete (o->lsdb_self);
+  ospf6_retrans_finish (o);
 
   ospf6_route_table_delete (o->route_table);
   ospf6_route_table_delete (o->brouter_table);
@@ -445,6 +463,7 @@ ospf6_show (struct vty *vty, struct ospf6 *o)
   struct ospf6_area *oa;
   char router_id[16], duration[32];
   struct timeval now, running;
+  unsigned int index;
 
   /* process id, router id */
   inet_ntop (AF_INET, &o->router_id, router_id, sizeof (router_id));
@@ -463,6 +482,15 @@ ospf6_show (struct vty *vty, struct ospf6 *o)
   /* LSAs */
   vty_out (vty, " Number of AS scoped LSAs is %u%s",
            o->lsdb->count, VNL);
+  vty_out (vty, " LSAs originated:");
+  for (index = 0; index < OSPF6_LSTYPE_SIZE; index++)
+    if (o->lsa_originated[index])
+      vty_out (vty, " %s %u", ospf6_lstype_name (htons (index)),
+               o->lsa_originated[index]);
+  vty_out (vty, "%s", VNL);
+  vty_out (vty, " LSA originations delayed by MinLSInterval %u, "
+           "merged into a pending one %u%s",
+           o->lsa_throttled, o->lsa_coalesced, VNL);
 
   /* Areas */
   vty_out (vty, " Number of areas in this router is %u%s",
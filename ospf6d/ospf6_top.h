@@ -23,6 +23,7 @@
 #define OSPF6_TOP_H
 
 #include "routemap.h"
+#include "ospf6_lsa.h"
 
 /* OSPFv3 top level data structure */
 struct ospf6
@@ -43,6 +44,9 @@ struct ospf6
   struct ospf6_lsdb *lsdb;
   struct ospf6_lsdb *lsdb_self;
 
+  /* neighbors' retransmission list entries, see ospf6_flood.c */
+  struct hash *retrans;
+
   struct ospf6_route_table *route_table;
   struct ospf6_route_table *brouter_table;
 
@@ -60,6 +64,14 @@ struct ospf6
   u_char flag;
 
   struct thread *maxage_remover;
+
+  /* New instances of self-originated LSAs, by function code */
+  u_int32_t lsa_originated[OSPF6_LSTYPE_SIZE];
+
+  /* Originations put off by MinLSInterval, and triggers merged into
+     an origination already pending */
+  u_int32_t lsa_throttled;
+  u_int32_t lsa_coalesced;
 };
 
 #define OSPF6_DISABLED    0x01
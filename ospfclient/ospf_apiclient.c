@@ -35,6 +35,7 @@
 #include "stream.h"
 #include "log.h"
 #include "memory.h"
+#include "network.h"
 
 #include "ospfd/ospfd.h"
 #include "ospfd/ospf_interface.h"
@@ -282,6 +283,9 @@ ospf_apiclient_close (struct ospf_apiclient *oclient)
       close (oclient->fd_async);
     }
 
+  if (oclient->ibuf_async)
+    stream_free (oclient->ibuf_async);
+
   /* Free client structure */
   XFREE (MTYPE_OSPF_APICLIENT, oclient);
   return 0;
@@ -388,17 +392,27 @@ ospf_apiclient_register_opaque_type (struct ospf_apiclient *cl,
  * dynamic updates and LSDB_Sync.
  */
 int
-ospf_apiclient_sync_lsdb (struct ospf_apiclient *oclient)
+ospf_apiclient_sync_lsdb_filter (struct ospf_apiclient *oclient,
+				 u_int16_t typemask, u_char origin,
+				 u_char num_areas, struct in_addr *areas)
 {
   struct msg *msg;
   int rc;
-  struct lsa_filter_type filter;
-
-  filter.typemask = 0xFFFF;	/* all LSAs */
-  filter.origin = ANY_ORIGIN;
-  filter.num_areas = 0;		/* all Areas. */
-
-  msg = new_msg_register_event (ospf_apiclient_get_seqnr (), &filter);
+  /* The area IDs follow the filter. */
+  struct
+  {
+    struct lsa_filter_type filter;
+    struct in_addr areas[255];
+  } f;
+  struct lsa_filter_type *filter = &f.filter;
+
+  filter->typemask = typemask;
+  filter->origin = origin;
+  filter->num_areas = num_areas;
+  if (num_areas)
+    memcpy (f.areas, areas, num_areas * sizeof (struct in_addr));
+
+  msg = new_msg_register_event (ospf_apiclient_get_seqnr (), filter);
   if (!msg)
     {
       fprintf (stderr, "new_msg_register_event failed\n");
@@ -409,7 +423,7 @@ ospf_apiclient_sync_lsdb (struct ospf_apiclient *oclient)
   if (rc != 0)
     goto out;
 
-  msg = new_msg_sync_lsdb (ospf_apiclient_get_seqnr (), &filter);
+  msg = new_msg_sync_lsdb (ospf_apiclient_get_seqnr (), filter);
   if (!msg)
     {
       fprintf (stderr, "new_msg_sync_lsdb failed\n");
@@ -421,6 +435,14 @@ out:
   return rc;
 }
 
+int
+ospf_apiclient_sync_lsdb (struct ospf_apiclient *oclient)
+{
+  /* all LSAs, all Areas */
+  return ospf_apiclient_sync_lsdb_filter (oclient, 0xFFFF, ANY_ORIGIN,
+					  0, NULL);
+}
+
 /* 
  * Synchronous request to originate or update an LSA.
  */
@@ -744,3 +766,27 @@ ospf_apiclient_handle_async (struct ospf_apiclient *oclient)
 
   return 0;
 }
+
+int
+ospf_apiclient_read_async (struct ospf_apiclient *oclient)
+{
+  struct msg *msg;
+  int rc;
+
+  if (!oclient->ibuf_async)
+    {
+      if (set_nonblocking (oclient->fd_async) < 0)
+	return -1;
+      oclient->ibuf_async = stream_new (OSPF_API_MSG_BUFSIZ);
+    }
+
+  /* Handle everything that has arrived, without waiting for more. */
+  while ((rc = msg_read_try (oclient->ibuf_async, oclient->fd_async,
+			     &msg)) > 0)
+    {
+      ospf_apiclient_msghandle (oclient, msg);
+      msg_free (msg);
+    }
+
+  return rc;
+}
@@ -33,6 +33,9 @@ struct ospf_apiclient
   int fd_sync;
   int fd_async;
 
+  /* Partially read notification, see ospf_apiclient_read_async() */
+  struct stream *ibuf_async;
+
   /* Pointer to callback functions */
   void (*ready_notify) (u_char lsa_type, u_char opaque_type,
 			struct in_addr addr);
@@ -113,6 +116,16 @@ void ospf_apiclient_register_callback (struct ospf_apiclient *oclient,
 /* Synchronous request to synchronize LSDB. */
 int ospf_apiclient_sync_lsdb (struct ospf_apiclient *oclient);
 
+/* Synchronous request to synchronize part of the LSDB: only LSA types
+   in typemask (bit n for type n), of the given origin (ANY_ORIGIN,
+   SELF_ORIGINATED or NON_SELF_ORIGINATED), from the listed areas (all
+   if num_areas is 0).  Notifications are filtered the same way.  The
+   LSAs arrive as update notifications on the asynchronous channel. */
+int ospf_apiclient_sync_lsdb_filter (struct ospf_apiclient *oclient,
+				     u_int16_t typemask, u_char origin,
+				     u_char num_areas,
+				     struct in_addr *areas);
+
 /* Synchronous request to originate or update opaque LSA. */
 int
 ospf_apiclient_lsa_originate(struct ospf_apiclient *oclient,
@@ -132,4 +145,11 @@ int ospf_apiclient_lsa_delete (struct ospf_apiclient *oclient,
 /* Fetch async message and handle it  */
 int ospf_apiclient_handle_async (struct ospf_apiclient *oclient);
 
+/* Event-driven alternative to ospf_apiclient_handle_async(): call when
+   fd_async is readable, e.g. from a read thread.  Dispatches every
+   message that has arrived to the callbacks and returns without
+   blocking; returns -1 when the connection has gone.  Once used, the
+   asynchronous channel is non-blocking, so do not mix the two. */
+int ospf_apiclient_read_async (struct ospf_apiclient *oclient);
+
 #endif /* _OSPF_APICLIENT_H */
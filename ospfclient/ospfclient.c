@@ -139,8 +139,8 @@ lsa_read (struct thread *thread)
   oclient = THREAD_ARG (thread);
   fd = THREAD_FD (thread);
 
-  /* Handle asynchronous message */
-  ret = ospf_apiclient_handle_async (oclient);
+  /* Handle asynchronous messages */
+  ret = ospf_apiclient_read_async (oclient);
   if (ret < 0) {
     printf ("Connection closed, exiting...");
     exit(0);
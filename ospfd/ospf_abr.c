@@ -560,6 +560,7 @@ ospf_check_abr_status (struct ospf *ospf)
       if (IS_DEBUG_OSPF_EVENT)
 	zlog_debug ("ospf_check_abr_status(): new router flags: %x",new_flags);
       ospf->flags = new_flags;
+      ospf->abr_full = 1;
       ospf_router_lsa_update (ospf);
     }
 }
@@ -1019,98 +1020,103 @@ ospf_abr_process_nssa_translates (struct ospf *ospf)
 }
 
 static void
-ospf_abr_process_network_rt (struct ospf *ospf,
-			     struct route_table *rt)
+ospf_abr_process_network_route (struct ospf *ospf, struct route_node *rn)
 {
   struct ospf_area *area;
   struct ospf_route *or;
-  struct route_node *rn;
+
+  if ((or = rn->info) == NULL)
+    return;
+
+  if (!(area = ospf_area_lookup_by_area_id (ospf, or->u.std.area_id)))
+    {
+      if (IS_DEBUG_OSPF_EVENT)
+	zlog_debug ("ospf_abr_process_network_rt(): area %s no longer exists",
+		   inet_ntoa (or->u.std.area_id));
+      return;
+    }
 
   if (IS_DEBUG_OSPF_EVENT)
-    zlog_debug ("ospf_abr_process_network_rt(): Start");
+    zlog_debug ("ospf_abr_process_network_rt(): this is a route to %s/%d",
+	       inet_ntoa (rn->p.u.prefix4), rn->p.prefixlen);
+  if (or->path_type >= OSPF_PATH_TYPE1_EXTERNAL)
+    {
+      if (IS_DEBUG_OSPF_EVENT)
+	zlog_debug ("ospf_abr_process_network_rt(): "
+		   "this is an External router, skipping");
+      return;
+    }
 
-  for (rn = route_top (rt); rn; rn = route_next (rn))
+  if (or->cost >= OSPF_LS_INFINITY)
     {
-      if ((or = rn->info) == NULL)
-	continue;
+      if (IS_DEBUG_OSPF_EVENT)
+	zlog_debug ("ospf_abr_process_network_rt():"
+		   " this route's cost is infinity, skipping");
+      return;
+    }
 
-      if (!(area = ospf_area_lookup_by_area_id (ospf, or->u.std.area_id)))
-	{
-	  if (IS_DEBUG_OSPF_EVENT)
-	    zlog_debug ("ospf_abr_process_network_rt(): area %s no longer exists",
-		       inet_ntoa (or->u.std.area_id));
-	  continue;
-	}
+  if (or->type == OSPF_DESTINATION_DISCARD)
+    {
+      if (IS_DEBUG_OSPF_EVENT)
+	zlog_debug ("ospf_abr_process_network_rt():"
+		   " this is a discard entry, skipping");
+      return;
+    }
 
+  if (or->path_type == OSPF_PATH_INTRA_AREA &&
+      !ospf_abr_should_announce (ospf, (struct prefix_ipv4 *) &rn->p, or))
+    {
       if (IS_DEBUG_OSPF_EVENT)
-	zlog_debug ("ospf_abr_process_network_rt(): this is a route to %s/%d",
-		   inet_ntoa (rn->p.u.prefix4), rn->p.prefixlen);
-      if (or->path_type >= OSPF_PATH_TYPE1_EXTERNAL)
-	{
-	  if (IS_DEBUG_OSPF_EVENT)
-	    zlog_debug ("ospf_abr_process_network_rt(): "
-		       "this is an External router, skipping");
-	  continue;
-	}
+	zlog_debug("ospf_abr_process_network_rt(): denied by export-list");
+      return;
+    }
 
-      if (or->cost >= OSPF_LS_INFINITY)
-	{
-	  if (IS_DEBUG_OSPF_EVENT)
-	    zlog_debug ("ospf_abr_process_network_rt():"
-		       " this route's cost is infinity, skipping");
-	  continue;
-	}
+  if (or->path_type == OSPF_PATH_INTRA_AREA &&
+      !ospf_abr_plist_out_check (area, or, (struct prefix_ipv4 *) &rn->p))
+    {
+      if (IS_DEBUG_OSPF_EVENT)
+	zlog_debug("ospf_abr_process_network_rt(): denied by prefix-list");
+      return;
+    }
 
-      if (or->type == OSPF_DESTINATION_DISCARD)
-	{
-	  if (IS_DEBUG_OSPF_EVENT)
-	    zlog_debug ("ospf_abr_process_network_rt():"
-		       " this is a discard entry, skipping");
-	  continue;
-	}
+  if ((or->path_type == OSPF_PATH_INTER_AREA) &&
+      !OSPF_IS_AREA_ID_BACKBONE (or->u.std.area_id))
+    {
+      if (IS_DEBUG_OSPF_EVENT)
+	zlog_debug ("ospf_abr_process_network_rt():"
+		   " this is route is not backbone one, skipping");
+      return;
+    }
 
-      if (or->path_type == OSPF_PATH_INTRA_AREA &&
-	  !ospf_abr_should_announce (ospf, (struct prefix_ipv4 *) &rn->p, or))
-	{
-	  if (IS_DEBUG_OSPF_EVENT)
-	    zlog_debug("ospf_abr_process_network_rt(): denied by export-list");
-	  continue;
-	}
 
-      if (or->path_type == OSPF_PATH_INTRA_AREA &&
-	  !ospf_abr_plist_out_check (area, or, (struct prefix_ipv4 *) &rn->p))
-	{
-	  if (IS_DEBUG_OSPF_EVENT)
-	    zlog_debug("ospf_abr_process_network_rt(): denied by prefix-list");
-	  continue;
-	}
+  if ((ospf->abr_type == OSPF_ABR_CISCO) ||
+      (ospf->abr_type == OSPF_ABR_IBM))
 
-      if ((or->path_type == OSPF_PATH_INTER_AREA) &&
-          !OSPF_IS_AREA_ID_BACKBONE (or->u.std.area_id))
-	{
-	  if (IS_DEBUG_OSPF_EVENT)
-	    zlog_debug ("ospf_abr_process_network_rt():"
-		       " this is route is not backbone one, skipping");
-	  continue;
-	}
+      if (!ospf_act_bb_connection (ospf) &&
+	  or->path_type != OSPF_PATH_INTRA_AREA)
+	 {
+	   if (IS_DEBUG_OSPF_EVENT)
+	     zlog_debug ("ospf_abr_process_network_rt(): ALT ABR: "
+			"No BB connection, skip not intra-area routes");
+	   return;
+	 }
 
+  if (IS_DEBUG_OSPF_EVENT)
+    zlog_debug ("ospf_abr_process_network_rt(): announcing");
+  ospf_abr_announce_network (ospf, (struct prefix_ipv4 *)&rn->p, or);
+}
 
-      if ((ospf->abr_type == OSPF_ABR_CISCO) ||
-          (ospf->abr_type == OSPF_ABR_IBM))
+static void
+ospf_abr_process_network_rt (struct ospf *ospf,
+			     struct route_table *rt)
+{
+  struct route_node *rn;
 
-          if (!ospf_act_bb_connection (ospf) &&
-              or->path_type != OSPF_PATH_INTRA_AREA)
-	     {
-	       if (IS_DEBUG_OSPF_EVENT)
-		 zlog_debug ("ospf_abr_process_network_rt(): ALT ABR: "
-			    "No BB connection, skip not intra-area routes");
-	       continue;
-	     }
+  if (IS_DEBUG_OSPF_EVENT)
+    zlog_debug ("ospf_abr_process_network_rt(): Start");
 
-      if (IS_DEBUG_OSPF_EVENT)
-	zlog_debug ("ospf_abr_process_network_rt(): announcing");
-      ospf_abr_announce_network (ospf, (struct prefix_ipv4 *)&rn->p, or);
-    }
+  for (rn = route_top (rt); rn; rn = route_next (rn))
+    ospf_abr_process_network_route (ospf, rn);
 
   if (IS_DEBUG_OSPF_EVENT)
     zlog_debug ("ospf_abr_process_network_rt(): Stop");
@@ -1367,8 +1373,10 @@ ospf_abr_unapprove_translates (struct ospf *ospf) /* For NSSA Translations */
     zlog_debug ("ospf_abr_unapprove_translates(): Stop");
 }
 
+/* Unset approved on the self-originated summary-LSAs, or only on the
+   ASBR-summary-LSAs if networks is 0. */
 static void
-ospf_abr_unapprove_summaries (struct ospf *ospf)
+ospf_abr_unapprove_summaries (struct ospf *ospf, int networks)
 {
   struct listnode *node;
   struct ospf_area *area;
@@ -1384,6 +1392,7 @@ ospf_abr_unapprove_summaries (struct ospf *ospf)
         zlog_debug ("ospf_abr_unapprove_summaries(): "
                    "considering area %s",
                    inet_ntoa (area->area_id)); 
+      if (networks)
       LSDB_LOOP (SUMMARY_LSDB (area), rn, lsa)
       if (ospf_lsa_is_self_originated (ospf, lsa))
         {
@@ -1664,7 +1673,7 @@ ospf_abr_remove_unapproved_translates (struct ospf *ospf)
 }
 
 static void
-ospf_abr_remove_unapproved_summaries (struct ospf *ospf)
+ospf_abr_remove_unapproved_summaries (struct ospf *ospf, int networks)
 {
   struct listnode *node;
   struct ospf_area *area;
@@ -1680,6 +1689,7 @@ ospf_abr_remove_unapproved_summaries (struct ospf *ospf)
 	zlog_debug ("ospf_abr_remove_unapproved_summaries(): "
 		   "looking at area %s", inet_ntoa (area->area_id));
 
+      if (networks)
       LSDB_LOOP (SUMMARY_LSDB (area), rn, lsa)
 	if (ospf_lsa_is_self_originated (ospf, lsa))
 	  if (!CHECK_FLAG (lsa->flags, OSPF_LSA_APPROVED))
@@ -1717,6 +1727,127 @@ ospf_abr_manage_discard_routes (struct ospf *ospf)
 	  }
 }
 
+/* Redo the summary-LSAs for network p alone. */
+static void
+ospf_abr_process_network_prefix (struct ospf *ospf, struct prefix_ipv4 *p)
+{
+  struct listnode *node;
+  struct ospf_area *area;
+  struct route_node *rn;
+  struct ospf_lsa *lsa;
+
+  if (IS_DEBUG_OSPF_EVENT)
+    zlog_debug ("ospf_abr_process_network_prefix(): %s/%d",
+		inet_ntoa (p->prefix), p->prefixlen);
+
+  for (ALL_LIST_ELEMENTS_RO (ospf->areas, node, area))
+    if ((lsa = ospf_lsa_lookup_by_prefix (area->lsdb, OSPF_SUMMARY_LSA, p,
+					  ospf->router_id)))
+      UNSET_FLAG (lsa->flags, OSPF_LSA_APPROVED);
+
+  if ((rn = route_node_lookup (ospf->new_table, (struct prefix *) p)))
+    {
+      ospf_abr_process_network_route (ospf, rn);
+      route_unlock_node (rn);
+    }
+
+  /* The default summary-LSA into stub areas is the same LSA. */
+  if (p->prefixlen == 0)
+    ospf_abr_announce_stub_defaults (ospf);
+
+  for (ALL_LIST_ELEMENTS_RO (ospf->areas, node, area))
+    if ((lsa = ospf_lsa_lookup_by_prefix (area->lsdb, OSPF_SUMMARY_LSA, p,
+					  ospf->router_id))
+	&& !CHECK_FLAG (lsa->flags, OSPF_LSA_APPROVED))
+      ospf_lsa_flush_area (lsa, area);
+}
+
+/* Whether the summary-LSAs for network p depend on other routes, being
+   those of an area range. */
+static int
+ospf_abr_network_in_range (struct ospf *ospf, struct prefix_ipv4 *p)
+{
+  struct listnode *node;
+  struct ospf_area *area;
+  struct route_node *rn;
+  struct ospf_area_range *range;
+  struct prefix_ipv4 q;
+
+  for (ALL_LIST_ELEMENTS_RO (ospf->areas, node, area))
+    for (rn = route_top (area->ranges); rn; rn = route_next (rn))
+      if ((range = rn->info) != NULL)
+	{
+	  if (prefix_match (&rn->p, (struct prefix *) p))
+	    {
+	      route_unlock_node (rn);
+	      return 1;
+	    }
+	  if (CHECK_FLAG (range->flags, OSPF_AREA_RANGE_SUBSTITUTE))
+	    {
+	      q.family = AF_INET;
+	      q.prefix = range->subst_addr;
+	      q.prefixlen = range->subst_masklen;
+	      if (prefix_same ((struct prefix *) &q, (struct prefix *) p))
+		{
+		  route_unlock_node (rn);
+		  return 1;
+		}
+	    }
+	}
+
+  return 0;
+}
+
+/* Whether the summary-LSAs may change for routes which did not: the
+   areas' transit capability or stub router state, or the backbone
+   connection of an alternative ABR.  Records the current state. */
+static int
+ospf_abr_state_changed (struct ospf *ospf)
+{
+  struct listnode *node;
+  struct ospf_area *area;
+  u_char state;
+  int bb, changed = 0;
+
+  for (ALL_LIST_ELEMENTS_RO (ospf->areas, node, area))
+    {
+      state = (ospf_area_is_transit (area) ? 1 : 0)
+	| (CHECK_FLAG (area->stub_router_state, OSPF_AREA_IS_STUB_ROUTED)
+	   ? 2 : 0);
+      if (state != area->abr_state)
+	changed = 1;
+      area->abr_state = state;
+    }
+
+  bb = ospf_act_bb_connection (ospf);
+  if (bb != ospf->abr_bb_connection)
+    changed = 1;
+  ospf->abr_bb_connection = bb;
+
+  return changed;
+}
+
+/* Whether ospf_abr_task() can redo only the summary-LSAs for the routes
+   which the last calculation changed. */
+static int
+ospf_abr_task_incremental (struct ospf *ospf)
+{
+  struct listnode *node;
+  struct prefix_ipv4 *p;
+  int changed;
+
+  changed = ospf_abr_state_changed (ospf);
+
+  if (ospf->abr_full || ospf->abr_changes == NULL || changed)
+    return 0;
+
+  for (ALL_LIST_ELEMENTS_RO (ospf->abr_changes, node, p))
+    if (ospf_abr_network_in_range (ospf, p))
+      return 0;
+
+  return 1;
+}
+
 /* This is the function taking care about ABR NSSA, i.e.  NSSA
    Translator, -LSA aggregation and flooding. For all NSSAs
 
@@ -1800,6 +1931,9 @@ ospf_abr_nssa_task (struct ospf *ospf) /* called only if any_nssa */
 
   ospf_abr_manage_discard_routes (ospf); /* same as normal...discard */
 
+  /* The area ranges were reset, recount them on the next run. */
+  ospf->abr_full = 1;
+
   if (IS_DEBUG_OSPF_NSSA)
     zlog_debug ("ospf_abr_nssa_task(): Stop");
 }
@@ -1819,9 +1953,30 @@ ospf_abr_task (struct ospf *ospf)
       return;
     }
 
+  if (ospf_abr_task_incremental (ospf))
+    {
+      struct listnode *node;
+      struct prefix_ipv4 *p;
+
+      if (IS_DEBUG_OSPF_EVENT)
+	zlog_debug ("ospf_abr_task(): %d changed networks",
+		    listcount (ospf->abr_changes));
+
+      for (ALL_LIST_ELEMENTS_RO (ospf->abr_changes, node, p))
+	ospf_abr_process_network_prefix (ospf, p);
+
+      /* There are few routes to ASBRs, they are all looked at. */
+      ospf_abr_unapprove_summaries (ospf, 0);
+      ospf_abr_process_router_rt (ospf, ospf->new_rtrs);
+      ospf_abr_remove_unapproved_summaries (ospf, 0);
+
+      ospf_abr_manage_discard_routes (ospf);
+      goto done;
+    }
+
   if (IS_DEBUG_OSPF_EVENT)
     zlog_debug ("ospf_abr_task(): unapprove summaries");
-  ospf_abr_unapprove_summaries (ospf);
+  ospf_abr_unapprove_summaries (ospf, 1);
 
   if (IS_DEBUG_OSPF_EVENT)
     zlog_debug ("ospf_abr_task(): prepare aggregates");
@@ -1848,10 +2003,16 @@ ospf_abr_task (struct ospf *ospf)
 
   if (IS_DEBUG_OSPF_EVENT)
     zlog_debug ("ospf_abr_task(): remove unapproved summaries");
-  ospf_abr_remove_unapproved_summaries (ospf);
+  ospf_abr_remove_unapproved_summaries (ospf, 1);
 
   ospf_abr_manage_discard_routes (ospf);
 
+ done:
+  if (ospf->abr_changes)
+    list_delete (ospf->abr_changes);
+  ospf->abr_changes = NULL;
+  ospf->abr_full = 0;
+
   if (IS_DEBUG_OSPF_EVENT)
     zlog_debug ("ospf_abr_task(): Stop");
 }
@@ -1881,6 +2042,8 @@ ospf_schedule_abr_task (struct ospf *ospf)
   if (IS_DEBUG_OSPF_EVENT)
     zlog_debug ("Scheduling ABR task");
 
+  ospf->abr_full = 1;
+
   if (ospf->t_abr_task == NULL)
     ospf->t_abr_task = thread_add_timer (master, ospf_abr_task_timer,
 					 ospf, OSPF_ABR_TASK_DELAY);
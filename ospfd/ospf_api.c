@@ -441,6 +441,80 @@ msg_write (int fd, struct msg *msg)
   return 0;
 }
 
+/* Non-blocking counterpart of msg_read(): collect a message in stream s,
+   which must hold OSPF_API_MSG_BUFSIZ bytes, across as many calls as it
+   takes.  Returns 1 and sets *msgp once a whole message has arrived, 0
+   if more is still to come, and -1 on error or when the peer closed
+   the connection. */
+int
+msg_read_try (struct stream *s, int fd, struct msg **msgp)
+{
+  struct apimsghdr hdr;
+  size_t have, want;
+  ssize_t nbytes;
+
+  *msgp = NULL;
+
+  have = stream_get_endp (s);
+  want = sizeof (struct apimsghdr);
+  if (have >= want)
+    {
+      memcpy (&hdr, STREAM_DATA (s), sizeof (struct apimsghdr));
+      want += ntohs (hdr.msglen);
+    }
+
+  if (have < want)
+    {
+      nbytes = stream_read_try (s, fd, want - have);
+      if (nbytes == -2)
+        return 0;
+      if (nbytes < 0)
+        return -1;
+      if (nbytes == 0)
+        {
+          zlog_warn ("msg_read_try: Connection closed by peer");
+          return -1;
+        }
+      have += nbytes;
+      if (have < want)
+        return 0;
+    }
+
+  if (want == sizeof (struct apimsghdr))
+    {
+      /* Header complete: check it, then go for the body. */
+      memcpy (&hdr, STREAM_DATA (s), sizeof (struct apimsghdr));
+      if (hdr.version != OSPF_API_VERSION)
+        {
+          zlog_warn ("msg_read_try: OSPF API protocol version mismatch");
+          return -1;
+        }
+      if (ntohs (hdr.msglen) > OSPF_API_MAX_MSG_SIZE)
+        {
+          zlog_warn ("msg_read_try: message too long (%u)",
+                     ntohs (hdr.msglen));
+          return -1;
+        }
+      if (ntohs (hdr.msglen) > 0)
+        return msg_read_try (s, fd, msgp);
+    }
+
+  *msgp = msg_new (hdr.msgtype, STREAM_DATA (s) + sizeof (struct apimsghdr),
+                   ntohl (hdr.msgseq), ntohs (hdr.msglen));
+  stream_reset (s);
+  return 1;
+}
+
+/* Append a message, header and body, to an output buffer, so that
+   queued messages can go out together in as few writes as the socket
+   allows. */
+void
+msg_buffer_put (struct buffer *b, struct msg *msg)
+{
+  buffer_put (b, &msg->hdr, sizeof (struct apimsghdr));
+  buffer_put (b, STREAM_DATA (msg->s), ntohs (msg->hdr.msglen));
+}
+
 /* -----------------------------------------------------------
  * Specific messages
  * -----------------------------------------------------------
@@ -474,7 +548,8 @@ new_msg_register_event (u_int32_t seqnum, struct lsa_filter_type *filter)
   emsg->filter.num_areas = filter->num_areas;
   if (len > sizeof (buf))
     len = sizeof(buf);
-  /* API broken - missing memcpy to fill data */
+  /* The area IDs follow the filter. */
+  memcpy (&emsg->filter + 1, filter + 1, len - sizeof (*emsg));
   return msg_new (MSG_REGISTER_EVENT, emsg, seqnum, len);
 }
 
@@ -493,7 +568,8 @@ new_msg_sync_lsdb (u_int32_t seqnum, struct lsa_filter_type *filter)
   smsg->filter.num_areas = filter->num_areas;
   if (len > sizeof (buf))
     len = sizeof(buf);
-  /* API broken - missing memcpy to fill data */
+  /* The area IDs follow the filter. */
+  memcpy (&smsg->filter + 1, filter + 1, len - sizeof (*smsg));
   return msg_new (MSG_SYNC_LSDB, smsg, seqnum, len);
 }
 
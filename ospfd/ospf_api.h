@@ -37,6 +37,8 @@
 /* This value could be overridden by "ospfapi" entry in "/etc/services". */
 #define OSPF_API_SYNC_PORT      2607
 
+struct buffer;
+
 /* -----------------------------------------------------------
  * Generic messages 
  * -----------------------------------------------------------
@@ -72,6 +74,8 @@ extern void msg_print (struct msg *msg);	/* XXX debug only */
 extern void msg_free (struct msg *msg);
 struct msg *msg_read (int fd);
 extern int msg_write (int fd, struct msg *msg);
+extern int msg_read_try (struct stream *s, int fd, struct msg **msgp);
+extern void msg_buffer_put (struct buffer *b, struct msg *msg);
 
 /* For requests, the message sequence number is between MIN_SEQ and
    MAX_SEQ. For notifications, the sequence number is 0. */
@@ -300,6 +304,10 @@ struct apimsg
 
 #define OSPF_API_MAX_MSG_SIZE (sizeof(struct apimsg) + OSPF_MAX_LSA_SIZE)
 
+/* Size of the input stream msg_read_try() collects a message in. */
+#define OSPF_API_MSG_BUFSIZ \
+  (sizeof (struct apimsghdr) + OSPF_API_MAX_MSG_SIZE)
+
 /* -----------------------------------------------------------
  * Prototypes for specific messages
  * -----------------------------------------------------------
@@ -40,6 +40,7 @@
 #include "hash.h"
 #include "sockunion.h"		/* for inet_aton() */
 #include "buffer.h"
+#include "network.h"
 
 #include <sys/types.h>
 
@@ -72,6 +73,18 @@
  * use this information to reconstruct the OSPF's LSDB. The OSPF
  * daemon supports multiple applications concurrently.  */
 
+/* Client sockets are non-blocking: queued messages are batched into
+   writes of up to this many bytes. */
+#define OSPF_APISERVER_WRITE_BATCH	65536
+
+/* LSDB synchronization keeps at most this many LSAs queued for a
+   client, taking more from its snapshot as they are written out. */
+#define OSPF_APISERVER_SYNC_BATCH	256
+
+/* A client that lets this many notifications pile up is disconnected
+   rather than allowed to grow ospfd without bound. */
+#define OSPF_APISERVER_FIFO_MAX		100000
+
 /* List of all active connections. */
 struct list *apiserver_list;
 
@@ -281,12 +294,21 @@ ospf_apiserver_new (int fd_sync, int fd_async)
 
   new->out_sync_fifo = msg_fifo_new ();
   new->out_async_fifo = msg_fifo_new ();
+  new->wb_sync = buffer_new (0);
+  new->wb_async = buffer_new (0);
+  new->ibuf_sync = stream_new (OSPF_API_MSG_BUFSIZ);
+#ifdef USE_ASYNC_READ
+  new->ibuf_async = stream_new (OSPF_API_MSG_BUFSIZ);
+#endif /* USE_ASYNC_READ */
+  new->sync_lsas = list_new ();
+  new->sync_seqnum = 0;
   new->t_sync_read = NULL;
 #ifdef USE_ASYNC_READ
   new->t_async_read = NULL;
 #endif /* USE_ASYNC_READ */
   new->t_sync_write = NULL;
   new->t_async_write = NULL;
+  new->t_overflow = NULL;
 
   new->filter->typemask = 0;	/* filter all LSAs */
   new->filter->origin = ANY_ORIGIN;
@@ -360,6 +382,11 @@ ospf_apiserver_free (struct ospf_apiserver *apiserv)
       thread_cancel (apiserv->t_async_write);
     }
 
+  if (apiserv->t_overflow)
+    {
+      thread_cancel (apiserv->t_overflow);
+    }
+
   /* Unregister all opaque types that application registered 
      and flush opaque LSAs if still in LSDB. */
 
@@ -386,6 +413,22 @@ ospf_apiserver_free (struct ospf_apiserver *apiserv)
   /* Free fifos */
   msg_fifo_free (apiserv->out_sync_fifo);
   msg_fifo_free (apiserv->out_async_fifo);
+  buffer_free (apiserv->wb_sync);
+  buffer_free (apiserv->wb_async);
+  stream_free (apiserv->ibuf_sync);
+#ifdef USE_ASYNC_READ
+  stream_free (apiserv->ibuf_async);
+#endif /* USE_ASYNC_READ */
+
+  /* Drop what is left of LSDB synchronization. */
+  while ((node = listhead (apiserv->sync_lsas)) != NULL)
+    {
+      struct ospf_lsa *lsa = listgetdata (node);
+
+      list_delete_node (apiserv->sync_lsas, node);
+      ospf_lsa_unlock (&lsa);
+    }
+  list_delete (apiserv->sync_lsas);
 
   /* Clear temporary strage for LSA instances to be refreshed. */
   ospf_lsdb_delete_all (&apiserv->reserve);
@@ -406,6 +449,7 @@ ospf_apiserver_read (struct thread *thread)
 {
   struct ospf_apiserver *apiserv;
   struct msg *msg;
+  struct stream *ibuf;
   int fd;
   int rc = -1;
   enum event event;
@@ -416,6 +460,7 @@ ospf_apiserver_read (struct thread *thread)
   if (fd == apiserv->fd_sync)
     {
       event = OSPF_APISERVER_SYNC_READ;
+      ibuf = apiserv->ibuf_sync;
       apiserv->t_sync_read = NULL;
 
       if (IS_DEBUG_OSPF_EVENT)
@@ -427,6 +472,7 @@ ospf_apiserver_read (struct thread *thread)
   else if (fd == apiserv->fd_async)
     {
       event = OSPF_APISERVER_ASYNC_READ;
+      ibuf = apiserv->ibuf_async;
       apiserv->t_async_read = NULL;
 
       if (IS_DEBUG_OSPF_EVENT)
@@ -442,9 +488,9 @@ ospf_apiserver_read (struct thread *thread)
       goto out;
     }
 
-  /* Read message from fd. */
-  msg = msg_read (fd);
-  if (msg == NULL)
+  /* Read message from fd, without waiting for the rest of it. */
+  rc = msg_read_try (ibuf, fd, &msg);
+  if (rc < 0)
     {
       zlog_warn
 	("ospf_apiserver_read: read failed on fd=%d, closing connection", fd);
@@ -453,6 +499,11 @@ ospf_apiserver_read (struct thread *thread)
       ospf_apiserver_free (apiserv);
       goto out;
     }
+  if (msg == NULL)
+    {
+      ospf_apiserver_event (event, fd, apiserv);
+      return 0;
+    }
 
   if (IS_DEBUG_OSPF_EVENT)
     msg_print (msg);
@@ -469,11 +520,42 @@ out:
   return rc;
 }
 
+/* Move queued messages from a fifo into the write buffer and write out
+   as much as the socket takes.  Returns -1 on error, 1 if there is more
+   to write and 0 once everything queued has gone out. */
+static int
+ospf_apiserver_write (struct msg_fifo *fifo, struct buffer *wb, int fd)
+{
+  struct msg *msg;
+
+  while (buffer_length (wb) < OSPF_APISERVER_WRITE_BATCH
+	 && (msg = msg_fifo_pop (fifo)) != NULL)
+    {
+      if (IS_DEBUG_OSPF_EVENT)
+	msg_print (msg);
+
+      msg_buffer_put (wb, msg);
+
+      /* Once a message is dequeued, it should be freed anyway. */
+      msg_free (msg);
+    }
+
+  switch (buffer_flush_available (wb, fd))
+    {
+    case BUFFER_ERROR:
+      return -1;
+    case BUFFER_PENDING:
+      return 1;
+    case BUFFER_EMPTY:
+      break;
+    }
+  return (msg_fifo_head (fifo) != NULL);
+}
+
 int
 ospf_apiserver_sync_write (struct thread *thread)
 {
   struct ospf_apiserver *apiserv;
-  struct msg *msg;
   int fd;
   int rc = -1;
 
@@ -495,22 +577,7 @@ ospf_apiserver_sync_write (struct thread *thread)
                 inet_ntoa (apiserv->peer_sync.sin_addr),
                 ntohs (apiserv->peer_sync.sin_port));
 
-  /* Check whether there is really a message in the fifo. */
-  msg = msg_fifo_pop (apiserv->out_sync_fifo);
-  if (!msg)
-    {
-      zlog_warn ("API: ospf_apiserver_sync_write: No message in Sync-FIFO?");
-      return 0;
-    }
-
-  if (IS_DEBUG_OSPF_EVENT)
-    msg_print (msg);
-
-  rc = msg_write (fd, msg);
-
-  /* Once a message is dequeued, it should be freed anyway. */
-  msg_free (msg);
-
+  rc = ospf_apiserver_write (apiserv->out_sync_fifo, apiserv->wb_sync, fd);
   if (rc < 0)
     {
       zlog_warn
@@ -518,9 +585,8 @@ ospf_apiserver_sync_write (struct thread *thread)
       goto out;
     }
 
-
-  /* If more messages are in sync message fifo, schedule write thread. */
-  if (msg_fifo_head (apiserv->out_sync_fifo))
+  /* If more messages are pending, schedule write thread. */
+  if (rc > 0)
     {
       ospf_apiserver_event (OSPF_APISERVER_SYNC_WRITE, apiserv->fd_sync,
                             apiserv);
@@ -542,7 +608,6 @@ int
 ospf_apiserver_async_write (struct thread *thread)
 {
   struct ospf_apiserver *apiserv;
-  struct msg *msg;
   int fd;
   int rc = -1;
 
@@ -564,22 +629,7 @@ ospf_apiserver_async_write (struct thread *thread)
                 inet_ntoa (apiserv->peer_async.sin_addr),
                 ntohs (apiserv->peer_async.sin_port));
 
-  /* Check whether there is really a message in the fifo. */
-  msg = msg_fifo_pop (apiserv->out_async_fifo);
-  if (!msg)
-    {
-      zlog_warn ("API: ospf_apiserver_async_write: No message in Async-FIFO?");
-      return 0;
-    }
-
-  if (IS_DEBUG_OSPF_EVENT)
-    msg_print (msg);
-
-  rc = msg_write (fd, msg);
-
-  /* Once a message is dequeued, it should be freed anyway. */
-  msg_free (msg);
-
+  rc = ospf_apiserver_write (apiserv->out_async_fifo, apiserv->wb_async, fd);
   if (rc < 0)
     {
       zlog_warn
@@ -587,9 +637,11 @@ ospf_apiserver_async_write (struct thread *thread)
       goto out;
     }
 
+  /* The client is keeping up: top up LSDB synchronization. */
+  ospf_apiserver_sync_feed (apiserv);
 
-  /* If more messages are in async message fifo, schedule write thread. */
-  if (msg_fifo_head (apiserv->out_async_fifo))
+  /* If more messages are pending, schedule write thread. */
+  if (rc > 0 || msg_fifo_head (apiserv->out_async_fifo))
     {
       ospf_apiserver_event (OSPF_APISERVER_ASYNC_WRITE, apiserv->fd_async,
                             apiserv);
@@ -740,6 +792,17 @@ ospf_apiserver_accept (struct thread *thread)
     }
 #endif /* USE_ASYNC_READ */
 
+  /* A slow client must not hold up ospfd: writes are queued and
+     retried when the socket drains. */
+  if (set_nonblocking (new_sync_sock) < 0
+      || set_nonblocking (new_async_sock) < 0)
+    {
+      zlog_warn ("ospf_apiserver_accept: set_nonblocking failed");
+      close (new_sync_sock);
+      close (new_async_sock);
+      return -1;
+    }
+
   /* Allocate new server-side connection structure */
   apiserv = ospf_apiserver_new (new_sync_sock, new_async_sock);
 
@@ -766,6 +829,20 @@ ospf_apiserver_accept (struct thread *thread)
  * -----------------------------------------------------------
  */
 
+/* Disconnect a client that stopped reading its notifications. */
+static int
+ospf_apiserver_overflow (struct thread *thread)
+{
+  struct ospf_apiserver *apiserv = THREAD_ARG (thread);
+
+  apiserv->t_overflow = NULL;
+  zlog_warn ("API: Peer %s/%u is not reading notifications, "
+	     "disconnecting", inet_ntoa (apiserv->peer_sync.sin_addr),
+	     ntohs (apiserv->peer_sync.sin_port));
+  ospf_apiserver_free (apiserv);
+  return 0;
+}
+
 static int
 ospf_apiserver_send_msg (struct ospf_apiserver *apiserv, struct msg *msg)
 {
@@ -798,6 +875,19 @@ ospf_apiserver_send_msg (struct ospf_apiserver *apiserv, struct msg *msg)
       return -1;
     }
 
+  /* Backpressure: a client that lets notifications pile up is cut
+     off, from an event since callers may still be walking the list
+     of clients. */
+  if (apiserv->t_overflow)
+    return -1;
+  if (fifo->count >= OSPF_APISERVER_FIFO_MAX)
+    {
+      msg_fifo_flush (fifo);
+      apiserv->t_overflow =
+	thread_add_event (master, ospf_apiserver_overflow, apiserv, 0);
+      return -1;
+    }
+
   /* Make a copy of the message and put in the fifo. Once the fifo
      gets drained by the write thread, the message will be freed. */
   /* NB: Given "msg" is untouched in this function. */
@@ -1266,19 +1356,55 @@ ospf_apiserver_handle_register_event (struct ospf_apiserver *apiserv,
  * -----------------------------------------------------------
  */
 
+/* Send one LSA of an LSDB synchronization. */
+static void
+apiserver_sync_send (struct ospf_apiserver *apiserv, struct ospf_lsa *lsa,
+		     u_int32_t seqnum)
+{
+  struct msg *msg;
+
+  /* Default area for AS-External and Opaque11 LSAs */
+  struct in_addr area_id = { .s_addr = 0L };
+
+  /* Default interface for non Opaque9 LSAs */
+  struct in_addr ifaddr = { .s_addr = 0L };
+
+  if (lsa->area)
+    {
+      area_id = lsa->area->area_id;
+    }
+  if (lsa->data->type == OSPF_OPAQUE_LINK_LSA)
+    {
+      ifaddr = lsa->oi->address->u.prefix4;
+    }
+
+  msg = new_msg_lsa_change_notify (MSG_LSA_UPDATE_NOTIFY,
+				   seqnum,
+				   ifaddr, area_id,
+				   lsa->flags & OSPF_LSA_SELF, lsa->data);
+  if (!msg)
+    {
+      zlog_warn ("apiserver_sync_send: new_msg_update failed");
+      return;
+    }
+
+  /* Send LSA */
+  ospf_apiserver_send_msg (apiserv, msg);
+  msg_free (msg);
+}
+
+/* Take an LSA matching the request into the client's snapshot; it is
+   sent later, as the client reads, by ospf_apiserver_sync_feed(). */
 static int
 apiserver_sync_callback (struct ospf_lsa *lsa, void *p_arg, int int_arg)
 {
   struct ospf_apiserver *apiserv;
-  int seqnum;
-  struct msg *msg;
   struct param_t
   {
     struct ospf_apiserver *apiserv;
     struct lsa_filter_type *filter;
   }
    *param;
-  int rc = -1;
 
   /* Sanity check */
   assert (lsa->data);
@@ -1286,50 +1412,35 @@ apiserver_sync_callback (struct ospf_lsa *lsa, void *p_arg, int int_arg)
 
   param = (struct param_t *) p_arg;
   apiserv = param->apiserv;
-  seqnum = (u_int32_t) int_arg;
 
   /* Check origin in filter. */
   if ((param->filter->origin == ANY_ORIGIN) ||
       (param->filter->origin == (lsa->flags & OSPF_LSA_SELF)))
-    {
+    listnode_add (apiserv->sync_lsas, ospf_lsa_lock (lsa));
 
-      /* Default area for AS-External and Opaque11 LSAs */
-      struct in_addr area_id = { .s_addr = 0L };
+  return 0;
+}
 
-      /* Default interface for non Opaque9 LSAs */
-      struct in_addr ifaddr = { .s_addr = 0L };
-      
-      if (lsa->area)
-	{
-	  area_id = lsa->area->area_id;
-	}
-      if (lsa->data->type == OSPF_OPAQUE_LINK_LSA)
-	{
-	  ifaddr = lsa->oi->address->u.prefix4;
-	}
+/* Queue more of the LSDB snapshot while the client keeps up.  An LSA
+   that has left the LSDB since the snapshot was taken is skipped: the
+   update or delete notification that replaced it is already queued. */
+void
+ospf_apiserver_sync_feed (struct ospf_apiserver *apiserv)
+{
+  struct listnode *node;
+  struct ospf_lsa *lsa;
 
-      msg = new_msg_lsa_change_notify (MSG_LSA_UPDATE_NOTIFY,
-				       seqnum,
-				       ifaddr, area_id,
-				       lsa->flags & OSPF_LSA_SELF, lsa->data);
-      if (!msg)
-	{
-	  zlog_warn ("apiserver_sync_callback: new_msg_update failed");
-#ifdef NOTYET
-	  /* Cannot allocate new message. What should we do? */
-/*        ospf_apiserver_free (apiserv);*//* Do nothing here XXX */
-#endif
-	  goto out;
-	}
+  while (apiserv->out_async_fifo->count < OSPF_APISERVER_SYNC_BATCH
+	 && !apiserv->t_overflow
+	 && (node = listhead (apiserv->sync_lsas)) != NULL)
+    {
+      lsa = listgetdata (node);
+      list_delete_node (apiserv->sync_lsas, node);
 
-      /* Send LSA */
-      ospf_apiserver_send_msg (apiserv, msg);
-      msg_free (msg);
+      if (!CHECK_FLAG (lsa->flags, OSPF_LSA_DISCARD))
+	apiserver_sync_send (apiserv, lsa, apiserv->sync_seqnum);
+      ospf_lsa_unlock (&lsa);
     }
-  rc = 0;
-
-out:
-  return rc;
 }
 
 int
@@ -1361,6 +1472,7 @@ ospf_apiserver_handle_sync_lsdb (struct ospf_apiserver *apiserv,
   /* Set parameter struct. */
   param.apiserv = apiserv;
   param.filter = &smsg->filter;
+  apiserv->sync_seqnum = seqnum;
 
   /* Remember mask. */
   mask = ntohs (smsg->filter.typemask);
@@ -1433,8 +1545,10 @@ ospf_apiserver_handle_sync_lsdb (struct ospf_apiserver *apiserv,
 	  apiserver_sync_callback(lsa, (void *) &param, seqnum);
     }
 
-  /* Send a reply back to client with return code */
+  /* Send a reply back to client with return code.  The LSAs follow on
+     the asynchronous channel, paced by the client reading them. */
   rc = ospf_apiserver_send_reply (apiserv, seqnum, rc);
+  ospf_apiserver_sync_feed (apiserv);
   return rc;
 }
 
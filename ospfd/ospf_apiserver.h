@@ -62,6 +62,21 @@ struct ospf_apiserver
   struct msg_fifo *out_sync_fifo;
   struct msg_fifo *out_async_fifo;
 
+  /* Messages taken off the fifos, waiting for the socket to drain */
+  struct buffer *wb_sync;
+  struct buffer *wb_async;
+
+  /* Partially read incoming messages */
+  struct stream *ibuf_sync;
+#ifdef USE_ASYNC_READ
+  struct stream *ibuf_async;
+#endif /* USE_ASYNC_READ */
+
+  /* LSAs still to be sent for LSDB synchronization requests, fed into
+     out_async_fifo as it drains */
+  struct list *sync_lsas;
+  u_int32_t sync_seqnum;
+
   /* Read and write threads */
   struct thread *t_sync_read;
 #ifdef USE_ASYNC_READ
@@ -69,6 +84,9 @@ struct ospf_apiserver
 #endif /* USE_ASYNC_READ */
   struct thread *t_sync_write;
   struct thread *t_async_write;
+
+  /* Disconnect of a client that fell too far behind */
+  struct thread *t_overflow;
 };
 
 enum event
@@ -144,6 +162,7 @@ extern int ospf_apiserver_handle_delete_request (struct ospf_apiserver *apiserv,
 					  struct msg *msg);
 extern int ospf_apiserver_handle_sync_lsdb (struct ospf_apiserver *apiserv,
 				     struct msg *msg);
+extern void ospf_apiserver_sync_feed (struct ospf_apiserver *apiserv);
 
 
 /* -----------------------------------------------------------
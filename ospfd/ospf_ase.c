@@ -31,6 +31,7 @@
 #include "table.h"
 #include "vty.h"
 #include "log.h"
+#include "zclient.h"
 
 #include "ospfd/ospfd.h"
 #include "ospfd/ospf_interface.h"
@@ -666,8 +667,10 @@ ospf_ase_calculate_timer (struct thread *t)
 
       /* Compare old and new external routing table and install the
 	 difference info zebra/kernel */
+      zclient_cork (zclient);
       ospf_ase_compare_tables (ospf->new_external_route,
 			       ospf->old_external_route);
+      zclient_uncork (zclient);
 
       /* Delete old external routing table */
       ospf_route_table_free (ospf->old_external_route);
@@ -763,21 +766,38 @@ ospf_ase_external_lsas_finish (struct route_table *rt)
   route_table_finish (rt);
 }
 
+static void
+ospf_ase_lsa_prefix (struct ospf_lsa *lsa, struct prefix_ipv4 *p)
+{
+  struct as_external_lsa *al;
+
+  al = (struct as_external_lsa *) lsa->data;
+  p->family = AF_INET;
+  p->prefix = lsa->data->id;
+  p->prefixlen = ip_masklen (al->mask);
+  apply_mask_ipv4 (p);
+}
+
 void
 ospf_ase_incremental_update (struct ospf *ospf, struct ospf_lsa *lsa)
+{
+  struct prefix_ipv4 p;
+
+  ospf_ase_lsa_prefix (lsa, &p);
+  ospf_ase_prefix_update (ospf, &p);
+}
+
+/* Recalculate the external route to P from all the LSAs for it, and
+   install the difference. */
+void
+ospf_ase_prefix_update (struct ospf *ospf, struct prefix_ipv4 *prefix)
 {
   struct list *lsas;
   struct listnode *node;
   struct route_node *rn, *rn2;
-  struct prefix_ipv4 p;
+  struct prefix_ipv4 p = *prefix;
   struct route_table *tmp_old;
-  struct as_external_lsa *al;
-
-  al = (struct as_external_lsa *) lsa->data;
-  p.family = AF_INET;
-  p.prefix = lsa->data->id;
-  p.prefixlen = ip_masklen (al->mask);
-  apply_mask_ipv4 (&p);
+  struct ospf_lsa *lsa;
 
   /* if new_table is NULL, there was no spf calculation, thus
      incremental update is unneeded */
@@ -796,14 +816,16 @@ ospf_ase_incremental_update (struct ospf *ospf, struct ospf_lsa *lsa)
 	return;
     }
 
+  /* The last LSA for P may just have gone. */
   rn = route_node_lookup (ospf->external_lsas, (struct prefix *) &p);
-  assert (rn); 
-  assert (rn->info);
-  lsas = rn->info;
-  route_unlock_node (rn);
-
-  for (ALL_LIST_ELEMENTS_RO (lsas, node, lsa))
-    ospf_ase_calculate_route (ospf, lsa);
+  if (rn)
+    {
+      lsas = rn->info;
+      route_unlock_node (rn);
+      if (lsas)
+        for (ALL_LIST_ELEMENTS_RO (lsas, node, lsa))
+          ospf_ase_calculate_route (ospf, lsa);
+    }
 
   /* prepare temporary old routing table for compare */
   tmp_old = route_table_init ();
@@ -850,3 +872,80 @@ ospf_ase_incremental_update (struct ospf *ospf, struct ospf_lsa *lsa)
 
   route_table_finish (tmp_old);
 }
+
+/* Does the route calculated from LSA go through ASBR, or through a
+   forwarding address within FWD? */
+static int
+ospf_ase_lsa_depends (struct ospf_lsa *lsa, struct in_addr *asbr,
+                      struct prefix_ipv4 *fwd)
+{
+  struct as_external_lsa *al;
+  struct prefix_ipv4 p;
+
+  al = (struct as_external_lsa *) lsa->data;
+
+  if (asbr)
+    return IPV4_ADDR_SAME (&lsa->data->adv_router, asbr);
+
+  if (al->e[0].fwd_addr.s_addr == 0)
+    return 0;
+
+  p.family = AF_INET;
+  p.prefix = al->e[0].fwd_addr;
+  p.prefixlen = IPV4_MAX_BITLEN;
+  return prefix_match ((struct prefix *) fwd, (struct prefix *) &p);
+}
+
+static void
+ospf_ase_depending_update (struct ospf *ospf, struct in_addr *asbr,
+                           struct prefix_ipv4 *fwd)
+{
+  struct route_node *rn;
+  struct ospf_lsa *lsa;
+  struct listnode *node;
+  struct ospf_area *area;
+  struct prefix_ipv4 p;
+
+  if (!ospf->new_table)
+    return;
+
+  LSDB_LOOP (EXTERNAL_LSDB (ospf), rn, lsa)
+    if (ospf_ase_lsa_depends (lsa, asbr, fwd))
+      {
+        ospf_ase_lsa_prefix (lsa, &p);
+        ospf_ase_prefix_update (ospf, &p);
+      }
+
+  if (ospf->anyNSSA)
+    for (ALL_LIST_ELEMENTS_RO (ospf->areas, node, area))
+      if (area->external_routing == OSPF_AREA_NSSA)
+        LSDB_LOOP (NSSA_LSDB (area), rn, lsa)
+          if (ospf_ase_lsa_depends (lsa, asbr, fwd))
+            {
+              ospf_ase_lsa_prefix (lsa, &p);
+              ospf_ase_prefix_update (ospf, &p);
+            }
+
+  LSDB_LOOP (NSSA_LSDB (ospf), rn, lsa)
+    if (ospf_ase_lsa_depends (lsa, asbr, fwd))
+      {
+        ospf_ase_lsa_prefix (lsa, &p);
+        ospf_ase_prefix_update (ospf, &p);
+      }
+}
+
+/* The routes to ASBR have changed, recalculate the external routes
+   through it. */
+void
+ospf_ase_asbr_update (struct ospf *ospf, struct in_addr asbr)
+{
+  ospf_ase_depending_update (ospf, &asbr, NULL);
+}
+
+/* The route to P has changed, recalculate the external routes with a
+   forwarding address within it. */
+void
+ospf_ase_forward_update (struct ospf *ospf, struct prefix_ipv4 *p)
+{
+  ospf_ase_depending_update (ospf, NULL, p);
+}
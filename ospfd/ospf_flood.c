@@ -31,6 +31,8 @@
 #include "memory.h"
 #include "log.h"
 #include "zclient.h"
+#include "hash.h"
+#include "jhash.h"
 
 #include "ospfd/ospfd.h"
 #include "ospfd/ospf_interface.h"
@@ -836,40 +838,126 @@ ospf_ls_request_new (struct lsa_header *lsah)
 }
 
 
-/* Management functions for neighbor's ls-retransmit list. */
+/* Management functions for neighbor's ls-retransmit list.
+
+   Each entry links an LSA instance to a neighbor it is waiting to be
+   acknowledged by, and sits both on the neighbor's ls_rxmt queue and on
+   the LSA's rxmt list.  The instance-wide ls_rxmt hash finds the entry
+   for a neighbor and an LSA key, so adding, acknowledging and flushing
+   do not search every neighbor or keep a copy of the LSDB for each. */
+static unsigned int
+ospf_ls_rxmt_hash_key (void *arg)
+{
+  struct ospf_ls_rxmt *rx = arg;
+  struct lsa_header *lsah = rx->lsa->data;
+
+  return jhash_3words (lsah->id.s_addr, lsah->adv_router.s_addr,
+		       lsah->type, (u_int32_t) (uintptr_t) rx->nbr);
+}
+
+static int
+ospf_ls_rxmt_hash_cmp (const void *arg1, const void *arg2)
+{
+  const struct ospf_ls_rxmt *rx1 = arg1;
+  const struct ospf_ls_rxmt *rx2 = arg2;
+
+  return rx1->nbr == rx2->nbr
+    && rx1->lsa->data->type == rx2->lsa->data->type
+    && rx1->lsa->data->id.s_addr == rx2->lsa->data->id.s_addr
+    && rx1->lsa->data->adv_router.s_addr
+       == rx2->lsa->data->adv_router.s_addr;
+}
+
+void
+ospf_ls_rxmt_init (struct ospf *ospf)
+{
+  ospf->ls_rxmt = hash_create_open (0, ospf_ls_rxmt_hash_key,
+				    ospf_ls_rxmt_hash_cmp);
+  hash_set_name (ospf->ls_rxmt, "OSPF retransmission lists");
+}
+
+void
+ospf_ls_rxmt_finish (struct ospf *ospf)
+{
+  hash_free (ospf->ls_rxmt);
+  ospf->ls_rxmt = NULL;
+}
+
+static struct ospf_ls_rxmt *
+ospf_ls_rxmt_find (struct ospf_neighbor *nbr, struct ospf_lsa *lsa)
+{
+  struct ospf_ls_rxmt key;
+
+  if (nbr->ls_rxmt.count == 0)
+    return NULL;
+
+  key.nbr = nbr;
+  key.lsa = lsa;
+  return hash_lookup (nbr->oi->ospf->ls_rxmt, &key);
+}
+
+static void
+ospf_ls_rxmt_free (struct ospf_ls_rxmt *rx)
+{
+  struct ospf_neighbor *nbr = rx->nbr;
+  struct ospf_lsa *lsa = rx->lsa;
+
+  lsa->retransmit_counter--;
+  if (IS_DEBUG_OSPF (lsa, LSA_FLOODING))		/* -- endo. */
+    zlog_debug ("RXmtL(%lu)--, NBR(%s), LSA[%s]",
+		ospf_ls_retransmit_count (nbr) - 1,
+		inet_ntoa (nbr->router_id), dump_lsa_key (lsa));
+
+  hash_release (nbr->oi->ospf->ls_rxmt, rx);
+  ilist_delete (&nbr->ls_rxmt, &rx->nbr_node);
+  ilist_delete (&lsa->rxmt, &rx->lsa_node);
+  ospf_lsa_unlock (&rx->lsa);
+  XFREE (MTYPE_OSPF_LS_RXMT, rx);
+}
+
 unsigned long
 ospf_ls_retransmit_count (struct ospf_neighbor *nbr)
 {
-  return ospf_lsdb_count_all (&nbr->ls_rxmt);
+  return nbr->ls_rxmt.count;
 }
 
 unsigned long
 ospf_ls_retransmit_count_self (struct ospf_neighbor *nbr, int lsa_type)
 {
-  return ospf_lsdb_count_self (&nbr->ls_rxmt, lsa_type);
+  struct ilistnode *node;
+  struct ospf_ls_rxmt *rx;
+  unsigned long count = 0;
+
+  for (ALL_ILIST_ELEMENTS_RO (&nbr->ls_rxmt, node, rx,
+			      struct ospf_ls_rxmt, nbr_node))
+    if (rx->lsa->data->type == lsa_type && IS_LSA_SELF (rx->lsa))
+      count++;
+
+  return count;
 }
 
 int
 ospf_ls_retransmit_isempty (struct ospf_neighbor *nbr)
 {
-  return ospf_lsdb_isempty (&nbr->ls_rxmt);
+  return nbr->ls_rxmt.count == 0;
 }
 
 /* Add LSA to be retransmitted to neighbor's ls-retransmit list. */
 void
 ospf_ls_retransmit_add (struct ospf_neighbor *nbr, struct ospf_lsa *lsa)
 {
-  struct ospf_lsa *old;
+  struct ospf_ls_rxmt *old, *rx;
 
-  old = ospf_ls_retransmit_lookup (nbr, lsa);
+  old = ospf_ls_rxmt_find (nbr, lsa);
 
-  if (ospf_lsa_more_recent (old, lsa) < 0)
+  if (ospf_lsa_more_recent (old ? old->lsa : NULL, lsa) < 0)
     {
       if (old)
-	{
-	  old->retransmit_counter--;
-	  ospf_lsdb_delete (&nbr->ls_rxmt, old);
-	}
+	ospf_ls_rxmt_free (old);
+
+      rx = XCALLOC (MTYPE_OSPF_LS_RXMT, sizeof (struct ospf_ls_rxmt));
+      rx->nbr = nbr;
+      rx->lsa = ospf_lsa_lock (lsa);
       lsa->retransmit_counter++;
       /*
        * We cannot make use of the newly introduced callback function
@@ -881,7 +969,9 @@ ospf_ls_retransmit_add (struct ospf_neighbor *nbr, struct ospf_lsa *lsa)
 	  zlog_debug ("RXmtL(%lu)++, NBR(%s), LSA[%s]",
                      ospf_ls_retransmit_count (nbr),
 		     inet_ntoa (nbr->router_id), dump_lsa_key (lsa));
-      ospf_lsdb_add (&nbr->ls_rxmt, lsa);
+      ilist_add (&nbr->ls_rxmt, &rx->nbr_node);
+      ilist_add (&lsa->rxmt, &rx->lsa_node);
+      hash_get (nbr->oi->ospf->ls_rxmt, rx, hash_alloc_intern);
     }
 }
 
@@ -889,36 +979,22 @@ ospf_ls_retransmit_add (struct ospf_neighbor *nbr, struct ospf_lsa *lsa)
 void
 ospf_ls_retransmit_delete (struct ospf_neighbor *nbr, struct ospf_lsa *lsa)
 {
-  if (ospf_ls_retransmit_lookup (nbr, lsa))
-    {
-      lsa->retransmit_counter--;  
-      if (IS_DEBUG_OSPF (lsa, LSA_FLOODING))		/* -- endo. */
-	  zlog_debug ("RXmtL(%lu)--, NBR(%s), LSA[%s]",
-                     ospf_ls_retransmit_count (nbr),
-		     inet_ntoa (nbr->router_id), dump_lsa_key (lsa));
-      ospf_lsdb_delete (&nbr->ls_rxmt, lsa);
-    }
+  struct ospf_ls_rxmt *rx;
+
+  if ((rx = ospf_ls_rxmt_find (nbr, lsa)) != NULL)
+    ospf_ls_rxmt_free (rx);
 }
 
 /* Clear neighbor's ls-retransmit list. */
 void
 ospf_ls_retransmit_clear (struct ospf_neighbor *nbr)
 {
-  struct ospf_lsdb *lsdb;
-  int i;
-
-  lsdb = &nbr->ls_rxmt;
-
-  for (i = OSPF_MIN_LSA; i < OSPF_MAX_LSA; i++)
-    {
-      struct route_table *table = lsdb->type[i].db;
-      struct route_node *rn;
-      struct ospf_lsa *lsa;
+  struct ilistnode *node, *nnode;
+  struct ospf_ls_rxmt *rx;
 
-      for (rn = route_top (table); rn; rn = route_next (rn))
-	if ((lsa = rn->info) != NULL)
-	  ospf_ls_retransmit_delete (nbr, lsa);
-    }
+  for (ALL_ILIST_ELEMENTS (&nbr->ls_rxmt, node, nnode, rx,
+			   struct ospf_ls_rxmt, nbr_node))
+    ospf_ls_rxmt_free (rx);
 
   ospf_lsa_unlock (&nbr->ls_req_last);
   nbr->ls_req_last = NULL;
@@ -928,52 +1004,38 @@ ospf_ls_retransmit_clear (struct ospf_neighbor *nbr)
 struct ospf_lsa *
 ospf_ls_retransmit_lookup (struct ospf_neighbor *nbr, struct ospf_lsa *lsa)
 {
-  return ospf_lsdb_lookup (&nbr->ls_rxmt, lsa);
+  struct ospf_ls_rxmt *rx = ospf_ls_rxmt_find (nbr, lsa);
+
+  return rx ? rx->lsa : NULL;
 }
 
+/* Remove this instance of the LSA from every neighbor's ls-retransmit
+   list it is on. */
 static void
-ospf_ls_retransmit_delete_nbr_if (struct ospf_interface *oi,
-				  struct ospf_lsa *lsa)
+ospf_ls_retransmit_delete_nbr_all (struct ospf_lsa *lsa)
 {
-  struct route_node *rn;
-  struct ospf_neighbor *nbr;
-  struct ospf_lsa *lsr;
+  struct ilistnode *node, *nnode;
+  struct ospf_ls_rxmt *rx;
 
-  if (ospf_if_is_enable (oi))
-    for (rn = route_top (oi->nbrs); rn; rn = route_next (rn))
-      /* If LSA find in LS-retransmit list, then remove it. */
-      if ((nbr = rn->info) != NULL)
-	{
-	  lsr = ospf_ls_retransmit_lookup (nbr, lsa);
-	     
-	  /* If LSA find in ls-retransmit list, remove it. */
-	  if (lsr != NULL && lsr->data->ls_seqnum == lsa->data->ls_seqnum)
-	    ospf_ls_retransmit_delete (nbr, lsr);
-	}
+  for (ALL_ILIST_ELEMENTS (&lsa->rxmt, node, nnode, rx,
+			   struct ospf_ls_rxmt, lsa_node))
+    ospf_ls_rxmt_free (rx);
 }
 
 void
 ospf_ls_retransmit_delete_nbr_area (struct ospf_area *area,
 				    struct ospf_lsa *lsa)
 {
-  struct listnode *node, *nnode;
-  struct ospf_interface *oi;
-
-  for (ALL_LIST_ELEMENTS (area->oiflist, node, nnode, oi))
-    ospf_ls_retransmit_delete_nbr_if (oi, lsa);
+  ospf_ls_retransmit_delete_nbr_all (lsa);
 }
 
 void
 ospf_ls_retransmit_delete_nbr_as (struct ospf *ospf, struct ospf_lsa *lsa)
 {
-  struct listnode *node, *nnode;
-  struct ospf_interface *oi;
-
-  for (ALL_LIST_ELEMENTS (ospf->oiflist, node, nnode, oi))
-    ospf_ls_retransmit_delete_nbr_if (oi, lsa);
+  ospf_ls_retransmit_delete_nbr_all (lsa);
 }
 
-
+
 /* Sets ls_age to MaxAge and floods throu the area. 
    When we implement ASE routing, there will be anothe function
    flushing an LSA from the whole domain. */
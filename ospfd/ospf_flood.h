@@ -23,6 +23,17 @@
 #ifndef _ZEBRA_OSPF_FLOOD_H
 #define _ZEBRA_OSPF_FLOOD_H
 
+/* An LSA instance waiting to be acknowledged by a neighbor. */
+struct ospf_ls_rxmt
+{
+  struct ospf_lsa *lsa;
+  struct ospf_neighbor *nbr;
+
+  /* On lsa->rxmt and on nbr->ls_rxmt. */
+  struct ilistnode lsa_node;
+  struct ilistnode nbr_node;
+};
+
 extern int ospf_flood (struct ospf *, struct ospf_neighbor *,
 		       struct ospf_lsa *, struct ospf_lsa *);
 extern int ospf_flood_through (struct ospf *, struct ospf_neighbor *,
@@ -44,6 +55,8 @@ extern void ospf_ls_request_delete_all (struct ospf_neighbor *);
 extern struct ospf_lsa *ospf_ls_request_lookup (struct ospf_neighbor *,
 						struct ospf_lsa *);
 
+extern void ospf_ls_rxmt_init (struct ospf *);
+extern void ospf_ls_rxmt_finish (struct ospf *);
 extern unsigned long ospf_ls_retransmit_count (struct ospf_neighbor *);
 extern unsigned long ospf_ls_retransmit_count_self (struct ospf_neighbor *,
 						    int);
@@ -44,6 +44,7 @@
 #include "ospfd/ospf_ase.h"
 #include "ospfd/ospf_abr.h"
 #include "ospfd/ospf_ia.h"
+#include "ospfd/ospf_zebra.h"
 #include "ospfd/ospf_dump.h"
 
 static struct ospf_route *
@@ -713,3 +714,203 @@ ospf_ia_routing (struct ospf *ospf,
         OSPF_EXAMINE_SUMMARIES_ALL (area, rt, rtrs);
     }
 }
+
+/* Process the summary-LSAs of LSDB_RT for prefix P only.  Their IDs all
+   fall within P, see RFC 2328 Appendix E. */
+static void
+ospf_examine_summaries_prefix (struct ospf_area *area,
+                               struct route_table *lsdb_rt,
+                               struct prefix_ipv4 *p,
+                               struct route_table *rt,
+                               struct route_table *rtrs)
+{
+  struct prefix_ls lp;
+  struct prefix_ipv4 q;
+  struct route_node *top, *rn;
+  struct summary_lsa *sl;
+  struct ospf_lsa *lsa;
+
+  memset (&lp, 0, sizeof (struct prefix_ls));
+  lp.prefixlen = p->prefixlen;
+  lp.id = p->prefix;
+
+  top = route_node_get (lsdb_rt, (struct prefix *) &lp);
+  route_lock_node (top);
+  for (rn = top; rn; rn = route_next_until (rn, top))
+    if ((lsa = rn->info))
+      {
+        sl = (struct summary_lsa *) lsa->data;
+        q.family = AF_INET;
+        q.prefix = sl->header.id;
+        if (sl->header.type == OSPF_SUMMARY_LSA)
+          q.prefixlen = ip_masklen (sl->mask);
+        else
+          q.prefixlen = IPV4_MAX_BITLEN;
+        apply_mask_ipv4 (&q);
+
+        if (prefix_same ((struct prefix *) &q, (struct prefix *) p))
+          process_summary_lsa (area, rt, rtrs, lsa);
+      }
+  route_unlock_node (top);
+}
+
+/* Recalculate the inter-area route to network P. */
+static void
+ospf_ia_network_update (struct ospf *ospf, struct prefix_ipv4 *p)
+{
+  struct route_table *tmp;
+  struct route_node *rn;
+  struct ospf_route *or = NULL, *new = NULL;
+  struct listnode *node;
+  struct ospf_area *area;
+  int changed;
+
+  /* Intra-area paths are always preferred. */
+  if ((rn = route_node_lookup (ospf->new_table, (struct prefix *) p)))
+    {
+      route_unlock_node (rn);
+      or = rn->info;
+      if (or && or->path_type != OSPF_PATH_INTER_AREA)
+        return;
+    }
+
+  tmp = route_table_init ();
+  for (ALL_LIST_ELEMENTS_RO (ospf->areas, node, area))
+    ospf_examine_summaries_prefix (area, SUMMARY_LSDB (area), p,
+                                   tmp, ospf->new_rtrs);
+  ospf_prune_unreachable_networks (tmp);
+
+  if ((rn = route_node_lookup (tmp, (struct prefix *) p)))
+    {
+      new = rn->info;
+      rn->info = NULL;
+      route_unlock_node (rn);
+      route_unlock_node (rn);
+    }
+  ospf_route_table_free (tmp);
+
+  if (new)
+    changed = ! ospf_route_match_same (ospf->new_table, p, new);
+  else
+    changed = (or != NULL);
+
+  if (IS_DEBUG_OSPF_EVENT)
+    zlog_debug ("%s: %s/%d %s", __func__, inet_ntoa (p->prefix),
+                p->prefixlen, changed ? "changed" : "unchanged");
+
+  if (changed)
+    {
+      if (new)
+        {
+          /* An external route to P gives way, as in ospf_route_install. */
+          if (ospf->old_external_route
+              && (rn = route_node_lookup (ospf->old_external_route,
+                                          (struct prefix *) p)))
+            {
+              if (rn->info)
+                {
+                  ospf_zebra_delete (p, rn->info);
+                  ospf_route_free (rn->info);
+                  rn->info = NULL;
+                  route_unlock_node (rn);
+                }
+              route_unlock_node (rn);
+            }
+          ospf_zebra_add (p, new);
+        }
+      else
+        ospf_zebra_delete (p, or);
+    }
+
+  rn = route_node_get (ospf->new_table, (struct prefix *) p);
+  if (rn->info)
+    {
+      ospf_route_free (rn->info);
+      route_unlock_node (rn);
+    }
+  rn->info = new;
+  if (new == NULL)
+    route_unlock_node (rn);
+
+  if (changed)
+    {
+      if (new == NULL)
+        ospf_ase_prefix_update (ospf, p);
+      ospf_ase_forward_update (ospf, p);
+    }
+}
+
+/* Recalculate the inter-area routes to AS boundary router P. */
+static void
+ospf_ia_router_update (struct ospf *ospf, struct prefix_ipv4 *p)
+{
+  struct route_node *rn;
+  struct ospf_route *or;
+  struct listnode *node, *nnode;
+  struct ospf_area *area;
+  struct list *or_list;
+
+  if ((rn = route_node_lookup (ospf->new_rtrs, (struct prefix *) p)))
+    {
+      route_unlock_node (rn);
+      if ((or_list = rn->info))
+        {
+          for (ALL_LIST_ELEMENTS (or_list, node, nnode, or))
+            if (or->path_type == OSPF_PATH_INTER_AREA)
+              {
+                listnode_delete (or_list, or);
+                ospf_route_free (or);
+              }
+          if (listcount (or_list) == 0)
+            {
+              list_delete (or_list);
+              rn->info = NULL;
+              route_unlock_node (rn);
+            }
+        }
+    }
+
+  for (ALL_LIST_ELEMENTS_RO (ospf->areas, node, area))
+    ospf_examine_summaries_prefix (area, ASBR_SUMMARY_LSDB (area), p,
+                                   ospf->new_table, ospf->new_rtrs);
+
+  ospf_ase_asbr_update (ospf, p->prefix);
+}
+
+/* Partial route calculation, RFC 2328 Section 16.5: a summary-LSA has
+   changed, so only the route to the destination it describes, and the
+   external routes depending on it, are recalculated.  An ABR also
+   bases its own summary-LSAs and transit area paths on these, so it
+   reruns the routing calculation, still over the kept trees. */
+void
+ospf_summary_incremental_update (struct ospf *ospf, struct ospf_lsa *lsa)
+{
+  struct summary_lsa *sl;
+  struct prefix_ipv4 p;
+
+  if (IS_OSPF_ABR (ospf) || !ospf->new_table || !ospf->new_rtrs)
+    {
+      ospf_spf_calculate_schedule_incremental (ospf);
+      return;
+    }
+
+  /* A pending calculation looks at all summary-LSAs anyway. */
+  if (ospf->t_spf_calc)
+    return;
+
+  sl = (struct summary_lsa *) lsa->data;
+  p.family = AF_INET;
+  p.prefix = sl->header.id;
+
+  if (sl->header.type == OSPF_SUMMARY_LSA)
+    {
+      p.prefixlen = ip_masklen (sl->mask);
+      apply_mask_ipv4 (&p);
+      ospf_ia_network_update (ospf, &p);
+    }
+  else
+    {
+      p.prefixlen = IPV4_MAX_BITLEN;
+      ospf_ia_router_update (ospf, &p);
+    }
+}
@@ -289,6 +289,12 @@ ospf_if_cleanup (struct ospf_interface *oi)
     ospf_lsa_unlock (&lsa); /* oi->ls_ack */
   list_delete_all_node (oi->ls_ack);
 
+  /* Drop direct acknowledgments still being coalesced. */
+  OSPF_TIMER_OFF (oi->t_ls_ack_direct);
+  for (ALL_LIST_ELEMENTS (oi->ls_ack_direct.ls_ack, node, nnode, lsa))
+    ospf_lsa_unlock (&lsa); /* oi->ls_ack_direct.ls_ack */
+  list_delete_all_node (oi->ls_ack_direct.ls_ack);
+
   oi->crypt_seqnum = 0;
   
   /* Empty link state update queue */
@@ -323,6 +329,9 @@ ospf_if_free (struct ospf_interface *oi)
   list_free (oi->ls_ack);
   list_free (oi->ls_ack_direct.ls_ack);
   
+  /* Nexthops of the kept shortest-path tree may point at us. */
+  ospf_spf_tree_free (oi->area);
+
   ospf_delete_from_if (oi->ifp, oi);
 
   listnode_delete (oi->ospf->oiflist, oi);
@@ -878,7 +887,6 @@ ospf_vl_new (struct ospf *ospf, struct ospf_vl_data *vl_data)
   vi = if_create (ifname, strnlen(ifname, sizeof(ifname)));
   co = connected_new ();
   co->ifp = vi;
-  listnode_add (vi->connected, co);
 
   p = prefix_ipv4_new ();
   p->family = AF_INET;
@@ -886,6 +894,7 @@ ospf_vl_new (struct ospf *ospf, struct ospf_vl_data *vl_data)
   p->prefixlen = 0;
  
   co->address = (struct prefix *)p;
+  connected_add (vi, co);
   
   voi = ospf_if_new (ospf, vi, co->address);
   if (voi == NULL)
@@ -1011,7 +1020,7 @@ ospf_vl_set_params (struct ospf_vl_data *vl_data, struct vertex *v)
 {
   int changed = 0;
   struct ospf_interface *voi;
-  struct listnode *node;
+  struct ilistnode *node;
   struct vertex_parent *vp = NULL;
   int i;
   struct router_lsa *rl;
@@ -1025,7 +1034,8 @@ ospf_vl_set_params (struct ospf_vl_data *vl_data, struct vertex *v)
       changed = 1;
     }
 
-  for (ALL_LIST_ELEMENTS_RO (v->parents, node, vp))
+  for (ALL_ILIST_ELEMENTS_RO (&v->parents, node, vp,
+			      struct vertex_parent, node))
     {
       vl_data->nexthop.oi = vp->nexthop->oi;
       vl_data->nexthop.router = vp->nexthop->router;
@@ -1204,9 +1214,21 @@ ospf_crypt_key_new ()
 void
 ospf_crypt_key_add (struct list *crypt, struct crypt_key *ck)
 {
+  if (ck->algo == OSPF_CRYPT_HMAC_SHA256)
+    HMAC_SHA256_Init (&ck->hmac, ck->auth_key,
+		      strlen ((char *) ck->auth_key));
   listnode_add (crypt, ck);
 }
 
+/* Authentication data length sent with the key; ck may be NULL. */
+unsigned int
+ospf_crypt_key_digest_size (struct crypt_key *ck)
+{
+  if (ck && ck->algo == OSPF_CRYPT_HMAC_SHA256)
+    return OSPF_AUTH_HMAC_SHA256_SIZE;
+  return OSPF_AUTH_MD5_SIZE;
+}
+
 struct crypt_key *
 ospf_crypt_key_lookup (struct list *auth_crypt, u_char key_id)
 {
@@ -23,6 +23,7 @@
 #ifndef _ZEBRA_OSPF_INTERFACE_H
 #define _ZEBRA_OSPF_INTERFACE_H
 
+#include "sha256.h"
 #include "ospfd/ospf_packet.h"
 #include "ospfd/ospf_spf.h"
 
@@ -112,10 +113,18 @@ struct ospf_vl_data
 
 #define OSPF_VL_FLAG_APPROVED 0x01
 
+/* Cryptographic authentication algorithms. */
+#define OSPF_CRYPT_MD5            0
+#define OSPF_CRYPT_HMAC_SHA256    1
+
 struct crypt_key
 {
   u_char key_id;
-  u_char auth_key[OSPF_AUTH_MD5_SIZE + 1];
+  u_char algo;
+  u_char auth_key[OSPF_AUTH_CRYPT_KEY_SIZE + 1];
+
+  /* HMAC hash states keyed once, when the key is added. */
+  HMAC_SHA256_CTX hmac;
 };
 
 /* OSPF interface structure. */
@@ -231,6 +240,8 @@ struct ospf_interface
   u_int32_t ls_upd_out;         /* LS update message output count. */
   u_int32_t ls_ack_in;          /* LS Ack message input count. */
   u_int32_t ls_ack_out;         /* LS Ack message output count. */
+  u_int32_t ls_upd_lsa_out;     /* LSAs in LS updates sent. */
+  u_int32_t ls_ack_lsa_out;     /* LSA headers in LS Acks sent. */
   u_int32_t discarded;		/* discarded input count by error. */
   u_int32_t state_change;	/* Number of status change. */
 
@@ -304,6 +315,7 @@ extern int ospf_vls_in_area (struct ospf_area *);
 extern struct crypt_key *ospf_crypt_key_lookup (struct list *, u_char);
 extern struct crypt_key *ospf_crypt_key_new (void);
 extern void ospf_crypt_key_add (struct list *, struct crypt_key *);
+extern unsigned int ospf_crypt_key_digest_size (struct crypt_key *);
 extern int ospf_crypt_key_delete (struct list *, u_char);
 
 extern u_char ospf_default_iftype (struct interface *ifp);
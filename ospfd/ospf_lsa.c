@@ -48,6 +48,7 @@
 #include "ospfd/ospf_dump.h"
 #include "ospfd/ospf_route.h"
 #include "ospfd/ospf_ase.h"
+#include "ospfd/ospf_ia.h"
 #include "ospfd/ospf_zebra.h"
 
 
@@ -220,6 +221,7 @@ ospf_lsa_new ()
   new->tv_recv = recent_relative_time ();
   new->tv_orig = new->tv_recv;
   new->refresh_list = -1;
+  new->expiry_index = -1;
   
   return new;
 }
@@ -239,6 +241,7 @@ ospf_lsa_dup (struct ospf_lsa *lsa)
   UNSET_FLAG (new->flags, OSPF_LSA_DISCARD);
   new->lock = 1;
   new->retransmit_counter = 0;
+  memset (&new->rxmt, 0, sizeof (struct ilist));
   new->data = ospf_lsa_data_dup (lsa->data);
 
   /* kevinm: Clear the refresh_list, otherwise there are going
@@ -246,6 +249,7 @@ ospf_lsa_dup (struct ospf_lsa *lsa)
      queue (which it's not a member of.)
      XXX: Should we add the LSA to the refresh_list queue? */
   new->refresh_list = -1;
+  new->expiry_index = -1;
 
   if (IS_DEBUG_OSPF (lsa, LSA))
     zlog_debug ("LSA: duplicated %p (new: %p)", lsa, new);
@@ -2400,7 +2404,7 @@ ospf_router_lsa_install (struct ospf *ospf, struct ospf_lsa *new,
       ospf_refresher_register_lsa (ospf, new);
     }
   if (rt_recalc)
-    ospf_spf_calculate_schedule (ospf);
+    ospf_spf_calculate_schedule_incremental (ospf);
 
   return new;
 }
@@ -2435,7 +2439,7 @@ ospf_network_lsa_install (struct ospf *ospf,
       ospf_refresher_register_lsa (ospf, new);
     }
   if (rt_recalc)
-    ospf_spf_calculate_schedule (ospf);
+    ospf_spf_calculate_schedule_incremental (ospf);
 
   return new;
 }
@@ -2454,15 +2458,10 @@ ospf_summary_lsa_install (struct ospf *ospf, struct ospf_lsa *new,
 	 necessary to re-examine all the AS-external-LSAs.
       */
 
-#if 0
-      /* This doesn't exist yet... */
-      ospf_summary_incremental_update(new); */
-#else /* #if 0 */
-      ospf_spf_calculate_schedule (ospf);
-#endif /* #if 0 */
+      ospf_summary_incremental_update (ospf, new);
  
       if (IS_DEBUG_OSPF (lsa, LSA_INSTALL))
-	zlog_debug ("ospf_summary_lsa_install(): SPF scheduled");
+	zlog_debug ("ospf_summary_lsa_install(): route recalculated");
     }
 
   if (IS_LSA_SELF (new))
@@ -2484,15 +2483,7 @@ ospf_summary_asbr_lsa_install (struct ospf *ospf, struct ospf_lsa *new,
 	 destination is an AS boundary router, it may also be
 	 necessary to re-examine all the AS-external-LSAs.
       */
-#if 0
-      /* These don't exist yet... */
-      ospf_summary_incremental_update(new);
-      /* Isn't this done by the above call? 
-	 - RFC 2328 Section 16.5 implies it should be */
-      /* ospf_ase_calculate_schedule(); */
-#else  /* #if 0 */
-      ospf_spf_calculate_schedule (ospf);
-#endif /* #if 0 */
+      ospf_summary_incremental_update (ospf, new);
     }
 
   /* register LSA to refresh-list. */
@@ -2697,6 +2688,12 @@ ospf_lsa_install (struct ospf *ospf, struct ospf_interface *oi,
         }
     }
 
+  /* Compare against the old instance while we still have it, to see
+     whether the shortest-path tree of the area survives. */
+  if (rt_recalc && (lsa->data->type == OSPF_ROUTER_LSA
+                    || lsa->data->type == OSPF_NETWORK_LSA))
+    ospf_spf_tree_check (lsa->area, old, lsa);
+
   /* discard old LSA from LSDB */
   if (old != NULL)
     ospf_discard_from_db (ospf, lsdb, lsa);
@@ -3003,6 +3000,10 @@ ospf_lsa_maxage_walker_remover (struct ospf *ospf, struct ospf_lsa *lsa)
           case OSPF_AS_NSSA_LSA:
 	    ospf_ase_incremental_update (ospf, lsa);
             break;
+          case OSPF_SUMMARY_LSA:
+          case OSPF_ASBR_SUMMARY_LSA:
+	    ospf_summary_incremental_update (ospf, lsa);
+            break;
           default:
 	    ospf_spf_calculate_schedule (ospf);
             break;
@@ -3017,48 +3018,52 @@ ospf_lsa_maxage_walker_remover (struct ospf *ospf, struct ospf_lsa *lsa)
   return 0;
 }
 
+/* Handle the LSAs of lsdb due to reach MaxAge by now.  Those not quite
+ * there yet, or which the walker is to leave alone, are requeued.
+ */
+static void
+ospf_lsa_maxage_walker_lsdb (struct ospf *ospf, struct ospf_lsdb *lsdb,
+			     time_t now)
+{
+  struct ospf_lsa *lsa;
+
+  while ((lsa = ospf_lsdb_expiry_pop (lsdb, now)) != NULL)
+    {
+      ospf->maxage_walker_seen++;
+
+      if (! IS_LSA_MAXAGE (lsa))
+	ospf_lsdb_expiry_requeue (lsdb, lsa, now + 1);
+      else if (CHECK_FLAG (lsa->flags, OSPF_LSA_LOCAL_XLT)
+	       || ospf_lsa_is_self_originated (ospf, lsa))
+	ospf_lsdb_expiry_requeue (lsdb, lsa,
+				  now + OSPF_LSA_MAXAGE_CHECK_INTERVAL);
+      else
+	{
+	  ospf->maxage_walker_aged++;
+	  ospf_lsa_maxage_walker_remover (ospf, lsa);
+	}
+    }
+}
+
 /* Periodical check of MaxAge LSA. */
 int
 ospf_lsa_maxage_walker (struct thread *thread)
 {
   struct ospf *ospf = THREAD_ARG (thread);
-  struct route_node *rn;
-  struct ospf_lsa *lsa;
   struct ospf_area *area;
   struct listnode *node, *nnode;
+  time_t now;
 
   ospf->t_maxage_walker = NULL;
+  ospf->maxage_walker_runs++;
+  now = recent_relative_time ().tv_sec;
 
   for (ALL_LIST_ELEMENTS (ospf->areas, node, nnode, area))
-    {
-      LSDB_LOOP (ROUTER_LSDB (area), rn, lsa)
-	ospf_lsa_maxage_walker_remover (ospf, lsa);
-      LSDB_LOOP (NETWORK_LSDB (area), rn, lsa)
-	ospf_lsa_maxage_walker_remover (ospf, lsa);
-      LSDB_LOOP (SUMMARY_LSDB (area), rn, lsa)
-	ospf_lsa_maxage_walker_remover (ospf, lsa);
-      LSDB_LOOP (ASBR_SUMMARY_LSDB (area), rn, lsa)
-	ospf_lsa_maxage_walker_remover (ospf, lsa);
-#ifdef HAVE_OPAQUE_LSA
-      LSDB_LOOP (OPAQUE_AREA_LSDB (area), rn, lsa)
-	ospf_lsa_maxage_walker_remover (ospf, lsa);
-      LSDB_LOOP (OPAQUE_LINK_LSDB (area), rn, lsa)
-	ospf_lsa_maxage_walker_remover (ospf, lsa);
-#endif /* HAVE_OPAQUE_LSA */
-      LSDB_LOOP (NSSA_LSDB (area), rn, lsa)
-        ospf_lsa_maxage_walker_remover (ospf, lsa);
-    }
+    ospf_lsa_maxage_walker_lsdb (ospf, area->lsdb, now);
 
   /* for AS-external-LSAs. */
   if (ospf->lsdb)
-    {
-      LSDB_LOOP (EXTERNAL_LSDB (ospf), rn, lsa)
-	ospf_lsa_maxage_walker_remover (ospf, lsa);
-#ifdef HAVE_OPAQUE_LSA
-      LSDB_LOOP (OPAQUE_AS_LSDB (ospf), rn, lsa)
-	ospf_lsa_maxage_walker_remover (ospf, lsa);
-#endif /* HAVE_OPAQUE_LSA */
-    }
+    ospf_lsa_maxage_walker_lsdb (ospf, ospf->lsdb, now);
 
   OSPF_TIMER_ON (ospf->t_maxage_walker, ospf_lsa_maxage_walker,
 		 OSPF_LSA_MAXAGE_CHECK_INTERVAL);
@@ -3131,22 +3136,12 @@ struct ospf_lsa *
 ospf_lsa_lookup_by_id (struct ospf_area *area, u_int32_t type, 
                        struct in_addr id)
 {
-  struct ospf_lsa *lsa;
-  struct route_node *rn;
-
   switch (type)
     {
     case OSPF_ROUTER_LSA:
       return ospf_lsdb_lookup_by_id (area->lsdb, type, id, id);
     case OSPF_NETWORK_LSA:
-      for (rn = route_top (NETWORK_LSDB (area)); rn; rn = route_next (rn))
-	if ((lsa = rn->info))
-	  if (IPV4_ADDR_SAME (&lsa->data->id, &id))
-	    {
-	      route_unlock_node (rn);
-	      return lsa;
-	    }
-      break;
+      return ospf_lsdb_lookup_by_ls_id (area->lsdb, type, id);
     case OSPF_SUMMARY_LSA:
     case OSPF_ASBR_SUMMARY_LSA:
       /* Currently not used. */
@@ -3685,7 +3680,13 @@ ospf_refresher_unregister_lsa (struct ospf *ospf, struct ospf_lsa *lsa)
 {
   assert (lsa->lock > 0);
   assert (IS_LSA_SELF (lsa));
-  if (lsa->refresh_list >= 0)
+  if (lsa->refresh_list == OSPF_LSA_REFRESH_BACKLOG)
+    {
+      listnode_delete (ospf->lsa_refresh_backlog, lsa);
+      ospf_lsa_unlock (&lsa); /* lsa_refresh_backlog */
+      lsa->refresh_list = -1;
+    }
+  else if (lsa->refresh_list >= 0)
     {
       struct list *refresh_list = ospf->lsa_refresh_queue.qs[lsa->refresh_list];
       listnode_delete (refresh_list, lsa);
@@ -3699,6 +3700,48 @@ ospf_refresher_unregister_lsa (struct ospf *ospf, struct ospf_lsa *lsa)
     }
 }
 
+/* Refresh up to max LSAs off the backlog, all of them if max is 0. */
+static void
+ospf_lsa_refresh_backlog (struct ospf *ospf, unsigned int max)
+{
+  struct listnode *node;
+  struct ospf_lsa *lsa;
+  unsigned int n;
+
+  for (n = 0; (max == 0 || n < max)
+	      && (node = listhead (ospf->lsa_refresh_backlog)); n++)
+    {
+      lsa = listgetdata (node);
+      list_delete_node (ospf->lsa_refresh_backlog, node);
+      lsa->refresh_list = -1;
+
+      ospf_lsa_refresh (ospf, lsa);
+      assert (lsa->lock > 0);
+      ospf_lsa_unlock (&lsa); /* lsa_refresh_backlog */
+    }
+}
+
+/* Spread the refreshes of the backlog at lsa_refresh_rate a second, so
+ * that the LSAs to flood each time fit a few LS Updates rather than
+ * thousands of LSAs going out at once.
+ */
+static int
+ospf_lsa_refresh_pace (struct thread *t)
+{
+  struct ospf *ospf = THREAD_ARG (t);
+
+  ospf->t_lsa_refresh_pace = NULL;
+
+  ospf_lsa_refresh_backlog (ospf, (ospf->lsa_refresh_rate
+				   * OSPF_LSA_REFRESH_PACE_MSEC + 999) / 1000);
+
+  if (listcount (ospf->lsa_refresh_backlog))
+    ospf->t_lsa_refresh_pace =
+      thread_add_timer_msec (master, ospf_lsa_refresh_pace, ospf,
+			     OSPF_LSA_REFRESH_PACE_MSEC);
+  return 0;
+}
+
 int
 ospf_lsa_refresh_walker (struct thread *t)
 {
@@ -3707,7 +3750,6 @@ ospf_lsa_refresh_walker (struct thread *t)
   struct ospf *ospf = THREAD_ARG (t);
   struct ospf_lsa *lsa;
   int i;
-  struct list *lsa_to_refresh = list_new ();
 
   if (IS_DEBUG_OSPF (lsa, LSA_REFRESH))
     zlog_debug ("LSA[Refresh]:ospf_lsa_refresh_walker(): start");
@@ -3752,8 +3794,8 @@ ospf_lsa_refresh_walker (struct thread *t)
 	      
 	      assert (lsa->lock > 0);
 	      list_delete_node (refresh_list, node);
-	      lsa->refresh_list = -1;
-	      listnode_add (lsa_to_refresh, lsa);
+	      lsa->refresh_list = OSPF_LSA_REFRESH_BACKLOG;
+	      listnode_add (ospf->lsa_refresh_backlog, lsa);
 	    }
 	  list_free (refresh_list);
 	}
@@ -3763,15 +3805,13 @@ ospf_lsa_refresh_walker (struct thread *t)
 					   ospf, ospf->lsa_refresh_interval);
   ospf->lsa_refresher_started = quagga_time (NULL);
 
-  for (ALL_LIST_ELEMENTS (lsa_to_refresh, node, nnode, lsa))
-    {
-      ospf_lsa_refresh (ospf, lsa);
-      assert (lsa->lock > 0);
-      ospf_lsa_unlock (&lsa); /* lsa_refresh_queue & temp for lsa_to_refresh*/
-    }
-  
-  list_delete (lsa_to_refresh);
-  
+  if (ospf->lsa_refresh_rate == 0)
+    ospf_lsa_refresh_backlog (ospf, 0);
+  else if (ospf->t_lsa_refresh_pace == NULL
+	   && listcount (ospf->lsa_refresh_backlog))
+    ospf->t_lsa_refresh_pace =
+      thread_add_event (master, ospf_lsa_refresh_pace, ospf, 0);
+
   if (IS_DEBUG_OSPF (lsa, LSA_REFRESH))
     zlog_debug ("LSA[Refresh]: ospf_lsa_refresh_walker(): end");
   
@@ -101,8 +101,12 @@ struct ospf_lsa
   #define LSA_SPF_IN_SPFTREE	-2
   /* If stat >= 0, stat is LSA position in candidates heap. */
   
+  /* When the LSA was added to its LSDB, see ospf_lsdb_add. */
+  unsigned long lsdb_seq;
+
   /* References to this LSA in neighbor retransmission lists*/
   int retransmit_counter;
+  struct ilist rxmt;			/* struct ospf_ls_rxmt */
 
   /* Area the LSA belongs to, may be NULL if AS-external-LSA. */
   struct ospf_area *area;
@@ -115,6 +119,11 @@ struct ospf_lsa
 
   /* Refreshement List or Queue */
   int refresh_list;
+
+  /* Position in the expiry heap of the LSDB, or -1 if not queued. */
+  int expiry_index;
+  /* Relative time at which the LSA is due to reach MaxAge. */
+  time_t expiry;
   
   /* For Type-9 Opaque-LSAs */
   struct ospf_interface *oi;
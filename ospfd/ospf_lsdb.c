@@ -26,12 +26,19 @@
 #include "table.h"
 #include "memory.h"
 #include "log.h"
+#include "hash.h"
+#include "jhash.h"
+#include "pqueue.h"
 
 #include "ospfd/ospfd.h"
 #include "ospfd/ospf_asbr.h"
 #include "ospfd/ospf_lsa.h"
 #include "ospfd/ospf_lsdb.h"
 
+/* Counts additions to any LSDB, so a walk can tell the LSAs added
+   since it started. */
+static unsigned long ospf_lsdb_seq;
+
 struct ospf_lsdb *
 ospf_lsdb_new ()
 {
@@ -43,13 +50,56 @@ ospf_lsdb_new ()
   return new;
 }
 
+static unsigned int
+ospf_lsdb_hash_key (void *arg)
+{
+  struct ospf_lsa *lsa = arg;
+
+  return jhash_2words (lsa->data->id.s_addr, lsa->data->adv_router.s_addr, 0);
+}
+
+static int
+ospf_lsdb_hash_cmp (const void *arg1, const void *arg2)
+{
+  const struct ospf_lsa *lsa1 = arg1;
+  const struct ospf_lsa *lsa2 = arg2;
+
+  return (IPV4_ADDR_SAME (&lsa1->data->id, &lsa2->data->id)
+	  && IPV4_ADDR_SAME (&lsa1->data->adv_router, &lsa2->data->adv_router));
+}
+
+static unsigned int
+ospf_lsdb_id_hash_key (void *arg)
+{
+  struct ospf_lsa *lsa = arg;
+
+  return jhash_1word (lsa->data->id.s_addr, 0);
+}
+
+static int
+ospf_lsdb_id_hash_cmp (const void *arg1, const void *arg2)
+{
+  const struct ospf_lsa *lsa1 = arg1;
+  const struct ospf_lsa *lsa2 = arg2;
+
+  return IPV4_ADDR_SAME (&lsa1->data->id, &lsa2->data->id);
+}
+
 void
 ospf_lsdb_init (struct ospf_lsdb *lsdb)
 {
   int i;
   
   for (i = OSPF_MIN_LSA; i < OSPF_MAX_LSA; i++)
-    lsdb->type[i].db = route_table_init ();
+    {
+      lsdb->type[i].db = route_table_init ();
+      lsdb->type[i].index = hash_create_open (0, ospf_lsdb_hash_key,
+					      ospf_lsdb_hash_cmp);
+    }
+
+  /* Network-LSAs are looked up by ID alone, see ospf_lsa_lookup_by_id. */
+  lsdb->type[OSPF_NETWORK_LSA].id_index =
+    hash_create_open (0, ospf_lsdb_id_hash_key, ospf_lsdb_id_hash_cmp);
 }
 
 void
@@ -69,7 +119,101 @@ ospf_lsdb_cleanup (struct ospf_lsdb *lsdb)
   ospf_lsdb_delete_all (lsdb);
   
   for (i = OSPF_MIN_LSA; i < OSPF_MAX_LSA; i++)
-    route_table_finish (lsdb->type[i].db);
+    {
+      route_table_finish (lsdb->type[i].db);
+      hash_free (lsdb->type[i].index);
+      if (lsdb->type[i].id_index)
+	hash_free (lsdb->type[i].id_index);
+      lsdb->type[i].id_index = NULL;
+    }
+
+  if (lsdb->expiry)
+    {
+      pqueue_delete (lsdb->expiry);
+      lsdb->expiry = NULL;
+    }
+}
+
+static int
+ospf_lsdb_expiry_cmp (void *arg1, void *arg2)
+{
+  struct ospf_lsa *lsa1 = arg1;
+  struct ospf_lsa *lsa2 = arg2;
+
+  if (lsa1->expiry != lsa2->expiry)
+    return lsa1->expiry < lsa2->expiry ? -1 : 1;
+  return 0;
+}
+
+static void
+ospf_lsdb_expiry_update (void *node, int pos)
+{
+  struct ospf_lsa *lsa = node;
+
+  lsa->expiry_index = pos;
+}
+
+/* Keep the LSAs of lsdb by expiry as well, for the MaxAge walker. */
+void
+ospf_lsdb_expiry_init (struct ospf_lsdb *lsdb)
+{
+  lsdb->expiry = pqueue_create ();
+  lsdb->expiry->cmp = ospf_lsdb_expiry_cmp;
+  lsdb->expiry->update = ospf_lsdb_expiry_update;
+}
+
+static void
+ospf_lsdb_expiry_add (struct ospf_lsdb *lsdb, struct ospf_lsa *lsa)
+{
+  int age = ntohs (lsa->data->ls_age);
+
+  if (lsdb->expiry == NULL || lsa->expiry_index >= 0)
+    return;
+
+  if (age > OSPF_LSA_MAXAGE)
+    age = OSPF_LSA_MAXAGE;
+  lsa->expiry = lsa->tv_recv.tv_sec + OSPF_LSA_MAXAGE - age;
+  pqueue_enqueue (lsa, lsdb->expiry);
+}
+
+static void
+ospf_lsdb_expiry_delete (struct ospf_lsdb *lsdb, struct ospf_lsa *lsa)
+{
+  if (lsdb->expiry == NULL || lsa->expiry_index < 0)
+    return;
+
+  pqueue_remove_at (lsa->expiry_index, lsdb->expiry);
+  lsa->expiry_index = -1;
+}
+
+/* Dequeue the next LSA due to reach MaxAge by now, if any.  It stays in
+ * the LSDB; it is up to the caller to requeue it if it has to be seen
+ * again.
+ */
+struct ospf_lsa *
+ospf_lsdb_expiry_pop (struct ospf_lsdb *lsdb, time_t now)
+{
+  struct ospf_lsa *lsa;
+
+  if (lsdb->expiry == NULL || lsdb->expiry->size == 0)
+    return NULL;
+
+  lsa = lsdb->expiry->array[0];
+  if (lsa->expiry > now)
+    return NULL;
+
+  pqueue_dequeue (lsdb->expiry);
+  lsa->expiry_index = -1;
+  return lsa;
+}
+
+void
+ospf_lsdb_expiry_requeue (struct ospf_lsdb *lsdb, struct ospf_lsa *lsa,
+			  time_t when)
+{
+  ospf_lsdb_expiry_delete (lsdb, lsa);
+  lsa->expiry = when;
+  pqueue_enqueue (lsa, lsdb->expiry);
 }
 
 void
@@ -84,6 +228,54 @@ ls_prefix_set (struct prefix_ls *lp, struct ospf_lsa *lsa)
     }
 }
 
+/* Index an LSA by ID, unless one of lower advertising router is. */
+static void
+ospf_lsdb_id_index_add (struct hash *id_index, struct ospf_lsa *lsa)
+{
+  struct ospf_lsa *find;
+
+  find = hash_get (id_index, lsa, hash_alloc_intern);
+  if (find != lsa
+      && ntohl (lsa->data->adv_router.s_addr)
+	 < ntohl (find->data->adv_router.s_addr))
+    {
+      hash_release (id_index, find);
+      hash_get (id_index, lsa, hash_alloc_intern);
+    }
+}
+
+/* Unindex an LSA by ID, indexing the LSA of next lowest advertising
+ * router instead.  Those follow the node of the LSA in the table, which
+ * no longer has it as info.
+ */
+static void
+ospf_lsdb_id_index_delete (struct hash *id_index, struct route_node *rn,
+			   struct ospf_lsa *lsa)
+{
+  struct route_node *next;
+
+  if (hash_lookup (id_index, lsa) != lsa)
+    return;
+  hash_release (id_index, lsa);
+
+  for (next = route_next (route_lock_node (rn)); next;
+       next = route_next (next))
+    {
+      if (next->p.prefixlen < IPV4_MAX_BITLEN
+	  || ! IPV4_ADDR_SAME (&next->p.u.prefix4, &lsa->data->id))
+	{
+	  route_unlock_node (next);
+	  break;
+	}
+      if (next->info)
+	{
+	  hash_get (id_index, next->info, hash_alloc_intern);
+	  route_unlock_node (next);
+	  break;
+	}
+    }
+}
+
 static void
 ospf_lsdb_delete_entry (struct ospf_lsdb *lsdb, struct route_node *rn)
 {
@@ -99,7 +291,11 @@ ospf_lsdb_delete_entry (struct ospf_lsdb *lsdb, struct route_node *rn)
   lsdb->type[lsa->data->type].count--;
   lsdb->type[lsa->data->type].checksum -= ntohs(lsa->data->checksum);
   lsdb->total--;
+  ospf_lsdb_expiry_delete (lsdb, lsa);
   rn->info = NULL;
+  hash_release (lsdb->type[lsa->data->type].index, lsa);
+  if (lsdb->type[lsa->data->type].id_index)
+    ospf_lsdb_id_index_delete (lsdb->type[lsa->data->type].id_index, rn, lsa);
   route_unlock_node (rn);
 #ifdef MONITOR_LSDB_CHANGE
   if (lsdb->del_lsa_hook != NULL)
@@ -143,6 +339,11 @@ ospf_lsdb_add (struct ospf_lsdb *lsdb, struct ospf_lsa *lsa)
 #endif /* MONITOR_LSDB_CHANGE */
   lsdb->type[lsa->data->type].checksum += ntohs(lsa->data->checksum);
   rn->info = ospf_lsa_lock (lsa); /* lsdb */
+  lsa->lsdb_seq = ++ospf_lsdb_seq;
+  hash_get (lsdb->type[lsa->data->type].index, lsa, hash_alloc_intern);
+  if (lsdb->type[lsa->data->type].id_index)
+    ospf_lsdb_id_index_add (lsdb->type[lsa->data->type].id_index, lsa);
+  ospf_lsdb_expiry_add (lsdb, lsa);
 }
 
 void
@@ -215,47 +416,49 @@ ospf_lsdb_clean_stat (struct ospf_lsdb *lsdb)
 struct ospf_lsa *
 ospf_lsdb_lookup (struct ospf_lsdb *lsdb, struct ospf_lsa *lsa)
 {
-  struct route_table *table;
-  struct prefix_ls lp;
-  struct route_node *rn;
-  struct ospf_lsa *find;
-
-  table = lsdb->type[lsa->data->type].db;
-  ls_prefix_set (&lp, lsa);
-  rn = route_node_lookup (table, (struct prefix *) &lp);
-  if (rn)
-    {
-      find = rn->info;
-      route_unlock_node (rn);
-      return find;
-    }
-  return NULL;
+  return hash_lookup (lsdb->type[lsa->data->type].index, lsa);
 }
 
 struct ospf_lsa *
 ospf_lsdb_lookup_by_id (struct ospf_lsdb *lsdb, u_char type,
 		       struct in_addr id, struct in_addr adv_router)
 {
-  struct route_table *table;
-  struct prefix_ls lp;
-  struct route_node *rn;
-  struct ospf_lsa *find;
+  struct lsa_header lsah;
+  struct ospf_lsa key;
 
-  table = lsdb->type[type].db;
+  lsah.id = id;
+  lsah.adv_router = adv_router;
+  key.data = &lsah;
 
-  memset (&lp, 0, sizeof (struct prefix_ls));
-  lp.family = 0;
-  lp.prefixlen = 64;
-  lp.id = id;
-  lp.adv_router = adv_router;
+  return hash_lookup (lsdb->type[type].index, &key);
+}
+
+/* Look up an LSA by ID alone.  If several advertising routers have one
+ * with the ID, that of the lowest is returned.
+ */
+struct ospf_lsa *
+ospf_lsdb_lookup_by_ls_id (struct ospf_lsdb *lsdb, u_char type,
+			   struct in_addr id)
+{
+  struct lsa_header lsah;
+  struct ospf_lsa key;
+  struct route_node *rn;
+  struct ospf_lsa *lsa;
 
-  rn = route_node_lookup (table, (struct prefix *) &lp);
-  if (rn)
+  if (lsdb->type[type].id_index)
     {
-      find = rn->info;
-      route_unlock_node (rn);
-      return find;
+      lsah.id = id;
+      key.data = &lsah;
+      return hash_lookup (lsdb->type[type].id_index, &key);
     }
+
+  for (rn = route_top (lsdb->type[type].db); rn; rn = route_next (rn))
+    if ((lsa = rn->info))
+      if (IPV4_ADDR_SAME (&lsa->data->id, &id))
+	{
+	  route_unlock_node (rn);
+	  return lsa;
+	}
   return NULL;
 }
 
@@ -299,6 +502,12 @@ ospf_lsdb_lookup_by_id_next (struct ospf_lsdb *lsdb, u_char type,
   return NULL;
 }
 
+unsigned long
+ospf_lsdb_seq_current (void)
+{
+  return ospf_lsdb_seq;
+}
+
 unsigned long
 ospf_lsdb_count_all (struct ospf_lsdb *lsdb)
 {
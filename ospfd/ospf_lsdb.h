@@ -32,8 +32,14 @@ struct ospf_lsdb
     unsigned long count_self;
     unsigned int checksum;
     struct route_table *db;
+    /* The LSAs of db by ID and advertising router. */
+    struct hash *index;
+    /* For network-LSAs, those of lowest advertising router by ID. */
+    struct hash *id_index;
   } type[OSPF_MAX_LSA];
   unsigned long total;
+  /* LSAs by the time they reach MaxAge, for the area and AS LSDBs. */
+  struct pqueue *expiry;
 #define MONITOR_LSDB_CHANGE 1 /* XXX */
 #ifdef MONITOR_LSDB_CHANGE
   /* Hooks for callback functions to catch every add/del event. */
@@ -66,6 +72,10 @@ extern struct ospf_lsdb *ospf_lsdb_new (void);
 extern void ospf_lsdb_init (struct ospf_lsdb *);
 extern void ospf_lsdb_free (struct ospf_lsdb *);
 extern void ospf_lsdb_cleanup (struct ospf_lsdb *);
+extern void ospf_lsdb_expiry_init (struct ospf_lsdb *);
+extern struct ospf_lsa *ospf_lsdb_expiry_pop (struct ospf_lsdb *, time_t);
+extern void ospf_lsdb_expiry_requeue (struct ospf_lsdb *, struct ospf_lsa *,
+				      time_t);
 extern void ls_prefix_set (struct prefix_ls *lp, struct ospf_lsa *lsa);
 extern void ospf_lsdb_add (struct ospf_lsdb *, struct ospf_lsa *);
 extern void ospf_lsdb_delete (struct ospf_lsdb *, struct ospf_lsa *);
@@ -75,9 +85,12 @@ extern void ospf_lsdb_clean_stat (struct ospf_lsdb *lsdb);
 extern struct ospf_lsa *ospf_lsdb_lookup (struct ospf_lsdb *, struct ospf_lsa *);
 extern struct ospf_lsa *ospf_lsdb_lookup_by_id (struct ospf_lsdb *, u_char,
 					struct in_addr, struct in_addr);
+extern struct ospf_lsa *ospf_lsdb_lookup_by_ls_id (struct ospf_lsdb *, u_char,
+					           struct in_addr);
 extern struct ospf_lsa *ospf_lsdb_lookup_by_id_next (struct ospf_lsdb *, u_char,
 					     struct in_addr, struct in_addr,
 					     int);
+extern unsigned long ospf_lsdb_seq_current (void);
 extern unsigned long ospf_lsdb_count_all (struct ospf_lsdb *);
 extern unsigned long ospf_lsdb_count (struct ospf_lsdb *, int);
 extern unsigned long ospf_lsdb_count_self (struct ospf_lsdb *, int);
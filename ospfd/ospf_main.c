@@ -49,6 +49,7 @@
 #include "ospfd/ospf_dump.h"
 #include "ospfd/ospf_zebra.h"
 #include "ospfd/ospf_vty.h"
+#include "ospfd/ospf_spf.h"
 
 /* ospfd privileges */
 zebra_capabilities_t _caps_p [] = 
@@ -89,6 +90,7 @@ struct option longopts[] =
   { "user",        required_argument, NULL, 'u'},
   { "group",       required_argument, NULL, 'g'},
   { "apiserver",   no_argument,       NULL, 'a'},
+  { "spf-threads", required_argument, NULL, 't'},
   { "version",     no_argument,       NULL, 'v'},
   { 0 }
 };
@@ -124,6 +126,7 @@ Daemon which manages OSPF.\n\n\
 -u, --user         User to run as\n\
 -g, --group        Group to run as\n\
 -a. --apiserver    Enable OSPF apiserver\n\
+-t, --spf-threads  Calculate areas' SPF on this many extra threads\n\
 -v, --version      Print program version\n\
 -C, --dryrun       Check configuration for validity and exit\n\
 -h, --help         Display this help and exit\n\
@@ -203,7 +206,7 @@ main (int argc, char **argv)
     {
       int opt;
 
-      opt = getopt_long (argc, argv, "df:i:z:hA:P:u:g:avC", longopts, 0);
+      opt = getopt_long (argc, argv, "df:i:z:hA:P:u:g:avCt:", longopts, 0);
     
       if (opt == EOF)
 	break;
@@ -250,6 +253,11 @@ main (int argc, char **argv)
 	  ospf_apiserver_enable = 1;
 	  break;
 #endif /* SUPPORT_OSPF_API */
+	case 't':
+	  ospf_spf_threads = atoi (optarg);
+	  if (ospf_spf_threads > 64)
+	    ospf_spf_threads = 64;
+	  break;
 	case 'v':
 	  print_version (progname);
 	  exit (0);
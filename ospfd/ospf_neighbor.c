@@ -92,8 +92,6 @@ ospf_nbr_new (struct ospf_interface *oi)
 
   nbr->nbr_nbma = NULL;
 
-  ospf_lsdb_init (&nbr->db_sum);
-  ospf_lsdb_init (&nbr->ls_rxmt);
   ospf_lsdb_init (&nbr->ls_req);
 
   nbr->crypt_seqnum = 0;
@@ -105,9 +103,7 @@ void
 ospf_nbr_free (struct ospf_neighbor *nbr)
 {
   /* Free DB summary list. */
-  if (ospf_db_summary_count (nbr))
-    ospf_db_summary_clear (nbr);
-    /* ospf_db_summary_delete_all (nbr); */
+  ospf_db_summary_clear (nbr);
 
   /* Free ls request list. */
   if (ospf_ls_request_count (nbr))
@@ -118,9 +114,7 @@ ospf_nbr_free (struct ospf_neighbor *nbr)
     ospf_ls_retransmit_clear (nbr);
 
   /* Cleanup LSDBs. */
-  ospf_lsdb_cleanup (&nbr->db_sum);
   ospf_lsdb_cleanup (&nbr->ls_req);
-  ospf_lsdb_cleanup (&nbr->ls_rxmt);
   
   /* Clear last send packet. */
   if (nbr->last_send)
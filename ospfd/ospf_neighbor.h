@@ -25,6 +25,25 @@
 
 #include <ospfd/ospf_packet.h>
 
+/* Database summary list of a neighbor, walked from the area and AS
+   LSDBs as the DD packets are made rather than copied from them. */
+struct ospf_db_summary
+{
+  /* LSA type and LSDB node next described, type 0 when empty. */
+  int type;
+  struct route_node *rn;
+
+  /* LSDB additions up to here were in the database when the exchange
+     started; those after were flooded to the neighbor instead. */
+  unsigned long lsdb_seq;
+
+  /* LSAs left to walk, for display. */
+  unsigned long count;
+
+  /* LSAs ahead of rn the neighbor has already described to us. */
+  struct hash *skip;
+};
+
 /* Neighbor Data Structure */
 struct ospf_neighbor
 {
@@ -60,8 +79,8 @@ struct ospf_neighbor
   } last_recv;
 
   /* LSA data. */
-  struct ospf_lsdb ls_rxmt;
-  struct ospf_lsdb db_sum;
+  struct ilist ls_rxmt;			/* struct ospf_ls_rxmt */
+  struct ospf_db_summary db_sum;
   struct ospf_lsdb ls_req;
   struct ospf_lsa *ls_req_last;
 
@@ -33,6 +33,7 @@
 #include "stream.h"
 #include "table.h"
 #include "log.h"
+#include "jhash.h"
 
 #include "ospfd/ospfd.h"
 #include "ospfd/ospf_interface.h"
@@ -193,39 +194,112 @@ nsm_twoway_received (struct ospf_neighbor *nbr)
   return (nsm_should_adj (nbr) ? NSM_ExStart : NSM_TwoWay);
 }
 
-int
-ospf_db_summary_count (struct ospf_neighbor *nbr)
-{
-  return ospf_lsdb_count_all (&nbr->db_sum);
-}
+/* The LSDB of an LSA type in the Database summary list of nbr.
 
-int
-ospf_db_summary_isempty (struct ospf_neighbor *nbr)
+   The area link state database consists of the router-LSAs,
+   network-LSAs and summary-LSAs contained in the area structure,
+   along with the AS-external-LSAs contained in the global structure.
+   AS-external-LSAs are omitted from a virtual neighbor's Database
+   summary list.  AS-external-LSAs are omitted from the Database
+   summary list if the area has been configured as a stub. */
+static struct ospf_lsdb *
+ospf_db_summary_lsdb (struct ospf_neighbor *nbr, int type)
 {
-  return ospf_lsdb_isempty (&nbr->db_sum);
-}
+  struct ospf_area *area = nbr->oi->area;
+  int external = (nbr->oi->type != OSPF_IFTYPE_VIRTUALLINK
+		  && area->external_routing == OSPF_AREA_DEFAULT);
 
-static int
-ospf_db_summary_add (struct ospf_neighbor *nbr, struct ospf_lsa *lsa)
-{
-#ifdef HAVE_OPAQUE_LSA
-  switch (lsa->data->type)
+  switch (type)
     {
-    case OSPF_OPAQUE_LINK_LSA:
-      /* Exclude type-9 LSAs that does not have the same "oi" with "nbr". */
-      if (nbr->oi && ospf_if_exists (lsa->oi) != nbr->oi)
-          return 0;
+    case OSPF_ROUTER_LSA:
+    case OSPF_NETWORK_LSA:
+    case OSPF_SUMMARY_LSA:
+    case OSPF_ASBR_SUMMARY_LSA:
+      return area->lsdb;
+    case OSPF_AS_NSSA_LSA:
+      if (CHECK_FLAG (nbr->options, OSPF_OPTION_NP))
+	return area->lsdb;
       break;
+    case OSPF_AS_EXTERNAL_LSA:
+      if (external)
+	return nbr->oi->ospf->lsdb;
+      break;
+#ifdef HAVE_OPAQUE_LSA
+    /* Process only if the neighbor is opaque capable. */
+    case OSPF_OPAQUE_LINK_LSA:
     case OSPF_OPAQUE_AREA_LSA:
-      /*
-       * It is assured by the caller function "nsm_negotiation_done()"
-       * that every given LSA belongs to the same area with "nbr".
-       */
+      if (CHECK_FLAG (nbr->options, OSPF_OPTION_O))
+	return area->lsdb;
       break;
     case OSPF_OPAQUE_AS_LSA:
-    default:
+      if (external && CHECK_FLAG (nbr->options, OSPF_OPTION_O))
+	return nbr->oi->ospf->lsdb;
       break;
+#endif /* HAVE_OPAQUE_LSA */
+    }
+
+  return NULL;
+}
+
+static unsigned int
+ospf_db_summary_skip_key (void *arg)
+{
+  return jhash_1word ((u_int32_t) (uintptr_t) arg, 0);
+}
+
+static int
+ospf_db_summary_skip_cmp (const void *arg1, const void *arg2)
+{
+  return arg1 == arg2;
+}
+
+static void
+ospf_db_summary_skip_free (void *arg)
+{
+  struct ospf_lsa *lsa = arg;
+
+  ospf_lsa_unlock (&lsa);
+}
+
+/* Whether the walk has gone past lsa. */
+static int
+ospf_db_summary_passed (struct ospf_neighbor *nbr, struct ospf_lsa *lsa)
+{
+  struct prefix_ls lp;
+
+  if (lsa->data->type != nbr->db_sum.type)
+    return lsa->data->type < nbr->db_sum.type;
+
+  ls_prefix_set (&lp, lsa);
+  return memcmp (&lp.id, &((struct prefix_ls *) &nbr->db_sum.rn->p)->id,
+		 2 * sizeof (struct in_addr)) < 0;
+}
+
+/* Whether lsa, met by the walk, is described to the neighbor. */
+static int
+ospf_db_summary_wanted (struct ospf_neighbor *nbr, struct ospf_lsa *lsa)
+{
+  struct ospf_lsa *skip;
+
+  /* The neighbor has described this instance, or a more recent one. */
+  if (nbr->db_sum.skip
+      && (skip = hash_release (nbr->db_sum.skip, lsa)) != NULL)
+    {
+      ospf_lsa_unlock (&skip);
+      return 0;
     }
+
+  /* Installed since the exchange started, and so flooded to the
+     neighbor instead. */
+  if (lsa->lsdb_seq > nbr->db_sum.lsdb_seq
+      || CHECK_FLAG (lsa->flags, OSPF_LSA_DISCARD))
+    return 0;
+
+#ifdef HAVE_OPAQUE_LSA
+  /* Exclude type-9 LSAs that does not have the same "oi" with "nbr". */
+  if (lsa->data->type == OSPF_OPAQUE_LINK_LSA
+      && nbr->oi && ospf_if_exists (lsa->oi) != nbr->oi)
+    return 0;
 #endif /* HAVE_OPAQUE_LSA */
 
   /* Stay away from any Local Translated Type-7 LSAs */
@@ -233,84 +307,130 @@ ospf_db_summary_add (struct ospf_neighbor *nbr, struct ospf_lsa *lsa)
     return 0;
 
   if (IS_LSA_MAXAGE (lsa))
-    ospf_ls_retransmit_add (nbr, lsa);                      
-  else 
-    ospf_lsdb_add (&nbr->db_sum, lsa);
+    {
+      ospf_ls_retransmit_add (nbr, lsa);
+      return 0;
+    }
 
-  return 0;
+  return 1;
 }
 
-void
-ospf_db_summary_clear (struct ospf_neighbor *nbr)
+/* Move the walk to the next LSDB node, ending it after the last. */
+static void
+ospf_db_summary_step (struct ospf_neighbor *nbr)
 {
+  struct ospf_db_summary *sum = &nbr->db_sum;
   struct ospf_lsdb *lsdb;
-  int i;
 
-  lsdb = &nbr->db_sum;
-  for (i = OSPF_MIN_LSA; i < OSPF_MAX_LSA; i++)
+  if (sum->rn)
     {
-      struct route_table *table = lsdb->type[i].db;
-      struct route_node *rn;
+      if (sum->rn->info && sum->count)
+	sum->count--;
+      sum->rn = route_next (sum->rn);
+    }
 
-      for (rn = route_top (table); rn; rn = route_next (rn))
-	if (rn->info)
-	  ospf_lsdb_delete (&nbr->db_sum, rn->info);
+  while (sum->rn == NULL)
+    {
+      if (++sum->type >= OSPF_MAX_LSA)
+	{
+	  ospf_db_summary_clear (nbr);
+	  return;
+	}
+      if ((lsdb = ospf_db_summary_lsdb (nbr, sum->type)) != NULL)
+	sum->rn = route_top (lsdb->type[sum->type].db);
     }
 }
 
-
-
-/* The area link state database consists of the router-LSAs,
-   network-LSAs and summary-LSAs contained in the area structure,
-   along with the AS-external-LSAs contained in the global structure.
-   AS-external-LSAs are omitted from a virtual neighbor's Database
-   summary list.  AS-external-LSAs are omitted from the Database
-   summary list if the area has been configured as a stub. */
-static int
-nsm_negotiation_done (struct ospf_neighbor *nbr)
+/* The next LSA to describe to the neighbor, or NULL if there is none
+   left.  It stays at the head until ospf_db_summary_advance(). */
+struct ospf_lsa *
+ospf_db_summary_head (struct ospf_neighbor *nbr)
 {
-  struct ospf_area *area = nbr->oi->area;
   struct ospf_lsa *lsa;
-  struct route_node *rn;
 
-  LSDB_LOOP (ROUTER_LSDB (area), rn, lsa)
-    ospf_db_summary_add (nbr, lsa);
-  LSDB_LOOP (NETWORK_LSDB (area), rn, lsa)
-    ospf_db_summary_add (nbr, lsa);
-  LSDB_LOOP (SUMMARY_LSDB (area), rn, lsa)
-    ospf_db_summary_add (nbr, lsa);
-  LSDB_LOOP (ASBR_SUMMARY_LSDB (area), rn, lsa)
-    ospf_db_summary_add (nbr, lsa);
-
-#ifdef HAVE_OPAQUE_LSA
-  /* Process only if the neighbor is opaque capable. */
-  if (CHECK_FLAG (nbr->options, OSPF_OPTION_O))
+  while (nbr->db_sum.type)
     {
-      LSDB_LOOP (OPAQUE_LINK_LSDB (area), rn, lsa)
-	ospf_db_summary_add (nbr, lsa);
-      LSDB_LOOP (OPAQUE_AREA_LSDB (area), rn, lsa)
-	ospf_db_summary_add (nbr, lsa);
+      if ((lsa = nbr->db_sum.rn->info) != NULL
+	  && ospf_db_summary_wanted (nbr, lsa))
+	return lsa;
+      ospf_db_summary_step (nbr);
     }
-#endif /* HAVE_OPAQUE_LSA */
 
-  if (CHECK_FLAG (nbr->options, OSPF_OPTION_NP))
+  return NULL;
+}
+
+void
+ospf_db_summary_advance (struct ospf_neighbor *nbr)
+{
+  if (nbr->db_sum.type)
+    ospf_db_summary_step (nbr);
+}
+
+/* The neighbor described the instance lsa of our database, or a more
+   recent one: leave it out of the walk if it is still ahead. */
+void
+ospf_db_summary_skip (struct ospf_neighbor *nbr, struct ospf_lsa *lsa)
+{
+  struct ospf_db_summary *sum = &nbr->db_sum;
+
+  if (! sum->type || ospf_db_summary_passed (nbr, lsa))
+    return;
+
+  if (! sum->skip)
+    sum->skip = hash_create_open (0, ospf_db_summary_skip_key,
+				  ospf_db_summary_skip_cmp);
+  if (hash_lookup (sum->skip, lsa) == NULL)
+    hash_get (sum->skip, ospf_lsa_lock (lsa), hash_alloc_intern);
+}
+
+int
+ospf_db_summary_count (struct ospf_neighbor *nbr)
+{
+  return nbr->db_sum.count;
+}
+
+int
+ospf_db_summary_isempty (struct ospf_neighbor *nbr)
+{
+  return ospf_db_summary_head (nbr) == NULL;
+}
+
+void
+ospf_db_summary_clear (struct ospf_neighbor *nbr)
+{
+  struct ospf_db_summary *sum = &nbr->db_sum;
+
+  if (sum->rn)
+    route_unlock_node (sum->rn);
+  if (sum->skip)
     {
-      LSDB_LOOP (NSSA_LSDB (area), rn, lsa)
-	ospf_db_summary_add (nbr, lsa);
+      hash_clean (sum->skip, ospf_db_summary_skip_free);
+      hash_free (sum->skip);
     }
+  memset (sum, 0, sizeof (struct ospf_db_summary));
+}
 
-  if (nbr->oi->type != OSPF_IFTYPE_VIRTUALLINK
-      && area->external_routing == OSPF_AREA_DEFAULT)
-    LSDB_LOOP (EXTERNAL_LSDB (nbr->oi->ospf), rn, lsa)
-      ospf_db_summary_add (nbr, lsa);
 
-#ifdef HAVE_OPAQUE_LSA
-  if (CHECK_FLAG (nbr->options, OSPF_OPTION_O)
-      && (nbr->oi->type != OSPF_IFTYPE_VIRTUALLINK
-	  && area->external_routing == OSPF_AREA_DEFAULT))
-    LSDB_LOOP (OPAQUE_AS_LSDB (nbr->oi->ospf), rn, lsa)
-      ospf_db_summary_add (nbr, lsa);
-#endif /* HAVE_OPAQUE_LSA */
+
+/* Start the Database summary list.  Rather than copying the LSAs, it
+   walks the LSDBs as DD packets are made, leaving out what was added
+   since now, see ospf_db_summary_wanted(). */
+static int
+nsm_negotiation_done (struct ospf_neighbor *nbr)
+{
+  struct ospf_db_summary *sum = &nbr->db_sum;
+  struct ospf_lsdb *lsdb;
+  int type;
+
+  ospf_db_summary_clear (nbr);
+
+  sum->lsdb_seq = ospf_lsdb_seq_current ();
+  for (type = OSPF_MIN_LSA; type < OSPF_MAX_LSA; type++)
+    if ((lsdb = ospf_db_summary_lsdb (nbr, type)) != NULL)
+      sum->count += ospf_lsdb_count (lsdb, type);
+
+  sum->type = OSPF_MIN_LSA - 1;
+  ospf_db_summary_step (nbr);
 
   return 0;
 }
@@ -82,6 +82,9 @@
 /* Prototypes. */
 extern int ospf_nsm_event (struct thread *);
 extern void ospf_check_nbr_loading (struct ospf_neighbor *);
+extern struct ospf_lsa *ospf_db_summary_head (struct ospf_neighbor *);
+extern void ospf_db_summary_advance (struct ospf_neighbor *);
+extern void ospf_db_summary_skip (struct ospf_neighbor *, struct ospf_lsa *);
 extern int ospf_db_summary_isempty (struct ospf_neighbor *);
 extern int ospf_db_summary_count (struct ospf_neighbor *);
 extern void ospf_db_summary_clear (struct ospf_neighbor *);
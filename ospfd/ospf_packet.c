@@ -32,8 +32,10 @@
 #include "stream.h"
 #include "log.h"
 #include "sockopt.h"
+#include "network.h"
 #include "checksum.h"
 #include "md5.h"
+#include "sha256.h"
 
 #include "ospfd/ospfd.h"
 #include "ospfd/ospf_network.h"
@@ -289,8 +291,8 @@ ospf_packet_dup (struct ospf_packet *op)
     zlog_warn ("ospf_packet_dup stream %lu ospf_packet %u size mismatch",
 	       (u_long)STREAM_SIZE(op->s), op->length);
 
-  /* Reserve space for MD5 authentication that may be added later. */
-  new = ospf_packet_new (stream_get_endp(op->s) + OSPF_AUTH_MD5_SIZE);
+  /* Reserve space for a digest that may be added later. */
+  new = ospf_packet_new (stream_get_endp(op->s) + OSPF_AUTH_DIGEST_MAX_SIZE);
   stream_copy (new->s, op->s);
 
   new->dst = op->dst;
@@ -306,7 +308,8 @@ ospf_packet_authspace (struct ospf_interface *oi)
   int auth = 0;
 
   if ( ospf_auth_type (oi) == OSPF_AUTH_CRYPTOGRAPHIC)
-    auth = OSPF_AUTH_MD5_SIZE;
+    auth = ospf_crypt_key_digest_size
+      (listgetdata (listtail (OSPF_IF_PARAM (oi, auth_crypt))));
 
   return auth;
 }
@@ -324,11 +327,42 @@ ospf_packet_max (struct ospf_interface *oi)
 }
 
 
-static int
-ospf_check_md5_digest (struct ospf_interface *oi, struct ospf_header *ospfh)
+/* Digest a packet of length bytes with a key, as RFC 2328 D.4.3 does for
+   keyed MD5 and RFC 5709 for HMAC-SHA.  Returns the digest length. */
+static unsigned int
+ospf_auth_digest (struct crypt_key *ck, const u_int8_t *auth_key,
+		  void *packet, u_int16_t length, unsigned char *digest)
 {
   MD5_CTX ctx;
-  unsigned char digest[OSPF_AUTH_MD5_SIZE];
+  HMAC_SHA256_CTX hctx;
+  u_int32_t apad[OSPF_AUTH_HMAC_SHA256_SIZE / 4];
+  unsigned int i;
+
+  if (ck && ck->algo == OSPF_CRYPT_HMAC_SHA256)
+    {
+      /* The keyed states are ready; only the packet and Apad are hashed. */
+      for (i = 0; i < OSPF_AUTH_HMAC_SHA256_SIZE / 4; i++)
+	apad[i] = htonl (0x878FE1F3);
+      hctx = ck->hmac;
+      HMAC_SHA256_Update (&hctx, packet, length);
+      HMAC_SHA256_Update (&hctx, apad, sizeof (apad));
+      HMAC_SHA256_Final (digest, &hctx);
+      return OSPF_AUTH_HMAC_SHA256_SIZE;
+    }
+
+  memset(&ctx, 0, sizeof(ctx));
+  MD5Init(&ctx);
+  MD5Update(&ctx, packet, length);
+  MD5Update(&ctx, auth_key, OSPF_AUTH_MD5_SIZE);
+  MD5Final(digest, &ctx);
+  return OSPF_AUTH_MD5_SIZE;
+}
+
+static int
+ospf_check_auth_digest (struct ospf_interface *oi, struct ospf_header *ospfh)
+{
+  unsigned char digest[OSPF_AUTH_DIGEST_MAX_SIZE];
+  unsigned int size;
   struct crypt_key *ck;
   struct ospf_neighbor *nbr;
   u_int16_t length = ntohs (ospfh->length);
@@ -338,17 +372,26 @@ ospf_check_md5_digest (struct ospf_interface *oi, struct ospf_header *ospfh)
 			      ospfh->u.crypt.key_id);
   if (ck == NULL)
     {
-      zlog_warn ("interface %s: ospf_check_md5 no key %d",
+      zlog_warn ("interface %s: ospf_check_auth_digest no key %d",
 		 IF_NAME (oi), ospfh->u.crypt.key_id);
       return 0;
     }
 
+  if (ospfh->u.crypt.auth_data_len != ospf_crypt_key_digest_size (ck))
+    {
+      zlog_warn ("interface %s: ospf_check_auth_digest key %d wrong "
+		 "digest length %d", IF_NAME (oi), ospfh->u.crypt.key_id,
+		 ospfh->u.crypt.auth_data_len);
+      return 0;
+    }
+
   /* check crypto seqnum. */
   nbr = ospf_nbr_lookup_by_routerid (oi->nbrs, &ospfh->router_id);
 
   if (nbr && ntohl(nbr->crypt_seqnum) > ntohl(ospfh->u.crypt.crypt_seqnum))
     {
-      zlog_warn ("interface %s: ospf_check_md5 bad sequence %d (expect %d)",
+      zlog_warn ("interface %s: ospf_check_auth_digest bad sequence %d "
+		 "(expect %d)",
 		 IF_NAME (oi),
 		 ntohl(ospfh->u.crypt.crypt_seqnum),
 		 ntohl(nbr->crypt_seqnum));
@@ -356,16 +399,12 @@ ospf_check_md5_digest (struct ospf_interface *oi, struct ospf_header *ospfh)
     }
       
   /* Generate a digest for the ospf packet - their digest + our digest. */
-  memset(&ctx, 0, sizeof(ctx));
-  MD5Init(&ctx);
-  MD5Update(&ctx, ospfh, length);
-  MD5Update(&ctx, ck->auth_key, OSPF_AUTH_MD5_SIZE);
-  MD5Final(digest, &ctx);
+  size = ospf_auth_digest (ck, ck->auth_key, ospfh, length, digest);
 
   /* compare the two */
-  if (memcmp ((caddr_t)ospfh + length, digest, OSPF_AUTH_MD5_SIZE))
+  if (memcmp ((caddr_t)ospfh + length, digest, size))
     {
-      zlog_warn ("interface %s: ospf_check_md5 checksum mismatch",
+      zlog_warn ("interface %s: ospf_check_auth_digest checksum mismatch",
 		 IF_NAME (oi));
       return 0;
     }
@@ -377,14 +416,14 @@ ospf_check_md5_digest (struct ospf_interface *oi, struct ospf_header *ospfh)
 }
 
 /* This function is called from ospf_write(), it will detect the
-   authentication scheme and if it is MD5, it will change the sequence
-   and update the MD5 digest. */
+   authentication scheme and if it is cryptographic, it will change the
+   sequence and append the digest. */
 static int
-ospf_make_md5_digest (struct ospf_interface *oi, struct ospf_packet *op)
+ospf_make_auth_digest (struct ospf_interface *oi, struct ospf_packet *op)
 {
   struct ospf_header *ospfh;
-  unsigned char digest[OSPF_AUTH_MD5_SIZE];
-  MD5_CTX ctx;
+  unsigned char digest[OSPF_AUTH_DIGEST_MAX_SIZE];
+  unsigned int size;
   void *ibuf;
   u_int32_t t;
   struct crypt_key *ck;
@@ -408,9 +447,12 @@ ospf_make_md5_digest (struct ospf_interface *oi, struct ospf_packet *op)
   
   ospfh->u.crypt.crypt_seqnum = htonl (oi->crypt_seqnum); 
 
-  /* Get MD5 Authentication key from auth_key list. */
+  /* Get Authentication key from auth_key list. */
   if (list_isempty (OSPF_IF_PARAM (oi, auth_crypt)))
-    auth_key = (const u_int8_t *) "";
+    {
+      ck = NULL;
+      auth_key = (const u_int8_t *) "";
+    }
   else
     {
       ck = listgetdata (listtail(OSPF_IF_PARAM (oi, auth_crypt)));
@@ -418,27 +460,23 @@ ospf_make_md5_digest (struct ospf_interface *oi, struct ospf_packet *op)
     }
 
   /* Generate a digest for the entire packet + our secret key. */
-  memset(&ctx, 0, sizeof(ctx));
-  MD5Init(&ctx);
-  MD5Update(&ctx, ibuf, ntohs (ospfh->length));
-  MD5Update(&ctx, auth_key, OSPF_AUTH_MD5_SIZE);
-  MD5Final(digest, &ctx);
+  size = ospf_auth_digest (ck, auth_key, ibuf, ntohs (ospfh->length), digest);
 
-  /* Append md5 digest to the end of the stream. */
-  stream_put (op->s, digest, OSPF_AUTH_MD5_SIZE);
+  /* Append digest to the end of the stream. */
+  stream_put (op->s, digest, size);
 
   /* We do *NOT* increment the OSPF header length. */
-  op->length = ntohs (ospfh->length) + OSPF_AUTH_MD5_SIZE;
+  op->length = ntohs (ospfh->length) + size;
 
   if (stream_get_endp(op->s) != op->length)
     /* XXX size_t */
-    zlog_warn("ospf_make_md5_digest: length mismatch stream %lu ospf_packet %u",
+    zlog_warn("ospf_make_auth_digest: length mismatch stream %lu ospf_packet %u",
 	      (u_long)stream_get_endp(op->s), op->length);
 
-  return OSPF_AUTH_MD5_SIZE;
+  return size;
 }
 
-
+
 static int
 ospf_ls_req_timer (struct thread *thread)
 {
@@ -482,37 +520,26 @@ ospf_ls_upd_timer (struct thread *thread)
   if (ospf_ls_retransmit_count (nbr) > 0)
     {
       struct list *update;
-      struct ospf_lsdb *lsdb;
-      int i;
+      struct ilistnode *node;
+      struct ospf_ls_rxmt *rx;
       int retransmit_interval;
 
       retransmit_interval = OSPF_IF_PARAM (nbr->oi, retransmit_interval);
 
-      lsdb = &nbr->ls_rxmt;
       update = list_new ();
 
-      for (i = OSPF_MIN_LSA; i < OSPF_MAX_LSA; i++)
-	{
-	  struct route_table *table = lsdb->type[i].db;
-	  struct route_node *rn;
-	  
-	  for (rn = route_top (table); rn; rn = route_next (rn))
-	    {
-	      struct ospf_lsa *lsa;
-	      
-	      if ((lsa = rn->info) != NULL)
-		/* Don't retransmit an LSA if we received it within
-		  the last RxmtInterval seconds - this is to allow the
-		  neighbour a chance to acknowledge the LSA as it may
-		  have ben just received before the retransmit timer
-		  fired.  This is a small tweak to what is in the RFC,
-		  but it will cut out out a lot of retransmit traffic
-		  - MAG */
-		if (tv_cmp (tv_sub (recent_relative_time (), lsa->tv_recv), 
-			    int2tv (retransmit_interval)) >= 0)
-		  listnode_add (update, rn->info);
-	    }
-	}
+      for (ALL_ILIST_ELEMENTS_RO (&nbr->ls_rxmt, node, rx,
+				  struct ospf_ls_rxmt, nbr_node))
+	/* Don't retransmit an LSA if we received it within
+	  the last RxmtInterval seconds - this is to allow the
+	  neighbour a chance to acknowledge the LSA as it may
+	  have ben just received before the retransmit timer
+	  fired.  This is a small tweak to what is in the RFC,
+	  but it will cut out out a lot of retransmit traffic
+	  - MAG */
+	if (tv_cmp (tv_sub (recent_relative_time (), rx->lsa->tv_recv), 
+		    int2tv (retransmit_interval)) >= 0)
+	  listnode_add (update, rx->lsa);
 
       if (listcount (update) > 0)
 	ospf_ls_upd_send (nbr, update, OSPF_SEND_PACKET_DIRECT);
@@ -628,32 +655,25 @@ ospf_write_frags (int fd, struct ospf_packet *op, struct ip *iph,
 }
 #endif /* WANT_OSPF_WRITE_FRAGMENT */
 
-static int
-ospf_write (struct thread *thread)
+/* One queued packet, as handed to the kernel. */
+struct ospf_write_msg
 {
-  struct ospf *ospf = THREAD_ARG (thread);
-  struct ospf_interface *oi;
   struct ospf_packet *op;
-  struct sockaddr_in sa_dst;
   struct ip iph;
-  struct msghdr msg;
+  struct sockaddr_in sa_dst;
   struct iovec iov[2];
   u_char type;
-  int ret;
-  int flags = 0;
-  struct listnode *node;
+  int error;
+};
+
+static void
+ospf_write_prepare (struct ospf_interface *oi, struct ospf_packet *op,
+		    struct ospf_write_msg *wm, struct msghdr *msg)
+{
 #ifdef WANT_OSPF_WRITE_FRAGMENT
   static u_int16_t ipid = 0;
 #endif /* WANT_OSPF_WRITE_FRAGMENT */
-  u_int16_t maxdatasize;
 #define OSPF_WRITE_IPHL_SHIFT 2
-  
-  ospf->t_write = NULL;
-
-  node = listhead (ospf->oi_write_q);
-  assert (node);
-  oi = listgetdata (node);
-  assert (oi);
 
 #ifdef WANT_OSPF_WRITE_FRAGMENT
   /* seed ipid static with low order bits of time */
@@ -661,62 +681,41 @@ ospf_write (struct thread *thread)
     ipid = (time(NULL) & 0xffff);
 #endif /* WANT_OSPF_WRITE_FRAGMENT */
 
-  /* convenience - max OSPF data per packet,
-   * and reliability - not more data, than our
-   * socket can accept
-   */
-  maxdatasize = MIN (oi->ifp->mtu, ospf->maxsndbuflen) -
-    sizeof (struct ip);
-  
-  /* Get one packet from queue. */
-  op = ospf_fifo_head (oi->obuf);
-  assert (op);
-  assert (op->length >= OSPF_HEADER_SIZE);
-
-  if (op->dst.s_addr == htonl (OSPF_ALLSPFROUTERS)
-      || op->dst.s_addr == htonl (OSPF_ALLDROUTERS))
-      ospf_if_ipmulticast (ospf, oi->address, oi->ifp->ifindex);
-    
-  /* Rewrite the md5 signature & update the seq */
-  ospf_make_md5_digest (oi, op);
+  /* Rewrite the digest & update the seq */
+  ospf_make_auth_digest (oi, op);
+
+  memset (wm, 0, sizeof (struct ospf_write_msg));
+  wm->op = op;
 
   /* Retrieve OSPF packet type. */
   stream_set_getp (op->s, 1);
-  type = stream_getc (op->s);
+  wm->type = stream_getc (op->s);
   
   /* reset get pointer */
   stream_set_getp (op->s, 0);
 
-  memset (&iph, 0, sizeof (struct ip));
-  memset (&sa_dst, 0, sizeof (sa_dst));
-  
-  sa_dst.sin_family = AF_INET;
+  wm->sa_dst.sin_family = AF_INET;
 #ifdef HAVE_STRUCT_SOCKADDR_IN_SIN_LEN
-  sa_dst.sin_len = sizeof(sa_dst);
+  wm->sa_dst.sin_len = sizeof(wm->sa_dst);
 #endif /* HAVE_STRUCT_SOCKADDR_IN_SIN_LEN */
-  sa_dst.sin_addr = op->dst;
-  sa_dst.sin_port = htons (0);
+  wm->sa_dst.sin_addr = op->dst;
+  wm->sa_dst.sin_port = htons (0);
 
-  /* Set DONTROUTE flag if dst is unicast. */
-  if (oi->type != OSPF_IFTYPE_VIRTUALLINK)
-    if (!IN_MULTICAST (htonl (op->dst.s_addr)))
-      flags = MSG_DONTROUTE;
-
-  iph.ip_hl = sizeof (struct ip) >> OSPF_WRITE_IPHL_SHIFT;
+  wm->iph.ip_hl = sizeof (struct ip) >> OSPF_WRITE_IPHL_SHIFT;
   /* it'd be very strange for header to not be 4byte-word aligned but.. */
   if ( sizeof (struct ip) 
-        > (unsigned int)(iph.ip_hl << OSPF_WRITE_IPHL_SHIFT) )
-    iph.ip_hl++; /* we presume sizeof struct ip cant overflow ip_hl.. */
+        > (unsigned int)(wm->iph.ip_hl << OSPF_WRITE_IPHL_SHIFT) )
+    wm->iph.ip_hl++; /* we presume sizeof struct ip cant overflow ip_hl.. */
   
-  iph.ip_v = IPVERSION;
-  iph.ip_tos = IPTOS_PREC_INTERNETCONTROL;
-  iph.ip_len = (iph.ip_hl << OSPF_WRITE_IPHL_SHIFT) + op->length;
+  wm->iph.ip_v = IPVERSION;
+  wm->iph.ip_tos = IPTOS_PREC_INTERNETCONTROL;
+  wm->iph.ip_len = (wm->iph.ip_hl << OSPF_WRITE_IPHL_SHIFT) + op->length;
 
 #if defined(__DragonFly__)
   /*
    * DragonFly's raw socket expects ip_len/ip_off in network byte order.
    */
-  iph.ip_len = htons(iph.ip_len);
+  wm->iph.ip_len = htons(wm->iph.ip_len);
 #endif
 
 #ifdef WANT_OSPF_WRITE_FRAGMENT
@@ -724,70 +723,148 @@ ospf_write (struct thread *thread)
    * XXX: this presumes this is only programme sending OSPF packets 
    * otherwise, no guarantee ipid will be unique
    */
-  iph.ip_id = ++ipid;
+  wm->iph.ip_id = ++ipid;
 #endif /* WANT_OSPF_WRITE_FRAGMENT */
 
-  iph.ip_off = 0;
+  wm->iph.ip_off = 0;
   if (oi->type == OSPF_IFTYPE_VIRTUALLINK)
-    iph.ip_ttl = OSPF_VL_IP_TTL;
+    wm->iph.ip_ttl = OSPF_VL_IP_TTL;
   else
-    iph.ip_ttl = OSPF_IP_TTL;
-  iph.ip_p = IPPROTO_OSPFIGP;
-  iph.ip_sum = 0;
-  iph.ip_src.s_addr = oi->address->u.prefix4.s_addr;
-  iph.ip_dst.s_addr = op->dst.s_addr;
-
-  memset (&msg, 0, sizeof (msg));
-  msg.msg_name = (caddr_t) &sa_dst;
-  msg.msg_namelen = sizeof (sa_dst); 
-  msg.msg_iov = iov;
-  msg.msg_iovlen = 2;
-  iov[0].iov_base = (char*)&iph;
-  iov[0].iov_len = iph.ip_hl << OSPF_WRITE_IPHL_SHIFT;
-  iov[1].iov_base = STREAM_PNT (op->s);
-  iov[1].iov_len = op->length;
+    wm->iph.ip_ttl = OSPF_IP_TTL;
+  wm->iph.ip_p = IPPROTO_OSPFIGP;
+  wm->iph.ip_sum = 0;
+  wm->iph.ip_src.s_addr = oi->address->u.prefix4.s_addr;
+  wm->iph.ip_dst.s_addr = op->dst.s_addr;
+
+  memset (msg, 0, sizeof (struct msghdr));
+  msg->msg_name = (caddr_t) &wm->sa_dst;
+  msg->msg_namelen = sizeof (wm->sa_dst); 
+  msg->msg_iov = wm->iov;
+  msg->msg_iovlen = 2;
+  wm->iov[0].iov_base = (char*)&wm->iph;
+  wm->iov[0].iov_len = wm->iph.ip_hl << OSPF_WRITE_IPHL_SHIFT;
+  wm->iov[1].iov_base = STREAM_PNT (op->s);
+  wm->iov[1].iov_len = op->length;
+}
+
+static int
+ospf_write (struct thread *thread)
+{
+  struct ospf *ospf = THREAD_ARG (thread);
+  struct ospf_interface *oi;
+  struct ospf_packet *op;
+  struct ospf_write_msg wm[OSPF_WRITE_BATCH];
+  struct mmsghdr mmsg[OSPF_WRITE_BATCH];
+  unsigned int count, sent, i;
+  int ret;
+  int flags = 0;
+  int opflags;
+  int multicast = 0;
+  struct listnode *node;
+  u_int16_t maxdatasize;
   
+  ospf->t_write = NULL;
+
+  node = listhead (ospf->oi_write_q);
+  assert (node);
+  oi = listgetdata (node);
+  assert (oi);
+
+  /* convenience - max OSPF data per packet,
+   * and reliability - not more data, than our
+   * socket can accept
+   */
+  maxdatasize = MIN (oi->ifp->mtu, ospf->maxsndbuflen) -
+    sizeof (struct ip);
+  
+  /* Take the run of queued packets that can go out in one batch: same
+     interface and send flags.  A packet to be fragmented goes alone. */
+  assert (ospf_fifo_head (oi->obuf));
+  for (count = 0, op = ospf_fifo_head (oi->obuf);
+       op && count < OSPF_WRITE_BATCH; op = op->next)
+    {
+      assert (op->length >= OSPF_HEADER_SIZE);
+
+      /* Set DONTROUTE flag if dst is unicast. */
+      opflags = 0;
+      if (oi->type != OSPF_IFTYPE_VIRTUALLINK)
+	if (!IN_MULTICAST (htonl (op->dst.s_addr)))
+	  opflags = MSG_DONTROUTE;
+
+      if (count && (opflags != flags || op->length > maxdatasize))
+	break;
+      flags = opflags;
+
+      if (op->dst.s_addr == htonl (OSPF_ALLSPFROUTERS)
+	  || op->dst.s_addr == htonl (OSPF_ALLDROUTERS))
+	multicast = 1;
+
+      ospf_write_prepare (oi, op, &wm[count], &mmsg[count].msg_hdr);
+      mmsg[count].msg_len = 0;
+      count++;
+
+      if (op->length > maxdatasize)
+	break;
+    }
+
+  if (multicast)
+    ospf_if_ipmulticast (ospf, oi->address, oi->ifp->ifindex);
+
   /* Sadly we can not rely on kernels to fragment packets because of either
    * IP_HDRINCL and/or multicast destination being set.
    */
 #ifdef WANT_OSPF_WRITE_FRAGMENT
-  if ( op->length > maxdatasize )
-    ospf_write_frags (ospf->fd, op, &iph, &msg, maxdatasize, 
-                      oi->ifp->mtu, flags, type);
+  if ( wm[0].op->length > maxdatasize )
+    ospf_write_frags (ospf->fd, wm[0].op, &wm[0].iph, &mmsg[0].msg_hdr,
+		      maxdatasize, oi->ifp->mtu, flags, wm[0].type);
 #endif /* WANT_OSPF_WRITE_FRAGMENT */
 
-  /* send final fragment (could be first) */
-  sockopt_iphdrincl_swab_htosys (&iph);
-  ret = sendmsg (ospf->fd, &msg, flags);
-  sockopt_iphdrincl_swab_systoh (&iph);
-  
-  if (ret < 0)
-    zlog_warn ("*** sendmsg in ospf_write failed to %s, "
-	       "id %d, off %d, len %d, interface %s, mtu %u: %s",
-	       inet_ntoa (iph.ip_dst), iph.ip_id, iph.ip_off, iph.ip_len,
-	       oi->ifp->name, oi->ifp->mtu, safe_strerror (errno));
+  /* send final fragments (could be first) */
+  for (i = 0; i < count; i++)
+    sockopt_iphdrincl_swab_htosys (&wm[i].iph);
+  for (sent = 0; sent < count; sent += ret)
+    if ((ret = sendmsg_batch (ospf->fd, &mmsg[sent], count - sent, flags)) <= 0)
+      {
+	/* Skip the message that failed and carry on with the rest. */
+	wm[sent].error = errno;
+	ret = 1;
+      }
 
-  /* Show debug sending packet. */
-  if (IS_DEBUG_OSPF_PACKET (type - 1, SEND))
+  for (i = 0; i < count; i++)
     {
-      if (IS_DEBUG_OSPF_PACKET (type - 1, DETAIL))
+      sockopt_iphdrincl_swab_systoh (&wm[i].iph);
+      op = wm[i].op;
+
+      if (wm[i].error)
+	zlog_warn ("*** sendmsg in ospf_write failed to %s, "
+		   "id %d, off %d, len %d, interface %s, mtu %u: %s",
+		   inet_ntoa (wm[i].iph.ip_dst), wm[i].iph.ip_id,
+		   wm[i].iph.ip_off, wm[i].iph.ip_len,
+		   oi->ifp->name, oi->ifp->mtu, safe_strerror (wm[i].error));
+
+      /* Show debug sending packet. */
+      if (IS_DEBUG_OSPF_PACKET (wm[i].type - 1, SEND))
 	{
-	  zlog_debug ("-----------------------------------------------------");
-	  ospf_ip_header_dump (&iph);
-	  stream_set_getp (op->s, 0);
-	  ospf_packet_dump (op->s);
-	}
+	  if (IS_DEBUG_OSPF_PACKET (wm[i].type - 1, DETAIL))
+	    {
+	      zlog_debug ("-----------------------------------------------------");
+	      ospf_ip_header_dump (&wm[i].iph);
+	      stream_set_getp (op->s, 0);
+	      ospf_packet_dump (op->s);
+	    }
 
-      zlog_debug ("%s sent to [%s] via [%s].",
-		 LOOKUP (ospf_packet_type_str, type), inet_ntoa (op->dst),
-		 IF_NAME (oi));
+	  zlog_debug ("%s sent to [%s] via [%s].",
+		     LOOKUP (ospf_packet_type_str, wm[i].type),
+		     inet_ntoa (op->dst), IF_NAME (oi));
 
-      if (IS_DEBUG_OSPF_PACKET (type - 1, DETAIL))
-	zlog_debug ("-----------------------------------------------------");
+	  if (IS_DEBUG_OSPF_PACKET (wm[i].type - 1, DETAIL))
+	    zlog_debug ("-----------------------------------------------------");
+	}
     }
 
-  /* Now delete packet from queue. */
-  ospf_packet_delete (oi);
+  /* Now delete the batch from queue. */
+  for (i = 0; i < count; i++)
+    ospf_packet_delete (oi);
 
   if (ospf_fifo_head (oi->obuf) == NULL)
     {
@@ -1117,7 +1194,7 @@ ospf_db_desc_proc (struct stream *s, struct ospf_interface *oi,
              * DB Description process implemented here.
              */
             if (find)
-              ospf_lsdb_delete (&nbr->db_sum, find);
+              ospf_db_summary_skip (nbr, find);
             ospf_lsa_discard (new);
             break;
           default:
@@ -2137,30 +2214,16 @@ ospf_ls_ack (struct ip *iph, struct ospf_header *ospfh,
   return;
 }
 
+/* Check a received datagram, of ret bytes, and find its interface. */
 static struct stream *
-ospf_recv_packet (int fd, struct interface **ifp, struct stream *ibuf)
+ospf_recv_packet (struct stream *ibuf, struct msghdr *msgh, int ret,
+		  struct interface **ifp)
 {
-  int ret;
   struct ip *iph;
   u_int16_t ip_len;
   unsigned int ifindex = 0;
-  struct iovec iov;
-  /* Header and data both require alignment. */
-  char buff [CMSG_SPACE(SOPT_SIZE_CMSG_IFINDEX_IPV4())];
-  struct msghdr msgh;
-
-  memset (&msgh, 0, sizeof (struct msghdr));
-  msgh.msg_iov = &iov;
-  msgh.msg_iovlen = 1;
-  msgh.msg_control = (caddr_t) buff;
-  msgh.msg_controllen = sizeof (buff);
-  
-  ret = stream_recvmsg (ibuf, fd, &msgh, 0, OSPF_MAX_PACKET_SIZE+1);
-  if (ret < 0)
-    {
-      zlog_warn("stream_recvmsg failed: %s", safe_strerror(errno));
-      return NULL;
-    }
+
+  stream_set_endp (ibuf, ret);
   if ((unsigned int)ret < sizeof(iph)) /* ret must be > 0 now */
     {
       zlog_warn("ospf_recv_packet: discarding runt packet of length %d "
@@ -2203,7 +2266,7 @@ ospf_recv_packet (int fd, struct interface **ifp, struct stream *ibuf)
   ip_len = ntohs(iph->ip_len) + (iph->ip_hl << 2);
 #endif
 
-  ifindex = getsockopt_ifindex (AF_INET, &msgh);
+  ifindex = getsockopt_ifindex (AF_INET, msgh);
   
   *ifp = if_lookup_by_index (ifindex);
 
@@ -2365,18 +2428,18 @@ ospf_check_auth (struct ospf_interface *oi, struct ospf_header *ospfh)
         zlog_warn ("interface %s: OSPF header checksum is not 0", IF_NAME (oi));
       return 0;
     }
-    /* only MD5 crypto method can pass ospf_packet_examin() */
+    /* only MD5 and HMAC-SHA-256 digests can pass ospf_packet_examin() */
     if
     (
       NULL == (ck = listgetdata (listtail(OSPF_IF_PARAM (oi,auth_crypt)))) ||
       ospfh->u.crypt.key_id != ck->key_id ||
       /* Condition above uses the last key ID on the list, which is
          different from what ospf_crypt_key_lookup() does. A bug? */
-      ! ospf_check_md5_digest (oi, ospfh)
+      ! ospf_check_auth_digest (oi, ospfh)
     )
     {
       if (IS_DEBUG_OSPF_PACKET (ospfh->type - 1, RECV))
-        zlog_warn ("interface %s: MD5 auth failed", IF_NAME (oi));
+        zlog_warn ("interface %s: cryptographic auth failed", IF_NAME (oi));
       return 0;
     }
     return 1;
@@ -2629,14 +2692,15 @@ ospf_packet_examin (struct ospf_header * oh, const unsigned bytesonwire)
     bytesauth = 0;
   else
   {
-    if (oh->u.crypt.auth_data_len != OSPF_AUTH_MD5_SIZE)
+    if (oh->u.crypt.auth_data_len != OSPF_AUTH_MD5_SIZE
+        && oh->u.crypt.auth_data_len != OSPF_AUTH_HMAC_SHA256_SIZE)
     {
       if (IS_DEBUG_OSPF_PACKET (0, RECV))
         zlog_debug ("%s: unsupported crypto auth length (%u B)",
                     __func__, oh->u.crypt.auth_data_len);
       return MSG_NG;
     }
-    bytesauth = OSPF_AUTH_MD5_SIZE;
+    bytesauth = oh->u.crypt.auth_data_len;
   }
   if (bytesdeclared + bytesauth > bytesonwire)
   {
@@ -2742,28 +2806,17 @@ ospf_verify_header (struct stream *ibuf, struct ospf_interface *oi,
   return 0;
 }
 
-/* Starting point of packet process function. */
-int
-ospf_read (struct thread *thread)
+/* Process one received packet. */
+static int
+ospf_read_packet (struct ospf *ospf, struct stream *ibuf,
+		  struct interface *ifp)
 {
   int ret;
-  struct stream *ibuf;
-  struct ospf *ospf;
   struct ospf_interface *oi;
   struct ip *iph;
   struct ospf_header *ospfh;
   u_int16_t length;
-  struct interface *ifp;
-
-  /* first of all get interface pointer. */
-  ospf = THREAD_ARG (thread);
 
-  /* prepare for next packet. */
-  ospf->t_read = thread_add_read (master, ospf_read, ospf, ospf->fd);
-
-  stream_reset(ospf->ibuf);
-  if (!(ibuf = ospf_recv_packet (ospf->fd, &ifp, ospf->ibuf)))
-    return -1;
   /* This raw packet is known to be at least as big as its IP header. */
   
   /* Note that there should not be alignment problems with this assignment
@@ -2965,6 +3018,52 @@ ospf_read (struct thread *thread)
   return 0;
 }
 
+/* Starting point of packet process function. */
+int
+ospf_read (struct thread *thread)
+{
+  struct ospf *ospf;
+  struct stream *ibuf;
+  struct interface *ifp;
+  struct mmsghdr mmsg[OSPF_READ_BATCH];
+  struct iovec iov[OSPF_READ_BATCH];
+  /* Header and data both require alignment. */
+  char buff[OSPF_READ_BATCH][CMSG_SPACE(SOPT_SIZE_CMSG_IFINDEX_IPV4())];
+  int count, i;
+
+  /* first of all get interface pointer. */
+  ospf = THREAD_ARG (thread);
+
+  /* prepare for next packet. */
+  ospf->t_read = thread_add_read (master, ospf_read, ospf, ospf->fd);
+
+  /* Take whatever has queued up on the socket, then process it in order. */
+  memset (mmsg, 0, sizeof (mmsg));
+  for (i = 0; i < OSPF_READ_BATCH; i++)
+    {
+      stream_reset (ospf->ibuf[i]);
+      iov[i].iov_base = STREAM_DATA (ospf->ibuf[i]);
+      iov[i].iov_len = OSPF_MAX_PACKET_SIZE+1;
+      mmsg[i].msg_hdr.msg_iov = &iov[i];
+      mmsg[i].msg_hdr.msg_iovlen = 1;
+      mmsg[i].msg_hdr.msg_control = (caddr_t) buff[i];
+      mmsg[i].msg_hdr.msg_controllen = sizeof (buff[i]);
+    }
+
+  if ((count = recvmsg_batch (ospf->fd, mmsg, OSPF_READ_BATCH)) < 0)
+    {
+      zlog_warn("recvmsg_batch failed: %s", safe_strerror(errno));
+      return -1;
+    }
+
+  for (i = 0; i < count; i++)
+    if ((ibuf = ospf_recv_packet (ospf->ibuf[i], &mmsg[i].msg_hdr,
+				  mmsg[i].msg_len, &ifp)))
+      ospf_read_packet (ospf, ibuf, ifp);
+
+  return 0;
+}
+
 /* Make OSPF header. */
 static void
 ospf_make_header (int type, struct ospf_interface *oi, struct stream *s)
@@ -3008,16 +3107,16 @@ ospf_make_auth (struct ospf_interface *oi, struct ospf_header *ospfh)
 	{
 	  ospfh->u.crypt.zero = 0;
 	  ospfh->u.crypt.key_id = 0;
-	  ospfh->u.crypt.auth_data_len = OSPF_AUTH_MD5_SIZE;
+	  ospfh->u.crypt.auth_data_len = ospf_crypt_key_digest_size (NULL);
 	}
       else
 	{
 	  ck = listgetdata (listtail(OSPF_IF_PARAM (oi, auth_crypt)));
 	  ospfh->u.crypt.zero = 0;
 	  ospfh->u.crypt.key_id = ck->key_id;
-	  ospfh->u.crypt.auth_data_len = OSPF_AUTH_MD5_SIZE;
+	  ospfh->u.crypt.auth_data_len = ospf_crypt_key_digest_size (ck);
 	}
-      /* note: the seq is done in ospf_make_md5_digest() */
+      /* note: the seq is done in ospf_make_auth_digest() */
       break;
     default:
       /* memset (ospfh->u.auth_data, 0, sizeof (ospfh->u.auth_data)); */
@@ -3127,8 +3226,6 @@ ospf_make_db_desc (struct ospf_interface *oi, struct ospf_neighbor *nbr,
   u_int16_t length = OSPF_DB_DESC_MIN_SIZE;
   u_char options;
   unsigned long pp;
-  int i;
-  struct ospf_lsdb *lsdb;
   
   /* Set Interface MTU. */
   if (oi->type == OSPF_IFTYPE_VIRTUALLINK)
@@ -3171,53 +3268,40 @@ ospf_make_db_desc (struct ospf_interface *oi, struct ospf_neighbor *nbr,
     goto empty;
 
   /* Describe LSA Header from Database Summary List. */
-  lsdb = &nbr->db_sum;
-
-  for (i = OSPF_MIN_LSA; i < OSPF_MAX_LSA; i++)
+  while ((lsa = ospf_db_summary_head (nbr)) != NULL)
     {
-      struct route_table *table = lsdb->type[i].db;
-      struct route_node *rn;
+      struct lsa_header *lsah;
+      u_int16_t ls_age;
 
-      for (rn = route_top (table); rn; rn = route_next (rn))
-	if ((lsa = rn->info) != NULL)
-	  {
 #ifdef HAVE_OPAQUE_LSA
-            if (IS_OPAQUE_LSA (lsa->data->type)
-            && (! CHECK_FLAG (options, OSPF_OPTION_O)))
-              {
-                /* Suppress advertising opaque-informations. */
-                /* Remove LSA from DB summary list. */
-                ospf_lsdb_delete (lsdb, lsa);
-                continue;
-              }
+      if (IS_OPAQUE_LSA (lsa->data->type)
+	  && (! CHECK_FLAG (options, OSPF_OPTION_O)))
+	{
+	  /* Suppress advertising opaque-informations. */
+	  /* Remove LSA from DB summary list. */
+	  ospf_db_summary_advance (nbr);
+	  continue;
+	}
 #endif /* HAVE_OPAQUE_LSA */
 
-	    if (!CHECK_FLAG (lsa->flags, OSPF_LSA_DISCARD))
-	      {
-		struct lsa_header *lsah;
-		u_int16_t ls_age;
-		
-		/* DD packet overflows interface MTU. */
-		if (length + OSPF_LSA_HEADER_SIZE > ospf_packet_max (oi))
-		  break;
-		
-		/* Keep pointer to LS age. */
-		lsah = (struct lsa_header *) (STREAM_DATA (s) +
-					      stream_get_endp (s));
-		
-		/* Proceed stream pointer. */
-		stream_put (s, lsa->data, OSPF_LSA_HEADER_SIZE);
-		length += OSPF_LSA_HEADER_SIZE;
-		
-		/* Set LS age. */
-		ls_age = LS_AGE (lsa);
-		lsah->ls_age = htons (ls_age);
-		
-	      }
-	    
-	    /* Remove LSA from DB summary list. */
-	    ospf_lsdb_delete (lsdb, lsa);
-	  }
+      /* DD packet overflows interface MTU. */
+      if (length + OSPF_LSA_HEADER_SIZE > ospf_packet_max (oi))
+	break;
+
+      /* Keep pointer to LS age. */
+      lsah = (struct lsa_header *) (STREAM_DATA (s) +
+				    stream_get_endp (s));
+
+      /* Proceed stream pointer. */
+      stream_put (s, lsa->data, OSPF_LSA_HEADER_SIZE);
+      length += OSPF_LSA_HEADER_SIZE;
+
+      /* Set LS age. */
+      ls_age = LS_AGE (lsa);
+      lsah->ls_age = htons (ls_age);
+
+      /* Remove LSA from DB summary list. */
+      ospf_db_summary_advance (nbr);
     }
 
   /* Update 'More' bit */
@@ -3730,6 +3814,7 @@ ospf_ls_upd_queue_send (struct ospf_interface *oi, struct list *update,
 {
   struct ospf_packet *op;
   u_int16_t length = OSPF_HEADER_SIZE;
+  unsigned int count;
 
   if (IS_DEBUG_OSPF_EVENT)
     zlog_debug ("listcount = %d, dst %s", listcount (update), inet_ntoa(addr));
@@ -3742,7 +3827,10 @@ ospf_ls_upd_queue_send (struct ospf_interface *oi, struct list *update,
   /* Prepare OSPF Link State Update body.
    * Includes Type-7 translation. 
    */
+  count = listcount (update);
   length += ospf_make_ls_upd (oi, update, op->s);
+  oi->ls_upd_out++;
+  oi->ls_upd_lsa_out += count - listcount (update);
 
   /* Fill OSPF header. */
   ospf_fill_header (oi, op->s, length);
@@ -3763,6 +3851,17 @@ ospf_ls_upd_queue_send (struct ospf_interface *oi, struct list *update,
   OSPF_ISM_WRITE_ON (oi->ospf);
 }
 
+/* Run func on the interface once its coalescing window is over. */
+static struct thread *
+ospf_coalesce_schedule (struct ospf_interface *oi,
+			int (*func) (struct thread *))
+{
+  if (oi->ospf->ls_upd_coalesce)
+    return thread_add_timer_msec (master, func, oi,
+				  oi->ospf->ls_upd_coalesce);
+  return thread_add_event (master, func, oi, 0);
+}
+
 static int
 ospf_ls_upd_send_queue_event (struct thread *thread)
 {
@@ -3860,7 +3959,7 @@ ospf_ls_upd_send (struct ospf_neighbor *nbr, struct list *update, int flag)
 
   if (oi->t_ls_upd_event == NULL)
     oi->t_ls_upd_event =
-      thread_add_event (master, ospf_ls_upd_send_queue_event, oi, 0);
+      ospf_coalesce_schedule (oi, ospf_ls_upd_send_queue_event);
 }
 
 static void
@@ -3869,6 +3968,7 @@ ospf_ls_ack_send_list (struct ospf_interface *oi, struct list *ack,
 {
   struct ospf_packet *op;
   u_int16_t length = OSPF_HEADER_SIZE;
+  unsigned int count;
 
   op = ospf_packet_new (oi->ifp->mtu);
 
@@ -3876,7 +3976,10 @@ ospf_ls_ack_send_list (struct ospf_interface *oi, struct list *ack,
   ospf_make_header (OSPF_MSG_LS_ACK, oi, op->s);
 
   /* Prepare OSPF Link State Acknowledgment body. */
+  count = listcount (ack);
   length += ospf_make_ls_ack (oi, ack, op->s);
+  oi->ls_ack_out++;
+  oi->ls_ack_lsa_out += count - listcount (ack);
 
   /* Fill OSPF header. */
   ospf_fill_header (oi, op->s, length);
@@ -3913,6 +4016,13 @@ ospf_ls_ack_send (struct ospf_neighbor *nbr, struct ospf_lsa *lsa)
 {
   struct ospf_interface *oi = nbr->oi;
 
+  /* Acks are combined for one neighbor at a time. */
+  if (listcount (oi->ls_ack_direct.ls_ack)
+      && ! IPV4_ADDR_SAME (&oi->ls_ack_direct.dst, &nbr->address.u.prefix4))
+    while (listcount (oi->ls_ack_direct.ls_ack))
+      ospf_ls_ack_send_list (oi, oi->ls_ack_direct.ls_ack,
+			     oi->ls_ack_direct.dst);
+
   if (listcount (oi->ls_ack_direct.ls_ack) == 0)
     oi->ls_ack_direct.dst = nbr->address.u.prefix4;
   
@@ -3920,7 +4030,7 @@ ospf_ls_ack_send (struct ospf_neighbor *nbr, struct ospf_lsa *lsa)
   
   if (oi->t_ls_ack_direct == NULL)
     oi->t_ls_ack_direct =
-      thread_add_event (master, ospf_ls_ack_send_event, oi, 0);
+      ospf_coalesce_schedule (oi, ospf_ls_ack_send_event);
 }
 
 /* Send Link State Acknowledgment delayed. */
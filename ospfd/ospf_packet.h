@@ -26,6 +26,9 @@
 #define OSPF_HEADER_SIZE         24U
 #define OSPF_AUTH_SIMPLE_SIZE     8U
 #define OSPF_AUTH_MD5_SIZE       16U
+#define OSPF_AUTH_HMAC_SHA256_SIZE 32U  /* RFC 5709 */
+#define OSPF_AUTH_DIGEST_MAX_SIZE  32U
+#define OSPF_AUTH_CRYPT_KEY_SIZE   64U  /* longest key accepted */
 
 #define OSPF_MAX_PACKET_SIZE  65535U   /* includes IP Header size. */
 #define OSPF_HELLO_MIN_SIZE      20U   /* not including neighbors */
@@ -30,6 +30,7 @@
 #include "if.h"
 #include "command.h"
 #include "sockunion.h"
+#include "zclient.h"
 
 #include "ospfd/ospfd.h"
 #include "ospfd/ospf_interface.h"
@@ -126,28 +127,36 @@ ospf_route_table_free (struct route_table *rt)
    route_table_finish (rt);
 }
 
-/* If a prefix exists in the new routing table, then return 1,
-   otherwise return 0. Since the ZEBRA-RIB does an implicit
-   withdraw, it is not necessary to send a delete, an add later
-   will act like an implicit delete. */
+/* Would installing NEWOR in place of OR change anything? */
 static int
-ospf_route_exist_new_table (struct route_table *rt, struct prefix_ipv4 *prefix)
+ospf_route_same (struct ospf_route *or, struct ospf_route *newor)
 {
-  struct route_node *rn;
-
-  assert (rt);
-  assert (prefix);
-
-  rn = route_node_lookup (rt, (struct prefix *) prefix);
-  if (!rn) {
-    return 0;
-  }
-  route_unlock_node (rn);
+  struct ospf_path *op;
+  struct ospf_path *newop;
+  struct listnode *n1;
+  struct listnode *n2;
 
-  if (!rn->info) {
+  if (or->type != newor->type || or->cost != newor->cost)
     return 0;
-  }
 
+  if (or->type == OSPF_DESTINATION_NETWORK)
+    {
+      if (or->paths->count != newor->paths->count)
+	return 0;
+
+      /* Check each path. */
+      for (n1 = listhead (or->paths), n2 = listhead (newor->paths);
+	   n1 && n2; n1 = listnextnode (n1), n2 = listnextnode (n2))
+	{ 
+	  op = listgetdata (n1);
+	  newop = listgetdata (n2);
+
+	  if (! IPV4_ADDR_SAME (&op->nexthop, &newop->nexthop))
+	    return 0;
+	  if (op->ifindex != newop->ifindex)
+	    return 0;
+	}
+    }
   return 1;
 }
 
@@ -158,11 +167,6 @@ ospf_route_match_same (struct route_table *rt, struct prefix_ipv4 *prefix,
 		       struct ospf_route *newor)
 {
   struct route_node *rn;
-  struct ospf_route *or;
-  struct ospf_path *op;
-  struct ospf_path *newop;
-  struct listnode *n1;
-  struct listnode *n2;
 
   if (! rt || ! prefix)
     return 0;
@@ -173,32 +177,7 @@ ospf_route_match_same (struct route_table *rt, struct prefix_ipv4 *prefix,
  
    route_unlock_node (rn);
 
-   or = rn->info;
-   if (or->type == newor->type && or->cost == newor->cost)
-     {
-       if (or->type == OSPF_DESTINATION_NETWORK)
-	 {
-	   if (or->paths->count != newor->paths->count)
-	     return 0;
-
-	   /* Check each path. */
-	   for (n1 = listhead (or->paths), n2 = listhead (newor->paths);
-		n1 && n2; n1 = listnextnode (n1), n2 = listnextnode (n2))
-	     { 
-	       op = listgetdata (n1);
-	       newop = listgetdata (n2);
-
-	       if (! IPV4_ADDR_SAME (&op->nexthop, &newop->nexthop))
-		 return 0;
-	       if (op->ifindex != newop->ifindex)
-		 return 0;
-	     }
-	   return 1;
-	 }
-       else if (prefix_same (&rn->p, (struct prefix *) prefix))
-	 return 1;
-     }
-  return 0;
+   return ospf_route_same (rn->info, newor);
 }
 
 /* delete routes generated from AS-External routes if there is a inter/intra
@@ -234,37 +213,96 @@ ospf_route_delete_same_ext(struct route_table *external_routes,
     }
 }
 
-/* rt: Old, cmprt: New */
+/* Order of prefixes in a route table walk: a prefix comes before the
+   prefixes within it, and 0 bits before 1 bits. */
+static int
+ospf_route_prefix_cmp (struct prefix *p1, struct prefix *p2)
+{
+  u_char *a = &p1->u.prefix;
+  u_char *b = &p2->u.prefix;
+  int len = MIN (p1->prefixlen, p2->prefixlen);
+  int bytes = len / 8;
+  int ret;
+
+  if (bytes && (ret = memcmp (a, b, bytes)) != 0)
+    return ret;
+
+  if (len % 8)
+    {
+      u_char mask = 0xff << (8 - len % 8);
+
+      if ((a[bytes] & mask) != (b[bytes] & mask))
+	return (a[bytes] & mask) - (b[bytes] & mask);
+    }
+  return p1->prefixlen - p2->prefixlen;
+}
+
+static struct route_node *
+ospf_route_next_info (struct route_node *rn)
+{
+  while (rn && rn->info == NULL)
+    rn = route_next (rn);
+  return rn;
+}
+
 static void
-ospf_route_delete_uniq (struct route_table *rt, struct route_table *cmprt)
+ospf_route_zebra_add (struct route_node *rn)
 {
-  struct route_node *rn;
-  struct ospf_route *or;
+  struct ospf_route *or = rn->info;
 
-  for (rn = route_top (rt); rn; rn = route_next (rn))
-    if ((or = rn->info) != NULL) 
-      if (or->path_type == OSPF_PATH_INTRA_AREA ||
-	  or->path_type == OSPF_PATH_INTER_AREA)
-	{
-	  if (or->type == OSPF_DESTINATION_NETWORK)
-	    {
-	      if (! ospf_route_exist_new_table (cmprt,
-					   (struct prefix_ipv4 *) &rn->p))
-		ospf_zebra_delete ((struct prefix_ipv4 *) &rn->p, or);
-	    }
-	  else if (or->type == OSPF_DESTINATION_DISCARD)
-	    if (! ospf_route_exist_new_table (cmprt,
-					 (struct prefix_ipv4 *) &rn->p))
-	      ospf_zebra_delete_discard ((struct prefix_ipv4 *) &rn->p);
-	}
+  if (or->type == OSPF_DESTINATION_NETWORK)
+    ospf_zebra_add ((struct prefix_ipv4 *) &rn->p, or);
+  else if (or->type == OSPF_DESTINATION_DISCARD)
+    ospf_zebra_add_discard ((struct prefix_ipv4 *) &rn->p);
+}
+
+static void
+ospf_route_zebra_delete (struct route_node *rn)
+{
+  struct ospf_route *or = rn->info;
+
+  if (or->path_type != OSPF_PATH_INTRA_AREA &&
+      or->path_type != OSPF_PATH_INTER_AREA)
+    return;
+
+  if (or->type == OSPF_DESTINATION_NETWORK)
+    ospf_zebra_delete ((struct prefix_ipv4 *) &rn->p, or);
+  else if (or->type == OSPF_DESTINATION_DISCARD)
+    ospf_zebra_delete_discard ((struct prefix_ipv4 *) &rn->p);
 }
 
 /* Install routes to table. */
+/* Note the route of rn as changed for the ABR, see ospf_abr_task(). */
+static void
+ospf_route_abr_change (struct list *changes, struct route_node *rn)
+{
+  struct ospf_route *or = rn->info;
+  struct prefix_ipv4 *p;
+
+  /* The ABR adds discard routes for its ranges itself. */
+  if (changes == NULL || or->type == OSPF_DESTINATION_DISCARD)
+    return;
+
+  p = prefix_ipv4_new ();
+  prefix_copy ((struct prefix *) p, &rn->p);
+  listnode_add (changes, p);
+}
+
+/* Whether the summary-LSAs of an ABR for the route may differ. */
+static int
+ospf_route_abr_same (struct ospf_route *or, struct ospf_route *newor)
+{
+  return (or->path_type == newor->path_type
+	  && IPV4_ADDR_SAME (&or->u.std.area_id, &newor->u.std.area_id)
+	  && ospf_route_same (or, newor));
+}
+
 void
 ospf_route_install (struct ospf *ospf, struct route_table *rt)
 {
-  struct route_node *rn;
-  struct ospf_route *or;
+  struct route_node *rn, *old;
+  struct list *changes = NULL;
+  int cmp;
 
   /* rt contains new routing table, new_table contains an old one.
      updating pointers */
@@ -274,27 +312,63 @@ ospf_route_install (struct ospf *ospf, struct route_table *rt)
   ospf->old_table = ospf->new_table;
   ospf->new_table = rt;
 
-  /* Delete old routes. */
-  if (ospf->old_table)
-    ospf_route_delete_uniq (ospf->old_table, rt);
+  zclient_cork (zclient);
+
   if (ospf->old_external_route)
     ospf_route_delete_same_ext (ospf->old_external_route, rt);
 
-  /* Install new routes. */
-  for (rn = route_top (rt); rn; rn = route_next (rn))
-    if ((or = rn->info) != NULL)
-      {
-	if (or->type == OSPF_DESTINATION_NETWORK)
-	  {
-	    if (! ospf_route_match_same (ospf->old_table,
-					 (struct prefix_ipv4 *)&rn->p, or))
-	      ospf_zebra_add ((struct prefix_ipv4 *) &rn->p, or);
-	  }
-	else if (or->type == OSPF_DESTINATION_DISCARD)
-	  if (! ospf_route_match_same (ospf->old_table,
-				       (struct prefix_ipv4 *) &rn->p, or))
-	    ospf_zebra_add_discard ((struct prefix_ipv4 *) &rn->p);
-      }
+  /* An ABR originates summary-LSAs only for the routes which changed. */
+  if (ospf->abr_changes)
+    list_delete (ospf->abr_changes);
+  ospf->abr_changes = NULL;
+  if (IS_OSPF_ABR (ospf))
+    {
+      changes = list_new ();
+      changes->del = (void (*) (void *)) prefix_ipv4_free;
+    }
+
+  /* Both tables are walked in the same order, so one pass finds the
+     routes gone, the routes new and the routes changed, without a
+     lookup for each. */
+  old = ospf->old_table ? ospf_route_next_info (route_top (ospf->old_table))
+                        : NULL;
+  rn = ospf_route_next_info (route_top (rt));
+
+  while (old || rn)
+    {
+      if (! old)
+	cmp = 1;
+      else if (! rn)
+	cmp = -1;
+      else
+	cmp = ospf_route_prefix_cmp (&old->p, &rn->p);
+
+      if (cmp < 0)
+	{
+	  ospf_route_zebra_delete (old);
+	  ospf_route_abr_change (changes, old);
+	  old = ospf_route_next_info (route_next (old));
+	}
+      else if (cmp > 0)
+	{
+	  ospf_route_zebra_add (rn);
+	  ospf_route_abr_change (changes, rn);
+	  rn = ospf_route_next_info (route_next (rn));
+	}
+      else
+	{
+	  if (! ospf_route_same (old->info, rn->info))
+	    ospf_route_zebra_add (rn);
+	  if (! ospf_route_abr_same (old->info, rn->info))
+	    ospf_route_abr_change (changes, rn);
+	  old = ospf_route_next_info (route_next (old));
+	  rn = ospf_route_next_info (route_next (rn));
+	}
+    }
+
+  zclient_uncork (zclient);
+
+  ospf->abr_changes = changes;
 }
 
 /* RFC2328 16.1. (4). For "router". */
@@ -765,14 +839,15 @@ void
 ospf_route_copy_nexthops_from_vertex (struct ospf_route *to,
 				      struct vertex *v)
 {
-  struct listnode *node;
+  struct ilistnode *node;
   struct ospf_path *path;
   struct vertex_nexthop *nexthop;
   struct vertex_parent *vp;
 
   assert (to->paths);
 
-  for (ALL_LIST_ELEMENTS_RO (v->parents, node, vp))
+  for (ALL_ILIST_ELEMENTS_RO (&v->parents, node, vp,
+			      struct vertex_parent, node))
     {
       nexthop = vp->nexthop;
       
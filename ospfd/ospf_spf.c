@@ -20,6 +20,10 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 
 #include <zebra.h>
 
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif /* HAVE_PTHREAD */
+
 #include "thread.h"
 #include "memory.h"
 #include "hash.h"
@@ -30,6 +34,8 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #include "log.h"
 #include "sockunion.h"          /* for inet_ntop () */
 #include "pqueue.h"
+#include "spf_backoff.h"
+#include "trace.h"
 
 #include "ospfd/ospfd.h"
 #include "ospfd/ospf_interface.h"
@@ -46,12 +52,10 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #include "ospfd/ospf_abr.h"
 #include "ospfd/ospf_dump.h"
 
-static void ospf_vertex_free (void *);
-/* List of allocated vertices, to simplify cleanup of SPF.
- * Not thread-safe obviously. If it ever needs to be, it'd have to be
- * dynamically allocated at begin of ospf_spf_calculate
- */
-static struct list vertex_list = { .del = ospf_vertex_free };
+/* Extra threads to calculate the trees of areas on, see -t. */
+unsigned int ospf_spf_threads = 0;
+
+static void ospf_vertex_free (struct vertex *);
 
 /* Heap related functions, for the managment of the candidates, to
  * be used with pqueue. */
@@ -115,7 +119,7 @@ ospf_canonical_nexthops_free (struct vertex *root)
   
   for (ALL_LIST_ELEMENTS (root->children, node, nnode, child))
     {
-      struct listnode *n2, *nn2;
+      struct ilistnode *n2;
       struct vertex_parent *vp;
       
       /* router vertices through an attached network each
@@ -129,7 +133,8 @@ ospf_canonical_nexthops_free (struct vertex *root)
         ospf_canonical_nexthops_free (child);
       
       /* Free child nexthops pointing back to this root vertex */
-      for (ALL_LIST_ELEMENTS (child->parents, n2, nn2, vp))
+      for (ALL_ILIST_ELEMENTS_RO (&child->parents, n2, vp,
+                                  struct vertex_parent, node))
         if (vp->parent == root && vp->nexthop)
           vertex_nexthop_free (vp->nexthop);
     }
@@ -143,7 +148,7 @@ vertex_parent_new (struct vertex *v, int backlink, struct vertex_nexthop *hop)
 {
   struct vertex_parent *new;
   
-  new = XMALLOC (MTYPE_OSPF_VERTEX_PARENT, sizeof (struct vertex_parent));
+  new = XCALLOC (MTYPE_OSPF_VERTEX_PARENT, sizeof (struct vertex_parent));
   
   if (new == NULL)
     return NULL;
@@ -161,7 +166,7 @@ vertex_parent_free (void *p)
 }
 
 static struct vertex *
-ospf_vertex_new (struct ospf_lsa *lsa)
+ospf_vertex_new (struct ospf_area *area, struct ospf_lsa *lsa)
 {
   struct vertex *new;
 
@@ -173,10 +178,11 @@ ospf_vertex_new (struct ospf_lsa *lsa)
   new->id = lsa->data->id;
   new->lsa = lsa->data;
   new->children = list_new ();
-  new->parents = list_new ();
-  new->parents->del = vertex_parent_free;
   
-  listnode_add (&vertex_list, new);
+  /* Every vertex is kept on the area's list, so the tree can be reused
+   * by later calculations and freed in one go.
+   */
+  ilist_add (&area->spf_vertices, &new->vertex_node);
   
   if (IS_DEBUG_OSPF_EVENT)
     zlog_debug ("%s: Created %s vertex %s", __func__,
@@ -186,14 +192,14 @@ ospf_vertex_new (struct ospf_lsa *lsa)
 }
 
 static void
-ospf_vertex_free (void *data)
+ospf_vertex_free (struct vertex *v)
 {
-  struct vertex *v = data;
+  struct vertex_parent *vp;
   
   if (IS_DEBUG_OSPF_EVENT)
     zlog_debug ("%s: Free %s vertex %s", __func__,
                 v->type == OSPF_VERTEX_ROUTER ? "Router" : "Network",
-                inet_ntoa (v->lsa->id));
+                inet_ntoa (v->id));
   
   /* There should be no parents potentially holding references to this vertex
    * Children however may still be there, but presumably referenced by other
@@ -205,9 +211,12 @@ ospf_vertex_free (void *data)
     list_delete (v->children);
   v->children = NULL;
   
-  if (v->parents)
-    list_delete (v->parents);
-  v->parents = NULL;
+  while (v->parents.head)
+    {
+      vp = ilist_entry (v->parents.head, struct vertex_parent, node);
+      ilist_delete (&v->parents, &vp->node);
+      vertex_parent_free (vp);
+    }
   
   v->lsa = NULL;
   
@@ -230,10 +239,11 @@ ospf_vertex_dump(const char *msg, struct vertex *v,
 
   if (print_parents)
     {
-      struct listnode *node;
+      struct ilistnode *node;
       struct vertex_parent *vp;
       
-      for (ALL_LIST_ELEMENTS_RO (v->parents, node, vp))
+      for (ALL_ILIST_ELEMENTS_RO (&v->parents, node, vp,
+                                  struct vertex_parent, node))
         {
 	  char buf1[BUFSIZ];
 	  
@@ -263,11 +273,12 @@ static void
 ospf_vertex_add_parent (struct vertex *v)
 {
   struct vertex_parent *vp;
-  struct listnode *node;
+  struct ilistnode *node;
   
-  assert (v && v->parents);
+  assert (v);
   
-  for (ALL_LIST_ELEMENTS_RO (v->parents, node, vp))
+  for (ALL_ILIST_ELEMENTS_RO (&v->parents, node, vp,
+                              struct vertex_parent, node))
     {
       assert (vp->parent && vp->parent->children);
       
@@ -282,14 +293,13 @@ ospf_spf_init (struct ospf_area *area)
 {
   struct vertex *v;
   
+  memset (&area->spf_vertices, 0, sizeof (struct ilist));
+  memset (&area->spf_tree, 0, sizeof (struct ilist));
+
   /* Create root node. */
-  v = ospf_vertex_new (area->router_lsa_self);
+  v = ospf_vertex_new (area, area->router_lsa_self);
   
   area->spf = v;
-
-  /* Reset ABR and ASBR router counts. */
-  area->abr_count = 0;
-  area->asbr_count = 0;
 }
 
 /* return index of link back to V from W, or -1 if no link found */
@@ -403,12 +413,13 @@ static void
 ospf_spf_flush_parents (struct vertex *w)
 {
   struct vertex_parent *vp;
-  struct listnode *ln, *nn;
+  struct ilistnode *ln, *nn;
   
   /* delete the existing nexthops */
-  for (ALL_LIST_ELEMENTS (w->parents, ln, nn, vp))
+  for (ALL_ILIST_ELEMENTS (&w->parents, ln, nn, vp,
+                           struct vertex_parent, node))
     {
-      list_delete_node (w->parents, ln);
+      ilist_delete (&w->parents, ln);
       vertex_parent_free (vp);
     }
 }
@@ -423,7 +434,7 @@ ospf_spf_add_parent (struct vertex *v, struct vertex *w,
                      unsigned int distance)
 {
   struct vertex_parent *vp, *wp;
-  struct listnode *node;
+  struct ilistnode *node;
     
   /* we must have a newhop, and a distance */
   assert (v && w && newhop);
@@ -460,7 +471,8 @@ ospf_spf_add_parent (struct vertex *v, struct vertex *w,
   /* new parent is <= existing parents, add it to parent list (if nexthop
    * not on parent list)
    */  
-  for (ALL_LIST_ELEMENTS_RO(w->parents, node, wp))
+  for (ALL_ILIST_ELEMENTS_RO (&w->parents, node, wp,
+                              struct vertex_parent, node))
     {
       if (memcmp(newhop, wp->nexthop, sizeof(*newhop)) == 0)
         {
@@ -471,7 +483,7 @@ ospf_spf_add_parent (struct vertex *v, struct vertex *w,
     }
 
   vp = vertex_parent_new (v, ospf_lsa_has_link (w->lsa, v->lsa), newhop);
-  listnode_add (w->parents, vp);
+  ilist_add (&w->parents, &vp->node);
 
   return;
 }
@@ -492,7 +504,7 @@ ospf_nexthop_calculation (struct ospf_area *area, struct vertex *v,
                           struct vertex *w, struct router_lsa_link *l,
                           unsigned int distance, int lsa_pos)
 {
-  struct listnode *node, *nnode;
+  struct ilistnode *node;
   struct vertex_nexthop *nh;
   struct vertex_parent *vp;
   struct ospf_interface *oi = NULL;
@@ -522,10 +534,8 @@ ospf_nexthop_calculation (struct ospf_area *area, struct vertex *v,
       oi = ospf_if_lookup_by_lsa_pos (area, lsa_pos);
       if (!oi)
 	{
-	  zlog_debug("%s: OI not found in LSA: lsa_pos:%d link_id:%s link_data:%s",
-		     __func__, lsa_pos,
-		     inet_ntop (AF_INET, &l->link_id, buf1, BUFSIZ),
-		     inet_ntop (AF_INET, &l->link_data, buf2, BUFSIZ));
+	  area->spf_problems.no_oi++;
+	  area->spf_problems.no_oi_pos = lsa_pos;
 	  return 0;
 	}
 
@@ -618,8 +628,10 @@ ospf_nexthop_calculation (struct ospf_area *area, struct vertex *v,
                   return 1;
                 }
               else
-		zlog_info("%s: could not determine nexthop for link %s",
-			  __func__, oi->ifp->name);
+                {
+                  area->spf_problems.no_nexthop++;
+                  area->spf_problems.no_nexthop_ifp = oi->ifp;
+                }
             } /* end point-to-point link from V to W */
           else if (l->m[0].type == LSA_LINK_TYPE_VIRTUALLINK)
             {
@@ -644,8 +656,7 @@ ospf_nexthop_calculation (struct ospf_area *area, struct vertex *v,
                   return 1;
                 }
               else
-                  zlog_info("ospf_nexthop_calculation(): "
-                            "vl_data for VL link not found");
+                area->spf_problems.no_vl++;
             } /* end virtual-link from V to W */
           return 0;
         } /* end W is a Router vertex */
@@ -664,7 +675,8 @@ ospf_nexthop_calculation (struct ospf_area *area, struct vertex *v,
   else if (v->type == OSPF_VERTEX_NETWORK)
     {
       /* See if any of V's parents are the root. */
-      for (ALL_LIST_ELEMENTS (v->parents, node, nnode, vp))
+      for (ALL_ILIST_ELEMENTS_RO (&v->parents, node, vp,
+                                  struct vertex_parent, node))
         {
           if (vp->parent == area->spf) /* connects to root? */
 	    {
@@ -730,7 +742,8 @@ ospf_nexthop_calculation (struct ospf_area *area, struct vertex *v,
   if (IS_DEBUG_OSPF_EVENT)
     zlog_debug ("%s: Intervening routers, adding parent(s)", __func__);
 
-  for (ALL_LIST_ELEMENTS (v->parents, node, nnode, vp))
+  for (ALL_ILIST_ELEMENTS_RO (&v->parents, node, vp,
+                              struct vertex_parent, node))
     {
       added = 1;
       ospf_spf_add_parent (v, w, vp->nexthop, distance);
@@ -834,7 +847,8 @@ ospf_spf_next (struct vertex *v, struct ospf_area *area,
                   zlog_debug ("found the LSA");
               break;
             default:
-              zlog_warn ("Invalid LSA link type %d", type);
+              area->spf_problems.bad_link++;
+              area->spf_problems.bad_link_type = type;
               continue;
             }
         }
@@ -902,7 +916,7 @@ ospf_spf_next (struct vertex *v, struct ospf_area *area,
       if (w_lsa->stat == LSA_SPF_NOT_EXPLORED)
 	{
           /* prepare vertex W. */
-          w = ospf_vertex_new (w_lsa);
+          w = ospf_vertex_new (area, w_lsa);
 
           /* Calculate nexthop to W. */
           if (ospf_nexthop_calculation (area, v, w, l, distance, lsa_pos))
@@ -951,7 +965,7 @@ static void
 ospf_spf_dump (struct vertex *v, int i)
 {
   struct listnode *cnode;
-  struct listnode *nnode;
+  struct ilistnode *nnode;
   struct vertex_parent *parent;
 
   if (v->type == OSPF_VERTEX_ROUTER)
@@ -968,7 +982,8 @@ ospf_spf_dump (struct vertex *v, int i)
     }
 
   if (IS_DEBUG_OSPF_EVENT)
-    for (ALL_LIST_ELEMENTS_RO (v->parents, nnode, parent))
+    for (ALL_ILIST_ELEMENTS_RO (&v->parents, nnode, parent,
+                                struct vertex_parent, node))
       {
         zlog_debug (" nexthop %p %s %s", 
                     parent->nexthop,
@@ -1138,14 +1153,17 @@ ospf_rtrs_print (struct route_table *rtrs)
 }
 #endif
 
-/* Calculating the shortest-path tree for an area. */
+/* Calculating the shortest-path tree for an area.  Only reads the LSDB
+ * of the area and writes its tree, so that the trees of several areas
+ * may be calculated at once, see ospf_spf_calculate_areas.
+ */
 static void
-ospf_spf_calculate (struct ospf_area *area, struct route_table *new_table,
-                    struct route_table *new_rtrs)
+ospf_spf_calculate (struct ospf_area *area)
 {
   struct pqueue *candidate;
   struct vertex *v;
   
+  QUAGGA_TRACE (ospfd, spf_entry, area->area_id.s_addr);
   if (IS_DEBUG_OSPF_EVENT)
     {
       zlog_debug ("ospf_spf_calculate: Start");
@@ -1179,13 +1197,14 @@ ospf_spf_calculate (struct ospf_area *area, struct route_table *new_table,
      router doing the calculation). */
   ospf_spf_init (area);
   v = area->spf;
+  ilist_add (&area->spf_tree, &v->tree_node);
   /* Set LSA position to LSA_SPF_IN_SPFTREE. This vertex is the root of the
    * spanning tree. */
   *(v->stat) = LSA_SPF_IN_SPFTREE;
 
   /* Set Area A's TransitCapability to FALSE. */
   area->transit = OSPF_TRANSIT_FALSE;
-  area->shortcut_capability = 1;
+  memset (&area->spf_problems, 0, sizeof (area->spf_problems));
   
   for (;;)
     {
@@ -1209,18 +1228,90 @@ ospf_spf_calculate (struct ospf_area *area, struct route_table *new_table,
       *(v->stat) = LSA_SPF_IN_SPFTREE;
 
       ospf_vertex_add_parent (v);
+      ilist_add (&area->spf_tree, &v->tree_node);
 
-      /* RFC2328 16.1. (4). */
-      if (v->type == OSPF_VERTEX_ROUTER)
-        ospf_intra_add_router (new_rtrs, v, area);
-      else
-        ospf_intra_add_transit (new_table, v, area);
+      /* RFC2328 16.1. (4), see ospf_spf_tree_routes. */
 
       /* RFC2328 16.1. (5). */
       /* Iterate the algorithm by returning to Step 2. */
 
     } /* end loop until no more candidate vertices */
 
+  /* Free candidate queue. */
+  pqueue_delete (candidate);
+
+  /* The tree is kept, see ospf_spf_tree_free. */
+
+  /* Increment SPF Calculation Counter. */
+  area->spf_calculation++;
+
+  QUAGGA_TRACE (ospfd, spf_exit, area->area_id.s_addr,
+		area->spf_tree.count);
+  if (IS_DEBUG_OSPF_EVENT)
+    zlog_debug ("ospf_spf_calculate: Stop. %ld vertices",
+                mtype_stats_alloc(MTYPE_OSPF_VERTEX));
+}
+
+/* Log the problems met by the last calculation of the tree of an area,
+ * from the main thread.
+ */
+static void
+ospf_spf_log_problems (struct ospf_area *area)
+{
+  if (area->spf_problems.no_oi)
+    zlog_debug ("ospf_nexthop_calculation(): OI not found in LSA: "
+                "lsa_pos:%d, %u time(s)",
+                area->spf_problems.no_oi_pos, area->spf_problems.no_oi);
+  if (area->spf_problems.no_nexthop)
+    zlog_info ("ospf_nexthop_calculation(): could not determine nexthop "
+               "for link %s, %u time(s)",
+               area->spf_problems.no_nexthop_ifp->name,
+               area->spf_problems.no_nexthop);
+  if (area->spf_problems.no_vl)
+    zlog_info ("ospf_nexthop_calculation(): "
+               "vl_data for VL link not found, %u time(s)",
+               area->spf_problems.no_vl);
+  if (area->spf_problems.bad_link)
+    zlog_warn ("Invalid LSA link type %d, %u time(s)",
+               area->spf_problems.bad_link_type,
+               area->spf_problems.bad_link);
+
+  memset (&area->spf_problems, 0, sizeof (area->spf_problems));
+}
+
+/* Add the routes to the vertices of the tree of an area, in the order
+ * they were added to it, then those to the stub networks.
+ */
+static void
+ospf_spf_tree_routes (struct ospf_area *area, struct route_table *new_table,
+                      struct route_table *new_rtrs)
+{
+  struct ilistnode *node;
+  struct vertex *v;
+
+  if (area->spf == NULL)
+    return;
+
+  ospf_spf_log_problems (area);
+
+  area->abr_count = 0;
+  area->asbr_count = 0;
+  area->shortcut_capability = 1;
+
+  for (ALL_ILIST_ELEMENTS_RO (&area->spf_tree, node, v,
+                              struct vertex, tree_node))
+    {
+      UNSET_FLAG (v->flags, OSPF_VERTEX_PROCESSED);
+      if (v == area->spf)
+        continue;
+
+      /* RFC2328 16.1. (4). */
+      if (v->type == OSPF_VERTEX_ROUTER)
+        ospf_intra_add_router (new_rtrs, v, area);
+      else
+        ospf_intra_add_transit (new_table, v, area);
+    }
+
   if (IS_DEBUG_OSPF_EVENT)
     {
       ospf_spf_dump (area->spf, 0);
@@ -1230,39 +1321,502 @@ ospf_spf_calculate (struct ospf_area *area, struct route_table *new_table,
   /* Second stage of SPF calculation procedure's  */
   ospf_spf_process_stubs (area, area->spf, new_table, 0);
 
-  /* Free candidate queue. */
-  pqueue_delete (candidate);
-  
   ospf_vertex_dump (__func__, area->spf, 0, 1);
+}
+
+/* Free the shortest-path tree kept from the last calculation of an area. */
+void
+ospf_spf_tree_free (struct ospf_area *area)
+{
+  struct ilistnode *node, *nnode;
+  struct vertex *v;
+
+  if (area->spf == NULL)
+    return;
+
   /* Free nexthop information, canonical versions of which are attached
    * the first level of router vertices attached to the root vertex, see
    * ospf_nexthop_calculation.
    */
-  ospf_canonical_nexthops_free (area->spf);
-  
-  /* Free SPF vertices, but not the list. List has ospf_vertex_free
-   * as deconstructor.
-   */
-  list_delete_all_node (&vertex_list);
-  
-  /* Increment SPF Calculation Counter. */
-  area->spf_calculation++;
+  if (area->spf)
+    ospf_canonical_nexthops_free (area->spf);
+
+  /* Free SPF vertices, the tree is a subset of them. */
+  for (ALL_ILIST_ELEMENTS (&area->spf_vertices, node, nnode, v,
+                           struct vertex, vertex_node))
+    ospf_vertex_free (v);
+  memset (&area->spf_vertices, 0, sizeof (struct ilist));
+  memset (&area->spf_tree, 0, sizeof (struct ilist));
+  area->spf = NULL;
+}
 
-  quagga_gettime (QUAGGA_CLK_MONOTONIC, &area->ospf->ts_spf);
+static void
+ospf_spf_tree_free_all (struct ospf *ospf)
+{
+  struct listnode *node;
+  struct ospf_area *area;
 
-  if (IS_DEBUG_OSPF_EVENT)
-    zlog_debug ("ospf_spf_calculate: Stop. %ld vertices",
-                mtype_stats_alloc(MTYPE_OSPF_VERTEX));
+  for (ALL_LIST_ELEMENTS_RO (ospf->areas, node, area))
+    ospf_spf_tree_free (area);
 }
-
+
+static struct vertex *
+ospf_spf_tree_lookup (struct ospf_area *area, u_char type, struct in_addr id)
+{
+  struct ilistnode *node;
+  struct vertex *v;
+
+  for (ALL_ILIST_ELEMENTS_RO (&area->spf_tree, node, v,
+                              struct vertex, tree_node))
+    if (v->type == type && IPV4_ADDR_SAME (&v->id, &id))
+      return v;
+  return NULL;
+}
+
+/* Is the vertex of given type and ID a parent or a child of V? */
+static int
+ospf_spf_tree_adjacent (struct vertex *v, u_char type, struct in_addr id)
+{
+  struct listnode *node;
+  struct ilistnode *pnode;
+  struct vertex *w;
+  struct vertex_parent *vp;
+
+  for (ALL_LIST_ELEMENTS_RO (v->children, node, w))
+    if (w->type == type && IPV4_ADDR_SAME (&w->id, &id))
+      return 1;
+  for (ALL_ILIST_ELEMENTS_RO (&v->parents, pnode, vp,
+                              struct vertex_parent, node))
+    if (vp->parent->type == type && IPV4_ADDR_SAME (&vp->parent->id, &id))
+      return 1;
+  return 0;
+}
+
+/* Find link L, by type, ID and data, in router-LSA LSA. */
+static struct router_lsa_link *
+ospf_spf_link_lookup (struct lsa_header *lsa, struct router_lsa_link *l)
+{
+  u_char *p;
+  u_char *lim;
+  struct router_lsa_link *m;
+
+  p = ((u_char *) lsa) + OSPF_LSA_HEADER_SIZE + 4;
+  lim = ((u_char *) lsa) + ntohs (lsa->length);
+
+  while (p < lim)
+    {
+      m = (struct router_lsa_link *) p;
+      p += (OSPF_ROUTER_LSA_LINK_SIZE +
+            (m->m[0].tos_count * OSPF_ROUTER_LSA_TOS_SIZE));
+
+      if (m->m[0].type == l->m[0].type
+          && IPV4_ADDR_SAME (&m->link_id, &l->link_id)
+          && IPV4_ADDR_SAME (&m->link_data, &l->link_data))
+        return m;
+    }
+  return NULL;
+}
+
+/* Stub links may change freely, they are only looked at by the second
+ * stage.  Transit links may only go away or get more expensive, and only
+ * where they are not an edge of the tree.
+ */
+static int
+ospf_spf_router_lsa_keeps_tree (struct vertex *v, struct lsa_header *old,
+                                struct lsa_header *new)
+{
+  struct router_lsa *orl = (struct router_lsa *) old;
+  struct router_lsa *nrl = (struct router_lsa *) new;
+  struct router_lsa_link *l, *m;
+  u_char *p;
+  u_char *lim;
+
+  if (old->options != new->options || orl->flags != nrl->flags)
+    return 0;
+
+  p = ((u_char *) new) + OSPF_LSA_HEADER_SIZE + 4;
+  lim = ((u_char *) new) + ntohs (new->length);
+  while (p < lim)
+    {
+      l = (struct router_lsa_link *) p;
+      p += (OSPF_ROUTER_LSA_LINK_SIZE +
+            (l->m[0].tos_count * OSPF_ROUTER_LSA_TOS_SIZE));
+
+      if (l->m[0].type != LSA_LINK_TYPE_STUB
+          && ospf_spf_link_lookup (old, l) == NULL)
+        return 0;
+    }
+
+  p = ((u_char *) old) + OSPF_LSA_HEADER_SIZE + 4;
+  lim = ((u_char *) old) + ntohs (old->length);
+  while (p < lim)
+    {
+      l = (struct router_lsa_link *) p;
+      p += (OSPF_ROUTER_LSA_LINK_SIZE +
+            (l->m[0].tos_count * OSPF_ROUTER_LSA_TOS_SIZE));
+
+      if (l->m[0].type == LSA_LINK_TYPE_STUB)
+        continue;
+
+      m = ospf_spf_link_lookup (new, l);
+      if (m && ntohs (m->m[0].metric) == ntohs (l->m[0].metric))
+        continue;
+      if (m && ntohs (m->m[0].metric) < ntohs (l->m[0].metric))
+        return 0;
+
+      if (v && ospf_spf_tree_adjacent (v,
+                                       l->m[0].type == LSA_LINK_TYPE_TRANSIT
+                                       ? OSPF_VERTEX_NETWORK
+                                       : OSPF_VERTEX_ROUTER,
+                                       l->link_id))
+        return 0;
+    }
+  return 1;
+}
+
+/* Attached routers may only go away, and only where not an edge of the
+ * tree.
+ */
+static int
+ospf_spf_network_lsa_keeps_tree (struct vertex *v, struct lsa_header *old,
+                                 struct lsa_header *new)
+{
+  struct network_lsa *onl = (struct network_lsa *) old;
+  struct network_lsa *nnl = (struct network_lsa *) new;
+  unsigned int i, j, olen, nlen;
+
+  if (old->options != new->options
+      || onl->mask.s_addr != nnl->mask.s_addr)
+    return 0;
+
+  olen = (ntohs (old->length) - OSPF_LSA_HEADER_SIZE - 4) / 4;
+  nlen = (ntohs (new->length) - OSPF_LSA_HEADER_SIZE - 4) / 4;
+
+  for (i = 0; i < nlen; i++)
+    {
+      for (j = 0; j < olen; j++)
+        if (IPV4_ADDR_SAME (&nnl->routers[i], &onl->routers[j]))
+          break;
+      if (j == olen)
+        return 0;
+    }
+
+  for (j = 0; j < olen; j++)
+    {
+      for (i = 0; i < nlen; i++)
+        if (IPV4_ADDR_SAME (&nnl->routers[i], &onl->routers[j]))
+          break;
+      if (i == nlen && v
+          && ospf_spf_tree_adjacent (v, OSPF_VERTEX_ROUTER, onl->routers[j]))
+        return 0;
+    }
+  return 1;
+}
+
+/* Router- or network-LSA NEW is about to replace OLD in the LSDB of
+ * AREA.  If NEW can neither add nor shorten a path, and leaves all edges
+ * of the area's shortest-path tree alone, the tree still is one and the
+ * next calculation replays it rather than running Dijkstra again.
+ * Otherwise the tree is dropped.
+ */
+void
+ospf_spf_tree_check (struct ospf_area *area, struct ospf_lsa *old,
+                     struct ospf_lsa *new)
+{
+  struct vertex *v;
+  int keep = 0;
+
+  if (area == NULL || area->spf == NULL)
+    return;
+
+  if (old && !IS_LSA_MAXAGE (old) && !IS_LSA_MAXAGE (new))
+    {
+      v = ospf_spf_tree_lookup (area, new->data->type, new->data->id);
+
+      switch (new->data->type)
+        {
+        case OSPF_ROUTER_LSA:
+          keep = ospf_spf_router_lsa_keeps_tree (v, old->data, new->data);
+          break;
+        case OSPF_NETWORK_LSA:
+          /* The tree may use another instance with the same ID. */
+          if (ospf_lsa_lookup_by_id (area, OSPF_NETWORK_LSA,
+                                     new->data->id) == old)
+            keep = ospf_spf_network_lsa_keeps_tree (v, old->data, new->data);
+          break;
+        default:
+          break;
+        }
+    }
+
+  if (!keep)
+    {
+      if (IS_DEBUG_OSPF_EVENT)
+        zlog_debug ("%s: area %s needs full SPF", __func__,
+                    inet_ntoa (area->area_id));
+      ospf_spf_tree_free (area);
+    }
+}
+
+/* Bring the tree kept from the last calculation of an area up to date
+ * with its LSDB.  Returns 0 if the tree can not be used any more.
+ */
+static int
+ospf_spf_tree_replay (struct ospf_area *area)
+{
+  struct ilistnode *node, *pnode;
+  struct vertex *v;
+  struct vertex_parent *vp;
+  struct ospf_lsa *lsa;
+
+  if (!area->router_lsa_self)
+    return 0;
+
+  /* The LSAs of the tree may have been replaced since it was built. */
+  for (ALL_ILIST_ELEMENTS_RO (&area->spf_tree, node, v,
+                              struct vertex, tree_node))
+    {
+      if (v == area->spf)
+        lsa = area->router_lsa_self;
+      else
+        lsa = ospf_lsa_lookup_by_id (area, v->type, v->id);
+
+      if (lsa == NULL || IS_LSA_MAXAGE (lsa))
+        return 0;
+
+      v->lsa = lsa->data;
+      v->stat = &(lsa->stat);
+      *(v->stat) = LSA_SPF_IN_SPFTREE;
+    }
+
+  for (ALL_ILIST_ELEMENTS_RO (&area->spf_tree, node, v,
+                              struct vertex, tree_node))
+    for (ALL_ILIST_ELEMENTS_RO (&v->parents, pnode, vp,
+                                struct vertex_parent, node))
+      vp->backlink = ospf_lsa_has_link (v->lsa, vp->parent->lsa);
+
+  area->spf_incremental++;
+
+  return 1;
+}
+
+#ifdef HAVE_PTHREAD
+/* Worker pool calculating the trees of several areas at once.  While a
+ * batch runs the main thread takes areas off it too and then waits, so
+ * nothing else touches the LSDBs meanwhile.
+ */
+struct ospf_spf_workers
+{
+  unsigned int count;
+  pthread_t *threads;
+
+  /* Batch hand-out.  A new generation starts the workers, pending
+     counts those not done with it yet, next is the first area of the
+     batch not taken yet. */
+  pthread_mutex_t mtx;
+  pthread_cond_t start;
+  pthread_cond_t done;
+  unsigned int generation;
+  unsigned int pending;
+  struct ospf_area **batch;
+  unsigned int batch_size;
+  unsigned int batch_count;
+  unsigned int next;
+};
+
+static struct ospf_spf_workers ospf_spf_workers;
+
+/* Calculate the trees of the current batch, until none is left. */
+static void
+ospf_spf_batch_work (void)
+{
+  struct ospf_spf_workers *w = &ospf_spf_workers;
+  struct ospf_area *area;
+
+  for (;;)
+    {
+      pthread_mutex_lock (&w->mtx);
+      area = w->next < w->batch_count ? w->batch[w->next++] : NULL;
+      pthread_mutex_unlock (&w->mtx);
+
+      if (area == NULL)
+        return;
+      ospf_spf_calculate (area);
+    }
+}
+
+static void *
+ospf_spf_worker (void *arg)
+{
+  struct ospf_spf_workers *w = &ospf_spf_workers;
+  unsigned int generation = 0;
+
+  pthread_mutex_lock (&w->mtx);
+  while (1)
+    {
+      while (w->generation == generation)
+        pthread_cond_wait (&w->start, &w->mtx);
+      generation = w->generation;
+      pthread_mutex_unlock (&w->mtx);
+
+      ospf_spf_batch_work ();
+
+      pthread_mutex_lock (&w->mtx);
+      if (--w->pending == 0)
+        pthread_cond_signal (&w->done);
+    }
+  return NULL;
+}
+
+/* Start the workers.  Done on first use rather than at startup, as
+ * threads do not survive daemon().  Returns 0 if none could be started.
+ */
+static int
+ospf_spf_workers_start (void)
+{
+  struct ospf_spf_workers *w = &ospf_spf_workers;
+  sigset_t all, old;
+  unsigned int i;
+  int ret;
+
+  w->threads = XCALLOC (MTYPE_OSPF_SPF_WORKERS,
+                        ospf_spf_threads * sizeof (pthread_t));
+  pthread_mutex_init (&w->mtx, NULL);
+  pthread_cond_init (&w->start, NULL);
+  pthread_cond_init (&w->done, NULL);
+
+  /* Signals are for the main thread to handle. */
+  sigfillset (&all);
+  pthread_sigmask (SIG_SETMASK, &all, &old);
+  for (i = 0; i < ospf_spf_threads; i++)
+    {
+      ret = pthread_create (&w->threads[i], NULL, ospf_spf_worker, NULL);
+      if (ret)
+        {
+          zlog_err ("%s: could not start SPF worker thread: %s",
+                    __func__, safe_strerror (ret));
+          break;
+        }
+    }
+  pthread_sigmask (SIG_SETMASK, &old, NULL);
+
+  w->count = i;
+  if (w->count)
+    zlog_info ("SPF runs on %u worker threads besides the main one",
+               w->count);
+
+  /* Do not try again. */
+  ospf_spf_threads = w->count;
+  return w->count;
+}
+
+/* Queue the calculation of the tree of an area for ospf_spf_batch_run.
+ * Returns 0 if it is to be done right away instead: when there are no
+ * workers to share it with, or when debugging, which is not thread-safe.
+ */
+static int
+ospf_spf_batch_add (struct ospf_area *area)
+{
+  struct ospf_spf_workers *w = &ospf_spf_workers;
+
+  if (! ospf_spf_threads || IS_DEBUG_OSPF_EVENT)
+    return 0;
+
+  if (w->batch_count == w->batch_size)
+    {
+      w->batch_size = w->batch_size ? w->batch_size * 2 : 8;
+      w->batch = XREALLOC (MTYPE_OSPF_SPF_WORKERS, w->batch,
+                           w->batch_size * sizeof (struct ospf_area *));
+    }
+  w->batch[w->batch_count++] = area;
+  return 1;
+}
+
+/* Calculate the trees of the queued areas on the worker pool. */
+static void
+ospf_spf_batch_run (void)
+{
+  struct ospf_spf_workers *w = &ospf_spf_workers;
+  unsigned int i;
+
+  if (w->batch_count < 2 || (! w->count && ! ospf_spf_workers_start ()))
+    {
+      for (i = 0; i < w->batch_count; i++)
+        ospf_spf_calculate (w->batch[i]);
+      w->batch_count = 0;
+      return;
+    }
+
+  memory_threads (1);
+
+  pthread_mutex_lock (&w->mtx);
+  w->next = 0;
+  w->pending = w->count;
+  w->generation++;
+  pthread_cond_broadcast (&w->start);
+  pthread_mutex_unlock (&w->mtx);
+
+  ospf_spf_batch_work ();
+
+  pthread_mutex_lock (&w->mtx);
+  while (w->pending)
+    pthread_cond_wait (&w->done, &w->mtx);
+  pthread_mutex_unlock (&w->mtx);
+
+  memory_threads (0);
+
+  w->batch_count = 0;
+}
+#endif /* HAVE_PTHREAD */
+
+/* Calculate the trees of either the non-backbone areas or the backbone,
+ * reusing those which are still good and calculating the others at
+ * once, then add their routes one area after the other.
+ */
+static void
+ospf_spf_calculate_areas (struct ospf *ospf, int backbone,
+                          struct route_table *new_table,
+                          struct route_table *new_rtrs)
+{
+  struct listnode *node;
+  struct ospf_area *area;
+
+  for (ALL_LIST_ELEMENTS_RO (ospf->areas, node, area))
+    {
+      if ((area == ospf->backbone) != backbone)
+        continue;
+
+      if (area->spf && ospf_spf_tree_replay (area))
+        {
+          if (IS_DEBUG_OSPF_EVENT)
+            zlog_debug ("ospf_spf_calculate: reused tree of area %s",
+                        inet_ntoa (area->area_id));
+          continue;
+        }
+
+      ospf_spf_tree_free (area);
+#ifdef HAVE_PTHREAD
+      if (ospf_spf_batch_add (area))
+        continue;
+#endif /* HAVE_PTHREAD */
+      ospf_spf_calculate (area);
+    }
+
+#ifdef HAVE_PTHREAD
+  ospf_spf_batch_run ();
+#endif /* HAVE_PTHREAD */
+
+  for (ALL_LIST_ELEMENTS_RO (ospf->areas, node, area))
+    if ((area == ospf->backbone) == backbone)
+      ospf_spf_tree_routes (area, new_table, new_rtrs);
+}
+
 /* Timer for SPF calculation. */
 static int
 ospf_spf_calculate_timer (struct thread *thread)
 {
   struct ospf *ospf = THREAD_ARG (thread);
   struct route_table *new_table, *new_rtrs;
-  struct ospf_area *area;
-  struct listnode *node, *nnode;
 
   if (IS_DEBUG_OSPF_EVENT)
     zlog_debug ("SPF: Timer (SPF calculation expire)");
@@ -1275,22 +1829,17 @@ ospf_spf_calculate_timer (struct thread *thread)
 
   ospf_vl_unapprove (ospf);
 
-  /* Calculate SPF for each area. */
-  for (ALL_LIST_ELEMENTS (ospf->areas, node, nnode, area))
-    {
-      /* Do backbone last, so as to first discover intra-area paths
-       * for any back-bone virtual-links
-       */
-      if (ospf->backbone && ospf->backbone == area)
-        continue;
-      
-      ospf_spf_calculate (area, new_table, new_rtrs);
-    }
-  
+  /* Calculate SPF for each area.  Do backbone last, so as to first
+   * discover intra-area paths for any back-bone virtual-links.
+   */
+  ospf_spf_calculate_areas (ospf, 0, new_table, new_rtrs);
+
   /* SPF for backbone, if required */
   if (ospf->backbone)
-    ospf_spf_calculate (ospf->backbone, new_table, new_rtrs);
-  
+    ospf_spf_calculate_areas (ospf, 1, new_table, new_rtrs);
+
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &ospf->ts_spf);
+
   ospf_vl_shut_unapproved (ospf);
 
   ospf_ia_routing (ospf, new_table, new_rtrs);
@@ -1331,29 +1880,24 @@ ospf_spf_calculate_timer (struct thread *thread)
 }
 
 /* Add schedule for SPF calculation.  To avoid frequenst SPF calc, we
-   set timer for SPF calc. */
+   set timer for SPF calc.  Trees of areas are recalculated from
+   scratch. */
 void
 ospf_spf_calculate_schedule (struct ospf *ospf)
+{
+  if (ospf)
+    ospf_spf_tree_free_all (ospf);
+
+  ospf_spf_calculate_schedule_incremental (ospf);
+}
+
+/* Delay of the classic adaptive hold-time throttle. */
+static unsigned long
+ospf_spf_throttle_delay (struct ospf *ospf)
 {
   unsigned long delay, elapsed, ht;
   struct timeval result;
 
-  if (IS_DEBUG_OSPF_EVENT)
-    zlog_debug ("SPF: calculation timer scheduled");
-
-  /* OSPF instance does not exist. */
-  if (ospf == NULL)
-    return;
-  
-  /* SPF calculation timer is already scheduled. */
-  if (ospf->t_spf_calc)
-    {
-      if (IS_DEBUG_OSPF_EVENT)
-        zlog_debug ("SPF: calculation timer is already scheduled: %p",
-                   ospf->t_spf_calc);
-      return;
-    }
-  
   /* XXX Monotic timers: we only care about relative time here. */
   result = tv_sub (recent_relative_time (), ospf->ts_spf);
   
@@ -1385,6 +1929,39 @@ ospf_spf_calculate_schedule (struct ospf *ospf)
       delay = ospf->spf_delay;
       ospf->spf_hold_multiplier = 1;
     }
+
+  return delay;
+}
+
+/* Likewise, but keep the trees that ospf_spf_tree_check let stand. */
+void
+ospf_spf_calculate_schedule_incremental (struct ospf *ospf)
+{
+  unsigned long delay = 0;
+
+  if (IS_DEBUG_OSPF_EVENT)
+    zlog_debug ("SPF: calculation timer scheduled");
+
+  /* OSPF instance does not exist. */
+  if (ospf == NULL)
+    return;
+
+  /* The back-off state machine sees every event, including those
+     absorbed by an already scheduled calculation. */
+  if (ospf->spf_delay_ietf)
+    delay = spf_backoff_event (ospf->spf_delay_ietf);
+  
+  /* SPF calculation timer is already scheduled. */
+  if (ospf->t_spf_calc)
+    {
+      if (IS_DEBUG_OSPF_EVENT)
+        zlog_debug ("SPF: calculation timer is already scheduled: %p",
+                   ospf->t_spf_calc);
+      return;
+    }
+  
+  if (!ospf->spf_delay_ietf)
+    delay = ospf_spf_throttle_delay (ospf);
   
   if (IS_DEBUG_OSPF_EVENT)
     zlog_debug ("SPF: calculation timer delay = %ld", delay);
@@ -41,8 +41,10 @@ struct vertex
   struct lsa_header *lsa; /* Router or Network LSA */
   int *stat;		/* Link to LSA status. */
   u_int32_t distance;	/* from root to this vertex */  
-  struct list *parents;		/* list of parents in SPF tree */
+  struct ilist parents;		/* list of parents in SPF tree */
   struct list *children;	/* list of children in SPF tree*/
+  struct ilistnode vertex_node;	/* on the area's spf_vertices */
+  struct ilistnode tree_node;	/* on the area's spf_tree */
 };
 
 /* A nexthop taken on the root node to get to this (parent) vertex */
@@ -57,9 +59,16 @@ struct vertex_parent
   struct vertex_nexthop *nexthop; /* link to nexthop info for this parent */
   struct vertex *parent;	/* parent vertex */
   int backlink;			/* index back to parent for router-lsa's */
+  struct ilistnode node;	/* on the parents of the child vertex */
 };
 
+extern unsigned int ospf_spf_threads;
+
 extern void ospf_spf_calculate_schedule (struct ospf *);
+extern void ospf_spf_calculate_schedule_incremental (struct ospf *);
+extern void ospf_spf_tree_check (struct ospf_area *, struct ospf_lsa *,
+                                 struct ospf_lsa *);
+extern void ospf_spf_tree_free (struct ospf_area *);
 extern void ospf_rtrs_free (struct route_table *);
 
 /* void ospf_spf_calculate_timer_add (); */
@@ -31,6 +31,8 @@
 #include "plist.h"
 #include "log.h"
 #include "zclient.h"
+#include "pqueue.h"
+#include "spf_backoff.h"
 
 #include "ospfd/ospfd.h"
 #include "ospfd/ospf_asbr.h"
@@ -2295,7 +2297,94 @@ ALIAS_DEPRECATED (no_ospf_timers_throttle_spf,
                   NO_STR
                   "Adjust routing timers\n"
                   "OSPF SPF timers\n")
+
+DEFUN (ospf_spf_delay_ietf,
+       ospf_spf_delay_ietf_cmd,
+       "spf-delay-ietf init-delay <0-60000> short-delay <0-60000> "
+       "long-delay <0-60000> holddown <0-60000> time-to-learn <0-60000>",
+       "IETF SPF delay algorithm (RFC 8405)\n"
+       "Delay used while in QUIET state\n"
+       "Delay (msec)\n"
+       "Delay used while in SHORT_WAIT state\n"
+       "Delay (msec)\n"
+       "Delay used while in LONG_WAIT state\n"
+       "Delay (msec)\n"
+       "Time with no received IGP events before considering IGP stable\n"
+       "Time (msec)\n"
+       "Maximum duration needed to learn all the events related to a "
+       "single failure\n"
+       "Time (msec)\n")
+{
+  struct ospf *ospf = vty->index;
+  unsigned int init_delay, short_delay, long_delay, holddown, ttl;
+
+  VTY_GET_INTEGER_RANGE ("init-delay", init_delay, argv[0], 0, 60000);
+  VTY_GET_INTEGER_RANGE ("short-delay", short_delay, argv[1], 0, 60000);
+  VTY_GET_INTEGER_RANGE ("long-delay", long_delay, argv[2], 0, 60000);
+  VTY_GET_INTEGER_RANGE ("holddown", holddown, argv[3], 0, 60000);
+  VTY_GET_INTEGER_RANGE ("time-to-learn", ttl, argv[4], 0, 60000);
+
+  if (ospf->spf_delay_ietf)
+    spf_backoff_free (ospf->spf_delay_ietf);
+  ospf->spf_delay_ietf = spf_backoff_new (init_delay, short_delay,
+                                          long_delay, holddown, ttl);
+  return CMD_SUCCESS;
+}
+
+DEFUN (no_ospf_spf_delay_ietf,
+       no_ospf_spf_delay_ietf_cmd,
+       "no spf-delay-ietf",
+       NO_STR
+       "IETF SPF delay algorithm (RFC 8405)\n")
+{
+  struct ospf *ospf = vty->index;
+
+  if (ospf->spf_delay_ietf)
+    {
+      spf_backoff_free (ospf->spf_delay_ietf);
+      ospf->spf_delay_ietf = NULL;
+    }
+  return CMD_SUCCESS;
+}
 
+DEFUN (ospf_timers_lsa_coalesce,
+       ospf_timers_lsa_coalesce_cmd,
+       "timers lsa coalesce <0-1000>",
+       "Adjust routing timers\n"
+       "OSPF LSA timers\n"
+       "Window over which LS Updates and Acks to send are packed together\n"
+       "Window (msec)\n")
+{
+  struct ospf *ospf = vty->index;
+
+  VTY_GET_INTEGER_RANGE ("LSA coalescing window", ospf->ls_upd_coalesce,
+			 argv[0], 0, 1000);
+  return CMD_SUCCESS;
+}
+
+DEFUN (no_ospf_timers_lsa_coalesce,
+       no_ospf_timers_lsa_coalesce_cmd,
+       "no timers lsa coalesce",
+       NO_STR
+       "Adjust routing timers\n"
+       "OSPF LSA timers\n"
+       "Window over which LS Updates and Acks to send are packed together\n")
+{
+  struct ospf *ospf = vty->index;
+
+  ospf->ls_upd_coalesce = 0;
+  return CMD_SUCCESS;
+}
+
+ALIAS (no_ospf_timers_lsa_coalesce,
+       no_ospf_timers_lsa_coalesce_val_cmd,
+       "no timers lsa coalesce <0-1000>",
+       NO_STR
+       "Adjust routing timers\n"
+       "OSPF LSA timers\n"
+       "Window over which LS Updates and Acks to send are packed together\n"
+       "Window (msec)\n")
+
 DEFUN (ospf_neighbor,
        ospf_neighbor_cmd,
        "neighbor A.B.C.D",
@@ -2475,6 +2564,39 @@ ALIAS (no_ospf_refresh_timer,
        "Adjust refresh parameters\n"
        "Unset refresh timer\n")
 
+DEFUN (ospf_refresh_rate, ospf_refresh_rate_cmd,
+       "refresh rate <1-100000>",
+       "Adjust refresh parameters\n"
+       "Limit the rate of LSA refreshes\n"
+       "Self-originated LSAs refreshed per second\n")
+{
+  struct ospf *ospf = vty->index;
+
+  VTY_GET_INTEGER_RANGE ("refresh rate", ospf->lsa_refresh_rate, argv[0],
+			 1, 100000);
+  return CMD_SUCCESS;
+}
+
+DEFUN (no_ospf_refresh_rate, no_ospf_refresh_rate_cmd,
+       "no refresh rate",
+       NO_STR
+       "Adjust refresh parameters\n"
+       "Limit the rate of LSA refreshes\n")
+{
+  struct ospf *ospf = vty->index;
+
+  ospf->lsa_refresh_rate = 0;
+  return CMD_SUCCESS;
+}
+
+ALIAS (no_ospf_refresh_rate,
+       no_ospf_refresh_rate_val_cmd,
+       "no refresh rate <1-100000>",
+       NO_STR
+       "Adjust refresh parameters\n"
+       "Limit the rate of LSA refreshes\n"
+       "Self-originated LSAs refreshed per second\n")
+
 DEFUN (ospf_auto_cost_reference_bandwidth,
        ospf_auto_cost_reference_bandwidth_cmd,
        "auto-cost reference-bandwidth <1-4294967>",
@@ -2642,6 +2764,8 @@ show_ip_ospf_area (struct vty *vty, struct ospf_area *area)
   /* Show SPF calculation times. */
   vty_out (vty, "   SPF algorithm executed %d times%s",
 	   area->spf_calculation, VTY_NEWLINE);
+  vty_out (vty, "   SPF tree reused %d times%s",
+	   area->spf_incremental, VTY_NEWLINE);
 
   /* Show number of LSA. */
   vty_out (vty, "   Number of LSA %ld%s", area->lsdb->total, VTY_NEWLINE);
@@ -2732,14 +2856,27 @@ DEFUN (show_ip_ospf,
     }
   
   /* Show SPF timers. */
-  vty_out (vty, " Initial SPF scheduling delay %d millisec(s)%s"
-                " Minimum hold time between consecutive SPFs %d millisec(s)%s"
-                " Maximum hold time between consecutive SPFs %d millisec(s)%s"
-                " Hold time multiplier is currently %d%s",
-	  ospf->spf_delay, VTY_NEWLINE,
-	  ospf->spf_holdtime, VTY_NEWLINE,
-	  ospf->spf_max_holdtime, VTY_NEWLINE,
-	  ospf->spf_hold_multiplier, VTY_NEWLINE);
+  if (ospf->spf_delay_ietf)
+    {
+      struct spf_backoff *backoff = ospf->spf_delay_ietf;
+
+      vty_out (vty, " SPF delay per RFC 8405, state %s%s"
+                    "   Init delay %u, short delay %u, long delay %u msec%s"
+                    "   Holddown %u, time to learn %u msec%s",
+               spf_backoff_state_str (backoff), VTY_NEWLINE,
+               backoff->init_delay, backoff->short_delay,
+               backoff->long_delay, VTY_NEWLINE,
+               backoff->holddown, backoff->time_to_learn, VTY_NEWLINE);
+    }
+  else
+    vty_out (vty, " Initial SPF scheduling delay %d millisec(s)%s"
+                  " Minimum hold time between consecutive SPFs %d millisec(s)%s"
+                  " Maximum hold time between consecutive SPFs %d millisec(s)%s"
+                  " Hold time multiplier is currently %d%s",
+             ospf->spf_delay, VTY_NEWLINE,
+             ospf->spf_holdtime, VTY_NEWLINE,
+             ospf->spf_max_holdtime, VTY_NEWLINE,
+             ospf->spf_hold_multiplier, VTY_NEWLINE);
   vty_out (vty, " SPF algorithm ");
   if (ospf->ts_spf.tv_sec || ospf->ts_spf.tv_usec)
     {
@@ -2758,6 +2895,13 @@ DEFUN (show_ip_ospf,
   /* Show refresh parameters. */
   vty_out (vty, " Refresh timer %d secs%s",
 	   ospf->lsa_refresh_interval, VTY_NEWLINE);
+  if (ospf->ls_upd_coalesce)
+    vty_out (vty, " LS Updates and Acks coalesced over %u msecs%s",
+	     ospf->ls_upd_coalesce, VTY_NEWLINE);
+  if (ospf->lsa_refresh_rate)
+    vty_out (vty, " Refresh rate %u LSAs per second, %u LSAs waiting%s",
+	     ospf->lsa_refresh_rate, listcount (ospf->lsa_refresh_backlog),
+	     VTY_NEWLINE);
 	   
   /* Show ABR/ASBR flags. */
   if (CHECK_FLAG (ospf->flags, OSPF_FLAG_ABR))
@@ -2954,6 +3098,15 @@ show_ip_ospf_interface_sub (struct vty *vty, struct ospf *ospf,
       vty_out (vty, "  Neighbor Count is %d, Adjacent neighbor count is %d%s",
 	       ospf_nbr_count (oi, 0), ospf_nbr_count (oi, NSM_Full),
 	       VTY_NEWLINE);
+
+      vty_out (vty, "  LS Updates sent %u, %u LSAs, %u per packet%s",
+	       oi->ls_upd_out, oi->ls_upd_lsa_out,
+	       oi->ls_upd_out ? oi->ls_upd_lsa_out / oi->ls_upd_out : 0,
+	       VTY_NEWLINE);
+      vty_out (vty, "  LS Acks sent %u, %u LSAs, %u per packet%s",
+	       oi->ls_ack_out, oi->ls_ack_lsa_out,
+	       oi->ls_ack_out ? oi->ls_ack_lsa_out / oi->ls_ack_out : 0,
+	       VTY_NEWLINE);
     }
 }
 
@@ -4054,6 +4207,65 @@ show_ip_ospf_database_maxage (struct vty *vty, struct ospf *ospf)
     }
 }
 
+static void
+show_ip_ospf_database_statistics_lsdb (struct vty *vty,
+				       struct ospf_lsdb *lsdb, time_t now)
+{
+  struct ospf_lsa *lsa;
+  int type;
+
+  for (type = OSPF_MIN_LSA; type < OSPF_MAX_LSA; type++)
+    if (ospf_lsdb_count (lsdb, type) > 0)
+      vty_out (vty, "  %-28s %8lu (%lu self-originated)%s",
+	       show_database_desc[type], ospf_lsdb_count (lsdb, type),
+	       ospf_lsdb_count_self (lsdb, type), VTY_NEWLINE);
+  vty_out (vty, "  %-28s %8lu%s", "Total", ospf_lsdb_count_all (lsdb),
+	   VTY_NEWLINE);
+
+  if (lsdb->expiry == NULL)
+    return;
+  vty_out (vty, "  Expiry queue %d LSAs", lsdb->expiry->size);
+  if (lsdb->expiry->size > 0)
+    {
+      lsa = lsdb->expiry->array[0];
+      vty_out (vty, ", next due in %ld sec",
+	       lsa->expiry > now ? (long) (lsa->expiry - now) : 0L);
+    }
+  vty_out (vty, "%s", VTY_NEWLINE);
+}
+
+static void
+show_ip_ospf_database_statistics (struct vty *vty, struct ospf *ospf)
+{
+  struct ospf_area *area;
+  struct listnode *node;
+  struct route_node *rn;
+  unsigned long maxage = 0;
+  time_t now = recent_relative_time ().tv_sec;
+
+  for (ALL_LIST_ELEMENTS_RO (ospf->areas, node, area))
+    {
+      vty_out (vty, "                LSDB Statistics (Area %s)%s%s",
+	       ospf_area_desc_string (area), VTY_NEWLINE, VTY_NEWLINE);
+      show_ip_ospf_database_statistics_lsdb (vty, area->lsdb, now);
+      vty_out (vty, "%s", VTY_NEWLINE);
+    }
+
+  vty_out (vty, "                LSDB Statistics (AS)%s%s",
+	   VTY_NEWLINE, VTY_NEWLINE);
+  show_ip_ospf_database_statistics_lsdb (vty, ospf->lsdb, now);
+  vty_out (vty, "%s", VTY_NEWLINE);
+
+  for (rn = route_top (ospf->maxage_lsa); rn; rn = route_next (rn))
+    if (rn->info)
+      maxage++;
+  vty_out (vty, "  MaxAge list %lu LSAs%s", maxage, VTY_NEWLINE);
+  vty_out (vty, "  MaxAge walker %lu runs, %lu LSAs dequeued, "
+	   "%lu aged out%s", ospf->maxage_walker_runs,
+	   ospf->maxage_walker_seen, ospf->maxage_walker_aged, VTY_NEWLINE);
+  vty_out (vty, "%s", VTY_NEWLINE);
+}
+
 #define OSPF_LSA_TYPE_NSSA_DESC      "NSSA external link state\n"
 #define OSPF_LSA_TYPE_NSSA_CMD_STR   "|nssa-external"
 
@@ -4132,6 +4344,11 @@ DEFUN (show_ip_ospf_database,
       show_ip_ospf_database_summary (vty, ospf, 1);
       return CMD_SUCCESS;
     }
+  else if (strncmp (argv[0], "st", 2) == 0)
+    {
+      show_ip_ospf_database_statistics (vty, ospf);
+      return CMD_SUCCESS;
+    }
   else if (strncmp (argv[0], "m", 1) == 0)
     {
       show_ip_ospf_database_maxage (vty, ospf);
@@ -4180,14 +4397,15 @@ DEFUN (show_ip_ospf_database,
 
 ALIAS (show_ip_ospf_database,
        show_ip_ospf_database_type_cmd,
-       "show ip ospf database (" OSPF_LSA_TYPES_CMD_STR "|max-age|self-originate)",
+       "show ip ospf database (" OSPF_LSA_TYPES_CMD_STR "|max-age|self-originate|statistics)",
        SHOW_STR
        IP_STR
        "OSPF information\n"
        "Database summary\n"
        OSPF_LSA_TYPES_DESC
        "LSAs in MaxAge list\n"
-       "Self-originated link states\n")
+       "Self-originated link states\n"
+       "LSDB and LSA aging statistics\n")
 
 ALIAS (show_ip_ospf_database,
        show_ip_ospf_database_type_id_cmd,
@@ -4570,16 +4788,9 @@ ALIAS (no_ip_ospf_authentication_key,
        "OSPF interface commands\n"
        "Authentication password (key)\n")
 
-DEFUN (ip_ospf_message_digest_key,
-       ip_ospf_message_digest_key_addr_cmd,
-       "ip ospf message-digest-key <1-255> md5 KEY A.B.C.D",
-       "IP Information\n"
-       "OSPF interface commands\n"
-       "Message digest authentication password (key)\n"
-       "Key ID\n"
-       "Use MD5 algorithm\n"
-       "The OSPF password (key)"
-       "Address of interface")
+static int
+ospf_vty_message_digest_key_set (struct vty *vty, int argc, const char **argv,
+				 u_char algo)
 {
   struct interface *ifp;
   struct crypt_key *ck;
@@ -4614,8 +4825,11 @@ DEFUN (ip_ospf_message_digest_key,
 
   ck = ospf_crypt_key_new ();
   ck->key_id = (u_char) key_id;
-  memset (ck->auth_key, 0, OSPF_AUTH_MD5_SIZE+1);
-  strncpy ((char *) ck->auth_key, argv[1], OSPF_AUTH_MD5_SIZE);
+  ck->algo = algo;
+  memset (ck->auth_key, 0, OSPF_AUTH_CRYPT_KEY_SIZE+1);
+  strncpy ((char *) ck->auth_key, argv[1],
+	   algo == OSPF_CRYPT_MD5 ? OSPF_AUTH_MD5_SIZE
+				  : OSPF_AUTH_CRYPT_KEY_SIZE);
 
   ospf_crypt_key_add (params->auth_crypt, ck);
   SET_IF_PARAM (params, auth_crypt);
@@ -4623,6 +4837,20 @@ DEFUN (ip_ospf_message_digest_key,
   return CMD_SUCCESS;
 }
 
+DEFUN (ip_ospf_message_digest_key,
+       ip_ospf_message_digest_key_addr_cmd,
+       "ip ospf message-digest-key <1-255> md5 KEY A.B.C.D",
+       "IP Information\n"
+       "OSPF interface commands\n"
+       "Message digest authentication password (key)\n"
+       "Key ID\n"
+       "Use MD5 algorithm\n"
+       "The OSPF password (key)"
+       "Address of interface")
+{
+  return ospf_vty_message_digest_key_set (vty, argc, argv, OSPF_CRYPT_MD5);
+}
+
 ALIAS (ip_ospf_message_digest_key,
        ip_ospf_message_digest_key_cmd,
        "ip ospf message-digest-key <1-255> md5 KEY",
@@ -4642,6 +4870,31 @@ ALIAS (ip_ospf_message_digest_key,
        "Use MD5 algorithm\n"
        "The OSPF password (key)")
 
+DEFUN (ip_ospf_message_digest_key_hmac_sha256,
+       ip_ospf_message_digest_key_hmac_sha256_addr_cmd,
+       "ip ospf message-digest-key <1-255> hmac-sha-256 KEY A.B.C.D",
+       "IP Information\n"
+       "OSPF interface commands\n"
+       "Message digest authentication password (key)\n"
+       "Key ID\n"
+       "Use HMAC-SHA-256 algorithm (RFC 5709)\n"
+       "The OSPF password (key)\n"
+       "Address of interface")
+{
+  return ospf_vty_message_digest_key_set (vty, argc, argv,
+					  OSPF_CRYPT_HMAC_SHA256);
+}
+
+ALIAS (ip_ospf_message_digest_key_hmac_sha256,
+       ip_ospf_message_digest_key_hmac_sha256_cmd,
+       "ip ospf message-digest-key <1-255> hmac-sha-256 KEY",
+       "IP Information\n"
+       "OSPF interface commands\n"
+       "Message digest authentication password (key)\n"
+       "Key ID\n"
+       "Use HMAC-SHA-256 algorithm (RFC 5709)\n"
+       "The OSPF password (key)\n")
+
 DEFUN (no_ip_ospf_message_digest_key,
        no_ip_ospf_message_digest_key_addr_cmd,
        "no ip ospf message-digest-key <1-255> A.B.C.D",
@@ -7521,8 +7774,10 @@ config_write_interface (struct vty *vty)
 	/* Cryptographic Authentication Key print. */
 	for (ALL_LIST_ELEMENTS_RO (params->auth_crypt, n2, ck))
 	  {
-	    vty_out (vty, " ip ospf message-digest-key %d md5 %s",
-		     ck->key_id, ck->auth_key);
+	    vty_out (vty, " ip ospf message-digest-key %d %s %s",
+		     ck->key_id,
+		     ck->algo == OSPF_CRYPT_HMAC_SHA256 ? "hmac-sha-256" : "md5",
+		     ck->auth_key);
 	    if (params != IF_DEF_PARAMS (ifp))
 	      vty_out (vty, " %s", inet_ntoa (rn->p.u.prefix4));
 	    vty_out (vty, "%s", VTY_NEWLINE);
@@ -8023,6 +8278,18 @@ ospf_config_write (struct vty *vty)
 	vty_out (vty, " timers throttle spf %d %d %d%s",
 		 ospf->spf_delay, ospf->spf_holdtime,
 		 ospf->spf_max_holdtime, VTY_NEWLINE);
+      if (ospf->spf_delay_ietf)
+	vty_out (vty, " spf-delay-ietf init-delay %u short-delay %u "
+		 "long-delay %u holddown %u time-to-learn %u%s",
+		 ospf->spf_delay_ietf->init_delay,
+		 ospf->spf_delay_ietf->short_delay,
+		 ospf->spf_delay_ietf->long_delay,
+		 ospf->spf_delay_ietf->holddown,
+		 ospf->spf_delay_ietf->time_to_learn, VTY_NEWLINE);
+
+      if (ospf->ls_upd_coalesce)
+	vty_out (vty, " timers lsa coalesce %u%s",
+		 ospf->ls_upd_coalesce, VTY_NEWLINE);
       
       /* Max-metric router-lsa print */
       config_write_stub_router (vty, ospf);
@@ -8031,6 +8298,9 @@ ospf_config_write (struct vty *vty)
       if (ospf->lsa_refresh_interval != OSPF_LSA_REFRESH_INTERVAL_DEFAULT)
 	vty_out (vty, " refresh timer %d%s",
 		 ospf->lsa_refresh_interval, VTY_NEWLINE);
+      if (ospf->lsa_refresh_rate)
+	vty_out (vty, " refresh rate %u%s",
+		 ospf->lsa_refresh_rate, VTY_NEWLINE);
 
       /* Redistribute information print. */
       config_write_ospf_redistribute (vty, ospf);
@@ -8185,6 +8455,8 @@ ospf_vty_if_init (void)
   /* "ip ospf message-digest-key" commands. */
   install_element (INTERFACE_NODE, &ip_ospf_message_digest_key_addr_cmd);
   install_element (INTERFACE_NODE, &ip_ospf_message_digest_key_cmd);
+  install_element (INTERFACE_NODE, &ip_ospf_message_digest_key_hmac_sha256_addr_cmd);
+  install_element (INTERFACE_NODE, &ip_ospf_message_digest_key_hmac_sha256_cmd);
   install_element (INTERFACE_NODE, &no_ip_ospf_message_digest_key_addr_cmd);
   install_element (INTERFACE_NODE, &no_ip_ospf_message_digest_key_cmd);
 
@@ -8496,11 +8768,19 @@ ospf_vty_init (void)
   install_element (OSPF_NODE, &no_ospf_timers_spf_cmd);
   install_element (OSPF_NODE, &ospf_timers_throttle_spf_cmd);
   install_element (OSPF_NODE, &no_ospf_timers_throttle_spf_cmd);
+  install_element (OSPF_NODE, &ospf_spf_delay_ietf_cmd);
+  install_element (OSPF_NODE, &no_ospf_spf_delay_ietf_cmd);
+  install_element (OSPF_NODE, &ospf_timers_lsa_coalesce_cmd);
+  install_element (OSPF_NODE, &no_ospf_timers_lsa_coalesce_cmd);
+  install_element (OSPF_NODE, &no_ospf_timers_lsa_coalesce_val_cmd);
   
   /* refresh timer commands */
   install_element (OSPF_NODE, &ospf_refresh_timer_cmd);
   install_element (OSPF_NODE, &no_ospf_refresh_timer_val_cmd);
   install_element (OSPF_NODE, &no_ospf_refresh_timer_cmd);
+  install_element (OSPF_NODE, &ospf_refresh_rate_cmd);
+  install_element (OSPF_NODE, &no_ospf_refresh_rate_cmd);
+  install_element (OSPF_NODE, &no_ospf_refresh_rate_val_cmd);
   
   /* max-metric commands */
   install_element (OSPF_NODE, &ospf_max_metric_router_lsa_admin_cmd);
@@ -34,6 +34,7 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #include "zclient.h"
 #include "plist.h"
 #include "sockopt.h"
+#include "spf_backoff.h"
 
 #include "ospfd/ospfd.h"
 #include "ospfd/ospf_network.h"
@@ -171,6 +172,9 @@ ospf_new (void)
   new->nbr_nbma = route_table_init ();
 
   new->lsdb = ospf_lsdb_new ();
+  ospf_lsdb_expiry_init (new->lsdb);
+  ospf_ls_rxmt_init (new);
+  new->abr_full = 1;
 
   new->default_originate = DEFAULT_ORIGINATE_NONE;
 
@@ -214,6 +218,7 @@ ospf_new (void)
   new->t_lsa_refresher = thread_add_timer (master, ospf_lsa_refresh_walker,
 					   new, new->lsa_refresh_interval);
   new->lsa_refresher_started = quagga_time (NULL);
+  new->lsa_refresh_backlog = list_new ();
 
   if ((new->fd = ospf_sock_init()) < 0)
     {
@@ -225,12 +230,13 @@ ospf_new (void)
   if (IS_DEBUG_OSPF (zebra, ZEBRA_INTERFACE))
     zlog_debug ("%s: starting with OSPF send buffer size %u",
       __func__, new->maxsndbuflen);
-  if ((new->ibuf = stream_new(OSPF_MAX_PACKET_SIZE+1)) == NULL)
-    {
-      zlog_err("ospf_new: fatal error: stream_new(%u) failed allocating ibuf",
-	       OSPF_MAX_PACKET_SIZE+1);
-      exit(1);
-    }
+  for (i = 0; i < OSPF_READ_BATCH; i++)
+    if ((new->ibuf[i] = stream_new(OSPF_MAX_PACKET_SIZE+1)) == NULL)
+      {
+	zlog_err("ospf_new: fatal error: stream_new(%u) failed allocating ibuf",
+		 OSPF_MAX_PACKET_SIZE+1);
+	exit(1);
+      }
   new->t_read = thread_add_read (master, ospf_read, new, new->fd);
   new->oi_write_q = list_new ();
   
@@ -483,14 +489,19 @@ ospf_finish_final (struct ospf *ospf)
   OSPF_TIMER_OFF (ospf->t_asbr_check);
   OSPF_TIMER_OFF (ospf->t_distribute_update);
   OSPF_TIMER_OFF (ospf->t_lsa_refresher);
+  OSPF_TIMER_OFF (ospf->t_lsa_refresh_pace);
   OSPF_TIMER_OFF (ospf->t_read);
   OSPF_TIMER_OFF (ospf->t_write);
 #ifdef HAVE_OPAQUE_LSA
   OSPF_TIMER_OFF (ospf->t_opaque_lsa_self);
 #endif
 
+  if (ospf->spf_delay_ietf)
+    spf_backoff_free (ospf->spf_delay_ietf);
+
   close (ospf->fd);
-  stream_free(ospf->ibuf);
+  for (i = 0; i < OSPF_READ_BATCH; i++)
+    stream_free(ospf->ibuf[i]);
    
 #ifdef HAVE_OPAQUE_LSA
   LSDB_LOOP (OPAQUE_AS_LSDB (ospf), rn, lsa)
@@ -515,6 +526,13 @@ ospf_finish_final (struct ospf *ospf)
     }
   route_table_finish (ospf->maxage_lsa);
 
+  for (ALL_LIST_ELEMENTS (ospf->lsa_refresh_backlog, node, nnode, lsa))
+    {
+      lsa->refresh_list = -1;
+      ospf_lsa_unlock (&lsa); /* lsa_refresh_backlog */
+    }
+  list_delete (ospf->lsa_refresh_backlog);
+
   if (ospf->old_table)
     ospf_route_table_free (ospf->old_table);
   if (ospf->new_table)
@@ -558,6 +576,10 @@ ospf_finish_final (struct ospf *ospf)
   ospf_distance_reset (ospf);
   route_table_finish (ospf->distance_table);
 
+  ospf_ls_rxmt_finish (ospf);
+  if (ospf->abr_changes)
+    list_delete (ospf->abr_changes);
+
   ospf_delete (ospf);
 
   XFREE (MTYPE_OSPF_TOP, ospf);
@@ -583,6 +605,7 @@ ospf_area_new (struct ospf *ospf, struct in_addr area_id)
   
   /* New LSDB init. */
   new->lsdb = ospf_lsdb_new ();
+  ospf_lsdb_expiry_init (new->lsdb);
 
   /* Self-originated LSAs initialize. */
   new->router_lsa_self = NULL;
@@ -606,6 +629,8 @@ ospf_area_free (struct ospf_area *area)
   struct route_node *rn;
   struct ospf_lsa *lsa;
 
+  ospf_spf_tree_free (area);
+
   /* Free LSDBs. */
   LSDB_LOOP (ROUTER_LSDB (area), rn, lsa)
     ospf_discard_from_db (area->ospf, area->lsdb, lsa);
@@ -26,6 +26,7 @@
 #include <zebra.h>
 
 #include "filter.h"
+#include "linklist.h"
 #include "log.h"
 
 #define OSPF_VERSION            2
@@ -47,6 +48,10 @@
 #define OSPF_IP_TTL             1
 #define OSPF_VL_IP_TTL          100
 
+/* Packets taken per system call on the OSPF socket. */
+#define OSPF_READ_BATCH         16
+#define OSPF_WRITE_BATCH        32
+
 /* Default configuration file name for ospfd. */
 #define OSPF_DEFAULT_CONFIG   "ospfd.conf"
 
@@ -206,6 +211,8 @@ struct ospf
   unsigned int spf_holdtime;		/* SPF hold time. */
   unsigned int spf_max_holdtime;	/* SPF maximum-holdtime */
   unsigned int spf_hold_multiplier;	/* Adaptive multiplier for hold time */
+  struct spf_backoff *spf_delay_ietf;	/* RFC 8405 back-off, replaces the
+					   above when set. */
   
   int default_originate;		/* Default information originate. */
 #define DEFAULT_ORIGINATE_NONE		0
@@ -223,6 +230,9 @@ struct ospf
 
   /* LSDB of AS-external-LSAs. */
   struct ospf_lsdb *lsdb;
+
+  /* Neighbor retransmission list entries, see ospf_flood.c. */
+  struct hash *ls_rxmt;
   
   /* Flags. */
   int external_origin;			/* AS-external-LSA origin flag. */
@@ -249,6 +259,13 @@ struct ospf
   struct timeval ts_spf;		/* SPF calculation time stamp. */
 
   struct route_table *maxage_lsa;       /* List of MaxAge LSA for deletion. */
+
+  /* Prefixes whose routes the last calculation changed, and whether
+     the next ospf_abr_task() has to look at all routes anyway. */
+  struct list *abr_changes;
+  int abr_full;
+  int abr_bb_connection;
+
   int redistribute;                     /* Num of redistributed protocols. */
 
   /* Threads. */
@@ -267,6 +284,9 @@ struct ospf
   struct thread *t_maxage;              /* MaxAge LSA remover timer. */
 #define OSPF_LSA_MAXAGE_CHECK_INTERVAL		30
   struct thread *t_maxage_walker;       /* MaxAge LSA checking timer. */
+  unsigned long maxage_walker_runs;	/* Runs of the MaxAge walker, */
+  unsigned long maxage_walker_seen;	/* LSAs it dequeued, */
+  unsigned long maxage_walker_aged;	/* and of those, LSAs aged out. */
 
   struct thread *t_deferred_shutdown;	/* deferred/stub-router shutdown timer*/
 
@@ -274,7 +294,7 @@ struct ospf
   struct thread *t_read;
   int fd;
   unsigned int maxsndbuflen;
-  struct stream *ibuf;
+  struct stream *ibuf[OSPF_READ_BATCH];
   struct list *oi_write_q;
   
   /* Distribute lists out of other route sources. */
@@ -318,6 +338,20 @@ struct ospf
   time_t lsa_refresher_started;
 #define OSPF_LSA_REFRESH_INTERVAL_DEFAULT 10
   u_int16_t lsa_refresh_interval;
+
+  /* Window over which the LS Updates and direct LS Acks queued on an
+     interface are coalesced before being packed and sent, in msec.  If
+     0, until the end of the current event. */
+  u_int32_t ls_upd_coalesce;
+
+  /* LSAs due for refresh, refreshed at most lsa_refresh_rate a second
+     if that is set, see ospf_lsa_refresh_pace().  Their refresh_list
+     is OSPF_LSA_REFRESH_BACKLOG. */
+#define OSPF_LSA_REFRESH_BACKLOG OSPF_LSA_REFRESHER_SLOTS
+#define OSPF_LSA_REFRESH_PACE_MSEC 100
+  struct list *lsa_refresh_backlog;
+  struct thread *t_lsa_refresh_pace;
+  u_int32_t lsa_refresh_rate;
   
   /* Distance parameter. */
   u_char distance_all;
@@ -389,6 +423,9 @@ struct ospf_area
 #define OSPF_AREA_ADMIN_STUB_ROUTED	(1 << 0) /* admin stub-router set */
 #define OSPF_AREA_IS_STUB_ROUTED	(1 << 1) /* stub-router active */
 #define OSPF_AREA_WAS_START_STUB_ROUTED	(1 << 2) /* startup SR was done */
+
+  /* Transit and stub-router state the ABR last originated for. */
+  u_char abr_state;
   
   /* Area related LSDBs[Type1-4]. */
   struct ospf_lsdb *lsdb;
@@ -436,6 +473,21 @@ struct ospf_area
 
   /* Shortest Path Tree. */
   struct vertex *spf;
+  struct ilist spf_vertices;	/* Vertices of the last calculation. */
+  struct ilist spf_tree;	/* Tree vertices, in order of addition. */
+
+  /* Problems met by the last calculation of the tree.  It may run on a
+     worker thread, so they are logged afterwards by the main thread. */
+  struct
+  {
+    u_int32_t no_oi;		/* Links of ours without an interface. */
+    int no_oi_pos;
+    u_int32_t no_nexthop;	/* Point-to-point links without a nexthop. */
+    struct interface *no_nexthop_ifp;
+    u_int32_t no_vl;		/* Virtual links without their data. */
+    u_int32_t bad_link;		/* Links of an unknown type. */
+    int bad_link_type;
+  } spf_problems;
 
   /* Threads. */
   struct thread *t_stub_router;    /* Stub-router timer */
@@ -445,6 +497,7 @@ struct ospf_area
 
   /* Statistics field. */
   u_int32_t spf_calculation;	/* SPF Calculation Count. */
+  u_int32_t spf_incremental;	/* SPF runs that reused the tree. */
 
   /* Router count. */
   u_int32_t abr_count;		/* ABR router in this area. */
@@ -41,7 +41,7 @@ struct rip_offset_list
   struct 
   {
     char *alist_name;
-    /* struct access_list *alist; */
+    struct access_list *alist;	/* resolved by rip_offset_list_update */
     int metric;
   } direct[RIP_OFFSET_LIST_MAX];
 };
@@ -136,6 +136,7 @@ rip_offset_list_set (struct vty *vty, const char *alist, const char *direct_str,
   if (offset->direct[direct].alist_name)
     free (offset->direct[direct].alist_name);
   offset->direct[direct].alist_name = strdup (alist);
+  offset->direct[direct].alist = access_list_lookup (AFI_IP, alist);
   offset->direct[direct].metric = metric;
 
   return CMD_SUCCESS;
@@ -177,6 +178,7 @@ rip_offset_list_unset (struct vty *vty, const char *alist,
       if (offset->direct[direct].alist_name)
 	free (offset->direct[direct].alist_name);
       offset->direct[direct].alist_name = NULL;
+      offset->direct[direct].alist = NULL;
 
       if (offset->direct[RIP_OFFSET_LIST_IN].alist_name == NULL &&
 	  offset->direct[RIP_OFFSET_LIST_OUT].alist_name == NULL)
@@ -196,11 +198,28 @@ rip_offset_list_unset (struct vty *vty, const char *alist,
 }
 
 #define OFFSET_LIST_IN_NAME(O)  ((O)->direct[RIP_OFFSET_LIST_IN].alist_name)
+#define OFFSET_LIST_IN_ALIST(O)  ((O)->direct[RIP_OFFSET_LIST_IN].alist)
 #define OFFSET_LIST_IN_METRIC(O)  ((O)->direct[RIP_OFFSET_LIST_IN].metric)
 
 #define OFFSET_LIST_OUT_NAME(O)  ((O)->direct[RIP_OFFSET_LIST_OUT].alist_name)
+#define OFFSET_LIST_OUT_ALIST(O)  ((O)->direct[RIP_OFFSET_LIST_OUT].alist)
 #define OFFSET_LIST_OUT_METRIC(O)  ((O)->direct[RIP_OFFSET_LIST_OUT].metric)
 
+/* Resolve the access-lists of all offset-lists again, after an
+   access-list was added or deleted. */
+void
+rip_offset_list_update (void)
+{
+  struct listnode *node;
+  struct rip_offset_list *offset;
+  int direct;
+
+  for (ALL_LIST_ELEMENTS_RO (rip_offset_list_master, node, offset))
+    for (direct = 0; direct < RIP_OFFSET_LIST_MAX; direct++)
+      offset->direct[direct].alist = offset->direct[direct].alist_name ?
+	access_list_lookup (AFI_IP, offset->direct[direct].alist_name) : NULL;
+}
+
 /* If metric is modifed return 1. */
 int
 rip_offset_list_apply_in (struct prefix_ipv4 *p, struct interface *ifp,
@@ -213,7 +232,7 @@ rip_offset_list_apply_in (struct prefix_ipv4 *p, struct interface *ifp,
   offset = rip_offset_list_lookup (ifp->name);
   if (offset && OFFSET_LIST_IN_NAME (offset))
     {
-      alist = access_list_lookup (AFI_IP, OFFSET_LIST_IN_NAME (offset));
+      alist = OFFSET_LIST_IN_ALIST (offset);
 
       if (alist 
 	  && access_list_apply (alist, (struct prefix *)p) == FILTER_PERMIT)
@@ -227,7 +246,7 @@ rip_offset_list_apply_in (struct prefix_ipv4 *p, struct interface *ifp,
   offset = rip_offset_list_lookup (NULL);
   if (offset && OFFSET_LIST_IN_NAME (offset))
     {
-      alist = access_list_lookup (AFI_IP, OFFSET_LIST_IN_NAME (offset));
+      alist = OFFSET_LIST_IN_ALIST (offset);
 
       if (alist 
 	  && access_list_apply (alist, (struct prefix *)p) == FILTER_PERMIT)
@@ -252,7 +271,7 @@ rip_offset_list_apply_out (struct prefix_ipv4 *p, struct interface *ifp,
   offset = rip_offset_list_lookup (ifp->name);
   if (offset && OFFSET_LIST_OUT_NAME (offset))
     {
-      alist = access_list_lookup (AFI_IP, OFFSET_LIST_OUT_NAME (offset));
+      alist = OFFSET_LIST_OUT_ALIST (offset);
 
       if (alist 
 	  && access_list_apply (alist, (struct prefix *)p) == FILTER_PERMIT)
@@ -267,7 +286,7 @@ rip_offset_list_apply_out (struct prefix_ipv4 *p, struct interface *ifp,
   offset = rip_offset_list_lookup (NULL);
   if (offset && OFFSET_LIST_OUT_NAME (offset))
     {
-      alist = access_list_lookup (AFI_IP, OFFSET_LIST_OUT_NAME (offset));
+      alist = OFFSET_LIST_OUT_ALIST (offset);
 
       if (alist 
 	  && access_list_apply (alist, (struct prefix *)p) == FILTER_PERMIT)
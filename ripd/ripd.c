@@ -115,24 +115,58 @@ rip_info_new (void)
   return XCALLOC (MTYPE_RIP_INFO, sizeof (struct rip_info));
 }
 
+/* Set the route change flag and queue the route on rip->changed, so
+   that triggered updates need not walk the whole table. */
+static void
+rip_info_changed (struct rip_info *rinfo)
+{
+  if (rinfo->flags & RIP_RTF_CHANGED)
+    return;
+
+  rinfo->flags |= RIP_RTF_CHANGED;
+  rinfo->changed_prev = NULL;
+  rinfo->changed_next = rip->changed;
+  if (rip->changed)
+    rip->changed->changed_prev = rinfo;
+  rip->changed = rinfo;
+}
+
+/* Clear the route change flag and unlink the route from rip->changed. */
+static void
+rip_info_unchanged (struct rip_info *rinfo)
+{
+  if (! (rinfo->flags & RIP_RTF_CHANGED))
+    return;
+
+  if (rinfo->changed_prev)
+    rinfo->changed_prev->changed_next = rinfo->changed_next;
+  else
+    rip->changed = rinfo->changed_next;
+  if (rinfo->changed_next)
+    rinfo->changed_next->changed_prev = rinfo->changed_prev;
+
+  rinfo->changed_next = rinfo->changed_prev = NULL;
+  rinfo->flags &= ~RIP_RTF_CHANGED;
+}
+
 void
 rip_info_free (struct rip_info *rinfo)
 {
+  rip_info_unchanged (rinfo);
   XFREE (MTYPE_RIP_INFO, rinfo);
 }
 
 /* RIP route garbage collect timer. */
 static int
-rip_garbage_collect (struct thread *t)
+rip_garbage_collect (struct wheel_timer *t)
 {
   struct rip_info *rinfo;
   struct route_node *rp;
 
-  rinfo = THREAD_ARG (t);
-  rinfo->t_garbage_collect = NULL;
+  rinfo = WHEEL_ARG (t);
 
   /* Off timeout timer. */
-  RIP_TIMER_OFF (rinfo->t_timeout);
+  RIP_ROUTE_TIMER_OFF (rinfo->t_timeout);
   
   /* Get route_node pointer. */
   rp = rinfo->rp;
@@ -149,18 +183,17 @@ rip_garbage_collect (struct thread *t)
 
 /* Timeout RIP routes. */
 static int
-rip_timeout (struct thread *t)
+rip_timeout (struct wheel_timer *t)
 {
   struct rip_info *rinfo;
   struct route_node *rn;
 
-  rinfo = THREAD_ARG (t);
-  rinfo->t_timeout = NULL;
+  rinfo = WHEEL_ARG (t);
 
   rn = rinfo->rp;
 
   /* - The garbage-collection timer is set for 120 seconds. */
-  RIP_TIMER_ON (rinfo->t_garbage_collect, rip_garbage_collect, 
+  RIP_ROUTE_TIMER_ON (rinfo->t_garbage_collect, rip_garbage_collect, 
 		rip->garbage_time);
 
   rip_zebra_ipv4_delete ((struct prefix_ipv4 *)&rn->p, &rinfo->nexthop,
@@ -172,7 +205,7 @@ rip_timeout (struct thread *t)
 
   /* - The route change flag is to indicate that this entry has been
      changed. */
-  rinfo->flags |= RIP_RTF_CHANGED;
+  rip_info_changed (rinfo);
 
   /* - The output process is signalled to trigger a response. */
   rip_event (RIP_TRIGGERED_UPDATE, 0);
@@ -183,151 +216,49 @@ rip_timeout (struct thread *t)
 static void
 rip_timeout_update (struct rip_info *rinfo)
 {
+  /* Re-arming only moves the timer to another bucket */
   if (rinfo->metric != RIP_METRIC_INFINITY)
-    {
-      RIP_TIMER_OFF (rinfo->t_timeout);
-      RIP_TIMER_ON (rinfo->t_timeout, rip_timeout, rip->timeout_time);
-    }
+    wheel_timer_on (rip->wheel, &rinfo->t_timeout, rip_timeout, rinfo,
+                    rip->timeout_time);
 }
 
-static int
-rip_incoming_filter (struct prefix_ipv4 *p, struct rip_interface *ri)
-{
-  struct distribute *dist;
-  struct access_list *alist;
-  struct prefix_list *plist;
-
-  /* Input distribute-list filtering. */
-  if (ri->list[RIP_FILTER_IN])
-    {
-      if (access_list_apply (ri->list[RIP_FILTER_IN], 
-			     (struct prefix *) p) == FILTER_DENY)
-	{
-	  if (IS_RIP_DEBUG_PACKET)
-	    zlog_debug ("%s/%d filtered by distribute in",
-		       inet_ntoa (p->prefix), p->prefixlen);
-	  return -1;
-	}
-    }
-  if (ri->prefix[RIP_FILTER_IN])
-    {
-      if (prefix_list_apply (ri->prefix[RIP_FILTER_IN], 
-			     (struct prefix *) p) == PREFIX_DENY)
-	{
-	  if (IS_RIP_DEBUG_PACKET)
-	    zlog_debug ("%s/%d filtered by prefix-list in",
-		       inet_ntoa (p->prefix), p->prefixlen);
-	  return -1;
-	}
-    }
-
-  /* All interface filter check. */
-  dist = distribute_lookup (NULL);
-  if (dist)
-    {
-      if (dist->list[DISTRIBUTE_IN])
-	{
-	  alist = access_list_lookup (AFI_IP, dist->list[DISTRIBUTE_IN]);
-	    
-	  if (alist)
-	    {
-	      if (access_list_apply (alist,
-				     (struct prefix *) p) == FILTER_DENY)
-		{
-		  if (IS_RIP_DEBUG_PACKET)
-		    zlog_debug ("%s/%d filtered by distribute in",
-			       inet_ntoa (p->prefix), p->prefixlen);
-		  return -1;
-		}
-	    }
-	}
-      if (dist->prefix[DISTRIBUTE_IN])
-	{
-	  plist = prefix_list_lookup (AFI_IP, dist->prefix[DISTRIBUTE_IN]);
-	  
-	  if (plist)
-	    {
-	      if (prefix_list_apply (plist,
-				     (struct prefix *) p) == PREFIX_DENY)
-		{
-		  if (IS_RIP_DEBUG_PACKET)
-		    zlog_debug ("%s/%d filtered by prefix-list in",
-			       inet_ntoa (p->prefix), p->prefixlen);
-		  return -1;
-		}
-	    }
-	}
-    }
-  return 0;
-}
+/* The lists of the distribute-list that applies to all interfaces,
+   resolved by rip_distribute_update like those in rip_interface, so
+   that filtering a route never looks a list up by name. */
+static struct access_list *rip_all_list[RIP_FILTER_MAX];
+static struct prefix_list *rip_all_prefix[RIP_FILTER_MAX];
 
+/* Apply the distribute-lists of direction rip_distribute, first those
+   of the interface and then those for all interfaces.  Returns -1 if
+   the route is filtered. */
 static int
-rip_outgoing_filter (struct prefix_ipv4 *p, struct rip_interface *ri)
+rip_filter (int rip_distribute, struct prefix_ipv4 *p, struct rip_interface *ri)
 {
-  struct distribute *dist;
   struct access_list *alist;
   struct prefix_list *plist;
+  const char *inout = rip_distribute == RIP_FILTER_OUT ? "out" : "in";
+  int i;
 
-  if (ri->list[RIP_FILTER_OUT])
+  for (i = 0; i < 2; i++)
     {
-      if (access_list_apply (ri->list[RIP_FILTER_OUT],
-			     (struct prefix *) p) == FILTER_DENY)
+      alist = i ? rip_all_list[rip_distribute] : ri->list[rip_distribute];
+      plist = i ? rip_all_prefix[rip_distribute] : ri->prefix[rip_distribute];
+
+      if (alist && access_list_apply (alist, (struct prefix *) p) == FILTER_DENY)
 	{
 	  if (IS_RIP_DEBUG_PACKET)
-	    zlog_debug ("%s/%d is filtered by distribute out",
-		       inet_ntoa (p->prefix), p->prefixlen);
+	    zlog_debug ("%s/%d filtered by distribute %s",
+			inet_ntoa (p->prefix), p->prefixlen, inout);
 	  return -1;
 	}
-    }
-  if (ri->prefix[RIP_FILTER_OUT])
-    {
-      if (prefix_list_apply (ri->prefix[RIP_FILTER_OUT],
-			     (struct prefix *) p) == PREFIX_DENY)
+      if (plist && prefix_list_apply (plist, (struct prefix *) p) == PREFIX_DENY)
 	{
 	  if (IS_RIP_DEBUG_PACKET)
-	    zlog_debug ("%s/%d is filtered by prefix-list out",
-		       inet_ntoa (p->prefix), p->prefixlen);
+	    zlog_debug ("%s/%d filtered by prefix-list %s",
+			inet_ntoa (p->prefix), p->prefixlen, inout);
 	  return -1;
 	}
     }
-
-  /* All interface filter check. */
-  dist = distribute_lookup (NULL);
-  if (dist)
-    {
-      if (dist->list[DISTRIBUTE_OUT])
-	{
-	  alist = access_list_lookup (AFI_IP, dist->list[DISTRIBUTE_OUT]);
-	    
-	  if (alist)
-	    {
-	      if (access_list_apply (alist,
-				     (struct prefix *) p) == FILTER_DENY)
-		{
-		  if (IS_RIP_DEBUG_PACKET)
-		    zlog_debug ("%s/%d filtered by distribute out",
-			       inet_ntoa (p->prefix), p->prefixlen);
-		  return -1;
-		}
-	    }
-	}
-      if (dist->prefix[DISTRIBUTE_OUT])
-	{
-	  plist = prefix_list_lookup (AFI_IP, dist->prefix[DISTRIBUTE_OUT]);
-	  
-	  if (plist)
-	    {
-	      if (prefix_list_apply (plist,
-				     (struct prefix *) p) == PREFIX_DENY)
-		{
-		  if (IS_RIP_DEBUG_PACKET)
-		    zlog_debug ("%s/%d filtered by prefix-list out",
-			       inet_ntoa (p->prefix), p->prefixlen);
-		  return -1;
-		}
-	    }
-	}
-    }
   return 0;
 }
 
@@ -385,7 +316,7 @@ rip_rte_process (struct rte *rte, struct sockaddr_in *from,
   /* Apply input filters. */
   ri = ifp->info;
 
-  ret = rip_incoming_filter (&p, ri);
+  ret = rip_filter (RIP_FILTER_IN, &p, ri);
   if (ret < 0)
     return;
 
@@ -496,8 +427,8 @@ rip_rte_process (struct rte *rte, struct sockaddr_in *from,
             }
           else
             {
-              RIP_TIMER_OFF (rinfo->t_timeout);
-              RIP_TIMER_OFF (rinfo->t_garbage_collect);
+              RIP_ROUTE_TIMER_OFF (rinfo->t_timeout);
+              RIP_ROUTE_TIMER_OFF (rinfo->t_garbage_collect);
                                                                                 
               rp->info = NULL;
               if (rip_route_rte (rinfo))
@@ -543,7 +474,7 @@ rip_rte_process (struct rte *rte, struct sockaddr_in *from,
           rip_timeout_update (rinfo);
 
           /* - Set the route change flag. */
-          rinfo->flags |= RIP_RTF_CHANGED;
+          rip_info_changed (rinfo);
 
           /* - Signal the output process to trigger an update (see section
              2.5). */
@@ -625,7 +556,7 @@ rip_rte_process (struct rte *rte, struct sockaddr_in *from,
               rinfo->type = ZEBRA_ROUTE_RIP;
               rinfo->sub_type = RIP_ROUTE_RTE;
 
-              RIP_TIMER_OFF (rinfo->t_garbage_collect);
+              RIP_ROUTE_TIMER_OFF (rinfo->t_garbage_collect);
 
               if (!IPV4_ADDR_SAME (&rinfo->nexthop, nexthop))
                 IPV4_ADDR_COPY (&rinfo->nexthop, nexthop);
@@ -649,7 +580,7 @@ rip_rte_process (struct rte *rte, struct sockaddr_in *from,
 
           /* - Set the route change flag and signal the output process
              to trigger an update. */
-          rinfo->flags |= RIP_RTF_CHANGED;
+          rip_info_changed (rinfo);
           rip_event (RIP_TRIGGERED_UPDATE, 0);
 
           /* - If the new metric is infinity, start the deletion
@@ -665,9 +596,9 @@ rip_rte_process (struct rte *rte, struct sockaddr_in *from,
               if (oldmetric != RIP_METRIC_INFINITY)
                 {
                   /* - The garbage-collection timer is set for 120 seconds. */
-                  RIP_TIMER_ON (rinfo->t_garbage_collect,
+                  RIP_ROUTE_TIMER_ON (rinfo->t_garbage_collect,
                                 rip_garbage_collect, rip->garbage_time);
-                  RIP_TIMER_OFF (rinfo->t_timeout);
+                  RIP_ROUTE_TIMER_OFF (rinfo->t_timeout);
 
                   /* - The metric for the route is set to 16
                      (infinity).  This causes the route to be removed
@@ -1555,8 +1486,8 @@ rip_redistribute_add (int type, int sub_type, struct prefix_ipv4 *p,
 	    }
 	}
 
-      RIP_TIMER_OFF (rinfo->t_timeout);
-      RIP_TIMER_OFF (rinfo->t_garbage_collect);
+      RIP_ROUTE_TIMER_OFF (rinfo->t_timeout);
+      RIP_ROUTE_TIMER_OFF (rinfo->t_garbage_collect);
 
       if (rip_route_rte (rinfo))
 	rip_zebra_ipv4_delete ((struct prefix_ipv4 *)&rp->p, &rinfo->nexthop,
@@ -1583,7 +1514,7 @@ rip_redistribute_add (int type, int sub_type, struct prefix_ipv4 *p,
   rinfo->flags |= RIP_RTF_FIB;
   rp->info = rinfo;
 
-  rinfo->flags |= RIP_RTF_CHANGED;
+  rip_info_changed (rinfo);
 
   if (IS_RIP_DEBUG_EVENT) {
     if (!nexthop)
@@ -1625,10 +1556,10 @@ rip_redistribute_delete (int type, int sub_type, struct prefix_ipv4 *p,
 	{
 	  /* Perform poisoned reverse. */
 	  rinfo->metric = RIP_METRIC_INFINITY;
-	  RIP_TIMER_ON (rinfo->t_garbage_collect, 
+	  RIP_ROUTE_TIMER_ON (rinfo->t_garbage_collect, 
 			rip_garbage_collect, rip->garbage_time);
-	  RIP_TIMER_OFF (rinfo->t_timeout);
-	  rinfo->flags |= RIP_RTF_CHANGED;
+	  RIP_ROUTE_TIMER_OFF (rinfo->t_timeout);
+	  rip_info_changed (rinfo);
 
           if (IS_RIP_DEBUG_EVENT)
             zlog_debug ("Poisone %s/%d on the interface %s with an infinity metric [delete]",
@@ -2132,27 +2063,252 @@ rip_write_rte (int num, struct stream *s, struct prefix_ipv4 *p,
   return ++num;
 }
 
-/* Send update to the ifp or spcified neighbor. */
+/* Per-call state of rip_output_process(): the packet being filled and
+   everything about the output interface that does not depend on the
+   route, worked out once rather than for every RTE. */
+struct rip_output
+{
+  struct connected *ifc;
+  struct rip_interface *ri;
+  struct sockaddr_in *to;
+  u_char version;
+
+  struct stream *s;
+  struct key *key;
+  /* this might need to made dynamic if RIP ever supported auth methods
+     with larger key string sizes */
+  char auth_str[RIP_AUTH_SIMPLE_SIZE];
+  size_t doff; /* offset of digest offset field */
+  int num;
+  int rtemax;
+
+  /* RIPv1 classful summarisation. */
+  int subnetted;
+  struct prefix_ipv4 ifaddrclass;
+};
+
+/* Send the RTEs accumulated in out, if any. */
+static void
+rip_output_flush (struct rip_output *out)
+{
+  int ret;
+
+  if (out->num == 0)
+    return;
+
+  if (out->version == RIPv2 && out->ri->auth_type == RIP_AUTH_MD5)
+    rip_auth_md5_set (out->s, out->ri, out->doff, out->auth_str,
+                      RIP_AUTH_SIMPLE_SIZE);
+
+  ret = rip_send_packet (STREAM_DATA (out->s), stream_get_endp (out->s),
+                         out->to, out->ifc);
+
+  if (ret >= 0 && IS_RIP_DEBUG_SEND)
+    rip_packet_dump ((struct rip_packet *)STREAM_DATA (out->s),
+                     stream_get_endp (out->s), "SEND");
+  out->num = 0;
+  stream_reset (out->s);
+}
+
+/* Run one route through the output policy of the interface and, if it
+   survives, append it to the packet being built. */
+static void
+rip_output_rte (struct rip_output *out, struct rip_info *rinfo)
+{
+  int ret;
+  struct connected *ifc = out->ifc;
+  struct rip_interface *ri = out->ri;
+  struct route_node *rp = rinfo->rp;
+  struct prefix_ipv4 *p;
+  struct prefix_ipv4 classfull;
+
+  p = (struct prefix_ipv4 *) &rp->p;
+
+  /* For RIPv1, if we are subnetted, output subnets in our network    */
+  /* that have the same mask as the output "interface". For other     */
+  /* networks, only the classfull version is output.                  */
+  if (out->version == RIPv1)
+    {
+      if (IS_RIP_DEBUG_PACKET)
+        zlog_debug("RIPv1 mask check, %s/%d considered for output",
+                  inet_ntoa (rp->p.u.prefix4), rp->p.prefixlen);
+
+      if (out->subnetted &&
+          prefix_match ((struct prefix *) &out->ifaddrclass, &rp->p))
+        {
+          if ((ifc->address->prefixlen != rp->p.prefixlen) &&
+              (rp->p.prefixlen != 32))
+            return;
+        }
+      else
+        {
+          memcpy (&classfull, &rp->p, sizeof(struct prefix_ipv4));
+          apply_classful_mask_ipv4(&classfull);
+          if (rp->p.u.prefix4.s_addr != 0 &&
+              classfull.prefixlen != rp->p.prefixlen)
+            return;
+        }
+      if (IS_RIP_DEBUG_PACKET)
+        zlog_debug("RIPv1 mask check, %s/%d made it through",
+                  inet_ntoa (rp->p.u.prefix4), rp->p.prefixlen);
+    }
+
+  /* Apply output filters. */
+  ret = rip_filter (RIP_FILTER_OUT, p, ri);
+  if (ret < 0)
+    return;
+
+  /* Split horizon. */
+  /* if (split_horizon == rip_split_horizon) */
+  if (ri->split_horizon == RIP_SPLIT_HORIZON)
+    {
+      /* 
+       * We perform split horizon for RIP and connected route. 
+       * For rip routes, we want to suppress the route if we would
+       * end up sending the route back on the interface that we
+       * learned it from, with a higher metric. For connected routes,
+       * we suppress the route if the prefix is a subset of the
+       * source address that we are going to use for the packet 
+       * (in order to handle the case when multiple subnets are
+       * configured on the same interface).
+       */
+      if (rinfo->type == ZEBRA_ROUTE_RIP  &&
+           rinfo->ifindex == ifc->ifp->ifindex) 
+        return;
+      if (rinfo->type == ZEBRA_ROUTE_CONNECT &&
+           prefix_match((struct prefix *)p, ifc->address))
+        return;
+    }
+
+  /* Preparation for route-map. */
+  rinfo->metric_set = 0;
+  rinfo->nexthop_out.s_addr = 0;
+  rinfo->metric_out = rinfo->metric;
+  rinfo->tag_out = rinfo->tag;
+  rinfo->ifindex_out = ifc->ifp->ifindex;
+
+  /* In order to avoid some local loops,
+   * if the RIP route has a nexthop via this interface, keep the nexthop,
+   * otherwise set it to 0. The nexthop should not be propagated
+   * beyond the local broadcast/multicast area in order
+   * to avoid an IGP multi-level recursive look-up.
+   * see (4.4)
+   */
+  if (rinfo->ifindex == ifc->ifp->ifindex)
+    rinfo->nexthop_out = rinfo->nexthop;
+
+  /* Interface route-map */
+  if (ri->routemap[RIP_FILTER_OUT])
+    {
+      ret = route_map_apply (ri->routemap[RIP_FILTER_OUT], 
+                               (struct prefix *) p, RMAP_RIP, 
+                               rinfo);
+
+      if (ret == RMAP_DENYMATCH)
+        {
+          if (IS_RIP_DEBUG_PACKET)
+            zlog_debug ("RIP %s/%d is filtered by route-map out",
+                       inet_ntoa (p->prefix), p->prefixlen);
+          return;
+        }
+    }
+     
+  /* Apply redistribute route map - continue, if deny */
+  if (rip->route_map[rinfo->type].name
+      && rinfo->sub_type != RIP_ROUTE_INTERFACE)
+    {
+      ret = route_map_apply (rip->route_map[rinfo->type].map,
+                             (struct prefix *)p, RMAP_RIP, rinfo);
+
+      if (ret == RMAP_DENYMATCH) 
+        {
+          if (IS_RIP_DEBUG_PACKET)
+            zlog_debug ("%s/%d is filtered by route-map",
+                       inet_ntoa (p->prefix), p->prefixlen);
+          return;
+        }
+    }
+
+  /* When route-map does not set metric. */
+  if (! rinfo->metric_set)
+    {
+      /* If redistribute metric is set. */
+      if (rip->route_map[rinfo->type].metric_config
+          && rinfo->metric != RIP_METRIC_INFINITY)
+        {
+          rinfo->metric_out = rip->route_map[rinfo->type].metric;
+        }
+      else
+        {
+          /* If the route is not connected or localy generated
+             one, use default-metric value*/
+          if (rinfo->type != ZEBRA_ROUTE_RIP 
+              && rinfo->type != ZEBRA_ROUTE_CONNECT
+              && rinfo->metric != RIP_METRIC_INFINITY)
+            rinfo->metric_out = rip->default_metric;
+        }
+    }
+
+  /* Apply offset-list */
+  if (rinfo->metric != RIP_METRIC_INFINITY)
+    rip_offset_list_apply_out (p, ifc->ifp, &rinfo->metric_out);
+
+  if (rinfo->metric_out > RIP_METRIC_INFINITY)
+    rinfo->metric_out = RIP_METRIC_INFINITY;
+
+  /* Perform split-horizon with poisoned reverse 
+   * for RIP and connected routes.
+   **/
+  if (ri->split_horizon == RIP_SPLIT_HORIZON_POISONED_REVERSE) {
+      /* 
+       * We perform split horizon for RIP and connected route. 
+       * For rip routes, we want to suppress the route if we would
+       * end up sending the route back on the interface that we
+       * learned it from, with a higher metric. For connected routes,
+       * we suppress the route if the prefix is a subset of the
+       * source address that we are going to use for the packet 
+       * (in order to handle the case when multiple subnets are
+       * configured on the same interface).
+       */
+    if (rinfo->type == ZEBRA_ROUTE_RIP  &&
+         rinfo->ifindex == ifc->ifp->ifindex)
+         rinfo->metric_out = RIP_METRIC_INFINITY;
+    if (rinfo->type == ZEBRA_ROUTE_CONNECT &&
+        prefix_match((struct prefix *)p, ifc->address))
+         rinfo->metric_out = RIP_METRIC_INFINITY;
+  }
+
+  /* Prepare preamble, auth headers, if needs be */
+  if (out->num == 0)
+    {
+      stream_putc (out->s, RIP_RESPONSE);
+      stream_putc (out->s, out->version);
+      stream_putw (out->s, 0);
+
+      /* auth header for !v1 && !no_auth */
+      if ( (ri->auth_type != RIP_NO_AUTH) && (out->version != RIPv1) )
+        out->doff = rip_auth_header_write (out->s, ri, out->key,
+                                           out->auth_str,
+                                           RIP_AUTH_SIMPLE_SIZE);
+    }
+
+  /* Write RTE to the stream. */
+  out->num = rip_write_rte (out->num, out->s, p, out->version, rinfo);
+  if (out->num == out->rtemax)
+    rip_output_flush (out);
+}
+
+/* Send update to the ifp or spcified neighbor.  A full update walks
+   the whole table; a triggered update only visits the routes queued
+   on rip->changed. */
 void
 rip_output_process (struct connected *ifc, struct sockaddr_in *to, 
                     int route_type, u_char version)
 {
-  int ret;
-  struct stream *s;
   struct route_node *rp;
   struct rip_info *rinfo;
   struct rip_interface *ri;
-  struct prefix_ipv4 *p;
-  struct prefix_ipv4 classfull;
-  struct prefix_ipv4 ifaddrclass;
-  struct key *key = NULL;
-  /* this might need to made dynamic if RIP ever supported auth methods
-     with larger key string sizes */
-  char auth_str[RIP_AUTH_SIMPLE_SIZE];
-  size_t doff = 0; /* offset of digest offset field */
-  int num = 0;
-  int rtemax;
-  int subnetted = 0;
+  struct rip_output out;
 
   /* Logging output event. */
   if (IS_RIP_DEBUG_EVENT)
@@ -2164,25 +2320,30 @@ rip_output_process (struct connected *ifc, struct sockaddr_in *to,
 		   ifc->ifp->name, ifc->ifp->ifindex);
     }
 
+  memset (&out, 0, sizeof (out));
+  out.ifc = ifc;
+  out.to = to;
+  out.version = version;
+
   /* Set output stream. */
-  s = rip->obuf;
+  out.s = rip->obuf;
 
   /* Reset stream and RTE counter. */
-  stream_reset (s);
-  rtemax = (RIP_PACKET_MAXSIZ - 4) / 20;
+  stream_reset (out.s);
+  out.rtemax = (RIP_PACKET_MAXSIZ - 4) / 20;
 
   /* Get RIP interface. */
-  ri = ifc->ifp->info;
+  ri = out.ri = ifc->ifp->info;
     
   /* If output interface is in simple password authentication mode, we
      need space for authentication data.  */
   if (ri->auth_type == RIP_AUTH_SIMPLE_PASSWORD)
-    rtemax -= 1;
+    out.rtemax -= 1;
 
   /* If output interface is in MD5 authentication mode, we need space
      for authentication header and data. */
   if (ri->auth_type == RIP_AUTH_MD5)
-    rtemax -= 2;
+    out.rtemax -= 2;
 
   /* If output interface is in simple password authentication mode
      and string or keychain is specified we need space for auth. data */
@@ -2194,234 +2355,37 @@ rip_output_process (struct connected *ifc, struct sockaddr_in *to,
 
          keychain = keychain_lookup (ri->key_chain);
          if (keychain)
-           key = key_lookup_for_send (keychain);
+           out.key = key_lookup_for_send (keychain);
        }
       /* to be passed to auth functions later */
-      rip_auth_prepare_str_send (ri, key, auth_str, RIP_AUTH_SIMPLE_SIZE);
+      rip_auth_prepare_str_send (ri, out.key, out.auth_str,
+                                 RIP_AUTH_SIMPLE_SIZE);
     }
 
   if (version == RIPv1)
     {
-      memcpy (&ifaddrclass, ifc->address, sizeof (struct prefix_ipv4));
-      apply_classful_mask_ipv4 (&ifaddrclass);
-      subnetted = 0;
-      if (ifc->address->prefixlen > ifaddrclass.prefixlen)
-        subnetted = 1;
+      memcpy (&out.ifaddrclass, ifc->address, sizeof (struct prefix_ipv4));
+      apply_classful_mask_ipv4 (&out.ifaddrclass);
+      if (ifc->address->prefixlen > out.ifaddrclass.prefixlen)
+        out.subnetted = 1;
     }
 
-  for (rp = route_top (rip->table); rp; rp = route_next (rp))
-    if ((rinfo = rp->info) != NULL)
-      {
-	/* For RIPv1, if we are subnetted, output subnets in our network    */
-	/* that have the same mask as the output "interface". For other     */
-	/* networks, only the classfull version is output.                  */
-	
-	if (version == RIPv1)
-	  {
-	    p = (struct prefix_ipv4 *) &rp->p;
-
-	    if (IS_RIP_DEBUG_PACKET)
-	      zlog_debug("RIPv1 mask check, %s/%d considered for output",
-			inet_ntoa (rp->p.u.prefix4), rp->p.prefixlen);
-
-	    if (subnetted &&
-		prefix_match ((struct prefix *) &ifaddrclass, &rp->p))
-	      {
-		if ((ifc->address->prefixlen != rp->p.prefixlen) &&
-		    (rp->p.prefixlen != 32))
-		  continue;
-	      }
-	    else
-	      {
-		memcpy (&classfull, &rp->p, sizeof(struct prefix_ipv4));
-		apply_classful_mask_ipv4(&classfull);
-		if (rp->p.u.prefix4.s_addr != 0 &&
-		    classfull.prefixlen != rp->p.prefixlen)
-		  continue;
-	      }
-	    if (IS_RIP_DEBUG_PACKET)
-	      zlog_debug("RIPv1 mask check, %s/%d made it through",
-			inet_ntoa (rp->p.u.prefix4), rp->p.prefixlen);
-	  }
-	else 
-	  p = (struct prefix_ipv4 *) &rp->p;
-
-	/* Apply output filters. */
-	ret = rip_outgoing_filter (p, ri);
-	if (ret < 0)
-	  continue;
-
-	/* Changed route only output. */
-	if (route_type == rip_changed_route &&
-	    (! (rinfo->flags & RIP_RTF_CHANGED)))
-	  continue;
-
-	/* Split horizon. */
-	/* if (split_horizon == rip_split_horizon) */
-	if (ri->split_horizon == RIP_SPLIT_HORIZON)
-	  {
-	    /* 
-	     * We perform split horizon for RIP and connected route. 
-	     * For rip routes, we want to suppress the route if we would
-             * end up sending the route back on the interface that we
-             * learned it from, with a higher metric. For connected routes,
-             * we suppress the route if the prefix is a subset of the
-             * source address that we are going to use for the packet 
-             * (in order to handle the case when multiple subnets are
-             * configured on the same interface).
-             */
-	    if (rinfo->type == ZEBRA_ROUTE_RIP  &&
-                 rinfo->ifindex == ifc->ifp->ifindex) 
-	      continue;
-	    if (rinfo->type == ZEBRA_ROUTE_CONNECT &&
-                 prefix_match((struct prefix *)p, ifc->address))
-	      continue;
-	  }
-
-	/* Preparation for route-map. */
-	rinfo->metric_set = 0;
-	rinfo->nexthop_out.s_addr = 0;
-	rinfo->metric_out = rinfo->metric;
-	rinfo->tag_out = rinfo->tag;
-	rinfo->ifindex_out = ifc->ifp->ifindex;
-
-	/* In order to avoid some local loops,
-	 * if the RIP route has a nexthop via this interface, keep the nexthop,
-	 * otherwise set it to 0. The nexthop should not be propagated
-	 * beyond the local broadcast/multicast area in order
-	 * to avoid an IGP multi-level recursive look-up.
-	 * see (4.4)
-	 */
-	if (rinfo->ifindex == ifc->ifp->ifindex)
-	  rinfo->nexthop_out = rinfo->nexthop;
-
-	/* Interface route-map */
-	if (ri->routemap[RIP_FILTER_OUT])
-	  {
-	    ret = route_map_apply (ri->routemap[RIP_FILTER_OUT], 
-				     (struct prefix *) p, RMAP_RIP, 
-				     rinfo);
-
-	    if (ret == RMAP_DENYMATCH)
-	      {
-	        if (IS_RIP_DEBUG_PACKET)
-	          zlog_debug ("RIP %s/%d is filtered by route-map out",
-			     inet_ntoa (p->prefix), p->prefixlen);
-		  continue;
-	      }
-	  }
-           
-	/* Apply redistribute route map - continue, if deny */
-	if (rip->route_map[rinfo->type].name
-	    && rinfo->sub_type != RIP_ROUTE_INTERFACE)
-	  {
-	    ret = route_map_apply (rip->route_map[rinfo->type].map,
-				   (struct prefix *)p, RMAP_RIP, rinfo);
-
-	    if (ret == RMAP_DENYMATCH) 
-	      {
-		if (IS_RIP_DEBUG_PACKET)
-		  zlog_debug ("%s/%d is filtered by route-map",
-			     inet_ntoa (p->prefix), p->prefixlen);
-		continue;
-	      }
-	  }
-
-	/* When route-map does not set metric. */
-	if (! rinfo->metric_set)
-	  {
-	    /* If redistribute metric is set. */
-	    if (rip->route_map[rinfo->type].metric_config
-		&& rinfo->metric != RIP_METRIC_INFINITY)
-	      {
-		rinfo->metric_out = rip->route_map[rinfo->type].metric;
-	      }
-	    else
-	      {
-		/* If the route is not connected or localy generated
-		   one, use default-metric value*/
-		if (rinfo->type != ZEBRA_ROUTE_RIP 
-		    && rinfo->type != ZEBRA_ROUTE_CONNECT
-		    && rinfo->metric != RIP_METRIC_INFINITY)
-		  rinfo->metric_out = rip->default_metric;
-	      }
-	  }
-
-	/* Apply offset-list */
-	if (rinfo->metric != RIP_METRIC_INFINITY)
-	  rip_offset_list_apply_out (p, ifc->ifp, &rinfo->metric_out);
-
-	if (rinfo->metric_out > RIP_METRIC_INFINITY)
-	  rinfo->metric_out = RIP_METRIC_INFINITY;
-
-	/* Perform split-horizon with poisoned reverse 
-	 * for RIP and connected routes.
-	 **/
-	if (ri->split_horizon == RIP_SPLIT_HORIZON_POISONED_REVERSE) {
-	    /* 
-	     * We perform split horizon for RIP and connected route. 
-	     * For rip routes, we want to suppress the route if we would
-             * end up sending the route back on the interface that we
-             * learned it from, with a higher metric. For connected routes,
-             * we suppress the route if the prefix is a subset of the
-             * source address that we are going to use for the packet 
-             * (in order to handle the case when multiple subnets are
-             * configured on the same interface).
-             */
-	  if (rinfo->type == ZEBRA_ROUTE_RIP  &&
-	       rinfo->ifindex == ifc->ifp->ifindex)
-	       rinfo->metric_out = RIP_METRIC_INFINITY;
-	  if (rinfo->type == ZEBRA_ROUTE_CONNECT &&
-              prefix_match((struct prefix *)p, ifc->address))
-	       rinfo->metric_out = RIP_METRIC_INFINITY;
-	}
-	
-	/* Prepare preamble, auth headers, if needs be */
-	if (num == 0)
-	  {
-	    stream_putc (s, RIP_RESPONSE);
-	    stream_putc (s, version);
-	    stream_putw (s, 0);
-	    
-	    /* auth header for !v1 && !no_auth */
-            if ( (ri->auth_type != RIP_NO_AUTH) && (version != RIPv1) )
-              doff = rip_auth_header_write (s, ri, key, auth_str, 
-                                              RIP_AUTH_SIMPLE_SIZE);
-          }
-        
-	/* Write RTE to the stream. */
-	num = rip_write_rte (num, s, p, version, rinfo);
-	if (num == rtemax)
-	  {
-	    if (version == RIPv2 && ri->auth_type == RIP_AUTH_MD5)
-              rip_auth_md5_set (s, ri, doff, auth_str, RIP_AUTH_SIMPLE_SIZE);
-
-	    ret = rip_send_packet (STREAM_DATA (s), stream_get_endp (s),
-				   to, ifc);
-
-	    if (ret >= 0 && IS_RIP_DEBUG_SEND)
-	      rip_packet_dump ((struct rip_packet *)STREAM_DATA (s),
-			       stream_get_endp(s), "SEND");
-	    num = 0;
-	    stream_reset (s);
-	  }
-      }
-
-  /* Flush unwritten RTE. */
-  if (num != 0)
+  /* Changed route only output. */
+  if (route_type == rip_changed_route)
     {
-      if (version == RIPv2 && ri->auth_type == RIP_AUTH_MD5)
-        rip_auth_md5_set (s, ri, doff, auth_str, RIP_AUTH_SIMPLE_SIZE);
-
-      ret = rip_send_packet (STREAM_DATA (s), stream_get_endp (s), to, ifc);
-
-      if (ret >= 0 && IS_RIP_DEBUG_SEND)
-	rip_packet_dump ((struct rip_packet *)STREAM_DATA (s),
-			 stream_get_endp (s), "SEND");
-      num = 0;
-      stream_reset (s);
+      for (rinfo = rip->changed; rinfo; rinfo = rinfo->changed_next)
+        rip_output_rte (&out, rinfo);
+    }
+  else
+    {
+      for (rp = route_top (rip->table); rp; rp = route_next (rp))
+        if ((rinfo = rp->info) != NULL)
+          rip_output_rte (&out, rinfo);
     }
 
+  /* Flush unwritten RTE. */
+  rip_output_flush (&out);
+
   /* Statistics updates. */
   ri->sent_updates++;
 }
@@ -2588,17 +2552,13 @@ rip_update (struct thread *t)
   return 0;
 }
 
-/* Walk down the RIP routing table then clear changed flag. */
+/* Clear the changed flag of every route queued since the last
+   triggered update. */
 static void
 rip_clear_changed_flag (void)
 {
-  struct route_node *rp;
-  struct rip_info *rinfo;
-
-  for (rp = route_top (rip->table); rp; rp = route_next (rp))
-    if ((rinfo = rp->info) != NULL)
-      if (rinfo->flags & RIP_RTF_CHANGED)
-	rinfo->flags &= ~RIP_RTF_CHANGED;
+  while (rip->changed)
+    rip_info_unchanged (rip->changed);
 }
 
 /* Triggered update interval timer. */
@@ -2676,10 +2636,10 @@ rip_redistribute_withdraw (int type)
 	  {
 	    /* Perform poisoned reverse. */
 	    rinfo->metric = RIP_METRIC_INFINITY;
-	    RIP_TIMER_ON (rinfo->t_garbage_collect, 
+	    RIP_ROUTE_TIMER_ON (rinfo->t_garbage_collect, 
 			  rip_garbage_collect, rip->garbage_time);
-	    RIP_TIMER_OFF (rinfo->t_timeout);
-	    rinfo->flags |= RIP_RTF_CHANGED;
+	    RIP_ROUTE_TIMER_OFF (rinfo->t_timeout);
+	    rip_info_changed (rinfo);
 
 	    if (IS_RIP_DEBUG_EVENT) {
               struct prefix_ipv4 *p = (struct prefix_ipv4 *) &rp->p;
@@ -2716,6 +2676,8 @@ rip_create (void)
   /* Make output stream. */
   rip->obuf = stream_new (1500);
 
+  rip->wheel = wheel_new (master, WHEEL_SIZE_DEFAULT);
+
   /* Make socket. */
   rip->sock = rip_create_socket (NULL);
   if (rip->sock < 0)
@@ -3381,18 +3343,17 @@ rip_vty_out_uptime (struct vty *vty, struct rip_info *rinfo)
   struct tm *tm;
 #define TIME_BUF 25
   char timebuf [TIME_BUF];
-  struct thread *thread;
 
-  if ((thread = rinfo->t_timeout) != NULL)
+  if (WHEEL_TIMER_ARMED (&rinfo->t_timeout))
     {
-      clock = thread_timer_remain_second (thread);
+      clock = wheel_timer_remain (&rinfo->t_timeout);
       tm = gmtime (&clock);
       strftime (timebuf, TIME_BUF, "%M:%S", tm);
       vty_out (vty, "%5s", timebuf);
     }
-  else if ((thread = rinfo->t_garbage_collect) != NULL)
+  else if (WHEEL_TIMER_ARMED (&rinfo->t_garbage_collect))
     {
-      clock = thread_timer_remain_second (thread);
+      clock = wheel_timer_remain (&rinfo->t_garbage_collect);
       tm = gmtime (&clock);
       strftime (timebuf, TIME_BUF, "%M:%S", tm);
       vty_out (vty, "%5s", timebuf);
@@ -3698,66 +3659,47 @@ static struct cmd_node rip_node =
 };
 
 /* Distribute-list update functions. */
+static void
+rip_distribute_resolve (struct distribute *dist, struct access_list **list,
+			struct prefix_list **prefix)
+{
+  list[RIP_FILTER_IN] = NULL;
+  list[RIP_FILTER_OUT] = NULL;
+  prefix[RIP_FILTER_IN] = NULL;
+  prefix[RIP_FILTER_OUT] = NULL;
+
+  if (dist->list[DISTRIBUTE_IN])
+    list[RIP_FILTER_IN] = access_list_lookup (AFI_IP,
+					      dist->list[DISTRIBUTE_IN]);
+  if (dist->list[DISTRIBUTE_OUT])
+    list[RIP_FILTER_OUT] = access_list_lookup (AFI_IP,
+					       dist->list[DISTRIBUTE_OUT]);
+  if (dist->prefix[DISTRIBUTE_IN])
+    prefix[RIP_FILTER_IN] = prefix_list_lookup (AFI_IP,
+						 dist->prefix[DISTRIBUTE_IN]);
+  if (dist->prefix[DISTRIBUTE_OUT])
+    prefix[RIP_FILTER_OUT] = prefix_list_lookup (AFI_IP,
+						  dist->prefix[DISTRIBUTE_OUT]);
+}
+
 static void
 rip_distribute_update (struct distribute *dist)
 {
   struct interface *ifp;
   struct rip_interface *ri;
-  struct access_list *alist;
-  struct prefix_list *plist;
 
   if (! dist->ifname)
-    return;
+    {
+      rip_distribute_resolve (dist, rip_all_list, rip_all_prefix);
+      return;
+    }
 
   ifp = if_lookup_by_name (dist->ifname);
   if (ifp == NULL)
     return;
 
   ri = ifp->info;
-
-  if (dist->list[DISTRIBUTE_IN])
-    {
-      alist = access_list_lookup (AFI_IP, dist->list[DISTRIBUTE_IN]);
-      if (alist)
-	ri->list[RIP_FILTER_IN] = alist;
-      else
-	ri->list[RIP_FILTER_IN] = NULL;
-    }
-  else
-    ri->list[RIP_FILTER_IN] = NULL;
-
-  if (dist->list[DISTRIBUTE_OUT])
-    {
-      alist = access_list_lookup (AFI_IP, dist->list[DISTRIBUTE_OUT]);
-      if (alist)
-	ri->list[RIP_FILTER_OUT] = alist;
-      else
-	ri->list[RIP_FILTER_OUT] = NULL;
-    }
-  else
-    ri->list[RIP_FILTER_OUT] = NULL;
-
-  if (dist->prefix[DISTRIBUTE_IN])
-    {
-      plist = prefix_list_lookup (AFI_IP, dist->prefix[DISTRIBUTE_IN]);
-      if (plist)
-	ri->prefix[RIP_FILTER_IN] = plist;
-      else
-	ri->prefix[RIP_FILTER_IN] = NULL;
-    }
-  else
-    ri->prefix[RIP_FILTER_IN] = NULL;
-
-  if (dist->prefix[DISTRIBUTE_OUT])
-    {
-      plist = prefix_list_lookup (AFI_IP, dist->prefix[DISTRIBUTE_OUT]);
-      if (plist)
-	ri->prefix[RIP_FILTER_OUT] = plist;
-      else
-	ri->prefix[RIP_FILTER_OUT] = NULL;
-    }
-  else
-    ri->prefix[RIP_FILTER_OUT] = NULL;
+  rip_distribute_resolve (dist, ri->list, ri->prefix);
 }
 
 void
@@ -3777,15 +3719,26 @@ rip_distribute_update_all (struct prefix_list *notused)
 {
   struct interface *ifp;
   struct listnode *node, *nnode;
+  struct distribute *dist;
 
   for (ALL_LIST_ELEMENTS (iflist, node, nnode, ifp))
     rip_distribute_update_interface (ifp);
+
+  dist = distribute_lookup (NULL);
+  if (dist)
+    rip_distribute_update (dist);
+  else
+    {
+      memset (rip_all_list, 0, sizeof (rip_all_list));
+      memset (rip_all_prefix, 0, sizeof (rip_all_prefix));
+    }
 }
 /* ARGSUSED */
 static void
 rip_distribute_update_all_wrapper(struct access_list *notused)
 {
         rip_distribute_update_all(NULL);
+        rip_offset_list_update ();
 }
 
 /* Delete all added rip route. */
@@ -3807,8 +3760,8 @@ rip_clean (void)
 	      rip_zebra_ipv4_delete ((struct prefix_ipv4 *)&rp->p,
 				     &rinfo->nexthop, rinfo->metric);
 	
-	    RIP_TIMER_OFF (rinfo->t_timeout);
-	    RIP_TIMER_OFF (rinfo->t_garbage_collect);
+	    RIP_ROUTE_TIMER_OFF (rinfo->t_timeout);
+	    RIP_ROUTE_TIMER_OFF (rinfo->t_garbage_collect);
 
 	    rp->info = NULL;
 	    route_unlock_node (rp);
@@ -3820,6 +3773,7 @@ rip_clean (void)
       RIP_TIMER_OFF (rip->t_update);
       RIP_TIMER_OFF (rip->t_triggered_update);
       RIP_TIMER_OFF (rip->t_triggered_interval);
+      wheel_free (rip->wheel);
 
       /* Cancel read thread. */
       if (rip->t_read)
@@ -3893,6 +3847,8 @@ rip_reset (void)
   prefix_list_reset ();
 
   distribute_list_reset ();
+  memset (rip_all_list, 0, sizeof (rip_all_list));
+  memset (rip_all_prefix, 0, sizeof (rip_all_prefix));
 
   rip_interface_reset ();
   rip_distance_reset ();
@@ -22,6 +22,8 @@
 #ifndef _ZEBRA_RIP_H
 #define _ZEBRA_RIP_H
 
+#include "wheel.h"
+
 /* RIP version number. */
 #define RIPv1                            1
 #define RIPv2                            2
@@ -127,6 +129,12 @@ struct rip
   struct thread *t_triggered_update;
   struct thread *t_triggered_interval;
 
+  /* Routes flagged RIP_RTF_CHANGED since the last triggered update. */
+  struct rip_info *changed;
+
+  /* Timeout and garbage collect timers of the routes. */
+  struct wheel *wheel;
+
   /* RIP timer values. */
   unsigned long update_time;
   unsigned long timeout_time;
@@ -212,9 +220,9 @@ struct rip_info
 #define RIP_RTF_CHANGED  2
   u_char flags;
 
-  /* Garbage collect timer. */
-  struct thread *t_timeout;
-  struct thread *t_garbage_collect;
+  /* Garbage collect timer, on rip->wheel. */
+  struct wheel_timer t_timeout;
+  struct wheel_timer t_garbage_collect;
 
   /* Route-map futures - this variables can be changed. */
   struct in_addr nexthop_out;
@@ -227,6 +235,10 @@ struct rip_info
 
   u_char distance;
 
+  /* Linkage on rip->changed while RIP_RTF_CHANGED is set. */
+  struct rip_info *changed_next;
+  struct rip_info *changed_prev;
+
 #ifdef NEW_RIP_TABLE
   struct rip_info *next;
   struct rip_info *prev;
@@ -356,12 +368,13 @@ enum rip_event
   RIP_TRIGGERED_UPDATE,
 };
 
-/* Macro for timer turn on. */
-#define RIP_TIMER_ON(T,F,V) \
+/* Macros for the route timers: turn on, unless on already, and off. */
+#define RIP_ROUTE_TIMER_ON(T,F,V) \
   do { \
-    if (!(T)) \
-      (T) = thread_add_timer (master, (F), rinfo, (V)); \
+    if (!WHEEL_TIMER_ARMED (&(T))) \
+      wheel_timer_on (rip->wheel, &(T), (F), rinfo, (V)); \
   } while (0)
+#define RIP_ROUTE_TIMER_OFF(T)  wheel_timer_off (rip->wheel, &(T))
 
 /* Macro for timer turn off. */
 #define RIP_TIMER_OFF(X) \
@@ -422,6 +435,7 @@ extern struct rip_peer *rip_peer_lookup_next (struct in_addr *);
 extern int rip_offset_list_apply_in (struct prefix_ipv4 *, struct interface *, u_int32_t *);
 extern int rip_offset_list_apply_out (struct prefix_ipv4 *, struct interface *, u_int32_t *);
 extern void rip_offset_clean (void);
+extern void rip_offset_list_update (void);
 
 extern void rip_info_free (struct rip_info *);
 extern u_char rip_distance_apply (struct rip_info *);
@@ -317,7 +317,7 @@ ripng_interface_delete (int command, struct zclient *zclient,
 
   /* To support pseudo interface do not free interface structure.  */
   /* if_delete(ifp); */
-  ifp->ifindex = IFINDEX_INTERNAL;
+  if_set_index (ifp, IFINDEX_INTERNAL);
 
   return 0;
 }
@@ -342,6 +342,8 @@ ripng_interface_clean (void)
           thread_cancel (ri->t_wakeup);
           ri->t_wakeup = NULL;
         }
+
+      ripng_update_cache_free (ri);
     }
 }
 
@@ -376,6 +378,8 @@ ripng_interface_reset (void)
         }
 
       ri->passive = 0;
+
+      ripng_update_cache_free (ri);
     }
 }
 
@@ -1037,6 +1041,7 @@ DEFUN (ipv6_ripng_split_horizon,
   ri = ifp->info;
 
   ri->split_horizon = RIPNG_SPLIT_HORIZON;
+  ripng_update_cache_free (ri);
   return CMD_SUCCESS;
 }
 
@@ -1055,6 +1060,7 @@ DEFUN (ipv6_ripng_split_horizon_poisoned_reverse,
   ri = ifp->info;
 
   ri->split_horizon = RIPNG_SPLIT_HORIZON_POISONED_REVERSE;
+  ripng_update_cache_free (ri);
   return CMD_SUCCESS;
 }
 
@@ -1073,6 +1079,7 @@ DEFUN (no_ipv6_ripng_split_horizon,
   ri = ifp->info;
 
   ri->split_horizon = RIPNG_NO_SPLIT_HORIZON;
+  ripng_update_cache_free (ri);
   return CMD_SUCCESS;
 }
 
@@ -1131,6 +1138,7 @@ ripng_if_new_hook (struct interface *ifp)
 static int
 ripng_if_delete_hook (struct interface *ifp)
 {
+  ripng_update_cache_free (ifp->info);
   XFREE (MTYPE_IF, ifp->info);
   ifp->info = NULL;
   return 0;
@@ -1200,7 +1208,7 @@ void
 ripng_if_init ()
 {
   /* Interface initialize. */
-  iflist = list_new ();
+  if_init ();
   if_add_hook (IF_NEW_HOOK, ripng_if_new_hook);
   if_add_hook (IF_DELETE_HOOK, ripng_if_delete_hook);
 
@@ -48,6 +48,7 @@ struct ripng_rte_data {
   struct prefix_ipv6 *p;
   struct ripng_info *rinfo;
   struct ripng_aggregate *aggregate;
+  unsigned int seq;
 };
 
 void _ripng_rte_del(struct ripng_rte_data *A);
@@ -65,7 +66,6 @@ ripng_rte_new(void) {
   struct list *rte;
 
   rte = list_new();
-  rte->cmp = (int (*)(void *, void *)) _ripng_rte_cmp;
   rte->del = (void (*)(void *)) _ripng_rte_del;
 
   return rte;
@@ -92,6 +92,19 @@ _ripng_rte_cmp(struct ripng_rte_data *A, struct ripng_rte_data *B) {
   return addr6_cmp(NEXTHOP_OUT_PTR(A), NEXTHOP_OUT_PTR(B));
 }
 
+/* qsort() wrapper, equal nexthops keep the order they were added in. */
+static int
+ripng_rte_qsort_cmp(const void *a, const void *b) {
+  struct ripng_rte_data *A = *(struct ripng_rte_data * const *) a;
+  struct ripng_rte_data *B = *(struct ripng_rte_data * const *) b;
+  int ret;
+
+  ret = _ripng_rte_cmp(A, B);
+  if (ret)
+    return ret;
+  return (A->seq > B->seq) - (A->seq < B->seq);
+}
+
 /* Add routing table entry */
 void
 ripng_rte_add(struct list *ripng_rte_list, struct prefix_ipv6 *p,
@@ -106,18 +119,41 @@ ripng_rte_add(struct list *ripng_rte_list, struct prefix_ipv6 *p,
   data->p     = p;
   data->rinfo = rinfo;
   data->aggregate = aggregate;
+  data->seq = listcount(ripng_rte_list);
 
-  listnode_add_sort(ripng_rte_list, data);
+  /* Sorted once by ripng_rte_send(), not on each insertion. */
+  listnode_add(ripng_rte_list, data);
 } 
 
-/* Send the RTE with the nexthop support
+/* Send the packet in s, keep a copy in save if given, and reset s. */
+static void
+ripng_rte_flush(struct stream *s, struct sockaddr_in6 *to,
+                struct interface *ifp, struct stream_fifo *save) {
+  int ret;
+
+  ret = ripng_send_packet ((caddr_t) STREAM_DATA (s), stream_get_endp (s),
+                           to, ifp);
+
+  if (ret >= 0 && IS_RIPNG_DEBUG_SEND)
+    ripng_packet_dump ((struct ripng_packet *)STREAM_DATA (s),
+                       stream_get_endp (s), "SEND");
+
+  if (save)
+    stream_fifo_push (save, stream_dup (s));
+
+  stream_reset (s);
+}
+
+/* Send the RTE with the nexthop support.  When save is not NULL the
+ * encoded packets are also queued on it, see ripng_output_process().
  */
 void
 ripng_rte_send(struct list *ripng_rte_list, struct interface *ifp,
-               struct sockaddr_in6 *to) {
+               struct sockaddr_in6 *to, struct stream_fifo *save) {
 
   struct ripng_rte_data *data;
-  struct listnode *node, *nnode;
+  struct ripng_rte_data **rtes;
+  struct listnode *node;
 
   struct in6_addr last_nexthop;
   struct in6_addr myself_nexthop;
@@ -126,7 +162,7 @@ ripng_rte_send(struct list *ripng_rte_list, struct interface *ifp,
   int num;
   int mtu;
   int rtemax;
-  int ret;
+  unsigned int i, count;
 
   /* Most of the time, there is no nexthop */
   memset(&last_nexthop, 0, sizeof(last_nexthop));
@@ -154,20 +190,26 @@ ripng_rte_send(struct list *ripng_rte_list, struct interface *ifp,
 	    sizeof (struct ripng_packet) +
 	    sizeof (struct rte)) / sizeof (struct rte);
 
-  for (ALL_LIST_ELEMENTS (ripng_rte_list, node, nnode, data)) {
+  /* Group the RTEs by nexthop. */
+  count = listcount(ripng_rte_list);
+  if (count == 0)
+    return;
+  rtes = XMALLOC(MTYPE_TMP, count * sizeof(*rtes));
+  i = 0;
+  for (ALL_LIST_ELEMENTS_RO (ripng_rte_list, node, data))
+    rtes[i++] = data;
+  qsort(rtes, count, sizeof(*rtes), ripng_rte_qsort_cmp);
+
+  for (i = 0; i < count; i++) {
+    data = rtes[i];
+
     /* (2.1) Next hop support */
     if (!IPV6_ADDR_SAME(&last_nexthop, NEXTHOP_OUT_PTR(data))) {
 
       /* A nexthop entry should be at least followed by 1 RTE */
       if (num == (rtemax-1)) {
-	ret = ripng_send_packet ((caddr_t) STREAM_DATA (s), stream_get_endp (s),
-				 to, ifp);
-
-        if (ret >= 0 && IS_RIPNG_DEBUG_SEND)
-          ripng_packet_dump((struct ripng_packet *)STREAM_DATA (s),
-			    stream_get_endp(s), "SEND");
+        ripng_rte_flush (s, to, ifp, save);
         num = 0;
-        stream_reset (s);
       }
 
       /* Add the nexthop (2.1) */
@@ -190,26 +232,14 @@ ripng_rte_send(struct list *ripng_rte_list, struct interface *ifp,
 			  TAG_OUT(data), METRIC_OUT(data));
 
     if (num == rtemax) {
-      ret = ripng_send_packet ((caddr_t) STREAM_DATA (s), stream_get_endp (s),
-			       to, ifp);
-
-      if (ret >= 0 && IS_RIPNG_DEBUG_SEND)
-        ripng_packet_dump((struct ripng_packet *)STREAM_DATA (s),
-			  stream_get_endp(s), "SEND");
+      ripng_rte_flush (s, to, ifp, save);
       num = 0;
-      stream_reset (s);
     }
   }
 
+  XFREE(MTYPE_TMP, rtes);
+
   /* If unwritten RTE exist, flush it. */
-  if (num != 0) {
-    ret = ripng_send_packet ((caddr_t) STREAM_DATA (s), stream_get_endp (s),
-			     to, ifp);
-
-    if (ret >= 0 && IS_RIPNG_DEBUG_SEND)
-      ripng_packet_dump ((struct ripng_packet *)STREAM_DATA (s),
-			 stream_get_endp (s), "SEND");
-    num = 0;
-    stream_reset (s);
-  }
+  if (num != 0)
+    ripng_rte_flush (s, to, ifp, save);
 }
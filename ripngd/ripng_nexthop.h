@@ -33,7 +33,7 @@ extern void ripng_rte_add(struct list *ripng_rte_list, struct prefix_ipv6 *p,
                           struct ripng_info *rinfo,
                           struct ripng_aggregate *aggregate);
 extern void ripng_rte_send(struct list *ripng_rte_list, struct interface *ifp,
-                           struct sockaddr_in6 *to);
+                           struct sockaddr_in6 *to, struct stream_fifo *save);
 
 /***
  * 1 if A > B
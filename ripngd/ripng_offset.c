@@ -45,7 +45,7 @@ struct ripng_offset_list
   struct 
   {
     char *alist_name;
-    /* struct access_list *alist; */
+    struct access_list *alist;	/* resolved by ripng_offset_list_update */
     int metric;
   } direct[RIPNG_OFFSET_LIST_MAX];
 };
@@ -144,8 +144,11 @@ ripng_offset_list_set (struct vty *vty, const char *alist,
   if (offset->direct[direct].alist_name)
     free (offset->direct[direct].alist_name);
   offset->direct[direct].alist_name = strdup (alist);
+  offset->direct[direct].alist = access_list_lookup (AFI_IP6, alist);
   offset->direct[direct].metric = metric;
 
+  ripng_update_cache_invalidate ();
+
   return CMD_SUCCESS;
 }
 
@@ -185,6 +188,7 @@ ripng_offset_list_unset (struct vty *vty, const char *alist,
       if (offset->direct[direct].alist_name)
 	free (offset->direct[direct].alist_name);
       offset->direct[direct].alist_name = NULL;
+      offset->direct[direct].alist = NULL;
 
       if (offset->direct[RIPNG_OFFSET_LIST_IN].alist_name == NULL &&
 	  offset->direct[RIPNG_OFFSET_LIST_OUT].alist_name == NULL)
@@ -194,6 +198,7 @@ ripng_offset_list_unset (struct vty *vty, const char *alist,
 	    free (offset->ifname);
 	  ripng_offset_list_free (offset);
 	}
+      ripng_update_cache_invalidate ();
     }
   else
     {
@@ -204,11 +209,30 @@ ripng_offset_list_unset (struct vty *vty, const char *alist,
 }
 
 #define OFFSET_LIST_IN_NAME(O)  ((O)->direct[RIPNG_OFFSET_LIST_IN].alist_name)
+#define OFFSET_LIST_IN_ALIST(O)  ((O)->direct[RIPNG_OFFSET_LIST_IN].alist)
 #define OFFSET_LIST_IN_METRIC(O)  ((O)->direct[RIPNG_OFFSET_LIST_IN].metric)
 
 #define OFFSET_LIST_OUT_NAME(O)  ((O)->direct[RIPNG_OFFSET_LIST_OUT].alist_name)
+#define OFFSET_LIST_OUT_ALIST(O)  ((O)->direct[RIPNG_OFFSET_LIST_OUT].alist)
 #define OFFSET_LIST_OUT_METRIC(O)  ((O)->direct[RIPNG_OFFSET_LIST_OUT].metric)
 
+/* Resolve the access-lists of all offset-lists again, after an
+   access-list was added or deleted. */
+void
+ripng_offset_list_update (void)
+{
+  struct listnode *node;
+  struct ripng_offset_list *offset;
+  int direct;
+
+  for (ALL_LIST_ELEMENTS_RO (ripng_offset_list_master, node, offset))
+    for (direct = 0; direct < RIPNG_OFFSET_LIST_MAX; direct++)
+      offset->direct[direct].alist = offset->direct[direct].alist_name ?
+	access_list_lookup (AFI_IP6, offset->direct[direct].alist_name) : NULL;
+
+  ripng_update_cache_invalidate ();
+}
+
 /* If metric is modifed return 1. */
 int
 ripng_offset_list_apply_in (struct prefix_ipv6 *p, struct interface *ifp,
@@ -221,7 +245,7 @@ ripng_offset_list_apply_in (struct prefix_ipv6 *p, struct interface *ifp,
   offset = ripng_offset_list_lookup (ifp->name);
   if (offset && OFFSET_LIST_IN_NAME (offset))
     {
-      alist = access_list_lookup (AFI_IP6, OFFSET_LIST_IN_NAME (offset));
+      alist = OFFSET_LIST_IN_ALIST (offset);
 
       if (alist 
 	  && access_list_apply (alist, (struct prefix *)p) == FILTER_PERMIT)
@@ -235,7 +259,7 @@ ripng_offset_list_apply_in (struct prefix_ipv6 *p, struct interface *ifp,
   offset = ripng_offset_list_lookup (NULL);
   if (offset && OFFSET_LIST_IN_NAME (offset))
     {
-      alist = access_list_lookup (AFI_IP6, OFFSET_LIST_IN_NAME (offset));
+      alist = OFFSET_LIST_IN_ALIST (offset);
 
       if (alist 
 	  && access_list_apply (alist, (struct prefix *)p) == FILTER_PERMIT)
@@ -260,7 +284,7 @@ ripng_offset_list_apply_out (struct prefix_ipv6 *p, struct interface *ifp,
   offset = ripng_offset_list_lookup (ifp->name);
   if (offset && OFFSET_LIST_OUT_NAME (offset))
     {
-      alist = access_list_lookup (AFI_IP6, OFFSET_LIST_OUT_NAME (offset));
+      alist = OFFSET_LIST_OUT_ALIST (offset);
 
       if (alist 
 	  && access_list_apply (alist, (struct prefix *)p) == FILTER_PERMIT)
@@ -275,7 +299,7 @@ ripng_offset_list_apply_out (struct prefix_ipv6 *p, struct interface *ifp,
   offset = ripng_offset_list_lookup (NULL);
   if (offset && OFFSET_LIST_OUT_NAME (offset))
     {
-      alist = access_list_lookup (AFI_IP6, OFFSET_LIST_OUT_NAME (offset));
+      alist = OFFSET_LIST_OUT_ALIST (offset);
 
       if (alist 
 	  && access_list_apply (alist, (struct prefix *)p) == FILTER_PERMIT)
@@ -112,6 +112,8 @@ ripng_aggregate_add (struct prefix *p)
 	}
     }
 
+  ripng_update_cache_invalidate ();
+
   return 0;
 }
 
@@ -154,5 +156,7 @@ ripng_aggregate_delete (struct prefix *p)
   route_unlock_node (top);
   route_unlock_node (top);
 
+  ripng_update_cache_invalidate ();
+
   return 0;
 }
@@ -177,6 +177,7 @@ ripng_redistribute_metric_set (int type, int metric)
 {
   ripng->route_map[type].metric_config = 1;
   ripng->route_map[type].metric = metric;
+  ripng_update_cache_invalidate ();
 }
 
 static int
@@ -184,6 +185,7 @@ ripng_redistribute_metric_unset (int type)
 {
   ripng->route_map[type].metric_config = 0;
   ripng->route_map[type].metric = 0;
+  ripng_update_cache_invalidate ();
   return 0;
 }
 
@@ -195,6 +197,7 @@ ripng_redistribute_routemap_set (int type, const char *name)
 
   ripng->route_map[type].name = strdup (name);
   ripng->route_map[type].map = route_map_lookup_by_name (name);
+  ripng_update_cache_invalidate ();
 }
 
 static void
@@ -205,6 +208,7 @@ ripng_redistribute_routemap_unset (int type)
 
   ripng->route_map[type].name = NULL;
   ripng->route_map[type].map = NULL;
+  ripng_update_cache_invalidate ();
 }
 
 /* Redistribution types */
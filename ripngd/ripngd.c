@@ -89,10 +89,47 @@ ripng_info_new ()
   return new;
 }
 
+/* Set the route change flag and queue the route on ripng->changed, so
+   that triggered updates need not walk the whole table. */
+static void
+ripng_info_changed (struct ripng_info *rinfo)
+{
+  ripng_update_cache_invalidate ();
+
+  if (rinfo->flags & RIPNG_RTF_CHANGED)
+    return;
+
+  rinfo->flags |= RIPNG_RTF_CHANGED;
+  rinfo->changed_prev = NULL;
+  rinfo->changed_next = ripng->changed;
+  if (ripng->changed)
+    ripng->changed->changed_prev = rinfo;
+  ripng->changed = rinfo;
+}
+
+/* Clear the route change flag and unlink the route from ripng->changed. */
+static void
+ripng_info_unchanged (struct ripng_info *rinfo)
+{
+  if (! (rinfo->flags & RIPNG_RTF_CHANGED))
+    return;
+
+  if (rinfo->changed_prev)
+    rinfo->changed_prev->changed_next = rinfo->changed_next;
+  else
+    ripng->changed = rinfo->changed_next;
+  if (rinfo->changed_next)
+    rinfo->changed_next->changed_prev = rinfo->changed_prev;
+
+  rinfo->changed_next = rinfo->changed_prev = NULL;
+  rinfo->flags &= ~RIPNG_RTF_CHANGED;
+}
+
 /* Free ripng information. */
 void
 ripng_info_free (struct ripng_info *rinfo)
 {
+  ripng_info_unchanged (rinfo);
   XFREE (MTYPE_RIPNG_ROUTE, rinfo);
 }
 
@@ -406,16 +443,15 @@ ripng_lladdr_check (struct interface *ifp, struct in6_addr *addr)
 
 /* RIPng route garbage collect timer. */
 static int
-ripng_garbage_collect (struct thread *t)
+ripng_garbage_collect (struct wheel_timer *t)
 {
   struct ripng_info *rinfo;
   struct route_node *rp;
 
-  rinfo = THREAD_ARG (t);
-  rinfo->t_garbage_collect = NULL;
+  rinfo = WHEEL_ARG (t);
 
   /* Off timeout timer. */
-  RIPNG_TIMER_OFF (rinfo->t_timeout);
+  RIPNG_ROUTE_TIMER_OFF (rinfo->t_timeout);
   
   /* Get route_node pointer. */
   rp = rinfo->rp;
@@ -426,25 +462,25 @@ ripng_garbage_collect (struct thread *t)
 
   /* Free RIPng routing information. */
   ripng_info_free (rinfo);
+  ripng_update_cache_invalidate ();
 
   return 0;
 }
 
 /* Timeout RIPng routes. */
 static int
-ripng_timeout (struct thread *t)
+ripng_timeout (struct wheel_timer *t)
 {
   struct ripng_info *rinfo;
   struct route_node *rp;
 
-  rinfo = THREAD_ARG (t);
-  rinfo->t_timeout = NULL;
+  rinfo = WHEEL_ARG (t);
 
   /* Get route_node pointer. */
   rp = rinfo->rp;
 
   /* - The garbage-collection timer is set for 120 seconds. */
-  RIPNG_TIMER_ON (rinfo->t_garbage_collect, ripng_garbage_collect, 
+  RIPNG_ROUTE_TIMER_ON (rinfo->t_garbage_collect, ripng_garbage_collect, 
 		  ripng->garbage_time);
 
   /* Delete this route from the kernel. */
@@ -460,7 +496,7 @@ ripng_timeout (struct thread *t)
 
   /* - The route change flag is to indicate that this entry has been
      changed. */
-  rinfo->flags |= RIPNG_RTF_CHANGED;
+  ripng_info_changed (rinfo);
 
   /* - The output process is signalled to trigger a response. */
   ripng_event (RIPNG_TRIGGERED_UPDATE, 0);
@@ -471,151 +507,52 @@ ripng_timeout (struct thread *t)
 static void
 ripng_timeout_update (struct ripng_info *rinfo)
 {
+  /* Re-arming only moves the timer to another bucket */
   if (rinfo->metric != RIPNG_METRIC_INFINITY)
-    {
-      RIPNG_TIMER_OFF (rinfo->t_timeout);
-      RIPNG_TIMER_ON (rinfo->t_timeout, ripng_timeout, ripng->timeout_time);
-    }
+    wheel_timer_on (ripng->wheel, &rinfo->t_timeout, ripng_timeout, rinfo,
+                    ripng->timeout_time);
 }
 
-static int
-ripng_incoming_filter (struct prefix_ipv6 *p, struct ripng_interface *ri)
-{
-  struct distribute *dist;
-  struct access_list *alist;
-  struct prefix_list *plist;
-
-  /* Input distribute-list filtering. */
-  if (ri->list[RIPNG_FILTER_IN])
-    {
-      if (access_list_apply (ri->list[RIPNG_FILTER_IN], 
-			     (struct prefix *) p) == FILTER_DENY)
-	{
-	  if (IS_RIPNG_DEBUG_PACKET)
-	    zlog_debug ("%s/%d filtered by distribute in",
-		       inet6_ntoa (p->prefix), p->prefixlen);
-	  return -1;
-	}
-    }
-  if (ri->prefix[RIPNG_FILTER_IN])
-    {
-      if (prefix_list_apply (ri->prefix[RIPNG_FILTER_IN], 
-			     (struct prefix *) p) == PREFIX_DENY)
-	{
-	  if (IS_RIPNG_DEBUG_PACKET)
-	    zlog_debug ("%s/%d filtered by prefix-list in",
-		       inet6_ntoa (p->prefix), p->prefixlen);
-	  return -1;
-	}
-    }
-
-  /* All interface filter check. */
-  dist = distribute_lookup (NULL);
-  if (dist)
-    {
-      if (dist->list[DISTRIBUTE_IN])
-	{
-	  alist = access_list_lookup (AFI_IP6, dist->list[DISTRIBUTE_IN]);
-	    
-	  if (alist)
-	    {
-	      if (access_list_apply (alist,
-				     (struct prefix *) p) == FILTER_DENY)
-		{
-		  if (IS_RIPNG_DEBUG_PACKET)
-		    zlog_debug ("%s/%d filtered by distribute in",
-			       inet6_ntoa (p->prefix), p->prefixlen);
-		  return -1;
-		}
-	    }
-	}
-      if (dist->prefix[DISTRIBUTE_IN])
-	{
-	  plist = prefix_list_lookup (AFI_IP6, dist->prefix[DISTRIBUTE_IN]);
-	  
-	  if (plist)
-	    {
-	      if (prefix_list_apply (plist,
-				     (struct prefix *) p) == PREFIX_DENY)
-		{
-		  if (IS_RIPNG_DEBUG_PACKET)
-		    zlog_debug ("%s/%d filtered by prefix-list in",
-			       inet6_ntoa (p->prefix), p->prefixlen);
-		  return -1;
-		}
-	    }
-	}
-    }
-  return 0;
-}
+/* The lists of the distribute-list that applies to all interfaces,
+   resolved by ripng_distribute_update like those in ripng_interface,
+   so that filtering a route never looks a list up by name. */
+static struct access_list *ripng_all_list[RIPNG_FILTER_MAX];
+static struct prefix_list *ripng_all_prefix[RIPNG_FILTER_MAX];
 
+/* Apply the distribute-lists of direction ripng_distribute, first
+   those of the interface and then those for all interfaces.  Returns
+   -1 if the route is filtered. */
 static int
-ripng_outgoing_filter (struct prefix_ipv6 *p, struct ripng_interface *ri)
+ripng_filter (int ripng_distribute, struct prefix_ipv6 *p,
+	      struct ripng_interface *ri)
 {
-  struct distribute *dist;
   struct access_list *alist;
   struct prefix_list *plist;
+  const char *inout = ripng_distribute == RIPNG_FILTER_OUT ? "out" : "in";
+  int i;
 
-  if (ri->list[RIPNG_FILTER_OUT])
+  for (i = 0; i < 2; i++)
     {
-      if (access_list_apply (ri->list[RIPNG_FILTER_OUT],
-			     (struct prefix *) p) == FILTER_DENY)
+      alist = i ? ripng_all_list[ripng_distribute]
+		: ri->list[ripng_distribute];
+      plist = i ? ripng_all_prefix[ripng_distribute]
+		: ri->prefix[ripng_distribute];
+
+      if (alist && access_list_apply (alist, (struct prefix *) p) == FILTER_DENY)
 	{
 	  if (IS_RIPNG_DEBUG_PACKET)
-	    zlog_debug ("%s/%d is filtered by distribute out",
-		       inet6_ntoa (p->prefix), p->prefixlen);
+	    zlog_debug ("%s/%d filtered by distribute %s",
+			inet6_ntoa (p->prefix), p->prefixlen, inout);
 	  return -1;
 	}
-    }
-  if (ri->prefix[RIPNG_FILTER_OUT])
-    {
-      if (prefix_list_apply (ri->prefix[RIPNG_FILTER_OUT],
-			     (struct prefix *) p) == PREFIX_DENY)
+      if (plist && prefix_list_apply (plist, (struct prefix *) p) == PREFIX_DENY)
 	{
 	  if (IS_RIPNG_DEBUG_PACKET)
-	    zlog_debug ("%s/%d is filtered by prefix-list out",
-		       inet6_ntoa (p->prefix), p->prefixlen);
+	    zlog_debug ("%s/%d filtered by prefix-list %s",
+			inet6_ntoa (p->prefix), p->prefixlen, inout);
 	  return -1;
 	}
     }
-
-  /* All interface filter check. */
-  dist = distribute_lookup (NULL);
-  if (dist)
-    {
-      if (dist->list[DISTRIBUTE_OUT])
-	{
-	  alist = access_list_lookup (AFI_IP6, dist->list[DISTRIBUTE_OUT]);
-	    
-	  if (alist)
-	    {
-	      if (access_list_apply (alist,
-				     (struct prefix *) p) == FILTER_DENY)
-		{
-		  if (IS_RIPNG_DEBUG_PACKET)
-		    zlog_debug ("%s/%d filtered by distribute out",
-			       inet6_ntoa (p->prefix), p->prefixlen);
-		  return -1;
-		}
-	    }
-	}
-      if (dist->prefix[DISTRIBUTE_OUT])
-	{
-	  plist = prefix_list_lookup (AFI_IP6, dist->prefix[DISTRIBUTE_OUT]);
-	  
-	  if (plist)
-	    {
-	      if (prefix_list_apply (plist,
-				     (struct prefix *) p) == PREFIX_DENY)
-		{
-		  if (IS_RIPNG_DEBUG_PACKET)
-		    zlog_debug ("%s/%d filtered by prefix-list out",
-			       inet6_ntoa (p->prefix), p->prefixlen);
-		  return -1;
-		}
-	    }
-	}
-    }
   return 0;
 }
 
@@ -649,7 +586,7 @@ ripng_route_process (struct rte *rte, struct sockaddr_in6 *from,
   /* Apply input filters. */
   ri = ifp->info;
 
-  ret = ripng_incoming_filter (&p, ri);
+  ret = ripng_filter (RIPNG_FILTER_IN, &p, ri);
   if (ret < 0)
     return;
 
@@ -781,7 +718,7 @@ ripng_route_process (struct rte *rte, struct sockaddr_in6 *from,
 	  ripng_timeout_update (rinfo);
 
 	  /* - Set the route change flag. */
-	  rinfo->flags |= RIPNG_RTF_CHANGED;
+	  ripng_info_changed (rinfo);
 
 	  /* - Signal the output process to trigger an update (see section
 	     2.5). */
@@ -841,7 +778,7 @@ ripng_route_process (struct rte *rte, struct sockaddr_in6 *from,
 	      rinfo->type = ZEBRA_ROUTE_RIPNG;
 	      rinfo->sub_type = RIPNG_ROUTE_RTE;
 
-	      RIPNG_TIMER_OFF (rinfo->t_garbage_collect);
+	      RIPNG_ROUTE_TIMER_OFF (rinfo->t_garbage_collect);
 
 	      if (! IPV6_ADDR_SAME (&rinfo->nexthop, nexthop))
 		IPV6_ADDR_COPY (&rinfo->nexthop, nexthop);
@@ -868,7 +805,7 @@ ripng_route_process (struct rte *rte, struct sockaddr_in6 *from,
 
 	  /* - Set the route change flag and signal the output process
 	     to trigger an update. */
-	  rinfo->flags |= RIPNG_RTF_CHANGED;
+	  ripng_info_changed (rinfo);
 	  ripng_event (RIPNG_TRIGGERED_UPDATE, 0);
 
 	  /* - If the new metric is infinity, start the deletion
@@ -884,9 +821,9 @@ ripng_route_process (struct rte *rte, struct sockaddr_in6 *from,
 	      if (oldmetric != RIPNG_METRIC_INFINITY)
 		{
 		  /* - The garbage-collection timer is set for 120 seconds. */
-		  RIPNG_TIMER_ON (rinfo->t_garbage_collect, 
+		  RIPNG_ROUTE_TIMER_ON (rinfo->t_garbage_collect, 
 				  ripng_garbage_collect, ripng->garbage_time);
-		  RIPNG_TIMER_OFF (rinfo->t_timeout);
+		  RIPNG_ROUTE_TIMER_OFF (rinfo->t_timeout);
 
 		  /* - The metric for the route is set to 16
 		     (infinity).  This causes the route to be removed
@@ -963,8 +900,8 @@ ripng_redistribute_add (int type, int sub_type, struct prefix_ipv6 *p,
 	}
       }
       
-      RIPNG_TIMER_OFF (rinfo->t_timeout);
-      RIPNG_TIMER_OFF (rinfo->t_garbage_collect);
+      RIPNG_ROUTE_TIMER_OFF (rinfo->t_timeout);
+      RIPNG_ROUTE_TIMER_OFF (rinfo->t_garbage_collect);
 
       /* Tells the other daemons about the deletion of
        * this RIPng route
@@ -997,7 +934,7 @@ ripng_redistribute_add (int type, int sub_type, struct prefix_ipv6 *p,
   /* Aggregate check. */
   ripng_aggregate_increment (rp, rinfo);
 
-  rinfo->flags |= RIPNG_RTF_CHANGED;
+  ripng_info_changed (rinfo);
 
   if (IS_RIPNG_DEBUG_EVENT) {
     if (!nexthop)
@@ -1048,14 +985,14 @@ ripng_redistribute_delete (int type, int sub_type, struct prefix_ipv6 *p,
 	{
 	  /* Perform poisoned reverse. */
 	  rinfo->metric = RIPNG_METRIC_INFINITY;
-	  RIPNG_TIMER_ON (rinfo->t_garbage_collect, 
+	  RIPNG_ROUTE_TIMER_ON (rinfo->t_garbage_collect, 
 			ripng_garbage_collect, ripng->garbage_time);
-	  RIPNG_TIMER_OFF (rinfo->t_timeout);
+	  RIPNG_ROUTE_TIMER_OFF (rinfo->t_timeout);
 
 	  /* Aggregate count decrement. */
 	  ripng_aggregate_decrement (rp, rinfo);
 
-	  rinfo->flags |= RIPNG_RTF_CHANGED;
+	  ripng_info_changed (rinfo);
 	  
           if (IS_RIPNG_DEBUG_EVENT)
             zlog_debug ("Poisone %s/%d on the interface %s with an infinity metric [delete]",
@@ -1085,14 +1022,14 @@ ripng_redistribute_withdraw (int type)
 	  {
 	    /* Perform poisoned reverse. */
 	    rinfo->metric = RIPNG_METRIC_INFINITY;
-	    RIPNG_TIMER_ON (rinfo->t_garbage_collect, 
+	    RIPNG_ROUTE_TIMER_ON (rinfo->t_garbage_collect, 
 			  ripng_garbage_collect, ripng->garbage_time);
-	    RIPNG_TIMER_OFF (rinfo->t_timeout);
+	    RIPNG_ROUTE_TIMER_OFF (rinfo->t_timeout);
 
 	    /* Aggregate count decrement. */
 	    ripng_aggregate_decrement (rp, rinfo);
 
-	    rinfo->flags |= RIPNG_RTF_CHANGED;
+	    ripng_info_changed (rinfo);
 
 	    if (IS_RIPNG_DEBUG_EVENT) {
 	      struct prefix_ipv6 *p = (struct prefix_ipv6 *) &rp->p;
@@ -1417,17 +1354,12 @@ ripng_read (struct thread *thread)
   return 0;
 }
 
-/* Walk down the RIPng routing table then clear changed flag. */
+/* Clear the changed flag of the routes queued on ripng->changed. */
 static void
 ripng_clear_changed_flag (void)
 {
-  struct route_node *rp;
-  struct ripng_info *rinfo;
-
-  for (rp = route_top (ripng->table); rp; rp = route_next (rp))
-    if ((rinfo = rp->info) != NULL)
-      if (rinfo->flags & RIPNG_RTF_CHANGED)
-	rinfo->flags &= ~RIPNG_RTF_CHANGED;
+  while (ripng->changed)
+    ripng_info_unchanged (ripng->changed);
 }
 
 /* Regular update of RIPng route.  Send all routing formation to RIPng
@@ -1593,230 +1525,330 @@ ripng_write_rte (int num, struct stream *s, struct prefix_ipv6 *p,
   return ++num;
 }
 
-/* Send RESPONSE message to specified destination. */
+/* Mark every interface's cached full update stale.  Called on any
+   route change and on any configuration change that the output filters,
+   route-maps, metrics or split horizon depend on. */
 void
-ripng_output_process (struct interface *ifp, struct sockaddr_in6 *to,
-		      int route_type)
+ripng_update_cache_invalidate (void)
+{
+  if (ripng)
+    ripng->update_version++;
+}
+
+/* Free the cached full update of an interface. */
+void
+ripng_update_cache_free (struct ripng_interface *ri)
+{
+  if (ri->update_cache)
+    {
+      stream_fifo_free (ri->update_cache);
+      ri->update_cache = NULL;
+    }
+}
+
+/* Apply the output filters to a route and add it to the RTE list. */
+static void
+ripng_output_rte (struct interface *ifp, struct ripng_interface *ri,
+		  struct ripng_info *rinfo, struct list *ripng_rte_list)
 {
   int ret;
-  struct route_node *rp;
-  struct ripng_info *rinfo;
-  struct ripng_interface *ri;
-  struct ripng_aggregate *aggregate;
   struct prefix_ipv6 *p;
-  struct list * ripng_rte_list;
 
-  if (IS_RIPNG_DEBUG_EVENT) {
-    if (to)
-      zlog_debug ("RIPng update routes to neighbor %s",
-                 inet6_ntoa(to->sin6_addr));
-    else
-      zlog_debug ("RIPng update routes on interface %s", ifp->name);
+  /* If no route-map are applied, the RTE will be these following
+   * informations.
+   */
+  p = (struct prefix_ipv6 *) &rinfo->rp->p;
+  rinfo->metric_out = rinfo->metric;
+  rinfo->tag_out    = rinfo->tag;
+  memset(&rinfo->nexthop_out, 0, sizeof(rinfo->nexthop_out));
+  /* In order to avoid some local loops,
+   * if the RIPng route has a nexthop via this interface, keep the nexthop,
+   * otherwise set it to 0. The nexthop should not be propagated
+   * beyond the local broadcast/multicast area in order
+   * to avoid an IGP multi-level recursive look-up.
+   */
+  if (rinfo->ifindex == ifp->ifindex)
+    rinfo->nexthop_out = rinfo->nexthop;
+
+  /* Apply output filters. */
+  ret = ripng_filter (RIPNG_FILTER_OUT, p, ri);
+  if (ret < 0)
+    return;
+
+  /* Split horizon. */
+  if (ri->split_horizon == RIPNG_SPLIT_HORIZON)
+  {
+    /* We perform split horizon for RIPng routes. */
+    if ((rinfo->type == ZEBRA_ROUTE_RIPNG) &&
+	rinfo->ifindex == ifp->ifindex)
+      return;
   }
 
-  /* Get RIPng interface. */
-  ri = ifp->info;
- 
-  ripng_rte_list = ripng_rte_new();
- 
-  for (rp = route_top (ripng->table); rp; rp = route_next (rp))
+  /* Preparation for route-map. */
+  rinfo->metric_set = 0;
+  /* nexthop_out,
+   * metric_out
+   * and tag_out are already initialized.
+   */
+
+  /* Interface route-map */
+  if (ri->routemap[RIPNG_FILTER_OUT])
     {
-      if ((rinfo = rp->info) != NULL && rinfo->suppress == 0)
+      ret = route_map_apply (ri->routemap[RIPNG_FILTER_OUT], 
+			     (struct prefix *) p, RMAP_RIPNG, 
+			     rinfo);
+
+      if (ret == RMAP_DENYMATCH)
 	{
-	  /* If no route-map are applied, the RTE will be these following
-	   * informations.
-	   */
-	  p = (struct prefix_ipv6 *) &rp->p;
-	  rinfo->metric_out = rinfo->metric;
-	  rinfo->tag_out    = rinfo->tag;
-	  memset(&rinfo->nexthop_out, 0, sizeof(rinfo->nexthop_out));
-	  /* In order to avoid some local loops,
-	   * if the RIPng route has a nexthop via this interface, keep the nexthop,
-	   * otherwise set it to 0. The nexthop should not be propagated
-	   * beyond the local broadcast/multicast area in order
-	   * to avoid an IGP multi-level recursive look-up.
-	   */
-	  if (rinfo->ifindex == ifp->ifindex)
-	    rinfo->nexthop_out = rinfo->nexthop;
-
-	  /* Apply output filters. */
-	  ret = ripng_outgoing_filter (p, ri);
-	  if (ret < 0)
-	    continue;
-
-	  /* Changed route only output. */
-	  if (route_type == ripng_changed_route &&
-	      (! (rinfo->flags & RIPNG_RTF_CHANGED)))
-	    continue;
-
-	  /* Split horizon. */
-	  if (ri->split_horizon == RIPNG_SPLIT_HORIZON)
-	  {
-	    /* We perform split horizon for RIPng routes. */
-	    if ((rinfo->type == ZEBRA_ROUTE_RIPNG) &&
-		rinfo->ifindex == ifp->ifindex)
-	      continue;
-	  }
+	  if (IS_RIPNG_DEBUG_PACKET)
+	    zlog_debug ("RIPng %s/%d is filtered by route-map out",
+		       inet6_ntoa (p->prefix), p->prefixlen);
+	  return;
+	}
 
-	  /* Preparation for route-map. */
-	  rinfo->metric_set = 0;
-	  /* nexthop_out,
-	   * metric_out
-	   * and tag_out are already initialized.
-	   */
+    }
 
-	  /* Interface route-map */
-	  if (ri->routemap[RIPNG_FILTER_OUT])
-	    {
-	      int ret;
+  /* Redistribute route-map. */
+  if (ripng->route_map[rinfo->type].name)
+    {
+      ret = route_map_apply (ripng->route_map[rinfo->type].map,
+			     (struct prefix *) p, RMAP_RIPNG,
+			     rinfo);
 
-	      ret = route_map_apply (ri->routemap[RIPNG_FILTER_OUT], 
-				     (struct prefix *) p, RMAP_RIPNG, 
-				     rinfo);
+      if (ret == RMAP_DENYMATCH)
+	{
+	  if (IS_RIPNG_DEBUG_PACKET)
+	    zlog_debug ("RIPng %s/%d is filtered by route-map",
+		       inet6_ntoa (p->prefix), p->prefixlen);
+	  return;
+	}
+    }
 
-	      if (ret == RMAP_DENYMATCH)
-		{
-		  if (IS_RIPNG_DEBUG_PACKET)
-		    zlog_debug ("RIPng %s/%d is filtered by route-map out",
-			       inet6_ntoa (p->prefix), p->prefixlen);
-		  continue;
-		}
+  /* When the route-map does not set metric. */
+  if (! rinfo->metric_set)
+    {
+      /* If the redistribute metric is set. */
+      if (ripng->route_map[rinfo->type].metric_config
+	  && rinfo->metric != RIPNG_METRIC_INFINITY)
+	{
+	  rinfo->metric_out = ripng->route_map[rinfo->type].metric;
+	}
+      else
+	{
+	  /* If the route is not connected or localy generated
+	     one, use default-metric value */
+	  if (rinfo->type != ZEBRA_ROUTE_RIPNG
+	      && rinfo->type != ZEBRA_ROUTE_CONNECT
+	      && rinfo->metric != RIPNG_METRIC_INFINITY)
+	    rinfo->metric_out = ripng->default_metric;
+	}
+    }
 
-	    }
+  /* Apply offset-list */
+  if (rinfo->metric_out != RIPNG_METRIC_INFINITY)
+    ripng_offset_list_apply_out (p, ifp, &rinfo->metric_out);
 
-	  /* Redistribute route-map. */
-	  if (ripng->route_map[rinfo->type].name)
-	    {
-	      int ret;
+  if (rinfo->metric_out > RIPNG_METRIC_INFINITY)
+    rinfo->metric_out = RIPNG_METRIC_INFINITY;
 
-	      ret = route_map_apply (ripng->route_map[rinfo->type].map,
-				     (struct prefix *) p, RMAP_RIPNG,
-				     rinfo);
+  /* Perform split-horizon with poisoned reverse 
+   * for RIPng routes.
+   **/
+  if (ri->split_horizon == RIPNG_SPLIT_HORIZON_POISONED_REVERSE) {
+    if ((rinfo->type == ZEBRA_ROUTE_RIPNG) &&
+	 rinfo->ifindex == ifp->ifindex)
+	 rinfo->metric_out = RIPNG_METRIC_INFINITY;
+  }
 
-	      if (ret == RMAP_DENYMATCH)
-		{
-		  if (IS_RIPNG_DEBUG_PACKET)
-		    zlog_debug ("RIPng %s/%d is filtered by route-map",
-			       inet6_ntoa (p->prefix), p->prefixlen);
-		  continue;
-		}
-	    }
+  /* Add RTE to the list */
+  ripng_rte_add(ripng_rte_list, p, rinfo, NULL);
+}
 
-	  /* When the route-map does not set metric. */
-	  if (! rinfo->metric_set)
-	    {
-	      /* If the redistribute metric is set. */
-	      if (ripng->route_map[rinfo->type].metric_config
-		  && rinfo->metric != RIPNG_METRIC_INFINITY)
-		{
-		  rinfo->metric_out = ripng->route_map[rinfo->type].metric;
-		}
-	      else
-		{
-		  /* If the route is not connected or localy generated
-		     one, use default-metric value */
-		  if (rinfo->type != ZEBRA_ROUTE_RIPNG
-		      && rinfo->type != ZEBRA_ROUTE_CONNECT
-		      && rinfo->metric != RIPNG_METRIC_INFINITY)
-		    rinfo->metric_out = ripng->default_metric;
-		}
-	    }
+/* Apply the output filters to the aggregate of rp and add it to the RTE
+   list.  An aggregate without any more routes under it is announced
+   with an infinite metric, for triggered updates. */
+static void
+ripng_output_aggregate (struct interface *ifp, struct ripng_interface *ri,
+			struct route_node *rp, struct list *ripng_rte_list)
+{
+  int ret;
+  struct ripng_aggregate *aggregate;
+  struct prefix_ipv6 *p;
 
-          /* Apply offset-list */
-	  if (rinfo->metric_out != RIPNG_METRIC_INFINITY)
-            ripng_offset_list_apply_out (p, ifp, &rinfo->metric_out);
+  aggregate = rp->aggregate;
 
-          if (rinfo->metric_out > RIPNG_METRIC_INFINITY)
-            rinfo->metric_out = RIPNG_METRIC_INFINITY;
+  /* If no route-map are applied, the RTE will be these following
+   * informations.
+   */
+  p = (struct prefix_ipv6 *) &rp->p;
+  aggregate->metric_set = 0;
+  aggregate->metric_out = aggregate->metric;
+  aggregate->tag_out    = aggregate->tag;
+  memset(&aggregate->nexthop_out, 0, sizeof(aggregate->nexthop_out));
+
+  /* Apply output filters.*/
+  ret = ripng_filter (RIPNG_FILTER_OUT, p, ri);
+  if (ret < 0)
+    return;
 
-	  /* Perform split-horizon with poisoned reverse 
-	   * for RIPng routes.
-	   **/
-	  if (ri->split_horizon == RIPNG_SPLIT_HORIZON_POISONED_REVERSE) {
-	    if ((rinfo->type == ZEBRA_ROUTE_RIPNG) &&
-	         rinfo->ifindex == ifp->ifindex)
-	         rinfo->metric_out = RIPNG_METRIC_INFINITY;
-	  }
+  /* Interface route-map */
+  if (ri->routemap[RIPNG_FILTER_OUT])
+    {
+      struct ripng_info newinfo;
 
-	  /* Add RTE to the list */
-	  ripng_rte_add(ripng_rte_list, p, rinfo, NULL);
-	}
+      /* let's cast the aggregate structure to ripng_info */
+      memset (&newinfo, 0, sizeof (struct ripng_info));
+      /* the nexthop is :: */
+      newinfo.metric = aggregate->metric;
+      newinfo.metric_out = aggregate->metric_out;
+      newinfo.tag = aggregate->tag;
+      newinfo.tag_out = aggregate->tag_out;
 
-      /* Process the aggregated RTE entry */
-      if ((aggregate = rp->aggregate) != NULL && 
-	  aggregate->count > 0 && 
-	  aggregate->suppress == 0)
+      ret = route_map_apply (ri->routemap[RIPNG_FILTER_OUT], 
+			     (struct prefix *) p, RMAP_RIPNG, 
+			     &newinfo);
+
+      if (ret == RMAP_DENYMATCH)
 	{
-	  /* If no route-map are applied, the RTE will be these following
-	   * informations.
-	   */
-	  p = (struct prefix_ipv6 *) &rp->p;
-	  aggregate->metric_set = 0;
-	  aggregate->metric_out = aggregate->metric;
-	  aggregate->tag_out    = aggregate->tag;
-	  memset(&aggregate->nexthop_out, 0, sizeof(aggregate->nexthop_out));
-
-	  /* Apply output filters.*/
-	  ret = ripng_outgoing_filter (p, ri);
-	  if (ret < 0)
-	    continue;
-
-	  /* Interface route-map */
-	  if (ri->routemap[RIPNG_FILTER_OUT])
-	    {
-	      int ret;
-	      struct ripng_info newinfo;
-
-	      /* let's cast the aggregate structure to ripng_info */
-	      memset (&newinfo, 0, sizeof (struct ripng_info));
-	      /* the nexthop is :: */
-	      newinfo.metric = aggregate->metric;
-	      newinfo.metric_out = aggregate->metric_out;
-	      newinfo.tag = aggregate->tag;
-	      newinfo.tag_out = aggregate->tag_out;
-
-	      ret = route_map_apply (ri->routemap[RIPNG_FILTER_OUT], 
-				     (struct prefix *) p, RMAP_RIPNG, 
-				     &newinfo);
-
-	      if (ret == RMAP_DENYMATCH)
-		{
-		  if (IS_RIPNG_DEBUG_PACKET)
-		    zlog_debug ("RIPng %s/%d is filtered by route-map out",
-			       inet6_ntoa (p->prefix), p->prefixlen);
-		  continue;
-		}
+	  if (IS_RIPNG_DEBUG_PACKET)
+	    zlog_debug ("RIPng %s/%d is filtered by route-map out",
+		       inet6_ntoa (p->prefix), p->prefixlen);
+	  return;
+	}
 
-	      aggregate->metric_out = newinfo.metric_out;
-	      aggregate->tag_out = newinfo.tag_out;
-	      if (IN6_IS_ADDR_LINKLOCAL(&newinfo.nexthop_out))
-		aggregate->nexthop_out = newinfo.nexthop_out;
-	    }
+      aggregate->metric_out = newinfo.metric_out;
+      aggregate->tag_out = newinfo.tag_out;
+      if (IN6_IS_ADDR_LINKLOCAL(&newinfo.nexthop_out))
+	aggregate->nexthop_out = newinfo.nexthop_out;
+    }
+
+  /* There is no redistribute routemap for the aggregated RTE */
 
-	  /* There is no redistribute routemap for the aggregated RTE */
+  /* Apply offset-list */
+  if (aggregate->metric_out != RIPNG_METRIC_INFINITY)
+    ripng_offset_list_apply_out (p, ifp, &aggregate->metric_out);
+
+  if (aggregate->metric_out > RIPNG_METRIC_INFINITY
+      || aggregate->count == 0)
+    aggregate->metric_out = RIPNG_METRIC_INFINITY;
+
+  /* Add RTE to the list */
+  ripng_rte_add(ripng_rte_list, p, NULL, aggregate);
+}
+
+/* Changed route only output.  Besides the changed routes that are not
+   suppressed, the outermost aggregate covering a changed route is sent,
+   so that a neighbour learns of it appearing, or going away once its
+   last route has, without waiting for the next regular update. */
+static void
+ripng_output_changed (struct interface *ifp, struct ripng_interface *ri,
+		      struct list *ripng_rte_list)
+{
+  struct ripng_info *rinfo;
+  struct route_node *np, *top;
+  struct ripng_aggregate *aggregate;
+  struct list *aggregates;
 
-	  /* Changed route only output. */
-	  /* XXX, vincent, in order to increase time convergence,
-	   * it should be announced if a child has changed.
-	   */
-	  if (route_type == ripng_changed_route)
-	    continue;
+  aggregates = list_new ();
 
-	  /* Apply offset-list */
-	  if (aggregate->metric_out != RIPNG_METRIC_INFINITY)
-	    ripng_offset_list_apply_out (p, ifp, &aggregate->metric_out);
+  for (rinfo = ripng->changed; rinfo; rinfo = rinfo->changed_next)
+    {
+      if (rinfo->suppress == 0)
+	ripng_output_rte (ifp, ri, rinfo, ripng_rte_list);
 
-	  if (aggregate->metric_out > RIPNG_METRIC_INFINITY)
-	    aggregate->metric_out = RIPNG_METRIC_INFINITY;
+      top = NULL;
+      for (np = rinfo->rp; np; np = np->parent)
+	if ((aggregate = np->aggregate) != NULL && aggregate->suppress == 0)
+	  top = np;
 
-	  /* Add RTE to the list */
-	  ripng_rte_add(ripng_rte_list, p, NULL, aggregate);
+      if (top && ! listnode_lookup (aggregates, top))
+	{
+	  listnode_add (aggregates, top);
+	  ripng_output_aggregate (ifp, ri, top, ripng_rte_list);
 	}
+    }
+
+  list_delete (aggregates);
+}
+
+/* The cached full update of ifp can be sent as it is. */
+static int
+ripng_update_cache_valid (struct interface *ifp, struct ripng_interface *ri)
+{
+  return (ri->update_cache != NULL
+	  && ri->update_version == ripng->update_version
+	  && ri->update_mtu == ifp->mtu6
+	  && ri->update_ifindex == ifp->ifindex);
+}
+
+/* Send RESPONSE message to specified destination.  A full update is
+   encoded once and then replayed from the interface's cache until a
+   route or the output configuration changes; a triggered update only
+   visits the routes queued on ripng->changed. */
+void
+ripng_output_process (struct interface *ifp, struct sockaddr_in6 *to,
+		      int route_type)
+{
+  struct route_node *rp;
+  struct ripng_info *rinfo;
+  struct ripng_interface *ri;
+  struct ripng_aggregate *aggregate;
+  struct list * ripng_rte_list;
+  struct stream *s;
+
+  if (IS_RIPNG_DEBUG_EVENT) {
+    if (to)
+      zlog_debug ("RIPng update routes to neighbor %s",
+                 inet6_ntoa(to->sin6_addr));
+    else
+      zlog_debug ("RIPng update routes on interface %s", ifp->name);
+  }
 
+  /* Get RIPng interface. */
+  ri = ifp->info;
+
+  if (route_type == ripng_all_route && ripng_update_cache_valid (ifp, ri))
+    {
+      for (s = ri->update_cache->head; s; s = s->next)
+	if (ripng_send_packet ((caddr_t) STREAM_DATA (s), stream_get_endp (s),
+			       to, ifp) >= 0 && IS_RIPNG_DEBUG_SEND)
+	  ripng_packet_dump ((struct ripng_packet *) STREAM_DATA (s),
+			     stream_get_endp (s), "SEND");
+      return;
+    }
+ 
+  ripng_rte_list = ripng_rte_new();
+
+  if (route_type == ripng_changed_route)
+    {
+      ripng_output_changed (ifp, ri, ripng_rte_list);
+      ripng_rte_send(ripng_rte_list, ifp, to, NULL);
+      ripng_rte_free(ripng_rte_list);
+      return;
+    }
+
+  for (rp = route_top (ripng->table); rp; rp = route_next (rp))
+    {
+      if ((rinfo = rp->info) != NULL && rinfo->suppress == 0)
+	ripng_output_rte (ifp, ri, rinfo, ripng_rte_list);
+
+      /* Process the aggregated RTE entry */
+      if ((aggregate = rp->aggregate) != NULL && 
+	  aggregate->count > 0 && 
+	  aggregate->suppress == 0)
+	ripng_output_aggregate (ifp, ri, rp, ripng_rte_list);
     }
 
-  /* Flush the list */
-  ripng_rte_send(ripng_rte_list, ifp, to);
+  /* Flush the list, keeping the packets for the next full update. */
+  if (ri->update_cache)
+    stream_fifo_clean (ri->update_cache);
+  else
+    ri->update_cache = stream_fifo_new ();
+  ri->update_version = ripng->update_version;
+  ri->update_mtu = ifp->mtu6;
+  ri->update_ifindex = ifp->ifindex;
+
+  ripng_rte_send(ripng_rte_list, ifp, to, ri->update_cache);
   ripng_rte_free(ripng_rte_list);
 }
 
@@ -1841,6 +1873,8 @@ ripng_create (void)
   ripng->ibuf = stream_new (RIPNG_MAX_PACKET_SIZE * 5);
   ripng->obuf = stream_new (RIPNG_MAX_PACKET_SIZE);
 
+  ripng->wheel = wheel_new (master, WHEEL_SIZE_DEFAULT);
+
   /* Initialize RIPng routig table. */
   ripng->table = route_table_init ();
   ripng->route = route_table_init ();
@@ -1938,18 +1972,17 @@ ripng_vty_out_uptime (struct vty *vty, struct ripng_info *rinfo)
   struct tm *tm;
 #define TIME_BUF 25
   char timebuf [TIME_BUF];
-  struct thread *thread;
-  
-  if ((thread = rinfo->t_timeout) != NULL)
+
+  if (WHEEL_TIMER_ARMED (&rinfo->t_timeout))
     {
-      clock = thread_timer_remain_second (thread);
+      clock = wheel_timer_remain (&rinfo->t_timeout);
       tm = gmtime (&clock);
       strftime (timebuf, TIME_BUF, "%M:%S", tm);
       vty_out (vty, "%5s", timebuf);
     }
-  else if ((thread = rinfo->t_garbage_collect) != NULL)
+  else if (WHEEL_TIMER_ARMED (&rinfo->t_garbage_collect))
     {
-      clock = thread_timer_remain_second (thread);
+      clock = wheel_timer_remain (&rinfo->t_garbage_collect);
       tm = gmtime (&clock);
       strftime (timebuf, TIME_BUF, "%M:%S", tm);
       vty_out (vty, "%5s", timebuf);
@@ -2345,6 +2378,7 @@ DEFUN (ripng_default_metric,
   if (ripng)
     {
       ripng->default_metric = atoi (argv[0]);
+      ripng_update_cache_invalidate ();
     }
   return CMD_SUCCESS;
 }
@@ -2359,6 +2393,7 @@ DEFUN (no_ripng_default_metric,
   if (ripng)
     {
       ripng->default_metric = RIPNG_DEFAULT_METRIC_DEFAULT;
+      ripng_update_cache_invalidate ();
     }
   return CMD_SUCCESS;
 }
@@ -2679,66 +2714,49 @@ static struct cmd_node cmd_ripng_node =
   1,
 };
 
+static void
+ripng_distribute_resolve (struct distribute *dist, struct access_list **list,
+			  struct prefix_list **prefix)
+{
+  list[RIPNG_FILTER_IN] = NULL;
+  list[RIPNG_FILTER_OUT] = NULL;
+  prefix[RIPNG_FILTER_IN] = NULL;
+  prefix[RIPNG_FILTER_OUT] = NULL;
+
+  if (dist->list[DISTRIBUTE_IN])
+    list[RIPNG_FILTER_IN] = access_list_lookup (AFI_IP6,
+						dist->list[DISTRIBUTE_IN]);
+  if (dist->list[DISTRIBUTE_OUT])
+    list[RIPNG_FILTER_OUT] = access_list_lookup (AFI_IP6,
+						 dist->list[DISTRIBUTE_OUT]);
+  if (dist->prefix[DISTRIBUTE_IN])
+    prefix[RIPNG_FILTER_IN] = prefix_list_lookup (AFI_IP6,
+						   dist->prefix[DISTRIBUTE_IN]);
+  if (dist->prefix[DISTRIBUTE_OUT])
+    prefix[RIPNG_FILTER_OUT] = prefix_list_lookup (AFI_IP6,
+						    dist->prefix[DISTRIBUTE_OUT]);
+}
+
 static void
 ripng_distribute_update (struct distribute *dist)
 {
   struct interface *ifp;
   struct ripng_interface *ri;
-  struct access_list *alist;
-  struct prefix_list *plist;
+
+  ripng_update_cache_invalidate ();
 
   if (! dist->ifname)
-    return;
+    {
+      ripng_distribute_resolve (dist, ripng_all_list, ripng_all_prefix);
+      return;
+    }
 
   ifp = if_lookup_by_name (dist->ifname);
   if (ifp == NULL)
     return;
 
   ri = ifp->info;
-
-  if (dist->list[DISTRIBUTE_IN])
-    {
-      alist = access_list_lookup (AFI_IP6, dist->list[DISTRIBUTE_IN]);
-      if (alist)
-	ri->list[RIPNG_FILTER_IN] = alist;
-      else
-	ri->list[RIPNG_FILTER_IN] = NULL;
-    }
-  else
-    ri->list[RIPNG_FILTER_IN] = NULL;
-
-  if (dist->list[DISTRIBUTE_OUT])
-    {
-      alist = access_list_lookup (AFI_IP6, dist->list[DISTRIBUTE_OUT]);
-      if (alist)
-	ri->list[RIPNG_FILTER_OUT] = alist;
-      else
-	ri->list[RIPNG_FILTER_OUT] = NULL;
-    }
-  else
-    ri->list[RIPNG_FILTER_OUT] = NULL;
-
-  if (dist->prefix[DISTRIBUTE_IN])
-    {
-      plist = prefix_list_lookup (AFI_IP6, dist->prefix[DISTRIBUTE_IN]);
-      if (plist)
-	ri->prefix[RIPNG_FILTER_IN] = plist;
-      else
-	ri->prefix[RIPNG_FILTER_IN] = NULL;
-    }
-  else
-    ri->prefix[RIPNG_FILTER_IN] = NULL;
-
-  if (dist->prefix[DISTRIBUTE_OUT])
-    {
-      plist = prefix_list_lookup (AFI_IP6, dist->prefix[DISTRIBUTE_OUT]);
-      if (plist)
-	ri->prefix[RIPNG_FILTER_OUT] = plist;
-      else
-	ri->prefix[RIPNG_FILTER_OUT] = NULL;
-    }
-  else
-    ri->prefix[RIPNG_FILTER_OUT] = NULL;
+  ripng_distribute_resolve (dist, ri->list, ri->prefix);
 }
 
 void
@@ -2757,15 +2775,28 @@ ripng_distribute_update_all (struct prefix_list *notused)
 {
   struct interface *ifp;
   struct listnode *node;
+  struct distribute *dist;
+
+  ripng_update_cache_invalidate ();
 
   for (ALL_LIST_ELEMENTS_RO (iflist, node, ifp))
     ripng_distribute_update_interface (ifp);
+
+  dist = distribute_lookup (NULL);
+  if (dist)
+    ripng_distribute_update (dist);
+  else
+    {
+      memset (ripng_all_list, 0, sizeof (ripng_all_list));
+      memset (ripng_all_prefix, 0, sizeof (ripng_all_prefix));
+    }
 }
 
 static void
 ripng_distribute_update_all_wrapper (struct access_list *notused)
 {
   ripng_distribute_update_all(NULL);
+  ripng_offset_list_update ();
 }
 
 /* delete all the added ripng routes. */
@@ -2785,8 +2816,8 @@ ripng_clean()
           ripng_zebra_ipv6_delete ((struct prefix_ipv6 *)&rp->p,
                                    &rinfo->nexthop, rinfo->metric);
 
-        RIPNG_TIMER_OFF (rinfo->t_timeout);
-        RIPNG_TIMER_OFF (rinfo->t_garbage_collect);
+        RIPNG_ROUTE_TIMER_OFF (rinfo->t_timeout);
+        RIPNG_ROUTE_TIMER_OFF (rinfo->t_garbage_collect);
 
         rp->info = NULL;
         route_unlock_node (rp);
@@ -2799,6 +2830,7 @@ ripng_clean()
     RIPNG_TIMER_OFF (ripng->t_update);
     RIPNG_TIMER_OFF (ripng->t_triggered_update);
     RIPNG_TIMER_OFF (ripng->t_triggered_interval);
+    wheel_free (ripng->wheel);
 
     /* Cancel the read thread */
     if (ripng->t_read) {
@@ -2859,6 +2891,8 @@ ripng_reset ()
   prefix_list_reset ();
 
   distribute_list_reset ();
+  memset (ripng_all_list, 0, sizeof (ripng_all_list));
+  memset (ripng_all_prefix, 0, sizeof (ripng_all_prefix));
 
   ripng_interface_reset ();
 
@@ -2877,6 +2911,7 @@ ripng_if_rmap_update (struct if_rmap *if_rmap)
     return;
 
   ri = ifp->info;
+  ripng_update_cache_invalidate ();
 
   if (if_rmap->routemap[IF_RMAP_IN])
     {
@@ -2937,6 +2972,14 @@ ripng_routemap_update (const char *unused)
     ripng_if_rmap_update_interface (ifp);
 
   ripng_routemap_update_redistribute ();
+  ripng_update_cache_invalidate ();
+}
+
+/* A route-map was edited, its output may have changed. */
+static void
+ripng_routemap_event (route_map_event_t event, const char *unused)
+{
+  ripng_update_cache_invalidate ();
 }
 
 /* Initialize ripng structure and set commands. */
@@ -3008,6 +3051,7 @@ ripng_init ()
 
   route_map_add_hook (ripng_routemap_update);
   route_map_delete_hook (ripng_routemap_update);
+  route_map_event_hook (ripng_routemap_event);
 
   if_rmap_init (RIPNG_NODE);
   if_rmap_hook_add (ripng_if_rmap_update);
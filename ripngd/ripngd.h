@@ -25,6 +25,7 @@
 
 #include <zclient.h>
 #include <vty.h>
+#include <wheel.h>
 
 /* RIPng version and port number. */
 #define RIPNG_V1                         1
@@ -129,6 +130,16 @@ struct ripng
   struct thread *t_triggered_update;
   struct thread *t_triggered_interval;
 
+  /* Timeout and garbage collect timers of the routes. */
+  struct wheel *wheel;
+
+  /* Routes with RIPNG_RTF_CHANGED set, for triggered updates. */
+  struct ripng_info *changed;
+
+  /* Bumped whenever a full update may encode differently, see
+     ripng_update_cache_invalidate(). */
+  u_int32_t update_version;
+
   /* For redistribute route map. */
   struct
   {
@@ -189,9 +200,9 @@ struct ripng_info
 #define RIPNG_RTF_CHANGED  2
   u_char flags;
 
-  /* Garbage collect timer. */
-  struct thread *t_timeout;
-  struct thread *t_garbage_collect;
+  /* Garbage collect timer, on ripng->wheel. */
+  struct wheel_timer t_timeout;
+  struct wheel_timer t_garbage_collect;
 
   /* Route-map features - this variables can be changed. */
   struct in6_addr nexthop_out;
@@ -200,6 +211,10 @@ struct ripng_info
   u_short tag_out;
 
   struct route_node *rp;
+
+  /* Linkage on ripng->changed while RIPNG_RTF_CHANGED is set. */
+  struct ripng_info *changed_next;
+  struct ripng_info *changed_prev;
 };
 
 #ifdef notyet
@@ -283,6 +298,13 @@ struct ripng_interface
 
   /* Passive interface. */
   int passive;
+
+  /* Encoded packets of the last full update, replayed while
+     ripng->update_version, the MTU and the ifindex are unchanged. */
+  struct stream_fifo *update_cache;
+  u_int32_t update_version;
+  unsigned int update_mtu;
+  unsigned int update_ifindex;
 };
 
 /* RIPng peer information. */
@@ -319,12 +341,14 @@ enum ripng_event
 };
 
 /* RIPng timer on/off macro. */
-#define RIPNG_TIMER_ON(T,F,V) \
+#define RIPNG_ROUTE_TIMER_ON(T,F,V) \
 do { \
-   if (!(T)) \
-      (T) = thread_add_timer (master, (F), rinfo, (V)); \
+   if (!WHEEL_TIMER_ARMED (&(T))) \
+      wheel_timer_on (ripng->wheel, &(T), (F), rinfo, (V)); \
 } while (0)
 
+#define RIPNG_ROUTE_TIMER_OFF(T)  wheel_timer_off (ripng->wheel, &(T))
+
 #define RIPNG_TIMER_OFF(T) \
 do { \
    if (T) \
@@ -375,10 +399,13 @@ extern int ripng_offset_list_apply_in (struct prefix_ipv6 *,
 extern int ripng_offset_list_apply_out (struct prefix_ipv6 *,
                                         struct interface *, u_char *);
 extern void ripng_offset_clean (void);
+extern void ripng_offset_list_update (void);
 
 extern struct ripng_info * ripng_info_new (void);
 extern void ripng_info_free (struct ripng_info *rinfo);
 extern void ripng_event (enum ripng_event, int);
+extern void ripng_update_cache_invalidate (void);
+extern void ripng_update_cache_free (struct ripng_interface *);
 extern int ripng_request (struct interface *ifp);
 extern void ripng_redistribute_add (int, int, struct prefix_ipv6 *,
                                     unsigned int, struct in6_addr *);
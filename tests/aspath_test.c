@@ -7,6 +7,7 @@
 #include "bgpd/bgpd.h"
 #include "bgpd/bgp_aspath.h"
 #include "bgpd/bgp_attr.h"
+#include "bgpd/bgp_perf.h"
 
 #define VT100_RESET "\x1b[0m"
 #define VT100_RED "\x1b[31m"
@@ -1210,6 +1211,7 @@ handle_attr_test (struct aspath_tests *t)
 {
   struct bgp bgp = { 0 }; 
   struct peer peer = { 0 };
+  struct bgp_perf perf = { { { 0 } } };
   struct attr attr = { 0 };  
   int ret;
   int initfail = failed;
@@ -1220,6 +1222,7 @@ handle_attr_test (struct aspath_tests *t)
     
   peer.ibuf = stream_new (BGP_MAX_PACKET_SIZE);
   peer.obuf = stream_fifo_new ();
+  peer.perf = &perf;
   peer.bgp = &bgp;
   peer.host = (char *)"none";
   peer.fd = -1;
@@ -1252,17 +1255,17 @@ handle_attr_test (struct aspath_tests *t)
       printf ("aspath is NULL, but should be: %s\n", t->shouldbe);
       failed++;
     }
-  if (t->shouldbe && attr.aspath && strcmp (attr.aspath->str, t->shouldbe))
+  if (t->shouldbe && attr.aspath && strcmp (aspath_print (attr.aspath), t->shouldbe))
     {
       printf ("attr str and 'shouldbe' mismatched!\n"
               "attr str:  %s\n"
               "shouldbe:  %s\n",
-              attr.aspath->str, t->shouldbe);
+              aspath_print (attr.aspath), t->shouldbe);
       failed++;
     }
   if (!t->shouldbe && attr.aspath)
     {
-      printf ("aspath should be NULL, but is: %s\n", attr.aspath->str);
+      printf ("aspath should be NULL, but is: %s\n", aspath_print (attr.aspath));
       failed++;
     }
 
@@ -0,0 +1,774 @@
+/* Microbenchmarks for bgpd hot paths.
+   Copyright (C) 2026 The Quagga project
+
+This file is part of GNU Zebra.
+
+GNU Zebra is free software; you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation; either version 2, or (at your option) any
+later version.
+
+GNU Zebra is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with GNU Zebra; see the file COPYING.  If not, write to the Free
+Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+02111-1307, USA.  */
+
+/* Each benchmark runs its operation over a set of inputs, doubling the
+ * number of operations until a run takes at least the minimum time, and
+ * reports the time and the allocations made per operation of that run.
+ *
+ * The inputs are path attributes and prefixes, either made up from a
+ * seeded generator or taken from the IPv4 unicast RIB entries of an MRT
+ * TABLE_DUMP_V2 file, such as "dump bgp routes-mrt" writes.  Inputs whose
+ * attributes do not parse are dropped.
+ */
+
+#include <zebra.h>
+
+#include "vty.h"
+#include "command.h"
+#include "stream.h"
+#include "privs.h"
+#include "memory.h"
+#include "thread.h"
+#include "log.h"
+#include "prefix.h"
+#include "table.h"
+#include "plist.h"
+#include "routemap.h"
+#include "sockunion.h"
+
+#include "bgpd/bgpd.h"
+#include "bgpd/bgp_aspath.h"
+#include "bgpd/bgp_attr.h"
+#include "bgpd/bgp_route.h"
+#include "bgpd/bgp_dump.h"
+
+/* need these to link in libbgp */
+struct zebra_privs_t *bgpd_privs = NULL;
+struct thread_master *master = NULL;
+
+static struct bgp *bgp;
+static struct peer *peer;
+static struct peer *peer2;
+
+/* One set of path attributes, as sent on the wire, and a prefix. */
+struct bench_input
+{
+  u_char *data;
+  bgp_size_t length;
+  bgp_size_t aspath_offset;
+  bgp_size_t aspath_length;
+  struct prefix_ipv4 p;
+  struct prefix_ipv4 host;
+  struct attr *attr;		/* interned */
+  struct aspath *aspath;	/* interned */
+};
+
+static struct bench_input *inputs;
+static unsigned int ninputs;
+static unsigned int maxinputs = 10000;
+static unsigned long min_usecs = 200000;
+static u_int32_t seed = 1;
+
+static struct route_table *table;
+static struct bgp_info *infos;
+static struct stream *aspath_s;
+
+static u_int32_t
+bench_random (void)
+{
+  /* xorshift32, so runs are the same everywhere for a given seed */
+  seed ^= seed << 13;
+  seed ^= seed >> 17;
+  seed ^= seed << 5;
+  return seed;
+}
+
+/* Find the AS_PATH in the attributes of an input. */
+static int
+bench_input_find_aspath (struct bench_input *in)
+{
+  bgp_size_t pos = 0;
+
+  while (pos + 3 <= in->length)
+    {
+      u_char flag = in->data[pos];
+      u_char type = in->data[pos + 1];
+      bgp_size_t len, hdr;
+
+      if (CHECK_FLAG (flag, BGP_ATTR_FLAG_EXTLEN))
+	{
+	  if (pos + 4 > in->length)
+	    return -1;
+	  len = (in->data[pos + 2] << 8) | in->data[pos + 3];
+	  hdr = 4;
+	}
+      else
+	{
+	  len = in->data[pos + 2];
+	  hdr = 3;
+	}
+      if (pos + hdr + len > in->length)
+	return -1;
+      if (type == BGP_ATTR_AS_PATH)
+	{
+	  in->aspath_offset = pos + hdr;
+	  in->aspath_length = len;
+	  return 0;
+	}
+      pos += hdr + len;
+    }
+  return -1;
+}
+
+static void
+bench_input_add (const u_char *data, bgp_size_t length,
+		 struct in_addr prefix, u_char prefixlen)
+{
+  struct bench_input *in;
+
+  if (ninputs >= maxinputs)
+    return;
+
+  in = &inputs[ninputs];
+  memset (in, 0, sizeof (struct bench_input));
+  in->data = XMALLOC (MTYPE_TMP, length);
+  memcpy (in->data, data, length);
+  in->length = length;
+
+  if (bench_input_find_aspath (in) < 0)
+    {
+      XFREE (MTYPE_TMP, in->data);
+      return;
+    }
+
+  in->p.family = AF_INET;
+  in->p.prefix = prefix;
+  in->p.prefixlen = prefixlen;
+  apply_mask_ipv4 (&in->p);
+
+  /* An address inside the prefix, for longest match lookups. */
+  in->host = in->p;
+  in->host.prefixlen = IPV4_MAX_BITLEN;
+  if (prefixlen < IPV4_MAX_BITLEN)
+    in->host.prefix.s_addr
+      |= htonl (bench_random () & (0xffffffff >> prefixlen));
+
+  ninputs++;
+}
+
+/* Attributes as a transit provider's full table might carry them: paths
+   of a few hops out of a limited set of ASes, so paths are shared, some
+   with a MED and some with communities. */
+static void
+bench_inputs_synthetic (void)
+{
+  u_char buf[256];
+
+  while (ninputs < maxinputs)
+    {
+      struct stream *s;
+      struct in_addr prefix;
+      int hops, ncomm, i;
+      size_t aspath_len;
+
+      s = stream_new (sizeof (buf));
+
+      stream_putc (s, BGP_ATTR_FLAG_TRANS);
+      stream_putc (s, BGP_ATTR_ORIGIN);
+      stream_putc (s, 1);
+      stream_putc (s, bench_random () % 3);
+
+      hops = 1 + bench_random () % 6;
+      aspath_len = 2 + hops * 4;
+      stream_putc (s, BGP_ATTR_FLAG_TRANS);
+      stream_putc (s, BGP_ATTR_AS_PATH);
+      stream_putc (s, aspath_len);
+      stream_putc (s, AS_SEQUENCE);
+      stream_putc (s, hops);
+      stream_putl (s, 65001);
+      for (i = 1; i < hops; i++)
+	stream_putl (s, 1 + bench_random () % 2000);
+
+      stream_putc (s, BGP_ATTR_FLAG_TRANS);
+      stream_putc (s, BGP_ATTR_NEXT_HOP);
+      stream_putc (s, 4);
+      stream_putl (s, 0xc0000201);		/* 192.0.2.1 */
+
+      if (bench_random () % 2)
+	{
+	  stream_putc (s, BGP_ATTR_FLAG_OPTIONAL);
+	  stream_putc (s, BGP_ATTR_MULTI_EXIT_DISC);
+	  stream_putc (s, 4);
+	  stream_putl (s, bench_random () % 100);
+	}
+
+      ncomm = bench_random () % 3 ? 0 : 1 + bench_random () % 4;
+      if (ncomm)
+	{
+	  stream_putc (s, BGP_ATTR_FLAG_OPTIONAL | BGP_ATTR_FLAG_TRANS);
+	  stream_putc (s, BGP_ATTR_COMMUNITIES);
+	  stream_putc (s, ncomm * 4);
+	  for (i = 0; i < ncomm; i++)
+	    stream_putl (s, (65001 << 16) | (bench_random () % 50));
+	}
+
+      /* Anywhere in 1.0.0.0 - 223.255.255.255 but 127/8. */
+      do
+	prefix.s_addr = htonl (bench_random ());
+      while ((ntohl (prefix.s_addr) >> 24) == 0
+	     || (ntohl (prefix.s_addr) >> 24) == 127
+	     || (ntohl (prefix.s_addr) >> 24) >= 224);
+
+      bench_input_add (STREAM_DATA (s), stream_get_endp (s),
+		       prefix, 16 + bench_random () % 9);
+      stream_free (s);
+    }
+}
+
+/* The IPv4 unicast RIB entries of an MRT TABLE_DUMP_V2 file. */
+static int
+bench_inputs_mrt (const char *file)
+{
+  FILE *fp;
+  u_char hdr[BGP_DUMP_HEADER_SIZE];
+  u_char *body = NULL;
+  size_t bodysize = 0;
+
+  if ((fp = fopen (file, "r")) == NULL)
+    {
+      fprintf (stderr, "%s: %s\n", file, safe_strerror (errno));
+      return -1;
+    }
+
+  while (ninputs < maxinputs
+	 && fread (hdr, sizeof (hdr), 1, fp) == 1)
+    {
+      u_int16_t type = (hdr[4] << 8) | hdr[5];
+      u_int16_t subtype = (hdr[6] << 8) | hdr[7];
+      u_int32_t len = (hdr[8] << 24) | (hdr[9] << 16) | (hdr[10] << 8)
+		      | hdr[11];
+      u_int32_t pos;
+      u_char plen;
+      struct in_addr prefix;
+      u_int16_t count;
+
+      if (len > bodysize)
+	{
+	  body = XREALLOC (MTYPE_TMP, body, len);
+	  bodysize = len;
+	}
+      if (len && fread (body, len, 1, fp) != 1)
+	break;
+
+      if (type != MSG_TABLE_DUMP_V2
+	  || subtype != TABLE_DUMP_V2_RIB_IPV4_UNICAST)
+	continue;
+
+      /* sequence number, prefix length, prefix, entry count */
+      if (len < 5)
+	continue;
+      plen = body[4];
+      pos = 5 + PSIZE (plen);
+      if (plen > IPV4_MAX_BITLEN || pos + 2 > len)
+	continue;
+      prefix.s_addr = 0;
+      memcpy (&prefix, body + 5, PSIZE (plen));
+      count = (body[pos] << 8) | body[pos + 1];
+      pos += 2;
+
+      /* peer index, originated time, attribute length, attributes */
+      while (count-- && pos + 8 <= len)
+	{
+	  bgp_size_t alen = (body[pos + 6] << 8) | body[pos + 7];
+
+	  pos += 8;
+	  if (pos + alen > len)
+	    break;
+	  bench_input_add (body + pos, alen, prefix, plen);
+	  pos += alen;
+	}
+    }
+
+  if (body)
+    XFREE (MTYPE_TMP, body);
+  fclose (fp);
+  return 0;
+}
+
+/* Load input i into the peer's input buffer, as bgp_read would. */
+static void
+bench_input_load (struct bench_input *in)
+{
+  stream_reset (peer->rbuf);
+  stream_write (peer->rbuf, in->data, in->length);
+  stream_clone_set (peer->ibuf, 0, stream_get_endp (peer->rbuf));
+}
+
+static int
+bench_attr_parse (struct bench_input *in, struct attr *attr,
+		  struct attr_extra *extra)
+{
+  struct bgp_nlri mp_update;
+  struct bgp_nlri mp_withdraw;
+
+  memset (attr, 0, sizeof (struct attr));
+  memset (extra, 0, sizeof (struct attr_extra));
+  memset (&mp_update, 0, sizeof (struct bgp_nlri));
+  memset (&mp_withdraw, 0, sizeof (struct bgp_nlri));
+  attr->extra = extra;
+
+  bench_input_load (in);
+  return bgp_attr_parse (peer, attr, in->length, &mp_update, &mp_withdraw);
+}
+
+/* Parse every input once, keeping what parses, with a reference to its
+   interned attributes and AS path so that the benchmarks find them in
+   the hashes as they would in a running bgpd. */
+static void
+bench_inputs_intern (void)
+{
+  unsigned int i, n = 0;
+
+  for (i = 0; i < ninputs; i++)
+    {
+      struct bench_input *in = &inputs[i];
+      struct attr attr;
+      struct attr_extra extra;
+
+      if (bench_attr_parse (in, &attr, &extra) != BGP_ATTR_PARSE_PROCEED
+	  || ! attr.aspath)
+	{
+	  bgp_attr_unintern_sub (&attr);
+	  XFREE (MTYPE_TMP, in->data);
+	  continue;
+	}
+      in->attr = bgp_attr_intern (&attr);
+      in->aspath = aspath_intern (aspath_dup (attr.aspath));
+      bgp_attr_unintern_sub (&attr);
+      inputs[n++] = *in;
+    }
+  ninputs = n;
+}
+
+static void
+bench_aspath_parse (unsigned long ops)
+{
+  unsigned long i;
+
+  for (i = 0; i < ops; i++)
+    {
+      struct bench_input *in = &inputs[i % ninputs];
+      struct aspath *as;
+
+      stream_reset (aspath_s);
+      stream_put (aspath_s, in->data + in->aspath_offset, in->aspath_length);
+      as = aspath_parse (aspath_s, in->aspath_length, 1);
+      aspath_unintern (&as);
+    }
+}
+
+/* As bgp_attr_aspath_check and the route-map set commands use it, on a
+   fresh copy which interning frees again when the path is known. */
+static void
+bench_aspath_intern (unsigned long ops)
+{
+  unsigned long i;
+
+  for (i = 0; i < ops; i++)
+    {
+      struct aspath *as = aspath_dup (inputs[i % ninputs].aspath);
+
+      as = aspath_intern (as);
+      aspath_unintern (&as);
+    }
+}
+
+static void
+bench_bgp_attr_parse (unsigned long ops)
+{
+  unsigned long i;
+
+  for (i = 0; i < ops; i++)
+    {
+      struct attr attr;
+      struct attr_extra extra;
+
+      bench_attr_parse (&inputs[i % ninputs], &attr, &extra);
+      bgp_attr_unintern_sub (&attr);
+    }
+}
+
+/* As bgp_update_main interns the copy of the parsed attributes. */
+static void
+bench_bgp_attr_intern (unsigned long ops)
+{
+  unsigned long i;
+
+  for (i = 0; i < ops; i++)
+    {
+      struct attr attr;
+      struct attr_extra extra;
+      struct attr *interned;
+
+      attr.extra = &extra;
+      bgp_attr_dup (&attr, inputs[i % ninputs].attr);
+      interned = bgp_attr_intern (&attr);
+      bgp_attr_unintern (&interned);
+    }
+}
+
+static void
+bench_infos_setup (void)
+{
+  unsigned int i;
+
+  infos = XCALLOC (MTYPE_TMP, ninputs * sizeof (struct bgp_info));
+  for (i = 0; i < ninputs; i++)
+    {
+      infos[i].type = ZEBRA_ROUTE_BGP;
+      infos[i].sub_type = BGP_ROUTE_NORMAL;
+      infos[i].peer = (i % 2) ? peer2 : peer;
+      infos[i].attr = inputs[i].attr;
+    }
+}
+
+static void
+bench_infos_teardown (void)
+{
+  XFREE (MTYPE_TMP, infos);
+}
+
+static void
+bench_bgp_info_cmp (unsigned long ops)
+{
+  unsigned long i;
+  int better = 0;
+
+  for (i = 0; i < ops; i++)
+    better += bgp_info_preferred (bgp, &infos[i % ninputs],
+				  &infos[(i + 1) % ninputs]);
+
+  /* keep the comparisons from being optimised away */
+  if (better < 0)
+    abort ();
+}
+
+static void
+bench_table_setup (void)
+{
+  unsigned int i;
+
+  table = route_table_init ();
+  for (i = 0; i < ninputs; i++)
+    route_node_get (table, (struct prefix *) &inputs[i].p);
+}
+
+static void
+bench_table_teardown (void)
+{
+  route_table_finish (table);
+}
+
+static void
+bench_route_node_get (unsigned long ops)
+{
+  unsigned long i;
+
+  for (i = 0; i < ops; i++)
+    {
+      struct route_node *rn;
+
+      rn = route_node_get (table, (struct prefix *) &inputs[i % ninputs].p);
+      route_unlock_node (rn);
+    }
+}
+
+static void
+bench_route_node_match (unsigned long ops)
+{
+  unsigned long i;
+
+  for (i = 0; i < ops; i++)
+    {
+      struct route_node *rn;
+
+      rn = route_node_match (table,
+			     (struct prefix *) &inputs[i % ninputs].host);
+      if (rn)
+	route_unlock_node (rn);
+    }
+}
+
+static void
+bench_prefix_list_apply (unsigned long ops)
+{
+  struct prefix_list *plist = prefix_list_lookup (AFI_IP, "BENCH");
+  unsigned long i;
+  int permit = 0;
+
+  for (i = 0; i < ops; i++)
+    permit += (prefix_list_apply (plist, &inputs[i % ninputs].p)
+	       == PREFIX_PERMIT);
+
+  if (permit < 0)
+    abort ();
+}
+
+/* As bgp_input_modifier applies a route-map to a copy of the
+   attributes. */
+static void
+bench_route_map_apply (unsigned long ops)
+{
+  struct route_map *map = route_map_lookup_by_name ("BENCH");
+  unsigned long i;
+
+  for (i = 0; i < ops; i++)
+    {
+      struct bench_input *in = &inputs[i % ninputs];
+      struct attr attr;
+      struct attr_extra extra;
+      struct bgp_info info;
+
+      attr.extra = &extra;
+      bgp_attr_dup (&attr, in->attr);
+      info.peer = peer;
+      info.attr = &attr;
+      route_map_apply (map, (struct prefix *) &in->p, RMAP_BGP, &info);
+      bgp_attr_flush (&attr);
+    }
+}
+
+static struct bench
+{
+  const char *name;
+  void (*setup) (void);
+  void (*run) (unsigned long ops);
+  void (*teardown) (void);
+} benches[] =
+{
+  { "aspath_parse", NULL, bench_aspath_parse, NULL },
+  { "aspath_intern", NULL, bench_aspath_intern, NULL },
+  { "bgp_attr_parse", NULL, bench_bgp_attr_parse, NULL },
+  { "bgp_attr_intern", NULL, bench_bgp_attr_intern, NULL },
+  { "bgp_info_cmp", bench_infos_setup, bench_bgp_info_cmp,
+    bench_infos_teardown },
+  { "route_node_get", bench_table_setup, bench_route_node_get,
+    bench_table_teardown },
+  { "route_node_match", bench_table_setup, bench_route_node_match,
+    bench_table_teardown },
+  { "prefix_list_apply", NULL, bench_prefix_list_apply, NULL },
+  { "route_map_apply", NULL, bench_route_map_apply, NULL },
+  { NULL, NULL, NULL, NULL },
+};
+
+static unsigned long
+bench_usecs (struct timeval *start)
+{
+  struct timeval now;
+
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &now);
+  return (now.tv_sec - start->tv_sec) * 1000000UL
+	 + now.tv_usec - start->tv_usec;
+}
+
+static void
+bench_run (struct bench *b)
+{
+  struct timeval start;
+  unsigned long ops = 64;
+  unsigned long usecs;
+  unsigned long allocs;
+
+  if (b->setup)
+    b->setup ();
+
+  for (;;)
+    {
+      allocs = mtype_stats_total ();
+      quagga_gettime (QUAGGA_CLK_MONOTONIC, &start);
+      b->run (ops);
+      usecs = bench_usecs (&start);
+      allocs = mtype_stats_total () - allocs;
+      if (usecs >= min_usecs)
+	break;
+      ops *= 2;
+    }
+
+  if (b->teardown)
+    b->teardown ();
+
+  printf ("%-20s %12lu ops %10.1f ns/op %8.2f allocs/op\n",
+	  b->name, ops, usecs * 1000.0 / ops, (double) allocs / ops);
+  fflush (stdout);
+}
+
+/* The filters of an IX route server: a prefix-list with an entry for
+   each /16 that some input falls in, and a route-map using it. */
+static void
+bench_config (void)
+{
+  static u_char seen[65536 / 8];
+  struct vty *vty;
+  FILE *fp;
+  unsigned int i, seq = 0;
+
+  if ((fp = tmpfile ()) == NULL)
+    {
+      perror ("tmpfile");
+      exit (1);
+    }
+
+  for (i = 0; i < ninputs && seq < 1000; i++)
+    {
+      u_int32_t net = ntohl (inputs[i].p.prefix.s_addr) >> 16;
+
+      if (inputs[i].p.prefixlen < 16 || (seen[net / 8] & (1 << (net % 8))))
+	continue;
+      seen[net / 8] |= 1 << (net % 8);
+      fprintf (fp, "ip prefix-list BENCH seq %u permit %u.%u.0.0/16 le 24\n",
+	       ++seq * 5, net >> 8, net & 0xff);
+    }
+  fprintf (fp, "route-map BENCH permit 10\n"
+	       " match ip address prefix-list BENCH\n"
+	       " set local-preference 200\n"
+	       " set community 65001:100 additive\n"
+	       "route-map BENCH permit 20\n");
+  rewind (fp);
+
+  vty = vty_new ();
+  vty->fd = 0;
+  vty->type = VTY_TERM;
+  vty->node = CONFIG_NODE;
+  if (config_from_file (vty, fp) != CMD_SUCCESS)
+    {
+      fprintf (stderr, "bad benchmark configuration: %s\n", vty->buf);
+      exit (1);
+    }
+  vty_close (vty);
+  fclose (fp);
+}
+
+static struct peer *
+bench_peer (const char *host, const char *addr, as_t as)
+{
+  struct peer *p;
+  afi_t afi;
+  safi_t safi;
+
+  p = peer_create_accept (bgp);
+  p->host = XSTRDUP (MTYPE_BGP_PEER_HOST, host);
+  p->as = as;
+  p->sort = BGP_PEER_EBGP;
+  p->su_remote = sockunion_str2su (addr);
+  inet_aton (addr, &p->remote_id);
+  SET_FLAG (p->cap, PEER_CAP_AS4_RCV | PEER_CAP_AS4_ADV);
+  for (afi = AFI_IP; afi < AFI_MAX; afi++)
+    for (safi = SAFI_UNICAST; safi < SAFI_MAX; safi++)
+      {
+	p->afc[afi][safi] = 1;
+	p->afc_adv[afi][safi] = 1;
+      }
+  return p;
+}
+
+static void
+usage (const char *progname)
+{
+  fprintf (stderr,
+	   "usage: %s [-f MRT-file] [-n inputs] [-s seed] [-t msecs] "
+	   "[benchmark...]\n", progname);
+  exit (1);
+}
+
+int
+main (int argc, char **argv)
+{
+  const char *mrt = NULL;
+  as_t asn = 65000;
+  struct bench *b;
+  int opt;
+
+  while ((opt = getopt (argc, argv, "f:n:s:t:")) != -1)
+    switch (opt)
+      {
+      case 'f':
+	mrt = optarg;
+	break;
+      case 'n':
+	maxinputs = strtoul (optarg, NULL, 10);
+	break;
+      case 's':
+	seed = strtoul (optarg, NULL, 10);
+	break;
+      case 't':
+	min_usecs = strtoul (optarg, NULL, 10) * 1000;
+	break;
+      default:
+	usage (argv[0]);
+      }
+  if (maxinputs == 0 || seed == 0)
+    usage (argv[0]);
+
+  /* No logging of what does not parse. */
+  zlog_default = openzlog ("bgpbench", ZLOG_BGP, LOG_NDELAY, LOG_DAEMON);
+  zlog_set_level (NULL, ZLOG_DEST_SYSLOG, ZLOG_DISABLED);
+
+  master = thread_master_create ();
+  bgp_master_init ();
+  bgp_option_set (BGP_OPT_NO_LISTEN);
+  cmd_init (1);
+  vty_init (master);
+  memory_init ();
+  bgp_init ();
+
+  if (bgp_get (&bgp, &asn, NULL))
+    return 1;
+  peer = bench_peer ("bench-a", "192.0.2.1", 65001);
+  peer2 = bench_peer ("bench-b", "192.0.2.2", 65002);
+
+  inputs = XCALLOC (MTYPE_TMP, maxinputs * sizeof (struct bench_input));
+  if (mrt)
+    {
+      if (bench_inputs_mrt (mrt) < 0)
+	return 1;
+    }
+  else
+    bench_inputs_synthetic ();
+  bench_inputs_intern ();
+  if (ninputs == 0)
+    {
+      fprintf (stderr, "no usable inputs\n");
+      return 1;
+    }
+  aspath_s = stream_new (BGP_MAX_PACKET_SIZE);
+  bench_config ();
+
+  printf ("%u %s inputs\n", ninputs, mrt ? mrt : "synthetic");
+  for (b = benches; b->name; b++)
+    {
+      int i;
+
+      if (optind < argc)
+	{
+	  for (i = optind; i < argc; i++)
+	    if (strcmp (argv[i], b->name) == 0)
+	      break;
+	  if (i == argc)
+	    continue;
+	}
+      bench_run (b);
+    }
+
+  /* Frees their host names too. */
+  peer_delete (peer);
+  peer_delete (peer2);
+
+  return 0;
+}
@@ -508,15 +508,14 @@ parse_test (struct peer *peer, struct test_segment *t, int type)
   int len = t->len;
 #define RANDOM_FUZZ 35
   
-  stream_reset (peer->ibuf);
-  stream_put (peer->ibuf, NULL, RANDOM_FUZZ);
-  stream_set_getp (peer->ibuf, RANDOM_FUZZ);
+  stream_reset (peer->rbuf);
+  stream_put (peer->rbuf, NULL, RANDOM_FUZZ);
   
   switch (type)
     {
       case CAPABILITY:
-        stream_putc (peer->ibuf, BGP_OPEN_OPT_CAP);
-        stream_putc (peer->ibuf, t->len);
+        stream_putc (peer->rbuf, BGP_OPEN_OPT_CAP);
+        stream_putc (peer->rbuf, t->len);
         break;
       case DYNCAP:
 /*        for (i = 0; i < BGP_MARKER_SIZE; i++)
@@ -525,7 +524,11 @@ parse_test (struct peer *peer, struct test_segment *t, int type)
         stream_putc (s, BGP_MSG_CAPABILITY);*/
         break;
     }
-  stream_write (peer->ibuf, t->data, t->len);
+  stream_write (peer->rbuf, t->data, t->len);
+  
+  /* parse it through ibuf, as bgp_read would */
+  stream_clone_set (peer->ibuf, 0, stream_get_endp (peer->rbuf));
+  stream_set_getp (peer->ibuf, RANDOM_FUZZ);
   
   printf ("%s: %s\n", t->name, t->desc);
 
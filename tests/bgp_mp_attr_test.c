@@ -449,11 +449,14 @@ parse_test (struct peer *peer, struct test_segment *t, int type)
   };
 #define RANDOM_FUZZ 35
   
-  stream_reset (peer->ibuf);
-  stream_put (peer->ibuf, NULL, RANDOM_FUZZ);
-  stream_set_getp (peer->ibuf, RANDOM_FUZZ);
+  stream_reset (peer->rbuf);
+  stream_put (peer->rbuf, NULL, RANDOM_FUZZ);
+  
+  stream_write (peer->rbuf, t->data, t->len);
   
-  stream_write (peer->ibuf, t->data, t->len);
+  /* parse it through ibuf, as bgp_read would */
+  stream_clone_set (peer->ibuf, 0, stream_get_endp (peer->rbuf));
+  stream_set_getp (peer->ibuf, RANDOM_FUZZ);
   
   printf ("%s: %s\n", t->name, t->desc);
   
@@ -27,6 +27,7 @@
 #include "stream.h"
 #include "privs.h"
 #include "linklist.h"
+#include "hash.h"
 #include "memory.h"
 #include "zclient.h"
 
@@ -82,6 +83,19 @@ struct zebra_privs_t bgpd_privs =
 
 static int tty = 0;
 
+/* The peer hashes stay empty, the keys do not matter. */
+static unsigned int
+fake_hash_key (void *arg)
+{
+  return 0;
+}
+
+static int
+fake_hash_cmp (const void *arg1, const void *arg2)
+{
+  return arg1 == arg2;
+}
+
 /* Create fake bgp instance */
 static struct bgp *
 bgp_create_fake (as_t *as, const char *name)
@@ -99,12 +113,15 @@ bgp_create_fake (as_t *as, const char *name)
 
   bgp->peer = list_new ();
   //bgp->peer->cmp = (int (*)(void *, void *)) peer_cmp;
+  bgp->peerhash = hash_create_open (0, fake_hash_key, fake_hash_cmp);
 
   bgp->group = list_new ();
   //bgp->group->cmp = (int (*)(void *, void *)) peer_group_cmp;
+  bgp->grouphash = hash_create_open (0, fake_hash_key, fake_hash_cmp);
 
   bgp->rsclient = list_new ();
   //bgp->rsclient->cmp = (int (*)(void*, void*)) peer_cmp;
+  bgp->rsclient_shared = list_new ();
 
   for (afi = AFI_IP; afi < AFI_MAX; afi++)
     for (safi = SAFI_UNICAST; safi < SAFI_MAX; safi++)
@@ -238,13 +255,12 @@ setup_bgp_mp_list (testcase_t *t)
 static int
 run_bgp_mp_list (testcase_t *t)
 {
-  struct list mp_list;
-  struct listnode *mp_node;
+  struct bgp_mp_list mp_list;
   struct bgp_info *info;
   int i;
   int test_result = TEST_PASSED;
   bgp_mp_list_init (&mp_list);
-  EXPECT_TRUE (listcount(&mp_list) == 0, test_result);
+  EXPECT_TRUE (mp_list.count == 0, test_result);
 
   bgp_mp_list_add (&mp_list, &test_mp_list_info[1]);
   bgp_mp_list_add (&mp_list, &test_mp_list_info[4]);
@@ -252,15 +268,16 @@ run_bgp_mp_list (testcase_t *t)
   bgp_mp_list_add (&mp_list, &test_mp_list_info[3]);
   bgp_mp_list_add (&mp_list, &test_mp_list_info[0]);
 
-  for (i = 0, mp_node = listhead(&mp_list); i < test_mp_list_info_count;
-       i++, mp_node = listnextnode(mp_node))
+  EXPECT_TRUE (mp_list.count == (unsigned int) test_mp_list_info_count,
+               test_result);
+  for (i = 0; i < test_mp_list_info_count; i++)
     {
-      info = listgetdata(mp_node);
+      info = mp_list.paths[i];
       EXPECT_TRUE (info == &test_mp_list_info[i], test_result);
     }
 
   bgp_mp_list_clear (&mp_list);
-  EXPECT_TRUE (listcount(&mp_list) == 0, test_result);
+  EXPECT_TRUE (mp_list.count == 0, test_result);
 
   return test_result;
 }
@@ -288,11 +305,15 @@ testcase_t test_bgp_mp_list = {
  */
 
 struct bgp_node test_rn;
+struct bgp_table *test_table;
 
 static int
 setup_bgp_info_mpath_update (testcase_t *t)
 {
   int i;
+  /* bgp_info_add () counts paths in the table of the node. */
+  test_table = bgp_table_init (AFI_IP, SAFI_UNICAST);
+  test_rn.table = test_table->route_table;
   str2prefix ("42.1.1.0/24", &test_rn.p);
   setup_bgp_mp_list (t);
   for (i = 0; i < test_mp_list_info_count; i++)
@@ -304,7 +325,7 @@ static int
 run_bgp_info_mpath_update (testcase_t *t)
 {
   struct bgp_info *new_best, *old_best, *mpath;
-  struct list mp_list;
+  struct bgp_mp_list mp_list;
   struct bgp_maxpaths_cfg mp_cfg = { 3, 3 };
   int test_result = TEST_PASSED;
   bgp_mp_list_init (&mp_list);
@@ -347,6 +368,7 @@ cleanup_bgp_info_mpath_update (testcase_t *t)
 
   for (i = 0; i < test_mp_list_peer_count; i++)
     sockunion_free (test_mp_list_peer[i].su_remote);
+  bgp_table_finish (&test_table);
 
   return 0;
 }
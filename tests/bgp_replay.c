@@ -0,0 +1,1246 @@
+/* MRT replay load generator for bgpd.
+   Copyright (C) 2026 The Quagga project
+
+This file is part of GNU Zebra.
+
+GNU Zebra is free software; you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation; either version 2, or (at your option) any
+later version.
+
+GNU Zebra is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with GNU Zebra; see the file COPYING.  If not, write to the Free
+Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+02111-1307, USA.  */
+
+/* bgpreplay opens a number of sender and receiver sessions to the bgpd
+ * under test, from consecutive source addresses and AS numbers.  Once
+ * all are established, the senders replay the IPv4 unicast routes of an
+ * MRT TABLE_DUMP_V2 RIB file, then send End-of-RIB, then replay the
+ * UPDATEs of any BGP4MP update files given, at the given rate of
+ * messages a second.  The routes of each MRT peer are sent by one
+ * sender, chosen round robin.  Next hops are set to the sender, and the
+ * sender's AS is prepended to the AS path, unless told not to.
+ *
+ * The receivers send no routes.  Every prefix they learn is matched to
+ * the time it was last sent, for the propagation latency.  Once all is
+ * sent, bgpreplay waits until the receivers have been quiet for a while
+ * and reports the send and receive rates, the time to convergence and
+ * the latency distribution.
+ *
+ * "bgpreplay -C" prints the neighbor configuration for bgpd which
+ * matches the other options, as route server clients.  It sets the
+ * advertisement interval to 0: with the default, receivers which come up
+ * before the replay starts hear nothing for up to 30 seconds, so the
+ * quiet time would have to be longer than that.
+ */
+
+#include <zebra.h>
+
+#include "vty.h"
+#include "thread.h"
+#include "stream.h"
+#include "buffer.h"
+#include "network.h"
+#include "sockunion.h"
+#include "prefix.h"
+#include "table.h"
+#include "memory.h"
+#include "log.h"
+
+#include "bgpd/bgpd.h"
+#include "bgpd/bgp_attr.h"
+#include "bgpd/bgp_aspath.h"
+#include "bgpd/bgp_open.h"
+#include "bgpd/bgp_dump.h"
+
+struct thread_master *master;
+
+#define REPLAY_HOLDTIME 90
+#define REPLAY_KEEPALIVE 30
+#define REPLAY_TICK_MSEC 10
+#define REPLAY_LATENCY_BUCKETS 24
+
+enum session_state
+{
+  REPLAY_OPENSENT,
+  REPLAY_OPENCONFIRM,
+  REPLAY_ESTABLISHED,
+};
+
+struct session
+{
+  int index;
+  int sender;
+  int fd;
+  enum session_state state;
+  as_t as;
+  struct in_addr addr;
+
+  struct buffer *wb;
+  int blocked;
+  struct thread *t_read;
+  struct thread *t_write;
+  struct thread *t_keepalive;
+
+  u_char rbuf[BGP_MAX_PACKET_SIZE * 2];
+  size_t rlen;
+
+  /* The UPDATE being filled with prefixes of the same attributes. */
+  struct stream *pending;
+  size_t pending_attrlen;
+
+  unsigned long updates;
+  unsigned long prefixes;
+  unsigned long withdrawals;
+};
+
+/* An MRT peer, and the sender whose routes it becomes. */
+struct mrt_peer
+{
+  as_t as;
+  struct in_addr addr;
+  int sender;
+};
+
+/* Options. */
+static union sockunion target;
+static struct in_addr source;
+static as_t base_as = 64512;
+static int nsenders = 1;
+static int nreceivers = 1;
+static unsigned long rate;
+static int quiet_secs = 5;
+static int rewrite_nexthop = 1;
+static int prepend_as = 1;
+static const char *rib_file;
+static char **update_files;
+static int nupdate_files;
+
+static struct session *sessions;
+static int nsessions;
+static int established;
+
+static struct mrt_peer *mrt_peers;
+static unsigned int nmrt_peers;
+static int next_sender;
+
+/* The replay cursor. */
+static FILE *replay_fp;
+static int replay_file = -1;
+static int replay_phase_rib;
+static int replay_done;
+static u_char *mrt_body;
+static size_t mrt_bodysize;
+static double tokens;
+static struct stream *scratch;
+
+/* Results. */
+static unsigned long long start_usec;
+static unsigned long long sent_usec;
+static unsigned long long last_recv_usec;
+static unsigned long sent_updates, sent_prefixes, sent_withdrawals;
+static unsigned long recv_updates, recv_prefixes, recv_withdrawals;
+static unsigned long last_sent_prefixes, last_recv_prefixes;
+static struct route_table *sent_times;
+static unsigned long latency[REPLAY_LATENCY_BUCKETS];
+static unsigned long latency_count;
+static unsigned long long latency_sum, latency_max;
+
+static void replay_generate (void);
+static int session_write (struct thread *);
+static void session_retry (struct session *);
+
+static unsigned long long
+now_usec (void)
+{
+  struct timeval tv;
+
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &tv);
+  return tv.tv_sec * 1000000ULL + tv.tv_usec;
+}
+
+static void
+session_send (struct session *sn, struct stream *s)
+{
+  buffer_put (sn->wb, STREAM_DATA (s), stream_get_endp (s));
+  if (! sn->blocked)
+    switch (buffer_flush_available (sn->wb, sn->fd))
+      {
+      case BUFFER_ERROR:
+	fprintf (stderr, "%s: write: %s\n", inet_ntoa (sn->addr),
+		 safe_strerror (errno));
+	exit (1);
+      case BUFFER_PENDING:
+	sn->blocked = 1;
+	sn->t_write = thread_add_write (master, session_write, sn, sn->fd);
+	break;
+      case BUFFER_EMPTY:
+	break;
+      }
+}
+
+static struct stream *
+message_new (u_char type)
+{
+  struct stream *s = stream_new (BGP_MAX_PACKET_SIZE);
+  int i;
+
+  for (i = 0; i < BGP_MARKER_SIZE; i++)
+    stream_putc (s, 0xff);
+  stream_putw (s, 0);
+  stream_putc (s, type);
+  return s;
+}
+
+static void
+message_send (struct session *sn, struct stream *s)
+{
+  stream_putw_at (s, BGP_MARKER_SIZE, stream_get_endp (s));
+  session_send (sn, s);
+  stream_free (s);
+}
+
+static void
+session_send_open (struct session *sn)
+{
+  struct stream *s = message_new (BGP_MSG_OPEN);
+  size_t optlen;
+
+  stream_putc (s, BGP_VERSION_4);
+  stream_putw (s, sn->as > BGP_AS_MAX ? BGP_AS_TRANS : sn->as);
+  stream_putw (s, REPLAY_HOLDTIME);
+  stream_put_in_addr (s, &sn->addr);
+  optlen = stream_get_endp (s);
+  stream_putc (s, 0);
+
+  stream_putc (s, BGP_OPEN_OPT_CAP);
+  stream_putc (s, 6);
+  stream_putc (s, CAPABILITY_CODE_MP);
+  stream_putc (s, 4);
+  stream_putw (s, AFI_IP);
+  stream_putc (s, 0);
+  stream_putc (s, SAFI_UNICAST);
+
+  stream_putc (s, BGP_OPEN_OPT_CAP);
+  stream_putc (s, 6);
+  stream_putc (s, CAPABILITY_CODE_AS4);
+  stream_putc (s, 4);
+  stream_putl (s, sn->as);
+
+  stream_putc_at (s, optlen, stream_get_endp (s) - optlen - 1);
+  message_send (sn, s);
+}
+
+static int
+session_keepalive (struct thread *t)
+{
+  struct session *sn = THREAD_ARG (t);
+
+  sn->t_keepalive = thread_add_timer (master, session_keepalive, sn,
+				      REPLAY_KEEPALIVE);
+  message_send (sn, message_new (BGP_MSG_KEEPALIVE));
+  return 0;
+}
+
+static int
+session_write (struct thread *t)
+{
+  struct session *sn = THREAD_ARG (t);
+
+  sn->t_write = NULL;
+  switch (buffer_flush_available (sn->wb, sn->fd))
+    {
+    case BUFFER_ERROR:
+      fprintf (stderr, "%s: write: %s\n", inet_ntoa (sn->addr),
+	       safe_strerror (errno));
+      exit (1);
+    case BUFFER_PENDING:
+      sn->t_write = thread_add_write (master, session_write, sn, sn->fd);
+      break;
+    case BUFFER_EMPTY:
+      sn->blocked = 0;
+      replay_generate ();
+      break;
+    }
+  return 0;
+}
+
+static void
+latency_add (unsigned long long usec)
+{
+  unsigned long msec = usec / 1000;
+  int b = 0;
+
+  while (msec && b < REPLAY_LATENCY_BUCKETS - 1)
+    {
+      msec >>= 1;
+      b++;
+    }
+  latency[b]++;
+  latency_count++;
+  latency_sum += usec;
+  if (usec > latency_max)
+    latency_max = usec;
+}
+
+/* Walk the prefixes of an NLRI field, counting them and, for announced
+   prefixes, recording or matching their send times. */
+static int
+nlri_walk (const u_char *pnt, size_t len, int announce, int sending,
+	   unsigned long long now)
+{
+  const u_char *end = pnt + len;
+  int count = 0;
+
+  while (pnt < end)
+    {
+      struct prefix_ipv4 p;
+      int psize;
+
+      memset (&p, 0, sizeof (p));
+      p.family = AF_INET;
+      p.prefixlen = *pnt++;
+      psize = PSIZE (p.prefixlen);
+      if (p.prefixlen > IPV4_MAX_BITLEN || pnt + psize > end)
+	return -1;
+      memcpy (&p.prefix, pnt, psize);
+      pnt += psize;
+      count++;
+
+      if (announce)
+	{
+	  struct route_node *rn;
+
+	  if (sending)
+	    {
+	      rn = route_node_get (sent_times, (struct prefix *) &p);
+	      if (! rn->info)
+		rn->info = XCALLOC (MTYPE_TMP, sizeof (unsigned long long));
+	      else
+		route_unlock_node (rn);
+	      *(unsigned long long *) rn->info = now;
+	    }
+	  else if ((rn = route_node_lookup (sent_times, (struct prefix *) &p)))
+	    {
+	      latency_add (now - *(unsigned long long *) rn->info);
+	      route_unlock_node (rn);
+	    }
+	}
+    }
+  return count;
+}
+
+static void
+session_update_receive (struct session *sn, const u_char *pnt, size_t len)
+{
+  unsigned long long now = now_usec ();
+  size_t wlen, alen;
+  int n;
+
+  if (len < 4)
+    goto bad;
+  wlen = (pnt[0] << 8) | pnt[1];
+  if (2 + wlen + 2 > len)
+    goto bad;
+  alen = (pnt[2 + wlen] << 8) | pnt[3 + wlen];
+  if (4 + wlen + alen > len)
+    goto bad;
+
+  if ((n = nlri_walk (pnt + 2, wlen, 0, 0, now)) < 0)
+    goto bad;
+  sn->withdrawals += n;
+  recv_withdrawals += n;
+  if ((n = nlri_walk (pnt + 4 + wlen + alen, len - 4 - wlen - alen,
+		      ! sn->sender, 0, now)) < 0)
+    goto bad;
+  sn->prefixes += n;
+  recv_prefixes += n;
+  sn->updates++;
+  recv_updates++;
+  last_recv_usec = now;
+  return;
+
+ bad:
+  fprintf (stderr, "%s: malformed UPDATE received\n", inet_ntoa (sn->addr));
+  exit (1);
+}
+
+static void
+session_message (struct session *sn, u_char type, const u_char *pnt,
+		 size_t len)
+{
+  switch (type)
+    {
+    case BGP_MSG_OPEN:
+      message_send (sn, message_new (BGP_MSG_KEEPALIVE));
+      sn->t_keepalive = thread_add_timer (master, session_keepalive, sn,
+					  REPLAY_KEEPALIVE);
+      sn->state = REPLAY_OPENCONFIRM;
+      break;
+    case BGP_MSG_KEEPALIVE:
+      if (sn->state == REPLAY_OPENCONFIRM)
+	{
+	  sn->state = REPLAY_ESTABLISHED;
+	  if (++established == nsessions)
+	    {
+	      printf ("%d sessions established\n", nsessions);
+	      fflush (stdout);
+	      start_usec = now_usec ();
+	      replay_generate ();
+	    }
+	}
+      break;
+    case BGP_MSG_UPDATE:
+      if (! sn->sender)
+	session_update_receive (sn, pnt, len);
+      break;
+    case BGP_MSG_NOTIFY:
+      fprintf (stderr, "%s: NOTIFICATION %d/%d received\n",
+	       inet_ntoa (sn->addr), len > 0 ? pnt[0] : 0,
+	       len > 1 ? pnt[1] : 0);
+      exit (1);
+    default:
+      break;
+    }
+}
+
+static int
+session_read (struct thread *t)
+{
+  struct session *sn = THREAD_ARG (t);
+  ssize_t nbytes;
+  size_t pos = 0;
+
+  sn->t_read = thread_add_read (master, session_read, sn, sn->fd);
+
+  nbytes = read (sn->fd, sn->rbuf + sn->rlen, sizeof (sn->rbuf) - sn->rlen);
+  if (nbytes < 0 && ERRNO_IO_RETRY (errno))
+    return 0;
+  if (nbytes <= 0)
+    {
+      if (sn->state != REPLAY_ESTABLISHED)
+	{
+	  session_retry (sn);
+	  return 0;
+	}
+      fprintf (stderr, "%s: connection closed\n", inet_ntoa (sn->addr));
+      exit (1);
+    }
+  sn->rlen += nbytes;
+
+  while (sn->rlen - pos >= BGP_HEADER_SIZE)
+    {
+      u_char *hdr = sn->rbuf + pos;
+      size_t len = (hdr[BGP_MARKER_SIZE] << 8) | hdr[BGP_MARKER_SIZE + 1];
+
+      if (len < BGP_HEADER_SIZE || len > BGP_MAX_PACKET_SIZE)
+	{
+	  fprintf (stderr, "%s: bad message length %lu\n",
+		   inet_ntoa (sn->addr), (unsigned long) len);
+	  exit (1);
+	}
+      if (sn->rlen - pos < len)
+	break;
+      session_message (sn, hdr[BGP_MARKER_SIZE + 2], hdr + BGP_HEADER_SIZE,
+		       len - BGP_HEADER_SIZE);
+      pos += len;
+    }
+  memmove (sn->rbuf, sn->rbuf + pos, sn->rlen - pos);
+  sn->rlen -= pos;
+  return 0;
+}
+
+static int
+session_start (struct thread *t)
+{
+  struct session *sn = THREAD_ARG (t);
+  union sockunion su;
+
+  memset (&su, 0, sizeof (su));
+  su.sin.sin_family = AF_INET;
+  su.sin.sin_addr = sn->addr;
+
+  sn->fd = sockunion_socket (&su);
+  if (sn->fd < 0 || sockunion_bind (sn->fd, &su, 0, &su) < 0)
+    {
+      fprintf (stderr, "%s: cannot bind\n", inet_ntoa (sn->addr));
+      exit (1);
+    }
+  if (connect (sn->fd, &target.sa, sizeof (struct sockaddr_in)) < 0)
+    {
+      session_retry (sn);
+      return 0;
+    }
+  set_nonblocking (sn->fd);
+
+  sn->state = REPLAY_OPENSENT;
+  session_send_open (sn);
+  sn->t_read = thread_add_read (master, session_read, sn, sn->fd);
+  return 0;
+}
+
+/* Try again in a while, as bgpd refuses sessions for a few seconds
+   after it starts and after a session goes down. */
+static void
+session_retry (struct session *sn)
+{
+  if (sn->t_read)
+    thread_cancel (sn->t_read);
+  if (sn->t_write)
+    thread_cancel (sn->t_write);
+  if (sn->t_keepalive)
+    thread_cancel (sn->t_keepalive);
+  sn->t_read = sn->t_write = sn->t_keepalive = NULL;
+  close (sn->fd);
+  sn->fd = -1;
+  sn->blocked = 0;
+  sn->rlen = 0;
+  buffer_reset (sn->wb);
+  thread_add_timer (master, session_start, sn, 1);
+}
+
+static int
+mrt_peer_add (as_t as, struct in_addr addr)
+{
+  mrt_peers = XREALLOC (MTYPE_TMP, mrt_peers,
+			(nmrt_peers + 1) * sizeof (struct mrt_peer));
+  mrt_peers[nmrt_peers].as = as;
+  mrt_peers[nmrt_peers].addr = addr;
+  mrt_peers[nmrt_peers].sender = next_sender;
+  next_sender = (next_sender + 1) % nsenders;
+  return mrt_peers[nmrt_peers++].sender;
+}
+
+static int
+mrt_peer_sender (as_t as, struct in_addr addr)
+{
+  unsigned int i;
+
+  for (i = 0; i < nmrt_peers; i++)
+    if (mrt_peers[i].as == as && mrt_peers[i].addr.s_addr == addr.s_addr)
+      return mrt_peers[i].sender;
+  return mrt_peer_add (as, addr);
+}
+
+static void
+attr_put_header (struct stream *s, u_char flag, u_char type, size_t len)
+{
+  if (len > 255)
+    {
+      stream_putc (s, flag | BGP_ATTR_FLAG_EXTLEN);
+      stream_putc (s, type);
+      stream_putw (s, len);
+    }
+  else
+    {
+      stream_putc (s, flag & ~BGP_ATTR_FLAG_EXTLEN);
+      stream_putc (s, type);
+      stream_putc (s, len);
+    }
+}
+
+/* Copy the AS_PATH to s in 4 octet form, with the sender's AS in
+   front if asked. */
+static int
+attr_put_aspath (struct stream *s, u_char flag, const u_char *pnt,
+		 size_t len, int as4, as_t as)
+{
+  const u_char *end = pnt + len;
+  int width = as4 ? 4 : 2;
+  size_t hdr = stream_get_endp (s);
+  size_t nlen = 0;
+  int first = 1;
+
+  /* extended length, as the length is only known at the end */
+  stream_putc (s, flag | BGP_ATTR_FLAG_EXTLEN);
+  stream_putc (s, BGP_ATTR_AS_PATH);
+  stream_putw (s, 0);
+  if (prepend_as && (len < 2 || pnt[0] != AS_SEQUENCE || pnt[1] == 255))
+    {
+      stream_putc (s, AS_SEQUENCE);
+      stream_putc (s, 1);
+      stream_putl (s, as);
+      nlen += 6;
+      first = 0;
+    }
+  while (pnt + 2 <= end)
+    {
+      u_char type = pnt[0];
+      u_char count = pnt[1];
+      int i;
+
+      pnt += 2;
+      if (pnt + count * width > end)
+	return -1;
+      stream_putc (s, type);
+      if (prepend_as && first)
+	{
+	  stream_putc (s, count + 1);
+	  stream_putl (s, as);
+	  nlen += 4;
+	}
+      else
+	stream_putc (s, count);
+      first = 0;
+      for (i = 0; i < count; i++, pnt += width)
+	stream_putl (s, as4 ? (pnt[0] << 24) | (pnt[1] << 16) | (pnt[2] << 8)
+			      | pnt[3]
+			    : (pnt[0] << 8) | pnt[1]);
+      nlen += 2 + count * 4;
+    }
+  stream_putw_at (s, hdr + 2, nlen);
+  return 0;
+}
+
+/* Rewrite path attributes for sending by a sender: in 4 octet AS form,
+   without the AS4 ones, IPv4 unicast only, with the sender's next hop
+   and AS as configured. */
+static int
+attr_rewrite (struct stream *s, const u_char *pnt, size_t len, int as4,
+	      struct session *sn)
+{
+  const u_char *end = pnt + len;
+
+  while (pnt < end)
+    {
+      u_char flag, type;
+      size_t alen;
+
+      if (pnt + 3 > end)
+	return -1;
+      flag = pnt[0];
+      type = pnt[1];
+      if (CHECK_FLAG (flag, BGP_ATTR_FLAG_EXTLEN))
+	{
+	  if (pnt + 4 > end)
+	    return -1;
+	  alen = (pnt[2] << 8) | pnt[3];
+	  pnt += 4;
+	}
+      else
+	{
+	  alen = pnt[2];
+	  pnt += 3;
+	}
+      if (pnt + alen > end)
+	return -1;
+
+      switch (type)
+	{
+	case BGP_ATTR_AS_PATH:
+	  if (attr_put_aspath (s, flag, pnt, alen, as4, sn->as) < 0)
+	    return -1;
+	  break;
+	case BGP_ATTR_NEXT_HOP:
+	  if (alen != 4)
+	    return -1;
+	  attr_put_header (s, flag, type, 4);
+	  if (rewrite_nexthop)
+	    stream_put_in_addr (s, &sn->addr);
+	  else
+	    stream_put (s, pnt, 4);
+	  break;
+	case BGP_ATTR_AGGREGATOR:
+	  if (alen != (as4 ? 8 : 6))
+	    return -1;
+	  attr_put_header (s, flag, type, 8);
+	  if (as4)
+	    stream_put (s, pnt, alen);
+	  else
+	    {
+	      stream_putl (s, (pnt[0] << 8) | pnt[1]);
+	      stream_put (s, pnt + 2, 4);
+	    }
+	  break;
+	case BGP_ATTR_AS4_PATH:
+	case BGP_ATTR_AS4_AGGREGATOR:
+	case BGP_ATTR_MP_REACH_NLRI:
+	case BGP_ATTR_MP_UNREACH_NLRI:
+	  break;
+	default:
+	  attr_put_header (s, flag, type, alen);
+	  stream_put (s, pnt, alen);
+	  break;
+	}
+      pnt += alen;
+    }
+  return 0;
+}
+
+static void
+pending_flush (struct session *sn)
+{
+  struct stream *s = sn->pending;
+  size_t nlri;
+
+  if (stream_get_endp (s) == 0)
+    return;
+
+  nlri = stream_get_endp (s) - BGP_HEADER_SIZE - 4 - sn->pending_attrlen;
+  nlri_walk (STREAM_DATA (s) + BGP_HEADER_SIZE + 4 + sn->pending_attrlen,
+	     nlri, 1, 1, now_usec ());
+  stream_putw_at (s, BGP_MARKER_SIZE, stream_get_endp (s));
+  session_send (sn, s);
+  stream_reset (s);
+  sent_updates++;
+  sn->updates++;
+}
+
+/* Add a RIB entry to the pending UPDATE of its sender, starting a new one
+   if the attributes differ or there is no room. */
+static int
+replay_rib_entry (struct session *sn, const u_char *attr, size_t alen,
+		  u_char plen, const u_char *prefix)
+{
+  struct stream *s = sn->pending;
+  size_t rlen;
+  int sent = 0;
+
+  stream_reset (scratch);
+  if (attr_rewrite (scratch, attr, alen, 1, sn) < 0)
+    return 0;
+  rlen = stream_get_endp (scratch);
+
+  if (stream_get_endp (s)
+      && (sn->pending_attrlen != rlen
+	  || memcmp (STREAM_DATA (s) + BGP_HEADER_SIZE + 4,
+		     STREAM_DATA (scratch), rlen)
+	  || STREAM_WRITEABLE (s) < 1 + (size_t) PSIZE (plen)))
+    {
+      pending_flush (sn);
+      sent = 1;
+    }
+
+  if (stream_get_endp (s) == 0)
+    {
+      int i;
+
+      if (BGP_HEADER_SIZE + 4 + rlen + 5 > STREAM_SIZE (s))
+	return sent;
+      for (i = 0; i < BGP_MARKER_SIZE; i++)
+	stream_putc (s, 0xff);
+      stream_putw (s, 0);
+      stream_putc (s, BGP_MSG_UPDATE);
+      stream_putw (s, 0);
+      stream_putw (s, rlen);
+      stream_put (s, STREAM_DATA (scratch), rlen);
+      sn->pending_attrlen = rlen;
+    }
+  stream_putc (s, plen);
+  stream_put (s, prefix, PSIZE (plen));
+  sent_prefixes++;
+  sn->prefixes++;
+  return sent;
+}
+
+/* Replay one UPDATE from a BGP4MP record. */
+static int
+replay_update (struct session *sn, const u_char *msg, size_t len, int as4)
+{
+  struct stream *s;
+  size_t wlen, alen, nlri, rlen = 0;
+  int n;
+
+  if (len < BGP_HEADER_SIZE + 4 || msg[BGP_MARKER_SIZE + 2] != BGP_MSG_UPDATE)
+    return 0;
+  msg += BGP_HEADER_SIZE;
+  len -= BGP_HEADER_SIZE;
+  wlen = (msg[0] << 8) | msg[1];
+  if (2 + wlen + 2 > len)
+    return 0;
+  alen = (msg[2 + wlen] << 8) | msg[3 + wlen];
+  if (4 + wlen + alen > len)
+    return 0;
+  nlri = len - 4 - wlen - alen;
+  if (wlen == 0 && nlri == 0)
+    return 0;
+
+  stream_reset (scratch);
+  if (nlri)
+    {
+      if (attr_rewrite (scratch, msg + 4 + wlen, alen, as4, sn) < 0)
+	return 0;
+      rlen = stream_get_endp (scratch);
+    }
+  if (BGP_HEADER_SIZE + 4 + wlen + rlen + nlri > BGP_MAX_PACKET_SIZE)
+    return 0;
+
+  s = message_new (BGP_MSG_UPDATE);
+  stream_putw (s, wlen);
+  stream_put (s, msg + 2, wlen);
+  stream_putw (s, rlen);
+  stream_put (s, STREAM_DATA (scratch), rlen);
+  stream_put (s, msg + 4 + wlen + alen, nlri);
+
+  if ((n = nlri_walk (msg + 2, wlen, 0, 1, 0)) > 0)
+    {
+      sent_withdrawals += n;
+      sn->withdrawals += n;
+    }
+  if ((n = nlri_walk (msg + 4 + wlen + alen, nlri, 1, 1, now_usec ())) > 0)
+    {
+      sent_prefixes += n;
+      sn->prefixes += n;
+    }
+  sent_updates++;
+  sn->updates++;
+  message_send (sn, s);
+  return 1;
+}
+
+/* Replay the next MRT record, returning how many messages were sent, or
+   -1 at the end of the files. */
+static int
+replay_record (void)
+{
+  u_char hdr[BGP_DUMP_HEADER_SIZE];
+  u_int16_t type, subtype;
+  u_int32_t len;
+  const u_char *b;
+
+  while (! replay_fp || fread (hdr, sizeof (hdr), 1, replay_fp) != 1)
+    {
+      const char *file;
+
+      if (replay_fp)
+	fclose (replay_fp);
+      replay_fp = NULL;
+
+      /* End-of-RIB, once the RIB is sent, before any updates. */
+      if (replay_phase_rib)
+	{
+	  int i;
+
+	  for (i = 0; i < nsenders; i++)
+	    {
+	      struct stream *s;
+
+	      pending_flush (&sessions[i]);
+	      s = message_new (BGP_MSG_UPDATE);
+	      stream_putw (s, 0);
+	      stream_putw (s, 0);
+	      message_send (&sessions[i], s);
+	    }
+	  replay_phase_rib = 0;
+	  printf ("RIB sent after %.3fs\n",
+		  (now_usec () - start_usec) / 1000000.0);
+	  fflush (stdout);
+	}
+
+      if (++replay_file > nupdate_files)
+	return -1;
+      file = replay_file == 0 ? rib_file : update_files[replay_file - 1];
+      if (! file)
+	continue;
+      if ((replay_fp = fopen (file, "r")) == NULL)
+	{
+	  fprintf (stderr, "%s: %s\n", file, safe_strerror (errno));
+	  exit (1);
+	}
+      replay_phase_rib = (replay_file == 0);
+    }
+
+  type = (hdr[4] << 8) | hdr[5];
+  subtype = (hdr[6] << 8) | hdr[7];
+  len = (hdr[8] << 24) | (hdr[9] << 16) | (hdr[10] << 8) | hdr[11];
+  if (len > mrt_bodysize)
+    {
+      mrt_body = XREALLOC (MTYPE_TMP, mrt_body, len);
+      mrt_bodysize = len;
+    }
+  if (len && fread (mrt_body, len, 1, replay_fp) != 1)
+    {
+      fclose (replay_fp);
+      replay_fp = NULL;
+      return 0;
+    }
+  b = mrt_body;
+
+  if (type == MSG_TABLE_DUMP_V2 && subtype == TABLE_DUMP_V2_PEER_INDEX_TABLE)
+    {
+      u_int32_t pos;
+      u_int16_t count, i;
+
+      /* collector id, view name, peer count, peers */
+      if (len < 6)
+	return 0;
+      pos = 4 + 2 + ((b[4] << 8) | b[5]);
+      if (pos + 2 > len)
+	return 0;
+      count = (b[pos] << 8) | b[pos + 1];
+      pos += 2;
+
+      if (mrt_peers)
+	XFREE (MTYPE_TMP, mrt_peers);
+      nmrt_peers = 0;
+      for (i = 0; i < count; i++)
+	{
+	  u_char ptype;
+	  struct in_addr addr = { 0 };
+	  as_t as;
+	  size_t alen;
+
+	  if (pos + 1 > len)
+	    return 0;
+	  ptype = b[pos];
+	  alen = CHECK_FLAG (ptype, TABLE_DUMP_V2_PEER_INDEX_TABLE_IP6)
+		 ? 16 : 4;
+	  pos += 1 + 4;
+	  if (pos + alen > len)
+	    return 0;
+	  if (alen == 4)
+	    memcpy (&addr, b + pos, 4);
+	  else
+	    memcpy (&addr, b + pos + 12, 4);
+	  pos += alen;
+	  if (CHECK_FLAG (ptype, TABLE_DUMP_V2_PEER_INDEX_TABLE_AS4))
+	    {
+	      if (pos + 4 > len)
+		return 0;
+	      as = (b[pos] << 24) | (b[pos + 1] << 16) | (b[pos + 2] << 8)
+		   | b[pos + 3];
+	      pos += 4;
+	    }
+	  else
+	    {
+	      if (pos + 2 > len)
+		return 0;
+	      as = (b[pos] << 8) | b[pos + 1];
+	      pos += 2;
+	    }
+	  /* by index, as the RIB entries refer to them */
+	  mrt_peer_add (as, addr);
+	}
+      return 0;
+    }
+
+  if (type == MSG_TABLE_DUMP_V2 && subtype == TABLE_DUMP_V2_RIB_IPV4_UNICAST)
+    {
+      u_int32_t pos;
+      u_char plen;
+      u_int16_t count;
+      const u_char *prefix;
+      int sent = 0;
+
+      if (len < 5)
+	return 0;
+      plen = b[4];
+      prefix = b + 5;
+      pos = 5 + PSIZE (plen);
+      if (plen > IPV4_MAX_BITLEN || pos + 2 > len)
+	return 0;
+      count = (b[pos] << 8) | b[pos + 1];
+      pos += 2;
+
+      while (count-- && pos + 8 <= len)
+	{
+	  u_int16_t idx = (b[pos] << 8) | b[pos + 1];
+	  size_t alen = (b[pos + 6] << 8) | b[pos + 7];
+	  int sender = idx < nmrt_peers ? mrt_peers[idx].sender
+					: idx % nsenders;
+
+	  pos += 8;
+	  if (pos + alen > len)
+	    break;
+	  sent += replay_rib_entry (&sessions[sender], b + pos, alen,
+				    plen, prefix);
+	  pos += alen;
+	}
+      return sent;
+    }
+
+  if ((type == MSG_PROTOCOL_BGP4MP || type == MSG_PROTOCOL_BGP4MP + 1)
+      && (subtype == BGP4MP_MESSAGE || subtype == BGP4MP_MESSAGE_AS4))
+    {
+      int as4 = (subtype == BGP4MP_MESSAGE_AS4);
+      size_t aswidth = as4 ? 4 : 2;
+      u_int32_t pos = 0;
+      as_t as;
+      u_int16_t afi;
+      struct in_addr addr = { 0 };
+      size_t alen;
+
+      /* the extended timestamp variant has microseconds first */
+      if (type == MSG_PROTOCOL_BGP4MP + 1)
+	pos += 4;
+      if (pos + 2 * aswidth + 4 > len)
+	return 0;
+      as = as4 ? (b[pos] << 24) | (b[pos + 1] << 16) | (b[pos + 2] << 8)
+		 | b[pos + 3]
+	       : (b[pos] << 8) | b[pos + 1];
+      pos += 2 * aswidth + 2;
+      afi = (b[pos] << 8) | b[pos + 1];
+      pos += 2;
+      alen = (afi == AFI_IP6) ? 16 : 4;
+      if (pos + 2 * alen > len)
+	return 0;
+      memcpy (&addr, b + pos + alen - 4, 4);
+      pos += 2 * alen;
+
+      return replay_update (&sessions[mrt_peer_sender (as, addr)],
+			    b + pos, len - pos, as4);
+    }
+
+  return 0;
+}
+
+/* Send what the rate allows, for as long as no sender is blocked. */
+static void
+replay_generate (void)
+{
+  int i;
+
+  if (replay_done || established < nsessions)
+    return;
+
+  for (;;)
+    {
+      int n;
+
+      for (i = 0; i < nsenders; i++)
+	if (sessions[i].blocked)
+	  return;
+      if (rate && tokens < 1)
+	return;
+
+      n = replay_record ();
+      if (n < 0)
+	break;
+      if (rate)
+	tokens -= n;
+    }
+
+  replay_done = 1;
+  sent_usec = now_usec ();
+  printf ("all sent after %.3fs\n", (sent_usec - start_usec) / 1000000.0);
+  fflush (stdout);
+}
+
+static void
+replay_report (void)
+{
+  double sent_secs = (sent_usec - start_usec) / 1000000.0;
+  double conv_secs = 0;
+  unsigned long seen = 0;
+  int b;
+
+  if (last_recv_usec > start_usec)
+    conv_secs = (last_recv_usec - start_usec) / 1000000.0;
+  if (sent_secs <= 0)
+    sent_secs = 0.000001;
+
+  printf ("sent: %lu updates, %lu prefixes, %lu withdrawals in %.3fs,"
+	  " %.0f prefixes/s\n",
+	  sent_updates, sent_prefixes, sent_withdrawals, sent_secs,
+	  (sent_prefixes + sent_withdrawals) / sent_secs);
+  printf ("received: %lu updates, %lu prefixes, %lu withdrawals,"
+	  " %.0f prefixes/s\n",
+	  recv_updates, recv_prefixes, recv_withdrawals,
+	  conv_secs > 0 ? (recv_prefixes + recv_withdrawals) / conv_secs : 0);
+  printf ("converged after %.3fs\n", conv_secs);
+
+  if (latency_count)
+    {
+      printf ("latency: %lu samples, mean %.1fms, max %.1fms\n",
+	      latency_count, latency_sum / 1000.0 / latency_count,
+	      latency_max / 1000.0);
+      for (b = 0; b < REPLAY_LATENCY_BUCKETS; b++)
+	if (latency[b])
+	  {
+	    seen += latency[b];
+	    printf ("  < %8lums %10lu %6.2f%%\n", 1UL << b, latency[b],
+		    100.0 * seen / latency_count);
+	  }
+    }
+}
+
+static int
+replay_tick (struct thread *t)
+{
+  static unsigned long long last_progress;
+  unsigned long long now = now_usec ();
+
+  thread_add_timer_msec (master, replay_tick, NULL, REPLAY_TICK_MSEC);
+
+  if (rate && start_usec)
+    {
+      tokens += rate * REPLAY_TICK_MSEC / 1000.0;
+      if (tokens > rate)
+	tokens = rate;
+      replay_generate ();
+    }
+
+  if (! start_usec)
+    return 0;
+
+  if (now - last_progress >= 1000000)
+    {
+      printf ("%6.1fs sent %lu prefixes (%lu/s), received %lu (%lu/s)\n",
+	      (now - start_usec) / 1000000.0, sent_prefixes,
+	      sent_prefixes - last_sent_prefixes, recv_prefixes,
+	      recv_prefixes - last_recv_prefixes);
+      fflush (stdout);
+      last_sent_prefixes = sent_prefixes;
+      last_recv_prefixes = recv_prefixes;
+      last_progress = now;
+    }
+
+  if (replay_done)
+    {
+      int i;
+
+      for (i = 0; i < nsenders; i++)
+	if (sessions[i].blocked)
+	  return 0;
+      if (now - (last_recv_usec > sent_usec ? last_recv_usec : sent_usec)
+	  >= quiet_secs * 1000000ULL)
+	{
+	  replay_report ();
+	  exit (0);
+	}
+    }
+  return 0;
+}
+
+static void
+config_print (void)
+{
+  int i;
+
+  for (i = 0; i < nsessions; i++)
+    {
+      printf (" neighbor %s remote-as %u\n", inet_ntoa (sessions[i].addr),
+	      sessions[i].as);
+      printf (" neighbor %s route-server-client\n",
+	      inet_ntoa (sessions[i].addr));
+      printf (" neighbor %s passive\n", inet_ntoa (sessions[i].addr));
+      printf (" neighbor %s advertisement-interval 0\n",
+	      inet_ntoa (sessions[i].addr));
+    }
+}
+
+static void
+usage (const char *progname)
+{
+  fprintf (stderr,
+	   "usage: %s -t target -s source [-p port] [-a AS] [-n senders]\n"
+	   "       [-m receivers] [-r msgs/s] [-q quiet-secs] [-N] [-P] [-C]\n"
+	   "       [-f RIB-file] [update-file...]\n\n"
+	   "  -t  address of the bgpd under test\n"
+	   "  -s  address of the first session; later ones count up\n"
+	   "  -a  AS of the first session; later ones count up\n"
+	   "  -n  number of sending sessions\n"
+	   "  -m  number of receiving sessions\n"
+	   "  -r  messages a second to send, 0 for as fast as possible\n"
+	   "  -q  seconds without UPDATEs after which all is converged\n"
+	   "  -N  keep the next hops of the MRT routes\n"
+	   "  -P  do not prepend the sender's AS\n"
+	   "  -C  print the neighbor configuration for bgpd and exit\n",
+	   progname);
+  exit (1);
+}
+
+int
+main (int argc, char **argv)
+{
+  int port = BGP_PORT_DEFAULT;
+  int print_config = 0;
+  int opt, i;
+
+  memset (&target, 0, sizeof (target));
+  while ((opt = getopt (argc, argv, "t:s:p:a:n:m:r:q:f:NPC")) != -1)
+    switch (opt)
+      {
+      case 't':
+	if (str2sockunion (optarg, &target) < 0
+	    || target.sa.sa_family != AF_INET)
+	  usage (argv[0]);
+	break;
+      case 's':
+	if (! inet_aton (optarg, &source))
+	  usage (argv[0]);
+	break;
+      case 'p':
+	port = atoi (optarg);
+	break;
+      case 'a':
+	base_as = strtoul (optarg, NULL, 10);
+	break;
+      case 'n':
+	nsenders = atoi (optarg);
+	break;
+      case 'm':
+	nreceivers = atoi (optarg);
+	break;
+      case 'r':
+	rate = strtoul (optarg, NULL, 10);
+	break;
+      case 'q':
+	quiet_secs = atoi (optarg);
+	break;
+      case 'f':
+	rib_file = optarg;
+	break;
+      case 'N':
+	rewrite_nexthop = 0;
+	break;
+      case 'P':
+	prepend_as = 0;
+	break;
+      case 'C':
+	print_config = 1;
+	break;
+      default:
+	usage (argv[0]);
+      }
+  update_files = argv + optind;
+  nupdate_files = argc - optind;
+
+  if (! source.s_addr || nsenders < 1 || nreceivers < 0
+      || (! print_config && ! target.sa.sa_family)
+      || (! print_config && ! rib_file && ! nupdate_files))
+    usage (argv[0]);
+  target.sin.sin_port = htons (port);
+
+  nsessions = nsenders + nreceivers;
+  sessions = XCALLOC (MTYPE_TMP, nsessions * sizeof (struct session));
+  for (i = 0; i < nsessions; i++)
+    {
+      sessions[i].index = i;
+      sessions[i].sender = (i < nsenders);
+      sessions[i].as = base_as + i;
+      sessions[i].addr.s_addr = htonl (ntohl (source.s_addr) + i);
+      sessions[i].wb = buffer_new (0);
+      sessions[i].pending = stream_new (BGP_MAX_PACKET_SIZE);
+    }
+
+  if (print_config)
+    {
+      config_print ();
+      return 0;
+    }
+
+  signal (SIGPIPE, SIG_IGN);
+  master = thread_master_create ();
+  sent_times = route_table_init ();
+  /* room for attributes which grow with 4 octet ASes */
+  scratch = stream_new (BGP_MAX_PACKET_SIZE * 2);
+
+  for (i = 0; i < nsessions; i++)
+    thread_add_event (master, session_start, &sessions[i], 0);
+  thread_add_timer_msec (master, replay_tick, NULL, REPLAY_TICK_MSEC);
+
+  {
+    struct thread thread;
+
+    while (thread_fetch (master, &thread))
+      thread_call (&thread);
+  }
+  return 0;
+}
@@ -0,0 +1,311 @@
+/* Dump the bgpd statistics segment for a metrics exporter.
+   Copyright (C) 2026 The Quagga project
+
+This file is part of GNU Zebra.
+
+GNU Zebra is free software; you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation; either version 2, or (at your option) any
+later version.
+
+GNU Zebra is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with GNU Zebra; see the file COPYING.  If not, write to the Free
+Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+02111-1307, USA.  */
+
+/* bgpstats reads the segment bgpd writes when "bgp stats-segment" is
+ * configured, and prints it in the Prometheus text format.  It is both
+ * a way to look at the segment and an example of how to read it
+ * consistently while bgpd rewrites it: see bgpd/bgp_statseg.h.
+ */
+
+#include <zebra.h>
+#include <sys/mman.h>
+
+#include "vty.h"
+
+#include "bgpd/bgpd.h"
+#include "bgpd/bgp_statseg.h"
+
+#define STATSEG_RETRIES 100
+
+static const char *peer_status_str[BGP_STATUS_MAX] =
+{
+  "", "Idle", "Connect", "Active", "OpenSent", "OpenConfirm",
+  "Established", "Clearing", "Deleted",
+};
+
+/* Copy the segment at base, of mapped bytes, once it is not being
+   rewritten.  Returns the copy, or NULL if it has to be mapped again
+   or no consistent copy could be had. */
+static u_char *
+statseg_copy (const u_char *base, size_t mapped, size_t *size)
+{
+  const struct bgp_statseg_header *h = (const void *) base;
+  u_int32_t seq;
+  u_char *copy = NULL;
+  int i;
+
+  for (i = 0; i < STATSEG_RETRIES; i++)
+    {
+      seq = h->seq;
+      __sync_synchronize ();
+      if (seq & 1)
+        {
+          usleep (1000);
+          continue;
+        }
+
+      *size = h->size;
+      if (*size < sizeof (*h) || *size > mapped)
+        break;
+      copy = realloc (copy, *size);
+      memcpy (copy, base, *size);
+
+      __sync_synchronize ();
+      if (h->seq == seq)
+        return copy;
+    }
+
+  free (copy);
+  return NULL;
+}
+
+static void
+put_label (const char *name, const char *value)
+{
+  printf ("%s=\"", name);
+  for (; *value; value++)
+    {
+      if (*value == '"' || *value == '\\')
+        putchar ('\\');
+      putchar (*value);
+    }
+  putchar ('"');
+}
+
+static const void *
+record (const u_char *seg, const struct bgp_statseg_header *h,
+        enum bgp_statseg_type type, unsigned int i)
+{
+  return seg + h->section[type].offset
+         + (size_t) i * h->section[type].record_size;
+}
+
+#define PEER_COUNTER(F) \
+  { #F, offsetof (struct bgp_statseg_peer, F) }
+
+static const struct
+{
+  const char *name;
+  size_t offset;
+} peer_counters[] =
+{
+  PEER_COUNTER (open_in),
+  PEER_COUNTER (open_out),
+  PEER_COUNTER (update_in),
+  PEER_COUNTER (update_out),
+  PEER_COUNTER (keepalive_in),
+  PEER_COUNTER (keepalive_out),
+  PEER_COUNTER (notify_in),
+  PEER_COUNTER (notify_out),
+  PEER_COUNTER (refresh_in),
+  PEER_COUNTER (refresh_out),
+  PEER_COUNTER (dynamic_cap_in),
+  PEER_COUNTER (dynamic_cap_out),
+  PEER_COUNTER (write_calls),
+  PEER_COUNTER (update_prefix_out),
+  PEER_COUNTER (adv_replaced),
+  PEER_COUNTER (adv_cancelled),
+  PEER_COUNTER (policy_rejected),
+};
+
+static void
+put_peers (const u_char *seg, const struct bgp_statseg_header *h)
+{
+  const struct bgp_statseg_peer *p;
+  unsigned int i, c;
+
+#define PEER_METRIC(NAME, VALUE) \
+  do { \
+    printf ("bgp_peer_%s{", NAME); \
+    put_label ("peer", p->host); \
+    if (p->view[0]) \
+      { \
+        putchar (','); \
+        put_label ("view", p->view); \
+      } \
+    printf ("} %llu\n", (unsigned long long) (VALUE)); \
+  } while (0)
+
+  for (i = 0; i < h->section[BGP_STATSEG_PEER].count; i++)
+    {
+      p = record (seg, h, BGP_STATSEG_PEER, i);
+
+      printf ("bgp_peer_info{");
+      put_label ("peer", p->host);
+      printf (",remote_as=\"%u\",local_as=\"%u\",", p->remote_as,
+              p->local_as);
+      put_label ("state", p->status < BGP_STATUS_MAX
+                          ? peer_status_str[p->status] : "");
+      printf ("} 1\n");
+
+      PEER_METRIC ("established", p->status == Established);
+      PEER_METRIC ("established_total", p->established);
+      PEER_METRIC ("dropped_total", p->dropped);
+      PEER_METRIC ("uptime_seconds", p->uptime);
+      PEER_METRIC ("outq", p->outq);
+      PEER_METRIC ("prefix_accepted", p->prefix_accepted);
+      PEER_METRIC ("prefix_sent", p->prefix_sent);
+      for (c = 0; c < sizeof (peer_counters) / sizeof (peer_counters[0]);
+           c++)
+        {
+          char name[64];
+
+          snprintf (name, sizeof (name), "%s_total", peer_counters[c].name);
+          PEER_METRIC (name, *(const u_int64_t *)
+                             ((const u_char *) p + peer_counters[c].offset));
+        }
+    }
+#undef PEER_METRIC
+}
+
+static void
+put_work_queues (const u_char *seg, const struct bgp_statseg_header *h)
+{
+  const struct bgp_statseg_work_queue *w;
+  unsigned int i;
+
+  for (i = 0; i < h->section[BGP_STATSEG_WORK_QUEUE].count; i++)
+    {
+      w = record (seg, h, BGP_STATSEG_WORK_QUEUE, i);
+      printf ("bgp_work_queue_items{");
+      put_label ("queue", w->name);
+      printf ("} %llu\n", (unsigned long long) w->items);
+      printf ("bgp_work_queue_runs_total{");
+      put_label ("queue", w->name);
+      printf ("} %llu\n", (unsigned long long) w->runs);
+      printf ("bgp_work_queue_cycles_total{");
+      put_label ("queue", w->name);
+      printf ("} %llu\n", (unsigned long long) w->cycles_total);
+    }
+}
+
+static void
+put_threads (const u_char *seg, const struct bgp_statseg_header *h)
+{
+  const struct bgp_statseg_thread *t;
+  unsigned int i;
+
+  for (i = 0; i < h->section[BGP_STATSEG_THREAD].count; i++)
+    {
+      t = record (seg, h, BGP_STATSEG_THREAD, i);
+      if (! t->calls)
+        continue;
+      printf ("bgp_thread_calls_total{");
+      put_label ("func", t->funcname);
+      printf ("} %llu\n", (unsigned long long) t->calls);
+      printf ("bgp_thread_real_seconds_total{");
+      put_label ("func", t->funcname);
+      printf ("} %.6f\n", t->real_total / 1e6);
+      printf ("bgp_thread_cpu_seconds_total{");
+      put_label ("func", t->funcname);
+      printf ("} %.6f\n", t->cpu_total / 1e6);
+    }
+}
+
+static void
+put_memtypes (const u_char *seg, const struct bgp_statseg_header *h)
+{
+  const struct bgp_statseg_memtype *m;
+  unsigned int i;
+
+  for (i = 0; i < h->section[BGP_STATSEG_MEMTYPE].count; i++)
+    {
+      m = record (seg, h, BGP_STATSEG_MEMTYPE, i);
+      if (! m->alloc)
+        continue;
+      printf ("bgp_memory_allocations{");
+      put_label ("type", m->name);
+      printf ("} %llu\n", (unsigned long long) m->alloc);
+    }
+}
+
+int
+main (int argc, char **argv)
+{
+  const struct bgp_statseg_header *h;
+  struct stat st;
+  u_char *base, *seg = NULL;
+  size_t size;
+  int fd, i;
+
+  if (argc != 2)
+    {
+      fprintf (stderr, "usage: %s SEGMENT\n", argv[0]);
+      return 2;
+    }
+
+  /* Map again whenever the segment has grown past the mapping. */
+  for (i = 0; i < STATSEG_RETRIES && ! seg; i++)
+    {
+      fd = open (argv[1], O_RDONLY);
+      if (fd < 0 || fstat (fd, &st) < 0)
+        {
+          fprintf (stderr, "%s: %s\n", argv[1], strerror (errno));
+          return 1;
+        }
+      if ((size_t) st.st_size < sizeof (*h))
+        {
+          close (fd);
+          usleep (1000);
+          continue;
+        }
+      base = mmap (NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+      close (fd);
+      if (base == MAP_FAILED)
+        {
+          fprintf (stderr, "%s: %s\n", argv[1], strerror (errno));
+          return 1;
+        }
+      seg = statseg_copy (base, st.st_size, &size);
+      munmap (base, st.st_size);
+    }
+  if (! seg)
+    {
+      fprintf (stderr, "%s: no consistent copy\n", argv[1]);
+      return 1;
+    }
+
+  h = (const void *) seg;
+  if (h->magic != BGP_STATSEG_MAGIC || h->version != BGP_STATSEG_VERSION
+      || h->section_count < BGP_STATSEG_MAX)
+    {
+      fprintf (stderr, "%s: not a statistics segment this knows\n",
+               argv[1]);
+      return 1;
+    }
+  for (i = 0; i < BGP_STATSEG_MAX; i++)
+    if (h->section[i].offset
+        + (u_int64_t) h->section[i].count * h->section[i].record_size > size)
+      {
+        fprintf (stderr, "%s: damaged\n", argv[1]);
+        return 1;
+      }
+
+  printf ("bgpd_up %d\n", h->pid != 0);
+  printf ("bgpd_stats_updated_seconds %llu\n",
+          (unsigned long long) h->updated);
+  put_peers (seg, h);
+  put_work_queues (seg, h);
+  put_threads (seg, h);
+  put_memtypes (seg, h);
+
+  free (seg);
+  return 0;
+}
@@ -0,0 +1,377 @@
+/* IS-IS SPF benchmark.
+   Copyright (C) 2026 The Quagga project
+
+This file is part of GNU Zebra.
+
+GNU Zebra is free software; you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation; either version 2, or (at your option) any
+later version.
+
+GNU Zebra is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with GNU Zebra; see the file COPYING.  If not, write to the Free
+Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+02111-1307, USA.  */
+
+/* The level-1 LSDB of a generated topology is built from LSP PDUs, as
+ * they would be received, router 1's own included, and the routes of
+ * router 1 are calculated from it and sent to zebra.  Router 1 has a
+ * point-to-point circuit with an adjacency up to each of its neighbours,
+ * there is no socket under them.
+ */
+
+#include <zebra.h>
+
+#include "thread.h"
+#include "command.h"
+#include "memory.h"
+#include "linklist.h"
+#include "prefix.h"
+#include "stream.h"
+#include "checksum.h"
+#include "if.h"
+#include "log.h"
+#include "zclient.h"
+
+#include "isisd/dict.h"
+#include "isisd/isis_constants.h"
+#include "isisd/isis_common.h"
+#include "isisd/isis_flags.h"
+#include "isisd/isis_circuit.h"
+#include "isisd/isis_csm.h"
+#include "isisd/isisd.h"
+#include "isisd/isis_tlv.h"
+#include "isisd/isis_lsp.h"
+#include "isisd/isis_pdu.h"
+#include "isisd/isis_adjacency.h"
+#include "isisd/isis_network.h"
+#include "isisd/isis_spf.h"
+
+#include "spf_bench.h"
+
+struct thread_master *master;
+extern struct zclient *zclient;
+
+/* What is left of an LSP of the maximum size for the TLVs, once the
+   protocols supported are in. */
+#define ISIS_BENCH_LSP_SIZE 1492
+#define ISIS_BENCH_TLV_ROOM \
+  (ISIS_BENCH_LSP_SIZE - ISIS_FIXED_HDR_LEN - ISIS_LSP_HDR_LEN - 3)
+
+/* Entries of the longest kind, a /31 or a /32, that fill a TLV. */
+#define ISIS_BENCH_NEIGHS_PER_TLV (255 / IS_NEIGHBOURS_LEN)
+#define ISIS_BENCH_REACHS_PER_TLV (255 / 9)
+
+/* No circuit of the benchmark has a socket. */
+int
+isis_sock_init (struct isis_circuit *circuit)
+{
+  return ISIS_OK;
+}
+
+void
+isis_sock_close (struct isis_circuit *circuit)
+{
+}
+
+#ifdef GNU_LINUX
+int
+isis_recv_pending (struct isis_circuit *circuit)
+{
+  return 0;
+}
+#endif
+
+static void
+isis_bench_sysid (u_int32_t r, u_char *sysid)
+{
+  memset (sysid, 0, ISIS_SYS_ID_LEN);
+  sysid[2] = r >> 24;
+  sysid[3] = r >> 16;
+  sysid[4] = r >> 8;
+  sysid[5] = r;
+}
+
+/* Bytes the entries take in their TLVs. */
+static size_t
+isis_bench_tlv_bytes (unsigned int neighs, unsigned int reachs)
+{
+  return neighs * IS_NEIGHBOURS_LEN
+	 + 2 * ((neighs + ISIS_BENCH_NEIGHS_PER_TLV - 1)
+		/ ISIS_BENCH_NEIGHS_PER_TLV)
+	 + reachs * 9
+	 + 2 * ((reachs + ISIS_BENCH_REACHS_PER_TLV - 1)
+		/ ISIS_BENCH_REACHS_PER_TLV);
+}
+
+/* The LSP of a router as it is filled, a fragment at a time. */
+struct isis_bench_lsp
+{
+  struct isis_area *area;
+  u_int32_t r;
+  int frag;
+  struct list *neighs;
+  struct list *reachs;
+  struct isis_lsp *lsp0;
+};
+
+static void
+isis_bench_tlv_free (void *data)
+{
+  XFREE (MTYPE_ISIS_TLV, data);
+}
+
+/* The fragment filled so far, into the LSDB. */
+static void
+isis_bench_lsp_insert (struct isis_bench_lsp *b)
+{
+  struct isis_link_state_hdr *hdr;
+  struct isis_lsp *lsp;
+  struct stream *s;
+  struct nlpids nlpids;
+
+  s = stream_new (ISIS_BENCH_LSP_SIZE);
+  fill_fixed_hdr ((struct isis_fixed_hdr *) STREAM_DATA (s), L1_LINK_STATE);
+  hdr = (struct isis_link_state_hdr *) (STREAM_DATA (s) + ISIS_FIXED_HDR_LEN);
+  hdr->rem_lifetime = htons (MAX_AGE);
+  isis_bench_sysid (b->r, hdr->lsp_id);
+  LSP_PSEUDO_ID (hdr->lsp_id) = 0;
+  LSP_FRAGMENT (hdr->lsp_id) = b->frag;
+  hdr->seq_num = htonl (1);
+  hdr->lsp_bits = IS_LEVEL_1;
+  stream_forward_endp (s, ISIS_FIXED_HDR_LEN + ISIS_LSP_HDR_LEN);
+
+  if (b->frag == 0)
+    {
+      nlpids.count = 1;
+      nlpids.nlpids[0] = NLPID_IP;
+      tlv_add_nlpid (&nlpids, s);
+    }
+  if (listcount (b->neighs))
+    tlv_add_te_is_neighs (b->neighs, s);
+  if (listcount (b->reachs))
+    tlv_add_te_ipv4_reachs (b->reachs, s);
+
+  hdr->pdu_len = htons (stream_get_endp (s));
+  fletcher_checksum (STREAM_DATA (s) + 12, stream_get_endp (s) - 12, 12);
+
+  lsp = lsp_new_from_stream_ptr (s, stream_get_endp (s), b->lsp0, b->area,
+				 IS_LEVEL_1);
+  lsp_insert (lsp, b->area->lspdb[0]);
+  stream_free (s);
+
+  if (b->frag == 0)
+    b->lsp0 = lsp;
+  b->frag++;
+  list_delete_all_node (b->neighs);
+  list_delete_all_node (b->reachs);
+}
+
+/* Whether there is room for one more entry, in a fragment of its own if
+   need be. */
+static int
+isis_bench_lsp_room (struct isis_bench_lsp *b, int neigh, int reach)
+{
+  if (b->frag > 255)
+    return 0;
+  if (isis_bench_tlv_bytes (listcount (b->neighs) + neigh,
+			    listcount (b->reachs) + reach)
+      <= ISIS_BENCH_TLV_ROOM)
+    return 1;
+  isis_bench_lsp_insert (b);
+  return b->frag <= 255;
+}
+
+static void
+isis_bench_reach_add (struct isis_bench_lsp *b, struct prefix_ipv4 *p,
+		      u_int32_t metric)
+{
+  struct te_ipv4_reachability *te_ipreach;
+
+  if (!isis_bench_lsp_room (b, 0, 1))
+    return;
+  te_ipreach = XCALLOC (MTYPE_ISIS_TLV, sizeof (struct te_ipv4_reachability)
+			+ ((p->prefixlen + 7) / 8) - 1);
+  te_ipreach->te_metric = htonl (metric);
+  te_ipreach->control = (p->prefixlen & 0x3F);
+  memcpy (&te_ipreach->prefix_start, &p->prefix.s_addr,
+	  (p->prefixlen + 7) / 8);
+  listnode_add (b->reachs, te_ipreach);
+}
+
+/* Router r's LSP: its neighbours, its address, its links and its stubs,
+   in as many fragments as they take.  Returns the number of fragments. */
+static int
+isis_bench_lsp (struct isis_area *area, struct spf_bench_topology *t,
+		u_int32_t r)
+{
+  struct isis_bench_lsp b;
+  struct spf_bench_nbr *n;
+  struct te_is_neigh *te_is_neigh;
+  struct prefix_ipv4 p;
+  u_int32_t i;
+
+  memset (&b, 0, sizeof (b));
+  b.area = area;
+  b.r = r;
+  b.neighs = list_new ();
+  b.neighs->del = isis_bench_tlv_free;
+  b.reachs = list_new ();
+  b.reachs->del = isis_bench_tlv_free;
+
+  for (SPF_BENCH_NBRS (t, r, n))
+    {
+      if (!isis_bench_lsp_room (&b, 1, 0))
+	break;
+      te_is_neigh = XCALLOC (MTYPE_ISIS_TLV, sizeof (struct te_is_neigh));
+      isis_bench_sysid (n->router, te_is_neigh->neigh_id);
+      SET_TE_METRIC (te_is_neigh, n->metric);
+      listnode_add (b.neighs, te_is_neigh);
+    }
+
+  p.family = AF_INET;
+  p.prefixlen = IPV4_MAX_BITLEN;
+  p.prefix = spf_bench_router_id (r);
+  isis_bench_reach_add (&b, &p, 0);
+  for (SPF_BENCH_NBRS (t, r, n))
+    {
+      spf_bench_link_addr (n->link, r > n->router, &p);
+      apply_mask_ipv4 (&p);
+      isis_bench_reach_add (&b, &p, n->metric);
+    }
+  for (i = 0; i < t->prefixes; i++)
+    {
+      spf_bench_stub (r, i, &p);
+      isis_bench_reach_add (&b, &p, 1);
+    }
+
+  if (b.frag <= 255)
+    isis_bench_lsp_insert (&b);
+  else
+    zlog_warn ("router %u does not fit in its LSP", r);
+
+  list_delete (b.neighs);
+  list_delete (b.reachs);
+  return b.frag;
+}
+
+/* A point-to-point circuit of router 1 to each of its neighbours, with
+   the adjacency up. */
+static unsigned int
+isis_bench_circuits (struct isis_area *area, struct spf_bench_topology *t)
+{
+  struct spf_bench_nbr *n;
+  struct interface *ifp;
+  struct isis_circuit *circuit;
+  struct isis_adjacency *adj;
+  struct prefix_ipv4 *addr, p;
+  struct in_addr *nexthop;
+  u_char sysid[ISIS_SYS_ID_LEN];
+  char name[INTERFACE_NAMSIZ];
+
+  for (SPF_BENCH_NBRS (t, SPF_BENCH_ROOT, n))
+    {
+      snprintf (name, sizeof (name), "bench%u", n->link);
+      ifp = if_get_by_name (name);
+      if_set_index (ifp, n->link + 1);
+
+      circuit = isis_circuit_new ();
+      isis_circuit_if_bind (circuit, ifp);
+      circuit->circ_type = CIRCUIT_T_P2P;
+      circuit->state = C_STATE_UP;
+      circuit->is_type = IS_LEVEL_1;
+      circuit->ip_router = 1;
+      circuit->te_metric[0] = n->metric;
+      circuit->ip_addrs = list_new ();
+      addr = prefix_ipv4_new ();
+      spf_bench_link_addr (n->link, 0, addr);
+      listnode_add (circuit->ip_addrs, addr);
+      isis_circuit_configure (circuit, area);
+      area->ip_circuits++;
+
+      isis_bench_sysid (n->router, sysid);
+      adj = isis_new_adj (sysid, NULL, IS_LEVEL_1, circuit);
+      adj->adj_state = ISIS_ADJ_UP;
+      adj->sys_type = ISIS_SYSTYPE_L1_IS;
+      adj->nlpids.count = 1;
+      adj->nlpids.nlpids[0] = NLPID_IP;
+      adj->ipv4_addrs = list_new ();
+      spf_bench_link_addr (n->link, 1, &p);
+      nexthop = XMALLOC (MTYPE_ISIS_TMP, sizeof (struct in_addr));
+      *nexthop = p.prefix;
+      listnode_add (adj->ipv4_addrs, nexthop);
+      circuit->u.p2p.neighbor = adj;
+      circuit->upadjcount[0] = 1;
+    }
+
+  return area->ip_circuits;
+}
+
+int
+main (int argc, char **argv)
+{
+  struct spf_bench_topology *t;
+  struct spf_bench_phase phase;
+  struct isis_area *area;
+  struct isis_spftree *spftree;
+  unsigned int circuits, lsps = 0, i;
+  u_int32_t r;
+
+  /* No logging of what the topology lacks. */
+  zlog_default = openzlog ("isisbench", ZLOG_ISIS, LOG_NDELAY, LOG_DAEMON);
+  zlog_set_level (NULL, ZLOG_DEST_SYSLOG, ZLOG_DISABLED);
+
+  master = thread_master_create ();
+  cmd_init (1);
+  memory_init ();
+  isis_circuit_init ();
+  isis_new (0);
+
+  t = spf_bench_init ("isisbench", argc, argv);
+
+  isis_bench_sysid (SPF_BENCH_ROOT, isis->sysid);
+  isis->sysid_set = 1;
+  area = isis_area_create ("bench");
+  THREAD_TIMER_OFF (area->t_tick);
+  area->min_spf_interval[0] = 0;
+  zclient = spf_bench_zclient (ZEBRA_ROUTE_ISIS);
+
+  /* no SPF while the LSPs go in, nor ever for IPv6 */
+  spftree = area->spftree[0];
+  spftree->pending = 1;
+#ifdef HAVE_IPV6
+  area->spftree6[0]->pending = 1;
+#endif /* HAVE_IPV6 */
+
+  spf_bench_phase_begin (&phase);
+  circuits = isis_bench_circuits (area, t);
+  for (r = 1; r <= t->routers; r++)
+    lsps += isis_bench_lsp (area, t, r);
+  spf_bench_phase_end (&phase, "lsdb", 1, "%u LSPs, %u circuits", lsps,
+		       circuits);
+
+  spftree->pending = 0;
+  spf_bench_phase_begin (&phase);
+  isis_spf_schedule (area, IS_LEVEL_1, NULL, 1);
+  spf_bench_phase_end (&phase, "spf", 1, "%u vertices, %u routes changed",
+		       spftree->paths.count, spftree->changed);
+
+  spf_bench_phase_begin (&phase);
+  spf_bench_zebra_flush (zclient);
+  spf_bench_phase_end (&phase, "zebra", 1, "%lu bytes",
+		       spf_bench_zebra_bytes ());
+
+  spf_bench_phase_begin (&phase);
+  for (i = 0; i < spf_bench_runs (); i++)
+    isis_spf_schedule (area, IS_LEVEL_1, NULL, 1);
+  spf_bench_phase_end (&phase, "respf", spf_bench_runs (),
+		       "%u runs, %u routes changed", spf_bench_runs (),
+		       spftree->changed);
+
+  exit (0);
+}
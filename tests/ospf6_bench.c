@@ -0,0 +1,410 @@
+/* OSPFv3 SPF benchmark.
+   Copyright (C) 2026 The Quagga project
+
+This file is part of GNU Zebra.
+
+GNU Zebra is free software; you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation; either version 2, or (at your option) any
+later version.
+
+GNU Zebra is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with GNU Zebra; see the file COPYING.  If not, write to the Free
+Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+02111-1307, USA.  */
+
+/* The backbone LSDB of a generated topology is built from router-LSAs
+ * and intra-area-prefix-LSAs installed as they would be on receipt,
+ * router 1's router-LSA included, and the routes of router 1 are
+ * calculated from it and sent to zebra.  Router 1 is configured with an
+ * interface to each of its neighbours, put in the point-to-point state
+ * at once, and the link-LSA of the neighbour on it gives the nexthop;
+ * no neighbour is needed for the calculation.  ospf6_init opens the
+ * OSPFv3 socket, nothing is sent or read on it.
+ */
+
+#include <zebra.h>
+
+#include "thread.h"
+#include "prefix.h"
+#include "linklist.h"
+#include "if.h"
+#include "command.h"
+#include "vty.h"
+#include "stream.h"
+#include "log.h"
+#include "memory.h"
+#include "privs.h"
+#include "zclient.h"
+
+#include "ospf6d/ospf6_proto.h"
+#include "ospf6d/ospf6_lsa.h"
+#include "ospf6d/ospf6_lsdb.h"
+#include "ospf6d/ospf6_route.h"
+#include "ospf6d/ospf6_top.h"
+#include "ospf6d/ospf6_area.h"
+#include "ospf6d/ospf6_interface.h"
+#include "ospf6d/ospf6_message.h"
+#include "ospf6d/ospf6_neighbor.h"
+#include "ospf6d/ospf6_intra.h"
+#include "ospf6d/ospf6_flood.h"
+#include "ospf6d/ospf6_spf.h"
+#include "ospf6d/ospf6d.h"
+
+#include "spf_bench.h"
+
+struct thread_master *master;
+extern struct zclient *zclient;
+
+static zebra_capabilities_t _caps_p [] =
+{
+  ZCAP_NET_RAW,
+};
+
+struct zebra_privs_t ospf6d_privs =
+{
+  .caps_p = _caps_p,
+  .cap_num_p = array_size (_caps_p),
+  .cap_num_i = 0
+};
+
+#define OSPF6_BENCH_LSA_MAX 65535
+
+/* Descriptions that fit in a router-LSA, prefixes of up to /64 in an
+   intra-area-prefix-LSA. */
+#define OSPF6_BENCH_LSDESCS_MAX \
+  ((OSPF6_BENCH_LSA_MAX - sizeof (struct ospf6_lsa_header) \
+    - sizeof (struct ospf6_router_lsa)) / sizeof (struct ospf6_router_lsdesc))
+#define OSPF6_BENCH_PREFIXES_MAX \
+  ((OSPF6_BENCH_LSA_MAX - sizeof (struct ospf6_lsa_header) \
+    - sizeof (struct ospf6_intra_prefix_lsa) \
+    - sizeof (struct ospf6_prefix) - OSPF6_PREFIX_SPACE (IPV6_MAX_BITLEN)) \
+   / (sizeof (struct ospf6_prefix) + OSPF6_PREFIX_SPACE (64)) + 1)
+
+/* The interface ID of both ends of a link, also the ifindex of router
+   1's interface to it. */
+#define OSPF6_BENCH_IFID(link) ((link) + 1)
+
+static struct stream *
+ospf6_bench_lsa_new (size_t size, u_int16_t type, u_int32_t id,
+		     struct in_addr adv_router)
+{
+  struct stream *s;
+
+  s = stream_new (sizeof (struct ospf6_lsa_header) + size);
+  stream_putw (s, 0);
+  stream_putw (s, type);
+  stream_putl (s, id);
+  stream_put_ipv4 (s, adv_router.s_addr);
+  stream_putl (s, INITIAL_SEQUENCE_NUMBER);
+  stream_putw (s, 0);
+  stream_putw (s, 0);
+  return s;
+}
+
+static void
+ospf6_bench_lsa_install (struct stream *s, struct ospf6_lsdb *lsdb)
+{
+  struct ospf6_lsa_header *header;
+  struct ospf6_lsa *lsa;
+
+  header = (struct ospf6_lsa_header *) STREAM_DATA (s);
+  header->length = htons (stream_get_endp (s));
+  ospf6_lsa_checksum (header);
+
+  lsa = ospf6_lsa_create (header);
+  lsa->lsdb = lsdb;
+  stream_free (s);
+
+  ospf6_install_lsa (lsa);
+}
+
+static void
+ospf6_bench_options (struct stream *s)
+{
+  u_char options[3] = { 0, 0, 0 };
+
+  OSPF6_OPT_SET (options, OSPF6_OPT_V6);
+  OSPF6_OPT_SET (options, OSPF6_OPT_E);
+  OSPF6_OPT_SET (options, OSPF6_OPT_R);
+  stream_put (s, options, sizeof (options));
+}
+
+static void
+ospf6_bench_prefix (struct stream *s, struct prefix_ipv6 *p, u_int32_t metric)
+{
+  apply_mask_ipv6 (p);
+  stream_putc (s, p->prefixlen);
+  stream_putc (s, 0);
+  stream_putw (s, MIN (metric, 0xffff));
+  stream_put (s, &p->prefix, OSPF6_PREFIX_SPACE (p->prefixlen));
+}
+
+/* Router r's router-LSA: a point-to-point description to each of its
+   neighbours. */
+static void
+ospf6_bench_router_lsa (struct ospf6_area *oa, struct spf_bench_topology *t,
+			u_int32_t r)
+{
+  struct spf_bench_nbr *n;
+  struct stream *s;
+  unsigned int lsdescs;
+
+  lsdescs = t->first[r + 1] - t->first[r];
+  if (lsdescs > OSPF6_BENCH_LSDESCS_MAX)
+    {
+      zlog_warn ("router %u does not fit in its router-LSA", r);
+      lsdescs = OSPF6_BENCH_LSDESCS_MAX;
+    }
+
+  s = ospf6_bench_lsa_new (sizeof (struct ospf6_router_lsa)
+			   + lsdescs * sizeof (struct ospf6_router_lsdesc),
+			   OSPF6_LSTYPE_ROUTER, 0, spf_bench_router_id (r));
+  stream_putc (s, 0);
+  ospf6_bench_options (s);
+
+  for (SPF_BENCH_NBRS (t, r, n))
+    {
+      if (lsdescs-- == 0)
+	break;
+      stream_putc (s, OSPF6_ROUTER_LSDESC_POINTTOPOINT);
+      stream_putc (s, 0);
+      stream_putw (s, MIN (n->metric, 0xffff));
+      stream_putl (s, OSPF6_BENCH_IFID (n->link));
+      stream_putl (s, OSPF6_BENCH_IFID (n->link));
+      stream_put_ipv4 (s, spf_bench_router_id (n->router).s_addr);
+    }
+
+  ospf6_bench_lsa_install (s, oa->lsdb);
+}
+
+/* Router r's intra-area-prefix-LSA: its address, the prefixes of its
+   links and its stubs.  Router 1 has none, it has no address of its own
+   and its links are those of its neighbours. */
+static void
+ospf6_bench_intra_prefix_lsa (struct ospf6_area *oa,
+			      struct spf_bench_topology *t, u_int32_t r)
+{
+  struct spf_bench_nbr *n;
+  struct stream *s;
+  struct prefix_ipv6 p;
+  unsigned int links, stubs, i;
+
+  links = t->first[r + 1] - t->first[r];
+  stubs = t->prefixes;
+  if (1 + links + stubs > OSPF6_BENCH_PREFIXES_MAX)
+    {
+      zlog_warn ("router %u does not fit in its intra-area-prefix-LSA", r);
+      links = MIN (links, OSPF6_BENCH_PREFIXES_MAX - 1);
+      stubs = OSPF6_BENCH_PREFIXES_MAX - 1 - links;
+    }
+
+  s = ospf6_bench_lsa_new (sizeof (struct ospf6_intra_prefix_lsa)
+			   + sizeof (struct ospf6_prefix)
+			   + OSPF6_PREFIX_SPACE (IPV6_MAX_BITLEN)
+			   + (links + stubs) * (sizeof (struct ospf6_prefix)
+						+ OSPF6_PREFIX_SPACE (64)),
+			   OSPF6_LSTYPE_INTRA_PREFIX, 0,
+			   spf_bench_router_id (r));
+  stream_putw (s, 1 + links + stubs);
+  stream_putw (s, OSPF6_LSTYPE_ROUTER);
+  stream_putl (s, 0);
+  stream_put_ipv4 (s, spf_bench_router_id (r).s_addr);
+
+  spf_bench_router_addr6 (r, &p);
+  ospf6_bench_prefix (s, &p, 0);
+  for (SPF_BENCH_NBRS (t, r, n))
+    {
+      if (links-- == 0)
+	break;
+      spf_bench_link_addr6 (n->link, &p);
+      ospf6_bench_prefix (s, &p, n->metric);
+    }
+  for (i = 0; i < stubs; i++)
+    {
+      spf_bench_stub6 (r, i, &p);
+      ospf6_bench_prefix (s, &p, 1);
+    }
+
+  ospf6_bench_lsa_install (s, oa->lsdb);
+}
+
+/* The link-LSA of the neighbour n on router 1's interface to it. */
+static void
+ospf6_bench_link_lsa (struct ospf6_interface *oi, struct spf_bench_nbr *n)
+{
+  struct stream *s;
+  struct in6_addr linklocal;
+  struct in_addr id;
+
+  id = spf_bench_router_id (n->router);
+  memset (&linklocal, 0, sizeof (linklocal));
+  linklocal.s6_addr[0] = 0xfe;
+  linklocal.s6_addr[1] = 0x80;
+  memcpy (&linklocal.s6_addr[12], &id, sizeof (id));
+
+  s = ospf6_bench_lsa_new (sizeof (struct ospf6_link_lsa), OSPF6_LSTYPE_LINK,
+			   OSPF6_BENCH_IFID (n->link), id);
+  stream_putc (s, OSPF6_INTERFACE_PRIORITY);
+  ospf6_bench_options (s);
+  stream_put (s, &linklocal, sizeof (linklocal));
+  stream_putl (s, 0);
+
+  ospf6_bench_lsa_install (s, oi->lsdb);
+}
+
+/* The instance, router 1's router ID and an interface to each of its
+   neighbours in the backbone, configured as from ospf6d.conf. */
+static void
+ospf6_bench_config (struct spf_bench_topology *t)
+{
+  struct spf_bench_nbr *n;
+  struct interface *ifp;
+  struct vty *vty;
+  FILE *fp;
+
+  if ((fp = tmpfile ()) == NULL)
+    {
+      perror ("tmpfile");
+      exit (1);
+    }
+
+  fprintf (fp, "router ospf6\n"
+	       " router-id %s\n", inet_ntoa (spf_bench_router_id (SPF_BENCH_ROOT)));
+  for (SPF_BENCH_NBRS (t, SPF_BENCH_ROOT, n))
+    {
+      char name[INTERFACE_NAMSIZ];
+
+      snprintf (name, sizeof (name), "bench%u", n->link);
+      ifp = if_get_by_name (name);
+      if_set_index (ifp, OSPF6_BENCH_IFID (n->link));
+      fprintf (fp, " interface %s area 0.0.0.0\n", name);
+    }
+  rewind (fp);
+
+  vty = vty_new ();
+  vty->fd = 0;
+  vty->type = VTY_TERM;
+  vty->node = CONFIG_NODE;
+  if (config_from_file (vty, fp) != CMD_SUCCESS)
+    {
+      fprintf (stderr, "bad benchmark configuration: %s\n", vty->buf);
+      exit (1);
+    }
+  vty_close (vty);
+  fclose (fp);
+}
+
+/* Bring router 1's interfaces to the point-to-point state, with the
+   link-LSAs of the neighbours on them. */
+static unsigned int
+ospf6_bench_interfaces (struct spf_bench_topology *t)
+{
+  struct spf_bench_nbr *n;
+  struct ospf6_interface *oi;
+  unsigned int interfaces = 0;
+
+  for (SPF_BENCH_NBRS (t, SPF_BENCH_ROOT, n))
+    {
+      oi = ospf6_interface_lookup_by_ifindex (OSPF6_BENCH_IFID (n->link));
+      oi->state = OSPF6_INTERFACE_POINTTOPOINT;
+      oi->cost = n->metric;
+      ospf6_bench_link_lsa (oi, n);
+      interfaces++;
+    }
+  return interfaces;
+}
+
+/* Whether this can open the OSPFv3 socket. */
+static int
+ospf6_bench_sock_check (void)
+{
+  int fd;
+
+  if ((fd = socket (AF_INET6, SOCK_RAW, IPPROTO_OSPFIGP)) < 0)
+    return 0;
+  close (fd);
+  return 1;
+}
+
+int
+main (int argc, char **argv)
+{
+  struct spf_bench_topology *t;
+  struct spf_bench_phase phase;
+  struct ospf6_area *oa;
+  unsigned int interfaces, i;
+  u_int32_t r;
+
+  /* No logging of what the topology lacks. */
+  zlog_default = openzlog ("ospf6bench", ZLOG_OSPF6, LOG_NDELAY, LOG_DAEMON);
+  zlog_set_level (NULL, ZLOG_DEST_SYSLOG, ZLOG_DISABLED);
+
+  master = thread_master_create ();
+  zprivs_init (&ospf6d_privs);
+  cmd_init (1);
+  vty_init (master);
+  memory_init ();
+  if_init ();
+
+  t = spf_bench_init ("ospf6bench", argc, argv);
+
+  if (!ospf6_bench_sock_check ())
+    {
+      printf ("ospf6bench: skipped, the OSPFv3 socket cannot be opened: %s\n",
+	      safe_strerror (errno));
+      exit (0);
+    }
+
+  ospf6_init ();
+  sort_node ();
+
+  /* Zebra is the other end of a socket pair. */
+  zclient_stop (zclient);
+  zclient_free (zclient);
+  zclient = spf_bench_zclient (ZEBRA_ROUTE_OSPF6);
+
+  ospf6_bench_config (t);
+  oa = ospf6_area_lookup (htonl (0), ospf6);
+
+  spf_bench_phase_begin (&phase);
+  interfaces = ospf6_bench_interfaces (t);
+  for (r = 1; r <= t->routers; r++)
+    {
+      ospf6_bench_router_lsa (oa, t, r);
+      if (r != SPF_BENCH_ROOT)
+	ospf6_bench_intra_prefix_lsa (oa, t, r);
+    }
+  spf_bench_phase_end (&phase, "lsdb", 1, "%u LSAs, %u interfaces",
+		       oa->lsdb->count, interfaces);
+
+  /* what the LSAs going in scheduled is done next */
+  THREAD_OFF (oa->thread_spf_calculation);
+
+  spf_bench_phase_begin (&phase);
+  ospf6_spf_schedule (oa);
+  spf_bench_run_while (&oa->thread_spf_calculation);
+  spf_bench_phase_end (&phase, "spf", 1, "%u vertices, %u routes",
+		       oa->spf_table->count, ospf6->route_table->count);
+
+  spf_bench_phase_begin (&phase);
+  spf_bench_zebra_flush (zclient);
+  spf_bench_phase_end (&phase, "zebra", 1, "%lu bytes",
+		       spf_bench_zebra_bytes ());
+
+  spf_bench_phase_begin (&phase);
+  for (i = 0; i < spf_bench_runs (); i++)
+    {
+      ospf6_spf_schedule (oa);
+      spf_bench_run_while (&oa->thread_spf_calculation);
+    }
+  spf_bench_phase_end (&phase, "respf", spf_bench_runs (), "%u runs",
+		       spf_bench_runs ());
+
+  exit (0);
+}
@@ -0,0 +1,305 @@
+/* OSPF SPF benchmark.
+   Copyright (C) 2026 The Quagga project
+
+This file is part of GNU Zebra.
+
+GNU Zebra is free software; you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation; either version 2, or (at your option) any
+later version.
+
+GNU Zebra is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with GNU Zebra; see the file COPYING.  If not, write to the Free
+Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+02111-1307, USA.  */
+
+/* The backbone LSDB of a generated topology is built from router-LSAs
+ * installed as they would be on receipt, router 1's own included, and
+ * the routes of router 1 are calculated from it and sent to zebra.
+ * Router 1 has a point-to-point interface with a full neighbour to each
+ * of its neighbours.  The OSPF instance opens its raw socket, nothing is
+ * sent or read on it.
+ */
+
+#include <zebra.h>
+
+#include "thread.h"
+#include "prefix.h"
+#include "linklist.h"
+#include "if.h"
+#include "command.h"
+#include "stream.h"
+#include "table.h"
+#include "log.h"
+#include "memory.h"
+#include "privs.h"
+#include "zclient.h"
+
+#include "ospfd/ospfd.h"
+#include "ospfd/ospf_interface.h"
+#include "ospfd/ospf_ism.h"
+#include "ospfd/ospf_asbr.h"
+#include "ospfd/ospf_lsa.h"
+#include "ospfd/ospf_lsdb.h"
+#include "ospfd/ospf_neighbor.h"
+#include "ospfd/ospf_nsm.h"
+#include "ospfd/ospf_spf.h"
+
+#include "spf_bench.h"
+
+struct thread_master *master;
+extern struct zclient *zclient;
+
+static zebra_capabilities_t _caps_p [] =
+{
+  ZCAP_NET_RAW,
+};
+
+struct zebra_privs_t ospfd_privs =
+{
+  .caps_p = _caps_p,
+  .cap_num_p = array_size (_caps_p),
+  .cap_num_i = 0
+};
+
+/* Links that fit in a router-LSA. */
+#define OSPF_BENCH_LINKS_MAX \
+  ((65535 - OSPF_LSA_HEADER_SIZE - 4) / OSPF_ROUTER_LSA_LINK_SIZE)
+
+static void
+ospf_bench_link (struct stream *s, struct in_addr id, struct in_addr data,
+		 u_char type, u_int32_t cost)
+{
+  stream_put_ipv4 (s, id.s_addr);
+  stream_put_ipv4 (s, data.s_addr);
+  stream_putc (s, type);
+  stream_putc (s, 0);
+  stream_putw (s, MIN (cost, OSPF_OUTPUT_COST_INFINITE));
+}
+
+/* Router r's router-LSA: a point-to-point link and the stub network of
+   its addresses to each neighbour, in that order, then a stub for its
+   address and its stubs.  Router 1 has no interface to the last, they
+   are left out of its LSA. */
+static void
+ospf_bench_router_lsa (struct ospf_area *area, struct spf_bench_topology *t,
+		       u_int32_t r)
+{
+  struct spf_bench_nbr *n;
+  struct stream *s;
+  struct lsa_header *lsah;
+  struct ospf_lsa *lsa;
+  struct prefix_ipv4 p;
+  struct in_addr id, mask;
+  unsigned int links, stubs;
+  u_int32_t i;
+
+  links = 2 * (t->first[r + 1] - t->first[r]);
+  stubs = (r == SPF_BENCH_ROOT) ? 0 : 1 + t->prefixes;
+  if (links + stubs > OSPF_BENCH_LINKS_MAX)
+    {
+      zlog_warn ("router %u does not fit in its router-LSA", r);
+      stubs = links > OSPF_BENCH_LINKS_MAX ? 0 : OSPF_BENCH_LINKS_MAX - links;
+      links = MIN (links, OSPF_BENCH_LINKS_MAX) & ~1;
+    }
+
+  id = spf_bench_router_id (r);
+  s = stream_new (OSPF_LSA_HEADER_SIZE + 4
+		  + (links + stubs) * OSPF_ROUTER_LSA_LINK_SIZE);
+  lsa_header_set (s, OSPF_OPTION_E, OSPF_ROUTER_LSA, id, id);
+  stream_putc (s, 0);
+  stream_putc (s, 0);
+  stream_putw (s, links + stubs);
+
+  for (SPF_BENCH_NBRS (t, r, n))
+    {
+      if (links == 0)
+	break;
+      spf_bench_link_addr (n->link, r > n->router, &p);
+      ospf_bench_link (s, spf_bench_router_id (n->router), p.prefix,
+		       LSA_LINK_TYPE_POINTOPOINT, n->metric);
+      masklen2ip (p.prefixlen, &mask);
+      apply_mask_ipv4 (&p);
+      ospf_bench_link (s, p.prefix, mask, LSA_LINK_TYPE_STUB, n->metric);
+      links -= 2;
+    }
+  for (i = 0; i < stubs; i++)
+    {
+      if (i == 0)
+	{
+	  p.prefix = id;
+	  p.prefixlen = IPV4_MAX_BITLEN;
+	}
+      else
+	spf_bench_stub (r, i - 1, &p);
+      masklen2ip (p.prefixlen, &mask);
+      ospf_bench_link (s, p.prefix, mask, LSA_LINK_TYPE_STUB, i ? 1 : 0);
+    }
+
+  lsah = (struct lsa_header *) STREAM_DATA (s);
+  lsah->length = htons (stream_get_endp (s));
+  ospf_lsa_checksum (lsah);
+
+  lsa = ospf_lsa_new ();
+  lsa->area = area;
+  lsa->data = ospf_lsa_data_new (stream_get_endp (s));
+  memcpy (lsa->data, lsah, stream_get_endp (s));
+  if (r == SPF_BENCH_ROOT)
+    SET_FLAG (lsa->flags, OSPF_LSA_SELF | OSPF_LSA_SELF_CHECKED);
+  stream_free (s);
+
+  ospf_lsa_install (area->ospf, NULL, lsa);
+}
+
+/* A point-to-point interface of router 1 to each of its neighbours, with
+   the neighbour full, at the positions of its links in the router-LSA. */
+static unsigned int
+ospf_bench_interfaces (struct ospf_area *area, struct spf_bench_topology *t)
+{
+  struct spf_bench_nbr *n;
+  struct interface *ifp;
+  struct ospf_interface *oi;
+  struct ospf_neighbor *nbr;
+  struct ospf_header ospfh;
+  struct ip iph;
+  struct prefix_ipv4 *addr, p;
+  char name[INTERFACE_NAMSIZ];
+  int lsa_pos = 0;
+
+  for (SPF_BENCH_NBRS (t, SPF_BENCH_ROOT, n))
+    {
+      snprintf (name, sizeof (name), "bench%u", n->link);
+      ifp = if_get_by_name (name);
+      if_set_index (ifp, n->link + 1);
+
+      addr = prefix_ipv4_new ();
+      spf_bench_link_addr (n->link, 0, addr);
+      oi = ospf_if_new (area->ospf, ifp, (struct prefix *) addr);
+      oi->area = area;
+      oi->type = OSPF_IFTYPE_POINTOPOINT;
+      oi->state = ISM_PointToPoint;
+      oi->output_cost = n->metric;
+      oi->lsa_pos_beg = lsa_pos;
+      oi->lsa_pos_end = lsa_pos += 2;
+      listnode_add (area->oiflist, oi);
+
+      spf_bench_link_addr (n->link, 1, &p);
+      memset (&ospfh, 0, sizeof (ospfh));
+      ospfh.router_id = spf_bench_router_id (n->router);
+      memset (&iph, 0, sizeof (iph));
+      iph.ip_src = p.prefix;
+      nbr = ospf_nbr_get (oi, &ospfh, &iph, (struct prefix *) &p);
+      nbr->state = NSM_Full;
+      area->full_nbrs++;
+    }
+
+  return listcount (area->oiflist);
+}
+
+static unsigned long
+ospf_bench_routes (struct route_table *table)
+{
+  struct route_node *rn;
+  unsigned long routes = 0;
+
+  for (rn = route_top (table); rn; rn = route_next (rn))
+    if (rn->info)
+      routes++;
+  return routes;
+}
+
+/* Whether this can open the socket of an OSPF instance. */
+static int
+ospf_bench_sock_check (void)
+{
+  int fd;
+
+  if ((fd = socket (AF_INET, SOCK_RAW, IPPROTO_OSPFIGP)) < 0)
+    return 0;
+  close (fd);
+  return 1;
+}
+
+int
+main (int argc, char **argv)
+{
+  struct spf_bench_topology *t;
+  struct spf_bench_phase phase;
+  struct ospf *ospf;
+  struct ospf_area *area;
+  struct in_addr area_id;
+  unsigned int interfaces, i;
+  u_int32_t r;
+
+  /* No logging of what the topology lacks. */
+  zlog_default = openzlog ("ospfbench", ZLOG_OSPF, LOG_NDELAY, LOG_DAEMON);
+  zlog_set_level (NULL, ZLOG_DEST_SYSLOG, ZLOG_DISABLED);
+
+  ospf_master_init ();
+  master = om->master;
+  zprivs_init (&ospfd_privs);
+  cmd_init (1);
+  memory_init ();
+  ospf_if_init ();
+
+  t = spf_bench_init ("ospfbench", argc, argv);
+
+  if (!ospf_bench_sock_check ())
+    {
+      printf ("ospfbench: skipped, the OSPF socket cannot be opened: %s\n",
+	      safe_strerror (errno));
+      exit (0);
+    }
+
+  /* Only the SPF calculation, at once: none of the timers of the
+     instance, nor its socket, are of use. */
+  ospf = ospf_get ();
+  OSPF_TIMER_OFF (ospf->t_maxage_walker);
+  OSPF_TIMER_OFF (ospf->t_lsa_refresher);
+  OSPF_TIMER_OFF (ospf->t_read);
+  ospf->router_id = spf_bench_router_id (SPF_BENCH_ROOT);
+  ospf->spf_delay = 0;
+  ospf->spf_holdtime = 0;
+  zclient = spf_bench_zclient (ZEBRA_ROUTE_OSPF);
+
+  area_id.s_addr = OSPF_AREA_BACKBONE;
+  area = ospf_area_get (ospf, area_id, OSPF_AREA_ID_FORMAT_ADDRESS);
+
+  spf_bench_phase_begin (&phase);
+  interfaces = ospf_bench_interfaces (area, t);
+  for (r = 1; r <= t->routers; r++)
+    ospf_bench_router_lsa (area, t, r);
+  spf_bench_phase_end (&phase, "lsdb", 1, "%lu LSAs, %u interfaces",
+		       ospf_lsdb_count_all (area->lsdb), interfaces);
+
+  /* what the LSAs going in scheduled is done next */
+  OSPF_TIMER_OFF (ospf->t_spf_calc);
+
+  spf_bench_phase_begin (&phase);
+  ospf_spf_calculate_schedule (ospf);
+  spf_bench_run_while (&ospf->t_spf_calc);
+  spf_bench_phase_end (&phase, "spf", 1, "%u vertices, %lu routes",
+		       area->spf_tree.count,
+		       ospf_bench_routes (ospf->new_table));
+
+  spf_bench_phase_begin (&phase);
+  spf_bench_zebra_flush (zclient);
+  spf_bench_phase_end (&phase, "zebra", 1, "%lu bytes",
+		       spf_bench_zebra_bytes ());
+
+  spf_bench_phase_begin (&phase);
+  for (i = 0; i < spf_bench_runs (); i++)
+    {
+      ospf_spf_calculate_schedule (ospf);
+      spf_bench_run_while (&ospf->t_spf_calc);
+    }
+  spf_bench_phase_end (&phase, "respf", spf_bench_runs (), "%u runs",
+		       spf_bench_runs ());
+
+  exit (0);
+}
@@ -0,0 +1,231 @@
+/* Compile prefixes into a prefix set file.
+   Copyright (C) 2026 The Quagga project
+
+This file is part of GNU Zebra.
+
+GNU Zebra is free software; you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation; either version 2, or (at your option) any
+later version.
+
+GNU Zebra is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with GNU Zebra; see the file COPYING.  If not, write to the Free
+Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+02111-1307, USA.  */
+
+/* plistcompile reads prefixes from standard input, one per line, and
+ * writes the prefix set file "ip prefix-list NAME file FILE" maps: see
+ * struct prefix_set_header in lib/plist.h.  A line is a prefix with an
+ * optional "ge N" and "le N", or an "ip prefix-list" or "ipv6
+ * prefix-list" permit command as IRR tools generate, so their output
+ * can be piped in as it is.  The file is written next to FILE and
+ * renamed over it, so a daemon still mapping the old one is not
+ * disturbed and reloads by configuring the file again.
+ */
+
+#include <zebra.h>
+
+#include "prefix.h"
+#include "vty.h"
+#include "plist.h"
+
+#define LINE_MAX_LEN 1024
+
+struct thread_master *master;
+
+struct set_entry
+{
+  u_char prefixlen;
+  u_char addr[16];
+  u_char ge;
+  u_char le;
+};
+
+static int addrlen;
+
+static int
+set_entry_cmp (const void *a, const void *b)
+{
+  const struct set_entry *e1 = a;
+  const struct set_entry *e2 = b;
+  int ret;
+
+  if (e1->prefixlen != e2->prefixlen)
+    return e1->prefixlen < e2->prefixlen ? -1 : 1;
+  if ((ret = memcmp (e1->addr, e2->addr, addrlen)) != 0)
+    return ret;
+  if (e1->ge != e2->ge)
+    return e1->ge < e2->ge ? -1 : 1;
+  return e1->le - e2->le;
+}
+
+/* Parse one line into e, returning 1, or 0 for a line with nothing to
+   add and -1 for a malformed one. */
+static int
+parse_line (char *line, afi_t afi, struct set_entry *e)
+{
+  struct prefix p;
+  char *tok, *save;
+  int maxlen = (afi == AFI_IP ? IPV4_MAX_BITLEN : IPV6_MAX_BITLEN);
+  int ge = 0, le = 0;
+  int have = 0;
+  int ret;
+
+  for (tok = strtok_r (line, " \t\r\n", &save); tok;
+       tok = strtok_r (NULL, " \t\r\n", &save))
+    {
+      if (tok[0] == '!' || tok[0] == '#')
+	break;
+      else if (strcmp (tok, "no") == 0 || strcmp (tok, "description") == 0)
+	return 0;
+      else if (strcmp (tok, "deny") == 0)
+	return -1;
+      else if (strcmp (tok, "ge") == 0 || strcmp (tok, "le") == 0)
+	{
+	  char *num = strtok_r (NULL, " \t\r\n", &save);
+
+	  if (! have || ! num)
+	    return -1;
+	  if (tok[0] == 'g')
+	    ge = atoi (num);
+	  else
+	    le = atoi (num);
+	}
+      else if (! have && strcmp (tok, "any") == 0)
+	{
+	  memset (&p, 0, sizeof (struct prefix));
+	  p.family = (afi == AFI_IP ? AF_INET : AF_INET6);
+	  le = maxlen;
+	  have = 1;
+	}
+      else if (! have && strchr (tok, '/'))
+	{
+	  if (afi == AFI_IP)
+	    ret = str2prefix_ipv4 (tok, (struct prefix_ipv4 *) &p);
+	  else
+	    ret = str2prefix_ipv6 (tok, (struct prefix_ipv6 *) &p);
+	  if (ret <= 0)
+	    return -1;
+	  have = 1;
+	}
+    }
+
+  if (! have)
+    return 0;
+
+  /* The checks and the normalisation of the prefix-list commands. */
+  if ((ge && ge <= p.prefixlen) || (le && le <= p.prefixlen)
+      || (le && ge > le) || ge > maxlen || le > maxlen)
+    return -1;
+  if (ge && le == maxlen)
+    le = 0;
+
+  apply_mask (&p);
+  memset (e, 0, sizeof (struct set_entry));
+  e->prefixlen = p.prefixlen;
+  memcpy (e->addr, &p.u.prefix, addrlen);
+  e->ge = ge;
+  e->le = le;
+  return 1;
+}
+
+int
+main (int argc, char **argv)
+{
+  struct prefix_set_header hdr;
+  struct set_entry *entries = NULL;
+  size_t count = 0, alloc = 0, i, n;
+  char line[LINE_MAX_LEN];
+  char *path, *tmp;
+  afi_t afi = AFI_IP;
+  unsigned long lineno = 0;
+  FILE *fp;
+  int len;
+  int ret;
+
+  if (argc == 3 && strcmp (argv[1], "-6") == 0)
+    {
+      afi = AFI_IP6;
+      path = argv[2];
+    }
+  else if (argc == 2)
+    path = argv[1];
+  else
+    {
+      fprintf (stderr, "usage: %s [-6] FILE < prefixes\n", argv[0]);
+      return 2;
+    }
+  addrlen = (afi == AFI_IP ? IPV4_MAX_BYTELEN : IPV6_MAX_BYTELEN);
+
+  while (fgets (line, sizeof (line), stdin))
+    {
+      lineno++;
+      if (count == alloc)
+	{
+	  alloc = alloc ? alloc * 2 : 1024;
+	  entries = realloc (entries, alloc * sizeof (struct set_entry));
+	  if (! entries)
+	    {
+	      fprintf (stderr, "out of memory\n");
+	      return 1;
+	    }
+	}
+      ret = parse_line (line, afi, &entries[count]);
+      if (ret < 0)
+	{
+	  fprintf (stderr, "line %lu: not a permitted IPv%d prefix\n",
+		   lineno, afi == AFI_IP ? 4 : 6);
+	  return 1;
+	}
+      count += ret;
+    }
+
+  /* In order of length then address, without duplicates. */
+  if (count)
+    qsort (entries, count, sizeof (struct set_entry), set_entry_cmp);
+  for (i = n = 0; i < count; i++)
+    if (n == 0 || set_entry_cmp (&entries[n - 1], &entries[i]) != 0)
+      entries[n++] = entries[i];
+  count = n;
+
+  memset (&hdr, 0, sizeof (hdr));
+  hdr.magic = PREFIX_SET_MAGIC;
+  hdr.afi = afi;
+  hdr.count = count;
+  for (i = 0, len = 0; len <= PREFIX_SET_MAXLEN; len++)
+    {
+      hdr.start[len] = i;
+      while (i < count && entries[i].prefixlen == len)
+	i++;
+    }
+  hdr.start[PREFIX_SET_MAXLEN + 1] = count;
+
+  tmp = malloc (strlen (path) + sizeof (".new"));
+  sprintf (tmp, "%s.new", path);
+  if ((fp = fopen (tmp, "w")) == NULL)
+    {
+      fprintf (stderr, "%s: %s\n", tmp, strerror (errno));
+      return 1;
+    }
+  fwrite (&hdr, sizeof (hdr), 1, fp);
+  for (i = 0; i < count; i++)
+    {
+      fwrite (entries[i].addr, addrlen, 1, fp);
+      fputc (entries[i].ge, fp);
+      fputc (entries[i].le, fp);
+    }
+  if (fclose (fp) != 0 || rename (tmp, path) < 0)
+    {
+      fprintf (stderr, "%s: %s\n", path, strerror (errno));
+      unlink (tmp);
+      return 1;
+    }
+
+  printf ("%s: %lu prefixes\n", path, (unsigned long) count);
+  return 0;
+}
@@ -0,0 +1,406 @@
+/* Common part of the IGP SPF benchmarks.
+   Copyright (C) 2026 The Quagga project
+
+This file is part of GNU Zebra.
+
+GNU Zebra is free software; you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation; either version 2, or (at your option) any
+later version.
+
+GNU Zebra is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with GNU Zebra; see the file COPYING.  If not, write to the Free
+Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+02111-1307, USA.  */
+
+/* The topologies are layered grids from the spgrid generator of the
+ * IS-IS topology code: X layers of Y routers, with a cycle both ways in
+ * each layer, links between the layers and a router linked to the first
+ * layer.  Its arcs are taken as point-to-point links with the arc length
+ * as metric, both ways, once for each pair of routers.  Each router has
+ * an address, numbered addresses on its links and a number of stub
+ * prefixes.
+ *
+ * Routes go to a zebra played by a socket pair, whose far end is read and
+ * discarded by a thread of the benchmark, so that the messages are built
+ * and written as they would be to the real one.
+ */
+
+#include <zebra.h>
+
+#include "thread.h"
+#include "vty.h"
+#include "log.h"
+#include "memory.h"
+#include "linklist.h"
+#include "prefix.h"
+#include "buffer.h"
+#include "network.h"
+#include "zclient.h"
+
+#include "spgrid.h"
+#include "spf_bench.h"
+
+extern struct thread_master *master;
+
+static unsigned int runs = 10;
+static u_int32_t prefixes = 1;
+static unsigned long zebra_bytes;
+static int zebra_fd = -1;
+
+struct spf_bench_arc
+{
+  u_int32_t a, b;		/* a < b */
+  u_int32_t metric;
+};
+
+static int
+spf_bench_arc_cmp (const void *p1, const void *p2)
+{
+  const struct spf_bench_arc *a1 = p1;
+  const struct spf_bench_arc *a2 = p2;
+
+  if (a1->a != a2->a)
+    return a1->a < a2->a ? -1 : 1;
+  if (a1->b != a2->b)
+    return a1->b < a2->b ? -1 : 1;
+  return 0;
+}
+
+/* The links of the generated arcs, for each pair of routers the first. */
+static void
+spf_bench_topology_build (struct spf_bench_topology *t, struct list *arcs)
+{
+  struct spf_bench_arc *links;
+  struct listnode *node;
+  struct arc *arc;
+  u_int32_t i, n = 0;
+
+  links = XCALLOC (MTYPE_TMP, listcount (arcs) * sizeof (*links));
+  for (ALL_LIST_ELEMENTS_RO (arcs, node, arc))
+    {
+      if (arc->from_node == arc->to_node)
+	continue;
+      links[n].a = MIN (arc->from_node, arc->to_node);
+      links[n].b = MAX (arc->from_node, arc->to_node);
+      links[n].metric = MAX (arc->distance, 1);
+      if (links[n].b > t->routers)
+	t->routers = links[n].b;
+      n++;
+    }
+  qsort (links, n, sizeof (*links), spf_bench_arc_cmp);
+  for (i = 0, t->links = 0; i < n; i++)
+    if (t->links == 0 || spf_bench_arc_cmp (&links[t->links - 1], &links[i]))
+      links[t->links++] = links[i];
+
+  /* Count the neighbours of each router, then place them. */
+  t->first = XCALLOC (MTYPE_TMP, (t->routers + 2) * sizeof (u_int32_t));
+  t->nbrs = XCALLOC (MTYPE_TMP, 2 * t->links * sizeof (struct spf_bench_nbr));
+  for (i = 0; i < t->links; i++)
+    {
+      t->first[links[i].a + 1]++;
+      t->first[links[i].b + 1]++;
+    }
+  for (i = 1; i <= t->routers + 1; i++)
+    t->first[i] += t->first[i - 1];
+  for (i = 0; i < t->links; i++)
+    {
+      struct spf_bench_nbr *n;
+
+      n = &t->nbrs[t->first[links[i].a]++];
+      n->router = links[i].b;
+      n->metric = links[i].metric;
+      n->link = i;
+      n = &t->nbrs[t->first[links[i].b]++];
+      n->router = links[i].a;
+      n->metric = links[i].metric;
+      n->link = i;
+    }
+  for (i = t->routers + 1; i > 0; i--)
+    t->first[i] = t->first[i - 1];
+  t->first[0] = 0;
+
+  XFREE (MTYPE_TMP, links);
+}
+
+static void
+spf_bench_usage (const char *progname)
+{
+  fprintf (stderr,
+	   "usage: %s [-x layers] [-y routers] [-s seed] [-p prefixes] "
+	   "[-r runs] [spgrid option...]\n", progname);
+  exit (1);
+}
+
+/* Parse the options and generate the topology. */
+struct spf_bench_topology *
+spf_bench_init (const char *progname, int argc, char **argv)
+{
+  struct spf_bench_topology *t;
+  struct spf_bench_phase phase;
+  struct vty vty;
+  struct list *arcs;
+  const char **args;
+  char x[16] = "30", y[16] = "30", seed[16] = "1";
+  int opt, i, n;
+
+  while ((opt = getopt (argc, argv, "x:y:s:p:r:")) != -1)
+    switch (opt)
+      {
+      case 'x':
+	snprintf (x, sizeof (x), "%s", optarg);
+	break;
+      case 'y':
+	snprintf (y, sizeof (y), "%s", optarg);
+	break;
+      case 's':
+	snprintf (seed, sizeof (seed), "%s", optarg);
+	break;
+      case 'p':
+	prefixes = strtoul (optarg, NULL, 10);
+	break;
+      case 'r':
+	runs = strtoul (optarg, NULL, 10);
+	break;
+      default:
+	spf_bench_usage (progname);
+      }
+
+  /* The generator tells what it does not like on the vty. */
+  memset (&vty, 0, sizeof (vty));
+  vty.type = VTY_SHELL;
+  args = XCALLOC (MTYPE_TMP, (3 + argc - optind) * sizeof (char *));
+  args[0] = x;
+  args[1] = y;
+  args[2] = seed;
+  for (i = optind, n = 3; i < argc; i++)
+    args[n++] = argv[i];
+  if (spgrid_check_params (&vty, n, args))
+    spf_bench_usage (progname);
+  XFREE (MTYPE_TMP, args);
+
+  spf_bench_phase_begin (&phase);
+  arcs = list_new ();
+  gen_spgrid_topology (&vty, arcs);
+  t = XCALLOC (MTYPE_TMP, sizeof (struct spf_bench_topology));
+  t->prefixes = prefixes;
+  spf_bench_topology_build (t, arcs);
+  list_delete (arcs);
+
+  if (t->routers < 2)
+    {
+      fprintf (stderr, "%s: the topology has no links\n", progname);
+      exit (1);
+    }
+
+  printf ("%s: %u routers, %u links, %u stub prefixes each, seed %s\n",
+	  progname, t->routers, t->links, t->prefixes, seed);
+  printf ("%-10s %12s %12s %12s\n", "phase", "msecs/run", "allocs/run",
+	  "KB held");
+  spf_bench_phase_end (&phase, "topology", 1, "%u routers", t->routers);
+
+  return t;
+}
+
+unsigned int
+spf_bench_runs (void)
+{
+  return runs;
+}
+
+void
+spf_bench_phase_begin (struct spf_bench_phase *phase)
+{
+  phase->allocs = mtype_stats_total ();
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &phase->start);
+}
+
+/* Report the time and the allocations per run of a phase, the memory held
+   after it, and what it did. */
+void
+spf_bench_phase_end (struct spf_bench_phase *phase, const char *name,
+		     unsigned int n, const char *format, ...)
+{
+  struct timeval now;
+  unsigned long usecs;
+  va_list args;
+
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &now);
+  usecs = (now.tv_sec - phase->start.tv_sec) * 1000000UL
+	  + now.tv_usec - phase->start.tv_usec;
+  if (n == 0)
+    n = 1;
+
+  printf ("%-10s %12.3f %12lu %12lu   ", name, usecs / 1000.0 / n,
+	  (mtype_stats_total () - phase->allocs) / n,
+	  mtype_stats_bytes () / 1024);
+  va_start (args, format);
+  vprintf (format, args);
+  va_end (args);
+  printf ("\n");
+  fflush (stdout);
+}
+
+/* Router r's address, 172.16.0.0/12 numbered by router, which is also
+   its router ID. */
+struct in_addr
+spf_bench_router_id (u_int32_t r)
+{
+  struct in_addr id;
+
+  id.s_addr = htonl (0xac100000 + r);
+  return id;
+}
+
+/* The address of one end of a link, a /31 out of 10.0.0.0/8: end 0 is
+   that of the router with the lower number. */
+void
+spf_bench_link_addr (u_int32_t link, int end, struct prefix_ipv4 *p)
+{
+  memset (p, 0, sizeof (struct prefix_ipv4));
+  p->family = AF_INET;
+  p->prefixlen = 31;
+  p->prefix.s_addr = htonl (0x0a000000 + link * 2 + end);
+}
+
+/* Stub prefix i of router r, a /24 out of 20.0.0.0 onwards. */
+void
+spf_bench_stub (u_int32_t r, u_int32_t i, struct prefix_ipv4 *p)
+{
+  memset (p, 0, sizeof (struct prefix_ipv4));
+  p->family = AF_INET;
+  p->prefixlen = 24;
+  p->prefix.s_addr = htonl (0x14000000 + (((r - 1) * prefixes + i) << 8));
+}
+
+#ifdef HAVE_IPV6
+/* Likewise for IPv6: router addresses out of fd00:1::/64, links /64s out
+   of fd00:2::/32 and stub /64s out of fd00:3::/32. */
+void
+spf_bench_router_addr6 (u_int32_t r, struct prefix_ipv6 *p)
+{
+  memset (p, 0, sizeof (struct prefix_ipv6));
+  p->family = AF_INET6;
+  p->prefixlen = IPV6_MAX_BITLEN;
+  p->prefix.s6_addr[0] = 0xfd;
+  p->prefix.s6_addr[3] = 1;
+  p->prefix.s6_addr[12] = r >> 24;
+  p->prefix.s6_addr[13] = r >> 16;
+  p->prefix.s6_addr[14] = r >> 8;
+  p->prefix.s6_addr[15] = r;
+}
+
+void
+spf_bench_link_addr6 (u_int32_t link, struct prefix_ipv6 *p)
+{
+  memset (p, 0, sizeof (struct prefix_ipv6));
+  p->family = AF_INET6;
+  p->prefixlen = 64;
+  p->prefix.s6_addr[0] = 0xfd;
+  p->prefix.s6_addr[3] = 2;
+  p->prefix.s6_addr[4] = link >> 24;
+  p->prefix.s6_addr[5] = link >> 16;
+  p->prefix.s6_addr[6] = link >> 8;
+  p->prefix.s6_addr[7] = link;
+}
+
+void
+spf_bench_stub6 (u_int32_t r, u_int32_t i, struct prefix_ipv6 *p)
+{
+  u_int32_t n = (r - 1) * prefixes + i;
+
+  memset (p, 0, sizeof (struct prefix_ipv6));
+  p->family = AF_INET6;
+  p->prefixlen = 64;
+  p->prefix.s6_addr[0] = 0xfd;
+  p->prefix.s6_addr[3] = 3;
+  p->prefix.s6_addr[4] = n >> 24;
+  p->prefix.s6_addr[5] = n >> 16;
+  p->prefix.s6_addr[6] = n >> 8;
+  p->prefix.s6_addr[7] = n;
+}
+#endif /* HAVE_IPV6 */
+
+/* The zebra end of the socket pair: read and forget. */
+static void
+spf_bench_zebra_drain (void)
+{
+  static u_char buf[65536];
+  ssize_t nbytes;
+
+  while ((nbytes = read (zebra_fd, buf, sizeof (buf))) > 0)
+    zebra_bytes += nbytes;
+}
+
+static int
+spf_bench_zebra_read (struct thread *thread)
+{
+  spf_bench_zebra_drain ();
+  thread_add_read (master, spf_bench_zebra_read, NULL, zebra_fd);
+  return 0;
+}
+
+/* A client connected to the zebra of the benchmark, which has agreed on
+   what this one's does, redistributing the routes of the type. */
+struct zclient *
+spf_bench_zclient (int type)
+{
+  struct zclient *zclient;
+  int sv[2];
+
+  if (socketpair (AF_UNIX, SOCK_STREAM, 0, sv) < 0)
+    {
+      perror ("socketpair");
+      exit (1);
+    }
+  set_nonblocking (sv[0]);
+  set_nonblocking (sv[1]);
+  zebra_fd = sv[1];
+  thread_add_read (master, spf_bench_zebra_read, NULL, zebra_fd);
+
+  zclient = zclient_new ();
+  zclient->enable = 1;
+  zclient->sock = sv[0];
+  zclient->redist_default = type;
+  zclient->redist[type] = 1;
+  zclient->capabilities = ZEBRA_CAPABILITY_ALL;
+  return zclient;
+}
+
+static void
+spf_bench_run_one (void)
+{
+  struct thread thread;
+
+  if (thread_fetch (master, &thread))
+    thread_call (&thread);
+}
+
+/* Run the threads for as long as the thread is scheduled. */
+void
+spf_bench_run_while (struct thread **t)
+{
+  while (*t)
+    spf_bench_run_one ();
+}
+
+/* Run the threads until the messages queued for zebra are written, and
+   zebra has read them. */
+void
+spf_bench_zebra_flush (struct zclient *zclient)
+{
+  while (zclient->t_bulk || zclient->t_write)
+    spf_bench_run_one ();
+  spf_bench_zebra_drain ();
+}
+
+unsigned long
+spf_bench_zebra_bytes (void)
+{
+  return zebra_bytes;
+}
@@ -0,0 +1,79 @@
+/* Common part of the IGP SPF benchmarks.
+   Copyright (C) 2026 The Quagga project
+
+This file is part of GNU Zebra.
+
+GNU Zebra is free software; you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation; either version 2, or (at your option) any
+later version.
+
+GNU Zebra is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with GNU Zebra; see the file COPYING.  If not, write to the Free
+Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+02111-1307, USA.  */
+
+#ifndef _QUAGGA_SPF_BENCH_H
+#define _QUAGGA_SPF_BENCH_H
+
+/* The router whose routes are calculated, the others are numbered from
+   2 up to the number of routers. */
+#define SPF_BENCH_ROOT 1
+
+/* A neighbour of a router, over a point-to-point link. */
+struct spf_bench_nbr
+{
+  u_int32_t router;
+  u_int32_t metric;
+  u_int32_t link;		/* numbered from 0 */
+};
+
+/* The neighbours of router r are nbrs[first[r]] to nbrs[first[r + 1] - 1],
+   each link is there once for each end. */
+struct spf_bench_topology
+{
+  u_int32_t routers;
+  u_int32_t links;
+  u_int32_t prefixes;		/* stub prefixes of each router */
+  u_int32_t *first;
+  struct spf_bench_nbr *nbrs;
+};
+
+#define SPF_BENCH_NBRS(t, r, n) \
+  (n) = &(t)->nbrs[(t)->first[(r)]]; (n) < &(t)->nbrs[(t)->first[(r) + 1]]; \
+  (n)++
+
+/* A phase of a benchmark, from spf_bench_phase_begin to _end. */
+struct spf_bench_phase
+{
+  struct timeval start;
+  unsigned long allocs;
+};
+
+extern struct spf_bench_topology *spf_bench_init (const char *, int, char **);
+extern void spf_bench_phase_begin (struct spf_bench_phase *);
+extern void spf_bench_phase_end (struct spf_bench_phase *, const char *,
+				 unsigned int, const char *, ...)
+  PRINTF_ATTRIBUTE(4, 5);
+extern unsigned int spf_bench_runs (void);
+
+extern struct in_addr spf_bench_router_id (u_int32_t);
+extern void spf_bench_link_addr (u_int32_t, int, struct prefix_ipv4 *);
+extern void spf_bench_stub (u_int32_t, u_int32_t, struct prefix_ipv4 *);
+#ifdef HAVE_IPV6
+extern void spf_bench_router_addr6 (u_int32_t, struct prefix_ipv6 *);
+extern void spf_bench_link_addr6 (u_int32_t, struct prefix_ipv6 *);
+extern void spf_bench_stub6 (u_int32_t, u_int32_t, struct prefix_ipv6 *);
+#endif /* HAVE_IPV6 */
+
+extern struct zclient *spf_bench_zclient (int);
+extern void spf_bench_run_while (struct thread **);
+extern void spf_bench_zebra_flush (struct zclient *);
+extern unsigned long spf_bench_zebra_bytes (void);
+
+#endif /* _QUAGGA_SPF_BENCH_H */
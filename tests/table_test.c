@@ -534,6 +534,132 @@ test_iter_pause (void)
   route_table_finish (table);
 }
 
+/*
+ * random_prefix
+ *
+ * Fill in a random prefix of the given family, with the addresses bunched
+ * up under a few leading bytes so that prefixes nest.
+ */
+static void
+random_prefix (struct prefix *p, int family)
+{
+  int i, bytes;
+
+  memset (p, 0, sizeof (*p));
+  p->family = family;
+  bytes = (family == AF_INET) ? IPV4_MAX_BYTELEN : IPV6_MAX_BYTELEN;
+
+  (&p->u.prefix)[0] = 10 + random () % 4;
+  (&p->u.prefix)[1] = random () % 8;
+  for (i = 2; i < bytes; i++)
+    (&p->u.prefix)[i] = random ();
+
+  p->prefixlen = random () % (bytes * 8 + 1);
+  apply_mask (p);
+}
+
+/*
+ * verify_index_match
+ *
+ * Checks that route_node_match() returns the same prefix from the plain
+ * and the indexed tables, for a number of random addresses and prefixes.
+ */
+static void
+verify_index_match (struct route_table *plain, struct route_table *indexed,
+		    int family, int count)
+{
+  struct route_node *rn1, *rn2;
+  struct prefix p;
+  int i;
+
+  for (i = 0; i < count; i++)
+    {
+      random_prefix (&p, family);
+      if (i % 2)
+	p.prefixlen = (family == AF_INET) ? IPV4_MAX_BITLEN : IPV6_MAX_BITLEN;
+
+      rn1 = route_node_match (plain, &p);
+      rn2 = route_node_match (indexed, &p);
+
+      assert ((rn1 == NULL) == (rn2 == NULL));
+      if (rn1)
+	{
+	  assert (prefix_same (&rn1->p, &rn2->p));
+	  route_unlock_node (rn1);
+	  route_unlock_node (rn2);
+	}
+    }
+}
+
+/*
+ * test_index
+ *
+ * Fills a plain table, a table indexed from the start and one indexed
+ * once filled with the same random prefixes, then checks that lookups
+ * agree, also after deleting some of the prefixes.
+ */
+static void
+test_index (int family)
+{
+  struct route_table *tables[3];
+  struct route_node *rn;
+  struct prefix p;
+  int i, t, num_prefixes = 2000;
+
+  printf ("\n\nTesting route_node_match() on an indexed table\n");
+
+  for (t = 0; t < 3; t++)
+    tables[t] = route_table_init ();
+  route_table_enable_index (tables[1]);
+
+  srandom (family);
+  for (i = 0; i < num_prefixes; i++)
+    {
+      random_prefix (&p, family);
+      for (t = 0; t < 3; t++)
+	{
+	  rn = route_node_get (tables[t], &p);
+	  if (rn->info)
+	    route_unlock_node (rn);
+	  else
+	    rn->info = tables[t];
+	}
+    }
+  route_table_enable_index (tables[2]);
+
+  verify_index_match (tables[0], tables[1], family, 10000);
+  verify_index_match (tables[0], tables[2], family, 10000);
+
+  /* Delete every other prefix, in tree order. */
+  for (t = 0; t < 3; t++)
+    {
+      i = 0;
+      for (rn = route_top (tables[t]); rn; rn = route_next (rn))
+	if (rn->info && (i++ % 2))
+	  {
+	    rn->info = NULL;
+	    route_unlock_node (rn);
+	  }
+    }
+
+  verify_index_match (tables[0], tables[1], family, 10000);
+  verify_index_match (tables[0], tables[2], family, 10000);
+
+  for (t = 0; t < 3; t++)
+    {
+      for (rn = route_top (tables[t]); rn; rn = route_next (rn))
+	if (rn->info)
+	  {
+	    rn->info = NULL;
+	    route_unlock_node (rn);
+	  }
+      route_table_finish (tables[t]);
+    }
+
+  printf ("Verified indexed match on %s tables\n",
+	  (family == AF_INET) ? "IPv4" : "IPv6");
+}
+
 /*
  * run_tests
  */
@@ -543,6 +669,10 @@ run_tests (void)
   test_prefix_iter_cmp ();
   test_get_next ();
   test_iter_pause ();
+  test_index (AF_INET);
+#ifdef HAVE_IPV6
+  test_index (AF_INET6);
+#endif
 }
 
 /*
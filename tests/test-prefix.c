@@ -0,0 +1,224 @@
+/* Prefix and sockunion compare tests.
+   Copyright (C) 2026 The Quagga project
+
+This file is part of GNU Zebra.
+
+GNU Zebra is free software; you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation; either version 2, or (at your option) any
+later version.
+
+GNU Zebra is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with GNU Zebra; see the file COPYING.  If not, write to the Free
+Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+02111-1307, USA.  */
+
+/* The family compares of lib are checked against byte at a time
+ * references on random prefixes that share a random number of leading
+ * bits, so that every length sees both outcomes.
+ */
+
+#include <zebra.h>
+#include <time.h>
+
+#include "prefix.h"
+#include "sockunion.h"
+
+struct thread_master *master;
+
+#define PREFIX_TEST_ROUNDS 200000
+#define PREFIX_BENCH_ROUNDS (1 << 26)
+
+static const u_char maskbit[] = {0x00, 0x80, 0xc0, 0xe0, 0xf0,
+				 0xf8, 0xfc, 0xfe, 0xff};
+
+/* prefix_match () as it was, a byte at a time. */
+static int
+ref_prefix_match (const struct prefix *n, const struct prefix *p)
+{
+  int offset, shift;
+  const u_char *np, *pp;
+
+  if (n->prefixlen > p->prefixlen)
+    return 0;
+
+  np = (const u_char *)&n->u.prefix;
+  pp = (const u_char *)&p->u.prefix;
+  offset = n->prefixlen / 8;
+  shift = n->prefixlen % 8;
+
+  if (shift)
+    if (maskbit[shift] & (np[offset] ^ pp[offset]))
+      return 0;
+  while (offset--)
+    if (np[offset] != pp[offset])
+      return 0;
+  return 1;
+}
+
+static int
+ref_prefix_cmp (const struct prefix *p1, const struct prefix *p2)
+{
+  if (p1->family != p2->family || p1->prefixlen != p2->prefixlen)
+    return 1;
+  return ! ref_prefix_match (p1, p2);
+}
+
+static int
+ref_prefix_same (const struct prefix *p1, const struct prefix *p2)
+{
+  return p1->family == p2->family && p1->prefixlen == p2->prefixlen
+    && memcmp (&p1->u.prefix, &p2->u.prefix,
+	       p1->family == AF_INET ? IPV4_MAX_BYTELEN : IPV6_MAX_BYTELEN) == 0;
+}
+
+/* Two random prefixes of family that are the same in a random number of
+   leading bits, the rest of the bits random. */
+static void
+prefix_pair (int family, struct prefix *p1, struct prefix *p2)
+{
+  int bytes = (family == AF_INET) ? IPV4_MAX_BYTELEN : IPV6_MAX_BYTELEN;
+  int bits = bytes * 8;
+  int common, i;
+  u_char *a, *b;
+
+  memset (p1, 0, sizeof (*p1));
+  memset (p2, 0, sizeof (*p2));
+  p1->family = p2->family = family;
+  p1->prefixlen = random () % (bits + 1);
+  p2->prefixlen = (random () % 4) ? p1->prefixlen : random () % (bits + 1);
+
+  a = (u_char *) &p1->u.prefix;
+  b = (u_char *) &p2->u.prefix;
+  for (i = 0; i < bytes; i++)
+    a[i] = b[i] = random ();
+  common = random () % (bits + 1);
+  if (common < bits)
+    b[common / 8] ^= 0x80 >> (common % 8);
+  if (random () % 2)
+    for (i = common + 1; i < bits; i++)
+      if (random () % 2)
+	b[i / 8] ^= 0x80 >> (i % 8);
+}
+
+static int
+verify (int family)
+{
+  struct prefix p1, p2;
+  union sockunion su1, su2;
+  char buf1[INET6_BUFSIZ], buf2[INET6_BUFSIZ];
+  unsigned int n;
+
+  for (n = 0; n < PREFIX_TEST_ROUNDS; n++)
+    {
+      prefix_pair (family, &p1, &p2);
+
+      if (prefix_match (&p1, &p2) != ref_prefix_match (&p1, &p2)
+	  || prefix_match_inline (&p1, &p2) != ref_prefix_match (&p1, &p2)
+	  || prefix_cmp (&p1, &p2) != ref_prefix_cmp (&p1, &p2)
+	  || prefix_same (&p1, &p2) != ref_prefix_same (&p1, &p2))
+	{
+	  prefix2str (&p1, buf1, sizeof (buf1));
+	  prefix2str (&p2, buf2, sizeof (buf2));
+	  printf ("verify: %s and %s: match %d/%d, cmp %d/%d, same %d/%d\n",
+		  buf1, buf2, prefix_match (&p1, &p2), ref_prefix_match (&p1, &p2),
+		  prefix_cmp (&p1, &p2), ref_prefix_cmp (&p1, &p2),
+		  prefix_same (&p1, &p2), ref_prefix_same (&p1, &p2));
+	  return 1;
+	}
+
+      p1.prefixlen = p2.prefixlen = (family == AF_INET) ? IPV4_MAX_BITLEN
+							: IPV6_MAX_BITLEN;
+      prefix2sockunion (&p1, &su1);
+      prefix2sockunion (&p2, &su2);
+      if (sockunion_same (&su1, &su2) != ref_prefix_same (&p1, &p2))
+	{
+	  prefix2str (&p1, buf1, sizeof (buf1));
+	  prefix2str (&p2, buf2, sizeof (buf2));
+	  printf ("verify: sockunion_same %s and %s\n", buf1, buf2);
+	  return 1;
+	}
+    }
+  return 0;
+}
+
+/* Time prefix_match, inline and as the function, and prefix_cmp against
+   the byte at a time references.  Run as "testprefix -b". */
+static int
+bench (void)
+{
+  /* Both functions are called, not inlined here. */
+  int (* volatile ref_match) (const struct prefix *, const struct prefix *)
+    = ref_prefix_match;
+  int (* volatile ref_cmp) (const struct prefix *, const struct prefix *)
+    = ref_prefix_cmp;
+  static const int families[] = { AF_INET, AF_INET6, 0 };
+  static struct prefix p1[256], p2[256];
+  unsigned int i, n, f;
+  volatile int sink = 0;
+  clock_t start;
+  double ref, lib, inl, cref, clib;
+
+  for (f = 0; families[f]; f++)
+    {
+      for (i = 0; i < 256; i++)
+	prefix_pair (families[f], &p1[i], &p2[i]);
+
+      start = clock ();
+      for (n = 0; n < PREFIX_BENCH_ROUNDS; n++)
+	sink += ref_match (&p1[n & 255], &p2[n & 255]);
+      ref = (double) (clock () - start) / CLOCKS_PER_SEC;
+
+      start = clock ();
+      for (n = 0; n < PREFIX_BENCH_ROUNDS; n++)
+	sink += prefix_match (&p1[n & 255], &p2[n & 255]);
+      lib = (double) (clock () - start) / CLOCKS_PER_SEC;
+
+      start = clock ();
+      for (n = 0; n < PREFIX_BENCH_ROUNDS; n++)
+	sink += prefix_match_inline (&p1[n & 255], &p2[n & 255]);
+      inl = (double) (clock () - start) / CLOCKS_PER_SEC;
+
+      start = clock ();
+      for (n = 0; n < PREFIX_BENCH_ROUNDS; n++)
+	sink += ref_cmp (&p1[n & 255], &p2[n & 255]);
+      cref = (double) (clock () - start) / CLOCKS_PER_SEC;
+
+      start = clock ();
+      for (n = 0; n < PREFIX_BENCH_ROUNDS; n++)
+	sink += prefix_cmp (&p1[n & 255], &p2[n & 255]);
+      clib = (double) (clock () - start) / CLOCKS_PER_SEC;
+
+      printf ("%s prefix_match: reference %.3fs, lib %.3fs (%.1fx), "
+	      "inline %.3fs (%.1fx)\n",
+	      families[f] == AF_INET ? "IPv4" : "IPv6", ref,
+	      lib, lib > 0 ? ref / lib : 0, inl, inl > 0 ? ref / inl : 0);
+      printf ("%s prefix_cmp: reference %.3fs, lib %.3fs (%.1fx)\n",
+	      families[f] == AF_INET ? "IPv4" : "IPv6", cref,
+	      clib, clib > 0 ? cref / clib : 0);
+    }
+  return 0;
+}
+
+int
+main (int argc, char **argv)
+{
+  srandom (time (NULL));
+
+  if (argc > 1 && !strcmp (argv[1], "-b"))
+    return bench ();
+
+  if (verify (AF_INET))
+    exit (1);
+#ifdef HAVE_IPV6
+  if (verify (AF_INET6))
+    exit (1);
+#endif /* HAVE_IPV6 */
+  printf ("prefix compares: OK\n");
+  exit (0);
+}
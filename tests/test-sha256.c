@@ -0,0 +1,104 @@
+#include <zebra.h>
+
+#include "sha256.h"
+
+struct thread_master *master;
+
+struct test
+{
+  const char *desc;
+  const char *key;		/* NULL for a plain hash */
+  size_t keylen;
+  const char *data;
+  size_t datalen;
+  unsigned int repeat;
+  const char *digest;
+};
+
+static char key_0b[20], key_aa[131];
+
+static struct test tests[] =
+{
+  { "empty", NULL, 0, "", 0, 1,
+    "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855" },
+  { "abc", NULL, 0, "abc", 3, 1,
+    "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad" },
+  { "two blocks", NULL, 0,
+    "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq", 56, 1,
+    "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1" },
+  { "million a", NULL, 0, "aaaaaaaaaa", 10, 100000,
+    "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0" },
+  { "rfc4231 1", key_0b, sizeof (key_0b), "Hi There", 8, 1,
+    "b0344c61d8db38535ca8afceaf0bf12b881dc200c9833da726e9376c2e32cff7" },
+  { "rfc4231 2", "Jefe", 4, "what do ya want for nothing?", 28, 1,
+    "5bdcc146bf60754e6a042426089575c75a003f089d2739839dec58b964ec3843" },
+  { "rfc4231 6", key_aa, sizeof (key_aa),
+    "Test Using Larger Than Block-Size Key - Hash Key First", 54, 1,
+    "60e431591ee0b67f0d8a26aacbf5b77f8e0bc6213728c5140546040f0ee37f54" },
+  { NULL },
+};
+
+static void
+hex (char *out, const uint8_t *digest)
+{
+  int i;
+
+  for (i = 0; i < SHA256_DIGEST_SIZE; i++)
+    sprintf (out + i * 2, "%02x", digest[i]);
+}
+
+int
+main (int argc, char **argv)
+{
+  struct test *t;
+  SHA256_CTX ctx;
+  HMAC_SHA256_CTX key, hctx;
+  uint8_t digest[SHA256_DIGEST_SIZE];
+  char out[SHA256_DIGEST_SIZE * 2 + 1];
+  unsigned int i;
+  int failed = 0;
+
+  memset (key_0b, 0x0b, sizeof (key_0b));
+  memset (key_aa, 0xaa, sizeof (key_aa));
+
+  for (t = tests; t->desc; t++)
+    {
+      if (t->key)
+	{
+	  /* Key once, then hash from a copy, as ospfd does. */
+	  HMAC_SHA256_Init (&key, t->key, t->keylen);
+	  hctx = key;
+	  for (i = 0; i < t->repeat; i++)
+	    HMAC_SHA256_Update (&hctx, t->data, t->datalen);
+	  HMAC_SHA256_Final (digest, &hctx);
+	}
+      else
+	{
+	  SHA256_Init (&ctx);
+	  for (i = 0; i < t->repeat; i++)
+	    SHA256_Update (&ctx, t->data, t->datalen);
+	  SHA256_Final (digest, &ctx);
+	}
+
+      hex (out, digest);
+      if (strcmp (out, t->digest))
+	{
+	  printf ("%s: got %s, expected %s\n", t->desc, out, t->digest);
+	  failed++;
+	}
+    }
+
+  /* The same key must give the same digest a second time. */
+  hctx = key;
+  HMAC_SHA256_Update (&hctx, tests[6].data, tests[6].datalen);
+  HMAC_SHA256_Final (digest, &hctx);
+  hex (out, digest);
+  if (strcmp (out, tests[6].digest))
+    {
+      printf ("reused key: got %s\n", out);
+      failed++;
+    }
+
+  printf ("%s\n", failed ? "FAILED" : "OK");
+  return failed ? 1 : 0;
+}
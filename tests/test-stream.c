@@ -30,7 +30,7 @@ print_stream (struct stream *s)
 int
 main (void)
 {
-  struct stream *s;
+  struct stream *s, *c;
   
   s = stream_new (1024);
   
@@ -50,5 +50,13 @@ main (void)
   printf ("l: 0x%x\n", stream_getl (s));
   printf ("q: 0x%lx\n", stream_getq (s));
   
+  stream_set_getp (s, 0);
+  c = stream_clone (s);
+  stream_free (s);
+  
+  print_stream (c);
+  
+  stream_free (c);
+  
   return 0;
 }
@@ -42,6 +42,17 @@ struct vty *vty;
 /* VTY shell pager name. */
 char *vtysh_pager_name = NULL;
 
+/* Number of commands sent to a daemon ahead of their replies while
+   reading a configuration file. */
+#define VTYSH_PIPELINE_DEPTH 64
+
+/* Pipelined command awaiting its reply. */
+struct vtysh_pending
+{
+  unsigned int lineno;
+  char *line;
+};
+
 /* VTY shell client structure. */
 struct vtysh_client
 {
@@ -49,6 +60,13 @@ struct vtysh_client
   const char *name;
   int flag;
   const char *path;
+
+  /* Pipelined commands, oldest first, and how many NULs of the
+     current reply's end marker have been read. */
+  struct vtysh_pending pending[VTYSH_PIPELINE_DEPTH];
+  int pending_head;
+  int pending_count;
+  int numnulls;
 } vtysh_client[] =
 {
   { .fd = -1, .name = "zebra", .flag = VTYSH_ZEBRA, .path = ZEBRA_VTYSH_PATH},
@@ -64,6 +82,9 @@ struct vtysh_client
 
 /* We need direct access to ripd to implement vtysh_exit_ripd_only. */
 static struct vtysh_client *ripd_client = NULL;
+
+/* Number of pipelined commands a daemon has rejected. */
+static unsigned int vtysh_pipeline_errors = 0;
  
 
 /* Using integrated config from Quagga.conf. Default is no. */
@@ -82,6 +103,147 @@ vclient_close (struct vtysh_client *vclient)
       close (vclient->fd);
       vclient->fd = -1;
     }
+
+  while (vclient->pending_count)
+    {
+      XFREE (MTYPE_TMP, vclient->pending[vclient->pending_head].line);
+      vclient->pending_head = (vclient->pending_head + 1)
+			      % VTYSH_PIPELINE_DEPTH;
+      vclient->pending_count--;
+    }
+  vclient->numnulls = 0;
+}
+
+/* The reply to the oldest pipelined command has ended with RET. */
+static void
+vtysh_client_reply (struct vtysh_client *vclient, int ret)
+{
+  struct vtysh_pending *pending;
+
+  pending = &vclient->pending[vclient->pending_head];
+  if (ret != CMD_SUCCESS)
+    {
+      fprintf (stdout, "%% %s: error on line %u: %s\n",
+	       vclient->name, pending->lineno, pending->line);
+      vtysh_pipeline_errors++;
+    }
+  XFREE (MTYPE_TMP, pending->line);
+
+  vclient->pending_head = (vclient->pending_head + 1) % VTYSH_PIPELINE_DEPTH;
+  vclient->pending_count--;
+}
+
+/* Read what is available of the replies to pipelined commands.  Reply
+   text is copied to stdout; each reply ends with \0\0\0<ret code>
+   (see lib/vty.c::vtysh_read). */
+static void
+vtysh_client_read_replies (struct vtysh_client *vclient)
+{
+  char buf[4096];
+  int nbytes;
+  int start;
+  int i;
+
+  nbytes = read (vclient->fd, buf, sizeof (buf));
+  if (nbytes <= 0)
+    {
+      if (nbytes < 0 && (errno == EINTR || errno == EAGAIN))
+	return;
+      vclient_close (vclient);
+      return;
+    }
+
+  start = 0;
+  for (i = 0; i < nbytes; i++)
+    {
+      if (vclient->numnulls == 3)
+	{
+	  vclient->numnulls = 0;
+	  start = i + 1;
+	  if (vclient->pending_count)
+	    vtysh_client_reply (vclient, buf[i]);
+	}
+      else if (buf[i] == '\0')
+	{
+	  if (vclient->numnulls++ == 0)
+	    fwrite (buf + start, 1, i - start, stdout);
+	}
+      else if (vclient->numnulls)
+	{
+	  vclient->numnulls = 0;
+	  start = i;
+	}
+    }
+  if (vclient->numnulls == 0 && start < nbytes)
+    fwrite (buf + start, 1, nbytes - start, stdout);
+  fflush (stdout);
+}
+
+/* Read replies from every daemon with pipelined commands, as they
+   arrive, until VCLIENT has no more than MAX commands outstanding. */
+static void
+vtysh_client_wait (struct vtysh_client *vclient, int max)
+{
+  fd_set readfd;
+  int maxfd;
+  u_int i;
+
+  while (vclient->fd >= 0 && vclient->pending_count > max)
+    {
+      FD_ZERO (&readfd);
+      maxfd = -1;
+      for (i = 0; i < array_size(vtysh_client); i++)
+	if (vtysh_client[i].fd >= 0 && vtysh_client[i].pending_count)
+	  {
+	    FD_SET (vtysh_client[i].fd, &readfd);
+	    if (vtysh_client[i].fd > maxfd)
+	      maxfd = vtysh_client[i].fd;
+	  }
+
+      if (select (maxfd + 1, &readfd, NULL, NULL, NULL) < 0)
+	{
+	  if (errno == EINTR)
+	    continue;
+	  perror ("select");
+	  vclient_close (vclient);
+	  return;
+	}
+
+      for (i = 0; i < array_size(vtysh_client); i++)
+	if (vtysh_client[i].fd >= 0
+	    && FD_ISSET (vtysh_client[i].fd, &readfd))
+	  vtysh_client_read_replies (&vtysh_client[i]);
+    }
+}
+
+/* Send LINE from line LINENO of a configuration file without waiting
+   for its reply, once fewer than VTYSH_PIPELINE_DEPTH commands are
+   outstanding on VCLIENT. */
+static void
+vtysh_client_send (struct vtysh_client *vclient, const char *line,
+		   unsigned int lineno)
+{
+  struct vtysh_pending *pending;
+  size_t len;
+
+  vtysh_client_wait (vclient, VTYSH_PIPELINE_DEPTH - 1);
+  if (vclient->fd < 0)
+    return;
+
+  if (write (vclient->fd, line, strlen (line) + 1) <= 0)
+    {
+      vclient_close (vclient);
+      return;
+    }
+
+  pending = &vclient->pending[(vclient->pending_head + vclient->pending_count)
+			      % VTYSH_PIPELINE_DEPTH];
+  pending->lineno = lineno;
+  pending->line = XSTRDUP (MTYPE_TMP, line);
+  len = strlen (pending->line);
+  if (len && pending->line[len - 1] == '\n')
+    pending->line[len - 1] = '\0';
+  vclient->pending_count++;
 }
 
 /* Following filled with debug code to trace a problematic condition
@@ -103,6 +265,9 @@ vtysh_client_config (struct vtysh_client *vclient, char *line)
   if (vclient->fd < 0)
     return CMD_SUCCESS;
 
+  /* Replies to pipelined commands come first. */
+  vtysh_client_wait (vclient, 0);
+
   ret = write (vclient->fd, line, strlen (line) + 1);
   if (ret <= 0)
     {
@@ -197,6 +362,9 @@ vtysh_client_execute (struct vtysh_client *vclient, const char *line, FILE *fp)
   if (vclient->fd < 0)
     return CMD_SUCCESS;
 
+  /* Replies to pipelined commands come first. */
+  vtysh_client_wait (vclient, 0);
+
   ret = write (vclient->fd, line, strlen (line) + 1);
   if (ret <= 0)
     {
@@ -458,9 +626,14 @@ vtysh_config_from_file (struct vty *vty, FILE *fp)
   int ret;
   vector vline;
   struct cmd_element *cmd;
+  unsigned int lineno = 0;
+  unsigned int errors;
+  u_int i;
 
   while (fgets (vty->buf, VTY_BUFSIZ, fp))
     {
+      lineno++;
+
       if (vty->buf[0] == '!' || vty->buf[1] == '#')
 	continue;
 
@@ -520,28 +693,42 @@ vtysh_config_from_file (struct vty *vty, FILE *fp)
 	  fprintf (stdout,"%% Command incomplete.\n");
 	  break;
 	case CMD_SUCCESS_DAEMON:
-	  {
-	    u_int i;
-	    int cmd_stat = CMD_SUCCESS;
+	  /* Plain lines are sent without waiting, their replies are
+	     collected while later lines are sent and a daemon's error is
+	     reported with the line it came from. */
+	  if (! cmd->func)
+	    {
+	      for (i = 0; i < array_size(vtysh_client); i++)
+		if (cmd->daemon & vtysh_client[i].flag)
+		  vtysh_client_send (&vtysh_client[i], vty->buf, lineno);
+	      break;
+	    }
 
-	    for (i = 0; i < array_size(vtysh_client); i++)
+	  /* A line that also changes vtysh's node must have been accepted
+	     by every daemon first, so drain the pipeline and wait for its
+	     replies. */
+	  for (i = 0; i < array_size(vtysh_client); i++)
+	    vtysh_client_wait (&vtysh_client[i], 0);
+
+	  errors = vtysh_pipeline_errors;
+	  for (i = 0; i < array_size(vtysh_client); i++)
+	    if (cmd->daemon & vtysh_client[i].flag)
 	      {
-	        if (cmd->daemon & vtysh_client[i].flag)
-		  {
-		    cmd_stat = vtysh_client_execute (&vtysh_client[i],
-						     vty->buf, stdout);
-		    if (cmd_stat != CMD_SUCCESS)
-		      break;
-		  }
+		vtysh_client_send (&vtysh_client[i], vty->buf, lineno);
+		vtysh_client_wait (&vtysh_client[i], 0);
+		if (vtysh_pipeline_errors != errors)
+		  break;
 	      }
-	    if (cmd_stat != CMD_SUCCESS)
-	      break;
+	  if (vtysh_pipeline_errors != errors)
+	    break;
 
-	    if (cmd->func)
-	      (*cmd->func) (cmd, vty, 0, NULL);
-	  }
+	  (*cmd->func) (cmd, vty, 0, NULL);
 	}
     }
+
+  for (i = 0; i < array_size(vtysh_client); i++)
+    vtysh_client_wait (&vtysh_client[i], 0);
+
   return CMD_SUCCESS;
 }
 
@@ -1627,6 +1814,52 @@ DEFUNSH (VTYSH_ALL,
   return CMD_SUCCESS;
 }
 
+DEFUNSH (VTYSH_ALL,
+	 vtysh_log_async,
+	 vtysh_log_async_cmd,
+	 "log async [<64-65536>]",
+	 "Logging control\n"
+	 "Leave writing the log file to a separate thread\n"
+	 "Size of the buffer for messages not written yet, in kbytes\n")
+{
+  return CMD_SUCCESS;
+}
+
+DEFUNSH (VTYSH_ALL,
+	 no_vtysh_log_async,
+	 no_vtysh_log_async_cmd,
+	 "no log async [<64-65536>]",
+	 NO_STR
+	 "Logging control\n"
+	 "Write the log file from the daemon itself\n"
+	 "Size of the buffer for messages not written yet, in kbytes\n")
+{
+  return CMD_SUCCESS;
+}
+
+DEFUNSH (VTYSH_ALL,
+	 vtysh_thread_lag_warning,
+	 vtysh_thread_lag_warning_cmd,
+	 "thread lag-warning <1-600000>",
+	 "Thread configuration\n"
+	 "Log timers dispatched late, with the task that held them up\n"
+	 "Lateness in milliseconds\n")
+{
+  return CMD_SUCCESS;
+}
+
+DEFUNSH (VTYSH_ALL,
+	 no_vtysh_thread_lag_warning,
+	 no_vtysh_thread_lag_warning_cmd,
+	 "no thread lag-warning [<1-600000>]",
+	 NO_STR
+	 "Thread configuration\n"
+	 "Log timers dispatched late, with the task that held them up\n"
+	 "Lateness in milliseconds\n")
+{
+  return CMD_SUCCESS;
+}
+
 DEFUNSH (VTYSH_ALL,
 	 vtysh_service_password_encrypt,
 	 vtysh_service_password_encrypt_cmd,
@@ -1876,6 +2109,73 @@ ALIAS (vtysh_write_terminal,
        SHOW_STR
        "Current operating configuration\n")
 
+/* Print to FP the commands that turn the running configuration into
+   the one in FILENAME. */
+static int
+vtysh_config_diff_file (struct vty *vty, const char *filename, FILE *fp)
+{
+  u_int i;
+  char line[] = "write terminal\n";
+  FILE *confp;
+
+  confp = fopen (filename, "r");
+  if (confp == NULL)
+    {
+      vty_out (vty, "%% Can't open configuration file %s: %s%s",
+	       filename, safe_strerror (errno), VTY_NEWLINE);
+      return CMD_WARNING;
+    }
+
+  for (i = 0; i < array_size(vtysh_client); i++)
+    vtysh_client_config (&vtysh_client[i], line);
+  vtysh_config_write ();
+
+  vtysh_config_diff (confp, fp);
+  fclose (confp);
+  return CMD_SUCCESS;
+}
+
+DEFUN (vtysh_show_configuration_diff,
+       vtysh_show_configuration_diff_cmd,
+       "show configuration diff FILENAME",
+       SHOW_STR
+       "Configuration\n"
+       "Commands that turn the running configuration into a file's\n"
+       "Configuration file name\n")
+{
+  return vtysh_config_diff_file (vty, argv[0], stdout);
+}
+
+DEFUN (vtysh_configure_replace,
+       vtysh_configure_replace_cmd,
+       "configure replace FILENAME",
+       "Configuration from vty interface\n"
+       "Replace the running configuration, sending only what changed\n"
+       "Configuration file name\n")
+{
+  int ret;
+  FILE *fp;
+
+  fp = tmpfile ();
+  if (fp == NULL)
+    {
+      vty_out (vty, "%% Can't create temporary file: %s%s",
+	       safe_strerror (errno), VTY_NEWLINE);
+      return CMD_WARNING;
+    }
+
+  ret = vtysh_config_diff_file (vty, argv[0], fp);
+  if (ret == CMD_SUCCESS)
+    {
+      rewind (fp);
+      vtysh_execute_no_pager ("configure terminal");
+      vtysh_config_from_file (vty, fp);
+      vtysh_execute_no_pager ("end");
+    }
+  fclose (fp);
+  return ret;
+}
+
 DEFUN (vtysh_terminal_length,
        vtysh_terminal_length_cmd,
        "terminal length <0-512>",
@@ -2403,6 +2703,8 @@ vtysh_init_vty (void)
 
   /* "write terminal" command. */
   install_element (ENABLE_NODE, &vtysh_write_terminal_cmd);
+  install_element (ENABLE_NODE, &vtysh_show_configuration_diff_cmd);
+  install_element (ENABLE_NODE, &vtysh_configure_replace_cmd);
  
   install_element (CONFIG_NODE, &vtysh_integrated_config_cmd);
   install_element (CONFIG_NODE, &no_vtysh_integrated_config_cmd);
@@ -2470,6 +2772,10 @@ vtysh_init_vty (void)
   install_element (CONFIG_NODE, &no_vtysh_log_record_priority_cmd);
   install_element (CONFIG_NODE, &vtysh_log_timestamp_precision_cmd);
   install_element (CONFIG_NODE, &no_vtysh_log_timestamp_precision_cmd);
+  install_element (CONFIG_NODE, &vtysh_log_async_cmd);
+  install_element (CONFIG_NODE, &no_vtysh_log_async_cmd);
+  install_element (CONFIG_NODE, &vtysh_thread_lag_warning_cmd);
+  install_element (CONFIG_NODE, &no_vtysh_thread_lag_warning_cmd);
 
   install_element (CONFIG_NODE, &vtysh_service_password_encrypt_cmd);
   install_element (CONFIG_NODE, &no_vtysh_service_password_encrypt_cmd);
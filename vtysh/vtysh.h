@@ -58,6 +58,8 @@ void vtysh_config_parse (char *);
 
 void vtysh_config_dump (FILE *);
 
+void vtysh_config_diff (FILE *, FILE *);
+
 void vtysh_config_init (void);
 
 void vtysh_pager_init (void);
@@ -23,6 +23,7 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #include "command.h"
 #include "linklist.h"
 #include "memory.h"
+#include "hash.h"
 
 #include "vtysh/vtysh.h"
 
@@ -47,6 +48,9 @@ struct config
 
 struct list *config_top;
 
+/* Node the following indented lines belong to, while parsing. */
+static struct config *config_current = NULL;
+
 int
 line_cmp (char *c1, char *c2)
 {
@@ -82,15 +86,32 @@ config_del (struct config* config)
   XFREE (MTYPE_VTYSH_CONFIG, config);
 }
 
+/* Every struct config of configvec, by index and name. */
+static struct hash *config_hash = NULL;
+
+static unsigned int
+config_hash_key (void *arg)
+{
+  const struct config *config = arg;
+
+  return string_hash_make (config->name) ^ config->index;
+}
+
+static int
+config_hash_cmp (const void *arg1, const void *arg2)
+{
+  const struct config *c1 = arg1;
+  const struct config *c2 = arg2;
+
+  return c1->index == c2->index && strcmp (c1->name, c2->name) == 0;
+}
+
 struct config *
 config_get (int index, const char *line)
 {
   struct config *config;
-  struct config *config_loop;
+  struct config key;
   struct list *master;
-  struct listnode *node, *nnode;
-
-  config = config_loop = NULL;
 
   master = vector_lookup_ensure (configvec, index);
 
@@ -102,21 +123,22 @@ config_get (int index, const char *line)
       vector_set_index (configvec, index, master);
     }
   
-  for (ALL_LIST_ELEMENTS (master, node, nnode, config_loop))
-    {
-      if (strcmp (config_loop->name, line) == 0)
-	config = config_loop;
-    }
+  key.index = index;
+  key.name = XSTRDUP (MTYPE_VTYSH_CONFIG_LINE, line);
+  config = hash_lookup (config_hash, &key);
 
-  if (! config)
+  if (config)
+    XFREE (MTYPE_VTYSH_CONFIG_LINE, key.name);
+  else
     {
       config = config_new ();
       config->line = list_new ();
       config->line->del = (void (*) (void *))line_del;
       config->line->cmp = (int (*)(void *, void *)) line_cmp;
-      config->name = XSTRDUP (MTYPE_VTYSH_CONFIG_LINE, line);
+      config->name = key.name;
       config->index = index;
       listnode_add (master, config);
+      hash_get (config_hash, config, hash_alloc_intern);
     }
   return config;
 }
@@ -145,7 +167,7 @@ void
 vtysh_config_parse_line (const char *line)
 {
   char c;
-  static struct config *config = NULL;
+  struct config *config = config_current;
 
   if (! line)
     return;
@@ -252,6 +274,7 @@ vtysh_config_parse_line (const char *line)
 	{
 	  if (strncmp (line, "log", strlen ("log")) == 0
 	      || strncmp (line, "hostname", strlen ("hostname")) == 0
+	      || strncmp (line, "thread", strlen ("thread")) == 0
 	     )
 	    config_add_line_uniq (config_top, line);
 	  else
@@ -260,6 +283,8 @@ vtysh_config_parse_line (const char *line)
 	}
       break;
     }
+
+  config_current = config;
 }
 
 void
@@ -339,6 +364,7 @@ vtysh_config_dump (FILE *fp)
 	  }
       }
 
+  hash_clean (config_hash, NULL);
   for (i = 0; i < vector_active (configvec); i++)
     if ((master = vector_slot (configvec, i)) != NULL)
       {
@@ -348,6 +374,355 @@ vtysh_config_dump (FILE *fp)
   list_delete_all_node (config_top);
 }
 
+/* Configuration difference.  The file is parsed by the same rules as
+ * the daemons' "write terminal" output, then compared with it line by
+ * line inside each node, so only commands that changed are sent. */
+
+static unsigned int
+config_diff_line_key (void *arg)
+{
+  return string_hash_make (arg);
+}
+
+static int
+config_diff_line_cmp (const void *arg1, const void *arg2)
+{
+  return strcmp (arg1, arg2) == 0;
+}
+
+static unsigned int
+config_diff_node_key (void *arg)
+{
+  const struct config *config = arg;
+
+  return string_hash_make (config->name);
+}
+
+static int
+config_diff_node_cmp (const void *arg1, const void *arg2)
+{
+  const struct config *c1 = arg1;
+  const struct config *c2 = arg2;
+
+  return strcmp (c1->name, c2->name) == 0;
+}
+
+static void
+config_diff_key_free (void *arg)
+{
+  XFREE (MTYPE_TMP, arg);
+}
+
+/* Set of the entries of LIST, strings or nodes. */
+static struct hash *
+config_diff_hash (struct list *list, int nodes)
+{
+  struct hash *hash;
+  struct listnode *node;
+  void *data;
+
+  if (nodes)
+    hash = hash_create (config_diff_node_key, config_diff_node_cmp);
+  else
+    hash = hash_create (config_diff_line_key, config_diff_line_cmp);
+
+  if (list)
+    for (node = listhead (list); node; node = listnextnode (node))
+      if ((data = listgetdata (node)) != NULL)
+	hash_get (hash, data, hash_alloc_intern);
+  return hash;
+}
+
+/* Lines that end a node rather than configure anything. */
+static int
+config_diff_skip (const char *line)
+{
+  while (*line == ' ')
+    line++;
+  return (strcmp (line, "end") == 0
+	  || strcmp (line, "exit") == 0
+	  || strcmp (line, "exit-address-family") == 0);
+}
+
+/* Length of the part of LINE that a changed value replaces in place,
+ * or 0.  Negating "neighbor A remote-as N" deletes the peer with all
+ * of its other settings, so a changed AS is only re-set. */
+static size_t
+config_diff_replace_len (const char *line)
+{
+  const char *pnt;
+
+  pnt = line;
+  while (*pnt == ' ')
+    pnt++;
+  if (strncmp (pnt, "neighbor ", strlen ("neighbor ")) != 0)
+    return 0;
+  if ((pnt = strstr (pnt, " remote-as ")) == NULL)
+    return 0;
+  return pnt - line + strlen (" remote-as ");
+}
+
+static char *
+config_diff_replace_key (const char *line)
+{
+  size_t len;
+  char *key;
+
+  if ((len = config_diff_replace_len (line)) == 0)
+    return NULL;
+  key = XMALLOC (MTYPE_TMP, len + 1);
+  memcpy (key, line, len);
+  key[len] = '\0';
+  return key;
+}
+
+/* Write to BUF the command that undoes LINE, keeping its indentation. */
+static void
+config_diff_negate (char *buf, size_t size, const char *line)
+{
+  const char *pnt;
+
+  pnt = line;
+  while (*pnt == ' ')
+    pnt++;
+  if (strncmp (pnt, "no ", 3) == 0)
+    snprintf (buf, size, "%.*s%s", (int) (pnt - line), line, pnt + 3);
+  else
+    snprintf (buf, size, "%.*sno %s", (int) (pnt - line), line, pnt);
+}
+
+/* Print the headers that enter the node, once. */
+static void
+config_diff_enter (FILE *fp, int *entered, const char *parent,
+		   const char *name)
+{
+  if (*entered)
+    return;
+  if (parent)
+    fprintf (fp, "%s\n", parent);
+  if (name)
+    fprintf (fp, "%s\n", name);
+  *entered = 1;
+}
+
+/* Print what turns the lines OLD of a node into NEW: removed lines are
+ * negated, last first so that settings go before what they depend on,
+ * then added lines follow in their order. */
+static void
+config_diff_lines (FILE *fp, struct list *old, struct list *new,
+		   const char *parent, const char *name)
+{
+  struct hash *old_hash;
+  struct hash *new_hash;
+  struct hash *replaced;
+  struct listnode *node;
+  char *line;
+  char *key;
+  char buf[VTY_BUFSIZ];
+  int entered = 0;
+
+  old_hash = config_diff_hash (old, 0);
+  new_hash = config_diff_hash (new, 0);
+
+  replaced = hash_create (config_diff_line_key, config_diff_line_cmp);
+  if (new)
+    for (ALL_LIST_ELEMENTS_RO (new, node, line))
+      if (! hash_lookup (old_hash, line)
+	  && (key = config_diff_replace_key (line)) != NULL)
+	{
+	  if (hash_get (replaced, key, hash_alloc_intern) != key)
+	    XFREE (MTYPE_TMP, key);
+	}
+
+  if (old)
+    for (node = listtail (old); node; node = node->prev)
+      {
+	line = listgetdata (node);
+	if (hash_lookup (new_hash, line) || config_diff_skip (line))
+	  continue;
+	if ((key = config_diff_replace_key (line)) != NULL)
+	  {
+	    int found = (hash_lookup (replaced, key) != NULL);
+
+	    XFREE (MTYPE_TMP, key);
+	    if (found)
+	      continue;
+	  }
+	/* "no X" is undone by X, which may be added anyway. */
+	config_diff_negate (buf, sizeof (buf), line);
+	if (hash_lookup (new_hash, buf))
+	  continue;
+	config_diff_enter (fp, &entered, parent, name);
+	fprintf (fp, "%s\n", buf);
+      }
+
+  if (new)
+    for (ALL_LIST_ELEMENTS_RO (new, node, line))
+      if (! hash_lookup (old_hash, line) && ! config_diff_skip (line))
+	{
+	  config_diff_enter (fp, &entered, parent, name);
+	  fprintf (fp, "%s\n", line);
+	}
+
+  hash_clean (replaced, config_diff_key_free);
+  hash_free (replaced);
+  hash_clean (old_hash, NULL);
+  hash_free (old_hash);
+  hash_clean (new_hash, NULL);
+  hash_free (new_hash);
+}
+
+#define ADDRESS_FAMILY_NODE(I) \
+  ((I) == BGP_VPNV4_NODE || (I) == BGP_IPV4_NODE || (I) == BGP_IPV4M_NODE \
+   || (I) == BGP_IPV6_NODE || (I) == BGP_IPV6M_NODE)
+
+/* Print what turns the nodes OLD of one kind into NEW.  Address family
+ * nodes are entered from PARENT, their "router bgp" line. */
+static void
+config_diff_nodes (FILE *fp, u_int index, struct list *old,
+		   struct list *new, const char *parent)
+{
+  struct hash *old_hash;
+  struct hash *new_hash;
+  struct listnode *node;
+  struct config *config;
+  struct config *match;
+  char buf[VTY_BUFSIZ];
+
+  if (! ADDRESS_FAMILY_NODE (index))
+    parent = NULL;
+
+  old_hash = config_diff_hash (old, 1);
+  new_hash = config_diff_hash (new, 1);
+
+  if (old)
+    for (node = listtail (old); node; node = node->prev)
+      {
+	config = listgetdata (node);
+	if (hash_lookup (new_hash, config))
+	  continue;
+	if (parent)
+	  config_diff_lines (fp, config->line, NULL, parent, config->name);
+	else
+	  {
+	    config_diff_negate (buf, sizeof (buf), config->name);
+	    fprintf (fp, "%s\n", buf);
+	  }
+      }
+
+  if (new)
+    for (ALL_LIST_ELEMENTS_RO (new, node, config))
+      {
+	match = hash_lookup (old_hash, config);
+	if (match)
+	  config_diff_lines (fp, match->line, config->line, parent,
+			     config->name);
+	else
+	  {
+	    struct listnode *lnode;
+	    char *line;
+
+	    if (parent)
+	      fprintf (fp, "%s\n", parent);
+	    fprintf (fp, "%s\n", config->name);
+	    for (ALL_LIST_ELEMENTS_RO (config->line, lnode, line))
+	      fprintf (fp, "%s\n", line);
+	  }
+      }
+
+  hash_clean (old_hash, NULL);
+  hash_free (old_hash);
+  hash_clean (new_hash, NULL);
+  hash_free (new_hash);
+}
+
+static void
+config_free_all (struct list *top, vector vec)
+{
+  struct list *master;
+  unsigned int i;
+
+  for (i = 0; i < vector_active (vec); i++)
+    if ((master = vector_slot (vec, i)) != NULL)
+      list_delete (master);
+  vector_free (vec);
+  list_delete (top);
+}
+
+static struct list *
+config_node_list (vector vec, u_int index)
+{
+  return index < vector_active (vec) ? vector_slot (vec, index) : NULL;
+}
+
+/* The "router bgp" line of the configuration in VEC, if any. */
+static const char *
+config_bgp_name (vector vec)
+{
+  struct list *master;
+
+  master = config_node_list (vec, BGP_NODE);
+  if (master == NULL || listhead (master) == NULL)
+    return NULL;
+  return ((struct config *) listgetdata (listhead (master)))->name;
+}
+
+/* Print to FP the commands that turn the configuration collected from
+ * the daemons (as for vtysh_config_dump) into the one in CONFP.  The
+ * collected configuration is consumed. */
+void
+vtysh_config_diff (FILE *confp, FILE *fp)
+{
+  struct list *running_top;
+  vector running_vec;
+  const char *bgp;
+  const char *running_bgp;
+  char buf[VTY_BUFSIZ];
+  char *pnt;
+  u_int active;
+  u_int i;
+
+  running_top = config_top;
+  running_vec = configvec;
+
+  vtysh_config_init ();
+  config_current = NULL;
+  while (fgets (buf, sizeof (buf), confp))
+    {
+      if ((pnt = strpbrk (buf, "\r\n")) != NULL)
+	*pnt = '\0';
+      vtysh_config_parse_line (buf);
+    }
+  config_current = NULL;
+
+  config_diff_lines (fp, running_top, config_top, NULL, NULL);
+
+  /* Address family nodes are entered from the BGP instance.  When the
+     instance goes away or is replaced, so does what was under it. */
+  bgp = config_bgp_name (configvec);
+  running_bgp = config_bgp_name (running_vec);
+  if (running_bgp && bgp && strcmp (running_bgp, bgp) != 0)
+    running_bgp = NULL;
+
+  active = vector_active (running_vec);
+  if (vector_active (configvec) > active)
+    active = vector_active (configvec);
+  for (i = 0; i < active; i++)
+    {
+      if (ADDRESS_FAMILY_NODE (i) && bgp == NULL)
+	continue;
+      config_diff_nodes (fp, i,
+			 ADDRESS_FAMILY_NODE (i) && running_bgp == NULL
+			 ? NULL : config_node_list (running_vec, i),
+			 config_node_list (configvec, i), bgp);
+    }
+  fflush (fp);
+
+  config_free_all (running_top, running_vec);
+  config_free_all (config_top, configvec);
+  vtysh_config_init ();
+}
+
 /* Read up configuration file from file_name. */
 static void
 vtysh_read_file (FILE *confp)
@@ -430,4 +805,8 @@ vtysh_config_init ()
   config_top = list_new ();
   config_top->del = (void (*) (void *))line_del;
   configvec = vector_init (1);
+  if (config_hash)
+    hash_clean (config_hash, NULL);
+  else
+    config_hash = hash_create (config_hash_key, config_hash_cmp);
 }
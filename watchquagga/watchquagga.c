@@ -40,6 +40,7 @@
 #define DEFAULT_PERIOD		5
 #define DEFAULT_TIMEOUT		10
 #define DEFAULT_RESTART_TIMEOUT	20
+#define DEFAULT_BUSY_TIMEOUT	300
 #define DEFAULT_LOGLEVEL	LOG_INFO
 #define DEFAULT_MIN_RESTART	60
 #define DEFAULT_MAX_RESTART	600
@@ -118,6 +119,7 @@ static struct global_state
   long period;
   long timeout;
   long restart_timeout;
+  long busy_timeout;
   long min_restart_interval;
   long max_restart_interval;
   int do_ping;
@@ -139,6 +141,7 @@ static struct global_state
   .period = 1000*DEFAULT_PERIOD,
   .timeout = DEFAULT_TIMEOUT,
   .restart_timeout = DEFAULT_RESTART_TIMEOUT,
+  .busy_timeout = DEFAULT_BUSY_TIMEOUT,
   .loglevel = DEFAULT_LOGLEVEL,
   .min_restart_interval = DEFAULT_MIN_RESTART,
   .max_restart_interval = DEFAULT_MAX_RESTART,
@@ -171,6 +174,8 @@ struct daemon {
   daemon_state_t state;
   int fd;
   struct timeval echo_sent;
+  u_int64_t heartbeat;		/* event loop count when last checked */
+  int heartbeat_valid;
   u_int connect_tries;
   struct thread *t_wakeup;
   struct thread *t_read;
@@ -188,6 +193,7 @@ static const struct option longopts[] =
   { "interval", required_argument, NULL, 'i'},
   { "timeout", required_argument, NULL, 't'},
   { "restart-timeout", required_argument, NULL, 'T'},
+  { "busy-timeout", required_argument, NULL, 'B'},
   { "restart", required_argument, NULL, 'r'},
   { "start-command", required_argument, NULL, 's'},
   { "kill-command", required_argument, NULL, 'k'},
@@ -283,6 +289,10 @@ Options:\n\
 		Set the restart (kill) timeout in seconds (default is %d).\n\
 		If any background jobs are still running after this much\n\
 		time has elapsed, they will be killed.\n\
+-B, --busy-timeout\n\
+		While a daemon's event loop heartbeat keeps advancing, wait\n\
+		up to this many seconds for an echo response before\n\
+		declaring it unresponsive (default is %d, 0 to disable).\n\
 -r, --restart	Supply a Bourne shell command to use to restart a single\n\
 		daemon.  The command string should include '%%s' where the\n\
 		name of the daemon should be substituted.\n\
@@ -323,7 +333,8 @@ Options:\n\
 progname,mode_str[3],progname,mode_str[4],progname,mode_str[2],mode_str[3],
 VTYDIR,DEFAULT_LOGLEVEL,LOG_EMERG,LOG_DEBUG,LOG_DEBUG,
 DEFAULT_MIN_RESTART,DEFAULT_MAX_RESTART,
-DEFAULT_PERIOD,DEFAULT_TIMEOUT,DEFAULT_RESTART_TIMEOUT,DEFAULT_PIDFILE);
+DEFAULT_PERIOD,DEFAULT_TIMEOUT,DEFAULT_RESTART_TIMEOUT,DEFAULT_BUSY_TIMEOUT,
+DEFAULT_PIDFILE);
 
   return status;
 }
@@ -945,15 +956,57 @@ wakeup_unresponsive(struct thread *t_wakeup)
   return 0;
 }
 
+/* Read the event loop heartbeat the daemon publishes next to its vty
+   socket.  This never waits on the daemon itself. */
+static int
+heartbeat_read(struct daemon *dmn, u_int64_t *count)
+{
+  char path[MAXPATHLEN];
+  struct thread_heartbeat hb;
+  int fd;
+  ssize_t rc;
+
+  snprintf(path,sizeof(path),"%s/%s%s",
+	   gs.vtydir,dmn->name,THREAD_HEARTBEAT_SUFFIX);
+  if ((fd = open(path,O_RDONLY)) < 0)
+    return -1;
+  rc = pread(fd,&hb,sizeof(hb),0);
+  close(fd);
+  if ((rc != sizeof(hb)) || (hb.magic != THREAD_HEARTBEAT_MAGIC))
+    return -1;
+  *count = hb.count;
+  return 0;
+}
+
 static int
 wakeup_no_answer(struct thread *t_wakeup)
 {
   struct daemon *dmn = THREAD_ARG(t_wakeup);
+  u_int64_t count;
+  struct timeval delay;
 
   dmn->t_wakeup = NULL;
+
+  /* A daemon chewing through a big update answers late, but its event
+     loop keeps turning: give it more time, up to the busy timeout. */
+  time_elapsed(&delay,&dmn->echo_sent);
+  if (dmn->heartbeat_valid && (delay.tv_sec < gs.busy_timeout) &&
+      !heartbeat_read(dmn,&count) && (count != dmn->heartbeat))
+    {
+      if (gs.loglevel > LOG_DEBUG)
+	zlog_debug("%s: no response yet to ping sent %ld seconds ago, "
+		   "but event loop is running (%llu threads since)",
+		   dmn->name,(long)delay.tv_sec,
+		   (unsigned long long)(count-dmn->heartbeat));
+      dmn->heartbeat = count;
+      dmn->t_wakeup = thread_add_timer(master,wakeup_no_answer,dmn,
+				       gs.timeout);
+      return 0;
+    }
+
   dmn->state = DAEMON_UNRESPONSIVE;
   zlog_err("%s state -> unresponsive : no response yet to ping "
-	   "sent %ld seconds ago",dmn->name,gs.timeout);
+	   "sent %ld seconds ago",dmn->name,(long)delay.tv_sec);
   if (gs.unresponsive_restart)
     {
       SET_WAKEUP_UNRESPONSIVE(dmn);
@@ -981,6 +1034,8 @@ wakeup_send_echo(struct thread *t_wakeup)
   else
     {
       gettimeofday(&dmn->echo_sent,NULL);
+      dmn->heartbeat_valid = (gs.busy_timeout > 0) &&
+			     !heartbeat_read(dmn,&dmn->heartbeat);
       dmn->t_wakeup = thread_add_timer(master,wakeup_no_answer,dmn,gs.timeout);
     }
   return 0;
@@ -1055,7 +1110,7 @@ main(int argc, char **argv)
     progname = argv[0];
 
   gs.restart.name = "all";
-  while ((opt = getopt_long(argc, argv, "aAb:dek:l:m:M:i:p:r:R:S:s:t:T:zvh",
+  while ((opt = getopt_long(argc, argv, "aAb:B:dek:l:m:M:i:p:r:R:S:s:t:T:zvh",
 			    longopts, 0)) != EOF)
     {
       switch (opt)
@@ -1206,6 +1261,17 @@ main(int argc, char **argv)
 	      }
 	  }
 	  break;
+	case 'B':
+	  {
+	    char garbage[3];
+	    if ((sscanf(optarg,"%ld%1s",&gs.busy_timeout,garbage) != 1) ||
+	        (gs.busy_timeout < 0))
+	      {
+	        fprintf(stderr,"Invalid busy timeout argument: %s\n",optarg);
+		return usage(progname,1);
+	      }
+	  }
+	  break;
 	case 'T':
 	  {
 	    char garbage[3];
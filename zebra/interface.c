@@ -103,6 +103,10 @@ if_zebra_delete_hook (struct interface *ifp)
     {
       zebra_if = ifp->info;
 
+#ifdef RTADV
+      rtadv_if_delete (ifp);
+#endif /* RTADV */
+
       /* Free installed address chains tree. */
       if (zebra_if->ipv4_subnets)
 	route_table_finish (zebra_if->ipv4_subnets);
@@ -476,7 +480,7 @@ if_delete_update (struct interface *ifp)
 		  /* Remove from interface address list (unconditionally). */
 		  if (!CHECK_FLAG (ifc->conf, ZEBRA_IFC_CONFIGURED))
 		    {
-		      listnode_delete (ifp->connected, ifc);
+		      connected_delete (ifp, ifc);
 		      connected_free (ifc);
                     }
                   else
@@ -502,7 +506,7 @@ if_delete_update (struct interface *ifp)
 		last = node;
 	      else
 		{
-		  listnode_delete (ifp->connected, ifc);
+		  connected_delete (ifp, ifc);
 		  connected_free (ifc);
 		}
 	    }
@@ -520,7 +524,7 @@ if_delete_update (struct interface *ifp)
      while processing the deletion.  Each client daemon is responsible
      for setting ifindex to IFINDEX_INTERNAL after processing the
      interface deletion message. */
-  ifp->ifindex = IFINDEX_INTERNAL;
+  if_set_index (ifp, IFINDEX_INTERNAL);
 }
 
 /* Interface is up. */
@@ -922,7 +926,12 @@ DEFUN (show_interface, show_interface_cmd,
   struct listnode *node;
   struct interface *ifp;
   
-#ifdef HAVE_PROC_NET_DEV
+#if defined (HAVE_NETLINK) && defined (HAVE_PROC_NET_DEV)
+  /* Netlink has the statistics of just the interface asked for, see
+     below. */
+  if (argc == 0)
+    ifstat_update_netlink (NULL);
+#elif defined (HAVE_PROC_NET_DEV)
   /* If system has interface statistics via proc file system, update
      statistics. */
   ifstat_update_proc ();
@@ -941,6 +950,9 @@ DEFUN (show_interface, show_interface_cmd,
 		   VTY_NEWLINE);
 	  return CMD_WARNING;
 	}
+#if defined (HAVE_NETLINK) && defined (HAVE_PROC_NET_DEV)
+      ifstat_update_netlink (ifp);
+#endif /* HAVE_NETLINK && HAVE_PROC_NET_DEV */
       if_dump_vty (vty, ifp);
       return CMD_SUCCESS;
     }
@@ -1252,7 +1264,7 @@ ip_address_install (struct vty *vty, struct interface *ifp,
 	ifc->label = XSTRDUP (MTYPE_CONNECTED_LABEL, label);
 
       /* Add to linked list. */
-      listnode_add (ifp->connected, ifc);
+      connected_add (ifp, ifc);
     }
 
   /* This address is configured from zebra. */
@@ -1323,7 +1335,7 @@ ip_address_uninstall (struct vty *vty, struct interface *ifp,
   if (! CHECK_FLAG (ifc->conf, ZEBRA_IFC_QUEUED)
       || ! CHECK_FLAG (ifp->status, ZEBRA_INTERFACE_ACTIVE))
     {
-      listnode_delete (ifp->connected, ifc);
+      connected_delete (ifp, ifc);
       connected_free (ifc);
       return CMD_WARNING;
     }
@@ -1431,7 +1443,7 @@ ipv6_address_install (struct vty *vty, struct interface *ifp,
 	ifc->label = XSTRDUP (MTYPE_CONNECTED_LABEL, label);
 
       /* Add to linked list. */
-      listnode_add (ifp->connected, ifc);
+      connected_add (ifp, ifc);
     }
 
   /* This address is configured from zebra. */
@@ -1502,7 +1514,7 @@ ipv6_address_uninstall (struct vty *vty, struct interface *ifp,
   if (! CHECK_FLAG (ifc->conf, ZEBRA_IFC_QUEUED)
       || ! CHECK_FLAG (ifp->status, ZEBRA_INTERFACE_ACTIVE))
     {
-      listnode_delete (ifp->connected, ifc);
+      connected_delete (ifp, ifc);
       connected_free (ifc);
       return CMD_WARNING;
     }
@@ -23,6 +23,7 @@
 #define _ZEBRA_INTERFACE_H
 
 #include "redistribute.h"
+#include "wheel.h"
 
 #ifdef HAVE_IRDP
 #include "zebra/irdp.h"
@@ -71,8 +72,18 @@ struct rtadvconf
   int MinRtrAdvInterval; /* This field is currently unused. */
 #define RTADV_MIN_RTR_ADV_INTERVAL (0.33 * RTADV_MAX_RTR_ADV_INTERVAL)
 
-  /* Unsolicited Router Advertisements' interval timer. */
+  /* Unsolicited Router Advertisements' interval timer, for intervals
+     not of whole seconds; the others wait on t_adv. */
   int AdvIntervalTimer;
+  struct wheel_timer t_adv;
+
+  /* The Router Advertisement as last built, its length, 0 if it is to
+     be built again, and the offset and length of the link-layer address
+     in it. */
+  u_char *ra_packet;
+  int ra_len;
+  int ra_lladdr;
+  int ra_lladdr_len;
 
   /* The TRUE/FALSE value to be placed in the "Managed address
      configuration" flag field in the Router Advertisement.  See
@@ -224,6 +235,9 @@ extern int if_subnet_delete (struct interface *, struct connected *);
 
 #ifdef HAVE_PROC_NET_DEV
 extern void ifstat_update_proc (void);
+#ifdef HAVE_NETLINK
+extern void ifstat_update_netlink (struct interface *);
+#endif /* HAVE_NETLINK */
 #endif /* HAVE_PROC_NET_DEV */
 #ifdef HAVE_NET_RT_IFLIST
 extern void ifstat_update_sysctl (void);
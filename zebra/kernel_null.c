@@ -29,6 +29,15 @@ int kernel_delete_ipv6_old (struct prefix_ipv6 *dest, struct in6_addr *gate,
 int kernel_add_route (struct prefix_ipv4 *a, struct in_addr *b, int c, int d)
 { return 0; }
 
+int kernel_nexthop_add (u_int32_t a, int b, union g_addr *c, unsigned int d,
+                        int e)
+{ return -1; }
+
+int kernel_nexthop_group_add (u_int32_t a, u_int32_t *b, int c)
+{ return -1; }
+
+int kernel_nexthop_delete (u_int32_t a) { return -1; }
+
 int kernel_address_add_ipv4 (struct interface *a, struct connected *b)
 {
   zlog_debug ("%s", __func__);
@@ -297,7 +297,7 @@ ifan_read (struct if_announcemsghdr *ifan)
       ifp = if_get_by_name_len(ifan->ifan_name,
 			       strnlen(ifan->ifan_name,
 				       sizeof(ifan->ifan_name)));
-      ifp->ifindex = ifan->ifan_index;
+      if_set_index (ifp, ifan->ifan_index);
 
       if_add_update (ifp);
     }
@@ -461,7 +461,7 @@ ifm_read (struct if_msghdr *ifm)
        * Fill in newly created interface structure, or larval
        * structure with ifindex IFINDEX_INTERNAL.
        */
-      ifp->ifindex = ifm->ifm_index;
+      if_set_index (ifp, ifm->ifm_index);
       
 #ifdef HAVE_BSD_IFI_LINK_STATE /* translate BSD kernel msg for link-state */
       bsd_linkdetect_translate(ifm);
@@ -1150,86 +1150,27 @@ rtmsg_debug (struct rt_msghdr *rtm)
 #endif /* RTA_NUMBITS */
 #endif /* RTAX_MAX */
 
-/* Kernel routing table and interface updates via routing socket. */
-static int
-kernel_read (struct thread *thread)
-{
-  int sock;
-  int nbytes;
-  struct rt_msghdr *rtm;
+/* Routing socket messages are read into one buffer, big enough for
+   any message the kernel might send.  Rather than determining how many
+   sockaddrs of what size might be in each particular message, it has
+   RTAX_MAX of sockaddr_storage for many.  The socket hands over one
+   message per read, but the buffer is parsed for as many as it holds. */
+#define KERNEL_READ_BUFSIZ \
+  (16 * (sizeof (struct rt_msghdr) \
+	 + RTAX_MAX * sizeof (struct sockaddr_storage)))
 
-  /*
-   * This must be big enough for any message the kernel might send.
-   * Rather than determining how many sockaddrs of what size might be
-   * in each particular message, just use RTAX_MAX of sockaddr_storage
-   * for each.  Note that the sockaddrs must be after each message
-   * definition, or rather after whichever happens to be the largest,
-   * since the buffer needs to be big enough for a message and the
-   * sockaddrs together.
-   */
-  union 
-  {
-    /* Routing information. */
-    struct 
-    {
-      struct rt_msghdr rtm;
-      struct sockaddr_storage addr[RTAX_MAX];
-    } r;
-
-    /* Interface information. */
-    struct
-    {
-      struct if_msghdr ifm;
-      struct sockaddr_storage addr[RTAX_MAX];
-    } im;
+/* Messages handled in one go, before others get their turn. */
+#define KERNEL_READ_MAX 256
 
-    /* Interface address information. */
-    struct
-    {
-      struct ifa_msghdr ifa;
-      struct sockaddr_storage addr[RTAX_MAX];
-    } ia;
-
-#ifdef RTM_IFANNOUNCE
-    /* Interface arrival/departure */
-    struct
-    {
-      struct if_announcemsghdr ifan;
-      struct sockaddr_storage addr[RTAX_MAX];
-    } ian;
-#endif /* RTM_IFANNOUNCE */
-
-  } buf;
-
-  /* Fetch routing socket. */
-  sock = THREAD_FD (thread);
-
-  nbytes= read (sock, &buf, sizeof buf);
-
-  if (nbytes <= 0)
-    {
-      if (nbytes < 0 && errno != EWOULDBLOCK && errno != EAGAIN)
-	zlog_warn ("routing socket error: %s", safe_strerror (errno));
-      return 0;
-    }
-
-  thread_add_read (zebrad.master, kernel_read, NULL, sock);
+/* Socket receive buffer asked for, so bursts of route changes are not
+   dropped before they are read. */
+#define KERNEL_RCVBUF_SIZE (1024 * 1024)
 
+static void
+kernel_read_msg (struct rt_msghdr *rtm)
+{
   if (IS_ZEBRA_DEBUG_KERNEL)
-    rtmsg_debug (&buf.r.rtm);
-
-  rtm = &buf.r.rtm;
-
-  /*
-   * Ensure that we didn't drop any data, so that processing routines
-   * can assume they have the whole message.
-   */
-  if (rtm->rtm_msglen != nbytes)
-    {
-      zlog_warn ("kernel_read: rtm->rtm_msglen %d, nbytes %d, type %d\n",
-		 rtm->rtm_msglen, nbytes, rtm->rtm_type);
-      return -1;
-    }
+    rtmsg_debug (rtm);
 
   switch (rtm->rtm_type)
     {
@@ -1239,15 +1180,15 @@ kernel_read (struct thread *thread)
       rtm_read (rtm);
       break;
     case RTM_IFINFO:
-      ifm_read (&buf.im.ifm);
+      ifm_read ((struct if_msghdr *) rtm);
       break;
     case RTM_NEWADDR:
     case RTM_DELADDR:
-      ifam_read (&buf.ia.ifa);
+      ifam_read ((struct ifa_msghdr *) rtm);
       break;
 #ifdef RTM_IFANNOUNCE
     case RTM_IFANNOUNCE:
-      ifan_read (&buf.ian.ifan);
+      ifan_read ((struct if_announcemsghdr *) rtm);
       break;
 #endif /* RTM_IFANNOUNCE */
     default:
@@ -1255,6 +1196,71 @@ kernel_read (struct thread *thread)
         zlog_debug("Unprocessed RTM_type: %d", rtm->rtm_type);
       break;
     }
+}
+
+/* Kernel routing table and interface updates via routing socket. */
+static int
+kernel_read (struct thread *thread)
+{
+  static union
+  {
+    struct rt_msghdr rtm;
+    char buf[KERNEL_READ_BUFSIZ];
+  } *buf;
+  int sock;
+  int nbytes;
+  int count;
+  char *pnt;
+  struct rt_msghdr *rtm;
+
+  if (! buf)
+    buf = XMALLOC (MTYPE_TMP, sizeof (*buf));
+
+  /* Fetch routing socket. */
+  sock = THREAD_FD (thread);
+
+  for (count = 0; count < KERNEL_READ_MAX; )
+    {
+      nbytes = recv (sock, buf, sizeof (*buf), MSG_DONTWAIT);
+      if (nbytes <= 0)
+	{
+	  if (nbytes == 0 || errno == EWOULDBLOCK || errno == EAGAIN
+	      || errno == EINTR)
+	    break;
+
+	  /* ENOBUFS: the socket overran, and what was lost is not
+	     known.  Carry on with what comes next. */
+	  if (errno != ENOBUFS)
+	    {
+	      zlog_warn ("routing socket error: %s", safe_strerror (errno));
+	      break;
+	    }
+	  zlog_warn ("routing socket overrun, messages were lost");
+	  count++;
+	  continue;
+	}
+
+      /*
+       * Ensure that we didn't drop any data, so that processing routines
+       * can assume they have the whole message.
+       */
+      for (pnt = buf->buf; nbytes > 0; pnt += rtm->rtm_msglen)
+	{
+	  rtm = (struct rt_msghdr *) pnt;
+	  /* All messages start with length, version and type. */
+	  if (nbytes < 4 || rtm->rtm_msglen == 0 || rtm->rtm_msglen > nbytes)
+	    {
+	      zlog_warn ("kernel_read: rtm->rtm_msglen %d, nbytes %d, type %d\n",
+			 rtm->rtm_msglen, nbytes, rtm->rtm_type);
+	      break;
+	    }
+	  kernel_read_msg (rtm);
+	  nbytes -= rtm->rtm_msglen;
+	  count++;
+	}
+    }
+
+  thread_add_read (zebrad.master, kernel_read, NULL, sock);
   return 0;
 }
 
@@ -1262,6 +1268,8 @@ kernel_read (struct thread *thread)
 static void
 routing_socket (void)
 {
+  int size;
+
   if ( zserv_privs.change (ZPRIVS_RAISE) )
     zlog_err ("routing_socket: Can't raise privileges");
 
@@ -1281,6 +1289,13 @@ routing_socket (void)
    */
   /*if (fcntl (routing_sock, F_SETFL, O_NONBLOCK) < 0) 
     zlog_warn ("Can't set O_NONBLOCK to routing socket");*/
+
+  /* kernel_read receives without blocking all the same. */
+  size = KERNEL_RCVBUF_SIZE;
+  if (setsockopt (routing_sock, SOL_SOCKET, SO_RCVBUF, &size,
+		  sizeof (size)) < 0)
+    zlog_warn ("Can't set routing socket receive buffer to %d: %s",
+	       size, safe_strerror (errno));
     
   if ( zserv_privs.change (ZPRIVS_LOWER) )
     zlog_err ("routing_socket: Can't lower privileges");
@@ -62,14 +62,27 @@ int keep_kernel_mode = 0;
 #ifdef HAVE_NETLINK
 /* Receive buffer size for netlink socket */
 u_int32_t nl_rcvbufsize = 0;
+
+/* Routes per netlink batch, 0 to program them one at a time. */
+u_int32_t nl_batchsize = 0;
+
+/* Install BGP routes over kernel nexthop objects. */
+int nl_nexthops = 0;
 #endif /* HAVE_NETLINK */
 
+/* Worker threads for best-route selection. */
+extern unsigned int rib_worker_threads;
+
+/* Seconds to wait for clients before sweeping old self inserted routes. */
+extern unsigned int rib_sweep_delay;
+
 /* Command line options. */
 struct option longopts[] = 
 {
   { "batch",       no_argument,       NULL, 'b'},
   { "daemon",      no_argument,       NULL, 'd'},
   { "keep_kernel", no_argument,       NULL, 'k'},
+  { "sweep-delay", required_argument, NULL, 'S'},
   { "config_file", required_argument, NULL, 'f'},
   { "pid_file",    required_argument, NULL, 'i'},
   { "socket",      required_argument, NULL, 'z'},
@@ -78,8 +91,12 @@ struct option longopts[] =
   { "vty_port",    required_argument, NULL, 'P'},
   { "retain",      no_argument,       NULL, 'r'},
   { "dryrun",      no_argument,       NULL, 'C'},
+  { "rib-threads", required_argument, NULL, 't'},
+  { "fpm",         required_argument, NULL, 'F'},
 #ifdef HAVE_NETLINK
   { "nl-bufsize",  required_argument, NULL, 's'},
+  { "nl-batch",    required_argument, NULL, 'B'},
+  { "nl-nexthops", no_argument,       NULL, 'N'},
 #endif /* HAVE_NETLINK */
   { "user",        required_argument, NULL, 'u'},
   { "group",       required_argument, NULL, 'g'},
@@ -133,15 +150,21 @@ usage (char *progname, int status)
 	      "-z, --socket       Set path of zebra socket\n"\
 	      "-k, --keep_kernel  Don't delete old routes which installed by "\
 				  "zebra.\n"\
+	      "-S, --sweep-delay  Wait this many seconds before deleting them\n"\
 	      "-C, --dryrun       Check configuration for validity and exit\n"\
 	      "-A, --vty_addr     Set vty's bind address\n"\
 	      "-P, --vty_port     Set vty's port number\n"\
 	      "-r, --retain       When program terminates, retain added route "\
 				  "by zebra.\n"\
+	      "-t, --rib-threads  Select BGP routes on this many extra threads\n"\
+	      "-F, --fpm          Send the FIB to the FPM at this "\
+				  "address[:port][,compact]\n"\
 	      "-u, --user         User to run as\n"\
 	      "-g, --group	  Group to run as\n", progname);
 #ifdef HAVE_NETLINK
       printf ("-s, --nl-bufsize   Set netlink receive buffer size\n");
+      printf ("-B, --nl-batch     Send routes to the kernel in batches of this size\n");
+      printf ("-N, --nl-nexthops  Install routes over kernel nexthop objects\n");
 #endif /* HAVE_NETLINK */
       printf ("-v, --version      Print program version\n"\
 	      "-h, --help         Display this help and exit\n"\
@@ -233,9 +256,9 @@ main (int argc, char **argv)
       int opt;
   
 #ifdef HAVE_NETLINK  
-      opt = getopt_long (argc, argv, "bdkf:i:z:hA:P:ru:g:vs:C", longopts, 0);
+      opt = getopt_long (argc, argv, "bdkS:f:i:z:hA:P:ru:g:vs:B:NCt:F:", longopts, 0);
 #else
-      opt = getopt_long (argc, argv, "bdkf:i:z:hA:P:ru:g:vC", longopts, 0);
+      opt = getopt_long (argc, argv, "bdkS:f:i:z:hA:P:ru:g:vCt:F:", longopts, 0);
 #endif /* HAVE_NETLINK */
 
       if (opt == EOF)
@@ -253,6 +276,9 @@ main (int argc, char **argv)
 	case 'k':
 	  keep_kernel_mode = 1;
 	  break;
+	case 'S':
+	  rib_sweep_delay = atoi (optarg);
+	  break;
 	case 'C':
 	  dryrun = 1;
 	  break;
@@ -287,7 +313,28 @@ main (int argc, char **argv)
 	case 's':
 	  nl_rcvbufsize = atoi (optarg);
 	  break;
+	case 'B':
+	  nl_batchsize = atoi (optarg);
+	  if (nl_batchsize > 1024)
+	    nl_batchsize = 1024;
+	  break;
+	case 'N':
+	  nl_nexthops = 1;
+	  break;
 #endif /* HAVE_NETLINK */
+	case 'F':
+	  if (zfpm_add_client (optarg) < 0)
+	    {
+	      fprintf (stderr, "Invalid or too many FPM addresses: %s\n",
+		       optarg);
+	      usage (progname, 1);
+	    }
+	  break;
+	case 't':
+	  rib_worker_threads = atoi (optarg);
+	  if (rib_worker_threads > 64)
+	    rib_worker_threads = 64;
+	  break;
 	case 'u':
 	  zserv_privs.user = optarg;
 	  break;
@@ -4,6 +4,7 @@
 #include "zebra/rtadv.h"
 #include "zebra/irdp.h"
 #include "zebra/interface.h"
+#include "zebra/rib.h"
 #include "zebra/zebra_fpm.h"
 
 void ifstat_update_proc (void) { return; }
@@ -11,14 +12,23 @@ void ifstat_update_proc (void) { return; }
 #pragma weak rtadv_config_write = ifstat_update_proc
 #pragma weak irdp_config_write = ifstat_update_proc
 #pragma weak ifstat_update_sysctl = ifstat_update_proc
+#pragma weak ifstat_update_netlink = ifstat_update_proc
 #else
 void rtadv_config_write (struct vty *vty, struct interface *ifp) { return; }
 void irdp_config_write (struct vty *vty, struct interface *ifp) { return; }
 void ifstat_update_sysctl (void) { return; }
+void ifstat_update_netlink (struct interface *ifp) { return; }
 #endif
+void rtadv_if_delete (struct interface *ifp) { return; }
 
 void
 zfpm_trigger_update (struct route_node *rn, const char *reason)
 {
   return;
 }
+
+void
+zfpm_dest_release (rib_dest_t *dest)
+{
+  return;
+}
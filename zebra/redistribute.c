@@ -30,6 +30,9 @@
 #include "zclient.h"
 #include "linklist.h"
 #include "log.h"
+#include "memory.h"
+#include "thread.h"
+#include "buffer.h"
 
 #include "zebra/rib.h"
 #include "zebra/zserv.h"
@@ -137,35 +140,314 @@ zebra_redistribute_default (struct zserv *client)
 #endif /* HAVE_IPV6 */
 }
 
-/* Redistribute routes. */
+/* Redistribution to a client is queued by prefix and route type and
+   sent from a thread of its own, so a prefix that changes several times
+   meanwhile goes out once, as it is by then.  A withdrawal keeps what
+   the withdrawn route looked like.  The queue is held back while the
+   client is slow to read what it was sent already. */
+struct redist_pending
+{
+  struct redist_pending *next;
+  u_char type;
+  u_char add;			/* Announce the route of type selected then */
+  u_char del;			/* Withdraw, before any announcement */
+  u_char del_flags;
+  u_char del_nexthop;		/* del_nh is set */
+  struct nexthop del_nh;
+};
+
+static void
+redistribute_queue (struct zserv *client, struct prefix *p, struct rib *rib,
+		    int add)
+{
+  struct route_node *rn;
+  struct redist_pending *pend;
+  struct nexthop *nexthop;
+  afi_t afi;
+
+  afi = family2afi (p->family);
+  if (afi != AFI_IP && afi != AFI_IP6)
+    return;
+
+  if (! client->redist_pending[afi])
+    client->redist_pending[afi] = route_table_init ();
+  rn = route_node_get (client->redist_pending[afi], p);
+
+  for (pend = rn->info; pend; pend = pend->next)
+    if (pend->type == rib->type)
+      break;
+  if (pend)
+    route_unlock_node (rn);
+  else
+    {
+      pend = XCALLOC (MTYPE_REDIST_PENDING, sizeof (struct redist_pending));
+      pend->type = rib->type;
+      if (! rn->info)
+	client->redist_queued++;
+      else
+	route_unlock_node (rn);
+      pend->next = rn->info;
+      rn->info = pend;
+    }
+
+  if (add)
+    {
+      pend->add = 1;
+      redistribute_schedule (client);
+      return;
+    }
+
+  pend->add = 0;
+  pend->del = 1;
+  pend->del_flags = rib->flags;
+  pend->del_nexthop = 0;
+  for (nexthop = rib->nexthop; nexthop; nexthop = nexthop->next)
+    if (CHECK_FLAG (nexthop->flags, NEXTHOP_FLAG_FIB))
+      {
+	memset (&pend->del_nh, 0, sizeof (struct nexthop));
+	pend->del_nh.type = nexthop->type;
+	pend->del_nh.flags = NEXTHOP_FLAG_FIB;
+	pend->del_nh.gate = nexthop->gate;
+	pend->del_nh.ifindex = nexthop->ifindex;
+	pend->del_nexthop = 1;
+	break;
+      }
+  redistribute_schedule (client);
+}
+
+/* Redistribute routes: the routes of types newly asked for by the client
+   are sent by a walk over the RIB, paced like the queue. */
 static void
 zebra_redistribute (struct zserv *client, int type)
 {
-  struct rib *newrib;
+  client->redist_walk[type] = 1;
+
+  /* Types added during a walk need the nodes it passed, too. */
+  if (client->redist_walk_rn)
+    {
+      route_unlock_node (client->redist_walk_rn);
+      client->redist_walk_rn = NULL;
+    }
+  client->redist_walk_afi = AFI_IP;
+  redistribute_schedule (client);
+}
+
+static void
+redistribute_walk_node (struct zserv *client, struct route_node *rn,
+			afi_t afi)
+{
+  struct route_node *prn;
+  struct redist_pending *pend;
+  struct rib *rib;
+
+  if (! zebra_check_addr (&rn->p))
+    return;
+
+  RNODE_FOREACH_RIB (rn, rib)
+    if (CHECK_FLAG (rib->flags, ZEBRA_FLAG_SELECTED)
+	&& client->redist_walk[rib->type]
+	&& rib->distance != DISTANCE_INFINITY)
+      {
+	/* A withdrawal queued for the prefix has to go first. */
+	pend = NULL;
+	if (client->redist_queued
+	    && (prn = route_node_lookup (client->redist_pending[afi], &rn->p)))
+	  {
+	    for (pend = prn->info; pend; pend = pend->next)
+	      if (pend->type == rib->type)
+		{
+		  pend->add = 1;
+		  break;
+		}
+	    route_unlock_node (prn);
+	  }
+	if (! pend)
+	  zsend_route_multipath (afi == AFI_IP ? ZEBRA_IPV4_ROUTE_ADD
+						: ZEBRA_IPV6_ROUTE_ADD,
+				 client, &rn->p, rib);
+      }
+}
+
+/* Go on with the walk.  Returns 0 when it is done, 1 when it has to
+   wait for the client or for its next time slot. */
+static int
+redistribute_walk (struct zserv *client, struct thread *thread)
+{
+  struct route_table *table;
+  struct route_node *rn = client->redist_walk_rn;
+  unsigned long count = 0;
+
+  client->redist_walk_rn = NULL;
+  while (client->redist_walk_afi && client->redist_walk_afi < AFI_MAX)
+    {
+      if (! rn)
+	{
+	  table = vrf_table (client->redist_walk_afi, SAFI_UNICAST, 0);
+	  if (! table || ! (rn = route_top (table)))
+	    {
+	      client->redist_walk_afi++;
+	      continue;
+	    }
+	}
+
+      redistribute_walk_node (client, rn, client->redist_walk_afi);
+      if (! (rn = route_next (rn)))
+	{
+	  client->redist_walk_afi++;
+	  continue;
+	}
+
+      if (zserv_client_full (client)
+	  || ((++count & 0xff) == 0 && thread_should_yield (thread)))
+	{
+	  client->redist_walk_rn = rn;
+	  return 1;
+	}
+    }
+
+  memset (client->redist_walk, 0, sizeof (client->redist_walk));
+  client->redist_walk_afi = 0;
+  return 0;
+}
+
+/* Send what is queued for one prefix, and drop it from the queue. */
+static void
+redistribute_send (struct zserv *client, struct route_node *prn, afi_t afi)
+{
+  struct redist_pending *pend;
+  struct redist_pending *next;
   struct route_table *table;
+  struct route_node *rn = NULL;
+  struct rib *rib;
+  struct rib del;
+  int add_cmd, del_cmd;
+
+  add_cmd = (afi == AFI_IP) ? ZEBRA_IPV4_ROUTE_ADD : ZEBRA_IPV6_ROUTE_ADD;
+  del_cmd = (afi == AFI_IP) ? ZEBRA_IPV4_ROUTE_DELETE
+			    : ZEBRA_IPV6_ROUTE_DELETE;
+
+  for (pend = prn->info; pend; pend = next)
+    {
+      next = pend->next;
+
+      if (pend->del)
+	{
+	  memset (&del, 0, sizeof (struct rib));
+	  del.type = pend->type;
+	  del.flags = pend->del_flags;
+	  if (pend->del_nexthop)
+	    del.nexthop = &pend->del_nh;
+	  zsend_route_multipath (del_cmd, client, &prn->p, &del);
+	}
+
+      if (pend->add
+	  && (client->redist[pend->type]
+	      || (client->redist_default && is_default (&prn->p))))
+	{
+	  if (! rn && (table = vrf_table (afi, SAFI_UNICAST, 0)))
+	    rn = route_node_lookup (table, &prn->p);
+	  if (rn)
+	    RNODE_FOREACH_RIB (rn, rib)
+	      if (CHECK_FLAG (rib->flags, ZEBRA_FLAG_SELECTED)
+		  && rib->type == pend->type
+		  && rib->distance != DISTANCE_INFINITY)
+		{
+		  zsend_route_multipath (add_cmd, client, &prn->p, rib);
+		  break;
+		}
+	}
+
+      XFREE (MTYPE_REDIST_PENDING, pend);
+    }
+
+  if (rn)
+    route_unlock_node (rn);
+  prn->info = NULL;
+  route_unlock_node (prn);
+  client->redist_queued--;
+}
+
+static int
+redistribute_flush (struct thread *thread)
+{
+  struct zserv *client = THREAD_ARG (thread);
   struct route_node *rn;
+  unsigned long count = 0;
+  afi_t afi;
 
-  table = vrf_table (AFI_IP, SAFI_UNICAST, 0);
-  if (table)
-    for (rn = route_top (table); rn; rn = route_next (rn))
-      RNODE_FOREACH_RIB (rn, newrib)
-	if (CHECK_FLAG (newrib->flags, ZEBRA_FLAG_SELECTED) 
-	    && newrib->type == type 
-	    && newrib->distance != DISTANCE_INFINITY
-	    && zebra_check_addr (&rn->p))
-	  zsend_route_multipath (ZEBRA_IPV4_ROUTE_ADD, client, &rn->p, newrib);
-  
-#ifdef HAVE_IPV6
-  table = vrf_table (AFI_IP6, SAFI_UNICAST, 0);
-  if (table)
-    for (rn = route_top (table); rn; rn = route_next (rn))
-      RNODE_FOREACH_RIB (rn, newrib)
-	if (CHECK_FLAG (newrib->flags, ZEBRA_FLAG_SELECTED)
-	    && newrib->type == type 
-	    && newrib->distance != DISTANCE_INFINITY
-	    && zebra_check_addr (&rn->p))
-	  zsend_route_multipath (ZEBRA_IPV6_ROUTE_ADD, client, &rn->p, newrib);
-#endif /* HAVE_IPV6 */
+  client->t_redist = NULL;
+
+  /* Everything sent in this slot goes out in as few writes as can be. */
+  zserv_cork (client);
+  for (afi = AFI_IP; afi < AFI_MAX; afi++)
+    if (client->redist_pending[afi])
+      for (rn = route_top (client->redist_pending[afi]); rn;
+	   rn = route_next (rn))
+	{
+	  if (rn->info)
+	    redistribute_send (client, rn, afi);
+
+	  if (zserv_client_full (client)
+	      || ((++count & 0xff) == 0 && thread_should_yield (thread)))
+	    {
+	      route_unlock_node (rn);
+	      goto out;
+	    }
+	}
+
+  /* Only then the walk, so that it sees no queued withdrawal twice. */
+  if (client->redist_walk_afi)
+    redistribute_walk (client, thread);
+
+ out:
+  zserv_uncork (client);
+
+  /* Past the high mark the write thread resumes us. */
+  redistribute_schedule (client);
+  return 0;
+}
+
+/* Have queued redistribution sent, unless the client has more than
+   enough to read already. */
+void
+redistribute_schedule (struct zserv *client)
+{
+  if (client->t_redist || client->t_suicide
+      || (! client->redist_queued && ! client->redist_walk_afi)
+      || zserv_client_full (client))
+    return;
+  client->t_redist = thread_add_background (zebrad.master,
+					    redistribute_flush, client, 0);
+}
+
+/* Drop the queue of a client going away. */
+void
+redistribute_finish (struct zserv *client)
+{
+  struct redist_pending *pend;
+  struct route_node *rn;
+  afi_t afi;
+
+  THREAD_OFF (client->t_redist);
+  if (client->redist_walk_rn)
+    route_unlock_node (client->redist_walk_rn);
+  client->redist_walk_rn = NULL;
+  client->redist_walk_afi = 0;
+  for (afi = AFI_IP; afi < AFI_MAX; afi++)
+    {
+      if (! client->redist_pending[afi])
+	continue;
+      for (rn = route_top (client->redist_pending[afi]); rn;
+	   rn = route_next (rn))
+	while ((pend = rn->info))
+	  {
+	    rn->info = pend->next;
+	    XFREE (MTYPE_REDIST_PENDING, pend);
+	  }
+      route_table_finish (client->redist_pending[afi]);
+      client->redist_pending[afi] = NULL;
+    }
+  client->redist_queued = 0;
 }
 
 void
@@ -174,29 +456,17 @@ redistribute_add (struct prefix *p, struct rib *rib)
   struct listnode *node, *nnode;
   struct zserv *client;
 
+  zebra_nht_changed (p);
+
   for (ALL_LIST_ELEMENTS (zebrad.client_list, node, nnode, client))
     {
       if (is_default (p))
         {
           if (client->redist_default || client->redist[rib->type])
-            {
-              if (p->family == AF_INET)
-                zsend_route_multipath (ZEBRA_IPV4_ROUTE_ADD, client, p, rib);
-#ifdef HAVE_IPV6
-              if (p->family == AF_INET6)
-                zsend_route_multipath (ZEBRA_IPV6_ROUTE_ADD, client, p, rib);
-#endif /* HAVE_IPV6 */	  
-	    }
+            redistribute_queue (client, p, rib, 1);
         }
       else if (client->redist[rib->type])
-        {
-          if (p->family == AF_INET)
-            zsend_route_multipath (ZEBRA_IPV4_ROUTE_ADD, client, p, rib);
-#ifdef HAVE_IPV6
-          if (p->family == AF_INET6)
-            zsend_route_multipath (ZEBRA_IPV6_ROUTE_ADD, client, p, rib);
-#endif /* HAVE_IPV6 */	  
-        }
+        redistribute_queue (client, p, rib, 1);
     }
 }
 
@@ -206,6 +476,8 @@ redistribute_delete (struct prefix *p, struct rib *rib)
   struct listnode *node, *nnode;
   struct zserv *client;
 
+  zebra_nht_changed (p);
+
   /* Add DISTANCE_INFINITY check. */
   if (rib->distance == DISTANCE_INFINITY)
     return;
@@ -215,26 +487,10 @@ redistribute_delete (struct prefix *p, struct rib *rib)
       if (is_default (p))
 	{
 	  if (client->redist_default || client->redist[rib->type])
-	    {
-	      if (p->family == AF_INET)
-		zsend_route_multipath (ZEBRA_IPV4_ROUTE_DELETE, client, p,
-				       rib);
-#ifdef HAVE_IPV6
-	      if (p->family == AF_INET6)
-		zsend_route_multipath (ZEBRA_IPV6_ROUTE_DELETE, client, p,
-				       rib);
-#endif /* HAVE_IPV6 */
-	    }
+	    redistribute_queue (client, p, rib, 0);
 	}
       else if (client->redist[rib->type])
-	{
-	  if (p->family == AF_INET)
-	    zsend_route_multipath (ZEBRA_IPV4_ROUTE_DELETE, client, p, rib);
-#ifdef HAVE_IPV6
-	  if (p->family == AF_INET6)
-	    zsend_route_multipath (ZEBRA_IPV6_ROUTE_DELETE, client, p, rib);
-#endif /* HAVE_IPV6 */
-	}
+	redistribute_queue (client, p, rib, 0);
     }
 }
 
@@ -266,6 +522,7 @@ zebra_redistribute_delete (int command, struct zserv *client, int length)
     return;
 
   client->redist[type] = 0;
+  client->redist_walk[type] = 0;
 }
 
 void
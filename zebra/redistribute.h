@@ -34,6 +34,8 @@ extern void zebra_redistribute_default_delete (int, struct zserv *, int);
 
 extern void redistribute_add (struct prefix *, struct rib *);
 extern void redistribute_delete (struct prefix *, struct rib *);
+extern void redistribute_schedule (struct zserv *);
+extern void redistribute_finish (struct zserv *);
 
 extern void zebra_interface_up_update (struct interface *);
 extern void zebra_interface_down_update (struct interface *);
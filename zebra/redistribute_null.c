@@ -53,3 +53,6 @@ void zebra_interface_address_delete_update (struct interface *a,
                                                 struct connected *b)
 { return; }
 #endif
+
+void zsend_route_notify (struct prefix *a, struct rib *b, u_char c)
+{ return; }
@@ -38,6 +38,8 @@ union g_addr {
 #endif /* HAVE_IPV6 */
 };
 
+/* There is one for every route, the fields are ordered to leave no
+   holes. */
 struct rib
 {
   /* Link list. */
@@ -47,21 +49,24 @@ struct rib
   /* Nexthop structure */
   struct nexthop *nexthop;
   
-  /* Refrence count. */
-  unsigned long refcnt;
-  
+  /* Kernel nexthop object installed over, if any. */
+  struct rib_nhobj_dep *nhobj;
+
   /* Uptime. */
   time_t uptime;
 
-  /* Type fo this route. */
-  int type;
-
   /* Which routing table */
   int table;			
 
   /* Metric */
   u_int32_t metric;
 
+  /* Duplicates of a connected route. */
+  u_int16_t refcnt;
+
+  /* Type fo this route. */
+  u_char type;
+
   /* Distance. */
   u_char distance;
 
@@ -74,6 +79,12 @@ struct rib
   /* RIB internal status */
   u_char status;
 #define RIB_ENTRY_REMOVED	(1 << 0)
+#define RIB_ENTRY_NHOBJ_STALE	(1 << 1) /* Reinstall, its nexthop object
+					    went out of date */
+#define RIB_ENTRY_FIB_NOTIFY	(1 << 2) /* The client is to hear how the
+					    add came out */
+#define RIB_ENTRY_FIB_QUEUED	(1 << 3) /* ... once the kernel answers */
+#define RIB_ENTRY_FIB_COUNTED	(1 << 4) /* In the FIB count of its table */
 
   /* Nexthop information. */
   u_char nexthop_num;
@@ -118,7 +129,12 @@ typedef struct rib_dest_t_
   u_int32_t flags;
 
   /*
-   * Linkage to put dest on the FPM processing queue.
+   * Bitmask of the FPM connections the dest has been 'advertised' to.
+   */
+  u_char fpm_sent;
+
+  /*
+   * Linkage to put dest on the FPM update log.
    */
   TAILQ_ENTRY(rib_dest_t_) fpm_q_entries;
 
@@ -133,16 +149,22 @@ typedef struct rib_dest_t_
 
 /*
  * This flag indicates that a given prefix has been 'advertised' to
- * the FPM to be installed in the forwarding plane.
+ * at least one FPM to be installed in the forwarding plane.
  */
 #define RIB_DEST_SENT_TO_FPM   (1 << (ZEBRA_MAX_QINDEX + 1))
 
 /*
- * This flag is set when we need to send an update to the FPM about a
- * dest.
+ * This flag is set while the dest is on the FPM update log, which
+ * FPMs are sent updates from.
  */
 #define RIB_DEST_UPDATE_FPM    (1 << (ZEBRA_MAX_QINDEX + 2))
 
+/*
+ * This flag is set while the dest has kernel routes read at startup
+ * that have not been through best-path selection yet.
+ */
+#define RIB_DEST_BULK          (1 << (ZEBRA_MAX_QINDEX + 3))
+
 /*
  * Macro to iterate over each route for a destination (prefix).
  */
@@ -238,6 +260,7 @@ enum nexthop_types_t
 };
 
 /* Nexthop structure. */
+/* Ordered to leave no holes, as for struct rib. */
 struct nexthop
 {
   struct nexthop *next;
@@ -254,12 +277,13 @@ struct nexthop
 #define NEXTHOP_FLAG_FIB        (1 << 1) /* FIB nexthop. */
 #define NEXTHOP_FLAG_RECURSIVE  (1 << 2) /* Recursive nexthop. */
 
-  /* Nexthop address or interface name. */
-  union g_addr gate;
-
   /* Recursive lookup nexthop. */
   u_char rtype;
   unsigned int rifindex;
+
+  /* Nexthop address or interface name. */
+  union g_addr gate;
+
   union g_addr rgate;
   union g_addr src;
 };
@@ -302,6 +326,31 @@ typedef struct rib_table_info_t_
   afi_t afi;
   safi_t safi;
 
+  /*
+   * Routes of each type in the table and in the FIB, those from iBGP
+   * also under RIB_COUNT_IBGP.  Kept up as routes come and go, for
+   * "show ip route summary".
+   */
+#define RIB_COUNT_IBGP ZEBRA_ROUTE_MAX
+  u_int32_t rib_cnt[RIB_COUNT_IBGP + 1];
+  u_int32_t fib_cnt[RIB_COUNT_IBGP + 1];
+
+  /*
+   * All the ribs in the table.  While there are any, the table is on
+   * the list of non-empty tables that rib_tables_iter_next() walks,
+   * kept in vrf and then AFI/SAFI order.
+   */
+  u_int32_t rib_total;
+  u_int32_t order;
+  struct route_table *next;
+  struct route_table *prev;
+
+  /*
+   * rib_tables_version() when a rib was last linked to or unlinked from
+   * the table.
+   */
+  u_int32_t version;
+
 } rib_table_info_t;
 
 typedef enum
@@ -317,8 +366,14 @@ typedef enum
  */
 typedef struct rib_tables_iter_t_
 {
-  uint32_t vrf_id;
-  int afi_safi_ix;
+  /* The table returned last. */
+  struct route_table *table;
+
+  /*
+   * If not 0, only tables changed after this rib_tables_version() are
+   * returned.
+   */
+  u_int32_t since;
 
   rib_tables_iter_state_t state;
 } rib_tables_iter_t;
@@ -360,6 +415,7 @@ extern int rib_add_ipv4 (int type, int flags, struct prefix_ipv4 *p,
 			 u_int32_t, u_char, safi_t);
 
 extern int rib_add_ipv4_multipath (struct prefix_ipv4 *, struct rib *, safi_t);
+extern void rib_discard (struct rib *);
 
 extern int rib_delete_ipv4 (int type, int flags, struct prefix_ipv4 *p,
 		            struct in_addr *gate, unsigned int ifindex, 
@@ -371,6 +427,15 @@ extern struct rib *rib_lookup_ipv4 (struct prefix_ipv4 *);
 
 extern void rib_update (void);
 extern void rib_weed_tables (void);
+extern void rib_bulk_start (void);
+extern void rib_bulk_finish (void);
+extern void rib_nexthop_resolve_flush (struct prefix *);
+extern void rib_fib_result (struct prefix *, struct rib *, int);
+extern void rib_fib_count (struct route_node *, struct rib *);
+extern void rib_nhobj_enable (u_int32_t);
+extern int rib_nhobj_enabled (void);
+extern u_int32_t rib_nhobj_id (struct rib *);
+extern void rib_nhobj_lost (u_int32_t);
 extern void rib_sweep_route (void);
 extern void rib_close (void);
 extern void rib_init (void);
@@ -413,6 +478,7 @@ static_delete_ipv6 (struct prefix *p, u_char type, struct in6_addr *gate,
 
 extern int rib_gc_dest (struct route_node *rn);
 extern struct route_table *rib_tables_iter_next (rib_tables_iter_t *iter);
+extern u_int32_t rib_tables_version (void);
 
 /*
  * Inline functions.
@@ -503,6 +569,19 @@ rib_tables_iter_init (rib_tables_iter_t *iter)
   iter->state = RIB_TABLES_ITER_S_INIT;
 }
 
+/*
+ * rib_tables_iter_init_since
+ *
+ * Like rib_tables_iter_init(), for the tables that had ribs linked or
+ * unlinked after the given rib_tables_version() only.
+ */
+static inline void
+rib_tables_iter_init_since (rib_tables_iter_t *iter, u_int32_t since)
+{
+  rib_tables_iter_init (iter);
+  iter->since = since;
+}
+
 /*
  * rib_tables_iter_started
  *
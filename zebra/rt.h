@@ -27,12 +27,22 @@
 #include "if.h"
 #include "zebra/rib.h"
 
+/* Route changes return -1 on failure, 0 once done, or 1 if the kernel
+   answers later; an add then ends with rib_fib_result(). */
 extern int kernel_add_ipv4 (struct prefix *, struct rib *);
 extern int kernel_delete_ipv4 (struct prefix *, struct rib *);
 extern int kernel_add_route (struct prefix_ipv4 *, struct in_addr *, int, int);
 extern int kernel_address_add_ipv4 (struct interface *, struct connected *);
 extern int kernel_address_delete_ipv4 (struct interface *, struct connected *);
 
+/* Nexthop objects routes can be installed over, see rt_netlink.c.
+   Kernels without them never have rib_nhobj_enable() called. */
+extern int kernel_nexthop_add (u_int32_t id, int family, union g_addr *gate,
+			       unsigned int ifindex, int replace);
+extern int kernel_nexthop_group_add (u_int32_t id, u_int32_t *member,
+				     int count);
+extern int kernel_nexthop_delete (u_int32_t id);
+
 #ifdef HAVE_IPV6
 extern int kernel_add_ipv6 (struct prefix *, struct rib *);
 extern int kernel_delete_ipv6 (struct prefix *, struct rib *);
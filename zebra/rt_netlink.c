@@ -36,6 +36,9 @@
 #include "rib.h"
 #include "thread.h"
 #include "privs.h"
+#include "command.h"
+#include "vty.h"
+#include "trace.h"
 
 #include "zebra/zserv.h"
 #include "zebra/rt.h"
@@ -45,6 +48,38 @@
 
 #include "rt_netlink.h"
 
+#ifdef RTM_NEWNEXTHOP
+#include <linux/nexthop.h>
+#endif /* RTM_NEWNEXTHOP */
+
+/* The most the kernel puts into one message of a dump, and how many of
+   those are taken per system call. */
+#define NL_RCV_BUF_SIZE  32768
+#define NL_RCV_BUF_COUNT 8
+
+/* How large the listen socket's receive buffer may grow by itself
+   after it overran. */
+#define NL_RCVBUF_MAX    (32 * 1024 * 1024)
+
+#ifndef MSG_WAITFORONE
+struct mmsghdr
+{
+  struct msghdr msg_hdr;
+  unsigned int msg_len;
+};
+#endif /* MSG_WAITFORONE */
+
+/* Messages received but not parsed yet. */
+struct nlrcv
+{
+  char *buf;
+  struct mmsghdr mm[NL_RCV_BUF_COUNT];
+  struct iovec iov[NL_RCV_BUF_COUNT];
+  struct sockaddr_nl snl[NL_RCV_BUF_COUNT];
+  int count;
+  int next;
+};
+
 /* Socket interface to kernel */
 struct nlsock
 {
@@ -52,6 +87,7 @@ struct nlsock
   int seq;
   struct sockaddr_nl snl;
   const char *name;
+  struct nlrcv *rcv;
 } netlink      = { -1, 0, {0}, "netlink-listen"},     /* kernel messages */
   netlink_cmd  = { -1, 0, {0}, "netlink-cmd"};        /* command channel */
 
@@ -65,6 +101,11 @@ static const struct message nlmsg_str[] = {
   {RTM_NEWADDR,  "RTM_NEWADDR"},
   {RTM_DELADDR,  "RTM_DELADDR"},
   {RTM_GETADDR,  "RTM_GETADDR"},
+#ifdef RTM_NEWNEXTHOP
+  {RTM_NEWNEXTHOP, "RTM_NEWNEXTHOP"},
+  {RTM_DELNEXTHOP, "RTM_DELNEXTHOP"},
+  {RTM_GETNEXTHOP, "RTM_GETNEXTHOP"},
+#endif /* RTM_NEWNEXTHOP */
   {0, NULL}
 };
 
@@ -73,6 +114,8 @@ extern struct zebra_t zebrad;
 extern struct zebra_privs_t zserv_privs;
 
 extern u_int32_t nl_rcvbufsize;
+extern u_int32_t nl_batchsize;
+extern int nl_nexthops;
 
 /* Note: on netlink systems, there should be a 1-to-1 mapping between interface
    names and ifindex values. */
@@ -98,7 +141,7 @@ set_ifindex(struct interface *ifp, unsigned int ifi_index)
 	  if_delete_update(oifp);
         }
     }
-  ifp->ifindex = ifi_index;
+  if_set_index (ifp, ifi_index);
 }
 
 #ifndef SO_RCVBUFFORCE
@@ -124,13 +167,13 @@ netlink_recvbuf (struct nlsock *nl, uint32_t newsize)
   /* Try force option (linux >= 2.6.14) and fall back to normal set */
   if ( zserv_privs.change (ZPRIVS_RAISE) )
     zlog_err ("routing_socket: Can't raise privileges");
-  ret = setsockopt(nl->sock, SOL_SOCKET, SO_RCVBUFFORCE, &nl_rcvbufsize,
-		   sizeof(nl_rcvbufsize));
+  ret = setsockopt(nl->sock, SOL_SOCKET, SO_RCVBUFFORCE, &newsize,
+		   sizeof(newsize));
   if ( zserv_privs.change (ZPRIVS_LOWER) )
     zlog_err ("routing_socket: Can't lower privileges");
   if (ret < 0)
-     ret = setsockopt(nl->sock, SOL_SOCKET, SO_RCVBUF, &nl_rcvbufsize,
-		      sizeof(nl_rcvbufsize));
+     ret = setsockopt(nl->sock, SOL_SOCKET, SO_RCVBUF, &newsize,
+		      sizeof(newsize));
   if (ret < 0)
     {
       zlog (NULL, LOG_ERR, "Can't set %s receive buffer size: %s", nl->name,
@@ -152,6 +195,22 @@ netlink_recvbuf (struct nlsock *nl, uint32_t newsize)
   return 0;
 }
 
+/* Double the receive buffer after an overrun, so that the next burst of
+   kernel messages, e.g. the routes going with an interface, fits. */
+static void
+netlink_recvbuf_grow (struct nlsock *nl)
+{
+  u_int32_t size;
+  socklen_t len = sizeof (size);
+
+  if (getsockopt (nl->sock, SOL_SOCKET, SO_RCVBUF, &size, &len) < 0
+      || size >= NL_RCVBUF_MAX)
+    return;
+
+  /* The kernel gives twice the size asked for. */
+  netlink_recvbuf (nl, size);
+}
+
 /* Make socket for Linux netlink interface. */
 static int
 netlink_socket (struct nlsock *nl, unsigned long groups)
@@ -210,20 +269,457 @@ netlink_socket (struct nlsock *nl, unsigned long groups)
   return ret;
 }
 
-/* Get type specified information from netlink. */
+/* Batched route programming.  With a batch size set, route changes are
+   not sent one by one with netlink_talk() waiting for each ACK.  They
+   are collected in one buffer and sent with a single sendmsg(), and
+   their ACKs are read later from the command socket.  Every message
+   carries its own sequence number, and the kernel answers in order, so
+   each ACK or error is matched to the oldest route still outstanding.
+   Synchronous users of the command socket first wait for everything
+   outstanding, which keeps their replies apart from the ACKs. */
+
+/* Buffer holding one batch. */
+#define NL_BATCH_BUF_SIZE	65536
+
+/* Routes sent but not acknowledged yet, in units of the batch size.
+   Their ACKs have to fit into the socket receive buffer. */
+#define NL_BATCH_DEPTH		4
+
+struct nl_batch_entry
+{
+  u_int32_t seq;
+  int cmd;
+  struct prefix p;
+  struct rib *rib;
+};
+
+static struct
+{
+  /* Messages not sent yet. */
+  char *buf;
+  size_t len;
+
+  /* Ring of routes queued or outstanding, staged ones at the tail. */
+  struct nl_batch_entry *ring;
+  unsigned int size;
+  unsigned int head;
+  unsigned int count;
+  unsigned int staged;
+
+  struct thread *t_flush;
+  struct thread *t_read;
+
+  /* Statistics. */
+  unsigned long batches;
+  unsigned long routes;
+  unsigned long errors;
+  unsigned long lost;
+  unsigned int depth_max;
+} nl_batch;
+
+static int netlink_batch_read (struct thread *);
+
+/* The rib of a route and its node, unless it is gone by now. */
+static struct rib *
+netlink_batch_rib (struct nl_batch_entry *e, struct route_node **rnp)
+{
+  struct route_table *table;
+  struct route_node *rn;
+  struct rib *rib;
+  safi_t safi;
+
+  for (safi = SAFI_UNICAST; safi <= SAFI_MULTICAST; safi++)
+    {
+      table = vrf_table (family2afi (e->p.family), safi, 0);
+      if (! table || (rn = route_node_lookup (table, &e->p)) == NULL)
+	continue;
+
+      RNODE_FOREACH_RIB (rn, rib)
+	if (rib == e->rib)
+	  break;
+      route_unlock_node (rn);
+      if (rib)
+	{
+	  *rnp = rn;
+	  return rib;
+	}
+    }
+  return NULL;
+}
+
+/* A route the kernel took. */
+static void
+netlink_batch_done (struct nl_batch_entry *e)
+{
+  struct route_node *rn;
+  struct rib *rib;
+
+  if (e->cmd == RTM_NEWROUTE && (rib = netlink_batch_rib (e, &rn)) != NULL)
+    rib_fib_result (&e->p, rib, 1);
+}
+
+/* The route an error refers to lost its FIB state, as rib_install_kernel
+   does after a failed synchronous install. */
+static void
+netlink_batch_fail (struct nl_batch_entry *e, int errnum)
+{
+  struct route_node *rn;
+  struct rib *rib;
+  struct nexthop *nexthop;
+  char buf[INET6_ADDRSTRLEN];
+
+  /* Deal with errors that occur because of races in link handling */
+  if ((e->cmd == RTM_DELROUTE && (errnum == ENODEV || errnum == ESRCH))
+      || (e->cmd == RTM_NEWROUTE && errnum == EEXIST))
+    {
+      if (IS_ZEBRA_DEBUG_KERNEL)
+	zlog_debug ("%s: error: %s type=%s(%u), seq=%u", netlink_cmd.name,
+		    safe_strerror (errnum), lookup (nlmsg_str, e->cmd),
+		    e->cmd, e->seq);
+      /* The route is there all the same. */
+      netlink_batch_done (e);
+      return;
+    }
+
+  nl_batch.errors++;
+  zlog_err ("%s error: %s, type=%s(%u), seq=%u, route %s/%d",
+	    netlink_cmd.name, safe_strerror (errnum),
+	    lookup (nlmsg_str, e->cmd), e->cmd, e->seq,
+	    inet_ntop (e->p.family, &e->p.u.prefix, buf, INET6_ADDRSTRLEN),
+	    e->p.prefixlen);
+
+  if (e->cmd != RTM_NEWROUTE)
+    return;
+
+  /* The rib may be gone by now; only touch it if it is still there. */
+  if ((rib = netlink_batch_rib (e, &rn)) == NULL)
+    return;
+
+  for (nexthop = rib->nexthop; nexthop; nexthop = nexthop->next)
+    UNSET_FLAG (nexthop->flags, NEXTHOP_FLAG_FIB);
+  rib_fib_count (rn, rib);
+  /* Gateways may have resolved over it. */
+  if (rib->type != ZEBRA_ROUTE_BGP)
+    rib_nexthop_resolve_flush (&e->p);
+  rib_fib_result (&e->p, rib, 0);
+}
+
+/* Pop the oldest outstanding route. */
+static void
+netlink_batch_pop (void)
+{
+  nl_batch.head = (nl_batch.head + 1) % nl_batch.size;
+  nl_batch.count--;
+}
+
+/* Match an ACK or error to the outstanding routes. */
+static void
+netlink_batch_ack (u_int32_t seq, int errnum)
+{
+  struct nl_batch_entry *e;
+
+  while (nl_batch.count > nl_batch.staged)
+    {
+      e = &nl_batch.ring[nl_batch.head];
+
+      /* Not ours, e.g. left over from a synchronous request. */
+      if ((int32_t) (seq - e->seq) < 0)
+	return;
+
+      if (e->seq == seq)
+	{
+	  if (errnum)
+	    netlink_batch_fail (e, errnum);
+	  else
+	    netlink_batch_done (e);
+	  netlink_batch_pop ();
+	  return;
+	}
+
+      /* The kernel answers every message; one that was skipped
+	 got lost. */
+      zlog_warn ("%s: no ACK for seq=%u", netlink_cmd.name, e->seq);
+      nl_batch.lost++;
+      netlink_batch_pop ();
+    }
+}
+
+/* Forget about every outstanding route, their ACKs will not come. */
+static void
+netlink_batch_forget (void)
+{
+  unsigned int outstanding = nl_batch.count - nl_batch.staged;
+
+  if (! outstanding)
+    return;
+
+  zlog_err ("%s: %u route ACKs lost", netlink_cmd.name, outstanding);
+  nl_batch.lost += outstanding;
+  nl_batch.head = (nl_batch.head + outstanding) % nl_batch.size;
+  nl_batch.count -= outstanding;
+}
+
+/* Receive one buffer of ACKs.  Returns -1 if there was nothing to read
+   or the socket failed. */
 static int
-netlink_request (int family, int type, struct nlsock *nl)
+netlink_batch_recv (int block)
+{
+  int status;
+  char buf[NL_PKT_BUF_SIZE];
+  struct iovec iov = { buf, sizeof buf };
+  struct sockaddr_nl snl;
+  struct msghdr msg = { (void *) &snl, sizeof snl, &iov, 1, NULL, 0, 0 };
+  struct nlmsghdr *h;
+  struct nlmsgerr *err;
+
+  do
+    status = recvmsg (netlink_cmd.sock, &msg, block ? 0 : MSG_DONTWAIT);
+  while (status < 0 && errno == EINTR);
+
+  if (status < 0)
+    {
+      if (errno == EWOULDBLOCK || errno == EAGAIN)
+	return -1;
+
+      /* Typically ENOBUFS, the receive buffer overran. */
+      zlog (NULL, LOG_ERR, "%s recvmsg overrun: %s",
+	    netlink_cmd.name, safe_strerror (errno));
+      netlink_batch_forget ();
+      return -1;
+    }
+  if (status == 0)
+    {
+      zlog (NULL, LOG_ERR, "%s EOF", netlink_cmd.name);
+      netlink_batch_forget ();
+      return -1;
+    }
+
+  for (h = (struct nlmsghdr *) buf; NLMSG_OK (h, (unsigned int) status);
+       h = NLMSG_NEXT (h, status))
+    {
+      if (h->nlmsg_type != NLMSG_ERROR)
+	continue;
+
+      if (h->nlmsg_len < NLMSG_LENGTH (sizeof (struct nlmsgerr)))
+	{
+	  zlog (NULL, LOG_ERR, "%s error: message truncated",
+		netlink_cmd.name);
+	  continue;
+	}
+
+      err = (struct nlmsgerr *) NLMSG_DATA (h);
+      netlink_batch_ack (err->msg.nlmsg_seq, -err->error);
+    }
+  return 0;
+}
+
+/* Send the routes collected so far. */
+static int
+netlink_batch_flush (void)
 {
-  int ret;
   struct sockaddr_nl snl;
+  struct iovec iov;
+  struct msghdr msg = { (void *) &snl, sizeof snl, &iov, 1, NULL, 0, 0 };
+  int status;
   int save_errno;
+  unsigned int depth;
 
-  struct
-  {
-    struct nlmsghdr nlh;
-    struct rtgenmsg g;
-  } req;
+  THREAD_OFF (nl_batch.t_flush);
+  if (! nl_batch.staged)
+    return 0;
+
+  memset (&snl, 0, sizeof snl);
+  snl.nl_family = AF_NETLINK;
+  iov.iov_base = nl_batch.buf;
+  iov.iov_len = nl_batch.len;
+
+  if (IS_ZEBRA_DEBUG_KERNEL)
+    zlog_debug ("%s: sending %u routes in %lu bytes", netlink_cmd.name,
+		nl_batch.staged, (u_long) nl_batch.len);
+
+  if (zserv_privs.change (ZPRIVS_RAISE))
+    zlog (NULL, LOG_ERR, "Can't raise privileges");
+  status = sendmsg (netlink_cmd.sock, &msg, 0);
+  save_errno = errno;
+  if (zserv_privs.change (ZPRIVS_LOWER))
+    zlog (NULL, LOG_ERR, "Can't lower privileges");
+
+  nl_batch.len = 0;
+
+  if (status < 0)
+    {
+      zlog (NULL, LOG_ERR, "netlink_batch_flush sendmsg() error: %s",
+            safe_strerror (save_errno));
+
+      /* Nothing was sent: ACKs for the earlier batches still come, and
+	 these routes are failures of their own. */
+      while (nl_batch.staged)
+	{
+	  struct nl_batch_entry *e;
+
+	  e = &nl_batch.ring[(nl_batch.head + nl_batch.count - 1)
+			     % nl_batch.size];
+	  netlink_batch_fail (e, save_errno);
+	  nl_batch.count--;
+	  nl_batch.staged--;
+	}
+      return -1;
+    }
+
+  nl_batch.batches++;
+  nl_batch.routes += nl_batch.staged;
+  nl_batch.staged = 0;
+
+  depth = nl_batch.count;
+  if (depth > nl_batch.depth_max)
+    nl_batch.depth_max = depth;
+
+  if (! nl_batch.t_read)
+    nl_batch.t_read = thread_add_read (zebrad.master, netlink_batch_read,
+				       NULL, netlink_cmd.sock);
+  return 0;
+}
 
+/* Wait until no more than limit routes are outstanding. */
+static void
+netlink_batch_drain (unsigned int limit)
+{
+  while (nl_batch.count - nl_batch.staged > limit)
+    if (netlink_batch_recv (1) < 0)
+      break;
+}
+
+static int
+netlink_batch_timer (struct thread *thread)
+{
+  nl_batch.t_flush = NULL;
+  netlink_batch_flush ();
+  return 0;
+}
+
+static int
+netlink_batch_read (struct thread *thread)
+{
+  nl_batch.t_read = NULL;
+
+  while (nl_batch.count > nl_batch.staged)
+    if (netlink_batch_recv (0) < 0)
+      break;
+
+  if (nl_batch.count > nl_batch.staged)
+    nl_batch.t_read = thread_add_read (zebrad.master, netlink_batch_read,
+				       NULL, netlink_cmd.sock);
+  return 0;
+}
+
+/* Queue a route message.  The batch goes out when it is full, or after
+   the current event, e.g. a run of the rib work queue. */
+static int
+netlink_batch_add (struct nlmsghdr *n, struct prefix *p, struct rib *rib)
+{
+  struct nl_batch_entry *e;
+
+  if (! nl_batch.ring)
+    {
+      nl_batch.size = nl_batchsize * NL_BATCH_DEPTH;
+      nl_batch.ring = XCALLOC (MTYPE_NL_BATCH,
+			       nl_batch.size * sizeof (struct nl_batch_entry));
+      nl_batch.buf = XMALLOC (MTYPE_NL_BATCH, NL_BATCH_BUF_SIZE);
+    }
+
+  if (nl_batch.len + NLMSG_ALIGN (n->nlmsg_len) > NL_BATCH_BUF_SIZE)
+    netlink_batch_flush ();
+
+  /* Don't let more ACKs pile up than the socket can hold. */
+  if (nl_batch.count == nl_batch.size)
+    {
+      netlink_batch_flush ();
+      netlink_batch_drain (nl_batch.size - nl_batchsize);
+    }
+
+  n->nlmsg_seq = ++netlink_cmd.seq;
+  n->nlmsg_flags |= NLM_F_ACK;
+
+  if (IS_ZEBRA_DEBUG_KERNEL)
+    zlog_debug ("netlink_batch_add: %s type %s(%u), seq=%u", netlink_cmd.name,
+               lookup (nlmsg_str, n->nlmsg_type), n->nlmsg_type,
+               n->nlmsg_seq);
+
+  memcpy (nl_batch.buf + nl_batch.len, n, n->nlmsg_len);
+  nl_batch.len += NLMSG_ALIGN (n->nlmsg_len);
+
+  e = &nl_batch.ring[(nl_batch.head + nl_batch.count) % nl_batch.size];
+  e->seq = n->nlmsg_seq;
+  e->cmd = n->nlmsg_type;
+  prefix_copy (&e->p, p);
+  e->rib = rib;
+  nl_batch.count++;
+  nl_batch.staged++;
+
+  if (nl_batch.staged >= nl_batchsize)
+    return netlink_batch_flush ();
+
+  if (! nl_batch.t_flush)
+    nl_batch.t_flush = thread_add_event (zebrad.master, netlink_batch_timer,
+					 NULL, 0);
+  return 0;
+}
+
+/* Don't exit with routes still queued, e.g. after rib_close(). */
+static void
+netlink_batch_exit (void)
+{
+  netlink_batch_flush ();
+  netlink_batch_drain (0);
+}
+
+/* Synchronous use of the command socket: get all the batched routes
+   answered first. */
+static void
+netlink_batch_sync (struct nlsock *nl)
+{
+  if (nl != &netlink_cmd || ! nl_batch.count)
+    return;
+
+  netlink_batch_flush ();
+  netlink_batch_drain (0);
+}
+
+DEFUN (show_zebra_kernel_stats,
+       show_zebra_kernel_stats_cmd,
+       "show zebra kernel stats",
+       SHOW_STR
+       "Zebra information\n"
+       "Kernel interface information\n"
+       "Statistics\n")
+{
+  if (! nl_batchsize)
+    {
+      vty_out (vty, "Routes are sent to the kernel one at a time%s",
+	       VTY_NEWLINE);
+      return CMD_SUCCESS;
+    }
+
+  vty_out (vty, "Batch size %u, up to %u routes outstanding%s",
+	   nl_batchsize, nl_batchsize * NL_BATCH_DEPTH, VTY_NEWLINE);
+  vty_out (vty, "  Outstanding now %u, most ever %u%s",
+	   nl_batch.count - nl_batch.staged, nl_batch.depth_max, VTY_NEWLINE);
+  vty_out (vty, "  %lu routes in %lu batches, average %lu%s",
+	   nl_batch.routes, nl_batch.batches,
+	   nl_batch.batches ? nl_batch.routes / nl_batch.batches : 0,
+	   VTY_NEWLINE);
+  vty_out (vty, "  Errors %lu, ACKs lost %lu%s",
+	   nl_batch.errors, nl_batch.lost, VTY_NEWLINE);
+  return CMD_SUCCESS;
+}
+
+/* Send a request whose answer is read with netlink_parse_info(). */
+static int
+netlink_request_send (struct nlmsghdr *n, struct nlsock *nl)
+{
+  int ret;
+  struct sockaddr_nl snl;
+  int save_errno;
 
   /* Check netlink socket. */
   if (nl->sock < 0)
@@ -232,16 +728,13 @@ netlink_request (int family, int type, struct nlsock *nl)
       return -1;
     }
 
+  netlink_batch_sync (nl);
+
   memset (&snl, 0, sizeof snl);
   snl.nl_family = AF_NETLINK;
 
-  memset (&req, 0, sizeof req);
-  req.nlh.nlmsg_len = sizeof req;
-  req.nlh.nlmsg_type = type;
-  req.nlh.nlmsg_flags = NLM_F_ROOT | NLM_F_MATCH | NLM_F_REQUEST;
-  req.nlh.nlmsg_pid = nl->snl.nl_pid;
-  req.nlh.nlmsg_seq = ++nl->seq;
-  req.g.rtgen_family = family;
+  n->nlmsg_pid = nl->snl.nl_pid;
+  n->nlmsg_seq = ++nl->seq;
 
   /* linux appears to check capabilities on every message 
    * have to raise caps for every message sent
@@ -252,7 +745,7 @@ netlink_request (int family, int type, struct nlsock *nl)
       return -1;
     }
 
-  ret = sendto (nl->sock, (void *) &req, sizeof req, 0,
+  ret = sendto (nl->sock, (void *) n, n->nlmsg_len, 0,
                 (struct sockaddr *) &snl, sizeof snl);
   save_errno = errno;
 
@@ -269,6 +762,101 @@ netlink_request (int family, int type, struct nlsock *nl)
   return 0;
 }
 
+/* Get type specified information from netlink. */
+static int
+netlink_request (int family, int type, struct nlsock *nl)
+{
+  struct
+  {
+    struct nlmsghdr nlh;
+    struct rtgenmsg g;
+  } req;
+
+  memset (&req, 0, sizeof req);
+  req.nlh.nlmsg_len = sizeof req;
+  req.nlh.nlmsg_type = type;
+  req.nlh.nlmsg_flags = NLM_F_ROOT | NLM_F_MATCH | NLM_F_REQUEST;
+  req.g.rtgen_family = family;
+
+  return netlink_request_send (&req.nlh, nl);
+}
+
+/* Receive as many messages as are waiting, up to one per buffer, with a
+   single system call. */
+static int
+netlink_recv_batch (struct nlsock *nl)
+{
+  static int no_recvmmsg;
+  struct nlrcv *r = nl->rcv;
+  int count = NL_RCV_BUF_COUNT;
+  int i;
+
+#ifndef MSG_WAITFORONE
+  no_recvmmsg = 1;
+#endif /* MSG_WAITFORONE */
+  if (no_recvmmsg)
+    count = 1;
+
+  memset (r->mm, 0, sizeof (r->mm));
+  for (i = 0; i < count; i++)
+    {
+      r->iov[i].iov_base = r->buf + i * NL_RCV_BUF_SIZE;
+      r->iov[i].iov_len = NL_RCV_BUF_SIZE;
+      r->mm[i].msg_hdr.msg_name = &r->snl[i];
+      r->mm[i].msg_hdr.msg_namelen = sizeof (struct sockaddr_nl);
+      r->mm[i].msg_hdr.msg_iov = &r->iov[i];
+      r->mm[i].msg_hdr.msg_iovlen = 1;
+    }
+
+#ifdef MSG_WAITFORONE
+  /* Block, if the socket does, for the first message only. */
+  if (! no_recvmmsg)
+    {
+      count = recvmmsg (nl->sock, r->mm, count, MSG_WAITFORONE, NULL);
+      if (count >= 0 || errno != ENOSYS)
+	return count;
+      no_recvmmsg = 1;
+    }
+#endif /* MSG_WAITFORONE */
+
+  count = recvmsg (nl->sock, &r->mm[0].msg_hdr, 0);
+  if (count < 0)
+    return -1;
+  r->mm[0].msg_len = count;
+  return 1;
+}
+
+/* Next message from the socket, received in batches.  Messages left over
+   when parsing stops stay for the next caller, as they would have in
+   the socket. */
+static int
+netlink_recv (struct nlsock *nl, struct msghdr *msg, char **buf)
+{
+  struct nlrcv *r;
+  int count;
+
+  if (! nl->rcv)
+    {
+      nl->rcv = XCALLOC (MTYPE_NL_BUF, sizeof (struct nlrcv));
+      nl->rcv->buf = XMALLOC (MTYPE_NL_BUF,
+			      NL_RCV_BUF_SIZE * NL_RCV_BUF_COUNT);
+    }
+  r = nl->rcv;
+
+  if (r->next == r->count)
+    {
+      r->next = r->count = 0;
+      count = netlink_recv_batch (nl);
+      if (count < 0)
+	return -1;
+      r->count = count;
+    }
+
+  *msg = r->mm[r->next].msg_hdr;
+  *buf = r->iov[r->next].iov_base;
+  return r->mm[r->next++].msg_len;
+}
+
 /* Receive message from netlink interface and pass those information
    to the given function. */
 static int
@@ -281,13 +869,12 @@ netlink_parse_info (int (*filter) (struct sockaddr_nl *, struct nlmsghdr *),
 
   while (1)
     {
-      char buf[NL_PKT_BUF_SIZE];
-      struct iovec iov = { buf, sizeof buf };
+      char *buf;
       struct sockaddr_nl snl;
-      struct msghdr msg = { (void *) &snl, sizeof snl, &iov, 1, NULL, 0, 0 };
+      struct msghdr msg;
       struct nlmsghdr *h;
 
-      status = recvmsg (nl->sock, &msg, 0);
+      status = netlink_recv (nl, &msg, &buf);
       if (status < 0)
         {
           if (errno == EINTR)
@@ -296,8 +883,11 @@ netlink_parse_info (int (*filter) (struct sockaddr_nl *, struct nlmsghdr *),
             break;
           zlog (NULL, LOG_ERR, "%s recvmsg overrun: %s",
 	  	nl->name, safe_strerror(errno));
+          if (errno == ENOBUFS && nl == &netlink)
+            netlink_recvbuf_grow (nl);
           continue;
         }
+      memcpy (&snl, msg.msg_name, sizeof snl);
 
       if (status == 0)
         {
@@ -1135,6 +1725,121 @@ netlink_link_change (struct sockaddr_nl *snl, struct nlmsghdr *h)
   return 0;
 }
 
+#ifdef RTM_NEWNEXTHOP
+/* Identifier of the nexthop object a message is about, 0 if none. */
+static u_int32_t
+netlink_nexthop_id (struct nlmsghdr *h)
+{
+  struct nhmsg *nhm = NLMSG_DATA (h);
+  struct rtattr *tb[NHA_MAX + 1];
+  int len;
+
+  len = h->nlmsg_len - NLMSG_LENGTH (sizeof (struct nhmsg));
+  if (len < 0)
+    return 0;
+
+  memset (tb, 0, sizeof tb);
+  netlink_parse_rtattr (tb, NHA_MAX, (struct rtattr *) (nhm + 1), len);
+  if (! tb[NHA_ID])
+    return 0;
+  return *(u_int32_t *) RTA_DATA (tb[NHA_ID]);
+}
+
+/* The kernel removes nexthop objects by itself when their interface
+   goes, and with them the routes over them. */
+static int
+netlink_nexthop_change (struct sockaddr_nl *snl, struct nlmsghdr *h)
+{
+  u_int32_t id;
+
+  id = netlink_nexthop_id (h);
+  if (id)
+    rib_nhobj_lost (id);
+  return 0;
+}
+
+/* Highest identifier of any nexthop object already there. */
+static u_int32_t netlink_nexthop_max_id;
+
+static int
+netlink_nexthop_table (struct sockaddr_nl *snl, struct nlmsghdr *h)
+{
+  u_int32_t id;
+
+  if (h->nlmsg_type != RTM_NEWNEXTHOP)
+    return 0;
+  id = netlink_nexthop_id (h);
+  if (id > netlink_nexthop_max_id)
+    netlink_nexthop_max_id = id;
+  return 0;
+}
+
+/* Dump the kernel's nexthop objects, which fails if it has none. */
+static int
+netlink_nexthop_read (void)
+{
+  struct sockaddr_nl snl;
+  int ret;
+  int save_errno;
+  struct
+  {
+    struct nlmsghdr n;
+    struct nhmsg nhm;
+  } req;
+
+  memset (&snl, 0, sizeof snl);
+  snl.nl_family = AF_NETLINK;
+
+  memset (&req, 0, sizeof req);
+  req.n.nlmsg_len = sizeof req;
+  req.n.nlmsg_type = RTM_GETNEXTHOP;
+  req.n.nlmsg_flags = NLM_F_DUMP | NLM_F_REQUEST;
+  req.n.nlmsg_pid = netlink_cmd.snl.nl_pid;
+  req.n.nlmsg_seq = ++netlink_cmd.seq;
+
+  if (zserv_privs.change (ZPRIVS_RAISE))
+    zlog (NULL, LOG_ERR, "Can't raise privileges");
+  ret = sendto (netlink_cmd.sock, (void *) &req, sizeof req, 0,
+		(struct sockaddr *) &snl, sizeof snl);
+  save_errno = errno;
+  if (zserv_privs.change (ZPRIVS_LOWER))
+    zlog (NULL, LOG_ERR, "Can't lower privileges");
+
+  if (ret < 0)
+    {
+      zlog (NULL, LOG_ERR, "%s sendto failed: %s", netlink_cmd.name,
+	    safe_strerror (save_errno));
+      return -1;
+    }
+  return netlink_parse_info (netlink_nexthop_table, &netlink_cmd);
+}
+
+/* Use nexthop objects if the kernel has them, and hear when it removes
+   any of ours. */
+static void
+netlink_nexthop_init (void)
+{
+  int group = RTNLGRP_NEXTHOP;
+
+  if (netlink_nexthop_read () < 0)
+    {
+      zlog_warn ("Kernel has no nexthop objects, not using them");
+      return;
+    }
+
+  if (setsockopt (netlink.sock, SOL_NETLINK, NETLINK_ADD_MEMBERSHIP,
+		  &group, sizeof group) < 0)
+    {
+      zlog_warn ("Can't listen to kernel nexthop objects, "
+		 "not using them: %s", safe_strerror (errno));
+      return;
+    }
+
+  rib_nhobj_enable (netlink_nexthop_max_id + 1);
+  zlog_info ("Installing routes over kernel nexthop objects");
+}
+#endif /* RTM_NEWNEXTHOP */
+
 static int
 netlink_information_fetch (struct sockaddr_nl *snl, struct nlmsghdr *h)
 {
@@ -1165,6 +1870,12 @@ netlink_information_fetch (struct sockaddr_nl *snl, struct nlmsghdr *h)
     case RTM_DELADDR:
       return netlink_interface_addr (snl, h);
       break;
+#ifdef RTM_NEWNEXTHOP
+    case RTM_NEWNEXTHOP:
+      return 0;
+    case RTM_DELNEXTHOP:
+      return netlink_nexthop_change (snl, h);
+#endif /* RTM_NEWNEXTHOP */
     default:
       zlog_warn ("Unknown netlink nlmsg_type %d\n", h->nlmsg_type);
       break;
@@ -1172,6 +1883,110 @@ netlink_information_fetch (struct sockaddr_nl *snl, struct nlmsghdr *h)
   return 0;
 }
 
+#ifdef HAVE_PROC_NET_DEV
+/* Statistics of an interface, from the IFLA_STATS64 of a link message,
+   or the 32 bit IFLA_STATS of older kernels. */
+static int
+netlink_interface_stats (struct sockaddr_nl *snl, struct nlmsghdr *h)
+{
+  int len;
+  struct ifinfomsg *ifi;
+  struct rtattr *tb[IFLA_MAX + 1];
+  struct interface *ifp;
+
+  if (h->nlmsg_type != RTM_NEWLINK)
+    return 0;
+
+  ifi = NLMSG_DATA (h);
+  len = h->nlmsg_len - NLMSG_LENGTH (sizeof (struct ifinfomsg));
+  if (len < 0)
+    return -1;
+
+  if ((ifp = if_lookup_by_index (ifi->ifi_index)) == NULL)
+    return 0;
+
+  memset (tb, 0, sizeof tb);
+  netlink_parse_rtattr (tb, IFLA_MAX, IFLA_RTA (ifi), len);
+
+#define NL_IFSTAT_COPY(st)						\
+  do {									\
+    ifp->stats.rx_packets = (st)->rx_packets;				\
+    ifp->stats.tx_packets = (st)->tx_packets;				\
+    ifp->stats.rx_bytes = (st)->rx_bytes;				\
+    ifp->stats.tx_bytes = (st)->tx_bytes;				\
+    ifp->stats.rx_errors = (st)->rx_errors;				\
+    ifp->stats.tx_errors = (st)->tx_errors;				\
+    ifp->stats.rx_dropped = (st)->rx_dropped;				\
+    ifp->stats.tx_dropped = (st)->tx_dropped;				\
+    ifp->stats.rx_multicast = (st)->multicast;				\
+    ifp->stats.rx_compressed = (st)->rx_compressed;			\
+    ifp->stats.tx_compressed = (st)->tx_compressed;			\
+    ifp->stats.collisions = (st)->collisions;				\
+    ifp->stats.rx_length_errors = (st)->rx_length_errors;		\
+    ifp->stats.rx_over_errors = (st)->rx_over_errors;			\
+    ifp->stats.rx_crc_errors = (st)->rx_crc_errors;			\
+    ifp->stats.rx_frame_errors = (st)->rx_frame_errors;			\
+    ifp->stats.rx_fifo_errors = (st)->rx_fifo_errors;			\
+    ifp->stats.rx_missed_errors = (st)->rx_missed_errors;		\
+    ifp->stats.tx_aborted_errors = (st)->tx_aborted_errors;		\
+    ifp->stats.tx_carrier_errors = (st)->tx_carrier_errors;		\
+    ifp->stats.tx_fifo_errors = (st)->tx_fifo_errors;			\
+    ifp->stats.tx_heartbeat_errors = (st)->tx_heartbeat_errors;		\
+    ifp->stats.tx_window_errors = (st)->tx_window_errors;		\
+  } while (0)
+
+  if (tb[IFLA_STATS64]
+      && RTA_PAYLOAD (tb[IFLA_STATS64]) >= sizeof (struct rtnl_link_stats64))
+    {
+      struct rtnl_link_stats64 st;
+
+      /* The attribute is only 4 byte aligned. */
+      memcpy (&st, RTA_DATA (tb[IFLA_STATS64]), sizeof st);
+      NL_IFSTAT_COPY (&st);
+      return 0;
+    }
+  if (tb[IFLA_STATS]
+      && RTA_PAYLOAD (tb[IFLA_STATS]) >= sizeof (struct rtnl_link_stats))
+    NL_IFSTAT_COPY ((struct rtnl_link_stats *) RTA_DATA (tb[IFLA_STATS]));
+
+#undef NL_IFSTAT_COPY
+  return 0;
+}
+
+/* Update the statistics of an interface, or of all of them with one
+   dump, from the kernel's binary link messages. */
+void
+ifstat_update_netlink (struct interface *ifp)
+{
+  struct
+  {
+    struct nlmsghdr n;
+    struct ifinfomsg ifi;
+  } req;
+
+  if (ifp && ifp->ifindex == IFINDEX_INTERNAL)
+    return;
+
+  if (! ifp)
+    {
+      if (netlink_request (AF_PACKET, RTM_GETLINK, &netlink_cmd) < 0)
+	return;
+    }
+  else
+    {
+      memset (&req, 0, sizeof req);
+      req.n.nlmsg_len = NLMSG_LENGTH (sizeof (struct ifinfomsg));
+      req.n.nlmsg_type = RTM_GETLINK;
+      req.n.nlmsg_flags = NLM_F_REQUEST | NLM_F_ACK;
+      req.ifi.ifi_family = AF_UNSPEC;
+      req.ifi.ifi_index = ifp->ifindex;
+      if (netlink_request_send (&req.n, &netlink_cmd) < 0)
+	return;
+    }
+  netlink_parse_info (netlink_interface_stats, &netlink_cmd);
+}
+#endif /* HAVE_PROC_NET_DEV */
+
 /* Interface lookup by netlink socket. */
 int
 interface_lookup_netlink (void)
@@ -1207,32 +2022,38 @@ interface_lookup_netlink (void)
   return 0;
 }
 
+static int
+netlink_route_dump (int family)
+{
+  int ret;
+
+  ret = netlink_request (family, RTM_GETROUTE, &netlink_cmd);
+  if (ret < 0)
+    return ret;
+  return netlink_parse_info (netlink_routing_table, &netlink_cmd);
+}
+
 /* Routing table read function using netlink interface.  Only called
-   bootstrap time. */
+   bootstrap time.  The routes are only linked in as they are read,
+   best-path selection runs over all of them afterwards. */
 int
 netlink_route_read (void)
 {
   int ret;
 
+  rib_bulk_start ();
+
   /* Get IPv4 routing table. */
-  ret = netlink_request (AF_INET, RTM_GETROUTE, &netlink_cmd);
-  if (ret < 0)
-    return ret;
-  ret = netlink_parse_info (netlink_routing_table, &netlink_cmd);
-  if (ret < 0)
-    return ret;
+  ret = netlink_route_dump (AF_INET);
 
 #ifdef HAVE_IPV6
   /* Get IPv6 routing table. */
-  ret = netlink_request (AF_INET6, RTM_GETROUTE, &netlink_cmd);
-  if (ret < 0)
-    return ret;
-  ret = netlink_parse_info (netlink_routing_table, &netlink_cmd);
-  if (ret < 0)
-    return ret;
+  if (ret >= 0)
+    ret = netlink_route_dump (AF_INET6);
 #endif /* HAVE_IPV6 */
 
-  return 0;
+  rib_bulk_finish ();
+  return ret < 0 ? ret : 0;
 }
 
 /* Utility function  comes from iproute2. 
@@ -1316,6 +2137,8 @@ netlink_talk (struct nlmsghdr *n, struct nlsock *nl)
   struct msghdr msg = { (void *) &snl, sizeof snl, &iov, 1, NULL, 0, 0 };
   int save_errno;
 
+  netlink_batch_sync (nl);
+
   memset (&snl, 0, sizeof snl);
   snl.nl_family = AF_NETLINK;
 
@@ -1324,6 +2147,8 @@ netlink_talk (struct nlmsghdr *n, struct nlsock *nl)
   /* Request an acknowledgement by setting NLM_F_ACK */
   n->nlmsg_flags |= NLM_F_ACK;
 
+  QUAGGA_TRACE (zebra, netlink_talk_entry, nl->name, n->nlmsg_type,
+		n->nlmsg_seq);
   if (IS_ZEBRA_DEBUG_KERNEL)
     zlog_debug ("netlink_talk: %s type %s(%u), seq=%u", nl->name,
                lookup (nlmsg_str, n->nlmsg_type), n->nlmsg_type,
@@ -1349,7 +2174,10 @@ netlink_talk (struct nlmsghdr *n, struct nlsock *nl)
    * Get reply from netlink socket. 
    * The reply should either be an acknowlegement or an error.
    */
-  return netlink_parse_info (netlink_talk_filter, nl);
+  status = netlink_parse_info (netlink_talk_filter, nl);
+  QUAGGA_TRACE (zebra, netlink_talk_exit, nl->name, n->nlmsg_type,
+		n->nlmsg_seq, status);
+  return status;
 }
 
 /* Routing table change via netlink interface. */
@@ -1436,6 +2264,9 @@ netlink_route_multipath (int cmd, struct prefix *p, struct rib *rib,
   struct nexthop *nexthop = NULL;
   int nexthop_num = 0;
   int discard;
+#ifdef RTM_NEWNEXTHOP
+  u_int32_t nhid;
+#endif /* RTM_NEWNEXTHOP */
 
   struct
   {
@@ -1490,6 +2321,44 @@ netlink_route_multipath (int cmd, struct prefix *p, struct rib *rib,
       goto skip;
     }
 
+#ifdef RTM_NEWNEXTHOP
+  /* Over a nexthop object, which has the paths. */
+  if ((nhid = rib_nhobj_id (rib)) != 0)
+    {
+      union g_addr *src = NULL;
+
+      for (nexthop = rib->nexthop; nexthop; nexthop = nexthop->next)
+        if ((cmd == RTM_NEWROUTE
+             && CHECK_FLAG (nexthop->flags, NEXTHOP_FLAG_ACTIVE))
+            || (cmd == RTM_DELROUTE
+                && CHECK_FLAG (nexthop->flags, NEXTHOP_FLAG_FIB)))
+          {
+            if (! src && family == AF_INET && nexthop->src.ipv4.s_addr)
+              src = &nexthop->src;
+            if (cmd == RTM_NEWROUTE)
+              SET_FLAG (nexthop->flags, NEXTHOP_FLAG_FIB);
+            nexthop_num++;
+          }
+      if (nexthop_num == 0)
+        return 0;
+
+      if (IS_ZEBRA_DEBUG_KERNEL)
+        {
+          char buf[INET6_ADDRSTRLEN];
+
+          zlog_debug ("netlink_route_multipath() (nexthop object): "
+                      "%s %s/%d, id %u", lookup (nlmsg_str, cmd),
+                      inet_ntop (family, &p->u.prefix, buf, sizeof buf),
+                      p->prefixlen, nhid);
+        }
+
+      addattr32 (&req.n, sizeof req, RTA_NH_ID, nhid);
+      if (src)
+        addattr_l (&req.n, sizeof req, RTA_PREFSRC, &src->ipv4, bytelen);
+      goto skip;
+    }
+#endif /* RTM_NEWNEXTHOP */
+
   /* Multipath case. */
   if (rib->nexthop_active_num == 1 || MULTIPATH_NUM == 1)
     {
@@ -1849,7 +2718,13 @@ skip:
   memset (&snl, 0, sizeof snl);
   snl.nl_family = AF_NETLINK;
 
-  /* Talk to netlink socket. */
+  /* Talk to netlink socket.  A batched add is answered later. */
+  if (nl_batchsize)
+    {
+      if (netlink_batch_add (&req.n, p, rib) < 0)
+	return -1;
+      return cmd == RTM_NEWROUTE ? 1 : 0;
+    }
   return netlink_talk (&req.n, &netlink_cmd);
 }
 
@@ -1865,6 +2740,104 @@ kernel_delete_ipv4 (struct prefix *p, struct rib *rib)
   return netlink_route_multipath (RTM_DELROUTE, p, rib, AF_INET);
 }
 
+/* Create a nexthop object for a gateway, or without replace, or change
+   the path of the one there. */
+int
+kernel_nexthop_add (u_int32_t id, int family, union g_addr *gate,
+		    unsigned int ifindex, int replace)
+{
+#ifdef RTM_NEWNEXTHOP
+  struct
+  {
+    struct nlmsghdr n;
+    struct nhmsg nhm;
+    char buf[256];
+  } req;
+
+  memset (&req, 0, sizeof req);
+  req.n.nlmsg_len = NLMSG_LENGTH (sizeof (struct nhmsg));
+  req.n.nlmsg_flags = NLM_F_CREATE | NLM_F_REQUEST;
+  if (replace)
+    req.n.nlmsg_flags |= NLM_F_REPLACE;
+  else
+    req.n.nlmsg_flags |= NLM_F_EXCL;
+  req.n.nlmsg_type = RTM_NEWNEXTHOP;
+  req.nhm.nh_family = family;
+  req.nhm.nh_protocol = RTPROT_ZEBRA;
+
+  addattr32 (&req.n, sizeof req, NHA_ID, id);
+  addattr32 (&req.n, sizeof req, NHA_OIF, ifindex);
+  if (gate)
+    addattr_l (&req.n, sizeof req, NHA_GATEWAY, gate,
+	       family == AF_INET ? 4 : 16);
+
+  return netlink_talk (&req.n, &netlink_cmd);
+#else
+  return -1;
+#endif /* RTM_NEWNEXTHOP */
+}
+
+/* Create a nexthop object spreading traffic over others. */
+int
+kernel_nexthop_group_add (u_int32_t id, u_int32_t *member, int count)
+{
+#ifdef RTM_NEWNEXTHOP
+  struct
+  {
+    struct nlmsghdr n;
+    struct nhmsg nhm;
+    char buf[NL_PKT_BUF_SIZE];
+  } req;
+  struct nexthop_grp grp[count];
+  int i;
+
+  memset (&req, 0, sizeof req - NL_PKT_BUF_SIZE);
+  req.n.nlmsg_len = NLMSG_LENGTH (sizeof (struct nhmsg));
+  req.n.nlmsg_flags = NLM_F_CREATE | NLM_F_EXCL | NLM_F_REQUEST;
+  req.n.nlmsg_type = RTM_NEWNEXTHOP;
+  req.nhm.nh_family = AF_UNSPEC;
+  req.nhm.nh_protocol = RTPROT_ZEBRA;
+
+  memset (grp, 0, sizeof grp);
+  for (i = 0; i < count; i++)
+    grp[i].id = member[i];
+
+  addattr32 (&req.n, sizeof req, NHA_ID, id);
+  addattr_l (&req.n, sizeof req, NHA_GROUP, grp, sizeof grp);
+
+  return netlink_talk (&req.n, &netlink_cmd);
+#else
+  return -1;
+#endif /* RTM_NEWNEXTHOP */
+}
+
+/* Remove a nexthop object; the kernel takes routes still over it
+   along. */
+int
+kernel_nexthop_delete (u_int32_t id)
+{
+#ifdef RTM_NEWNEXTHOP
+  struct
+  {
+    struct nlmsghdr n;
+    struct nhmsg nhm;
+    char buf[64];
+  } req;
+
+  memset (&req, 0, sizeof req);
+  req.n.nlmsg_len = NLMSG_LENGTH (sizeof (struct nhmsg));
+  req.n.nlmsg_flags = NLM_F_REQUEST;
+  req.n.nlmsg_type = RTM_DELNEXTHOP;
+  req.nhm.nh_family = AF_UNSPEC;
+
+  addattr32 (&req.n, sizeof req, NHA_ID, id);
+
+  return netlink_talk (&req.n, &netlink_cmd);
+#else
+  return -1;
+#endif /* RTM_NEWNEXTHOP */
+}
+
 #ifdef HAVE_IPV6
 int
 kernel_add_ipv6 (struct prefix *p, struct rib *rib)
@@ -2023,6 +2996,20 @@ kernel_init (void)
       netlink_install_filter (netlink.sock, netlink_cmd.snl.nl_pid);
       thread_add_read (zebrad.master, kernel_read, NULL, netlink.sock);
     }
+
+#ifdef RTM_NEWNEXTHOP
+  if (nl_nexthops)
+    netlink_nexthop_init ();
+#else
+  if (nl_nexthops)
+    zlog_warn ("Kernel nexthop objects not supported by this build");
+#endif /* RTM_NEWNEXTHOP */
+
+  if (nl_batchsize)
+    atexit (netlink_batch_exit);
+
+  install_element (VIEW_NODE, &show_zebra_kernel_stats_cmd);
+  install_element (ENABLE_NODE, &show_zebra_kernel_stats_cmd);
 }
 
 /*
@@ -256,6 +256,26 @@ kernel_delete_ipv4 (struct prefix *p, struct rib *rib)
   return route;
 }
 
+/* No nexthop objects, see rt_netlink.c. */
+int
+kernel_nexthop_add (u_int32_t id, int family, union g_addr *gate,
+		    unsigned int ifindex, int replace)
+{
+  return -1;
+}
+
+int
+kernel_nexthop_group_add (u_int32_t id, u_int32_t *member, int count)
+{
+  return -1;
+}
+
+int
+kernel_nexthop_delete (u_int32_t id)
+{
+  return -1;
+}
+
 #ifdef HAVE_IPV6
 
 /* Calculate sin6_len value for netmask socket value. */
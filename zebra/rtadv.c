@@ -31,6 +31,7 @@
 #include "linklist.h"
 #include "command.h"
 #include "privs.h"
+#include "wheel.h"
 
 #include "zebra/interface.h"
 #include "zebra/rtadv.h"
@@ -59,8 +60,7 @@ extern struct zebra_privs_t zserv_privs;
 
 extern struct zebra_t zebrad;
 
-enum rtadv_event {RTADV_START, RTADV_STOP, RTADV_TIMER, 
-		  RTADV_TIMER_MSEC, RTADV_READ};
+enum rtadv_event {RTADV_START, RTADV_STOP, RTADV_TIMER_MSEC, RTADV_READ};
 
 static void rtadv_event (enum rtadv_event, int);
 
@@ -73,9 +73,15 @@ struct rtadv
   int sock;
 
   int adv_if_count;
-  int adv_msec_if_count;
 
   struct thread *ra_read;
+
+  /* Unsolicited advertisements.  The interfaces with an interval of
+     whole seconds wait on the wheel, one tick sending those due in that
+     second, and the others are on msec_ifs, walked every 10 ms by
+     ra_timer while there are any. */
+  struct wheel *wheel;
+  struct list *msec_ifs;
   struct thread *ra_timer;
 };
 
@@ -84,7 +90,18 @@ struct rtadv *rtadv = NULL;
 static struct rtadv *
 rtadv_new (void)
 {
-  return XCALLOC (MTYPE_TMP, sizeof (struct rtadv));
+  struct rtadv *new;
+
+  new = XCALLOC (MTYPE_TMP, sizeof (struct rtadv));
+  new->msec_ifs = list_new ();
+  return new;
+}
+
+/* The advertisement of the interface is to be built again. */
+static void
+rtadv_packet_reset (struct zebra_if *zif)
+{
+  zif->rtadv.ra_len = 0;
 }
 
 static int
@@ -142,59 +159,24 @@ rtadv_recv_packet (int sock, u_char *buf, int buflen,
 
 #define RTADV_MSG_SIZE 4096
 
-/* Send router advertisement packet. */
-static void
-rtadv_send_packet (int sock, struct interface *ifp)
+/* Build the router advertisement of ifp into buf and return its length.
+   The offset of the address in the link-layer address option goes in
+   lladdr, 0 without the option. */
+static int
+rtadv_build_packet (struct interface *ifp, u_char *buf, int *lladdr)
 {
-  struct msghdr msg;
-  struct iovec iov;
-  struct cmsghdr  *cmsgptr;
-  struct in6_pktinfo *pkt;
-  struct sockaddr_in6 addr;
 #ifdef HAVE_STRUCT_SOCKADDR_DL
   struct sockaddr_dl *sdl;
 #endif /* HAVE_STRUCT_SOCKADDR_DL */
-  static void *adata = NULL;
-  unsigned char buf[RTADV_MSG_SIZE];
   struct nd_router_advert *rtadv;
-  int ret;
   int len = 0;
   struct zebra_if *zif;
   struct rtadv_prefix *rprefix;
-  u_char all_nodes_addr[] = {0xff,0x02,0,0,0,0,0,0,0,0,0,0,0,0,0,1};
   struct listnode *node;
   u_int16_t pkt_RouterLifetime;
 
-  /*
-   * Allocate control message bufffer.  This is dynamic because
-   * CMSG_SPACE is not guaranteed not to call a function.  Note that
-   * the size will be different on different architectures due to
-   * differing alignment rules.
-   */
-  if (adata == NULL)
-    {
-      /* XXX Free on shutdown. */
-      adata = malloc(CMSG_SPACE(sizeof(struct in6_pktinfo)));
-	   
-      if (adata == NULL)
-	zlog_err("rtadv_send_packet: can't malloc control data\n");
-    }
-
-  /* Logging of packet. */
-  if (IS_ZEBRA_DEBUG_PACKET)
-    zlog_debug ("Router advertisement send to %s", ifp->name);
-
-  /* Fill in sockaddr_in6. */
-  memset (&addr, 0, sizeof (struct sockaddr_in6));
-  addr.sin6_family = AF_INET6;
-#ifdef SIN6_LEN
-  addr.sin6_len = sizeof (struct sockaddr_in6);
-#endif /* SIN6_LEN */
-  addr.sin6_port = htons (IPPROTO_ICMPV6);
-  IPV6_ADDR_COPY (&addr.sin6_addr, all_nodes_addr);
-
-  /* Fetch interface information. */
   zif = ifp->info;
+  *lladdr = 0;
 
   /* Make router advertisement message. */
   rtadv = (struct nd_router_advert *) buf;
@@ -323,6 +305,7 @@ rtadv_send_packet (int sock, struct interface *ifp)
          the link address does not end on an octet boundary. */
       buf[len++] = (sdl->sdl_alen + 9) >> 3;
 
+      *lladdr = len;
       memcpy (buf + len, LLADDR (sdl), sdl->sdl_alen);
       len += sdl->sdl_alen;
 
@@ -339,6 +322,7 @@ rtadv_send_packet (int sock, struct interface *ifp)
          the link address does not end on an octet boundary. */
       buf[len++] = (ifp->hw_addr_len + 9) >> 3;
 
+      *lladdr = len;
       memcpy (buf + len, ifp->hw_addr, ifp->hw_addr_len);
       len += ifp->hw_addr_len;
 
@@ -359,6 +343,80 @@ rtadv_send_packet (int sock, struct interface *ifp)
       len += sizeof (struct nd_opt_mtu);
     }
 
+  return len;
+}
+
+/* Send the router advertisement of ifp.  It is built again only after
+   its configuration changed, see rtadv_packet_reset(), or if the
+   link-layer address changed size; otherwise only that address is
+   written over the packet last built. */
+static void
+rtadv_send_packet (int sock, struct interface *ifp)
+{
+  struct msghdr msg;
+  struct iovec iov;
+  struct cmsghdr  *cmsgptr;
+  struct in6_pktinfo *pkt;
+  struct sockaddr_in6 addr;
+  static void *adata = NULL;
+  int ret;
+  struct zebra_if *zif;
+  struct rtadvconf *conf;
+  const u_char *hw_addr;
+  int hw_addr_len;
+  u_char all_nodes_addr[] = {0xff,0x02,0,0,0,0,0,0,0,0,0,0,0,0,0,1};
+
+  /*
+   * Allocate control message bufffer.  This is dynamic because
+   * CMSG_SPACE is not guaranteed not to call a function.  Note that
+   * the size will be different on different architectures due to
+   * differing alignment rules.
+   */
+  if (adata == NULL)
+    {
+      /* XXX Free on shutdown. */
+      adata = malloc(CMSG_SPACE(sizeof(struct in6_pktinfo)));
+	   
+      if (adata == NULL)
+	zlog_err("rtadv_send_packet: can't malloc control data\n");
+    }
+
+  /* Logging of packet. */
+  if (IS_ZEBRA_DEBUG_PACKET)
+    zlog_debug ("Router advertisement send to %s", ifp->name);
+
+  /* Fill in sockaddr_in6. */
+  memset (&addr, 0, sizeof (struct sockaddr_in6));
+  addr.sin6_family = AF_INET6;
+#ifdef SIN6_LEN
+  addr.sin6_len = sizeof (struct sockaddr_in6);
+#endif /* SIN6_LEN */
+  addr.sin6_port = htons (IPPROTO_ICMPV6);
+  IPV6_ADDR_COPY (&addr.sin6_addr, all_nodes_addr);
+
+  /* Fetch interface information. */
+  zif = ifp->info;
+  conf = &zif->rtadv;
+
+#ifdef HAVE_STRUCT_SOCKADDR_DL
+  hw_addr = (const u_char *) LLADDR (&ifp->sdl);
+  hw_addr_len = ifp->sdl.sdl_alen;
+#else
+  hw_addr = ifp->hw_addr;
+  hw_addr_len = ifp->hw_addr_len;
+#endif /* HAVE_STRUCT_SOCKADDR_DL */
+
+  if (conf->ra_packet == NULL)
+    conf->ra_packet = XMALLOC (MTYPE_RTADV_PACKET, RTADV_MSG_SIZE);
+  if (conf->ra_len == 0 || conf->ra_lladdr_len != hw_addr_len)
+    {
+      conf->ra_len = rtadv_build_packet (ifp, conf->ra_packet,
+					 &conf->ra_lladdr);
+      conf->ra_lladdr_len = hw_addr_len;
+    }
+  else if (conf->ra_lladdr)
+    memcpy (conf->ra_packet + conf->ra_lladdr, hw_addr, hw_addr_len);
+
   msg.msg_name = (void *) &addr;
   msg.msg_namelen = sizeof (struct sockaddr_in6);
   msg.msg_iov = &iov;
@@ -366,8 +424,8 @@ rtadv_send_packet (int sock, struct interface *ifp)
   msg.msg_control = (void *) adata;
   msg.msg_controllen = CMSG_SPACE(sizeof(struct in6_pktinfo));
   msg.msg_flags = 0;
-  iov.iov_base = buf;
-  iov.iov_len = len;
+  iov.iov_base = conf->ra_packet;
+  iov.iov_len = conf->ra_len;
 
   cmsgptr = ZCMSG_FIRSTHDR(&msg);
   cmsgptr->cmsg_len = CMSG_LEN(sizeof(struct in6_pktinfo));
@@ -386,48 +444,81 @@ rtadv_send_packet (int sock, struct interface *ifp)
     }
 }
 
+static int
+rtadv_adv_timer (struct wheel_timer *timer)
+{
+  struct interface *ifp = WHEEL_ARG (timer);
+  struct zebra_if *zif = ifp->info;
+
+  /* Looked at again every second until the interface is up. */
+  if (if_is_loopback (ifp) || ! if_is_operative (ifp))
+    {
+      wheel_timer_on (rtadv->wheel, timer, rtadv_adv_timer, ifp, 1);
+      return 0;
+    }
+
+  /* FIXME: using MaxRtrAdvInterval each time isn't what section
+     6.2.4 of RFC4861 tells to do. */
+  wheel_timer_on (rtadv->wheel, timer, rtadv_adv_timer, ifp,
+		  zif->rtadv.MaxRtrAdvInterval / 1000);
+  rtadv_send_packet (rtadv->sock, ifp);
+  return 0;
+}
+
 static int
 rtadv_timer (struct thread *thread)
 {
   struct listnode *node, *nnode;
   struct interface *ifp;
   struct zebra_if *zif;
-  int period;
+  int period = 10; /* 10 ms */
 
   rtadv->ra_timer = NULL;
-  if (rtadv->adv_msec_if_count == 0)
-    {
-      period = 1000; /* 1 s */
-      rtadv_event (RTADV_TIMER, 1 /* 1 s */);
-    } 
-  else
-    {
-      period = 10; /* 10 ms */
-      rtadv_event (RTADV_TIMER_MSEC, 10 /* 10 ms */);
-    }
+  if (listcount (rtadv->msec_ifs))
+    rtadv_event (RTADV_TIMER_MSEC, period);
 
-  for (ALL_LIST_ELEMENTS (iflist, node, nnode, ifp))
+  for (ALL_LIST_ELEMENTS (rtadv->msec_ifs, node, nnode, ifp))
     {
       if (if_is_loopback (ifp) || ! if_is_operative (ifp))
 	continue;
 
       zif = ifp->info;
 
-      if (zif->rtadv.AdvSendAdvertisements)
-	{ 
-	  zif->rtadv.AdvIntervalTimer -= period;
-	  if (zif->rtadv.AdvIntervalTimer <= 0)
-	    {
-	      /* FIXME: using MaxRtrAdvInterval each time isn't what section
-	         6.2.4 of RFC4861 tells to do. */
-	      zif->rtadv.AdvIntervalTimer = zif->rtadv.MaxRtrAdvInterval;
-	      rtadv_send_packet (rtadv->sock, ifp);
-	    }
+      zif->rtadv.AdvIntervalTimer -= period;
+      if (zif->rtadv.AdvIntervalTimer <= 0)
+	{
+	  zif->rtadv.AdvIntervalTimer = zif->rtadv.MaxRtrAdvInterval;
+	  rtadv_send_packet (rtadv->sock, ifp);
 	}
     }
   return 0;
 }
 
+/* Schedule the first unsolicited advertisement of ifp for the next
+   tick, or none if it is not to send any. */
+static void
+rtadv_schedule (struct interface *ifp)
+{
+  struct zebra_if *zif = ifp->info;
+
+  if (rtadv->wheel)
+    wheel_timer_off (rtadv->wheel, &zif->rtadv.t_adv);
+  listnode_delete (rtadv->msec_ifs, ifp);
+  zif->rtadv.AdvIntervalTimer = 0;
+
+  if (! zif->rtadv.AdvSendAdvertisements)
+    return;
+
+  if (zif->rtadv.MaxRtrAdvInterval % 1000)
+    {
+      listnode_add (rtadv->msec_ifs, ifp);
+      rtadv_event (RTADV_TIMER_MSEC, 10 /* 10 ms */);
+    }
+  else
+    wheel_timer_on (rtadv->wheel, &zif->rtadv.t_adv, rtadv_adv_timer,
+		    ifp, 0);
+}
+
 static void
 rtadv_process_solicit (struct interface *ifp)
 {
@@ -634,6 +725,7 @@ rtadv_prefix_set (struct zebra_if *zif, struct rtadv_prefix *rp)
   rprefix->AdvOnLinkFlag = rp->AdvOnLinkFlag;
   rprefix->AdvAutonomousFlag = rp->AdvAutonomousFlag;
   rprefix->AdvRouterAddressFlag = rp->AdvRouterAddressFlag;
+  rtadv_packet_reset (zif);
 }
 
 static int
@@ -646,6 +738,7 @@ rtadv_prefix_reset (struct zebra_if *zif, struct rtadv_prefix *rp)
     {
       listnode_delete (zif->rtadv.AdvPrefixList, (void *) rprefix);
       rtadv_prefix_free (rprefix);
+      rtadv_packet_reset (zif);
       return 1;
     }
   else
@@ -674,7 +767,7 @@ DEFUN (ipv6_nd_suppress_ra,
   if (zif->rtadv.AdvSendAdvertisements)
     {
       zif->rtadv.AdvSendAdvertisements = 0;
-      zif->rtadv.AdvIntervalTimer = 0;
+      rtadv_schedule (ifp);
       rtadv->adv_if_count--;
 
       if_leave_all_router (rtadv->sock, ifp);
@@ -709,13 +802,13 @@ DEFUN (no_ipv6_nd_suppress_ra,
   if (! zif->rtadv.AdvSendAdvertisements)
     {
       zif->rtadv.AdvSendAdvertisements = 1;
-      zif->rtadv.AdvIntervalTimer = 0;
       rtadv->adv_if_count++;
 
       if_join_all_router (rtadv->sock, ifp);
 
       if (rtadv->adv_if_count == 1)
 	rtadv_event (RTADV_START, rtadv->sock);
+      rtadv_schedule (ifp);
     }
 
   return CMD_SUCCESS;
@@ -740,15 +833,10 @@ DEFUN (ipv6_nd_ra_interval_msec,
     return CMD_WARNING;
   }
 
-  if (zif->rtadv.MaxRtrAdvInterval % 1000)
-    rtadv->adv_msec_if_count--;
-
-  if (interval % 1000)
-    rtadv->adv_msec_if_count++;
-  
   zif->rtadv.MaxRtrAdvInterval = interval;
   zif->rtadv.MinRtrAdvInterval = 0.33 * interval;
-  zif->rtadv.AdvIntervalTimer = 0;
+  rtadv_schedule (ifp);
+  rtadv_packet_reset (zif);
 
   return CMD_SUCCESS;
 }
@@ -772,15 +860,13 @@ DEFUN (ipv6_nd_ra_interval,
     return CMD_WARNING;
   }
 
-  if (zif->rtadv.MaxRtrAdvInterval % 1000)
-    rtadv->adv_msec_if_count--;
-	
   /* convert to milliseconds */
   interval = interval * 1000; 
 	
   zif->rtadv.MaxRtrAdvInterval = interval;
   zif->rtadv.MinRtrAdvInterval = 0.33 * interval;
-  zif->rtadv.AdvIntervalTimer = 0;
+  rtadv_schedule (ifp);
+  rtadv_packet_reset (zif);
 
   return CMD_SUCCESS;
 }
@@ -799,12 +885,10 @@ DEFUN (no_ipv6_nd_ra_interval,
   ifp = (struct interface *) vty->index;
   zif = ifp->info;
 
-  if (zif->rtadv.MaxRtrAdvInterval % 1000)
-    rtadv->adv_msec_if_count--;
-  
   zif->rtadv.MaxRtrAdvInterval = RTADV_MAX_RTR_ADV_INTERVAL;
   zif->rtadv.MinRtrAdvInterval = RTADV_MIN_RTR_ADV_INTERVAL;
-  zif->rtadv.AdvIntervalTimer = zif->rtadv.MaxRtrAdvInterval;
+  rtadv_schedule (ifp);
+  rtadv_packet_reset (zif);
 
   return CMD_SUCCESS;
 }
@@ -855,6 +939,8 @@ DEFUN (ipv6_nd_ra_lifetime,
 
   zif->rtadv.AdvDefaultLifetime = lifetime;
 
+  rtadv_packet_reset (zif);
+
   return CMD_SUCCESS;
 }
 
@@ -874,6 +960,8 @@ DEFUN (no_ipv6_nd_ra_lifetime,
 
   zif->rtadv.AdvDefaultLifetime = -1;
 
+  rtadv_packet_reset (zif);
+
   return CMD_SUCCESS;
 }
 
@@ -897,6 +985,7 @@ DEFUN (ipv6_nd_reachable_time,
   struct interface *ifp = (struct interface *) vty->index;
   struct zebra_if *zif = ifp->info;
   VTY_GET_INTEGER_RANGE ("reachable time", zif->rtadv.AdvReachableTime, argv[0], 1, RTADV_MAX_REACHABLE_TIME);
+  rtadv_packet_reset (zif);
   return CMD_SUCCESS;
 }
 
@@ -916,6 +1005,8 @@ DEFUN (no_ipv6_nd_reachable_time,
 
   zif->rtadv.AdvReachableTime = 0;
 
+  rtadv_packet_reset (zif);
+
   return CMD_SUCCESS;
 }
 
@@ -939,6 +1030,7 @@ DEFUN (ipv6_nd_homeagent_preference,
   struct interface *ifp = (struct interface *) vty->index;
   struct zebra_if *zif = ifp->info;
   VTY_GET_INTEGER_RANGE ("home agent preference", zif->rtadv.HomeAgentPreference, argv[0], 0, 65535);
+  rtadv_packet_reset (zif);
   return CMD_SUCCESS;
 }
 
@@ -958,6 +1050,8 @@ DEFUN (no_ipv6_nd_homeagent_preference,
 
   zif->rtadv.HomeAgentPreference = 0;
 
+  rtadv_packet_reset (zif);
+
   return CMD_SUCCESS;
 }
 
@@ -981,6 +1075,7 @@ DEFUN (ipv6_nd_homeagent_lifetime,
   struct interface *ifp = (struct interface *) vty->index;
   struct zebra_if *zif = ifp->info;
   VTY_GET_INTEGER_RANGE ("home agent lifetime", zif->rtadv.HomeAgentLifetime, argv[0], 0, RTADV_MAX_HALIFETIME);
+  rtadv_packet_reset (zif);
   return CMD_SUCCESS;
 }
 
@@ -1000,6 +1095,8 @@ DEFUN (no_ipv6_nd_homeagent_lifetime,
 
   zif->rtadv.HomeAgentLifetime = -1;
 
+  rtadv_packet_reset (zif);
+
   return CMD_SUCCESS;
 }
 
@@ -1027,6 +1124,8 @@ DEFUN (ipv6_nd_managed_config_flag,
 
   zif->rtadv.AdvManagedFlag = 1;
 
+  rtadv_packet_reset (zif);
+
   return CMD_SUCCESS;
 }
 
@@ -1046,6 +1145,8 @@ DEFUN (no_ipv6_nd_managed_config_flag,
 
   zif->rtadv.AdvManagedFlag = 0;
 
+  rtadv_packet_reset (zif);
+
   return CMD_SUCCESS;
 }
 
@@ -1064,6 +1165,8 @@ DEFUN (ipv6_nd_homeagent_config_flag,
 
   zif->rtadv.AdvHomeAgentFlag = 1;
 
+  rtadv_packet_reset (zif);
+
   return CMD_SUCCESS;
 }
 
@@ -1083,6 +1186,8 @@ DEFUN (no_ipv6_nd_homeagent_config_flag,
 
   zif->rtadv.AdvHomeAgentFlag = 0;
 
+  rtadv_packet_reset (zif);
+
   return CMD_SUCCESS;
 }
 
@@ -1101,6 +1206,8 @@ DEFUN (ipv6_nd_adv_interval_config_option,
 
   zif->rtadv.AdvIntervalOption = 1;
 
+  rtadv_packet_reset (zif);
+
   return CMD_SUCCESS;
 }
 
@@ -1120,6 +1227,8 @@ DEFUN (no_ipv6_nd_adv_interval_config_option,
 
   zif->rtadv.AdvIntervalOption = 0;
 
+  rtadv_packet_reset (zif);
+
   return CMD_SUCCESS;
 }
 
@@ -1138,6 +1247,8 @@ DEFUN (ipv6_nd_other_config_flag,
 
   zif->rtadv.AdvOtherConfigFlag = 1;
 
+  rtadv_packet_reset (zif);
+
   return CMD_SUCCESS;
 }
 
@@ -1157,6 +1268,8 @@ DEFUN (no_ipv6_nd_other_config_flag,
 
   zif->rtadv.AdvOtherConfigFlag = 0;
 
+  rtadv_packet_reset (zif);
+
   return CMD_SUCCESS;
 }
 
@@ -1454,6 +1567,7 @@ DEFUN (ipv6_nd_router_preference,
       if (strncmp (argv[0], rtadv_pref_strs[i], 1) == 0)
 	{
 	  zif->rtadv.DefaultPreference = i;
+	  rtadv_packet_reset (zif);
 	  return CMD_SUCCESS;
 	}
       i++;
@@ -1478,6 +1592,8 @@ DEFUN (no_ipv6_nd_router_preference,
 
   zif->rtadv.DefaultPreference = RTADV_PREF_MEDIUM; /* Default per RFC4191. */
 
+  rtadv_packet_reset (zif);
+
   return CMD_SUCCESS;
 }
 
@@ -1503,6 +1619,7 @@ DEFUN (ipv6_nd_mtu,
   struct interface *ifp = (struct interface *) vty->index;
   struct zebra_if *zif = ifp->info;
   VTY_GET_INTEGER_RANGE ("MTU", zif->rtadv.AdvLinkMTU, argv[0], 1, 65535);
+  rtadv_packet_reset (zif);
   return CMD_SUCCESS;
 }
 
@@ -1517,6 +1634,7 @@ DEFUN (no_ipv6_nd_mtu,
   struct interface *ifp = (struct interface *) vty->index;
   struct zebra_if *zif = ifp->info;
   zif->rtadv.AdvLinkMTU = 0;
+  rtadv_packet_reset (zif);
   return CMD_SUCCESS;
 }
 
@@ -1635,9 +1753,8 @@ rtadv_event (enum rtadv_event event, int val)
     case RTADV_START:
       if (! rtadv->ra_read)
 	rtadv->ra_read = thread_add_read (zebrad.master, rtadv_read, NULL, val);
-      if (! rtadv->ra_timer)
-	rtadv->ra_timer = thread_add_event (zebrad.master, rtadv_timer,
-	                                    NULL, 0);
+      if (! rtadv->wheel)
+	rtadv->wheel = wheel_new (zebrad.master, WHEEL_SIZE_DEFAULT);
       break;
     case RTADV_STOP:
       if (rtadv->ra_timer)
@@ -1650,11 +1767,11 @@ rtadv_event (enum rtadv_event event, int val)
 	  thread_cancel (rtadv->ra_read);
 	  rtadv->ra_read = NULL;
 	}
-      break;
-    case RTADV_TIMER:
-      if (! rtadv->ra_timer)
-	rtadv->ra_timer = thread_add_timer (zebrad.master, rtadv_timer, NULL,
-	                                    val);
+      if (rtadv->wheel)
+	{
+	  wheel_free (rtadv->wheel);
+	  rtadv->wheel = NULL;
+	}
       break;
     case RTADV_TIMER_MSEC:
       if (! rtadv->ra_timer)
@@ -1733,6 +1850,22 @@ rtadv_init (void)
   install_element (INTERFACE_NODE, &no_ipv6_nd_mtu_val_cmd);
 }
 
+/* The interface is going away: off the wheel and the list it was on. */
+void
+rtadv_if_delete (struct interface *ifp)
+{
+  struct zebra_if *zif = ifp->info;
+
+  if (rtadv)
+    {
+      if (rtadv->wheel)
+	wheel_timer_off (rtadv->wheel, &zif->rtadv.t_adv);
+      listnode_delete (rtadv->msec_ifs, ifp);
+    }
+  if (zif->rtadv.ra_packet)
+    XFREE (MTYPE_RTADV_PACKET, zif->rtadv.ra_packet);
+}
+
 static int
 if_join_all_router (int sock, struct interface *ifp)
 {
@@ -1781,4 +1914,10 @@ rtadv_init (void)
 {
   /* Empty.*/;
 }
+
+void
+rtadv_if_delete (struct interface *ifp)
+{
+  /* Empty.*/;
+}
 #endif /* RTADV && HAVE_IPV6 */
@@ -60,6 +60,7 @@ struct rtadv_prefix
 
 extern void rtadv_config_write (struct vty *, struct interface *);
 extern void rtadv_init (void);
+extern void rtadv_if_delete (struct interface *);
 
 /* RFC4584 Extension to Sockets API for Mobile IPv6 */
 
@@ -29,13 +29,20 @@
 #include "zebra/rt.h"
 #include "zebra/kernel_socket.h"
 
-/* Kernel routing table read up by sysctl function. */
+/* Tries at the dump, as the table may grow between sizing and reading
+   it. */
+#define ROUTE_READ_TRIES 4
+
+/* Kernel routing table read up by sysctl function.  The routes are
+   only linked in as they are read, selection over them runs in the
+   background later, see rib_bulk_start(). */
 void
 route_read (void)
 {
   caddr_t buf, end, ref;
   size_t bufsiz;
   struct rt_msghdr *rtm;
+  int tries;
   
 #define MIBSIZ 6
   int mib[MIBSIZ] = 
@@ -48,30 +55,45 @@ route_read (void)
     0
   };
 		      
-  /* Get buffer size. */
-  if (sysctl (mib, MIBSIZ, NULL, &bufsiz, NULL, 0) < 0) 
+  for (tries = 1; ; tries++)
     {
-      zlog_warn ("sysctl fail: %s", safe_strerror (errno));
-      return;
-    }
+      /* Get buffer size. */
+      if (sysctl (mib, MIBSIZ, NULL, &bufsiz, NULL, 0) < 0) 
+	{
+	  zlog_warn ("sysctl fail: %s", safe_strerror (errno));
+	  return;
+	}
 
-  /* Allocate buffer. */
-  ref = buf = XMALLOC (MTYPE_TMP, bufsiz);
+      /* Allocate buffer, with room for some growth. */
+      bufsiz += bufsiz / 8;
+      ref = buf = XMALLOC (MTYPE_TMP, bufsiz);
   
-  /* Read routing table information by calling sysctl(). */
-  if (sysctl (mib, MIBSIZ, buf, &bufsiz, NULL, 0) < 0) 
-    {
-      zlog_warn ("sysctl() fail by %s", safe_strerror (errno));
-      return;
+      /* Read routing table information by calling sysctl(). */
+      if (sysctl (mib, MIBSIZ, buf, &bufsiz, NULL, 0) == 0)
+	break;
+
+      XFREE (MTYPE_TMP, ref);
+      if (errno != ENOMEM || tries == ROUTE_READ_TRIES)
+	{
+	  zlog_warn ("sysctl() fail by %s", safe_strerror (errno));
+	  return;
+	}
     }
 
+  rib_bulk_start ();
   for (end = buf + bufsiz; buf < end; buf += rtm->rtm_msglen) 
     {
       rtm = (struct rt_msghdr *) buf;
+      if (rtm->rtm_msglen == 0 || rtm->rtm_msglen > end - buf)
+	{
+	  zlog_warn ("route_read: bad message length %d", rtm->rtm_msglen);
+	  break;
+	}
       /* We must set RTF_DONE here, so rtm_read() doesn't ignore the message. */
       SET_FLAG (rtm->rtm_flags, RTF_DONE);
       rtm_read (rtm);
     }
+  rib_bulk_finish ();
 
   /* Free buffer. */
   XFREE (MTYPE_TMP, ref);
@@ -41,11 +41,18 @@
  */
 #define ZFPM_CONNECT_RETRY_IVL   5
 
+/*
+ * Maximum number of FPMs we talk to. Each has a bit in the fpm_sent
+ * field of rib_dest_t.
+ */
+#define ZFPM_MAX_CLIENTS 8
+
 /*
  * Sizes of outgoing and incoming stream buffers for writing/reading
- * FPM messages.
+ * FPM messages. The outgoing buffer holds the messages for many
+ * routes, which are then written out at once.
  */
-#define ZFPM_OBUF_SIZE (2 * FPM_MAX_MSG_LEN)
+#define ZFPM_OBUF_SIZE (16 * FPM_MAX_MSG_LEN)
 #define ZFPM_IBUF_SIZE (FPM_MAX_MSG_LEN)
 
 /*
@@ -59,16 +66,6 @@
  */
 #define ZFPM_STATS_IVL_SECS        10
 
-/*
- * Structure that holds state for iterating over all route_node
- * structures that are candidates for being communicated to the FPM.
- */
-typedef struct zfpm_rnodes_iter_t_
-{
-  rib_tables_iter_t tables_iter;
-  route_table_iter_t iter;
-} zfpm_rnodes_iter_t;
-
 /*
  * Statistics.
  */
@@ -89,21 +86,16 @@ typedef struct zfpm_stats_t_ {
   unsigned long route_dels;
 
   unsigned long updates_triggered;
-  unsigned long redundant_triggers;
+  unsigned long updates_requeued;
   unsigned long non_fpm_table_triggers;
 
   unsigned long dests_del_after_update;
 
-  unsigned long t_conn_down_starts;
-  unsigned long t_conn_down_dests_processed;
-  unsigned long t_conn_down_yields;
-  unsigned long t_conn_down_finishes;
+  unsigned long resyncs;
+  unsigned long conn_downs;
 
-  unsigned long t_conn_up_starts;
-  unsigned long t_conn_up_dests_processed;
-  unsigned long t_conn_up_yields;
-  unsigned long t_conn_up_aborts;
-  unsigned long t_conn_up_finishes;
+  unsigned long nhg_defs;
+  unsigned long compact_fallbacks;
 
 } zfpm_stats_t;
 
@@ -139,29 +131,30 @@ typedef enum {
 } zfpm_state_t;
 
 /*
- * Globals.
+ * State of the connection to one FPM.
  */
-typedef struct zfpm_glob_t_
+typedef struct zfpm_client_t_
 {
 
   /*
-   * True if the FPM module has been enabled.
+   * Position in zfpm_g->clients, and the bit for this client in
+   * rib_dest_t's fpm_sent.
    */
-  int enabled;
-
-  struct thread_master *master;
-
-  zfpm_state_t state;
+  int index;
 
   /*
-   * Port on which the FPM is running.
+   * Address and port on which the FPM is running.
    */
+  struct in_addr addr;
   int fpm_port;
 
   /*
-   * List of rib_dest_t structures to be processed
+   * True if routes are sent in compact messages rather than netlink
+   * ones.
    */
-  TAILQ_HEAD (zfpm_dest_q, rib_dest_t_) dest_q;
+  int compact;
+
+  zfpm_state_t state;
 
   /*
    * Stream socket to the FPM.
@@ -182,28 +175,59 @@ typedef struct zfpm_glob_t_
   struct thread *t_read;
 
   /*
-   * Thread to clean up after the TCP connection to the FPM goes down
-   * and the state that belongs to it.
+   * Next dest on the update log to tell this FPM about, NULL once the
+   * FPM has heard about every dest on the log.
    */
-  struct thread *t_conn_down;
-
-  struct {
-    zfpm_rnodes_iter_t iter;
-  } t_conn_down_state;
+  rib_dest_t *next;
 
   /*
-   * Thread to take actions once the TCP conn to the FPM comes up, and
-   * the state that belongs to it.
+   * True once the FPM has been through the whole log since the
+   * connection came up.
    */
-  struct thread *t_conn_up;
-
-  struct {
-    zfpm_rnodes_iter_t iter;
-  } t_conn_up_state;
+  int synced;
 
   unsigned long connect_calls;
   time_t last_connect_call_time;
 
+  /*
+   * Counters for this FPM alone, since the connection came up.
+   */
+  unsigned long route_adds;
+  unsigned long route_dels;
+
+} zfpm_client_t;
+
+#define ZFPM_CLIENT_BIT(client) (1 << (client)->index)
+
+/*
+ * Globals.
+ */
+typedef struct zfpm_glob_t_
+{
+
+  /*
+   * True if the FPM module has been enabled.
+   */
+  int enabled;
+
+  struct thread_master *master;
+
+  /*
+   * The update log: every dest that may have to be communicated to
+   * an FPM, ordered by the time of its last change. Each FPM walks it
+   * at its own pace, and starts over from the head when it
+   * reconnects, so that all of them share the one queue and none
+   * needs a walk of the RIB to be resynced.
+   *
+   * A dest stays on the log for as long as it has routes, or as long
+   * as some FPM has been told about it and is yet to hear of its
+   * deletion.
+   */
+  TAILQ_HEAD (zfpm_dest_q, rib_dest_t_) dest_q;
+
+  zfpm_client_t clients[ZFPM_MAX_CLIENTS];
+  int num_clients;
+
   /*
    * Stats from the start of the current statistics interval up to
    * now. These are the counters we typically update in the code.
@@ -236,11 +260,24 @@ typedef struct zfpm_glob_t_
 static zfpm_glob_t zfpm_glob_space;
 static zfpm_glob_t *zfpm_g = &zfpm_glob_space;
 
+/*
+ * FPMs given on the command line, see zfpm_add_client().
+ */
+static struct
+{
+  struct in_addr addr;
+  int port;
+  int compact;
+} zfpm_client_conf[ZFPM_MAX_CLIENTS];
+static int zfpm_num_client_conf;
+
 static int zfpm_read_cb (struct thread *thread);
 static int zfpm_write_cb (struct thread *thread);
 
-static void zfpm_set_state (zfpm_state_t state, const char *reason);
-static void zfpm_start_connect_timer (const char *reason);
+static void zfpm_set_state (zfpm_client_t *client, zfpm_state_t state,
+			    const char *reason);
+static void zfpm_start_connect_timer (zfpm_client_t *client,
+				      const char *reason);
 static void zfpm_start_stats_timer (void);
 
 /*
@@ -339,78 +376,6 @@ zfpm_is_table_for_fpm (struct route_table *table)
   return 1;
 }
 
-/*
- * zfpm_rnodes_iter_init
- */
-static inline void
-zfpm_rnodes_iter_init (zfpm_rnodes_iter_t *iter)
-{
-  memset (iter, 0, sizeof (*iter));
-  rib_tables_iter_init (&iter->tables_iter);
-
-  /*
-   * This is a hack, but it makes implementing 'next' easier by
-   * ensuring that route_table_iter_next() will return NULL the first
-   * time we call it.
-   */
-  route_table_iter_init (&iter->iter, NULL);
-  route_table_iter_cleanup (&iter->iter);
-}
-
-/*
- * zfpm_rnodes_iter_next
- */
-static inline struct route_node *
-zfpm_rnodes_iter_next (zfpm_rnodes_iter_t *iter)
-{
-  struct route_node *rn;
-  struct route_table *table;
-
-  while (1)
-    {
-      rn = route_table_iter_next (&iter->iter);
-      if (rn)
-	return rn;
-
-      /*
-       * We've made our way through this table, go to the next one.
-       */
-      route_table_iter_cleanup (&iter->iter);
-
-      while ((table = rib_tables_iter_next (&iter->tables_iter)))
-	{
-	  if (zfpm_is_table_for_fpm (table))
-	    break;
-	}
-
-      if (!table)
-	return NULL;
-
-      route_table_iter_init (&iter->iter, table);
-    }
-
-  return NULL;
-}
-
-/*
- * zfpm_rnodes_iter_pause
- */
-static inline void
-zfpm_rnodes_iter_pause (zfpm_rnodes_iter_t *iter)
-{
-  route_table_iter_pause (&iter->iter);
-}
-
-/*
- * zfpm_rnodes_iter_cleanup
- */
-static inline void
-zfpm_rnodes_iter_cleanup (zfpm_rnodes_iter_t *iter)
-{
-  route_table_iter_cleanup (&iter->iter);
-  rib_tables_iter_cleanup (&iter->tables_iter);
-}
-
 /*
  * zfpm_stats_init
  *
@@ -475,266 +440,207 @@ zfpm_stats_compose (const zfpm_stats_t *s1, const zfpm_stats_t *s2,
  * zfpm_read_on
  */
 static inline void
-zfpm_read_on (void)
+zfpm_read_on (zfpm_client_t *client)
 {
-  assert (!zfpm_g->t_read);
-  assert (zfpm_g->sock >= 0);
+  assert (!client->t_read);
+  assert (client->sock >= 0);
 
-  THREAD_READ_ON (zfpm_g->master, zfpm_g->t_read, zfpm_read_cb, 0,
-		  zfpm_g->sock);
+  THREAD_READ_ON (zfpm_g->master, client->t_read, zfpm_read_cb, client,
+		  client->sock);
 }
 
 /*
  * zfpm_write_on
  */
 static inline void
-zfpm_write_on (void)
+zfpm_write_on (zfpm_client_t *client)
 {
-  assert (!zfpm_g->t_write);
-  assert (zfpm_g->sock >= 0);
+  assert (!client->t_write);
+  assert (client->sock >= 0);
 
-  THREAD_WRITE_ON (zfpm_g->master, zfpm_g->t_write, zfpm_write_cb, 0,
-		   zfpm_g->sock);
+  THREAD_WRITE_ON (zfpm_g->master, client->t_write, zfpm_write_cb, client,
+		   client->sock);
 }
 
 /*
  * zfpm_read_off
  */
 static inline void
-zfpm_read_off (void)
+zfpm_read_off (zfpm_client_t *client)
 {
-  THREAD_READ_OFF (zfpm_g->t_read);
+  THREAD_READ_OFF (client->t_read);
 }
 
 /*
  * zfpm_write_off
  */
 static inline void
-zfpm_write_off (void)
+zfpm_write_off (zfpm_client_t *client)
 {
-  THREAD_WRITE_OFF (zfpm_g->t_write);
+  THREAD_WRITE_OFF (client->t_write);
 }
 
 /*
- * zfpm_conn_up_thread_cb
+ * zfpm_log_remove
  *
- * Callback for actions to be taken when the connection to the FPM
- * comes up.
+ * Take a dest off the update log, moving any FPM that was about to
+ * look at it on to the next one.
  */
-static int
-zfpm_conn_up_thread_cb (struct thread *thread)
+static void
+zfpm_log_remove (rib_dest_t *dest)
 {
-  struct route_node *rnode;
-  zfpm_rnodes_iter_t *iter;
-  rib_dest_t *dest;
+  zfpm_client_t *client;
+  int i;
 
-  assert (zfpm_g->t_conn_up);
-  zfpm_g->t_conn_up = NULL;
+  assert (CHECK_FLAG (dest->flags, RIB_DEST_UPDATE_FPM));
 
-  iter = &zfpm_g->t_conn_up_state.iter;
-
-  if (zfpm_g->state != ZFPM_STATE_ESTABLISHED)
+  for (i = 0; i < zfpm_g->num_clients; i++)
     {
-      zfpm_debug ("Connection not up anymore, conn_up thread aborting");
-      zfpm_g->stats.t_conn_up_aborts++;
-      goto done;
+      client = &zfpm_g->clients[i];
+      if (client->next == dest)
+	client->next = TAILQ_NEXT (dest, fpm_q_entries);
     }
 
-  while ((rnode = zfpm_rnodes_iter_next (iter)))
-    {
-      dest = rib_dest_from_rnode (rnode);
-
-      if (dest)
-	{
-	  zfpm_g->stats.t_conn_up_dests_processed++;
-	  zfpm_trigger_update (rnode, NULL);
-	}
+  TAILQ_REMOVE (&zfpm_g->dest_q, dest, fpm_q_entries);
+  UNSET_FLAG (dest->flags, RIB_DEST_UPDATE_FPM);
+}
 
-      /*
-       * Yield if need be.
-       */
-      if (!zfpm_thread_should_yield (thread))
-	continue;
+/*
+ * zfpm_log_append
+ *
+ * Put a dest at the tail of the update log. FPMs that had already
+ * heard about everything on the log will look at it next.
+ */
+static void
+zfpm_log_append (rib_dest_t *dest)
+{
+  zfpm_client_t *client;
+  int i;
 
-      zfpm_g->stats.t_conn_up_yields++;
-      zfpm_rnodes_iter_pause (iter);
-      zfpm_g->t_conn_up = thread_add_background (zfpm_g->master,
-						 zfpm_conn_up_thread_cb,
-						 0, 0);
-      return 0;
+  if (CHECK_FLAG (dest->flags, RIB_DEST_UPDATE_FPM))
+    {
+      zfpm_g->stats.updates_requeued++;
+      zfpm_log_remove (dest);
     }
 
-  zfpm_g->stats.t_conn_up_finishes++;
+  SET_FLAG (dest->flags, RIB_DEST_UPDATE_FPM);
+  TAILQ_INSERT_TAIL (&zfpm_g->dest_q, dest, fpm_q_entries);
 
- done:
-  zfpm_rnodes_iter_cleanup (iter);
-  return 0;
+  for (i = 0; i < zfpm_g->num_clients; i++)
+    {
+      client = &zfpm_g->clients[i];
+      if (client->state == ZFPM_STATE_ESTABLISHED && !client->next)
+	client->next = dest;
+    }
 }
 
 /*
  * zfpm_connection_up
  *
- * Called when the connection to the FPM comes up.
+ * Called when the connection to an FPM comes up.
  */
 static void
-zfpm_connection_up (const char *detail)
+zfpm_connection_up (zfpm_client_t *client, const char *detail)
 {
-  assert (zfpm_g->sock >= 0);
-  zfpm_read_on ();
-  zfpm_write_on ();
-  zfpm_set_state (ZFPM_STATE_ESTABLISHED, detail);
+  assert (client->sock >= 0);
+  zfpm_read_on (client);
+  zfpm_write_on (client);
+  zfpm_set_state (client, ZFPM_STATE_ESTABLISHED, detail);
 
   /*
-   * Start thread to push existing routes to the FPM.
+   * Push existing routes to the FPM by walking the update log from
+   * the start. Deletions it may have missed while the connection was
+   * down are on the log as well.
    */
-  assert (!zfpm_g->t_conn_up);
+  client->next = TAILQ_FIRST (&zfpm_g->dest_q);
+  client->synced = (client->next == NULL);
+  client->route_adds = 0;
+  client->route_dels = 0;
+  zfpm_g->stats.resyncs++;
 
-  zfpm_rnodes_iter_init (&zfpm_g->t_conn_up_state.iter);
-
-  zfpm_debug ("Starting conn_up thread");
-  zfpm_g->t_conn_up = thread_add_background (zfpm_g->master,
-					     zfpm_conn_up_thread_cb, 0, 0);
-  zfpm_g->stats.t_conn_up_starts++;
+  /*
+   * Nexthop groups have to be defined again on the new connection.
+   */
+  if (client->compact)
+    zfpm_compact_client_reset (client->index);
 }
 
 /*
  * zfpm_connect_check
  *
- * Check if an asynchronous connect() to the FPM is complete.
+ * Check if an asynchronous connect() to an FPM is complete.
  */
 static void
-zfpm_connect_check ()
+zfpm_connect_check (zfpm_client_t *client)
 {
   int status;
   socklen_t slen;
   int ret;
 
-  zfpm_read_off ();
-  zfpm_write_off ();
+  zfpm_read_off (client);
+  zfpm_write_off (client);
 
   slen = sizeof (status);
-  ret = getsockopt (zfpm_g->sock, SOL_SOCKET, SO_ERROR, (void *) &status,
+  ret = getsockopt (client->sock, SOL_SOCKET, SO_ERROR, (void *) &status,
 		    &slen);
 
   if (ret >= 0 && status == 0)
     {
-      zfpm_connection_up ("async connect complete");
+      zfpm_connection_up (client, "async connect complete");
       return;
     }
 
   /*
    * getsockopt() failed or indicated an error on the socket.
    */
-  close (zfpm_g->sock);
-  zfpm_g->sock = -1;
+  close (client->sock);
+  client->sock = -1;
 
-  zfpm_start_connect_timer ("getsockopt() after async connect failed");
+  zfpm_start_connect_timer (client, "getsockopt() after async connect failed");
   return;
 }
 
-/*
- * zfpm_conn_down_thread_cb
- *
- * Callback that is invoked to clean up state after the TCP connection
- * to the FPM goes down.
- */
-static int
-zfpm_conn_down_thread_cb (struct thread *thread)
-{
-  struct route_node *rnode;
-  zfpm_rnodes_iter_t *iter;
-  rib_dest_t *dest;
-
-  assert (zfpm_g->state == ZFPM_STATE_IDLE);
-
-  assert (zfpm_g->t_conn_down);
-  zfpm_g->t_conn_down = NULL;
-
-  iter = &zfpm_g->t_conn_down_state.iter;
-
-  while ((rnode = zfpm_rnodes_iter_next (iter)))
-    {
-      dest = rib_dest_from_rnode (rnode);
-
-      if (dest)
-	{
-	  if (CHECK_FLAG (dest->flags, RIB_DEST_UPDATE_FPM))
-	    {
-	      TAILQ_REMOVE (&zfpm_g->dest_q, dest, fpm_q_entries);
-	    }
-
-	  UNSET_FLAG (dest->flags, RIB_DEST_UPDATE_FPM);
-	  UNSET_FLAG (dest->flags, RIB_DEST_SENT_TO_FPM);
-
-	  zfpm_g->stats.t_conn_down_dests_processed++;
-
-	  /*
-	   * Check if the dest should be deleted.
-	   */
-	  rib_gc_dest(rnode);
-	}
-
-      /*
-       * Yield if need be.
-       */
-      if (!zfpm_thread_should_yield (thread))
-	continue;
-
-      zfpm_g->stats.t_conn_down_yields++;
-      zfpm_rnodes_iter_pause (iter);
-      zfpm_g->t_conn_down = thread_add_background (zfpm_g->master,
-						   zfpm_conn_down_thread_cb,
-						   0, 0);
-      return 0;
-    }
-
-  zfpm_g->stats.t_conn_down_finishes++;
-  zfpm_rnodes_iter_cleanup (iter);
-
-  /*
-   * Start the process of connecting to the FPM again.
-   */
-  zfpm_start_connect_timer ("cleanup complete");
-  return 0;
-}
-
 /*
  * zfpm_connection_down
  *
- * Called when the connection to the FPM has gone down.
+ * Called when the connection to an FPM has gone down.
  */
 static void
-zfpm_connection_down (const char *detail)
+zfpm_connection_down (zfpm_client_t *client, const char *detail)
 {
   if (!detail)
     detail = "unknown";
 
-  assert (zfpm_g->state == ZFPM_STATE_ESTABLISHED);
+  assert (client->state == ZFPM_STATE_ESTABLISHED);
 
-  zlog_info ("connection to the FPM has gone down: %s", detail);
+  zlog_info ("connection to the FPM at %s:%d has gone down: %s",
+	     inet_ntoa (client->addr), client->fpm_port, detail);
 
-  zfpm_read_off ();
-  zfpm_write_off ();
+  zfpm_read_off (client);
+  zfpm_write_off (client);
 
-  stream_reset (zfpm_g->ibuf);
-  stream_reset (zfpm_g->obuf);
+  stream_reset (client->ibuf);
+  stream_reset (client->obuf);
 
-  if (zfpm_g->sock >= 0) {
-    close (zfpm_g->sock);
-    zfpm_g->sock = -1;
+  if (client->sock >= 0) {
+    close (client->sock);
+    client->sock = -1;
   }
 
   /*
-   * Start thread to clean up state after the connection goes down.
+   * Dests keep their fpm_sent bit for this FPM: if it comes back, it
+   * is told about their deletion while walking the log.
+   */
+  client->next = NULL;
+  client->synced = 0;
+  zfpm_g->stats.conn_downs++;
+
+  zfpm_set_state (client, ZFPM_STATE_IDLE, detail);
+
+  /*
+   * Start the process of connecting to the FPM again.
    */
-  assert (!zfpm_g->t_conn_down);
-  zfpm_debug ("Starting conn_down thread");
-  zfpm_rnodes_iter_init (&zfpm_g->t_conn_down_state.iter);
-  zfpm_g->t_conn_down = thread_add_background (zfpm_g->master,
-					       zfpm_conn_down_thread_cb, 0, 0);
-  zfpm_g->stats.t_conn_down_starts++;
-
-  zfpm_set_state (ZFPM_STATE_IDLE, detail);
+  zfpm_start_connect_timer (client, "connection down");
 }
 
 /*
@@ -743,38 +649,40 @@ zfpm_connection_down (const char *detail)
 static int
 zfpm_read_cb (struct thread *thread)
 {
+  zfpm_client_t *client;
   size_t already;
   struct stream *ibuf;
   uint16_t msg_len;
   fpm_msg_hdr_t *hdr;
 
+  client = THREAD_ARG (thread);
   zfpm_g->stats.read_cb_calls++;
-  assert (zfpm_g->t_read);
-  zfpm_g->t_read = NULL;
+  assert (client->t_read);
+  client->t_read = NULL;
 
   /*
    * Check if async connect is now done.
    */
-  if (zfpm_g->state == ZFPM_STATE_CONNECTING)
+  if (client->state == ZFPM_STATE_CONNECTING)
     {
-      zfpm_connect_check();
+      zfpm_connect_check (client);
       return 0;
     }
 
-  assert (zfpm_g->state == ZFPM_STATE_ESTABLISHED);
-  assert (zfpm_g->sock >= 0);
+  assert (client->state == ZFPM_STATE_ESTABLISHED);
+  assert (client->sock >= 0);
 
-  ibuf = zfpm_g->ibuf;
+  ibuf = client->ibuf;
 
   already = stream_get_endp (ibuf);
   if (already < FPM_MSG_HDR_LEN)
     {
       ssize_t nbyte;
 
-      nbyte = stream_read_try (ibuf, zfpm_g->sock, FPM_MSG_HDR_LEN - already);
+      nbyte = stream_read_try (ibuf, client->sock, FPM_MSG_HDR_LEN - already);
       if (nbyte == 0 || nbyte == -1)
 	{
-	  zfpm_connection_down ("closed socket in read");
+	  zfpm_connection_down (client, "closed socket in read");
 	  return 0;
 	}
 
@@ -790,7 +698,7 @@ zfpm_read_cb (struct thread *thread)
 
   if (!fpm_msg_hdr_ok (hdr))
     {
-      zfpm_connection_down ("invalid message header");
+      zfpm_connection_down (client, "invalid message header");
       return 0;
     }
 
@@ -803,11 +711,11 @@ zfpm_read_cb (struct thread *thread)
     {
       ssize_t nbyte;
 
-      nbyte = stream_read_try (ibuf, zfpm_g->sock, msg_len - already);
+      nbyte = stream_read_try (ibuf, client->sock, msg_len - already);
 
       if (nbyte == 0 || nbyte == -1)
 	{
-	  zfpm_connection_down ("failed to read message");
+	  zfpm_connection_down (client, "failed to read message");
 	  return 0;
 	}
 
@@ -823,7 +731,7 @@ zfpm_read_cb (struct thread *thread)
   stream_reset (ibuf);
 
  done:
-  zfpm_read_on ();
+  zfpm_read_on (client);
   return 0;
 }
 
@@ -833,20 +741,21 @@ zfpm_read_cb (struct thread *thread)
  * Returns TRUE if we may have something to write to the FPM.
  */
 static int
-zfpm_writes_pending (void)
+zfpm_writes_pending (zfpm_client_t *client)
 {
 
   /*
    * Check if there is any data in the outbound buffer that has not
    * been written to the socket yet.
    */
-  if (stream_get_endp (zfpm_g->obuf) - stream_get_getp (zfpm_g->obuf))
+  if (stream_get_endp (client->obuf) - stream_get_getp (client->obuf))
     return 1;
 
   /*
-   * Check if there are any prefixes on the outbound queue.
+   * Check if there are any prefixes on the log the FPM has not heard
+   * about.
    */
-  if (!TAILQ_EMPTY (&zfpm_g->dest_q))
+  if (client->next)
     return 1;
 
   return 0;
@@ -901,14 +810,174 @@ zfpm_route_for_update (rib_dest_t *dest)
   return NULL;
 }
 
+/*
+ * zfpm_dest_done
+ *
+ * Record that the FPM has been told about the given dest.
+ */
+static void
+zfpm_dest_done (zfpm_client_t *client, rib_dest_t *dest, int is_add)
+{
+  if (is_add)
+    dest->fpm_sent |= ZFPM_CLIENT_BIT (client);
+  else
+    dest->fpm_sent &= ~ZFPM_CLIENT_BIT (client);
+
+  if (dest->fpm_sent)
+    SET_FLAG (dest->flags, RIB_DEST_SENT_TO_FPM);
+  else
+    UNSET_FLAG (dest->flags, RIB_DEST_SENT_TO_FPM);
+
+  /*
+   * Delete the destination if no FPM needs to hear about it
+   * anymore.
+   */
+  if (!is_add && rib_gc_dest (dest->rnode))
+    zfpm_g->stats.dests_del_after_update++;
+}
+
+/*
+ * zfpm_build_updates_compact
+ *
+ * Like zfpm_build_updates(), for an FPM that takes compact messages.
+ * Consecutive dests on the log that use the same nexthop group are
+ * packed into one message.
+ */
+static void
+zfpm_build_updates_compact (zfpm_client_t *client)
+{
+  struct stream *s;
+  rib_dest_t *dest;
+  struct rib *rib;
+  char *buf, *msg;
+  size_t msg_start, data_len;
+  uint32_t nhg_id, msg_nhg_id;
+  u_char family, msg_family;
+  int is_add, msg_is_add;
+  int ret;
+
+  s = client->obuf;
+
+  /*
+   * The message prefixes are being added to, if any.
+   */
+  msg = NULL;
+  msg_start = data_len = 0;
+  msg_nhg_id = 0;
+  msg_family = 0;
+  msg_is_add = 0;
+
+  do {
+
+    /*
+     * Make sure there is enough space for a nexthop group definition
+     * and another message.
+     */
+    if (STREAM_WRITEABLE (s) < 2 * FPM_MAX_MSG_LEN)
+      break;
+
+    dest = client->next;
+    if (!dest)
+      {
+	client->synced = 1;
+	break;
+      }
+
+    assert (CHECK_FLAG (dest->flags, RIB_DEST_UPDATE_FPM));
+    client->next = TAILQ_NEXT (dest, fpm_q_entries);
+
+    rib = zfpm_route_for_update (dest);
+    is_add = rib ? 1 : 0;
+    family = rib_dest_af (dest);
+    nhg_id = 0;
+
+    /*
+     * If this is a route deletion, and we have not sent the route to
+     * this FPM previously, skip it.
+     */
+    if (!is_add && !(dest->fpm_sent & ZFPM_CLIENT_BIT (client)))
+      {
+	zfpm_g->stats.nop_deletes_skipped++;
+	zfpm_dest_done (client, dest, is_add);
+	continue;
+      }
+
+    if (is_add)
+      {
+	buf = (char *) STREAM_DATA (s) + stream_get_endp (s);
+	ret = zfpm_compact_encode_nhg (dest, rib, client->index, &nhg_id,
+				       buf, STREAM_WRITEABLE (s));
+	if (ret > 0)
+	  {
+	    stream_forward_endp (s, ret);
+	    zfpm_g->stats.nhg_defs++;
+	    msg = NULL;
+	  }
+	else if (ret < 0)
+	  {
+	    /*
+	     * Fall back to a netlink message for this route.
+	     */
+	    buf = (char *) STREAM_DATA (s) + stream_get_endp (s);
+	    ret = zfpm_encode_route (dest, rib, buf, STREAM_WRITEABLE (s));
+	    if (ret > 0)
+	      {
+		stream_forward_endp (s, ret);
+		zfpm_g->stats.route_adds++;
+		client->route_adds++;
+	      }
+	    zfpm_g->stats.compact_fallbacks++;
+	    msg = NULL;
+	    zfpm_dest_done (client, dest, is_add);
+	    continue;
+	  }
+      }
+
+    /*
+     * Start a new message unless the prefix fits in the current one.
+     */
+    if (!msg || msg_is_add != is_add || msg_family != family
+	|| msg_nhg_id != nhg_id
+	|| (fpm_data_len_to_msg_len (data_len + ZFPM_COMPACT_PREFIX_MAX_LEN)
+	    > FPM_MAX_MSG_LEN))
+      {
+	msg_start = stream_get_endp (s);
+	msg = (char *) STREAM_DATA (s) + msg_start;
+	data_len = zfpm_compact_route_start (is_add, family, nhg_id, msg);
+	msg_is_add = is_add;
+	msg_family = family;
+	msg_nhg_id = nhg_id;
+      }
+
+    data_len = zfpm_compact_route_append (msg, data_len,
+					  rib_dest_prefix (dest));
+    stream_set_endp (s, msg_start + fpm_data_len_to_msg_len (data_len));
+
+    if (is_add)
+      {
+	zfpm_g->stats.route_adds++;
+	client->route_adds++;
+      }
+    else
+      {
+	zfpm_g->stats.route_dels++;
+	client->route_dels++;
+      }
+
+    zfpm_dest_done (client, dest, is_add);
+
+  } while (1);
+}
+
 /*
  * zfpm_build_updates
  *
- * Process the outgoing queue and write messages to the outbound
- * buffer.
+ * Walk the update log from where the FPM is at and write messages
+ * for as many dests as fit to its outbound buffer, so that they go
+ * out in one write.
  */
 static void
-zfpm_build_updates (void)
+zfpm_build_updates (zfpm_client_t *client)
 {
   struct stream *s;
   rib_dest_t *dest;
@@ -919,10 +988,16 @@ zfpm_build_updates (void)
   struct rib *rib;
   int is_add, write_msg;
 
-  s = zfpm_g->obuf;
+  s = client->obuf;
 
   assert (stream_empty (s));
 
+  if (client->compact)
+    {
+      zfpm_build_updates_compact (client);
+      return;
+    }
+
   do {
 
     /*
@@ -934,11 +1009,15 @@ zfpm_build_updates (void)
     buf = STREAM_DATA (s) + stream_get_endp (s);
     buf_end = buf + STREAM_WRITEABLE (s);
 
-    dest = TAILQ_FIRST (&zfpm_g->dest_q);
+    dest = client->next;
     if (!dest)
-      break;
+      {
+	client->synced = 1;
+	break;
+      }
 
     assert (CHECK_FLAG (dest->flags, RIB_DEST_UPDATE_FPM));
+    client->next = TAILQ_NEXT (dest, fpm_q_entries);
 
     hdr = (fpm_msg_hdr_t *) buf;
     hdr->version = FPM_PROTO_VERSION;
@@ -953,9 +1032,9 @@ zfpm_build_updates (void)
 
     /*
      * If this is a route deletion, and we have not sent the route to
-     * the FPM previously, skip it.
+     * this FPM previously, skip it.
      */
-    if (!is_add && !CHECK_FLAG (dest->flags, RIB_DEST_SENT_TO_FPM))
+    if (!is_add && !(dest->fpm_sent & ZFPM_CLIENT_BIT (client)))
       {
 	write_msg = 0;
 	zfpm_g->stats.nop_deletes_skipped++;
@@ -972,32 +1051,19 @@ zfpm_build_updates (void)
 	  stream_forward_endp (s, msg_len);
 
 	  if (is_add)
-	    zfpm_g->stats.route_adds++;
+	    {
+	      zfpm_g->stats.route_adds++;
+	      client->route_adds++;
+	    }
 	  else
-	    zfpm_g->stats.route_dels++;
+	    {
+	      zfpm_g->stats.route_dels++;
+	      client->route_dels++;
+	    }
 	}
     }
 
-    /*
-     * Remove the dest from the queue, and reset the flag.
-     */
-    UNSET_FLAG (dest->flags, RIB_DEST_UPDATE_FPM);
-    TAILQ_REMOVE (&zfpm_g->dest_q, dest, fpm_q_entries);
-
-    if (is_add)
-      {
-	SET_FLAG (dest->flags, RIB_DEST_SENT_TO_FPM);
-      }
-    else
-      {
-	UNSET_FLAG (dest->flags, RIB_DEST_SENT_TO_FPM);
-      }
-
-    /*
-     * Delete the destination if necessary.
-     */
-    if (rib_gc_dest (dest->rnode))
-      zfpm_g->stats.dests_del_after_update++;
+    zfpm_dest_done (client, dest, is_add);
 
   } while (1);
 
@@ -1009,24 +1075,26 @@ zfpm_build_updates (void)
 static int
 zfpm_write_cb (struct thread *thread)
 {
+  zfpm_client_t *client;
   struct stream *s;
   int num_writes;
 
+  client = THREAD_ARG (thread);
   zfpm_g->stats.write_cb_calls++;
-  assert (zfpm_g->t_write);
-  zfpm_g->t_write = NULL;
+  assert (client->t_write);
+  client->t_write = NULL;
 
   /*
    * Check if async connect is now done.
    */
-  if (zfpm_g->state == ZFPM_STATE_CONNECTING)
+  if (client->state == ZFPM_STATE_CONNECTING)
     {
-      zfpm_connect_check ();
+      zfpm_connect_check (client);
       return 0;
     }
 
-  assert (zfpm_g->state == ZFPM_STATE_ESTABLISHED);
-  assert (zfpm_g->sock >= 0);
+  assert (client->state == ZFPM_STATE_ESTABLISHED);
+  assert (client->sock >= 0);
 
   num_writes = 0;
 
@@ -1034,21 +1102,21 @@ zfpm_write_cb (struct thread *thread)
     {
       int bytes_to_write, bytes_written;
 
-      s = zfpm_g->obuf;
+      s = client->obuf;
 
       /*
        * If the stream is empty, try fill it up with data.
        */
       if (stream_empty (s))
 	{
-	  zfpm_build_updates ();
+	  zfpm_build_updates (client);
 	}
 
       bytes_to_write = stream_get_endp (s) - stream_get_getp (s);
       if (!bytes_to_write)
 	break;
 
-      bytes_written = write (zfpm_g->sock, STREAM_PNT (s), bytes_to_write);
+      bytes_written = write (client->sock, STREAM_PNT (s), bytes_to_write);
       zfpm_g->stats.write_calls++;
       num_writes++;
 
@@ -1057,7 +1125,7 @@ zfpm_write_cb (struct thread *thread)
 	  if (ERRNO_IO_RETRY (errno))
 	    break;
 
-	  zfpm_connection_down ("failed to write to socket");
+	  zfpm_connection_down (client, "failed to write to socket");
 	  return 0;
 	}
 
@@ -1065,7 +1133,8 @@ zfpm_write_cb (struct thread *thread)
 	{
 
 	  /*
-	   * Partial write.
+	   * Partial write. The FPM is not keeping up: wait for its
+	   * socket to drain before reading further down the log.
 	   */
 	  stream_forward_getp (s, bytes_written);
 	  zfpm_g->stats.partial_writes++;
@@ -1090,8 +1159,8 @@ zfpm_write_cb (struct thread *thread)
 	}
     } while (1);
 
-  if (zfpm_writes_pending ())
-      zfpm_write_on ();
+  if (zfpm_writes_pending (client))
+      zfpm_write_on (client);
 
   return 0;
 }
@@ -1102,12 +1171,14 @@ zfpm_write_cb (struct thread *thread)
 static int
 zfpm_connect_cb (struct thread *t)
 {
+  zfpm_client_t *client;
   int sock, ret;
   struct sockaddr_in serv;
 
-  assert (zfpm_g->t_connect);
-  zfpm_g->t_connect = NULL;
-  assert (zfpm_g->state == ZFPM_STATE_ACTIVE);
+  client = THREAD_ARG (t);
+  assert (client->t_connect);
+  client->t_connect = NULL;
+  assert (client->state == ZFPM_STATE_ACTIVE);
 
   sock = socket (AF_INET, SOCK_STREAM, 0);
   if (sock < 0)
@@ -1122,55 +1193,57 @@ zfpm_connect_cb (struct thread *t)
   /* Make server socket. */
   memset (&serv, 0, sizeof (serv));
   serv.sin_family = AF_INET;
-  serv.sin_port = htons (zfpm_g->fpm_port);
+  serv.sin_port = htons (client->fpm_port);
 #ifdef HAVE_STRUCT_SOCKADDR_IN_SIN_LEN
   serv.sin_len = sizeof (struct sockaddr_in);
 #endif /* HAVE_STRUCT_SOCKADDR_IN_SIN_LEN */
-  serv.sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+  serv.sin_addr = client->addr;
 
   /*
    * Connect to the FPM.
    */
-  zfpm_g->connect_calls++;
+  client->connect_calls++;
   zfpm_g->stats.connect_calls++;
-  zfpm_g->last_connect_call_time = zfpm_get_time ();
+  client->last_connect_call_time = zfpm_get_time ();
 
   ret = connect (sock, (struct sockaddr *) &serv, sizeof (serv));
   if (ret >= 0)
     {
-      zfpm_g->sock = sock;
-      zfpm_connection_up ("connect succeeded");
+      client->sock = sock;
+      zfpm_connection_up (client, "connect succeeded");
       return 1;
     }
 
   if (errno == EINPROGRESS)
     {
-      zfpm_g->sock = sock;
-      zfpm_read_on ();
-      zfpm_write_on ();
-      zfpm_set_state (ZFPM_STATE_CONNECTING, "async connect in progress");
+      client->sock = sock;
+      zfpm_read_on (client);
+      zfpm_write_on (client);
+      zfpm_set_state (client, ZFPM_STATE_CONNECTING,
+		      "async connect in progress");
       return 0;
     }
 
-  zlog_info ("can't connect to FPM %d: %s", sock, safe_strerror (errno));
+  zlog_info ("can't connect to FPM at %s:%d: %s", inet_ntoa (client->addr),
+	     client->fpm_port, safe_strerror (errno));
   close (sock);
 
   /*
    * Restart timer for retrying connection.
    */
-  zfpm_start_connect_timer ("connect() failed");
+  zfpm_start_connect_timer (client, "connect() failed");
   return 0;
 }
 
 /*
  * zfpm_set_state
  *
- * Move state machine into the given state.
+ * Move the state machine of an FPM connection into the given state.
  */
 static void
-zfpm_set_state (zfpm_state_t state, const char *reason)
+zfpm_set_state (zfpm_client_t *client, zfpm_state_t state, const char *reason)
 {
-  zfpm_state_t cur_state = zfpm_g->state;
+  zfpm_state_t cur_state = client->state;
 
   if (!reason)
     reason = "Unknown";
@@ -1178,7 +1251,8 @@ zfpm_set_state (zfpm_state_t state, const char *reason)
   if (state == cur_state)
     return;
 
-  zfpm_debug("beginning state transition %s -> %s. Reason: %s",
+  zfpm_debug("%s:%d beginning state transition %s -> %s. Reason: %s",
+	     inet_ntoa (client->addr), client->fpm_port,
 	     zfpm_state_to_str (cur_state), zfpm_state_to_str (state),
 	     reason);
 
@@ -1191,26 +1265,26 @@ zfpm_set_state (zfpm_state_t state, const char *reason)
   case ZFPM_STATE_ACTIVE:
      assert (cur_state == ZFPM_STATE_IDLE ||
 	     cur_state == ZFPM_STATE_CONNECTING);
-    assert (zfpm_g->t_connect);
+    assert (client->t_connect);
     break;
 
   case ZFPM_STATE_CONNECTING:
-    assert (zfpm_g->sock);
+    assert (client->sock);
     assert (cur_state == ZFPM_STATE_ACTIVE);
-    assert (zfpm_g->t_read);
-    assert (zfpm_g->t_write);
+    assert (client->t_read);
+    assert (client->t_write);
     break;
 
   case ZFPM_STATE_ESTABLISHED:
     assert (cur_state == ZFPM_STATE_ACTIVE ||
 	    cur_state == ZFPM_STATE_CONNECTING);
-    assert (zfpm_g->sock);
-    assert (zfpm_g->t_read);
-    assert (zfpm_g->t_write);
+    assert (client->sock);
+    assert (client->t_read);
+    assert (client->t_write);
     break;
   }
 
-  zfpm_g->state = state;
+  client->state = state;
 }
 
 /*
@@ -1220,19 +1294,19 @@ zfpm_set_state (zfpm_state_t state, const char *reason)
  * reconnect to the FPM.
  */
 static long
-zfpm_calc_connect_delay (void)
+zfpm_calc_connect_delay (zfpm_client_t *client)
 {
   time_t elapsed;
 
   /*
    * Return 0 if this is our first attempt to connect.
    */
-  if (zfpm_g->connect_calls == 0)
+  if (client->connect_calls == 0)
     {
       return 0;
     }
 
-  elapsed = zfpm_get_elapsed_time (zfpm_g->last_connect_call_time);
+  elapsed = zfpm_get_elapsed_time (client->last_connect_call_time);
 
   if (elapsed > ZFPM_CONNECT_RETRY_IVL) {
     return 0;
@@ -1245,23 +1319,23 @@ zfpm_calc_connect_delay (void)
  * zfpm_start_connect_timer
  */
 static void
-zfpm_start_connect_timer (const char *reason)
+zfpm_start_connect_timer (zfpm_client_t *client, const char *reason)
 {
   long delay_secs;
 
-  assert (!zfpm_g->t_connect);
-  assert (zfpm_g->sock < 0);
+  assert (!client->t_connect);
+  assert (client->sock < 0);
 
-  assert(zfpm_g->state == ZFPM_STATE_IDLE ||
-	 zfpm_g->state == ZFPM_STATE_ACTIVE ||
-	 zfpm_g->state == ZFPM_STATE_CONNECTING);
+  assert(client->state == ZFPM_STATE_IDLE ||
+	 client->state == ZFPM_STATE_ACTIVE ||
+	 client->state == ZFPM_STATE_CONNECTING);
 
-  delay_secs = zfpm_calc_connect_delay();
+  delay_secs = zfpm_calc_connect_delay (client);
   zfpm_debug ("scheduling connect in %ld seconds", delay_secs);
 
-  THREAD_TIMER_ON (zfpm_g->master, zfpm_g->t_connect, zfpm_connect_cb, 0,
+  THREAD_TIMER_ON (zfpm_g->master, client->t_connect, zfpm_connect_cb, client,
 		   delay_secs);
-  zfpm_set_state (ZFPM_STATE_ACTIVE, reason);
+  zfpm_set_state (client, ZFPM_STATE_ACTIVE, reason);
 }
 
 /*
@@ -1278,15 +1352,15 @@ zfpm_is_enabled (void)
 /*
  * zfpm_conn_is_up
  *
- * Returns TRUE if the connection to the FPM is up.
+ * Returns TRUE if the connection to the given FPM is up.
  */
 static inline int
-zfpm_conn_is_up (void)
+zfpm_conn_is_up (zfpm_client_t *client)
 {
-  if (zfpm_g->state != ZFPM_STATE_ESTABLISHED)
+  if (client->state != ZFPM_STATE_ESTABLISHED)
     return 0;
 
-  assert (zfpm_g->sock >= 0);
+  assert (client->sock >= 0);
 
   return 1;
 }
@@ -1301,13 +1375,15 @@ void
 zfpm_trigger_update (struct route_node *rn, const char *reason)
 {
   rib_dest_t *dest;
+  zfpm_client_t *client;
   char buf[INET6_ADDRSTRLEN];
+  int i;
 
   /*
-   * Ignore if the connection is down. We will update the FPM about
-   * all destinations once the connection comes up.
+   * The log is kept whether or not any FPM is connected: it is what
+   * they are brought up to date from once they connect.
    */
-  if (!zfpm_conn_is_up ())
+  if (!zfpm_is_enabled ())
     return;
 
   dest = rib_dest_from_rnode (rn);
@@ -1322,11 +1398,6 @@ zfpm_trigger_update (struct route_node *rn, const char *reason)
       return;
     }
 
-  if (CHECK_FLAG (dest->flags, RIB_DEST_UPDATE_FPM)) {
-    zfpm_g->stats.redundant_triggers++;
-    return;
-  }
-
   if (reason)
     {
       zfpm_debug ("%s/%d triggering update to FPM - Reason: %s",
@@ -1334,17 +1405,32 @@ zfpm_trigger_update (struct route_node *rn, const char *reason)
 		  rn->p.prefixlen, reason);
     }
 
-  SET_FLAG (dest->flags, RIB_DEST_UPDATE_FPM);
-  TAILQ_INSERT_TAIL (&zfpm_g->dest_q, dest, fpm_q_entries);
+  zfpm_log_append (dest);
   zfpm_g->stats.updates_triggered++;
 
   /*
    * Make sure that writes are enabled.
    */
-  if (zfpm_g->t_write)
-    return;
+  for (i = 0; i < zfpm_g->num_clients; i++)
+    {
+      client = &zfpm_g->clients[i];
+      if (zfpm_conn_is_up (client) && !client->t_write)
+	zfpm_write_on (client);
+    }
+}
 
-  zfpm_write_on ();
+/*
+ * zfpm_dest_release
+ *
+ * Called when the given dest, which is on the update log, is about to
+ * be deleted. No FPM has it installed, so there is nothing left to
+ * tell them about it.
+ */
+void
+zfpm_dest_release (rib_dest_t *dest)
+{
+  assert (!dest->fpm_sent);
+  zfpm_log_remove (dest);
 }
 
 /*
@@ -1442,18 +1528,13 @@ zfpm_show_stats (struct vty *vty)
   ZFPM_SHOW_STAT (route_adds);
   ZFPM_SHOW_STAT (route_dels);
   ZFPM_SHOW_STAT (updates_triggered);
+  ZFPM_SHOW_STAT (updates_requeued);
   ZFPM_SHOW_STAT (non_fpm_table_triggers);
-  ZFPM_SHOW_STAT (redundant_triggers);
   ZFPM_SHOW_STAT (dests_del_after_update);
-  ZFPM_SHOW_STAT (t_conn_down_starts);
-  ZFPM_SHOW_STAT (t_conn_down_dests_processed);
-  ZFPM_SHOW_STAT (t_conn_down_yields);
-  ZFPM_SHOW_STAT (t_conn_down_finishes);
-  ZFPM_SHOW_STAT (t_conn_up_starts);
-  ZFPM_SHOW_STAT (t_conn_up_dests_processed);
-  ZFPM_SHOW_STAT (t_conn_up_yields);
-  ZFPM_SHOW_STAT (t_conn_up_aborts);
-  ZFPM_SHOW_STAT (t_conn_up_finishes);
+  ZFPM_SHOW_STAT (resyncs);
+  ZFPM_SHOW_STAT (conn_downs);
+  ZFPM_SHOW_STAT (nhg_defs);
+  ZFPM_SHOW_STAT (compact_fallbacks);
 
   if (!zfpm_g->last_stats_clear_time)
     return;
@@ -1503,6 +1584,62 @@ DEFUN (show_zebra_fpm_stats,
   return CMD_SUCCESS;
 }
 
+/*
+ * zfpm_show_clients
+ */
+static void
+zfpm_show_clients (struct vty *vty)
+{
+  zfpm_client_t *client;
+  int i;
+
+  if (!zfpm_is_enabled ())
+    {
+      vty_out (vty, "The FPM module is not enabled...%s", VTY_NEWLINE);
+      return;
+    }
+
+  vty_out (vty, "%-21s %-8s %-12s %-8s %10s %10s %8s%s", "FPM", "Encoding",
+	   "State", "Sync", "Adds", "Dels", "Queued", VTY_NEWLINE);
+
+  for (i = 0; i < zfpm_g->num_clients; i++)
+    {
+      char addr[INET_ADDRSTRLEN + 6];
+
+      client = &zfpm_g->clients[i];
+      snprintf (addr, sizeof (addr), "%s:%d", inet_ntoa (client->addr),
+		client->fpm_port);
+      vty_out (vty, "%-21s %-8s %-12s %-8s %10lu %10lu %8lu%s", addr,
+	       client->compact ? "compact" : "netlink",
+	       zfpm_state_to_str (client->state),
+	       !zfpm_conn_is_up (client) ? "-" :
+	       (client->synced ? "done" : "walking"),
+	       client->route_adds, client->route_dels,
+	       (unsigned long) (client->obuf ?
+				(stream_get_endp (client->obuf)
+				 - stream_get_getp (client->obuf)) : 0),
+	       VTY_NEWLINE);
+    }
+
+  vty_out (vty, "%sNexthop groups: %lu%s", VTY_NEWLINE,
+	   zfpm_compact_nhg_count (), VTY_NEWLINE);
+}
+
+/*
+ * show_zebra_fpm_clients
+ */
+DEFUN (show_zebra_fpm_clients,
+       show_zebra_fpm_clients_cmd,
+       "show zebra fpm clients",
+       SHOW_STR
+       "Zebra information\n"
+       "Forwarding Path Manager information\n"
+       "Connections to each FPM\n")
+{
+  zfpm_show_clients (vty);
+  return CMD_SUCCESS;
+}
+
 /*
  * clear_zebra_fpm_stats
  */
@@ -1518,12 +1655,74 @@ DEFUN (clear_zebra_fpm_stats,
   return CMD_SUCCESS;
 }
 
+/**
+ * zfpm_add_client
+ *
+ * Add an FPM to talk to, given as "A.B.C.D" or "A.B.C.D:port",
+ * optionally followed by ",compact" if routes should be sent to it in
+ * compact messages. Must be called before zfpm_init(). Without any, the
+ * FPM is expected on the loopback address.
+ *
+ * Returns 0 on success, -1 if the address is malformed or there are
+ * too many FPMs.
+ */
+int
+zfpm_add_client (const char *spec)
+{
+  char buf[INET_ADDRSTRLEN + sizeof (":65535")];
+  const char *comma;
+  char *colon;
+  struct in_addr addr;
+  long port;
+  int compact;
+  char *end;
+
+  if (zfpm_num_client_conf >= ZFPM_MAX_CLIENTS)
+    return -1;
+
+  compact = 0;
+  comma = strchr (spec, ',');
+  if (comma)
+    {
+      if (strcmp (comma + 1, "compact"))
+	return -1;
+      compact = 1;
+    }
+  else
+    comma = spec + strlen (spec);
+
+  if ((size_t) (comma - spec) >= sizeof (buf))
+    return -1;
+  memcpy (buf, spec, comma - spec);
+  buf[comma - spec] = '\0';
+
+  port = FPM_DEFAULT_PORT;
+  colon = strchr (buf, ':');
+  if (colon)
+    {
+      *colon = '\0';
+      port = strtol (colon + 1, &end, 10);
+      if (*end != '\0' || port <= 0 || port > 65535)
+	return -1;
+    }
+
+  if (inet_aton (buf, &addr) == 0)
+    return -1;
+
+  zfpm_client_conf[zfpm_num_client_conf].addr = addr;
+  zfpm_client_conf[zfpm_num_client_conf].port = port;
+  zfpm_client_conf[zfpm_num_client_conf].compact = compact;
+  zfpm_num_client_conf++;
+  return 0;
+}
+
 /**
  * zfpm_init
  *
  * One-time initialization of the Zebra FPM module.
  *
- * @param[in] port port at which FPM is running.
+ * @param[in] port port at which FPM is running, unless given by
+ *                 zfpm_add_client().
  * @param[in] enable TRUE if the zebra FPM module should be enabled
  *
  * Returns TRUE on success.
@@ -1532,6 +1731,8 @@ int
 zfpm_init (struct thread_master *master, int enable, uint16_t port)
 {
   static int initialized = 0;
+  zfpm_client_t *client;
+  int i;
 
   if (initialized) {
     return 1;
@@ -1542,8 +1743,6 @@ zfpm_init (struct thread_master *master, int enable, uint16_t port)
   memset (zfpm_g, 0, sizeof (*zfpm_g));
   zfpm_g->master = master;
   TAILQ_INIT(&zfpm_g->dest_q);
-  zfpm_g->sock = -1;
-  zfpm_g->state = ZFPM_STATE_IDLE;
 
   /*
    * Netlink must currently be available for the Zebra-FPM interface
@@ -1560,6 +1759,7 @@ zfpm_init (struct thread_master *master, int enable, uint16_t port)
   zfpm_stats_init (&zfpm_g->cumulative_stats);
 
   install_element (ENABLE_NODE, &show_zebra_fpm_stats_cmd);
+  install_element (ENABLE_NODE, &show_zebra_fpm_clients_cmd);
   install_element (ENABLE_NODE, &clear_zebra_fpm_stats_cmd);
 
   if (!enable) {
@@ -1569,13 +1769,30 @@ zfpm_init (struct thread_master *master, int enable, uint16_t port)
   if (!port)
     port = FPM_DEFAULT_PORT;
 
-  zfpm_g->fpm_port = port;
-
-  zfpm_g->obuf = stream_new (ZFPM_OBUF_SIZE);
-  zfpm_g->ibuf = stream_new (ZFPM_IBUF_SIZE);
+  if (!zfpm_num_client_conf)
+    {
+      zfpm_client_conf[0].addr.s_addr = htonl (INADDR_LOOPBACK);
+      zfpm_client_conf[0].port = port;
+      zfpm_num_client_conf = 1;
+    }
 
   zfpm_start_stats_timer ();
-  zfpm_start_connect_timer ("initialized");
+
+  for (i = 0; i < zfpm_num_client_conf; i++)
+    {
+      client = &zfpm_g->clients[i];
+      client->index = i;
+      client->addr = zfpm_client_conf[i].addr;
+      client->fpm_port = zfpm_client_conf[i].port;
+      client->compact = zfpm_client_conf[i].compact;
+      client->sock = -1;
+      client->state = ZFPM_STATE_IDLE;
+      client->obuf = stream_new (ZFPM_OBUF_SIZE);
+      client->ibuf = stream_new (ZFPM_IBUF_SIZE);
+      zfpm_g->num_clients++;
+
+      zfpm_start_connect_timer (client, "initialized");
+    }
 
   return 1;
 }
@@ -28,7 +28,9 @@
 /*
  * Externs.
  */
+extern int zfpm_add_client (const char *spec);
 extern int zfpm_init (struct thread_master *master, int enable, uint16_t port);
 extern void zfpm_trigger_update (struct route_node *rn, const char *reason);
+extern void zfpm_dest_release (rib_dest_t *dest);
 
 #endif /* _ZEBRA_FPM_H */
@@ -0,0 +1,501 @@
+/*
+ * Code for encoding FPM messages in the compact format.
+ *
+ * This file is part of GNU Zebra.
+ *
+ * GNU Zebra is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * GNU Zebra is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Zebra; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include <zebra.h>
+
+#include "log.h"
+#include "memory.h"
+#include "hash.h"
+#include "jhash.h"
+#include "rib.h"
+
+#include "fpm/fpm.h"
+#include "zebra_fpm_private.h"
+
+/*
+ * Maximum number of nexthops in a group, as for netlink messages.
+ */
+#define ZFPM_NHG_MAX_NHS MAX (MULTIPATH_NUM, 64)
+
+/*
+ * Maximum number of nexthop groups. Routes that would need more are
+ * sent as netlink messages.
+ */
+#define ZFPM_NHG_MAX 65536
+
+/*
+ * zfpm_nh_t
+ */
+typedef struct zfpm_nh_t_
+{
+  uint32_t if_index;
+  u_char has_gateway;
+  union g_addr gateway;
+} zfpm_nh_t;
+
+/*
+ * zfpm_nhg_t
+ *
+ * A nexthop group, shared by all routes with the same forwarding
+ * information. The fields from 'family' onwards make up the key.
+ */
+typedef struct zfpm_nhg_t_
+{
+  uint32_t id;
+
+  /*
+   * Bitmask of the FPM connections this group has been defined on.
+   */
+  u_char defined;
+
+  u_char family;
+  u_char type;
+  u_char route_type;
+  u_char has_pref_src;
+  uint32_t metric;
+  union g_addr pref_src;
+  int num_nhs;
+  zfpm_nh_t nhs[1];
+} zfpm_nhg_t;
+
+#define ZFPM_NHG_SIZE(num_nhs) \
+  (offsetof (zfpm_nhg_t, nhs) + (num_nhs) * sizeof (zfpm_nh_t))
+
+#define ZFPM_NHG_KEY_LEN(nhg) \
+  (ZFPM_NHG_SIZE ((nhg)->num_nhs) - offsetof (zfpm_nhg_t, family))
+
+static struct hash *zfpm_nhg_hash;
+static uint32_t zfpm_nhg_next_id = 1;
+
+static unsigned int
+zfpm_nhg_hash_key (void *arg)
+{
+  zfpm_nhg_t *nhg = arg;
+
+  return jhash (&nhg->family, ZFPM_NHG_KEY_LEN (nhg), 0);
+}
+
+static int
+zfpm_nhg_hash_cmp (const void *a, const void *b)
+{
+  const zfpm_nhg_t *nhg1 = a;
+  const zfpm_nhg_t *nhg2 = b;
+
+  if (nhg1->num_nhs != nhg2->num_nhs)
+    return 0;
+
+  return !memcmp (&nhg1->family, &nhg2->family, ZFPM_NHG_KEY_LEN (nhg1));
+}
+
+static void *
+zfpm_nhg_alloc (void *arg)
+{
+  zfpm_nhg_t *key = arg;
+  zfpm_nhg_t *nhg;
+
+  nhg = XMALLOC (MTYPE_FPM_NHG, ZFPM_NHG_SIZE (key->num_nhs));
+  memcpy (nhg, key, ZFPM_NHG_SIZE (key->num_nhs));
+  nhg->id = zfpm_nhg_next_id++;
+  nhg->defined = 0;
+  return nhg;
+}
+
+/*
+ * af_addr_size
+ */
+static size_t
+af_addr_size (u_char af)
+{
+#ifdef HAVE_IPV6
+  if (af == AF_INET6)
+    return 16;
+#endif /* HAVE_IPV6 */
+  return 4;
+}
+
+/*
+ * zfpm_nhg_copy_addr
+ *
+ * Copy only as much of an address as the family uses, so that keys
+ * compare equal.
+ */
+static inline void
+zfpm_nhg_copy_addr (u_char af, union g_addr *dst, union g_addr *src)
+{
+#ifdef HAVE_IPV6
+  if (af == AF_INET6)
+    {
+      dst->ipv6 = src->ipv6;
+      return;
+    }
+#endif /* HAVE_IPV6 */
+  dst->ipv4 = src->ipv4;
+}
+
+/*
+ * zfpm_nhg_add_nh
+ *
+ * Add the given nexthop to a group being filled in, following the
+ * same rules as the netlink encoding.
+ *
+ * Returns TRUE if a nexthop was added, FALSE otherwise.
+ */
+static int
+zfpm_nhg_add_nh (zfpm_nhg_t *nhg, struct nexthop *nexthop)
+{
+  enum nexthop_types_t type;
+  union g_addr *gate, *gateway, *src;
+  uint32_t if_index;
+  zfpm_nh_t *nh;
+
+  if (nhg->num_nhs >= ZFPM_NHG_MAX_NHS)
+    return 0;
+
+  if (CHECK_FLAG (nexthop->flags, NEXTHOP_FLAG_RECURSIVE))
+    {
+      type = nexthop->rtype;
+      if_index = nexthop->rifindex;
+      gate = &nexthop->rgate;
+    }
+  else
+    {
+      type = nexthop->type;
+      if_index = nexthop->ifindex;
+      gate = &nexthop->gate;
+    }
+
+  gateway = src = NULL;
+  switch (type)
+    {
+    case NEXTHOP_TYPE_IPV4:
+    case NEXTHOP_TYPE_IPV4_IFINDEX:
+      gateway = gate;
+      if (nexthop->src.ipv4.s_addr)
+	src = &nexthop->src;
+      break;
+#ifdef HAVE_IPV6
+    case NEXTHOP_TYPE_IPV6:
+    case NEXTHOP_TYPE_IPV6_IFINDEX:
+    case NEXTHOP_TYPE_IPV6_IFNAME:
+      gateway = gate;
+      break;
+#endif /* HAVE_IPV6 */
+    case NEXTHOP_TYPE_IFINDEX:
+    case NEXTHOP_TYPE_IFNAME:
+      if (nexthop->src.ipv4.s_addr)
+	src = &nexthop->src;
+      break;
+    default:
+      break;
+    }
+
+  if (!gateway && if_index == 0)
+    return 0;
+
+  nh = &nhg->nhs[nhg->num_nhs++];
+  nh->if_index = if_index;
+  if (gateway)
+    {
+      nh->has_gateway = 1;
+      zfpm_nhg_copy_addr (nhg->family, &nh->gateway, gateway);
+    }
+
+  if (src && !nhg->has_pref_src)
+    {
+      nhg->has_pref_src = 1;
+      zfpm_nhg_copy_addr (nhg->family, &nhg->pref_src, src);
+    }
+
+  return 1;
+}
+
+/*
+ * zfpm_nhg_fill
+ *
+ * Fill in the nexthop group key for the given route.
+ *
+ * Returns TRUE on success and FALSE if the route has no useful
+ * nexthop.
+ */
+static int
+zfpm_nhg_fill (zfpm_nhg_t *nhg, rib_dest_t *dest, struct rib *rib)
+{
+  struct nexthop *nexthop;
+
+  memset (nhg, 0, ZFPM_NHG_SIZE (ZFPM_NHG_MAX_NHS));
+
+  nhg->family = rib_dest_af (dest);
+  nhg->route_type = rib->type;
+  nhg->metric = rib->metric;
+
+  if (rib->flags & ZEBRA_FLAG_BLACKHOLE)
+    {
+      nhg->type = FPM_COMPACT_NHG_BLACKHOLE;
+      return 1;
+    }
+
+  if (rib->flags & ZEBRA_FLAG_REJECT)
+    {
+      nhg->type = FPM_COMPACT_NHG_UNREACHABLE;
+      return 1;
+    }
+
+  nhg->type = FPM_COMPACT_NHG_UNICAST;
+
+  for (nexthop = rib->nexthop;
+       nexthop && (MULTIPATH_NUM == 0 || nhg->num_nhs < MULTIPATH_NUM);
+       nexthop = nexthop->next)
+    {
+      if (!CHECK_FLAG (nexthop->flags, NEXTHOP_FLAG_ACTIVE))
+	continue;
+
+      zfpm_nhg_add_nh (nhg, nexthop);
+
+      /* Single path case. */
+      if (nhg->num_nhs && (rib->nexthop_active_num == 1 || MULTIPATH_NUM == 1))
+	break;
+    }
+
+  return nhg->num_nhs > 0;
+}
+
+/*
+ * zfpm_nhg_encode
+ *
+ * Write a message defining the given group to the buffer.
+ *
+ * Returns the number of bytes written.
+ */
+static size_t
+zfpm_nhg_encode (zfpm_nhg_t *nhg, char *buf, size_t buf_len)
+{
+  fpm_msg_hdr_t *hdr;
+  fpm_compact_hdr_t *chdr;
+  fpm_compact_nhg_t *cnhg;
+  fpm_compact_nh_t *cnh;
+  size_t addr_len, data_len, msg_len;
+  char *data, *p;
+  int i;
+
+  addr_len = af_addr_size (nhg->family);
+
+  data_len = sizeof (*chdr) + sizeof (*cnhg);
+  for (i = 0; i < nhg->num_nhs; i++)
+    data_len += sizeof (*cnh) + (nhg->nhs[i].has_gateway ? addr_len : 0);
+  if (nhg->has_pref_src)
+    data_len += addr_len;
+
+  msg_len = fpm_data_len_to_msg_len (data_len);
+  if (msg_len > buf_len || msg_len > FPM_MAX_MSG_LEN)
+    {
+      assert (0);
+      return 0;
+    }
+
+  memset (buf, 0, msg_len);
+
+  hdr = (fpm_msg_hdr_t *) buf;
+  hdr->version = FPM_PROTO_VERSION;
+  hdr->msg_type = FPM_MSG_TYPE_COMPACT;
+  hdr->msg_len = htons (msg_len);
+
+  data = fpm_msg_data (hdr);
+
+  chdr = (fpm_compact_hdr_t *) data;
+  chdr->op = FPM_COMPACT_OP_NHG_ADD;
+  chdr->family = nhg->family;
+  chdr->count = htons (nhg->num_nhs);
+  chdr->nhg_id = htonl (nhg->id);
+
+  cnhg = (fpm_compact_nhg_t *) (chdr + 1);
+  cnhg->type = nhg->type;
+  cnhg->route_type = nhg->route_type;
+  cnhg->flags = nhg->has_pref_src ? FPM_COMPACT_NHG_F_PREFSRC : 0;
+  cnhg->metric = htonl (nhg->metric);
+
+  p = (char *) (cnhg + 1);
+  for (i = 0; i < nhg->num_nhs; i++)
+    {
+      cnh = (fpm_compact_nh_t *) p;
+      cnh->if_index = htonl (nhg->nhs[i].if_index);
+      p += sizeof (*cnh);
+
+      if (!nhg->nhs[i].has_gateway)
+	continue;
+
+      cnh->flags = FPM_COMPACT_NH_F_GATEWAY;
+      memcpy (p, &nhg->nhs[i].gateway, addr_len);
+      p += addr_len;
+    }
+
+  if (nhg->has_pref_src)
+    memcpy (p, &nhg->pref_src, addr_len);
+
+  return msg_len;
+}
+
+/*
+ * zfpm_compact_encode_nhg
+ *
+ * Look up the nexthop group for the given route, and if the FPM on
+ * connection 'client' does not know about it yet, write a message
+ * defining it to the buffer, which must have room for a message of
+ * maximum size.
+ *
+ * Returns the number of bytes written, 0 if the group was defined
+ * already, or -1 if the route cannot be sent in compact form.
+ */
+int
+zfpm_compact_encode_nhg (rib_dest_t *dest, struct rib *rib, int client,
+			 uint32_t *nhg_id, char *buf, size_t buf_len)
+{
+  union
+  {
+    zfpm_nhg_t nhg;
+    char space[ZFPM_NHG_SIZE (ZFPM_NHG_MAX_NHS)];
+  } key;
+  zfpm_nhg_t *nhg;
+
+  if (!zfpm_nhg_fill (&key.nhg, dest, rib))
+    return -1;
+
+  if (!zfpm_nhg_hash)
+    {
+      zfpm_nhg_hash = hash_create (zfpm_nhg_hash_key, zfpm_nhg_hash_cmp);
+      hash_set_name (zfpm_nhg_hash, "FPM nexthop groups");
+    }
+
+  nhg = hash_lookup (zfpm_nhg_hash, &key.nhg);
+  if (!nhg)
+    {
+      if (zfpm_nhg_hash->count >= ZFPM_NHG_MAX)
+	return -1;
+      nhg = hash_get (zfpm_nhg_hash, &key.nhg, zfpm_nhg_alloc);
+    }
+
+  *nhg_id = nhg->id;
+
+  if (nhg->defined & (1 << client))
+    return 0;
+
+  nhg->defined |= (1 << client);
+  return zfpm_nhg_encode (nhg, buf, buf_len);
+}
+
+/*
+ * zfpm_compact_route_start
+ *
+ * Start a message for adding routes using the given nexthop group, or
+ * deleting routes, in the buffer, which must have room for a message
+ * of maximum size. Prefixes are then added with
+ * zfpm_compact_route_append().
+ *
+ * Returns the length of the message payload so far.
+ */
+size_t
+zfpm_compact_route_start (int add, u_char family, uint32_t nhg_id, char *buf)
+{
+  fpm_msg_hdr_t *hdr;
+  fpm_compact_hdr_t *chdr;
+
+  hdr = (fpm_msg_hdr_t *) buf;
+  hdr->version = FPM_PROTO_VERSION;
+  hdr->msg_type = FPM_MSG_TYPE_COMPACT;
+  hdr->msg_len = htons (fpm_data_len_to_msg_len (sizeof (*chdr)));
+
+  chdr = fpm_msg_data (hdr);
+  memset (chdr, 0, sizeof (*chdr));
+  chdr->op = add ? FPM_COMPACT_OP_ROUTE_ADD : FPM_COMPACT_OP_ROUTE_DEL;
+  chdr->family = family;
+  chdr->nhg_id = add ? htonl (nhg_id) : 0;
+
+  return sizeof (*chdr);
+}
+
+/*
+ * zfpm_compact_route_append
+ *
+ * Add a prefix to the message started at 'buf', whose payload is
+ * 'data_len' bytes long. The caller makes sure that the message stays
+ * within FPM_MAX_MSG_LEN, leaving ZFPM_COMPACT_PREFIX_MAX_LEN bytes.
+ *
+ * Returns the new length of the message payload.
+ */
+size_t
+zfpm_compact_route_append (char *buf, size_t data_len, struct prefix *p)
+{
+  fpm_msg_hdr_t *hdr;
+  fpm_compact_hdr_t *chdr;
+  u_char *data;
+  size_t msg_len, psize;
+
+  hdr = (fpm_msg_hdr_t *) buf;
+  chdr = fpm_msg_data (hdr);
+  data = ((u_char *) chdr) + data_len;
+
+  psize = PSIZE (p->prefixlen);
+  *data++ = p->prefixlen;
+  memcpy (data, &p->u.prefix, psize);
+  data_len += 1 + psize;
+
+  chdr->count = htons (ntohs (chdr->count) + 1);
+
+  /*
+   * Keep the padding up to the aligned length zeroed.
+   */
+  msg_len = fpm_data_len_to_msg_len (data_len);
+  memset (((char *) chdr) + data_len, 0,
+	  msg_len - FPM_MSG_HDR_LEN - data_len);
+  hdr->msg_len = htons (msg_len);
+
+  return data_len;
+}
+
+static void
+zfpm_nhg_undefine (struct hash_backet *backet, void *arg)
+{
+  zfpm_nhg_t *nhg = backet->data;
+  int client = *(int *) arg;
+
+  nhg->defined &= ~(1 << client);
+}
+
+/*
+ * zfpm_compact_client_reset
+ *
+ * Forget which nexthop groups the FPM on connection 'client' knows
+ * about, as its connection has just come up.
+ */
+void
+zfpm_compact_client_reset (int client)
+{
+  if (zfpm_nhg_hash)
+    hash_iterate (zfpm_nhg_hash, zfpm_nhg_undefine, &client);
+}
+
+/*
+ * zfpm_compact_nhg_count
+ */
+unsigned long
+zfpm_compact_nhg_count (void)
+{
+  return zfpm_nhg_hash ? zfpm_nhg_hash->count : 0;
+}
@@ -53,4 +53,20 @@ extern int
 zfpm_netlink_encode_route (int cmd, rib_dest_t *dest, struct rib *rib,
 			   char *in_buf, size_t in_buf_len);
 
+/*
+ * Largest prefix in a compact route message: length octet and an IPv6
+ * address.
+ */
+#define ZFPM_COMPACT_PREFIX_MAX_LEN (1 + 16)
+
+extern int
+zfpm_compact_encode_nhg (rib_dest_t *dest, struct rib *rib, int client,
+			 uint32_t *nhg_id, char *buf, size_t buf_len);
+extern size_t
+zfpm_compact_route_start (int add, u_char family, uint32_t nhg_id, char *buf);
+extern size_t
+zfpm_compact_route_append (char *buf, size_t data_len, struct prefix *p);
+extern void zfpm_compact_client_reset (int client);
+extern unsigned long zfpm_compact_nhg_count (void);
+
 #endif /* _ZEBRA_FPM_PRIVATE_H */
@@ -21,6 +21,10 @@
 
 #include <zebra.h>
 
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif /* HAVE_PTHREAD */
+
 #include "prefix.h"
 #include "table.h"
 #include "memory.h"
@@ -34,6 +38,9 @@
 #include "workqueue.h"
 #include "prefix.h"
 #include "routemap.h"
+#include "hash.h"
+#include "jhash.h"
+#include "trace.h"
 
 #include "zebra/rib.h"
 #include "zebra/rt.h"
@@ -51,6 +58,11 @@ extern struct zebra_t zebrad;
  */
 int rib_process_hold_time = 10;
 
+/* Threads, besides the main one, running best-route selection for BGP
+ * route_nodes of the meta queue.  0 keeps selection on the main thread.
+ */
+unsigned int rib_worker_threads = 0;
+
 /* Each route type's string and default distance value. */
 static const struct
 {  
@@ -75,6 +87,26 @@ static const struct
 /* Vector for routing table.  */
 static vector vrf_vector;
 
+/* The AFI/SAFI combinations of the tables of a vrf, in iteration
+   order. */
+static const struct
+{
+  afi_t afi;
+  safi_t safi;
+} rib_afi_safis[] =
+{
+  { AFI_IP, SAFI_UNICAST },
+  { AFI_IP, SAFI_MULTICAST },
+  { AFI_IP6, SAFI_UNICAST },
+  { AFI_IP6, SAFI_MULTICAST },
+};
+
+/* The tables with any ribs, in order, see rib_table_info_t. */
+static struct route_table *rib_tables_nonempty;
+
+/* Bumped each time a rib is linked to or unlinked from a table. */
+static u_int32_t rib_tables_ver;
+
 /*
  * vrf_table_create
  */
@@ -83,16 +115,23 @@ vrf_table_create (struct vrf *vrf, afi_t afi, safi_t safi)
 {
   rib_table_info_t *info;
   struct route_table *table;
+  unsigned int i;
 
   assert (!vrf->table[afi][safi]);
 
   table = route_table_init ();
+  route_table_set_family (table, afi2family (afi));
+  route_table_enable_index (table);
   vrf->table[afi][safi] = table;
 
   info = XCALLOC (MTYPE_RIB_TABLE_INFO, sizeof (*info));
   info->vrf = vrf;
   info->afi = afi;
   info->safi = safi;
+  for (i = 0; i < ZEBRA_NUM_OF (rib_afi_safis); i++)
+    if (rib_afi_safis[i].afi == afi && rib_afi_safis[i].safi == safi)
+      break;
+  info->order = vrf->id * ZEBRA_NUM_OF (rib_afi_safis) + i;
   table->info = info;
 }
 
@@ -365,273 +404,1260 @@ nexthop_blackhole_add (struct rib *rib)
   return nexthop;
 }
 
-/* If force flag is not set, do not modify falgs at all for uninstall
-   the route from FIB. */
+#ifdef HAVE_PTHREAD
+/* Worker pool selecting best routes in parallel, see
+ * process_subq_parallel().  Only route_nodes carrying nothing but BGP
+ * ribs are handed out: nexthops never resolve over BGP routes, so their
+ * selection neither depends on, nor affects, the rest of the batch.
+ * While a batch runs the main thread selects its own shard and waits,
+ * so the tables are not modified underneath the workers.
+ */
+struct rib_workers
+{
+  unsigned int count;
+  pthread_t *threads;
+
+  /* Batch hand-out.  A new generation starts the workers, pending
+     counts those not done with it yet. */
+  pthread_mutex_t mtx;
+  pthread_cond_t start;
+  pthread_cond_t done;
+  unsigned int generation;
+  unsigned int pending;
+  struct rib_select *batch;
+  unsigned int batch_count;
+
+  /* Set while a batch runs: state shared between route_nodes (the
+     resolution cache, route lock counts, route-maps) is then only
+     touched under 'lock'. */
+  int running;
+  pthread_mutex_t lock;
+
+  /* Statistics. */
+  unsigned long batches;
+  unsigned long nodes;
+};
+
+static struct rib_workers rib_workers;
+
+#define RIB_SELECT_LOCK() \
+  do { \
+    if (rib_workers.running) \
+      pthread_mutex_lock (&rib_workers.lock); \
+  } while (0)
+#define RIB_SELECT_UNLOCK() \
+  do { \
+    if (rib_workers.running) \
+      pthread_mutex_unlock (&rib_workers.lock); \
+  } while (0)
+#else
+#define RIB_SELECT_LOCK()
+#define RIB_SELECT_UNLOCK()
+#endif /* HAVE_PTHREAD */
+
+/* Resolution of gateway nexthops.  Many ribs share the same gateway,
+ * e.g. all BGP routes learnt from one peer, and resolving it walks the
+ * table each time.  Since the walk never resolves over BGP routes, its
+ * outcome only changes when a non-BGP route does, so it is computed once
+ * per gateway and kept until then.  Entries are also indexed by gateway
+ * in a table per family, so a change to a route only drops those it
+ * can affect: the gateways it covers that resolved over no longer a
+ * prefix.  rib_match_ipv4() and rib_match_ipv6() are looked up here
+ * too, with a type of 0.
+ */
+struct nexthop_resolve
+{
+  /* Key. */
+  u_char family;
+  u_char type;
+  u_char internal;
+  union g_addr gate;
+
+  /* Other entries for the same gateway in the index. */
+  struct nexthop_resolve *next;
+
+  /* Route the walk stopped at, locked, and its length, -1 if none. */
+  struct route_node *rn;
+  int matchlen;
+
+  u_char active;
+
+  /* Resolved over a connected route, and its interface if known. */
+  u_char connected;
+  u_char has_ifindex;
+  unsigned int ifindex;
+
+  /* First usable nexthop of the route resolved over. */
+  u_char rtype;
+  unsigned int rifindex;
+  union g_addr rgate;
+};
+
+static struct hash *nexthop_resolve_hash;
+static struct route_table *nexthop_resolve_index[AFI_MAX];
+
+static unsigned int
+nexthop_resolve_hash_key (void *arg)
+{
+  struct nexthop_resolve *nr = arg;
+  u_int32_t initval;
+
+  initval = (nr->family << 16) | (nr->type << 8) | nr->internal;
+  if (nr->family == AF_INET)
+    return jhash_1word (nr->gate.ipv4.s_addr, initval);
+  return jhash2 ((u_int32_t *) &nr->gate, sizeof (nr->gate) / 4, initval);
+}
+
 static int
-nexthop_active_ipv4 (struct rib *rib, struct nexthop *nexthop, int set,
-		     struct route_node *top)
+nexthop_resolve_hash_cmp (const void *a, const void *b)
+{
+  const struct nexthop_resolve *nr1 = a;
+  const struct nexthop_resolve *nr2 = b;
+
+  if (nr1->family != nr2->family
+      || nr1->type != nr2->type
+      || nr1->internal != nr2->internal)
+    return 0;
+
+  if (nr1->family == AF_INET)
+    return IPV4_ADDR_SAME (&nr1->gate.ipv4, &nr2->gate.ipv4);
+#ifdef HAVE_IPV6
+  return IPV6_ADDR_SAME (&nr1->gate.ipv6, &nr2->gate.ipv6);
+#else
+  return 0;
+#endif /* HAVE_IPV6 */
+}
+
+static void
+nexthop_resolve_free (void *arg)
+{
+  struct nexthop_resolve *nr = arg;
+
+  if (nr->rn)
+    route_unlock_node (nr->rn);
+  XFREE (MTYPE_NEXTHOP_RESOLVE, nr);
+}
+
+static void
+nexthop_resolve_host (struct prefix *p, int family, union g_addr *gate)
+{
+  memset (p, 0, sizeof (struct prefix));
+  p->family = family;
+  if (family == AF_INET)
+    {
+      p->prefixlen = IPV4_MAX_PREFIXLEN;
+      p->u.prefix4 = gate->ipv4;
+    }
+#ifdef HAVE_IPV6
+  else
+    {
+      p->prefixlen = IPV6_MAX_PREFIXLEN;
+      p->u.prefix6 = gate->ipv6;
+    }
+#endif /* HAVE_IPV6 */
+}
+
+static void rib_nhobj_schedule (void);
+
+/* A non-BGP route of prefix p changed, or any route if p is NULL: what
+   was resolved over it or over a shorter prefix covering it may be
+   stale, and nexthop objects may have to follow. */
+void
+rib_nexthop_resolve_flush (struct prefix *p)
+{
+  struct route_node *top;
+  struct route_node *rn;
+  struct nexthop_resolve *nr;
+  struct nexthop_resolve *next;
+  afi_t afi;
+
+  rib_nhobj_schedule ();
+  if (! nexthop_resolve_hash || ! nexthop_resolve_hash->count)
+    return;
+
+  if (! p)
+    {
+      hash_clean (nexthop_resolve_hash, nexthop_resolve_free);
+      for (afi = AFI_IP; afi < AFI_MAX; afi++)
+	if (nexthop_resolve_index[afi])
+	  {
+	    route_table_finish (nexthop_resolve_index[afi]);
+	    nexthop_resolve_index[afi] = NULL;
+	  }
+      return;
+    }
+
+  afi = family2afi (p->family);
+  if ((afi != AFI_IP && afi != AFI_IP6) || ! nexthop_resolve_index[afi])
+    return;
+
+  /* The walk below may drop every node under top but top itself. */
+  top = route_node_get (nexthop_resolve_index[afi], p);
+  route_lock_node (top);
+  for (rn = top; rn; rn = route_next_until (rn, top))
+    {
+      if (! rn->info)
+	continue;
+
+      nr = rn->info;
+      rn->info = NULL;
+      for (; nr; nr = next)
+	{
+	  next = nr->next;
+	  if (nr->matchlen <= p->prefixlen)
+	    {
+	      hash_release (nexthop_resolve_hash, nr);
+	      nexthop_resolve_free (nr);
+	    }
+	  else
+	    {
+	      nr->next = rn->info;
+	      rn->info = nr;
+	    }
+	}
+      if (! rn->info)
+	route_unlock_node (rn);
+    }
+  route_unlock_node (top);
+}
+
+/* Walk the table for the gateway.  The route being processed is left
+   to the caller, which checks it against matchlen. */
+static void
+nexthop_resolve_walk (struct nexthop_resolve *nr)
 {
-  struct prefix_ipv4 p;
+  struct prefix p;
   struct route_table *table;
   struct route_node *rn;
   struct rib *match;
   struct nexthop *newhop;
 
-  if (nexthop->type == NEXTHOP_TYPE_IPV4)
-    nexthop->ifindex = 0;
-
-  if (set)
-    UNSET_FLAG (nexthop->flags, NEXTHOP_FLAG_RECURSIVE);
+  nr->rn = NULL;
+  nr->matchlen = -1;
+  nr->active = 0;
 
   /* Make lookup prefix. */
-  memset (&p, 0, sizeof (struct prefix_ipv4));
-  p.family = AF_INET;
-  p.prefixlen = IPV4_MAX_PREFIXLEN;
-  p.prefix = nexthop->gate.ipv4;
+  nexthop_resolve_host (&p, nr->family, &nr->gate);
 
   /* Lookup table.  */
-  table = vrf_table (AFI_IP, SAFI_UNICAST, 0);
+  table = vrf_table (family2afi (nr->family), SAFI_UNICAST, 0);
   if (! table)
-    return 0;
+    return;
 
-  rn = route_node_match (table, (struct prefix *) &p);
+  rn = route_node_match (table, &p);
   while (rn)
     {
       route_unlock_node (rn);
-      
-      /* If lookup self prefix return immediately. */
-      if (rn == top)
-	return 0;
 
-      /* Pick up selected route. */
+      /* Pick up selected route, unless it is EGP.  BGP ribs are
+	 passed over untouched, their flags may be changing under
+	 a parallel selection. */
       RNODE_FOREACH_RIB (rn, match)
 	{
-	  if (CHECK_FLAG (match->status, RIB_ENTRY_REMOVED))
+	  if (match->type == ZEBRA_ROUTE_BGP
+	      || CHECK_FLAG (match->status, RIB_ENTRY_REMOVED))
 	    continue;
 	  if (CHECK_FLAG (match->flags, ZEBRA_FLAG_SELECTED))
 	    break;
 	}
 
-      /* If there is no selected route or matched route is EGP, go up
-         tree. */
-      if (! match 
-	  || match->type == ZEBRA_ROUTE_BGP)
+      /* If there is no selected route, go up tree. */
+      if (! match)
 	{
 	  do {
 	    rn = rn->parent;
 	  } while (rn && rn->info == NULL);
 	  if (rn)
 	    route_lock_node (rn);
+	  continue;
 	}
-      else
+
+      nr->rn = route_lock_node (rn);
+      nr->matchlen = rn->p.prefixlen;
+
+      if (match->type == ZEBRA_ROUTE_CONNECT)
 	{
-	  if (match->type == ZEBRA_ROUTE_CONNECT)
-	    {
-	      /* Directly point connected route. */
-	      newhop = match->nexthop;
-	      if (newhop && nexthop->type == NEXTHOP_TYPE_IPV4)
-		nexthop->ifindex = newhop->ifindex;
-	      
-	      return 1;
-	    }
-	  else if (CHECK_FLAG (rib->flags, ZEBRA_FLAG_INTERNAL))
-	    {
-	      for (newhop = match->nexthop; newhop; newhop = newhop->next)
-		if (CHECK_FLAG (newhop->flags, NEXTHOP_FLAG_FIB)
-		    && ! CHECK_FLAG (newhop->flags, NEXTHOP_FLAG_RECURSIVE))
-		  {
-		    if (set)
-		      {
-			SET_FLAG (nexthop->flags, NEXTHOP_FLAG_RECURSIVE);
-			nexthop->rtype = newhop->type;
-			if (newhop->type == NEXTHOP_TYPE_IPV4 ||
-			    newhop->type == NEXTHOP_TYPE_IPV4_IFINDEX)
-			  nexthop->rgate.ipv4 = newhop->gate.ipv4;
-			if (newhop->type == NEXTHOP_TYPE_IFINDEX
-			    || newhop->type == NEXTHOP_TYPE_IFNAME
-			    || newhop->type == NEXTHOP_TYPE_IPV4_IFINDEX)
-			  nexthop->rifindex = newhop->ifindex;
-		      }
-		    return 1;
-		  }
-	      return 0;
-	    }
-	  else
+	  /* Directly point connected route. */
+	  nr->active = 1;
+	  nr->connected = 1;
+	  if ((newhop = match->nexthop) != NULL)
 	    {
-	      return 0;
+	      nr->has_ifindex = 1;
+	      nr->ifindex = newhop->ifindex;
 	    }
 	}
+      else if (nr->internal)
+	{
+	  for (newhop = match->nexthop; newhop; newhop = newhop->next)
+	    if (CHECK_FLAG (newhop->flags, NEXTHOP_FLAG_FIB)
+		&& ! CHECK_FLAG (newhop->flags, NEXTHOP_FLAG_RECURSIVE))
+	      {
+		nr->active = 1;
+		nr->rtype = newhop->type;
+		nr->rgate = newhop->gate;
+		nr->rifindex = newhop->ifindex;
+		break;
+	      }
+	}
+      return;
     }
-  return 0;
 }
 
+static void *
+nexthop_resolve_alloc (void *arg)
+{
+  struct nexthop_resolve *nr;
+  struct route_node *rn;
+  struct prefix p;
+  afi_t afi;
+
+  nr = XCALLOC (MTYPE_NEXTHOP_RESOLVE, sizeof (struct nexthop_resolve));
+  memcpy (nr, arg, sizeof (struct nexthop_resolve));
+  nexthop_resolve_walk (nr);
+
+  /* Index it by gateway, a node holding one lock while it has entries. */
+  afi = family2afi (nr->family);
+  if (! nexthop_resolve_index[afi])
+    nexthop_resolve_index[afi] = route_table_init ();
+  nexthop_resolve_host (&p, nr->family, &nr->gate);
+  rn = route_node_get (nexthop_resolve_index[afi], &p);
+  if (rn->info)
+    route_unlock_node (rn);
+  nr->next = rn->info;
+  rn->info = nr;
+  return nr;
+}
+
+/* Resolution of a gateway, from the cache or by a walk of the table. */
+static struct nexthop_resolve *
+nexthop_resolve_get (int family, u_char type, u_char internal,
+		     union g_addr *gate)
+{
+  struct nexthop_resolve key;
+  struct nexthop_resolve *nr;
+
+  memset (&key, 0, sizeof (struct nexthop_resolve));
+  key.family = family;
+  key.type = type;
+  key.internal = internal;
+  if (family == AF_INET)
+    key.gate.ipv4 = gate->ipv4;
 #ifdef HAVE_IPV6
+  else
+    key.gate.ipv6 = gate->ipv6;
+#endif /* HAVE_IPV6 */
+
+  /* Entries are only released by the main thread, outside of parallel
+     selection, so nr stays valid once the lock is dropped. */
+  RIB_SELECT_LOCK ();
+  if (! nexthop_resolve_hash)
+    {
+      nexthop_resolve_hash = hash_create (nexthop_resolve_hash_key,
+					  nexthop_resolve_hash_cmp);
+      hash_set_name (nexthop_resolve_hash, "Resolved nexthops");
+    }
+  nr = hash_get (nexthop_resolve_hash, &key, nexthop_resolve_alloc);
+  RIB_SELECT_UNLOCK ();
+  return nr;
+}
+
 /* If force flag is not set, do not modify falgs at all for uninstall
    the route from FIB. */
 static int
+nexthop_active_resolve (int family, struct rib *rib, struct nexthop *nexthop,
+			int set, struct route_node *top)
+{
+  struct nexthop_resolve *nr;
+  struct prefix p;
+
+  if (nexthop->type == NEXTHOP_TYPE_IPV4
+      || nexthop->type == NEXTHOP_TYPE_IPV6)
+    nexthop->ifindex = 0;
+
+  if (set)
+    UNSET_FLAG (nexthop->flags, NEXTHOP_FLAG_RECURSIVE);
+
+  nr = nexthop_resolve_get (family, nexthop->type,
+			    CHECK_FLAG (rib->flags, ZEBRA_FLAG_INTERNAL)
+			    ? 1 : 0, &nexthop->gate);
+  if (! nr->active)
+    return 0;
+
+  /* If lookup self prefix return immediately: the walk would have met
+     the route being processed before the one it resolved over. */
+  if (top && top->p.family == family && top->p.prefixlen >= nr->matchlen)
+    {
+      nexthop_resolve_host (&p, family, &nexthop->gate);
+      if (prefix_match (&top->p, &p))
+	return 0;
+    }
+
+  if (nr->connected)
+    {
+      if (nr->has_ifindex
+	  && (nexthop->type == NEXTHOP_TYPE_IPV4
+	      || nexthop->type == NEXTHOP_TYPE_IPV6))
+	nexthop->ifindex = nr->ifindex;
+      return 1;
+    }
+
+  if (set)
+    {
+      SET_FLAG (nexthop->flags, NEXTHOP_FLAG_RECURSIVE);
+      nexthop->rtype = nr->rtype;
+      if (family == AF_INET)
+	{
+	  if (nr->rtype == NEXTHOP_TYPE_IPV4
+	      || nr->rtype == NEXTHOP_TYPE_IPV4_IFINDEX)
+	    nexthop->rgate.ipv4 = nr->rgate.ipv4;
+	  if (nr->rtype == NEXTHOP_TYPE_IFINDEX
+	      || nr->rtype == NEXTHOP_TYPE_IFNAME
+	      || nr->rtype == NEXTHOP_TYPE_IPV4_IFINDEX)
+	    nexthop->rifindex = nr->rifindex;
+	}
+#ifdef HAVE_IPV6
+      else
+	{
+	  if (nr->rtype == NEXTHOP_TYPE_IPV6
+	      || nr->rtype == NEXTHOP_TYPE_IPV6_IFINDEX
+	      || nr->rtype == NEXTHOP_TYPE_IPV6_IFNAME)
+	    nexthop->rgate.ipv6 = nr->rgate.ipv6;
+	  if (nr->rtype == NEXTHOP_TYPE_IFINDEX
+	      || nr->rtype == NEXTHOP_TYPE_IFNAME
+	      || nr->rtype == NEXTHOP_TYPE_IPV6_IFINDEX
+	      || nr->rtype == NEXTHOP_TYPE_IPV6_IFNAME)
+	    nexthop->rifindex = nr->rifindex;
+	}
+#endif /* HAVE_IPV6 */
+    }
+  return 1;
+}
+
+static int
+nexthop_active_ipv4 (struct rib *rib, struct nexthop *nexthop, int set,
+		     struct route_node *top)
+{
+  return nexthop_active_resolve (AF_INET, rib, nexthop, set, top);
+}
+
+#ifdef HAVE_IPV6
+static int
 nexthop_active_ipv6 (struct rib *rib, struct nexthop *nexthop, int set,
 		     struct route_node *top)
 {
-  struct prefix_ipv6 p;
+  return nexthop_active_resolve (AF_INET6, rib, nexthop, set, top);
+}
+#endif /* HAVE_IPV6 */
+
+/* Kernel nexthop objects.  With a kernel that has them, a BGP route is
+ * installed over an object standing for its gateways rather than with
+ * its own copy of the path to each: one object per gateway, pointing
+ * at the IGP path, and a group object over those when there are
+ * several.  When the path to a gateway changes, its object is replaced
+ * in place, which moves every route over it at once, and the ribs
+ * installed over it only have their resolved nexthops brought up to
+ * date.  Only when a gateway no longer resolves, or its object cannot
+ * follow, are the ribs over it queued to be processed again.
+ */
+#define RIB_NHOBJ_GROUP_MAX MAX (MULTIPATH_NUM, 64)
+
+/* Where a gateway resolved to: what its kernel object says. */
+struct rib_nhobj_path
+{
+  u_char active;
+  u_char has_gate;
+  union g_addr gate;
+  unsigned int ifindex;
+};
+
+struct rib_nhobj
+{
+  /* All objects, including those off the hash. */
+  struct rib_nhobj *next;
+  struct rib_nhobj *prev;
+
+  /* Kernel identifier, 0 if the object could not be put there. */
+  u_int32_t id;
+
+  /* Ribs and groups using it. */
+  unsigned long refcnt;
+  struct rib_nhobj_dep *deps;
+
+  u_char flags;
+#define RIB_NHOBJ_DEAD		(1 << 0) /* Off the hash, going away */
+#define RIB_NHOBJ_CHANGED	(1 << 1) /* Path replaced, ribs to update */
+#define RIB_NHOBJ_LOST		(1 << 2) /* Removed by the kernel */
+
+  /* Key: a gateway as given in the rib, or the gateway objects of a
+     group. */
+  u_char family;
+  u_char type;
+  u_char internal;
+  union g_addr gate;
+  unsigned int ifindex;
+  int count;			/* 0 for a gateway */
+  struct rib_nhobj *member[RIB_NHOBJ_GROUP_MAX];
+
+  /* Gateway: where it resolved to when last sent to the kernel. */
+  struct rib_nhobj_path path;
+};
+
+/* A rib installed over an object. */
+struct rib_nhobj_dep
+{
+  struct rib_nhobj_dep *next;
+  struct rib_nhobj_dep *prev;
+  struct rib_nhobj *obj;
+  struct rib *rib;
+  struct route_node *rn;
+};
+
+static int rib_nhobj_on;
+static u_int32_t rib_nhobj_next_id;
+static struct hash *rib_nhobj_hash;
+static struct rib_nhobj *rib_nhobj_list;
+static struct thread *rib_nhobj_thread;
+
+static void rib_queue_add (struct zebra_t *zebra, struct route_node *rn);
+
+static unsigned int
+rib_nhobj_hash_key (void *arg)
+{
+  struct rib_nhobj *obj = arg;
+
+  if (obj->count)
+    return jhash (obj->member, obj->count * sizeof (obj->member[0]),
+		  obj->count);
+  return jhash (&obj->gate, sizeof (obj->gate),
+		(obj->family << 16) | (obj->type << 8) | obj->internal)
+	 ^ obj->ifindex;
+}
+
+static int
+rib_nhobj_hash_cmp (const void *a, const void *b)
+{
+  const struct rib_nhobj *obj1 = a;
+  const struct rib_nhobj *obj2 = b;
+
+  if (obj1->count != obj2->count)
+    return 0;
+  if (obj1->count)
+    return ! memcmp (obj1->member, obj2->member,
+		     obj1->count * sizeof (obj1->member[0]));
+  return (obj1->family == obj2->family
+	  && obj1->type == obj2->type
+	  && obj1->internal == obj2->internal
+	  && obj1->ifindex == obj2->ifindex
+	  && ! memcmp (&obj1->gate, &obj2->gate, sizeof (obj1->gate)));
+}
+
+/* Turn nexthop objects on; the kernel code calls this when it finds
+   them supported, with the first identifier free for zebra to use. */
+void
+rib_nhobj_enable (u_int32_t first_id)
+{
+  rib_nhobj_on = 1;
+  rib_nhobj_next_id = first_id ? first_id : 1;
+  rib_nhobj_hash = hash_create (rib_nhobj_hash_key, rib_nhobj_hash_cmp);
+  hash_set_name (rib_nhobj_hash, "Kernel nexthop objects");
+}
+
+int
+rib_nhobj_enabled (void)
+{
+  return rib_nhobj_on;
+}
+
+/* Kernel object the rib is installed over, 0 to install it with its
+   own nexthops. */
+u_int32_t
+rib_nhobj_id (struct rib *rib)
+{
+  if (! rib->nhobj || CHECK_FLAG (rib->nhobj->obj->flags, RIB_NHOBJ_LOST))
+    return 0;
+  return rib->nhobj->obj->id;
+}
+
+/* Where a nexthop resolved to, once nexthop_active_update() has set
+   it. */
+/* Interface of the connected route a gateway is on.  Recursion only
+   keeps the interface of nexthops that name one, but a nexthop object
+   always needs it. */
+static unsigned int
+rib_nhobj_gate_ifindex (int family, union g_addr *gate)
+{
+  struct prefix p;
   struct route_table *table;
   struct route_node *rn;
   struct rib *match;
-  struct nexthop *newhop;
+  unsigned int ifindex = 0;
 
-  if (nexthop->type == NEXTHOP_TYPE_IPV6)
-    nexthop->ifindex = 0;
+  memset (&p, 0, sizeof (struct prefix));
+  p.family = family;
+  if (family == AF_INET)
+    {
+      p.prefixlen = IPV4_MAX_PREFIXLEN;
+      p.u.prefix4 = gate->ipv4;
+    }
+#ifdef HAVE_IPV6
+  else
+    {
+      p.prefixlen = IPV6_MAX_PREFIXLEN;
+      p.u.prefix6 = gate->ipv6;
+    }
+#endif /* HAVE_IPV6 */
 
-  if (set)
-    UNSET_FLAG (nexthop->flags, NEXTHOP_FLAG_RECURSIVE);
+  table = vrf_table (family2afi (family), SAFI_UNICAST, 0);
+  if (! table || ! (rn = route_node_match (table, &p)))
+    return 0;
 
-  /* Make lookup prefix. */
-  memset (&p, 0, sizeof (struct prefix_ipv6));
-  p.family = AF_INET6;
-  p.prefixlen = IPV6_MAX_PREFIXLEN;
-  p.prefix = nexthop->gate.ipv6;
+  RNODE_FOREACH_RIB (rn, match)
+    if (! CHECK_FLAG (match->status, RIB_ENTRY_REMOVED)
+	&& CHECK_FLAG (match->flags, ZEBRA_FLAG_SELECTED))
+      break;
+  if (match && match->type == ZEBRA_ROUTE_CONNECT && match->nexthop)
+    ifindex = match->nexthop->ifindex;
 
-  /* Lookup table.  */
-  table = vrf_table (AFI_IP6, SAFI_UNICAST, 0);
-  if (! table)
+  route_unlock_node (rn);
+  return ifindex;
+}
+
+static void
+rib_nhobj_path_get (int family, struct nexthop *nexthop,
+		    struct rib_nhobj_path *path)
+{
+  memset (path, 0, sizeof (struct rib_nhobj_path));
+  path->active = CHECK_FLAG (nexthop->flags, NEXTHOP_FLAG_ACTIVE) ? 1 : 0;
+
+  if (! CHECK_FLAG (nexthop->flags, NEXTHOP_FLAG_RECURSIVE))
+    {
+      path->has_gate = 1;
+      path->gate = nexthop->gate;
+      path->ifindex = nexthop->ifindex;
+      return;
+    }
+
+  switch (nexthop->rtype)
+    {
+    case NEXTHOP_TYPE_IPV4:
+    case NEXTHOP_TYPE_IPV4_IFINDEX:
+#ifdef HAVE_IPV6
+    case NEXTHOP_TYPE_IPV6:
+    case NEXTHOP_TYPE_IPV6_IFINDEX:
+    case NEXTHOP_TYPE_IPV6_IFNAME:
+#endif /* HAVE_IPV6 */
+      path->has_gate = 1;
+      path->gate = nexthop->rgate;
+      break;
+    default:
+      break;
+    }
+  path->ifindex = nexthop->rifindex;
+  if (path->has_gate && ! path->ifindex)
+    path->ifindex = rib_nhobj_gate_ifindex (family, &path->gate);
+}
+
+static int
+rib_nhobj_path_same (int family, struct rib_nhobj_path *p1,
+		     struct rib_nhobj_path *p2)
+{
+  if (p1->active != p2->active
+      || p1->has_gate != p2->has_gate
+      || p1->ifindex != p2->ifindex)
     return 0;
+  if (! p1->has_gate)
+    return 1;
+  if (family == AF_INET)
+    return IPV4_ADDR_SAME (&p1->gate.ipv4, &p2->gate.ipv4);
+#ifdef HAVE_IPV6
+  return IPV6_ADDR_SAME (&p1->gate.ipv6, &p2->gate.ipv6);
+#else
+  return 0;
+#endif /* HAVE_IPV6 */
+}
 
-  rn = route_node_match (table, (struct prefix *) &p);
-  while (rn)
+/* Fill in the key of the gateway object for a nexthop of a rib on rn.
+   Returns 0 if the nexthop cannot use one: only gateways resolved over
+   the table follow the IGP. */
+static int
+rib_nhobj_key (struct route_node *rn, struct rib *rib,
+	       struct nexthop *nexthop, struct rib_nhobj *key)
+{
+  int family = PREFIX_FAMILY (&rn->p);
+
+  memset (key, 0, offsetof (struct rib_nhobj, path));
+  key->family = family;
+  key->type = nexthop->type;
+  key->internal = CHECK_FLAG (rib->flags, ZEBRA_FLAG_INTERNAL) ? 1 : 0;
+
+  switch (nexthop->type)
     {
-      route_unlock_node (rn);
-      
-      /* If lookup self prefix return immediately. */
-      if (rn == top)
+    case NEXTHOP_TYPE_IPV4_IFINDEX:
+      key->ifindex = nexthop->ifindex;
+    case NEXTHOP_TYPE_IPV4:
+      if (family != AF_INET)
+	return 0;
+      key->gate.ipv4 = nexthop->gate.ipv4;
+      return 1;
+#ifdef HAVE_IPV6
+    case NEXTHOP_TYPE_IPV6_IFINDEX:
+      if (IN6_IS_ADDR_LINKLOCAL (&nexthop->gate.ipv6))
 	return 0;
+      key->ifindex = nexthop->ifindex;
+    case NEXTHOP_TYPE_IPV6:
+      if (family != AF_INET6)
+	return 0;
+      key->gate.ipv6 = nexthop->gate.ipv6;
+      return 1;
+#endif /* HAVE_IPV6 */
+    default:
+      return 0;
+    }
+}
 
-      /* Pick up selected route. */
-      RNODE_FOREACH_RIB (rn, match)
+/* Put a gateway object's path in the kernel.  Returns 0 on success. */
+static int
+rib_nhobj_kernel_set (struct rib_nhobj *obj, int replace)
+{
+  if (! obj->path.active || ! obj->path.ifindex)
+    return -1;
+  return kernel_nexthop_add (obj->id, obj->family,
+			     obj->path.has_gate ? &obj->path.gate : NULL,
+			     obj->path.ifindex, replace);
+}
+
+static void *
+rib_nhobj_alloc (void *arg)
+{
+  struct rib_nhobj *key = arg;
+  struct rib_nhobj *obj;
+  u_int32_t member[RIB_NHOBJ_GROUP_MAX];
+  int i;
+
+  obj = XCALLOC (MTYPE_NHOBJ, sizeof (struct rib_nhobj));
+  memcpy (obj, key, sizeof (struct rib_nhobj));
+  obj->prev = NULL;
+  obj->refcnt = 0;
+  obj->deps = NULL;
+  obj->flags = 0;
+
+  obj->id = rib_nhobj_next_id++;
+  if (obj->count)
+    {
+      /* Members came with a reference each, kept for the group. */
+      for (i = 0; i < obj->count; i++)
 	{
-	  if (CHECK_FLAG (match->status, RIB_ENTRY_REMOVED))
-	    continue;
-	  if (CHECK_FLAG (match->flags, ZEBRA_FLAG_SELECTED))
+	  member[i] = obj->member[i]->id;
+	  if (! member[i])
 	    break;
 	}
+      if (i < obj->count
+	  || kernel_nexthop_group_add (obj->id, member, obj->count) < 0)
+	obj->id = 0;
+    }
+  else if (rib_nhobj_kernel_set (obj, 0) < 0)
+    obj->id = 0;
+
+  obj->next = rib_nhobj_list;
+  if (rib_nhobj_list)
+    rib_nhobj_list->prev = obj;
+  rib_nhobj_list = obj;
+  return obj;
+}
+
+static void rib_nhobj_unlock (struct rib_nhobj *obj);
+
+static void
+rib_nhobj_free (struct rib_nhobj *obj)
+{
+  int i;
+
+  if (obj->id && ! CHECK_FLAG (obj->flags, RIB_NHOBJ_LOST))
+    kernel_nexthop_delete (obj->id);
+  if (! CHECK_FLAG (obj->flags, RIB_NHOBJ_DEAD))
+    hash_release (rib_nhobj_hash, obj);
+
+  if (obj->next)
+    obj->next->prev = obj->prev;
+  if (obj->prev)
+    obj->prev->next = obj->next;
+  else
+    rib_nhobj_list = obj->next;
+
+  for (i = 0; i < obj->count; i++)
+    rib_nhobj_unlock (obj->member[i]);
+  XFREE (MTYPE_NHOBJ, obj);
+}
+
+static void
+rib_nhobj_unlock (struct rib_nhobj *obj)
+{
+  assert (obj->refcnt);
+  if (--obj->refcnt == 0)
+    rib_nhobj_free (obj);
+}
+
+/* Queue the ribs over an object to be installed again. */
+static void
+rib_nhobj_requeue (struct rib_nhobj *obj)
+{
+  struct rib_nhobj_dep *dep;
+  struct nexthop *nexthop;
+
+  for (dep = obj->deps; dep; dep = dep->next)
+    {
+      if (CHECK_FLAG (obj->flags, RIB_NHOBJ_LOST))
+	for (nexthop = dep->rib->nexthop; nexthop; nexthop = nexthop->next)
+	  UNSET_FLAG (nexthop->flags, NEXTHOP_FLAG_FIB);
+      SET_FLAG (dep->rib->status, RIB_ENTRY_NHOBJ_STALE);
+      rib_queue_add (&zebrad, dep->rn);
+    }
+}
+
+/* An object can no longer be used: new ribs get a new one, those over
+   it are processed again and leave it.  Groups of a gateway follow it
+   from the event. */
+static void
+rib_nhobj_kill (struct rib_nhobj *obj)
+{
+  if (CHECK_FLAG (obj->flags, RIB_NHOBJ_DEAD))
+    return;
+  SET_FLAG (obj->flags, RIB_NHOBJ_DEAD);
+  hash_release (rib_nhobj_hash, obj);
+  rib_nhobj_requeue (obj);
+  rib_nhobj_schedule ();
+}
+
+/* A gateway now resolves to path: replace its kernel object, which
+   takes the routes over it along. */
+static void
+rib_nhobj_follow (struct rib_nhobj *obj, struct rib_nhobj_path *path)
+{
+  obj->path = *path;
+  if (! obj->id || rib_nhobj_kernel_set (obj, 1) < 0)
+    rib_nhobj_kill (obj);
+  else
+    {
+      SET_FLAG (obj->flags, RIB_NHOBJ_CHANGED);
+      rib_nhobj_schedule ();
+    }
+}
+
+/* Find the object for the active nexthops of a rib on rn, which
+   nexthop_active_update() has just set.  With lock, create it if
+   needed and take a reference on it.  Returns NULL if the rib cannot
+   use one. */
+static struct rib_nhobj *
+rib_nhobj_get (struct route_node *rn, struct rib *rib, int lock)
+{
+  struct rib_nhobj key;
+  struct rib_nhobj *gw[RIB_NHOBJ_GROUP_MAX];
+  struct rib_nhobj *obj;
+  struct rib_nhobj_path path;
+  struct nexthop *nexthop;
+  int count = 0;
+  int i;
+
+  if (! rib_nhobj_on || rib->type != ZEBRA_ROUTE_BGP
+      || CHECK_FLAG (rib->flags, ZEBRA_FLAG_BLACKHOLE | ZEBRA_FLAG_REJECT))
+    return NULL;
+
+  for (nexthop = rib->nexthop; nexthop; nexthop = nexthop->next)
+    {
+      if (! CHECK_FLAG (nexthop->flags, NEXTHOP_FLAG_ACTIVE))
+	continue;
+      if (count == RIB_NHOBJ_GROUP_MAX
+	  || ! rib_nhobj_key (rn, rib, nexthop, &key))
+	goto fail;
 
-      /* If there is no selected route or matched route is EGP, go up
-         tree. */
-      if (! match
-	  || match->type == ZEBRA_ROUTE_BGP)
+      rib_nhobj_path_get (key.family, nexthop, &path);
+      obj = hash_lookup (rib_nhobj_hash, &key);
+      if (obj && ! rib_nhobj_path_same (obj->family, &obj->path, &path))
 	{
-	  do {
-	    rn = rn->parent;
-	  } while (rn && rn->info == NULL);
-	  if (rn)
-	    route_lock_node (rn);
+	  /* The rib has the newer path, the IGP changed since. */
+	  if (! lock)
+	    goto fail;
+	  rib_nhobj_follow (obj, &path);
+	  if (CHECK_FLAG (obj->flags, RIB_NHOBJ_DEAD))
+	    obj = NULL;
 	}
-      else
+      if (! obj)
 	{
-	  if (match->type == ZEBRA_ROUTE_CONNECT)
-	    {
-	      /* Directly point connected route. */
-	      newhop = match->nexthop;
+	  if (! lock)
+	    goto fail;
+	  key.path = path;
+	  obj = hash_get (rib_nhobj_hash, &key, rib_nhobj_alloc);
+	}
+      if (lock)
+	obj->refcnt++;
+      gw[count++] = obj;
+    }
 
-	      if (newhop && nexthop->type == NEXTHOP_TYPE_IPV6)
-		nexthop->ifindex = newhop->ifindex;
-	      
-	      return 1;
-	    }
-	  else if (CHECK_FLAG (rib->flags, ZEBRA_FLAG_INTERNAL))
-	    {
-	      for (newhop = match->nexthop; newhop; newhop = newhop->next)
-		if (CHECK_FLAG (newhop->flags, NEXTHOP_FLAG_FIB)
-		    && ! CHECK_FLAG (newhop->flags, NEXTHOP_FLAG_RECURSIVE))
-		  {
-		    if (set)
-		      {
-			SET_FLAG (nexthop->flags, NEXTHOP_FLAG_RECURSIVE);
-			nexthop->rtype = newhop->type;
-			if (newhop->type == NEXTHOP_TYPE_IPV6
-			    || newhop->type == NEXTHOP_TYPE_IPV6_IFINDEX
-			    || newhop->type == NEXTHOP_TYPE_IPV6_IFNAME)
-			  nexthop->rgate.ipv6 = newhop->gate.ipv6;
-			if (newhop->type == NEXTHOP_TYPE_IFINDEX
-			    || newhop->type == NEXTHOP_TYPE_IFNAME
-			    || newhop->type == NEXTHOP_TYPE_IPV6_IFINDEX
-			    || newhop->type == NEXTHOP_TYPE_IPV6_IFNAME)
-			  nexthop->rifindex = newhop->ifindex;
-		      }
-		    return 1;
-		  }
-	      return 0;
-	    }
-	  else
+  if (count <= 1)
+    return count ? gw[0] : NULL;
+
+  memset (&key, 0, sizeof (struct rib_nhobj));
+  key.family = PREFIX_FAMILY (&rn->p);
+  key.count = count;
+  memcpy (key.member, gw, count * sizeof (gw[0]));
+  if (! lock)
+    return hash_lookup (rib_nhobj_hash, &key);
+
+  /* A new group keeps the references on its members. */
+  obj = hash_get (rib_nhobj_hash, &key, rib_nhobj_alloc);
+  if (obj->refcnt)
+    for (i = 0; i < count; i++)
+      rib_nhobj_unlock (gw[i]);
+  obj->refcnt++;
+  return obj;
+
+ fail:
+  if (lock)
+    for (i = 0; i < count; i++)
+      rib_nhobj_unlock (gw[i]);
+  return NULL;
+}
+
+/* Before the rib on rn goes to the kernel: install it over the object
+   for its nexthops, if it can use one. */
+static void
+rib_nhobj_attach (struct route_node *rn, struct rib *rib)
+{
+  struct rib_nhobj *obj;
+  struct rib_nhobj_dep *dep;
+
+  obj = rib_nhobj_get (rn, rib, 1);
+  if (! obj)
+    return;
+
+  dep = XCALLOC (MTYPE_NHOBJ_DEP, sizeof (struct rib_nhobj_dep));
+  dep->obj = obj;
+  dep->rib = rib;
+  dep->rn = rn;
+  dep->next = obj->deps;
+  if (obj->deps)
+    obj->deps->prev = dep;
+  obj->deps = dep;
+  rib->nhobj = dep;
+}
+
+static void
+rib_nhobj_dep_free (struct rib_nhobj_dep *dep)
+{
+  struct rib_nhobj *obj = dep->obj;
+
+  if (dep->next)
+    dep->next->prev = dep->prev;
+  if (dep->prev)
+    dep->prev->next = dep->next;
+  else
+    obj->deps = dep->next;
+  XFREE (MTYPE_NHOBJ_DEP, dep);
+
+  rib_nhobj_unlock (obj);
+}
+
+/* After the rib has left the kernel. */
+static void
+rib_nhobj_detach (struct rib *rib)
+{
+  if (rib->nhobj)
+    {
+      rib_nhobj_dep_free (rib->nhobj);
+      rib->nhobj = NULL;
+    }
+}
+
+/* Whether two ribs give their kernel routes the same preferred source
+   address: fib as installed, rib as it would be. */
+static int
+rib_nhobj_src_same (struct rib *fib, struct rib *rib)
+{
+  struct nexthop *nh1, *nh2;
+
+  for (nh1 = fib->nexthop; nh1; nh1 = nh1->next)
+    if (CHECK_FLAG (nh1->flags, NEXTHOP_FLAG_FIB) && nh1->src.ipv4.s_addr)
+      break;
+  for (nh2 = rib->nexthop; nh2; nh2 = nh2->next)
+    if (CHECK_FLAG (nh2->flags, NEXTHOP_FLAG_ACTIVE) && nh2->src.ipv4.s_addr)
+      break;
+  if (! nh1 || ! nh2)
+    return nh1 == nh2;
+  return nh1->src.ipv4.s_addr == nh2->src.ipv4.s_addr;
+}
+
+static void
+rib_nhobj_set_fib (struct rib *rib)
+{
+  struct nexthop *nexthop;
+
+  for (nexthop = rib->nexthop; nexthop; nexthop = nexthop->next)
+    if (CHECK_FLAG (nexthop->flags, NEXTHOP_FLAG_ACTIVE))
+      SET_FLAG (nexthop->flags, NEXTHOP_FLAG_FIB);
+    else
+      UNSET_FLAG (nexthop->flags, NEXTHOP_FLAG_FIB);
+  UNSET_FLAG (rib->status, RIB_ENTRY_NHOBJ_STALE);
+}
+
+/* Whether rib, installed over an object and with its nexthops just
+   set, would still give the kernel the route it has. */
+static int
+rib_nhobj_keep (struct route_node *rn, struct rib *rib)
+{
+  if (! rib_nhobj_id (rib)
+      || CHECK_FLAG (rib->nhobj->obj->flags, RIB_NHOBJ_DEAD)
+      || rib_nhobj_get (rn, rib, 0) != rib->nhobj->obj
+      || ! rib_nhobj_src_same (rib, rib))
+    return 0;
+
+  rib_nhobj_set_fib (rib);
+  return 1;
+}
+
+/* The rib about to be installed on rn would give the kernel the route
+   fib has, over the same object: let it take the route over without
+   telling the kernel.  Both have had their nexthops set. */
+static int
+rib_nhobj_takeover (struct route_node *rn, struct rib *fib,
+		    struct rib *select)
+{
+  struct rib_nhobj_dep *dep = fib->nhobj;
+  struct nexthop *nexthop;
+
+  if (! rib_nhobj_id (fib)
+      || CHECK_FLAG (dep->obj->flags, RIB_NHOBJ_DEAD)
+      || select->metric != fib->metric
+      || select->table != fib->table
+      || rib_nhobj_get (rn, select, 0) != dep->obj
+      || ! rib_nhobj_src_same (fib, select))
+    return 0;
+
+  for (nexthop = fib->nexthop; nexthop; nexthop = nexthop->next)
+    UNSET_FLAG (nexthop->flags, NEXTHOP_FLAG_FIB);
+  rib_nhobj_set_fib (select);
+
+  fib->nhobj = NULL;
+  select->nhobj = dep;
+  dep->rib = select;
+  return 1;
+}
+
+/* Bring the nexthops of a rib over a changed object up to date with
+   the paths its gateways have now.  Returns 0 if the rib no longer
+   resolves the way the object does. */
+static int
+rib_nhobj_update_rib (struct rib_nhobj_dep *dep)
+{
+  struct rib_nhobj *obj = dep->obj;
+  struct rib_nhobj *gw;
+  struct rib_nhobj key;
+  struct rib_nhobj_path path;
+  struct nexthop *nexthop;
+  struct nexthop update[RIB_NHOBJ_GROUP_MAX];
+  int count = 0;
+
+  for (nexthop = dep->rib->nexthop; nexthop; nexthop = nexthop->next)
+    {
+      if (! CHECK_FLAG (nexthop->flags, NEXTHOP_FLAG_FIB))
+	continue;
+      if (count == (obj->count ? obj->count : 1))
+	return 0;
+      gw = obj->count ? obj->member[count] : obj;
+
+      /* Resolve a copy, the rib may have to leave the kernel with
+	 what it has. */
+      update[count] = *nexthop;
+      if (! nexthop_active_resolve (gw->family, dep->rib, &update[count], 1,
+				    dep->rn))
+	return 0;
+      rib_nhobj_key (dep->rn, dep->rib, nexthop, &key);
+      rib_nhobj_path_get (gw->family, &update[count], &path);
+      if (! rib_nhobj_hash_cmp (&key, gw)
+	  || ! rib_nhobj_path_same (gw->family, &gw->path, &path))
+	return 0;
+      count++;
+    }
+
+  count = 0;
+  for (nexthop = dep->rib->nexthop; nexthop; nexthop = nexthop->next)
+    if (CHECK_FLAG (nexthop->flags, NEXTHOP_FLAG_FIB))
+      {
+	nexthop->flags = update[count].flags;
+	nexthop->ifindex = update[count].ifindex;
+	nexthop->rtype = update[count].rtype;
+	nexthop->rgate = update[count].rgate;
+	nexthop->rifindex = update[count].rifindex;
+	count++;
+      }
+  return 1;
+}
+
+/* Resolve a gateway object afresh. */
+static void
+rib_nhobj_resolve (struct rib_nhobj *obj, struct rib_nhobj_path *path)
+{
+  struct rib rib;
+  struct nexthop nexthop;
+
+  memset (&rib, 0, sizeof (struct rib));
+  rib.type = ZEBRA_ROUTE_BGP;
+  if (obj->internal)
+    SET_FLAG (rib.flags, ZEBRA_FLAG_INTERNAL);
+
+  memset (&nexthop, 0, sizeof (struct nexthop));
+  nexthop.type = obj->type;
+  nexthop.gate = obj->gate;
+  nexthop.ifindex = obj->ifindex;
+  if (nexthop_active_resolve (obj->family, &rib, &nexthop, 1, NULL))
+    SET_FLAG (nexthop.flags, NEXTHOP_FLAG_ACTIVE);
+  rib_nhobj_path_get (obj->family, &nexthop, path);
+}
+
+static int
+rib_nhobj_member_flag (struct rib_nhobj *obj, u_char flag)
+{
+  int i;
+
+  for (i = 0; i < obj->count; i++)
+    if (CHECK_FLAG (obj->member[i]->flags, flag))
+      return 1;
+  return 0;
+}
+
+/* A route other gateways may resolve over changed: have every gateway
+   object follow its gateway, then bring up to date the ribs over those
+   that moved, or over groups of them. */
+static int
+rib_nhobj_update (struct thread *thread)
+{
+  struct rib_nhobj *obj;
+  struct rib_nhobj_dep *dep, *next;
+  struct rib_nhobj_path path;
+
+  rib_nhobj_thread = NULL;
+
+  for (obj = rib_nhobj_list; obj; obj = obj->next)
+    {
+      if (obj->count || CHECK_FLAG (obj->flags, RIB_NHOBJ_DEAD))
+	continue;
+      rib_nhobj_resolve (obj, &path);
+      if (! path.active)
+	rib_nhobj_kill (obj);
+      else if (! rib_nhobj_path_same (obj->family, &obj->path, &path))
+	rib_nhobj_follow (obj, &path);
+    }
+
+  for (obj = rib_nhobj_list; obj; obj = obj->next)
+    if (obj->count && ! CHECK_FLAG (obj->flags, RIB_NHOBJ_DEAD))
+      {
+	if (rib_nhobj_member_flag (obj, RIB_NHOBJ_DEAD))
+	  rib_nhobj_kill (obj);
+	else if (rib_nhobj_member_flag (obj, RIB_NHOBJ_CHANGED))
+	  SET_FLAG (obj->flags, RIB_NHOBJ_CHANGED);
+      }
+
+  for (obj = rib_nhobj_list; obj; obj = obj->next)
+    {
+      if (! CHECK_FLAG (obj->flags, RIB_NHOBJ_CHANGED)
+	  || CHECK_FLAG (obj->flags, RIB_NHOBJ_DEAD))
+	continue;
+
+      for (dep = obj->deps; dep; dep = next)
+	{
+	  next = dep->next;
+	  zfpm_trigger_update (dep->rn, "nexthop object changed");
+	  if (! rib_nhobj_update_rib (dep))
 	    {
-	      return 0;
+	      SET_FLAG (dep->rib->status, RIB_ENTRY_NHOBJ_STALE);
+	      rib_queue_add (&zebrad, dep->rn);
 	    }
 	}
     }
+
+  for (obj = rib_nhobj_list; obj; obj = obj->next)
+    UNSET_FLAG (obj->flags, RIB_NHOBJ_CHANGED);
+
+  /* Killing objects above scheduled another run it has no need of. */
+  if (rib_nhobj_thread)
+    {
+      thread_cancel (rib_nhobj_thread);
+      rib_nhobj_thread = NULL;
+    }
   return 0;
 }
-#endif /* HAVE_IPV6 */
 
-struct rib *
-rib_match_ipv4 (struct in_addr addr)
+static void
+rib_nhobj_schedule (void)
 {
-  struct prefix_ipv4 p;
-  struct route_table *table;
-  struct route_node *rn;
+  if (rib_nhobj_list && ! rib_nhobj_thread)
+    rib_nhobj_thread = thread_add_event (zebrad.master, rib_nhobj_update,
+					 NULL, 0);
+}
+
+/* The kernel removed an object, with the routes over it, e.g. because
+   its interface went down. */
+void
+rib_nhobj_lost (u_int32_t id)
+{
+  struct rib_nhobj *obj;
+
+  for (obj = rib_nhobj_list; obj; obj = obj->next)
+    if (obj->id == id && ! CHECK_FLAG (obj->flags, RIB_NHOBJ_LOST))
+      break;
+  if (! obj)
+    return;
+
+  if (IS_ZEBRA_DEBUG_RIB)
+    zlog_debug ("%s: kernel removed nexthop object %u", __func__, id);
+
+  SET_FLAG (obj->flags, RIB_NHOBJ_LOST);
+  if (CHECK_FLAG (obj->flags, RIB_NHOBJ_DEAD))
+    rib_nhobj_requeue (obj);
+  else
+    rib_nhobj_kill (obj);
+}
+
+/* The route a client is told addr resolves over: that of the cached
+   resolution, as selected still since nothing under it changed. */
+static struct rib *
+rib_match (int family, union g_addr *addr)
+{
+  struct nexthop_resolve *nr;
   struct rib *match;
   struct nexthop *newhop;
 
-  /* Lookup table.  */
-  table = vrf_table (AFI_IP, SAFI_UNICAST, 0);
-  if (! table)
-    return 0;
-
-  memset (&p, 0, sizeof (struct prefix_ipv4));
-  p.family = AF_INET;
-  p.prefixlen = IPV4_MAX_PREFIXLEN;
-  p.prefix = addr;
+  nr = nexthop_resolve_get (family, 0, 0, addr);
+  if (! nr->rn)
+    return NULL;
 
-  rn = route_node_match (table, (struct prefix *) &p);
+  RNODE_FOREACH_RIB (nr->rn, match)
+    if (match->type != ZEBRA_ROUTE_BGP
+	&& ! CHECK_FLAG (match->status, RIB_ENTRY_REMOVED)
+	&& CHECK_FLAG (match->flags, ZEBRA_FLAG_SELECTED))
+      break;
+  if (! match)
+    return NULL;
 
-  while (rn)
-    {
-      route_unlock_node (rn);
-      
-      /* Pick up selected route. */
-      RNODE_FOREACH_RIB (rn, match)
-	{
-	  if (CHECK_FLAG (match->status, RIB_ENTRY_REMOVED))
-	    continue;
-	  if (CHECK_FLAG (match->flags, ZEBRA_FLAG_SELECTED))
-	    break;
-	}
+  if (match->type == ZEBRA_ROUTE_CONNECT)
+    /* Directly point connected route. */
+    return match;
 
-      /* If there is no selected route or matched route is EGP, go up
-         tree. */
-      if (! match 
-	  || match->type == ZEBRA_ROUTE_BGP)
-	{
-	  do {
-	    rn = rn->parent;
-	  } while (rn && rn->info == NULL);
-	  if (rn)
-	    route_lock_node (rn);
-	}
-      else
-	{
-	  if (match->type == ZEBRA_ROUTE_CONNECT)
-	    /* Directly point connected route. */
-	    return match;
-	  else
-	    {
-	      for (newhop = match->nexthop; newhop; newhop = newhop->next)
-		if (CHECK_FLAG (newhop->flags, NEXTHOP_FLAG_FIB))
-		  return match;
-	      return NULL;
-	    }
-	}
-    }
+  for (newhop = match->nexthop; newhop; newhop = newhop->next)
+    if (CHECK_FLAG (newhop->flags, NEXTHOP_FLAG_FIB))
+      return match;
   return NULL;
 }
 
+struct rib *
+rib_match_ipv4 (struct in_addr addr)
+{
+  union g_addr gate;
+
+  memset (&gate, 0, sizeof (union g_addr));
+  gate.ipv4 = addr;
+  return rib_match (AF_INET, &gate);
+}
+
 struct rib *
 rib_lookup_ipv4 (struct prefix_ipv4 *p)
 {
@@ -755,63 +1781,11 @@ rib_lookup_ipv4_route (struct prefix_ipv4 *p, union sockunion * qgate)
 struct rib *
 rib_match_ipv6 (struct in6_addr *addr)
 {
-  struct prefix_ipv6 p;
-  struct route_table *table;
-  struct route_node *rn;
-  struct rib *match;
-  struct nexthop *newhop;
-
-  /* Lookup table.  */
-  table = vrf_table (AFI_IP6, SAFI_UNICAST, 0);
-  if (! table)
-    return 0;
-
-  memset (&p, 0, sizeof (struct prefix_ipv6));
-  p.family = AF_INET6;
-  p.prefixlen = IPV6_MAX_PREFIXLEN;
-  IPV6_ADDR_COPY (&p.prefix, addr);
-
-  rn = route_node_match (table, (struct prefix *) &p);
-
-  while (rn)
-    {
-      route_unlock_node (rn);
-      
-      /* Pick up selected route. */
-      RNODE_FOREACH_RIB (rn, match)
-	{
-	  if (CHECK_FLAG (match->status, RIB_ENTRY_REMOVED))
-	    continue;
-	  if (CHECK_FLAG (match->flags, ZEBRA_FLAG_SELECTED))
-	    break;
-	}
+  union g_addr gate;
 
-      /* If there is no selected route or matched route is EGP, go up
-         tree. */
-      if (! match 
-	  || match->type == ZEBRA_ROUTE_BGP)
-	{
-	  do {
-	    rn = rn->parent;
-	  } while (rn && rn->info == NULL);
-	  if (rn)
-	    route_lock_node (rn);
-	}
-      else
-	{
-	  if (match->type == ZEBRA_ROUTE_CONNECT)
-	    /* Directly point connected route. */
-	    return match;
-	  else
-	    {
-	      for (newhop = match->nexthop; newhop; newhop = newhop->next)
-		if (CHECK_FLAG (newhop->flags, NEXTHOP_FLAG_FIB))
-		  return match;
-	      return NULL;
-	    }
-	}
-    }
-  return NULL;
+  memset (&gate, 0, sizeof (union g_addr));
+  IPV6_ADDR_COPY (&gate.ipv6, addr);
+  return rib_match (AF_INET6, &gate);
 }
 #endif /* HAVE_IPV6 */
 
@@ -921,7 +1895,9 @@ nexthop_active_check (struct route_node *rn, struct rib *rib,
   if (!rmap && proto_rm[family][ZEBRA_ROUTE_MAX])
     rmap = route_map_lookup_by_name (proto_rm[family][ZEBRA_ROUTE_MAX]);
   if (rmap) {
+      RIB_SELECT_LOCK ();
       ret = route_map_apply(rmap, &rn->p, RMAP_ZEBRA, nexthop);
+      RIB_SELECT_UNLOCK ();
   }
 
   if (ret == RMAP_DENYMATCH)
@@ -967,12 +1943,21 @@ rib_install_kernel (struct route_node *rn, struct rib *rib)
 {
   int ret = 0;
   struct nexthop *nexthop;
+  struct rib_nhobj_dep *dep;
 
   /*
    * Make sure we update the FPM any time we send new information to
    * the kernel.
    */
   zfpm_trigger_update (rn, "installing in kernel");
+
+  /* Let go of an object used before only once the new one is there. */
+  dep = rib->nhobj;
+  rib->nhobj = NULL;
+  rib_nhobj_attach (rn, rib);
+  if (dep)
+    rib_nhobj_dep_free (dep);
+  UNSET_FLAG (rib->status, RIB_ENTRY_NHOBJ_STALE);
   switch (PREFIX_FAMILY (&rn->p))
     {
     case AF_INET:
@@ -991,6 +1976,28 @@ rib_install_kernel (struct route_node *rn, struct rib *rib)
       for (nexthop = rib->nexthop; nexthop; nexthop = nexthop->next)
 	UNSET_FLAG (nexthop->flags, NEXTHOP_FLAG_FIB);
     }
+
+  if (ret > 0)
+    {
+      if (CHECK_FLAG (rib->status, RIB_ENTRY_FIB_NOTIFY))
+	SET_FLAG (rib->status, RIB_ENTRY_FIB_QUEUED);
+      UNSET_FLAG (rib->status, RIB_ENTRY_FIB_NOTIFY);
+    }
+  else
+    rib_fib_result (&rn->p, rib, ret == 0);
+}
+
+/* The kernel's answer to the install of a rib: tell the client that
+   added it, if it asked. */
+void
+rib_fib_result (struct prefix *p, struct rib *rib, int installed)
+{
+  if (! CHECK_FLAG (rib->status, RIB_ENTRY_FIB_NOTIFY | RIB_ENTRY_FIB_QUEUED))
+    return;
+
+  UNSET_FLAG (rib->status, RIB_ENTRY_FIB_NOTIFY | RIB_ENTRY_FIB_QUEUED);
+  zsend_route_notify (p, rib, installed ? ZEBRA_FIB_INSTALLED
+					: ZEBRA_FIB_FAILED);
 }
 
 /* Uninstall the route from kernel. */
@@ -1021,6 +2028,8 @@ rib_uninstall_kernel (struct route_node *rn, struct rib *rib)
   for (nexthop = rib->nexthop; nexthop; nexthop = nexthop->next)
     UNSET_FLAG (nexthop->flags, NEXTHOP_FLAG_FIB);
 
+  rib_nhobj_detach (rib);
+  UNSET_FLAG (rib->status, RIB_ENTRY_NHOBJ_STALE);
   return ret;
 }
 
@@ -1030,6 +2039,9 @@ rib_uninstall (struct route_node *rn, struct rib *rib)
 {
   if (CHECK_FLAG (rib->flags, ZEBRA_FLAG_SELECTED))
     {
+      if (rib->type != ZEBRA_ROUTE_BGP)
+	rib_nexthop_resolve_flush (&rn->p);
+
       zfpm_trigger_update (rn, "rib_uninstall");
 
       redistribute_delete (&rn->p, rib);
@@ -1055,13 +2067,18 @@ rib_can_delete_dest (rib_dest_t *dest)
     }
 
   /*
-   * Don't delete the dest if we have to update the FPM about this
+   * Don't delete the dest if we have to update an FPM about this
    * prefix.
    */
-  if (CHECK_FLAG (dest->flags, RIB_DEST_UPDATE_FPM) ||
-      CHECK_FLAG (dest->flags, RIB_DEST_SENT_TO_FPM))
+  if (CHECK_FLAG (dest->flags, RIB_DEST_SENT_TO_FPM))
     return 0;
 
+  /*
+   * No FPM has it, so it need not stay on the FPM update log.
+   */
+  if (CHECK_FLAG (dest->flags, RIB_DEST_UPDATE_FPM))
+    zfpm_dest_release (dest);
+
   return 1;
 }
 
@@ -1104,26 +2121,39 @@ rib_gc_dest (struct route_node *rn)
   return 1;
 }
 
-/* Core function for processing routing information base. */
+/* Outcome of best-route selection on one route_node, see rib_select(). */
+struct rib_select
+{
+  struct route_node *rn;
+  unsigned int shard;
+
+  struct rib *select;	/* the winner RIB entry, if any */
+  struct rib *fib;	/* the SELECTED RIB entry, if any */
+  struct rib *del;	/* equal to fib, if fib is queued for deletion */
+  int resolving;	/* other nexthops may resolve over this node */
+};
+
+/* Pick the best RIB entry of a route_node.  Only the ribs of the node
+ * are modified, which lets rib_select() run on worker threads; removed
+ * ribs are left for rib_process_apply() to unlink.
+ */
 static void
-rib_process (struct route_node *rn)
+rib_select (struct rib_select *rs)
 {
+  struct route_node *rn = rs->rn;
   struct rib *rib;
-  struct rib *next;
   struct rib *fib = NULL;
   struct rib *select = NULL;
-  struct rib *del = NULL;
-  int installed = 0;
-  struct nexthop *nexthop = NULL;
-  char buf[INET6_ADDRSTRLEN];
-  
-  assert (rn);
-  
-  if (IS_ZEBRA_DEBUG_RIB || IS_ZEBRA_DEBUG_RIB_Q)
-    inet_ntop (rn->p.family, &rn->p.u.prefix, buf, INET6_ADDRSTRLEN);
 
-  RNODE_FOREACH_RIB_SAFE (rn, rib, next)
+  rs->del = NULL;
+  rs->resolving = 0;
+
+  RNODE_FOREACH_RIB (rn, rib)
     {
+      /* Other nexthops may resolve over this node. */
+      if (rib->type != ZEBRA_ROUTE_BGP)
+	rs->resolving = 1;
+
       /* Currently installed rib. */
       if (CHECK_FLAG (rib->flags, ZEBRA_FLAG_SELECTED))
         {
@@ -1131,21 +2161,13 @@ rib_process (struct route_node *rn)
           fib = rib;
         }
       
-      /* Unlock removed routes, so they'll be freed, bar the FIB entry,
-       * which we need to do do further work with below.
+      /* Removed routes are unlocked later, bar the FIB entry, which
+       * we need to do do further work with.
        */
       if (CHECK_FLAG (rib->status, RIB_ENTRY_REMOVED))
         {
-          if (rib != fib)
-            {
-              if (IS_ZEBRA_DEBUG_RIB)
-                zlog_debug ("%s: %s/%d: rn %p, removing rib %p", __func__,
-                  buf, rn->p.prefixlen, rn, rib);
-	      rib_unlink (rn, rib);
-            }
-          else
-            del = rib;
-          
+          if (rib == fib)
+            rs->del = rib;
           continue;
         }
       
@@ -1198,14 +2220,43 @@ rib_process (struct route_node *rn)
       /* metric tie-breaks equal distance */
       if (rib->metric <= select->metric)
         select = rib;
-    } /* RNODE_FOREACH_RIB_SAFE */
+    } /* RNODE_FOREACH_RIB */
 
-  /* After the cycle is finished, the following pointers will be set:
-   * select --- the winner RIB entry, if any was found, otherwise NULL
-   * fib    --- the SELECTED RIB entry, if any, otherwise NULL
-   * del    --- equal to fib, if fib is queued for deletion, NULL otherwise
-   * rib    --- NULL
-   */
+  rs->select = select;
+  rs->fib = fib;
+}
+
+/* Act on the outcome of rib_select(): update kernel, FPM and clients,
+ * and reap removed ribs.  Main thread only.
+ */
+static void
+rib_process_apply (struct rib_select *rs)
+{
+  struct route_node *rn = rs->rn;
+  struct rib *rib;
+  struct rib *next;
+  struct rib *fib = rs->fib;
+  struct rib *select = rs->select;
+  struct rib *del = rs->del;
+  int installed = 0;
+  int takeover = 0;
+  struct nexthop *nexthop = NULL;
+  char buf[INET6_ADDRSTRLEN];
+
+  if (IS_ZEBRA_DEBUG_RIB || IS_ZEBRA_DEBUG_RIB_Q)
+    inet_ntop (rn->p.family, &rn->p.u.prefix, buf, INET6_ADDRSTRLEN);
+
+  UNSET_FLAG (rib_dest_from_rnode (rn)->flags, RIB_DEST_BULK);
+
+  /* Unlock removed routes, so they'll be freed, bar the FIB entry. */
+  RNODE_FOREACH_RIB_SAFE (rn, rib, next)
+    if (CHECK_FLAG (rib->status, RIB_ENTRY_REMOVED) && rib != fib)
+      {
+	if (IS_ZEBRA_DEBUG_RIB)
+	  zlog_debug ("%s: %s/%d: rn %p, removing rib %p", __func__,
+		      buf, rn->p.prefixlen, rn, rib);
+	rib_unlink (rn, rib);
+      }
 
   /* Same RIB entry is selected. Update FIB and finish. */
   if (select && select == fib)
@@ -1213,19 +2264,34 @@ rib_process (struct route_node *rn)
       if (IS_ZEBRA_DEBUG_RIB)
         zlog_debug ("%s: %s/%d: Updating existing route, select %p, fib %p",
                      __func__, buf, rn->p.prefixlen, select, fib);
-      if (CHECK_FLAG (select->flags, ZEBRA_FLAG_CHANGED))
+      if (CHECK_FLAG (select->flags, ZEBRA_FLAG_CHANGED)
+	  || CHECK_FLAG (select->status, RIB_ENTRY_NHOBJ_STALE))
         {
 	  zfpm_trigger_update (rn, "updating existing route");
 
           redistribute_delete (&rn->p, select);
-          if (! RIB_SYSTEM_ROUTE (select))
-            rib_uninstall_kernel (rn, select);
+	  if (rib_nhobj_id (select))
+	    {
+	      /* The kernel route only names its nexthop object, it need
+		 not change if the new nexthops map to the same. */
+	      nexthop_active_update (rn, select, 1);
+	      if (! rib_nhobj_keep (rn, select))
+		{
+		  rib_uninstall_kernel (rn, select);
+		  rib_install_kernel (rn, select);
+		}
+	    }
+	  else
+	    {
+	      if (! RIB_SYSTEM_ROUTE (select))
+		rib_uninstall_kernel (rn, select);
 
-          /* Set real nexthop. */
-          nexthop_active_update (rn, select, 1);
-  
-          if (! RIB_SYSTEM_ROUTE (select))
-            rib_install_kernel (rn, select);
+	      /* Set real nexthop. */
+	      nexthop_active_update (rn, select, 1);
+
+	      if (! RIB_SYSTEM_ROUTE (select))
+		rib_install_kernel (rn, select);
+	    }
           redistribute_add (&rn->p, select);
         }
       else if (! RIB_SYSTEM_ROUTE (select))
@@ -1262,7 +2328,12 @@ rib_process (struct route_node *rn)
       zfpm_trigger_update (rn, "removing existing route");
 
       redistribute_delete (&rn->p, fib);
-      if (! RIB_SYSTEM_ROUTE (fib))
+      if (select && rib_nhobj_id (fib))
+	{
+	  nexthop_active_update (rn, select, 1);
+	  takeover = rib_nhobj_takeover (rn, fib, select);
+	}
+      if (! takeover && ! RIB_SYSTEM_ROUTE (fib))
 	rib_uninstall_kernel (rn, fib);
       UNSET_FLAG (fib->flags, ZEBRA_FLAG_SELECTED);
 
@@ -1285,7 +2356,7 @@ rib_process (struct route_node *rn)
       /* Set real nexthop. */
       nexthop_active_update (rn, select, 1);
 
-      if (! RIB_SYSTEM_ROUTE (select))
+      if (! takeover && ! RIB_SYSTEM_ROUTE (select))
         rib_install_kernel (rn, select);
       SET_FLAG (select->flags, ZEBRA_FLAG_SELECTED);
       redistribute_add (&rn->p, select);
@@ -1301,46 +2372,246 @@ rib_process (struct route_node *rn)
     }
 
 end:
+  if (rs->resolving)
+    rib_nexthop_resolve_flush (&rn->p);
+
+  RNODE_FOREACH_RIB (rn, rib)
+    {
+      rib_fib_count (rn, rib);
+
+      /* Added routes that did not make it to the kernel. */
+      if (CHECK_FLAG (rib->status, RIB_ENTRY_FIB_NOTIFY)
+	  && ! CHECK_FLAG (rib->status, RIB_ENTRY_REMOVED))
+	{
+	  UNSET_FLAG (rib->status, RIB_ENTRY_FIB_NOTIFY);
+	  zsend_route_notify (&rn->p, rib, ZEBRA_FIB_NOT_SELECTED);
+	}
+    }
+
   if (IS_ZEBRA_DEBUG_RIB_Q)
     zlog_debug ("%s: %s/%d: rn %p dequeued", __func__, buf, rn->p.prefixlen, rn);
 
-  /*
-   * Check if the dest can be deleted now.
-   */
-  rib_gc_dest (rn);
+  /*
+   * Check if the dest can be deleted now.
+   */
+  rib_gc_dest (rn);
+}
+
+/* Core function for processing routing information base. */
+static void
+rib_process (struct route_node *rn)
+{
+  struct rib_select rs;
+
+  assert (rn);
+
+  QUAGGA_TRACE (zebra, rib_process_entry, &rn->p);
+  memset (&rs, 0, sizeof (struct rib_select));
+  rs.rn = rn;
+  rib_select (&rs);
+  rib_process_apply (&rs);
+  QUAGGA_TRACE (zebra, rib_process_exit, &rn->p);
+}
+
+/* Done with the route_node at the head of a sub-queue. */
+static void
+process_subq_done (struct list *subq, u_char qindex)
+{
+  struct listnode *lnode = listhead (subq);
+  struct route_node *rnode = listgetdata (lnode);
+
+  if (rnode->info)
+    UNSET_FLAG (rib_dest_from_rnode (rnode)->flags, RIB_ROUTE_QUEUED (qindex));
+
+#if 0
+  else
+    {
+      zlog_debug ("%s: called for route_node (%p, %d) with no ribs",
+                  __func__, rnode, rnode->lock);
+      zlog_backtrace(LOG_DEBUG);
+    }
+#endif
+  route_unlock_node (rnode);
+  list_delete_node (subq, lnode);
+}
+
+/* Take a list of route_node structs and return 1, if there was a record
+ * picked from it and processed by rib_process(). Don't process more, 
+ * than one RN record; operate only in the specified sub-queue.
+ */
+static unsigned int
+process_subq (struct list * subq, u_char qindex)
+{
+  struct listnode *lnode  = listhead (subq);
+
+  if (!lnode)
+    return 0;
+
+  rib_process (listgetdata (lnode));
+  process_subq_done (subq, qindex);
+  return 1;
+}
+
+#ifdef HAVE_PTHREAD
+/* Route_nodes handed to each thread per batch. */
+#define RIB_WORKER_BATCH 256
+
+/* Select the route_nodes of the current batch falling in a shard. */
+static void
+rib_select_shard (unsigned int shard)
+{
+  unsigned int i;
+
+  for (i = 0; i < rib_workers.batch_count; i++)
+    if (rib_workers.batch[i].shard == shard)
+      rib_select (&rib_workers.batch[i]);
+}
+
+static void *
+rib_worker (void *arg)
+{
+  unsigned int shard = (unsigned int) (uintptr_t) arg;
+  unsigned int generation = 0;
+
+  pthread_mutex_lock (&rib_workers.mtx);
+  while (1)
+    {
+      while (rib_workers.generation == generation)
+	pthread_cond_wait (&rib_workers.start, &rib_workers.mtx);
+      generation = rib_workers.generation;
+      pthread_mutex_unlock (&rib_workers.mtx);
+
+      rib_select_shard (shard);
+
+      pthread_mutex_lock (&rib_workers.mtx);
+      if (--rib_workers.pending == 0)
+	pthread_cond_signal (&rib_workers.done);
+    }
+  return NULL;
+}
+
+/* Start the workers.  Done on first use rather than at startup, as
+ * threads do not survive daemon().  Returns 0 if none could be started.
+ */
+static int
+rib_workers_start (void)
+{
+  sigset_t all, old;
+  unsigned int i;
+  int ret;
+
+  rib_workers.threads = XCALLOC (MTYPE_RIB_WORKERS,
+				 rib_worker_threads * sizeof (pthread_t));
+  rib_workers.batch = XCALLOC (MTYPE_RIB_WORKERS,
+			       (rib_worker_threads + 1) * RIB_WORKER_BATCH
+			       * sizeof (struct rib_select));
+  pthread_mutex_init (&rib_workers.mtx, NULL);
+  pthread_mutex_init (&rib_workers.lock, NULL);
+  pthread_cond_init (&rib_workers.start, NULL);
+  pthread_cond_init (&rib_workers.done, NULL);
+
+  /* Signals are for the main thread to handle. */
+  sigfillset (&all);
+  pthread_sigmask (SIG_SETMASK, &all, &old);
+  for (i = 0; i < rib_worker_threads; i++)
+    {
+      ret = pthread_create (&rib_workers.threads[i], NULL, rib_worker,
+			    (void *) (uintptr_t) (i + 1));
+      if (ret)
+	{
+	  zlog_err ("%s: could not start RIB worker thread: %s",
+		    __func__, safe_strerror (ret));
+	  break;
+	}
+    }
+  pthread_sigmask (SIG_SETMASK, &old, NULL);
+
+  rib_workers.count = i;
+  if (rib_workers.count)
+    zlog_info ("RIB selection runs on %u worker threads besides the main one",
+	       rib_workers.count);
+
+  /* Do not try again. */
+  rib_worker_threads = rib_workers.count;
+  return rib_workers.count;
+}
+
+/* Can the route_node be selected alongside others? */
+static int
+rib_select_parallel_ok (struct route_node *rn)
+{
+  struct rib *rib;
+
+  RNODE_FOREACH_RIB (rn, rib)
+    if (rib->type != ZEBRA_ROUTE_BGP)
+      return 0;
+  return 1;
 }
 
-/* Take a list of route_node structs and return 1, if there was a record
- * picked from it and processed by rib_process(). Don't process more, 
- * than one RN record; operate only in the specified sub-queue.
+/* Like process_subq(), but take a batch of BGP route_nodes off the
+ * head of the sub-queue, select their best routes on the worker pool,
+ * sharded by prefix, and then act on the outcome in queue order.
+ * Returns the number of route_nodes processed, 0 if there was only
+ * one to process or the head of the sub-queue is not suitable.
  */
 static unsigned int
-process_subq (struct list * subq, u_char qindex)
+process_subq_parallel (struct list *subq, u_char qindex)
 {
-  struct listnode *lnode  = listhead (subq);
-  struct route_node *rnode;
+  struct listnode *lnode;
+  struct route_node *rn;
+  struct rib_select *rs;
+  unsigned int max, shards, n, i;
 
-  if (!lnode)
+  if (! rib_workers.count && ! rib_workers_start ())
+    return 0;
+
+  shards = rib_workers.count + 1;
+  max = shards * RIB_WORKER_BATCH;
+  n = 0;
+  for (lnode = listhead (subq); lnode && n < max; lnode = listnextnode (lnode))
+    {
+      rn = listgetdata (lnode);
+      if (! rib_select_parallel_ok (rn))
+	break;
+
+      rs = &rib_workers.batch[n++];
+      memset (rs, 0, sizeof (struct rib_select));
+      rs->rn = rn;
+      rs->shard = jhash (&rn->p.u.prefix, PSIZE (rn->p.prefixlen),
+			 rn->p.prefixlen) % shards;
+    }
+  if (n < 2)
     return 0;
 
-  rnode = listgetdata (lnode);
-  rib_process (rnode);
+  /* Select. */
+  pthread_mutex_lock (&rib_workers.mtx);
+  rib_workers.batch_count = n;
+  rib_workers.running = 1;
+  rib_workers.pending = rib_workers.count;
+  rib_workers.generation++;
+  pthread_cond_broadcast (&rib_workers.start);
+  pthread_mutex_unlock (&rib_workers.mtx);
 
-  if (rnode->info)
-    UNSET_FLAG (rib_dest_from_rnode (rnode)->flags, RIB_ROUTE_QUEUED (qindex));
+  rib_select_shard (0);
 
-#if 0
-  else
+  pthread_mutex_lock (&rib_workers.mtx);
+  while (rib_workers.pending)
+    pthread_cond_wait (&rib_workers.done, &rib_workers.mtx);
+  rib_workers.running = 0;
+  pthread_mutex_unlock (&rib_workers.mtx);
+
+  rib_workers.batches++;
+  rib_workers.nodes += n;
+
+  /* Apply, the batch being the head of the sub-queue. */
+  for (i = 0; i < n; i++)
     {
-      zlog_debug ("%s: called for route_node (%p, %d) with no ribs",
-                  __func__, rnode, rnode->lock);
-      zlog_backtrace(LOG_DEBUG);
+      rib_process_apply (&rib_workers.batch[i]);
+      process_subq_done (subq, qindex);
     }
-#endif
-  route_unlock_node (rnode);
-  list_delete_node (subq, lnode);
-  return 1;
+  return n;
 }
+#endif /* HAVE_PTHREAD */
 
 /* Dispatch the meta queue by picking, processing and unlocking the next RN from
  * a non-empty sub-queue with lowest priority. wq is equal to zebra->ribq and data
@@ -1351,13 +2622,26 @@ meta_queue_process (struct work_queue *dummy, void *data)
 {
   struct meta_queue * mq = data;
   unsigned i;
+#ifdef HAVE_PTHREAD
+  unsigned int n;
+#endif /* HAVE_PTHREAD */
 
   for (i = 0; i < MQ_SIZE; i++)
-    if (process_subq (mq->subq[i], i))
-      {
-	mq->size--;
-	break;
-      }
+    {
+#ifdef HAVE_PTHREAD
+      if (rib_worker_threads
+	  && (n = process_subq_parallel (mq->subq[i], i)) != 0)
+	{
+	  mq->size -= n;
+	  break;
+	}
+#endif /* HAVE_PTHREAD */
+      if (process_subq (mq->subq[i], i))
+	{
+	  mq->size--;
+	  break;
+	}
+    }
   return mq->size ? WQ_REQUEUE : WQ_SUCCESS;
 }
 
@@ -1454,7 +2738,7 @@ rib_queue_add (struct zebra_t *zebra, struct route_node *rn)
    * holder, if necessary, then push the work into it in any case.
    * This semantics was introduced after 0.99.9 release.
    */
-  if (!zebra->ribq->items->count)
+  if (!work_queue_item_count (zebra->ribq))
     work_queue_add (zebra->ribq, zebra->mq);
 
   rib_meta_queue_add (zebra->mq, rn);
@@ -1514,6 +2798,88 @@ rib_queue_init (struct zebra_t *zebra)
   return;
 }
 
+/* The kernel may hand zebra a full table at startup.  Its routes are
+   linked without queueing their nodes one at a time: once the whole
+   dump is in, a background walk runs best-path selection on the nodes
+   that nothing else queued meanwhile, yielding to clients now and
+   then. */
+static int rib_bulk_on;
+static u_int32_t rib_bulk_since;
+static struct thread *rib_bulk_thread;
+static rib_tables_iter_t rib_bulk_iter;
+static struct route_node *rib_bulk_rn;
+
+#define RIB_ROUTE_QUEUED_ANY ((1 << MQ_SIZE) - 1)
+
+void
+rib_bulk_start (void)
+{
+  rib_bulk_on = 1;
+  rib_bulk_since = rib_tables_version ();
+}
+
+static int
+rib_bulk_walk (struct thread *thread)
+{
+  struct route_table *table;
+  struct route_node *rn;
+  rib_dest_t *dest;
+  unsigned long count = 0;
+
+  rib_bulk_thread = NULL;
+
+  while (1)
+    {
+      if (! rib_bulk_rn)
+	{
+	  table = rib_tables_iter_next (&rib_bulk_iter);
+	  if (! table)
+	    break;
+	  rib_bulk_rn = route_top (table);
+	  continue;
+	}
+
+      rn = rib_bulk_rn;
+      dest = rib_dest_from_rnode (rn);
+      if (dest && CHECK_FLAG (dest->flags, RIB_DEST_BULK)
+	  && ! CHECK_FLAG (dest->flags, RIB_ROUTE_QUEUED_ANY))
+	{
+	  rib_process (rn);
+	  count++;
+	}
+      rib_bulk_rn = route_next (rn);
+
+      /* Check for the time slot now and then only. */
+      if (rib_bulk_rn && (count & 0xff) == 0xff
+	  && thread_should_yield (thread))
+	{
+	  rib_bulk_thread = thread_add_background (zebrad.master,
+						   rib_bulk_walk, NULL, 0);
+	  return 0;
+	}
+    }
+
+  rib_tables_iter_cleanup (&rib_bulk_iter);
+  if (IS_ZEBRA_DEBUG_RIB)
+    zlog_debug ("%s: startup routes selected", __func__);
+  return 0;
+}
+
+/* The kernel dump is in: select over it once the main loop runs, after
+   the configuration and the FPM are set up. */
+void
+rib_bulk_finish (void)
+{
+  rib_bulk_on = 0;
+
+  /* Only the tables the dump went into. */
+  rib_tables_iter_init_since (&rib_bulk_iter, rib_bulk_since);
+  rib_bulk_rn = NULL;
+  if (! rib_bulk_thread)
+    rib_bulk_thread = thread_add_event (zebrad.master, rib_bulk_walk,
+					NULL, 0);
+}
+
 /* RIB updates are processed via a queue of pointers to route_nodes.
  *
  * The queue length is bounded by the maximal size of the routing table,
@@ -1551,6 +2917,81 @@ rib_queue_init (struct zebra_t *zebra)
  *
  */
  
+static void
+rib_count (u_int32_t *cnt, struct rib *rib, int delta)
+{
+  cnt[rib->type] += delta;
+  if (rib->type == ZEBRA_ROUTE_BGP && CHECK_FLAG (rib->flags, ZEBRA_FLAG_IBGP))
+    cnt[RIB_COUNT_IBGP] += delta;
+}
+
+/* Count a rib in or out of its table, putting the table on the list of
+   non-empty tables with its first rib and taking it off with its last.
+   Tables become empty or not seldom, the list is short. */
+static void
+rib_table_count (struct route_table *table, int delta)
+{
+  rib_table_info_t *info = rib_table_info (table);
+  struct route_table *prev, *next;
+
+  info->version = ++rib_tables_ver;
+  info->rib_total += delta;
+
+  if (delta > 0 && info->rib_total == 1)
+    {
+      /* In before the first table that comes after this one. */
+      prev = NULL;
+      next = rib_tables_nonempty;
+      while (next && rib_table_info (next)->order < info->order)
+	{
+	  prev = next;
+	  next = rib_table_info (next)->next;
+	}
+
+      info->prev = prev;
+      info->next = next;
+      if (prev)
+	rib_table_info (prev)->next = table;
+      else
+	rib_tables_nonempty = table;
+      if (next)
+	rib_table_info (next)->prev = table;
+    }
+  else if (delta < 0 && info->rib_total == 0)
+    {
+      if (info->prev)
+	rib_table_info (info->prev)->next = info->next;
+      else
+	rib_tables_nonempty = info->next;
+      if (info->next)
+	rib_table_info (info->next)->prev = info->prev;
+      info->next = info->prev = NULL;
+    }
+}
+
+/* Count a rib in or out of the FIB of its table, after its nexthops
+   changed FIB state. */
+void
+rib_fib_count (struct route_node *rn, struct rib *rib)
+{
+  struct nexthop *nexthop;
+
+  for (nexthop = rib->nexthop; nexthop; nexthop = nexthop->next)
+    if (CHECK_FLAG (nexthop->flags, NEXTHOP_FLAG_FIB))
+      break;
+
+  if (nexthop && ! CHECK_FLAG (rib->status, RIB_ENTRY_FIB_COUNTED))
+    {
+      SET_FLAG (rib->status, RIB_ENTRY_FIB_COUNTED);
+      rib_count (rib_table_info (rn->table)->fib_cnt, rib, 1);
+    }
+  else if (! nexthop && CHECK_FLAG (rib->status, RIB_ENTRY_FIB_COUNTED))
+    {
+      UNSET_FLAG (rib->status, RIB_ENTRY_FIB_COUNTED);
+      rib_count (rib_table_info (rn->table)->fib_cnt, rib, -1);
+    }
+}
+
 /* Add RIB to head of the route node. */
 static void
 rib_link (struct route_node *rn, struct rib *rib)
@@ -1590,6 +3031,14 @@ rib_link (struct route_node *rn, struct rib *rib)
     }
   rib->next = head;
   dest->routes = rib;
+  rib_count (rib_table_info (rn->table)->rib_cnt, rib, 1);
+  rib_table_count (rn->table, 1);
+
+  if (rib_bulk_on && rib->type == ZEBRA_ROUTE_KERNEL)
+    {
+      SET_FLAG (dest->flags, RIB_DEST_BULK);
+      return;
+    }
   rib_queue_add (&zebrad, rn);
 }
 
@@ -1626,7 +3075,6 @@ rib_addnode (struct route_node *rn, struct rib *rib)
 static void
 rib_unlink (struct route_node *rn, struct rib *rib)
 {
-  struct nexthop *nexthop, *next;
   char buf[INET6_ADDRSTRLEN];
   rib_dest_t *dest;
 
@@ -1651,14 +3099,29 @@ rib_unlink (struct route_node *rn, struct rib *rib)
       dest->routes = rib->next;
     }
 
+  rib_count (rib_table_info (rn->table)->rib_cnt, rib, -1);
+  rib_table_count (rn->table, -1);
+  if (CHECK_FLAG (rib->status, RIB_ENTRY_FIB_COUNTED))
+    rib_count (rib_table_info (rn->table)->fib_cnt, rib, -1);
+
+  rib_nhobj_detach (rib);
+
   /* free RIB and nexthops */
+  rib_discard (rib);
+}
+
+/* Free a rib which is in no table, with its nexthops. */
+void
+rib_discard (struct rib *rib)
+{
+  struct nexthop *nexthop, *next;
+
   for (nexthop = rib->nexthop; nexthop; nexthop = next)
     {
       next = nexthop->next;
       nexthop_free (nexthop);
     }
   XFREE (MTYPE_RIB, rib);
-
 }
 
 static void
@@ -1672,6 +3135,8 @@ rib_delnode (struct route_node *rn, struct rib *rib)
       buf, rn->p.prefixlen, rn, rib);
   }
   SET_FLAG (rib->status, RIB_ENTRY_REMOVED);
+  if (rib->type != ZEBRA_ROUTE_BGP)
+    rib_nexthop_resolve_flush (&rn->p);
   rib_queue_add (&zebrad, rn);
 }
 
@@ -1793,7 +3258,7 @@ void rib_dump (const char * func, const struct prefix_ipv4 * p, const struct rib
   zlog_debug ("%s: dumping RIB entry %p for %s/%d", func, rib, straddr1, p->prefixlen);
   zlog_debug
   (
-    "%s: refcnt == %lu, uptime == %lu, type == %u, table == %d",
+    "%s: refcnt == %u, uptime == %lu, type == %u, table == %d",
     func,
     rib->refcnt,
     (unsigned long) rib->uptime,
@@ -2106,6 +3571,7 @@ rib_delete_ipv4 (int type, int flags, struct prefix_ipv4 *p,
 	    UNSET_FLAG (nexthop->flags, NEXTHOP_FLAG_FIB);
 
 	  UNSET_FLAG (fib->flags, ZEBRA_FLAG_SELECTED);
+	  rib_nexthop_resolve_flush ((struct prefix *) p);
 	}
       else
 	{
@@ -2657,6 +4123,7 @@ rib_delete_ipv6 (int type, int flags, struct prefix_ipv6 *p,
 	    UNSET_FLAG (nexthop->flags, NEXTHOP_FLAG_FIB);
 
 	  UNSET_FLAG (fib->flags, ZEBRA_FLAG_SELECTED);
+	  rib_nexthop_resolve_flush ((struct prefix *) p);
 	}
       else
 	{
@@ -3007,67 +4474,157 @@ rib_update (void)
 }
 
 
-/* Remove all routes which comes from non main table.  */
-static void
-rib_weed_table (struct route_table *table)
+/* Routes left over from before zebra started are cleaned up by a walk
+ * over all RIB tables, run in the background a slice at a time so that
+ * clients are served meanwhile.  Routes from foreign kernel tables are
+ * weeded right away, zebra's own from before a restart are swept
+ * rib_sweep_delay seconds later, leaving its daemons time to reconnect
+ * and take over their prefixes before the old routes go.
+ */
+#define RIB_CLEAN_WEED  (1 << 0)
+#define RIB_CLEAN_SWEEP (1 << 1)
+
+unsigned int rib_sweep_delay = 0;
+
+static struct
 {
+  u_char pending;		/* Walks asked for */
+  u_char active;		/* The walk going on */
+  unsigned long removed;
+  struct thread *t_walk;
+  struct thread *t_sweep;
+  rib_tables_iter_t iter;
   struct route_node *rn;
+} rib_clean;
+
+static void
+rib_clean_node (struct route_node *rn, u_char what)
+{
   struct rib *rib;
   struct rib *next;
 
-  if (table)
-    for (rn = route_top (table); rn; rn = route_next (rn))
-      RNODE_FOREACH_RIB_SAFE (rn, rib, next)
+  RNODE_FOREACH_RIB_SAFE (rn, rib, next)
+    {
+      if (CHECK_FLAG (rib->status, RIB_ENTRY_REMOVED))
+	continue;
+
+      /* Remove all routes which comes from non main table. */
+      if (CHECK_FLAG (what, RIB_CLEAN_WEED)
+	  && rib->table != zebrad.rtm_table_default
+	  && rib->table != RT_TABLE_MAIN)
 	{
-	  if (CHECK_FLAG (rib->status, RIB_ENTRY_REMOVED))
-	    continue;
+	  rib_delnode (rn, rib);
+	  rib_clean.removed++;
+	}
+      /* Delete self installed routes after zebra is relaunched. */
+      else if (CHECK_FLAG (what, RIB_CLEAN_SWEEP)
+	       && rib->type == ZEBRA_ROUTE_KERNEL
+	       && CHECK_FLAG (rib->flags, ZEBRA_FLAG_SELFROUTE))
+	{
+	  if (! rib_uninstall_kernel (rn, rib))
+	    {
+	      rib_delnode (rn, rib);
+	      rib_clean.removed++;
+	    }
+	}
+    }
+}
+
+static void rib_clean_start (u_char);
+
+static int
+rib_clean_walk (struct thread *thread)
+{
+  struct route_table *table;
+  struct route_node *rn;
+  unsigned long count = 0;
+
+  rib_clean.t_walk = NULL;
+
+  while (1)
+    {
+      if (! rib_clean.rn)
+	{
+	  table = rib_tables_iter_next (&rib_clean.iter);
+	  if (! table)
+	    break;
+	  rib_clean.rn = route_top (table);
+	  continue;
+	}
+
+      rn = rib_clean.rn;
+      if (rn->info)
+	rib_clean_node (rn, rib_clean.active);
+      rib_clean.rn = route_next (rn);
 
-	  if (rib->table != zebrad.rtm_table_default &&
-	      rib->table != RT_TABLE_MAIN)
-            rib_delnode (rn, rib);
+      /* Check for the time slot now and then only. */
+      if (rib_clean.rn && (++count & 0xff) == 0
+	  && thread_should_yield (thread))
+	{
+	  rib_clean.t_walk = thread_add_background (zebrad.master,
+						    rib_clean_walk, NULL, 0);
+	  return 0;
 	}
+    }
+
+  rib_tables_iter_cleanup (&rib_clean.iter);
+  zlog_info ("%s %lu old routes",
+	     CHECK_FLAG (rib_clean.active, RIB_CLEAN_SWEEP)
+	     ? "Swept" : "Weeded", rib_clean.removed);
+  rib_clean.active = 0;
+
+  /* Another walk was asked for while this one went on. */
+  if (rib_clean.pending)
+    rib_clean_start (0);
+  return 0;
+}
+
+static void
+rib_clean_start (u_char what)
+{
+  SET_FLAG (rib_clean.pending, what);
+  if (rib_clean.active)
+    return;
+
+  rib_clean.active = rib_clean.pending;
+  rib_clean.pending = 0;
+  rib_clean.removed = 0;
+  rib_clean.rn = NULL;
+  rib_tables_iter_init (&rib_clean.iter);
+  rib_clean.t_walk = thread_add_event (zebrad.master, rib_clean_walk,
+				       NULL, 0);
 }
 
 /* Delete all routes from non main table. */
 void
 rib_weed_tables (void)
 {
-  rib_weed_table (vrf_table (AFI_IP, SAFI_UNICAST, 0));
-  rib_weed_table (vrf_table (AFI_IP6, SAFI_UNICAST, 0));
+  rib_clean_start (RIB_CLEAN_WEED);
 }
-
-/* Delete self installed routes after zebra is relaunched.  */
-static void
-rib_sweep_table (struct route_table *table)
-{
-  struct route_node *rn;
-  struct rib *rib;
-  struct rib *next;
-  int ret = 0;
-
-  if (table)
-    for (rn = route_top (table); rn; rn = route_next (rn))
-      RNODE_FOREACH_RIB_SAFE (rn, rib, next)
-	{
-	  if (CHECK_FLAG (rib->status, RIB_ENTRY_REMOVED))
-	    continue;
 
-	  if (rib->type == ZEBRA_ROUTE_KERNEL && 
-	      CHECK_FLAG (rib->flags, ZEBRA_FLAG_SELFROUTE))
-	    {
-	      ret = rib_uninstall_kernel (rn, rib);
-	      if (! ret)
-                rib_delnode (rn, rib);
-	    }
-	}
+static int
+rib_sweep_timer (struct thread *thread)
+{
+  rib_clean.t_sweep = NULL;
+  rib_clean_start (RIB_CLEAN_SWEEP);
+  return 0;
 }
 
-/* Sweep all RIB tables.  */
+/* Sweep all RIB tables, once clients had the time to reconnect.  */
 void
 rib_sweep_route (void)
 {
-  rib_sweep_table (vrf_table (AFI_IP, SAFI_UNICAST, 0));
-  rib_sweep_table (vrf_table (AFI_IP6, SAFI_UNICAST, 0));
+  if (rib_clean.t_sweep)
+    return;
+
+  if (rib_sweep_delay)
+    {
+      zlog_info ("Sweeping old routes in %u seconds", rib_sweep_delay);
+      rib_clean.t_sweep = thread_add_timer (zebrad.master, rib_sweep_timer,
+					    NULL, rib_sweep_delay);
+    }
+  else
+    rib_clean_start (RIB_CLEAN_SWEEP);
 }
 
 /* Remove specific by protocol routes from 'table'. */
@@ -3132,60 +4689,133 @@ rib_close (void)
   rib_close_table (vrf_table (AFI_IP6, SAFI_UNICAST, 0));
 }
 
+DEFUN (show_zebra_rib_workers,
+       show_zebra_rib_workers_cmd,
+       "show zebra rib workers",
+       SHOW_STR
+       "Zebra information\n"
+       "Routing information base\n"
+       "Best-route selection worker threads\n")
+{
+#ifdef HAVE_PTHREAD
+  if (rib_workers.count)
+    {
+      vty_out (vty, "%u worker threads besides the main one%s",
+	       rib_workers.count, VTY_NEWLINE);
+      vty_out (vty, "  %lu route nodes in %lu batches, average %lu%s",
+	       rib_workers.nodes, rib_workers.batches,
+	       rib_workers.batches ? rib_workers.nodes / rib_workers.batches : 0,
+	       VTY_NEWLINE);
+      return CMD_SUCCESS;
+    }
+  if (rib_worker_threads)
+    {
+      vty_out (vty, "%u worker threads, not started yet%s",
+	       rib_worker_threads, VTY_NEWLINE);
+      return CMD_SUCCESS;
+    }
+#endif /* HAVE_PTHREAD */
+  vty_out (vty, "Routes are selected on the main thread%s", VTY_NEWLINE);
+  return CMD_SUCCESS;
+}
+
 /* Routing information base initialize. */
+DEFUN (show_zebra_kernel_nexthops,
+       show_zebra_kernel_nexthops_cmd,
+       "show zebra kernel nexthops",
+       SHOW_STR
+       "Zebra information\n"
+       "Kernel interface\n"
+       "Nexthop objects routes are installed over\n")
+{
+  struct rib_nhobj *obj;
+  struct rib_nhobj_dep *dep;
+  unsigned long routes;
+  char buf[INET6_ADDRSTRLEN];
+  int i;
+
+  if (! rib_nhobj_on)
+    {
+      vty_out (vty, "Nexthop objects are not in use%s", VTY_NEWLINE);
+      return CMD_SUCCESS;
+    }
+
+  vty_out (vty, "%10s %6s %8s  %s%s", "ID", "Refs", "Routes", "Nexthop",
+	   VTY_NEWLINE);
+  for (obj = rib_nhobj_list; obj; obj = obj->next)
+    {
+      routes = 0;
+      for (dep = obj->deps; dep; dep = dep->next)
+	routes++;
+
+      if (obj->id)
+	vty_out (vty, "%10u", obj->id);
+      else
+	vty_out (vty, "%10s", "-");
+      vty_out (vty, " %6lu %8lu  ", obj->refcnt, routes);
+
+      if (obj->count)
+	{
+	  vty_out (vty, "group");
+	  for (i = 0; i < obj->count; i++)
+	    vty_out (vty, "%s%u", i ? "/" : " ", obj->member[i]->id);
+	}
+      else
+	{
+	  vty_out (vty, "%s",
+		   inet_ntop (obj->family, &obj->gate, buf, sizeof (buf)));
+	  if (obj->path.has_gate
+	      && memcmp (&obj->path.gate, &obj->gate, sizeof (obj->gate)))
+	    vty_out (vty, " via %s", inet_ntop (obj->family, &obj->path.gate,
+						 buf, sizeof (buf)));
+	  if (obj->path.ifindex)
+	    vty_out (vty, " dev %s", ifindex2ifname (obj->path.ifindex));
+	}
+      if (CHECK_FLAG (obj->flags, RIB_NHOBJ_LOST))
+	vty_out (vty, " (removed by kernel)");
+      else if (CHECK_FLAG (obj->flags, RIB_NHOBJ_DEAD))
+	vty_out (vty, " (replaced)");
+      vty_out (vty, "%s", VTY_NEWLINE);
+    }
+  return CMD_SUCCESS;
+}
+
 void
 rib_init (void)
 {
   rib_queue_init (&zebrad);
   /* VRF initialization.  */
   vrf_init ();
+
+  install_element (VIEW_NODE, &show_zebra_rib_workers_cmd);
+  install_element (ENABLE_NODE, &show_zebra_rib_workers_cmd);
+  install_element (VIEW_NODE, &show_zebra_kernel_nexthops_cmd);
+  install_element (ENABLE_NODE, &show_zebra_kernel_nexthops_cmd);
 }
 
 /*
- * vrf_id_get_next
+ * rib_tables_version
  *
- * Get the first vrf id that is greater than the given vrf id if any.
- *
- * Returns TRUE if a vrf id was found, FALSE otherwise.
+ * Returns the current version of the tables, for
+ * rib_tables_iter_init_since().
  */
-static inline int
-vrf_id_get_next (uint32_t id, uint32_t *next_id_p)
+u_int32_t
+rib_tables_version (void)
 {
-  while (++id < vector_active (vrf_vector))
-    {
-      if (vrf_lookup (id))
-	{
-	  *next_id_p = id;
-	  return 1;
-	}
-    }
-
-  return 0;
+  return rib_tables_ver;
 }
 
 /*
  * rib_tables_iter_next
  *
- * Returns the next table in the iteration.
+ * Returns the next table in the iteration.  Only the tables that have
+ * ribs are visited, so vrfs and AFI/SAFIs without routes cost nothing.
  */
 struct route_table *
 rib_tables_iter_next (rib_tables_iter_t *iter)
 {
   struct route_table *table;
-
-  /*
-   * Array that helps us go over all AFI/SAFI combinations via one
-   * index.
-   */
-  static struct {
-    afi_t afi;
-    safi_t safi;
-  } afi_safis[] = {
-    { AFI_IP, SAFI_UNICAST },
-    { AFI_IP, SAFI_MULTICAST },
-    { AFI_IP6, SAFI_UNICAST },
-    { AFI_IP6, SAFI_MULTICAST },
-  };
+  rib_table_info_t *info;
 
   table = NULL;
 
@@ -3193,49 +4823,39 @@ rib_tables_iter_next (rib_tables_iter_t *iter)
     {
 
     case RIB_TABLES_ITER_S_INIT:
-      iter->vrf_id = 0;
-      iter->afi_safi_ix = -1;
-
-      /* Fall through */
+      table = rib_tables_nonempty;
+      break;
 
     case RIB_TABLES_ITER_S_ITERATING:
-      iter->afi_safi_ix++;
-      while (1)
+      info = rib_table_info (iter->table);
+      if (info->rib_total)
 	{
-
-	  while (iter->afi_safi_ix < (int) ZEBRA_NUM_OF (afi_safis))
-	    {
-	      table = vrf_table (afi_safis[iter->afi_safi_ix].afi,
-				 afi_safis[iter->afi_safi_ix].safi,
-				 iter->vrf_id);
-	      if (table)
-		break;
-
-	      iter->afi_safi_ix++;
-	    }
-
-	  /*
-	   * Found another table in this vrf.
-	   */
-	  if (table)
-	    break;
-
-	  /*
-	   * Done with all tables in the current vrf, go to the next
-	   * one.
-	   */
-	  if (!vrf_id_get_next (iter->vrf_id, &iter->vrf_id))
-	    break;
-
-	  iter->afi_safi_ix = 0;
+	  table = info->next;
+	  break;
 	}
 
+      /*
+       * The last table went empty since it was returned, and off the
+       * list: go on from the first table that comes after it.
+       */
+      for (table = rib_tables_nonempty; table;
+	   table = rib_table_info (table)->next)
+	if (rib_table_info (table)->order > info->order)
+	  break;
       break;
 
     case RIB_TABLES_ITER_S_DONE:
       return NULL;
     }
 
+  /*
+   * Skip the tables that did not change since the version asked for.
+   */
+  if (iter->since)
+    while (table && rib_table_info (table)->version <= iter->since)
+      table = rib_table_info (table)->next;
+
+  iter->table = table;
   if (table)
     iter->state = RIB_TABLES_ITER_S_ITERATING;
   else
@@ -293,12 +293,46 @@ check_replace(struct route_node *np2, struct rib *rib2,
   return;
 }
 
+/* Index of ipForwardTable: dest, proto, policy and nexthop. */
+#define IPFWTABLE_INDEX_LEN 10
+
+/* The row get_fwtable_route_node() last returned to a GETNEXT, by its
+ * index and the first node of the table with its destination.  A walk
+ * asks for the row after the one it was given last, which is then
+ * searched for from that node instead of from the top of the table.
+ * The node is locked while it is kept.
+ */
+static struct
+{
+  struct route_table *table;
+  struct route_node *np;
+  oid index[IPFWTABLE_INDEX_LEN];
+} fwtable_cursor;
+
+static void
+fwtable_cursor_set (struct route_table *table, struct route_node *np,
+		    oid *index)
+{
+  /* Nodes with the same destination are ancestors of the node. */
+  while (np->parent
+	 && in_addr_cmp (&np->parent->p.u.prefix, &np->p.u.prefix) == 0)
+    np = np->parent;
+
+  route_lock_node (np);
+  if (fwtable_cursor.np)
+    route_unlock_node (fwtable_cursor.np);
+  fwtable_cursor.table = table;
+  fwtable_cursor.np = np;
+  oid_copy (fwtable_cursor.index, index, IPFWTABLE_INDEX_LEN);
+}
+
 static void
 get_fwtable_route_node(struct variable *v, oid objid[], size_t *objid_len, 
 		       int exact, struct route_node **np, struct rib **rib)
 {
   struct in_addr dest;
   struct route_table *table;
+  struct route_node *start;
   struct route_node *np2;
   struct rib *rib2;
   int proto;
@@ -327,7 +361,7 @@ get_fwtable_route_node(struct variable *v, oid objid[], size_t *objid_len,
 
   /* Short circuit exact matches of wrong length */
 
-  if (exact && (*objid_len != (unsigned) v->namelen + 10))
+  if (exact && (*objid_len != (unsigned) v->namelen + IPFWTABLE_INDEX_LEN))
     return;
 
   table = vrf_table (AFI_IP, SAFI_UNICAST, 0);
@@ -359,14 +393,30 @@ get_fwtable_route_node(struct variable *v, oid objid[], size_t *objid_len,
         return;
     }
 
+  if (exact && policy) /* Not supported (yet?) */
+    return;
+
+  /* Where to search from: the table is in order of destination. */
+  if (!exact && *objid_len == (unsigned) v->namelen + IPFWTABLE_INDEX_LEN
+      && fwtable_cursor.np && fwtable_cursor.table == table
+      && oid_compare (objid + v->namelen, IPFWTABLE_INDEX_LEN,
+		      fwtable_cursor.index, IPFWTABLE_INDEX_LEN) == 0)
+    start = route_lock_node (fwtable_cursor.np);
+  else
+    start = route_top (table);
+
   /* For exact: search matching entry in rib table. */
 
   if (exact)
     {
-      if (policy) /* Not supported (yet?) */
-        return;
-      for (*np = route_top (table); *np; *np = route_next (*np))
+      for (*np = start; *np; *np = route_next (*np))
 	{
+	  if (in_addr_cmp(&(*np)->p.u.prefix, (u_char *)&dest) > 0)
+	    {
+	      route_unlock_node (*np);
+	      *np = NULL;
+	      break;
+	    }
 	  if (!in_addr_cmp(&(*np)->p.u.prefix, (u_char *)&dest))
 	    {
 	      RNODE_FOREACH_RIB (*np, *rib)
@@ -374,17 +424,27 @@ get_fwtable_route_node(struct variable *v, oid objid[], size_t *objid_len,
 		  if (!in_addr_cmp((u_char *)&(*rib)->nexthop->gate.ipv4,
 				   (u_char *)&nexthop))
 		    if (proto == proto_trans((*rib)->type))
-		      return;
+		      {
+			route_unlock_node (*np);
+			return;
+		      }
 		}
 	    }
 	}
+      *rib = NULL;
       return;
     }
 
   /* Search next best entry */
 
-  for (np2 = route_top (table); np2; np2 = route_next (np2))
+  for (np2 = start; np2; np2 = route_next (np2))
     {
+      /* Past the destination found, no row comes before it. */
+      if (*np && in_addr_cmp(&np2->p.u.prefix, &(*np)->p.u.prefix) > 0)
+	{
+	  route_unlock_node (np2);
+	  break;
+	}
 
       /* Check destination first */
       if (in_addr_cmp(&np2->p.u.prefix, (u_char *)&dest) > 0)
@@ -417,7 +477,7 @@ get_fwtable_route_node(struct variable *v, oid objid[], size_t *objid_len,
   policy = 0;
   proto = proto_trans((*rib)->type);
 
-  *objid_len = v->namelen + 10;
+  *objid_len = v->namelen + IPFWTABLE_INDEX_LEN;
   pnt = (u_char *) &(*np)->p.u.prefix;
   for (i = 0; i < 4; i++)
     objid[v->namelen + i] = *pnt++;
@@ -437,6 +497,7 @@ get_fwtable_route_node(struct variable *v, oid objid[], size_t *objid_len,
       }
   }
 
+  fwtable_cursor_set (table, *np, objid + v->namelen);
   return;
 }
 
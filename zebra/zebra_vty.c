@@ -545,7 +545,7 @@ vty_show_ip_route_detail (struct vty *vty, struct route_node *rn)
       if (CHECK_FLAG (rib->flags, ZEBRA_FLAG_SELECTED))
 	vty_out (vty, ", best");
       if (rib->refcnt)
-	vty_out (vty, ", refcnt %ld", rib->refcnt);
+	vty_out (vty, ", refcnt %u", rib->refcnt);
       if (CHECK_FLAG (rib->flags, ZEBRA_FLAG_BLACKHOLE))
        vty_out (vty, ", blackhole");
       if (CHECK_FLAG (rib->flags, ZEBRA_FLAG_REJECT))
@@ -1038,39 +1038,22 @@ DEFUN (show_ip_route_prefix,
   return CMD_SUCCESS;
 }
 
+/* From the counts the table keeps, see rib_table_info_t. */
 static void
 vty_show_ip_route_summary (struct vty *vty, struct route_table *table)
 {
-  struct route_node *rn;
-  struct rib *rib;
-  struct nexthop *nexthop;
-#define ZEBRA_ROUTE_IBGP  ZEBRA_ROUTE_MAX
-#define ZEBRA_ROUTE_TOTAL (ZEBRA_ROUTE_IBGP + 1)
-  u_int32_t rib_cnt[ZEBRA_ROUTE_TOTAL + 1];
-  u_int32_t fib_cnt[ZEBRA_ROUTE_TOTAL + 1];
+  rib_table_info_t *info = rib_table_info (table);
+  u_int32_t *rib_cnt = info->rib_cnt;
+  u_int32_t *fib_cnt = info->fib_cnt;
+  u_int32_t rib_total = 0;
+  u_int32_t fib_total = 0;
   u_int32_t i;
 
-  memset (&rib_cnt, 0, sizeof(rib_cnt));
-  memset (&fib_cnt, 0, sizeof(fib_cnt));
-  for (rn = route_top (table); rn; rn = route_next (rn))
-    RNODE_FOREACH_RIB (rn, rib)
-      for (nexthop = rib->nexthop; nexthop; nexthop = nexthop->next)
-        {
-	  rib_cnt[ZEBRA_ROUTE_TOTAL]++;
-	  rib_cnt[rib->type]++;
-	  if (CHECK_FLAG (nexthop->flags, NEXTHOP_FLAG_FIB)) 
-	    {
-	      fib_cnt[ZEBRA_ROUTE_TOTAL]++;
-	      fib_cnt[rib->type]++;
-	    }
-	  if (rib->type == ZEBRA_ROUTE_BGP && 
-	      CHECK_FLAG (rib->flags, ZEBRA_FLAG_IBGP)) 
-	    {
-	      rib_cnt[ZEBRA_ROUTE_IBGP]++;
-	      if (CHECK_FLAG (nexthop->flags, NEXTHOP_FLAG_FIB)) 
-		fib_cnt[ZEBRA_ROUTE_IBGP]++;
-	    }
-	}
+  for (i = 0; i < ZEBRA_ROUTE_MAX; i++)
+    {
+      rib_total += rib_cnt[i];
+      fib_total += fib_cnt[i];
+    }
 
   vty_out (vty, "%-20s %-20s %-20s %s", 
 	   "Route Source", "Routes", "FIB", VTY_NEWLINE);
@@ -1082,11 +1065,11 @@ vty_show_ip_route_summary (struct vty *vty, struct route_table *table)
 	  if (i == ZEBRA_ROUTE_BGP)
 	    {
 	      vty_out (vty, "%-20s %-20d %-20d %s", "ebgp", 
-		       rib_cnt[ZEBRA_ROUTE_BGP] - rib_cnt[ZEBRA_ROUTE_IBGP],
-		       fib_cnt[ZEBRA_ROUTE_BGP] - fib_cnt[ZEBRA_ROUTE_IBGP],
+		       rib_cnt[ZEBRA_ROUTE_BGP] - rib_cnt[RIB_COUNT_IBGP],
+		       fib_cnt[ZEBRA_ROUTE_BGP] - fib_cnt[RIB_COUNT_IBGP],
 		       VTY_NEWLINE);
 	      vty_out (vty, "%-20s %-20d %-20d %s", "ibgp", 
-		       rib_cnt[ZEBRA_ROUTE_IBGP], fib_cnt[ZEBRA_ROUTE_IBGP],
+		       rib_cnt[RIB_COUNT_IBGP], fib_cnt[RIB_COUNT_IBGP],
 		       VTY_NEWLINE);
 	    }
 	  else 
@@ -1096,8 +1079,8 @@ vty_show_ip_route_summary (struct vty *vty, struct route_table *table)
     }
 
   vty_out (vty, "------%s", VTY_NEWLINE);
-  vty_out (vty, "%-20s %-20d %-20d %s", "Totals", rib_cnt[ZEBRA_ROUTE_TOTAL], 
-	   fib_cnt[ZEBRA_ROUTE_TOTAL], VTY_NEWLINE);  
+  vty_out (vty, "%-20s %-20d %-20d %s", "Totals", rib_total, fib_total,
+	   VTY_NEWLINE);
 }
 
 /* Show route summary.  */
@@ -1564,7 +1547,7 @@ vty_show_ipv6_route_detail (struct vty *vty, struct route_node *rn)
       if (CHECK_FLAG (rib->flags, ZEBRA_FLAG_SELECTED))
 	vty_out (vty, ", best");
       if (rib->refcnt)
-	vty_out (vty, ", refcnt %ld", rib->refcnt);
+	vty_out (vty, ", refcnt %u", rib->refcnt);
       if (CHECK_FLAG (rib->flags, ZEBRA_FLAG_BLACKHOLE))
        vty_out (vty, ", blackhole");
       if (CHECK_FLAG (rib->flags, ZEBRA_FLAG_REJECT))
@@ -2120,12 +2103,56 @@ static struct cmd_node protocol_node = { PROTOCOL_NODE, "", 1 };
 static struct cmd_node ip_node = { IP_NODE,  "",  1 };
 
 /* Route VTY.  */
+/* What the routes take, on average, after "show memory zebra". */
+static void
+zebra_show_memory_routes (struct vty *vty)
+{
+  static const struct
+  {
+    int type;
+    const char *name;
+  } per_route[] =
+  {
+    { MTYPE_RIB,		"RIB"				},
+    { MTYPE_NEXTHOP,		"Nexthop"			},
+    { MTYPE_RIB_DEST,		"RIB destination"		},
+    { MTYPE_ROUTE_NODE,		"Route node"			},
+    { MTYPE_NHOBJ_DEP,		"Kernel nexthop object use"	},
+  };
+  rib_tables_iter_t iter;
+  struct route_table *table;
+  rib_table_info_t *info;
+  unsigned long routes = 0;
+  unsigned long bytes, total = 0;
+  unsigned int i;
+
+  rib_tables_iter_init (&iter);
+  while ((table = rib_tables_iter_next (&iter)))
+    for (info = rib_table_info (table), i = 0; i < ZEBRA_ROUTE_MAX; i++)
+      routes += info->rib_cnt[i];
+  rib_tables_iter_cleanup (&iter);
+
+  vty_out (vty, "Bytes per route, of %lu routes%s", routes, VTY_NEWLINE);
+  if (! routes)
+    return;
+  for (i = 0; i < array_size (per_route); i++)
+    {
+      bytes = mtype_stats_type_bytes (per_route[i].type);
+      total += bytes;
+      vty_out (vty, "%-30s: %10lu%s", per_route[i].name, bytes / routes,
+	       VTY_NEWLINE);
+    }
+  vty_out (vty, "%-30s: %10lu%s", "Total", total / routes, VTY_NEWLINE);
+}
+
 void
 zebra_vty_init (void)
 {
   install_node (&ip_node, zebra_ip_config);
   install_node (&protocol_node, config_write_protocol);
 
+  memory_show_zebra_hook (zebra_show_memory_routes);
+
   install_element (CONFIG_NODE, &ip_protocol_cmd);
   install_element (CONFIG_NODE, &no_ip_protocol_cmd);
   install_element (VIEW_NODE, &show_ip_protocol_cmd);
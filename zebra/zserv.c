@@ -73,6 +73,10 @@ zserv_delayed_close(struct thread *thread)
  */
 static int route_type_oaths[ZEBRA_ROUTE_MAX];
 
+/* Watermarks of the client write buffers. */
+static size_t zserv_wb_high = ZSERV_WB_HIGH_DEFAULT;
+static size_t zserv_wb_low = ZSERV_WB_LOW_DEFAULT;
+
 static int
 zserv_flush_data(struct thread *thread)
 {
@@ -90,7 +94,7 @@ zserv_flush_data(struct thread *thread)
       zlog_warn("%s: buffer_flush_available failed on zserv client fd %d, "
       		"closing", __func__, client->sock);
       zebra_client_close(client);
-      break;
+      return 0;
     case BUFFER_PENDING:
       client->t_write = thread_add_write(zebrad.master, zserv_flush_data,
       					 client, client->sock);
@@ -98,6 +102,10 @@ zserv_flush_data(struct thread *thread)
     case BUFFER_EMPTY:
       break;
     }
+
+  /* Room again for redistribution held back. */
+  if (! zserv_client_full (client))
+    redistribute_schedule (client);
   return 0;
 }
 
@@ -106,6 +114,12 @@ zebra_server_send_message(struct zserv *client)
 {
   if (client->t_suicide)
     return -1;
+  if (client->corked)
+    {
+      buffer_put (client->wb, STREAM_DATA(client->obuf),
+		  stream_get_endp(client->obuf));
+      return 0;
+    }
   switch (buffer_write(client->wb, client->sock, STREAM_DATA(client->obuf),
 		       stream_get_endp(client->obuf)))
     {
@@ -130,6 +144,41 @@ zebra_server_send_message(struct zserv *client)
   return 0;
 }
 
+/* Hold messages to the client in its buffer, to go out in as few
+   writes as possible once uncorked. */
+void
+zserv_cork (struct zserv *client)
+{
+  client->corked = 1;
+}
+
+/* Whether the client has more than enough to read for now: producers of
+   bulk updates pause from the high mark on, until the write thread has
+   made room down to the low mark. */
+int
+zserv_client_full (struct zserv *client)
+{
+  size_t length = buffer_length (client->wb);
+
+  if (client->wb_full && length < zserv_wb_low)
+    client->wb_full = 0;
+  else if (! client->wb_full && length >= zserv_wb_high)
+    {
+      client->wb_full = 1;
+      client->wb_paused++;
+    }
+  return client->wb_full;
+}
+
+void
+zserv_uncork (struct zserv *client)
+{
+  client->corked = 0;
+  if (! client->t_suicide && ! buffer_empty (client->wb))
+    THREAD_WRITE_ON(zebrad.master, client->t_write,
+		    zserv_flush_data, client, client->sock);
+}
+
 static void
 zserv_create_header (struct stream *s, uint16_t cmd)
 {
@@ -682,6 +731,41 @@ zsend_router_id_update (struct zserv *client, struct prefix *p)
 
   return zebra_server_send_message(client);
 }
+
+/* Tell the client that added a route how it came out, status being one
+   of ZEBRA_FIB_*, if it asked to hear. */
+void
+zsend_route_notify (struct prefix *p, struct rib *rib, u_char status)
+{
+  struct listnode *node;
+  struct zserv *client;
+  struct stream *s;
+
+  if (! route_type_oaths[rib->type])
+    return;
+
+  for (ALL_LIST_ELEMENTS_RO (zebrad.client_list, node, client))
+    {
+      if (client->sock != route_type_oaths[rib->type])
+	continue;
+      if (! CHECK_FLAG (client->capabilities, ZEBRA_CAPABILITY_FIB_NOTIFY))
+	return;
+
+      s = client->obuf;
+      stream_reset (s);
+
+      zserv_create_header (s, ZEBRA_ROUTE_NOTIFY);
+      stream_putc (s, rib->type);
+      stream_putc (s, status);
+      stream_putc (s, p->family);
+      stream_putc (s, p->prefixlen);
+      stream_put (s, &p->u.prefix, PSIZE (p->prefixlen));
+      stream_putw_at (s, 0, stream_get_endp (s));
+
+      zebra_server_send_message (client);
+      return;
+    }
+}
 
 /* Register zebra server interface information.  Send current all
    interface and address information. */
@@ -724,76 +808,120 @@ zread_interface_delete (struct zserv *client, u_short length)
   return 0;
 }
 
-/* This function support multiple nexthop. */
-/* 
- * Parse the ZEBRA_IPV4_ROUTE_ADD sent from client. Update rib and
- * add kernel route. 
- */
+/* The IPv4 route messages are decoded unchecked, from windows checked
+   with stream_window() for each part of the message.  A message which
+   turns out short is dropped. */
+
+/* Size of a nexthop of the type in a route message, after its type, or
+   for an interface name the size of its length. */
+static size_t
+zread_nexthop_size (u_char nexthop_type)
+{
+  switch (nexthop_type)
+    {
+    case ZEBRA_NEXTHOP_IFINDEX:
+    case ZEBRA_NEXTHOP_IPV4:
+      return 4;
+    case ZEBRA_NEXTHOP_IFNAME:
+      return 1;
+    case ZEBRA_NEXTHOP_IPV4_IFINDEX:
+      return 8;
+    case ZEBRA_NEXTHOP_IPV6:
+      return IPV6_MAX_BYTELEN;
+    }
+  return 0;
+}
+
+/* Check the window for the next nexthop of a route message, and get its
+   type.  Returns -1 if the message is short. */
 static int
-zread_ipv4_add (struct zserv *client, u_short length)
+zread_nexthop_type (struct stream *s)
 {
-  int i;
-  struct rib *rib;
-  struct prefix_ipv4 p;
-  u_char message;
-  struct in_addr nexthop;
-  u_char nexthop_num;
   u_char nexthop_type;
-  struct stream *s;
-  unsigned int ifindex;
   u_char ifname_len;
-  safi_t safi;	
 
+  if (! stream_window (s, 1))
+    return -1;
+  nexthop_type = stream_wgetc (s);
+  if (! stream_window (s, zread_nexthop_size (nexthop_type)))
+    return -1;
 
-  /* Get input stream.  */
-  s = client->ibuf;
+  /* The name is skipped, nexthops by name are not supported. */
+  if (nexthop_type == ZEBRA_NEXTHOP_IFNAME)
+    {
+      ifname_len = stream_wgetc (s);
+      if (! stream_window (s, ifname_len))
+	return -1;
+      stream_wforward (s, ifname_len);
+    }
+  return nexthop_type;
+}
 
-  /* Allocate new rib. */
-  rib = XCALLOC (MTYPE_RIB, sizeof (struct rib));
-  
-  /* Type, flags, message. */
-  rib->type = stream_getc (s);
-  rib->flags = stream_getc (s);
-  message = stream_getc (s); 
-  safi = stream_getw (s);
-  rib->uptime = time (NULL);
+/* Check the window for the distance and metric of a route message. */
+static int
+zread_distance_metric_window (struct stream *s, u_char message)
+{
+  return stream_window (s, (CHECK_FLAG (message, ZAPI_MESSAGE_DISTANCE) ? 1 : 0)
+			   + (CHECK_FLAG (message, ZAPI_MESSAGE_METRIC) ? 4 : 0));
+}
 
-  /* IPv4 prefix. */
-  memset (&p, 0, sizeof (struct prefix_ipv4));
-  p.family = AF_INET;
-  p.prefixlen = stream_getc (s);
-  stream_get (&p.prefix, s, PSIZE (p.prefixlen));
+/* Type, flags, message, SAFI and prefix length, then the prefix.
+   Returns 0 if the message is short or the prefix malformed. */
+#define ZREAD_ROUTE_HEADER_SIZE 6
+
+static int
+zread_ipv4_prefix (struct stream *s, struct prefix_ipv4 *p)
+{
+  memset (p, 0, sizeof (struct prefix_ipv4));
+  p->family = AF_INET;
+  p->prefixlen = stream_wgetc (s);
+  if (p->prefixlen > IPV4_MAX_BITLEN
+      || ! stream_window (s, PSIZE (p->prefixlen)))
+    return 0;
+  stream_wget (&p->prefix, s, PSIZE (p->prefixlen));
+  return 1;
+}
+
+/* Parse the nexthops, distance and metric of an IPv4 route add into
+   rib.  Returns -1 if the message is short. */
+static int
+zread_ipv4_add_rib (struct stream *s, struct rib *rib, u_char message)
+{
+  int i;
+  struct in_addr nexthop;
+  u_char nexthop_num;
+  int nexthop_type;
+  unsigned int ifindex;
 
   /* Nexthop parse. */
   if (CHECK_FLAG (message, ZAPI_MESSAGE_NEXTHOP))
     {
-      nexthop_num = stream_getc (s);
+      if (! stream_window (s, 1))
+	return -1;
+      nexthop_num = stream_wgetc (s);
 
       for (i = 0; i < nexthop_num; i++)
 	{
-	  nexthop_type = stream_getc (s);
+	  if ((nexthop_type = zread_nexthop_type (s)) < 0)
+	    return -1;
 
 	  switch (nexthop_type)
 	    {
 	    case ZEBRA_NEXTHOP_IFINDEX:
-	      ifindex = stream_getl (s);
+	      ifindex = stream_wgetl (s);
 	      nexthop_ifindex_add (rib, ifindex);
 	      break;
-	    case ZEBRA_NEXTHOP_IFNAME:
-	      ifname_len = stream_getc (s);
-	      stream_forward_getp (s, ifname_len);
-	      break;
 	    case ZEBRA_NEXTHOP_IPV4:
-	      nexthop.s_addr = stream_get_ipv4 (s);
+	      nexthop.s_addr = stream_wget_ipv4 (s);
 	      nexthop_ipv4_add (rib, &nexthop, NULL);
 	      break;
 	    case ZEBRA_NEXTHOP_IPV4_IFINDEX:
-	      nexthop.s_addr = stream_get_ipv4 (s);
-	      ifindex = stream_getl (s);
+	      nexthop.s_addr = stream_wget_ipv4 (s);
+	      ifindex = stream_wgetl (s);
 	      nexthop_ipv4_ifindex_add (rib, &nexthop, NULL, ifindex);
 	      break;
 	    case ZEBRA_NEXTHOP_IPV6:
-	      stream_forward_getp (s, IPV6_MAX_BYTELEN);
+	      stream_wforward (s, IPV6_MAX_BYTELEN);
 	      break;
             case ZEBRA_NEXTHOP_BLACKHOLE:
               nexthop_blackhole_add (rib);
@@ -802,101 +930,307 @@ zread_ipv4_add (struct zserv *client, u_short length)
 	}
     }
 
+  if (! zread_distance_metric_window (s, message))
+    return -1;
+
   /* Distance. */
   if (CHECK_FLAG (message, ZAPI_MESSAGE_DISTANCE))
-    rib->distance = stream_getc (s);
+    rib->distance = stream_wgetc (s);
 
   /* Metric. */
   if (CHECK_FLAG (message, ZAPI_MESSAGE_METRIC))
-    rib->metric = stream_getl (s);
+    rib->metric = stream_wgetl (s);
     
   /* Table */
   rib->table=zebrad.rtm_table_default;
-  rib_add_ipv4_multipath (&p, rib, safi);
   return 0;
 }
 
-/* Zebra server IPv4 prefix delete function. */
+/* This function support multiple nexthop. */
+/* 
+ * Parse the ZEBRA_IPV4_ROUTE_ADD sent from client. Update rib and
+ * add kernel route. 
+ */
 static int
-zread_ipv4_delete (struct zserv *client, u_short length)
+zread_ipv4_add (struct zserv *client, u_short length)
 {
-  int i;
-  struct stream *s;
-  struct zapi_ipv4 api;
-  struct in_addr nexthop, *nexthop_p;
-  unsigned long ifindex;
+  struct rib *rib;
   struct prefix_ipv4 p;
-  u_char nexthop_num;
-  u_char nexthop_type;
-  u_char ifname_len;
-  
+  u_char message;
+  struct stream *s;
+  safi_t safi;	
+
+
+  /* Get input stream.  */
   s = client->ibuf;
-  ifindex = 0;
-  nexthop.s_addr = 0;
-  nexthop_p = NULL;
+  if (! stream_window (s, ZREAD_ROUTE_HEADER_SIZE))
+    {
+      zlog_warn ("%s: short route message", __func__);
+      return -1;
+    }
 
+  /* Allocate new rib. */
+  rib = XCALLOC (MTYPE_RIB, sizeof (struct rib));
+  
   /* Type, flags, message. */
-  api.type = stream_getc (s);
-  api.flags = stream_getc (s);
-  api.message = stream_getc (s);
-  api.safi = stream_getw (s);
+  rib->type = stream_wgetc (s);
+  rib->flags = stream_wgetc (s);
+  message = stream_wgetc (s); 
+  safi = stream_wgetw (s);
+  rib->uptime = time (NULL);
 
   /* IPv4 prefix. */
-  memset (&p, 0, sizeof (struct prefix_ipv4));
-  p.family = AF_INET;
-  p.prefixlen = stream_getc (s);
-  stream_get (&p.prefix, s, PSIZE (p.prefixlen));
+  if (! zread_ipv4_prefix (s, &p)
+      || zread_ipv4_add_rib (s, rib, message) < 0)
+    {
+      zlog_warn ("%s: malformed route message", __func__);
+      rib_discard (rib);
+      return -1;
+    }
+
+  if (safi == SAFI_UNICAST
+      && CHECK_FLAG (client->capabilities, ZEBRA_CAPABILITY_FIB_NOTIFY))
+    SET_FLAG (rib->status, RIB_ENTRY_FIB_NOTIFY);
+  rib_add_ipv4_multipath (&p, rib, safi);
+  return 0;
+}
+
+/* Read the next prefix of a bulk route message.  Returns 0 at the end
+   of the message. */
+static int
+zread_ipv4_bulk_prefix (struct stream *s, struct prefix_ipv4 *p)
+{
+  if (! stream_window (s, 1))
+    return 0;
+
+  if (! zread_ipv4_prefix (s, p))
+    {
+      zlog_warn ("%s: malformed prefix in bulk route message", __func__);
+      return 0;
+    }
+  return 1;
+}
+
+/* Parse ZEBRA_IPV4_ROUTE_BULK_ADD: the attributes of a route add once,
+   then every prefix sharing them.  All of them go onto the rib queue in
+   this one pass. */
+static int
+zread_ipv4_bulk_add (struct zserv *client, u_short length)
+{
+  struct rib *rib;
+  struct prefix_ipv4 p;
+  u_char type, flags, message;
+  struct stream *s;
+  safi_t safi;
+  size_t attr, next;
+  time_t now;
+  int notify;
+
+  s = client->ibuf;
+
+  if (! CHECK_FLAG (client->capabilities, ZEBRA_CAPABILITY_ROUTE_BULK))
+    {
+      zlog_warn ("client %d sent bulk routes without negotiating them",
+		 client->sock);
+      return -1;
+    }
+
+  /* The header and the size of the attributes. */
+  if (! stream_window (s, ZREAD_ROUTE_HEADER_SIZE + 1))
+    {
+      zlog_warn ("%s: malformed bulk route message", __func__);
+      return -1;
+    }
+  type = stream_wgetc (s);
+  flags = stream_wgetc (s);
+  message = stream_wgetc (s);
+  safi = stream_wgetw (s);
+  now = time (NULL);
+  notify = (safi == SAFI_UNICAST
+	    && CHECK_FLAG (client->capabilities, ZEBRA_CAPABILITY_FIB_NOTIFY));
+
+  /* The prefixes follow the attributes, which are parsed again for
+     each rib. */
+  next = stream_wgetw (s);
+  attr = stream_get_getp (s);
+  next += attr;
+  if (next > stream_get_endp (s))
+    {
+      zlog_warn ("%s: malformed bulk route message", __func__);
+      return -1;
+    }
+
+  for (;;)
+    {
+      stream_set_getp (s, next);
+      if (! zread_ipv4_bulk_prefix (s, &p))
+	break;
+      next = stream_get_getp (s);
+
+      rib = XCALLOC (MTYPE_RIB, sizeof (struct rib));
+      rib->type = type;
+      rib->flags = flags;
+      rib->uptime = now;
+      stream_set_getp (s, attr);
+      if (zread_ipv4_add_rib (s, rib, message) < 0)
+	{
+	  zlog_warn ("%s: malformed bulk route message", __func__);
+	  rib_discard (rib);
+	  return -1;
+	}
+      if (notify)
+	SET_FLAG (rib->status, RIB_ENTRY_FIB_NOTIFY);
+      rib_add_ipv4_multipath (&p, rib, safi);
+    }
+  return 0;
+}
+
+/* Parse the nexthop, distance and metric of an IPv4 route delete.
+   Returns -1 if the message is short. */
+static int
+zread_ipv4_delete_api (struct stream *s, struct zapi_ipv4 *api,
+		       struct in_addr *nexthop, struct in_addr **nexthop_p,
+		       unsigned long *ifindex)
+{
+  int i;
+  u_char nexthop_num;
+  int nexthop_type;
+
+  *ifindex = 0;
+  nexthop->s_addr = 0;
+  *nexthop_p = NULL;
 
   /* Nexthop, ifindex, distance, metric. */
-  if (CHECK_FLAG (api.message, ZAPI_MESSAGE_NEXTHOP))
+  if (CHECK_FLAG (api->message, ZAPI_MESSAGE_NEXTHOP))
     {
-      nexthop_num = stream_getc (s);
+      if (! stream_window (s, 1))
+	return -1;
+      nexthop_num = stream_wgetc (s);
 
       for (i = 0; i < nexthop_num; i++)
 	{
-	  nexthop_type = stream_getc (s);
+	  if ((nexthop_type = zread_nexthop_type (s)) < 0)
+	    return -1;
 
 	  switch (nexthop_type)
 	    {
 	    case ZEBRA_NEXTHOP_IFINDEX:
-	      ifindex = stream_getl (s);
-	      break;
-	    case ZEBRA_NEXTHOP_IFNAME:
-	      ifname_len = stream_getc (s);
-	      stream_forward_getp (s, ifname_len);
+	      *ifindex = stream_wgetl (s);
 	      break;
 	    case ZEBRA_NEXTHOP_IPV4:
-	      nexthop.s_addr = stream_get_ipv4 (s);
-	      nexthop_p = &nexthop;
+	      nexthop->s_addr = stream_wget_ipv4 (s);
+	      *nexthop_p = nexthop;
 	      break;
 	    case ZEBRA_NEXTHOP_IPV4_IFINDEX:
-	      nexthop.s_addr = stream_get_ipv4 (s);
-	      ifindex = stream_getl (s);
+	      nexthop->s_addr = stream_wget_ipv4 (s);
+	      *ifindex = stream_wgetl (s);
 	      break;
 	    case ZEBRA_NEXTHOP_IPV6:
-	      stream_forward_getp (s, IPV6_MAX_BYTELEN);
+	      stream_wforward (s, IPV6_MAX_BYTELEN);
 	      break;
 	    }
 	}
     }
 
+  if (! zread_distance_metric_window (s, api->message))
+    return -1;
+
   /* Distance. */
-  if (CHECK_FLAG (api.message, ZAPI_MESSAGE_DISTANCE))
-    api.distance = stream_getc (s);
+  if (CHECK_FLAG (api->message, ZAPI_MESSAGE_DISTANCE))
+    api->distance = stream_wgetc (s);
   else
-    api.distance = 0;
+    api->distance = 0;
 
   /* Metric. */
-  if (CHECK_FLAG (api.message, ZAPI_MESSAGE_METRIC))
-    api.metric = stream_getl (s);
+  if (CHECK_FLAG (api->message, ZAPI_MESSAGE_METRIC))
+    api->metric = stream_wgetl (s);
   else
-    api.metric = 0;
+    api->metric = 0;
+  return 0;
+}
+
+/* Zebra server IPv4 prefix delete function. */
+static int
+zread_ipv4_delete (struct zserv *client, u_short length)
+{
+  struct stream *s;
+  struct zapi_ipv4 api;
+  struct in_addr nexthop, *nexthop_p;
+  unsigned long ifindex;
+  struct prefix_ipv4 p;
+  
+  s = client->ibuf;
+  if (! stream_window (s, ZREAD_ROUTE_HEADER_SIZE))
+    {
+      zlog_warn ("%s: short route message", __func__);
+      return -1;
+    }
+
+  /* Type, flags, message. */
+  api.type = stream_wgetc (s);
+  api.flags = stream_wgetc (s);
+  api.message = stream_wgetc (s);
+  api.safi = stream_wgetw (s);
+
+  /* IPv4 prefix. */
+  if (! zread_ipv4_prefix (s, &p)
+      || zread_ipv4_delete_api (s, &api, &nexthop, &nexthop_p, &ifindex) < 0)
+    {
+      zlog_warn ("%s: malformed route message", __func__);
+      return -1;
+    }
     
   rib_delete_ipv4 (api.type, api.flags, &p, nexthop_p, ifindex,
 		   client->rtm_table, api.safi);
   return 0;
 }
 
+/* Parse ZEBRA_IPV4_ROUTE_BULK_DELETE. */
+static int
+zread_ipv4_bulk_delete (struct zserv *client, u_short length)
+{
+  struct stream *s;
+  struct zapi_ipv4 api;
+  struct in_addr nexthop, *nexthop_p;
+  unsigned long ifindex;
+  struct prefix_ipv4 p;
+  size_t next;
+
+  s = client->ibuf;
+
+  if (! CHECK_FLAG (client->capabilities, ZEBRA_CAPABILITY_ROUTE_BULK))
+    {
+      zlog_warn ("client %d sent bulk routes without negotiating them",
+		 client->sock);
+      return -1;
+    }
+
+  if (! stream_window (s, ZREAD_ROUTE_HEADER_SIZE + 1))
+    {
+      zlog_warn ("%s: malformed bulk route message", __func__);
+      return -1;
+    }
+  api.type = stream_wgetc (s);
+  api.flags = stream_wgetc (s);
+  api.message = stream_wgetc (s);
+  api.safi = stream_wgetw (s);
+
+  next = stream_wgetw (s);
+  next += stream_get_getp (s);
+  if (next > stream_get_endp (s)
+      || zread_ipv4_delete_api (s, &api, &nexthop, &nexthop_p, &ifindex) < 0)
+    {
+      zlog_warn ("%s: malformed bulk route message", __func__);
+      return -1;
+    }
+  stream_set_getp (s, next);
+
+  while (zread_ipv4_bulk_prefix (s, &p))
+    rib_delete_ipv4 (api.type, api.flags, &p, nexthop_p, ifindex,
+		     client->rtm_table, api.safi);
+  return 0;
+}
+
 /* Nexthop lookup for IPv4. */
 static int
 zread_ipv4_nexthop_lookup (struct zserv *client, u_short length)
@@ -1095,15 +1429,411 @@ zread_router_id_delete (struct zserv *client, u_short length)
   return 0;
 }
 
-/* Tie up route-type and client->sock */
-static void
-zread_hello (struct zserv *client)
+/* Nexthop tracking.  A client registers host addresses it wants to
+ * follow; whenever a route covering one of them is installed or
+ * withdrawn the entry is marked, and from an event the address is
+ * looked up again and the result is sent to the client if it differs
+ * from what was sent last.
+ *
+ * Import checks work the same way for prefixes looked up exactly, as
+ * ZEBRA_IPV4_IMPORT_LOOKUP does, in tables of their own.
+ */
+struct zserv_nht
 {
-  /* type of protocol (lib/zebra.h) */
-  u_char proto;
-  proto = stream_getc (client->ibuf);
+  /* A covering route changed since the last lookup. */
+  u_char changed;
 
-  /* accept only dynamic routing protocols */
+  /* Body of the last update sent for this address or prefix. */
+  u_char *data;
+  size_t size;
+};
+
+static struct thread *zebra_nht_thread = NULL;
+
+/* Send the state of a tracked nexthop, or of an import checked prefix
+   when IMPORT. */
+static int
+zsend_nexthop_update (struct zserv *client, struct route_node *rn,
+		      int import, int force)
+{
+  struct zserv_nht *nht = rn->info;
+  struct stream *s;
+  struct rib *rib = NULL;
+  unsigned long nump;
+  u_char num;
+  struct nexthop *nexthop;
+  size_t size;
+
+  if (import)
+    {
+      if (rn->p.family == AF_INET)
+	rib = rib_lookup_ipv4 ((struct prefix_ipv4 *) &rn->p);
+    }
+  else if (rn->p.family == AF_INET)
+    rib = rib_match_ipv4 (rn->p.u.prefix4);
+#ifdef HAVE_IPV6
+  else if (rn->p.family == AF_INET6)
+    rib = rib_match_ipv6 (&rn->p.u.prefix6);
+#endif /* HAVE_IPV6 */
+
+  nht->changed = 0;
+
+  s = client->obuf;
+  stream_reset (s);
+
+  zserv_create_header (s, import ? ZEBRA_IMPORT_UPDATE : ZEBRA_NEXTHOP_UPDATE);
+  stream_putc (s, rn->p.family);
+  if (import)
+    stream_putc (s, rn->p.prefixlen);
+  stream_put (s, &rn->p.u.prefix, PSIZE (rn->p.prefixlen));
+
+  if (rib)
+    {
+      stream_putl (s, rib->metric);
+      num = 0;
+      nump = stream_get_endp(s);
+      stream_putc (s, 0);
+      for (nexthop = rib->nexthop; nexthop; nexthop = nexthop->next)
+	if (CHECK_FLAG (nexthop->flags, NEXTHOP_FLAG_FIB))
+	  {
+	    stream_putc (s, nexthop->type);
+	    switch (nexthop->type)
+	      {
+	      case ZEBRA_NEXTHOP_IPV4:
+		stream_put_in_addr (s, &nexthop->gate.ipv4);
+		break;
+	      case ZEBRA_NEXTHOP_IPV4_IFINDEX:
+		stream_put_in_addr (s, &nexthop->gate.ipv4);
+		stream_putl (s, nexthop->ifindex);
+		break;
+	      case ZEBRA_NEXTHOP_IFINDEX:
+	      case ZEBRA_NEXTHOP_IFNAME:
+		stream_putl (s, nexthop->ifindex);
+		break;
+#ifdef HAVE_IPV6
+	      case ZEBRA_NEXTHOP_IPV6:
+		stream_put (s, &nexthop->gate.ipv6, 16);
+		break;
+	      case ZEBRA_NEXTHOP_IPV6_IFINDEX:
+	      case ZEBRA_NEXTHOP_IPV6_IFNAME:
+		stream_put (s, &nexthop->gate.ipv6, 16);
+		stream_putl (s, nexthop->ifindex);
+		break;
+#endif /* HAVE_IPV6 */
+	      default:
+                /* do nothing */
+		break;
+	      }
+	    num++;
+	  }
+      stream_putc_at (s, nump, num);
+    }
+  else
+    {
+      stream_putl (s, 0);
+      stream_putc (s, 0);
+    }
+
+  stream_putw_at (s, 0, stream_get_endp (s));
+
+  /* Suppress updates which would not tell the client anything new. */
+  size = stream_get_endp (s) - ZEBRA_HEADER_SIZE;
+  if (! force && nht->data && nht->size == size
+      && memcmp (nht->data, s->data + ZEBRA_HEADER_SIZE, size) == 0)
+    return 0;
+
+  if (nht->data)
+    XFREE (MTYPE_ZEBRA_NHT, nht->data);
+  nht->data = XMALLOC (MTYPE_ZEBRA_NHT, size);
+  memcpy (nht->data, s->data + ZEBRA_HEADER_SIZE, size);
+  nht->size = size;
+
+  return zebra_server_send_message(client);
+}
+
+static int
+zread_nexthop_prefix (struct stream *s, struct prefix *p)
+{
+  memset (p, 0, sizeof (struct prefix));
+  p->family = stream_getc (s);
+
+  switch (p->family)
+    {
+    case AF_INET:
+      p->prefixlen = IPV4_MAX_BITLEN;
+      p->u.prefix4.s_addr = stream_get_ipv4 (s);
+      break;
+#ifdef HAVE_IPV6
+    case AF_INET6:
+      p->prefixlen = IPV6_MAX_BITLEN;
+      stream_get (&p->u.prefix6, s, 16);
+      break;
+#endif /* HAVE_IPV6 */
+    default:
+      return -1;
+    }
+  return 0;
+}
+
+/* Register nexthop tracking for an address.  Send its current state. */
+static int
+zread_nexthop_register (struct zserv *client, u_short length)
+{
+  struct prefix p;
+  afi_t afi;
+  struct route_node *rn;
+
+  if (zread_nexthop_prefix (client->ibuf, &p) < 0)
+    return -1;
+
+  afi = family2afi (p.family);
+  if (! client->nht[afi])
+    client->nht[afi] = route_table_init ();
+
+  rn = route_node_get (client->nht[afi], &p);
+  if (rn->info)
+    route_unlock_node (rn);
+  else
+    rn->info = XCALLOC (MTYPE_ZEBRA_NHT, sizeof (struct zserv_nht));
+
+  return zsend_nexthop_update (client, rn, 0, 1);
+}
+
+static void
+zserv_nht_free (struct route_node *rn)
+{
+  struct zserv_nht *nht = rn->info;
+
+  if (nht->data)
+    XFREE (MTYPE_ZEBRA_NHT, nht->data);
+  XFREE (MTYPE_ZEBRA_NHT, nht);
+  rn->info = NULL;
+  route_unlock_node (rn);
+}
+
+/* Unregister nexthop tracking for an address. */
+static int
+zread_nexthop_unregister (struct zserv *client, u_short length)
+{
+  struct prefix p;
+  struct route_node *rn;
+  afi_t afi;
+
+  if (zread_nexthop_prefix (client->ibuf, &p) < 0)
+    return -1;
+
+  afi = family2afi (p.family);
+  if (! client->nht[afi])
+    return 0;
+
+  rn = route_node_lookup (client->nht[afi], &p);
+  if (rn)
+    {
+      route_unlock_node (rn);
+      if (rn->info)
+	zserv_nht_free (rn);
+    }
+  return 0;
+}
+
+/* Import checks are for IPv4 prefixes only, as the lookup they replace. */
+static int
+zread_import_prefix (struct stream *s, struct prefix *p)
+{
+  memset (p, 0, sizeof (struct prefix));
+  p->family = stream_getc (s);
+  p->prefixlen = stream_getc (s);
+  if (p->family != AF_INET || p->prefixlen > IPV4_MAX_PREFIXLEN)
+    return -1;
+  stream_get (&p->u.prefix, s, PSIZE (p->prefixlen));
+  apply_mask (p);
+  return 0;
+}
+
+/* Register an import check for a prefix.  Send its current state. */
+static int
+zread_import_register (struct zserv *client, u_short length)
+{
+  struct prefix p;
+  afi_t afi;
+  struct route_node *rn;
+
+  if (zread_import_prefix (client->ibuf, &p) < 0)
+    return -1;
+
+  afi = family2afi (p.family);
+  if (! client->import[afi])
+    client->import[afi] = route_table_init ();
+
+  rn = route_node_get (client->import[afi], &p);
+  if (rn->info)
+    route_unlock_node (rn);
+  else
+    rn->info = XCALLOC (MTYPE_ZEBRA_NHT, sizeof (struct zserv_nht));
+
+  return zsend_nexthop_update (client, rn, 1, 1);
+}
+
+/* Unregister the import check for a prefix. */
+static int
+zread_import_unregister (struct zserv *client, u_short length)
+{
+  struct prefix p;
+  struct route_node *rn;
+  afi_t afi;
+
+  if (zread_import_prefix (client->ibuf, &p) < 0)
+    return -1;
+
+  afi = family2afi (p.family);
+  if (! client->import[afi])
+    return 0;
+
+  rn = route_node_lookup (client->import[afi], &p);
+  if (rn)
+    {
+      route_unlock_node (rn);
+      if (rn->info)
+	zserv_nht_free (rn);
+    }
+  return 0;
+}
+
+static void
+zserv_nht_table_finish (struct route_table **table)
+{
+  struct route_node *rn;
+
+  if (! *table)
+    return;
+
+  for (rn = route_top (*table); rn; rn = route_next (rn))
+    if (rn->info)
+      zserv_nht_free (rn);
+  route_table_finish (*table);
+  *table = NULL;
+}
+
+static void
+zserv_nht_finish (struct zserv *client)
+{
+  afi_t afi;
+
+  for (afi = AFI_IP; afi < AFI_MAX; afi++)
+    {
+      zserv_nht_table_finish (&client->nht[afi]);
+      zserv_nht_table_finish (&client->import[afi]);
+    }
+}
+
+static int
+zebra_nht_process (struct thread *thread)
+{
+  struct listnode *node, *nnode;
+  struct zserv *client;
+  struct route_node *rn;
+  struct zserv_nht *nht;
+  afi_t afi;
+
+  zebra_nht_thread = NULL;
+
+  for (ALL_LIST_ELEMENTS (zebrad.client_list, node, nnode, client))
+    for (afi = AFI_IP; afi < AFI_MAX; afi++)
+      {
+	if (client->nht[afi])
+	  for (rn = route_top (client->nht[afi]); rn; rn = route_next (rn))
+	    if ((nht = rn->info) != NULL && nht->changed)
+	      zsend_nexthop_update (client, rn, 0, 0);
+	if (client->import[afi])
+	  for (rn = route_top (client->import[afi]); rn; rn = route_next (rn))
+	    if ((nht = rn->info) != NULL && nht->changed)
+	      zsend_nexthop_update (client, rn, 1, 0);
+      }
+  return 0;
+}
+
+/* The selected route for prefix P changed.  Every tracked address
+ * covered by P may now resolve differently, and an import check of P
+ * itself may have another answer; look them up again once the current
+ * batch of RIB work is done.
+ */
+void
+zebra_nht_changed (struct prefix *p)
+{
+  struct listnode *node, *nnode;
+  struct zserv *client;
+  struct route_node *top;
+  struct route_node *rn;
+  struct zserv_nht *nht;
+  afi_t afi;
+  int marked = 0;
+
+  if (p->family != AF_INET
+#ifdef HAVE_IPV6
+      && p->family != AF_INET6
+#endif /* HAVE_IPV6 */
+      )
+    return;
+  afi = family2afi (p->family);
+
+  for (ALL_LIST_ELEMENTS (zebrad.client_list, node, nnode, client))
+    {
+      if (client->import[afi]
+	  && (rn = route_node_lookup (client->import[afi], p)) != NULL)
+	{
+	  route_unlock_node (rn);
+	  if ((nht = rn->info) != NULL)
+	    {
+	      nht->changed = 1;
+	      marked = 1;
+	    }
+	}
+
+      if (! client->nht[afi])
+	continue;
+
+      /* Hold the subtree root so it stays valid as the walk's limit. */
+      top = route_node_get (client->nht[afi], p);
+      route_lock_node (top);
+      for (rn = top; rn; rn = route_next_until (rn, top))
+	if ((nht = rn->info) != NULL)
+	  {
+	    nht->changed = 1;
+	    marked = 1;
+	  }
+      route_unlock_node (top);
+    }
+
+  if (marked && ! zebra_nht_thread)
+    zebra_nht_thread = thread_add_event (zebrad.master, zebra_nht_process,
+					 NULL, 0);
+}
+
+/* Answer a client's hello with the features agreed on. */
+static int
+zsend_hello (struct zserv *client)
+{
+  struct stream *s;
+
+  s = client->obuf;
+  stream_reset (s);
+
+  zserv_create_header (s, ZEBRA_HELLO);
+  stream_putl (s, client->capabilities);
+  stream_putw_at (s, 0, stream_get_endp (s));
+
+  return zebra_server_send_message (client);
+}
+
+/* Tie up route-type and client->sock */
+static void
+zread_hello (struct zserv *client)
+{
+  /* type of protocol (lib/zebra.h) */
+  u_char proto;
+  proto = stream_getc (client->ibuf);
+
+  /* accept only dynamic routing protocols */
   if ((proto < ZEBRA_ROUTE_MAX)
   &&  (proto > ZEBRA_ROUTE_STATIC))
     {
@@ -1118,6 +1848,19 @@ zread_hello (struct zserv *client)
 
       route_type_oaths[proto] = client->sock;
     }
+
+  /* Newer clients offer optional features; confirm what we support.
+     Older ones send nothing more and get no reply. */
+  if (STREAM_READABLE (client->ibuf) >= 4)
+    {
+      client->capabilities = (stream_getl (client->ibuf)
+			      & ZEBRA_CAPABILITY_ALL);
+      /* Routes over nexthop objects follow their gateway in the
+         kernel by themselves. */
+      if (! rib_nhobj_enabled ())
+	UNSET_FLAG (client->capabilities, ZEBRA_CAPABILITY_FOLLOW_IGP);
+      zsend_hello (client);
+    }
 }
 
 /* If client sent routes of specific type, zebra removes it
@@ -1150,9 +1893,17 @@ zebra_client_close (struct zserv *client)
       client->sock = -1;
     }
 
+  /* Drop nexthop tracking state. */
+  zserv_nht_finish (client);
+
+  /* Drop redistribution not sent yet. */
+  redistribute_finish (client);
+
   /* Free stream buffers. */
   if (client->ibuf)
     stream_free (client->ibuf);
+  if (client->rbuf)
+    stream_free (client->rbuf);
   if (client->obuf)
     stream_free (client->obuf);
   if (client->wb)
@@ -1182,6 +1933,7 @@ zebra_client_create (int sock)
   /* Make client input/output buffer. */
   client->sock = sock;
   client->ibuf = stream_new (ZEBRA_MAX_PACKET_SIZ);
+  client->rbuf = stream_new (ZEBRA_RECV_BUF_SIZE);
   client->obuf = stream_new (ZEBRA_MAX_PACKET_SIZ);
   client->wb = buffer_new(0);
 
@@ -1195,106 +1947,14 @@ zebra_client_create (int sock)
   zebra_event (ZEBRA_READ, sock, client);
 }
 
-/* Handler of zebra service request. */
-static int
-zebra_client_read (struct thread *thread)
+/* Handle the client's message in ibuf, its header read. */
+static void
+zebra_client_dispatch (struct zserv *client, uint16_t command,
+		       uint16_t length)
 {
-  int sock;
-  struct zserv *client;
-  size_t already;
-  uint16_t length, command;
-  uint8_t marker, version;
-
-  /* Get thread data.  Reset reading thread because I'm running. */
-  sock = THREAD_FD (thread);
-  client = THREAD_ARG (thread);
-  client->t_read = NULL;
-
-  if (client->t_suicide)
-    {
-      zebra_client_close(client);
-      return -1;
-    }
-
-  /* Read length and command (if we don't have it already). */
-  if ((already = stream_get_endp(client->ibuf)) < ZEBRA_HEADER_SIZE)
-    {
-      ssize_t nbyte;
-      if (((nbyte = stream_read_try (client->ibuf, sock,
-				     ZEBRA_HEADER_SIZE-already)) == 0) ||
-	  (nbyte == -1))
-	{
-	  if (IS_ZEBRA_DEBUG_EVENT)
-	    zlog_debug ("connection closed socket [%d]", sock);
-	  zebra_client_close (client);
-	  return -1;
-	}
-      if (nbyte != (ssize_t)(ZEBRA_HEADER_SIZE-already))
-	{
-	  /* Try again later. */
-	  zebra_event (ZEBRA_READ, sock, client);
-	  return 0;
-	}
-      already = ZEBRA_HEADER_SIZE;
-    }
-
-  /* Reset to read from the beginning of the incoming packet. */
-  stream_set_getp(client->ibuf, 0);
-
-  /* Fetch header values */
-  length = stream_getw (client->ibuf);
-  marker = stream_getc (client->ibuf);
-  version = stream_getc (client->ibuf);
-  command = stream_getw (client->ibuf);
-
-  if (marker != ZEBRA_HEADER_MARKER || version != ZSERV_VERSION)
-    {
-      zlog_err("%s: socket %d version mismatch, marker %d, version %d",
-               __func__, sock, marker, version);
-      zebra_client_close (client);
-      return -1;
-    }
-  if (length < ZEBRA_HEADER_SIZE) 
-    {
-      zlog_warn("%s: socket %d message length %u is less than header size %d",
-	        __func__, sock, length, ZEBRA_HEADER_SIZE);
-      zebra_client_close (client);
-      return -1;
-    }
-  if (length > STREAM_SIZE(client->ibuf))
-    {
-      zlog_warn("%s: socket %d message length %u exceeds buffer size %lu",
-	        __func__, sock, length, (u_long)STREAM_SIZE(client->ibuf));
-      zebra_client_close (client);
-      return -1;
-    }
-
-  /* Read rest of data. */
-  if (already < length)
-    {
-      ssize_t nbyte;
-      if (((nbyte = stream_read_try (client->ibuf, sock,
-				     length-already)) == 0) ||
-	  (nbyte == -1))
-	{
-	  if (IS_ZEBRA_DEBUG_EVENT)
-	    zlog_debug ("connection closed [%d] when reading zebra data", sock);
-	  zebra_client_close (client);
-	  return -1;
-	}
-      if (nbyte != (ssize_t)(length-already))
-        {
-	  /* Try again later. */
-	  zebra_event (ZEBRA_READ, sock, client);
-	  return 0;
-	}
-    }
-
-  length -= ZEBRA_HEADER_SIZE;
-
   /* Debug packet information. */
   if (IS_ZEBRA_DEBUG_EVENT)
-    zlog_debug ("zebra message comes from socket [%d]", sock);
+    zlog_debug ("zebra message comes from socket [%d]", client->sock);
 
   if (IS_ZEBRA_DEBUG_PACKET && IS_ZEBRA_DEBUG_RECV)
     zlog_debug ("zebra message received [%s] %d", 
@@ -1320,6 +1980,12 @@ zebra_client_read (struct thread *thread)
     case ZEBRA_IPV4_ROUTE_DELETE:
       zread_ipv4_delete (client, length);
       break;
+    case ZEBRA_IPV4_ROUTE_BULK_ADD:
+      zread_ipv4_bulk_add (client, length);
+      break;
+    case ZEBRA_IPV4_ROUTE_BULK_DELETE:
+      zread_ipv4_bulk_delete (client, length);
+      break;
 #ifdef HAVE_IPV6
     case ZEBRA_IPV6_ROUTE_ADD:
       zread_ipv6_add (client, length);
@@ -1354,18 +2020,125 @@ zebra_client_read (struct thread *thread)
     case ZEBRA_HELLO:
       zread_hello (client);
       break;
+    case ZEBRA_NEXTHOP_REGISTER:
+      zread_nexthop_register (client, length);
+      break;
+    case ZEBRA_NEXTHOP_UNREGISTER:
+      zread_nexthop_unregister (client, length);
+      break;
+    case ZEBRA_IMPORT_REGISTER:
+      zread_import_register (client, length);
+      break;
+    case ZEBRA_IMPORT_UNREGISTER:
+      zread_import_unregister (client, length);
+      break;
     default:
       zlog_info ("Zebra received unknown command %d", command);
       break;
     }
+}
+
+/* Handler of zebra service requests: what the client sent that fits is
+   read at once and its whole messages handled one after the other, until
+   the thread has run for its time slot. */
+static int
+zebra_client_read (struct thread *thread)
+{
+  int sock;
+  struct zserv *client;
+  struct stream *rbuf;
+  ssize_t nbyte;
+  size_t start;
+  uint16_t length, command;
+  uint8_t marker, version;
+  unsigned int count = 0;
+
+  /* Get thread data.  Reset reading thread because I'm running. */
+  sock = THREAD_FD (thread);
+  client = THREAD_ARG (thread);
+  client->t_read = NULL;
+  rbuf = client->rbuf;
 
   if (client->t_suicide)
     {
-      /* No need to wait for thread callback, just kill immediately. */
       zebra_client_close(client);
       return -1;
     }
 
+  /* After a yield the buffer may be full of messages not yet handled. */
+  if (STREAM_WRITEABLE (rbuf) > 0)
+    {
+      nbyte = stream_read_try (rbuf, sock, STREAM_WRITEABLE (rbuf));
+      if (nbyte == 0 || nbyte == -1)
+	{
+	  if (IS_ZEBRA_DEBUG_EVENT)
+	    zlog_debug ("connection closed socket [%d]", sock);
+	  zebra_client_close (client);
+	  return -1;
+	}
+    }
+
+  while (STREAM_READABLE (rbuf) >= ZEBRA_HEADER_SIZE)
+    {
+      /* Fetch header values */
+      start = stream_get_getp (rbuf);
+      length = stream_getw_from (rbuf, start);
+      marker = stream_getc_from (rbuf, start + 2);
+      version = stream_getc_from (rbuf, start + 3);
+      command = stream_getw_from (rbuf, start + 4);
+
+      if (marker != ZEBRA_HEADER_MARKER || version != ZSERV_VERSION)
+	{
+	  zlog_err("%s: socket %d version mismatch, marker %d, version %d",
+		   __func__, sock, marker, version);
+	  zebra_client_close (client);
+	  return -1;
+	}
+      if (length < ZEBRA_HEADER_SIZE) 
+	{
+	  zlog_warn("%s: socket %d message length %u is less than header size %d",
+		    __func__, sock, length, ZEBRA_HEADER_SIZE);
+	  zebra_client_close (client);
+	  return -1;
+	}
+      if (length > STREAM_SIZE(client->ibuf))
+	{
+	  zlog_warn("%s: socket %d message length %u exceeds buffer size %lu",
+		    __func__, sock, length, (u_long)STREAM_SIZE(client->ibuf));
+	  zebra_client_close (client);
+	  return -1;
+	}
+
+      /* The rest of the message is still to come. */
+      if (STREAM_READABLE (rbuf) < length)
+	break;
+
+      /* The message alone in ibuf, read from after its header. */
+      stream_reset (client->ibuf);
+      stream_put (client->ibuf, STREAM_PNT (rbuf), length);
+      stream_forward_getp (rbuf, length);
+      stream_set_getp (client->ibuf, ZEBRA_HEADER_SIZE);
+
+      zebra_client_dispatch (client, command, length - ZEBRA_HEADER_SIZE);
+
+      if (client->t_suicide)
+	{
+	  /* No need to wait for thread callback, just kill immediately. */
+	  zebra_client_close(client);
+	  return -1;
+	}
+
+      if ((++count & 0x3f) == 0 && thread_should_yield (thread))
+	{
+	  stream_pulldown (rbuf);
+	  client->t_read = thread_add_event (zebrad.master, zebra_client_read,
+					     client, sock);
+	  return 0;
+	}
+    }
+
+  /* Keep what there is of the next message, and read on. */
+  stream_pulldown (rbuf);
   stream_reset (client->ibuf);
   zebra_event (ZEBRA_READ, sock, client);
   return 0;
@@ -1627,11 +2400,81 @@ DEFUN (show_zebra_client,
   struct zserv *client;
 
   for (ALL_LIST_ELEMENTS_RO (zebrad.client_list, node, client))
-    vty_out (vty, "Client fd %d%s", client->sock, VTY_NEWLINE);
+    {
+      vty_out (vty, "Client fd %d%s", client->sock, VTY_NEWLINE);
+      vty_out (vty, "  Write buffer %lu bytes%s, paused %lu times%s",
+	       (u_long) buffer_length (client->wb),
+	       zserv_client_full (client) ? " (full)" : "",
+	       client->wb_paused, VTY_NEWLINE);
+      vty_out (vty, "  %lu prefixes waiting for redistribution%s%s",
+	       client->redist_queued,
+	       client->redist_walk_afi ? ", table walk going on" : "",
+	       VTY_NEWLINE);
+    }
+  vty_out (vty, "Write buffer marks: high %lu, low %lu bytes%s",
+	   (u_long) zserv_wb_high, (u_long) zserv_wb_low, VTY_NEWLINE);
   
   return CMD_SUCCESS;
 }
 
+DEFUN (client_buffer,
+       client_buffer_cmd,
+       "client buffer high <65536-1073741824> low <0-1073741824>",
+       "Zebra client settings\n"
+       "Write buffer to each client\n"
+       "Hold back redistribution to a client with this many bytes waiting\n"
+       "Bytes\n"
+       "Resume it once the client read down to this many\n"
+       "Bytes\n")
+{
+  struct listnode *node;
+  struct zserv *client;
+  u_long high, low;
+
+  VTY_GET_INTEGER_RANGE ("high mark", high, argv[0], 65536, 1073741824);
+  VTY_GET_INTEGER_RANGE ("low mark", low, argv[1], 0, 1073741824);
+  if (low >= high)
+    {
+      vty_out (vty, "%% The low mark must be below the high mark%s",
+	       VTY_NEWLINE);
+      return CMD_WARNING;
+    }
+
+  zserv_wb_high = high;
+  zserv_wb_low = low;
+  for (ALL_LIST_ELEMENTS_RO (zebrad.client_list, node, client))
+    redistribute_schedule (client);
+  return CMD_SUCCESS;
+}
+
+DEFUN (no_client_buffer,
+       no_client_buffer_cmd,
+       "no client buffer",
+       NO_STR
+       "Zebra client settings\n"
+       "Write buffer to each client\n")
+{
+  struct listnode *node;
+  struct zserv *client;
+
+  zserv_wb_high = ZSERV_WB_HIGH_DEFAULT;
+  zserv_wb_low = ZSERV_WB_LOW_DEFAULT;
+  for (ALL_LIST_ELEMENTS_RO (zebrad.client_list, node, client))
+    redistribute_schedule (client);
+  return CMD_SUCCESS;
+}
+
+ALIAS (no_client_buffer,
+       no_client_buffer_val_cmd,
+       "no client buffer high <65536-1073741824> low <0-1073741824>",
+       NO_STR
+       "Zebra client settings\n"
+       "Write buffer to each client\n"
+       "Hold back redistribution to a client with this many bytes waiting\n"
+       "Bytes\n"
+       "Resume it once the client read down to this many\n"
+       "Bytes\n")
+
 /* Table configuration write function. */
 static int
 config_write_table (struct vty *vty)
@@ -1639,6 +2482,10 @@ config_write_table (struct vty *vty)
   if (zebrad.rtm_table_default)
     vty_out (vty, "table %d%s", zebrad.rtm_table_default,
 	     VTY_NEWLINE);
+  if (zserv_wb_high != ZSERV_WB_HIGH_DEFAULT
+      || zserv_wb_low != ZSERV_WB_LOW_DEFAULT)
+    vty_out (vty, "client buffer high %lu low %lu%s", (u_long) zserv_wb_high,
+	     (u_long) zserv_wb_low, VTY_NEWLINE);
   return 0;
 }
 
@@ -1787,6 +2634,9 @@ zebra_init (void)
   install_element (CONFIG_NODE, &ip_forwarding_cmd);
   install_element (CONFIG_NODE, &no_ip_forwarding_cmd);
   install_element (ENABLE_NODE, &show_zebra_client_cmd);
+  install_element (CONFIG_NODE, &client_buffer_cmd);
+  install_element (CONFIG_NODE, &no_client_buffer_cmd);
+  install_element (CONFIG_NODE, &no_client_buffer_val_cmd);
 
 #ifdef HAVE_NETLINK
   install_element (VIEW_NODE, &show_table_cmd);
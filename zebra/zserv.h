@@ -32,6 +32,12 @@
 /* Default configuration filename. */
 #define DEFAULT_CONFIG_FILE "zebra.conf"
 
+/* Redistribution to a client is held back while more than the high
+   mark of bytes wait to be written to it, and resumed below the low
+   mark.  These are the defaults of "client buffer". */
+#define ZSERV_WB_HIGH_DEFAULT         (1024 * 1024)
+#define ZSERV_WB_LOW_DEFAULT          (256 * 1024)
+
 /* Client structure. */
 struct zserv
 {
@@ -42,9 +48,20 @@ struct zserv
   struct stream *ibuf;
   struct stream *obuf;
 
+  /* Bytes read from the client, taken into ibuf a message at a time. */
+  struct stream *rbuf;
+
   /* Buffer of data waiting to be written to client. */
   struct buffer *wb;
 
+  /* Messages are only buffered, to be written together later. */
+  int corked;
+
+  /* Redistribution is held back for a full buffer, and how often it
+     was. */
+  int wb_full;
+  unsigned long wb_paused;
+
   /* Threads for read/write. */
   struct thread *t_read;
   struct thread *t_write;
@@ -66,6 +83,26 @@ struct zserv
 
   /* Router-id information. */
   u_char ridinfo;
+
+  /* Addresses whose reachability this client tracks. */
+  struct route_table *nht[AFI_MAX];
+
+  /* Prefixes whose presence in the RIB this client checks, exactly. */
+  struct route_table *import[AFI_MAX];
+
+  /* Redistribution not sent yet, by prefix, and its thread. */
+  struct route_table *redist_pending[AFI_MAX];
+  unsigned long redist_queued;
+  struct thread *t_redist;
+
+  /* Walk of the RIB for types newly redistributed, and where it is.
+     redist_walk_afi is 0 when there is none. */
+  u_char redist_walk[ZEBRA_ROUTE_MAX];
+  afi_t redist_walk_afi;
+  struct route_node *redist_walk_rn;
+
+  /* Protocol features agreed in ZEBRA_HELLO. */
+  u_int32_t capabilities;
 };
 
 /* Zebra instance */
@@ -107,6 +144,11 @@ extern int zsend_interface_update (int, struct zserv *, struct interface *);
 extern int zsend_route_multipath (int, struct zserv *, struct prefix *, 
                                   struct rib *);
 extern int zsend_router_id_update(struct zserv *, struct prefix *);
+extern void zsend_route_notify (struct prefix *, struct rib *, u_char);
+extern void zserv_cork (struct zserv *);
+extern void zserv_uncork (struct zserv *);
+extern int zserv_client_full (struct zserv *);
+extern void zebra_nht_changed (struct prefix *);
 
 extern pid_t pid;
 